@@ -0,0 +1,103 @@
+using BenchmarkDotNet.Columns;
+using BenchmarkDotNet.Configs;
+using BenchmarkDotNet.Diagnosers;
+using BenchmarkDotNet.Exporters;
+using BenchmarkDotNet.Loggers;
+using BenchmarkDotNet.Reports;
+using BenchmarkDotNet.Running;
+
+namespace AesGcmSiv.Benchmarks
+{
+    /// <summary>
+    /// Settings shared by every benchmark: allocations are always measured, results are grouped
+    /// so each AesGcmSiv row sits next to its AesGcm baseline, a throughput column is added, and
+    /// the results are also exported in the <see cref="BenchmarkResults"/> schema.
+    /// </summary>
+    public sealed class BenchmarkConfig : ManualConfig
+    {
+        public BenchmarkConfig()
+        {
+            AddDiagnoser(MemoryDiagnoser.Default);
+            AddColumn(new ThroughputColumn());
+            AddExporter(new ResultsExporter());
+            AddLogicalGroupRules(BenchmarkLogicalGroupRule.ByCategory, BenchmarkLogicalGroupRule.ByParams);
+        }
+    }
+
+    /// <summary>
+    /// Message bytes processed per second, from the mean time and the <c>MessageSize</c> parameter.
+    /// </summary>
+    public sealed class ThroughputColumn : IColumn
+    {
+        public string Id => nameof(ThroughputColumn);
+        public string ColumnName => "Throughput";
+        public bool AlwaysShow => true;
+        public ColumnCategory Category => ColumnCategory.Statistics;
+        public int PriorityInCategory => 0;
+        public bool IsNumeric => true;
+        public UnitType UnitType => UnitType.Dimensionless;
+        public string Legend => "Message bytes processed per second, in MB/s";
+
+        public bool IsDefault(Summary summary, BenchmarkCase benchmarkCase) => false;
+
+        public bool IsAvailable(Summary summary) => true;
+
+        public string GetValue(Summary summary, BenchmarkCase benchmarkCase) =>
+            GetValue(summary, benchmarkCase, SummaryStyle.Default);
+
+        public string GetValue(Summary summary, BenchmarkCase benchmarkCase, SummaryStyle style)
+        {
+            var statistics = summary[benchmarkCase]?.ResultStatistics;
+            if (statistics == null || benchmarkCase.Parameters["MessageSize"] is not int size)
+                return "NA";
+
+            double bytesPerSecond = size / (statistics.Mean / 1e9);
+            return (bytesPerSecond / (1024 * 1024)).ToString("N1", style.CultureInfo);
+        }
+    }
+
+    /// <summary>
+    /// Writes <c>*-aesgcmsiv.json</c> next to BenchmarkDotNet's own reports, in the schema the
+    /// native benchmark and the <c>compare</c> mode share.
+    /// </summary>
+    public sealed class ResultsExporter : ExporterBase
+    {
+        protected override string FileExtension => "json";
+        protected override string FileCaption => "aesgcmsiv";
+
+        public override void ExportToLog(Summary summary, ILogger logger)
+        {
+            var results = BenchmarkResults.Create("benchmarkdotnet");
+            foreach (BenchmarkReport report in summary.Reports)
+            {
+                var statistics = report.ResultStatistics;
+                if (statistics == null)
+                    continue;
+
+                BenchmarkCase benchmarkCase = report.BenchmarkCase;
+                var parameters = benchmarkCase.Parameters;
+                int? size = parameters["MessageSize"] as int?;
+                bool? withAad = parameters["WithAssociatedData"] as bool?;
+                double opsPerSecond = 1e9 / statistics.Mean;
+                results.Results.Add(new BenchmarkResult
+                {
+                    Name = $"{benchmarkCase.Descriptor.Type.Name}.{benchmarkCase.Descriptor.WorkloadMethod.Name}",
+                    Variant = benchmarkCase.Job.ResolvedId,
+                    Size = size,
+                    Aad = withAad == null ? null : withAad.Value ? CipherBenchmarks.AssociatedDataSize : 0,
+                    Threads = 1,
+                    OpsPerSecond = opsPerSecond,
+                    BytesPerSecond = size * opsPerSecond,
+                    PercentilesNs = new Dictionary<string, double>
+                    {
+                        ["p50"] = statistics.Percentiles.P50,
+                        ["p90"] = statistics.Percentiles.P90,
+                        ["p95"] = statistics.Percentiles.P95,
+                        ["max"] = statistics.Max,
+                    },
+                });
+            }
+            logger.WriteLine(results.ToJson());
+        }
+    }
+}
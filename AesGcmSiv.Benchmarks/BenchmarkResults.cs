@@ -0,0 +1,208 @@
+using System.Runtime.InteropServices;
+using System.Runtime.Intrinsics.X86;
+using System.Text;
+using System.Text.Json;
+using System.Text.Json.Serialization;
+
+namespace AesGcmSiv.Benchmarks
+{
+    /// <summary>
+    /// A results file in the <c>aesgcmsiv-bench/1</c> schema, written by every suite here and by
+    /// <c>bench_aesgcmsiv --json</c>, and read by the <c>compare</c> mode.
+    /// </summary>
+    /// <remarks>
+    /// Each file holds one suite, and a result within it is identified by its name, variant, size, AAD
+    /// size and thread count; the metrics are whichever of throughput, cycles per byte and latency
+    /// percentiles the suite measures.
+    /// Fields a suite does not measure are left out. New fields may be added without changing the
+    /// schema name; changing the meaning of one must change it.
+    /// </remarks>
+    internal sealed class BenchmarkResults
+    {
+        public const string SchemaName = "aesgcmsiv-bench/1";
+
+        private static readonly JsonSerializerOptions s_jsonOptions = new JsonSerializerOptions
+        {
+            PropertyNamingPolicy = JsonNamingPolicy.SnakeCaseLower,
+            DefaultIgnoreCondition = JsonIgnoreCondition.WhenWritingNull,
+            WriteIndented = true,
+        };
+
+        public string Schema { get; set; } = string.Empty;
+
+        public string Suite { get; set; } = string.Empty;
+
+        public MachineInfo Machine { get; set; } = new MachineInfo();
+
+        public BackendInfo Backend { get; set; } = new BackendInfo();
+
+        public double? SecondsPerPoint { get; set; }
+
+        public List<BenchmarkResult> Results { get; set; } = new List<BenchmarkResult>();
+
+        /// <summary>
+        /// Starts a file for <paramref name="suite"/> describing this machine and the loaded native library.
+        /// </summary>
+        public static BenchmarkResults Create(string suite)
+        {
+            return new BenchmarkResults
+            {
+                Schema = SchemaName,
+                Suite = suite,
+                Machine = MachineInfo.Current(),
+                Backend = new BackendInfo
+                {
+                    Name = System.Security.Cryptography.AesGcmSiv.BackendName,
+                    Features = (uint)System.Security.Cryptography.AesGcmSiv.CpuFeatures,
+                },
+            };
+        }
+
+        public string ToJson() => JsonSerializer.Serialize(this, s_jsonOptions);
+
+        public void Write(string path)
+        {
+            File.WriteAllText(path, ToJson() + Environment.NewLine);
+        }
+
+        /// <exception cref="InvalidDataException">The file is not in this schema.</exception>
+        public static BenchmarkResults Read(string path)
+        {
+            BenchmarkResults? results;
+            try
+            {
+                results = JsonSerializer.Deserialize<BenchmarkResults>(File.ReadAllText(path), s_jsonOptions);
+            }
+            catch (JsonException e)
+            {
+                throw new InvalidDataException($"{path}: {e.Message}", e);
+            }
+            if (results == null || results.Schema != SchemaName)
+            {
+                throw new InvalidDataException($"{path}: not an {SchemaName} results file");
+            }
+            return results;
+        }
+    }
+
+    internal sealed class MachineInfo
+    {
+        public string Os { get; set; } = string.Empty;
+
+        public string Arch { get; set; } = string.Empty;
+
+        public string Cpu { get; set; } = string.Empty;
+
+        public int LogicalProcessors { get; set; }
+
+        public string? Runtime { get; set; }
+
+        /// <summary>
+        /// Describes this machine the same way <c>bench_aesgcmsiv</c> does, so files from the two
+        /// suites on one machine match.
+        /// </summary>
+        public static MachineInfo Current()
+        {
+            return new MachineInfo
+            {
+                Os = OperatingSystem.IsWindows() ? "windows"
+                    : OperatingSystem.IsMacOS() ? "macos"
+                    : OperatingSystem.IsLinux() ? "linux"
+                    : "unknown",
+                Arch = RuntimeInformation.ProcessArchitecture switch
+                {
+                    Architecture.X64 => "x64",
+                    Architecture.X86 => "x86",
+                    Architecture.Arm64 => "arm64",
+                    _ => "unknown",
+                },
+                Cpu = CpuName(),
+                LogicalProcessors = Environment.ProcessorCount,
+                Runtime = RuntimeInformation.FrameworkDescription,
+            };
+        }
+
+        // The CPUID brand string on x86, the "model name" line of /proc/cpuinfo elsewhere on Linux
+        private static string CpuName()
+        {
+            string name = string.Empty;
+            if (X86Base.IsSupported)
+            {
+                var brand = new byte[48];
+                for (int leaf = 0; leaf < 3; leaf++)
+                {
+                    (int eax, int ebx, int ecx, int edx) = X86Base.CpuId(unchecked((int)0x80000002u) + leaf, 0);
+                    BitConverter.TryWriteBytes(brand.AsSpan(leaf * 16), eax);
+                    BitConverter.TryWriteBytes(brand.AsSpan(leaf * 16 + 4), ebx);
+                    BitConverter.TryWriteBytes(brand.AsSpan(leaf * 16 + 8), ecx);
+                    BitConverter.TryWriteBytes(brand.AsSpan(leaf * 16 + 12), edx);
+                }
+                int length = Array.IndexOf(brand, (byte)0);
+                name = Encoding.ASCII.GetString(brand, 0, length < 0 ? brand.Length : length);
+            }
+            else if (OperatingSystem.IsLinux() && File.Exists("/proc/cpuinfo"))
+            {
+                string? line = File.ReadLines("/proc/cpuinfo").FirstOrDefault(l => l.StartsWith("model name", StringComparison.Ordinal));
+                int colon = line?.IndexOf(':') ?? -1;
+                if (colon >= 0)
+                    name = line!.Substring(colon + 1);
+            }
+            name = name.Trim();
+            return name.Length == 0 ? "unknown" : name;
+        }
+    }
+
+    internal sealed class BackendInfo
+    {
+        public string Name { get; set; } = string.Empty;
+
+        public uint Features { get; set; }
+    }
+
+    internal sealed class BenchmarkResult
+    {
+        /// <summary>What was timed, such as <c>encrypt</c> or <c>decrypt</c>.</summary>
+        public string Name { get; set; } = string.Empty;
+
+        /// <summary>Distinguishes runs of the same operation, such as a key size or implementation.</summary>
+        public string? Variant { get; set; }
+
+        public long? Size { get; set; }
+
+        public long? Aad { get; set; }
+
+        public int? Threads { get; set; }
+
+        public double? OpsPerSecond { get; set; }
+
+        public double? BytesPerSecond { get; set; }
+
+        public double? CyclesPerByte { get; set; }
+
+        /// <summary>
+        /// Per-call latency in nanoseconds, keyed <c>p50</c>, <c>p99.9</c>, <c>max</c> and so on. The
+        /// BenchmarkDotNet suite can only report percentiles of its iteration means, each of which
+        /// averages many calls, so its tails are much shorter than the latency suite's.
+        /// </summary>
+        public Dictionary<string, double>? PercentilesNs { get; set; }
+
+        /// <summary>Identifies the result within its file, for instance <c>encrypt [shared] size=16 threads=4</c>.</summary>
+        [JsonIgnore]
+        public string Key
+        {
+            get
+            {
+                var key = new StringBuilder(Name);
+                if (Variant != null)
+                    key.Append(" [").Append(Variant).Append(']');
+                if (Size != null)
+                    key.Append(" size=").Append(Size.Value);
+                if (Aad != null)
+                    key.Append(" aad=").Append(Aad.Value);
+                if (Threads != null)
+                    key.Append(" threads=").Append(Threads.Value);
+                return key.ToString();
+            }
+        }
+    }
+}
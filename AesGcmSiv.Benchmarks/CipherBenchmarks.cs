@@ -0,0 +1,85 @@
+using System.Security.Cryptography;
+using BenchmarkDotNet.Attributes;
+using BenchmarkDotNet.Configs;
+
+namespace AesGcmSiv.Benchmarks
+{
+    /// <summary>
+    /// Single-call encryption and decryption with <see cref="System.Security.Cryptography.AesGcmSiv"/>
+    /// against <see cref="AesGcm"/> as the baseline, over messages from 16 bytes to 16 MB, with and
+    /// without associated data. Both use a 256-bit key, a 96-bit nonce and a 128-bit tag, and every
+    /// buffer is allocated once in setup, so the allocation column shows only what a call itself costs.
+    /// </summary>
+    [GroupBenchmarksBy(BenchmarkLogicalGroupRule.ByCategory)]
+    [CategoriesColumn]
+    public class CipherBenchmarks
+    {
+        private const int KeySize = 32;
+        private const int NonceSize = 12;
+        private const int TagSize = 16;
+        internal const int AssociatedDataSize = 32;
+
+        private System.Security.Cryptography.AesGcmSiv _aesGcmSiv = null!;
+        private AesGcm _aesGcm = null!;
+        private byte[] _nonce = null!;
+        private byte[] _plaintext = null!;
+        private byte[]? _associatedData;
+        private byte[] _output = null!;
+        private byte[] _tag = null!;
+        private byte[] _sivCiphertext = null!;
+        private byte[] _sivTag = null!;
+        private byte[] _gcmCiphertext = null!;
+        private byte[] _gcmTag = null!;
+
+        [Params(16, 256, 4 * 1024, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024)]
+        public int MessageSize { get; set; }
+
+        [Params(false, true)]
+        public bool WithAssociatedData { get; set; }
+
+        [GlobalSetup]
+        public void Setup()
+        {
+            var key = RandomNumberGenerator.GetBytes(KeySize);
+            _aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(key);
+            _aesGcm = new AesGcm(key, TagSize);
+
+            _nonce = RandomNumberGenerator.GetBytes(NonceSize);
+            _plaintext = RandomNumberGenerator.GetBytes(MessageSize);
+            _associatedData = WithAssociatedData ? RandomNumberGenerator.GetBytes(AssociatedDataSize) : null;
+            _output = new byte[MessageSize];
+            _tag = new byte[TagSize];
+
+            // Decryption runs over real ciphertext so the tag check passes
+            _sivCiphertext = new byte[MessageSize];
+            _sivTag = new byte[TagSize];
+            _aesGcmSiv.Encrypt(_nonce, _plaintext, _sivCiphertext, _sivTag, _associatedData);
+            _gcmCiphertext = new byte[MessageSize];
+            _gcmTag = new byte[TagSize];
+            _aesGcm.Encrypt(_nonce, _plaintext, _gcmCiphertext, _gcmTag, _associatedData);
+        }
+
+        [GlobalCleanup]
+        public void Cleanup()
+        {
+            _aesGcmSiv.Dispose();
+            _aesGcm.Dispose();
+        }
+
+        [Benchmark(Baseline = true), BenchmarkCategory("Encrypt")]
+        public void AesGcm_Encrypt() =>
+            _aesGcm.Encrypt(_nonce, _plaintext, _output, _tag, _associatedData);
+
+        [Benchmark, BenchmarkCategory("Encrypt")]
+        public void AesGcmSiv_Encrypt() =>
+            _aesGcmSiv.Encrypt(_nonce, _plaintext, _output, _tag, _associatedData);
+
+        [Benchmark(Baseline = true), BenchmarkCategory("Decrypt")]
+        public void AesGcm_Decrypt() =>
+            _aesGcm.Decrypt(_nonce, _gcmCiphertext, _gcmTag, _output, _associatedData);
+
+        [Benchmark, BenchmarkCategory("Decrypt")]
+        public void AesGcmSiv_Decrypt() =>
+            _aesGcmSiv.Decrypt(_nonce, _sivCiphertext, _sivTag, _output, _associatedData);
+    }
+}
@@ -0,0 +1,228 @@
+using System.Diagnostics;
+using System.Globalization;
+using System.Runtime.InteropServices;
+using System.Security.Cryptography;
+
+namespace AesGcmSiv.Benchmarks
+{
+    /// <summary>
+    /// Time from process start to the first successful encryption. Each run spawns a fresh copy of
+    /// this program which goes through the first-use path one step at a time and reports how long
+    /// each step took:
+    /// <list type="bullet">
+    /// <item><description><c>runtime</c>: spawn until managed code runs, which is .NET startup and no concern of the library</description></item>
+    /// <item><description><c>library load</c>: loading the native library and its dependencies and binding the exports</description></item>
+    /// <item><description><c>openssl init</c>: <c>OPENSSL_init_crypto</c>, including reading the configuration file</description></item>
+    /// <item><description><c>provider fetch</c>: the rest of <see cref="System.Security.Cryptography.AesGcmSiv.Preload"/>, which creates the library's OpenSSL context, loads its provider and fetches the ciphers</description></item>
+    /// <item><description><c>key setup</c>: the first <see cref="System.Security.Cryptography.AesGcmSiv"/> constructor</description></item>
+    /// <item><description><c>first encrypt</c>: the first 16-byte <see cref="System.Security.Cryptography.AesGcmSiv.Encrypt(byte[], byte[], byte[], byte[], byte[])"/></description></item>
+    /// </list>
+    /// </summary>
+    /// <remarks>
+    /// Options: <c>--runs 20</c>, <c>--no-config</c>, which passes
+    /// <see cref="AesGcmSivPreloadOptions.SkipOpenSslConfig"/>, and <c>--json path</c>, which also writes
+    /// each step's minimum, median and maximum as <see cref="BenchmarkResults"/>. The two OpenSSL steps
+    /// are only taken with the OpenSSL backend; a hardware kernel never initializes OpenSSL, and they
+    /// show as zero.
+    /// They are told apart by calling <c>OPENSSL_init_crypto</c> directly before the preload, which
+    /// needs a libcrypto that can be loaded by name; with a statically linked one the initialization
+    /// is counted under <c>provider fetch</c>. Every step also includes JIT compiling the code it
+    /// runs, as a real first call would.
+    /// </remarks>
+    internal static unsafe class ColdStartBenchmark
+    {
+        private const string ChildArgument = "--child";
+        private const ulong OPENSSL_INIT_LOAD_CONFIG = 0x40;
+        private const ulong OPENSSL_INIT_NO_LOAD_CONFIG = 0x80;
+
+        private static readonly string[] s_phases =
+        {
+            "runtime", "library load", "openssl init", "provider fetch", "key setup", "first encrypt",
+        };
+
+        public static int Run(string[] args)
+        {
+            long mainEntered = Stopwatch.GetTimestamp();
+            int runs = 20;
+            bool noConfig = false;
+            string? jsonPath = null;
+            long spawned = 0;
+
+            for (int i = 0; i < args.Length; i++)
+            {
+                bool ok = true;
+                switch (args[i])
+                {
+                    case "--no-config":
+                        noConfig = true;
+                        continue;
+                    case "--runs":
+                        ok = i + 1 < args.Length && int.TryParse(args[i + 1], NumberStyles.None, CultureInfo.InvariantCulture, out runs) && runs > 0;
+                        break;
+                    case "--json":
+                        ok = i + 1 < args.Length;
+                        jsonPath = ok ? args[i + 1] : null;
+                        break;
+                    case ChildArgument:
+                        ok = i + 1 < args.Length && long.TryParse(args[i + 1], NumberStyles.None, CultureInfo.InvariantCulture, out spawned);
+                        break;
+                    default:
+                        ok = false;
+                        break;
+                }
+                if (!ok)
+                {
+                    Console.Error.WriteLine($"coldstart: bad or incomplete option {args[i]}");
+                    return 2;
+                }
+                i++;
+            }
+
+            return spawned != 0 ? RunChild(spawned, mainEntered, noConfig) : RunParent(runs, noConfig, jsonPath);
+        }
+
+        private static int RunParent(int runs, bool noConfig, string? jsonPath)
+        {
+            // Under "dotnet bench.dll" the process is the host, which needs the assembly path
+            string host = Environment.ProcessPath ?? throw new InvalidOperationException("No process path.");
+            string? assembly = Path.GetFileNameWithoutExtension(host) == "dotnet"
+                ? typeof(ColdStartBenchmark).Assembly.Location
+                : null;
+
+            var samples = new List<double[]>();
+            string backend = "unknown";
+            for (int run = 0; run < runs; run++)
+            {
+                var start = new ProcessStartInfo(host)
+                {
+                    RedirectStandardOutput = true,
+                    UseShellExecute = false,
+                };
+                if (assembly != null)
+                    start.ArgumentList.Add(assembly);
+                start.ArgumentList.Add("coldstart");
+                if (noConfig)
+                    start.ArgumentList.Add("--no-config");
+                start.ArgumentList.Add(ChildArgument);
+
+                // Stopwatch timestamps come from a system-wide monotonic clock, so the child can
+                // measure from the parent's timestamp
+                start.ArgumentList.Add(Stopwatch.GetTimestamp().ToString(CultureInfo.InvariantCulture));
+                using Process child = Process.Start(start)!;
+                string output = child.StandardOutput.ReadToEnd();
+                child.WaitForExit();
+                if (child.ExitCode != 0)
+                {
+                    Console.Error.WriteLine($"coldstart: run {run} exited with {child.ExitCode}");
+                    return 1;
+                }
+
+                var sample = new double[s_phases.Length];
+                foreach (string line in output.Split('\n', StringSplitOptions.RemoveEmptyEntries | StringSplitOptions.TrimEntries))
+                {
+                    int tab = line.IndexOf('\t');
+                    string name = line.Substring(0, tab);
+                    string value = line.Substring(tab + 1);
+                    int phase = Array.IndexOf(s_phases, name);
+                    if (phase >= 0)
+                        sample[phase] = double.Parse(value, CultureInfo.InvariantCulture);
+                    else if (name == "backend")
+                        backend = value;
+                }
+                samples.Add(sample);
+            }
+
+            Console.WriteLine($"# backend {backend}, {runs} fresh processes{(noConfig ? ", OpenSSL config skipped" : "")}, milliseconds");
+            Console.WriteLine($"{"phase",-16} {"min",9} {"median",9} {"max",9}");
+            var results = BenchmarkResults.Create("coldstart");
+            for (int phase = 0; phase < s_phases.Length; phase++)
+            {
+                PrintRow(results, s_phases[phase], samples.Select(s => s[phase]).ToArray(), noConfig);
+            }
+            PrintRow(results, "library total", samples.Select(s => s.Skip(1).Sum()).ToArray(), noConfig);
+            PrintRow(results, "spawn to first", samples.Select(s => s.Sum()).ToArray(), noConfig);
+            if (jsonPath != null)
+                results.Write(jsonPath);
+            return 0;
+        }
+
+        private static void PrintRow(BenchmarkResults results, string name, double[] values, bool noConfig)
+        {
+            Array.Sort(values);
+            double median = values.Length % 2 == 1
+                ? values[values.Length / 2]
+                : (values[values.Length / 2 - 1] + values[values.Length / 2]) / 2;
+            Console.WriteLine(string.Create(CultureInfo.InvariantCulture,
+                $"{name,-16} {values[0],9:F3} {median,9:F3} {values[^1],9:F3}"));
+            results.Results.Add(new BenchmarkResult
+            {
+                Name = "coldstart " + name,
+                Variant = noConfig ? "no-config" : null,
+                PercentilesNs = new Dictionary<string, double>
+                {
+                    ["min"] = values[0] * 1e6,
+                    ["p50"] = median * 1e6,
+                    ["max"] = values[^1] * 1e6,
+                },
+            });
+        }
+
+        private static int RunChild(long spawned, long mainEntered, bool noConfig)
+        {
+            var options = noConfig ? AesGcmSivPreloadOptions.SkipOpenSslConfig : AesGcmSivPreloadOptions.None;
+            var phases = new double[s_phases.Length];
+            phases[0] = Stopwatch.GetElapsedTime(spawned, mainEntered).TotalMilliseconds;
+
+            long begin = Stopwatch.GetTimestamp();
+            string backend = System.Security.Cryptography.AesGcmSiv.BackendName;
+            phases[1] = Stopwatch.GetElapsedTime(begin).TotalMilliseconds;
+
+            if (backend == "openssl")
+            {
+                begin = Stopwatch.GetTimestamp();
+                if (TryInitOpenSsl(noConfig))
+                    phases[2] = Stopwatch.GetElapsedTime(begin).TotalMilliseconds;
+
+                begin = Stopwatch.GetTimestamp();
+                System.Security.Cryptography.AesGcmSiv.Preload(options);
+                phases[3] = Stopwatch.GetElapsedTime(begin).TotalMilliseconds;
+            }
+
+            var key = new byte[32];
+            var nonce = new byte[12];
+            var plaintext = new byte[16];
+            var ciphertext = new byte[16];
+            var tag = new byte[16];
+
+            begin = Stopwatch.GetTimestamp();
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(key);
+            phases[4] = Stopwatch.GetElapsedTime(begin).TotalMilliseconds;
+
+            begin = Stopwatch.GetTimestamp();
+            aesGcmSiv.Encrypt(nonce, plaintext, ciphertext, tag);
+            phases[5] = Stopwatch.GetElapsedTime(begin).TotalMilliseconds;
+
+            Console.WriteLine($"backend\t{backend}");
+            for (int phase = 0; phase < s_phases.Length; phase++)
+            {
+                Console.WriteLine(string.Create(CultureInfo.InvariantCulture, $"{s_phases[phase]}\t{phases[phase]:R}"));
+            }
+            return 0;
+        }
+
+        // The native library has already loaded libcrypto, so this finds the same copy
+        private static bool TryInitOpenSsl(bool noConfig)
+        {
+            string name = OperatingSystem.IsWindows()
+                ? (RuntimeInformation.ProcessArchitecture == Architecture.Arm64 ? "libcrypto-3-arm64.dll" : "libcrypto-3-x64.dll")
+                : OperatingSystem.IsMacOS() ? "libcrypto.3.dylib" : "libcrypto.so.3";
+            if (!NativeLibrary.TryLoad(name, out IntPtr library)
+                || !NativeLibrary.TryGetExport(library, "OPENSSL_init_crypto", out IntPtr export))
+            {
+                return false;
+            }
+            var init = (delegate* unmanaged<ulong, IntPtr, int>)export;
+            return init(noConfig ? OPENSSL_INIT_NO_LOAD_CONFIG : OPENSSL_INIT_LOAD_CONFIG, IntPtr.Zero) == 1;
+        }
+    }
+}
@@ -0,0 +1,39 @@
+using System.Globalization;
+
+namespace AesGcmSiv.Benchmarks
+{
+    /// <summary>
+    /// Option parsing shared by the modes that run outside BenchmarkDotNet.
+    /// </summary>
+    internal static class CommandLine
+    {
+        /// <summary>
+        /// Parses a comma-separated list of non-negative integers such as <c>16,256,4096</c>.
+        /// </summary>
+        public static bool TryParseList(string text, out int[] values)
+        {
+            var parts = text.Split(',', StringSplitOptions.RemoveEmptyEntries);
+            values = new int[parts.Length];
+            for (int i = 0; i < parts.Length; i++)
+            {
+                if (!int.TryParse(parts[i], NumberStyles.None, CultureInfo.InvariantCulture, out values[i]))
+                    return false;
+            }
+            return values.Length > 0;
+        }
+
+        /// <summary>
+        /// 1, 2, 4, ... up to the processor count, which is always included.
+        /// </summary>
+        public static int[] DefaultThreadCounts()
+        {
+            var counts = new List<int>();
+            for (int n = 1; n < Environment.ProcessorCount; n *= 2)
+            {
+                counts.Add(n);
+            }
+            counts.Add(Environment.ProcessorCount);
+            return counts.ToArray();
+        }
+    }
+}
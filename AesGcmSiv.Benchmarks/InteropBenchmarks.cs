@@ -0,0 +1,81 @@
+using System.Reflection;
+using System.Runtime.InteropServices;
+using System.Security.Cryptography;
+using BenchmarkDotNet.Attributes;
+
+namespace AesGcmSiv.Benchmarks
+{
+    /// <summary>
+    /// Per-call cost of reaching the native library. <c>aesgcmsiv_nop</c> is called through the same
+    /// kind of function pointer the library binds, with and without the GC transition, and is set
+    /// against a 16-byte encrypt and decrypt. Run with <c>--mock</c> to repeat everything against the
+    /// mock library, whose cipher calls do no cryptography: what remains there is validation,
+    /// pinning and the transition itself.
+    /// </summary>
+    public unsafe class InteropBenchmarks
+    {
+        private const int MessageSize = 16;
+
+        private delegate* unmanaged[Cdecl]<void> _nop;
+        private delegate* unmanaged[Cdecl, SuppressGCTransition]<void> _nopWithoutTransition;
+        private System.Security.Cryptography.AesGcmSiv _aesGcmSiv = null!;
+        private System.Security.Cryptography.AesGcmSiv _aesGcmSivFastPath = null!;
+        private byte[] _nonce = null!;
+        private byte[] _plaintext = null!;
+        private byte[] _ciphertext = null!;
+        private byte[] _output = null!;
+        private byte[] _tag = null!;
+
+        [GlobalSetup]
+        public void Setup()
+        {
+            // Construct first so the library is loaded and bound the usual way, then look up the
+            // export in that same library
+            var key = RandomNumberGenerator.GetBytes(32);
+            _aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(key);
+            _aesGcmSivFastPath = new System.Security.Cryptography.AesGcmSiv(key) { SmallMessageFastPath = true };
+
+            IntPtr nop = NativeLibrary.GetExport(LoadLibrary(), "aesgcmsiv_nop");
+            _nop = (delegate* unmanaged[Cdecl]<void>)nop;
+            _nopWithoutTransition = (delegate* unmanaged[Cdecl, SuppressGCTransition]<void>)nop;
+
+            _nonce = RandomNumberGenerator.GetBytes(12);
+            _plaintext = RandomNumberGenerator.GetBytes(MessageSize);
+            _ciphertext = new byte[MessageSize];
+            _output = new byte[MessageSize];
+            _tag = new byte[16];
+            _aesGcmSiv.Encrypt(_nonce, _plaintext, _ciphertext, _tag);
+        }
+
+        [GlobalCleanup]
+        public void Cleanup()
+        {
+            _aesGcmSiv.Dispose();
+            _aesGcmSivFastPath.Dispose();
+        }
+
+        // Resolves the library the way AesGcmSiv does; loading it again only returns the handle
+        private static IntPtr LoadLibrary()
+        {
+            string? path = Environment.GetEnvironmentVariable("AESGCMSIV_NATIVE_LIBRARY");
+            return string.IsNullOrEmpty(path)
+                ? NativeLibrary.Load("aesgcmsiv", typeof(System.Security.Cryptography.AesGcmSiv).Assembly, null)
+                : NativeLibrary.Load(path);
+        }
+
+        [Benchmark(Baseline = true)]
+        public void Nop() => _nop();
+
+        [Benchmark]
+        public void Nop_WithoutGCTransition() => _nopWithoutTransition();
+
+        [Benchmark]
+        public void Encrypt16() => _aesGcmSiv.Encrypt(_nonce, _plaintext, _output, _tag);
+
+        [Benchmark]
+        public void Encrypt16_FastPath() => _aesGcmSivFastPath.Encrypt(_nonce, _plaintext, _output, _tag);
+
+        [Benchmark]
+        public void Decrypt16() => _aesGcmSiv.Decrypt(_nonce, _ciphertext, _tag, _output);
+    }
+}
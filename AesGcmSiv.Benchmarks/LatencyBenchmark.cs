@@ -0,0 +1,183 @@
+using System.Diagnostics;
+using System.Globalization;
+using System.Security.Cryptography;
+
+namespace AesGcmSiv.Benchmarks
+{
+    /// <summary>
+    /// Latency distribution of single synchronous calls, which BenchmarkDotNet's means and
+    /// standard deviations smooth over. Every thread times each call on its own and records it in
+    /// a per-thread <see cref="LatencyHistogram"/>. The histograms are merged per message size and
+    /// thread count and reported as percentiles, so contention and allocator stalls show up in the
+    /// tail even when throughput looks unchanged.
+    /// </summary>
+    /// <remarks>
+    /// Options: <c>--sizes 16,256,4096</c>, <c>--threads 1,2,4</c>, <c>--seconds 1</c>,
+    /// <c>--op encrypt|decrypt|both</c> and <c>--json path</c>, which also writes the results as
+    /// <see cref="BenchmarkResults"/>. All threads share one <see cref="System.Security.Cryptography.AesGcmSiv"/>,
+    /// as a server would. Timings use <see cref="Stopwatch.GetTimestamp"/>; where its frequency is
+    /// low, as with the 10 MHz counter on many Windows machines, the shortest calls are rounded to a tick.
+    /// </remarks>
+    internal static class LatencyBenchmark
+    {
+        private static readonly double[] s_percentiles = { 50, 90, 99, 99.9, 99.99 };
+        private static readonly string[] s_percentileNames = { "p50", "p90", "p99", "p99.9", "p99.99" };
+
+        public static int Run(string[] args)
+        {
+            int[] sizes = { 16, 256, 4 * 1024, 64 * 1024 };
+            int[] threadCounts = { 1, 2, 4, 8, 16, 32, 64 };
+            double seconds = 1;
+            bool encrypt = true, decrypt = true;
+            string? jsonPath = null;
+
+            for (int i = 0; i < args.Length; i++)
+            {
+                string? value = i + 1 < args.Length ? args[i + 1] : null;
+                bool ok = value != null;
+                switch (args[i])
+                {
+                    case "--sizes":
+                        ok = ok && CommandLine.TryParseList(value!, out sizes);
+                        break;
+                    case "--threads":
+                        ok = ok && CommandLine.TryParseList(value!, out threadCounts) && threadCounts.All(n => n > 0);
+                        break;
+                    case "--seconds":
+                        ok = ok && double.TryParse(value, NumberStyles.Float, CultureInfo.InvariantCulture, out seconds) && seconds > 0;
+                        break;
+                    case "--op":
+                        encrypt = value is "encrypt" or "both";
+                        decrypt = value is "decrypt" or "both";
+                        ok = encrypt || decrypt;
+                        break;
+                    case "--json":
+                        jsonPath = value;
+                        break;
+                    default:
+                        ok = false;
+                        break;
+                }
+                if (!ok)
+                {
+                    Console.Error.WriteLine($"latency: bad or incomplete option {args[i]}");
+                    return 2;
+                }
+                i++;
+            }
+
+            var key = RandomNumberGenerator.GetBytes(32);
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(key);
+            var results = BenchmarkResults.Create("latency");
+            results.SecondsPerPoint = seconds;
+            Console.WriteLine($"# backend {System.Security.Cryptography.AesGcmSiv.BackendName}, {seconds:0.##} s per point, latencies in microseconds");
+            Console.WriteLine($"{"op",-8} {"size",8} {"threads",8} {"calls",12} {"p50",9} {"p90",9} {"p99",9} {"p99.9",9} {"p99.99",9} {"max",9}");
+
+            foreach (bool decrypting in new[] { false, true })
+            {
+                if (decrypting ? !decrypt : !encrypt)
+                    continue;
+                foreach (int size in sizes)
+                {
+                    foreach (int threads in threadCounts)
+                    {
+                        LatencyHistogram histogram = Measure(aesGcmSiv, decrypting, size, threads, seconds);
+                        var percentiles = new Dictionary<string, double>();
+                        for (int p = 0; p < s_percentiles.Length; p++)
+                        {
+                            percentiles[s_percentileNames[p]] = histogram.ValueAtPercentile(s_percentiles[p]);
+                        }
+                        percentiles["max"] = histogram.MaxValue;
+                        results.Results.Add(new BenchmarkResult
+                        {
+                            Name = decrypting ? "decrypt" : "encrypt",
+                            Size = size,
+                            Threads = threads,
+                            OpsPerSecond = histogram.TotalCount / seconds,
+                            BytesPerSecond = (double)histogram.TotalCount * size / seconds,
+                            PercentilesNs = percentiles,
+                        });
+                        var line = new System.Text.StringBuilder();
+                        line.Append(CultureInfo.InvariantCulture, $"{(decrypting ? "decrypt" : "encrypt"),-8} {size,8} {threads,8} {histogram.TotalCount,12}");
+                        foreach (double nanoseconds in percentiles.Values)
+                        {
+                            line.Append(CultureInfo.InvariantCulture, $" {nanoseconds / 1000.0,9:F2}");
+                        }
+                        Console.WriteLine(line.ToString());
+                    }
+                }
+            }
+            if (jsonPath != null)
+                results.Write(jsonPath);
+            return 0;
+        }
+
+        private static LatencyHistogram Measure(
+            System.Security.Cryptography.AesGcmSiv aesGcmSiv, bool decrypting, int size, int threadCount, double seconds)
+        {
+            var histograms = new LatencyHistogram[threadCount];
+            var workers = new Thread[threadCount];
+            // 0: warming up, 1: recording, 2: stop
+            int phase = 0;
+            using var started = new CountdownEvent(threadCount);
+            double nanosecondsPerTick = 1e9 / Stopwatch.Frequency;
+
+            for (int t = 0; t < threadCount; t++)
+            {
+                int index = t;
+                workers[t] = new Thread(() =>
+                {
+                    var nonce = new byte[12];
+                    nonce[0] = (byte)index;
+                    nonce[1] = (byte)(index >> 8);
+                    var input = RandomNumberGenerator.GetBytes(size);
+                    var output = new byte[size];
+                    var tag = new byte[16];
+                    if (decrypting)
+                    {
+                        var ciphertext = new byte[size];
+                        aesGcmSiv.Encrypt(nonce, input, ciphertext, tag);
+                        input = ciphertext;
+                    }
+                    var histogram = new LatencyHistogram();
+                    histograms[index] = histogram;
+                    started.Signal();
+
+                    while (Volatile.Read(ref phase) != 2)
+                    {
+                        long begin = Stopwatch.GetTimestamp();
+                        if (decrypting)
+                            aesGcmSiv.Decrypt(nonce, input, tag, output);
+                        else
+                            aesGcmSiv.Encrypt(nonce, input, output, tag);
+                        long end = Stopwatch.GetTimestamp();
+                        if (Volatile.Read(ref phase) == 1)
+                            histogram.Record((long)((end - begin) * nanosecondsPerTick));
+                    }
+                })
+                {
+                    IsBackground = true,
+                    Name = $"latency {index}",
+                };
+                workers[t].Start();
+            }
+
+            started.Wait();
+            Thread.Sleep(TimeSpan.FromSeconds(Math.Min(seconds / 5, 0.2)));
+            Volatile.Write(ref phase, 1);
+            Thread.Sleep(TimeSpan.FromSeconds(seconds));
+            Volatile.Write(ref phase, 2);
+            foreach (Thread worker in workers)
+            {
+                worker.Join();
+            }
+
+            var merged = new LatencyHistogram();
+            foreach (LatencyHistogram histogram in histograms)
+            {
+                merged.Add(histogram);
+            }
+            return merged;
+        }
+    }
+}
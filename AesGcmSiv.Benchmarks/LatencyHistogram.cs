@@ -0,0 +1,92 @@
+using System.Numerics;
+
+namespace AesGcmSiv.Benchmarks
+{
+    /// <summary>
+    /// High dynamic range histogram of latencies in nanoseconds. Values below 2048 are counted
+    /// exactly; each power-of-two range above that is split into 1024 linear buckets, so every
+    /// recorded value is kept to within 0.1% (three significant digits) up to about 68 seconds.
+    /// Recording is a handful of integer operations and never allocates, so one histogram per
+    /// thread can sit inside a timing loop. Not thread safe; merge per-thread histograms with
+    /// <see cref="Add"/>.
+    /// </summary>
+    internal sealed class LatencyHistogram
+    {
+        private const int SubBucketBits = 11;
+        private const int SubBucketCount = 1 << SubBucketBits;
+        private const int SubBucketHalf = SubBucketCount / 2;
+        private const int MaxExponent = 36;  // 2^36 ns, about 68 s; longer values are clamped
+        private const long HighestValue = (1L << MaxExponent) - 1;
+
+        private readonly long[] _counts = new long[SubBucketCount + (MaxExponent - SubBucketBits) * SubBucketHalf];
+        private long _totalCount;
+        private long _maxValue;
+
+        public long TotalCount => _totalCount;
+
+        public long MaxValue => _maxValue;
+
+        public void Record(long value)
+        {
+            value = Math.Clamp(value, 0, HighestValue);
+            _counts[IndexOf(value)]++;
+            _totalCount++;
+            if (value > _maxValue)
+                _maxValue = value;
+        }
+
+        public void Add(LatencyHistogram other)
+        {
+            for (int i = 0; i < _counts.Length; i++)
+            {
+                _counts[i] += other._counts[i];
+            }
+            _totalCount += other._totalCount;
+            _maxValue = Math.Max(_maxValue, other._maxValue);
+        }
+
+        /// <summary>
+        /// Returns the smallest recorded value that at least <paramref name="percentile"/> percent of
+        /// the recorded values are less than or equal to, rounded up to the top of its bucket.
+        /// </summary>
+        public long ValueAtPercentile(double percentile)
+        {
+            if (_totalCount == 0)
+                return 0;
+
+            long rank = Math.Max(1, (long)Math.Ceiling(percentile / 100 * _totalCount));
+            long seen = 0;
+            for (int i = 0; i < _counts.Length; i++)
+            {
+                seen += _counts[i];
+                if (seen >= rank)
+                    return Math.Min(HighestValueIn(i), _maxValue);
+            }
+            return _maxValue;
+        }
+
+        // Values below SubBucketCount map to themselves. Above that, a value
+        // with its top bit at position e is shifted down by e - 10 and lands
+        // in the upper half of a sub-bucket range, one range per exponent.
+        private static int IndexOf(long value)
+        {
+            if (value < SubBucketCount)
+                return (int)value;
+
+            int shift = 63 - BitOperations.LeadingZeroCount((ulong)value) - (SubBucketBits - 1);
+            int subBucket = (int)(value >> shift);
+            return SubBucketCount + (shift - 1) * SubBucketHalf + (subBucket - SubBucketHalf);
+        }
+
+        private static long HighestValueIn(int index)
+        {
+            if (index < SubBucketCount)
+                return index;
+
+            int offset = index - SubBucketCount;
+            int shift = offset / SubBucketHalf + 1;
+            long subBucket = offset % SubBucketHalf + SubBucketHalf;
+            return (subBucket << shift) + (1L << shift) - 1;
+        }
+    }
+}
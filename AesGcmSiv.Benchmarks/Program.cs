@@ -0,0 +1,82 @@
+using BenchmarkDotNet.Jobs;
+using BenchmarkDotNet.Running;
+
+namespace AesGcmSiv.Benchmarks
+{
+    /// <summary>
+    /// Entry point. Every benchmark class in this assembly is offered to the switcher, so
+    /// <c>--filter *</c> runs them all and <c>--filter *Decrypt*</c> picks a subset.
+    /// </summary>
+    /// <remarks>
+    /// <c>--mock &lt;path&gt;</c> runs each benchmark twice, once against the normal native library and
+    /// once against the mock library at <c>path</c> (built from <c>Native/CMakeLists_mock.txt</c>). The
+    /// difference between the two rows is the cost of the cipher work; the mock row alone is the
+    /// interop and managed overhead.
+    /// <para>
+    /// <c>--backends &lt;a,b,...&gt;</c> runs each benchmark once per named backend of the one native
+    /// library, selected through <c>AESGCMSIV_BACKEND</c> (see
+    /// <see cref="System.Security.Cryptography.AesGcmSiv.SelectBackend"/>), for A/B comparisons such
+    /// as <c>--backends vaes-avx512,aesni,mock</c>.
+    /// </para>
+    /// <para>
+    /// <c>latency</c>, <c>scaling</c> or <c>coldstart</c> as the first argument skips BenchmarkDotNet
+    /// and runs <see cref="LatencyBenchmark"/>, <see cref="ScalingBenchmark"/> or
+    /// <see cref="ColdStartBenchmark"/> instead, each with its own options. <c>compare</c> diffs two
+    /// results files; see <see cref="ResultComparer"/>.
+    /// </para>
+    /// </remarks>
+    public static class Program
+    {
+        public static void Main(string[] args)
+        {
+            Func<string[], int>? mode = args.Length == 0 ? null : args[0] switch
+            {
+                "latency" => LatencyBenchmark.Run,
+                "scaling" => ScalingBenchmark.Run,
+                "coldstart" => ColdStartBenchmark.Run,
+                "compare" => ResultComparer.Run,
+                _ => null,
+            };
+            if (mode != null)
+            {
+                Environment.Exit(mode(args.Skip(1).ToArray()));
+            }
+
+            var config = new BenchmarkConfig();
+            int mock = Array.IndexOf(args, "--mock");
+            if (mock >= 0)
+            {
+                if (mock + 1 >= args.Length)
+                {
+                    Console.Error.WriteLine("--mock needs the path of the mock native library.");
+                    Environment.Exit(2);
+                }
+                string path = Path.GetFullPath(args[mock + 1]);
+                config.AddJob(Job.Default.WithId("Native"));
+                config.AddJob(Job.Default
+                    .WithEnvironmentVariables(new EnvironmentVariable("AESGCMSIV_NATIVE_LIBRARY", path))
+                    .WithId("Mock"));
+                args = args.Take(mock).Concat(args.Skip(mock + 2)).ToArray();
+            }
+
+            int backends = Array.IndexOf(args, "--backends");
+            if (backends >= 0)
+            {
+                if (backends + 1 >= args.Length)
+                {
+                    Console.Error.WriteLine("--backends needs a comma-separated list of backend names.");
+                    Environment.Exit(2);
+                }
+                foreach (string name in args[backends + 1].Split(',', StringSplitOptions.RemoveEmptyEntries | StringSplitOptions.TrimEntries))
+                {
+                    config.AddJob(Job.Default
+                        .WithEnvironmentVariables(new EnvironmentVariable("AESGCMSIV_BACKEND", name))
+                        .WithId(name));
+                }
+                args = args.Take(backends).Concat(args.Skip(backends + 2)).ToArray();
+            }
+
+            BenchmarkSwitcher.FromAssembly(typeof(Program).Assembly).Run(args, config);
+        }
+    }
+}
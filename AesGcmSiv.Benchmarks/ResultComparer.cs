@@ -0,0 +1,146 @@
+using System.Globalization;
+
+namespace AesGcmSiv.Benchmarks
+{
+    /// <summary>
+    /// The <c>compare</c> mode: diffs two <see cref="BenchmarkResults"/> files and flags every metric that got
+    /// worse by more than the noise threshold.
+    /// </summary>
+    /// <remarks>
+    /// <c>compare baseline.json candidate.json [--threshold 5] [--tail-threshold 10]</c>. Results are
+    /// matched by <see cref="BenchmarkResult.Key"/>. Throughput regresses when it falls and cycles per
+    /// byte when it rises, each by more than <c>--threshold</c> percent; latency percentiles regress when
+    /// they rise by more than <c>--tail-threshold</c> percent, since tails are noisier than means. The
+    /// maximum and minimum are shown but never flagged. The exit code is 1 when anything regressed, so a
+    /// script can gate on it.
+    /// </remarks>
+    internal static class ResultComparer
+    {
+        public static int Run(string[] args)
+        {
+            var files = new List<string>();
+            double threshold = 5;
+            double tailThreshold = 10;
+            for (int i = 0; i < args.Length; i++)
+            {
+                if (!args[i].StartsWith("--", StringComparison.Ordinal))
+                {
+                    files.Add(args[i]);
+                    continue;
+                }
+                string? value = i + 1 < args.Length ? args[i + 1] : null;
+                bool ok = args[i] switch
+                {
+                    "--threshold" => double.TryParse(value, NumberStyles.Float, CultureInfo.InvariantCulture, out threshold) && threshold >= 0,
+                    "--tail-threshold" => double.TryParse(value, NumberStyles.Float, CultureInfo.InvariantCulture, out tailThreshold) && tailThreshold >= 0,
+                    _ => false,
+                };
+                if (!ok)
+                {
+                    Console.Error.WriteLine($"compare: bad or incomplete option {args[i]}");
+                    return 2;
+                }
+                i++;
+            }
+            if (files.Count != 2)
+            {
+                Console.Error.WriteLine("compare: expected a baseline and a candidate results file");
+                return 2;
+            }
+
+            BenchmarkResults baseline, candidate;
+            try
+            {
+                baseline = BenchmarkResults.Read(files[0]);
+                candidate = BenchmarkResults.Read(files[1]);
+            }
+            catch (Exception e) when (e is IOException or InvalidDataException or UnauthorizedAccessException)
+            {
+                Console.Error.WriteLine($"compare: {e.Message}");
+                return 2;
+            }
+
+            Console.WriteLine($"baseline:  {Describe(baseline)}");
+            Console.WriteLine($"candidate: {Describe(candidate)}");
+            if (baseline.Suite != candidate.Suite)
+            {
+                Console.WriteLine($"warning: comparing suite {baseline.Suite} with {candidate.Suite}");
+            }
+            Console.WriteLine(string.Create(CultureInfo.InvariantCulture,
+                $"thresholds: {threshold:0.##}% for throughput and cycles/byte, {tailThreshold:0.##}% for percentiles"));
+            Console.WriteLine();
+
+            var candidates = new Dictionary<string, BenchmarkResult>();
+            foreach (BenchmarkResult result in candidate.Results)
+            {
+                candidates[result.Key] = result;
+            }
+
+            int regressions = 0, improvements = 0, compared = 0, missing = 0;
+            Console.WriteLine($"{"",-10} {"result",-48} {"metric",-16} {"baseline",14} {"candidate",14} {"change",9}");
+            foreach (BenchmarkResult before in baseline.Results)
+            {
+                if (!candidates.Remove(before.Key, out BenchmarkResult? after))
+                {
+                    Console.WriteLine($"missing    {before.Key}");
+                    missing++;
+                    continue;
+                }
+
+                var metrics = new List<(string Name, double? Before, double? After, bool HigherIsBetter, double? Threshold)>
+                {
+                    ("ops/s", before.OpsPerSecond, after.OpsPerSecond, true, threshold),
+                    ("cycles/byte", before.CyclesPerByte, after.CyclesPerByte, false, threshold),
+                };
+                if (before.OpsPerSecond == null)
+                    metrics.Add(("bytes/s", before.BytesPerSecond, after.BytesPerSecond, true, threshold));
+                foreach (var (name, value) in before.PercentilesNs ?? new Dictionary<string, double>())
+                {
+                    double? other = after.PercentilesNs != null && after.PercentilesNs.TryGetValue(name, out double v) ? v : null;
+                    bool flagged = name.StartsWith('p');
+                    metrics.Add((name + " ns", value, other, false, flagged ? tailThreshold : null));
+                }
+
+                foreach (var (name, valueBefore, valueAfter, higherIsBetter, limit) in metrics)
+                {
+                    if (valueBefore is not double b || valueAfter is not double a || b <= 0)
+                        continue;
+                    compared++;
+                    double change = (a - b) / b * 100;
+                    double worse = higherIsBetter ? -change : change;
+                    string verdict = "";
+                    if (limit is double l && worse > l)
+                    {
+                        verdict = "REGRESSED";
+                        regressions++;
+                    }
+                    else if (limit is double m && -worse > m)
+                    {
+                        verdict = "improved";
+                        improvements++;
+                    }
+                    if (verdict.Length > 0)
+                    {
+                        Console.WriteLine(string.Create(CultureInfo.InvariantCulture,
+                            $"{verdict,-10} {before.Key,-48} {name,-16} {b,14:G6} {a,14:G6} {change,8:+0.0;-0.0}%"));
+                    }
+                }
+            }
+            foreach (string key in candidates.Keys)
+            {
+                Console.WriteLine($"new        {key}");
+            }
+
+            Console.WriteLine();
+            Console.WriteLine($"{compared} metrics compared: {regressions} regressed, {improvements} improved, " +
+                $"{missing} results missing from the candidate, {candidates.Count} new");
+            return regressions > 0 ? 1 : 0;
+        }
+
+        private static string Describe(BenchmarkResults results)
+        {
+            MachineInfo machine = results.Machine;
+            return $"{results.Suite} on {machine.Cpu} ({machine.Os}-{machine.Arch}, {machine.LogicalProcessors} logical processors), backend {results.Backend.Name}";
+        }
+    }
+}
@@ -0,0 +1,225 @@
+using System.Diagnostics;
+using System.Globalization;
+using System.Security.Cryptography;
+
+namespace AesGcmSiv.Benchmarks
+{
+    /// <summary>
+    /// Throughput against thread count, with every thread sharing one key and instance and again with
+    /// a private key and instance per thread. The two curves separate contention inside the library,
+    /// which only the shared case pays for, from limits both cases hit, such as memory bandwidth or
+    /// too few cores. A shared/private ratio that falls as threads are added is contention on the
+    /// shared context.
+    /// </summary>
+    /// <remarks>
+    /// Options: <c>--sizes 16,1024</c>, <c>--threads 1,2,4</c> (default 1, 2, 4, ... up to the
+    /// processor count), <c>--seconds 1</c>, <c>--op encrypt|decrypt</c> and <c>--csv</c>, which
+    /// prints one row per point for plotting instead of the table, and <c>--json path</c>, which also
+    /// writes the results as <see cref="BenchmarkResults"/>. Each call runs on one thread
+    /// (<see cref="System.Security.Cryptography.AesGcmSiv.MaxDegreeOfParallelism"/> is 1), so the
+    /// threads are the only parallelism.
+    /// </remarks>
+    internal static class ScalingBenchmark
+    {
+        public static int Run(string[] args)
+        {
+            int[] sizes = { 16, 1024 };
+            int[] threadCounts = CommandLine.DefaultThreadCounts();
+            double seconds = 1;
+            bool decrypting = false;
+            bool csv = false;
+            string? jsonPath = null;
+
+            for (int i = 0; i < args.Length; i++)
+            {
+                if (args[i] == "--csv")
+                {
+                    csv = true;
+                    continue;
+                }
+                string? value = i + 1 < args.Length ? args[i + 1] : null;
+                bool ok = value != null;
+                switch (args[i])
+                {
+                    case "--sizes":
+                        ok = ok && CommandLine.TryParseList(value!, out sizes);
+                        break;
+                    case "--threads":
+                        ok = ok && CommandLine.TryParseList(value!, out threadCounts) && threadCounts.All(n => n > 0);
+                        break;
+                    case "--seconds":
+                        ok = ok && double.TryParse(value, NumberStyles.Float, CultureInfo.InvariantCulture, out seconds) && seconds > 0;
+                        break;
+                    case "--op":
+                        decrypting = value == "decrypt";
+                        ok = decrypting || value == "encrypt";
+                        break;
+                    case "--json":
+                        jsonPath = value;
+                        break;
+                    default:
+                        ok = false;
+                        break;
+                }
+                if (!ok)
+                {
+                    Console.Error.WriteLine($"scaling: bad or incomplete option {args[i]}");
+                    return 2;
+                }
+                i++;
+            }
+
+            string op = decrypting ? "decrypt" : "encrypt";
+            var results = BenchmarkResults.Create("scaling");
+            results.SecondsPerPoint = seconds;
+            if (csv)
+            {
+                Console.WriteLine("op,keys,size,threads,ops_per_second");
+            }
+            else
+            {
+                Console.WriteLine($"# backend {System.Security.Cryptography.AesGcmSiv.BackendName}, {Environment.ProcessorCount} processors, {op}, {seconds:0.##} s per point");
+                Console.WriteLine("# speedup is against one thread with the same keys; shared/private compares the two at the same thread count");
+            }
+
+            foreach (int size in sizes)
+            {
+                if (!csv)
+                {
+                    Console.WriteLine();
+                    Console.WriteLine($"{"size",8} {"threads",8} {"shared ops/s",14} {"speedup",8} {"private ops/s",14} {"speedup",8} {"shared/private",15}");
+                }
+                double sharedBase = 0, privateBase = 0;
+                foreach (int threads in threadCounts)
+                {
+                    double shared = Measure(sharedKey: true, decrypting, size, threads, seconds);
+                    double own = Measure(sharedKey: false, decrypting, size, threads, seconds);
+                    foreach (var (keys, opsPerSecond) in new[] { ("shared", shared), ("private", own) })
+                    {
+                        results.Results.Add(new BenchmarkResult
+                        {
+                            Name = op,
+                            Variant = keys,
+                            Size = size,
+                            Threads = threads,
+                            OpsPerSecond = opsPerSecond,
+                            BytesPerSecond = opsPerSecond * size,
+                        });
+                    }
+                    if (sharedBase == 0)
+                    {
+                        // Speedups are relative to the first thread count listed, normally 1
+                        sharedBase = shared / threads;
+                        privateBase = own / threads;
+                    }
+
+                    if (csv)
+                    {
+                        Console.WriteLine(string.Create(CultureInfo.InvariantCulture, $"{op},shared,{size},{threads},{shared:F0}"));
+                        Console.WriteLine(string.Create(CultureInfo.InvariantCulture, $"{op},private,{size},{threads},{own:F0}"));
+                    }
+                    else
+                    {
+                        Console.WriteLine(string.Create(CultureInfo.InvariantCulture,
+                            $"{size,8} {threads,8} {shared,14:F0} {shared / sharedBase,8:F2} {own,14:F0} {own / privateBase,8:F2} {shared / own,15:F2}"));
+                    }
+                }
+            }
+            if (jsonPath != null)
+                results.Write(jsonPath);
+            return 0;
+        }
+
+        /// <summary>
+        /// Runs <paramref name="threadCount"/> threads for the given time and returns calls per second
+        /// summed over all of them.
+        /// </summary>
+        private static double Measure(bool sharedKey, bool decrypting, int size, int threadCount, double seconds)
+        {
+            var instances = new System.Security.Cryptography.AesGcmSiv[sharedKey ? 1 : threadCount];
+            for (int i = 0; i < instances.Length; i++)
+            {
+                instances[i] = new System.Security.Cryptography.AesGcmSiv(RandomNumberGenerator.GetBytes(32))
+                {
+                    MaxDegreeOfParallelism = 1,
+                };
+            }
+
+            var counts = new long[threadCount];
+            var workers = new Thread[threadCount];
+            // 0: warming up, 1: counting, 2: stop
+            int phase = 0;
+            using var started = new CountdownEvent(threadCount);
+            try
+            {
+                for (int t = 0; t < threadCount; t++)
+                {
+                    int index = t;
+                    var aesGcmSiv = instances[sharedKey ? 0 : index];
+                    workers[t] = new Thread(() =>
+                    {
+                        var nonce = new byte[12];
+                        nonce[0] = (byte)index;
+                        nonce[1] = (byte)(index >> 8);
+                        var input = RandomNumberGenerator.GetBytes(size);
+                        var output = new byte[size];
+                        var tag = new byte[16];
+                        if (decrypting)
+                        {
+                            var ciphertext = new byte[size];
+                            aesGcmSiv.Encrypt(nonce, input, ciphertext, tag);
+                            input = ciphertext;
+                        }
+                        started.Signal();
+
+                        while (Volatile.Read(ref phase) == 0)
+                        {
+                            Call(aesGcmSiv, decrypting, nonce, input, output, tag);
+                        }
+                        long calls = 0;
+                        while (Volatile.Read(ref phase) == 1)
+                        {
+                            Call(aesGcmSiv, decrypting, nonce, input, output, tag);
+                            calls++;
+                        }
+                        counts[index] = calls;
+                    })
+                    {
+                        IsBackground = true,
+                        Name = $"scaling {index}",
+                    };
+                    workers[t].Start();
+                }
+
+                started.Wait();
+                Thread.Sleep(TimeSpan.FromSeconds(Math.Min(seconds / 5, 0.2)));
+                long begin = Stopwatch.GetTimestamp();
+                Volatile.Write(ref phase, 1);
+                Thread.Sleep(TimeSpan.FromSeconds(seconds));
+                Volatile.Write(ref phase, 2);
+                double elapsed = Stopwatch.GetElapsedTime(begin).TotalSeconds;
+                foreach (Thread worker in workers)
+                {
+                    worker.Join();
+                }
+                return counts.Sum() / elapsed;
+            }
+            finally
+            {
+                foreach (var instance in instances)
+                {
+                    instance.Dispose();
+                }
+            }
+        }
+
+        private static void Call(System.Security.Cryptography.AesGcmSiv aesGcmSiv, bool decrypting,
+            byte[] nonce, byte[] input, byte[] output, byte[] tag)
+        {
+            if (decrypting)
+                aesGcmSiv.Decrypt(nonce, input, tag, output);
+            else
+                aesGcmSiv.Encrypt(nonce, input, output, tag);
+        }
+    }
+}
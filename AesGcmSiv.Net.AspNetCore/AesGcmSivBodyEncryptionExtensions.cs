@@ -0,0 +1,35 @@
+using System.Security.Cryptography;
+using Microsoft.AspNetCore.BodyEncryption;
+
+namespace Microsoft.AspNetCore.Builder
+{
+    /// <summary>
+    /// Adds <see cref="AesGcmSivBodyEncryptionMiddleware"/> to an application's pipeline.
+    /// </summary>
+    public static class AesGcmSivBodyEncryptionExtensions
+    {
+        /// <summary>
+        /// Decrypts request bodies and encrypts response bodies under <paramref name="key"/> for
+        /// everything later in the pipeline.
+        /// </summary>
+        /// <param name="app">The application builder.</param>
+        /// <param name="key">The key to use. Must stay undisposed while the application runs.</param>
+        /// <param name="configure">Optionally adjusts the other settings.</param>
+        /// <returns><paramref name="app"/>, for chaining.</returns>
+        /// <remarks>
+        /// Add it before the middleware whose bodies it should cover. Add it before response compression
+        /// too, so that the plaintext is compressed and the compressed body encrypted: ciphertext does
+        /// not compress.
+        /// </remarks>
+        /// <exception cref="ArgumentNullException"><paramref name="app"/> or <paramref name="key"/> is null.</exception>
+        public static IApplicationBuilder UseAesGcmSivBodyEncryption(
+            this IApplicationBuilder app, AesGcmSiv key, Action<AesGcmSivBodyEncryptionOptions>? configure = null)
+        {
+            ArgumentNullException.ThrowIfNull(app);
+            ArgumentNullException.ThrowIfNull(key);
+            var options = new AesGcmSivBodyEncryptionOptions { Key = key };
+            configure?.Invoke(options);
+            return app.UseMiddleware<AesGcmSivBodyEncryptionMiddleware>(options);
+        }
+    }
+}
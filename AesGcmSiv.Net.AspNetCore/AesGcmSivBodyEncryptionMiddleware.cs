@@ -0,0 +1,190 @@
+using System.IO.Pipelines;
+using System.Security.Cryptography;
+using Microsoft.AspNetCore.Http;
+using Microsoft.AspNetCore.Http.Features;
+using Microsoft.Extensions.Primitives;
+using Microsoft.Net.Http.Headers;
+
+namespace Microsoft.AspNetCore.BodyEncryption
+{
+    /// <summary>
+    /// Decrypts request bodies and encrypts response bodies in the chunked format of
+    /// <see cref="AesGcmSivStream"/>, marked by the content coding
+    /// <see cref="AesGcmSivBodyEncryptionOptions.EncodingName"/>.
+    /// </summary>
+    /// <remarks>
+    /// A request whose <c>Content-Encoding</c> is the coding is decrypted as the application reads it,
+    /// with <see cref="AesGcmSivPipe.DecryptAsync"/> between the server's <see cref="PipeReader"/> and
+    /// the one the application sees; each chunk reaches the application once its tag verifies. A body
+    /// that does not authenticate fails the application's read with a
+    /// <see cref="BadHttpRequestException"/> for status 400.
+    ///
+    /// A response is encrypted as the application writes it, and each chunk is sent as soon as it
+    /// fills, so the first chunk leaves before the rest of the response exists. Chunks are sealed
+    /// straight into the server's <see cref="PipeWriter"/>, from memory the pipes rent from their pool,
+    /// with no copy of the body held. Responses whose <c>Content-Length</c> reaches
+    /// <see cref="AesGcmSivBodyEncryptionOptions.ParallelThreshold"/> are sealed several chunks at a
+    /// time on the native worker pool instead. The <c>Content-Length</c> header is removed, since the
+    /// encrypted length differs. Responses to <c>HEAD</c> requests, and those with statuses that carry no
+    /// body, are left alone.
+    /// </remarks>
+    public sealed class AesGcmSivBodyEncryptionMiddleware
+    {
+        private readonly RequestDelegate _next;
+        private readonly AesGcmSivBodyEncryptionOptions _options;
+
+        /// <summary>
+        /// Initializes the middleware.
+        /// </summary>
+        /// <param name="next">The rest of the pipeline.</param>
+        /// <param name="options">The settings, which are not copied and must not change afterwards.</param>
+        /// <exception cref="ArgumentNullException"><paramref name="next"/> or <paramref name="options"/> is null.</exception>
+        /// <exception cref="ArgumentException">
+        /// <see cref="AesGcmSivBodyEncryptionOptions.Key"/> is not set, or
+        /// <see cref="AesGcmSivBodyEncryptionOptions.EncodingName"/> is empty.
+        /// </exception>
+        /// <exception cref="ArgumentOutOfRangeException">The chunk size or parallel chunk count is out of range.</exception>
+        public AesGcmSivBodyEncryptionMiddleware(RequestDelegate next, AesGcmSivBodyEncryptionOptions options)
+        {
+            ArgumentNullException.ThrowIfNull(next);
+            ArgumentNullException.ThrowIfNull(options);
+            if (options.Key == null)
+                throw new ArgumentException("A key must be set.", nameof(options));
+            if (string.IsNullOrEmpty(options.EncodingName))
+                throw new ArgumentException("The encoding name must not be empty.", nameof(options));
+            ArgumentOutOfRangeException.ThrowIfNegativeOrZero(options.ChunkSize, nameof(options.ChunkSize));
+            ArgumentOutOfRangeException.ThrowIfGreaterThan(options.ChunkSize, AesGcmSivStream.MaxChunkSize, nameof(options.ChunkSize));
+            ArgumentOutOfRangeException.ThrowIfNegativeOrZero(options.ParallelChunks, nameof(options.ParallelChunks));
+            ArgumentOutOfRangeException.ThrowIfGreaterThan(options.ParallelChunks, 256, nameof(options.ParallelChunks));
+
+            _next = next;
+            _options = options;
+        }
+
+        /// <summary>
+        /// Runs the rest of the pipeline with the bodies of the request and its response replaced.
+        /// </summary>
+        /// <param name="context">The request.</param>
+        public async Task InvokeAsync(HttpContext context)
+        {
+            ArgumentNullException.ThrowIfNull(context);
+
+            RequestBody? request = DecryptsRequest(context.Request) ? new RequestBody(context, _options) : null;
+            AesGcmSivResponseBodyFeature? response = null;
+            IHttpResponseBodyFeature? serverResponse = null;
+            if (EncryptsResponse(context.Request))
+            {
+                serverResponse = context.Features.Get<IHttpResponseBodyFeature>()!;
+                response = new AesGcmSivResponseBodyFeature(context, serverResponse, _options);
+                context.Features.Set<IHttpResponseBodyFeature>(response);
+            }
+
+            try
+            {
+                await _next(context);
+                if (response != null)
+                    await response.CompleteAsync();
+            }
+            finally
+            {
+                if (response != null)
+                {
+                    context.Features.Set(serverResponse);
+                    await response.AbortAsync();
+                }
+                if (request != null)
+                    await request.DisposeAsync();
+            }
+        }
+
+        private bool DecryptsRequest(HttpRequest request) =>
+            string.Equals(request.Headers.ContentEncoding, _options.EncodingName, StringComparison.OrdinalIgnoreCase);
+
+        private bool EncryptsResponse(HttpRequest request)
+        {
+            if (HttpMethods.IsHead(request.Method))
+                return false;
+            if (_options.EncryptAllResponses)
+                return true;
+            if (!StringWithQualityHeaderValue.TryParseList(request.Headers.AcceptEncoding, out IList<StringWithQualityHeaderValue>? accepted))
+                return false;
+            foreach (StringWithQualityHeaderValue coding in accepted)
+            {
+                if (StringSegment.Equals(coding.Value, _options.EncodingName, StringComparison.OrdinalIgnoreCase) &&
+                    coding.Quality != 0)
+                    return true;
+            }
+            return false;
+        }
+
+        // The decrypted request body, and the pump that fills it from the
+        // server's reader
+        private sealed class RequestBody : IRequestBodyPipeFeature, IAsyncDisposable
+        {
+            private readonly HttpContext _context;
+            private readonly Stream _serverBody;
+            private readonly IRequestBodyPipeFeature? _serverPipe;
+            private readonly long? _serverLength;
+            private readonly StringValues _serverEncoding;
+            private readonly Pipe _pipe = new(new PipeOptions(useSynchronizationContext: false));
+            private readonly Task _pump;
+
+            internal RequestBody(HttpContext context, AesGcmSivBodyEncryptionOptions options)
+            {
+                HttpRequest request = context.Request;
+                _context = context;
+                _serverBody = request.Body;
+                _serverPipe = context.Features.Get<IRequestBodyPipeFeature>();
+                _serverLength = request.ContentLength;
+                _serverEncoding = request.Headers.ContentEncoding;
+
+                _pump = DecryptAsync(request.BodyReader, options.Key!, context.RequestAborted);
+                request.Body = _pipe.Reader.AsStream(leaveOpen: true);
+                context.Features.Set<IRequestBodyPipeFeature>(this);
+                request.ContentLength = null;
+                request.Headers.ContentEncoding = StringValues.Empty;
+            }
+
+            public PipeReader Reader => _pipe.Reader;
+
+            public async ValueTask DisposeAsync()
+            {
+                // Ends the pump if the application stopped reading early
+                await _pipe.Reader.CompleteAsync();
+                try
+                {
+                    await _pump;
+                }
+                catch
+                {
+                    // Already reported to the application's read, if it read
+                }
+
+                HttpRequest request = _context.Request;
+                request.Body = _serverBody;
+                _context.Features.Set(_serverPipe);
+                request.ContentLength = _serverLength;
+                request.Headers.ContentEncoding = _serverEncoding;
+            }
+
+            private async Task DecryptAsync(PipeReader source, AesGcmSiv key, CancellationToken cancellationToken)
+            {
+                PipeWriter destination = _pipe.Writer;
+                Exception? error = null;
+                try
+                {
+                    await AesGcmSivPipe.DecryptAsync(source, destination, key, cancellationToken: cancellationToken);
+                }
+                catch (CryptographicException e)
+                {
+                    error = new BadHttpRequestException("The request body does not decrypt.", StatusCodes.Status400BadRequest, e);
+                }
+                catch (Exception e)
+                {
+                    error = e;
+                }
+                await destination.CompleteAsync(error);
+            }
+        }
+    }
+}
@@ -0,0 +1,53 @@
+using System.Security.Cryptography;
+
+namespace Microsoft.AspNetCore.BodyEncryption
+{
+    /// <summary>
+    /// Settings for <see cref="AesGcmSivBodyEncryptionMiddleware"/>.
+    /// </summary>
+    public sealed class AesGcmSivBodyEncryptionOptions
+    {
+        /// <summary>The content coding that marks an encrypted body, unless <see cref="EncodingName"/> is changed.</summary>
+        public const string DefaultEncodingName = "aesgcmsiv";
+
+        /// <summary>
+        /// Gets or sets the key bodies are encrypted and decrypted with. Must be set, and must stay
+        /// undisposed while the middleware runs.
+        /// </summary>
+        public AesGcmSiv? Key { get; set; }
+
+        /// <summary>
+        /// Gets or sets the content coding that marks an encrypted body: in <c>Content-Encoding</c> on
+        /// requests and responses, and in <c>Accept-Encoding</c> on requests that accept an encrypted
+        /// response.
+        /// </summary>
+        public string EncodingName { get; set; } = DefaultEncodingName;
+
+        /// <summary>
+        /// Gets or sets the plaintext bytes per chunk of an encrypted response, from 1 to
+        /// <see cref="AesGcmSivStream.MaxChunkSize"/>. Each chunk is sent as soon as it fills, so smaller
+        /// chunks reach the client sooner. Request bodies carry their own chunk size, which must fit in
+        /// the server's request buffer.
+        /// </summary>
+        public int ChunkSize { get; set; } = AesGcmSivStream.DefaultChunkSize;
+
+        /// <summary>
+        /// Gets or sets whether every response is encrypted, rather than only those to requests whose
+        /// <c>Accept-Encoding</c> names <see cref="EncodingName"/>.
+        /// </summary>
+        public bool EncryptAllResponses { get; set; }
+
+        /// <summary>
+        /// Gets or sets the <c>Content-Length</c> from which a response is sealed
+        /// <see cref="ParallelChunks"/> chunks at a time on the native worker pool. Responses of unknown
+        /// length are sealed a chunk at a time.
+        /// </summary>
+        public long ParallelThreshold { get; set; } = 1024 * 1024;
+
+        /// <summary>
+        /// Gets or sets how many chunks of a large response are sealed at once, as
+        /// <see cref="AesGcmSivStream.ParallelChunks"/>. 1 turns parallel sealing off.
+        /// </summary>
+        public int ParallelChunks { get; set; } = 8;
+    }
+}
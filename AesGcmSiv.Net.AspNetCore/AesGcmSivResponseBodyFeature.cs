@@ -0,0 +1,160 @@
+using System.IO.Pipelines;
+using System.Security.Cryptography;
+using Microsoft.AspNetCore.Http;
+using Microsoft.AspNetCore.Http.Features;
+using Microsoft.Net.Http.Headers;
+
+namespace Microsoft.AspNetCore.BodyEncryption
+{
+    /// <summary>
+    /// The response body the application writes while <see cref="AesGcmSivBodyEncryptionMiddleware"/>
+    /// runs. What is written goes through a pipe to a pump that encrypts it into the server's body.
+    /// </summary>
+    /// <remarks>
+    /// The pump starts on the first access to <see cref="Writer"/> or <see cref="Stream"/>, and waits
+    /// for the first write, or the end, before starting the response, so headers set before then still
+    /// count. Whether to encrypt is decided as the response starts, from its status.
+    /// </remarks>
+    internal sealed class AesGcmSivResponseBodyFeature : IHttpResponseBodyFeature
+    {
+        private readonly HttpContext _context;
+        private readonly IHttpResponseBodyFeature _server;
+        private readonly AesGcmSivBodyEncryptionOptions _options;
+        private readonly Pipe _pipe;
+        private Task? _pump;
+        private Stream? _stream;
+        private bool _encrypt;
+        private long? _plaintextLength;
+        private bool _completed;
+        private bool _abandoned;
+
+        internal AesGcmSivResponseBodyFeature(
+            HttpContext context, IHttpResponseBodyFeature server, AesGcmSivBodyEncryptionOptions options)
+        {
+            _context = context;
+            _server = server;
+            _options = options;
+            // The pump seals a chunk only once a byte past it has arrived, so
+            // the pipe must hold a whole chunk without pausing the writer
+            long chunk = options.ChunkSize + 1L;
+            _pipe = new Pipe(new PipeOptions(
+                pauseWriterThreshold: Math.Max(2 * chunk, 65536),
+                resumeWriterThreshold: Math.Max(chunk, 32768),
+                useSynchronizationContext: false));
+            context.Response.OnStarting(static state => ((AesGcmSivResponseBodyFeature)state).OnStarting(), this);
+        }
+
+        public Stream Stream => _stream ??= Writer.AsStream(leaveOpen: true);
+
+        public PipeWriter Writer
+        {
+            get
+            {
+                _pump ??= PumpAsync();
+                return _pipe.Writer;
+            }
+        }
+
+        public void DisableBuffering() => _server.DisableBuffering();
+
+        public Task StartAsync(CancellationToken cancellationToken = default) => _server.StartAsync(cancellationToken);
+
+        public Task SendFileAsync(string path, long offset, long? count, CancellationToken cancellationToken = default) =>
+            SendFileFallback.SendFileAsync(Stream, path, offset, count, cancellationToken);
+
+        /// <summary>
+        /// Ends the body, waits for its last chunk to be written, and completes the server's body.
+        /// A response whose body was never touched is still encrypted, as an empty stream.
+        /// </summary>
+        public async Task CompleteAsync()
+        {
+            if (_completed)
+                return;
+            _completed = true;
+            PipeWriter writer = Writer;
+            await writer.CompleteAsync();
+            await _pump!;
+            await _server.CompleteAsync();
+        }
+
+        // Stops the pump after the application failed, leaving the server's
+        // body to whoever handles the failure
+        internal async Task AbortAsync()
+        {
+            if (_completed)
+                return;
+            _completed = true;
+            _abandoned = true;
+            if (_pump == null)
+                return;
+            await _pipe.Writer.CompleteAsync(new OperationCanceledException("The response was abandoned."));
+            try
+            {
+                await _pump;
+            }
+            catch
+            {
+                // The application's failure is the one that matters
+            }
+        }
+
+        private Task OnStarting()
+        {
+            // An error response written after the application failed is not ours
+            HttpResponse response = _context.Response;
+            _encrypt = !_abandoned && CarriesBody(response.StatusCode);
+            if (!_encrypt)
+                return Task.CompletedTask;
+
+            _plaintextLength = response.ContentLength;
+            response.ContentLength = null;
+            response.Headers.Append(HeaderNames.ContentEncoding, _options.EncodingName);
+            if (!_options.EncryptAllResponses)
+                response.Headers.Append(HeaderNames.Vary, HeaderNames.AcceptEncoding);
+            return Task.CompletedTask;
+        }
+
+        private static bool CarriesBody(int statusCode) =>
+            statusCode >= 200 && statusCode != StatusCodes.Status204NoContent && statusCode != StatusCodes.Status304NotModified;
+
+        private async Task PumpAsync()
+        {
+            PipeReader reader = _pipe.Reader;
+            try
+            {
+                // The application's first write, or its end, comes before the
+                // response starts
+                CancellationToken cancellationToken = _context.RequestAborted;
+                ReadResult first = await reader.ReadAsync(cancellationToken);
+                reader.AdvanceTo(first.Buffer.Start);
+                await _server.StartAsync(cancellationToken);
+
+                AesGcmSiv key = _options.Key!;
+                if (!_encrypt)
+                {
+                    await reader.CopyToAsync(_server.Writer, cancellationToken);
+                }
+                else if (_options.ParallelChunks > 1 && _plaintextLength >= _options.ParallelThreshold)
+                {
+                    await using var encryptor = new AesGcmSivStream(
+                        _server.Stream, key, CryptoStreamMode.Write, _options.ChunkSize, leaveOpen: true)
+                    {
+                        ParallelChunks = _options.ParallelChunks,
+                    };
+                    await reader.CopyToAsync(encryptor, cancellationToken);
+                    await encryptor.FlushFinalChunkAsync(cancellationToken);
+                }
+                else
+                {
+                    await AesGcmSivPipe.EncryptAsync(reader, _server.Writer, key, _options.ChunkSize, cancellationToken: cancellationToken);
+                }
+                await reader.CompleteAsync();
+            }
+            catch (Exception e)
+            {
+                await reader.CompleteAsync(e);
+                throw;
+            }
+        }
+    }
+}
@@ -0,0 +1,100 @@
+using System.Security.Cryptography;
+
+namespace Microsoft.AspNetCore.DataProtection.AuthenticatedEncryption
+{
+    /// <summary>
+    /// An <see cref="IAuthenticatedEncryptor"/> that protects payloads with AES-GCM-SIV under a Data
+    /// Protection master key.
+    /// </summary>
+    /// <remarks>
+    /// A payload is laid out as nonce || ciphertext || tag, as <see cref="AesGcmSiv.SealWithRandomNonce(ReadOnlySpan{byte}, Span{byte}, ReadOnlySpan{byte})"/>
+    /// writes it, with the additional authenticated data Data Protection supplies bound into the tag.
+    /// That is one pass over the data, against two for AES-CBC with HMAC, and 28 bytes of overhead.
+    ///
+    /// The master key is expanded once, when the encryptor is created, and the encryptor is kept for
+    /// the life of the key ring, so a payload costs no key setup. Unlike the built-in AES-GCM
+    /// encryptor no subkey is derived per payload: AES-GCM-SIV with random nonces stays safe for far
+    /// more messages under one key, and a repeated nonce reveals only whether two payloads were
+    /// identical. Payloads of a few hundred bytes, such as cookies and antiforgery tokens, run in
+    /// managed code as <see cref="AesGcmSivImplementation.Auto"/> chooses. One instance can be shared
+    /// across threads.
+    /// </remarks>
+    public sealed class AesGcmSivAuthenticatedEncryptor : IAuthenticatedEncryptor, IDisposable
+    {
+        private const int NonceSize = 12;
+        private const int TagSize = 16;
+
+        private readonly AesGcmSiv _cipher;
+
+        /// <summary>
+        /// Initializes an encryptor for a master key.
+        /// </summary>
+        /// <param name="masterKey">The master key. Must be exactly 16 or 32 bytes.</param>
+        /// <exception cref="ArgumentNullException"><paramref name="masterKey"/> is null.</exception>
+        /// <exception cref="ArgumentException"><paramref name="masterKey"/> is not 16 or 32 bytes.</exception>
+        /// <exception cref="CryptographicException">The key could not be set up.</exception>
+        public AesGcmSivAuthenticatedEncryptor(ISecret masterKey)
+        {
+            ArgumentNullException.ThrowIfNull(masterKey);
+            if (masterKey.Length != 16 && masterKey.Length != 32)
+                throw new ArgumentException("Master key must be exactly 16 bytes (128 bits) or 32 bytes (256 bits).", nameof(masterKey));
+
+            byte[] key = new byte[masterKey.Length];
+            try
+            {
+                masterKey.WriteSecretIntoBuffer(new ArraySegment<byte>(key));
+                _cipher = new AesGcmSiv(key, AesGcmSivImplementation.Auto);
+            }
+            finally
+            {
+                CryptographicOperations.ZeroMemory(key);
+            }
+        }
+
+        /// <summary>
+        /// Encrypts and authenticates a payload under a fresh random nonce.
+        /// </summary>
+        /// <param name="plaintext">The data to protect.</param>
+        /// <param name="additionalAuthenticatedData">Data bound into the tag but not encrypted.</param>
+        /// <returns>The protected payload, 28 bytes longer than <paramref name="plaintext"/>.</returns>
+        /// <exception cref="ObjectDisposedException">The encryptor has been disposed.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public byte[] Encrypt(ArraySegment<byte> plaintext, ArraySegment<byte> additionalAuthenticatedData)
+        {
+            byte[] payload = new byte[plaintext.Count + AesGcmSiv.SealOverhead];
+            _cipher.SealWithRandomNonce(plaintext, payload, additionalAuthenticatedData);
+            return payload;
+        }
+
+        /// <summary>
+        /// Verifies and decrypts a payload from <see cref="Encrypt"/>.
+        /// </summary>
+        /// <param name="ciphertext">The protected payload.</param>
+        /// <param name="additionalAuthenticatedData">The data passed to <see cref="Encrypt"/>.</param>
+        /// <returns>The plaintext.</returns>
+        /// <exception cref="ObjectDisposedException">The encryptor has been disposed.</exception>
+        /// <exception cref="CryptographicException">
+        /// The payload is too short, was not protected under this key and data, or was modified.
+        /// </exception>
+        public byte[] Decrypt(ArraySegment<byte> ciphertext, ArraySegment<byte> additionalAuthenticatedData)
+        {
+            ReadOnlySpan<byte> payload = ciphertext;
+            if (payload.Length < AesGcmSiv.SealOverhead)
+                throw new CryptographicException("The payload is too short to have been protected with AES-GCM-SIV.");
+
+            byte[] plaintext = new byte[payload.Length - AesGcmSiv.SealOverhead];
+            _cipher.Decrypt(
+                payload.Slice(0, NonceSize),
+                payload.Slice(NonceSize, plaintext.Length),
+                payload.Slice(NonceSize + plaintext.Length, TagSize),
+                plaintext,
+                additionalAuthenticatedData);
+            return plaintext;
+        }
+
+        /// <summary>
+        /// Releases the expanded key.
+        /// </summary>
+        public void Dispose() => _cipher.Dispose();
+    }
+}
@@ -0,0 +1,33 @@
+using Microsoft.AspNetCore.DataProtection.AuthenticatedEncryption.ConfigurationModel;
+
+namespace Microsoft.AspNetCore.DataProtection.AuthenticatedEncryption
+{
+    /// <summary>
+    /// Creates AES-GCM-SIV master keys for new Data Protection keys; set as
+    /// <see cref="KeyManagement.KeyManagementOptions.AuthenticatedEncryptorConfiguration"/> by
+    /// <see cref="AesGcmSivDataProtectionBuilderExtensions.UseAesGcmSiv"/>.
+    /// </summary>
+    public sealed class AesGcmSivAuthenticatedEncryptorConfiguration : AlgorithmConfiguration
+    {
+        private int _keySize = 256;
+
+        /// <summary>
+        /// Gets or sets the size of new master keys in bits: 128 or 256, the default.
+        /// </summary>
+        /// <exception cref="ArgumentOutOfRangeException">The value is not 128 or 256.</exception>
+        public int KeySize
+        {
+            get => _keySize;
+            set
+            {
+                if (value != 128 && value != 256)
+                    throw new ArgumentOutOfRangeException(nameof(value), "Key size must be 128 or 256 bits.");
+                _keySize = value;
+            }
+        }
+
+        /// <inheritdoc/>
+        public override IAuthenticatedEncryptorDescriptor CreateNewDescriptor() =>
+            new AesGcmSivAuthenticatedEncryptorDescriptor(Secret.Random(KeySize / 8));
+    }
+}
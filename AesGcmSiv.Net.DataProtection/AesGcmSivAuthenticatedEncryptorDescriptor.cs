@@ -0,0 +1,93 @@
+using System.Xml.Linq;
+using Microsoft.AspNetCore.DataProtection.AuthenticatedEncryption.ConfigurationModel;
+
+namespace Microsoft.AspNetCore.DataProtection.AuthenticatedEncryption
+{
+    /// <summary>
+    /// The master key of an AES-GCM-SIV Data Protection key, as stored in the key ring.
+    /// </summary>
+    /// <remarks>
+    /// Exported as
+    /// <c>&lt;descriptor&gt;&lt;encryption algorithm="AES_256_GCM_SIV" /&gt;&lt;masterKey&gt;&lt;value&gt;base64&lt;/value&gt;&lt;/masterKey&gt;&lt;/descriptor&gt;</c>,
+    /// with the master key marked for encryption by whatever key-encryption Data Protection is
+    /// configured with.
+    /// </remarks>
+    public sealed class AesGcmSivAuthenticatedEncryptorDescriptor : IAuthenticatedEncryptorDescriptor
+    {
+        internal const string AlgorithmAttribute = "algorithm";
+
+        /// <summary>
+        /// Initializes a descriptor for a master key.
+        /// </summary>
+        /// <param name="masterKey">The master key. Must be exactly 16 or 32 bytes.</param>
+        /// <exception cref="ArgumentNullException"><paramref name="masterKey"/> is null.</exception>
+        /// <exception cref="ArgumentException"><paramref name="masterKey"/> is not 16 or 32 bytes.</exception>
+        public AesGcmSivAuthenticatedEncryptorDescriptor(ISecret masterKey)
+        {
+            ArgumentNullException.ThrowIfNull(masterKey);
+            if (masterKey.Length != 16 && masterKey.Length != 32)
+                throw new ArgumentException("Master key must be exactly 16 bytes (128 bits) or 32 bytes (256 bits).", nameof(masterKey));
+            MasterKey = masterKey;
+        }
+
+        /// <summary>
+        /// Gets the master key.
+        /// </summary>
+        public ISecret MasterKey { get; }
+
+        internal static string AlgorithmName(int keyLength) => keyLength == 16 ? "AES_128_GCM_SIV" : "AES_256_GCM_SIV";
+
+        /// <inheritdoc/>
+        public XmlSerializedDescriptorInfo ExportToXml()
+        {
+            byte[] key = new byte[MasterKey.Length];
+            try
+            {
+                MasterKey.WriteSecretIntoBuffer(new ArraySegment<byte>(key));
+                var masterKey = new XElement("masterKey", new XElement("value", Convert.ToBase64String(key)));
+                masterKey.MarkAsRequiresEncryption();
+                var element = new XElement("descriptor",
+                    new XElement("encryption", new XAttribute(AlgorithmAttribute, AlgorithmName(key.Length))),
+                    masterKey);
+                return new XmlSerializedDescriptorInfo(element, typeof(AesGcmSivAuthenticatedEncryptorDescriptorDeserializer));
+            }
+            finally
+            {
+                System.Security.Cryptography.CryptographicOperations.ZeroMemory(key);
+            }
+        }
+    }
+
+    /// <summary>
+    /// Reads an <see cref="AesGcmSivAuthenticatedEncryptorDescriptor"/> back from the key ring.
+    /// </summary>
+    public sealed class AesGcmSivAuthenticatedEncryptorDescriptorDeserializer : IAuthenticatedEncryptorDescriptorDeserializer
+    {
+        /// <inheritdoc/>
+        /// <exception cref="ArgumentNullException"><paramref name="element"/> is null.</exception>
+        /// <exception cref="FormatException">
+        /// The element has no master key, or its length does not match the algorithm.
+        /// </exception>
+        public IAuthenticatedEncryptorDescriptor ImportFromXml(XElement element)
+        {
+            ArgumentNullException.ThrowIfNull(element);
+            string? value = (string?)element.Element("masterKey")?.Element("value");
+            if (value == null)
+                throw new FormatException("The descriptor has no master key.");
+
+            byte[] key = Convert.FromBase64String(value);
+            try
+            {
+                string? algorithm = (string?)element.Element("encryption")?.Attribute(AesGcmSivAuthenticatedEncryptorDescriptor.AlgorithmAttribute);
+                if ((key.Length != 16 && key.Length != 32) ||
+                    (algorithm != null && algorithm != AesGcmSivAuthenticatedEncryptorDescriptor.AlgorithmName(key.Length)))
+                    throw new FormatException("The master key length does not match the descriptor's algorithm.");
+                return new AesGcmSivAuthenticatedEncryptorDescriptor(new Secret(key));
+            }
+            finally
+            {
+                System.Security.Cryptography.CryptographicOperations.ZeroMemory(key);
+            }
+        }
+    }
+}
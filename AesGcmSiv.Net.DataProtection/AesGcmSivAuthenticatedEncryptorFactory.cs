@@ -0,0 +1,21 @@
+using Microsoft.AspNetCore.DataProtection.KeyManagement;
+
+namespace Microsoft.AspNetCore.DataProtection.AuthenticatedEncryption
+{
+    /// <summary>
+    /// Creates an <see cref="AesGcmSivAuthenticatedEncryptor"/> for each key in the ring with an
+    /// <see cref="AesGcmSivAuthenticatedEncryptorDescriptor"/>, and leaves other keys to the factories
+    /// after it.
+    /// </summary>
+    public sealed class AesGcmSivAuthenticatedEncryptorFactory : IAuthenticatedEncryptorFactory
+    {
+        /// <inheritdoc/>
+        public IAuthenticatedEncryptor? CreateEncryptorInstance(IKey key)
+        {
+            ArgumentNullException.ThrowIfNull(key);
+            return key.Descriptor is AesGcmSivAuthenticatedEncryptorDescriptor descriptor
+                ? new AesGcmSivAuthenticatedEncryptor(descriptor.MasterKey)
+                : null;
+        }
+    }
+}
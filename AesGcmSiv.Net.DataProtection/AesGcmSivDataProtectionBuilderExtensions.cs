@@ -0,0 +1,37 @@
+using Microsoft.AspNetCore.DataProtection.AuthenticatedEncryption;
+using Microsoft.AspNetCore.DataProtection.KeyManagement;
+using Microsoft.Extensions.DependencyInjection;
+
+namespace Microsoft.AspNetCore.DataProtection
+{
+    /// <summary>
+    /// Registers AES-GCM-SIV with ASP.NET Core Data Protection.
+    /// </summary>
+    public static class AesGcmSivDataProtectionBuilderExtensions
+    {
+        /// <summary>
+        /// Protects payloads under new keys with <see cref="AesGcmSivAuthenticatedEncryptor"/>.
+        /// </summary>
+        /// <param name="builder">The Data Protection builder.</param>
+        /// <param name="keySize">The size of new master keys in bits: 128 or 256.</param>
+        /// <returns><paramref name="builder"/>, for chaining.</returns>
+        /// <remarks>
+        /// Keys already in the ring keep the algorithm they were created with, so payloads protected
+        /// before the switch still unprotect; new payloads use AES-GCM-SIV once the next key is
+        /// created, or at once after <see cref="IKeyManager.CreateNewKey"/>.
+        /// </remarks>
+        /// <exception cref="ArgumentNullException"><paramref name="builder"/> is null.</exception>
+        /// <exception cref="ArgumentOutOfRangeException"><paramref name="keySize"/> is not 128 or 256.</exception>
+        public static IDataProtectionBuilder UseAesGcmSiv(this IDataProtectionBuilder builder, int keySize = 256)
+        {
+            ArgumentNullException.ThrowIfNull(builder);
+            var configuration = new AesGcmSivAuthenticatedEncryptorConfiguration { KeySize = keySize };
+            builder.Services.Configure<KeyManagementOptions>(options =>
+            {
+                options.AuthenticatedEncryptorConfiguration = configuration;
+                options.AuthenticatedEncryptorFactories.Insert(0, new AesGcmSivAuthenticatedEncryptorFactory());
+            });
+            return builder;
+        }
+    }
+}
@@ -0,0 +1,447 @@
+using System.Buffers;
+using System.Buffers.Binary;
+using System.Collections.Concurrent;
+using System.Runtime.CompilerServices;
+using System.Security.Cryptography;
+using System.Text;
+
+namespace Microsoft.EntityFrameworkCore
+{
+    /// <summary>
+    /// Field-level AES-GCM-SIV encryption of EF Core columns under numbered keys.
+    /// </summary>
+    /// <remarks>
+    /// A stored value is laid out as key ID (4 bytes, big-endian) || nonce || ciphertext || tag,
+    /// <see cref="Overhead"/> bytes longer than the plaintext; strings are stored as UTF-8. New values
+    /// are encrypted under <see cref="CurrentKeyId"/>, and each value decrypts under the key ID it
+    /// carries, so keys can be rotated without rewriting existing rows.
+    ///
+    /// The resolver is asked for each key ID once. The expanded key is then kept until the instance is
+    /// disposed, so no value pays for key setup. With
+    /// <see cref="AesGcmSivEntityFrameworkExtensions.UseAesGcmSivBatching"/>, <c>SaveChanges</c> hands every
+    /// new or modified value of the save to <see cref="EncryptPending"/>, which encrypts them with one
+    /// <see cref="AesGcmSiv.EncryptColumn(ReadOnlySpan{byte}, ReadOnlySpan{int}, Span{byte}, Span{byte}, byte[], ulong)"/>
+    /// call, and the converters then return the ready ciphertexts. EF Core materializes query results
+    /// one value at a time, so reads decrypt one value per call. Properties of type
+    /// <see cref="AesGcmSivLazyDecrypted"/> are not decrypted when they are loaded, only when they are
+    /// read, and values read together can be decrypted with one batch call.
+    ///
+    /// Every value is encrypted under a random nonce, so encrypted columns cannot be searched for
+    /// equality. Values are not bound to their row or column: someone who can write to the database
+    /// can move a value to another encrypted cell under the same key. One instance can be shared
+    /// across threads and contexts.
+    /// </remarks>
+    public sealed class AesGcmSivColumnEncryptor : IDisposable
+    {
+        /// <summary>
+        /// The number of bytes a stored value adds to its plaintext.
+        /// </summary>
+        public const int Overhead = KeyIdSize + AesGcmSiv.SealOverhead;
+
+        private const int KeyIdSize = 4;
+        private const int NonceSize = 12;
+        private const int TagSize = 16;
+
+        // Plaintext encrypted by one columnar call at most; a larger save takes several
+        private const int MaxColumnLength = 16 * 1024 * 1024;
+
+        private readonly Func<int, byte[]> _keyResolver;
+        private readonly ConcurrentDictionary<int, AesGcmSiv> _ciphers = new();
+        private readonly object _createLock = new();
+
+        // Ciphertexts from EncryptPending, keyed by the plaintext instance
+        // they were made from, until a converter takes them
+        private readonly ConditionalWeakTable<object, byte[]> _pending = new();
+
+        private volatile int _currentKeyId;
+        private volatile bool _disposed;
+
+        /// <summary>
+        /// Initializes an encryptor.
+        /// </summary>
+        /// <param name="currentKeyId">The key ID new values are encrypted under.</param>
+        /// <param name="keyResolver">
+        /// Returns the key for a key ID, 16 or 32 bytes; called at most once per key ID that succeeds.
+        /// </param>
+        /// <exception cref="ArgumentNullException"><paramref name="keyResolver"/> is null.</exception>
+        public AesGcmSivColumnEncryptor(int currentKeyId, Func<int, byte[]> keyResolver)
+        {
+            ArgumentNullException.ThrowIfNull(keyResolver);
+            _currentKeyId = currentKeyId;
+            _keyResolver = keyResolver;
+        }
+
+        /// <summary>
+        /// Gets or sets the key ID new values are encrypted under.
+        /// </summary>
+        public int CurrentKeyId
+        {
+            get => _currentKeyId;
+            set => _currentKeyId = value;
+        }
+
+        /// <summary>
+        /// Encrypts a value under <see cref="CurrentKeyId"/>.
+        /// </summary>
+        /// <param name="plaintext">The value.</param>
+        /// <returns>The stored value.</returns>
+        /// <exception cref="ObjectDisposedException">The encryptor has been disposed.</exception>
+        /// <exception cref="CryptographicException">The key could not be resolved, or encryption failed.</exception>
+        public byte[] Encrypt(ReadOnlySpan<byte> plaintext)
+        {
+            int keyId = _currentKeyId;
+            AesGcmSiv cipher = GetCipher(keyId);
+            byte[] stored = new byte[plaintext.Length + Overhead];
+            BinaryPrimitives.WriteInt32BigEndian(stored, keyId);
+            cipher.SealWithRandomNonce(plaintext, stored.AsSpan(KeyIdSize));
+            return stored;
+        }
+
+        /// <summary>
+        /// Encrypts a string, as UTF-8, under <see cref="CurrentKeyId"/>.
+        /// </summary>
+        /// <exception cref="ArgumentNullException"><paramref name="plaintext"/> is null.</exception>
+        /// <exception cref="ObjectDisposedException">The encryptor has been disposed.</exception>
+        /// <exception cref="CryptographicException">The key could not be resolved, or encryption failed.</exception>
+        public byte[] Encrypt(string plaintext)
+        {
+            ArgumentNullException.ThrowIfNull(plaintext);
+            byte[] utf8 = Encoding.UTF8.GetBytes(plaintext);
+            try
+            {
+                return Encrypt(utf8);
+            }
+            finally
+            {
+                CryptographicOperations.ZeroMemory(utf8);
+            }
+        }
+
+        /// <summary>
+        /// Verifies and decrypts a stored value.
+        /// </summary>
+        /// <param name="stored">The stored value.</param>
+        /// <returns>The plaintext.</returns>
+        /// <exception cref="ArgumentNullException"><paramref name="stored"/> is null.</exception>
+        /// <exception cref="ObjectDisposedException">The encryptor has been disposed.</exception>
+        /// <exception cref="CryptographicException">
+        /// The value is too short, its key could not be resolved, or it does not authenticate.
+        /// </exception>
+        public byte[] Decrypt(byte[] stored)
+        {
+            ArgumentNullException.ThrowIfNull(stored);
+            if (stored.Length < Overhead)
+                throw new CryptographicException("The stored value is too short to have been encrypted with AES-GCM-SIV.");
+
+            byte[] plaintext = new byte[stored.Length - Overhead];
+            DecryptInto(stored, plaintext);
+            return plaintext;
+        }
+
+        /// <summary>
+        /// Verifies and decrypts a stored string.
+        /// </summary>
+        /// <exception cref="ArgumentNullException"><paramref name="stored"/> is null.</exception>
+        /// <exception cref="ObjectDisposedException">The encryptor has been disposed.</exception>
+        /// <exception cref="CryptographicException">
+        /// The value is too short, its key could not be resolved, or it does not authenticate.
+        /// </exception>
+        public string DecryptString(byte[] stored)
+        {
+            byte[] utf8 = Decrypt(stored);
+            try
+            {
+                return Encoding.UTF8.GetString(utf8);
+            }
+            finally
+            {
+                CryptographicOperations.ZeroMemory(utf8);
+            }
+        }
+
+        /// <summary>
+        /// Wraps a stored value so that it is decrypted only when it is first read.
+        /// </summary>
+        /// <param name="stored">The stored value, which is kept rather than copied.</param>
+        /// <returns>The value, not yet decrypted.</returns>
+        /// <exception cref="ArgumentNullException"><paramref name="stored"/> is null.</exception>
+        /// <exception cref="ObjectDisposedException">The encryptor has been disposed.</exception>
+        /// <exception cref="CryptographicException">The value is too short.</exception>
+        public AesGcmSivLazyDecrypted DecryptLazily(byte[] stored)
+        {
+            ArgumentNullException.ThrowIfNull(stored);
+            ObjectDisposedException.ThrowIf(_disposed, this);
+            if (stored.Length < Overhead)
+                throw new CryptographicException("The stored value is too short to have been encrypted with AES-GCM-SIV.");
+            return new AesGcmSivLazyDecrypted(this, stored);
+        }
+
+        /// <summary>
+        /// Encrypts many values, each a <see cref="string"/>, a <see cref="byte"/> array or an
+        /// <see cref="AesGcmSivLazyDecrypted"/>, with as few
+        /// columnar calls as their size allows. Each ciphertext is kept for the next
+        /// <see cref="TakeOrEncrypt(string)"/> or <see cref="TakeOrEncrypt(byte[])"/> call on the same
+        /// instance.
+        /// </summary>
+        /// <param name="values">The values. Must not be modified until their ciphertexts are taken.</param>
+        /// <remarks>
+        /// The values of one call share a random base nonce and take the nonces
+        /// <see cref="AesGcmSiv.EncryptBatch(ReadOnlySpan{AesGcmSivBatchItem}, byte[], ulong)"/> derives
+        /// from it. Each stored value carries its own nonce, so it decrypts alone.
+        /// </remarks>
+        /// <exception cref="ArgumentNullException"><paramref name="values"/> or one of its items is null.</exception>
+        /// <exception cref="ArgumentException">A value is not a string, a byte array or a lazy value.</exception>
+        /// <exception cref="ObjectDisposedException">The encryptor has been disposed.</exception>
+        /// <exception cref="CryptographicException">The key could not be resolved, or encryption failed.</exception>
+        public void EncryptPending(IReadOnlyList<object> values)
+        {
+            ArgumentNullException.ThrowIfNull(values);
+            int first = 0;
+            while (first < values.Count)
+            {
+                long length = 0;
+                int end = first;
+                while (end < values.Count)
+                {
+                    int valueLength = PlaintextLength(values[end]);
+                    if (end > first && length + valueLength > MaxColumnLength)
+                        break;
+                    length += valueLength;
+                    end++;
+                }
+                if (length > Array.MaxLength)
+                    throw new ArgumentException("A value is too large to encrypt.", nameof(values));
+                EncryptColumn(values, first, end - first, (int)length);
+                first = end;
+            }
+        }
+
+        /// <summary>
+        /// Returns the ciphertext <see cref="EncryptPending"/> made from this string instance, or
+        /// encrypts it now if there is none; for value converters.
+        /// </summary>
+        /// <exception cref="ArgumentNullException"><paramref name="plaintext"/> is null.</exception>
+        /// <exception cref="ObjectDisposedException">The encryptor has been disposed.</exception>
+        /// <exception cref="CryptographicException">The key could not be resolved, or encryption failed.</exception>
+        public byte[] TakeOrEncrypt(string plaintext) =>
+            TakePending(plaintext) ?? Encrypt(plaintext);
+
+        /// <summary>
+        /// Returns the ciphertext <see cref="EncryptPending"/> made from this array instance, or
+        /// encrypts it now if there is none; for value converters.
+        /// </summary>
+        /// <exception cref="ArgumentNullException"><paramref name="plaintext"/> is null.</exception>
+        /// <exception cref="ObjectDisposedException">The encryptor has been disposed.</exception>
+        /// <exception cref="CryptographicException">The key could not be resolved, or encryption failed.</exception>
+        public byte[] TakeOrEncrypt(byte[] plaintext)
+        {
+            ArgumentNullException.ThrowIfNull(plaintext);
+            return TakePending(plaintext) ?? Encrypt(plaintext);
+        }
+
+        /// <summary>
+        /// Returns the stored value a lazy value was loaded with if it came from this instance, so an
+        /// unchanged value is saved back as it was; otherwise the ciphertext <see cref="EncryptPending"/>
+        /// made from it, or a new encryption of it. For value converters.
+        /// </summary>
+        /// <exception cref="ArgumentNullException"><paramref name="plaintext"/> is null.</exception>
+        /// <exception cref="ObjectDisposedException">The encryptor or the value has been disposed.</exception>
+        /// <exception cref="CryptographicException">The key could not be resolved, or encryption failed.</exception>
+        public byte[] TakeOrEncrypt(AesGcmSivLazyDecrypted plaintext)
+        {
+            ArgumentNullException.ThrowIfNull(plaintext);
+            return plaintext.StoredBy(this) ?? TakePending(plaintext) ?? Encrypt(plaintext.Span);
+        }
+
+        /// <summary>
+        /// Releases every expanded key.
+        /// </summary>
+        public void Dispose()
+        {
+            _disposed = true;
+            lock (_createLock)
+            {
+                foreach (AesGcmSiv cipher in _ciphers.Values)
+                    cipher.Dispose();
+                _ciphers.Clear();
+            }
+        }
+
+        private byte[]? TakePending(object plaintext)
+        {
+            if (!_pending.TryGetValue(plaintext, out byte[]? stored))
+                return null;
+            _pending.Remove(plaintext);
+            return stored;
+        }
+
+        private static int PlaintextLength(object value) => value switch
+        {
+            string s => Encoding.UTF8.GetByteCount(s),
+            byte[] b => b.Length,
+            AesGcmSivLazyDecrypted l => l.Length,
+            null => throw new ArgumentNullException(nameof(value)),
+            _ => throw new ArgumentException("Only strings and byte arrays can be encrypted.", nameof(value)),
+        };
+
+        private void EncryptColumn(IReadOnlyList<object> values, int first, int count, int length)
+        {
+            int keyId = _currentKeyId;
+            AesGcmSiv cipher = GetCipher(keyId);
+            byte[] column = ArrayPool<byte>.Shared.Rent(length);
+            byte[] tags = ArrayPool<byte>.Shared.Rent(count * TagSize);
+            int[] offsets = ArrayPool<int>.Shared.Rent(count + 1);
+            var baseNonce = new byte[NonceSize];
+            try
+            {
+                offsets[0] = 0;
+                for (int i = 0; i < count; i++)
+                {
+                    Span<byte> slot = column.AsSpan(offsets[i]);
+                    int written = values[first + i] switch
+                    {
+                        string s => Encoding.UTF8.GetBytes(s, slot),
+                        AesGcmSivLazyDecrypted l => CopyBytes(l.Span, slot),
+                        object b => CopyBytes((byte[])b, slot),
+                    };
+                    offsets[i + 1] = offsets[i] + written;
+                }
+
+                RandomNumberGenerator.Fill(baseNonce);
+                cipher.EncryptColumn(
+                    column.AsSpan(0, length), offsets.AsSpan(0, count + 1), column.AsSpan(0, length), tags,
+                    baseNonce, 0);
+
+                for (int i = 0; i < count; i++)
+                {
+                    int valueLength = offsets[i + 1] - offsets[i];
+                    byte[] stored = new byte[valueLength + Overhead];
+                    BinaryPrimitives.WriteInt32BigEndian(stored, keyId);
+                    DeriveNonce(baseNonce, (ulong)i, stored.AsSpan(KeyIdSize, NonceSize));
+                    column.AsSpan(offsets[i], valueLength).CopyTo(stored.AsSpan(KeyIdSize + NonceSize));
+                    tags.AsSpan(i * TagSize, TagSize).CopyTo(stored.AsSpan(KeyIdSize + NonceSize + valueLength));
+                    _pending.AddOrUpdate(values[first + i], stored);
+                }
+            }
+            finally
+            {
+                // Holds plaintext if encryption failed part way
+                CryptographicOperations.ZeroMemory(column.AsSpan(0, length));
+                ArrayPool<byte>.Shared.Return(column);
+                ArrayPool<byte>.Shared.Return(tags);
+                ArrayPool<int>.Shared.Return(offsets);
+            }
+        }
+
+        private static int CopyBytes(ReadOnlySpan<byte> value, Span<byte> destination)
+        {
+            value.CopyTo(destination);
+            return value.Length;
+        }
+
+        // Decrypts lazy values from this instance that have not been decrypted,
+        // with one batch call per key ID
+        internal void DecryptLazy(List<AesGcmSivLazyDecrypted> values)
+        {
+            if (values.Count == 1)
+            {
+                AesGcmSivLazyDecrypted value = values[0];
+                byte[] plaintext = AesGcmSivLazyDecrypted.Rent(value.Length);
+                try
+                {
+                    DecryptInto(value.Stored, plaintext.AsSpan(0, value.Length));
+                }
+                catch
+                {
+                    AesGcmSivLazyDecrypted.Return(plaintext, value.Length);
+                    throw;
+                }
+                value.SetPlaintext(plaintext);
+                return;
+            }
+
+            int failures = 0;
+            foreach (IGrouping<int, AesGcmSivLazyDecrypted> group in values.GroupBy(v => BinaryPrimitives.ReadInt32BigEndian(v.Stored)))
+                failures += DecryptLazyGroup(GetCipher(group.Key), group.ToArray());
+            if (failures != 0)
+                throw new CryptographicException($"{failures} stored values do not authenticate.");
+        }
+
+        private static int DecryptLazyGroup(AesGcmSiv cipher, AesGcmSivLazyDecrypted[] values)
+        {
+            var items = new AesGcmSivBatchItem[values.Length];
+            var plaintexts = new byte[values.Length][];
+            var succeeded = new bool[values.Length];
+            int failures;
+            try
+            {
+                for (int i = 0; i < values.Length; i++)
+                {
+                    byte[] stored = values[i].Stored;
+                    int length = values[i].Length;
+                    plaintexts[i] = AesGcmSivLazyDecrypted.Rent(length);
+                    items[i] = new AesGcmSivBatchItem(
+                        stored.AsSpan(KeyIdSize, NonceSize).ToArray(),
+                        stored.AsSpan(KeyIdSize + NonceSize, length).ToArray(),
+                        plaintexts[i],
+                        stored.AsSpan(KeyIdSize + NonceSize + length, TagSize).ToArray());
+                }
+                failures = cipher.DecryptBatch(items, succeeded);
+            }
+            catch
+            {
+                for (int i = 0; i < values.Length && plaintexts[i] != null; i++)
+                    AesGcmSivLazyDecrypted.Return(plaintexts[i], values[i].Length);
+                throw;
+            }
+
+            for (int i = 0; i < values.Length; i++)
+            {
+                // The plaintext of a value that failed is already zeroed
+                if (succeeded[i])
+                    values[i].SetPlaintext(plaintexts[i]);
+                else
+                    AesGcmSivLazyDecrypted.Return(plaintexts[i], values[i].Length);
+            }
+            return failures;
+        }
+
+        private void DecryptInto(byte[] stored, Span<byte> plaintext)
+        {
+            AesGcmSiv cipher = GetCipher(BinaryPrimitives.ReadInt32BigEndian(stored));
+            ReadOnlySpan<byte> sealedData = stored.AsSpan(KeyIdSize);
+            cipher.Decrypt(
+                sealedData.Slice(0, NonceSize),
+                sealedData.Slice(NonceSize, plaintext.Length),
+                sealedData.Slice(NonceSize + plaintext.Length, TagSize),
+                plaintext);
+        }
+
+        // As AesGcmSiv derives item nonces from a base nonce and a counter
+        private static void DeriveNonce(ReadOnlySpan<byte> baseNonce, ulong counter, Span<byte> nonce)
+        {
+            baseNonce.CopyTo(nonce);
+            Span<byte> tail = nonce.Slice(4);
+            BinaryPrimitives.WriteUInt64LittleEndian(tail, BinaryPrimitives.ReadUInt64LittleEndian(tail) ^ counter);
+        }
+
+        private AesGcmSiv GetCipher(int keyId)
+        {
+            ObjectDisposedException.ThrowIf(_disposed, this);
+            if (_ciphers.TryGetValue(keyId, out AesGcmSiv? cipher))
+                return cipher;
+
+            lock (_createLock)
+            {
+                ObjectDisposedException.ThrowIf(_disposed, this);
+                if (_ciphers.TryGetValue(keyId, out cipher))
+                    return cipher;
+                byte[] key = _keyResolver(keyId)
+                    ?? throw new CryptographicException($"No key is known for key ID {keyId}.");
+                cipher = new AesGcmSiv(key, AesGcmSivImplementation.Auto);
+                _ciphers[keyId] = cipher;
+                return cipher;
+            }
+        }
+    }
+}
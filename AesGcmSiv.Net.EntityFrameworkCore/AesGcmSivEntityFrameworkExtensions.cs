@@ -0,0 +1,66 @@
+using Microsoft.EntityFrameworkCore.Diagnostics;
+using Microsoft.EntityFrameworkCore.Metadata.Builders;
+using Microsoft.EntityFrameworkCore.Storage.ValueConversion;
+
+namespace Microsoft.EntityFrameworkCore
+{
+    /// <summary>
+    /// Maps properties to AES-GCM-SIV encrypted columns.
+    /// </summary>
+    public static class AesGcmSivEntityFrameworkExtensions
+    {
+        /// <summary>
+        /// Stores a string property encrypted, as a binary column.
+        /// </summary>
+        /// <param name="builder">The property.</param>
+        /// <param name="encryptor">The encryptor, usually one shared by the whole model.</param>
+        /// <returns><paramref name="builder"/>, for chaining.</returns>
+        /// <exception cref="ArgumentNullException">An argument is null.</exception>
+        public static PropertyBuilder<string> HasAesGcmSivEncryption(
+            this PropertyBuilder<string> builder, AesGcmSivColumnEncryptor encryptor)
+        {
+            ArgumentNullException.ThrowIfNull(builder);
+            return builder.HasConversion(new AesGcmSivStringConverter(encryptor));
+        }
+
+        /// <summary>
+        /// Stores a byte array property encrypted.
+        /// </summary>
+        /// <param name="builder">The property.</param>
+        /// <param name="encryptor">The encryptor, usually one shared by the whole model.</param>
+        /// <returns><paramref name="builder"/>, for chaining.</returns>
+        /// <exception cref="ArgumentNullException">An argument is null.</exception>
+        public static PropertyBuilder<byte[]> HasAesGcmSivEncryption(
+            this PropertyBuilder<byte[]> builder, AesGcmSivColumnEncryptor encryptor)
+        {
+            ArgumentNullException.ThrowIfNull(builder);
+            return builder.HasConversion(new AesGcmSivBytesConverter(encryptor));
+        }
+
+        /// <summary>
+        /// Stores a property encrypted, as a binary column, and decrypts it only when it is read.
+        /// </summary>
+        /// <param name="builder">The property.</param>
+        /// <param name="encryptor">The encryptor, usually one shared by the whole model.</param>
+        /// <returns><paramref name="builder"/>, for chaining.</returns>
+        /// <exception cref="ArgumentNullException">An argument is null.</exception>
+        public static PropertyBuilder<AesGcmSivLazyDecrypted> HasAesGcmSivEncryption(
+            this PropertyBuilder<AesGcmSivLazyDecrypted> builder, AesGcmSivColumnEncryptor encryptor)
+        {
+            ArgumentNullException.ThrowIfNull(builder);
+            return builder.HasConversion(new AesGcmSivLazyConverter(encryptor));
+        }
+
+        /// <summary>
+        /// Encrypts the encrypted properties of each save in batches rather than one value at a time.
+        /// </summary>
+        /// <param name="builder">The context options.</param>
+        /// <returns><paramref name="builder"/>, for chaining.</returns>
+        /// <exception cref="ArgumentNullException"><paramref name="builder"/> is null.</exception>
+        public static DbContextOptionsBuilder UseAesGcmSivBatching(this DbContextOptionsBuilder builder)
+        {
+            ArgumentNullException.ThrowIfNull(builder);
+            return builder.AddInterceptors(AesGcmSivSaveChangesInterceptor.Instance);
+        }
+    }
+}
@@ -0,0 +1,212 @@
+using System.Buffers;
+using System.Security.Cryptography;
+using System.Text;
+
+namespace Microsoft.EntityFrameworkCore
+{
+    /// <summary>
+    /// An encrypted column value that is decrypted only when it is first read, for rows with many
+    /// encrypted columns of which most requests read a few.
+    /// </summary>
+    /// <remarks>
+    /// A value loaded through <see cref="AesGcmSivEntityFrameworkExtensions.HasAesGcmSivEncryption(Metadata.Builders.PropertyBuilder{AesGcmSivLazyDecrypted}, AesGcmSivColumnEncryptor)"/>
+    /// or <see cref="AesGcmSivColumnEncryptor.DecryptLazily"/> holds the stored value and the encryptor
+    /// whose keys open it. It is decrypted once, into memory rented from the shared array pool, the
+    /// first time <see cref="Span"/>, <see cref="Memory"/>, <see cref="GetString"/> or
+    /// <see cref="ToArray"/> is called. Columns never read are never decrypted. Values that will be
+    /// read together can be opened with one <see cref="DecryptAll"/> call, which decrypts all of them
+    /// under one key with a single batch call.
+    ///
+    /// A value that was loaded and not replaced is saved back as it was loaded, without being decrypted
+    /// or encrypted again. To change a column, assign a new value from <see cref="FromBytes"/> or
+    /// <see cref="FromString"/>.
+    ///
+    /// A value may be read from several threads at once, and is decrypted once however many race to
+    /// read it first. <see cref="Dispose"/> zeroes the plaintext and returns its memory to the pool; it
+    /// must not race with reads. A value that is never disposed leaves its memory to the garbage
+    /// collector.
+    /// </remarks>
+    public sealed class AesGcmSivLazyDecrypted : IDisposable
+    {
+        private readonly AesGcmSivColumnEncryptor? _encryptor;
+        private readonly byte[]? _stored;
+        private readonly int _length;
+        // The plaintext, rented unless empty; set once, by whichever thread decrypts first
+        private byte[]? _plaintext;
+        private bool _disposed;
+
+        internal AesGcmSivLazyDecrypted(AesGcmSivColumnEncryptor encryptor, byte[] stored)
+        {
+            _encryptor = encryptor;
+            _stored = stored;
+            _length = stored.Length - AesGcmSivColumnEncryptor.Overhead;
+        }
+
+        private AesGcmSivLazyDecrypted(ReadOnlySpan<byte> plaintext)
+        {
+            _length = plaintext.Length;
+            _plaintext = Rent(plaintext.Length);
+            plaintext.CopyTo(_plaintext);
+        }
+
+        /// <summary>
+        /// Gets whether the value has been decrypted. A value made from plaintext always has been.
+        /// </summary>
+        public bool IsDecrypted => Volatile.Read(ref _plaintext) != null;
+
+        /// <summary>
+        /// Gets the length of the plaintext in bytes, known without decrypting.
+        /// </summary>
+        public int Length => _length;
+
+        /// <summary>
+        /// Gets the plaintext, decrypting it first if it has not been. Valid until the value is disposed.
+        /// </summary>
+        /// <exception cref="ObjectDisposedException">The value has been disposed.</exception>
+        /// <exception cref="CryptographicException">
+        /// The key could not be resolved, or the stored value does not authenticate.
+        /// </exception>
+        public ReadOnlySpan<byte> Span => Plaintext().AsSpan(0, _length);
+
+        /// <summary>
+        /// Gets the plaintext as memory, decrypting it first if it has not been. Valid until the value is
+        /// disposed.
+        /// </summary>
+        /// <exception cref="ObjectDisposedException">The value has been disposed.</exception>
+        /// <exception cref="CryptographicException">
+        /// The key could not be resolved, or the stored value does not authenticate.
+        /// </exception>
+        public ReadOnlyMemory<byte> Memory => Plaintext().AsMemory(0, _length);
+
+        /// <summary>
+        /// Makes a new value from plaintext, to assign to a property; it is encrypted when saved.
+        /// </summary>
+        /// <param name="plaintext">The plaintext, which is copied.</param>
+        public static AesGcmSivLazyDecrypted FromBytes(ReadOnlySpan<byte> plaintext) => new(plaintext);
+
+        /// <summary>
+        /// Makes a new value from a string, stored as UTF-8, to assign to a property; it is encrypted
+        /// when saved.
+        /// </summary>
+        /// <param name="plaintext">The string.</param>
+        /// <exception cref="ArgumentNullException"><paramref name="plaintext"/> is null.</exception>
+        public static AesGcmSivLazyDecrypted FromString(string plaintext)
+        {
+            ArgumentNullException.ThrowIfNull(plaintext);
+            byte[] utf8 = Encoding.UTF8.GetBytes(plaintext);
+            try
+            {
+                return new AesGcmSivLazyDecrypted(utf8);
+            }
+            finally
+            {
+                CryptographicOperations.ZeroMemory(utf8);
+            }
+        }
+
+        /// <summary>
+        /// Decrypts every value given that has not been decrypted yet, with one batch call per encryptor
+        /// and key ID, for values that are about to be read together.
+        /// </summary>
+        /// <param name="values">The values. Null entries are skipped.</param>
+        /// <exception cref="ArgumentNullException"><paramref name="values"/> is null.</exception>
+        /// <exception cref="ObjectDisposedException">A value has been disposed.</exception>
+        /// <exception cref="CryptographicException">
+        /// A key could not be resolved, or a stored value does not authenticate. The values that did
+        /// authenticate are decrypted nonetheless.
+        /// </exception>
+        public static void DecryptAll(params AesGcmSivLazyDecrypted?[] values)
+        {
+            ArgumentNullException.ThrowIfNull(values);
+
+            Dictionary<AesGcmSivColumnEncryptor, List<AesGcmSivLazyDecrypted>>? pending = null;
+            foreach (AesGcmSivLazyDecrypted? value in values)
+            {
+                if (value == null)
+                    continue;
+                ObjectDisposedException.ThrowIf(value._disposed, value);
+                if (value.IsDecrypted)
+                    continue;
+                pending ??= new Dictionary<AesGcmSivColumnEncryptor, List<AesGcmSivLazyDecrypted>>();
+                if (!pending.TryGetValue(value._encryptor!, out List<AesGcmSivLazyDecrypted>? group))
+                    pending[value._encryptor!] = group = new List<AesGcmSivLazyDecrypted>();
+                if (!group.Contains(value))
+                    group.Add(value);
+            }
+
+            if (pending == null)
+                return;
+            foreach ((AesGcmSivColumnEncryptor encryptor, List<AesGcmSivLazyDecrypted> group) in pending)
+                encryptor.DecryptLazy(group);
+        }
+
+        /// <summary>
+        /// Returns the plaintext as a string, decoding it as UTF-8.
+        /// </summary>
+        /// <exception cref="ObjectDisposedException">The value has been disposed.</exception>
+        /// <exception cref="CryptographicException">
+        /// The key could not be resolved, or the stored value does not authenticate.
+        /// </exception>
+        public string GetString() => Encoding.UTF8.GetString(Span);
+
+        /// <summary>
+        /// Returns a copy of the plaintext.
+        /// </summary>
+        /// <exception cref="ObjectDisposedException">The value has been disposed.</exception>
+        /// <exception cref="CryptographicException">
+        /// The key could not be resolved, or the stored value does not authenticate.
+        /// </exception>
+        public byte[] ToArray() => Span.ToArray();
+
+        /// <summary>
+        /// Zeroes the plaintext, if the value was decrypted, and returns its memory to the pool.
+        /// </summary>
+        public void Dispose()
+        {
+            if (_disposed)
+                return;
+            _disposed = true;
+            byte[]? plaintext = Interlocked.Exchange(ref _plaintext, null);
+            if (plaintext != null)
+                Return(plaintext, _length);
+        }
+
+        // The stored value, if this value was loaded from the given encryptor
+        // and can be saved back as it is
+        internal byte[]? StoredBy(AesGcmSivColumnEncryptor encryptor) =>
+            _encryptor == encryptor ? _stored : null;
+
+        // The stored value a lazy batch decrypts, for values not yet decrypted
+        internal byte[] Stored => _stored!;
+
+        // Publishes a plaintext decrypted by a batch; a losing race hands its
+        // copy back
+        internal void SetPlaintext(byte[] plaintext)
+        {
+            if (Interlocked.CompareExchange(ref _plaintext, plaintext, null) != null)
+                Return(plaintext, _length);
+        }
+
+        internal static byte[] Rent(int length) =>
+            length == 0 ? Array.Empty<byte>() : ArrayPool<byte>.Shared.Rent(length);
+
+        internal static void Return(byte[] plaintext, int length)
+        {
+            if (plaintext.Length == 0)
+                return;
+            CryptographicOperations.ZeroMemory(plaintext.AsSpan(0, length));
+            ArrayPool<byte>.Shared.Return(plaintext);
+        }
+
+        private byte[] Plaintext()
+        {
+            ObjectDisposedException.ThrowIf(_disposed, this);
+            byte[]? plaintext = Volatile.Read(ref _plaintext);
+            if (plaintext != null)
+                return plaintext;
+
+            _encryptor!.DecryptLazy(new List<AesGcmSivLazyDecrypted>(1) { this });
+            return Volatile.Read(ref _plaintext) ?? throw new ObjectDisposedException(nameof(AesGcmSivLazyDecrypted));
+        }
+    }
+}
@@ -0,0 +1,70 @@
+using Microsoft.EntityFrameworkCore.ChangeTracking;
+using Microsoft.EntityFrameworkCore.Storage.ValueConversion;
+
+namespace Microsoft.EntityFrameworkCore.Diagnostics
+{
+    /// <summary>
+    /// Encrypts every new or modified encrypted property of a save in batches, one
+    /// <see cref="AesGcmSivColumnEncryptor.EncryptPending"/> call per encryptor, before EF Core asks the
+    /// converters for them; added by
+    /// <see cref="AesGcmSivEntityFrameworkExtensions.UseAesGcmSivBatching"/>.
+    /// </summary>
+    public sealed class AesGcmSivSaveChangesInterceptor : SaveChangesInterceptor
+    {
+        /// <summary>
+        /// Gets the shared instance, which holds no state.
+        /// </summary>
+        public static AesGcmSivSaveChangesInterceptor Instance { get; } = new();
+
+        private AesGcmSivSaveChangesInterceptor()
+        {
+        }
+
+        /// <inheritdoc/>
+        public override InterceptionResult<int> SavingChanges(DbContextEventData eventData, InterceptionResult<int> result)
+        {
+            EncryptPending(eventData.Context);
+            return result;
+        }
+
+        /// <inheritdoc/>
+        public override ValueTask<InterceptionResult<int>> SavingChangesAsync(
+            DbContextEventData eventData, InterceptionResult<int> result, CancellationToken cancellationToken = default)
+        {
+            EncryptPending(eventData.Context);
+            return ValueTask.FromResult(result);
+        }
+
+        private static void EncryptPending(DbContext? context)
+        {
+            if (context == null)
+                return;
+
+            Dictionary<AesGcmSivColumnEncryptor, List<object>>? pending = null;
+            foreach (EntityEntry entry in context.ChangeTracker.Entries())
+            {
+                if (entry.State != EntityState.Added && entry.State != EntityState.Modified)
+                    continue;
+                foreach (PropertyEntry property in entry.Properties)
+                {
+                    if (property.Metadata.GetValueConverter() is not IAesGcmSivValueConverter converter ||
+                        property.CurrentValue is not { } value ||
+                        (entry.State == EntityState.Modified && !property.IsModified))
+                        continue;
+                    // Loaded and not replaced, so it is saved as it was loaded
+                    if (value is AesGcmSivLazyDecrypted lazy && lazy.StoredBy(converter.Encryptor) != null)
+                        continue;
+                    pending ??= new Dictionary<AesGcmSivColumnEncryptor, List<object>>();
+                    if (!pending.TryGetValue(converter.Encryptor, out List<object>? values))
+                        pending[converter.Encryptor] = values = new List<object>();
+                    values.Add(value);
+                }
+            }
+
+            if (pending == null)
+                return;
+            foreach ((AesGcmSivColumnEncryptor encryptor, List<object> values) in pending)
+                encryptor.EncryptPending(values);
+        }
+    }
+}
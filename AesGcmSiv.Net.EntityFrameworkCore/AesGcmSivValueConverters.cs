@@ -0,0 +1,81 @@
+namespace Microsoft.EntityFrameworkCore.Storage.ValueConversion
+{
+    // Lets the save interceptor find the encryptor behind a property
+    internal interface IAesGcmSivValueConverter
+    {
+        AesGcmSivColumnEncryptor Encryptor { get; }
+    }
+
+    /// <summary>
+    /// Stores a string property encrypted with an <see cref="AesGcmSivColumnEncryptor"/>.
+    /// </summary>
+    public sealed class AesGcmSivStringConverter : ValueConverter<string, byte[]>, IAesGcmSivValueConverter
+    {
+        /// <summary>
+        /// Initializes a converter.
+        /// </summary>
+        /// <param name="encryptor">The encryptor.</param>
+        /// <param name="mappingHints">Hints for the column type, if any.</param>
+        /// <exception cref="ArgumentNullException"><paramref name="encryptor"/> is null.</exception>
+        public AesGcmSivStringConverter(AesGcmSivColumnEncryptor encryptor, ConverterMappingHints? mappingHints = null)
+            : base(value => encryptor.TakeOrEncrypt(value), stored => encryptor.DecryptString(stored), mappingHints)
+        {
+            ArgumentNullException.ThrowIfNull(encryptor);
+            Encryptor = encryptor;
+        }
+
+        /// <summary>
+        /// Gets the encryptor.
+        /// </summary>
+        public AesGcmSivColumnEncryptor Encryptor { get; }
+    }
+
+    /// <summary>
+    /// Stores a byte array property encrypted with an <see cref="AesGcmSivColumnEncryptor"/>.
+    /// </summary>
+    public sealed class AesGcmSivBytesConverter : ValueConverter<byte[], byte[]>, IAesGcmSivValueConverter
+    {
+        /// <summary>
+        /// Initializes a converter.
+        /// </summary>
+        /// <param name="encryptor">The encryptor.</param>
+        /// <param name="mappingHints">Hints for the column type, if any.</param>
+        /// <exception cref="ArgumentNullException"><paramref name="encryptor"/> is null.</exception>
+        public AesGcmSivBytesConverter(AesGcmSivColumnEncryptor encryptor, ConverterMappingHints? mappingHints = null)
+            : base(value => encryptor.TakeOrEncrypt(value), stored => encryptor.Decrypt(stored), mappingHints)
+        {
+            ArgumentNullException.ThrowIfNull(encryptor);
+            Encryptor = encryptor;
+        }
+
+        /// <summary>
+        /// Gets the encryptor.
+        /// </summary>
+        public AesGcmSivColumnEncryptor Encryptor { get; }
+    }
+
+    /// <summary>
+    /// Stores an <see cref="AesGcmSivLazyDecrypted"/> property encrypted with an
+    /// <see cref="AesGcmSivColumnEncryptor"/>, decrypting it only when it is read.
+    /// </summary>
+    public sealed class AesGcmSivLazyConverter : ValueConverter<AesGcmSivLazyDecrypted, byte[]>, IAesGcmSivValueConverter
+    {
+        /// <summary>
+        /// Initializes a converter.
+        /// </summary>
+        /// <param name="encryptor">The encryptor.</param>
+        /// <param name="mappingHints">Hints for the column type, if any.</param>
+        /// <exception cref="ArgumentNullException"><paramref name="encryptor"/> is null.</exception>
+        public AesGcmSivLazyConverter(AesGcmSivColumnEncryptor encryptor, ConverterMappingHints? mappingHints = null)
+            : base(value => encryptor.TakeOrEncrypt(value), stored => encryptor.DecryptLazily(stored), mappingHints)
+        {
+            ArgumentNullException.ThrowIfNull(encryptor);
+            Encryptor = encryptor;
+        }
+
+        /// <summary>
+        /// Gets the encryptor.
+        /// </summary>
+        public AesGcmSivColumnEncryptor Encryptor { get; }
+    }
+}
@@ -0,0 +1,232 @@
+using System.Buffers.Binary;
+using System.Collections.Concurrent;
+using System.Security.Cryptography;
+using System.Text;
+
+namespace Confluent.Kafka
+{
+    /// <summary>
+    /// AES-GCM-SIV encryption of Kafka record values, one record at a time as a Confluent.Kafka
+    /// serializer and deserializer, or a whole producer batch or consumer poll with one native call.
+    /// </summary>
+    /// <remarks>
+    /// An encrypted value is laid out as nonce || ciphertext || tag, <see cref="AesGcmSiv.SealOverhead"/>
+    /// bytes longer than the plaintext, as <see cref="AesGcmSiv.Seal(byte[], byte[], byte[], byte[])"/>
+    /// writes it. Null values, which Kafka uses as tombstones, are passed through unencrypted.
+    ///
+    /// Nonces are not drawn at random per record. Each instance picks a random base nonce once, and
+    /// record <c>n</c> of the instance is sealed under that nonce with its last 8 bytes XORed with
+    /// <c>n</c>, as <see cref="AesGcmSiv.EncryptBatch(ReadOnlySpan{AesGcmSivBatchItem}, byte[], ulong)"/>
+    /// derives them; a batch reserves its run of sequence numbers with one atomic add. The nonce is
+    /// stored in the value, so consumers need no state. Partition and offset cannot feed the nonce,
+    /// because the broker assigns the offset only after the value is sealed.
+    ///
+    /// With <c>bindTopic</c>, the topic name is the associated data of every value, so a value copied
+    /// to another topic does not decrypt there; mirroring to a renamed topic then needs the same
+    /// setting off. One instance can be shared across producers, consumers and threads.
+    /// </remarks>
+    public sealed class AesGcmSivKafkaSerializer : ISerializer<byte[]>, IDeserializer<byte[]>
+    {
+        private const int NonceSize = 12;
+        private const int TagSize = 16;
+
+        private readonly AesGcmSiv _aesGcmSiv;
+        private readonly bool _bindTopic;
+        private readonly byte[] _baseNonce = new byte[NonceSize];
+        private readonly ConcurrentDictionary<string, byte[]> _topics = new();
+        private long _sequence;
+
+        /// <summary>
+        /// Initializes a serializer.
+        /// </summary>
+        /// <param name="aesGcmSiv">The key values are encrypted under. Must stay undisposed while in use.</param>
+        /// <param name="bindTopic">Whether each value is authenticated together with its topic name.</param>
+        /// <exception cref="ArgumentNullException"><paramref name="aesGcmSiv"/> is null.</exception>
+        public AesGcmSivKafkaSerializer(AesGcmSiv aesGcmSiv, bool bindTopic = true)
+        {
+            ArgumentNullException.ThrowIfNull(aesGcmSiv);
+            _aesGcmSiv = aesGcmSiv;
+            _bindTopic = bindTopic;
+            AesGcmSiv.GenerateNonce(_baseNonce);
+        }
+
+        /// <summary>
+        /// Encrypts one record value, for use as a producer's value serializer.
+        /// </summary>
+        /// <param name="data">The plaintext value, or null for a tombstone.</param>
+        /// <param name="context">The record's topic and component.</param>
+        /// <returns>The encrypted value, or null.</returns>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public byte[]? Serialize(byte[]? data, SerializationContext context)
+        {
+            if (data == null)
+                return null;
+            var value = new byte[data.Length + AesGcmSiv.SealOverhead];
+            Span<byte> nonce = value.AsSpan(0, NonceSize);
+            WriteNonce(nonce, Reserve(1));
+            _aesGcmSiv.Encrypt(
+                nonce, data,
+                value.AsSpan(NonceSize, data.Length),
+                value.AsSpan(NonceSize + data.Length, TagSize),
+                AssociatedData(context.Topic));
+            return value;
+        }
+
+        /// <summary>
+        /// Verifies and decrypts one record value, for use as a consumer's value deserializer.
+        /// </summary>
+        /// <param name="data">The encrypted value.</param>
+        /// <param name="isNull">Whether the value is null.</param>
+        /// <param name="context">The record's topic and component.</param>
+        /// <returns>The plaintext value, or null.</returns>
+        /// <exception cref="CryptographicException">The value is too short or does not authenticate.</exception>
+        public byte[]? Deserialize(ReadOnlySpan<byte> data, bool isNull, SerializationContext context)
+        {
+            if (isNull)
+                return null;
+            if (data.Length < AesGcmSiv.SealOverhead)
+                throw new CryptographicException($"An encrypted value must be at least {AesGcmSiv.SealOverhead} bytes.");
+            int length = data.Length - AesGcmSiv.SealOverhead;
+            var plaintext = new byte[length];
+            _aesGcmSiv.Decrypt(
+                data.Slice(0, NonceSize),
+                data.Slice(NonceSize, length),
+                data.Slice(NonceSize + length, TagSize),
+                plaintext,
+                AssociatedData(context.Topic));
+            return plaintext;
+        }
+
+        /// <summary>
+        /// Encrypts the values of a batch of messages for <paramref name="topic"/> with a single native
+        /// call, replacing each <see cref="Message{TKey, TValue}.Value"/> with its encrypted form. The
+        /// messages are then produced with the plain byte array serializer.
+        /// </summary>
+        /// <typeparam name="TKey">The message key type; keys are not encrypted.</typeparam>
+        /// <param name="topic">The topic the messages will be produced to.</param>
+        /// <param name="messages">The messages. Null values are left as they are.</param>
+        /// <exception cref="ArgumentNullException"><paramref name="topic"/> or <paramref name="messages"/> is null.</exception>
+        /// <exception cref="CryptographicException">Encryption failed; no value has been replaced.</exception>
+        public void EncryptBatch<TKey>(string topic, IReadOnlyList<Message<TKey, byte[]>> messages)
+        {
+            ArgumentNullException.ThrowIfNull(topic);
+            ArgumentNullException.ThrowIfNull(messages);
+            byte[] associatedData = AssociatedData(topic);
+            var values = new byte[messages.Count][];
+            int count = 0;
+            foreach (Message<TKey, byte[]> message in messages)
+            {
+                if (message.Value != null)
+                    count++;
+            }
+            if (count == 0)
+                return;
+
+            ulong sequence = Reserve(count);
+            using (var batch = new AesGcmSivBatch(_aesGcmSiv, count))
+            {
+                for (int i = 0; i < messages.Count; i++)
+                {
+                    byte[]? plaintext = messages[i].Value;
+                    if (plaintext == null)
+                        continue;
+                    byte[] value = values[i] = new byte[plaintext.Length + AesGcmSiv.SealOverhead];
+                    WriteNonce(value.AsSpan(0, NonceSize), sequence++);
+                    batch.Add(
+                        value.AsMemory(0, NonceSize),
+                        plaintext,
+                        value.AsMemory(NonceSize, plaintext.Length),
+                        value.AsMemory(NonceSize + plaintext.Length, TagSize),
+                        associatedData);
+                }
+                batch.Encrypt();
+            }
+
+            for (int i = 0; i < messages.Count; i++)
+            {
+                if (values[i] != null)
+                    messages[i].Value = values[i];
+            }
+        }
+
+        /// <summary>
+        /// Verifies and decrypts the values of consumed messages with a single native call, replacing
+        /// each <see cref="Message{TKey, TValue}.Value"/> with its plaintext. The messages must have
+        /// been consumed with the plain byte array deserializer.
+        /// </summary>
+        /// <typeparam name="TKey">The message key type.</typeparam>
+        /// <param name="results">The consumed messages, from any topics. Null values are left as they are.</param>
+        /// <param name="succeeded">
+        /// Receives, for each message, whether its value authenticated. Must be at least as long as
+        /// <paramref name="results"/>. A value that does not authenticate, or is too short to be
+        /// encrypted, is set to null.
+        /// </param>
+        /// <returns>The number of values that failed to authenticate.</returns>
+        /// <exception cref="ArgumentNullException"><paramref name="results"/> is null.</exception>
+        /// <exception cref="ArgumentException"><paramref name="succeeded"/> is too small.</exception>
+        /// <exception cref="CryptographicException">Decryption failed for a reason other than authentication.</exception>
+        public int DecryptBatch<TKey>(IReadOnlyList<ConsumeResult<TKey, byte[]>> results, Span<bool> succeeded)
+        {
+            ArgumentNullException.ThrowIfNull(results);
+            if (succeeded.Length < results.Count)
+                throw new ArgumentException("Result buffer is too small.", nameof(succeeded));
+
+            var plaintexts = new byte[results.Count][];
+            var batched = new int[results.Count];
+            int count = 0;
+            int failures = 0;
+            using (var batch = new AesGcmSivBatch(_aesGcmSiv, Math.Max(results.Count, 1)))
+            {
+                for (int i = 0; i < results.Count; i++)
+                {
+                    byte[]? value = results[i].Message.Value;
+                    succeeded[i] = true;
+                    if (value == null)
+                        continue;
+                    if (value.Length < AesGcmSiv.SealOverhead)
+                    {
+                        succeeded[i] = false;
+                        failures++;
+                        continue;
+                    }
+                    int length = value.Length - AesGcmSiv.SealOverhead;
+                    byte[] plaintext = plaintexts[i] = new byte[length];
+                    batch.Add(
+                        value.AsMemory(0, NonceSize),
+                        value.AsMemory(NonceSize, length),
+                        plaintext,
+                        value.AsMemory(NonceSize + length, TagSize),
+                        AssociatedData(results[i].Topic));
+                    batched[count++] = i;
+                }
+
+                Span<bool> verified = count <= 256 ? stackalloc bool[count] : new bool[count];
+                failures += batch.Decrypt(verified);
+                for (int j = 0; j < count; j++)
+                    succeeded[batched[j]] = verified[j];
+            }
+
+            for (int i = 0; i < results.Count; i++)
+            {
+                if (results[i].Message.Value != null)
+                    results[i].Message.Value = succeeded[i] ? plaintexts[i] : null;
+            }
+            return failures;
+        }
+
+        // Reserves count consecutive sequence numbers and returns the first
+        private ulong Reserve(int count) => (ulong)(Interlocked.Add(ref _sequence, count) - count);
+
+        private void WriteNonce(Span<byte> nonce, ulong sequence)
+        {
+            _baseNonce.CopyTo(nonce);
+            Span<byte> counter = nonce.Slice(NonceSize - 8);
+            BinaryPrimitives.WriteUInt64LittleEndian(counter, BinaryPrimitives.ReadUInt64LittleEndian(counter) ^ sequence);
+        }
+
+        private byte[] AssociatedData(string? topic) =>
+            _bindTopic && topic != null
+                ? _topics.GetOrAdd(topic, static t => Encoding.UTF8.GetBytes(t))
+                : Array.Empty<byte>();
+    }
+}
@@ -1,5 +1,9 @@
+using System.Buffers;
+using System.Buffers.Binary;
+using System.Buffers.Text;
+using System.Diagnostics;
+using System.Runtime.CompilerServices;
 using System.Runtime.InteropServices;
-using System.Security.Cryptography;
 
 namespace System.Security.Cryptography
 {
@@ -13,42 +17,107 @@ namespace System.Security.Cryptography
     /// lead to security failures, though it will reveal that the same plaintext was encrypted.
     /// 
     /// Key requirements:
-    /// - Must be exactly 32 bytes (256 bits)
+    /// - Must be exactly 16 bytes (AES-128-GCM-SIV) or 32 bytes (AES-256-GCM-SIV)
     /// - Should be generated using a cryptographically secure random number generator
     /// 
     /// Nonce requirements:
     /// - Must be exactly 12 bytes (96 bits)
     /// - Can be random or structured (e.g., user ID + counter)
     /// - Nonce reuse is safe but reveals message duplication
+    /// 
+    /// The key schedule is expanded once, in the constructor, and kept in native memory until
+    /// <see cref="Dispose"/> frees and clears it. Create one instance per key and reuse it rather
+    /// than constructing one per message. An instance created with
+    /// <see cref="AesGcmSivImplementation.Auto"/> or <see cref="AesGcmSivImplementation.Managed"/>
+    /// also keeps a managed copy of the schedule for the calls it runs without the native library.
+    /// 
+    /// Thread safety: an instance may be shared by any number of threads. The native key schedule
+    /// is never modified after construction and each call keeps its working state locally, so
+    /// concurrent encrypt and decrypt calls need no locking. Settings changed while calls are in
+    /// flight apply to calls that start afterwards. <see cref="Dispose"/> must not be called while
+    /// the instance is still in use.
     /// </remarks>
-    public sealed class AesGcmSiv : IDisposable
+    public sealed unsafe class AesGcmSiv : IDisposable
     {
         private bool _disposed;
-        private readonly byte[] _key;
-
-        // P/Invoke declarations
-        [DllImport("aesgcmsiv", CallingConvention = CallingConvention.Cdecl)]
-        private static extern int aesgcmsiv_encrypt(
-            [In] byte[] key, nuint key_len,
-            [In] byte[] nonce, nuint nonce_len,
-            [In] byte[] plaintext, nuint plaintext_len,
-            [In] byte[]? aad, nuint aad_len,
-            [Out] byte[] ciphertext_out,
-            [Out] byte[] tag_out);
-
-        [DllImport("aesgcmsiv", CallingConvention = CallingConvention.Cdecl)]
-        private static extern int aesgcmsiv_decrypt(
-            [In] byte[] key, nuint key_len,
-            [In] byte[] nonce, nuint nonce_len,
-            [In] byte[] ciphertext, nuint ciphertext_len,
-            [In] byte[]? aad, nuint aad_len,
-            [In] byte[] tag,
-            [Out] byte[] plaintext_out);
+        private readonly SafeAesGcmSivHandle? _context;  // key schedule, built once; null if managed only
+        private readonly AesGcmSivManaged? _managed;  // managed key schedule, for Auto and Managed
+        private int _maxDegreeOfParallelism = 1;
+        private int _nonceCacheSize;
+        private long _streamingThreshold;
+        private long _wideVectorThreshold;
+        private bool _smallMessageFastPath;
+        private readonly bool _providerSelected;  // pinned to OpenSSL by the provider constructor
+        private int _managedMessageThreshold = -1;  // -1 until first needed, then the process default
 
         // Constants
-        private const int KeySize = 32;  // 256 bits
+        private const int KeySize128 = 16;  // 128 bits
+        private const int KeySize256 = 32;  // 256 bits
+        private const int MaxNonceCacheSize = 4096;  // AESGCMSIV_NONCE_CACHE_MAX
         private const int NonceSize = 12; // 96 bits
         private const int TagSize = 16;   // 128 bits
+        private const long MaxMessageFileSize = 1L << 36;  // AESGCMSIV_MAX_INPUT_SIZE
+
+        /// <summary>
+        /// The number of bytes <see cref="Seal(byte[], byte[], byte[], byte[])"/> adds to a plaintext: the 12-byte nonce in front
+        /// and the 16-byte tag behind the ciphertext.
+        /// </summary>
+        public const int SealOverhead = NonceSize + TagSize;
+
+        /// <summary>
+        /// Name of the <see cref="System.Diagnostics.Metrics.Meter"/> that counts calls, bytes and
+        /// authentication failures and times each call by message size. Pass it to a listener, such as
+        /// OpenTelemetry's <c>AddMeter</c>, to collect them; until one subscribes, calls skip the
+        /// measurements entirely.
+        /// </summary>
+        public const string MeterName = "AesGcmSiv.Net";
+
+        // Plaintext and AAD limit of the native _small entry points
+        private const int SmallMessageMaxSize = 256;
+
+        private static readonly byte[] s_emptyBuffer = new byte[1];
+
+        // Tokens of SealBase64Url: base64url(nonce || ciphertext || tag), unpadded. The nonce takes
+        // 16 characters, and the largest plaintext is the one whose token length still fits in an int.
+        private const int Base64UrlNonceLength = 16;
+        private const int MaxBase64UrlPlaintextLength = int.MaxValue / 4 * 3 - SealOverhead;
+        private static readonly SearchValues<byte> s_base64UrlAlphabet =
+            SearchValues.Create("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_"u8);
+
+        // Native worker pool shared by every instance with parallelism enabled.
+        // Created on first use and kept for the life of the process, so it
+        // outlives any context attached to it. On a NUMA machine its workers
+        // are pinned per node and take work on the node holding the input.
+        private const uint AESGCMSIV_POOL_NODE_LOCAL = 1u << 1;
+        private static readonly object s_poolLock = new();
+        private static IntPtr s_sharedPool;
+        private static int s_sharedPoolWorkers;  // 0 for one fewer than the hardware threads
+        private static bool s_sharedPoolOnThreadPool;
+
+        // Lends a .NET thread-pool thread to the hosted shared pool
+        private static readonly Action<IntPtr> s_runPoolWork = static pool => AesGcmSivNative.PoolWork(pool);
+
+        // Smallest message that EncryptAsync and DecryptAsync queue on the
+        // shared pool; shorter ones take less time than the hand-off
+        private const int AsyncPoolMinBytes = 1 << 20;
+
+        // Native key cache behind FromCache, created on first use and kept for
+        // the life of the process
+        private static readonly object s_keyCacheLock = new();
+        private static IntPtr s_keyCache;
+        private static int s_keyCacheCapacity = 4096;
+
+        // Largest message, plaintext and AAD together, that Auto instances
+        // run in managed code by default. Measured on the first call of an
+        // Auto instance with a native context, unless a tuning profile set it
+        // first; -1 until then.
+        private const int CalibrationMinSize = 64;
+        private const int CalibrationMaxSize = 64 * 1024;
+        private static int s_managedMessageThreshold = -1;
+
+        // Whether the native _small entry points are usable, which needs a
+        // hand-written kernel: 0 until first checked, then 1 or -1.
+        private static int s_smallMessageKernel;
 
         // Error codes from native layer
         private const int AESGCMSIV_SUCCESS = 0;
@@ -62,18 +131,761 @@ namespace System.Security.Cryptography
         /// <summary>
         /// Initializes a new instance of the <see cref="AesGcmSiv"/> class with the specified key.
         /// </summary>
-        /// <param name="key">The encryption key. Must be exactly 32 bytes (256 bits).</param>
+        /// <param name="key">
+        /// The encryption key. Must be exactly 16 bytes (AES-128-GCM-SIV) or 32 bytes (AES-256-GCM-SIV).
+        /// </param>
         /// <exception cref="ArgumentNullException"><paramref name="key"/> is null.</exception>
-        /// <exception cref="ArgumentException"><paramref name="key"/> is not exactly 32 bytes.</exception>
+        /// <exception cref="ArgumentException"><paramref name="key"/> is not 16 or 32 bytes.</exception>
         public AesGcmSiv(byte[] key)
+            : this(key ?? throw new ArgumentNullException(nameof(key)), null, null, AesGcmSivImplementation.Native)
+        {
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="AesGcmSiv"/> class with a key held in any memory,
+        /// such as a stack buffer or a slice of a larger one.
+        /// </summary>
+        /// <param name="key">
+        /// The encryption key. Must be exactly 16 bytes (AES-128-GCM-SIV) or 32 bytes (AES-256-GCM-SIV).
+        /// </param>
+        /// <remarks>
+        /// The key is expanded straight into the native context, which lives in locked memory and is
+        /// cleared when the instance is disposed. No managed copy is made, so the caller clears only its
+        /// own buffer.
+        /// </remarks>
+        /// <exception cref="ArgumentException"><paramref name="key"/> is not 16 or 32 bytes.</exception>
+        public AesGcmSiv(ReadOnlySpan<byte> key)
+            : this(key, null, null, AesGcmSivImplementation.Native)
+        {
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="AesGcmSiv"/> class with a key held in any memory,
+        /// choosing whether calls run in the native library or in managed code.
+        /// </summary>
+        /// <param name="key">
+        /// The encryption key. Must be exactly 16 bytes (AES-128-GCM-SIV) or 32 bytes (AES-256-GCM-SIV).
+        /// </param>
+        /// <param name="implementation">Where calls run; see <see cref="AesGcmSivImplementation"/>.</param>
+        /// <remarks>
+        /// With <see cref="AesGcmSivImplementation.Auto"/> or <see cref="AesGcmSivImplementation.Managed"/>
+        /// the managed key schedule is built from <paramref name="key"/> directly; the key itself is never
+        /// copied to the managed heap.
+        /// </remarks>
+        /// <exception cref="ArgumentException"><paramref name="key"/> is not 16 or 32 bytes.</exception>
+        /// <exception cref="ArgumentOutOfRangeException"><paramref name="implementation"/> is not a defined value.</exception>
+        /// <exception cref="PlatformNotSupportedException">
+        /// <paramref name="implementation"/> is <see cref="AesGcmSivImplementation.Managed"/> and
+        /// <see cref="IsManagedImplementationSupported"/> is false.
+        /// </exception>
+        public AesGcmSiv(ReadOnlySpan<byte> key, AesGcmSivImplementation implementation)
+            : this(key, null, null, implementation)
+        {
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="AesGcmSiv"/> class with a key in unmanaged memory,
+        /// such as a buffer returned by a key management service.
+        /// </summary>
+        /// <param name="key">The key's first byte.</param>
+        /// <param name="keyLength">The key's length. Must be exactly 16 or 32.</param>
+        /// <remarks>
+        /// The key is read once, straight into the native context; see <see cref="AesGcmSiv(ReadOnlySpan{byte})"/>.
+        /// </remarks>
+        /// <exception cref="ArgumentNullException"><paramref name="key"/> is null.</exception>
+        /// <exception cref="ArgumentException"><paramref name="keyLength"/> is not 16 or 32.</exception>
+        public AesGcmSiv(byte* key, int keyLength)
+            : this(new ReadOnlySpan<byte>(
+                key == null ? throw new ArgumentNullException(nameof(key)) : key,
+                keyLength is KeySize128 or KeySize256 ? keyLength : throw KeyLengthException(nameof(keyLength))),
+                null, null, AesGcmSivImplementation.Native)
+        {
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="AesGcmSiv"/> class with a key in unmanaged memory
+        /// owned by <paramref name="key"/>, which is kept alive while the key is read.
+        /// </summary>
+        /// <param name="key">A handle to memory whose first <paramref name="keyLength"/> bytes are the key.</param>
+        /// <param name="keyLength">The key's length. Must be exactly 16 or 32.</param>
+        /// <remarks>
+        /// The key is read once, straight into the native context; see <see cref="AesGcmSiv(ReadOnlySpan{byte})"/>.
+        /// The handle is not owned by the instance and may be released once the constructor returns.
+        /// </remarks>
+        /// <exception cref="ArgumentNullException"><paramref name="key"/> is null.</exception>
+        /// <exception cref="ArgumentException"><paramref name="key"/> is invalid, or <paramref name="keyLength"/> is not 16 or 32.</exception>
+        /// <exception cref="ObjectDisposedException"><paramref name="key"/> has been closed.</exception>
+        public AesGcmSiv(SafeHandle key, int keyLength)
+        {
+            ArgumentNullException.ThrowIfNull(key);
+            if (keyLength != KeySize128 && keyLength != KeySize256)
+                throw KeyLengthException(nameof(keyLength));
+            if (key.IsInvalid)
+                throw new ArgumentException("The handle is invalid.", nameof(key));
+
+            bool added = false;
+            try
+            {
+                key.DangerousAddRef(ref added);
+                var keySpan = new ReadOnlySpan<byte>((void*)key.DangerousGetHandle(), keyLength);
+                CreateSchedules(keySpan, null, null, AesGcmSivImplementation.Native, out _context, out _managed);
+            }
+            finally
+            {
+                if (added)
+                    key.DangerousRelease();
+            }
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="AesGcmSiv"/> class with the specified key,
+        /// choosing whether calls run in the native library or in managed code.
+        /// </summary>
+        /// <param name="key">
+        /// The encryption key. Must be exactly 16 bytes (AES-128-GCM-SIV) or 32 bytes (AES-256-GCM-SIV).
+        /// </param>
+        /// <param name="implementation">Where calls run; see <see cref="AesGcmSivImplementation"/>.</param>
+        /// <remarks>
+        /// The managed implementation suits messages of a few hundred bytes, where the fixed cost of a
+        /// native call is most of the work, and deployments that cannot ship the native library. It
+        /// reads the caller's buffers directly and allocates nothing per call except for the vectored
+        /// overloads, which gather their segments.
+        /// </remarks>
+        /// <exception cref="ArgumentNullException"><paramref name="key"/> is null.</exception>
+        /// <exception cref="ArgumentException"><paramref name="key"/> is not 16 or 32 bytes.</exception>
+        /// <exception cref="ArgumentOutOfRangeException"><paramref name="implementation"/> is not a defined value.</exception>
+        /// <exception cref="PlatformNotSupportedException">
+        /// <paramref name="implementation"/> is <see cref="AesGcmSivImplementation.Managed"/> and
+        /// <see cref="IsManagedImplementationSupported"/> is false.
+        /// </exception>
+        public AesGcmSiv(byte[] key, AesGcmSivImplementation implementation)
+            : this(key ?? throw new ArgumentNullException(nameof(key)), null, null, implementation)
+        {
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="AesGcmSiv"/> class with the specified key, using
+        /// the cipher of a chosen OpenSSL provider, for example a FIPS provider or a hardware offload
+        /// engine.
+        /// </summary>
+        /// <param name="key">
+        /// The encryption key. Must be exactly 16 bytes (AES-128-GCM-SIV) or 32 bytes (AES-256-GCM-SIV).
+        /// </param>
+        /// <param name="providerName">
+        /// The name of an OpenSSL provider to load, such as <c>"fips"</c>, or null to use the providers
+        /// already loaded.
+        /// </param>
+        /// <param name="propertyQuery">
+        /// An OpenSSL property query the cipher must match, such as <c>"fips=yes"</c> or
+        /// <c>"provider=myengine"</c>, or null for no constraint.
+        /// </param>
+        /// <remarks>
+        /// When either <paramref name="providerName"/> or <paramref name="propertyQuery"/> is given the
+        /// instance always goes through OpenSSL, even where <see cref="BackendName"/> reports a hardware
+        /// kernel, and <see cref="SmallMessageFastPath"/> has no effect. Passing null for both is the
+        /// same as <see cref="AesGcmSiv(byte[])"/>. The provider is loaded into the library's own OpenSSL
+        /// context and stays loaded until the instance is disposed.
+        /// </remarks>
+        /// <exception cref="ArgumentNullException"><paramref name="key"/> is null.</exception>
+        /// <exception cref="ArgumentException"><paramref name="key"/> is not 16 or 32 bytes.</exception>
+        /// <exception cref="CryptographicException">
+        /// The provider could not be loaded, or no AES-GCM-SIV cipher matches the query.
+        /// </exception>
+        public AesGcmSiv(byte[] key, string? providerName, string? propertyQuery)
+            : this(key ?? throw new ArgumentNullException(nameof(key)), providerName, propertyQuery, AesGcmSivImplementation.Native)
+        {
+        }
+
+        private AesGcmSiv(ReadOnlySpan<byte> key, string? providerName, string? propertyQuery, AesGcmSivImplementation implementation)
+        {
+            if (key.Length != KeySize128 && key.Length != KeySize256)
+                throw KeyLengthException(nameof(key));
+            CreateSchedules(key, providerName, propertyQuery, implementation, out _context, out _managed);
+            _providerSelected = providerName != null || propertyQuery != null;
+        }
+
+        // Builds the native context and, for Auto and Managed, the managed
+        // schedule; shared by the constructors so that each can keep its key
+        // where the caller has it
+        private static void CreateSchedules(
+            ReadOnlySpan<byte> key, string? providerName, string? propertyQuery, AesGcmSivImplementation implementation,
+            out SafeAesGcmSivHandle? nativeContext, out AesGcmSivManaged? managedSchedule)
+        {
+            nativeContext = null;
+            managedSchedule = null;
+            if (implementation < AesGcmSivImplementation.Native || implementation > AesGcmSivImplementation.Managed)
+                throw new ArgumentOutOfRangeException(nameof(implementation));
+            if (implementation == AesGcmSivImplementation.Managed && !AesGcmSivManaged.IsSupported)
+                throw new PlatformNotSupportedException(
+                    "The managed AES-GCM-SIV implementation needs AES-NI and PCLMULQDQ, or the ARMv8 AES and PMULL instructions.");
+
+            bool managed = implementation != AesGcmSivImplementation.Native && AesGcmSivManaged.IsSupported;
+            if (implementation != AesGcmSivImplementation.Managed)
+            {
+                SafeAesGcmSivHandle context;
+                int result;
+                try
+                {
+                    result = SafeAesGcmSivHandle.Create(key, providerName, propertyQuery, out context);
+                }
+                catch (Exception e) when (managed && e is DllNotFoundException or EntryPointNotFoundException or BadImageFormatException)
+                {
+                    // Auto without a loadable library runs everything managed
+                    result = AESGCMSIV_SUCCESS;
+                    context = null!;
+                }
+                if (result != AESGCMSIV_SUCCESS)
+                {
+                    context.Dispose();
+                    if (providerName != null || propertyQuery != null)
+                        throw new CryptographicException(
+                            $"No AES-GCM-SIV cipher is available for provider '{providerName}' and properties '{propertyQuery}' (error code: {result})");
+                    throw new CryptographicException($"Key setup failed with error code: {result}");
+                }
+                nativeContext = context;
+            }
+            if (managed)
+                managedSchedule = new AesGcmSivManaged(key);
+        }
+
+        private AesGcmSiv(SafeAesGcmSivHandle context)
+        {
+            _context = context;
+        }
+
+        // Copies template's schedules, through aesgcmsiv_ctx_clone natively,
+        // and its settings but for the nonce cache, which the clone starts
+        // without
+        private AesGcmSiv(AesGcmSiv template)
+        {
+            if (template._context != null)
+            {
+                int result = SafeAesGcmSivHandle.Clone(template._context, out SafeAesGcmSivHandle context);
+                if (result != AESGCMSIV_SUCCESS)
+                {
+                    context.Dispose();
+                    throw new CryptographicException($"Cloning the key context failed with error code: {result}");
+                }
+                _context = context;
+            }
+            if (template._managed != null)
+                _managed = new AesGcmSivManaged(template._managed);
+            _providerSelected = template._providerSelected;
+            _maxDegreeOfParallelism = template._maxDegreeOfParallelism;
+            _streamingThreshold = template._streamingThreshold;
+            _wideVectorThreshold = template._wideVectorThreshold;
+            _smallMessageFastPath = template._smallMessageFastPath;
+            _managedMessageThreshold = template._managedMessageThreshold;
+        }
+
+        /// <summary>
+        /// Creates an instance for the same key with its own key schedule, for code that wants a private
+        /// instance per thread or per connection.
+        /// </summary>
+        /// <returns>A new instance, independent of this one, which may be disposed first.</returns>
+        /// <remarks>
+        /// The expanded key schedule is copied rather than computed again, and on OpenSSL the keyed cipher
+        /// state is copied without fetching the cipher again, so a clone takes microseconds. It runs the
+        /// same implementation, bound to the same provider, with the same settings, except that
+        /// <see cref="NonceCacheSize"/> starts at 0.
+        /// </remarks>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="CryptographicException">The native context could not be copied.</exception>
+        public AesGcmSiv Clone()
+        {
+            ThrowIfDisposed();
+            return new AesGcmSiv(this);
+        }
+
+        private static void ValidateKey(byte[] key)
         {
             if (key == null)
                 throw new ArgumentNullException(nameof(key));
-            if (key.Length != KeySize)
-                throw new ArgumentException($"Key must be exactly {KeySize} bytes (256 bits).", nameof(key));
+            if (key.Length != KeySize128 && key.Length != KeySize256)
+                throw KeyLengthException(nameof(key));
+        }
+
+        private static ArgumentException KeyLengthException(string paramName) =>
+            new ArgumentException(
+                $"Key must be exactly {KeySize128} bytes (128 bits) or {KeySize256} bytes (256 bits).", paramName);
+
+        /// <summary>
+        /// Creates an instance for <paramref name="key"/> from a process-wide native cache of expanded
+        /// keys, for services that construct an instance per request from a working set of keys.
+        /// </summary>
+        /// <param name="key">
+        /// The encryption key. Must be exactly 16 bytes (AES-128-GCM-SIV) or 32 bytes (AES-256-GCM-SIV).
+        /// </param>
+        /// <returns>
+        /// A new instance, as <see cref="AesGcmSiv(byte[])"/> would create, that owns a copy of the cached
+        /// key schedule. Dispose it as usual; the cached entry is not affected.
+        /// </returns>
+        /// <remarks>
+        /// The cache holds up to <see cref="KeyCacheCapacity"/> keys and evicts the least recently used
+        /// one when full. Entries are found by a hash keyed with a secret drawn per process, and are
+        /// cleared from memory when evicted or by <see cref="ClearKeyCache"/>.
+        /// </remarks>
+        /// <exception cref="ArgumentNullException"><paramref name="key"/> is null.</exception>
+        /// <exception cref="ArgumentException"><paramref name="key"/> is not 16 or 32 bytes.</exception>
+        /// <exception cref="CryptographicException">The native library failed to create the context.</exception>
+        public static AesGcmSiv FromCache(byte[] key)
+        {
+            ValidateKey(key);
+            int result = SafeAesGcmSivHandle.CreateFromCache(GetKeyCache(), key, out SafeAesGcmSivHandle context);
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                context.Dispose();
+                throw new CryptographicException($"Key setup failed with error code: {result}");
+            }
+            return new AesGcmSiv(context);
+        }
+
+        /// <summary>
+        /// Gets or sets the most keys <see cref="FromCache"/> keeps expanded. The default is 4096, a
+        /// little under 2 MiB of native memory; 0 turns caching off.
+        /// </summary>
+        /// <remarks>Lowering the capacity evicts the least recently used keys at once.</remarks>
+        /// <exception cref="ArgumentOutOfRangeException">The value is negative.</exception>
+        /// <exception cref="CryptographicException">The native library rejected the capacity.</exception>
+        public static int KeyCacheCapacity
+        {
+            get => Volatile.Read(ref s_keyCacheCapacity);
+            set
+            {
+                if (value < 0)
+                    throw new ArgumentOutOfRangeException(nameof(value), "Value must not be negative.");
+                lock (s_keyCacheLock)
+                {
+                    if (s_keyCache != IntPtr.Zero)
+                    {
+                        int result = AesGcmSivNative.KeyCacheSetCapacity(s_keyCache, (nuint)value);
+                        if (result != AESGCMSIV_SUCCESS)
+                            throw new CryptographicException($"Resizing the key cache failed with error code: {result}");
+                    }
+                    Volatile.Write(ref s_keyCacheCapacity, value);
+                }
+            }
+        }
+
+        /// <summary>
+        /// Evicts every key from the <see cref="FromCache"/> cache and clears it from memory, for
+        /// example after keys have been rotated or revoked. Existing instances keep working.
+        /// </summary>
+        public static void ClearKeyCache()
+        {
+            IntPtr cache = Volatile.Read(ref s_keyCache);
+            if (cache != IntPtr.Zero)
+                AesGcmSivNative.KeyCacheClear(cache);
+        }
+
+        internal static IntPtr GetKeyCache()
+        {
+            IntPtr cache = Volatile.Read(ref s_keyCache);
+            if (cache != IntPtr.Zero)
+                return cache;
+
+            AesGcmSivNative.EnsureLoaded();
+            lock (s_keyCacheLock)
+            {
+                if (s_keyCache == IntPtr.Zero)
+                {
+                    int result = AesGcmSivNative.KeyCacheNew((nuint)s_keyCacheCapacity, &cache);
+                    if (result != AESGCMSIV_SUCCESS)
+                        throw new CryptographicException($"Creating the key cache failed with error code: {result}");
+                    Volatile.Write(ref s_keyCache, cache);
+                }
+                return s_keyCache;
+            }
+        }
+
+        /// <summary>
+        /// Gets whether this process can run the managed implementation selected by
+        /// <see cref="AesGcmSivImplementation.Auto"/> and <see cref="AesGcmSivImplementation.Managed"/>,
+        /// which needs an x86 processor with AES-NI and PCLMULQDQ or an Arm64 one with the AES and PMULL
+        /// instructions.
+        /// </summary>
+        public static bool IsManagedImplementationSupported => AesGcmSivManaged.IsSupported;
+
+        /// <summary>
+        /// Gets the name of the native implementation selected for this process,
+        /// for example <c>"vaes-avx512"</c>, <c>"aesni"</c>, <c>"armv8-crypto"</c>, <c>"bitsliced-ct64"</c> or <c>"openssl"</c>.
+        /// The name changes after <see cref="SelectBackend"/>.
+        /// </summary>
+        /// <exception cref="CryptographicException">The native library could not report its backend.</exception>
+        public static string BackendName
+        {
+            get
+            {
+                GetBackend(out IntPtr name, out _);
+                return Marshal.PtrToStringAnsi(name) ?? string.Empty;
+            }
+        }
+
+        /// <summary>
+        /// Switches the native library to another of its implementations, for comparing them in one
+        /// process. All of them share the native validation, batching and context code, so only the
+        /// cipher work differs.
+        /// </summary>
+        /// <param name="name">
+        /// A name <see cref="BackendName"/> can report, such as <c>"aesni"</c>, <c>"bitsliced-ct64"</c> or
+        /// <c>"openssl"</c>, or null for the one chosen when the library was loaded.
+        /// </param>
+        /// <remarks>
+        /// Instances created afterwards use the new choice; existing ones keep theirs. <c>"mock"</c> is a
+        /// kernel that does no encryption at all, present only in native builds configured with
+        /// <c>AESGCMSIV_MOCK_KERNEL</c>, for measuring everything but the cipher. Setting the
+        /// <c>AESGCMSIV_BACKEND</c> environment variable makes the same choice when the library is loaded.
+        /// </remarks>
+        /// <exception cref="ArgumentException">The native library cannot run <paramref name="name"/> on this processor.</exception>
+        /// <exception cref="DllNotFoundException">The native library could not be loaded.</exception>
+        public static void SelectBackend(string? name)
+        {
+            AesGcmSivNative.EnsureLoaded();
+            if (AesGcmSivNative.Select(name) != AESGCMSIV_SUCCESS)
+                throw new ArgumentException($"The native library has no backend '{name}' this processor can run.", nameof(name));
+            s_smallMessageKernel = 0;
+        }
+
+        // Whether a BackendName means the general-purpose crypto library rather
+        // than one of the native kernels
+        internal static bool IsLibraryBackend(string backend) => backend == "openssl";
+
+        /// <summary>
+        /// Gets the CPU features the native library detected when it was loaded.
+        /// </summary>
+        /// <exception cref="CryptographicException">The native library could not report its backend.</exception>
+        public static AesGcmSivCpuFeatures CpuFeatures
+        {
+            get
+            {
+                GetBackend(out _, out uint features);
+                return (AesGcmSivCpuFeatures)features;
+            }
+        }
+
+        /// <summary>
+        /// Gets whether the native library was built with the compressor <paramref name="compression"/>,
+        /// which <see cref="AesGcmSivStream.Compression"/> needs. <see cref="AesGcmSivCompression.None"/>
+        /// is always supported.
+        /// </summary>
+        /// <param name="compression">The compressor to look for.</param>
+        /// <returns><see langword="true"/> if streams can be written with <paramref name="compression"/>.</returns>
+        /// <exception cref="DllNotFoundException">The native library could not be loaded.</exception>
+        public static bool IsCompressionSupported(AesGcmSivCompression compression)
+        {
+            if (compression == AesGcmSivCompression.None)
+                return true;
+            AesGcmSivNative.EnsureLoaded();
+            return AesGcmSivNative.CompressionSupported((uint)compression) != 0;
+        }
+
+        /// <summary>
+        /// Loads the native library from <paramref name="libraryPath"/> instead of the default
+        /// <c>aesgcmsiv</c> library, for example to compare an OpenSSL-only build with a kernel build,
+        /// or to measure call overhead against the mock library.
+        /// </summary>
+        /// <param name="libraryPath">Path of a library exporting the functions in <c>aesgcmsiv.h</c>.</param>
+        /// <remarks>
+        /// The library is bound once per process, so this must be called before any other member of
+        /// this class is used. Setting the <c>AESGCMSIV_NATIVE_LIBRARY</c> environment variable to a
+        /// path has the same effect without a code change.
+        /// </remarks>
+        /// <exception cref="ArgumentNullException"><paramref name="libraryPath"/> is null.</exception>
+        /// <exception cref="InvalidOperationException">A native library is already loaded.</exception>
+        /// <exception cref="DllNotFoundException">The library could not be loaded.</exception>
+        /// <exception cref="EntryPointNotFoundException">The library lacks one of the required exports.</exception>
+        public static void LoadNativeLibrary(string libraryPath)
+        {
+            if (libraryPath == null)
+                throw new ArgumentNullException(nameof(libraryPath));
+            AesGcmSivNative.Load(libraryPath);
+        }
+
+        /// <summary>
+        /// Loads the native library and does its one-time setup now, so the first encryption or
+        /// decryption does not pay for it.
+        /// </summary>
+        /// <param name="options">Initialization options.</param>
+        /// <remarks>
+        /// Optional; without it the same work happens on first use. This binds the native library like
+        /// any other first use, so call <see cref="LoadNativeLibrary"/> beforehand to use a different one.
+        /// </remarks>
+        /// <exception cref="DllNotFoundException">The native library could not be loaded.</exception>
+        /// <exception cref="CryptographicException">Native initialization failed.</exception>
+        public static void Preload(AesGcmSivPreloadOptions options = AesGcmSivPreloadOptions.None)
+        {
+            AesGcmSivNative.EnsureLoaded();
+            int result = AesGcmSivNative.Init((uint)options);
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                throw new CryptographicException($"Native initialization failed with error code: {result}");
+            }
+        }
+
+        /// <summary>
+        /// Gets or sets the maximum number of threads one call may use to encrypt or decrypt a large message.
+        /// </summary>
+        /// <remarks>
+        /// The default of 1 keeps every call on the calling thread; -1 uses one thread per processor.
+        /// Any other value runs the extra work on a pool of worker threads shared by all instances
+        /// rather than on threads started per call, and also spreads batches of more than a few dozen
+        /// items across that pool. Only messages of several megabytes are split, and the output does
+        /// not depend on this setting.
+        /// </remarks>
+        /// <exception cref="ArgumentOutOfRangeException">The value is 0 or less than -1.</exception>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        public int MaxDegreeOfParallelism
+        {
+            get => _maxDegreeOfParallelism;
+            set
+            {
+                if (value == 0 || value < -1)
+                    throw new ArgumentOutOfRangeException(nameof(value), "Value must be -1 or a positive number.");
+                ThrowIfDisposed();
+                if (_context == null)
+                {
+                    _maxDegreeOfParallelism = value;
+                    return;
+                }
+
+                // -1 maps to the native "one per hardware thread"
+                IntPtr pool = value == 1 ? IntPtr.Zero : GetSharedPool();
+                int result;
+                using (var context = new SafeAesGcmSivHandle.Lease(_context))
+                {
+                    result = AesGcmSivNative.CtxSetThreads(context.Pointer, value == -1 ? 0u : (uint)value);
+                    if (result == AESGCMSIV_SUCCESS)
+                        result = AesGcmSivNative.CtxSetPool(context.Pointer, pool);
+                }
+                if (result != AESGCMSIV_SUCCESS)
+                {
+                    throw new CryptographicException($"Setting the thread count failed with error code: {result}");
+                }
+                _maxDegreeOfParallelism = value;
+            }
+        }
+
+        /// <summary>
+        /// Gets or sets how many distinct nonces the instance keeps the derived per-nonce keys for, so a
+        /// call that repeats a recent nonce skips key derivation.
+        /// </summary>
+        /// <remarks>
+        /// The default of 0 keeps no cache. Enable it when nonces repeat by design, for example one per
+        /// shard and epoch, where it takes about a third off a short message; with nonces that never
+        /// repeat it only adds a copy. The size is rounded up to a power of two, at most 4096, and the
+        /// cached keys are cleared when the cache is resized or the instance disposed. Set it before the
+        /// instance is shared between threads. Has no effect on the managed or OpenSSL paths.
+        /// </remarks>
+        /// <exception cref="ArgumentOutOfRangeException">The value is negative or greater than 4096.</exception>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        public int NonceCacheSize
+        {
+            get => _nonceCacheSize;
+            set
+            {
+                ArgumentOutOfRangeException.ThrowIfNegative(value);
+                ArgumentOutOfRangeException.ThrowIfGreaterThan(value, MaxNonceCacheSize);
+                ThrowIfDisposed();
+                if (_context != null)
+                {
+                    int result;
+                    using (var context = new SafeAesGcmSivHandle.Lease(_context))
+                    {
+                        result = AesGcmSivNative.CtxSetNonceCache(context.Pointer, (nuint)value);
+                    }
+                    if (result != AESGCMSIV_SUCCESS)
+                    {
+                        throw new CryptographicException($"Setting the nonce cache failed with error code: {result}");
+                    }
+                }
+                _nonceCacheSize = value;
+            }
+        }
+
+        /// <summary>
+        /// Gets or sets the message size, in bytes, from which the output is written with non-temporal
+        /// stores that bypass the CPU cache.
+        /// </summary>
+        /// <remarks>
+        /// The default of 0 never streams. Set it for multi-gigabyte outputs, such as backups, that this
+        /// process writes once and does not read back, so they do not evict the rest of the process's
+        /// working set from the last-level cache; reading such output back soon afterwards is slower.
+        /// Output that is not 16-byte aligned is written normally. Has no effect on the managed or
+        /// OpenSSL paths or on CPUs other than x86.
+        /// </remarks>
+        /// <exception cref="ArgumentOutOfRangeException">The value is negative.</exception>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        public long StreamingThreshold
+        {
+            get => _streamingThreshold;
+            set
+            {
+                ArgumentOutOfRangeException.ThrowIfNegative(value);
+                ThrowIfDisposed();
+                if (_context != null)
+                {
+                    int result;
+                    using (var context = new SafeAesGcmSivHandle.Lease(_context))
+                    {
+                        result = AesGcmSivNative.CtxSetStreaming(context.Pointer, (nuint)value);
+                    }
+                    if (result != AESGCMSIV_SUCCESS)
+                    {
+                        throw new CryptographicException($"Setting the streaming threshold failed with error code: {result}");
+                    }
+                }
+                _streamingThreshold = value;
+            }
+        }
+
+        /// <summary>
+        /// Gets or sets the message size, in bytes, below which the 128-bit AES-NI kernel runs in place of
+        /// the 512-bit one.
+        /// </summary>
+        /// <remarks>
+        /// The default of 0 always runs the widest kernel. Heavy 512-bit work lowers the clock speed of the
+        /// core, and on some CPUs its sibling, for a while after it stops; a service that encrypts short
+        /// messages between other work can lose more to that than it gains. <see cref="long.MaxValue"/>
+        /// never runs the 512-bit kernel. Batches are decided by their mean message length. Has no effect
+        /// unless the native backend is vaes-avx512.
+        /// </remarks>
+        /// <exception cref="ArgumentOutOfRangeException">The value is negative.</exception>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        public long WideVectorThreshold
+        {
+            get => _wideVectorThreshold;
+            set
+            {
+                ArgumentOutOfRangeException.ThrowIfNegative(value);
+                ThrowIfDisposed();
+                if (_context != null)
+                {
+                    int result;
+                    using (var context = new SafeAesGcmSivHandle.Lease(_context))
+                    {
+                        nuint minimum = (ulong)value > nuint.MaxValue ? nuint.MaxValue : (nuint)value;
+                        result = AesGcmSivNative.CtxSetWideMin(context.Pointer, minimum);
+                    }
+                    if (result != AESGCMSIV_SUCCESS)
+                    {
+                        throw new CryptographicException($"Setting the wide vector threshold failed with error code: {result}");
+                    }
+                }
+                _wideVectorThreshold = value;
+            }
+        }
+
+        /// <summary>
+        /// Gets or sets whether the parallel work of instances with <see cref="MaxDegreeOfParallelism"/>
+        /// other than 1, and of <see cref="AesGcmSivKeyTable"/>, runs on .NET thread-pool threads
+        /// instead of the native library's own worker threads.
+        /// </summary>
+        /// <remarks>
+        /// A native pool sized to the processor count, next to a busy .NET thread pool, puts about twice
+        /// as many runnable threads as cores on the machine. With this set, the shared pool starts no
+        /// threads; each time it has work it queues a work item that drains the work and returns, so
+        /// the .NET thread pool decides how many threads run. A call never waits for a work item to
+        /// start: it runs whatever no thread has picked up yet itself. NUMA placement does not apply.
+        /// Set it at start-up, before any instance enables parallelism. The default is false.
+        /// </remarks>
+        /// <exception cref="InvalidOperationException">The shared pool has already been created.</exception>
+        public static bool UseThreadPool
+        {
+            get => Volatile.Read(ref s_sharedPoolOnThreadPool);
+            set
+            {
+                lock (s_poolLock)
+                {
+                    if (s_sharedPool != IntPtr.Zero && value != s_sharedPoolOnThreadPool)
+                        throw new InvalidOperationException("The shared worker pool has already been created.");
+                    s_sharedPoolOnThreadPool = value;
+                }
+            }
+        }
+
+        // Called by a hosted shared pool, on the thread that queued its work
+        [UnmanagedCallersOnly(CallConvs = new[] { typeof(CallConvCdecl) })]
+        private static void SchedulePoolWork(IntPtr userData, IntPtr pool)
+        {
+            ThreadPool.UnsafeQueueUserWorkItem(s_runPoolWork, pool, preferLocal: false);
+        }
+
+        // From AesGcmSivTuningProfile.Apply. Returns false once the pool exists.
+        internal static bool SetSharedPoolWorkers(int workers)
+        {
+            lock (s_poolLock)
+            {
+                if (s_sharedPool != IntPtr.Zero)
+                    return false;
+                s_sharedPoolWorkers = workers;
+                return true;
+            }
+        }
+
+        internal static IntPtr GetSharedPool()
+        {
+            IntPtr pool = Volatile.Read(ref s_sharedPool);
+            if (pool != IntPtr.Zero)
+                return pool;
+
+            lock (s_poolLock)
+            {
+                if (s_sharedPool == IntPtr.Zero)
+                {
+                    int result = s_sharedPoolOnThreadPool
+                        ? AesGcmSivNative.PoolCreateHosted(
+                            (uint)s_sharedPoolWorkers, &SchedulePoolWork, IntPtr.Zero, &pool)
+                        : AesGcmSivNative.PoolCreateEx(
+                            (uint)s_sharedPoolWorkers, AESGCMSIV_POOL_NODE_LOCAL, &pool);
+                    if (result != AESGCMSIV_SUCCESS)
+                    {
+                        throw new CryptographicException($"Creating the worker pool failed with error code: {result}");
+                    }
+                    Volatile.Write(ref s_sharedPool, pool);
+                }
+                return s_sharedPool;
+            }
+        }
+
+        /// <summary>
+        /// Gets or sets whether short messages are encrypted and decrypted through a native entry point
+        /// that is called without a GC transition.
+        /// </summary>
+        /// <remarks>
+        /// Applies when the message and the associated data are each at most 256 bytes and a hardware
+        /// kernel is in use (see <see cref="BackendName"/>) and the instance was not bound to an OpenSSL
+        /// provider; other calls are unaffected. Skipping the
+        /// transition removes a fixed per-call cost that dominates at these sizes. The default is false.
+        /// </remarks>
+        public bool SmallMessageFastPath
+        {
+            get => _smallMessageFastPath;
+            set => _smallMessageFastPath = value;
+        }
 
-            _key = new byte[KeySize];
-            Array.Copy(key, _key, KeySize);
+        /// <summary>
+        /// Gets or sets the largest message, counting the plaintext and associated data together, that an
+        /// instance created with <see cref="AesGcmSivImplementation.Auto"/> encrypts and decrypts in
+        /// managed code. Longer messages go to the native library.
+        /// </summary>
+        /// <remarks>
+        /// The default is the one an applied <see cref="AesGcmSivTuningProfile"/> gives. Without one it
+        /// is measured once per process, on the first call of such an instance, as the largest power of
+        /// two from 64 bytes to 64 KiB at which the managed implementation kept up with the native one on
+        /// this host. The measurement takes a few milliseconds. Set it explicitly where the workload's
+        /// sizes are known or start-up time matters; 0 sends every non-empty message to the native
+        /// library. Has no effect on instances without both implementations.
+        /// </remarks>
+        /// <exception cref="ArgumentOutOfRangeException">The value is negative.</exception>
+        public int ManagedMessageThreshold
+        {
+            get => _managedMessageThreshold >= 0 ? _managedMessageThreshold : ResolveManagedMessageThreshold();
+            set
+            {
+                if (value < 0)
+                    throw new ArgumentOutOfRangeException(nameof(value), "Value must not be negative.");
+                _managedMessageThreshold = value;
+            }
         }
 
         /// <summary>
@@ -97,18 +909,7 @@ namespace System.Security.Cryptography
         {
             ThrowIfDisposed();
             ValidateEncryptParameters(nonce, plaintext, ciphertext, tag, associatedData);
-
-            int result = aesgcmsiv_encrypt(
-                _key, (nuint)_key.Length,
-                nonce, (nuint)nonce.Length,
-                plaintext, (nuint)plaintext.Length,
-                associatedData, (nuint)(associatedData?.Length ?? 0),
-                ciphertext, tag);
-
-            if (result != AESGCMSIV_SUCCESS)
-            {
-                throw new CryptographicException($"Encryption failed with error code: {result}");
-            }
+            Encrypt(nonce.AsSpan(), plaintext.AsSpan(), ciphertext.AsSpan(), tag.AsSpan(), associatedData.AsSpan());
         }
 
         /// <summary>
@@ -132,17 +933,3170 @@ namespace System.Security.Cryptography
         {
             ThrowIfDisposed();
             ValidateDecryptParameters(nonce, ciphertext, tag, plaintext, associatedData);
+            Decrypt(nonce.AsSpan(), ciphertext.AsSpan(), tag.AsSpan(), plaintext.AsSpan(), associatedData.AsSpan());
+        }
 
-            int result = aesgcmsiv_decrypt(
-                _key, (nuint)_key.Length,
-                nonce, (nuint)nonce.Length,
-                ciphertext, (nuint)ciphertext.Length,
-                associatedData, (nuint)(associatedData?.Length ?? 0),
-                tag, plaintext);
-
-            if (result != AESGCMSIV_SUCCESS)
-            {
-                throw new CryptographicException($"Decryption failed with error code: {result}");
+        /// <summary>
+        /// Encrypts plaintext using AES-GCM-SIV, reading and writing the caller's memory directly.
+        /// </summary>
+        /// <param name="nonce">The nonce. Must be exactly 12 bytes (96 bits).</param>
+        /// <param name="plaintext">The plaintext to encrypt.</param>
+        /// <param name="ciphertext">
+        /// The output buffer for the ciphertext. Must be at least as large as the plaintext. May be the
+        /// same memory as <paramref name="plaintext"/>, but must not otherwise overlap it.
+        /// </param>
+        /// <param name="tag">The output buffer for the authentication tag. Must be at least 16 bytes.</param>
+        /// <param name="associatedData">Optional additional authenticated data.</param>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentException">Parameter sizes are invalid, or the buffers partially overlap.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public void Encrypt(
+            ReadOnlySpan<byte> nonce,
+            ReadOnlySpan<byte> plaintext,
+            Span<byte> ciphertext,
+            Span<byte> tag,
+            ReadOnlySpan<byte> associatedData = default)
+        {
+            ThrowIfDisposed();
+            ValidateSpanParameters(nonce, plaintext, ciphertext, nameof(ciphertext), tag, exactTag: false);
+
+            int result = EncryptCore(nonce, plaintext, ciphertext, tag, associatedData);
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                throw new CryptographicException($"Encryption failed with error code: {result}");
+            }
+        }
+
+        /// <summary>
+        /// Encrypts plaintext using AES-GCM-SIV and returns a content hash of the plaintext, computed in the
+        /// same pass over it.
+        /// </summary>
+        /// <remarks>
+        /// The hash is XXH3-64 (xxHash 0.8) with seed 0, the value <c>XxHash3.HashToUInt64</c> from
+        /// System.IO.Hashing gives, for deduplication and ETags. It is not a cryptographic hash and says
+        /// nothing about the key. The native library hashes each few kilobytes of plaintext beside the
+        /// POLYVAL pass that computes the tag, while they are still in cache, so a large object is read
+        /// from memory once for both rather than again by a separate hash. The call runs on the calling
+        /// thread whatever <see cref="MaxDegreeOfParallelism"/> allows, as the hash is sequential. Needs
+        /// the native library.
+        /// </remarks>
+        /// <param name="nonce">The nonce. Must be exactly 12 bytes (96 bits).</param>
+        /// <param name="plaintext">The plaintext to encrypt.</param>
+        /// <param name="ciphertext">
+        /// The output buffer for the ciphertext. Must be at least as large as the plaintext. May be the
+        /// same memory as <paramref name="plaintext"/>, but must not otherwise overlap it.
+        /// </param>
+        /// <param name="tag">The output buffer for the authentication tag. Must be at least 16 bytes.</param>
+        /// <param name="associatedData">Optional additional authenticated data.</param>
+        /// <returns>The XXH3-64 hash of <paramref name="plaintext"/>.</returns>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentException">Parameter sizes are invalid, or the buffers partially overlap.</exception>
+        /// <exception cref="NotSupportedException">The instance runs only managed code.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public ulong EncryptHashed(
+            ReadOnlySpan<byte> nonce,
+            ReadOnlySpan<byte> plaintext,
+            Span<byte> ciphertext,
+            Span<byte> tag,
+            ReadOnlySpan<byte> associatedData = default)
+        {
+            ThrowIfDisposed();
+            ValidateSpanParameters(nonce, plaintext, ciphertext, nameof(ciphertext), tag, exactTag: false);
+            if (_context == null)
+                throw new NotSupportedException("An instance running only managed code cannot hash while encrypting.");
+
+            long started = AesGcmSivMetrics.IsEnabled ? Stopwatch.GetTimestamp() : 0;
+            ulong hash = 0;
+            int result;
+            using (var context = new SafeAesGcmSivHandle.Lease(_context))
+            fixed (byte* noncePtr = nonce)
+            fixed (byte* input = &BufferReference(plaintext))
+            fixed (byte* aad = associatedData)
+            fixed (byte* output = &BufferReference(ciphertext))
+            fixed (byte* tagPtr = tag)
+            {
+                result = AesGcmSivNative.CtxEncryptHashed(
+                    context.Pointer, noncePtr, (nuint)nonce.Length, input, (nuint)plaintext.Length,
+                    aad, (nuint)associatedData.Length, output, tagPtr, &hash);
+            }
+            if (started != 0)
+                AesGcmSivMetrics.Record(decrypt: false, result, plaintext.Length, started);
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                throw new CryptographicException($"Encryption failed with error code: {result}");
+            }
+            return hash;
+        }
+
+        /// <summary>
+        /// Attempts to encrypt plaintext using AES-GCM-SIV into a caller-supplied buffer.
+        /// </summary>
+        /// <param name="nonce">The nonce. Must be exactly 12 bytes (96 bits).</param>
+        /// <param name="plaintext">The plaintext to encrypt.</param>
+        /// <param name="ciphertext">
+        /// The output buffer for the ciphertext. May be the same memory as <paramref name="plaintext"/>,
+        /// but must not otherwise overlap it.
+        /// </param>
+        /// <param name="tag">The output buffer for the authentication tag. Must be at least 16 bytes.</param>
+        /// <param name="bytesWritten">The number of ciphertext bytes written, or 0 on failure.</param>
+        /// <param name="associatedData">Optional additional authenticated data.</param>
+        /// <returns>
+        /// <see langword="true"/> on success; <see langword="false"/> if <paramref name="ciphertext"/> is
+        /// too small, in which case nothing is written.
+        /// </returns>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentException">The nonce or tag size is invalid, or the buffers partially overlap.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public bool TryEncrypt(
+            ReadOnlySpan<byte> nonce,
+            ReadOnlySpan<byte> plaintext,
+            Span<byte> ciphertext,
+            Span<byte> tag,
+            out int bytesWritten,
+            ReadOnlySpan<byte> associatedData = default)
+        {
+            ThrowIfDisposed();
+            bytesWritten = 0;
+            if (ciphertext.Length < plaintext.Length)
+                return false;
+            ValidateSpanParameters(nonce, plaintext, ciphertext, nameof(ciphertext), tag, exactTag: false);
+
+            int result = EncryptCore(nonce, plaintext, ciphertext, tag, associatedData);
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                throw new CryptographicException($"Encryption failed with error code: {result}");
+            }
+            bytesWritten = plaintext.Length;
+            return true;
+        }
+
+        // Returns the native status; parameters must already be validated.
+        private int EncryptCore(
+            ReadOnlySpan<byte> nonce, ReadOnlySpan<byte> plaintext, Span<byte> ciphertext, Span<byte> tag,
+            ReadOnlySpan<byte> associatedData)
+        {
+            if (!AesGcmSivMetrics.IsEnabled)
+                return EncryptUntimed(nonce, plaintext, ciphertext, tag, associatedData);
+
+            long started = Stopwatch.GetTimestamp();
+            int result = EncryptUntimed(nonce, plaintext, ciphertext, tag, associatedData);
+            AesGcmSivMetrics.Record(decrypt: false, result, plaintext.Length, started);
+            return result;
+        }
+
+        private int EncryptUntimed(
+            ReadOnlySpan<byte> nonce, ReadOnlySpan<byte> plaintext, Span<byte> ciphertext, Span<byte> tag,
+            ReadOnlySpan<byte> associatedData)
+        {
+            if (UseManaged(plaintext.Length, associatedData.Length))
+                return _managed!.Encrypt(nonce, plaintext, ciphertext, tag, associatedData);
+            return EncryptNative(nonce, plaintext, ciphertext, tag, associatedData);
+        }
+
+        // Calls the _unchecked exports: every caller has validated the parameters, and
+        // BufferReference keeps empty messages off NULL, so the native checks would only repeat
+        // ours.
+        private int EncryptNative(
+            ReadOnlySpan<byte> nonce, ReadOnlySpan<byte> plaintext, Span<byte> ciphertext, Span<byte> tag,
+            ReadOnlySpan<byte> associatedData)
+        {
+            using var context = new SafeAesGcmSivHandle.Lease(_context!);
+            fixed (byte* noncePtr = nonce)
+            fixed (byte* input = &BufferReference(plaintext))
+            fixed (byte* aad = associatedData)
+            fixed (byte* output = &BufferReference(ciphertext))
+            fixed (byte* tagPtr = tag)
+            {
+                if (UseSmallMessagePath(plaintext.Length, associatedData.Length))
+                {
+                    return AesGcmSivNative.CtxEncryptSmallUnchecked(
+                        context.Pointer,
+                        noncePtr,
+                        input, (nuint)plaintext.Length,
+                        aad, (nuint)associatedData.Length,
+                        output, tagPtr);
+                }
+                return AesGcmSivNative.CtxEncryptUnchecked(
+                    context.Pointer,
+                    noncePtr,
+                    input, (nuint)plaintext.Length,
+                    aad, (nuint)associatedData.Length,
+                    output, tagPtr);
+            }
+        }
+
+        /// <summary>
+        /// Decrypts ciphertext using AES-GCM-SIV, reading and writing the caller's memory directly.
+        /// </summary>
+        /// <param name="nonce">The nonce used during encryption. Must be exactly 12 bytes (96 bits).</param>
+        /// <param name="ciphertext">The ciphertext to decrypt.</param>
+        /// <param name="tag">The authentication tag. Must be exactly 16 bytes.</param>
+        /// <param name="plaintext">
+        /// The output buffer for the plaintext. Must be at least as large as the ciphertext, and is zeroed
+        /// if the tag does not verify. May be the same memory as <paramref name="ciphertext"/>, but must
+        /// not otherwise overlap it.
+        /// </param>
+        /// <param name="associatedData">Optional additional authenticated data (must match the data used during encryption).</param>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentException">Parameter sizes are invalid, or the buffers partially overlap.</exception>
+        /// <exception cref="CryptographicException">Decryption failed or authentication tag is invalid.</exception>
+        public void Decrypt(
+            ReadOnlySpan<byte> nonce,
+            ReadOnlySpan<byte> ciphertext,
+            ReadOnlySpan<byte> tag,
+            Span<byte> plaintext,
+            ReadOnlySpan<byte> associatedData = default)
+        {
+            ThrowIfDisposed();
+            ValidateSpanParameters(nonce, ciphertext, plaintext, nameof(plaintext), tag, exactTag: true);
+
+            int result = DecryptCore(nonce, ciphertext, tag, plaintext, associatedData);
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                throw new CryptographicException($"Decryption failed with error code: {result}");
+            }
+        }
+
+        /// <summary>
+        /// Attempts to decrypt and authenticate ciphertext using AES-GCM-SIV, reporting a forged or
+        /// corrupted message through the return value instead of an exception.
+        /// </summary>
+        /// <param name="nonce">The nonce used during encryption. Must be exactly 12 bytes (96 bits).</param>
+        /// <param name="ciphertext">The ciphertext to decrypt.</param>
+        /// <param name="tag">The authentication tag. Must be exactly 16 bytes.</param>
+        /// <param name="plaintext">
+        /// The output buffer for the plaintext. Must be at least as large as the ciphertext, and is zeroed
+        /// if the tag does not verify. May be the same memory as <paramref name="ciphertext"/>, but must
+        /// not otherwise overlap it.
+        /// </param>
+        /// <param name="associatedData">Optional additional authenticated data (must match the data used during encryption).</param>
+        /// <returns><see langword="true"/> if the tag verified; otherwise <see langword="false"/>.</returns>
+        /// <remarks>
+        /// Authentication failure neither throws nor allocates, so rejecting untrusted input costs no more
+        /// than accepting it.
+        /// </remarks>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentException">Parameter sizes are invalid, or the buffers partially overlap.</exception>
+        /// <exception cref="CryptographicException">Decryption failed for a reason other than authentication.</exception>
+        public bool TryDecrypt(
+            ReadOnlySpan<byte> nonce,
+            ReadOnlySpan<byte> ciphertext,
+            ReadOnlySpan<byte> tag,
+            Span<byte> plaintext,
+            ReadOnlySpan<byte> associatedData = default)
+        {
+            ThrowIfDisposed();
+            ValidateSpanParameters(nonce, ciphertext, plaintext, nameof(plaintext), tag, exactTag: true);
+
+            int result = DecryptCore(nonce, ciphertext, tag, plaintext, associatedData);
+            if (result == AESGCMSIV_ERROR_DECRYPT_FAILED)
+                return false;
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                throw new CryptographicException($"Decryption failed with error code: {result}");
+            }
+            return true;
+        }
+
+        /// <summary>
+        /// Decrypts a message under whichever of several candidate keys it was encrypted with, for stored
+        /// values that predate key IDs. The candidates are tried in order, and the first whose tag verifies
+        /// decrypts the message.
+        /// </summary>
+        /// <param name="candidates">The candidate keys, newest first as a rule. Must not be empty.</param>
+        /// <param name="nonce">The nonce used during encryption. Must be exactly 12 bytes (96 bits).</param>
+        /// <param name="ciphertext">The ciphertext to decrypt.</param>
+        /// <param name="tag">The authentication tag. Must be exactly 16 bytes.</param>
+        /// <param name="plaintext">
+        /// The output buffer for the plaintext. Must be at least as large as the ciphertext, and is zeroed
+        /// if no candidate verifies. May be the same memory as <paramref name="ciphertext"/>, but must not
+        /// otherwise overlap it.
+        /// </param>
+        /// <param name="associatedData">Optional additional authenticated data (must match the data used during encryption).</param>
+        /// <returns>The index in <paramref name="candidates"/> of the key that verified, or -1 if none did.</returns>
+        /// <remarks>
+        /// When every candidate holds a native key schedule, all of them are tried in one native call, which
+        /// stops at the first that verifies. A candidate that fails costs one pass over the message and no
+        /// exception. In place, every candidate but the last is only verified, so that the ciphertext
+        /// survives it.
+        /// </remarks>
+        /// <exception cref="ArgumentNullException">A candidate is null.</exception>
+        /// <exception cref="ObjectDisposedException">A candidate has been disposed.</exception>
+        /// <exception cref="ArgumentException">
+        /// <paramref name="candidates"/> is empty, parameter sizes are invalid, or the buffers partially overlap.
+        /// </exception>
+        /// <exception cref="CryptographicException">Decryption failed for a reason other than authentication.</exception>
+        public static int TryDecryptWithAny(
+            ReadOnlySpan<AesGcmSiv> candidates,
+            ReadOnlySpan<byte> nonce,
+            ReadOnlySpan<byte> ciphertext,
+            ReadOnlySpan<byte> tag,
+            Span<byte> plaintext,
+            ReadOnlySpan<byte> associatedData = default)
+        {
+            if (candidates.IsEmpty)
+                throw new ArgumentException("At least one candidate key is required.", nameof(candidates));
+            bool native = true;
+            foreach (AesGcmSiv? candidate in candidates)
+            {
+                ArgumentNullException.ThrowIfNull(candidate, nameof(candidates));
+                candidate.ThrowIfDisposed();
+                native &= candidate._context != null;
+            }
+            ValidateSpanParameters(nonce, ciphertext, plaintext, nameof(plaintext), tag, exactTag: true);
+
+            if (!native)
+                return TryDecryptWithAnyManaged(candidates, nonce, ciphertext, tag, plaintext, associatedData);
+
+            long started = AesGcmSivMetrics.IsEnabled ? Stopwatch.GetTimestamp() : 0;
+            int result;
+            nuint index;
+            IntPtr[]? rented = null;
+            Span<IntPtr> contexts = candidates.Length <= 16
+                ? stackalloc IntPtr[candidates.Length]
+                : (rented = ArrayPool<IntPtr>.Shared.Rent(candidates.Length)).AsSpan(0, candidates.Length);
+            int leased = 0;
+            try
+            {
+                for (; leased < candidates.Length; leased++)
+                {
+                    SafeAesGcmSivHandle context = candidates[leased]._context!;
+                    bool added = false;
+                    context.DangerousAddRef(ref added);
+                    contexts[leased] = context.DangerousGetHandle();
+                }
+                fixed (IntPtr* contextsPtr = contexts)
+                fixed (byte* noncePtr = nonce)
+                fixed (byte* input = &BufferReference(ciphertext))
+                fixed (byte* aad = associatedData)
+                fixed (byte* tagPtr = tag)
+                fixed (byte* output = &BufferReference(plaintext))
+                {
+                    result = AesGcmSivNative.OpenTrial(
+                        contextsPtr, (nuint)contexts.Length,
+                        noncePtr, (nuint)nonce.Length,
+                        input, (nuint)ciphertext.Length,
+                        aad, (nuint)associatedData.Length,
+                        tagPtr, output, &index);
+                }
+            }
+            finally
+            {
+                for (int i = 0; i < leased; i++)
+                {
+                    candidates[i]._context!.DangerousRelease();
+                }
+                if (rented != null)
+                    ArrayPool<IntPtr>.Shared.Return(rented);
+            }
+            if (started != 0)
+                AesGcmSivMetrics.Record(decrypt: true, result, ciphertext.Length, started);
+
+            if (result == AESGCMSIV_ERROR_DECRYPT_FAILED)
+                return -1;
+            if (result != AESGCMSIV_SUCCESS)
+                throw new CryptographicException($"Decryption failed with error code: {result}");
+            return (int)index;
+        }
+
+        // Candidates without a native key schedule are tried one by one; in
+        // place, the ciphertext is copied aside so a failed attempt cannot
+        // zero it
+        private static int TryDecryptWithAnyManaged(
+            ReadOnlySpan<AesGcmSiv> candidates, ReadOnlySpan<byte> nonce, ReadOnlySpan<byte> ciphertext,
+            ReadOnlySpan<byte> tag, Span<byte> plaintext, ReadOnlySpan<byte> associatedData)
+        {
+            byte[]? saved = null;
+            if (candidates.Length > 1 && plaintext.Overlaps(ciphertext))
+            {
+                saved = ArrayPool<byte>.Shared.Rent(ciphertext.Length);
+                ciphertext.CopyTo(saved);
+                ciphertext = saved.AsSpan(0, ciphertext.Length);
+            }
+            try
+            {
+                for (int i = 0; i < candidates.Length; i++)
+                {
+                    int result = candidates[i].DecryptCore(nonce, ciphertext, tag, plaintext, associatedData);
+                    if (result == AESGCMSIV_SUCCESS)
+                        return i;
+                    if (result != AESGCMSIV_ERROR_DECRYPT_FAILED)
+                        throw new CryptographicException($"Decryption failed with error code: {result}");
+                }
+                return -1;
+            }
+            finally
+            {
+                if (saved != null)
+                {
+                    CryptographicOperations.ZeroMemory(saved.AsSpan(0, ciphertext.Length));
+                    ArrayPool<byte>.Shared.Return(saved);
+                }
+            }
+        }
+
+        // Returns the native status; parameters must already be validated.
+        private int DecryptCore(
+            ReadOnlySpan<byte> nonce, ReadOnlySpan<byte> ciphertext, ReadOnlySpan<byte> tag, Span<byte> plaintext,
+            ReadOnlySpan<byte> associatedData)
+        {
+            if (!AesGcmSivMetrics.IsEnabled)
+                return DecryptUntimed(nonce, ciphertext, tag, plaintext, associatedData);
+
+            long started = Stopwatch.GetTimestamp();
+            int result = DecryptUntimed(nonce, ciphertext, tag, plaintext, associatedData);
+            AesGcmSivMetrics.Record(decrypt: true, result, ciphertext.Length, started);
+            return result;
+        }
+
+        private int DecryptUntimed(
+            ReadOnlySpan<byte> nonce, ReadOnlySpan<byte> ciphertext, ReadOnlySpan<byte> tag, Span<byte> plaintext,
+            ReadOnlySpan<byte> associatedData)
+        {
+            if (UseManaged(ciphertext.Length, associatedData.Length))
+                return _managed!.Decrypt(nonce, ciphertext, tag, plaintext, associatedData);
+            return DecryptNative(nonce, ciphertext, tag, plaintext, associatedData);
+        }
+
+        private int DecryptNative(
+            ReadOnlySpan<byte> nonce, ReadOnlySpan<byte> ciphertext, ReadOnlySpan<byte> tag, Span<byte> plaintext,
+            ReadOnlySpan<byte> associatedData)
+        {
+            using var context = new SafeAesGcmSivHandle.Lease(_context!);
+            fixed (byte* noncePtr = nonce)
+            fixed (byte* input = &BufferReference(ciphertext))
+            fixed (byte* aad = associatedData)
+            fixed (byte* tagPtr = tag)
+            fixed (byte* output = &BufferReference(plaintext))
+            {
+                if (UseSmallMessagePath(ciphertext.Length, associatedData.Length))
+                {
+                    return AesGcmSivNative.CtxDecryptSmallUnchecked(
+                        context.Pointer,
+                        noncePtr,
+                        input, (nuint)ciphertext.Length,
+                        aad, (nuint)associatedData.Length,
+                        tagPtr, output);
+                }
+                return AesGcmSivNative.CtxDecryptUnchecked(
+                    context.Pointer,
+                    noncePtr,
+                    input, (nuint)ciphertext.Length,
+                    aad, (nuint)associatedData.Length,
+                    tagPtr, output);
+            }
+        }
+
+        /// <summary>
+        /// Encrypts plaintext using AES-GCM-SIV without blocking the calling thread while an offload
+        /// engine works.
+        /// </summary>
+        /// <param name="nonce">The nonce. Must be exactly 12 bytes (96 bits).</param>
+        /// <param name="plaintext">The plaintext to encrypt.</param>
+        /// <param name="ciphertext">
+        /// The output buffer for the ciphertext. Must be at least as large as the plaintext. May be the
+        /// same memory as <paramref name="plaintext"/>, but must not otherwise overlap it.
+        /// </param>
+        /// <param name="tag">The output buffer for the authentication tag. Must be at least 16 bytes.</param>
+        /// <param name="associatedData">Optional additional authenticated data.</param>
+        /// <param name="cancellationToken">
+        /// Checked before the call is submitted; a submitted call always runs to completion.
+        /// </param>
+        /// <remarks>
+        /// An instance bound to an OpenSSL provider (see
+        /// <see cref="AesGcmSiv(byte[], string?, string?)"/>) runs the call as an OpenSSL asynchronous
+        /// job, which lets an engine that supports it pause while the device works. Such jobs are driven
+        /// by one background thread, so a single caller can keep many in flight. On an instance whose
+        /// <see cref="MaxDegreeOfParallelism"/> is not 1, a message of 1 MiB or more is queued on the
+        /// shared native worker pool and split there as that setting allows; no managed thread waits
+        /// for it, and the task completes from the worker that finishes it. Any other call finishes
+        /// before this method returns. The buffers must not be modified until the returned task
+        /// completes.
+        /// </remarks>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentException">Parameter sizes are invalid, or the buffers partially overlap.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public ValueTask EncryptAsync(
+            ReadOnlyMemory<byte> nonce,
+            ReadOnlyMemory<byte> plaintext,
+            Memory<byte> ciphertext,
+            Memory<byte> tag,
+            ReadOnlyMemory<byte> associatedData = default,
+            CancellationToken cancellationToken = default)
+        {
+            ThrowIfDisposed();
+            ValidateSpanParameters(nonce.Span, plaintext.Span, ciphertext.Span, nameof(ciphertext), tag.Span, exactTag: false);
+            if (cancellationToken.IsCancellationRequested)
+                return ValueTask.FromCanceled(cancellationToken);
+
+            if (!_providerSelected && !RunsOnPool(plaintext.Length))
+            {
+                int result = EncryptCore(nonce.Span, plaintext.Span, ciphertext.Span, tag.Span, associatedData.Span);
+                return result == AESGCMSIV_SUCCESS
+                    ? ValueTask.CompletedTask
+                    : ValueTask.FromException(new CryptographicException($"Encryption failed with error code: {result}"));
+            }
+
+            var job = new AesGcmSivJob(
+                _context!, decrypt: false, nonce, JobBuffer(plaintext), associatedData, tag, JobBuffer(ciphertext));
+            return _providerSelected
+                ? AesGcmSivJob.RunAsync(job, "Encryption")
+                : AesGcmSivJob.RunOnPoolAsync(job, "Encryption");
+        }
+
+        /// <summary>
+        /// Decrypts ciphertext using AES-GCM-SIV without blocking the calling thread while an offload
+        /// engine works.
+        /// </summary>
+        /// <param name="nonce">The nonce used during encryption. Must be exactly 12 bytes (96 bits).</param>
+        /// <param name="ciphertext">The ciphertext to decrypt.</param>
+        /// <param name="tag">The authentication tag. Must be exactly 16 bytes.</param>
+        /// <param name="plaintext">
+        /// The output buffer for the plaintext. Must be at least as large as the ciphertext, and is zeroed
+        /// if the tag does not verify. May be the same memory as <paramref name="ciphertext"/>, but must
+        /// not otherwise overlap it.
+        /// </param>
+        /// <param name="associatedData">Optional additional authenticated data (must match the data used during encryption).</param>
+        /// <param name="cancellationToken">
+        /// Checked before the call is submitted; a submitted call always runs to completion.
+        /// </param>
+        /// <remarks>
+        /// Runs as <see cref="EncryptAsync"/> does.
+        /// </remarks>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentException">Parameter sizes are invalid, or the buffers partially overlap.</exception>
+        /// <exception cref="CryptographicException">Decryption failed or authentication tag is invalid.</exception>
+        public ValueTask DecryptAsync(
+            ReadOnlyMemory<byte> nonce,
+            ReadOnlyMemory<byte> ciphertext,
+            ReadOnlyMemory<byte> tag,
+            Memory<byte> plaintext,
+            ReadOnlyMemory<byte> associatedData = default,
+            CancellationToken cancellationToken = default)
+        {
+            ThrowIfDisposed();
+            ValidateSpanParameters(nonce.Span, ciphertext.Span, plaintext.Span, nameof(plaintext), tag.Span, exactTag: true);
+            if (cancellationToken.IsCancellationRequested)
+                return ValueTask.FromCanceled(cancellationToken);
+
+            if (!_providerSelected && !RunsOnPool(ciphertext.Length))
+            {
+                int result = DecryptCore(nonce.Span, ciphertext.Span, tag.Span, plaintext.Span, associatedData.Span);
+                return result == AESGCMSIV_SUCCESS
+                    ? ValueTask.CompletedTask
+                    : ValueTask.FromException(new CryptographicException($"Decryption failed with error code: {result}"));
+            }
+
+            var job = new AesGcmSivJob(
+                _context!, decrypt: true, nonce, JobBuffer(ciphertext), associatedData, tag, JobBuffer(plaintext));
+            return _providerSelected
+                ? AesGcmSivJob.RunAsync(job, "Decryption")
+                : AesGcmSivJob.RunOnPoolAsync(job, "Decryption");
+        }
+
+        // Whether an asynchronous call on a message of this length goes to
+        // the shared pool, which the context is attached to while
+        // parallelism is enabled
+        private bool RunsOnPool(int messageLength) =>
+            _context != null && _maxDegreeOfParallelism != 1 && messageLength >= AsyncPoolMinBytes;
+
+        // Validates an encrypt call and pins it for an AesGcmSivEngine
+        internal AesGcmSivJob CreateEncryptJob(
+            ReadOnlyMemory<byte> nonce, ReadOnlyMemory<byte> plaintext, Memory<byte> ciphertext, Memory<byte> tag,
+            ReadOnlyMemory<byte> associatedData)
+        {
+            ThrowIfDisposed();
+            ValidateSpanParameters(nonce.Span, plaintext.Span, ciphertext.Span, nameof(ciphertext), tag.Span, exactTag: false);
+            return new AesGcmSivJob(
+                EngineContext(), decrypt: false, nonce, JobBuffer(plaintext), associatedData, tag, JobBuffer(ciphertext));
+        }
+
+        // Validates a decrypt call and pins it for an AesGcmSivEngine
+        internal AesGcmSivJob CreateDecryptJob(
+            ReadOnlyMemory<byte> nonce, ReadOnlyMemory<byte> ciphertext, ReadOnlyMemory<byte> tag, Memory<byte> plaintext,
+            ReadOnlyMemory<byte> associatedData)
+        {
+            ThrowIfDisposed();
+            ValidateSpanParameters(nonce.Span, ciphertext.Span, plaintext.Span, nameof(plaintext), tag.Span, exactTag: true);
+            return new AesGcmSivJob(
+                EngineContext(), decrypt: true, nonce, JobBuffer(ciphertext), associatedData, tag, JobBuffer(plaintext));
+        }
+
+        private SafeAesGcmSivHandle EngineContext() =>
+            _context ?? throw new NotSupportedException(
+                "An instance running only managed code cannot submit calls to an AesGcmSivEngine.");
+
+        internal SafeAesGcmSivHandle StreamContext()
+        {
+            ThrowIfDisposed();
+            return _context ?? throw new NotSupportedException(
+                "An instance running only managed code cannot compress or decompress a stream.");
+        }
+
+        internal SafeAesGcmSivHandle JsonContext()
+        {
+            ThrowIfDisposed();
+            return _context ?? throw new NotSupportedException(
+                "An instance running only managed code cannot encrypt or decrypt JSON fields.");
+        }
+
+        // Like BufferReference, keeps an empty message from reaching native code as NULL
+        internal static Memory<byte> JobBuffer(Memory<byte> buffer) =>
+            buffer.IsEmpty ? s_emptyBuffer.AsMemory(0, 0) : buffer;
+
+        internal static ReadOnlyMemory<byte> JobBuffer(ReadOnlyMemory<byte> buffer) =>
+            buffer.IsEmpty ? s_emptyBuffer.AsMemory(0, 0) : buffer;
+
+        /// <summary>
+        /// Encrypts a buffer in place using AES-GCM-SIV, overwriting the plaintext with the ciphertext.
+        /// </summary>
+        /// <param name="nonce">The nonce. Must be exactly 12 bytes (96 bits).</param>
+        /// <param name="buffer">The plaintext on input and the ciphertext on return.</param>
+        /// <param name="tag">The output buffer for the authentication tag. Must be at least 16 bytes.</param>
+        /// <param name="associatedData">Optional additional authenticated data.</param>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentNullException">Any required parameter is null.</exception>
+        /// <exception cref="ArgumentException">Parameter sizes are invalid.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public void Encrypt(
+            byte[] nonce,
+            Span<byte> buffer,
+            byte[] tag,
+            byte[]? associatedData = null)
+        {
+            ThrowIfDisposed();
+            ValidateNonceAndTag(nonce, tag, exactTag: false);
+            Encrypt(nonce, buffer, buffer, tag, associatedData);
+        }
+
+        /// <summary>
+        /// Decrypts a buffer in place using AES-GCM-SIV, overwriting the ciphertext with the plaintext.
+        /// </summary>
+        /// <param name="nonce">The nonce used during encryption. Must be exactly 12 bytes (96 bits).</param>
+        /// <param name="buffer">
+        /// The ciphertext on input and the plaintext on return. Zeroed if the tag does not verify.
+        /// </param>
+        /// <param name="tag">The authentication tag. Must be exactly 16 bytes.</param>
+        /// <param name="associatedData">Optional additional authenticated data (must match the data used during encryption).</param>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentNullException">Any required parameter is null.</exception>
+        /// <exception cref="ArgumentException">Parameter sizes are invalid.</exception>
+        /// <exception cref="CryptographicException">Decryption failed or authentication tag is invalid.</exception>
+        public void Decrypt(
+            byte[] nonce,
+            Span<byte> buffer,
+            byte[] tag,
+            byte[]? associatedData = null)
+        {
+            ThrowIfDisposed();
+            ValidateNonceAndTag(nonce, tag, exactTag: true);
+            Decrypt(nonce, buffer, tag, buffer, associatedData);
+        }
+
+        /// <summary>
+        /// Encrypts a plaintext held in several segments without first copying it into one buffer.
+        /// </summary>
+        /// <param name="nonce">The nonce. Must be exactly 12 bytes (96 bits).</param>
+        /// <param name="plaintext">The plaintext, as the concatenation of these segments in order.</param>
+        /// <param name="ciphertext">
+        /// The segments the ciphertext is written across, in order. Together they must hold at least
+        /// as many bytes as <paramref name="plaintext"/>. They may be the plaintext segments themselves
+        /// to encrypt in place.
+        /// </param>
+        /// <param name="tag">The output buffer for the authentication tag. Must be at least 16 bytes.</param>
+        /// <param name="associatedData">Optional additional authenticated data, as segments.</param>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentNullException">Any required parameter is null.</exception>
+        /// <exception cref="ArgumentException">A segment has no array, or parameter sizes are invalid.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public void Encrypt(
+            byte[] nonce,
+            IReadOnlyList<ArraySegment<byte>> plaintext,
+            IReadOnlyList<ArraySegment<byte>> ciphertext,
+            byte[] tag,
+            IReadOnlyList<ArraySegment<byte>>? associatedData = null)
+        {
+            ThrowIfDisposed();
+            if (plaintext == null)
+                throw new ArgumentNullException(nameof(plaintext));
+            if (ciphertext == null)
+                throw new ArgumentNullException(nameof(ciphertext));
+            ValidateNonceAndTag(nonce, tag, exactTag: false);
+            long plaintextLength = TotalLength(plaintext, nameof(plaintext));
+            if (TotalLength(ciphertext, nameof(ciphertext)) < plaintextLength)
+                throw new ArgumentException("Ciphertext buffer is too small.", nameof(ciphertext));
+            if (associatedData != null)
+                TotalLength(associatedData, nameof(associatedData));
+
+            long started = AesGcmSivMetrics.IsEnabled ? Stopwatch.GetTimestamp() : 0;
+            int result;
+            if (_context == null)
+            {
+                result = RunManagedSegments(decrypt: false, nonce, plaintext, plaintextLength, tag, ciphertext, associatedData);
+            }
+            else
+            {
+                var handles = new List<GCHandle>();
+                try
+                {
+                    NativeIoVec[] input = PinSegments(plaintext, handles);
+                    NativeIoVec[] aad = PinSegments(associatedData, handles);
+                    NativeIoVec[] output = PinSegments(ciphertext, handles);
+                    using var context = new SafeAesGcmSivHandle.Lease(_context);
+                    fixed (byte* noncePtr = nonce)
+                    fixed (NativeIoVec* inputPtr = input)
+                    fixed (NativeIoVec* aadPtr = aad)
+                    fixed (NativeIoVec* outputPtr = output)
+                    fixed (byte* tagPtr = tag)
+                    {
+                        result = AesGcmSivNative.CtxEncryptV(
+                            context.Pointer,
+                            noncePtr, (nuint)nonce.Length,
+                            inputPtr, (nuint)input.Length,
+                            aadPtr, (nuint)aad.Length,
+                            outputPtr, (nuint)output.Length,
+                            tagPtr);
+                    }
+                }
+                finally
+                {
+                    foreach (var handle in handles)
+                        handle.Free();
+                }
+            }
+            if (started != 0)
+                AesGcmSivMetrics.Record(decrypt: false, result, plaintextLength, started);
+
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                throw new CryptographicException($"Encryption failed with error code: {result}");
+            }
+        }
+
+        /// <summary>
+        /// Decrypts a ciphertext held in several segments, writing the plaintext across output segments.
+        /// </summary>
+        /// <param name="nonce">The nonce used during encryption. Must be exactly 12 bytes (96 bits).</param>
+        /// <param name="ciphertext">The ciphertext, as the concatenation of these segments in order.</param>
+        /// <param name="tag">The authentication tag. Must be exactly 16 bytes.</param>
+        /// <param name="plaintext">
+        /// The segments the plaintext is written across, in order. Together they must hold at least
+        /// as many bytes as <paramref name="ciphertext"/>, and are zeroed if the tag does not verify.
+        /// They may be the ciphertext segments themselves to decrypt in place.
+        /// </param>
+        /// <param name="associatedData">Optional additional authenticated data, as segments (must match the data used during encryption).</param>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentNullException">Any required parameter is null.</exception>
+        /// <exception cref="ArgumentException">A segment has no array, or parameter sizes are invalid.</exception>
+        /// <exception cref="CryptographicException">Decryption failed or authentication tag is invalid.</exception>
+        public void Decrypt(
+            byte[] nonce,
+            IReadOnlyList<ArraySegment<byte>> ciphertext,
+            byte[] tag,
+            IReadOnlyList<ArraySegment<byte>> plaintext,
+            IReadOnlyList<ArraySegment<byte>>? associatedData = null)
+        {
+            ThrowIfDisposed();
+            if (ciphertext == null)
+                throw new ArgumentNullException(nameof(ciphertext));
+            if (plaintext == null)
+                throw new ArgumentNullException(nameof(plaintext));
+            ValidateNonceAndTag(nonce, tag, exactTag: true);
+            long ciphertextLength = TotalLength(ciphertext, nameof(ciphertext));
+            if (TotalLength(plaintext, nameof(plaintext)) < ciphertextLength)
+                throw new ArgumentException("Plaintext buffer is too small.", nameof(plaintext));
+            if (associatedData != null)
+                TotalLength(associatedData, nameof(associatedData));
+
+            long started = AesGcmSivMetrics.IsEnabled ? Stopwatch.GetTimestamp() : 0;
+            int result;
+            if (_context == null)
+            {
+                result = RunManagedSegments(decrypt: true, nonce, ciphertext, ciphertextLength, tag, plaintext, associatedData);
+            }
+            else
+            {
+                var handles = new List<GCHandle>();
+                try
+                {
+                    NativeIoVec[] input = PinSegments(ciphertext, handles);
+                    NativeIoVec[] aad = PinSegments(associatedData, handles);
+                    NativeIoVec[] output = PinSegments(plaintext, handles);
+                    using var context = new SafeAesGcmSivHandle.Lease(_context);
+                    fixed (byte* noncePtr = nonce)
+                    fixed (NativeIoVec* inputPtr = input)
+                    fixed (NativeIoVec* aadPtr = aad)
+                    fixed (byte* tagPtr = tag)
+                    fixed (NativeIoVec* outputPtr = output)
+                    {
+                        result = AesGcmSivNative.CtxDecryptV(
+                            context.Pointer,
+                            noncePtr, (nuint)nonce.Length,
+                            inputPtr, (nuint)input.Length,
+                            aadPtr, (nuint)aad.Length,
+                            tagPtr,
+                            outputPtr, (nuint)output.Length);
+                    }
+                }
+                finally
+                {
+                    foreach (var handle in handles)
+                        handle.Free();
+                }
+            }
+            if (started != 0)
+                AesGcmSivMetrics.Record(decrypt: true, result, ciphertextLength, started);
+
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                throw new CryptographicException($"Decryption failed with error code: {result}");
+            }
+        }
+
+        // Encrypts a plaintext held in a sequence into one buffer, for
+        // AesGcmSivPipe. A multi-segment plaintext goes to native code as one
+        // I/O vector per segment rather than being copied together first.
+        internal void Encrypt(
+            ReadOnlySpan<byte> nonce, in ReadOnlySequence<byte> plaintext, Span<byte> ciphertext, Span<byte> tag,
+            ReadOnlySpan<byte> associatedData)
+        {
+            if (plaintext.IsSingleSegment || plaintext.IsEmpty)
+            {
+                Encrypt(nonce, plaintext.FirstSpan, ciphertext, tag, associatedData);
+                return;
+            }
+            ThrowIfDisposed();
+            ValidateSequenceParameters(nonce, plaintext, ciphertext, nameof(ciphertext), tag, exactTag: false);
+
+            long started = AesGcmSivMetrics.IsEnabled ? Stopwatch.GetTimestamp() : 0;
+            int result = RunSequence(decrypt: false, nonce, plaintext, tag, ciphertext, associatedData);
+            if (started != 0)
+                AesGcmSivMetrics.Record(decrypt: false, result, plaintext.Length, started);
+
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                throw new CryptographicException($"Encryption failed with error code: {result}");
+            }
+        }
+
+        // Decrypts a ciphertext held in a sequence into one buffer, as the
+        // sequence Encrypt does, returning whether the tag verified
+        internal bool TryDecrypt(
+            ReadOnlySpan<byte> nonce, in ReadOnlySequence<byte> ciphertext, ReadOnlySpan<byte> tag, Span<byte> plaintext,
+            ReadOnlySpan<byte> associatedData)
+        {
+            if (ciphertext.IsSingleSegment || ciphertext.IsEmpty)
+                return TryDecrypt(nonce, ciphertext.FirstSpan, tag, plaintext, associatedData);
+            ThrowIfDisposed();
+            ValidateSequenceParameters(nonce, ciphertext, plaintext, nameof(plaintext), tag, exactTag: true);
+
+            // The tag is only read, but shares a parameter with encryption's
+            Span<byte> tagCopy = stackalloc byte[TagSize];
+            tag.CopyTo(tagCopy);
+            long started = AesGcmSivMetrics.IsEnabled ? Stopwatch.GetTimestamp() : 0;
+            int result = RunSequence(decrypt: true, nonce, ciphertext, tagCopy, plaintext, associatedData);
+            if (started != 0)
+                AesGcmSivMetrics.Record(decrypt: true, result, ciphertext.Length, started);
+
+            if (result == AESGCMSIV_ERROR_DECRYPT_FAILED)
+                return false;
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                throw new CryptographicException($"Decryption failed with error code: {result}");
+            }
+            return true;
+        }
+
+        private int RunSequence(
+            bool decrypt, ReadOnlySpan<byte> nonce, in ReadOnlySequence<byte> input, Span<byte> tag,
+            Span<byte> output, ReadOnlySpan<byte> associatedData)
+        {
+            if (_context == null)
+            {
+                // Without native code there is nothing to hand the segments
+                // to, so they are copied together into the output first
+                input.CopyTo(output);
+                Span<byte> message = output.Slice(0, (int)input.Length);
+                return decrypt
+                    ? _managed!.Decrypt(nonce, message, tag, message, associatedData)
+                    : _managed!.Encrypt(nonce, message, message, tag, associatedData);
+            }
+
+            int segments = 0;
+            foreach (ReadOnlyMemory<byte> segment in input)
+            {
+                if (!segment.IsEmpty)
+                    segments++;
+            }
+            var vectors = new NativeIoVec[segments];
+            var handles = new MemoryHandle[segments];
+            try
+            {
+                int next = 0;
+                foreach (ReadOnlyMemory<byte> segment in input)
+                {
+                    if (segment.IsEmpty)
+                        continue;
+                    handles[next] = segment.Pin();
+                    vectors[next++] = new NativeIoVec { Data = (IntPtr)handles[next - 1].Pointer, Length = (nuint)segment.Length };
+                }
+
+                using var context = new SafeAesGcmSivHandle.Lease(_context);
+                fixed (byte* noncePtr = nonce)
+                fixed (NativeIoVec* inputPtr = vectors)
+                fixed (byte* aadPtr = associatedData)
+                fixed (byte* tagPtr = tag)
+                fixed (byte* outputPtr = &BufferReference(output))
+                {
+                    var outputVector = new NativeIoVec { Data = (IntPtr)outputPtr, Length = (nuint)input.Length };
+                    var aadVector = new NativeIoVec { Data = (IntPtr)aadPtr, Length = (nuint)associatedData.Length };
+                    nuint aadCount = associatedData.IsEmpty ? 0u : 1u;
+                    return decrypt
+                        ? AesGcmSivNative.CtxDecryptV(
+                            context.Pointer,
+                            noncePtr, (nuint)nonce.Length,
+                            inputPtr, (nuint)vectors.Length,
+                            &aadVector, aadCount,
+                            tagPtr,
+                            &outputVector, 1)
+                        : AesGcmSivNative.CtxEncryptV(
+                            context.Pointer,
+                            noncePtr, (nuint)nonce.Length,
+                            inputPtr, (nuint)vectors.Length,
+                            &aadVector, aadCount,
+                            &outputVector, 1,
+                            tagPtr);
+                }
+            }
+            finally
+            {
+                foreach (var handle in handles)
+                    handle.Dispose();
+            }
+        }
+
+        private static void ValidateSequenceParameters(
+            ReadOnlySpan<byte> nonce, in ReadOnlySequence<byte> input, ReadOnlySpan<byte> output, string outputName,
+            ReadOnlySpan<byte> tag, bool exactTag)
+        {
+            if (nonce.Length != NonceSize)
+                throw new ArgumentException($"Nonce must be exactly {NonceSize} bytes (96 bits).", nameof(nonce));
+            if (output.Length < input.Length)
+                throw new ArgumentException("Output buffer is too small.", outputName);
+            if (exactTag && tag.Length != TagSize)
+                throw new ArgumentException($"Tag must be exactly {TagSize} bytes.", nameof(tag));
+            if (!exactTag && tag.Length < TagSize)
+                throw new ArgumentException($"Tag buffer must be at least {TagSize} bytes.", nameof(tag));
+        }
+
+        /// <summary>
+        /// Encrypts plaintext into a single buffer laid out as nonce || ciphertext || tag.
+        /// </summary>
+        /// <param name="nonce">The nonce. Must be exactly 12 bytes (96 bits).</param>
+        /// <param name="plaintext">The data to encrypt.</param>
+        /// <param name="destination">
+        /// The output buffer. Must be at least <see cref="SealOverhead"/> bytes longer than <paramref name="plaintext"/>.
+        /// </param>
+        /// <param name="associatedData">Optional additional authenticated data.</param>
+        /// <returns>The number of bytes written to <paramref name="destination"/>.</returns>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentNullException">Any required parameter is null.</exception>
+        /// <exception cref="ArgumentException">Parameter sizes are invalid.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public int Seal(
+            byte[] nonce,
+            byte[] plaintext,
+            byte[] destination,
+            byte[]? associatedData = null)
+        {
+            ThrowIfDisposed();
+            if (nonce == null)
+                throw new ArgumentNullException(nameof(nonce));
+            if (plaintext == null)
+                throw new ArgumentNullException(nameof(plaintext));
+            if (destination == null)
+                throw new ArgumentNullException(nameof(destination));
+
+            if (nonce.Length != NonceSize)
+                throw new ArgumentException($"Nonce must be exactly {NonceSize} bytes (96 bits).", nameof(nonce));
+            if (destination.Length - SealOverhead < plaintext.Length)
+                throw new ArgumentException("Destination buffer is too small.", nameof(destination));
+
+            // Encrypt straight into the ciphertext and tag slots
+            Span<byte> output = destination;
+            Encrypt(
+                nonce, plaintext,
+                output.Slice(NonceSize, plaintext.Length),
+                output.Slice(NonceSize + plaintext.Length, TagSize),
+                associatedData);
+            nonce.CopyTo(output);
+            return plaintext.Length + SealOverhead;
+        }
+
+        /// <summary>
+        /// Encrypts plaintext under a fresh random nonce into a single buffer laid out as
+        /// nonce || ciphertext || tag, which <see cref="Open(byte[], byte[], byte[])"/> reads back.
+        /// </summary>
+        /// <param name="plaintext">The data to encrypt.</param>
+        /// <param name="destination">
+        /// The output buffer. Must be at least <see cref="SealOverhead"/> bytes longer than
+        /// <paramref name="plaintext"/>. The plaintext may already sit at offset 12 to seal in place, but
+        /// must not otherwise overlap it.
+        /// </param>
+        /// <param name="associatedData">Optional additional authenticated data.</param>
+        /// <returns>The number of bytes written to <paramref name="destination"/>.</returns>
+        /// <remarks>
+        /// The nonce comes from the same per-thread buffer as <see cref="GenerateNonce"/>, within the same
+        /// native call as the encryption. Calls handled in managed code draw it from
+        /// <see cref="RandomNumberGenerator"/> instead.
+        /// </remarks>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentException">The destination is too small, or the buffers partially overlap.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public int SealWithRandomNonce(
+            ReadOnlySpan<byte> plaintext,
+            Span<byte> destination,
+            ReadOnlySpan<byte> associatedData = default)
+        {
+            ThrowIfDisposed();
+            if (destination.Length - SealOverhead < plaintext.Length)
+                throw new ArgumentException("Destination buffer is too small.", nameof(destination));
+            Span<byte> ciphertext = destination.Slice(NonceSize, plaintext.Length);
+            if (plaintext.Overlaps(ciphertext, out int offset) && offset != 0 ||
+                plaintext.Overlaps(destination.Slice(0, NonceSize)) ||
+                plaintext.Overlaps(destination.Slice(NonceSize + plaintext.Length, TagSize)))
+                throw new ArgumentException("Input and output buffers must be the same memory or not overlap.", nameof(destination));
+
+            int result;
+            if (UseManaged(plaintext.Length, associatedData.Length))
+            {
+                // The native library may not be loaded at all on this path
+                Span<byte> nonce = stackalloc byte[NonceSize];
+                RandomNumberGenerator.Fill(nonce);
+                result = EncryptCore(nonce, plaintext, ciphertext, destination.Slice(NonceSize + plaintext.Length, TagSize), associatedData);
+                if (result == AESGCMSIV_SUCCESS)
+                    nonce.CopyTo(destination);
+            }
+            else
+            {
+                long started = AesGcmSivMetrics.IsEnabled ? Stopwatch.GetTimestamp() : 0;
+                using (var context = new SafeAesGcmSivHandle.Lease(_context!))
+                {
+                    fixed (byte* input = &BufferReference(plaintext))
+                    fixed (byte* aad = associatedData)
+                    fixed (byte* output = destination)
+                    {
+                        result = AesGcmSivNative.CtxEncryptAutoNonce(
+                            context.Pointer,
+                            input, (nuint)plaintext.Length,
+                            aad, (nuint)associatedData.Length,
+                            output);
+                    }
+                }
+                if (started != 0)
+                    AesGcmSivMetrics.Record(decrypt: false, result, plaintext.Length, started);
+            }
+
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                throw new CryptographicException($"Encryption failed with error code: {result}");
+            }
+            return plaintext.Length + SealOverhead;
+        }
+
+        /// <summary>
+        /// Fills <paramref name="nonce"/> with random bytes for use as a nonce.
+        /// </summary>
+        /// <param name="nonce">The buffer to fill. Must be exactly 12 bytes (96 bits).</param>
+        /// <remarks>
+        /// Nonces are drawn from OpenSSL's random generator in bulk and handed out from a per-thread
+        /// native buffer, so this is much cheaper per call than <see cref="RandomNumberGenerator.Fill"/>
+        /// for 12 bytes. A forked child never reuses its parent's buffered nonces.
+        /// </remarks>
+        /// <exception cref="ArgumentException"><paramref name="nonce"/> is not 12 bytes.</exception>
+        /// <exception cref="CryptographicException">The random generator failed.</exception>
+        public static void GenerateNonce(Span<byte> nonce)
+        {
+            if (nonce.Length != NonceSize)
+                throw new ArgumentException($"Nonce must be exactly {NonceSize} bytes (96 bits).", nameof(nonce));
+            AesGcmSivNative.EnsureLoaded();
+
+            int result;
+            fixed (byte* noncePtr = nonce)
+            {
+                result = AesGcmSivNative.RandomNonce(noncePtr);
+            }
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                throw new CryptographicException($"Nonce generation failed with error code: {result}");
+            }
+        }
+
+        /// <summary>
+        /// Verifies and decrypts a buffer laid out as nonce || ciphertext || tag, as produced by <see cref="Seal(byte[], byte[], byte[], byte[])"/>.
+        /// </summary>
+        /// <param name="sealedData">The sealed message. Must be at least <see cref="SealOverhead"/> bytes.</param>
+        /// <param name="destination">
+        /// The output buffer for the plaintext. Must be at least <paramref name="sealedData"/> length minus
+        /// <see cref="SealOverhead"/> bytes. Zeroed if the tag does not verify.
+        /// </param>
+        /// <param name="associatedData">Optional additional authenticated data (must match the data used during encryption).</param>
+        /// <returns>The number of plaintext bytes written to <paramref name="destination"/>.</returns>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentNullException">Any required parameter is null.</exception>
+        /// <exception cref="ArgumentException">Parameter sizes are invalid.</exception>
+        /// <exception cref="CryptographicException">Decryption failed or authentication tag is invalid.</exception>
+        public int Open(
+            byte[] sealedData,
+            byte[] destination,
+            byte[]? associatedData = null)
+        {
+            ThrowIfDisposed();
+            if (sealedData == null)
+                throw new ArgumentNullException(nameof(sealedData));
+            if (destination == null)
+                throw new ArgumentNullException(nameof(destination));
+
+            if (sealedData.Length < SealOverhead)
+                throw new ArgumentException($"Sealed data must be at least {SealOverhead} bytes.", nameof(sealedData));
+            int plaintextLength = sealedData.Length - SealOverhead;
+            if (destination.Length < plaintextLength)
+                throw new ArgumentException("Destination buffer is too small.", nameof(destination));
+
+            ReadOnlySpan<byte> input = sealedData;
+            Decrypt(
+                input.Slice(0, NonceSize),
+                input.Slice(NonceSize, plaintextLength),
+                input.Slice(NonceSize + plaintextLength, TagSize),
+                destination.AsSpan(0, plaintextLength),
+                associatedData);
+            return plaintextLength;
+        }
+
+        /// <summary>
+        /// Encrypts plaintext straight into memory from <paramref name="destination"/> as
+        /// ciphertext || tag, with no intermediate array.
+        /// </summary>
+        /// <param name="nonce">The nonce. Must be exactly 12 bytes (96 bits).</param>
+        /// <param name="plaintext">
+        /// The data to encrypt. May already sit at the start of the writer's next span to encrypt in
+        /// place, but must not otherwise overlap it.
+        /// </param>
+        /// <param name="destination">
+        /// The writer to encrypt into. Exactly 16 bytes more than <paramref name="plaintext"/> are requested
+        /// from it, and it is advanced by that much.
+        /// </param>
+        /// <param name="associatedData">Optional additional authenticated data.</param>
+        /// <returns>The number of bytes written to <paramref name="destination"/>.</returns>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentNullException"><paramref name="destination"/> is null.</exception>
+        /// <exception cref="ArgumentException">Parameter sizes are invalid, or the buffers partially overlap.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public int Encrypt(
+            ReadOnlySpan<byte> nonce,
+            ReadOnlySpan<byte> plaintext,
+            IBufferWriter<byte> destination,
+            ReadOnlySpan<byte> associatedData = default)
+        {
+            ThrowIfDisposed();
+            if (destination == null)
+                throw new ArgumentNullException(nameof(destination));
+            if (plaintext.Length > Array.MaxLength - TagSize)
+                throw new ArgumentException("Plaintext is too large.", nameof(plaintext));
+
+            int length = plaintext.Length + TagSize;
+            Span<byte> output = destination.GetSpan(length).Slice(0, length);
+            Encrypt(nonce, plaintext, output.Slice(0, plaintext.Length), output.Slice(plaintext.Length), associatedData);
+            destination.Advance(length);
+            return length;
+        }
+
+        /// <summary>
+        /// Encrypts plaintext straight into memory from <paramref name="destination"/> as
+        /// nonce || ciphertext || tag, the layout <see cref="Open(ReadOnlySpan{byte}, IBufferWriter{byte}, ReadOnlySpan{byte})"/>
+        /// reads back.
+        /// </summary>
+        /// <param name="nonce">The nonce. Must be exactly 12 bytes (96 bits).</param>
+        /// <param name="plaintext">The data to encrypt. Must not overlap the writer's memory.</param>
+        /// <param name="destination">
+        /// The writer to seal into. Exactly <see cref="SealOverhead"/> bytes more than
+        /// <paramref name="plaintext"/> are requested from it, and it is advanced by that much.
+        /// </param>
+        /// <param name="associatedData">Optional additional authenticated data.</param>
+        /// <returns>The number of bytes written to <paramref name="destination"/>.</returns>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentNullException"><paramref name="destination"/> is null.</exception>
+        /// <exception cref="ArgumentException">Parameter sizes are invalid.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public int Seal(
+            ReadOnlySpan<byte> nonce,
+            ReadOnlySpan<byte> plaintext,
+            IBufferWriter<byte> destination,
+            ReadOnlySpan<byte> associatedData = default)
+        {
+            ThrowIfDisposed();
+            if (destination == null)
+                throw new ArgumentNullException(nameof(destination));
+            if (nonce.Length != NonceSize)
+                throw new ArgumentException($"Nonce must be exactly {NonceSize} bytes (96 bits).", nameof(nonce));
+            if (plaintext.Length > Array.MaxLength - SealOverhead)
+                throw new ArgumentException("Plaintext is too large.", nameof(plaintext));
+
+            int length = plaintext.Length + SealOverhead;
+            Span<byte> output = destination.GetSpan(length).Slice(0, length);
+            Encrypt(
+                nonce, plaintext,
+                output.Slice(NonceSize, plaintext.Length),
+                output.Slice(NonceSize + plaintext.Length, TagSize),
+                associatedData);
+            nonce.CopyTo(output);
+            destination.Advance(length);
+            return length;
+        }
+
+        /// <summary>
+        /// Encrypts plaintext under a fresh random nonce straight into memory from
+        /// <paramref name="destination"/> as nonce || ciphertext || tag.
+        /// </summary>
+        /// <param name="plaintext">The data to encrypt. Must not overlap the writer's memory.</param>
+        /// <param name="destination">
+        /// The writer to seal into. Exactly <see cref="SealOverhead"/> bytes more than
+        /// <paramref name="plaintext"/> are requested from it, and it is advanced by that much.
+        /// </param>
+        /// <param name="associatedData">Optional additional authenticated data.</param>
+        /// <returns>The number of bytes written to <paramref name="destination"/>.</returns>
+        /// <remarks>
+        /// The nonce is drawn as for <see cref="SealWithRandomNonce(ReadOnlySpan{byte}, Span{byte}, ReadOnlySpan{byte})"/>.
+        /// </remarks>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentNullException"><paramref name="destination"/> is null.</exception>
+        /// <exception cref="ArgumentException">The plaintext is too large, or overlaps the writer's memory.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public int SealWithRandomNonce(
+            ReadOnlySpan<byte> plaintext,
+            IBufferWriter<byte> destination,
+            ReadOnlySpan<byte> associatedData = default)
+        {
+            ThrowIfDisposed();
+            if (destination == null)
+                throw new ArgumentNullException(nameof(destination));
+            if (plaintext.Length > Array.MaxLength - SealOverhead)
+                throw new ArgumentException("Plaintext is too large.", nameof(plaintext));
+
+            int length = plaintext.Length + SealOverhead;
+            SealWithRandomNonce(plaintext, destination.GetSpan(length).Slice(0, length), associatedData);
+            destination.Advance(length);
+            return length;
+        }
+
+        /// <summary>
+        /// Verifies and decrypts a buffer laid out as nonce || ciphertext || tag straight into memory from
+        /// <paramref name="destination"/>.
+        /// </summary>
+        /// <param name="sealedData">The sealed message. Must be at least <see cref="SealOverhead"/> bytes.</param>
+        /// <param name="destination">
+        /// The writer to decrypt into. Exactly <see cref="SealOverhead"/> bytes less than
+        /// <paramref name="sealedData"/> are requested from it. It is advanced only once the tag verifies,
+        /// so a forged message never becomes part of its output.
+        /// </param>
+        /// <param name="associatedData">Optional additional authenticated data (must match the data used during encryption).</param>
+        /// <returns>The number of plaintext bytes written to <paramref name="destination"/>.</returns>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentNullException"><paramref name="destination"/> is null.</exception>
+        /// <exception cref="ArgumentException">Parameter sizes are invalid.</exception>
+        /// <exception cref="CryptographicException">Decryption failed or authentication tag is invalid.</exception>
+        public int Open(
+            ReadOnlySpan<byte> sealedData,
+            IBufferWriter<byte> destination,
+            ReadOnlySpan<byte> associatedData = default)
+        {
+            ThrowIfDisposed();
+            if (destination == null)
+                throw new ArgumentNullException(nameof(destination));
+            if (sealedData.Length < SealOverhead)
+                throw new ArgumentException($"Sealed data must be at least {SealOverhead} bytes.", nameof(sealedData));
+
+            int plaintextLength = sealedData.Length - SealOverhead;
+            Span<byte> output = destination.GetSpan(plaintextLength).Slice(0, plaintextLength);
+            Decrypt(
+                sealedData.Slice(0, NonceSize),
+                sealedData.Slice(NonceSize, plaintextLength),
+                sealedData.Slice(NonceSize + plaintextLength, TagSize),
+                output,
+                associatedData);
+            destination.Advance(plaintextLength);
+            return plaintextLength;
+        }
+
+        /// <summary>
+        /// Encrypts plaintext as nonce || ciphertext || tag into memory rented from the shared array pool,
+        /// sized exactly to the sealed message.
+        /// </summary>
+        /// <param name="nonce">The nonce. Must be exactly 12 bytes (96 bits).</param>
+        /// <param name="plaintext">The data to encrypt.</param>
+        /// <param name="associatedData">Optional additional authenticated data.</param>
+        /// <returns>
+        /// The sealed message, <see cref="SealOverhead"/> bytes longer than <paramref name="plaintext"/>.
+        /// Dispose it to return the memory to the pool, and do not use it afterwards.
+        /// </returns>
+        /// <remarks>
+        /// Once the pool is warm, a call that disposes its result on the same thread allocates nothing.
+        /// Prefer this to allocating a destination per message when the sealed bytes are written out and
+        /// dropped.
+        /// </remarks>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentException">Parameter sizes are invalid.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public IMemoryOwner<byte> SealPooled(
+            ReadOnlySpan<byte> nonce,
+            ReadOnlySpan<byte> plaintext,
+            ReadOnlySpan<byte> associatedData = default)
+        {
+            ThrowIfDisposed();
+            if (nonce.Length != NonceSize)
+                throw new ArgumentException($"Nonce must be exactly {NonceSize} bytes (96 bits).", nameof(nonce));
+            if (plaintext.Length > Array.MaxLength - SealOverhead)
+                throw new ArgumentException("Plaintext is too large.", nameof(plaintext));
+
+            int length = plaintext.Length + SealOverhead;
+            AesGcmSivPooledBuffer owner = AesGcmSivPooledBuffer.Rent(length, clearOnReturn: false);
+            try
+            {
+                Span<byte> output = owner.Memory.Span;
+                Encrypt(
+                    nonce, plaintext,
+                    output.Slice(NonceSize, plaintext.Length),
+                    output.Slice(NonceSize + plaintext.Length, TagSize),
+                    associatedData);
+                nonce.CopyTo(output);
+            }
+            catch
+            {
+                owner.Dispose();
+                throw;
+            }
+            return owner;
+        }
+
+        /// <summary>
+        /// Verifies and decrypts a buffer laid out as nonce || ciphertext || tag into memory rented from
+        /// the shared array pool, sized exactly to the plaintext.
+        /// </summary>
+        /// <param name="sealedData">The sealed message. Must be at least <see cref="SealOverhead"/> bytes.</param>
+        /// <param name="associatedData">Optional additional authenticated data (must match the data used during encryption).</param>
+        /// <returns>
+        /// The plaintext. Dispose it to zero the memory and return it to the pool, and do not use it
+        /// afterwards.
+        /// </returns>
+        /// <remarks>
+        /// If the tag does not verify, the rented memory is zeroed and returned before the exception is
+        /// thrown, so no unauthenticated plaintext is left in the pool.
+        /// </remarks>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentException">Parameter sizes are invalid.</exception>
+        /// <exception cref="CryptographicException">Decryption failed or authentication tag is invalid.</exception>
+        public IMemoryOwner<byte> OpenPooled(
+            ReadOnlySpan<byte> sealedData,
+            ReadOnlySpan<byte> associatedData = default)
+        {
+            ThrowIfDisposed();
+            if (sealedData.Length < SealOverhead)
+                throw new ArgumentException($"Sealed data must be at least {SealOverhead} bytes.", nameof(sealedData));
+
+            int plaintextLength = sealedData.Length - SealOverhead;
+            AesGcmSivPooledBuffer owner = AesGcmSivPooledBuffer.Rent(plaintextLength, clearOnReturn: true);
+            try
+            {
+                Decrypt(
+                    sealedData.Slice(0, NonceSize),
+                    sealedData.Slice(NonceSize, plaintextLength),
+                    sealedData.Slice(NonceSize + plaintextLength, TagSize),
+                    owner.Memory.Span,
+                    associatedData);
+            }
+            catch
+            {
+                owner.Dispose();
+                throw;
+            }
+            return owner;
+        }
+
+        /// <summary>
+        /// Returns the length of the token <see cref="SealBase64Url"/> writes for a plaintext of
+        /// <paramref name="plaintextLength"/> bytes.
+        /// </summary>
+        /// <param name="plaintextLength">The plaintext length in bytes.</param>
+        /// <returns>The token length in UTF-8 bytes, which are all ASCII.</returns>
+        /// <exception cref="ArgumentOutOfRangeException">
+        /// <paramref name="plaintextLength"/> is negative, or its token would not fit in an <see cref="int"/>.
+        /// </exception>
+        public static int GetBase64UrlTokenLength(int plaintextLength)
+        {
+            ArgumentOutOfRangeException.ThrowIfNegative(plaintextLength);
+            ArgumentOutOfRangeException.ThrowIfGreaterThan(plaintextLength, MaxBase64UrlPlaintextLength);
+            return Base64Url.GetEncodedLength(plaintextLength + SealOverhead);
+        }
+
+        /// <summary>
+        /// Encrypts plaintext into a URL-safe token: nonce || ciphertext || tag in unpadded base64url
+        /// (RFC 4648, section 5), ready for a cookie, header or query string.
+        /// </summary>
+        /// <param name="nonce">The nonce. Must be exactly 12 bytes (96 bits).</param>
+        /// <param name="plaintext">The data to encrypt.</param>
+        /// <param name="utf8Destination">
+        /// The output buffer for the token's characters, as UTF-8. Must be at least
+        /// <see cref="GetBase64UrlTokenLength"/> bytes, and must not overlap <paramref name="nonce"/> or
+        /// <paramref name="plaintext"/>.
+        /// </param>
+        /// <param name="associatedData">Optional additional authenticated data.</param>
+        /// <returns>The number of bytes written to <paramref name="utf8Destination"/>.</returns>
+        /// <remarks>
+        /// The native library seals the message into the tail of <paramref name="utf8Destination"/> and
+        /// encodes it in place in the same call, while it is still in cache, with a vector encoder where
+        /// the CPU has one. There is no intermediate buffer on either path.
+        /// </remarks>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentException">Parameter sizes are invalid, or the buffers overlap.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public int SealBase64Url(
+            ReadOnlySpan<byte> nonce,
+            ReadOnlySpan<byte> plaintext,
+            Span<byte> utf8Destination,
+            ReadOnlySpan<byte> associatedData = default)
+        {
+            ThrowIfDisposed();
+            if (nonce.Length != NonceSize)
+                throw new ArgumentException($"Nonce must be exactly {NonceSize} bytes (96 bits).", nameof(nonce));
+            return SealBase64UrlCore(nonce, plaintext, utf8Destination, associatedData);
+        }
+
+        /// <summary>
+        /// Encrypts plaintext under a fresh random nonce into a URL-safe token, as
+        /// <see cref="SealBase64Url"/> does.
+        /// </summary>
+        /// <param name="plaintext">The data to encrypt.</param>
+        /// <param name="utf8Destination">
+        /// The output buffer for the token's characters, as UTF-8. Must be at least
+        /// <see cref="GetBase64UrlTokenLength"/> bytes, and must not overlap <paramref name="plaintext"/>.
+        /// </param>
+        /// <param name="associatedData">Optional additional authenticated data.</param>
+        /// <returns>The number of bytes written to <paramref name="utf8Destination"/>.</returns>
+        /// <remarks>
+        /// The nonce is drawn as for <see cref="SealWithRandomNonce(ReadOnlySpan{byte}, Span{byte}, ReadOnlySpan{byte})"/>.
+        /// </remarks>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentException">The destination is too small, or the buffers overlap.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public int SealBase64UrlWithRandomNonce(
+            ReadOnlySpan<byte> plaintext,
+            Span<byte> utf8Destination,
+            ReadOnlySpan<byte> associatedData = default)
+        {
+            ThrowIfDisposed();
+            return SealBase64UrlCore(default, plaintext, utf8Destination, associatedData);
+        }
+
+        // An empty nonce draws a random one
+        private int SealBase64UrlCore(
+            ReadOnlySpan<byte> nonce, ReadOnlySpan<byte> plaintext, Span<byte> utf8Destination,
+            ReadOnlySpan<byte> associatedData)
+        {
+            if (plaintext.Length > MaxBase64UrlPlaintextLength)
+                throw new ArgumentException("Plaintext is too large.", nameof(plaintext));
+            int tokenLength = GetBase64UrlTokenLength(plaintext.Length);
+            if (utf8Destination.Length < tokenLength)
+                throw new ArgumentException("Destination buffer is too small.", nameof(utf8Destination));
+            utf8Destination = utf8Destination.Slice(0, tokenLength);
+            if (plaintext.Overlaps(utf8Destination) || nonce.Overlaps(utf8Destination))
+                throw new ArgumentException("Input and output buffers must not overlap.", nameof(utf8Destination));
+
+            int result;
+            if (UseManaged(plaintext.Length, associatedData.Length))
+            {
+                // Seal in front and encode in place, back to front
+                Span<byte> fresh = stackalloc byte[NonceSize];
+                if (nonce.IsEmpty)
+                    RandomNumberGenerator.Fill(fresh);
+                ReadOnlySpan<byte> sealNonce = nonce.IsEmpty ? fresh : nonce;
+                Span<byte> sealedData = utf8Destination.Slice(0, plaintext.Length + SealOverhead);
+                result = EncryptCore(
+                    sealNonce, plaintext,
+                    sealedData.Slice(NonceSize, plaintext.Length),
+                    sealedData.Slice(NonceSize + plaintext.Length, TagSize),
+                    associatedData);
+                if (result == AESGCMSIV_SUCCESS)
+                {
+                    sealNonce.CopyTo(sealedData);
+                    Base64Url.EncodeToUtf8InPlace(utf8Destination, sealedData.Length, out _);
+                }
+            }
+            else
+            {
+                long started = AesGcmSivMetrics.IsEnabled ? Stopwatch.GetTimestamp() : 0;
+                using (var context = new SafeAesGcmSivHandle.Lease(_context!))
+                {
+                    fixed (byte* noncePtr = nonce)
+                    fixed (byte* input = &BufferReference(plaintext))
+                    fixed (byte* aad = associatedData)
+                    fixed (byte* output = utf8Destination)
+                    {
+                        nuint written;
+                        result = AesGcmSivNative.CtxSealBase64Url(
+                            context.Pointer,
+                            noncePtr, (nuint)nonce.Length,
+                            input, (nuint)plaintext.Length,
+                            aad, (nuint)associatedData.Length,
+                            output, &written);
+                    }
+                }
+                if (started != 0)
+                    AesGcmSivMetrics.Record(decrypt: false, result, plaintext.Length, started);
+            }
+
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                throw new CryptographicException($"Encryption failed with error code: {result}");
+            }
+            return tokenLength;
+        }
+
+        /// <summary>
+        /// Verifies and decrypts a token written by <see cref="SealBase64Url"/> or
+        /// <see cref="SealBase64UrlWithRandomNonce"/>.
+        /// </summary>
+        /// <param name="utf8Token">The token's characters, as UTF-8.</param>
+        /// <param name="destination">
+        /// The output buffer for the plaintext. Must hold the token's plaintext, which is
+        /// <see cref="SealOverhead"/> bytes less than the token decodes to, and must not overlap
+        /// <paramref name="utf8Token"/>.
+        /// </param>
+        /// <param name="bytesWritten">The number of plaintext bytes written, or 0 on failure.</param>
+        /// <param name="associatedData">Optional additional authenticated data (must match the data used during encryption).</param>
+        /// <returns>
+        /// <see langword="true"/> if the token decoded and verified; <see langword="false"/> otherwise, in
+        /// which case <paramref name="destination"/> holds no plaintext.
+        /// </returns>
+        /// <remarks>
+        /// Tokens are read strictly: padding, whitespace, characters outside the base64url alphabet and
+        /// stray bits in the last character all make a token invalid, so each message has exactly one
+        /// token. The ciphertext is decoded straight into <paramref name="destination"/> and decrypted
+        /// there, with no intermediate buffer.
+        /// </remarks>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentException">The destination is too small, or the buffers overlap.</exception>
+        /// <exception cref="CryptographicException">Decryption failed for a reason other than an invalid token.</exception>
+        public bool TryOpenBase64Url(
+            ReadOnlySpan<byte> utf8Token,
+            Span<byte> destination,
+            out int bytesWritten,
+            ReadOnlySpan<byte> associatedData = default)
+        {
+            ThrowIfDisposed();
+            bytesWritten = 0;
+            if (!TryGetBase64UrlPlaintextLength(utf8Token.Length, out int plaintextLength))
+                return false;
+            if (destination.Length < plaintextLength)
+                throw new ArgumentException("Destination buffer is too small.", nameof(destination));
+            destination = destination.Slice(0, plaintextLength);
+            if (utf8Token.Overlaps(destination))
+                throw new ArgumentException("Input and output buffers must not overlap.", nameof(destination));
+
+            int result;
+            if (UseManaged(plaintextLength, associatedData.Length))
+            {
+                result = OpenBase64UrlManaged(utf8Token, destination, associatedData);
+            }
+            else
+            {
+                long started = AesGcmSivMetrics.IsEnabled ? Stopwatch.GetTimestamp() : 0;
+                using (var context = new SafeAesGcmSivHandle.Lease(_context!))
+                {
+                    fixed (byte* token = utf8Token)
+                    fixed (byte* aad = associatedData)
+                    fixed (byte* output = &BufferReference(destination))
+                    {
+                        nuint written;
+                        result = AesGcmSivNative.CtxOpenBase64Url(
+                            context.Pointer,
+                            token, (nuint)utf8Token.Length,
+                            aad, (nuint)associatedData.Length,
+                            output, &written);
+                    }
+                }
+                if (started != 0)
+                    AesGcmSivMetrics.Record(decrypt: true, result, plaintextLength, started);
+            }
+
+            if (result == AESGCMSIV_ERROR_DECRYPT_FAILED || result == AESGCMSIV_ERROR_INVALID_INPUT)
+                return false;
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                throw new CryptographicException($"Decryption failed with error code: {result}");
+            }
+            bytesWritten = plaintextLength;
+            return true;
+        }
+
+        // The same layout as the native decoder: the nonce and the group or two holding the tag on
+        // the stack, the rest of the ciphertext straight into destination, which is then decrypted
+        // in place. destination is exactly the plaintext length.
+        private int OpenBase64UrlManaged(
+            ReadOnlySpan<byte> utf8Token, Span<byte> destination, ReadOnlySpan<byte> associatedData)
+        {
+            if (!IsCanonicalBase64Url(utf8Token))
+                return AESGCMSIV_ERROR_INVALID_INPUT;
+
+            Span<byte> nonce = stackalloc byte[NonceSize];
+            Span<byte> tail = stackalloc byte[2 + TagSize];
+            int headLength = destination.Length / 3 * 3;
+            int tailLength = destination.Length - headLength;
+            ReadOnlySpan<byte> encoded = utf8Token.Slice(Base64UrlNonceLength);
+            int headCharacters = headLength / 3 * 4;
+            Base64Url.DecodeFromUtf8(utf8Token.Slice(0, Base64UrlNonceLength), nonce, out _, out _);
+            Base64Url.DecodeFromUtf8(encoded.Slice(0, headCharacters), destination, out _, out _);
+            Base64Url.DecodeFromUtf8(encoded.Slice(headCharacters), tail, out _, out _);
+            tail.Slice(0, tailLength).CopyTo(destination.Slice(headLength));
+            return DecryptCore(nonce, destination, tail.Slice(tailLength, TagSize), destination, associatedData);
+        }
+
+        // Token lengths a plaintext can have: 16 characters of nonce, then at least the tag's 22
+        private static bool TryGetBase64UrlPlaintextLength(int tokenLength, out int plaintextLength)
+        {
+            plaintextLength = 0;
+            int remainder = tokenLength % 4;
+            if (tokenLength < GetBase64UrlTokenLength(0) || remainder == 1)
+                return false;
+            plaintextLength = tokenLength / 4 * 3 + (remainder == 0 ? 0 : remainder - 1) - SealOverhead;
+            return true;
+        }
+
+        // As strict as the native decoder, which .NET's is not: it skips whitespace and ignores
+        // stray bits in the last character
+        private static bool IsCanonicalBase64Url(ReadOnlySpan<byte> utf8)
+        {
+            if (utf8.IndexOfAnyExcept(s_base64UrlAlphabet) >= 0)
+                return false;
+            int remainder = utf8.Length % 4;
+            if (remainder == 0)
+                return true;
+            int last = utf8[^1] switch
+            {
+                >= (byte)'a' => utf8[^1] - 'a' + 26,
+                >= (byte)'A' and <= (byte)'Z' => utf8[^1] - 'A',
+                >= (byte)'0' and <= (byte)'9' => utf8[^1] - '0' + 52,
+                (byte)'-' => 62,
+                _ => 63,
+            };
+            return (last & (remainder == 2 ? 0x0f : 0x03)) == 0;
+        }
+
+        /// <summary>
+        /// Encrypts a whole file into another in the chunked format of <see cref="AesGcmSivStream"/>.
+        /// </summary>
+        /// <param name="sourcePath">The file to encrypt.</param>
+        /// <param name="destinationPath">The file to create or replace. Deleted if encryption fails.</param>
+        /// <param name="chunkSize">Plaintext bytes per chunk, from 1 to <see cref="AesGcmSivStream.MaxChunkSize"/>.</param>
+        /// <param name="associatedData">Optional additional authenticated data, bound to every chunk.</param>
+        /// <remarks>
+        /// Both files are memory-mapped, and each chunk is encrypted straight from the source mapping
+        /// into the destination mapping, with no copy through a managed buffer. Both are opened with
+        /// <see cref="FileOptions.SequentialScan"/>. The result reads back with <see cref="DecryptFile"/>,
+        /// <see cref="AesGcmSivStream"/> or the native <c>aesgcmsiv_stream_open_file</c>.
+        /// </remarks>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentNullException"><paramref name="sourcePath"/> or <paramref name="destinationPath"/> is null.</exception>
+        /// <exception cref="ArgumentOutOfRangeException"><paramref name="chunkSize"/> is out of range.</exception>
+        /// <exception cref="ArgumentException">The file needs more chunks than the format allows at this chunk size.</exception>
+        /// <exception cref="IOException">A file could not be opened, sized or mapped.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public void EncryptFile(
+            string sourcePath,
+            string destinationPath,
+            int chunkSize = AesGcmSivStream.DefaultChunkSize,
+            byte[]? associatedData = null)
+        {
+            ThrowIfDisposed();
+            if (sourcePath == null)
+                throw new ArgumentNullException(nameof(sourcePath));
+            if (destinationPath == null)
+                throw new ArgumentNullException(nameof(destinationPath));
+            ArgumentOutOfRangeException.ThrowIfNegativeOrZero(chunkSize);
+            ArgumentOutOfRangeException.ThrowIfGreaterThan(chunkSize, AesGcmSivStream.MaxChunkSize);
+
+            using var input = AesGcmSivMappedFile.Open(sourcePath);
+            // An empty file still gets an empty last chunk
+            long chunks = Math.Max(1, (input.Length + chunkSize - 1) / chunkSize);
+            if (chunks - 1 > uint.MaxValue)
+                throw new ArgumentException("The file needs too many chunks at this chunk size.", nameof(chunkSize));
+
+            var output = AesGcmSivMappedFile.Create(
+                destinationPath, AesGcmSivStream.HeaderSize + input.Length + chunks * TagSize);
+            bool completed = false;
+            try
+            {
+                Span<byte> prefix = stackalloc byte[AesGcmSivStream.PrefixSize];
+                AesGcmSivStream.WriteHeader(output.GetSpan(0, AesGcmSivStream.HeaderSize), chunkSize, prefix);
+
+                Span<byte> nonce = stackalloc byte[NonceSize];
+                for (long i = 0; i < chunks; i++)
+                {
+                    bool last = i == chunks - 1;
+                    long offset = i * chunkSize;
+                    int length = last ? (int)(input.Length - offset) : chunkSize;
+                    AesGcmSivStream.ChunkNonce(prefix, (ulong)i, last, nonce);
+                    Span<byte> sealedChunk = output.GetSpan(AesGcmSivStream.HeaderSize + offset + i * TagSize, length + TagSize);
+                    Encrypt(nonce, input.GetSpan(offset, length), sealedChunk.Slice(0, length), sealedChunk.Slice(length), associatedData);
+                }
+                completed = true;
+            }
+            finally
+            {
+                output.Dispose();
+                if (!completed)
+                    File.Delete(destinationPath);
+            }
+        }
+
+        /// <summary>
+        /// Decrypts a whole file written by <see cref="EncryptFile"/> or <see cref="AesGcmSivStream"/> into
+        /// another.
+        /// </summary>
+        /// <param name="sourcePath">The encrypted file.</param>
+        /// <param name="destinationPath">
+        /// The file to create or replace. Deleted if any chunk fails to authenticate, so no unverified
+        /// plaintext is left behind.
+        /// </param>
+        /// <param name="associatedData">The additional authenticated data the file was encrypted with, if any.</param>
+        /// <remarks>
+        /// Both files are memory-mapped as for <see cref="EncryptFile"/>, and each chunk is decrypted
+        /// straight from one mapping into the other.
+        /// </remarks>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentNullException"><paramref name="sourcePath"/> or <paramref name="destinationPath"/> is null.</exception>
+        /// <exception cref="IOException">A file could not be opened, sized or mapped.</exception>
+        /// <exception cref="CryptographicException">
+        /// The file is not a valid stream for this key and associated data, or has been truncated or altered.
+        /// </exception>
+        public void DecryptFile(
+            string sourcePath,
+            string destinationPath,
+            byte[]? associatedData = null)
+        {
+            ThrowIfDisposed();
+            if (sourcePath == null)
+                throw new ArgumentNullException(nameof(sourcePath));
+            if (destinationPath == null)
+                throw new ArgumentNullException(nameof(destinationPath));
+
+            using var input = AesGcmSivMappedFile.Open(sourcePath);
+            Span<byte> prefix = stackalloc byte[AesGcmSivStream.PrefixSize];
+            int headerLength = (int)Math.Min(input.Length, AesGcmSivStream.HeaderSize);
+            int chunkSize = AesGcmSivStream.ParseHeader(input.GetSpan(0, headerLength), headerLength, prefix);
+
+            // Every chunk but the last is full; the last holds at least a tag
+            long sealedLength = input.Length - AesGcmSivStream.HeaderSize;
+            long full = chunkSize + TagSize;
+            long chunks = (sealedLength + full - 1) / full;
+            long lastSealedLength = sealedLength - (chunks - 1) * full;
+            if (chunks == 0 || lastSealedLength < TagSize || chunks - 1 > uint.MaxValue)
+                throw new CryptographicException("The stream has been truncated.");
+
+            var output = AesGcmSivMappedFile.Create(destinationPath, sealedLength - chunks * TagSize);
+            bool completed = false;
+            try
+            {
+                Span<byte> nonce = stackalloc byte[NonceSize];
+                for (long i = 0; i < chunks; i++)
+                {
+                    bool last = i == chunks - 1;
+                    int length = (int)(last ? lastSealedLength : full) - TagSize;
+                    AesGcmSivStream.ChunkNonce(prefix, (ulong)i, last, nonce);
+                    Span<byte> sealedChunk = input.GetSpan(AesGcmSivStream.HeaderSize + i * full, length + TagSize);
+                    if (!TryDecrypt(nonce, sealedChunk.Slice(0, length), sealedChunk.Slice(length), output.GetSpan(i * chunkSize, length), associatedData))
+                        throw new CryptographicException("A stream chunk failed to authenticate.");
+                }
+                completed = true;
+            }
+            finally
+            {
+                output.Dispose();
+                if (!completed)
+                    File.Delete(destinationPath);
+            }
+        }
+
+        /// <summary>
+        /// Encrypts a whole file into another as one standard AES-GCM-SIV message, ciphertext || tag,
+        /// for consumers that need that rather than the chunked format of <see cref="EncryptFile"/>.
+        /// </summary>
+        /// <param name="nonce">The nonce. Must be exactly 12 bytes (96 bits).</param>
+        /// <param name="sourcePath">The file to encrypt, at most 64 GiB.</param>
+        /// <param name="destinationPath">
+        /// The file to create or replace, 16 bytes longer than the source. Deleted if encryption fails.
+        /// </param>
+        /// <param name="associatedData">Optional additional authenticated data.</param>
+        /// <remarks>
+        /// The tag covers the whole plaintext and keys the encryption, so the source is read twice: a
+        /// POLYVAL pass, then a CTR pass. Both files are memory-mapped with
+        /// <see cref="FileOptions.SequentialScan"/>, so the operating system reads ahead of each pass and
+        /// drops pages behind it, and a file larger than memory needs no more than the mappings. The
+        /// result reads back with <see cref="DecryptMessageFile"/>, or as the ciphertext and tag of
+        /// <see cref="Decrypt(byte[], byte[], byte[], byte[], byte[])"/>. Files over 2 GB need the native
+        /// library and a hardware-accelerated backend.
+        /// </remarks>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentNullException"><paramref name="sourcePath"/> or <paramref name="destinationPath"/> is null.</exception>
+        /// <exception cref="ArgumentException">The nonce size is invalid, or the file is too large.</exception>
+        /// <exception cref="IOException">A file could not be opened, sized or mapped.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public void EncryptMessageFile(
+            ReadOnlySpan<byte> nonce,
+            string sourcePath,
+            string destinationPath,
+            byte[]? associatedData = null)
+        {
+            ThrowIfDisposed();
+            if (nonce.Length != NonceSize)
+                throw new ArgumentException($"Nonce must be exactly {NonceSize} bytes (96 bits).", nameof(nonce));
+            if (sourcePath == null)
+                throw new ArgumentNullException(nameof(sourcePath));
+            if (destinationPath == null)
+                throw new ArgumentNullException(nameof(destinationPath));
+
+            using var input = AesGcmSivMappedFile.Open(sourcePath);
+            if (input.Length > MaxMessageFileSize)
+                throw new ArgumentException("The file is too large for one message.", nameof(sourcePath));
+
+            var output = AesGcmSivMappedFile.Create(destinationPath, input.Length + TagSize);
+            bool completed = false;
+            try
+            {
+                int result = CryptMessageFile(decrypt: false, nonce, input, output, input.Length, associatedData);
+                if (result != AESGCMSIV_SUCCESS)
+                    throw new CryptographicException($"Encryption failed with error code: {result}");
+                completed = true;
+            }
+            finally
+            {
+                output.Dispose();
+                if (!completed)
+                    File.Delete(destinationPath);
+            }
+        }
+
+        /// <summary>
+        /// Decrypts a file written by <see cref="EncryptMessageFile"/>, one message stored as
+        /// ciphertext || tag, into another.
+        /// </summary>
+        /// <param name="nonce">The nonce used during encryption. Must be exactly 12 bytes (96 bits).</param>
+        /// <param name="sourcePath">The encrypted file.</param>
+        /// <param name="destinationPath">
+        /// The file to create or replace. Only replaced once the whole file has authenticated; on failure
+        /// it is left as it was.
+        /// </param>
+        /// <param name="associatedData">The additional authenticated data the file was encrypted with, if any.</param>
+        /// <remarks>
+        /// The tag can only be checked once all of the plaintext exists, so the plaintext is first
+        /// written to a provisional file beside <paramref name="destinationPath"/>, mapped as for
+        /// <see cref="EncryptMessageFile"/>, and renamed over it after the tag verifies. Peak memory
+        /// therefore stays at the mappings however large the file is, and unverified plaintext never
+        /// appears under the destination name.
+        /// </remarks>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentNullException"><paramref name="sourcePath"/> or <paramref name="destinationPath"/> is null.</exception>
+        /// <exception cref="ArgumentException">The nonce size is invalid, or the file is too large.</exception>
+        /// <exception cref="IOException">A file could not be opened, sized, mapped or renamed.</exception>
+        /// <exception cref="CryptographicException">
+        /// The file is not a valid message for this key, nonce and associated data, or has been truncated
+        /// or altered.
+        /// </exception>
+        public void DecryptMessageFile(
+            ReadOnlySpan<byte> nonce,
+            string sourcePath,
+            string destinationPath,
+            byte[]? associatedData = null)
+        {
+            ThrowIfDisposed();
+            if (nonce.Length != NonceSize)
+                throw new ArgumentException($"Nonce must be exactly {NonceSize} bytes (96 bits).", nameof(nonce));
+            if (sourcePath == null)
+                throw new ArgumentNullException(nameof(sourcePath));
+            if (destinationPath == null)
+                throw new ArgumentNullException(nameof(destinationPath));
+
+            using var input = AesGcmSivMappedFile.Open(sourcePath);
+            if (input.Length < TagSize)
+                throw new CryptographicException("The message has been truncated.");
+            long length = input.Length - TagSize;
+            if (length > MaxMessageFileSize)
+                throw new ArgumentException("The file is too large for one message.", nameof(sourcePath));
+
+            string provisional = destinationPath + ".partial-" + Convert.ToHexString(RandomNumberGenerator.GetBytes(NonceSize));
+            var output = AesGcmSivMappedFile.Create(provisional, length, replace: false);
+            bool committed = false;
+            try
+            {
+                int result;
+                try
+                {
+                    result = CryptMessageFile(decrypt: true, nonce, input, output, length, associatedData);
+                }
+                finally
+                {
+                    output.Dispose();
+                }
+                if (result == AESGCMSIV_ERROR_DECRYPT_FAILED)
+                    throw new CryptographicException("The message failed to authenticate.");
+                if (result != AESGCMSIV_SUCCESS)
+                    throw new CryptographicException($"Decryption failed with error code: {result}");
+
+                File.Move(provisional, destinationPath, overwrite: true);
+                committed = true;
+            }
+            finally
+            {
+                if (!committed)
+                    File.Delete(provisional);
+            }
+        }
+
+        // Encrypts or decrypts length bytes at the start of input into output,
+        // with the tag after the ciphertext in whichever file holds it. Native
+        // code takes 64-bit lengths, so the mappings are passed as pointers;
+        // the managed implementation only takes what a span can hold.
+        private int CryptMessageFile(
+            bool decrypt, ReadOnlySpan<byte> nonce, AesGcmSivMappedFile input, AesGcmSivMappedFile output,
+            long length, ReadOnlySpan<byte> associatedData)
+        {
+            if (_context == null)
+            {
+                if (length > Array.MaxLength)
+                    throw new ArgumentException("Files over 2 GB need the native library.");
+                ReadOnlySpan<byte> source = input.GetSpan(0, (int)length);
+                Span<byte> destination = output.GetSpan(0, (int)length);
+                return decrypt
+                    ? DecryptCore(nonce, source, input.GetSpan(length, TagSize), destination, associatedData)
+                    : EncryptCore(nonce, source, destination, output.GetSpan(length, TagSize), associatedData);
+            }
+
+            using var context = new SafeAesGcmSivHandle.Lease(_context);
+            // An empty file has no mapping, but native code wants a pointer
+            byte empty = 0;
+            byte* sourcePtr = length == 0 ? &empty : input.Pointer;
+            byte* targetPtr = length == 0 ? &empty : output.Pointer;
+            fixed (byte* noncePtr = nonce)
+            fixed (byte* aad = associatedData)
+            {
+                return decrypt
+                    ? AesGcmSivNative.CtxDecrypt(
+                        context.Pointer,
+                        noncePtr, (nuint)nonce.Length,
+                        sourcePtr, (nuint)length,
+                        aad, (nuint)associatedData.Length,
+                        input.Pointer + length, targetPtr)
+                    : AesGcmSivNative.CtxEncrypt(
+                        context.Pointer,
+                        noncePtr, (nuint)nonce.Length,
+                        sourcePtr, (nuint)length,
+                        aad, (nuint)associatedData.Length,
+                        targetPtr, output.Pointer + length);
+            }
+        }
+
+        /// <summary>
+        /// Encrypts a batch of messages with a single native call.
+        /// </summary>
+        /// <param name="items">
+        /// The messages to encrypt. Each item's <see cref="AesGcmSivBatchItem.Input"/> is the plaintext;
+        /// the ciphertext and tag are written to <see cref="AesGcmSivBatchItem.Output"/> and
+        /// <see cref="AesGcmSivBatchItem.Tag"/>.
+        /// </param>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentNullException">A required buffer of an item is null.</exception>
+        /// <exception cref="ArgumentException">The buffer sizes of an item are invalid.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public void EncryptBatch(ReadOnlySpan<AesGcmSivBatchItem> items) => EncryptBatchCore(items, null, 0, null);
+
+        /// <summary>
+        /// Encrypts a batch of messages with a single native call, deriving each item's nonce from a
+        /// base nonce and a counter, as for page or record numbers.
+        /// </summary>
+        /// <param name="items">
+        /// The messages to encrypt, as for <see cref="EncryptBatch(ReadOnlySpan{AesGcmSivBatchItem})"/>.
+        /// Their <see cref="AesGcmSivBatchItem.Nonce"/> is ignored and may be null.
+        /// </param>
+        /// <param name="baseNonce">
+        /// The base nonce. Must be exactly 12 bytes (96 bits). Item <c>i</c> is encrypted under this
+        /// nonce with its last 8 bytes XORed with <c>firstCounter + i</c> as a little-endian integer, so
+        /// a base nonce of a 4-byte file id followed by zeros gives the nonce file id || page number.
+        /// </param>
+        /// <param name="firstCounter">The counter of the first item.</param>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentNullException"><paramref name="baseNonce"/> or a required buffer of an item is null.</exception>
+        /// <exception cref="ArgumentException">The buffer sizes of an item are invalid.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public void EncryptBatch(ReadOnlySpan<AesGcmSivBatchItem> items, byte[] baseNonce, ulong firstCounter)
+        {
+            if (baseNonce == null)
+                throw new ArgumentNullException(nameof(baseNonce));
+            EncryptBatchCore(items, baseNonce, firstCounter, null);
+        }
+
+        /// <summary>
+        /// Encrypts a batch of messages that all share the same associated data, such as a table id or
+        /// schema version, with a single native call.
+        /// </summary>
+        /// <param name="items">
+        /// The messages to encrypt, as for <see cref="EncryptBatch(ReadOnlySpan{AesGcmSivBatchItem})"/>.
+        /// Their <see cref="AesGcmSivBatchItem.AssociatedData"/> is ignored.
+        /// </param>
+        /// <param name="associatedData">The associated data of every item.</param>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentNullException"><paramref name="associatedData"/> or a required buffer of an item is null.</exception>
+        /// <exception cref="ArgumentException">The buffer sizes of an item are invalid.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public void EncryptBatchWithAssociatedData(ReadOnlySpan<AesGcmSivBatchItem> items, byte[] associatedData)
+        {
+            if (associatedData == null)
+                throw new ArgumentNullException(nameof(associatedData));
+            EncryptBatchCore(items, null, 0, associatedData);
+        }
+
+        /// <summary>
+        /// Encrypts a stream of messages in batches, as for ETL jobs reading records one at a time, so
+        /// the per-call cost is paid once per batch rather than once per record.
+        /// </summary>
+        /// <param name="items">
+        /// The messages to encrypt, as for <see cref="EncryptBatch(ReadOnlySpan{AesGcmSivBatchItem})"/>.
+        /// </param>
+        /// <param name="batchSize">How many messages go into each native batch call.</param>
+        /// <param name="cancellationToken">Stops reading <paramref name="items"/>.</param>
+        /// <returns>
+        /// The same items in the same order, each yielded once its ciphertext and tag have been written.
+        /// </returns>
+        /// <remarks>
+        /// Each full batch is encrypted on the thread pool while the next one is read from
+        /// <paramref name="items"/>, and its items are yielded once that next batch has filled too, or
+        /// the source has ended. At most two batches are held at once. A final partial batch is
+        /// encrypted when the source ends. Argument checks on the items, and any encryption failure,
+        /// surface from the enumeration. Stopping the enumeration early waits for the batch in flight.
+        /// </remarks>
+        /// <exception cref="ArgumentNullException"><paramref name="items"/> is null.</exception>
+        /// <exception cref="ArgumentOutOfRangeException"><paramref name="batchSize"/> is not positive.</exception>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        public IAsyncEnumerable<AesGcmSivBatchItem> EncryptStream(
+            IAsyncEnumerable<AesGcmSivBatchItem> items, int batchSize, CancellationToken cancellationToken = default)
+        {
+            ArgumentNullException.ThrowIfNull(items);
+            ArgumentOutOfRangeException.ThrowIfNegativeOrZero(batchSize);
+            ThrowIfDisposed();
+            return EncryptStreamCore(items, batchSize, cancellationToken);
+        }
+
+        private async IAsyncEnumerable<AesGcmSivBatchItem> EncryptStreamCore(
+            IAsyncEnumerable<AesGcmSivBatchItem> items, int batchSize,
+            [EnumeratorCancellation] CancellationToken cancellationToken)
+        {
+            // Two buffers in turn: one filling, one encrypting or being yielded
+            var filling = new AesGcmSivBatchItem[batchSize];
+            var sealing = new AesGcmSivBatchItem[batchSize];
+            int count = 0;
+            Task? inFlight = null;
+            try
+            {
+                await foreach (AesGcmSivBatchItem item in items.WithCancellation(cancellationToken).ConfigureAwait(false))
+                {
+                    filling[count++] = item;
+                    if (count < batchSize)
+                        continue;
+
+                    if (inFlight != null)
+                    {
+                        await inFlight.ConfigureAwait(false);
+                        inFlight = null;
+                        foreach (AesGcmSivBatchItem done in sealing)
+                            yield return done;
+                    }
+                    (filling, sealing) = (sealing, filling);
+                    AesGcmSivBatchItem[] batch = sealing;
+                    inFlight = Task.Run(() => EncryptBatch(batch));
+                    count = 0;
+                }
+
+                if (inFlight != null)
+                {
+                    await inFlight.ConfigureAwait(false);
+                    inFlight = null;
+                    foreach (AesGcmSivBatchItem done in sealing)
+                        yield return done;
+                }
+                if (count > 0)
+                {
+                    EncryptBatch(filling.AsSpan(0, count));
+                    for (int i = 0; i < count; i++)
+                        yield return filling[i];
+                }
+            }
+            finally
+            {
+                // The caller may reuse the buffers once the enumeration ends
+                if (inFlight != null)
+                    await inFlight.ConfigureAwait(ConfigureAwaitOptions.SuppressThrowing);
+            }
+        }
+
+        private void EncryptBatchCore(
+            ReadOnlySpan<AesGcmSivBatchItem> items, byte[]? baseNonce, ulong firstCounter, byte[]? sharedAad)
+        {
+            ThrowIfDisposed();
+            foreach (var item in items)
+            {
+                ValidateEncryptParameters(baseNonce ?? item.Nonce, item.Input, item.Output, item.Tag, sharedAad ?? item.AssociatedData);
+            }
+            if (items.IsEmpty)
+                return;
+
+            int result = RunBatch(items, null, baseNonce, firstCounter, sharedAad);
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                throw new CryptographicException($"Batch encryption failed with error code: {result}");
+            }
+        }
+
+        /// <summary>
+        /// Decrypts a batch of messages with a single native call, reporting authentication
+        /// failures per item instead of failing the whole batch.
+        /// </summary>
+        /// <param name="items">
+        /// The messages to decrypt. Each item's <see cref="AesGcmSivBatchItem.Input"/> is the ciphertext
+        /// and <see cref="AesGcmSivBatchItem.Tag"/> the tag to verify; the plaintext is written to
+        /// <see cref="AesGcmSivBatchItem.Output"/>, which is zeroed for items that fail to authenticate.
+        /// </param>
+        /// <param name="succeeded">
+        /// Receives, for each item, whether it authenticated. Must be at least as long as <paramref name="items"/>.
+        /// </param>
+        /// <returns>The number of items that failed to authenticate.</returns>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentNullException">A required buffer of an item is null.</exception>
+        /// <exception cref="ArgumentException">The buffer sizes of an item are invalid, or <paramref name="succeeded"/> is too small.</exception>
+        /// <exception cref="CryptographicException">Decryption failed for a reason other than authentication.</exception>
+        public int DecryptBatch(ReadOnlySpan<AesGcmSivBatchItem> items, Span<bool> succeeded) =>
+            DecryptBatchCore(items, null, 0, null, succeeded);
+
+        /// <summary>
+        /// Decrypts a batch of messages with a single native call, deriving each item's nonce from a
+        /// base nonce and a counter as <see cref="EncryptBatch(ReadOnlySpan{AesGcmSivBatchItem}, byte[], ulong)"/>
+        /// does, and reporting authentication failures per item.
+        /// </summary>
+        /// <param name="items">
+        /// The messages to decrypt, as for <see cref="DecryptBatch(ReadOnlySpan{AesGcmSivBatchItem}, Span{bool})"/>.
+        /// Their <see cref="AesGcmSivBatchItem.Nonce"/> is ignored and may be null.
+        /// </param>
+        /// <param name="baseNonce">The base nonce. Must be exactly 12 bytes (96 bits).</param>
+        /// <param name="firstCounter">The counter of the first item.</param>
+        /// <param name="succeeded">
+        /// Receives, for each item, whether it authenticated. Must be at least as long as <paramref name="items"/>.
+        /// </param>
+        /// <returns>The number of items that failed to authenticate.</returns>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentNullException"><paramref name="baseNonce"/> or a required buffer of an item is null.</exception>
+        /// <exception cref="ArgumentException">The buffer sizes of an item are invalid, or <paramref name="succeeded"/> is too small.</exception>
+        /// <exception cref="CryptographicException">Decryption failed for a reason other than authentication.</exception>
+        public int DecryptBatch(ReadOnlySpan<AesGcmSivBatchItem> items, byte[] baseNonce, ulong firstCounter, Span<bool> succeeded)
+        {
+            if (baseNonce == null)
+                throw new ArgumentNullException(nameof(baseNonce));
+            return DecryptBatchCore(items, baseNonce, firstCounter, null, succeeded);
+        }
+
+        /// <summary>
+        /// Decrypts a batch of messages that all share the same associated data with a single native
+        /// call, reporting authentication failures per item.
+        /// </summary>
+        /// <param name="items">
+        /// The messages to decrypt, as for <see cref="DecryptBatch(ReadOnlySpan{AesGcmSivBatchItem}, Span{bool})"/>.
+        /// Their <see cref="AesGcmSivBatchItem.AssociatedData"/> is ignored.
+        /// </param>
+        /// <param name="associatedData">The associated data of every item.</param>
+        /// <param name="succeeded">
+        /// Receives, for each item, whether it authenticated. Must be at least as long as <paramref name="items"/>.
+        /// </param>
+        /// <returns>The number of items that failed to authenticate.</returns>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentNullException"><paramref name="associatedData"/> or a required buffer of an item is null.</exception>
+        /// <exception cref="ArgumentException">The buffer sizes of an item are invalid, or <paramref name="succeeded"/> is too small.</exception>
+        /// <exception cref="CryptographicException">Decryption failed for a reason other than authentication.</exception>
+        public int DecryptBatchWithAssociatedData(
+            ReadOnlySpan<AesGcmSivBatchItem> items, byte[] associatedData, Span<bool> succeeded)
+        {
+            if (associatedData == null)
+                throw new ArgumentNullException(nameof(associatedData));
+            return DecryptBatchCore(items, null, 0, associatedData, succeeded);
+        }
+
+        private int DecryptBatchCore(
+            ReadOnlySpan<AesGcmSivBatchItem> items, byte[]? baseNonce, ulong firstCounter, byte[]? sharedAad,
+            Span<bool> succeeded)
+        {
+            ThrowIfDisposed();
+            foreach (var item in items)
+            {
+                ValidateDecryptParameters(baseNonce ?? item.Nonce, item.Input, item.Tag, item.Output, sharedAad ?? item.AssociatedData);
+            }
+            if (succeeded.Length < items.Length)
+                throw new ArgumentException("Result buffer is too small.", nameof(succeeded));
+            if (items.IsEmpty)
+                return 0;
+
+            var statuses = new int[items.Length];
+            int result = RunBatch(items, statuses, baseNonce, firstCounter, sharedAad);
+            if (result != AESGCMSIV_SUCCESS && result != AESGCMSIV_ERROR_DECRYPT_FAILED)
+            {
+                throw new CryptographicException($"Batch decryption failed with error code: {result}");
+            }
+
+            int failures = 0;
+            for (int i = 0; i < statuses.Length; i++)
+            {
+                if (statuses[i] != AESGCMSIV_SUCCESS && statuses[i] != AESGCMSIV_ERROR_DECRYPT_FAILED)
+                {
+                    throw new CryptographicException($"Batch decryption failed with error code: {statuses[i]}");
+                }
+                succeeded[i] = statuses[i] == AESGCMSIV_SUCCESS;
+                if (!succeeded[i])
+                    failures++;
+            }
+            return failures;
+        }
+
+        /// <summary>
+        /// Re-encrypts one record from this instance's key to <paramref name="newKey"/>'s in a single
+        /// call, as for key rotation. The record is decrypted and verified into native scratch memory and
+        /// encrypted from there, so the plaintext never reaches the managed heap.
+        /// </summary>
+        /// <param name="newKey">The key to encrypt the record under. May be this instance.</param>
+        /// <param name="nonce">The nonce the record is encrypted under. Must be exactly 12 bytes (96 bits).</param>
+        /// <param name="newNonce">The nonce to encrypt it under. Must be exactly 12 bytes (96 bits); may equal <paramref name="nonce"/>.</param>
+        /// <param name="ciphertext">The ciphertext under this instance's key.</param>
+        /// <param name="tag">The tag under this instance's key. Must be exactly 16 bytes.</param>
+        /// <param name="destination">
+        /// Receives the ciphertext under the new key. Must be at least as large as the ciphertext; may be
+        /// the same memory as <paramref name="ciphertext"/>, but must not otherwise overlap it.
+        /// </param>
+        /// <param name="destinationTag">Receives the new tag. Must be exactly 16 bytes; may be <paramref name="tag"/>.</param>
+        /// <param name="associatedData">Optional additional authenticated data, kept unchanged.</param>
+        /// <returns>
+        /// <see langword="true"/> if the record verified and was re-encrypted; <see langword="false"/> if it
+        /// did not verify, in which case <paramref name="destination"/> and <paramref name="destinationTag"/>
+        /// are left as they were.
+        /// </returns>
+        /// <exception cref="ObjectDisposedException">This instance or <paramref name="newKey"/> has been disposed.</exception>
+        /// <exception cref="ArgumentNullException"><paramref name="newKey"/> is null.</exception>
+        /// <exception cref="ArgumentException">Parameter sizes are invalid, or the buffers partially overlap.</exception>
+        /// <exception cref="CryptographicException">Re-encryption failed for a reason other than authentication.</exception>
+        public bool TryReencrypt(
+            AesGcmSiv newKey,
+            ReadOnlySpan<byte> nonce,
+            ReadOnlySpan<byte> newNonce,
+            ReadOnlySpan<byte> ciphertext,
+            ReadOnlySpan<byte> tag,
+            Span<byte> destination,
+            Span<byte> destinationTag,
+            ReadOnlySpan<byte> associatedData = default)
+        {
+            ThrowIfDisposed();
+            if (newKey == null)
+                throw new ArgumentNullException(nameof(newKey));
+            newKey.ThrowIfDisposed();
+            ValidateSpanParameters(nonce, ciphertext, destination, nameof(destination), tag, exactTag: true);
+            if (newNonce.Length != NonceSize)
+                throw new ArgumentException($"Nonce must be exactly {NonceSize} bytes (96 bits).", nameof(newNonce));
+            if (destinationTag.Length != TagSize)
+                throw new ArgumentException($"Tag must be exactly {TagSize} bytes.", nameof(destinationTag));
+
+            int result = ReencryptCore(newKey, nonce, newNonce, ciphertext, tag, destination, destinationTag, associatedData);
+            if (result == AESGCMSIV_ERROR_DECRYPT_FAILED)
+                return false;
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                throw new CryptographicException($"Re-encryption failed with error code: {result}");
+            }
+            return true;
+        }
+
+        /// <summary>
+        /// Re-encrypts a batch of records from this instance's key to <paramref name="newKey"/>'s with a
+        /// single native call, reporting authentication failures per item. The plaintexts stay in native
+        /// scratch memory, and groups of short records run through the multi-buffer kernel.
+        /// </summary>
+        /// <param name="newKey">The key to encrypt the records under.</param>
+        /// <param name="items">
+        /// The records. Each item's <see cref="AesGcmSivBatchItem.Input"/> is its ciphertext and
+        /// <see cref="AesGcmSivBatchItem.Tag"/> its tag under this instance's key. Once an item verifies,
+        /// its <see cref="AesGcmSivBatchItem.Output"/> receives the ciphertext under the new key and its tag
+        /// is overwritten with the new tag; an item that fails keeps both as they were.
+        /// </param>
+        /// <param name="newNonces">
+        /// Twelve bytes of new nonce per item, or null to keep each item's <see cref="AesGcmSivBatchItem.Nonce"/>.
+        /// </param>
+        /// <param name="succeeded">
+        /// Receives, for each item, whether it verified. Must be at least as long as <paramref name="items"/>.
+        /// </param>
+        /// <returns>The number of items that failed to authenticate.</returns>
+        /// <exception cref="ObjectDisposedException">This instance or <paramref name="newKey"/> has been disposed.</exception>
+        /// <exception cref="ArgumentNullException"><paramref name="newKey"/> or a required buffer of an item is null.</exception>
+        /// <exception cref="ArgumentException">The buffer sizes are invalid, or <paramref name="succeeded"/> is too small.</exception>
+        /// <exception cref="CryptographicException">Re-encryption failed for a reason other than authentication.</exception>
+        public int ReencryptBatch(
+            AesGcmSiv newKey, ReadOnlySpan<AesGcmSivBatchItem> items, byte[]? newNonces, Span<bool> succeeded)
+        {
+            ThrowIfDisposed();
+            if (newKey == null)
+                throw new ArgumentNullException(nameof(newKey));
+            newKey.ThrowIfDisposed();
+            foreach (var item in items)
+            {
+                ValidateDecryptParameters(item.Nonce, item.Input, item.Tag, item.Output, item.AssociatedData);
+            }
+            if (newNonces != null && newNonces.Length != (long)items.Length * NonceSize)
+                throw new ArgumentException($"Must hold exactly {NonceSize} bytes per item.", nameof(newNonces));
+            if (succeeded.Length < items.Length)
+                throw new ArgumentException("Result buffer is too small.", nameof(succeeded));
+            if (items.IsEmpty)
+                return 0;
+
+            var statuses = new int[items.Length];
+            long started = AesGcmSivMetrics.IsEnabled ? Stopwatch.GetTimestamp() : 0;
+            int result = ReencryptBatchUntimed(newKey, items, newNonces, statuses);
+            if (AesGcmSivMetrics.IsEnabled)
+                AesGcmSivMetrics.RecordBatch(decrypt: true, items, statuses, result, started);
+            if (result != AESGCMSIV_SUCCESS && result != AESGCMSIV_ERROR_DECRYPT_FAILED)
+            {
+                throw new CryptographicException($"Batch re-encryption failed with error code: {result}");
+            }
+
+            int failures = 0;
+            for (int i = 0; i < statuses.Length; i++)
+            {
+                if (statuses[i] != AESGCMSIV_SUCCESS && statuses[i] != AESGCMSIV_ERROR_DECRYPT_FAILED)
+                {
+                    throw new CryptographicException($"Batch re-encryption failed with error code: {statuses[i]}");
+                }
+                succeeded[i] = statuses[i] == AESGCMSIV_SUCCESS;
+                if (!succeeded[i])
+                    failures++;
+            }
+            return failures;
+        }
+
+        // Returns the native status; parameters must already be validated.
+        private int ReencryptCore(
+            AesGcmSiv newKey, ReadOnlySpan<byte> nonce, ReadOnlySpan<byte> newNonce, ReadOnlySpan<byte> ciphertext,
+            ReadOnlySpan<byte> tag, Span<byte> destination, Span<byte> destinationTag, ReadOnlySpan<byte> associatedData)
+        {
+            long started = AesGcmSivMetrics.IsEnabled ? Stopwatch.GetTimestamp() : 0;
+            int result = _context == null || newKey._context == null
+                ? ReencryptManaged(newKey, nonce, newNonce, ciphertext, tag, destination, destinationTag, associatedData)
+                : ReencryptNative(newKey, nonce, newNonce, ciphertext, tag, destination, destinationTag, associatedData);
+            if (AesGcmSivMetrics.IsEnabled)
+                AesGcmSivMetrics.Record(decrypt: true, result, ciphertext.Length, started);
+            return result;
+        }
+
+        private int ReencryptNative(
+            AesGcmSiv newKey, ReadOnlySpan<byte> nonce, ReadOnlySpan<byte> newNonce, ReadOnlySpan<byte> ciphertext,
+            ReadOnlySpan<byte> tag, Span<byte> destination, Span<byte> destinationTag, ReadOnlySpan<byte> associatedData)
+        {
+            using var oldContext = new SafeAesGcmSivHandle.Lease(_context!);
+            using var newContext = new SafeAesGcmSivHandle.Lease(newKey._context!);
+            fixed (byte* noncePtr = nonce)
+            fixed (byte* newNoncePtr = newNonce)
+            fixed (byte* input = &BufferReference(ciphertext))
+            fixed (byte* aad = associatedData)
+            fixed (byte* tagPtr = tag)
+            fixed (byte* output = &BufferReference(destination))
+            fixed (byte* tagOut = destinationTag)
+            {
+                return AesGcmSivNative.Reencrypt(
+                    oldContext.Pointer, newContext.Pointer, noncePtr, newNoncePtr,
+                    input, (nuint)ciphertext.Length, aad, (nuint)associatedData.Length,
+                    tagPtr, output, tagOut);
+            }
+        }
+
+        // One side has no native context, so the record is decrypted and
+        // encrypted by the two instances in turn. The plaintext still lives in
+        // native memory, never on the managed heap, and is zeroed before it is
+        // freed.
+        private int ReencryptManaged(
+            AesGcmSiv newKey, ReadOnlySpan<byte> nonce, ReadOnlySpan<byte> newNonce, ReadOnlySpan<byte> ciphertext,
+            ReadOnlySpan<byte> tag, Span<byte> destination, Span<byte> destinationTag, ReadOnlySpan<byte> associatedData)
+        {
+            byte* scratch = (byte*)NativeMemory.Alloc((nuint)Math.Max(ciphertext.Length, 1));
+            var plaintext = new Span<byte>(scratch, ciphertext.Length);
+            try
+            {
+                int result = DecryptUntimed(nonce, ciphertext, tag, plaintext, associatedData);
+                if (result != AESGCMSIV_SUCCESS)
+                    return result;
+                Span<byte> newTag = stackalloc byte[TagSize];
+                result = newKey.EncryptUntimed(newNonce, plaintext, destination, newTag, associatedData);
+                if (result == AESGCMSIV_SUCCESS)
+                    newTag.CopyTo(destinationTag);
+                return result;
+            }
+            finally
+            {
+                CryptographicOperations.ZeroMemory(plaintext);
+                NativeMemory.Free(scratch);
+            }
+        }
+
+        private int ReencryptBatchUntimed(
+            AesGcmSiv newKey, ReadOnlySpan<AesGcmSivBatchItem> items, byte[]? newNonces, int[] statuses)
+        {
+            if (_context == null || newKey._context == null)
+            {
+                int result = AESGCMSIV_SUCCESS;
+                for (int i = 0; i < items.Length; i++)
+                {
+                    var item = items[i];
+                    ReadOnlySpan<byte> newNonce = newNonces != null ? newNonces.AsSpan(i * NonceSize, NonceSize) : item.Nonce;
+                    statuses[i] = ReencryptManaged(
+                        newKey, item.Nonce, newNonce, item.Input, item.Tag, item.Output, item.Tag, item.AssociatedData);
+                    if (statuses[i] != AESGCMSIV_SUCCESS)
+                        result = statuses[i];
+                }
+                return result;
+            }
+
+            var handles = new GCHandle[items.Length * 5];
+            try
+            {
+                NativeBatchItem[] nativeItems = PinBatch(items, handles);
+                using var oldContext = new SafeAesGcmSivHandle.Lease(_context);
+                using var newContext = new SafeAesGcmSivHandle.Lease(newKey._context);
+                fixed (NativeBatchItem* itemsPtr = nativeItems)
+                fixed (byte* newNoncesPtr = newNonces)
+                fixed (int* statusPtr = statuses)
+                {
+                    return AesGcmSivNative.ReencryptBatch(
+                        oldContext.Pointer, newContext.Pointer, (nuint)nativeItems.Length, itemsPtr, newNoncesPtr, statusPtr);
+                }
+            }
+            finally
+            {
+                foreach (var handle in handles)
+                {
+                    if (handle.IsAllocated)
+                        handle.Free();
+                }
+            }
+        }
+
+        /// <summary>
+        /// Encrypts a run of fixed-size storage pages in place with a single native call, keeping each
+        /// page's header in the clear as associated data and writing the tags to a separate buffer.
+        /// </summary>
+        /// <param name="pages">
+        /// The pages, back to back. Must be a whole number of <paramref name="pageSize"/>-byte pages.
+        /// </param>
+        /// <param name="pageSize">The size of each page in bytes.</param>
+        /// <param name="headerSize">
+        /// The bytes at the start of each page that are authenticated but not encrypted.
+        /// </param>
+        /// <param name="baseNonce">
+        /// The base nonce. Must be exactly 12 bytes (96 bits). Page <c>i</c> is encrypted under the nonce
+        /// <see cref="EncryptBatch(ReadOnlySpan{AesGcmSivBatchItem}, byte[], ulong)"/> would give item
+        /// <c>i</c> for <paramref name="firstPageNumber"/>.
+        /// </param>
+        /// <param name="firstPageNumber">The page number of the first page.</param>
+        /// <param name="tags">Receives 16 bytes of tag per page.</param>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentNullException"><paramref name="baseNonce"/> is null.</exception>
+        /// <exception cref="ArgumentException">The page layout or buffer sizes are invalid.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public void EncryptPages(
+            Span<byte> pages, int pageSize, int headerSize, byte[] baseNonce, ulong firstPageNumber, Span<byte> tags)
+        {
+            int count = ValidatePages(pages, pageSize, headerSize, baseNonce, tags.Length);
+            if (count == 0)
+                return;
+
+            int result;
+            fixed (byte* tagsPtr = tags)
+            {
+                result = RunPages(pages, pageSize, headerSize, baseNonce, firstPageNumber, tagsPtr, null);
+            }
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                throw new CryptographicException($"Page encryption failed with error code: {result}");
+            }
+        }
+
+        /// <summary>
+        /// Decrypts pages written by <see cref="EncryptPages"/> in place with a single native call,
+        /// reporting authentication failures per page. The body of a page that fails to authenticate is
+        /// zeroed; its header is left as it was.
+        /// </summary>
+        /// <param name="pages">The pages, back to back, as for <see cref="EncryptPages"/>.</param>
+        /// <param name="pageSize">The size of each page in bytes.</param>
+        /// <param name="headerSize">The bytes at the start of each page that were not encrypted.</param>
+        /// <param name="baseNonce">The base nonce the pages were encrypted with.</param>
+        /// <param name="firstPageNumber">The page number of the first page.</param>
+        /// <param name="tags">The tags, 16 bytes per page.</param>
+        /// <param name="succeeded">
+        /// Receives, for each page, whether it authenticated. Must hold at least one entry per page.
+        /// </param>
+        /// <returns>The number of pages that failed to authenticate.</returns>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentNullException"><paramref name="baseNonce"/> is null.</exception>
+        /// <exception cref="ArgumentException">The page layout or buffer sizes are invalid.</exception>
+        /// <exception cref="CryptographicException">Decryption failed for a reason other than authentication.</exception>
+        public int DecryptPages(
+            Span<byte> pages, int pageSize, int headerSize, byte[] baseNonce, ulong firstPageNumber,
+            ReadOnlySpan<byte> tags, Span<bool> succeeded)
+        {
+            int count = ValidatePages(pages, pageSize, headerSize, baseNonce, tags.Length);
+            if (succeeded.Length < count)
+                throw new ArgumentException("Result buffer is too small.", nameof(succeeded));
+            if (count == 0)
+                return 0;
+
+            var statuses = new int[count];
+            int result;
+            fixed (byte* tagsPtr = tags)
+            {
+                result = RunPages(pages, pageSize, headerSize, baseNonce, firstPageNumber, tagsPtr, statuses);
+            }
+            if (result != AESGCMSIV_SUCCESS && result != AESGCMSIV_ERROR_DECRYPT_FAILED)
+            {
+                throw new CryptographicException($"Page decryption failed with error code: {result}");
+            }
+
+            int failures = 0;
+            for (int i = 0; i < count; i++)
+            {
+                succeeded[i] = statuses[i] == AESGCMSIV_SUCCESS;
+                if (!succeeded[i])
+                    failures++;
+            }
+            return failures;
+        }
+
+        // Returns the number of pages
+        private int ValidatePages(ReadOnlySpan<byte> pages, int pageSize, int headerSize, byte[] baseNonce, int tagsLength)
+        {
+            ThrowIfDisposed();
+            if (baseNonce == null)
+                throw new ArgumentNullException(nameof(baseNonce));
+            if (baseNonce.Length != NonceSize)
+                throw new ArgumentException($"Nonce must be exactly {NonceSize} bytes (96 bits).", nameof(baseNonce));
+            if (pageSize <= 0)
+                throw new ArgumentOutOfRangeException(nameof(pageSize));
+            if (headerSize < 0 || headerSize > pageSize)
+                throw new ArgumentOutOfRangeException(nameof(headerSize));
+            if (pages.Length % pageSize != 0)
+                throw new ArgumentException("Buffer must hold a whole number of pages.", nameof(pages));
+
+            int count = pages.Length / pageSize;
+            if ((long)tagsLength < (long)count * TagSize)
+                throw new ArgumentException("Tag buffer is too small.", "tags");
+            return count;
+        }
+
+        // statuses is null when encrypting; tags holds 16 bytes per page,
+        // written when encrypting and read when decrypting
+        private int RunPages(
+            Span<byte> pages, int pageSize, int headerSize, byte[] baseNonce, ulong firstPageNumber,
+            byte* tags, int[]? statuses)
+        {
+            int count = pages.Length / pageSize;
+            long started = AesGcmSivMetrics.IsEnabled ? Stopwatch.GetTimestamp() : 0;
+            int result = RunPagesUntimed(pages, pageSize, headerSize, baseNonce, firstPageNumber, tags, statuses);
+            if (AesGcmSivMetrics.IsEnabled)
+                AesGcmSivMetrics.RecordLayout(statuses != null, count, _ => pageSize - headerSize, statuses, result, started);
+            return result;
+        }
+
+        private int RunPagesUntimed(
+            Span<byte> pages, int pageSize, int headerSize, byte[] baseNonce, ulong firstPageNumber,
+            byte* tags, int[]? statuses)
+        {
+            int count = pages.Length / pageSize;
+            if (_context == null)
+            {
+                // As the native library does, one page after another
+                int result = AESGCMSIV_SUCCESS;
+                Span<byte> nonce = stackalloc byte[NonceSize];
+                for (int i = 0; i < count; i++)
+                {
+                    Span<byte> page = pages.Slice(i * pageSize, pageSize);
+                    Span<byte> body = page.Slice(headerSize);
+                    var tag = new Span<byte>(tags + (long)i * TagSize, TagSize);
+                    DeriveCounterNonce(baseNonce, firstPageNumber + (ulong)i, nonce);
+                    if (statuses == null)
+                    {
+                        _managed!.Encrypt(nonce, body, body, tag, page.Slice(0, headerSize));
+                        continue;
+                    }
+                    statuses[i] = _managed!.Decrypt(nonce, body, tag, body, page.Slice(0, headerSize));
+                    if (statuses[i] != AESGCMSIV_SUCCESS)
+                        result = statuses[i];
+                }
+                return result;
+            }
+
+            using var context = new SafeAesGcmSivHandle.Lease(_context);
+            fixed (byte* pagesPtr = pages)
+            fixed (byte* basePtr = baseNonce)
+            fixed (int* statusPtr = statuses)
+            {
+                return statuses == null
+                    ? AesGcmSivNative.EncryptPages(
+                        context.Pointer, basePtr, pagesPtr, (nuint)pageSize, (nuint)count, firstPageNumber,
+                        (nuint)headerSize, tags)
+                    : AesGcmSivNative.DecryptPages(
+                        context.Pointer, basePtr, pagesPtr, (nuint)pageSize, (nuint)count, firstPageNumber,
+                        (nuint)headerSize, tags, statusPtr);
+            }
+        }
+
+        /// <summary>
+        /// Encrypts a column of variable-length values laid out as Arrow lays out a binary column, with a
+        /// single native call and no descriptor per value. Value <c>i</c> is
+        /// <c>values[offsets[i]..offsets[i + 1]]</c>; its ciphertext is written at the same offset of
+        /// <paramref name="destination"/>, so the encrypted column shares <paramref name="offsets"/>, and
+        /// its tag to <paramref name="tags"/> at <c>16 * i</c>.
+        /// </summary>
+        /// <param name="values">The values buffer.</param>
+        /// <param name="offsets">
+        /// One more offset than there are values; the first at least 0 and none less than the one before.
+        /// </param>
+        /// <param name="destination">
+        /// Receives the ciphertexts. Must be at least as long as the last offset, and either the same
+        /// memory as <paramref name="values"/> or not overlap it.
+        /// </param>
+        /// <param name="tags">Receives 16 bytes of tag per value.</param>
+        /// <param name="baseNonce">
+        /// The base nonce. Must be exactly 12 bytes (96 bits). Value <c>i</c> is encrypted under the nonce
+        /// <see cref="EncryptBatch(ReadOnlySpan{AesGcmSivBatchItem}, byte[], ulong)"/> would give item
+        /// <c>i</c> for <paramref name="firstRow"/>.
+        /// </param>
+        /// <param name="firstRow">The row number of the first value.</param>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentNullException"><paramref name="baseNonce"/> is null.</exception>
+        /// <exception cref="ArgumentException">The offsets or buffer sizes are invalid.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public void EncryptColumn(
+            ReadOnlySpan<byte> values, ReadOnlySpan<int> offsets, Span<byte> destination, Span<byte> tags,
+            byte[] baseNonce, ulong firstRow)
+        {
+            fixed (int* offsetsPtr = offsets)
+            {
+                EncryptColumnCore(values, offsetsPtr, sizeof(int), offsets.Length, destination, tags, baseNonce, firstRow);
+            }
+        }
+
+        /// <summary>
+        /// Encrypts a column of variable-length values with 64-bit offsets, as
+        /// <see cref="EncryptColumn(ReadOnlySpan{byte}, ReadOnlySpan{int}, Span{byte}, Span{byte}, byte[], ulong)"/> does.
+        /// </summary>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentNullException"><paramref name="baseNonce"/> is null.</exception>
+        /// <exception cref="ArgumentException">The offsets or buffer sizes are invalid.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public void EncryptColumn(
+            ReadOnlySpan<byte> values, ReadOnlySpan<long> offsets, Span<byte> destination, Span<byte> tags,
+            byte[] baseNonce, ulong firstRow)
+        {
+            fixed (long* offsetsPtr = offsets)
+            {
+                EncryptColumnCore(values, offsetsPtr, sizeof(long), offsets.Length, destination, tags, baseNonce, firstRow);
+            }
+        }
+
+        /// <summary>
+        /// Decrypts a column written by
+        /// <see cref="EncryptColumn(ReadOnlySpan{byte}, ReadOnlySpan{int}, Span{byte}, Span{byte}, byte[], ulong)"/>,
+        /// reporting authentication failures per value. The plaintext of a value that fails to
+        /// authenticate is zeroed.
+        /// </summary>
+        /// <param name="values">The encrypted values buffer.</param>
+        /// <param name="offsets">The offsets the column was encrypted with.</param>
+        /// <param name="tags">The tags, 16 bytes per value.</param>
+        /// <param name="destination">
+        /// Receives the plaintexts at the same offsets. Must be at least as long as the last offset, and
+        /// either the same memory as <paramref name="values"/> or not overlap it.
+        /// </param>
+        /// <param name="baseNonce">The base nonce the column was encrypted with.</param>
+        /// <param name="firstRow">The row number of the first value.</param>
+        /// <param name="succeeded">
+        /// Receives, for each value, whether it authenticated. Must hold at least one entry per value.
+        /// </param>
+        /// <returns>The number of values that failed to authenticate.</returns>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentNullException"><paramref name="baseNonce"/> is null.</exception>
+        /// <exception cref="ArgumentException">The offsets or buffer sizes are invalid.</exception>
+        /// <exception cref="CryptographicException">Decryption failed for a reason other than authentication.</exception>
+        public int DecryptColumn(
+            ReadOnlySpan<byte> values, ReadOnlySpan<int> offsets, ReadOnlySpan<byte> tags, Span<byte> destination,
+            byte[] baseNonce, ulong firstRow, Span<bool> succeeded)
+        {
+            fixed (int* offsetsPtr = offsets)
+            {
+                return DecryptColumnCore(
+                    values, offsetsPtr, sizeof(int), offsets.Length, tags, destination, baseNonce, firstRow, succeeded);
+            }
+        }
+
+        /// <summary>
+        /// Decrypts a column with 64-bit offsets, as
+        /// <see cref="DecryptColumn(ReadOnlySpan{byte}, ReadOnlySpan{int}, ReadOnlySpan{byte}, Span{byte}, byte[], ulong, Span{bool})"/> does.
+        /// </summary>
+        /// <returns>The number of values that failed to authenticate.</returns>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentNullException"><paramref name="baseNonce"/> is null.</exception>
+        /// <exception cref="ArgumentException">The offsets or buffer sizes are invalid.</exception>
+        /// <exception cref="CryptographicException">Decryption failed for a reason other than authentication.</exception>
+        public int DecryptColumn(
+            ReadOnlySpan<byte> values, ReadOnlySpan<long> offsets, ReadOnlySpan<byte> tags, Span<byte> destination,
+            byte[] baseNonce, ulong firstRow, Span<bool> succeeded)
+        {
+            fixed (long* offsetsPtr = offsets)
+            {
+                return DecryptColumnCore(
+                    values, offsetsPtr, sizeof(long), offsets.Length, tags, destination, baseNonce, firstRow, succeeded);
+            }
+        }
+
+        /// <summary>
+        /// Encrypts a binary or string column exported through the Arrow C Data Interface, returning the
+        /// ciphertexts as a new exported Arrow array. The values go through the same single native call
+        /// as <see cref="EncryptColumn(ReadOnlySpan{byte}, ReadOnlySpan{int}, Span{byte}, Span{byte}, byte[], ulong)"/>,
+        /// straight from the input's buffers into the output's, so no value is copied in either runtime.
+        /// </summary>
+        /// <remarks>
+        /// The input must have format <c>z</c>, <c>u</c>, <c>Z</c> or <c>U</c> (binary, utf8 and their large
+        /// variants); its offset and validity bitmap are honored, and it is only read, not released. The
+        /// output keeps the input's offset width, name and validity bitmap, and its buffers are native
+        /// memory freed by its release callbacks. With Apache.Arrow, export a column with
+        /// <c>CArrowArrayExporter</c> into pointers from <c>CArrowArray.Create()</c> and
+        /// <c>CArrowSchema.Create()</c>, and import the result with <c>CArrowArrayImporter</c>.
+        /// </remarks>
+        /// <param name="schema">A pointer to the input's <c>ArrowSchema</c>.</param>
+        /// <param name="array">A pointer to the input's <c>ArrowArray</c>.</param>
+        /// <param name="baseNonce">
+        /// The base nonce. Must be exactly 12 bytes (96 bits). Value <c>i</c> is encrypted under the nonce
+        /// <see cref="EncryptBatch(ReadOnlySpan{AesGcmSivBatchItem}, byte[], ulong)"/> would give item
+        /// <c>i</c> for <paramref name="firstRow"/>.
+        /// </param>
+        /// <param name="firstRow">The row number of the array's first value.</param>
+        /// <param name="tagLayout">Where the tags go in the output.</param>
+        /// <param name="schemaOut">A pointer to an <c>ArrowSchema</c> that receives the output's type.</param>
+        /// <param name="arrayOut">A pointer to an <c>ArrowArray</c> that receives the output.</param>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentNullException"><paramref name="baseNonce"/> or a pointer is null.</exception>
+        /// <exception cref="ArgumentException">
+        /// The nonce size is invalid, or the column is not binary or string, is malformed, or would
+        /// overflow 32-bit offsets with appended tags.
+        /// </exception>
+        /// <exception cref="ArgumentOutOfRangeException"><paramref name="tagLayout"/> is not a defined layout.</exception>
+        /// <exception cref="NotSupportedException">The instance runs only managed code.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public void EncryptArrowColumn(
+            IntPtr schema, IntPtr array, byte[] baseNonce, ulong firstRow, AesGcmSivArrowTagLayout tagLayout,
+            IntPtr schemaOut, IntPtr arrayOut)
+        {
+            ThrowIfDisposed();
+            ArgumentNullException.ThrowIfNull(baseNonce);
+            if (schema == IntPtr.Zero)
+                throw new ArgumentNullException(nameof(schema));
+            if (array == IntPtr.Zero)
+                throw new ArgumentNullException(nameof(array));
+            if (schemaOut == IntPtr.Zero)
+                throw new ArgumentNullException(nameof(schemaOut));
+            if (arrayOut == IntPtr.Zero)
+                throw new ArgumentNullException(nameof(arrayOut));
+            if (baseNonce.Length != NonceSize)
+                throw new ArgumentException($"Nonce must be exactly {NonceSize} bytes (96 bits).", nameof(baseNonce));
+            if (tagLayout != AesGcmSivArrowTagLayout.Struct && tagLayout != AesGcmSivArrowTagLayout.Appended)
+                throw new ArgumentOutOfRangeException(nameof(tagLayout));
+            if (_context == null)
+                throw new NotSupportedException("An instance running only managed code cannot encrypt an Arrow column.");
+
+            int result;
+            using (var context = new SafeAesGcmSivHandle.Lease(_context))
+            fixed (byte* noncePtr = baseNonce)
+            {
+                result = AesGcmSivNative.ArrowEncryptColumn(
+                    context.Pointer, noncePtr, firstRow, (void*)schema, (void*)array, (uint)tagLayout,
+                    (void*)schemaOut, (void*)arrayOut);
+            }
+            if (result == AESGCMSIV_ERROR_INVALID_INPUT)
+                throw new ArgumentException("The column is not a well-formed binary or string array, or its offsets would overflow.", nameof(array));
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                throw new CryptographicException($"Arrow column encryption failed with error code: {result}");
+            }
+        }
+
+        private void EncryptColumnCore(
+            ReadOnlySpan<byte> values, void* offsets, int offsetSize, int offsetCount, Span<byte> destination,
+            Span<byte> tags, byte[] baseNonce, ulong firstRow)
+        {
+            int count = ValidateColumn(values, offsets, offsetSize, offsetCount, destination, tags.Length, baseNonce);
+            if (count == 0)
+                return;
+
+            int result;
+            fixed (byte* tagsPtr = tags)
+            {
+                result = RunColumn(values, offsets, offsetSize, count, destination, tagsPtr, baseNonce, firstRow, null);
+            }
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                throw new CryptographicException($"Column encryption failed with error code: {result}");
+            }
+        }
+
+        private int DecryptColumnCore(
+            ReadOnlySpan<byte> values, void* offsets, int offsetSize, int offsetCount, ReadOnlySpan<byte> tags,
+            Span<byte> destination, byte[] baseNonce, ulong firstRow, Span<bool> succeeded)
+        {
+            int count = ValidateColumn(values, offsets, offsetSize, offsetCount, destination, tags.Length, baseNonce);
+            if (succeeded.Length < count)
+                throw new ArgumentException("Result buffer is too small.", nameof(succeeded));
+            if (count == 0)
+                return 0;
+
+            var statuses = new int[count];
+            int result;
+            fixed (byte* tagsPtr = tags)
+            {
+                result = RunColumn(values, offsets, offsetSize, count, destination, tagsPtr, baseNonce, firstRow, statuses);
+            }
+            if (result != AESGCMSIV_SUCCESS && result != AESGCMSIV_ERROR_DECRYPT_FAILED)
+            {
+                throw new CryptographicException($"Column decryption failed with error code: {result}");
+            }
+
+            int failures = 0;
+            for (int i = 0; i < count; i++)
+            {
+                succeeded[i] = statuses[i] == AESGCMSIV_SUCCESS;
+                if (!succeeded[i])
+                    failures++;
+            }
+            return failures;
+        }
+
+        private static long ColumnOffset(void* offsets, int offsetSize, int i) =>
+            offsetSize == sizeof(int) ? ((int*)offsets)[i] : ((long*)offsets)[i];
+
+        // Returns the number of values
+        private int ValidateColumn(
+            ReadOnlySpan<byte> values, void* offsets, int offsetSize, int offsetCount, ReadOnlySpan<byte> destination,
+            int tagsLength, byte[] baseNonce)
+        {
+            ThrowIfDisposed();
+            if (baseNonce == null)
+                throw new ArgumentNullException(nameof(baseNonce));
+            if (baseNonce.Length != NonceSize)
+                throw new ArgumentException($"Nonce must be exactly {NonceSize} bytes (96 bits).", nameof(baseNonce));
+            if (offsetCount == 0)
+                throw new ArgumentException("A column needs at least one offset.", "offsets");
+
+            long previous = ColumnOffset(offsets, offsetSize, 0);
+            if (previous < 0)
+                throw new ArgumentException("Offsets must not be negative.", "offsets");
+            for (int i = 1; i < offsetCount; i++)
+            {
+                long offset = ColumnOffset(offsets, offsetSize, i);
+                if (offset < previous)
+                    throw new ArgumentException("Offsets must not decrease.", "offsets");
+                previous = offset;
+            }
+            if (previous > values.Length)
+                throw new ArgumentException("Offsets run past the end of the values.", nameof(values));
+            if (previous > destination.Length)
+                throw new ArgumentException("Output buffer is too small.", nameof(destination));
+            if (values.Overlaps(destination, out int overlap) && overlap != 0)
+                throw new ArgumentException("Input and output buffers must be the same memory or not overlap.", nameof(destination));
+
+            int count = offsetCount - 1;
+            if ((long)tagsLength < (long)count * TagSize)
+                throw new ArgumentException("Tag buffer is too small.", "tags");
+            return count;
+        }
+
+        // statuses is null when encrypting; tags holds 16 bytes per value,
+        // written when encrypting and read when decrypting
+        private int RunColumn(
+            ReadOnlySpan<byte> values, void* offsets, int offsetSize, int count, Span<byte> destination,
+            byte* tags, byte[] baseNonce, ulong firstRow, int[]? statuses)
+        {
+            long started = AesGcmSivMetrics.IsEnabled ? Stopwatch.GetTimestamp() : 0;
+            int result = RunColumnUntimed(values, offsets, offsetSize, count, destination, tags, baseNonce, firstRow, statuses);
+            if (AesGcmSivMetrics.IsEnabled)
+            {
+                AesGcmSivMetrics.RecordLayout(
+                    statuses != null, count,
+                    i => ColumnOffset(offsets, offsetSize, i + 1) - ColumnOffset(offsets, offsetSize, i),
+                    statuses, result, started);
+            }
+            return result;
+        }
+
+        private int RunColumnUntimed(
+            ReadOnlySpan<byte> values, void* offsets, int offsetSize, int count, Span<byte> destination,
+            byte* tags, byte[] baseNonce, ulong firstRow, int[]? statuses)
+        {
+            if (_context == null)
+            {
+                int result = AESGCMSIV_SUCCESS;
+                Span<byte> nonce = stackalloc byte[NonceSize];
+                for (int i = 0; i < count; i++)
+                {
+                    int begin = (int)ColumnOffset(offsets, offsetSize, i);
+                    int length = (int)ColumnOffset(offsets, offsetSize, i + 1) - begin;
+                    var tag = new Span<byte>(tags + (long)i * TagSize, TagSize);
+                    DeriveCounterNonce(baseNonce, firstRow + (ulong)i, nonce);
+                    if (statuses == null)
+                    {
+                        _managed!.Encrypt(nonce, values.Slice(begin, length), destination.Slice(begin, length), tag, default);
+                        continue;
+                    }
+                    statuses[i] = _managed!.Decrypt(nonce, values.Slice(begin, length), tag, destination.Slice(begin, length), default);
+                    if (statuses[i] != AESGCMSIV_SUCCESS)
+                        result = statuses[i];
+                }
+                return result;
+            }
+
+            using var context = new SafeAesGcmSivHandle.Lease(_context);
+            fixed (byte* valuesPtr = &BufferReference(values))
+            fixed (byte* destinationPtr = &BufferReference(destination))
+            fixed (byte* basePtr = baseNonce)
+            fixed (int* statusPtr = statuses)
+            {
+                return statuses == null
+                    ? AesGcmSivNative.EncryptColumn(
+                        context.Pointer, basePtr, firstRow, (nuint)count, valuesPtr, offsets, (nuint)offsetSize,
+                        destinationPtr, tags)
+                    : AesGcmSivNative.DecryptColumn(
+                        context.Pointer, basePtr, firstRow, (nuint)count, valuesPtr, offsets, (nuint)offsetSize,
+                        tags, destinationPtr, statusPtr);
+            }
+        }
+
+        /// <summary>
+        /// Encrypts a batch of messages held in the registered buffers of <paramref name="pool"/> with a
+        /// single native call. The items name their data by buffer index and offset, so nothing is pinned
+        /// and no pointer is passed per message.
+        /// </summary>
+        /// <param name="pool">The pool the items' buffers belong to.</param>
+        /// <param name="items">
+        /// The messages to encrypt. Each tag is written to the item's output buffer. An item's output
+        /// must either be its input or not overlap it.
+        /// </param>
+        /// <exception cref="ObjectDisposedException">The object or the pool has been disposed.</exception>
+        /// <exception cref="ArgumentNullException"><paramref name="pool"/> is null.</exception>
+        /// <exception cref="ArgumentException">A range of an item runs past the end of its buffer.</exception>
+        /// <exception cref="ArgumentOutOfRangeException">An item names a buffer out of range.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public void EncryptRegistered(AesGcmSivBufferPool pool, ReadOnlySpan<AesGcmSivRegisteredItem> items)
+        {
+            ValidateRegistered(pool, items);
+            if (items.IsEmpty)
+                return;
+
+            int result;
+            fixed (AesGcmSivRegisteredItem* itemsPtr = items)
+            {
+                result = RunRegistered(pool, itemsPtr, items.Length, null);
+            }
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                throw new CryptographicException($"Registered batch encryption failed with error code: {result}");
+            }
+        }
+
+        /// <summary>
+        /// Decrypts a batch of messages held in the registered buffers of <paramref name="pool"/> with a
+        /// single native call, reporting authentication failures per item. The plaintext of an item that
+        /// fails to authenticate is zeroed.
+        /// </summary>
+        /// <param name="pool">The pool the items' buffers belong to.</param>
+        /// <param name="items">
+        /// The messages to decrypt. Each tag is read from the item's input buffer.
+        /// </param>
+        /// <param name="succeeded">
+        /// Receives, for each item, whether it authenticated. Must be at least as long as <paramref name="items"/>.
+        /// </param>
+        /// <returns>The number of items that failed to authenticate.</returns>
+        /// <exception cref="ObjectDisposedException">The object or the pool has been disposed.</exception>
+        /// <exception cref="ArgumentNullException"><paramref name="pool"/> is null.</exception>
+        /// <exception cref="ArgumentException">
+        /// A range of an item runs past the end of its buffer, or <paramref name="succeeded"/> is too small.
+        /// </exception>
+        /// <exception cref="ArgumentOutOfRangeException">An item names a buffer out of range.</exception>
+        /// <exception cref="CryptographicException">Decryption failed for a reason other than authentication.</exception>
+        public int DecryptRegistered(
+            AesGcmSivBufferPool pool, ReadOnlySpan<AesGcmSivRegisteredItem> items, Span<bool> succeeded)
+        {
+            ValidateRegistered(pool, items);
+            if (succeeded.Length < items.Length)
+                throw new ArgumentException("Result buffer is too small.", nameof(succeeded));
+            if (items.IsEmpty)
+                return 0;
+
+            var statuses = new int[items.Length];
+            int result;
+            fixed (AesGcmSivRegisteredItem* itemsPtr = items)
+            {
+                result = RunRegistered(pool, itemsPtr, items.Length, statuses);
+            }
+            if (result != AESGCMSIV_SUCCESS && result != AESGCMSIV_ERROR_DECRYPT_FAILED)
+            {
+                throw new CryptographicException($"Registered batch decryption failed with error code: {result}");
+            }
+
+            int failures = 0;
+            for (int i = 0; i < statuses.Length; i++)
+            {
+                succeeded[i] = statuses[i] == AESGCMSIV_SUCCESS;
+                if (!succeeded[i])
+                    failures++;
+            }
+            return failures;
+        }
+
+        private void ValidateRegistered(AesGcmSivBufferPool pool, ReadOnlySpan<AesGcmSivRegisteredItem> items)
+        {
+            ThrowIfDisposed();
+            if (pool == null)
+                throw new ArgumentNullException(nameof(pool));
+            foreach (ref readonly var item in items)
+            {
+                pool.ValidateItem(item);
+            }
+        }
+
+        // statuses is null when encrypting
+        private int RunRegistered(AesGcmSivBufferPool pool, AesGcmSivRegisteredItem* items, int count, int[]? statuses)
+        {
+            long started = AesGcmSivMetrics.IsEnabled ? Stopwatch.GetTimestamp() : 0;
+            int result = RunRegisteredUntimed(pool, items, count, statuses);
+            if (AesGcmSivMetrics.IsEnabled)
+                AesGcmSivMetrics.RecordLayout(statuses != null, count, i => items[i].Length, statuses, result, started);
+            return result;
+        }
+
+        private int RunRegisteredUntimed(AesGcmSivBufferPool pool, AesGcmSivRegisteredItem* items, int count, int[]? statuses)
+        {
+            if (_context == null)
+            {
+                // As the native library does, one item after another
+                int result = AESGCMSIV_SUCCESS;
+                for (int i = 0; i < count; i++)
+                {
+                    ref readonly AesGcmSivRegisteredItem item = ref items[i];
+                    Span<byte> input = pool.GetSpan(item.InputBuffer);
+                    Span<byte> output = pool.GetSpan(item.OutputBuffer);
+                    int length = (int)item.Length;
+                    ReadOnlySpan<byte> nonce = input.Slice((int)item.NonceOffset, NonceSize);
+                    ReadOnlySpan<byte> associatedData = item.AssociatedDataLength == 0
+                        ? default
+                        : input.Slice((int)item.AssociatedDataOffset, (int)item.AssociatedDataLength);
+                    if (statuses == null)
+                    {
+                        _managed!.Encrypt(
+                            nonce, input.Slice((int)item.InputOffset, length), output.Slice((int)item.OutputOffset, length),
+                            output.Slice((int)item.TagOffset, TagSize), associatedData);
+                        continue;
+                    }
+                    statuses[i] = _managed!.Decrypt(
+                        nonce, input.Slice((int)item.InputOffset, length), input.Slice((int)item.TagOffset, TagSize),
+                        output.Slice((int)item.OutputOffset, length), associatedData);
+                    if (statuses[i] != AESGCMSIV_SUCCESS)
+                        result = statuses[i];
+                }
+                return result;
+            }
+
+            SafeAesGcmSivBuffersHandle registry = pool.GetRegistry();
+            bool added = false;
+            registry.DangerousAddRef(ref added);
+            try
+            {
+                using var context = new SafeAesGcmSivHandle.Lease(_context);
+                fixed (int* statusPtr = statuses)
+                {
+                    return statuses == null
+                        ? AesGcmSivNative.EncryptRegistered(context.Pointer, registry.DangerousGetHandle(), (nuint)count, items)
+                        : AesGcmSivNative.DecryptRegistered(
+                            context.Pointer, registry.DangerousGetHandle(), (nuint)count, items, statusPtr);
+                }
+            }
+            finally
+            {
+                registry.DangerousRelease();
+            }
+        }
+
+        // Runs the descriptors of an AesGcmSivBatch, whose buffers are already
+        // pinned. statuses is null when encrypting
+        internal int RunDescriptors(NativeBatchItem* items, int count, int[]? statuses)
+        {
+            ThrowIfDisposed();
+            if (!AesGcmSivMetrics.IsEnabled)
+                return RunDescriptorsUntimed(items, count, statuses);
+
+            long started = Stopwatch.GetTimestamp();
+            int result = RunDescriptorsUntimed(items, count, statuses);
+            RecordDescriptors(items, count, statuses, result, started);
+            return result;
+        }
+
+        // Apart from RunDescriptors so the closure is only allocated with a
+        // metrics listener attached
+        private static void RecordDescriptors(NativeBatchItem* items, int count, int[]? statuses, int result, long started) =>
+            AesGcmSivMetrics.RecordLayout(statuses != null, count, i => (long)items[i].InputLength, statuses, result, started);
+
+        private int RunDescriptorsUntimed(NativeBatchItem* items, int count, int[]? statuses)
+        {
+            if (_context == null)
+            {
+                int result = AESGCMSIV_SUCCESS;
+                for (int i = 0; i < count; i++)
+                {
+                    ref readonly NativeBatchItem item = ref items[i];
+                    int length = (int)item.InputLength;
+                    var nonce = new ReadOnlySpan<byte>((void*)item.Nonce, NonceSize);
+                    var input = new ReadOnlySpan<byte>((void*)item.Input, length);
+                    var output = new Span<byte>((void*)item.Output, length);
+                    var tag = new Span<byte>((void*)item.Tag, TagSize);
+                    var associatedData = new ReadOnlySpan<byte>((void*)item.AssociatedData, (int)item.AssociatedDataLength);
+                    if (statuses == null)
+                    {
+                        _managed!.Encrypt(nonce, input, output, tag, associatedData);
+                        continue;
+                    }
+                    statuses[i] = _managed!.Decrypt(nonce, input, tag, output, associatedData);
+                    if (statuses[i] != AESGCMSIV_SUCCESS)
+                        result = statuses[i];
+                }
+                return result;
+            }
+
+            using var context = new SafeAesGcmSivHandle.Lease(_context);
+            fixed (int* statusPtr = statuses)
+            {
+                return statuses == null
+                    ? AesGcmSivNative.EncryptBatch(context.Pointer, (nuint)count, items)
+                    : AesGcmSivNative.DecryptBatch(context.Pointer, (nuint)count, items, statusPtr);
             }
         }
 
@@ -153,12 +4107,305 @@ namespace System.Security.Cryptography
         {
             if (!_disposed)
             {
-                // Clear the key from memory
-                if (_key != null)
+                // Frees the native context, which clears the key schedule
+                _context?.Dispose();
+                _managed?.Dispose();
+                _disposed = true;
+            }
+        }
+
+        // Whether a call runs in managed code: every call when there is no
+        // native context, otherwise those up to the threshold
+        private bool UseManaged(int messageLength, int associatedDataLength) =>
+            _managed != null &&
+            (_context == null || (long)messageLength + associatedDataLength <= ManagedMessageThreshold);
+
+        private int ResolveManagedMessageThreshold()
+        {
+            int threshold = Volatile.Read(ref s_managedMessageThreshold);
+            if (threshold < 0 && _managed != null && _context != null)
+            {
+                // Racing first instances each measure; the first result sticks
+                Interlocked.CompareExchange(ref s_managedMessageThreshold, MeasureManagedMessageThreshold(), -1);
+                threshold = s_managedMessageThreshold;
+            }
+            if (threshold < 0)
+                return 0;
+            _managedMessageThreshold = threshold;
+            return threshold;
+        }
+
+        // From AesGcmSivTuningProfile.Apply, for instances that have not yet
+        // resolved their threshold
+        internal static void SetDefaultManagedMessageThreshold(int threshold) =>
+            Volatile.Write(ref s_managedMessageThreshold, threshold);
+
+        // Times both implementations on each power-of-two size and stops at
+        // the first one where managed code falls behind. Each sample covers
+        // about 64 KiB, and the fastest of three is kept, which also discards
+        // the first run's JIT and cache warm-up.
+        internal int MeasureManagedMessageThreshold()
+        {
+            var buffer = new byte[CalibrationMaxSize];
+            Span<byte> nonce = stackalloc byte[NonceSize];
+            Span<byte> tag = stackalloc byte[TagSize];
+            nonce.Clear();
+
+            int threshold = 0;
+            for (int size = CalibrationMinSize; size <= CalibrationMaxSize; size *= 2)
+            {
+                Span<byte> message = buffer.AsSpan(0, size);
+                int iterations = Math.Max(8, CalibrationMaxSize / size);
+                long managed = long.MaxValue;
+                long native = long.MaxValue;
+                for (int sample = 0; sample < 3; sample++)
                 {
-                    Array.Clear(_key, 0, _key.Length);
+                    long started = Stopwatch.GetTimestamp();
+                    for (int i = 0; i < iterations; i++)
+                        _managed!.Encrypt(nonce, message, message, tag, default);
+                    managed = Math.Min(managed, Stopwatch.GetTimestamp() - started);
+
+                    started = Stopwatch.GetTimestamp();
+                    for (int i = 0; i < iterations; i++)
+                        EncryptNative(nonce, message, message, tag, default);
+                    native = Math.Min(native, Stopwatch.GetTimestamp() - started);
                 }
-                _disposed = true;
+                if (managed > native)
+                    break;
+                threshold = size;
+            }
+            return threshold;
+        }
+
+        private bool UseSmallMessagePath(int messageLength, int associatedDataLength)
+        {
+            if (!_smallMessageFastPath || _providerSelected || messageLength > SmallMessageMaxSize || associatedDataLength > SmallMessageMaxSize)
+                return false;
+            if (s_smallMessageKernel == 0)
+                s_smallMessageKernel = IsLibraryBackend(BackendName) ? -1 : 1;
+            return s_smallMessageKernel > 0;
+        }
+
+        // Runs a batch on the instance's context. Decrypts when statuses is
+        // supplied, otherwise encrypts. With a base nonce the items' nonces
+        // are derived from it and the counter instead.
+        // baseNonce and sharedAad, when set, replace every item's nonce and
+        // associated data
+        private int RunBatch(
+            ReadOnlySpan<AesGcmSivBatchItem> items, int[]? statuses, byte[]? baseNonce, ulong firstCounter, byte[]? sharedAad)
+        {
+            if (!AesGcmSivMetrics.IsEnabled)
+                return RunBatchUntimed(items, statuses, baseNonce, firstCounter, sharedAad);
+
+            long started = Stopwatch.GetTimestamp();
+            int result = RunBatchUntimed(items, statuses, baseNonce, firstCounter, sharedAad);
+            AesGcmSivMetrics.RecordBatch(decrypt: statuses != null, items, statuses, result, started);
+            return result;
+        }
+
+        private int RunBatchUntimed(
+            ReadOnlySpan<AesGcmSivBatchItem> items, int[]? statuses, byte[]? baseNonce, ulong firstCounter, byte[]? sharedAad)
+        {
+            if (_context == null)
+                return RunManagedBatch(items, statuses, baseNonce, firstCounter, sharedAad);
+
+            var handles = new GCHandle[items.Length * 5];
+            try
+            {
+                NativeBatchItem[] nativeItems = PinBatch(items, handles);
+                using var context = new SafeAesGcmSivHandle.Lease(_context);
+                fixed (NativeBatchItem* itemsPtr = nativeItems)
+                fixed (int* statusPtr = statuses)
+                fixed (byte* basePtr = baseNonce)
+                fixed (byte* aadPtr = sharedAad)
+                {
+                    nuint count = (nuint)nativeItems.Length;
+                    if (sharedAad != null)
+                    {
+                        return statuses == null
+                            ? AesGcmSivNative.EncryptBatchSharedAad(context.Pointer, count, itemsPtr, aadPtr, (nuint)sharedAad.Length)
+                            : AesGcmSivNative.DecryptBatchSharedAad(context.Pointer, count, itemsPtr, aadPtr, (nuint)sharedAad.Length, statusPtr);
+                    }
+                    if (baseNonce != null)
+                    {
+                        return statuses == null
+                            ? AesGcmSivNative.EncryptBatchCounter(context.Pointer, count, itemsPtr, basePtr, firstCounter)
+                            : AesGcmSivNative.DecryptBatchCounter(context.Pointer, count, itemsPtr, basePtr, firstCounter, statusPtr);
+                    }
+                    return statuses == null
+                        ? AesGcmSivNative.EncryptBatch(context.Pointer, count, itemsPtr)
+                        : AesGcmSivNative.DecryptBatch(context.Pointer, count, itemsPtr, statusPtr);
+                }
+            }
+            finally
+            {
+                foreach (var handle in handles)
+                {
+                    if (handle.IsAllocated)
+                        handle.Free();
+                }
+            }
+        }
+
+        // Without a native context there is no pool to spread a batch over,
+        // so its items run one after another
+        private int RunManagedBatch(
+            ReadOnlySpan<AesGcmSivBatchItem> items, int[]? statuses, byte[]? baseNonce, ulong firstCounter, byte[]? sharedAad)
+        {
+            int result = AESGCMSIV_SUCCESS;
+            Span<byte> derived = stackalloc byte[NonceSize];
+            for (int i = 0; i < items.Length; i++)
+            {
+                var item = items[i];
+                if (baseNonce != null)
+                    DeriveCounterNonce(baseNonce, firstCounter + (ulong)i, derived);
+                ReadOnlySpan<byte> nonce = baseNonce != null ? derived : item.Nonce;
+                byte[]? associatedData = sharedAad ?? item.AssociatedData;
+                if (statuses == null)
+                {
+                    _managed!.Encrypt(nonce, item.Input, item.Output, item.Tag, associatedData);
+                    continue;
+                }
+                statuses[i] = _managed!.Decrypt(nonce, item.Input, item.Tag, item.Output, associatedData);
+                if (statuses[i] != AESGCMSIV_SUCCESS)
+                    result = statuses[i];
+            }
+            return result;
+        }
+
+        // The nonce the native library derives for counter value counter
+        private static void DeriveCounterNonce(ReadOnlySpan<byte> baseNonce, ulong counter, Span<byte> nonce)
+        {
+            baseNonce.CopyTo(nonce);
+            Span<byte> tail = nonce.Slice(4);
+            BinaryPrimitives.WriteUInt64LittleEndian(tail, BinaryPrimitives.ReadUInt64LittleEndian(tail) ^ counter);
+        }
+
+        // Gathers the input and associated data of a vectored call into one
+        // buffer each, runs it in managed code and scatters the output
+        private int RunManagedSegments(
+            bool decrypt, byte[] nonce, IReadOnlyList<ArraySegment<byte>> input, long inputLength, byte[] tag,
+            IReadOnlyList<ArraySegment<byte>> output, IReadOnlyList<ArraySegment<byte>>? associatedData)
+        {
+            byte[] message = Gather(input, inputLength, decrypt ? "ciphertext" : "plaintext");
+            byte[] aad = associatedData == null
+                ? Array.Empty<byte>()
+                : Gather(associatedData, TotalLength(associatedData, nameof(associatedData)), nameof(associatedData));
+            try
+            {
+                // A failed decrypt has zeroed the message, so the scatter
+                // clears the output as the native call would
+                int result = decrypt
+                    ? _managed!.Decrypt(nonce, message, tag, message, aad)
+                    : _managed!.Encrypt(nonce, message, message, tag, aad);
+                int offset = 0;
+                for (int i = 0; i < output.Count && offset < message.Length; i++)
+                {
+                    int count = Math.Min(output[i].Count, message.Length - offset);
+                    message.AsSpan(offset, count).CopyTo(output[i].AsSpan());
+                    offset += count;
+                }
+                return result;
+            }
+            finally
+            {
+                CryptographicOperations.ZeroMemory(message);
+            }
+        }
+
+        private static byte[] Gather(IReadOnlyList<ArraySegment<byte>> segments, long length, string paramName)
+        {
+            if (length > Array.MaxLength)
+                throw new ArgumentException("The segments are too large for the managed implementation.", paramName);
+            var buffer = new byte[length];
+            int offset = 0;
+            for (int i = 0; i < segments.Count; i++)
+            {
+                segments[i].AsSpan().CopyTo(buffer.AsSpan(offset));
+                offset += segments[i].Count;
+            }
+            return buffer;
+        }
+
+        // Pins every buffer of every item, recording the handles so the caller
+        // can release them, and builds the matching native descriptors.
+        internal static NativeBatchItem[] PinBatch(ReadOnlySpan<AesGcmSivBatchItem> items, GCHandle[] handles)
+        {
+            var nativeItems = new NativeBatchItem[items.Length];
+            int next = 0;
+            IntPtr Pin(byte[]? buffer)
+            {
+                if (buffer == null)
+                    return IntPtr.Zero;
+                handles[next] = GCHandle.Alloc(buffer, GCHandleType.Pinned);
+                return handles[next++].AddrOfPinnedObject();
+            }
+
+            for (int i = 0; i < items.Length; i++)
+            {
+                var item = items[i];
+                nativeItems[i] = new NativeBatchItem
+                {
+                    Nonce = Pin(item.Nonce),
+                    Input = Pin(item.Input),
+                    InputLength = (nuint)item.Input.Length,
+                    AssociatedData = Pin(item.AssociatedData),
+                    AssociatedDataLength = (nuint)(item.AssociatedData?.Length ?? 0),
+                    Output = Pin(item.Output),
+                    Tag = Pin(item.Tag),
+                };
+            }
+            return nativeItems;
+        }
+
+        // Sums the segment lengths, rejecting segments without an array.
+        private static long TotalLength(IReadOnlyList<ArraySegment<byte>> segments, string paramName)
+        {
+            long total = 0;
+            for (int i = 0; i < segments.Count; i++)
+            {
+                if (segments[i].Array == null)
+                    throw new ArgumentException("Segments must refer to an array.", paramName);
+                total += segments[i].Count;
+            }
+            return total;
+        }
+
+        // Pins the array behind each non-empty segment, recording the handles
+        // so the caller can release them. A null list gives no segments.
+        private static NativeIoVec[] PinSegments(IReadOnlyList<ArraySegment<byte>>? segments, List<GCHandle> handles)
+        {
+            if (segments == null)
+                return Array.Empty<NativeIoVec>();
+
+            var vectors = new NativeIoVec[segments.Count];
+            for (int i = 0; i < vectors.Length; i++)
+            {
+                var segment = segments[i];
+                if (segment.Count == 0)
+                    continue;
+                var handle = GCHandle.Alloc(segment.Array, GCHandleType.Pinned);
+                handles.Add(handle);
+                vectors[i] = new NativeIoVec
+                {
+                    Data = handle.AddrOfPinnedObject() + segment.Offset,
+                    Length = (nuint)segment.Count,
+                };
+            }
+            return vectors;
+        }
+
+        private static void GetBackend(out IntPtr name, out uint features)
+        {
+            AesGcmSivNative.EnsureLoaded();
+            IntPtr namePtr;
+            uint featureBits;
+            int result = AesGcmSivNative.GetBackend(&namePtr, &featureBits);
+            name = namePtr;
+            features = featureBits;
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                throw new CryptographicException($"Backend query failed with error code: {result}");
             }
         }
 
@@ -168,8 +4415,8 @@ namespace System.Security.Cryptography
                 throw new ObjectDisposedException(nameof(AesGcmSiv));
         }
 
-        private static void ValidateEncryptParameters(
-            byte[] nonce, byte[] plaintext, byte[] ciphertext, byte[] tag, byte[]? associatedData)
+        internal static void ValidateEncryptParameters(
+            byte[]? nonce, byte[] plaintext, byte[] ciphertext, byte[] tag, byte[]? associatedData)
         {
             if (nonce == null)
                 throw new ArgumentNullException(nameof(nonce));
@@ -188,8 +4435,51 @@ namespace System.Security.Cryptography
                 throw new ArgumentException($"Tag buffer must be at least {TagSize} bytes.", nameof(tag));
         }
 
-        private static void ValidateDecryptParameters(
-            byte[] nonce, byte[] ciphertext, byte[] tag, byte[] plaintext, byte[]? associatedData)
+        // Checks shared by the in-place overloads. Decryption needs the tag to
+        // be exactly TagSize bytes; encryption only needs room for it.
+        private static void ValidateNonceAndTag(byte[] nonce, byte[] tag, bool exactTag)
+        {
+            if (nonce == null)
+                throw new ArgumentNullException(nameof(nonce));
+            if (tag == null)
+                throw new ArgumentNullException(nameof(tag));
+
+            if (nonce.Length != NonceSize)
+                throw new ArgumentException($"Nonce must be exactly {NonceSize} bytes (96 bits).", nameof(nonce));
+            if (exactTag && tag.Length != TagSize)
+                throw new ArgumentException($"Tag must be exactly {TagSize} bytes.", nameof(tag));
+            if (!exactTag && tag.Length < TagSize)
+                throw new ArgumentException($"Tag buffer must be at least {TagSize} bytes.", nameof(tag));
+        }
+
+        // Checks for the span overloads, which have no nulls to reject.
+        private static void ValidateSpanParameters(
+            ReadOnlySpan<byte> nonce, ReadOnlySpan<byte> input, ReadOnlySpan<byte> output, string outputName,
+            ReadOnlySpan<byte> tag, bool exactTag)
+        {
+            if (nonce.Length != NonceSize)
+                throw new ArgumentException($"Nonce must be exactly {NonceSize} bytes (96 bits).", nameof(nonce));
+            if (output.Length < input.Length)
+                throw new ArgumentException("Output buffer is too small.", outputName);
+            if (input.Overlaps(output, out int offset) && offset != 0)
+                throw new ArgumentException("Input and output buffers must be the same memory or not overlap.", outputName);
+            if (exactTag && tag.Length != TagSize)
+                throw new ArgumentException($"Tag must be exactly {TagSize} bytes.", nameof(tag));
+            if (!exactTag && tag.Length < TagSize)
+                throw new ArgumentException($"Tag buffer must be at least {TagSize} bytes.", nameof(tag));
+        }
+
+        // Not every native entry point takes a NULL buffer for an empty message,
+        // and an empty span may have a null reference.
+        internal static ref byte BufferReference(ReadOnlySpan<byte> span)
+        {
+            if (span.IsEmpty)
+                return ref MemoryMarshal.GetArrayDataReference(s_emptyBuffer);
+            return ref MemoryMarshal.GetReference(span);
+        }
+
+        internal static void ValidateDecryptParameters(
+            byte[]? nonce, byte[] ciphertext, byte[] tag, byte[] plaintext, byte[]? associatedData)
         {
             if (nonce == null)
                 throw new ArgumentNullException(nameof(nonce));
@@ -0,0 +1,20 @@
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Where <see cref="AesGcmSiv.EncryptArrowColumn"/> puts each value's tag in the Arrow array it returns.
+    /// </summary>
+    public enum AesGcmSivArrowTagLayout
+    {
+        /// <summary>
+        /// A struct array of two children: <c>ciphertext</c>, binary with the input's lengths, and
+        /// <c>tag</c>, fixed-size binary of 16 bytes.
+        /// </summary>
+        Struct = 0,
+
+        /// <summary>
+        /// A binary array whose every value is the ciphertext followed by its tag, 16 bytes longer than
+        /// the input's.
+        /// </summary>
+        Appended = 1,
+    }
+}
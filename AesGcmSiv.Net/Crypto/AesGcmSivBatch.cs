@@ -0,0 +1,212 @@
+using System.Buffers;
+using System.Runtime.InteropServices;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// A batch of messages for one <see cref="AesGcmSiv"/> that is built item by item and run with a
+    /// single native call, then cleared and built again without allocating.
+    /// </summary>
+    /// <remarks>
+    /// <see cref="Add"/> pins the item's buffers and writes its native descriptor straight into an
+    /// array on the pinned object heap, so <see cref="Encrypt"/> and <see cref="Decrypt"/> hand that
+    /// array to the native library as it is, with no per-call descriptor array, pinning or delegate.
+    /// The buffers are taken as <see cref="Memory{T}"/> rather than spans because they must stay pinned
+    /// from <see cref="Add"/> until the batch runs; arrays are pinned with a GC handle, which takes
+    /// nothing from the GC heap. <see cref="Clear"/> unpins them and keeps the arrays, which only grow
+    /// when a batch outgrows every one before it. An instance is not thread-safe.
+    /// </remarks>
+    public sealed unsafe class AesGcmSivBatch : IDisposable
+    {
+        private const int AESGCMSIV_SUCCESS = 0;
+        private const int AESGCMSIV_ERROR_DECRYPT_FAILED = -5;
+        private const int NonceSize = 12;
+        private const int TagSize = 16;
+        private const int HandlesPerItem = 5;
+
+        private readonly AesGcmSiv _aesGcmSiv;
+        private NativeBatchItem[] _items;  // pinned object heap
+        private int[] _statuses;  // pinned object heap
+        private MemoryHandle[] _handles;
+        private int _count;
+        private bool _disposed;
+
+        /// <summary>
+        /// Initializes an empty batch for <paramref name="aesGcmSiv"/>.
+        /// </summary>
+        /// <param name="aesGcmSiv">The key the batch runs under.</param>
+        /// <param name="capacity">The number of items to make room for up front.</param>
+        /// <exception cref="ArgumentNullException"><paramref name="aesGcmSiv"/> is null.</exception>
+        /// <exception cref="ArgumentOutOfRangeException"><paramref name="capacity"/> is not positive.</exception>
+        public AesGcmSivBatch(AesGcmSiv aesGcmSiv, int capacity = 16)
+        {
+            ArgumentNullException.ThrowIfNull(aesGcmSiv);
+            ArgumentOutOfRangeException.ThrowIfNegativeOrZero(capacity);
+
+            _aesGcmSiv = aesGcmSiv;
+            _items = GC.AllocateUninitializedArray<NativeBatchItem>(capacity, pinned: true);
+            _statuses = GC.AllocateUninitializedArray<int>(capacity, pinned: true);
+            _handles = new MemoryHandle[capacity * HandlesPerItem];
+        }
+
+        /// <summary>
+        /// Gets the number of items in the batch.
+        /// </summary>
+        public int Count => _count;
+
+        /// <summary>
+        /// Adds a message to the batch. Its buffers stay pinned until <see cref="Clear"/>.
+        /// </summary>
+        /// <param name="nonce">The nonce. Must be exactly 12 bytes (96 bits).</param>
+        /// <param name="input">The plaintext when encrypting, the ciphertext when decrypting.</param>
+        /// <param name="output">
+        /// The output buffer. Must be at least as large as <paramref name="input"/>; may be the same memory,
+        /// but must not otherwise overlap it.
+        /// </param>
+        /// <param name="tag">
+        /// Receives the tag when encrypting and holds the tag to verify when decrypting. Must be at least
+        /// 16 bytes; only the first 16 are used.
+        /// </param>
+        /// <param name="associatedData">Optional additional authenticated data.</param>
+        /// <exception cref="ObjectDisposedException">The batch has been disposed.</exception>
+        /// <exception cref="ArgumentException">The buffer sizes are invalid.</exception>
+        public void Add(
+            ReadOnlyMemory<byte> nonce, ReadOnlyMemory<byte> input, Memory<byte> output, Memory<byte> tag,
+            ReadOnlyMemory<byte> associatedData = default)
+        {
+            ObjectDisposedException.ThrowIf(_disposed, this);
+            if (nonce.Length != NonceSize)
+                throw new ArgumentException($"Nonce must be exactly {NonceSize} bytes (96 bits).", nameof(nonce));
+            if (output.Length < input.Length)
+                throw new ArgumentException("Output buffer is too small.", nameof(output));
+            if (input.Span.Overlaps(output.Span, out int offset) && offset != 0)
+                throw new ArgumentException("Input and output buffers must be the same memory or not overlap.", nameof(output));
+            if (tag.Length < TagSize)
+                throw new ArgumentException($"Tag buffer must be at least {TagSize} bytes.", nameof(tag));
+
+            if (_count == _items.Length)
+                Grow();
+
+            int first = _count * HandlesPerItem;
+            _handles[first] = nonce.Pin();
+            _handles[first + 1] = AesGcmSiv.JobBuffer(input).Pin();
+            _handles[first + 2] = associatedData.Pin();
+            _handles[first + 3] = AesGcmSiv.JobBuffer(output).Pin();
+            _handles[first + 4] = tag.Pin();
+            _items[_count++] = new NativeBatchItem
+            {
+                Nonce = (IntPtr)_handles[first].Pointer,
+                Input = (IntPtr)_handles[first + 1].Pointer,
+                InputLength = (nuint)input.Length,
+                AssociatedData = (IntPtr)_handles[first + 2].Pointer,
+                AssociatedDataLength = (nuint)associatedData.Length,
+                Output = (IntPtr)_handles[first + 3].Pointer,
+                Tag = (IntPtr)_handles[first + 4].Pointer,
+            };
+        }
+
+        /// <summary>
+        /// Encrypts every item with a single native call, writing each ciphertext and tag to the item's
+        /// output and tag buffers. The items stay in the batch.
+        /// </summary>
+        /// <exception cref="ObjectDisposedException">The batch or its <see cref="AesGcmSiv"/> has been disposed.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public void Encrypt()
+        {
+            ObjectDisposedException.ThrowIf(_disposed, this);
+            if (_count == 0)
+                return;
+
+            int result;
+            fixed (NativeBatchItem* itemsPtr = _items)
+            {
+                result = _aesGcmSiv.RunDescriptors(itemsPtr, _count, null);
+            }
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                throw new CryptographicException($"Batch encryption failed with error code: {result}");
+            }
+        }
+
+        /// <summary>
+        /// Decrypts every item with a single native call, reporting authentication failures per item.
+        /// The output of an item that fails to authenticate is zeroed. The items stay in the batch.
+        /// </summary>
+        /// <param name="succeeded">
+        /// Receives, for each item in the order added, whether it authenticated. Must be at least
+        /// <see cref="Count"/> long.
+        /// </param>
+        /// <returns>The number of items that failed to authenticate.</returns>
+        /// <exception cref="ObjectDisposedException">The batch or its <see cref="AesGcmSiv"/> has been disposed.</exception>
+        /// <exception cref="ArgumentException"><paramref name="succeeded"/> is too small.</exception>
+        /// <exception cref="CryptographicException">Decryption failed for a reason other than authentication.</exception>
+        public int Decrypt(Span<bool> succeeded)
+        {
+            ObjectDisposedException.ThrowIf(_disposed, this);
+            if (succeeded.Length < _count)
+                throw new ArgumentException("Result buffer is too small.", nameof(succeeded));
+            if (_count == 0)
+                return 0;
+
+            int result;
+            fixed (NativeBatchItem* itemsPtr = _items)
+            {
+                result = _aesGcmSiv.RunDescriptors(itemsPtr, _count, _statuses);
+            }
+            if (result != AESGCMSIV_SUCCESS && result != AESGCMSIV_ERROR_DECRYPT_FAILED)
+            {
+                throw new CryptographicException($"Batch decryption failed with error code: {result}");
+            }
+
+            int failures = 0;
+            for (int i = 0; i < _count; i++)
+            {
+                if (_statuses[i] != AESGCMSIV_SUCCESS && _statuses[i] != AESGCMSIV_ERROR_DECRYPT_FAILED)
+                {
+                    throw new CryptographicException($"Batch decryption failed with error code: {_statuses[i]}");
+                }
+                succeeded[i] = _statuses[i] == AESGCMSIV_SUCCESS;
+                if (!succeeded[i])
+                    failures++;
+            }
+            return failures;
+        }
+
+        /// <summary>
+        /// Removes every item and unpins its buffers, keeping the capacity for the next batch.
+        /// </summary>
+        public void Clear()
+        {
+            for (int i = 0; i < _count * HandlesPerItem; i++)
+            {
+                _handles[i].Dispose();
+                _handles[i] = default;
+            }
+            _count = 0;
+        }
+
+        /// <summary>
+        /// Unpins the buffers of any items still in the batch.
+        /// </summary>
+        public void Dispose()
+        {
+            if (!_disposed)
+            {
+                Clear();
+                _disposed = true;
+            }
+        }
+
+        // Doubles the capacity; the descriptors move with the array, and the
+        // buffers they point to stay pinned by their handles
+        private void Grow()
+        {
+            int capacity = _items.Length * 2;
+            var items = GC.AllocateUninitializedArray<NativeBatchItem>(capacity, pinned: true);
+            _items.AsSpan(0, _count).CopyTo(items);
+            _items = items;
+            _statuses = GC.AllocateUninitializedArray<int>(capacity, pinned: true);
+            Array.Resize(ref _handles, capacity * HandlesPerItem);
+        }
+    }
+}
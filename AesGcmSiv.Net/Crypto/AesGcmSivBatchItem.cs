@@ -0,0 +1,49 @@
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Describes one message in a batch call on <see cref="AesGcmSiv"/>.
+    /// </summary>
+    /// <remarks>
+    /// When encrypting, <see cref="Input"/> is the plaintext, <see cref="Output"/> receives the
+    /// ciphertext and <see cref="Tag"/> receives the authentication tag. When decrypting,
+    /// <see cref="Input"/> is the ciphertext, <see cref="Output"/> receives the plaintext and
+    /// <see cref="Tag"/> holds the tag to verify.
+    /// </remarks>
+    public readonly struct AesGcmSivBatchItem
+    {
+        /// <summary>
+        /// Initializes a new batch item.
+        /// </summary>
+        /// <param name="nonce">
+        /// The nonce. Must be exactly 12 bytes (96 bits), or null for a batch whose nonces are derived
+        /// from a base nonce and a counter.
+        /// </param>
+        /// <param name="input">The data to encrypt or decrypt.</param>
+        /// <param name="output">The output buffer. Must be at least as large as <paramref name="input"/>.</param>
+        /// <param name="tag">The authentication tag buffer. Must be 16 bytes.</param>
+        /// <param name="associatedData">Optional additional authenticated data.</param>
+        public AesGcmSivBatchItem(byte[]? nonce, byte[] input, byte[] output, byte[] tag, byte[]? associatedData = null)
+        {
+            Nonce = nonce;
+            Input = input;
+            Output = output;
+            Tag = tag;
+            AssociatedData = associatedData;
+        }
+
+        /// <summary>Gets the nonce.</summary>
+        public byte[]? Nonce { get; }
+
+        /// <summary>Gets the data to encrypt or decrypt.</summary>
+        public byte[] Input { get; }
+
+        /// <summary>Gets the output buffer.</summary>
+        public byte[] Output { get; }
+
+        /// <summary>Gets the authentication tag buffer.</summary>
+        public byte[] Tag { get; }
+
+        /// <summary>Gets the optional additional authenticated data.</summary>
+        public byte[]? AssociatedData { get; }
+    }
+}
@@ -0,0 +1,282 @@
+using System.Buffers;
+using System.Collections.Concurrent;
+using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// A fixed number of equal-sized buffers that never move, registered once with the native library
+    /// so batches over them name their messages by buffer index and offset, as io_uring does with
+    /// registered buffers.
+    /// </summary>
+    /// <remarks>
+    /// The buffers are carved from one block, either an array on the pinned object heap or memory from
+    /// <see cref="NativeMemory.AlignedAlloc"/>, with each buffer starting on a 64-byte cache line. The
+    /// first native batch over the pool registers every buffer with the library, and from then on
+    /// <see cref="AesGcmSiv.EncryptRegistered"/> and <see cref="AesGcmSiv.DecryptRegistered"/> pin
+    /// nothing and pass no pointers: the items are handed over as they are and each range is checked
+    /// against the registered lengths. An <see cref="AesGcmSiv"/> using the managed implementation
+    /// works on the same buffers without registering them.
+    ///
+    /// <see cref="TryRent"/> and <see cref="Return"/> hand out buffer indices to concurrent users; a
+    /// caller that manages the indices itself need not use them. Batches may run on any number of
+    /// threads at once, but the pool must not be disposed while one is running, and natively allocated
+    /// memory is only freed by <see cref="Dispose"/>.
+    /// </remarks>
+    public sealed unsafe class AesGcmSivBufferPool : IDisposable
+    {
+        private const int AESGCMSIV_SUCCESS = 0;
+        private const int NonceSize = 12;
+        private const int TagSize = 16;
+
+        // Every buffer starts on a cache line, so neighbours never share one
+        private const int Alignment = 64;
+
+        private readonly byte[]? _array;  // pinned object heap; null for native memory
+        private readonly int _arrayOffset;  // of buffer 0 in _array
+        private readonly void* _native;  // NativeMemory.AlignedAlloc; null for the array
+        private readonly byte* _first;  // start of buffer 0
+        private readonly long _stride;
+        private readonly NativeBufferManager[]? _managers;
+        private readonly ConcurrentQueue<int> _free = new();
+        private readonly int[] _rented;
+        private readonly object _registryLock = new();
+        private SafeAesGcmSivBuffersHandle? _registry;
+        private bool _disposed;
+
+        /// <summary>
+        /// Initializes a pool of <paramref name="bufferCount"/> buffers of <paramref name="bufferSize"/>
+        /// bytes each.
+        /// </summary>
+        /// <param name="bufferCount">The number of buffers, numbered from 0.</param>
+        /// <param name="bufferSize">The size of each buffer in bytes.</param>
+        /// <param name="useNativeMemory">
+        /// True to allocate with <see cref="NativeMemory.AlignedAlloc"/>, outside the GC heap; false to
+        /// allocate one array on the pinned object heap.
+        /// </param>
+        /// <exception cref="ArgumentOutOfRangeException">
+        /// <paramref name="bufferCount"/> or <paramref name="bufferSize"/> is not positive, or the pool
+        /// is too large for one array.
+        /// </exception>
+        /// <exception cref="OutOfMemoryException">The memory could not be allocated.</exception>
+        public AesGcmSivBufferPool(int bufferCount, int bufferSize, bool useNativeMemory = false)
+        {
+            ArgumentOutOfRangeException.ThrowIfNegativeOrZero(bufferCount);
+            ArgumentOutOfRangeException.ThrowIfNegativeOrZero(bufferSize);
+
+            _stride = ((long)bufferSize + Alignment - 1) & ~(long)(Alignment - 1);
+            long total = _stride * bufferCount;
+            if (useNativeMemory)
+            {
+                _native = NativeMemory.AlignedAlloc((nuint)total, Alignment);
+                _first = (byte*)_native;
+                _managers = new NativeBufferManager[bufferCount];
+                for (int i = 0; i < bufferCount; i++)
+                {
+                    _managers[i] = new NativeBufferManager(_first + i * _stride, bufferSize);
+                }
+            }
+            else
+            {
+                // The array's data is not itself aligned, so it has room to
+                // start buffer 0 on the next cache line
+                if (total > Array.MaxLength - Alignment)
+                    throw new ArgumentOutOfRangeException(nameof(bufferCount), "The pool is too large for one array; use native memory.");
+                _array = GC.AllocateUninitializedArray<byte>((int)total + Alignment, pinned: true);
+                byte* data = (byte*)Unsafe.AsPointer(ref MemoryMarshal.GetArrayDataReference(_array));
+                _arrayOffset = (int)(-(nint)data & (Alignment - 1));
+                _first = data + _arrayOffset;
+            }
+
+            BufferCount = bufferCount;
+            BufferSize = bufferSize;
+            _rented = new int[bufferCount];
+            for (int i = 0; i < bufferCount; i++)
+            {
+                _free.Enqueue(i);
+            }
+        }
+
+        /// <summary>Gets the number of buffers.</summary>
+        public int BufferCount { get; }
+
+        /// <summary>Gets the size of each buffer in bytes.</summary>
+        public int BufferSize { get; }
+
+        /// <summary>Gets whether the buffers are outside the GC heap.</summary>
+        public bool UsesNativeMemory => _array == null;
+
+        /// <summary>
+        /// Gets a buffer as a span.
+        /// </summary>
+        /// <param name="index">The buffer index.</param>
+        /// <exception cref="ArgumentOutOfRangeException"><paramref name="index"/> is out of range.</exception>
+        /// <exception cref="ObjectDisposedException">The pool has been disposed.</exception>
+        public Span<byte> GetSpan(int index)
+        {
+            ThrowIfDisposed();
+            CheckIndex(index, nameof(index));
+            return new Span<byte>(_first + index * _stride, BufferSize);
+        }
+
+        /// <summary>
+        /// Gets a buffer as memory, for asynchronous I/O straight into or out of it.
+        /// </summary>
+        /// <param name="index">The buffer index.</param>
+        /// <exception cref="ArgumentOutOfRangeException"><paramref name="index"/> is out of range.</exception>
+        /// <exception cref="ObjectDisposedException">The pool has been disposed.</exception>
+        public Memory<byte> GetMemory(int index)
+        {
+            ThrowIfDisposed();
+            CheckIndex(index, nameof(index));
+            if (_managers != null)
+                return _managers[index].Memory;
+            return new Memory<byte>(_array!, _arrayOffset + (int)(index * _stride), BufferSize);
+        }
+
+        /// <summary>
+        /// Takes a free buffer, if there is one, for the caller's exclusive use until it is returned.
+        /// </summary>
+        /// <param name="index">Receives the buffer index, or -1 if every buffer is rented.</param>
+        /// <returns>True if a buffer was taken.</returns>
+        /// <exception cref="ObjectDisposedException">The pool has been disposed.</exception>
+        public bool TryRent(out int index)
+        {
+            ThrowIfDisposed();
+            if (!_free.TryDequeue(out index))
+            {
+                index = -1;
+                return false;
+            }
+            Volatile.Write(ref _rented[index], 1);
+            return true;
+        }
+
+        /// <summary>
+        /// Gives back a buffer taken by <see cref="TryRent"/>. Its contents are left as they are.
+        /// </summary>
+        /// <param name="index">The buffer index.</param>
+        /// <exception cref="ArgumentOutOfRangeException"><paramref name="index"/> is out of range.</exception>
+        /// <exception cref="InvalidOperationException">The buffer is not rented.</exception>
+        /// <exception cref="ObjectDisposedException">The pool has been disposed.</exception>
+        public void Return(int index)
+        {
+            ThrowIfDisposed();
+            CheckIndex(index, nameof(index));
+            if (Interlocked.Exchange(ref _rented[index], 0) != 1)
+                throw new InvalidOperationException($"Buffer {index} is not rented.");
+            _free.Enqueue(index);
+        }
+
+        /// <summary>
+        /// Frees the native registry and, for native memory, the buffers themselves.
+        /// </summary>
+        public void Dispose()
+        {
+            lock (_registryLock)
+            {
+                if (_disposed)
+                    return;
+                _disposed = true;
+                _registry?.Dispose();
+            }
+            if (_native != null)
+                NativeMemory.AlignedFree(_native);
+        }
+
+        /// <summary>
+        /// Checks that every range of <paramref name="item"/> lies within its buffer, as the native
+        /// library does, so failures surface as argument exceptions under either implementation.
+        /// </summary>
+        internal void ValidateItem(in AesGcmSivRegisteredItem item)
+        {
+            ThrowIfDisposed();
+            CheckIndex(item.InputBuffer, "items");
+            CheckIndex(item.OutputBuffer, "items");
+            CheckRange(item.NonceOffset, NonceSize, "nonce");
+            CheckRange(item.InputOffset, item.Length, "input");
+            if (item.AssociatedDataLength != 0)
+                CheckRange(item.AssociatedDataOffset, item.AssociatedDataLength, "associated data");
+            CheckRange(item.OutputOffset, item.Length, "output");
+            CheckRange(item.TagOffset, TagSize, "tag");
+        }
+
+        /// <summary>
+        /// Returns the native registry, creating it and registering every buffer on first use.
+        /// </summary>
+        /// <exception cref="ObjectDisposedException">The pool has been disposed.</exception>
+        /// <exception cref="CryptographicException">The registry could not be created.</exception>
+        internal SafeAesGcmSivBuffersHandle GetRegistry()
+        {
+            SafeAesGcmSivBuffersHandle? registry = Volatile.Read(ref _registry);
+            if (registry != null)
+                return registry;
+
+            lock (_registryLock)
+            {
+                ThrowIfDisposed();
+                if (_registry != null)
+                    return _registry;
+
+                int result = SafeAesGcmSivBuffersHandle.Create(BufferCount, out registry);
+                for (int i = 0; i < BufferCount && result == AESGCMSIV_SUCCESS; i++)
+                {
+                    result = AesGcmSivNative.BuffersRegister(
+                        registry.DangerousGetHandle(), (nuint)i, _first + i * _stride, (nuint)BufferSize);
+                }
+                if (result != AESGCMSIV_SUCCESS)
+                {
+                    registry.Dispose();
+                    throw new CryptographicException($"Buffer registration failed with error code: {result}");
+                }
+                Volatile.Write(ref _registry, registry);
+                return registry;
+            }
+        }
+
+        private void CheckRange(long offset, long length, string what)
+        {
+            if (offset < 0 || length < 0 || offset > BufferSize || length > BufferSize - offset)
+                throw new ArgumentException($"An item's {what} runs past the end of its buffer.", "items");
+        }
+
+        private void CheckIndex(int index, string paramName)
+        {
+            if ((uint)index >= (uint)BufferCount)
+                throw new ArgumentOutOfRangeException(paramName, $"Buffer index must be between 0 and {BufferCount - 1}.");
+        }
+
+        private void ThrowIfDisposed()
+        {
+            if (_disposed)
+                throw new ObjectDisposedException(nameof(AesGcmSivBufferPool));
+        }
+
+        // Memory<byte> over one natively allocated buffer; the memory never
+        // moves, so pinning is free
+        internal sealed class NativeBufferManager : MemoryManager<byte>
+        {
+            private readonly byte* _pointer;
+            private readonly int _length;
+
+            public NativeBufferManager(byte* pointer, int length)
+            {
+                _pointer = pointer;
+                _length = length;
+            }
+
+            public override Span<byte> GetSpan() => new Span<byte>(_pointer, _length);
+
+            public override MemoryHandle Pin(int elementIndex = 0) => new MemoryHandle(_pointer + elementIndex);
+
+            public override void Unpin()
+            {
+            }
+
+            protected override void Dispose(bool disposing)
+            {
+            }
+        }
+    }
+}
@@ -0,0 +1,270 @@
+using System.Runtime.InteropServices;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// A bounded cache of verified plaintext chunks, shared by any number of
+    /// <see cref="AesGcmSivRandomAccessReader"/> instances, that lets hot reads skip both the read and
+    /// the decryption.
+    /// </summary>
+    /// <remarks>
+    /// The cache holds <see cref="Capacity"/> slots of <see cref="ChunkSize"/> bytes in one native
+    /// block, locked in RAM if asked, so cached plaintext never moves or reaches the GC heap, and with
+    /// <c>lockMemory</c> never reaches swap. Entries are keyed by a stream ID that the cache gives each
+    /// reader it is attached to, and the chunk number; readers therefore never see each other's
+    /// chunks, even for the same object, since each one verifies what it caches. Once full, the cache
+    /// evicts the chunk read least recently. A slot is wiped when its chunk is evicted or its reader
+    /// is disposed, and the whole block when the cache is disposed.
+    ///
+    /// Every method may be called from any number of threads at once. Dispose the cache only once
+    /// every reader using it has been disposed.
+    /// </remarks>
+    public sealed unsafe class AesGcmSivChunkCache : IDisposable
+    {
+        private const uint AESGCMSIV_ALLOC_LOCKED = 1u << 1;
+
+        private readonly byte* _slots;
+        private readonly bool _locked;  // _slots came from the native library
+        private readonly Dictionary<(long Stream, long Chunk), int> _index = new();  // guarded by itself, like everything below
+        private readonly (long Stream, long Chunk)[] _keys;
+        private readonly int[] _lengths;
+        private readonly int[] _newer;  // the LRU list: -1 ends it
+        private readonly int[] _older;
+        private readonly Stack<int> _free = new();  // slots emptied by RemoveStream
+        private int _newest = -1;
+        private int _oldest = -1;
+        private int _unused;  // slots never used yet start here
+        private long _nextStream;
+        private long _hits;
+        private long _misses;
+        private long _evictions;
+        private bool _disposed;
+
+        /// <summary>
+        /// Initializes an empty cache.
+        /// </summary>
+        /// <param name="capacity">Most chunks held at once.</param>
+        /// <param name="chunkSize">The largest chunk held, which sets the slot size; readers with larger chunks cannot use the cache.</param>
+        /// <param name="lockMemory">
+        /// Whether to keep the slots out of swap. Creation fails if the process may not lock that much
+        /// memory.
+        /// </param>
+        /// <exception cref="ArgumentOutOfRangeException">
+        /// <paramref name="capacity"/> is not positive, or <paramref name="chunkSize"/> is not positive or
+        /// is above <see cref="AesGcmSivStream.MaxChunkSize"/>.
+        /// </exception>
+        /// <exception cref="OutOfMemoryException">The memory could not be allocated or locked.</exception>
+        public AesGcmSivChunkCache(int capacity, int chunkSize = AesGcmSivStream.DefaultChunkSize, bool lockMemory = false)
+        {
+            ArgumentOutOfRangeException.ThrowIfNegativeOrZero(capacity);
+            ArgumentOutOfRangeException.ThrowIfNegativeOrZero(chunkSize);
+            ArgumentOutOfRangeException.ThrowIfGreaterThan(chunkSize, AesGcmSivStream.MaxChunkSize);
+
+            nuint bytes = (nuint)((long)capacity * chunkSize);
+            if (lockMemory)
+            {
+                AesGcmSivNative.EnsureLoaded();
+                _slots = (byte*)AesGcmSivNative.Alloc(bytes, AESGCMSIV_ALLOC_LOCKED);
+                if (_slots == null)
+                    throw new OutOfMemoryException("The chunk cache could not be allocated and locked in memory.");
+                _locked = true;
+            }
+            else
+            {
+                _slots = (byte*)NativeMemory.Alloc(bytes);
+            }
+
+            Capacity = capacity;
+            ChunkSize = chunkSize;
+            _keys = new (long, long)[capacity];
+            _lengths = new int[capacity];
+            _newer = new int[capacity];
+            _older = new int[capacity];
+        }
+
+        /// <summary>Gets the most chunks the cache holds at once.</summary>
+        public int Capacity { get; }
+
+        /// <summary>Gets the largest chunk the cache holds, in bytes.</summary>
+        public int ChunkSize { get; }
+
+        /// <summary>Gets the number of chunks held.</summary>
+        public int Count
+        {
+            get
+            {
+                lock (_index)
+                {
+                    return _index.Count;
+                }
+            }
+        }
+
+        /// <summary>Gets the number of chunk reads served from the cache.</summary>
+        public long Hits => Interlocked.Read(ref _hits);
+
+        /// <summary>Gets the number of chunk reads the cache could not serve.</summary>
+        public long Misses => Interlocked.Read(ref _misses);
+
+        /// <summary>Gets the number of chunks evicted to make room.</summary>
+        public long Evictions => Interlocked.Read(ref _evictions);
+
+        /// <summary>
+        /// Drops and wipes every chunk held.
+        /// </summary>
+        /// <exception cref="ObjectDisposedException">The cache has been disposed.</exception>
+        public void Clear()
+        {
+            lock (_index)
+            {
+                ObjectDisposedException.ThrowIf(_disposed, this);
+                _index.Clear();
+                _free.Clear();
+                WipeSlots();
+                _newest = _oldest = -1;
+                _unused = 0;
+            }
+        }
+
+        /// <summary>
+        /// Wipes and frees the slots.
+        /// </summary>
+        public void Dispose()
+        {
+            lock (_index)
+            {
+                if (_disposed)
+                    return;
+                _disposed = true;
+                _index.Clear();
+                WipeSlots();
+            }
+            if (_locked)
+                AesGcmSivNative.Free(_slots);
+            else
+                NativeMemory.Free(_slots);
+        }
+
+        // A stream ID for a reader attaching to the cache
+        internal long NewStream() => Interlocked.Increment(ref _nextStream);
+
+        // Copies the part of the chunk at and after start into destination if
+        // the cache holds it, returning how much was copied, or -1 if not
+        internal int TryCopy(long stream, long chunk, int start, Span<byte> destination)
+        {
+            lock (_index)
+            {
+                if (_disposed || !_index.TryGetValue((stream, chunk), out int slot))
+                {
+                    _misses++;
+                    return -1;
+                }
+                _hits++;
+                Unlink(slot);
+                LinkNewest(slot);
+                int length = Math.Min(_lengths[slot] - start, destination.Length);
+                new ReadOnlySpan<byte>(_slots + (nint)slot * ChunkSize + start, length).CopyTo(destination);
+                return length;
+            }
+        }
+
+        // Whether the cache holds the chunk, counting a miss if asked to but
+        // never a hit, which is counted when the chunk is copied out
+        internal bool Contains(long stream, long chunk, bool countMiss = false)
+        {
+            lock (_index)
+            {
+                bool found = !_disposed && _index.ContainsKey((stream, chunk));
+                if (!found && countMiss)
+                    _misses++;
+                return found;
+            }
+        }
+
+        // Caches a verified chunk, evicting the least recently read one if full
+        internal void Add(long stream, long chunk, ReadOnlySpan<byte> plaintext)
+        {
+            lock (_index)
+            {
+                if (_disposed || _index.ContainsKey((stream, chunk)))
+                    return;
+                int slot;
+                if (_free.Count > 0)
+                {
+                    slot = _free.Pop();
+                }
+                else if (_unused < Capacity)
+                {
+                    slot = _unused++;
+                }
+                else
+                {
+                    slot = _oldest;
+                    Unlink(slot);
+                    _index.Remove(_keys[slot]);
+                    Wipe(slot);
+                    _evictions++;
+                }
+                plaintext.CopyTo(new Span<byte>(_slots + (nint)slot * ChunkSize, ChunkSize));
+                _keys[slot] = (stream, chunk);
+                _lengths[slot] = plaintext.Length;
+                _index.Add((stream, chunk), slot);
+                LinkNewest(slot);
+            }
+        }
+
+        // Drops and wipes every chunk of a reader being disposed
+        internal void RemoveStream(long stream)
+        {
+            lock (_index)
+            {
+                if (_disposed)
+                    return;
+                for (int slot = 0; slot < _unused; slot++)
+                {
+                    if (_keys[slot].Stream != stream || !_index.Remove(_keys[slot]))
+                        continue;
+                    Unlink(slot);
+                    Wipe(slot);
+                    _free.Push(slot);
+                }
+            }
+        }
+
+        private void Wipe(int slot)
+        {
+            CryptographicOperations.ZeroMemory(new Span<byte>(_slots + (nint)slot * ChunkSize, _lengths[slot]));
+        }
+
+        // Wipes every slot ever used; the block may be too large for one span
+        private void WipeSlots()
+        {
+            for (int slot = 0; slot < _unused; slot++)
+                CryptographicOperations.ZeroMemory(new Span<byte>(_slots + (nint)slot * ChunkSize, ChunkSize));
+        }
+
+        private void Unlink(int slot)
+        {
+            int newer = _newer[slot], older = _older[slot];
+            if (newer >= 0)
+                _older[newer] = older;
+            else
+                _newest = older;
+            if (older >= 0)
+                _newer[older] = newer;
+            else
+                _oldest = newer;
+        }
+
+        private void LinkNewest(int slot)
+        {
+            _newer[slot] = -1;
+            _older[slot] = _newest;
+            if (_newest >= 0)
+                _newer[_newest] = slot;
+            else
+                _oldest = slot;
+            _newest = slot;
+        }
+    }
+}
@@ -0,0 +1,442 @@
+using System.Buffers;
+using System.Buffers.Binary;
+using System.Numerics;
+using Microsoft.Win32.SafeHandles;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// A deduplicating store of encrypted chunks for backups, which splits each stream it stores at
+    /// content-defined boundaries and writes only the chunks it does not hold yet.
+    /// </summary>
+    /// <remarks>
+    /// Streams are cut with FastCDC: a gear hash rolls over the bytes and a chunk ends where its top
+    /// bits are zero, with a stricter mask before the average size and a looser one after it, so the
+    /// sizes bunch around the average. Boundaries depend only on the bytes near them, so an insertion
+    /// shifts the chunks around it and leaves the rest unchanged.
+    ///
+    /// A chunk's id is HMAC-SHA256 of its plaintext under a separate id key, and its nonce is the first
+    /// 12 bytes of the id. AES-GCM-SIV is deterministic, so equal chunks encrypt to equal records, and a
+    /// chunk whose id is already in the index is skipped before it is encrypted or written. New chunks
+    /// are encrypted by one <see cref="AesGcmSivBatch"/> call per batch and appended with one write. The
+    /// ids are stored in the clear, which tells anyone holding the pack which chunks are equal, but
+    /// without the id key not what they hold; that is the price of deduplication.
+    ///
+    /// The pack file holds a <see cref="HeaderSize"/>-byte header, then one record per chunk: its id,
+    /// its length, its ciphertext and its tag, with the id as associated data so records cannot be
+    /// swapped. The index is rebuilt by walking the records when the store is opened; a record cut
+    /// short at the end of the file, as a crash during a write leaves it, is removed.
+    /// <see cref="Store"/> returns a recipe, the ids of the stream's chunks in order, which
+    /// <see cref="Restore"/> turns back into the stream. Keep recipes alongside the pack; they hold
+    /// nothing secret beyond the ids. An instance is not thread-safe.
+    /// </remarks>
+    public sealed class AesGcmSivChunkStore : IDisposable
+    {
+        /// <summary>The size of the pack file header, in bytes.</summary>
+        public const int HeaderSize = 8;
+
+        /// <summary>The size of a chunk id, and so of each recipe entry, in bytes.</summary>
+        public const int ChunkIdSize = 32;
+
+        private const int LengthSize = 4;
+        private const int RecordOverhead = ChunkIdSize + LengthSize + TagSize;
+        private const int TagSize = 16;
+        private const int NonceSize = 12;
+        private const byte FormatVersion = 1;
+        private const int MinAverageChunkSize = 1 << 10;
+        private const int MaxAverageChunkSize = 1 << 20;
+        // Bytes cut into chunks before the new ones among them are committed
+        private const int BatchBytes = 8 << 20;
+
+        // The gear hash values, fixed forever: other values would move every
+        // chunk boundary and so defeat deduplication against older backups
+        private static readonly ulong[] s_gear = CreateGear();
+
+        private readonly FileStream _file;
+        private readonly AesGcmSiv _aesGcmSiv;
+        private readonly byte[] _chunkIdKey;
+        private readonly bool _flushToDisk;
+        private readonly int _minChunkSize;
+        private readonly int _averageChunkSize;
+        private readonly int _maxChunkSize;
+        private readonly ulong _strictMask;
+        private readonly ulong _looseMask;
+        private readonly Dictionary<ChunkKey, ChunkLocation> _index = new();
+        private readonly AesGcmSivBatch _batch;
+        private byte[] _records = Array.Empty<byte>();
+        private long _length;
+        private bool _disposed;
+
+        /// <summary>
+        /// Opens the chunk store at <paramref name="path"/>, creating it if it does not exist.
+        /// </summary>
+        /// <param name="path">The pack file.</param>
+        /// <param name="aesGcmSiv">The key to encrypt with. Must stay undisposed until the store is disposed.</param>
+        /// <param name="chunkIdKey">
+        /// The key chunk ids are derived under, at least 16 bytes. Must not be the encryption key, and must
+        /// stay the same for the life of the store, or no chunk will match an earlier one.
+        /// </param>
+        /// <param name="averageChunkSize">
+        /// The average chunk size, a power of two from 1 KiB to 1 MiB. Chunks run from a quarter of it to
+        /// four times it. Changing it moves the boundaries, so later streams share fewer chunks with
+        /// earlier ones.
+        /// </param>
+        /// <param name="flushToDisk">Whether each <see cref="Store"/> waits for its chunks to reach the disk.</param>
+        /// <exception cref="ArgumentNullException">An argument is null.</exception>
+        /// <exception cref="ArgumentException"><paramref name="chunkIdKey"/> is shorter than 16 bytes.</exception>
+        /// <exception cref="ArgumentOutOfRangeException"><paramref name="averageChunkSize"/> is not a power of two in range.</exception>
+        /// <exception cref="CryptographicException">The file exists but does not hold a valid pack.</exception>
+        /// <exception cref="IOException">The file could not be opened or read.</exception>
+        public AesGcmSivChunkStore(
+            string path, AesGcmSiv aesGcmSiv, byte[] chunkIdKey, int averageChunkSize = 64 << 10, bool flushToDisk = true)
+        {
+            ArgumentNullException.ThrowIfNull(path);
+            ArgumentNullException.ThrowIfNull(aesGcmSiv);
+            ArgumentNullException.ThrowIfNull(chunkIdKey);
+            if (chunkIdKey.Length < 16)
+                throw new ArgumentException("The chunk id key must be at least 16 bytes.", nameof(chunkIdKey));
+            if (averageChunkSize < MinAverageChunkSize || averageChunkSize > MaxAverageChunkSize ||
+                !BitOperations.IsPow2(averageChunkSize))
+                throw new ArgumentOutOfRangeException(nameof(averageChunkSize), "Must be a power of two from 1 KiB to 1 MiB.");
+
+            _aesGcmSiv = aesGcmSiv;
+            _chunkIdKey = (byte[])chunkIdKey.Clone();
+            _flushToDisk = flushToDisk;
+            _averageChunkSize = averageChunkSize;
+            _minChunkSize = averageChunkSize / 4;
+            _maxChunkSize = averageChunkSize * 4;
+            // Two bits either side of the average, FastCDC's normalization level 2
+            int bits = BitOperations.Log2((uint)averageChunkSize);
+            _strictMask = ~0UL << (64 - (bits + 2));
+            _looseMask = ~0UL << (64 - (bits - 2));
+
+            _file = new FileStream(path, FileMode.OpenOrCreate, FileAccess.ReadWrite, FileShare.Read, bufferSize: 0);
+            try
+            {
+                if (_file.Length == 0)
+                {
+                    Span<byte> header = stackalloc byte[HeaderSize];
+                    "AGSC"u8.CopyTo(header);
+                    header[4] = FormatVersion;
+                    RandomAccess.Write(_file.SafeFileHandle, header, 0);
+                    _file.Flush(flushToDisk);
+                    _length = HeaderSize;
+                }
+                else
+                {
+                    _length = ScanRecords(_file.SafeFileHandle, _file.Length);
+                    if (_length < _file.Length)
+                    {
+                        // A torn last record; the next one must follow on from the
+                        // last whole one
+                        _file.SetLength(_length);
+                        _file.Flush(flushToDisk);
+                    }
+                }
+                _batch = new AesGcmSivBatch(aesGcmSiv, capacity: 64);
+            }
+            catch
+            {
+                _file.Dispose();
+                throw;
+            }
+        }
+
+        /// <summary>Gets the number of distinct chunks in the store.</summary>
+        public int ChunkCount => _index.Count;
+
+        /// <summary>Gets the plaintext bytes this instance has encrypted and written.</summary>
+        public long StoredBytes { get; private set; }
+
+        /// <summary>Gets the plaintext bytes this instance has skipped because their chunk was already held.</summary>
+        public long DuplicateBytes { get; private set; }
+
+        /// <summary>
+        /// Splits <paramref name="source"/> into chunks and writes the ones the store does not hold yet.
+        /// </summary>
+        /// <param name="source">The stream to store, read to its end.</param>
+        /// <returns>The recipe: the ids of the stream's chunks in order, <see cref="ChunkIdSize"/> bytes each.</returns>
+        /// <exception cref="ObjectDisposedException">The store has been disposed.</exception>
+        /// <exception cref="ArgumentNullException"><paramref name="source"/> is null.</exception>
+        /// <exception cref="CryptographicException">A batch could not be encrypted.</exception>
+        /// <exception cref="IOException">The stream could not be read, or the pack written.</exception>
+        public byte[] Store(Stream source)
+        {
+            ObjectDisposedException.ThrowIf(_disposed, this);
+            ArgumentNullException.ThrowIfNull(source);
+
+            var recipe = new ArrayBufferWriter<byte>();
+            var pending = new List<PendingChunk>();
+            byte[] buffer = ArrayPool<byte>.Shared.Rent(BatchBytes + _maxChunkSize);
+            try
+            {
+                int filled = 0;
+                bool end = false;
+                while (true)
+                {
+                    while (!end && filled < buffer.Length)
+                    {
+                        int read = source.Read(buffer, filled, buffer.Length - filled);
+                        if (read == 0)
+                            end = true;
+                        filled += read;
+                    }
+
+                    // Short of the largest chunk, only the end of the stream may
+                    // cut, or a boundary past the buffer would be missed
+                    int position = 0;
+                    while (position < filled && (end || filled - position >= _maxChunkSize))
+                    {
+                        ReadOnlySpan<byte> chunk = buffer.AsSpan(position, FindBoundary(buffer.AsSpan(position, filled - position)));
+                        Span<byte> id = recipe.GetSpan(ChunkIdSize).Slice(0, ChunkIdSize);
+                        HMACSHA256.HashData(_chunkIdKey, chunk, id);
+                        recipe.Advance(ChunkIdSize);
+                        var key = new ChunkKey(id);
+                        if (_index.ContainsKey(key))
+                        {
+                            DuplicateBytes += chunk.Length;
+                        }
+                        else
+                        {
+                            // Indexed now, so a repeat later in the batch is skipped too
+                            _index.Add(key, new ChunkLocation(0, chunk.Length));
+                            pending.Add(new PendingChunk(key, position, chunk.Length));
+                        }
+                        position += chunk.Length;
+                    }
+
+                    Commit(buffer, pending);
+                    pending.Clear();
+                    if (end)
+                        break;
+                    buffer.AsSpan(position, filled - position).CopyTo(buffer);
+                    filled -= position;
+                }
+            }
+            catch
+            {
+                foreach (PendingChunk chunk in pending)
+                    _index.Remove(chunk.Key);
+                throw;
+            }
+            finally
+            {
+                ArrayPool<byte>.Shared.Return(buffer);
+            }
+
+            _file.Flush(_flushToDisk);
+            return recipe.WrittenSpan.ToArray();
+        }
+
+        /// <summary>
+        /// Writes the stream a recipe from <see cref="Store"/> describes to <paramref name="destination"/>.
+        /// </summary>
+        /// <param name="recipe">The recipe, <see cref="ChunkIdSize"/> bytes per chunk.</param>
+        /// <param name="destination">The stream to write to.</param>
+        /// <exception cref="ObjectDisposedException">The store has been disposed.</exception>
+        /// <exception cref="ArgumentNullException"><paramref name="destination"/> is null.</exception>
+        /// <exception cref="ArgumentException"><paramref name="recipe"/> is not a whole number of ids.</exception>
+        /// <exception cref="CryptographicException">
+        /// The recipe names a chunk the store does not hold, or a chunk fails to authenticate.
+        /// </exception>
+        /// <exception cref="IOException">The pack could not be read, or the stream written.</exception>
+        public void Restore(ReadOnlySpan<byte> recipe, Stream destination)
+        {
+            ObjectDisposedException.ThrowIf(_disposed, this);
+            ArgumentNullException.ThrowIfNull(destination);
+            if (recipe.Length % ChunkIdSize != 0)
+                throw new ArgumentException($"A recipe is a whole number of {ChunkIdSize}-byte ids.", nameof(recipe));
+
+            byte[] record = ArrayPool<byte>.Shared.Rent(RecordOverhead + _maxChunkSize);
+            byte[] plaintext = ArrayPool<byte>.Shared.Rent(_maxChunkSize);
+            try
+            {
+                for (int i = 0; i < recipe.Length; i += ChunkIdSize)
+                {
+                    ReadOnlySpan<byte> id = recipe.Slice(i, ChunkIdSize);
+                    if (!_index.TryGetValue(new ChunkKey(id), out ChunkLocation location))
+                        throw new CryptographicException("The recipe names a chunk the store does not hold.");
+                    if (record.Length < RecordOverhead + location.Length)
+                    {
+                        // Written with a larger average chunk size
+                        ArrayPool<byte>.Shared.Return(record);
+                        ArrayPool<byte>.Shared.Return(plaintext);
+                        record = ArrayPool<byte>.Shared.Rent(RecordOverhead + location.Length);
+                        plaintext = ArrayPool<byte>.Shared.Rent(location.Length);
+                    }
+
+                    Span<byte> span = record.AsSpan(0, RecordOverhead + location.Length);
+                    if (AesGcmSivRecordLog.ReadExactly(_file.SafeFileHandle, span, location.Offset) < span.Length)
+                        throw new CryptographicException("A chunk record runs past the end of the pack.");
+                    Span<byte> output = plaintext.AsSpan(0, location.Length);
+                    _aesGcmSiv.Decrypt(
+                        id.Slice(0, NonceSize),
+                        span.Slice(ChunkIdSize + LengthSize, location.Length),
+                        span.Slice(ChunkIdSize + LengthSize + location.Length, TagSize),
+                        output,
+                        id);
+                    destination.Write(output);
+                }
+            }
+            finally
+            {
+                CryptographicOperations.ZeroMemory(plaintext);
+                ArrayPool<byte>.Shared.Return(record);
+                ArrayPool<byte>.Shared.Return(plaintext);
+            }
+        }
+
+        /// <summary>
+        /// Closes the pack file.
+        /// </summary>
+        public void Dispose()
+        {
+            if (!_disposed)
+            {
+                _disposed = true;
+                _batch.Dispose();
+                _file.Dispose();
+                CryptographicOperations.ZeroMemory(_chunkIdKey);
+            }
+        }
+
+        // The length of the chunk starting data, which ends the stream or
+        // holds at least the largest chunk
+        private int FindBoundary(ReadOnlySpan<byte> data)
+        {
+            if (data.Length <= _minChunkSize)
+                return data.Length;
+            int end = Math.Min(data.Length, _maxChunkSize);
+            int normal = Math.Min(end, _averageChunkSize);
+            ulong hash = 0;
+            int i = _minChunkSize;
+            for (; i < normal; i++)
+            {
+                hash = (hash << 1) + s_gear[data[i]];
+                if ((hash & _strictMask) == 0)
+                    return i + 1;
+            }
+            for (; i < end; i++)
+            {
+                hash = (hash << 1) + s_gear[data[i]];
+                if ((hash & _looseMask) == 0)
+                    return i + 1;
+            }
+            return end;
+        }
+
+        // Encrypts the new chunks of a batch into their records and appends
+        // them with one write
+        private void Commit(byte[] buffer, List<PendingChunk> pending)
+        {
+            if (pending.Count == 0)
+                return;
+
+            long total = 0;
+            foreach (PendingChunk chunk in pending)
+                total += RecordOverhead + chunk.Length;
+            if (_records.Length < total)
+                _records = new byte[Math.Max(total, _records.Length * 2L)];
+
+            int offset = 0;
+            try
+            {
+                foreach (PendingChunk chunk in pending)
+                {
+                    Memory<byte> record = _records.AsMemory(offset, RecordOverhead + chunk.Length);
+                    chunk.Key.CopyTo(record.Span);
+                    BinaryPrimitives.WriteInt32LittleEndian(record.Span.Slice(ChunkIdSize), chunk.Length);
+                    _batch.Add(
+                        record.Slice(0, NonceSize),
+                        buffer.AsMemory(chunk.Position, chunk.Length),
+                        record.Slice(ChunkIdSize + LengthSize, chunk.Length),
+                        record.Slice(ChunkIdSize + LengthSize + chunk.Length, TagSize),
+                        record.Slice(0, ChunkIdSize));
+                    offset += record.Length;
+                }
+                _batch.Encrypt();
+            }
+            finally
+            {
+                _batch.Clear();
+            }
+
+            RandomAccess.Write(_file.SafeFileHandle, _records.AsSpan(0, offset), _length);
+            foreach (PendingChunk chunk in pending)
+            {
+                _index[chunk.Key] = new ChunkLocation(_length, chunk.Length);
+                _length += RecordOverhead + chunk.Length;
+                StoredBytes += chunk.Length;
+            }
+        }
+
+        // Checks the header and indexes every whole record after it,
+        // returning where the last one ends
+        private long ScanRecords(SafeFileHandle file, long fileLength)
+        {
+            Span<byte> header = stackalloc byte[ChunkIdSize + LengthSize];
+            if (AesGcmSivRecordLog.ReadExactly(file, header.Slice(0, HeaderSize), 0) < HeaderSize)
+                throw new CryptographicException("The file is too short to hold a pack header.");
+            if (!header.Slice(0, 4).SequenceEqual("AGSC"u8) || header[4] != FormatVersion)
+                throw new CryptographicException("The pack header is not valid.");
+
+            long offset = HeaderSize;
+            while (fileLength - offset >= header.Length &&
+                AesGcmSivRecordLog.ReadExactly(file, header, offset) == header.Length)
+            {
+                int length = BinaryPrimitives.ReadInt32LittleEndian(header.Slice(ChunkIdSize));
+                // No chunk is empty; a crash can leave the file extended over
+                // zeros the write never reached
+                if (length == 0)
+                    break;
+                if (length < 0)
+                    throw new CryptographicException("A chunk record header is not valid.");
+                if (fileLength - offset < RecordOverhead + (long)length)
+                    break;
+                _index.TryAdd(new ChunkKey(header.Slice(0, ChunkIdSize)), new ChunkLocation(offset, length));
+                offset += RecordOverhead + length;
+            }
+            return offset;
+        }
+
+        // SplitMix64 from a fixed seed
+        private static ulong[] CreateGear()
+        {
+            var gear = new ulong[256];
+            ulong state = 0x4147_5343_4643_4443;  // "AGSCFCDC"
+            for (int i = 0; i < gear.Length; i++)
+            {
+                ulong z = state += 0x9e37_79b9_7f4a_7c15;
+                z = (z ^ (z >> 30)) * 0xbf58_476d_1ce4_e5b9;
+                z = (z ^ (z >> 27)) * 0x94d0_49bb_1331_11eb;
+                gear[i] = z ^ (z >> 31);
+            }
+            return gear;
+        }
+
+        private readonly record struct ChunkLocation(long Offset, int Length);
+
+        private readonly record struct PendingChunk(ChunkKey Key, int Position, int Length);
+
+        // A chunk id as a dictionary key
+        private readonly record struct ChunkKey(ulong A, ulong B, ulong C, ulong D)
+        {
+            public ChunkKey(ReadOnlySpan<byte> id)
+                : this(
+                    BinaryPrimitives.ReadUInt64LittleEndian(id),
+                    BinaryPrimitives.ReadUInt64LittleEndian(id.Slice(8)),
+                    BinaryPrimitives.ReadUInt64LittleEndian(id.Slice(16)),
+                    BinaryPrimitives.ReadUInt64LittleEndian(id.Slice(24)))
+            {
+            }
+
+            public void CopyTo(Span<byte> destination)
+            {
+                BinaryPrimitives.WriteUInt64LittleEndian(destination, A);
+                BinaryPrimitives.WriteUInt64LittleEndian(destination.Slice(8), B);
+                BinaryPrimitives.WriteUInt64LittleEndian(destination.Slice(16), C);
+                BinaryPrimitives.WriteUInt64LittleEndian(destination.Slice(24), D);
+            }
+        }
+    }
+}
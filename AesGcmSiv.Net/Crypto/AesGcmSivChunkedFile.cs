@@ -0,0 +1,341 @@
+using System.Buffers.Binary;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// An encrypted file in fixed-size chunks that can be changed in place: a write re-encrypts only
+    /// the chunks that overlap it, and the header.
+    /// </summary>
+    /// <remarks>
+    /// An <see cref="AesGcmSivStream"/> seals every chunk under a nonce fixed by its position, so an
+    /// edit to one byte of a large object means encrypting the whole object again. This file keeps a
+    /// version number in front of each chunk and XORs it into the chunk's nonce. A write reads and
+    /// verifies each chunk it touches, overlays the new bytes and seals the chunk again at the next
+    /// version, so no nonce is ever used for two different contents of a chunk. Small edits therefore
+    /// cost a few chunks of writing wherever they fall in the file. Writes may also extend the file;
+    /// the chunk that was last is then rewritten as well, since the last chunk is marked in its nonce.
+    ///
+    /// The file holds a <see cref="HeaderSize"/>-byte header with the chunk size, a random nonce prefix
+    /// and a count of the writes applied, then each chunk as its version (4 bytes, little-endian),
+    /// ciphertext and tag. Chunk <c>i</c> at version <c>v</c> is sealed under the nonce of chunk
+    /// <c>i</c> of an <see cref="AesGcmSivStream"/> with the first 4 bytes of the prefix XORed with
+    /// <c>v</c>. A chunk that was altered, moved or dropped, or a file that was truncated, fails to
+    /// authenticate. Versions keep nonces fresh; they do not stop a chunk being replaced by an earlier
+    /// sealed copy of itself. A write is not atomic: a crash part-way through can leave a chunk that
+    /// fails to authenticate.
+    ///
+    /// Reads and writes may be issued from several threads; they run one at a time.
+    /// </remarks>
+    public sealed class AesGcmSivChunkedFile : IDisposable
+    {
+        /// <summary>The size of the file header, in bytes.</summary>
+        public const int HeaderSize = 20;
+
+        private const int TagSize = 16;
+        private const int NonceSize = 12;
+        private const int VersionSize = 4;
+        private const byte FormatVersion = 3;
+
+        private readonly FileStream _file;
+        private readonly AesGcmSiv _aesGcmSiv;
+        private readonly byte[]? _associatedData;
+        private readonly bool _flushToDisk;
+        private readonly byte[] _prefix = new byte[AesGcmSivStream.PrefixSize];
+        private readonly byte[] _plaintext;
+        private readonly byte[] _record;
+        private readonly object _gate = new();
+        private long _chunkCount;  // guarded by _gate, like everything below
+        private long _length;
+        private long _generation;
+        private bool _disposed;
+
+        /// <summary>
+        /// Opens the chunked file at <paramref name="path"/>, creating an empty one if it does not exist.
+        /// </summary>
+        /// <param name="path">The file.</param>
+        /// <param name="aesGcmSiv">The key to encrypt with. Must stay undisposed until the file is disposed.</param>
+        /// <param name="associatedData">The additional authenticated data every chunk is sealed with, if any.</param>
+        /// <param name="chunkSize">The plaintext bytes per chunk of a new file. An existing file keeps its own.</param>
+        /// <param name="flushToDisk">Whether each write waits for its chunks and the header to reach the disk.</param>
+        /// <exception cref="ArgumentNullException"><paramref name="path"/> or <paramref name="aesGcmSiv"/> is null.</exception>
+        /// <exception cref="ArgumentOutOfRangeException">
+        /// <paramref name="chunkSize"/> is not positive or is above <see cref="AesGcmSivStream.MaxChunkSize"/>.
+        /// </exception>
+        /// <exception cref="CryptographicException">
+        /// The file exists but does not hold a valid header, or its length is not that of a whole file.
+        /// </exception>
+        /// <exception cref="IOException">The file could not be opened or read.</exception>
+        public AesGcmSivChunkedFile(
+            string path,
+            AesGcmSiv aesGcmSiv,
+            byte[]? associatedData = null,
+            int chunkSize = AesGcmSivStream.DefaultChunkSize,
+            bool flushToDisk = true)
+        {
+            ArgumentNullException.ThrowIfNull(path);
+            ArgumentNullException.ThrowIfNull(aesGcmSiv);
+            ArgumentOutOfRangeException.ThrowIfNegativeOrZero(chunkSize);
+            ArgumentOutOfRangeException.ThrowIfGreaterThan(chunkSize, AesGcmSivStream.MaxChunkSize);
+
+            _aesGcmSiv = aesGcmSiv;
+            _associatedData = associatedData;
+            _flushToDisk = flushToDisk;
+            _file = new FileStream(path, FileMode.OpenOrCreate, FileAccess.ReadWrite, FileShare.Read, bufferSize: 0);
+            try
+            {
+                if (_file.Length == 0)
+                {
+                    // An empty file is one empty last chunk, as for a stream
+                    ChunkSize = chunkSize;
+                    RandomNumberGenerator.Fill(_prefix);
+                    _chunkCount = 1;
+                    _plaintext = new byte[ChunkSize];
+                    _record = new byte[VersionSize + ChunkSize + TagSize];
+                    WriteChunk(0, 0, last: true, 0);
+                    WriteHeader();
+                    _file.Flush(flushToDisk);
+                }
+                else
+                {
+                    ReadHeader();
+                    _plaintext = new byte[ChunkSize];
+                    _record = new byte[VersionSize + ChunkSize + TagSize];
+                }
+            }
+            catch
+            {
+                _file.Dispose();
+                throw;
+            }
+        }
+
+        /// <summary>Gets the length of the plaintext, in bytes.</summary>
+        public long Length
+        {
+            get
+            {
+                lock (_gate)
+                {
+                    return _length;
+                }
+            }
+        }
+
+        /// <summary>Gets the plaintext bytes per chunk, from the header.</summary>
+        public int ChunkSize { get; private set; }
+
+        /// <summary>Gets the number of writes applied to the file since it was created.</summary>
+        public long Generation
+        {
+            get
+            {
+                lock (_gate)
+                {
+                    return _generation;
+                }
+            }
+        }
+
+        /// <summary>
+        /// Reads plaintext starting at <paramref name="offset"/>.
+        /// </summary>
+        /// <param name="offset">The plaintext offset to read from.</param>
+        /// <param name="destination">Receives the plaintext.</param>
+        /// <returns>
+        /// The number of bytes read: the length of <paramref name="destination"/>, or less at the end of the
+        /// plaintext, where it is 0.
+        /// </returns>
+        /// <exception cref="ArgumentOutOfRangeException"><paramref name="offset"/> is negative.</exception>
+        /// <exception cref="ObjectDisposedException">The file has been disposed.</exception>
+        /// <exception cref="CryptographicException">A chunk in the range failed to authenticate.</exception>
+        public int Read(long offset, Span<byte> destination)
+        {
+            ArgumentOutOfRangeException.ThrowIfNegative(offset);
+            lock (_gate)
+            {
+                ObjectDisposedException.ThrowIf(_disposed, this);
+                int length = (int)Math.Clamp(_length - offset, 0, destination.Length);
+                for (int copied = 0; copied < length;)
+                {
+                    long position = offset + copied;
+                    long index = position / ChunkSize;
+                    int chunkLength = ChunkLength(index);
+                    OpenChunk(index, chunkLength);
+                    int start = (int)(position - index * ChunkSize);
+                    int count = Math.Min(chunkLength - start, length - copied);
+                    _plaintext.AsSpan(start, count).CopyTo(destination.Slice(copied));
+                    copied += count;
+                }
+                return length;
+            }
+        }
+
+        /// <summary>
+        /// Writes <paramref name="data"/> at <paramref name="offset"/>, re-encrypting only the chunks it
+        /// overlaps, and the last chunk if the write extends the file.
+        /// </summary>
+        /// <param name="offset">The plaintext offset to write at. May be at most <see cref="Length"/>.</param>
+        /// <param name="data">The bytes to write.</param>
+        /// <returns>The number of chunks rewritten.</returns>
+        /// <exception cref="ArgumentOutOfRangeException">
+        /// <paramref name="offset"/> is negative or past the end of the file.
+        /// </exception>
+        /// <exception cref="ObjectDisposedException">The file has been disposed.</exception>
+        /// <exception cref="CryptographicException">
+        /// A chunk to be rewritten failed to authenticate, has been rewritten too many times, or the file
+        /// would grow past the chunk count a nonce can number.
+        /// </exception>
+        /// <exception cref="IOException">The chunks or the header could not be written.</exception>
+        public int Write(long offset, ReadOnlySpan<byte> data)
+        {
+            ArgumentOutOfRangeException.ThrowIfNegative(offset);
+            lock (_gate)
+            {
+                ObjectDisposedException.ThrowIf(_disposed, this);
+                ArgumentOutOfRangeException.ThrowIfGreaterThan(offset, _length);
+                if (data.IsEmpty)
+                    return 0;
+
+                long end = offset + data.Length;
+                long length = Math.Max(_length, end);
+                long chunkCount = (length + ChunkSize - 1) / ChunkSize;
+                if (chunkCount - 1 > uint.MaxValue)
+                    throw new CryptographicException("The file would have too many chunks.");
+                long first = offset / ChunkSize;
+                long last = (end - 1) / ChunkSize;
+                if (chunkCount > _chunkCount)
+                {
+                    // The old last chunk loses its flag
+                    first = Math.Min(first, _chunkCount - 1);
+                    last = chunkCount - 1;
+                }
+
+                for (long index = first; index <= last; index++)
+                {
+                    uint version = 0;
+                    if (index < _chunkCount)
+                    {
+                        version = OpenChunk(index, ChunkLength(index));
+                        if (version == uint.MaxValue)
+                            throw new CryptographicException("A chunk has been rewritten too many times.");
+                        version++;
+                    }
+
+                    long chunkStart = index * ChunkSize;
+                    int chunkLength = (int)Math.Min(ChunkSize, length - chunkStart);
+                    long from = Math.Max(offset, chunkStart);
+                    long to = Math.Min(end, chunkStart + chunkLength);
+                    data.Slice((int)(from - offset), (int)(to - from)).CopyTo(_plaintext.AsSpan((int)(from - chunkStart)));
+                    WriteChunk(index, version, index == chunkCount - 1, chunkLength);
+                }
+
+                _chunkCount = chunkCount;
+                _length = length;
+                _generation++;
+                WriteHeader();
+                _file.Flush(_flushToDisk);
+                return (int)(last - first + 1);
+            }
+        }
+
+        /// <summary>Closes the file, waiting for any read or write in progress.</summary>
+        public void Dispose()
+        {
+            lock (_gate)
+            {
+                if (_disposed)
+                    return;
+                _disposed = true;
+                CryptographicOperations.ZeroMemory(_plaintext);
+            }
+            _file.Dispose();
+        }
+
+        // Reads and checks the header, and works out the chunk count and
+        // length from the file's length
+        private void ReadHeader()
+        {
+            Span<byte> header = stackalloc byte[HeaderSize];
+            if (AesGcmSivRecordLog.ReadExactly(_file.SafeFileHandle, header, 0) < HeaderSize)
+                throw new CryptographicException("The file is too short to hold a header.");
+            int chunkSize = BinaryPrimitives.ReadInt32LittleEndian(header.Slice(1));
+            long generation = BinaryPrimitives.ReadInt64LittleEndian(header.Slice(12));
+            if (header[0] != FormatVersion || chunkSize <= 0 || chunkSize > AesGcmSivStream.MaxChunkSize || generation < 0)
+                throw new CryptographicException("The file header is not valid.");
+            ChunkSize = chunkSize;
+            header.Slice(5, AesGcmSivStream.PrefixSize).CopyTo(_prefix);
+            _generation = generation;
+
+            // Every chunk but the last is full; the last holds at least a version and a tag
+            long sealedLength = _file.Length - HeaderSize;
+            long full = VersionSize + ChunkSize + TagSize;
+            _chunkCount = (sealedLength + full - 1) / full;
+            long lastSealedLength = sealedLength - (_chunkCount - 1) * full;
+            if (_chunkCount == 0 || lastSealedLength < VersionSize + TagSize || _chunkCount - 1 > uint.MaxValue)
+                throw new CryptographicException("The file has been truncated.");
+            _length = sealedLength - _chunkCount * (VersionSize + TagSize);
+        }
+
+        private void WriteHeader()
+        {
+            Span<byte> header = stackalloc byte[HeaderSize];
+            header[0] = FormatVersion;
+            BinaryPrimitives.WriteInt32LittleEndian(header.Slice(1), ChunkSize);
+            _prefix.CopyTo(header.Slice(5));
+            BinaryPrimitives.WriteInt64LittleEndian(header.Slice(12), _generation);
+            RandomAccess.Write(_file.SafeFileHandle, header, 0);
+        }
+
+        // The plaintext length of chunk index as the file stands
+        private int ChunkLength(long index)
+        {
+            return (int)Math.Min(ChunkSize, _length - index * ChunkSize);
+        }
+
+        // Reads and verifies chunk index, of length plaintext bytes, into
+        // _plaintext, returning its version
+        private uint OpenChunk(long index, int length)
+        {
+            Span<byte> record = _record.AsSpan(0, VersionSize + length + TagSize);
+            if (AesGcmSivRecordLog.ReadExactly(_file.SafeFileHandle, record, ChunkPosition(index)) < record.Length)
+                throw new CryptographicException("The file has been truncated.");
+
+            uint version = BinaryPrimitives.ReadUInt32LittleEndian(record);
+            Span<byte> nonce = stackalloc byte[NonceSize];
+            ChunkNonce(index, version, index == _chunkCount - 1, nonce);
+            if (!_aesGcmSiv.TryDecrypt(
+                    nonce, record.Slice(VersionSize, length), record.Slice(VersionSize + length),
+                    _plaintext.AsSpan(0, length), _associatedData))
+                throw new CryptographicException("A chunk failed to authenticate.");
+            return version;
+        }
+
+        // Seals the first length bytes of _plaintext as chunk index at
+        // version and writes the record in place
+        private void WriteChunk(long index, uint version, bool last, int length)
+        {
+            Span<byte> record = _record.AsSpan(0, VersionSize + length + TagSize);
+            BinaryPrimitives.WriteUInt32LittleEndian(record, version);
+            Span<byte> nonce = stackalloc byte[NonceSize];
+            ChunkNonce(index, version, last, nonce);
+            _aesGcmSiv.Encrypt(
+                nonce, _plaintext.AsSpan(0, length), record.Slice(VersionSize, length),
+                record.Slice(VersionSize + length), _associatedData);
+            RandomAccess.Write(_file.SafeFileHandle, record, ChunkPosition(index));
+        }
+
+        private long ChunkPosition(long index)
+        {
+            return HeaderSize + index * (VersionSize + ChunkSize + TagSize);
+        }
+
+        // The stream nonce of chunk index, with version XORed into the
+        // front of the prefix
+        private void ChunkNonce(long index, uint version, bool last, Span<byte> nonce)
+        {
+            AesGcmSivStream.ChunkNonce(_prefix, (ulong)index, last, nonce);
+            uint mixed = BinaryPrimitives.ReadUInt32BigEndian(nonce) ^ version;
+            BinaryPrimitives.WriteUInt32BigEndian(nonce, mixed);
+        }
+    }
+}
@@ -0,0 +1,296 @@
+using System.Collections.Concurrent;
+using System.Diagnostics;
+using System.Runtime.InteropServices;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Gathers <see cref="SealAsync"/> and <see cref="OpenAsync"/> calls made at the same time from
+    /// different threads into batches, each run with one native batch call, so that code written one
+    /// message at a time gets batch throughput without being restructured.
+    /// </summary>
+    /// <remarks>
+    /// The first call into an empty batch leads it. If other calls are in flight, the leader spins for
+    /// up to the linger time while they join. It then runs the batch on its own thread and completes
+    /// every call in it. A call that fills a batch to its maximum size runs the batch at once. A call
+    /// made while no other is in flight runs at once, so an uncontended caller pays no delay. Callers
+    /// resume asynchronously, never on the thread that ran their batch.
+    ///
+    /// Seal and open calls are batched separately. A sealed message is laid out as
+    /// nonce || ciphertext || tag, <see cref="AesGcmSiv.SealOverhead"/> bytes longer than the plaintext,
+    /// under a random nonce, as <see cref="AesGcmSiv.SealWithRandomNonce"/> writes it; one call to the
+    /// random generator covers the nonces of a whole batch. Buffers passed in must not be modified until
+    /// the returned task completes. The <see cref="AesGcmSiv"/> is not owned by the coalescer and must
+    /// stay undisposed while it is in use.
+    /// </remarks>
+    public sealed class AesGcmSivCoalescer : IDisposable
+    {
+        private const int NonceSize = 12;
+        private const int TagSize = 16;
+
+        // Largest batch the nonces of which are drawn on the stack
+        private const int StackNonceItems = 64;
+
+        private static readonly TimeSpan DefaultLingerTime = TimeSpan.FromMicroseconds(20);
+        private static readonly TimeSpan MaxLingerTime = TimeSpan.FromMilliseconds(1);
+
+        private readonly AesGcmSiv _aesGcmSiv;
+        private readonly long _lingerTicks;  // Stopwatch ticks
+        private readonly int _maxBatchSize;
+        private readonly CallQueue _seals = new(decrypt: false);
+        private readonly CallQueue _opens = new(decrypt: true);
+        private readonly ConcurrentBag<AesGcmSivBatch> _batches = new();
+        private int _disposed;
+
+        /// <summary>
+        /// Initializes a coalescer for calls under <paramref name="aesGcmSiv"/>.
+        /// </summary>
+        /// <param name="aesGcmSiv">The key the calls run under.</param>
+        /// <param name="lingerTime">
+        /// Longest a batch waits for more calls while others are in flight, at most 1 millisecond; null
+        /// for 20 microseconds, and <see cref="TimeSpan.Zero"/> to batch only the calls that are already
+        /// waiting.
+        /// </param>
+        /// <param name="maxBatchSize">Most calls in one batch, from 1 to 1024.</param>
+        /// <exception cref="ArgumentNullException"><paramref name="aesGcmSiv"/> is null.</exception>
+        /// <exception cref="ArgumentOutOfRangeException">
+        /// <paramref name="lingerTime"/> or <paramref name="maxBatchSize"/> is out of range.
+        /// </exception>
+        public AesGcmSivCoalescer(AesGcmSiv aesGcmSiv, TimeSpan? lingerTime = null, int maxBatchSize = 64)
+        {
+            ArgumentNullException.ThrowIfNull(aesGcmSiv);
+            TimeSpan linger = lingerTime ?? DefaultLingerTime;
+            if (linger < TimeSpan.Zero || linger > MaxLingerTime)
+                throw new ArgumentOutOfRangeException(nameof(lingerTime));
+            ArgumentOutOfRangeException.ThrowIfNegativeOrZero(maxBatchSize);
+            ArgumentOutOfRangeException.ThrowIfGreaterThan(maxBatchSize, 1024);
+
+            _aesGcmSiv = aesGcmSiv;
+            _lingerTicks = (long)(linger.TotalSeconds * Stopwatch.Frequency);
+            _maxBatchSize = maxBatchSize;
+        }
+
+        /// <summary>
+        /// Encrypts <paramref name="plaintext"/> under a random nonce, in a batch with whatever other
+        /// calls are made meanwhile.
+        /// </summary>
+        /// <param name="plaintext">The data to encrypt.</param>
+        /// <param name="associatedData">Optional additional authenticated data.</param>
+        /// <returns>The sealed message, nonce || ciphertext || tag.</returns>
+        /// <exception cref="ObjectDisposedException">The coalescer has been disposed.</exception>
+        /// <exception cref="ArgumentException"><paramref name="plaintext"/> is too long to seal into one array.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public ValueTask<byte[]> SealAsync(ReadOnlyMemory<byte> plaintext, ReadOnlyMemory<byte> associatedData = default)
+        {
+            ThrowIfDisposed();
+            if (plaintext.Length > Array.MaxLength - AesGcmSiv.SealOverhead)
+                throw new ArgumentException("Plaintext is too long to seal.", nameof(plaintext));
+
+            var call = new Call(plaintext, associatedData, new byte[plaintext.Length + AesGcmSiv.SealOverhead]);
+            Enter(_seals, call);
+            return new ValueTask<byte[]>(call.Completion.Task);
+        }
+
+        /// <summary>
+        /// Verifies and decrypts a message sealed by <see cref="SealAsync"/> or
+        /// <see cref="AesGcmSiv.Seal(byte[], byte[], byte[], byte[])"/>, in a batch with whatever other
+        /// calls are made meanwhile.
+        /// </summary>
+        /// <param name="sealedData">The sealed message. Must be at least <see cref="AesGcmSiv.SealOverhead"/> bytes.</param>
+        /// <param name="associatedData">Optional additional authenticated data (must match the data used when sealing).</param>
+        /// <returns>The plaintext.</returns>
+        /// <exception cref="ObjectDisposedException">The coalescer has been disposed.</exception>
+        /// <exception cref="ArgumentException"><paramref name="sealedData"/> is too short.</exception>
+        /// <exception cref="CryptographicException">The message failed to authenticate, or decryption failed.</exception>
+        public ValueTask<byte[]> OpenAsync(ReadOnlyMemory<byte> sealedData, ReadOnlyMemory<byte> associatedData = default)
+        {
+            ThrowIfDisposed();
+            if (sealedData.Length < AesGcmSiv.SealOverhead)
+                throw new ArgumentException($"Sealed data must be at least {AesGcmSiv.SealOverhead} bytes.", nameof(sealedData));
+
+            var call = new Call(sealedData, associatedData, new byte[sealedData.Length - AesGcmSiv.SealOverhead]);
+            Enter(_opens, call);
+            return new ValueTask<byte[]>(call.Completion.Task);
+        }
+
+        /// <summary>
+        /// Stops accepting calls. Calls already made still complete.
+        /// </summary>
+        public void Dispose()
+        {
+            if (Interlocked.Exchange(ref _disposed, 1) != 0)
+                return;
+            while (_batches.TryTake(out AesGcmSivBatch? batch))
+                batch.Dispose();
+        }
+
+        // Adds call to queue's open batch, and runs the batch on this thread
+        // if this call fills it or leads it
+        private void Enter(CallQueue queue, Call call)
+        {
+            List<Call>? batch = null;
+            long generation;
+            bool leader;
+            lock (queue.Lock)
+            {
+                queue.Pending.Add(call);
+                generation = queue.Generation;
+                leader = queue.Pending.Count == 1;
+                if (queue.Pending.Count >= _maxBatchSize)
+                    batch = queue.Take();
+            }
+            if (batch == null && leader)
+            {
+                // Others are in flight when a batch is running or the last one
+                // held more than one call; otherwise waiting would only add latency
+                if (_lingerTicks > 0 &&
+                    (Volatile.Read(ref queue.Running) > 0 || Volatile.Read(ref queue.LastBatchSize) > 1))
+                    Linger(queue, generation);
+                lock (queue.Lock)
+                {
+                    if (queue.Generation == generation)
+                        batch = queue.Take();
+                }
+            }
+            if (batch != null)
+                Run(queue, batch);
+        }
+
+        // Spins until the linger time has passed or a call filling the batch
+        // has taken it. Spinning never sleeps: the wait is far below a timer tick.
+        private void Linger(CallQueue queue, long generation)
+        {
+            long deadline = Stopwatch.GetTimestamp() + _lingerTicks;
+            var spinner = new SpinWait();
+            while (Volatile.Read(ref queue.Generation) == generation && Stopwatch.GetTimestamp() < deadline)
+                spinner.SpinOnce(sleep1Threshold: -1);
+        }
+
+        private void Run(CallQueue queue, List<Call> calls)
+        {
+            Interlocked.Increment(ref queue.Running);
+            AesGcmSivBatch? batch = null;
+            try
+            {
+                if (!_batches.TryTake(out batch))
+                    batch = new AesGcmSivBatch(_aesGcmSiv, _maxBatchSize);
+                if (queue.Decrypt)
+                    OpenBatch(batch, calls);
+                else
+                    SealBatch(batch, calls);
+            }
+            catch (Exception e)
+            {
+                foreach (Call call in calls)
+                    call.Completion.TrySetException(e);
+            }
+            finally
+            {
+                if (batch != null)
+                {
+                    batch.Clear();
+                    if (Volatile.Read(ref _disposed) == 0)
+                        _batches.Add(batch);
+                    else
+                        batch.Dispose();
+                }
+                Volatile.Write(ref queue.LastBatchSize, calls.Count);
+                Interlocked.Decrement(ref queue.Running);
+            }
+        }
+
+        private static void SealBatch(AesGcmSivBatch batch, List<Call> calls)
+        {
+            int count = calls.Count;
+            Span<byte> nonces = count <= StackNonceItems ? stackalloc byte[count * NonceSize] : new byte[count * NonceSize];
+            RandomNumberGenerator.Fill(nonces);
+            for (int i = 0; i < count; i++)
+            {
+                Call call = calls[i];
+                int length = call.Input.Length;
+                nonces.Slice(i * NonceSize, NonceSize).CopyTo(call.Output);
+                batch.Add(
+                    call.Output.AsMemory(0, NonceSize),
+                    call.Input,
+                    call.Output.AsMemory(NonceSize, length),
+                    call.Output.AsMemory(NonceSize + length, TagSize),
+                    call.AssociatedData);
+            }
+            batch.Encrypt();
+            foreach (Call call in calls)
+                call.Completion.TrySetResult(call.Output);
+        }
+
+        private static void OpenBatch(AesGcmSivBatch batch, List<Call> calls)
+        {
+            int count = calls.Count;
+            foreach (Call call in calls)
+            {
+                int length = call.Output.Length;
+                ReadOnlyMemory<byte> sealedData = call.Input;
+                batch.Add(
+                    sealedData.Slice(0, NonceSize),
+                    sealedData.Slice(NonceSize, length),
+                    call.Output,
+                    // A batch takes the tag as writable memory; decrypting only reads it
+                    MemoryMarshal.AsMemory(sealedData.Slice(NonceSize + length, TagSize)),
+                    call.AssociatedData);
+            }
+            Span<bool> succeeded = stackalloc bool[count];
+            batch.Decrypt(succeeded);
+            for (int i = 0; i < count; i++)
+            {
+                if (succeeded[i])
+                    calls[i].Completion.TrySetResult(calls[i].Output);
+                else
+                    calls[i].Completion.TrySetException(new CryptographicException("The message failed to authenticate."));
+            }
+        }
+
+        private void ThrowIfDisposed()
+        {
+            ObjectDisposedException.ThrowIf(Volatile.Read(ref _disposed) != 0, this);
+        }
+
+        private sealed class Call
+        {
+            public Call(ReadOnlyMemory<byte> input, ReadOnlyMemory<byte> associatedData, byte[] output)
+            {
+                Input = input;
+                AssociatedData = associatedData;
+                Output = output;
+            }
+
+            public ReadOnlyMemory<byte> Input { get; }
+            public ReadOnlyMemory<byte> AssociatedData { get; }
+            public byte[] Output { get; }
+            public TaskCompletionSource<byte[]> Completion { get; } = new(TaskCreationOptions.RunContinuationsAsynchronously);
+        }
+
+        // The open batch of one direction. Generation counts the batches
+        // taken, so a leader can tell whether a filling call took its batch.
+        private sealed class CallQueue
+        {
+            public readonly object Lock = new();
+            public readonly bool Decrypt;
+            public List<Call> Pending = new();
+            public long Generation;
+            public int Running;
+            public int LastBatchSize = 1;
+
+            public CallQueue(bool decrypt)
+            {
+                Decrypt = decrypt;
+            }
+
+            // Called under Lock
+            public List<Call> Take()
+            {
+                List<Call> taken = Pending;
+                Pending = new List<Call>();
+                Volatile.Write(ref Generation, Generation + 1);
+                return taken;
+            }
+        }
+    }
+}
@@ -0,0 +1,24 @@
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Selects how <see cref="AesGcmSivStream"/> compresses each chunk before sealing it, for
+    /// <see cref="AesGcmSivStream.Compression"/>.
+    /// </summary>
+    /// <remarks>
+    /// Compression runs in the native library, in the same call that seals the chunk, so it needs an
+    /// <see cref="AesGcmSiv"/> instance with a native context and a library built with the chosen
+    /// compressor; see <see cref="AesGcmSiv.IsCompressionSupported"/>. A compressed stream can be read
+    /// by any build, as long as it has the compressors its chunks used.
+    /// </remarks>
+    public enum AesGcmSivCompression
+    {
+        /// <summary>No compression: the stream is written in the plain chunked format.</summary>
+        None = 0,
+
+        /// <summary>Zstandard, for the best ratio on text such as JSON.</summary>
+        Zstd = 1,
+
+        /// <summary>LZ4, for the least CPU time per byte.</summary>
+        Lz4 = 2,
+    }
+}
@@ -0,0 +1,45 @@
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// CPU features detected by the native AES-GCM-SIV library.
+    /// </summary>
+    /// <remarks>
+    /// Values match the <c>AESGCMSIV_CPU_*</c> bits in <c>aesgcmsiv.h</c>.
+    /// </remarks>
+    [Flags]
+    public enum AesGcmSivCpuFeatures : uint
+    {
+        /// <summary>No relevant features were detected.</summary>
+        None = 0,
+
+        /// <summary>x86 AES-NI instructions.</summary>
+        AesNi = 1u << 0,
+
+        /// <summary>x86 carry-less multiplication.</summary>
+        Pclmulqdq = 1u << 1,
+
+        /// <summary>x86 SSE4.1.</summary>
+        Sse41 = 1u << 2,
+
+        /// <summary>x86 AVX2, with OS support for the register state.</summary>
+        Avx2 = 1u << 3,
+
+        /// <summary>x86 AVX-512 F, BW and VL, with OS support for the register state.</summary>
+        Avx512 = 1u << 4,
+
+        /// <summary>x86 vector AES instructions.</summary>
+        Vaes = 1u << 5,
+
+        /// <summary>x86 vector carry-less multiplication.</summary>
+        Vpclmulqdq = 1u << 6,
+
+        /// <summary>x86 SHA extensions, used for key derivation.</summary>
+        Sha = 1u << 7,
+
+        /// <summary>ARMv8 AES instructions.</summary>
+        ArmAes = 1u << 8,
+
+        /// <summary>ARMv8 64-bit polynomial multiplication.</summary>
+        ArmPmull = 1u << 9,
+    }
+}
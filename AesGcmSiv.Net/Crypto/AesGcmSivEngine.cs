@@ -0,0 +1,315 @@
+using System.Runtime.InteropServices;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Collects encrypt and decrypt calls from any number of threads onto a pool of native worker
+    /// threads, which drain them in batches and run the short messages of each key together through
+    /// the multi-buffer kernels.
+    /// </summary>
+    /// <remarks>
+    /// Meant for services where many threads each handle a few small records: every call is one
+    /// lock-free submission, and the batching that <see cref="AesGcmSiv.EncryptBatch(ReadOnlySpan{AesGcmSivBatchItem})"/> would need the
+    /// caller to arrange happens across callers instead. Calls may name different
+    /// <see cref="AesGcmSiv"/> instances; each instance must stay undisposed until its calls complete.
+    /// The buffers must not be modified until the returned task completes.
+    ///
+    /// Calls are queued in one of two lanes (see <see cref="AesGcmSivEngineLane"/>), so that short
+    /// calls from request handlers are not held up by bulk work sharing the engine. Unless a call names
+    /// its lane, messages of up to 16 KiB go to the latency lane and longer ones to the bulk lane.
+    /// <see cref="GetStatistics(AesGcmSivEngineLane)"/> reports each lane's queue depth and wait times.
+    ///
+    /// Dispose the engine to stop its threads. Calls already submitted still complete.
+    /// </remarks>
+    public sealed unsafe class AesGcmSivEngine : IDisposable
+    {
+        private const int AESGCMSIV_SUCCESS = 0;
+        private const int AESGCMSIV_ERROR_INVALID_INPUT = -3;
+
+        // AESGCMSIV_ENGINE_MAX_LINGER_NS
+        private static readonly TimeSpan MaxLingerTime = TimeSpan.FromMilliseconds(1);
+
+        // Completions taken per native reap call
+        private const int ReapBatchSize = 256;
+
+        private readonly SafeAesGcmSivEngineHandle _engine;
+        private readonly Thread _reaper;
+        private int _disposed;
+
+        /// <summary>
+        /// Initializes a new engine and starts its threads.
+        /// </summary>
+        /// <param name="workerCount">Number of native worker threads, or 0 for one per hardware thread.</param>
+        /// <param name="queueDepth">
+        /// Most calls in flight at once. A call submitted while the queue is full blocks its thread
+        /// until earlier calls complete.
+        /// </param>
+        /// <exception cref="ArgumentOutOfRangeException">
+        /// <paramref name="workerCount"/> is negative or <paramref name="queueDepth"/> is not positive.
+        /// </exception>
+        /// <exception cref="CryptographicException">The engine could not be started.</exception>
+        public AesGcmSivEngine(int workerCount = 0, int queueDepth = 4096)
+        {
+            ArgumentOutOfRangeException.ThrowIfNegative(workerCount);
+            ArgumentOutOfRangeException.ThrowIfNegativeOrZero(queueDepth);
+
+            int result = SafeAesGcmSivEngineHandle.Create(workerCount, queueDepth, out _engine);
+            // The reaper runs on its own thread, so a full queue can block submitters
+            if (result == AESGCMSIV_SUCCESS)
+                result = AesGcmSivNative.EngineSetBlocking(_engine.DangerousGetHandle(), 1);
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                _engine.Dispose();
+                throw new CryptographicException($"Engine setup failed with error code: {result}");
+            }
+
+            _reaper = new Thread(Reap) { IsBackground = true, Name = "AesGcmSiv engine completions" };
+            _reaper.Start();
+        }
+
+        /// <summary>
+        /// Encrypts plaintext under <paramref name="key"/> on the engine's workers.
+        /// </summary>
+        /// <param name="key">The instance holding the key.</param>
+        /// <param name="nonce">The nonce. Must be exactly 12 bytes (96 bits).</param>
+        /// <param name="plaintext">The plaintext to encrypt.</param>
+        /// <param name="ciphertext">
+        /// The output buffer for the ciphertext. Must be at least as large as the plaintext. May be the
+        /// same memory as <paramref name="plaintext"/>, but must not otherwise overlap it.
+        /// </param>
+        /// <param name="tag">The output buffer for the authentication tag. Must be at least 16 bytes.</param>
+        /// <param name="associatedData">Optional additional authenticated data.</param>
+        /// <param name="lane">The lane to queue the call in, or null to choose by the message's length.</param>
+        /// <exception cref="ArgumentNullException"><paramref name="key"/> is null.</exception>
+        /// <exception cref="ObjectDisposedException">The engine or <paramref name="key"/> has been disposed.</exception>
+        /// <exception cref="ArgumentException">Parameter sizes are invalid, or the buffers partially overlap.</exception>
+        /// <exception cref="ArgumentOutOfRangeException"><paramref name="lane"/> is not a defined lane.</exception>
+        /// <exception cref="NotSupportedException"><paramref name="key"/> runs only managed code (see <see cref="AesGcmSivImplementation.Managed"/>).</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public ValueTask EncryptAsync(
+            AesGcmSiv key,
+            ReadOnlyMemory<byte> nonce,
+            ReadOnlyMemory<byte> plaintext,
+            Memory<byte> ciphertext,
+            Memory<byte> tag,
+            ReadOnlyMemory<byte> associatedData = default,
+            AesGcmSivEngineLane? lane = null)
+        {
+            ArgumentNullException.ThrowIfNull(key);
+            ThrowIfLaneUndefined(lane);
+            ThrowIfDisposed();
+            return Submit(key.CreateEncryptJob(nonce, plaintext, ciphertext, tag, associatedData), "Encryption", lane);
+        }
+
+        /// <summary>
+        /// Decrypts ciphertext under <paramref name="key"/> on the engine's workers.
+        /// </summary>
+        /// <param name="key">The instance holding the key.</param>
+        /// <param name="nonce">The nonce used during encryption. Must be exactly 12 bytes (96 bits).</param>
+        /// <param name="ciphertext">The ciphertext to decrypt.</param>
+        /// <param name="tag">The authentication tag. Must be exactly 16 bytes.</param>
+        /// <param name="plaintext">
+        /// The output buffer for the plaintext. Must be at least as large as the ciphertext, and is zeroed
+        /// if the tag does not verify. May be the same memory as <paramref name="ciphertext"/>, but must
+        /// not otherwise overlap it.
+        /// </param>
+        /// <param name="associatedData">Optional additional authenticated data (must match the data used during encryption).</param>
+        /// <param name="lane">The lane to queue the call in, or null to choose by the message's length.</param>
+        /// <exception cref="ArgumentNullException"><paramref name="key"/> is null.</exception>
+        /// <exception cref="ObjectDisposedException">The engine or <paramref name="key"/> has been disposed.</exception>
+        /// <exception cref="ArgumentException">Parameter sizes are invalid, or the buffers partially overlap.</exception>
+        /// <exception cref="ArgumentOutOfRangeException"><paramref name="lane"/> is not a defined lane.</exception>
+        /// <exception cref="NotSupportedException"><paramref name="key"/> runs only managed code (see <see cref="AesGcmSivImplementation.Managed"/>).</exception>
+        /// <exception cref="CryptographicException">Decryption failed or authentication tag is invalid.</exception>
+        public ValueTask DecryptAsync(
+            AesGcmSiv key,
+            ReadOnlyMemory<byte> nonce,
+            ReadOnlyMemory<byte> ciphertext,
+            ReadOnlyMemory<byte> tag,
+            Memory<byte> plaintext,
+            ReadOnlyMemory<byte> associatedData = default,
+            AesGcmSivEngineLane? lane = null)
+        {
+            ArgumentNullException.ThrowIfNull(key);
+            ThrowIfLaneUndefined(lane);
+            ThrowIfDisposed();
+            return Submit(key.CreateDecryptJob(nonce, ciphertext, tag, plaintext, associatedData), "Decryption", lane);
+        }
+
+        /// <summary>
+        /// Lets the native workers wait briefly for a fuller batch of latency-lane calls once calls
+        /// arrive faster than they run, so that short messages fill the multi-buffer kernels.
+        /// </summary>
+        /// <remarks>
+        /// A worker lingers only while it keeps finding more than one call waiting when it comes back
+        /// for work; under light load every call is dispatched as soon as a worker is free. Lingering
+        /// is off until this is called. Around 20 microseconds suits small messages from many threads.
+        /// </remarks>
+        /// <param name="lingerTime">
+        /// Longest a worker holds a batch open, at most 1 millisecond; <see cref="TimeSpan.Zero"/> turns
+        /// lingering off.
+        /// </param>
+        /// <param name="batchTarget">
+        /// Calls a worker waits for, at most 64, or 0 for the width of the multi-buffer kernels.
+        /// </param>
+        /// <exception cref="ArgumentOutOfRangeException">
+        /// <paramref name="lingerTime"/> or <paramref name="batchTarget"/> is out of range.
+        /// </exception>
+        /// <exception cref="ObjectDisposedException">The engine has been disposed.</exception>
+        public void ConfigureLinger(TimeSpan lingerTime, int batchTarget = 0)
+        {
+            if (lingerTime < TimeSpan.Zero || lingerTime > MaxLingerTime)
+                throw new ArgumentOutOfRangeException(nameof(lingerTime));
+            ArgumentOutOfRangeException.ThrowIfNegative(batchTarget);
+            ArgumentOutOfRangeException.ThrowIfGreaterThan(batchTarget, 64);
+            ThrowIfDisposed();
+
+            bool added = false;
+            try
+            {
+                _engine.DangerousAddRef(ref added);
+                AesGcmSivNative.EngineSetLinger(_engine.DangerousGetHandle(), (ulong)lingerTime.Ticks * 100, (nuint)batchTarget);
+            }
+            finally
+            {
+                if (added)
+                    _engine.DangerousRelease();
+            }
+        }
+
+        /// <summary>
+        /// Reads the counters of one lane.
+        /// </summary>
+        /// <param name="lane">The lane.</param>
+        /// <returns>The lane's submissions, queue depth and wait times since the engine was created.</returns>
+        /// <exception cref="ArgumentOutOfRangeException"><paramref name="lane"/> is not a defined lane.</exception>
+        /// <exception cref="ObjectDisposedException">The engine has been disposed.</exception>
+        public AesGcmSivEngineLaneStatistics GetStatistics(AesGcmSivEngineLane lane)
+        {
+            ThrowIfLaneUndefined(lane);
+            NativeEngineStats stats = ReadStatistics();
+            return new AesGcmSivEngineLaneStatistics(lane == AesGcmSivEngineLane.Latency ? stats.Latency : stats.Bulk);
+        }
+
+        /// <summary>
+        /// Gets the number of times a worker paused bulk work to run calls waiting in the latency lane.
+        /// </summary>
+        /// <exception cref="ObjectDisposedException">The engine has been disposed.</exception>
+        public long Preemptions => (long)ReadStatistics().Preemptions;
+
+        /// <summary>
+        /// Stops accepting calls, waits for those already submitted, and stops the engine's threads.
+        /// </summary>
+        public void Dispose()
+        {
+            if (Interlocked.Exchange(ref _disposed, 1) != 0)
+                return;
+
+            // The reaper returns once the shut-down engine has nothing left
+            // outstanding; only then is it safe to free
+            bool added = false;
+            _engine.DangerousAddRef(ref added);
+            try
+            {
+                AesGcmSivNative.EngineShutdown(_engine.DangerousGetHandle());
+            }
+            finally
+            {
+                _engine.DangerousRelease();
+            }
+            _reaper.Join();
+            _engine.Dispose();
+        }
+
+        private NativeEngineStats ReadStatistics()
+        {
+            ThrowIfDisposed();
+            NativeEngineStats stats;
+            bool added = false;
+            try
+            {
+                _engine.DangerousAddRef(ref added);
+                AesGcmSivNative.EngineGetStats(_engine.DangerousGetHandle(), &stats);
+            }
+            finally
+            {
+                if (added)
+                    _engine.DangerousRelease();
+            }
+            return stats;
+        }
+
+        private ValueTask Submit(AesGcmSivJob job, string operation, AesGcmSivEngineLane? lane)
+        {
+            // The native request carries the job back through its completion
+            GCHandle handle = GCHandle.Alloc(job);
+            NativeRequest request = job.ToRequest((ulong)(nint)GCHandle.ToIntPtr(handle));
+            int result;
+            bool added = false;
+            try
+            {
+                _engine.DangerousAddRef(ref added);
+                // Blocks while the queue is full; Dispose releases it with an error
+                IntPtr engine = _engine.DangerousGetHandle();
+                result = lane is AesGcmSivEngineLane chosen
+                    ? AesGcmSivNative.EngineSubmitLane(engine, &request, (uint)chosen)
+                    : AesGcmSivNative.EngineSubmit(engine, &request);
+            }
+            catch
+            {
+                handle.Free();
+                job.Complete(AESGCMSIV_ERROR_INVALID_INPUT);
+                throw;
+            }
+            finally
+            {
+                if (added)
+                    _engine.DangerousRelease();
+            }
+
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                // Rejected, so no completion will come for it
+                handle.Free();
+                job.Complete(result);
+                ThrowIfDisposed();
+            }
+            return AesGcmSivJob.CompleteAsync(job.Completion, operation);
+        }
+
+        private void Reap()
+        {
+            IntPtr engine = _engine.DangerousGetHandle();
+            var completions = new NativeCompletion[ReapBatchSize];
+            fixed (NativeCompletion* completionsPtr = completions)
+            {
+                while (true)
+                {
+                    nuint count = 0;
+                    AesGcmSivNative.EngineReap(engine, completionsPtr, ReapBatchSize, 1, &count);
+                    if (count == 0)
+                        return;
+
+                    for (int i = 0; i < (int)count; i++)
+                    {
+                        GCHandle handle = GCHandle.FromIntPtr((IntPtr)(nint)completions[i].UserData);
+                        var job = (AesGcmSivJob)handle.Target!;
+                        handle.Free();
+                        job.Complete(completions[i].Status);
+                    }
+                }
+            }
+        }
+
+        private static void ThrowIfLaneUndefined(AesGcmSivEngineLane? lane)
+        {
+            if (lane is AesGcmSivEngineLane value && value != AesGcmSivEngineLane.Latency && value != AesGcmSivEngineLane.Bulk)
+                throw new ArgumentOutOfRangeException(nameof(lane));
+        }
+
+        private void ThrowIfDisposed()
+        {
+            ObjectDisposedException.ThrowIf(Volatile.Read(ref _disposed) != 0, this);
+        }
+    }
+}
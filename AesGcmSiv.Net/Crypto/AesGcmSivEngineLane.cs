@@ -0,0 +1,25 @@
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// The priority class a call on an <see cref="AesGcmSivEngine"/> is queued in.
+    /// </summary>
+    /// <remarks>
+    /// The engine's workers take latency calls first and run bulk calls only while no latency call
+    /// is waiting. A bulk message longer than 256 KiB is worked through 256 KiB at a time, and
+    /// latency calls that arrive meanwhile run between those slices, so a short call waits behind at
+    /// most one slice of bulk work rather than a whole multi-megabyte message. The priority is strict:
+    /// bulk calls wait for as long as latency calls keep arriving.
+    /// </remarks>
+    public enum AesGcmSivEngineLane
+    {
+        /// <summary>
+        /// Short, interactive calls, such as those of a request handler.
+        /// </summary>
+        Latency = 0,
+
+        /// <summary>
+        /// Throughput work that can wait, such as a job re-encrypting stored data.
+        /// </summary>
+        Bulk = 1,
+    }
+}
@@ -0,0 +1,47 @@
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Counters of one lane of an <see cref="AesGcmSivEngine"/>, kept since the engine was created.
+    /// </summary>
+    /// <remarks>
+    /// The wait of a call is the time from its submission until a native worker takes it, so it shows
+    /// queueing rather than the time spent encrypting. Each counter is read on its own while the
+    /// workers run, so they may be a few calls apart from one another.
+    /// </remarks>
+    public readonly struct AesGcmSivEngineLaneStatistics
+    {
+        internal AesGcmSivEngineLaneStatistics(in NativeEngineLaneStats stats)
+        {
+            Submitted = (long)stats.Submitted;
+            Started = (long)stats.Started;
+            QueueDepth = (long)stats.Depth;
+            MaxQueueDepth = (long)stats.MaxDepth;
+            TotalWait = FromNanoseconds(stats.WaitNs);
+            MaxWait = FromNanoseconds(stats.MaxWaitNs);
+        }
+
+        /// <summary>Gets the number of calls queued on the lane.</summary>
+        public long Submitted { get; }
+
+        /// <summary>Gets the number of calls a worker has taken off the lane.</summary>
+        public long Started { get; }
+
+        /// <summary>Gets the number of calls waiting for a worker now.</summary>
+        public long QueueDepth { get; }
+
+        /// <summary>Gets the most calls ever waiting for a worker at once.</summary>
+        public long MaxQueueDepth { get; }
+
+        /// <summary>Gets the total time the started calls waited for a worker.</summary>
+        public TimeSpan TotalWait { get; }
+
+        /// <summary>Gets the longest time any call waited for a worker.</summary>
+        public TimeSpan MaxWait { get; }
+
+        /// <summary>Gets the mean time a started call waited for a worker.</summary>
+        public TimeSpan MeanWait => Started == 0 ? TimeSpan.Zero : TotalWait / Started;
+
+        private static TimeSpan FromNanoseconds(ulong nanoseconds) =>
+            TimeSpan.FromTicks((long)(nanoseconds / 100));
+    }
+}
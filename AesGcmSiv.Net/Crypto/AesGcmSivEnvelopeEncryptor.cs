@@ -0,0 +1,492 @@
+using System.Buffers.Binary;
+using System.Diagnostics.CodeAnalysis;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Envelope encryption: each message is encrypted under a data key (DEK) that travels with it,
+    /// wrapped by a key management service (KMS), with the unwrapped keys cached so the KMS is not
+    /// called per message.
+    /// </summary>
+    /// <remarks>
+    /// An envelope is laid out as version (1 byte) || wrapped-DEK length (2 bytes, big-endian) ||
+    /// wrapped DEK || nonce || ciphertext || tag. The wrapped DEK is whatever the wrap callback returns,
+    /// and is handed back unchanged to the unwrap callback.
+    ///
+    /// <see cref="Encrypt"/> draws a DEK, has the KMS wrap it, and reuses it for up to
+    /// <see cref="MessagesPerKey"/> messages or <see cref="KeyLifetime"/>, whichever ends first, so
+    /// one KMS call is spread over many messages. Every message gets a random nonce, which AES-GCM-SIV
+    /// tolerates far better than AES-GCM should two ever repeat.
+    ///
+    /// <see cref="Decrypt"/> finds the DEK by the wrapped DEK it carries. Unwrapped DEKs are kept
+    /// expanded in a cache of up to <see cref="CacheCapacity"/> keys. Each is held for
+    /// <see cref="KeyLifetime"/> from when it was unwrapped, and the least recently used is evicted
+    /// first. A key in use by another thread is only disposed once that thread is done with it.
+    ///
+    /// The callbacks may be called from any thread, and never while a lock is held. One instance can
+    /// be shared across threads. <see cref="Dispose"/> clears every cached key.
+    /// </remarks>
+    public sealed class AesGcmSivEnvelopeEncryptor : IDisposable
+    {
+        /// <summary>
+        /// The longest wrapped DEK an envelope can carry.
+        /// </summary>
+        public const int MaxWrappedKeyLength = ushort.MaxValue;
+
+        private const byte FormatVersion = 1;
+        private const int HeaderSize = 3;
+        private const int NonceSize = 12;
+        private const int TagSize = 16;
+
+        private readonly Func<byte[], byte[]> _wrapKey;
+        private readonly Func<byte[], byte[]> _unwrapKey;
+        private readonly int _keySize;
+
+        // Guards everything below; the KMS is called outside it
+        private readonly object _lock = new();
+        // Serializes drawing a new DEK, so threads that find the current one
+        // used up make one KMS call between them
+        private readonly object _rotateLock = new();
+        private readonly Dictionary<UInt128, DekEntry> _entries = new();
+        private readonly LinkedList<DekEntry> _lru = new();  // most recently used first
+        private DekEntry? _current;
+        private long _messagesPerKey = 1_000_000;
+        private TimeSpan _keyLifetime = TimeSpan.FromMinutes(5);
+        private int _cacheCapacity = 1024;
+        private bool _disposed;
+
+        /// <summary>
+        /// Initializes an encryptor over a KMS.
+        /// </summary>
+        /// <param name="wrapKey">
+        /// Wraps a new DEK with the KMS and returns the wrapped form, at most
+        /// <see cref="MaxWrappedKeyLength"/> bytes. Called once per DEK.
+        /// </param>
+        /// <param name="unwrapKey">
+        /// Unwraps a wrapped DEK with the KMS and returns the DEK. Called when <see cref="Decrypt"/> meets
+        /// a wrapped DEK that is not cached.
+        /// </param>
+        /// <param name="keySize">The size of the DEKs drawn: 16 (AES-128-GCM-SIV) or 32 (AES-256-GCM-SIV).</param>
+        /// <exception cref="ArgumentNullException"><paramref name="wrapKey"/> or <paramref name="unwrapKey"/> is null.</exception>
+        /// <exception cref="ArgumentException"><paramref name="keySize"/> is not 16 or 32.</exception>
+        public AesGcmSivEnvelopeEncryptor(Func<byte[], byte[]> wrapKey, Func<byte[], byte[]> unwrapKey, int keySize = 32)
+        {
+            ArgumentNullException.ThrowIfNull(wrapKey);
+            ArgumentNullException.ThrowIfNull(unwrapKey);
+            if (keySize != 16 && keySize != 32)
+                throw new ArgumentException("Key size must be 16 bytes (128 bits) or 32 bytes (256 bits).", nameof(keySize));
+
+            _wrapKey = wrapKey;
+            _unwrapKey = unwrapKey;
+            _keySize = keySize;
+        }
+
+        /// <summary>
+        /// Gets or sets the most messages <see cref="Encrypt"/> seals under one DEK. The default is
+        /// 1,000,000; 1 draws a DEK, and calls the KMS, per message.
+        /// </summary>
+        /// <exception cref="ArgumentOutOfRangeException">The value is not positive.</exception>
+        public long MessagesPerKey
+        {
+            get => Interlocked.Read(ref _messagesPerKey);
+            set
+            {
+                ArgumentOutOfRangeException.ThrowIfNegativeOrZero(value);
+                Interlocked.Exchange(ref _messagesPerKey, value);
+            }
+        }
+
+        /// <summary>
+        /// Gets or sets how long a DEK is used for encryption after it is drawn, and how long an
+        /// unwrapped DEK stays cached. The default is 5 minutes. Changes apply to keys drawn or unwrapped
+        /// afterwards.
+        /// </summary>
+        /// <exception cref="ArgumentOutOfRangeException">The value is negative.</exception>
+        public TimeSpan KeyLifetime
+        {
+            get { lock (_lock) return _keyLifetime; }
+            set
+            {
+                ArgumentOutOfRangeException.ThrowIfLessThan(value, TimeSpan.Zero);
+                lock (_lock) _keyLifetime = value;
+            }
+        }
+
+        /// <summary>
+        /// Gets or sets the most unwrapped DEKs kept. The default is 1024; 0 caches nothing, so every
+        /// <see cref="Decrypt"/> calls the KMS. Lowering it evicts the least recently used keys at once.
+        /// </summary>
+        /// <exception cref="ArgumentOutOfRangeException">The value is negative.</exception>
+        public int CacheCapacity
+        {
+            get { lock (_lock) return _cacheCapacity; }
+            set
+            {
+                ArgumentOutOfRangeException.ThrowIfNegative(value);
+                lock (_lock)
+                {
+                    _cacheCapacity = value;
+                    Trim(value);
+                }
+            }
+        }
+
+        /// <summary>
+        /// Gets the number of unwrapped DEKs cached.
+        /// </summary>
+        public int CachedKeyCount
+        {
+            get { lock (_lock) return _entries.Count; }
+        }
+
+        /// <summary>
+        /// Returns the size of the envelope <see cref="Encrypt"/> makes for a plaintext.
+        /// </summary>
+        /// <param name="plaintextLength">The plaintext length.</param>
+        /// <param name="wrappedKeyLength">The length of the wrapped DEKs the KMS returns.</param>
+        public static int GetEnvelopeLength(int plaintextLength, int wrappedKeyLength) =>
+            HeaderSize + wrappedKeyLength + plaintextLength + AesGcmSiv.SealOverhead;
+
+        /// <summary>
+        /// Encrypts a message under the current DEK, drawing and wrapping a new one first if it is used
+        /// up or expired.
+        /// </summary>
+        /// <param name="plaintext">The message.</param>
+        /// <param name="associatedData">Optional additional authenticated data.</param>
+        /// <returns>The envelope.</returns>
+        /// <exception cref="ObjectDisposedException">The encryptor has been disposed.</exception>
+        /// <exception cref="CryptographicException">
+        /// The wrap callback returned no bytes or more than <see cref="MaxWrappedKeyLength"/>, or
+        /// encryption failed. Exceptions from the callback itself propagate unchanged.
+        /// </exception>
+        public byte[] Encrypt(ReadOnlySpan<byte> plaintext, ReadOnlySpan<byte> associatedData = default)
+        {
+            DekEntry entry = AcquireCurrent();
+            try
+            {
+                byte[] wrapped = entry.WrappedKey;
+                byte[] envelope = new byte[GetEnvelopeLength(plaintext.Length, wrapped.Length)];
+                envelope[0] = FormatVersion;
+                BinaryPrimitives.WriteUInt16BigEndian(envelope.AsSpan(1), (ushort)wrapped.Length);
+                wrapped.CopyTo(envelope, HeaderSize);
+                entry.Cipher.SealWithRandomNonce(plaintext, envelope.AsSpan(HeaderSize + wrapped.Length), associatedData);
+                return envelope;
+            }
+            finally
+            {
+                Release(entry);
+            }
+        }
+
+        /// <summary>
+        /// Verifies and decrypts an envelope, unwrapping its DEK with the KMS unless it is cached.
+        /// </summary>
+        /// <param name="envelope">The envelope.</param>
+        /// <param name="associatedData">Optional additional authenticated data (must match the data used during encryption).</param>
+        /// <returns>The plaintext.</returns>
+        /// <exception cref="ObjectDisposedException">The encryptor has been disposed.</exception>
+        /// <exception cref="CryptographicException">
+        /// The envelope is malformed, the unwrap callback returned a key that is not 16 or 32 bytes, or
+        /// the message does not authenticate. Exceptions from the callback itself propagate unchanged.
+        /// </exception>
+        public byte[] Decrypt(ReadOnlySpan<byte> envelope, ReadOnlySpan<byte> associatedData = default)
+        {
+            if (envelope.Length < HeaderSize || envelope[0] != FormatVersion)
+                throw new CryptographicException("The envelope is malformed or of an unknown version.");
+            int wrappedLength = BinaryPrimitives.ReadUInt16BigEndian(envelope.Slice(1));
+            if (wrappedLength == 0 || envelope.Length - HeaderSize - wrappedLength < AesGcmSiv.SealOverhead)
+                throw new CryptographicException("The envelope is malformed or of an unknown version.");
+
+            ReadOnlySpan<byte> wrapped = envelope.Slice(HeaderSize, wrappedLength);
+            ReadOnlySpan<byte> sealedData = envelope.Slice(HeaderSize + wrappedLength);
+            UInt128 id = KeyId(wrapped);
+            DekEntry entry = Acquire(id, wrapped) ?? Unwrap(id, wrapped);
+            try
+            {
+                byte[] plaintext = new byte[sealedData.Length - AesGcmSiv.SealOverhead];
+                entry.Cipher.Decrypt(
+                    sealedData.Slice(0, NonceSize),
+                    sealedData.Slice(NonceSize, plaintext.Length),
+                    sealedData.Slice(NonceSize + plaintext.Length, TagSize),
+                    plaintext,
+                    associatedData);
+                return plaintext;
+            }
+            finally
+            {
+                Release(entry);
+            }
+        }
+
+        /// <summary>
+        /// Retires the current DEK, so the next <see cref="Encrypt"/> draws a new one. Envelopes already
+        /// made under it still decrypt.
+        /// </summary>
+        public void RotateKey()
+        {
+            lock (_lock)
+            {
+                SetCurrent(null);
+            }
+        }
+
+        /// <summary>
+        /// Evicts every unwrapped DEK and retires the current one, for example after a KMS key has been
+        /// revoked. Calls in progress finish under the keys they hold.
+        /// </summary>
+        public void ClearCache()
+        {
+            lock (_lock)
+            {
+                SetCurrent(null);
+                Trim(0);
+            }
+        }
+
+        /// <summary>
+        /// Clears every cached DEK.
+        /// </summary>
+        public void Dispose()
+        {
+            lock (_lock)
+            {
+                if (_disposed)
+                    return;
+                _disposed = true;
+                SetCurrent(null);
+                Trim(0);
+            }
+        }
+
+        // The cache key: the first 128 bits of the wrapped DEK's SHA-256. A
+        // hit is confirmed against the wrapped DEK itself.
+        private static UInt128 KeyId(ReadOnlySpan<byte> wrapped)
+        {
+            Span<byte> hash = stackalloc byte[32];
+            SHA256.HashData(wrapped, hash);
+            return BinaryPrimitives.ReadUInt128LittleEndian(hash);
+        }
+
+        // When a key drawn or unwrapped now expires, clamped so that a very long
+        // lifetime cannot overflow into the past
+        private long Deadline()
+        {
+            long now = Environment.TickCount64;
+            double lifetime = _keyLifetime.TotalMilliseconds;
+            return lifetime >= long.MaxValue - now ? long.MaxValue : now + (long)lifetime;
+        }
+
+        private DekEntry AcquireCurrent()
+        {
+            lock (_lock)
+            {
+                if (TryTakeCurrent(out DekEntry? entry))
+                    return entry;
+            }
+
+            lock (_rotateLock)
+            {
+                lock (_lock)
+                {
+                    // Another thread may have drawn one while this one waited
+                    if (TryTakeCurrent(out DekEntry? entry))
+                        return entry;
+                }
+
+                byte[] key = RandomNumberGenerator.GetBytes(_keySize);
+                try
+                {
+                    byte[] wrapped = _wrapKey((byte[])key.Clone());
+                    if (wrapped == null || wrapped.Length == 0 || wrapped.Length > MaxWrappedKeyLength)
+                        throw new CryptographicException($"The wrapped key must be between 1 and {MaxWrappedKeyLength} bytes.");
+                    wrapped = (byte[])wrapped.Clone();
+                    var entry = new DekEntry(KeyId(wrapped), wrapped, new AesGcmSiv(key));
+
+                    lock (_lock)
+                    {
+                        if (_disposed)
+                        {
+                            entry.Cipher.Dispose();
+                            throw new ObjectDisposedException(nameof(AesGcmSivEnvelopeEncryptor));
+                        }
+                        entry.Expires = Deadline();
+                        entry.MessagesLeft = Interlocked.Read(ref _messagesPerKey) - 1;
+                        entry.Leases = 1;
+                        SetCurrent(entry);
+                        Insert(entry);
+                        return entry;
+                    }
+                }
+                finally
+                {
+                    CryptographicOperations.ZeroMemory(key);
+                }
+            }
+        }
+
+        // Takes a lease on the current DEK and one of its messages, if it has
+        // any left and has not expired
+        private bool TryTakeCurrent([NotNullWhen(true)] out DekEntry? entry)
+        {
+            ObjectDisposedException.ThrowIf(_disposed, this);
+            entry = _current;
+            if (entry == null || entry.MessagesLeft <= 0 || Environment.TickCount64 >= entry.Expires)
+                return false;
+            entry.MessagesLeft--;
+            entry.Leases++;
+            return true;
+        }
+
+        // Takes a lease on a cached DEK, or returns null on a miss
+        private DekEntry? Acquire(UInt128 id, ReadOnlySpan<byte> wrapped)
+        {
+            lock (_lock)
+            {
+                ObjectDisposedException.ThrowIf(_disposed, this);
+                if (!_entries.TryGetValue(id, out DekEntry? entry) ||
+                    !CryptographicOperations.FixedTimeEquals(entry.WrappedKey, wrapped))
+                    return null;
+                if (Environment.TickCount64 >= entry.Expires)
+                {
+                    Evict(entry);
+                    return null;
+                }
+                _lru.Remove(entry.Node!);
+                _lru.AddFirst(entry.Node!);
+                entry.Leases++;
+                return entry;
+            }
+        }
+
+        private DekEntry Unwrap(UInt128 id, ReadOnlySpan<byte> wrapped)
+        {
+            byte[] wrappedCopy = wrapped.ToArray();
+            byte[] key = _unwrapKey((byte[])wrappedCopy.Clone());
+            DekEntry entry;
+            try
+            {
+                if (key == null || (key.Length != 16 && key.Length != 32))
+                    throw new CryptographicException("The unwrapped key must be 16 or 32 bytes.");
+                entry = new DekEntry(id, wrappedCopy, new AesGcmSiv(key));
+            }
+            finally
+            {
+                if (key != null)
+                    CryptographicOperations.ZeroMemory(key);
+            }
+
+            lock (_lock)
+            {
+                if (_disposed)
+                {
+                    entry.Cipher.Dispose();
+                    throw new ObjectDisposedException(nameof(AesGcmSivEnvelopeEncryptor));
+                }
+                if (_entries.TryGetValue(id, out DekEntry? cached) &&
+                    CryptographicOperations.FixedTimeEquals(cached.WrappedKey, wrappedCopy))
+                {
+                    // Another thread unwrapped the same key meanwhile
+                    entry.Cipher.Dispose();
+                    cached.Leases++;
+                    return cached;
+                }
+                entry.Expires = Deadline();
+                entry.Leases = 1;
+                Insert(entry);
+                return entry;
+            }
+        }
+
+        private void Release(DekEntry entry)
+        {
+            lock (_lock)
+            {
+                entry.Leases--;
+                if (entry.Retired && entry.Leases == 0)
+                    entry.Cipher.Dispose();
+            }
+        }
+
+        // Caches an entry as the most recently used. With no capacity it is
+        // not cached at all, and goes once its leases are released and it is
+        // not the current DEK.
+        private void Insert(DekEntry entry)
+        {
+            if (_cacheCapacity == 0)
+            {
+                if (entry != _current)
+                    Retire(entry);
+                return;
+            }
+            if (_entries.Remove(entry.Id, out DekEntry? previous))
+            {
+                // A different wrapped DEK with the same 128-bit hash, or an expired copy
+                _lru.Remove(previous.Node!);
+                previous.Node = null;
+                if (previous != _current)
+                    Retire(previous);
+            }
+            _entries.Add(entry.Id, entry);
+            entry.Node = _lru.AddFirst(entry);
+            Trim(_cacheCapacity);
+        }
+
+        private void Evict(DekEntry entry)
+        {
+            _entries.Remove(entry.Id);
+            _lru.Remove(entry.Node!);
+            entry.Node = null;
+            // The current DEK stays in use for encryption until replaced
+            if (entry != _current)
+                Retire(entry);
+        }
+
+        private void Trim(int capacity)
+        {
+            while (_entries.Count > capacity)
+            {
+                Evict(_lru.Last!.Value);
+            }
+        }
+
+        private void SetCurrent(DekEntry? entry)
+        {
+            DekEntry? previous = _current;
+            _current = entry;
+            if (previous != null && previous.Node == null)
+                Retire(previous);
+        }
+
+        // Marks an entry as out of the cache for good, disposing it now or when
+        // its last lease is released
+        private static void Retire(DekEntry entry)
+        {
+            if (entry.Retired)
+                return;
+            entry.Retired = true;
+            if (entry.Leases == 0)
+                entry.Cipher.Dispose();
+        }
+
+        // A DEK, expanded. Every field but the readonly ones is guarded by the
+        // encryptor's lock.
+        private sealed class DekEntry
+        {
+            internal readonly UInt128 Id;
+            internal readonly byte[] WrappedKey;
+            internal readonly AesGcmSiv Cipher;
+            internal long Expires;  // Environment.TickCount64
+            internal long MessagesLeft;  // for the current DEK only
+            internal int Leases;  // calls using Cipher
+            internal bool Retired;
+            internal LinkedListNode<DekEntry>? Node;  // null when not cached
+
+            internal DekEntry(UInt128 id, byte[] wrappedKey, AesGcmSiv cipher)
+            {
+                Id = id;
+                WrappedKey = wrappedKey;
+                Cipher = cipher;
+            }
+        }
+    }
+}
@@ -0,0 +1,148 @@
+using Microsoft.Win32.SafeHandles;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Encrypts files through <see cref="RandomAccess"/> in the chunked format of
+    /// <see cref="AesGcmSivStream"/>, with several chunks in flight at once.
+    /// </summary>
+    /// <remarks>
+    /// Every chunk has a fixed place in both files, so chunks need not be handled in order. A number of
+    /// workers each claim the next chunk number, read that chunk with
+    /// <see cref="RandomAccess.ReadAsync(SafeFileHandle, Memory{byte}, long, CancellationToken)"/> into a
+    /// buffer of their own, seal it there in place with one native call and write it with
+    /// <see cref="RandomAccess.WriteAsync(SafeFileHandle, ReadOnlyMemory{byte}, long, CancellationToken)"/>
+    /// at its offset in the output. The buffers come from one <see cref="AesGcmSivBufferPool"/> on the
+    /// pinned object heap, so no copy goes through a <see cref="FileStream"/> buffer and nothing is
+    /// pinned per call. Handles opened with <see cref="FileOptions.Asynchronous"/> overlap the reads
+    /// and writes of every chunk in flight; other handles still run them on several threads at once.
+    /// </remarks>
+    public static class AesGcmSivFile
+    {
+        /// <summary>The number of chunks in flight used when none is given.</summary>
+        public const int DefaultChunksInFlight = 8;
+
+        /// <summary>The most chunks in flight.</summary>
+        public const int MaxChunksInFlight = 64;
+
+        private const int TagSize = 16;
+        private const int NonceSize = 12;
+
+        /// <summary>
+        /// Encrypts the whole of <paramref name="input"/> into <paramref name="output"/>.
+        /// </summary>
+        /// <param name="input">The plaintext file, opened for reading.</param>
+        /// <param name="output">
+        /// The file to write, opened for writing. It is resized to the encrypted length first; if
+        /// encryption fails its contents are undefined, and the caller should delete it.
+        /// </param>
+        /// <param name="aesGcmSiv">The key to use.</param>
+        /// <param name="chunkSize">Plaintext bytes per chunk, from 1 to <see cref="AesGcmSivStream.MaxChunkSize"/>.</param>
+        /// <param name="associatedData">Optional additional authenticated data, bound to every chunk.</param>
+        /// <param name="chunksInFlight">
+        /// The most chunks being read, sealed or written at once, from 1 to <see cref="MaxChunksInFlight"/>.
+        /// Memory use is about this many chunks.
+        /// </param>
+        /// <param name="cancellationToken">The token to monitor for cancellation requests.</param>
+        /// <returns>A task that completes once every chunk has been written.</returns>
+        /// <remarks>
+        /// The result reads back with <see cref="AesGcmSiv.DecryptFile"/>, <see cref="AesGcmSivStream"/>
+        /// or <see cref="AesGcmSivRandomAccessReader"/>. The input must not change length while it is
+        /// being read.
+        /// </remarks>
+        /// <exception cref="ArgumentNullException"><paramref name="input"/>, <paramref name="output"/> or <paramref name="aesGcmSiv"/> is null.</exception>
+        /// <exception cref="ArgumentOutOfRangeException"><paramref name="chunkSize"/> or <paramref name="chunksInFlight"/> is out of range.</exception>
+        /// <exception cref="ArgumentException">The file needs more chunks than the format allows at this chunk size.</exception>
+        /// <exception cref="IOException">A read or write failed, or the input shrank while it was being read.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public static async Task EncryptAsync(
+            SafeFileHandle input,
+            SafeFileHandle output,
+            AesGcmSiv aesGcmSiv,
+            int chunkSize = AesGcmSivStream.DefaultChunkSize,
+            byte[]? associatedData = null,
+            int chunksInFlight = DefaultChunksInFlight,
+            CancellationToken cancellationToken = default)
+        {
+            ArgumentNullException.ThrowIfNull(input);
+            ArgumentNullException.ThrowIfNull(output);
+            ArgumentNullException.ThrowIfNull(aesGcmSiv);
+            ArgumentOutOfRangeException.ThrowIfNegativeOrZero(chunkSize);
+            ArgumentOutOfRangeException.ThrowIfGreaterThan(chunkSize, AesGcmSivStream.MaxChunkSize);
+            ArgumentOutOfRangeException.ThrowIfNegativeOrZero(chunksInFlight);
+            ArgumentOutOfRangeException.ThrowIfGreaterThan(chunksInFlight, MaxChunksInFlight);
+
+            long length = RandomAccess.GetLength(input);
+            // An empty file still gets an empty last chunk
+            long chunks = Math.Max(1, (length + chunkSize - 1) / chunkSize);
+            if (chunks - 1 > uint.MaxValue)
+                throw new ArgumentException("The file needs too many chunks at this chunk size.", nameof(chunkSize));
+
+            RandomAccess.SetLength(output, AesGcmSivStream.HeaderSize + length + chunks * TagSize);
+            var header = new byte[AesGcmSivStream.HeaderSize];
+            var prefix = new byte[AesGcmSivStream.PrefixSize];
+            AesGcmSivStream.WriteHeader(header, chunkSize, prefix);
+            await RandomAccess.WriteAsync(output, header, 0, cancellationToken).ConfigureAwait(false);
+
+            int workers = (int)Math.Min(chunksInFlight, chunks);
+            using var pool = new AesGcmSivBufferPool(workers, chunkSize + TagSize);
+            // Stops the other workers once one fails
+            using var failed = CancellationTokenSource.CreateLinkedTokenSource(cancellationToken);
+            long next = -1;
+            var tasks = new Task[workers];
+            for (int w = 0; w < workers; w++)
+            {
+                Memory<byte> buffer = pool.GetMemory(w);
+                tasks[w] = Task.Run(async () =>
+                {
+                    try
+                    {
+                        var nonce = new byte[NonceSize];
+                        long i;
+                        while ((i = Interlocked.Increment(ref next)) < chunks)
+                        {
+                            bool last = i == chunks - 1;
+                            long offset = i * chunkSize;
+                            int chunkLength = last ? (int)(length - offset) : chunkSize;
+                            Memory<byte> chunk = buffer.Slice(0, chunkLength);
+                            await ReadChunkAsync(input, chunk, offset, failed.Token).ConfigureAwait(false);
+
+                            AesGcmSivStream.ChunkNonce(prefix, (ulong)i, last, nonce);
+                            aesGcmSiv.Encrypt(nonce, chunk.Span, chunk.Span, buffer.Span.Slice(chunkLength, TagSize), associatedData);
+                            await RandomAccess.WriteAsync(
+                                output, buffer.Slice(0, chunkLength + TagSize),
+                                AesGcmSivStream.HeaderSize + offset + i * TagSize, failed.Token).ConfigureAwait(false);
+                        }
+                    }
+                    catch (Exception e) when (e is not OperationCanceledException)
+                    {
+                        failed.Cancel();
+                        throw;
+                    }
+                    finally
+                    {
+                        // A failed chunk may leave plaintext behind
+                        CryptographicOperations.ZeroMemory(buffer.Span);
+                    }
+                }, failed.Token);
+            }
+            await Task.WhenAll(tasks).ConfigureAwait(false);
+        }
+
+        // Fills chunk from input at offset, which RandomAccess may take
+        // several reads to do
+        private static async ValueTask ReadChunkAsync(
+            SafeFileHandle input, Memory<byte> chunk, long offset, CancellationToken cancellationToken)
+        {
+            int total = 0;
+            while (total < chunk.Length)
+            {
+                int read = await RandomAccess.ReadAsync(input, chunk.Slice(total), offset + total, cancellationToken)
+                    .ConfigureAwait(false);
+                if (read == 0)
+                    throw new IOException("The input file shrank while it was being encrypted.");
+                total += read;
+            }
+        }
+    }
+}
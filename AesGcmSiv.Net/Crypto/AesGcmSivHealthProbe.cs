@@ -0,0 +1,139 @@
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Measures the native backend's speed now and then on a timer, so that a host whose cipher
+    /// instructions run far slower than they should, because of microcode or a hypervisor that hides
+    /// or traps them, shows up in its metrics and health checks and can be drained.
+    /// </summary>
+    /// <remarks>
+    /// Each measurement encrypts a fixed 16 KiB buffer a few times on a thread-pool thread and keeps
+    /// the fastest run, which takes tens of microseconds on a healthy host. It is reported through
+    /// <see cref="LastResult"/> and <see cref="IsDegraded"/>, and through the
+    /// <c>aesgcmsiv.probe.cycles_per_byte</c> and <c>aesgcmsiv.probe.degraded</c> gauges of the
+    /// <see cref="AesGcmSiv.MeterName"/> meter.
+    ///
+    /// A measurement is degraded when it took more cycles per byte than expected: the figure passed to
+    /// the constructor, or else the library's reference for the backend, which is about twice what a
+    /// healthy host measures. Only the hand-written x86 kernels have a reference; elsewhere pass the
+    /// figure a healthy host of the fleet reports in <see cref="AesGcmSivProbeResult.CyclesPerByte"/>,
+    /// or the probe never reports degradation.
+    /// </remarks>
+    public sealed class AesGcmSivHealthProbe : IDisposable
+    {
+        private const int AESGCMSIV_SUCCESS = 0;
+
+        private readonly double _expectedCyclesPerByte;
+        private readonly Timer _timer;
+        private readonly object _lock = new();
+        private AesGcmSivProbeResult? _lastResult;
+        private bool _degraded;
+        private bool _disposed;
+
+        /// <summary>
+        /// Starts probing at once and then every <paramref name="interval"/>.
+        /// </summary>
+        /// <param name="interval">Time between measurements; at least 1 second.</param>
+        /// <param name="expectedCyclesPerByte">
+        /// Most cycles per byte a healthy host takes, or null for the library's reference for the
+        /// backend.
+        /// </param>
+        /// <exception cref="ArgumentOutOfRangeException">
+        /// <paramref name="interval"/> is shorter than 1 second, or <paramref name="expectedCyclesPerByte"/>
+        /// is not positive.
+        /// </exception>
+        public AesGcmSivHealthProbe(TimeSpan interval, double? expectedCyclesPerByte = null)
+        {
+            if (interval < TimeSpan.FromSeconds(1))
+                throw new ArgumentOutOfRangeException(nameof(interval));
+            if (expectedCyclesPerByte is <= 0 or double.NaN)
+                throw new ArgumentOutOfRangeException(nameof(expectedCyclesPerByte));
+
+            _expectedCyclesPerByte = expectedCyclesPerByte ?? 0;
+            _timer = new Timer(_ => Probe(), null, TimeSpan.Zero, interval);
+        }
+
+        /// <summary>Gets the latest measurement, or null before the first one finishes.</summary>
+        public AesGcmSivProbeResult? LastResult
+        {
+            get
+            {
+                lock (_lock)
+                    return _lastResult;
+            }
+        }
+
+        /// <summary>Gets whether the latest measurement was slower than expected.</summary>
+        public bool IsDegraded
+        {
+            get
+            {
+                lock (_lock)
+                    return _degraded;
+            }
+        }
+
+        /// <summary>
+        /// Measures the backend in use once, on the calling thread.
+        /// </summary>
+        /// <param name="bytes">Bytes to encrypt per run, up to 1 MiB, or 0 for 16 KiB.</param>
+        /// <param name="runs">Timed runs, up to 64, or 0 for 5.</param>
+        /// <returns>The fastest run.</returns>
+        /// <exception cref="ArgumentOutOfRangeException"><paramref name="bytes"/> or <paramref name="runs"/> is out of range.</exception>
+        /// <exception cref="CryptographicException">The measurement failed.</exception>
+        public static unsafe AesGcmSivProbeResult Measure(int bytes = 0, int runs = 0)
+        {
+            ArgumentOutOfRangeException.ThrowIfNegative(bytes);
+            ArgumentOutOfRangeException.ThrowIfGreaterThan(bytes, 1 << 20);
+            ArgumentOutOfRangeException.ThrowIfNegative(runs);
+            ArgumentOutOfRangeException.ThrowIfGreaterThan(runs, 64);
+
+            AesGcmSivNative.EnsureLoaded();
+            NativeProbeResult result;
+            int status = AesGcmSivNative.Probe((nuint)bytes, (uint)runs, &result);
+            if (status != AESGCMSIV_SUCCESS)
+                throw new CryptographicException($"Probe failed with error code: {status}");
+            return new AesGcmSivProbeResult(result);
+        }
+
+        /// <summary>
+        /// Stops probing. The gauges keep reporting the last measurement.
+        /// </summary>
+        public void Dispose()
+        {
+            lock (_lock)
+            {
+                if (_disposed)
+                    return;
+                _disposed = true;
+            }
+            _timer.Dispose();
+        }
+
+        private void Probe()
+        {
+            AesGcmSivProbeResult result;
+            try
+            {
+                result = Measure();
+            }
+            catch (CryptographicException)
+            {
+                // Leave the last reading in place; the next tick tries again
+                return;
+            }
+
+            double expected = _expectedCyclesPerByte != 0
+                ? _expectedCyclesPerByte
+                : result.Bytes == 0 ? 0 : (double)result.ExpectedCycles / result.Bytes;
+            bool degraded = expected != 0 && result.CyclesPerByte > expected;
+            lock (_lock)
+            {
+                if (_disposed)
+                    return;
+                _lastResult = result;
+                _degraded = degraded;
+            }
+            AesGcmSivMetrics.RecordProbe(result, degraded);
+        }
+    }
+}
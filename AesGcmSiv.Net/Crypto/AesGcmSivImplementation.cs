@@ -0,0 +1,35 @@
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Selects the code that runs the cipher for an <see cref="AesGcmSiv"/> instance, for
+    /// <see cref="AesGcmSiv(byte[], AesGcmSivImplementation)"/>.
+    /// </summary>
+    /// <remarks>
+    /// The managed implementation needs AES-NI and PCLMULQDQ on x86, or the AES and PMULL instructions
+    /// on Arm64; see <see cref="AesGcmSiv.IsManagedImplementationSupported"/>. Every implementation
+    /// produces the same ciphertext and tags.
+    /// </remarks>
+    public enum AesGcmSivImplementation
+    {
+        /// <summary>
+        /// The native library for every call, as <see cref="AesGcmSiv(byte[])"/> does.
+        /// </summary>
+        Native = 0,
+
+        /// <summary>
+        /// Managed code for messages up to <see cref="AesGcmSiv.ManagedMessageThreshold"/>, where the
+        /// fixed cost of calling into the library dominates, and the native library for the rest. If the library cannot be loaded every call runs in managed code, as with
+        /// <see cref="Managed"/>. Where the managed implementation is not supported this is the same
+        /// as <see cref="Native"/>.
+        /// </summary>
+        Auto = 1,
+
+        /// <summary>
+        /// Managed code for every call, without loading the native library. Batches and vectored
+        /// calls run one message at a time, <see cref="AesGcmSiv.MaxDegreeOfParallelism"/> and
+        /// <see cref="AesGcmSiv.SmallMessageFastPath"/> have no effect, and the instance cannot be used
+        /// with an <see cref="AesGcmSivEngine"/>.
+        /// </summary>
+        Managed = 2,
+    }
+}
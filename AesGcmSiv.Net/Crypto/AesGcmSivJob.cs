@@ -0,0 +1,247 @@
+using System.Buffers;
+using System.Collections.Concurrent;
+using System.Diagnostics;
+using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// One encrypt or decrypt call in flight, either as a native asynchronous job, as a call queued on
+    /// its context's worker pool, or as a request on an <see cref="AesGcmSivEngine"/>. The buffers stay
+    /// pinned and the context referenced until the call finishes, so the caller may await it freely.
+    /// </summary>
+    /// <remarks>
+    /// OpenSSL resumes a paused job only on the thread that started it, so every job is both
+    /// submitted and polled by one dedicated driver thread, which keeps any number in flight at once.
+    /// </remarks>
+    internal sealed class AesGcmSivJob
+    {
+        private const int AESGCMSIV_SUCCESS = 0;
+        private const int AESGCMSIV_PENDING = 1;
+
+        private static readonly ConcurrentQueue<AesGcmSivJob> s_submissions = new();
+        private static readonly AutoResetEvent s_submitted = new(false);
+        private static int s_driverStarted;
+
+        private readonly TaskCompletionSource<int> _completion =
+            new(TaskCreationOptions.RunContinuationsAsynchronously);
+        private readonly SafeAesGcmSivHandle _context;
+        private readonly bool _decrypt;
+        private MemoryHandle _nonce;
+        private MemoryHandle _input;
+        private MemoryHandle _associatedData;
+        private MemoryHandle _tag;
+        private MemoryHandle _output;
+        private readonly int _nonceLength;
+        private readonly int _inputLength;
+        private readonly int _associatedDataLength;
+        private IntPtr _job;  // native job while paused
+        private readonly long _started;  // Stopwatch timestamp, or 0 if no metrics listener was attached
+
+        /// <exception cref="ObjectDisposedException"><paramref name="context"/> has been released.</exception>
+        internal AesGcmSivJob(
+            SafeAesGcmSivHandle context, bool decrypt, ReadOnlyMemory<byte> nonce, ReadOnlyMemory<byte> input,
+            ReadOnlyMemory<byte> associatedData, ReadOnlyMemory<byte> tag, Memory<byte> output)
+        {
+            _started = AesGcmSivMetrics.IsEnabled ? Stopwatch.GetTimestamp() : 0;
+            _decrypt = decrypt;
+            _nonceLength = nonce.Length;
+            _inputLength = input.Length;
+            _associatedDataLength = associatedData.Length;
+            _nonce = nonce.Pin();
+            _input = input.Pin();
+            _associatedData = associatedData.Pin();
+            _tag = tag.Pin();
+            _output = output.Pin();
+            try
+            {
+                bool added = false;
+                context.DangerousAddRef(ref added);
+                _context = context;
+            }
+            catch
+            {
+                ReleaseBuffers();
+                throw;
+            }
+        }
+
+        /// <summary>
+        /// Runs <paramref name="job"/> on the driver thread, throwing if it fails.
+        /// </summary>
+        /// <param name="job">The job to run.</param>
+        /// <param name="operation">Names the call in the exception message.</param>
+        internal static ValueTask RunAsync(AesGcmSivJob job, string operation) =>
+            CompleteAsync(Submit(job), operation);
+
+        /// <summary>
+        /// Queues <paramref name="job"/> on its context's native worker pool, throwing if it fails. No
+        /// thread waits for it: the pool worker that finishes the call completes the task. A context
+        /// without a pool runs the call before this returns.
+        /// </summary>
+        /// <param name="job">The job to run.</param>
+        /// <param name="operation">Names the call in the exception message.</param>
+        internal static ValueTask RunOnPoolAsync(AesGcmSivJob job, string operation)
+        {
+            GCHandle handle = GCHandle.Alloc(job);
+            int result = job.Post(GCHandle.ToIntPtr(handle));
+            if (result != AESGCMSIV_PENDING)
+            {
+                handle.Free();
+                job.Finish(result);
+            }
+            return CompleteAsync(job.Completion, operation);
+        }
+
+        /// <summary>
+        /// Awaits the native status of a call, throwing if it failed.
+        /// </summary>
+        /// <param name="completion">The call's <see cref="Completion"/>.</param>
+        /// <param name="operation">Names the call in the exception message.</param>
+        internal static async ValueTask CompleteAsync(Task<int> completion, string operation)
+        {
+            int result = await completion.ConfigureAwait(false);
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                throw new CryptographicException($"{operation} failed with error code: {result}");
+            }
+        }
+
+        private static Task<int> Submit(AesGcmSivJob job)
+        {
+            s_submissions.Enqueue(job);
+            if (Volatile.Read(ref s_driverStarted) == 0 && Interlocked.Exchange(ref s_driverStarted, 1) == 0)
+            {
+                new Thread(Drive) { IsBackground = true, Name = "AesGcmSiv async jobs" }.Start();
+            }
+            s_submitted.Set();
+            return job._completion.Task;
+        }
+
+        private static void Drive()
+        {
+            var inFlight = new List<AesGcmSivJob>();
+            while (true)
+            {
+                while (s_submissions.TryDequeue(out AesGcmSivJob? job))
+                {
+                    if (!job.Start())
+                        inFlight.Add(job);
+                }
+
+                inFlight.RemoveAll(job => job.Poll());
+
+                // Paused jobs are waiting on a device and have no completion
+                // signal to block on, so keep polling while any remain
+                if (inFlight.Count == 0)
+                    s_submitted.WaitOne();
+                else
+                    Thread.Yield();
+            }
+        }
+
+        /// <summary>Completes with the native status once the call finishes.</summary>
+        internal Task<int> Completion => _completion.Task;
+
+        /// <summary>
+        /// Describes the call as an engine request. The job must then be completed with
+        /// <see cref="Complete"/>.
+        /// </summary>
+        internal unsafe NativeRequest ToRequest(ulong userData) => new NativeRequest
+        {
+            Context = _context.DangerousGetHandle(),
+            Operation = _decrypt ? NativeRequest.Decrypt : NativeRequest.Encrypt,
+            Item = new NativeBatchItem
+            {
+                Nonce = (IntPtr)_nonce.Pointer,
+                Input = (IntPtr)_input.Pointer,
+                InputLength = (nuint)_inputLength,
+                AssociatedData = (IntPtr)_associatedData.Pointer,
+                AssociatedDataLength = (nuint)_associatedDataLength,
+                Output = (IntPtr)_output.Pointer,
+                Tag = (IntPtr)_tag.Pointer,
+            },
+            UserData = userData,
+        };
+
+        /// <summary>
+        /// Releases the buffers and context and publishes <paramref name="result"/>.
+        /// </summary>
+        internal void Complete(int result) => Finish(result);
+
+        // Returns whether the job finished
+        private unsafe bool Start()
+        {
+            IntPtr job = IntPtr.Zero;
+            IntPtr context = _context.DangerousGetHandle();
+            int result = _decrypt
+                ? AesGcmSivNative.CtxDecryptSubmit(
+                    context,
+                    (byte*)_nonce.Pointer, (nuint)_nonceLength,
+                    (byte*)_input.Pointer, (nuint)_inputLength,
+                    (byte*)_associatedData.Pointer, (nuint)_associatedDataLength,
+                    (byte*)_tag.Pointer, (byte*)_output.Pointer, &job)
+                : AesGcmSivNative.CtxEncryptSubmit(
+                    context,
+                    (byte*)_nonce.Pointer, (nuint)_nonceLength,
+                    (byte*)_input.Pointer, (nuint)_inputLength,
+                    (byte*)_associatedData.Pointer, (nuint)_associatedDataLength,
+                    (byte*)_output.Pointer, (byte*)_tag.Pointer, &job);
+            _job = job;
+            return Finish(result);
+        }
+
+        private unsafe bool Poll() => Finish(AesGcmSivNative.JobPoll(_job));
+
+        private unsafe int Post(IntPtr userData)
+        {
+            IntPtr context = _context.DangerousGetHandle();
+            return _decrypt
+                ? AesGcmSivNative.CtxDecryptAsync(
+                    context,
+                    (byte*)_nonce.Pointer, (nuint)_nonceLength,
+                    (byte*)_input.Pointer, (nuint)_inputLength,
+                    (byte*)_associatedData.Pointer, (nuint)_associatedDataLength,
+                    (byte*)_tag.Pointer, (byte*)_output.Pointer, &OnPoolDone, userData)
+                : AesGcmSivNative.CtxEncryptAsync(
+                    context,
+                    (byte*)_nonce.Pointer, (nuint)_nonceLength,
+                    (byte*)_input.Pointer, (nuint)_inputLength,
+                    (byte*)_associatedData.Pointer, (nuint)_associatedDataLength,
+                    (byte*)_output.Pointer, (byte*)_tag.Pointer, &OnPoolDone, userData);
+        }
+
+        // Called on the pool worker that finished a posted call
+        [UnmanagedCallersOnly(CallConvs = new[] { typeof(CallConvCdecl) })]
+        private static void OnPoolDone(IntPtr userData, int status)
+        {
+            GCHandle handle = GCHandle.FromIntPtr(userData);
+            var job = (AesGcmSivJob)handle.Target!;
+            handle.Free();
+            job.Finish(status);
+        }
+
+        private bool Finish(int result)
+        {
+            if (result == AESGCMSIV_PENDING)
+                return false;
+            _job = IntPtr.Zero;
+            ReleaseBuffers();
+            _context.DangerousRelease();
+            if (_started != 0)
+                AesGcmSivMetrics.Record(_decrypt, result, _inputLength, _started);
+            _completion.TrySetResult(result);
+            return true;
+        }
+
+        private void ReleaseBuffers()
+        {
+            _nonce.Dispose();
+            _input.Dispose();
+            _associatedData.Dispose();
+            _tag.Dispose();
+            _output.Dispose();
+        }
+    }
+}
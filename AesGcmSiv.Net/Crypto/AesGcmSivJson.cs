@@ -0,0 +1,148 @@
+using System.Text;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Encrypts and decrypts selected fields of a UTF-8 JSON document in one pass, leaving the rest of
+    /// the document as it was.
+    /// </summary>
+    /// <remarks>
+    /// A path is member names separated by <c>.</c>, from the top-level object, such as
+    /// <c>card.number</c>, and a segment <c>*</c> matches any member or array element, as in
+    /// <c>items.*.price</c>. Each selected value, whatever its type, is replaced by a JSON string holding
+    /// a token in the form <see cref="AesGcmSiv.SealBase64Url"/> writes, sealed over the value's
+    /// exact text under a fresh random nonce. The document is scanned once in native code and every
+    /// selected value is sealed by one batch call.
+    ///
+    /// Every field is sealed with the same associated data, so a token moved to another selected field
+    /// still decrypts. Pass something that names the document, such as its ID, to keep tokens from
+    /// moving between documents. Needs the native library.
+    /// </remarks>
+    public static unsafe class AesGcmSivJson
+    {
+        private const int AESGCMSIV_SUCCESS = 0;
+        private const int AESGCMSIV_ERROR_INVALID_INPUT = -3;
+        private const int AESGCMSIV_ERROR_DECRYPT_FAILED = -5;
+
+        /// <summary>
+        /// Returns a copy of <paramref name="utf8Json"/> with the values <paramref name="paths"/> select
+        /// encrypted.
+        /// </summary>
+        /// <param name="aesGcmSiv">The key to use.</param>
+        /// <param name="utf8Json">The UTF-8 document, which must be valid JSON.</param>
+        /// <param name="paths">The paths of the values to encrypt; with none, the document is copied.</param>
+        /// <param name="associatedData">Optional additional authenticated data, bound to every field.</param>
+        /// <returns>The document with each selected value replaced by a token string.</returns>
+        /// <exception cref="ArgumentNullException"><paramref name="aesGcmSiv"/> or <paramref name="paths"/> is null.</exception>
+        /// <exception cref="ArgumentException">The document is not valid JSON, or a path is null, empty or has an empty segment.</exception>
+        /// <exception cref="NotSupportedException">The instance runs only managed code.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public static byte[] EncryptFields(
+            AesGcmSiv aesGcmSiv,
+            ReadOnlySpan<byte> utf8Json,
+            IReadOnlyList<string> paths,
+            ReadOnlySpan<byte> associatedData = default)
+        {
+            // Each token is about a third longer than its value plus 40
+            // bytes, so a short value can grow many times over; a guess that
+            // falls short is retried at the length the first call reports
+            long capacity = Math.Min((long)utf8Json.Length * 2 + 256, Array.MaxLength);
+            return Run(aesGcmSiv, utf8Json, paths, associatedData, open: false, (int)capacity);
+        }
+
+        /// <summary>
+        /// Returns a copy of <paramref name="utf8Json"/> with the values <paramref name="paths"/> select
+        /// decrypted, reversing <see cref="EncryptFields"/>.
+        /// </summary>
+        /// <param name="aesGcmSiv">The key to use.</param>
+        /// <param name="utf8Json">The UTF-8 document <see cref="EncryptFields"/> returned.</param>
+        /// <param name="paths">The paths the fields were encrypted under.</param>
+        /// <param name="associatedData">The additional authenticated data the fields were encrypted with.</param>
+        /// <returns>The document with each token string replaced by the value it sealed.</returns>
+        /// <exception cref="ArgumentNullException"><paramref name="aesGcmSiv"/> or <paramref name="paths"/> is null.</exception>
+        /// <exception cref="ArgumentException">The document is not valid JSON, or a path is null, empty or has an empty segment.</exception>
+        /// <exception cref="NotSupportedException">The instance runs only managed code.</exception>
+        /// <exception cref="AuthenticationTagMismatchException">A selected value is not a token, or did not verify.</exception>
+        public static byte[] DecryptFields(
+            AesGcmSiv aesGcmSiv,
+            ReadOnlySpan<byte> utf8Json,
+            IReadOnlyList<string> paths,
+            ReadOnlySpan<byte> associatedData = default)
+        {
+            // Opening only ever shortens the document
+            return Run(aesGcmSiv, utf8Json, paths, associatedData, open: true, utf8Json.Length);
+        }
+
+        private static byte[] Run(
+            AesGcmSiv aesGcmSiv,
+            ReadOnlySpan<byte> utf8Json,
+            IReadOnlyList<string> paths,
+            ReadOnlySpan<byte> associatedData,
+            bool open,
+            int capacity)
+        {
+            ArgumentNullException.ThrowIfNull(aesGcmSiv);
+            ArgumentNullException.ThrowIfNull(paths);
+
+            // The paths go to native code as NUL-terminated UTF-8, packed
+            // into one buffer with a pointer to each
+            var offsets = new int[paths.Count];
+            int total = 0;
+            for (int i = 0; i < paths.Count; i++)
+            {
+                string? path = paths[i];
+                if (string.IsNullOrEmpty(path) || path.Contains('\0'))
+                    throw new ArgumentException("A path is null, empty or holds a NUL character.", nameof(paths));
+                offsets[i] = total;
+                total = checked(total + Encoding.UTF8.GetByteCount(path) + 1);
+            }
+            var packed = new byte[total];
+            for (int i = 0; i < paths.Count; i++)
+                Encoding.UTF8.GetBytes(paths[i], packed.AsSpan(offsets[i]));
+            var pointers = new IntPtr[paths.Count];
+
+            using var context = new SafeAesGcmSivHandle.Lease(aesGcmSiv.JsonContext());
+            while (true)
+            {
+                var output = new byte[capacity];
+                nuint written = 0;
+                int result;
+                fixed (byte* json = utf8Json)
+                fixed (byte* aad = associatedData)
+                fixed (byte* packedPtr = packed)
+                fixed (IntPtr* pointersPtr = pointers)
+                fixed (byte* outputPtr = output)
+                {
+                    for (int i = 0; i < pointers.Length; i++)
+                        pointersPtr[i] = (IntPtr)(packedPtr + offsets[i]);
+                    var run = open ? AesGcmSivNative.JsonOpenFields : AesGcmSivNative.JsonSealFields;
+                    result = run(
+                        context.Pointer, json, (nuint)utf8Json.Length, (byte**)pointersPtr, (nuint)pointers.Length,
+                        aad, (nuint)associatedData.Length, outputPtr, (nuint)output.Length, &written);
+                }
+
+                if (result == AESGCMSIV_ERROR_INVALID_INPUT && written > (nuint)capacity)
+                {
+                    if (written > (nuint)Array.MaxLength)
+                        throw new CryptographicException("The encrypted document would be too large.");
+                    capacity = (int)written;
+                    continue;
+                }
+                if (result == AESGCMSIV_ERROR_INVALID_INPUT)
+                    throw new ArgumentException("The document is not valid JSON, or a path has an empty segment.", nameof(utf8Json));
+                if (result == AESGCMSIV_ERROR_DECRYPT_FAILED && open)
+                    throw new AuthenticationTagMismatchException("A selected field is not a token, or did not verify.");
+                if (result != AESGCMSIV_SUCCESS)
+                    throw new CryptographicException($"JSON field {(open ? "decryption" : "encryption")} failed with error code: {result}");
+
+                if ((int)written == output.Length)
+                    return output;
+                byte[] trimmed = output.AsSpan(0, (int)written).ToArray();
+                // An opened document is not left behind in a second copy
+                if (open)
+                    CryptographicOperations.ZeroMemory(output);
+                return trimmed;
+            }
+        }
+    }
+}
@@ -0,0 +1,345 @@
+using System.Buffers.Binary;
+using System.Diagnostics;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Keys named by 32-bit IDs, for messages that carry the ID of the key they were sealed under, so
+    /// that a receiver holding many keys can open any of them.
+    /// </summary>
+    /// <remarks>
+    /// A sealed message is laid out as key ID || nonce || ciphertext || tag, the ID big-endian. Both
+    /// <see cref="Seal"/> and <see cref="Open"/> look the key up and run the cipher in one native call,
+    /// in a flat open-addressed table hashed under a per-keyring secret, so no lookup or instance is
+    /// needed in managed code per message.
+    ///
+    /// Seals and opens may run on any number of threads at once, also while keys are added or
+    /// removed. A removed key is cleared and freed once no seal or open that could have found it is
+    /// still running: at once if none is, otherwise by a later <see cref="Add"/> or
+    /// <see cref="Remove"/>. An ID that was removed should not be reused for another key.
+    /// <see cref="Dispose"/> clears every key.
+    /// </remarks>
+    public sealed unsafe class AesGcmSivKeyRing : IDisposable
+    {
+        /// <summary>The size of the key ID header in bytes.</summary>
+        public const int KeyIdSize = 4;
+
+        /// <summary>
+        /// The number of bytes a sealed message is longer than its plaintext: key ID, nonce and tag.
+        /// </summary>
+        public const int SealOverhead = KeyIdSize + AesGcmSiv.SealOverhead;
+
+        private const int AESGCMSIV_SUCCESS = 0;
+        private const int AESGCMSIV_ERROR_INVALID_INPUT = -3;
+        private const int AESGCMSIV_ERROR_NOT_FOUND = -9;
+
+        private const int NonceSize = 12;
+        private const int TagSize = 16;
+        private const int MaxCapacity = 1 << 24;
+
+        private readonly SafeAesGcmSivKeyRingHandle _keyring;
+        private bool _disposed;
+
+        /// <summary>
+        /// Initializes an empty keyring that holds up to <paramref name="capacity"/> keys.
+        /// </summary>
+        /// <param name="capacity">The most keys held at once, from 1 to 16777216.</param>
+        /// <exception cref="ArgumentOutOfRangeException"><paramref name="capacity"/> is out of range.</exception>
+        /// <exception cref="CryptographicException">The native keyring could not be allocated.</exception>
+        public AesGcmSivKeyRing(int capacity)
+        {
+            ArgumentOutOfRangeException.ThrowIfNegativeOrZero(capacity);
+            ArgumentOutOfRangeException.ThrowIfGreaterThan(capacity, MaxCapacity);
+
+            int result = SafeAesGcmSivKeyRingHandle.Create(capacity, out _keyring);
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                _keyring.Dispose();
+                throw new CryptographicException($"Keyring setup failed with error code: {result}");
+            }
+            Capacity = capacity;
+        }
+
+        /// <summary>Gets the most keys the keyring holds at once.</summary>
+        public int Capacity { get; }
+
+        /// <summary>
+        /// Expands <paramref name="key"/> and adds it under <paramref name="keyId"/>.
+        /// </summary>
+        /// <param name="keyId">The key's ID, written into every message sealed under it.</param>
+        /// <param name="key">
+        /// The encryption key. Must be exactly 16 bytes (AES-128-GCM-SIV) or 32 bytes (AES-256-GCM-SIV).
+        /// </param>
+        /// <exception cref="ArgumentException"><paramref name="key"/> is not 16 or 32 bytes.</exception>
+        /// <exception cref="InvalidOperationException">
+        /// The keyring already holds a key under <paramref name="keyId"/>, or holds <see cref="Capacity"/> keys.
+        /// </exception>
+        /// <exception cref="ObjectDisposedException">The keyring has been disposed.</exception>
+        public void Add(uint keyId, ReadOnlySpan<byte> key)
+        {
+            ThrowIfDisposed();
+            if (key.Length != 16 && key.Length != 32)
+                throw new ArgumentException("Key must be exactly 16 bytes (128 bits) or 32 bytes (256 bits).", nameof(key));
+
+            int result;
+            fixed (byte* keyPtr = key)
+            {
+                byte* k = keyPtr;
+                nuint length = (nuint)key.Length;
+                result = Call(keyring => AesGcmSivNative.KeyRingAdd(keyring, keyId, k, length));
+            }
+            if (result == AESGCMSIV_ERROR_INVALID_INPUT)
+                throw new InvalidOperationException($"The keyring already holds key {keyId}, or is full.");
+            if (result != AESGCMSIV_SUCCESS)
+                throw new CryptographicException($"Key setup failed with error code: {result}");
+        }
+
+        /// <summary>
+        /// Removes the key under <paramref name="keyId"/>, so that messages naming it no longer open.
+        /// </summary>
+        /// <param name="keyId">The key's ID.</param>
+        /// <returns>Whether the keyring held a key under <paramref name="keyId"/>.</returns>
+        /// <exception cref="ObjectDisposedException">The keyring has been disposed.</exception>
+        public bool Remove(uint keyId)
+        {
+            ThrowIfDisposed();
+            int result = Call(keyring => AesGcmSivNative.KeyRingRemove(keyring, keyId));
+            if (result != AESGCMSIV_SUCCESS && result != AESGCMSIV_ERROR_NOT_FOUND)
+                throw new CryptographicException($"Key removal failed with error code: {result}");
+            return result == AESGCMSIV_SUCCESS;
+        }
+
+        /// <summary>
+        /// Encrypts plaintext under the key <paramref name="keyId"/> into a single buffer laid out as
+        /// key ID || nonce || ciphertext || tag.
+        /// </summary>
+        /// <param name="keyId">The ID of the key to seal under.</param>
+        /// <param name="nonce">The nonce. Must be exactly 12 bytes (96 bits).</param>
+        /// <param name="plaintext">The data to encrypt.</param>
+        /// <param name="destination">
+        /// The output buffer. Must be at least <see cref="SealOverhead"/> bytes longer than
+        /// <paramref name="plaintext"/>. The plaintext may already sit at offset 16 to seal in place, but
+        /// must not otherwise overlap it.
+        /// </param>
+        /// <param name="associatedData">Optional additional authenticated data.</param>
+        /// <returns>The number of bytes written to <paramref name="destination"/>.</returns>
+        /// <exception cref="ObjectDisposedException">The keyring has been disposed.</exception>
+        /// <exception cref="ArgumentException">Parameter sizes are invalid, or the buffers partially overlap.</exception>
+        /// <exception cref="KeyNotFoundException">The keyring holds no key under <paramref name="keyId"/>.</exception>
+        /// <exception cref="CryptographicException">Encryption failed.</exception>
+        public int Seal(
+            uint keyId,
+            ReadOnlySpan<byte> nonce,
+            ReadOnlySpan<byte> plaintext,
+            Span<byte> destination,
+            ReadOnlySpan<byte> associatedData = default)
+        {
+            ThrowIfDisposed();
+            if (nonce.Length != NonceSize)
+                throw new ArgumentException($"Nonce must be exactly {NonceSize} bytes (96 bits).", nameof(nonce));
+            if (destination.Length - SealOverhead < plaintext.Length)
+                throw new ArgumentException("Destination buffer is too small.", nameof(destination));
+            Span<byte> ciphertext = destination.Slice(KeyIdSize + NonceSize, plaintext.Length);
+            if (plaintext.Overlaps(ciphertext, out int offset) && offset != 0 ||
+                plaintext.Overlaps(destination.Slice(0, KeyIdSize + NonceSize)) ||
+                plaintext.Overlaps(destination.Slice(SealOverhead - TagSize + plaintext.Length, TagSize)))
+                throw new ArgumentException("Input and output buffers must be the same memory or not overlap.", nameof(destination));
+
+            long started = AesGcmSivMetrics.IsEnabled ? Stopwatch.GetTimestamp() : 0;
+            int result;
+            bool added = false;
+            _keyring.DangerousAddRef(ref added);
+            try
+            {
+                fixed (byte* noncePtr = nonce)
+                fixed (byte* input = &AesGcmSiv.BufferReference(plaintext))
+                fixed (byte* aad = associatedData)
+                fixed (byte* output = destination)
+                {
+                    result = AesGcmSivNative.SealWithKeyId(
+                        _keyring.DangerousGetHandle(), keyId,
+                        noncePtr, (nuint)nonce.Length,
+                        input, (nuint)plaintext.Length,
+                        aad, (nuint)associatedData.Length,
+                        output);
+                }
+            }
+            finally
+            {
+                _keyring.DangerousRelease();
+            }
+            if (started != 0)
+                AesGcmSivMetrics.Record(decrypt: false, result, plaintext.Length, started);
+
+            if (result == AESGCMSIV_ERROR_NOT_FOUND)
+                throw new KeyNotFoundException($"The keyring holds no key {keyId}.");
+            if (result != AESGCMSIV_SUCCESS)
+                throw new CryptographicException($"Encryption failed with error code: {result}");
+            return plaintext.Length + SealOverhead;
+        }
+
+        /// <summary>
+        /// Verifies and decrypts a buffer laid out as key ID || nonce || ciphertext || tag, as produced
+        /// by <see cref="Seal"/>, under the key its header names.
+        /// </summary>
+        /// <param name="sealedData">The sealed message. Must be at least <see cref="SealOverhead"/> bytes.</param>
+        /// <param name="destination">
+        /// The output buffer for the plaintext. Must be at least <paramref name="sealedData"/> length minus
+        /// <see cref="SealOverhead"/> bytes.
+        /// </param>
+        /// <param name="keyId">Receives the key ID read from the header.</param>
+        /// <param name="associatedData">Optional additional authenticated data (must match the data used during encryption).</param>
+        /// <returns>The number of plaintext bytes written to <paramref name="destination"/>.</returns>
+        /// <exception cref="ObjectDisposedException">The keyring has been disposed.</exception>
+        /// <exception cref="ArgumentException">Parameter sizes are invalid.</exception>
+        /// <exception cref="CryptographicException">
+        /// The keyring holds no key under the header's ID, or the message does not authenticate.
+        /// </exception>
+        public int Open(
+            ReadOnlySpan<byte> sealedData,
+            Span<byte> destination,
+            out uint keyId,
+            ReadOnlySpan<byte> associatedData = default)
+        {
+            ThrowIfDisposed();
+            if (sealedData.Length < SealOverhead)
+                throw new ArgumentException($"Sealed data must be at least {SealOverhead} bytes.", nameof(sealedData));
+            int plaintextLength = sealedData.Length - SealOverhead;
+            if (destination.Length < plaintextLength)
+                throw new ArgumentException("Destination buffer is too small.", nameof(destination));
+            keyId = BinaryPrimitives.ReadUInt32BigEndian(sealedData);
+
+            long started = AesGcmSivMetrics.IsEnabled ? Stopwatch.GetTimestamp() : 0;
+            int result;
+            bool added = false;
+            _keyring.DangerousAddRef(ref added);
+            try
+            {
+                uint parsed;
+                fixed (byte* input = sealedData)
+                fixed (byte* aad = associatedData)
+                fixed (byte* output = &AesGcmSiv.BufferReference(destination))
+                {
+                    result = AesGcmSivNative.OpenWithKeyId(
+                        _keyring.DangerousGetHandle(),
+                        input, (nuint)sealedData.Length,
+                        aad, (nuint)associatedData.Length,
+                        output, &parsed);
+                }
+            }
+            finally
+            {
+                _keyring.DangerousRelease();
+            }
+            if (started != 0)
+                AesGcmSivMetrics.Record(decrypt: true, result, plaintextLength, started);
+
+            // An unknown ID reads the same as a forged message to the caller
+            if (result == AESGCMSIV_ERROR_NOT_FOUND)
+                throw new CryptographicException($"The keyring holds no key {keyId}.");
+            if (result != AESGCMSIV_SUCCESS)
+                throw new CryptographicException($"Decryption failed with error code: {result}");
+            return plaintextLength;
+        }
+
+        /// <summary>
+        /// Reads the key ID from the header of a sealed message without opening it.
+        /// </summary>
+        /// <param name="sealedData">The sealed message, or at least its first <see cref="KeyIdSize"/> bytes.</param>
+        /// <exception cref="ArgumentException"><paramref name="sealedData"/> is shorter than <see cref="KeyIdSize"/>.</exception>
+        public static uint ReadKeyId(ReadOnlySpan<byte> sealedData)
+        {
+            if (sealedData.Length < KeyIdSize)
+                throw new ArgumentException($"Sealed data must be at least {KeyIdSize} bytes.", nameof(sealedData));
+            return BinaryPrimitives.ReadUInt32BigEndian(sealedData);
+        }
+
+        /// <summary>
+        /// Turns per-key usage counters on or off for every key held, and for keys added later.
+        /// </summary>
+        /// <remarks>
+        /// While on, each call adds to counters kept with its native key, which
+        /// <see cref="GetUsage"/> reads for all keys at once. They are off until enabled, and then cost
+        /// each call a few atomic adds and a clock read. Disabling keeps the counts.
+        /// </remarks>
+        /// <param name="enabled">Whether to count.</param>
+        /// <exception cref="ObjectDisposedException">The keyring has been disposed.</exception>
+        /// <exception cref="CryptographicException">The counters could not be allocated.</exception>
+        public void SetUsageTracking(bool enabled)
+        {
+            ThrowIfDisposed();
+            int result = Call(keyring => AesGcmSivNative.KeyRingSetUsageTracking(keyring, enabled ? 1 : 0));
+            if (result != AESGCMSIV_SUCCESS)
+                throw new CryptographicException($"Usage tracking setup failed with error code: {result}");
+        }
+
+        /// <summary>
+        /// Reads the usage counters of every key the keyring holds, in no particular order.
+        /// </summary>
+        /// <returns>One entry per key held; removed keys are not listed.</returns>
+        /// <exception cref="ObjectDisposedException">The keyring has been disposed.</exception>
+        public AesGcmSivKeyUsage[] GetUsage()
+        {
+            ThrowIfDisposed();
+            // Keys may be added between the count and the read, so retry until the buffer holds them all
+            NativeKeyUsage[] buffer = Array.Empty<NativeKeyUsage>();
+            nuint count;
+            while (true)
+            {
+                int result;
+                fixed (NativeKeyUsage* usage = buffer)
+                {
+                    NativeKeyUsage* u = usage;
+                    nuint max = (nuint)buffer.Length;
+                    nuint held = 0;
+                    nuint* h = &held;
+                    result = Call(keyring => AesGcmSivNative.KeyRingStats(keyring, u, max, h));
+                    count = held;
+                }
+                if (result != AESGCMSIV_SUCCESS)
+                    throw new CryptographicException($"Reading key usage failed with error code: {result}");
+                if (count <= (nuint)buffer.Length)
+                    break;
+                buffer = new NativeKeyUsage[(int)count + 16];
+            }
+
+            var keys = new AesGcmSivKeyUsage[(int)count];
+            for (int i = 0; i < keys.Length; i++)
+                keys[i] = new AesGcmSivKeyUsage(buffer[i]);
+            return keys;
+        }
+
+        /// <summary>
+        /// Clears every key, removed ones included, and frees the native keyring.
+        /// </summary>
+        public void Dispose()
+        {
+            if (!_disposed)
+            {
+                _keyring.Dispose();
+                _disposed = true;
+            }
+        }
+
+        // Runs one native call with the keyring kept alive for its duration
+        private int Call(Func<IntPtr, int> call)
+        {
+            bool added = false;
+            _keyring.DangerousAddRef(ref added);
+            try
+            {
+                return call(_keyring.DangerousGetHandle());
+            }
+            finally
+            {
+                _keyring.DangerousRelease();
+            }
+        }
+
+        private void ThrowIfDisposed()
+        {
+            if (_disposed)
+                throw new ObjectDisposedException(nameof(AesGcmSivKeyRing));
+        }
+    }
+}
@@ -0,0 +1,289 @@
+using System.Diagnostics;
+using System.Runtime.InteropServices;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// A fixed number of numbered key slots for batches in which every message may use a different
+    /// key, such as one record per tenant.
+    /// </summary>
+    /// <remarks>
+    /// Each key is expanded once, by <see cref="SetKey"/>, into one dense native table, and a batch
+    /// item names its key by slot number. No key is set up per call, and short messages under
+    /// different keys still share the multi-buffer kernels, as long as the keys are the same size.
+    ///
+    /// Batches may run on any number of threads at once. A slot must not be set or cleared while a
+    /// batch that uses it is running. <see cref="Dispose"/> clears every key.
+    /// </remarks>
+    public sealed unsafe class AesGcmSivKeyTable : IDisposable
+    {
+        private const int AESGCMSIV_SUCCESS = 0;
+        private const int AESGCMSIV_ERROR_INVALID_KEY = -1;
+        private const int AESGCMSIV_ERROR_DECRYPT_FAILED = -5;
+
+        private readonly SafeAesGcmSivKeyTableHandle _table;
+        private int _maxDegreeOfParallelism = 1;
+        private bool _disposed;
+
+        /// <summary>
+        /// Initializes a table with <paramref name="slotCount"/> empty slots.
+        /// </summary>
+        /// <param name="slotCount">The number of slots, numbered from 0.</param>
+        /// <exception cref="ArgumentOutOfRangeException"><paramref name="slotCount"/> is not positive.</exception>
+        /// <exception cref="CryptographicException">The native table could not be allocated.</exception>
+        public AesGcmSivKeyTable(int slotCount)
+        {
+            ArgumentOutOfRangeException.ThrowIfNegativeOrZero(slotCount);
+
+            int result = SafeAesGcmSivKeyTableHandle.Create(slotCount, out _table);
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                _table.Dispose();
+                throw new CryptographicException($"Key table setup failed with error code: {result}");
+            }
+            SlotCount = slotCount;
+        }
+
+        /// <summary>Gets the number of slots.</summary>
+        public int SlotCount { get; }
+
+        /// <summary>
+        /// Gets or sets the maximum number of threads one batch may use, as
+        /// <see cref="AesGcmSiv.MaxDegreeOfParallelism"/> does for an instance.
+        /// </summary>
+        /// <exception cref="ArgumentOutOfRangeException">The value is 0 or less than -1.</exception>
+        /// <exception cref="ObjectDisposedException">The table has been disposed.</exception>
+        public int MaxDegreeOfParallelism
+        {
+            get => _maxDegreeOfParallelism;
+            set
+            {
+                if (value == 0 || value < -1)
+                    throw new ArgumentOutOfRangeException(nameof(value), "Value must be -1 or a positive number.");
+                ThrowIfDisposed();
+
+                // A batch is split over the pool by items, so only whether
+                // there is one matters here
+                IntPtr pool = value == 1 ? IntPtr.Zero : AesGcmSiv.GetSharedPool();
+                int result = Call(table => AesGcmSivNative.KeyTableSetPool(table, pool));
+                if (result != AESGCMSIV_SUCCESS)
+                    throw new CryptographicException($"Setting the worker pool failed with error code: {result}");
+                _maxDegreeOfParallelism = value;
+            }
+        }
+
+        /// <summary>
+        /// Expands <paramref name="key"/> into a slot, replacing and clearing the key it held.
+        /// </summary>
+        /// <param name="slot">The slot number.</param>
+        /// <param name="key">
+        /// The encryption key. Must be exactly 16 bytes (AES-128-GCM-SIV) or 32 bytes (AES-256-GCM-SIV).
+        /// </param>
+        /// <exception cref="ArgumentOutOfRangeException"><paramref name="slot"/> is out of range.</exception>
+        /// <exception cref="ArgumentException"><paramref name="key"/> is not 16 or 32 bytes.</exception>
+        /// <exception cref="ObjectDisposedException">The table has been disposed.</exception>
+        public void SetKey(int slot, ReadOnlySpan<byte> key)
+        {
+            ThrowIfDisposed();
+            CheckSlot(slot, nameof(slot));
+            if (key.Length != 16 && key.Length != 32)
+                throw new ArgumentException("Key must be exactly 16 bytes (128 bits) or 32 bytes (256 bits).", nameof(key));
+
+            int result;
+            fixed (byte* keyPtr = key)
+            {
+                byte* k = keyPtr;
+                nuint length = (nuint)key.Length;
+                result = Call(table => AesGcmSivNative.KeyTableSet(table, (nuint)slot, k, length));
+            }
+            if (result != AESGCMSIV_SUCCESS)
+                throw new CryptographicException($"Key setup failed with error code: {result}");
+        }
+
+        /// <summary>
+        /// Clears the key in a slot and marks it empty.
+        /// </summary>
+        /// <param name="slot">The slot number.</param>
+        /// <exception cref="ArgumentOutOfRangeException"><paramref name="slot"/> is out of range.</exception>
+        /// <exception cref="ObjectDisposedException">The table has been disposed.</exception>
+        public void ClearKey(int slot)
+        {
+            ThrowIfDisposed();
+            CheckSlot(slot, nameof(slot));
+            Call(table => AesGcmSivNative.KeyTableClear(table, (nuint)slot));
+        }
+
+        /// <summary>
+        /// Encrypts a batch of messages with a single native call, item <c>i</c> under the key in slot
+        /// <c>slots[i]</c>.
+        /// </summary>
+        /// <param name="items">The messages to encrypt, as for <see cref="AesGcmSiv.EncryptBatch(ReadOnlySpan{AesGcmSivBatchItem})"/>.</param>
+        /// <param name="slots">The slot of each item. Must be at least as long as <paramref name="items"/>.</param>
+        /// <exception cref="ObjectDisposedException">The table has been disposed.</exception>
+        /// <exception cref="ArgumentNullException">A required buffer of an item is null.</exception>
+        /// <exception cref="ArgumentException">
+        /// The buffer sizes of an item are invalid, or <paramref name="slots"/> is too small.
+        /// </exception>
+        /// <exception cref="ArgumentOutOfRangeException">A slot number is out of range.</exception>
+        /// <exception cref="CryptographicException">An item names an empty slot, or encryption failed.</exception>
+        public void EncryptBatch(ReadOnlySpan<AesGcmSivBatchItem> items, ReadOnlySpan<int> slots)
+        {
+            ThrowIfDisposed();
+            ValidateBatch(items, slots);
+            foreach (var item in items)
+            {
+                AesGcmSiv.ValidateEncryptParameters(item.Nonce, item.Input, item.Output, item.Tag, item.AssociatedData);
+            }
+            if (items.IsEmpty)
+                return;
+
+            int result = RunBatch(items, slots, null);
+            if (result == AESGCMSIV_ERROR_INVALID_KEY)
+                throw new CryptographicException("A batch item names a slot with no key.");
+            if (result != AESGCMSIV_SUCCESS)
+                throw new CryptographicException($"Batch encryption failed with error code: {result}");
+        }
+
+        /// <summary>
+        /// Decrypts a batch of messages with a single native call, item <c>i</c> under the key in slot
+        /// <c>slots[i]</c>, reporting authentication failures per item.
+        /// </summary>
+        /// <param name="items">The messages to decrypt, as for <see cref="AesGcmSiv.DecryptBatch(ReadOnlySpan{AesGcmSivBatchItem}, Span{bool})"/>.</param>
+        /// <param name="slots">The slot of each item. Must be at least as long as <paramref name="items"/>.</param>
+        /// <param name="succeeded">
+        /// Receives, for each item, whether it authenticated. Must be at least as long as <paramref name="items"/>.
+        /// </param>
+        /// <returns>The number of items that failed to authenticate.</returns>
+        /// <exception cref="ObjectDisposedException">The table has been disposed.</exception>
+        /// <exception cref="ArgumentNullException">A required buffer of an item is null.</exception>
+        /// <exception cref="ArgumentException">
+        /// The buffer sizes of an item are invalid, or <paramref name="slots"/> or
+        /// <paramref name="succeeded"/> is too small.
+        /// </exception>
+        /// <exception cref="ArgumentOutOfRangeException">A slot number is out of range.</exception>
+        /// <exception cref="CryptographicException">
+        /// An item names an empty slot, or decryption failed for a reason other than authentication.
+        /// </exception>
+        public int DecryptBatch(ReadOnlySpan<AesGcmSivBatchItem> items, ReadOnlySpan<int> slots, Span<bool> succeeded)
+        {
+            ThrowIfDisposed();
+            ValidateBatch(items, slots);
+            foreach (var item in items)
+            {
+                AesGcmSiv.ValidateDecryptParameters(item.Nonce, item.Input, item.Tag, item.Output, item.AssociatedData);
+            }
+            if (succeeded.Length < items.Length)
+                throw new ArgumentException("Result buffer is too small.", nameof(succeeded));
+            if (items.IsEmpty)
+                return 0;
+
+            var statuses = new int[items.Length];
+            RunBatch(items, slots, statuses);
+
+            int failures = 0;
+            for (int i = 0; i < statuses.Length; i++)
+            {
+                if (statuses[i] == AESGCMSIV_ERROR_INVALID_KEY)
+                    throw new CryptographicException($"Batch item {i} names a slot with no key.");
+                if (statuses[i] != AESGCMSIV_SUCCESS && statuses[i] != AESGCMSIV_ERROR_DECRYPT_FAILED)
+                    throw new CryptographicException($"Batch decryption failed with error code: {statuses[i]}");
+                succeeded[i] = statuses[i] == AESGCMSIV_SUCCESS;
+                if (!succeeded[i])
+                    failures++;
+            }
+            return failures;
+        }
+
+        /// <summary>
+        /// Clears every key and frees the native table.
+        /// </summary>
+        public void Dispose()
+        {
+            if (!_disposed)
+            {
+                _table.Dispose();
+                _disposed = true;
+            }
+        }
+
+        private void ValidateBatch(ReadOnlySpan<AesGcmSivBatchItem> items, ReadOnlySpan<int> slots)
+        {
+            if (slots.Length < items.Length)
+                throw new ArgumentException("Slot buffer is too small.", nameof(slots));
+            for (int i = 0; i < items.Length; i++)
+            {
+                CheckSlot(slots[i], nameof(slots));
+            }
+        }
+
+        private void CheckSlot(int slot, string paramName)
+        {
+            if ((uint)slot >= (uint)SlotCount)
+                throw new ArgumentOutOfRangeException(paramName, $"Slot must be between 0 and {SlotCount - 1}.");
+        }
+
+        // Decrypts when statuses is supplied, otherwise encrypts
+        private int RunBatch(ReadOnlySpan<AesGcmSivBatchItem> items, ReadOnlySpan<int> slots, int[]? statuses)
+        {
+            long started = AesGcmSivMetrics.IsEnabled ? Stopwatch.GetTimestamp() : 0;
+            var handles = new GCHandle[items.Length * 5];
+            int result;
+            try
+            {
+                NativeBatchItem[] nativeItems = AesGcmSiv.PinBatch(items, handles);
+                bool added = false;
+                _table.DangerousAddRef(ref added);
+                try
+                {
+                    IntPtr table = _table.DangerousGetHandle();
+                    fixed (NativeBatchItem* itemsPtr = nativeItems)
+                    fixed (int* slotPtr = slots)
+                    fixed (int* statusPtr = statuses)
+                    {
+                        // Slots were checked to be in range, so they read as uint unchanged
+                        result = statuses == null
+                            ? AesGcmSivNative.KeyTableEncryptBatch(table, (nuint)nativeItems.Length, itemsPtr, (uint*)slotPtr)
+                            : AesGcmSivNative.KeyTableDecryptBatch(table, (nuint)nativeItems.Length, itemsPtr, (uint*)slotPtr, statusPtr);
+                    }
+                }
+                finally
+                {
+                    _table.DangerousRelease();
+                }
+            }
+            finally
+            {
+                foreach (var handle in handles)
+                {
+                    if (handle.IsAllocated)
+                        handle.Free();
+                }
+            }
+
+            if (started != 0)
+                AesGcmSivMetrics.RecordBatch(decrypt: statuses != null, items, statuses, result, started);
+            return result;
+        }
+
+        // Runs one native call with the table kept alive for its duration
+        private int Call(Func<IntPtr, int> call)
+        {
+            bool added = false;
+            _table.DangerousAddRef(ref added);
+            try
+            {
+                return call(_table.DangerousGetHandle());
+            }
+            finally
+            {
+                _table.DangerousRelease();
+            }
+        }
+
+        private void ThrowIfDisposed()
+        {
+            if (_disposed)
+                throw new ObjectDisposedException(nameof(AesGcmSivKeyTable));
+        }
+    }
+}
@@ -0,0 +1,40 @@
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// What one key of an <see cref="AesGcmSivKeyRing"/> has been used for since usage tracking was
+    /// first enabled on it.
+    /// </summary>
+    /// <remarks>
+    /// Each message counts once, whether it was sealed, opened or only verified. The counters are
+    /// kept with the native key, so reading them takes no lookup in managed code; calls still running
+    /// when they are read may be partly included.
+    /// </remarks>
+    public readonly struct AesGcmSivKeyUsage
+    {
+        internal AesGcmSivKeyUsage(in NativeKeyUsage usage)
+        {
+            KeyId = usage.KeyId;
+            Operations = (long)usage.Ops;
+            Bytes = (long)usage.Bytes;
+            Failures = (long)usage.Failures;
+            LastUsed = usage.LastUsedMs == 0
+                ? null
+                : DateTimeOffset.FromUnixTimeMilliseconds((long)usage.LastUsedMs);
+        }
+
+        /// <summary>Gets the key's ID.</summary>
+        public uint KeyId { get; }
+
+        /// <summary>Gets the number of messages run under the key, whether or not they succeeded.</summary>
+        public long Operations { get; }
+
+        /// <summary>Gets the plaintext or ciphertext bytes of the messages that succeeded.</summary>
+        public long Bytes { get; }
+
+        /// <summary>Gets the number of messages that failed, forged ones included.</summary>
+        public long Failures { get; }
+
+        /// <summary>Gets when the key last ran a message, or <see langword="null"/> if it never has.</summary>
+        public DateTimeOffset? LastUsed { get; }
+    }
+}
@@ -0,0 +1,198 @@
+using System.Diagnostics;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Deterministic key wrapping with AES-GCM-SIV: one key-encryption key used with one fixed nonce,
+    /// as RFC 8452 allows.
+    /// </summary>
+    /// <remarks>
+    /// The keys AES-GCM-SIV derives from the nonce are derived once, when the instance is created, so
+    /// wrapping a 32-byte data key costs one POLYVAL pass and a few AES blocks. The output is the same
+    /// as <see cref="AesGcmSiv.Encrypt(ReadOnlySpan{byte}, ReadOnlySpan{byte}, Span{byte}, Span{byte}, ReadOnlySpan{byte})"/>
+    /// with that nonce.
+    ///
+    /// Wrapping the same key with the same associated data always gives the same output. That reveals
+    /// when a key is wrapped twice and nothing else, which suits keys but not general messages. One
+    /// instance can be shared across threads.
+    /// </remarks>
+    public sealed unsafe class AesGcmSivKeyWrap : IDisposable
+    {
+        private const int NonceSize = 12;
+        private const int TagSize = 16;
+        private const int AESGCMSIV_SUCCESS = 0;
+        private const int AESGCMSIV_ERROR_DECRYPT_FAILED = -5;
+
+        private readonly SafeAesGcmSivWrapHandle _context;
+        private bool _disposed;
+
+        /// <summary>
+        /// Initializes a key-wrapping instance for a key-encryption key and its fixed nonce.
+        /// </summary>
+        /// <param name="key">
+        /// The key-encryption key. Must be exactly 16 bytes (AES-128-GCM-SIV) or 32 bytes (AES-256-GCM-SIV).
+        /// </param>
+        /// <param name="nonce">The nonce used for every wrap. Must be exactly 12 bytes (96 bits).</param>
+        /// <exception cref="ArgumentException">The key or nonce size is invalid.</exception>
+        /// <exception cref="CryptographicException">The native context could not be created.</exception>
+        public AesGcmSivKeyWrap(ReadOnlySpan<byte> key, ReadOnlySpan<byte> nonce)
+        {
+            if (key.Length != 16 && key.Length != 32)
+                throw new ArgumentException("Key must be exactly 16 bytes (128 bits) or 32 bytes (256 bits).", nameof(key));
+            if (nonce.Length != NonceSize)
+                throw new ArgumentException($"Nonce must be exactly {NonceSize} bytes (96 bits).", nameof(nonce));
+
+            int result = SafeAesGcmSivWrapHandle.Create(key, nonce, out _context);
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                _context.Dispose();
+                throw new CryptographicException($"Key-wrap setup failed with error code: {result}");
+            }
+        }
+
+        /// <summary>
+        /// Wraps a key.
+        /// </summary>
+        /// <param name="plaintext">The key to wrap.</param>
+        /// <param name="ciphertext">
+        /// The output buffer for the wrapped key. Must be at least as large as <paramref name="plaintext"/>.
+        /// May be the same memory as <paramref name="plaintext"/>, but must not otherwise overlap it.
+        /// </param>
+        /// <param name="tag">The output buffer for the authentication tag. Must be at least 16 bytes.</param>
+        /// <param name="associatedData">Optional additional authenticated data, such as a key identifier.</param>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentException">Parameter sizes are invalid, or the buffers partially overlap.</exception>
+        /// <exception cref="CryptographicException">Wrapping failed.</exception>
+        public void Wrap(
+            ReadOnlySpan<byte> plaintext,
+            Span<byte> ciphertext,
+            Span<byte> tag,
+            ReadOnlySpan<byte> associatedData = default)
+        {
+            ThrowIfDisposed();
+            ValidateSpans(plaintext, ciphertext, nameof(ciphertext));
+            if (tag.Length < TagSize)
+                throw new ArgumentException($"Tag buffer must be at least {TagSize} bytes.", nameof(tag));
+
+            int result = Run(decrypt: false, plaintext, ciphertext, tag, associatedData);
+            if (result != AESGCMSIV_SUCCESS)
+                throw new CryptographicException($"Key wrap failed with error code: {result}");
+        }
+
+        /// <summary>
+        /// Unwraps and authenticates a key.
+        /// </summary>
+        /// <param name="ciphertext">The wrapped key.</param>
+        /// <param name="tag">The authentication tag. Must be exactly 16 bytes.</param>
+        /// <param name="plaintext">
+        /// The output buffer for the key. Must be at least as large as <paramref name="ciphertext"/>, and
+        /// is zeroed if the tag does not verify. May be the same memory as <paramref name="ciphertext"/>,
+        /// but must not otherwise overlap it.
+        /// </param>
+        /// <param name="associatedData">Optional additional authenticated data (must match the data used when wrapping).</param>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentException">Parameter sizes are invalid, or the buffers partially overlap.</exception>
+        /// <exception cref="CryptographicException">Unwrapping failed or the authentication tag is invalid.</exception>
+        public void Unwrap(
+            ReadOnlySpan<byte> ciphertext,
+            ReadOnlySpan<byte> tag,
+            Span<byte> plaintext,
+            ReadOnlySpan<byte> associatedData = default)
+        {
+            if (!TryUnwrap(ciphertext, tag, plaintext, associatedData))
+                throw new CryptographicException($"Key unwrap failed with error code: {AESGCMSIV_ERROR_DECRYPT_FAILED}");
+        }
+
+        /// <summary>
+        /// Attempts to unwrap and authenticate a key, reporting a forged or corrupted key through the
+        /// return value instead of an exception.
+        /// </summary>
+        /// <param name="ciphertext">The wrapped key.</param>
+        /// <param name="tag">The authentication tag. Must be exactly 16 bytes.</param>
+        /// <param name="plaintext">
+        /// The output buffer for the key. Must be at least as large as <paramref name="ciphertext"/>, and
+        /// is zeroed if the tag does not verify.
+        /// </param>
+        /// <param name="associatedData">Optional additional authenticated data (must match the data used when wrapping).</param>
+        /// <returns><see langword="true"/> if the tag verified; otherwise <see langword="false"/>.</returns>
+        /// <exception cref="ObjectDisposedException">The object has been disposed.</exception>
+        /// <exception cref="ArgumentException">Parameter sizes are invalid, or the buffers partially overlap.</exception>
+        /// <exception cref="CryptographicException">Unwrapping failed for a reason other than authentication.</exception>
+        public bool TryUnwrap(
+            ReadOnlySpan<byte> ciphertext,
+            ReadOnlySpan<byte> tag,
+            Span<byte> plaintext,
+            ReadOnlySpan<byte> associatedData = default)
+        {
+            ThrowIfDisposed();
+            ValidateSpans(ciphertext, plaintext, nameof(plaintext));
+            if (tag.Length != TagSize)
+                throw new ArgumentException($"Tag must be exactly {TagSize} bytes.", nameof(tag));
+
+            int result = Run(decrypt: true, ciphertext, plaintext, tag, associatedData);
+            if (result == AESGCMSIV_ERROR_DECRYPT_FAILED)
+                return false;
+            if (result != AESGCMSIV_SUCCESS)
+                throw new CryptographicException($"Key unwrap failed with error code: {result}");
+            return true;
+        }
+
+        /// <summary>
+        /// Clears the derived keys and frees the native context.
+        /// </summary>
+        public void Dispose()
+        {
+            if (!_disposed)
+            {
+                _context.Dispose();
+                _disposed = true;
+            }
+        }
+
+        private static void ValidateSpans(ReadOnlySpan<byte> input, ReadOnlySpan<byte> output, string outputName)
+        {
+            if (output.Length < input.Length)
+                throw new ArgumentException("Output buffer is too small.", outputName);
+            if (input.Overlaps(output, out int offset) && offset != 0)
+                throw new ArgumentException("Input and output buffers must be the same memory or not overlap.", outputName);
+        }
+
+        // The tag is written when wrapping and read when unwrapping
+        private int Run(
+            bool decrypt, ReadOnlySpan<byte> input, Span<byte> output, ReadOnlySpan<byte> tag,
+            ReadOnlySpan<byte> associatedData)
+        {
+            long started = AesGcmSivMetrics.IsEnabled ? Stopwatch.GetTimestamp() : 0;
+            int result;
+            bool added = false;
+            _context.DangerousAddRef(ref added);
+            try
+            {
+                IntPtr ctx = _context.DangerousGetHandle();
+                fixed (byte* inputPtr = &AesGcmSiv.BufferReference(input))
+                fixed (byte* outputPtr = &AesGcmSiv.BufferReference(output))
+                fixed (byte* aad = associatedData)
+                fixed (byte* tagPtr = tag)
+                {
+                    result = decrypt
+                        ? AesGcmSivNative.Unwrap(ctx, inputPtr, (nuint)input.Length, aad, (nuint)associatedData.Length, tagPtr, outputPtr)
+                        : AesGcmSivNative.Wrap(ctx, inputPtr, (nuint)input.Length, aad, (nuint)associatedData.Length, outputPtr, tagPtr);
+                }
+            }
+            finally
+            {
+                _context.DangerousRelease();
+            }
+
+            if (started != 0)
+                AesGcmSivMetrics.Record(decrypt, result, input.Length, started);
+            return result;
+        }
+
+        private void ThrowIfDisposed()
+        {
+            if (_disposed)
+                throw new ObjectDisposedException(nameof(AesGcmSivKeyWrap));
+        }
+    }
+}
@@ -0,0 +1,421 @@
+using System.Diagnostics.CodeAnalysis;
+using System.Numerics;
+using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
+using System.Runtime.Intrinsics;
+using System.Runtime.Intrinsics.Arm;
+using System.Runtime.Intrinsics.X86;
+using ArmAes = System.Runtime.Intrinsics.Arm.Aes;
+using X86Aes = System.Runtime.Intrinsics.X86.Aes;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// AES-GCM-SIV (RFC 8452) in managed code, on AES-NI and PCLMULQDQ or on the ARMv8 AES and PMULL
+    /// instructions. Used by
+    /// <see cref="AesGcmSivImplementation.Auto"/> for short messages, where the fixed cost of a call
+    /// into the native library outweighs the cipher itself, and by
+    /// <see cref="AesGcmSivImplementation.Managed"/> where the library cannot be deployed.
+    /// </summary>
+    /// <remarks>
+    /// Follows the structure of the native aesni kernel: the key-generating key schedule is expanded
+    /// once, each message derives its own authentication and encryption keys, POLYVAL runs one block
+    /// at a time and CTR four blocks at a time. Each primitive has an x86 and an Arm body; the JIT
+    /// keeps only the one the processor supports. Callers validate the parameters. Like the native
+    /// context, an instance is immutable after construction and safe to share between threads.
+    /// </remarks>
+    internal sealed class AesGcmSivManaged : IDisposable
+    {
+        private const int AESGCMSIV_SUCCESS = 0;
+        private const int AESGCMSIV_ERROR_DECRYPT_FAILED = -5;
+
+        private const int BlockSize = 16;
+        private const int MaxRounds = 14;
+
+        // Reduction constant of the POLYVAL field, x^128 + x^127 + x^126 + x^121 + 1
+        private static readonly Vector128<ulong> s_polynomial = Vector128.Create(1ul, 0xc200000000000000ul);
+
+        private readonly Vector128<byte>[] _keySchedule = new Vector128<byte>[MaxRounds + 1];
+        private readonly int _rounds;
+
+        /// <summary>Whether this process can run the managed implementation.</summary>
+        internal static bool IsSupported =>
+            (X86Aes.IsSupported && Pclmulqdq.IsSupported) || (ArmAes.IsSupported && AdvSimd.IsSupported);
+
+        /// <param name="key">A 16- or 32-byte key.</param>
+        internal AesGcmSivManaged(ReadOnlySpan<byte> key)
+        {
+            _rounds = ExpandKey(key, _keySchedule);
+        }
+
+        /// <summary>Copies the key schedule of <paramref name="source"/> instead of expanding the key again.</summary>
+        internal AesGcmSivManaged(AesGcmSivManaged source)
+        {
+            source._keySchedule.CopyTo(_keySchedule, 0);
+            _rounds = source._rounds;
+        }
+
+        /// <summary>
+        /// Encrypts <paramref name="plaintext"/> into <paramref name="ciphertext"/>, which may be the
+        /// same memory, and writes the tag to the first 16 bytes of <paramref name="tag"/>.
+        /// </summary>
+        /// <returns>The native status code for success, so callers treat both implementations alike.</returns>
+        internal int Encrypt(
+            ReadOnlySpan<byte> nonce, ReadOnlySpan<byte> plaintext, Span<byte> ciphertext, Span<byte> tag,
+            ReadOnlySpan<byte> associatedData)
+        {
+            Span<Vector128<byte>> encryptionKey = stackalloc Vector128<byte>[MaxRounds + 1];
+            int rounds = DeriveKeys(nonce, encryptionKey, out Vector128<ulong> authenticationKey);
+
+            // The tag covers the plaintext, so it is computed before an in-place
+            // call overwrites it
+            Vector128<byte> computed = ComputeTag(
+                authenticationKey, encryptionKey, rounds, nonce, plaintext, associatedData);
+            Ctr(encryptionKey, rounds, computed, plaintext, ciphertext);
+            computed.StoreUnsafe(ref MemoryMarshal.GetReference(tag));
+
+            CryptographicOperations.ZeroMemory(MemoryMarshal.AsBytes(encryptionKey));
+            return AESGCMSIV_SUCCESS;
+        }
+
+        /// <summary>
+        /// Decrypts <paramref name="ciphertext"/> into <paramref name="plaintext"/>, which may be the
+        /// same memory, and zeroes the plaintext if <paramref name="tag"/> does not verify.
+        /// </summary>
+        /// <returns>The native status code for success or for an authentication failure.</returns>
+        internal int Decrypt(
+            ReadOnlySpan<byte> nonce, ReadOnlySpan<byte> ciphertext, ReadOnlySpan<byte> tag, Span<byte> plaintext,
+            ReadOnlySpan<byte> associatedData)
+        {
+            Span<Vector128<byte>> encryptionKey = stackalloc Vector128<byte>[MaxRounds + 1];
+            int rounds = DeriveKeys(nonce, encryptionKey, out Vector128<ulong> authenticationKey);
+
+            Vector128<byte> expected = Vector128.Create(tag);
+            Span<byte> output = plaintext.Slice(0, ciphertext.Length);
+            Ctr(encryptionKey, rounds, expected, ciphertext, output);
+            Vector128<byte> computed = ComputeTag(
+                authenticationKey, encryptionKey, rounds, nonce, output, associatedData);
+            CryptographicOperations.ZeroMemory(MemoryMarshal.AsBytes(encryptionKey));
+
+            Span<byte> computedBytes = stackalloc byte[BlockSize];
+            computed.CopyTo(computedBytes);
+            if (!CryptographicOperations.FixedTimeEquals(computedBytes, tag))
+            {
+                CryptographicOperations.ZeroMemory(output);
+                return AESGCMSIV_ERROR_DECRYPT_FAILED;
+            }
+            return AESGCMSIV_SUCCESS;
+        }
+
+        /// <summary>Clears the key schedule.</summary>
+        public void Dispose() =>
+            CryptographicOperations.ZeroMemory(MemoryMarshal.AsBytes(_keySchedule.AsSpan()));
+
+        // RFC 8452 section 4: the low halves of AES(K, le32(i) || nonce) for
+        // i = 0, 1 form the authentication key and the following two or four
+        // the encryption key, whose schedule is expanded into encryptionKey.
+        // Returns its round count.
+        private int DeriveKeys(
+            ReadOnlySpan<byte> nonce, Span<Vector128<byte>> encryptionKey, out Vector128<ulong> authenticationKey)
+        {
+            Span<byte> block = stackalloc byte[BlockSize];
+            block.Slice(0, 4).Clear();
+            nonce.CopyTo(block.Slice(4));
+            Vector128<uint> counter = Vector128.Create<byte>(block).AsUInt32();
+
+            authenticationKey = Vector128.Create(Derive(counter, 0), Derive(counter, 1));
+            Vector128<byte> low = Vector128.Create(Derive(counter, 2), Derive(counter, 3)).AsByte();
+            if (_rounds == 10)
+                return ExpandKey(low, default, key256: false, encryptionKey);
+            Vector128<byte> high = Vector128.Create(Derive(counter, 4), Derive(counter, 5)).AsByte();
+            return ExpandKey(low, high, key256: true, encryptionKey);
+        }
+
+        private Vector64<ulong> Derive(Vector128<uint> counter, uint i) =>
+            EncryptBlock(counter.WithElement(0, i).AsByte(), _keySchedule, _rounds).AsUInt64().GetLower();
+
+        private static int ExpandKey(ReadOnlySpan<byte> key, Span<Vector128<byte>> schedule) =>
+            key.Length == 16
+                ? ExpandKey(Vector128.Create(key), default, key256: false, schedule)
+                : ExpandKey(Vector128.Create(key), Vector128.Create(key.Slice(16)), key256: true, schedule);
+
+        // Returns the round count
+        private static int ExpandKey(Vector128<byte> k0, Vector128<byte> k1, bool key256, Span<Vector128<byte>> schedule)
+        {
+            if (!X86Aes.IsSupported)
+                ExpandWords(k0, k1, key256, schedule);
+            else if (key256)
+                Expand256(k0, k1, schedule);
+            else
+                Expand128(k0, schedule);
+            return key256 ? 14 : 10;
+        }
+
+        // The FIPS 197 expansion one word at a time, for Arm, which has no
+        // KeygenAssist; AESE with a zero round key supplies SubWord
+        private static void ExpandWords(Vector128<byte> k0, Vector128<byte> k1, bool key256, Span<Vector128<byte>> schedule)
+        {
+            int nk = key256 ? 8 : 4;
+            int rounds = key256 ? 14 : 10;
+            Span<uint> words = stackalloc uint[4 * (MaxRounds + 1)];
+            k0.AsUInt32().CopyTo(words);
+            if (key256)
+                k1.AsUInt32().CopyTo(words.Slice(4));
+
+            uint rcon = 1;
+            for (int i = nk; i < 4 * (rounds + 1); i++)
+            {
+                uint t = words[i - 1];
+                if (i % nk == 0)
+                {
+                    t = SubWord(BitOperations.RotateRight(t, 8)) ^ rcon;
+                    rcon = (rcon << 1) ^ ((rcon >> 7) * 0x11b);
+                }
+                else if (nk == 8 && i % nk == 4)
+                {
+                    t = SubWord(t);
+                }
+                words[i] = words[i - nk] ^ t;
+            }
+
+            for (int r = 0; r <= rounds; r++)
+                schedule[r] = Vector128.Create<uint>(words.Slice(4 * r, 4)).AsByte();
+            CryptographicOperations.ZeroMemory(MemoryMarshal.AsBytes(words));
+        }
+
+        // With the word in every column ShiftRows moves nothing, so AESE
+        // leaves just the S-box applied to each byte
+        [MethodImpl(MethodImplOptions.AggressiveInlining)]
+        private static uint SubWord(uint word) =>
+            ArmAes.Encrypt(Vector128.Create(word).AsByte(), Vector128<byte>.Zero).AsUInt32().ToScalar();
+
+        // KeygenAssist takes its round constant as an immediate, hence the unrolling
+        private static void Expand128(Vector128<byte> key, Span<Vector128<byte>> schedule)
+        {
+            schedule[0] = key;
+            schedule[1] = key = ExpandStep(key, X86Aes.KeygenAssist(key, 0x01), 0xff);
+            schedule[2] = key = ExpandStep(key, X86Aes.KeygenAssist(key, 0x02), 0xff);
+            schedule[3] = key = ExpandStep(key, X86Aes.KeygenAssist(key, 0x04), 0xff);
+            schedule[4] = key = ExpandStep(key, X86Aes.KeygenAssist(key, 0x08), 0xff);
+            schedule[5] = key = ExpandStep(key, X86Aes.KeygenAssist(key, 0x10), 0xff);
+            schedule[6] = key = ExpandStep(key, X86Aes.KeygenAssist(key, 0x20), 0xff);
+            schedule[7] = key = ExpandStep(key, X86Aes.KeygenAssist(key, 0x40), 0xff);
+            schedule[8] = key = ExpandStep(key, X86Aes.KeygenAssist(key, 0x80), 0xff);
+            schedule[9] = key = ExpandStep(key, X86Aes.KeygenAssist(key, 0x1b), 0xff);
+            schedule[10] = ExpandStep(key, X86Aes.KeygenAssist(key, 0x36), 0xff);
+        }
+
+        // Each round constant yields two round keys: the first mixes in the
+        // rotated, substituted last word of the other half, the second only
+        // the substituted one
+        private static void Expand256(Vector128<byte> k0, Vector128<byte> k1, Span<Vector128<byte>> schedule)
+        {
+            schedule[0] = k0;
+            schedule[1] = k1;
+            schedule[2] = k0 = ExpandStep(k0, X86Aes.KeygenAssist(k1, 0x01), 0xff);
+            schedule[3] = k1 = ExpandStep(k1, X86Aes.KeygenAssist(k0, 0x00), 0xaa);
+            schedule[4] = k0 = ExpandStep(k0, X86Aes.KeygenAssist(k1, 0x02), 0xff);
+            schedule[5] = k1 = ExpandStep(k1, X86Aes.KeygenAssist(k0, 0x00), 0xaa);
+            schedule[6] = k0 = ExpandStep(k0, X86Aes.KeygenAssist(k1, 0x04), 0xff);
+            schedule[7] = k1 = ExpandStep(k1, X86Aes.KeygenAssist(k0, 0x00), 0xaa);
+            schedule[8] = k0 = ExpandStep(k0, X86Aes.KeygenAssist(k1, 0x08), 0xff);
+            schedule[9] = k1 = ExpandStep(k1, X86Aes.KeygenAssist(k0, 0x00), 0xaa);
+            schedule[10] = k0 = ExpandStep(k0, X86Aes.KeygenAssist(k1, 0x10), 0xff);
+            schedule[11] = k1 = ExpandStep(k1, X86Aes.KeygenAssist(k0, 0x00), 0xaa);
+            schedule[12] = k0 = ExpandStep(k0, X86Aes.KeygenAssist(k1, 0x20), 0xff);
+            schedule[13] = ExpandStep(k1, X86Aes.KeygenAssist(k0, 0x00), 0xaa);
+            schedule[14] = ExpandStep(k0, X86Aes.KeygenAssist(schedule[13], 0x40), 0xff);
+        }
+
+        [MethodImpl(MethodImplOptions.AggressiveInlining)]
+        private static Vector128<byte> ExpandStep(Vector128<byte> key, Vector128<byte> assist, [ConstantExpected] byte word)
+        {
+            assist = Sse2.Shuffle(assist.AsUInt32(), word).AsByte();
+            Vector128<byte> shifted = Sse2.ShiftLeftLogical128BitLane(key, 4);
+            key ^= shifted;
+            shifted = Sse2.ShiftLeftLogical128BitLane(shifted, 4);
+            key ^= shifted;
+            shifted = Sse2.ShiftLeftLogical128BitLane(shifted, 4);
+            return key ^ shifted ^ assist;
+        }
+
+        [MethodImpl(MethodImplOptions.AggressiveInlining)]
+        private static Vector128<byte> EncryptBlock(Vector128<byte> block, ReadOnlySpan<Vector128<byte>> schedule, int rounds)
+        {
+            if (!X86Aes.IsSupported)
+            {
+                // AESE adds the round key before substituting, so the last
+                // key is added on its own
+                for (int i = 0; i < rounds - 1; i++)
+                    block = ArmAes.MixColumns(ArmAes.Encrypt(block, schedule[i]));
+                return ArmAes.Encrypt(block, schedule[rounds - 1]) ^ schedule[rounds];
+            }
+
+            block ^= schedule[0];
+            for (int i = 1; i < rounds; i++)
+                block = X86Aes.Encrypt(block, schedule[i]);
+            return X86Aes.EncryptLast(block, schedule[rounds]);
+        }
+
+        // EncryptBlock on four independent blocks, interleaved so that their
+        // rounds overlap in the pipeline
+        [MethodImpl(MethodImplOptions.AggressiveInlining)]
+        private static void EncryptFour(
+            ref Vector128<byte> b0, ref Vector128<byte> b1, ref Vector128<byte> b2, ref Vector128<byte> b3,
+            ReadOnlySpan<Vector128<byte>> schedule, int rounds)
+        {
+            if (!X86Aes.IsSupported)
+            {
+                for (int i = 0; i < rounds - 1; i++)
+                {
+                    b0 = ArmAes.MixColumns(ArmAes.Encrypt(b0, schedule[i]));
+                    b1 = ArmAes.MixColumns(ArmAes.Encrypt(b1, schedule[i]));
+                    b2 = ArmAes.MixColumns(ArmAes.Encrypt(b2, schedule[i]));
+                    b3 = ArmAes.MixColumns(ArmAes.Encrypt(b3, schedule[i]));
+                }
+                b0 = ArmAes.Encrypt(b0, schedule[rounds - 1]) ^ schedule[rounds];
+                b1 = ArmAes.Encrypt(b1, schedule[rounds - 1]) ^ schedule[rounds];
+                b2 = ArmAes.Encrypt(b2, schedule[rounds - 1]) ^ schedule[rounds];
+                b3 = ArmAes.Encrypt(b3, schedule[rounds - 1]) ^ schedule[rounds];
+                return;
+            }
+
+            b0 ^= schedule[0];
+            b1 ^= schedule[0];
+            b2 ^= schedule[0];
+            b3 ^= schedule[0];
+            for (int i = 1; i < rounds; i++)
+            {
+                b0 = X86Aes.Encrypt(b0, schedule[i]);
+                b1 = X86Aes.Encrypt(b1, schedule[i]);
+                b2 = X86Aes.Encrypt(b2, schedule[i]);
+                b3 = X86Aes.Encrypt(b3, schedule[i]);
+            }
+            b0 = X86Aes.EncryptLast(b0, schedule[rounds]);
+            b1 = X86Aes.EncryptLast(b1, schedule[rounds]);
+            b2 = X86Aes.EncryptLast(b2, schedule[rounds]);
+            b3 = X86Aes.EncryptLast(b3, schedule[rounds]);
+        }
+
+        // Tag = AES(encryption key, POLYVAL(aad || message || lengths) ^ nonce,
+        // with the top bit cleared)
+        private static Vector128<byte> ComputeTag(
+            Vector128<ulong> h, ReadOnlySpan<Vector128<byte>> encryptionKey, int rounds,
+            ReadOnlySpan<byte> nonce, ReadOnlySpan<byte> message, ReadOnlySpan<byte> associatedData)
+        {
+            Vector128<ulong> s = Vector128<ulong>.Zero;
+            s = Polyval(s, h, associatedData);
+            s = Polyval(s, h, message);
+            s = Dot(s ^ Vector128.Create((ulong)associatedData.Length * 8, (ulong)message.Length * 8), h);
+
+            Span<byte> block = stackalloc byte[BlockSize];
+            nonce.CopyTo(block);
+            block.Slice(nonce.Length).Clear();
+            Vector128<byte> input = s.AsByte() ^ Vector128.Create<byte>(block);
+            input &= Vector128.Create((byte)0xff).WithElement(15, (byte)0x7f);
+            return EncryptBlock(input, encryptionKey, rounds);
+        }
+
+        // Absorbs data, zero-padded to a whole number of blocks
+        private static Vector128<ulong> Polyval(Vector128<ulong> s, Vector128<ulong> h, ReadOnlySpan<byte> data)
+        {
+            ref byte start = ref MemoryMarshal.GetReference(data);
+            int whole = data.Length & ~(BlockSize - 1);
+            for (int i = 0; i < whole; i += BlockSize)
+                s = Dot(s ^ Vector128.LoadUnsafe(ref start, (nuint)i).AsUInt64(), h);
+
+            if (whole < data.Length)
+            {
+                Span<byte> last = stackalloc byte[BlockSize];
+                last.Clear();
+                data.Slice(whole).CopyTo(last);
+                s = Dot(s ^ Vector128.Create<byte>(last).AsUInt64(), h);
+            }
+            return s;
+        }
+
+        // a * b * x^-128 in the POLYVAL field: a schoolbook carry-less
+        // multiply, then two folds of the low half by the reduction constant
+        [MethodImpl(MethodImplOptions.AggressiveInlining)]
+        private static Vector128<ulong> Dot(Vector128<ulong> a, Vector128<ulong> b)
+        {
+            if (!X86Aes.IsSupported)
+                return DotArm(a, b);
+
+            Vector128<ulong> low = Pclmulqdq.CarrylessMultiply(a, b, 0x00);
+            Vector128<ulong> high = Pclmulqdq.CarrylessMultiply(a, b, 0x11);
+            Vector128<ulong> middle = Pclmulqdq.CarrylessMultiply(a, b, 0x01) ^ Pclmulqdq.CarrylessMultiply(a, b, 0x10);
+            low ^= Sse2.ShiftLeftLogical128BitLane(middle, 8);
+            high ^= Sse2.ShiftRightLogical128BitLane(middle, 8);
+
+            Vector128<ulong> fold = Pclmulqdq.CarrylessMultiply(low, s_polynomial, 0x10);
+            low = Sse2.Shuffle(low.AsUInt32(), 0x4e).AsUInt64() ^ fold;
+            fold = Pclmulqdq.CarrylessMultiply(low, s_polynomial, 0x10);
+            low = Sse2.Shuffle(low.AsUInt32(), 0x4e).AsUInt64() ^ fold;
+            return high ^ low;
+        }
+
+        // Dot with PMULL and PMULL2 in place of PCLMULQDQ, and EXT to swap halves
+        [MethodImpl(MethodImplOptions.AggressiveInlining)]
+        private static Vector128<ulong> DotArm(Vector128<ulong> a, Vector128<ulong> b)
+        {
+            Vector128<ulong> low = ArmAes.PolynomialMultiplyWideningLower(a.GetLower(), b.GetLower());
+            Vector128<ulong> high = ArmAes.PolynomialMultiplyWideningUpper(a, b);
+            Vector128<ulong> middle = ArmAes.PolynomialMultiplyWideningLower(a.GetUpper(), b.GetLower()) ^
+                ArmAes.PolynomialMultiplyWideningLower(a.GetLower(), b.GetUpper());
+            low ^= Vector128.Create(Vector64<ulong>.Zero, middle.GetLower());
+            high ^= Vector128.Create(middle.GetUpper(), Vector64<ulong>.Zero);
+
+            Vector64<ulong> reduction = s_polynomial.GetUpper();
+            Vector128<ulong> fold = ArmAes.PolynomialMultiplyWideningLower(low.GetLower(), reduction);
+            low = AdvSimd.ExtractVector128(low, low, 1) ^ fold;
+            fold = ArmAes.PolynomialMultiplyWideningLower(low.GetLower(), reduction);
+            low = AdvSimd.ExtractVector128(low, low, 1) ^ fold;
+            return high ^ low;
+        }
+
+        // AES-CTR from the tag with its top bit set, counting in the low 32
+        // bits, little-endian and wrapping
+        private static void Ctr(
+            ReadOnlySpan<Vector128<byte>> key, int rounds, Vector128<byte> tag,
+            ReadOnlySpan<byte> input, Span<byte> output)
+        {
+            Vector128<uint> counter = (tag | Vector128<byte>.Zero.WithElement(15, (byte)0x80)).AsUInt32();
+            Vector128<uint> one = Vector128.Create(1u, 0, 0, 0);
+            ref byte source = ref MemoryMarshal.GetReference(input);
+            ref byte destination = ref MemoryMarshal.GetReference(output);
+            int length = input.Length;
+            int i = 0;
+
+            for (; i + 4 * BlockSize <= length; i += 4 * BlockSize)
+            {
+                Vector128<byte> b0 = counter.AsByte();
+                Vector128<byte> b1 = (counter + one).AsByte();
+                Vector128<byte> b2 = (counter + one + one).AsByte();
+                Vector128<byte> b3 = (counter + one + one + one).AsByte();
+                counter += one + one + one + one;
+                EncryptFour(ref b0, ref b1, ref b2, ref b3, key, rounds);
+                (Vector128.LoadUnsafe(ref source, (nuint)i) ^ b0).StoreUnsafe(ref destination, (nuint)i);
+                (Vector128.LoadUnsafe(ref source, (nuint)(i + 16)) ^ b1).StoreUnsafe(ref destination, (nuint)(i + 16));
+                (Vector128.LoadUnsafe(ref source, (nuint)(i + 32)) ^ b2).StoreUnsafe(ref destination, (nuint)(i + 32));
+                (Vector128.LoadUnsafe(ref source, (nuint)(i + 48)) ^ b3).StoreUnsafe(ref destination, (nuint)(i + 48));
+            }
+
+            for (; i + BlockSize <= length; i += BlockSize)
+            {
+                Vector128<byte> keystream = EncryptBlock(counter.AsByte(), key, rounds);
+                counter += one;
+                (Vector128.LoadUnsafe(ref source, (nuint)i) ^ keystream).StoreUnsafe(ref destination, (nuint)i);
+            }
+
+            if (i < length)
+            {
+                Span<byte> last = stackalloc byte[BlockSize];
+                input.Slice(i).CopyTo(last);
+                (Vector128.Create<byte>(last) ^ EncryptBlock(counter.AsByte(), key, rounds)).CopyTo(last);
+                last.Slice(0, length - i).CopyTo(output.Slice(i));
+                CryptographicOperations.ZeroMemory(last);
+            }
+        }
+    }
+}
@@ -0,0 +1,88 @@
+using System.IO.MemoryMappedFiles;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// A whole file mapped into memory, so its bytes can be handed to <see cref="AesGcmSiv"/> as spans
+    /// over the mapping with no copy through a managed buffer. An empty file is opened but not mapped,
+    /// since a mapping cannot be empty.
+    /// </summary>
+    internal sealed unsafe class AesGcmSivMappedFile : IDisposable
+    {
+        private readonly FileStream _file;
+        private readonly MemoryMappedFile? _mapping;
+        private readonly MemoryMappedViewAccessor? _view;
+        private readonly byte* _pointer;
+
+        private AesGcmSivMappedFile(FileStream file, bool write)
+        {
+            _file = file;
+            Length = file.Length;
+            if (Length == 0)
+                return;
+
+            var access = write ? MemoryMappedFileAccess.ReadWrite : MemoryMappedFileAccess.Read;
+            try
+            {
+                _mapping = MemoryMappedFile.CreateFromFile(file, null, Length, access, HandleInheritability.None, leaveOpen: true);
+                _view = _mapping.CreateViewAccessor(0, Length, access);
+                byte* pointer = null;
+                _view.SafeMemoryMappedViewHandle.AcquirePointer(ref pointer);
+                _pointer = pointer + _view.PointerOffset;
+            }
+            catch
+            {
+                Dispose();
+                throw;
+            }
+        }
+
+        public long Length { get; }
+
+        /// <summary>Maps an existing file for reading, hinting that it is read once, in order.</summary>
+        public static AesGcmSivMappedFile Open(string path) =>
+            new(new FileStream(path, FileMode.Open, FileAccess.Read, FileShare.Read, 1, FileOptions.SequentialScan), write: false);
+
+        /// <summary>
+        /// Creates a file of exactly <paramref name="length"/> bytes and maps it for writing. An existing
+        /// file is replaced, or if <paramref name="replace"/> is false, fails the call.
+        /// </summary>
+        public static AesGcmSivMappedFile Create(string path, long length, bool replace = true)
+        {
+            var file = new FileStream(
+                path, replace ? FileMode.Create : FileMode.CreateNew, FileAccess.ReadWrite, FileShare.None, 1, FileOptions.SequentialScan);
+            try
+            {
+                file.SetLength(length);
+                return new AesGcmSivMappedFile(file, write: true);
+            }
+            catch
+            {
+                file.Dispose();
+                throw;
+            }
+        }
+
+        /// <summary>The start of the mapping, for lengths a span cannot hold; null for an empty file.</summary>
+        public byte* Pointer => _pointer;
+
+        public Span<byte> GetSpan(long offset, int length)
+        {
+            if ((ulong)offset > (ulong)Length || (ulong)length > (ulong)(Length - offset))
+                throw new ArgumentOutOfRangeException(nameof(length));
+            return length == 0 ? Span<byte>.Empty : new Span<byte>(_pointer + offset, length);
+        }
+
+        public void Dispose()
+        {
+            if (_view != null)
+            {
+                if (_pointer != null)
+                    _view.SafeMemoryMappedViewHandle.ReleasePointer();
+                _view.Dispose();
+            }
+            _mapping?.Dispose();
+            _file.Dispose();
+        }
+    }
+}
@@ -0,0 +1,202 @@
+using System.Diagnostics;
+using System.Diagnostics.Metrics;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// The instruments published on the <see cref="AesGcmSiv.MeterName"/> meter. Every entry point
+    /// checks <see cref="IsEnabled"/> first and, while nothing listens, goes straight to native code
+    /// without reading the clock.
+    /// </summary>
+    /// <remarks>
+    /// <list type="bullet">
+    /// <item><description><c>aesgcmsiv.encryptions</c> and <c>aesgcmsiv.decryptions</c>: messages processed, whether or not they succeeded</description></item>
+    /// <item><description><c>aesgcmsiv.bytes</c>: plaintext or ciphertext bytes of the messages that succeeded, tagged with <c>aesgcmsiv.operation</c></description></item>
+    /// <item><description><c>aesgcmsiv.duration</c>: seconds per call, tagged with <c>aesgcmsiv.operation</c> and <c>aesgcmsiv.size</c>, the message size bucket</description></item>
+    /// <item><description><c>aesgcmsiv.authentication_failures</c>: messages rejected because their tag did not verify</description></item>
+    /// </list>
+    /// A batch adds each of its messages to the counters but records one duration, under the bucket
+    /// of its largest message. Asynchronous calls are timed from submission to completion.
+    ///
+    /// Once an <see cref="AesGcmSivHealthProbe"/> has measured, two gauges report its latest reading,
+    /// tagged with <c>aesgcmsiv.backend</c>:
+    /// <list type="bullet">
+    /// <item><description><c>aesgcmsiv.probe.cycles_per_byte</c>: cycles per byte of the probe's fastest run</description></item>
+    /// <item><description><c>aesgcmsiv.probe.degraded</c>: 1 if that was slower than expected for the backend, else 0</description></item>
+    /// </list>
+    /// </remarks>
+    internal static class AesGcmSivMetrics
+    {
+        internal const string OperationTag = "aesgcmsiv.operation";
+        internal const string SizeTag = "aesgcmsiv.size";
+        internal const string BackendTag = "aesgcmsiv.backend";
+
+        private const int AESGCMSIV_SUCCESS = 0;
+        private const int AESGCMSIV_ERROR_DECRYPT_FAILED = -5;
+
+        private static readonly Meter s_meter = new(
+            AesGcmSiv.MeterName, typeof(AesGcmSivMetrics).Assembly.GetName().Version?.ToString());
+
+        private static readonly Counter<long> s_encryptions = s_meter.CreateCounter<long>(
+            "aesgcmsiv.encryptions", "{message}", "Messages encrypted, including failed calls.");
+
+        private static readonly Counter<long> s_decryptions = s_meter.CreateCounter<long>(
+            "aesgcmsiv.decryptions", "{message}", "Messages decrypted, including failed calls.");
+
+        private static readonly Counter<long> s_bytes = s_meter.CreateCounter<long>(
+            "aesgcmsiv.bytes", "By", "Plaintext or ciphertext bytes of the messages that succeeded.");
+
+        private static readonly Histogram<double> s_duration = s_meter.CreateHistogram(
+            "aesgcmsiv.duration", "s", "Duration of encrypt and decrypt calls.",
+            advice: new InstrumentAdvice<double>
+            {
+                HistogramBucketBoundaries = new[]
+                {
+                    1e-7, 2.5e-7, 5e-7, 1e-6, 2.5e-6, 5e-6, 1e-5, 2.5e-5, 5e-5,
+                    1e-4, 2.5e-4, 5e-4, 1e-3, 2.5e-3, 1e-2, 0.1, 1,
+                },
+            });
+
+        private static readonly Counter<long> s_authenticationFailures = s_meter.CreateCounter<long>(
+            "aesgcmsiv.authentication_failures", "{message}", "Messages whose tag did not verify.");
+
+        private static readonly KeyValuePair<string, object?> s_encryptTag = new(OperationTag, "encrypt");
+        private static readonly KeyValuePair<string, object?> s_decryptTag = new(OperationTag, "decrypt");
+
+        // Upper bounds of the size buckets, each labelled by the matching entry of s_sizeTags
+        private static readonly long[] s_sizeBounds = { 64, 256, 1024, 16 * 1024, 1024 * 1024 };
+
+        private static readonly KeyValuePair<string, object?>[] s_sizeTags =
+        {
+            new(SizeTag, "<=64B"),
+            new(SizeTag, "<=256B"),
+            new(SizeTag, "<=1KiB"),
+            new(SizeTag, "<=16KiB"),
+            new(SizeTag, "<=1MiB"),
+            new(SizeTag, ">1MiB"),
+        };
+
+        // The latest probe reading, and whether its gauges exist yet
+        private static ProbeReading? s_probe;
+        private static int s_probeGauges;
+
+        /// <summary>Whether any instrument has a listener.</summary>
+        internal static bool IsEnabled =>
+            s_encryptions.Enabled || s_decryptions.Enabled || s_bytes.Enabled
+            || s_duration.Enabled || s_authenticationFailures.Enabled;
+
+        /// <summary>
+        /// Records one message of <paramref name="length"/> bytes that finished with the native status
+        /// <paramref name="result"/>, timed from <paramref name="started"/>, a <see cref="Stopwatch"/>
+        /// timestamp.
+        /// </summary>
+        internal static void Record(bool decrypt, int result, long length, long started)
+        {
+            TimeSpan elapsed = Stopwatch.GetElapsedTime(started);
+            KeyValuePair<string, object?> operation = decrypt ? s_decryptTag : s_encryptTag;
+            (decrypt ? s_decryptions : s_encryptions).Add(1);
+            if (result == AESGCMSIV_SUCCESS)
+                s_bytes.Add(length, operation);
+            else if (result == AESGCMSIV_ERROR_DECRYPT_FAILED)
+                s_authenticationFailures.Add(1);
+            s_duration.Record(elapsed.TotalSeconds, operation, SizeBucket(length));
+        }
+
+        /// <summary>
+        /// Records a batch that finished with the native status <paramref name="result"/>. When
+        /// decrypting, <paramref name="statuses"/> holds each item's status; when encrypting, every
+        /// item counts as succeeding if the batch did.
+        /// </summary>
+        internal static void RecordBatch(bool decrypt, ReadOnlySpan<AesGcmSivBatchItem> items, int[]? statuses, int result, long started)
+        {
+            TimeSpan elapsed = Stopwatch.GetElapsedTime(started);
+            KeyValuePair<string, object?> operation = decrypt ? s_decryptTag : s_encryptTag;
+            long bytes = 0;
+            long largest = 0;
+            int failures = 0;
+            for (int i = 0; i < items.Length; i++)
+            {
+                long length = items[i].Input.Length;
+                largest = Math.Max(largest, length);
+                int status = statuses != null ? statuses[i] : result;
+                if (status == AESGCMSIV_SUCCESS)
+                    bytes += length;
+                else if (status == AESGCMSIV_ERROR_DECRYPT_FAILED)
+                    failures++;
+            }
+
+            (decrypt ? s_decryptions : s_encryptions).Add(items.Length);
+            if (bytes != 0)
+                s_bytes.Add(bytes, operation);
+            if (failures != 0)
+                s_authenticationFailures.Add(failures);
+            s_duration.Record(elapsed.TotalSeconds, operation, SizeBucket(largest));
+        }
+
+        /// <summary>
+        /// Records <paramref name="count"/> messages laid out without batch items, such as pages or the
+        /// values of a column, where message <c>i</c> is <paramref name="length"/>(i) bytes, as
+        /// <see cref="RecordBatch"/> records a batch.
+        /// </summary>
+        internal static void RecordLayout(bool decrypt, int count, Func<int, long> length, int[]? statuses, int result, long started)
+        {
+            TimeSpan elapsed = Stopwatch.GetElapsedTime(started);
+            KeyValuePair<string, object?> operation = decrypt ? s_decryptTag : s_encryptTag;
+            long bytes = 0;
+            long largest = 0;
+            int failures = 0;
+            for (int i = 0; i < count; i++)
+            {
+                long itemLength = length(i);
+                largest = Math.Max(largest, itemLength);
+                int status = statuses != null ? statuses[i] : result;
+                if (status == AESGCMSIV_SUCCESS)
+                    bytes += itemLength;
+                else if (status == AESGCMSIV_ERROR_DECRYPT_FAILED)
+                    failures++;
+            }
+
+            (decrypt ? s_decryptions : s_encryptions).Add(count);
+            if (bytes != 0)
+                s_bytes.Add(bytes, operation);
+            if (failures != 0)
+                s_authenticationFailures.Add(failures);
+            s_duration.Record(elapsed.TotalSeconds, operation, SizeBucket(largest));
+        }
+
+        /// <summary>
+        /// Makes <paramref name="result"/> the reading the probe gauges report, creating them on the
+        /// first call. With several probes running, the latest measurement wins.
+        /// </summary>
+        internal static void RecordProbe(in AesGcmSivProbeResult result, bool degraded)
+        {
+            Volatile.Write(ref s_probe, new ProbeReading(
+                new KeyValuePair<string, object?>(BackendTag, result.Backend), result.CyclesPerByte, degraded));
+            if (Interlocked.Exchange(ref s_probeGauges, 1) != 0)
+                return;
+
+            s_meter.CreateObservableGauge(
+                "aesgcmsiv.probe.cycles_per_byte",
+                () => Volatile.Read(ref s_probe) is { } probe
+                    ? new[] { new Measurement<double>(probe.CyclesPerByte, probe.Backend) }
+                    : Array.Empty<Measurement<double>>(),
+                "{cycle}/By", "Cycles per byte of the latest health probe.");
+            s_meter.CreateObservableGauge(
+                "aesgcmsiv.probe.degraded",
+                () => Volatile.Read(ref s_probe) is { } probe
+                    ? new[] { new Measurement<int>(probe.Degraded ? 1 : 0, probe.Backend) }
+                    : Array.Empty<Measurement<int>>(),
+                null, "1 if the latest health probe was slower than expected for the backend.");
+        }
+
+        private static KeyValuePair<string, object?> SizeBucket(long length)
+        {
+            int bucket = 0;
+            while (bucket < s_sizeBounds.Length && length > s_sizeBounds[bucket])
+                bucket++;
+            return s_sizeTags[bucket];
+        }
+
+        private sealed record ProbeReading(KeyValuePair<string, object?> Backend, double CyclesPerByte, bool Degraded);
+    }
+}
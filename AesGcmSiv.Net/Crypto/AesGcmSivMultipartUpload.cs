@@ -0,0 +1,255 @@
+using System.Runtime.ExceptionServices;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Encrypts a stream in the chunked format of <see cref="AesGcmSivStream"/> as a series of parts for
+    /// a multipart upload to S3-compatible object storage, sealing parts in parallel while earlier ones
+    /// upload.
+    /// </summary>
+    /// <remarks>
+    /// Every part holds a whole number of chunks: <c>partSize / chunkSize</c> of them, and the first
+    /// part is preceded by the stream header. Concatenated in part-number order, the parts are exactly
+    /// the stream <see cref="AesGcmSivStream"/> would have written, so the stored object reads back with
+    /// <see cref="AesGcmSivStream"/> or <see cref="AesGcmSivRandomAccessReader"/>. Every part but the
+    /// last has the same sealed length, which is what multipart uploads require.
+    ///
+    /// The source is read one part at a time into a buffer of its own. Each part is then sealed by one
+    /// batch call on the native worker pool and handed to the upload callback, while the next part is
+    /// being read. At most <c>partsInFlight</c> parts are being read, sealed or uploaded at once, so
+    /// memory stays at that many parts however large the object is.
+    /// </remarks>
+    public static class AesGcmSivMultipartUpload
+    {
+        /// <summary>The plaintext part size used when none is given, 8 MiB.</summary>
+        public const int DefaultPartSize = 8 << 20;
+
+        /// <summary>The largest plaintext part size, 256 MiB.</summary>
+        public const int MaxPartSize = 1 << 28;
+
+        /// <summary>The number of parts in flight used when none is given.</summary>
+        public const int DefaultPartsInFlight = 4;
+
+        /// <summary>The most parts in flight.</summary>
+        public const int MaxPartsInFlight = 64;
+
+        private const int TagSize = 16;
+        private const int NonceSize = 12;
+        private const int AESGCMSIV_SUCCESS = 0;
+
+        /// <summary>
+        /// Encrypts everything read from <paramref name="source"/>, handing each sealed part to
+        /// <paramref name="uploadPart"/> as soon as it is ready.
+        /// </summary>
+        /// <param name="source">The plaintext, read to its end.</param>
+        /// <param name="aesGcmSiv">The key to use.</param>
+        /// <param name="uploadPart">
+        /// Uploads one part, given its part number, counted from 1, and its sealed bytes. The bytes are
+        /// valid only until the returned task completes. Calls for different parts may run at the same
+        /// time and finish in any order.
+        /// </param>
+        /// <param name="partSize">
+        /// Plaintext bytes per part, a multiple of <paramref name="chunkSize"/> up to
+        /// <see cref="MaxPartSize"/>. Each sealed part is 16 bytes per chunk longer, and the first is
+        /// <see cref="AesGcmSivStream.HeaderSize"/> bytes longer again. S3 needs every part but the last
+        /// to be at least 5 MiB.
+        /// </param>
+        /// <param name="chunkSize">Plaintext bytes per chunk, from 1 to <see cref="AesGcmSivStream.MaxChunkSize"/>.</param>
+        /// <param name="associatedData">Optional additional authenticated data, bound to every chunk.</param>
+        /// <param name="partsInFlight">The most parts held at once, from 1 to <see cref="MaxPartsInFlight"/>.</param>
+        /// <param name="cancellationToken">The token to monitor for cancellation requests.</param>
+        /// <returns>
+        /// A task that completes with the number of parts once every part has been uploaded. An empty
+        /// source still makes one part.
+        /// </returns>
+        /// <exception cref="ArgumentNullException"><paramref name="source"/>, <paramref name="aesGcmSiv"/> or <paramref name="uploadPart"/> is null.</exception>
+        /// <exception cref="ArgumentOutOfRangeException">
+        /// <paramref name="partSize"/>, <paramref name="chunkSize"/> or <paramref name="partsInFlight"/> is out of range,
+        /// or a part would hold too many chunks.
+        /// </exception>
+        /// <exception cref="ArgumentException"><paramref name="partSize"/> is not a multiple of <paramref name="chunkSize"/>.</exception>
+        /// <exception cref="CryptographicException">Encryption failed, or the stream has too many chunks.</exception>
+        /// <remarks>
+        /// Once reading, sealing or any upload fails, no further part is started, and the first failure
+        /// is thrown after the parts in flight have finished. The caller then aborts the multipart upload.
+        /// </remarks>
+        public static async Task<int> EncryptAsync(
+            Stream source,
+            AesGcmSiv aesGcmSiv,
+            Func<int, ReadOnlyMemory<byte>, CancellationToken, Task> uploadPart,
+            int partSize = DefaultPartSize,
+            int chunkSize = AesGcmSivStream.DefaultChunkSize,
+            byte[]? associatedData = null,
+            int partsInFlight = DefaultPartsInFlight,
+            CancellationToken cancellationToken = default)
+        {
+            ArgumentNullException.ThrowIfNull(source);
+            ArgumentNullException.ThrowIfNull(aesGcmSiv);
+            ArgumentNullException.ThrowIfNull(uploadPart);
+            ArgumentOutOfRangeException.ThrowIfNegativeOrZero(chunkSize);
+            ArgumentOutOfRangeException.ThrowIfGreaterThan(chunkSize, AesGcmSivStream.MaxChunkSize);
+            ArgumentOutOfRangeException.ThrowIfNegativeOrZero(partSize);
+            ArgumentOutOfRangeException.ThrowIfGreaterThan(partSize, MaxPartSize);
+            ArgumentOutOfRangeException.ThrowIfNegativeOrZero(partsInFlight);
+            ArgumentOutOfRangeException.ThrowIfGreaterThan(partsInFlight, MaxPartsInFlight);
+            if (partSize % chunkSize != 0)
+                throw new ArgumentException("The part size must be a multiple of the chunk size.", nameof(partSize));
+
+            int chunksPerPart = partSize / chunkSize;
+            int slotSize = chunkSize + TagSize;
+            if (AesGcmSivStream.HeaderSize + (long)chunksPerPart * slotSize > Array.MaxLength)
+                throw new ArgumentOutOfRangeException(nameof(partSize), "The part holds too many chunks; use larger chunks.");
+            var header = new byte[AesGcmSivStream.HeaderSize];
+            var prefix = new byte[AesGcmSivStream.PrefixSize];
+            AesGcmSivStream.WriteHeader(header, chunkSize, prefix);
+
+            // Every buffer has room ahead of its chunks for the header, which
+            // only the first part uses
+            using var pool = new AesGcmSivBufferPool(
+                partsInFlight, AesGcmSivStream.HeaderSize + chunksPerPart * slotSize, useNativeMemory: true);
+            using var free = new SemaphoreSlim(partsInFlight);
+            // Stops reading once a part fails
+            using var failed = CancellationTokenSource.CreateLinkedTokenSource(cancellationToken);
+            var pending = new List<Task>();
+            var peek = new byte[1];
+            bool carried = false;  // peek holds the first byte of the next part
+            bool last = false;
+            int parts = 0;
+            try
+            {
+                while (!last)
+                {
+                    await free.WaitAsync(failed.Token).ConfigureAwait(false);
+                    pool.TryRent(out int index);
+                    Memory<byte> buffer = pool.GetMemory(index);
+                    int chunks = 0;
+                    int lastLength = chunkSize;
+                    try
+                    {
+                        while (chunks < chunksPerPart)
+                        {
+                            Memory<byte> chunk = buffer.Slice(AesGcmSivStream.HeaderSize + chunks * slotSize, chunkSize);
+                            int filled = 0;
+                            if (carried)
+                            {
+                                chunk.Span[0] = peek[0];
+                                filled = 1;
+                                carried = false;
+                            }
+                            filled += await source.ReadAtLeastAsync(
+                                chunk.Slice(filled), chunkSize - filled, throwOnEndOfStream: false, failed.Token).ConfigureAwait(false);
+                            chunks++;
+                            if (filled < chunkSize)
+                            {
+                                last = true;
+                                lastLength = filled;
+                                break;
+                            }
+                        }
+                        // A full part is known not to be the last only once a byte past it has arrived
+                        if (!last)
+                        {
+                            if (await source.ReadAsync(peek, failed.Token).ConfigureAwait(false) == 0)
+                                last = true;
+                            else
+                                carried = true;
+                        }
+                    }
+                    catch
+                    {
+                        CryptographicOperations.ZeroMemory(buffer.Span);
+                        pool.Return(index);
+                        free.Release();
+                        throw;
+                    }
+
+                    int partNumber = ++parts;
+                    ulong firstChunk = (ulong)(partNumber - 1) * (ulong)chunksPerPart;
+                    bool lastPart = last;
+                    int lastChunkLength = lastLength;
+                    int partChunks = chunks;
+                    pending.Add(Task.Run(async () =>
+                    {
+                        try
+                        {
+                            failed.Token.ThrowIfCancellationRequested();
+                            int start = AesGcmSivStream.HeaderSize;
+                            if (partNumber == 1)
+                            {
+                                header.CopyTo(buffer);
+                                start = 0;
+                            }
+                            int end = SealPart(
+                                aesGcmSiv, pool.GetSpan(index), prefix, firstChunk, partChunks, lastPart, lastChunkLength,
+                                chunkSize, associatedData);
+                            await uploadPart(partNumber, buffer.Slice(start, end - start), failed.Token).ConfigureAwait(false);
+                        }
+                        catch (Exception e) when (e is not OperationCanceledException)
+                        {
+                            failed.Cancel();
+                            throw;
+                        }
+                        finally
+                        {
+                            CryptographicOperations.ZeroMemory(buffer.Span);
+                            pool.Return(index);
+                            free.Release();
+                        }
+                    }));
+                }
+            }
+            catch
+            {
+                failed.Cancel();
+                Task all = Task.WhenAll(pending);
+                await all.ConfigureAwait(ConfigureAwaitOptions.SuppressThrowing);
+                // A failed part cancels the reading, so its error is the cause
+                if (all.IsFaulted)
+                    ExceptionDispatchInfo.Throw(all.Exception!.InnerException!);
+                throw;
+            }
+            await Task.WhenAll(pending).ConfigureAwait(false);
+            return parts;
+        }
+
+        // Seals the chunks of one part, which start HeaderSize bytes into
+        // buffer, in place with one batch call, returning where they end
+        private static unsafe int SealPart(
+            AesGcmSiv aesGcmSiv, Span<byte> buffer, byte[] prefix, ulong firstChunk, int count, bool last, int lastLength,
+            int chunkSize, byte[]? associatedData)
+        {
+            int slotSize = chunkSize + TagSize;
+            var nonces = new byte[count * NonceSize];
+            var items = new NativeBatchItem[count];
+            int result;
+            fixed (byte* data = buffer)
+            fixed (byte* noncesPtr = nonces)
+            fixed (byte* aad = associatedData)
+            fixed (NativeBatchItem* itemsPtr = items)
+            {
+                for (int i = 0; i < count; i++)
+                {
+                    bool lastChunk = last && i == count - 1;
+                    int length = lastChunk ? lastLength : chunkSize;
+                    byte* chunk = data + AesGcmSivStream.HeaderSize + (nint)i * slotSize;
+                    byte* nonce = noncesPtr + i * NonceSize;
+                    AesGcmSivStream.ChunkNonce(prefix, firstChunk + (ulong)i, lastChunk, new Span<byte>(nonce, NonceSize));
+                    itemsPtr[i] = new NativeBatchItem
+                    {
+                        Nonce = (IntPtr)nonce,
+                        Input = (IntPtr)chunk,
+                        InputLength = (nuint)length,
+                        AssociatedData = (IntPtr)aad,
+                        AssociatedDataLength = (nuint)(associatedData?.Length ?? 0),
+                        Output = (IntPtr)chunk,
+                        Tag = (IntPtr)(chunk + length),
+                    };
+                }
+                result = aesGcmSiv.RunDescriptors(itemsPtr, count, null);
+            }
+            if (result != AESGCMSIV_SUCCESS)
+                throw new CryptographicException($"Batch encryption failed with error code: {result}");
+            return AesGcmSivStream.HeaderSize + (count - 1) * slotSize + (last ? lastLength : chunkSize) + TagSize;
+        }
+    }
+}
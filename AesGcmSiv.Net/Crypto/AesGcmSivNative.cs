@@ -0,0 +1,679 @@
+using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
+using System.Runtime.Intrinsics.X86;
+using System.Text;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Binds the exports of the native library. The library is loaded once per process, either the one
+    /// named by <see cref="LibraryPathVariable"/>, a path given to <see cref="Load"/>, a build for the
+    /// CPU's x86-64 microarchitecture level, or the <c>aesgcmsiv</c> library found by the usual probing
+    /// rules, and every export is resolved into a function pointer at that time so calls go straight to
+    /// native code without a marshaling stub.
+    /// </summary>
+    /// <remarks>
+    /// The x64 packages carry builds of the whole library for x86-64-v2, v3 and v4 beside the baseline,
+    /// as <c>aesgcmsiv.x86-64-v3.dll</c> or <c>libaesgcmsiv.x86-64-v3.so</c> and so on. The kernels
+    /// pick their instructions at run time in every build; these let the compiler use the level's
+    /// instructions in the code around them too. The highest level the CPU supports, capped by
+    /// <see cref="X86LevelVariable"/>, is loaded if present, and the baseline otherwise.
+    ///
+    /// The default library is reached through one P/Invoke, <c>aesgcmsiv_get_export</c>, which hands
+    /// out every other export. A Native AOT app can therefore link the static archive into its
+    /// executable and list <c>aesgcmsiv</c> under <c>DirectPInvoke</c>, and nothing is loaded at run
+    /// time; see <c>buildTransitive/AesGcmSiv.Net.targets</c>.
+    /// </remarks>
+    internal static unsafe class AesGcmSivNative
+    {
+        // Environment variable naming a library to load instead of the default
+        internal const string LibraryPathVariable = "AESGCMSIV_NATIVE_LIBRARY";
+
+        // Environment variable naming a backend to select once the library is bound
+        internal const string BackendVariable = "AESGCMSIV_BACKEND";
+
+        // Environment variable capping the x86-64 level of the build loaded
+        // by default: v1 for the baseline, up to v4
+        internal const string X86LevelVariable = "AESGCMSIV_X86_LEVEL";
+
+        private const string DefaultLibraryName = "aesgcmsiv";
+
+        private static readonly object s_lock = new();
+        private static bool s_bound;
+
+        // Function pointers for the exports in aesgcmsiv.h. Set once, under
+        // s_lock, before s_bound is published.
+        internal static delegate* unmanaged[Cdecl]<byte*, nuint, IntPtr*, int> CtxNew;
+        internal static delegate* unmanaged[Cdecl]<byte*, nuint, byte*, byte*, IntPtr*, int> CtxNewEx;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, void> CtxFree;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, IntPtr*, int> CtxClone;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, nuint, byte*, byte*, int> CtxEncrypt;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, nuint, byte*, byte*, int> CtxDecrypt;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, nuint, byte*, byte*, ulong*, int> CtxEncryptHashed;
+
+        // The bounded entry points never block, so they skip the GC transition
+        internal static delegate* unmanaged[Cdecl, SuppressGCTransition]<IntPtr, byte*, nuint, byte*, nuint, byte*, nuint, byte*, byte*, int> CtxEncryptSmall;
+        internal static delegate* unmanaged[Cdecl, SuppressGCTransition]<IntPtr, byte*, nuint, byte*, nuint, byte*, nuint, byte*, byte*, int> CtxDecryptSmall;
+
+        // The same without the native parameter checks, for callers that have done them
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, byte*, nuint, byte*, nuint, byte*, byte*, int> CtxEncryptUnchecked;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, byte*, nuint, byte*, nuint, byte*, byte*, int> CtxDecryptUnchecked;
+        internal static delegate* unmanaged[Cdecl, SuppressGCTransition]<IntPtr, byte*, byte*, nuint, byte*, nuint, byte*, byte*, int> CtxEncryptSmallUnchecked;
+        internal static delegate* unmanaged[Cdecl, SuppressGCTransition]<IntPtr, byte*, byte*, nuint, byte*, nuint, byte*, byte*, int> CtxDecryptSmallUnchecked;
+
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, NativeIoVec*, nuint, NativeIoVec*, nuint, NativeIoVec*, nuint, byte*, int> CtxEncryptV;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, NativeIoVec*, nuint, NativeIoVec*, nuint, byte*, NativeIoVec*, nuint, int> CtxDecryptV;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, nuint, byte*, byte*, IntPtr*, int> CtxEncryptSubmit;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, nuint, byte*, byte*, IntPtr*, int> CtxDecryptSubmit;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, int> JobPoll;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, nuint, byte*, byte*, delegate* unmanaged[Cdecl]<IntPtr, int, void>, IntPtr, int> CtxEncryptAsync;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, nuint, byte*, byte*, delegate* unmanaged[Cdecl]<IntPtr, int, void>, IntPtr, int> CtxDecryptAsync;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, uint, int> CtxSetThreads;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, nuint, int> CtxSetNonceCache;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, nuint, int> CtxSetStreaming;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, nuint, int> CtxSetWideMin;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, int> CtxEncryptAutoNonce;
+        internal static delegate* unmanaged[Cdecl]<IntPtr*, nuint, byte*, nuint, byte*, nuint, byte*, nuint, byte*, byte*, nuint*, int> OpenTrial;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, nuint, byte*, nuint*, int> CtxSealBase64Url;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, nuint*, int> CtxOpenBase64Url;
+        internal static delegate* unmanaged[Cdecl]<byte*, int> RandomNonce;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, IntPtr, int> CtxSetPool;
+        internal static delegate* unmanaged[Cdecl]<uint, uint, IntPtr*, int> PoolCreateEx;
+        internal static delegate* unmanaged[Cdecl]<uint, delegate* unmanaged[Cdecl]<IntPtr, IntPtr, void>, IntPtr, IntPtr*, int> PoolCreateHosted;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, void> PoolWork;
+        internal static delegate* unmanaged[Cdecl]<uint, nuint, IntPtr*, int> EngineNew;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, NativeRequest*, int> EngineSubmit;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, NativeRequest*, uint, int> EngineSubmitLane;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, NativeEngineStats*, int> EngineGetStats;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, ulong, nuint, int> EngineSetLinger;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, int, int> EngineSetBlocking;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, NativeCompletion*, nuint, int, nuint*, int> EngineReap;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, void> EngineShutdown;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, void> EngineFree;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, nuint, NativeBatchItem*, int> EncryptBatch;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, nuint, NativeBatchItem*, int*, int> DecryptBatch;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, nuint, NativeBatchItem*, byte*, ulong, int> EncryptBatchCounter;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, nuint, NativeBatchItem*, byte*, ulong, int*, int> DecryptBatchCounter;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, nuint, NativeBatchItem*, byte*, nuint, int> EncryptBatchSharedAad;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, nuint, NativeBatchItem*, byte*, nuint, int*, int> DecryptBatchSharedAad;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, IntPtr, byte*, byte*, byte*, nuint, byte*, nuint, byte*, byte*, byte*, int> Reencrypt;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, IntPtr, nuint, NativeBatchItem*, byte*, int*, int> ReencryptBatch;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, byte*, nuint, nuint, ulong, nuint, byte*, int> EncryptPages;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, byte*, nuint, nuint, ulong, nuint, byte*, int*, int> DecryptPages;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, ulong, nuint, byte*, void*, nuint, byte*, byte*, int> EncryptColumn;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, ulong, nuint, byte*, void*, nuint, byte*, byte*, int*, int> DecryptColumn;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, ulong, void*, void*, uint, void*, void*, int> ArrowEncryptColumn;
+        internal static delegate* unmanaged[Cdecl]<IntPtr*, uint*, int> GetBackend;
+        internal static delegate* unmanaged[Cdecl]<nuint, uint, NativeProbeResult*, int> Probe;
+        internal static delegate* unmanaged[Cdecl]<byte*, int> SelectBackend;
+        internal static delegate* unmanaged[Cdecl]<uint, int> Init;
+        internal static delegate* unmanaged[Cdecl]<NativeTuning*, int> SetTuning;
+        internal static delegate* unmanaged[Cdecl]<NativeTuning*, int> GetTuning;
+        internal static delegate* unmanaged[Cdecl]<nuint, IntPtr*, int> KeyCacheNew;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, IntPtr*, int> KeyCacheGet;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, nuint, int> KeyCacheSetCapacity;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, void> KeyCacheClear;
+        internal static delegate* unmanaged[Cdecl]<nuint, IntPtr*, int> KeyTableNew;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, nuint, byte*, nuint, int> KeyTableSet;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, nuint, int> KeyTableClear;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, IntPtr, int> KeyTableSetPool;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, nuint, NativeBatchItem*, uint*, int> KeyTableEncryptBatch;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, nuint, NativeBatchItem*, uint*, int*, int> KeyTableDecryptBatch;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, void> KeyTableFree;
+        internal static delegate* unmanaged[Cdecl]<byte*, nuint, nuint, uint, IntPtr*, int> ValueCacheNew;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, nuint, NativeCacheValue*, int*, int> ValueCachePut;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, nuint, NativeCacheValue*, int*, int> ValueCacheGet;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, ulong, int> ValueCacheRemove;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, NativeValueCacheStats*, int> ValueCacheGetStats;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, void> ValueCacheFree;
+        internal static delegate* unmanaged[Cdecl]<nuint, IntPtr*, int> KeyRingNew;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, uint, byte*, nuint, int> KeyRingAdd;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, uint, int> KeyRingRemove;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, uint, byte*, nuint, byte*, nuint, byte*, nuint, byte*, int> SealWithKeyId;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, uint*, int> OpenWithKeyId;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, int, int> KeyRingSetUsageTracking;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, NativeKeyUsage*, nuint, nuint*, int> KeyRingStats;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, void> KeyRingFree;
+        internal static delegate* unmanaged[Cdecl]<byte*, nuint, byte*, nuint, nuint, IntPtr*, int> KdfNew;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, IntPtr, int> KdfSetCache;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, nuint, NativeIoVec*, byte*, int> KdfDeriveBatch;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, nuint, NativeBatchItem*, NativeIoVec*, int> KdfEncryptBatch;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, nuint, NativeBatchItem*, NativeIoVec*, int*, int> KdfDecryptBatch;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, void> KdfFree;
+        internal static delegate* unmanaged[Cdecl]<nuint, IntPtr*, int> BuffersNew;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, nuint, byte*, nuint, int> BuffersRegister;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, IntPtr, nuint, AesGcmSivRegisteredItem*, int> EncryptRegistered;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, IntPtr, nuint, AesGcmSivRegisteredItem*, int*, int> DecryptRegistered;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, void> BuffersFree;
+        internal static delegate* unmanaged[Cdecl]<byte*, nuint, byte*, nuint, IntPtr*, int> WrapCtxNew;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, byte*, int> Wrap;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, byte*, int> Unwrap;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, void> WrapCtxFree;
+        internal static delegate* unmanaged[Cdecl]<uint, int> CompressionSupported;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, uint, uint, int, byte*, IntPtr*, int> StreamSealNewCompressed;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, IntPtr*, int> StreamOpenNew;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, int, byte*, nuint*, int> StreamSealCompressed;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, nuint*, int*, int> StreamOpenCompressed;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, void> StreamFree;
+        internal static delegate* unmanaged[Cdecl]<ulong, int> StreamBudgetSet;
+        internal static delegate* unmanaged[Cdecl]<nuint, uint, uint, int, byte**, uint*, int> StreamWindowAcquire;
+        internal static delegate* unmanaged[Cdecl]<byte*, void> StreamWindowRelease;
+        internal static delegate* unmanaged[Cdecl]<NativeStreamBudgetStats*, int> StreamBudgetGetStats;
+        internal static delegate* unmanaged[Cdecl]<nuint, uint, void*> Alloc;
+        internal static delegate* unmanaged[Cdecl]<void*, void> Free;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte**, nuint, byte*, nuint, byte*, nuint, nuint*, int> JsonSealFields;
+        internal static delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte**, nuint, byte*, nuint, byte*, nuint, nuint*, int> JsonOpenFields;
+
+        /// <summary>
+        /// Loads the default library unless one is already bound.
+        /// </summary>
+        internal static void EnsureLoaded()
+        {
+            if (Volatile.Read(ref s_bound))
+                return;
+
+            lock (s_lock)
+            {
+                if (s_bound)
+                    return;
+
+                string? path = Environment.GetEnvironmentVariable(LibraryPathVariable);
+                Bind(string.IsNullOrEmpty(path) ? LoadLevelBuild() : NativeLibrary.Load(path));
+            }
+        }
+
+        // The build for the highest x86-64 level the CPU supports that is
+        // shipped and loads, or Zero for the default library. A Native AOT
+        // app has the archive linked in, or loads the default library, and
+        // looks for none.
+        private static IntPtr LoadLevelBuild()
+        {
+            if (!RuntimeFeature.IsDynamicCodeSupported)
+                return IntPtr.Zero;
+
+            int level = X86Level();
+            string? cap = Environment.GetEnvironmentVariable(X86LevelVariable);
+            if (!string.IsNullOrEmpty(cap))
+            {
+                if (cap.Length != 2 || (cap[0] != 'v' && cap[0] != 'V') || cap[1] < '1' || cap[1] > '4')
+                    throw new InvalidOperationException($"{X86LevelVariable} must be v1, v2, v3 or v4, not '{cap}'.");
+                level = Math.Min(level, cap[1] - '0');
+            }
+
+            for (; level >= 2; level--)
+            {
+                string fileName = OperatingSystem.IsWindows()
+                    ? $"{DefaultLibraryName}.x86-64-v{level}.dll"
+                    : $"lib{DefaultLibraryName}.x86-64-v{level}.{(OperatingSystem.IsMacOS() ? "dylib" : "so")}";
+                foreach (string directory in NativeDirectories())
+                {
+                    string candidate = Path.Combine(directory, fileName);
+                    if (File.Exists(candidate) && NativeLibrary.TryLoad(candidate, out IntPtr library))
+                        return library;
+                }
+            }
+            return IntPtr.Zero;
+        }
+
+        // The x86-64 microarchitecture level of the CPU, as far as the
+        // runtime reports it, or 0 on other architectures. F16C and MOVBE
+        // have no IsSupported and are taken to come with the rest of v3, as
+        // they do on every CPU that has it.
+        private static int X86Level()
+        {
+            if (RuntimeInformation.ProcessArchitecture != Architecture.X64)
+                return 0;
+            if (!(Sse42.IsSupported && Ssse3.IsSupported && Popcnt.IsSupported))
+                return 1;
+            if (!(Avx2.IsSupported && Bmi1.IsSupported && Bmi2.IsSupported && Fma.IsSupported && Lzcnt.IsSupported))
+                return 2;
+            if (!(Avx512F.IsSupported && Avx512F.VL.IsSupported && Avx512BW.IsSupported &&
+                  Avx512CD.IsSupported && Avx512DQ.IsSupported))
+                return 3;
+            return 4;
+        }
+
+        // Where the runtime looks for native libraries: the directories the
+        // host resolved from the app's dependencies, then the app's own and
+        // its runtimes folder, as a build without a runtime identifier has
+        private static IEnumerable<string> NativeDirectories()
+        {
+            if (AppContext.GetData("NATIVE_DLL_SEARCH_DIRECTORIES") is string searchDirectories)
+            {
+                foreach (string directory in searchDirectories.Split(Path.PathSeparator, StringSplitOptions.RemoveEmptyEntries))
+                    yield return directory;
+            }
+            string baseDirectory = AppContext.BaseDirectory;
+            string os = OperatingSystem.IsWindows() ? "win" : OperatingSystem.IsMacOS() ? "osx" : "linux";
+            yield return baseDirectory;
+            yield return Path.Combine(baseDirectory, "runtimes", os + "-x64", "native");
+        }
+
+        /// <summary>
+        /// Loads and binds the library at <paramref name="libraryPath"/>. Fails if a library is already bound.
+        /// </summary>
+        internal static void Load(string libraryPath)
+        {
+            lock (s_lock)
+            {
+                if (s_bound)
+                    throw new InvalidOperationException("A native library has already been loaded for this process.");
+                Bind(NativeLibrary.Load(libraryPath));
+            }
+        }
+
+        // The default library's export lookup, resolved by the runtime like
+        // any P/Invoke, or at link time under DirectPInvoke. Its arguments
+        // are blittable, so it needs no marshaling code.
+        [DllImport(DefaultLibraryName, EntryPoint = "aesgcmsiv_get_export", ExactSpelling = true)]
+        private static extern IntPtr GetLinkedExport(byte* name);
+
+        // An export of library, or of the default library when library is Zero
+        private static IntPtr GetExport(IntPtr library, string name)
+        {
+            if (library != IntPtr.Zero)
+                return NativeLibrary.GetExport(library, name);
+
+            byte* ascii = stackalloc byte[name.Length + 1];
+            for (int i = 0; i < name.Length; i++)
+                ascii[i] = (byte)name[i];
+            ascii[name.Length] = 0;
+            IntPtr export = GetLinkedExport(ascii);
+            if (export == IntPtr.Zero)
+                throw new EntryPointNotFoundException($"The native library has no export named '{name}'.");
+            return export;
+        }
+
+        // Resolves every export before publishing the library, so a library
+        // missing one is rejected whole and nothing is left half bound.
+        // library is Zero for the default library.
+        private static void Bind(IntPtr library)
+        {
+            try
+            {
+                CtxNew = (delegate* unmanaged[Cdecl]<byte*, nuint, IntPtr*, int>)
+                    GetExport(library, "aesgcmsiv_ctx_new");
+                CtxNewEx = (delegate* unmanaged[Cdecl]<byte*, nuint, byte*, byte*, IntPtr*, int>)
+                    GetExport(library, "aesgcmsiv_ctx_new_ex");
+                CtxFree = (delegate* unmanaged[Cdecl]<IntPtr, void>)
+                    GetExport(library, "aesgcmsiv_ctx_free");
+                CtxClone = (delegate* unmanaged[Cdecl]<IntPtr, IntPtr*, int>)
+                    GetExport(library, "aesgcmsiv_ctx_clone");
+                CtxEncrypt = (delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, nuint, byte*, byte*, int>)
+                    GetExport(library, "aesgcmsiv_ctx_encrypt");
+                CtxDecrypt = (delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, nuint, byte*, byte*, int>)
+                    GetExport(library, "aesgcmsiv_ctx_decrypt");
+                CtxEncryptHashed = (delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, nuint, byte*, byte*, ulong*, int>)
+                    GetExport(library, "aesgcmsiv_ctx_encrypt_hashed");
+                CtxEncryptSmall = (delegate* unmanaged[Cdecl, SuppressGCTransition]<IntPtr, byte*, nuint, byte*, nuint, byte*, nuint, byte*, byte*, int>)
+                    GetExport(library, "aesgcmsiv_ctx_encrypt_small");
+                CtxDecryptSmall = (delegate* unmanaged[Cdecl, SuppressGCTransition]<IntPtr, byte*, nuint, byte*, nuint, byte*, nuint, byte*, byte*, int>)
+                    GetExport(library, "aesgcmsiv_ctx_decrypt_small");
+                CtxEncryptUnchecked = (delegate* unmanaged[Cdecl]<IntPtr, byte*, byte*, nuint, byte*, nuint, byte*, byte*, int>)
+                    GetExport(library, "aesgcmsiv_ctx_encrypt_unchecked");
+                CtxDecryptUnchecked = (delegate* unmanaged[Cdecl]<IntPtr, byte*, byte*, nuint, byte*, nuint, byte*, byte*, int>)
+                    GetExport(library, "aesgcmsiv_ctx_decrypt_unchecked");
+                CtxEncryptSmallUnchecked = (delegate* unmanaged[Cdecl, SuppressGCTransition]<IntPtr, byte*, byte*, nuint, byte*, nuint, byte*, byte*, int>)
+                    GetExport(library, "aesgcmsiv_ctx_encrypt_small_unchecked");
+                CtxDecryptSmallUnchecked = (delegate* unmanaged[Cdecl, SuppressGCTransition]<IntPtr, byte*, byte*, nuint, byte*, nuint, byte*, byte*, int>)
+                    GetExport(library, "aesgcmsiv_ctx_decrypt_small_unchecked");
+                CtxEncryptV = (delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, NativeIoVec*, nuint, NativeIoVec*, nuint, NativeIoVec*, nuint, byte*, int>)
+                    GetExport(library, "aesgcmsiv_ctx_encryptv");
+                CtxDecryptV = (delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, NativeIoVec*, nuint, NativeIoVec*, nuint, byte*, NativeIoVec*, nuint, int>)
+                    GetExport(library, "aesgcmsiv_ctx_decryptv");
+                CtxEncryptSubmit = (delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, nuint, byte*, byte*, IntPtr*, int>)
+                    GetExport(library, "aesgcmsiv_ctx_encrypt_submit");
+                CtxDecryptSubmit = (delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, nuint, byte*, byte*, IntPtr*, int>)
+                    GetExport(library, "aesgcmsiv_ctx_decrypt_submit");
+                JobPoll = (delegate* unmanaged[Cdecl]<IntPtr, int>)
+                    GetExport(library, "aesgcmsiv_job_poll");
+                CtxEncryptAsync = (delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, nuint, byte*, byte*, delegate* unmanaged[Cdecl]<IntPtr, int, void>, IntPtr, int>)
+                    GetExport(library, "aesgcmsiv_ctx_encrypt_async");
+                CtxDecryptAsync = (delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, nuint, byte*, byte*, delegate* unmanaged[Cdecl]<IntPtr, int, void>, IntPtr, int>)
+                    GetExport(library, "aesgcmsiv_ctx_decrypt_async");
+                CtxSetThreads = (delegate* unmanaged[Cdecl]<IntPtr, uint, int>)
+                    GetExport(library, "aesgcmsiv_ctx_set_threads");
+                CtxSetNonceCache = (delegate* unmanaged[Cdecl]<IntPtr, nuint, int>)
+                    GetExport(library, "aesgcmsiv_ctx_set_nonce_cache");
+                CtxSetStreaming = (delegate* unmanaged[Cdecl]<IntPtr, nuint, int>)
+                    GetExport(library, "aesgcmsiv_ctx_set_streaming");
+                CtxSetWideMin = (delegate* unmanaged[Cdecl]<IntPtr, nuint, int>)
+                    GetExport(library, "aesgcmsiv_ctx_set_wide_min");
+                CtxEncryptAutoNonce = (delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, int>)
+                    GetExport(library, "aesgcmsiv_ctx_encrypt_autononce");
+                OpenTrial = (delegate* unmanaged[Cdecl]<IntPtr*, nuint, byte*, nuint, byte*, nuint, byte*, nuint, byte*, byte*, nuint*, int>)
+                    GetExport(library, "aesgcmsiv_open_trial");
+                CtxSealBase64Url = (delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, nuint, byte*, nuint*, int>)
+                    GetExport(library, "aesgcmsiv_ctx_seal_b64url");
+                CtxOpenBase64Url = (delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, nuint*, int>)
+                    GetExport(library, "aesgcmsiv_ctx_open_b64url");
+                RandomNonce = (delegate* unmanaged[Cdecl]<byte*, int>)
+                    GetExport(library, "aesgcmsiv_random_nonce");
+                CtxSetPool = (delegate* unmanaged[Cdecl]<IntPtr, IntPtr, int>)
+                    GetExport(library, "aesgcmsiv_ctx_set_pool");
+                PoolCreateEx = (delegate* unmanaged[Cdecl]<uint, uint, IntPtr*, int>)
+                    GetExport(library, "aesgcmsiv_pool_create_ex");
+                PoolCreateHosted = (delegate* unmanaged[Cdecl]<uint, delegate* unmanaged[Cdecl]<IntPtr, IntPtr, void>, IntPtr, IntPtr*, int>)
+                    GetExport(library, "aesgcmsiv_pool_create_hosted");
+                PoolWork = (delegate* unmanaged[Cdecl]<IntPtr, void>)
+                    GetExport(library, "aesgcmsiv_pool_work");
+                EngineNew = (delegate* unmanaged[Cdecl]<uint, nuint, IntPtr*, int>)
+                    GetExport(library, "aesgcmsiv_engine_new");
+                EngineSubmit = (delegate* unmanaged[Cdecl]<IntPtr, NativeRequest*, int>)
+                    GetExport(library, "aesgcmsiv_engine_submit");
+                EngineSubmitLane = (delegate* unmanaged[Cdecl]<IntPtr, NativeRequest*, uint, int>)
+                    GetExport(library, "aesgcmsiv_engine_submit_lane");
+                EngineGetStats = (delegate* unmanaged[Cdecl]<IntPtr, NativeEngineStats*, int>)
+                    GetExport(library, "aesgcmsiv_engine_get_stats");
+                EngineSetLinger = (delegate* unmanaged[Cdecl]<IntPtr, ulong, nuint, int>)
+                    GetExport(library, "aesgcmsiv_engine_set_linger");
+                EngineSetBlocking = (delegate* unmanaged[Cdecl]<IntPtr, int, int>)
+                    GetExport(library, "aesgcmsiv_engine_set_blocking");
+                EngineReap = (delegate* unmanaged[Cdecl]<IntPtr, NativeCompletion*, nuint, int, nuint*, int>)
+                    GetExport(library, "aesgcmsiv_engine_reap");
+                EngineShutdown = (delegate* unmanaged[Cdecl]<IntPtr, void>)
+                    GetExport(library, "aesgcmsiv_engine_shutdown");
+                EngineFree = (delegate* unmanaged[Cdecl]<IntPtr, void>)
+                    GetExport(library, "aesgcmsiv_engine_free");
+                EncryptBatch = (delegate* unmanaged[Cdecl]<IntPtr, nuint, NativeBatchItem*, int>)
+                    GetExport(library, "aesgcmsiv_encrypt_batch");
+                DecryptBatch = (delegate* unmanaged[Cdecl]<IntPtr, nuint, NativeBatchItem*, int*, int>)
+                    GetExport(library, "aesgcmsiv_decrypt_batch");
+                EncryptBatchCounter = (delegate* unmanaged[Cdecl]<IntPtr, nuint, NativeBatchItem*, byte*, ulong, int>)
+                    GetExport(library, "aesgcmsiv_encrypt_batch_counter");
+                DecryptBatchCounter = (delegate* unmanaged[Cdecl]<IntPtr, nuint, NativeBatchItem*, byte*, ulong, int*, int>)
+                    GetExport(library, "aesgcmsiv_decrypt_batch_counter");
+                EncryptBatchSharedAad = (delegate* unmanaged[Cdecl]<IntPtr, nuint, NativeBatchItem*, byte*, nuint, int>)
+                    GetExport(library, "aesgcmsiv_encrypt_batch_shared_aad");
+                DecryptBatchSharedAad = (delegate* unmanaged[Cdecl]<IntPtr, nuint, NativeBatchItem*, byte*, nuint, int*, int>)
+                    GetExport(library, "aesgcmsiv_decrypt_batch_shared_aad");
+                Reencrypt = (delegate* unmanaged[Cdecl]<IntPtr, IntPtr, byte*, byte*, byte*, nuint, byte*, nuint, byte*, byte*, byte*, int>)
+                    GetExport(library, "aesgcmsiv_reencrypt");
+                ReencryptBatch = (delegate* unmanaged[Cdecl]<IntPtr, IntPtr, nuint, NativeBatchItem*, byte*, int*, int>)
+                    GetExport(library, "aesgcmsiv_reencrypt_batch");
+                EncryptPages = (delegate* unmanaged[Cdecl]<IntPtr, byte*, byte*, nuint, nuint, ulong, nuint, byte*, int>)
+                    GetExport(library, "aesgcmsiv_encrypt_pages");
+                DecryptPages = (delegate* unmanaged[Cdecl]<IntPtr, byte*, byte*, nuint, nuint, ulong, nuint, byte*, int*, int>)
+                    GetExport(library, "aesgcmsiv_decrypt_pages");
+                EncryptColumn = (delegate* unmanaged[Cdecl]<IntPtr, byte*, ulong, nuint, byte*, void*, nuint, byte*, byte*, int>)
+                    GetExport(library, "aesgcmsiv_encrypt_column");
+                DecryptColumn = (delegate* unmanaged[Cdecl]<IntPtr, byte*, ulong, nuint, byte*, void*, nuint, byte*, byte*, int*, int>)
+                    GetExport(library, "aesgcmsiv_decrypt_column");
+                ArrowEncryptColumn = (delegate* unmanaged[Cdecl]<IntPtr, byte*, ulong, void*, void*, uint, void*, void*, int>)
+                    GetExport(library, "aesgcmsiv_arrow_encrypt_column");
+                GetBackend = (delegate* unmanaged[Cdecl]<IntPtr*, uint*, int>)
+                    GetExport(library, "aesgcmsiv_get_backend");
+                SelectBackend = (delegate* unmanaged[Cdecl]<byte*, int>)
+                    GetExport(library, "aesgcmsiv_select_backend");
+                Probe = (delegate* unmanaged[Cdecl]<nuint, uint, NativeProbeResult*, int>)
+                    GetExport(library, "aesgcmsiv_probe");
+                Init = (delegate* unmanaged[Cdecl]<uint, int>)
+                    GetExport(library, "aesgcmsiv_init");
+                SetTuning = (delegate* unmanaged[Cdecl]<NativeTuning*, int>)
+                    GetExport(library, "aesgcmsiv_set_tuning");
+                GetTuning = (delegate* unmanaged[Cdecl]<NativeTuning*, int>)
+                    GetExport(library, "aesgcmsiv_get_tuning");
+                KeyCacheNew = (delegate* unmanaged[Cdecl]<nuint, IntPtr*, int>)
+                    GetExport(library, "aesgcmsiv_key_cache_new");
+                KeyCacheGet = (delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, IntPtr*, int>)
+                    GetExport(library, "aesgcmsiv_key_cache_get");
+                KeyCacheSetCapacity = (delegate* unmanaged[Cdecl]<IntPtr, nuint, int>)
+                    GetExport(library, "aesgcmsiv_key_cache_set_capacity");
+                KeyCacheClear = (delegate* unmanaged[Cdecl]<IntPtr, void>)
+                    GetExport(library, "aesgcmsiv_key_cache_clear");
+                KeyTableNew = (delegate* unmanaged[Cdecl]<nuint, IntPtr*, int>)
+                    GetExport(library, "aesgcmsiv_key_table_new");
+                KeyTableSet = (delegate* unmanaged[Cdecl]<IntPtr, nuint, byte*, nuint, int>)
+                    GetExport(library, "aesgcmsiv_key_table_set");
+                KeyTableClear = (delegate* unmanaged[Cdecl]<IntPtr, nuint, int>)
+                    GetExport(library, "aesgcmsiv_key_table_clear");
+                KeyTableSetPool = (delegate* unmanaged[Cdecl]<IntPtr, IntPtr, int>)
+                    GetExport(library, "aesgcmsiv_key_table_set_pool");
+                KeyTableEncryptBatch = (delegate* unmanaged[Cdecl]<IntPtr, nuint, NativeBatchItem*, uint*, int>)
+                    GetExport(library, "aesgcmsiv_key_table_encrypt_batch");
+                KeyTableDecryptBatch = (delegate* unmanaged[Cdecl]<IntPtr, nuint, NativeBatchItem*, uint*, int*, int>)
+                    GetExport(library, "aesgcmsiv_key_table_decrypt_batch");
+                KeyTableFree = (delegate* unmanaged[Cdecl]<IntPtr, void>)
+                    GetExport(library, "aesgcmsiv_key_table_free");
+                ValueCacheNew = (delegate* unmanaged[Cdecl]<byte*, nuint, nuint, uint, IntPtr*, int>)
+                    GetExport(library, "aesgcmsiv_value_cache_new");
+                ValueCachePut = (delegate* unmanaged[Cdecl]<IntPtr, nuint, NativeCacheValue*, int*, int>)
+                    GetExport(library, "aesgcmsiv_value_cache_put");
+                ValueCacheGet = (delegate* unmanaged[Cdecl]<IntPtr, nuint, NativeCacheValue*, int*, int>)
+                    GetExport(library, "aesgcmsiv_value_cache_get");
+                ValueCacheRemove = (delegate* unmanaged[Cdecl]<IntPtr, ulong, int>)
+                    GetExport(library, "aesgcmsiv_value_cache_remove");
+                ValueCacheGetStats = (delegate* unmanaged[Cdecl]<IntPtr, NativeValueCacheStats*, int>)
+                    GetExport(library, "aesgcmsiv_value_cache_get_stats");
+                ValueCacheFree = (delegate* unmanaged[Cdecl]<IntPtr, void>)
+                    GetExport(library, "aesgcmsiv_value_cache_free");
+                KeyRingNew = (delegate* unmanaged[Cdecl]<nuint, IntPtr*, int>)
+                    GetExport(library, "aesgcmsiv_keyring_new");
+                KeyRingAdd = (delegate* unmanaged[Cdecl]<IntPtr, uint, byte*, nuint, int>)
+                    GetExport(library, "aesgcmsiv_keyring_add");
+                KeyRingRemove = (delegate* unmanaged[Cdecl]<IntPtr, uint, int>)
+                    GetExport(library, "aesgcmsiv_keyring_remove");
+                SealWithKeyId = (delegate* unmanaged[Cdecl]<IntPtr, uint, byte*, nuint, byte*, nuint, byte*, nuint, byte*, int>)
+                    GetExport(library, "aesgcmsiv_seal_with_keyid");
+                OpenWithKeyId = (delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, uint*, int>)
+                    GetExport(library, "aesgcmsiv_open_with_keyid");
+                KeyRingSetUsageTracking = (delegate* unmanaged[Cdecl]<IntPtr, int, int>)
+                    GetExport(library, "aesgcmsiv_keyring_set_usage_tracking");
+                KeyRingStats = (delegate* unmanaged[Cdecl]<IntPtr, NativeKeyUsage*, nuint, nuint*, int>)
+                    GetExport(library, "aesgcmsiv_keyring_stats");
+                KeyRingFree = (delegate* unmanaged[Cdecl]<IntPtr, void>)
+                    GetExport(library, "aesgcmsiv_keyring_free");
+                KdfNew = (delegate* unmanaged[Cdecl]<byte*, nuint, byte*, nuint, nuint, IntPtr*, int>)
+                    GetExport(library, "aesgcmsiv_kdf_new");
+                KdfSetCache = (delegate* unmanaged[Cdecl]<IntPtr, IntPtr, int>)
+                    GetExport(library, "aesgcmsiv_kdf_set_cache");
+                KdfDeriveBatch = (delegate* unmanaged[Cdecl]<IntPtr, nuint, NativeIoVec*, byte*, int>)
+                    GetExport(library, "aesgcmsiv_kdf_derive_batch");
+                KdfEncryptBatch = (delegate* unmanaged[Cdecl]<IntPtr, nuint, NativeBatchItem*, NativeIoVec*, int>)
+                    GetExport(library, "aesgcmsiv_kdf_encrypt_batch");
+                KdfDecryptBatch = (delegate* unmanaged[Cdecl]<IntPtr, nuint, NativeBatchItem*, NativeIoVec*, int*, int>)
+                    GetExport(library, "aesgcmsiv_kdf_decrypt_batch");
+                KdfFree = (delegate* unmanaged[Cdecl]<IntPtr, void>)
+                    GetExport(library, "aesgcmsiv_kdf_free");
+                BuffersNew = (delegate* unmanaged[Cdecl]<nuint, IntPtr*, int>)
+                    GetExport(library, "aesgcmsiv_buffers_new");
+                BuffersRegister = (delegate* unmanaged[Cdecl]<IntPtr, nuint, byte*, nuint, int>)
+                    GetExport(library, "aesgcmsiv_buffers_register");
+                EncryptRegistered = (delegate* unmanaged[Cdecl]<IntPtr, IntPtr, nuint, AesGcmSivRegisteredItem*, int>)
+                    GetExport(library, "aesgcmsiv_encrypt_registered");
+                DecryptRegistered = (delegate* unmanaged[Cdecl]<IntPtr, IntPtr, nuint, AesGcmSivRegisteredItem*, int*, int>)
+                    GetExport(library, "aesgcmsiv_decrypt_registered");
+                BuffersFree = (delegate* unmanaged[Cdecl]<IntPtr, void>)
+                    GetExport(library, "aesgcmsiv_buffers_free");
+                WrapCtxNew = (delegate* unmanaged[Cdecl]<byte*, nuint, byte*, nuint, IntPtr*, int>)
+                    GetExport(library, "aesgcmsiv_wrap_ctx_new");
+                Wrap = (delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, byte*, int>)
+                    GetExport(library, "aesgcmsiv_wrap");
+                Unwrap = (delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, byte*, int>)
+                    GetExport(library, "aesgcmsiv_unwrap");
+                WrapCtxFree = (delegate* unmanaged[Cdecl]<IntPtr, void>)
+                    GetExport(library, "aesgcmsiv_wrap_ctx_free");
+                CompressionSupported = (delegate* unmanaged[Cdecl]<uint, int>)
+                    GetExport(library, "aesgcmsiv_compression_supported");
+                StreamSealNewCompressed = (delegate* unmanaged[Cdecl]<IntPtr, uint, uint, int, byte*, IntPtr*, int>)
+                    GetExport(library, "aesgcmsiv_stream_seal_new_compressed");
+                StreamOpenNew = (delegate* unmanaged[Cdecl]<IntPtr, byte*, IntPtr*, int>)
+                    GetExport(library, "aesgcmsiv_stream_open_new");
+                StreamSealCompressed = (delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, int, byte*, nuint*, int>)
+                    GetExport(library, "aesgcmsiv_stream_seal_compressed");
+                StreamOpenCompressed = (delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte*, nuint, byte*, nuint*, int*, int>)
+                    GetExport(library, "aesgcmsiv_stream_open_compressed");
+                StreamFree = (delegate* unmanaged[Cdecl]<IntPtr, void>)
+                    GetExport(library, "aesgcmsiv_stream_free");
+                StreamBudgetSet = (delegate* unmanaged[Cdecl]<ulong, int>)
+                    GetExport(library, "aesgcmsiv_stream_budget_set");
+                StreamWindowAcquire = (delegate* unmanaged[Cdecl]<nuint, uint, uint, int, byte**, uint*, int>)
+                    GetExport(library, "aesgcmsiv_stream_window_acquire");
+                StreamWindowRelease = (delegate* unmanaged[Cdecl]<byte*, void>)
+                    GetExport(library, "aesgcmsiv_stream_window_release");
+                StreamBudgetGetStats = (delegate* unmanaged[Cdecl]<NativeStreamBudgetStats*, int>)
+                    GetExport(library, "aesgcmsiv_stream_budget_get_stats");
+                Alloc = (delegate* unmanaged[Cdecl]<nuint, uint, void*>)
+                    GetExport(library, "aesgcmsiv_alloc");
+                Free = (delegate* unmanaged[Cdecl]<void*, void>)
+                    GetExport(library, "aesgcmsiv_free");
+                JsonSealFields = (delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte**, nuint, byte*, nuint, byte*, nuint, nuint*, int>)
+                    GetExport(library, "aesgcmsiv_json_seal_fields");
+                JsonOpenFields = (delegate* unmanaged[Cdecl]<IntPtr, byte*, nuint, byte**, nuint, byte*, nuint, byte*, nuint, nuint*, int>)
+                    GetExport(library, "aesgcmsiv_json_open_fields");
+
+                string? backend = Environment.GetEnvironmentVariable(BackendVariable);
+                if (!string.IsNullOrEmpty(backend) && Select(backend) != 0)
+                    throw new InvalidOperationException($"The native library cannot run the backend '{backend}' named by {BackendVariable}.");
+            }
+            catch
+            {
+                if (library != IntPtr.Zero)
+                    NativeLibrary.Free(library);
+                throw;
+            }
+
+            Volatile.Write(ref s_bound, true);
+        }
+
+        /// <summary>
+        /// Calls <c>aesgcmsiv_select_backend</c> on the bound library, returning its status.
+        /// </summary>
+        internal static int Select(string? name)
+        {
+            if (name == null)
+                return SelectBackend(null);
+            var bytes = new byte[Encoding.UTF8.GetByteCount(name) + 1];
+            Encoding.UTF8.GetBytes(name, 0, name.Length, bytes, 0);
+            fixed (byte* namePtr = bytes)
+            {
+                return SelectBackend(namePtr);
+            }
+        }
+    }
+
+    // Mirrors aesgcmsiv_batch_item
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct NativeBatchItem
+    {
+        public IntPtr Nonce;
+        public IntPtr Input;
+        public nuint InputLength;
+        public IntPtr AssociatedData;
+        public nuint AssociatedDataLength;
+        public IntPtr Output;
+        public IntPtr Tag;
+    }
+
+    // Mirrors aesgcmsiv_cache_value
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct NativeCacheValue
+    {
+        public ulong Id;
+        public IntPtr Data;
+        public nuint Length;
+    }
+
+    // Mirrors aesgcmsiv_value_cache_stats
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct NativeValueCacheStats
+    {
+        public ulong Entries;
+        public ulong ValueBytes;
+        public ulong SlabBytes;
+        public ulong Evictions;
+    }
+
+    // Mirrors aesgcmsiv_key_usage
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct NativeKeyUsage
+    {
+        public uint KeyId;
+        public ulong Ops;
+        public ulong Bytes;
+        public ulong Failures;
+        public ulong LastUsedMs;
+    }
+
+    // Mirrors aesgcmsiv_stream_budget_stats
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct NativeStreamBudgetStats
+    {
+        public ulong MaxBytes;
+        public ulong BytesInUse;
+        public ulong BytesCached;
+        public ulong Windows;
+        public ulong Shrunk;
+        public ulong Waits;
+    }
+
+    // Mirrors aesgcmsiv_request
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct NativeRequest
+    {
+        public const uint Encrypt = 0;  // AESGCMSIV_OP_ENCRYPT
+        public const uint Decrypt = 1;  // AESGCMSIV_OP_DECRYPT
+
+        public IntPtr Context;
+        public uint Operation;
+        public NativeBatchItem Item;
+        public ulong UserData;
+    }
+
+    // Mirrors aesgcmsiv_completion
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct NativeCompletion
+    {
+        public ulong UserData;
+        public int Status;
+    }
+
+    // Mirrors aesgcmsiv_engine_lane_stats
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct NativeEngineLaneStats
+    {
+        public ulong Submitted;
+        public ulong Started;
+        public ulong Depth;
+        public ulong MaxDepth;
+        public ulong WaitNs;
+        public ulong MaxWaitNs;
+    }
+
+    // Mirrors aesgcmsiv_engine_stats, whose lanes are indexed by AESGCMSIV_LANE_*
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct NativeEngineStats
+    {
+        public NativeEngineLaneStats Latency;
+        public NativeEngineLaneStats Bulk;
+        public ulong Preemptions;
+    }
+
+    // Mirrors aesgcmsiv_probe_result
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct NativeProbeResult
+    {
+        public IntPtr Backend;
+        public ulong Bytes;
+        public ulong Cycles;
+        public ulong Ns;
+        public ulong ExpectedCycles;
+    }
+
+    // Mirrors aesgcmsiv_tuning
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct NativeTuning
+    {
+        public nuint ParallelMinBytes;
+        public nuint BatchChunkItems;
+        public nuint LaneMaxBlocks;
+    }
+
+    // Mirrors aesgcmsiv_iovec and aesgcmsiv_iovec_out
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct NativeIoVec
+    {
+        public IntPtr Data;
+        public nuint Length;
+    }
+}
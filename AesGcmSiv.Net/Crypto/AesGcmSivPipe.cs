@@ -0,0 +1,195 @@
+using System.Buffers;
+using System.IO.Pipelines;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Encrypts or decrypts between a <see cref="PipeReader"/> and a <see cref="PipeWriter"/> in the
+    /// chunked format of <see cref="AesGcmSivStream"/>.
+    /// </summary>
+    /// <remarks>
+    /// Each chunk is taken straight from the reader's <see cref="ReadOnlySequence{T}"/>: a chunk that
+    /// spans several segments is passed to native code as one I/O vector per segment instead of being
+    /// copied together. Its output is written straight into memory from
+    /// <see cref="PipeWriter.GetSpan(int)"/>, so no intermediate buffer is used. When decrypting, a
+    /// chunk is advanced into the writer only after its tag verifies.
+    ///
+    /// A chunk is sealed or opened only once it and one more byte are buffered in the reader, which is
+    /// how the last chunk is told apart. The reader must therefore be able to hold a whole chunk: for a
+    /// <see cref="Pipe"/>, set <see cref="PipeOptions.PauseWriterThreshold"/> above the chunk size plus
+    /// 17 bytes, or the writer feeding it stalls. Neither pipe is completed; the caller completes them
+    /// once the returned task finishes.
+    /// </remarks>
+    public static class AesGcmSivPipe
+    {
+        private const int TagSize = 16;
+        private const int NonceSize = 12;
+
+        /// <summary>
+        /// Encrypts everything read from <paramref name="source"/> until it completes into
+        /// <paramref name="destination"/>.
+        /// </summary>
+        /// <param name="source">The plaintext.</param>
+        /// <param name="destination">Receives the encrypted stream.</param>
+        /// <param name="aesGcmSiv">The key to use.</param>
+        /// <param name="chunkSize">
+        /// Plaintext bytes per chunk, from 1 to <see cref="AesGcmSivStream.MaxChunkSize"/>.
+        /// </param>
+        /// <param name="associatedData">Optional additional authenticated data, bound to every chunk.</param>
+        /// <param name="cancellationToken">The token to monitor for cancellation requests.</param>
+        /// <returns>A task that completes once the last chunk has been flushed to <paramref name="destination"/>.</returns>
+        /// <exception cref="ArgumentNullException"><paramref name="source"/>, <paramref name="destination"/> or <paramref name="aesGcmSiv"/> is null.</exception>
+        /// <exception cref="ArgumentOutOfRangeException"><paramref name="chunkSize"/> is out of range.</exception>
+        /// <exception cref="CryptographicException">Encryption failed, or the stream has too many chunks.</exception>
+        public static async Task EncryptAsync(
+            PipeReader source,
+            PipeWriter destination,
+            AesGcmSiv aesGcmSiv,
+            int chunkSize = AesGcmSivStream.DefaultChunkSize,
+            byte[]? associatedData = null,
+            CancellationToken cancellationToken = default)
+        {
+            ArgumentNullException.ThrowIfNull(source);
+            ArgumentNullException.ThrowIfNull(destination);
+            ArgumentNullException.ThrowIfNull(aesGcmSiv);
+            ArgumentOutOfRangeException.ThrowIfNegativeOrZero(chunkSize);
+            ArgumentOutOfRangeException.ThrowIfGreaterThan(chunkSize, AesGcmSivStream.MaxChunkSize);
+
+            var prefix = new byte[AesGcmSivStream.PrefixSize];
+            AesGcmSivStream.WriteHeader(destination.GetSpan(AesGcmSivStream.HeaderSize), chunkSize, prefix);
+            destination.Advance(AesGcmSivStream.HeaderSize);
+
+            ulong index = 0;
+            while (true)
+            {
+                ReadResult result = await source.ReadAsync(cancellationToken).ConfigureAwait(false);
+                ReadOnlySequence<byte> buffer = result.Buffer;
+                // A chunk is known not to be the last only once a byte past it has arrived
+                while (buffer.Length > chunkSize)
+                {
+                    SealChunk(aesGcmSiv, prefix, index++, buffer.Slice(0, chunkSize), last: false, destination, associatedData);
+                    buffer = buffer.Slice(chunkSize);
+                }
+                if (result.IsCompleted)
+                {
+                    SealChunk(aesGcmSiv, prefix, index, buffer, last: true, destination, associatedData);
+                    source.AdvanceTo(buffer.End);
+                    await destination.FlushAsync(cancellationToken).ConfigureAwait(false);
+                    return;
+                }
+                source.AdvanceTo(buffer.Start, buffer.End);
+                cancellationToken.ThrowIfCancellationRequested();
+                FlushResult flushed = await destination.FlushAsync(cancellationToken).ConfigureAwait(false);
+                if (flushed.IsCompleted)
+                    return;
+            }
+        }
+
+        /// <summary>
+        /// Decrypts the encrypted stream read from <paramref name="source"/> into
+        /// <paramref name="destination"/>.
+        /// </summary>
+        /// <param name="source">The encrypted stream, as written by <see cref="EncryptAsync"/> or <see cref="AesGcmSivStream"/>.</param>
+        /// <param name="destination">Receives the plaintext.</param>
+        /// <param name="aesGcmSiv">The key the stream was encrypted with.</param>
+        /// <param name="associatedData">The additional authenticated data the stream was encrypted with, if any.</param>
+        /// <param name="cancellationToken">The token to monitor for cancellation requests.</param>
+        /// <returns>A task that completes once the last chunk has been flushed to <paramref name="destination"/>.</returns>
+        /// <exception cref="ArgumentNullException"><paramref name="source"/>, <paramref name="destination"/> or <paramref name="aesGcmSiv"/> is null.</exception>
+        /// <exception cref="CryptographicException">
+        /// The data is not a valid stream for this key and associated data, or has been truncated or altered.
+        /// Every chunk before the failing one has already been written.
+        /// </exception>
+        public static async Task DecryptAsync(
+            PipeReader source,
+            PipeWriter destination,
+            AesGcmSiv aesGcmSiv,
+            byte[]? associatedData = null,
+            CancellationToken cancellationToken = default)
+        {
+            ArgumentNullException.ThrowIfNull(source);
+            ArgumentNullException.ThrowIfNull(destination);
+            ArgumentNullException.ThrowIfNull(aesGcmSiv);
+
+            var prefix = new byte[AesGcmSivStream.PrefixSize];
+            int chunkSize = 0;
+            ulong index = 0;
+            while (true)
+            {
+                ReadResult result = await source.ReadAsync(cancellationToken).ConfigureAwait(false);
+                ReadOnlySequence<byte> buffer = result.Buffer;
+                if (chunkSize == 0)
+                {
+                    if (buffer.Length < AesGcmSivStream.HeaderSize && !result.IsCompleted)
+                    {
+                        source.AdvanceTo(buffer.Start, buffer.End);
+                        continue;
+                    }
+                    chunkSize = ReadHeader(ref buffer, prefix);
+                }
+
+                int full = chunkSize + TagSize;
+                while (buffer.Length > full)
+                {
+                    OpenChunk(aesGcmSiv, prefix, index++, buffer.Slice(0, full), last: false, destination, associatedData);
+                    buffer = buffer.Slice(full);
+                }
+                if (result.IsCompleted)
+                {
+                    if (buffer.Length < TagSize)
+                        throw new CryptographicException("The stream has been truncated.");
+                    OpenChunk(aesGcmSiv, prefix, index, buffer, last: true, destination, associatedData);
+                    source.AdvanceTo(buffer.End);
+                    await destination.FlushAsync(cancellationToken).ConfigureAwait(false);
+                    return;
+                }
+                source.AdvanceTo(buffer.Start, buffer.End);
+                cancellationToken.ThrowIfCancellationRequested();
+                FlushResult flushed = await destination.FlushAsync(cancellationToken).ConfigureAwait(false);
+                if (flushed.IsCompleted)
+                    return;
+            }
+        }
+
+        // Parses the header at the start of buffer and moves buffer past it,
+        // returning the chunk size
+        private static int ReadHeader(ref ReadOnlySequence<byte> buffer, byte[] prefix)
+        {
+            Span<byte> header = stackalloc byte[AesGcmSivStream.HeaderSize];
+            int length = (int)Math.Min(buffer.Length, header.Length);
+            buffer.Slice(0, length).CopyTo(header);
+            int chunkSize = AesGcmSivStream.ParseHeader(header, length, prefix);
+            buffer = buffer.Slice(length);
+            return chunkSize;
+        }
+
+        private static void SealChunk(
+            AesGcmSiv aesGcmSiv, byte[] prefix, ulong index, in ReadOnlySequence<byte> chunk, bool last,
+            PipeWriter destination, byte[]? associatedData)
+        {
+            Span<byte> nonce = stackalloc byte[NonceSize];
+            AesGcmSivStream.ChunkNonce(prefix, index, last, nonce);
+            int length = (int)chunk.Length;
+            Span<byte> output = destination.GetSpan(length + TagSize);
+            aesGcmSiv.Encrypt(nonce, chunk, output.Slice(0, length), output.Slice(length, TagSize), associatedData);
+            destination.Advance(length + TagSize);
+        }
+
+        // Opens one sealed chunk into the writer's memory, advancing the
+        // writer only once it has verified
+        private static void OpenChunk(
+            AesGcmSiv aesGcmSiv, byte[] prefix, ulong index, in ReadOnlySequence<byte> sealedChunk, bool last,
+            PipeWriter destination, byte[]? associatedData)
+        {
+            Span<byte> nonce = stackalloc byte[NonceSize];
+            AesGcmSivStream.ChunkNonce(prefix, index, last, nonce);
+            int length = (int)sealedChunk.Length - TagSize;
+            Span<byte> tag = stackalloc byte[TagSize];
+            sealedChunk.Slice(length).CopyTo(tag);
+            Span<byte> output = destination.GetSpan(length);
+            if (!aesGcmSiv.TryDecrypt(nonce, sealedChunk.Slice(0, length), tag, output.Slice(0, length), associatedData))
+                throw new CryptographicException("A stream chunk failed to authenticate.");
+            destination.Advance(length);
+        }
+    }
+}
@@ -0,0 +1,65 @@
+using System.Buffers;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Exactly sized memory over an array rented from <see cref="ArrayPool{T}.Shared"/>, as returned by
+    /// <see cref="AesGcmSiv.SealPooled"/> and <see cref="AesGcmSiv.OpenPooled"/>.
+    /// </summary>
+    /// <remarks>
+    /// <see cref="MemoryPool{T}.Shared"/> rents from the same arrays but allocates a new owner per call
+    /// and hands out the whole array, so this keeps its own owner. Each thread caches one disposed owner
+    /// for its next rental, which makes a rent and dispose on the same thread allocation-free once the
+    /// array pool is warm. The memory must not be touched, nor the owner disposed again, after
+    /// <see cref="Dispose"/>: the owner may already be serving another call.
+    /// </remarks>
+    internal sealed class AesGcmSivPooledBuffer : IMemoryOwner<byte>
+    {
+        [ThreadStatic]
+        private static AesGcmSivPooledBuffer? t_cached;
+
+        private byte[]? _array;
+        private int _length;
+        private bool _clearOnReturn;
+
+        private AesGcmSivPooledBuffer()
+        {
+        }
+
+        /// <summary>
+        /// Rents <paramref name="length"/> bytes. With <paramref name="clearOnReturn"/> the array is
+        /// zeroed before it goes back to the pool, for plaintext.
+        /// </summary>
+        internal static AesGcmSivPooledBuffer Rent(int length, bool clearOnReturn)
+        {
+            AesGcmSivPooledBuffer owner = t_cached ?? new AesGcmSivPooledBuffer();
+            t_cached = null;
+            owner._array = ArrayPool<byte>.Shared.Rent(length);
+            owner._length = length;
+            owner._clearOnReturn = clearOnReturn;
+            return owner;
+        }
+
+        public Memory<byte> Memory
+        {
+            get
+            {
+                byte[]? array = _array;
+                ObjectDisposedException.ThrowIf(array == null, this);
+                return new Memory<byte>(array, 0, _length);
+            }
+        }
+
+        public void Dispose()
+        {
+            byte[]? array = _array;
+            if (array == null)
+                return;
+            _array = null;
+            if (_clearOnReturn)
+                CryptographicOperations.ZeroMemory(array.AsSpan(0, _length));
+            ArrayPool<byte>.Shared.Return(array);
+            t_cached ??= this;
+        }
+    }
+}
@@ -0,0 +1,21 @@
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Options for <see cref="AesGcmSiv.Preload(AesGcmSivPreloadOptions)"/>.
+    /// </summary>
+    /// <remarks>
+    /// Values match the <c>AESGCMSIV_INIT_*</c> flags in <c>aesgcmsiv.h</c>.
+    /// </remarks>
+    [Flags]
+    public enum AesGcmSivPreloadOptions : uint
+    {
+        /// <summary>Default initialization.</summary>
+        None = 0,
+
+        /// <summary>
+        /// Do not read the OpenSSL configuration file. Only takes effect if OpenSSL has not already
+        /// been initialized in the process.
+        /// </summary>
+        SkipOpenSslConfig = 1u << 0,
+    }
+}
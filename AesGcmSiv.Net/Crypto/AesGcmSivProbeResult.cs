@@ -0,0 +1,51 @@
+using System.Runtime.InteropServices;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// One measurement of the native backend's speed, taken by <see cref="AesGcmSivHealthProbe.Measure"/>.
+    /// </summary>
+    /// <remarks>
+    /// Cycles come from the time stamp counter on x86, which counts reference cycles at a fixed rate
+    /// whatever the core clock; from the virtual counter on ARM64; and are nanoseconds elsewhere. Only
+    /// the hand-written x86 kernels have a reference figure to compare against.
+    /// </remarks>
+    public readonly struct AesGcmSivProbeResult
+    {
+        internal AesGcmSivProbeResult(in NativeProbeResult result)
+        {
+            Backend = Marshal.PtrToStringAnsi(result.Backend) ?? string.Empty;
+            Bytes = (long)result.Bytes;
+            Cycles = (long)result.Cycles;
+            Duration = TimeSpan.FromTicks((long)(result.Ns / 100));
+            ExpectedCycles = (long)result.ExpectedCycles;
+        }
+
+        /// <summary>Gets the backend measured, as <see cref="AesGcmSiv.BackendName"/> reports it.</summary>
+        public string Backend { get; }
+
+        /// <summary>Gets the bytes each run encrypted.</summary>
+        public long Bytes { get; }
+
+        /// <summary>Gets the cycles the fastest run took.</summary>
+        public long Cycles { get; }
+
+        /// <summary>Gets the time the fastest run took.</summary>
+        public TimeSpan Duration { get; }
+
+        /// <summary>
+        /// Gets the most cycles a healthy host of this backend takes for <see cref="Bytes"/>, roughly
+        /// twice what one measures; 0 if the backend has no reference.
+        /// </summary>
+        public long ExpectedCycles { get; }
+
+        /// <summary>Gets the cycles per byte of the fastest run.</summary>
+        public double CyclesPerByte => Bytes == 0 ? 0 : (double)Cycles / Bytes;
+
+        /// <summary>
+        /// Gets <see cref="Cycles"/> over <see cref="ExpectedCycles"/>: above 1 the host is slower than
+        /// a healthy one should be. 0 if the backend has no reference.
+        /// </summary>
+        public double Ratio => ExpectedCycles == 0 ? 0 : (double)Cycles / ExpectedCycles;
+    }
+}
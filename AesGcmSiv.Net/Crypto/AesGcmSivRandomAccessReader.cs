@@ -0,0 +1,427 @@
+using Microsoft.Win32.SafeHandles;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Reads any byte range of the plaintext of an <see cref="AesGcmSivStream"/>, decrypting only the
+    /// chunks that cover it.
+    /// </summary>
+    /// <remarks>
+    /// Meant for serving ranges, such as HTTP Range requests, from encrypted objects: the chunk that
+    /// holds an offset is found from the chunk size in the header, so a read costs the same wherever it
+    /// starts. Every chunk is verified before any of it is returned, and the last chunk is told apart by
+    /// its position at the end of the data, so a truncated object fails to authenticate.
+    ///
+    /// Decrypted chunks are kept until a read moves past them. With <see cref="PrefetchChunks"/> set,
+    /// each read also starts decrypting the chunks that follow it on the thread pool, in parallel, so
+    /// that a client reading the object in order finds them ready. Reads may be issued from several
+    /// threads at once.
+    ///
+    /// A stream written with <see cref="AesGcmSivStream.TagManifest"/> set is opened from its sealed
+    /// manifest, which gives the chunk count without reading the last chunk, and each chunk read is
+    /// also checked against the root of the tag tree, through one node per level. Compare
+    /// <see cref="ManifestRoot"/> with a root kept from when the object was written to be sure every
+    /// chunk read belongs to that version.
+    ///
+    /// With <see cref="ChunkCache"/> set, every chunk the reader verifies is also kept in that cache,
+    /// which may be shared by many readers, and later reads of it are served from there without
+    /// reading or decrypting it again.
+    /// </remarks>
+    public sealed class AesGcmSivRandomAccessReader : IDisposable
+    {
+        private const int TagSize = 16;
+        private const int NonceSize = 12;
+
+        private readonly SafeFileHandle? _file;
+        private readonly Stream? _stream;  // reads are serialized on it
+        private readonly bool _leaveOpen;
+        private readonly AesGcmSiv _aesGcmSiv;
+        private readonly byte[]? _associatedData;
+        private readonly byte[] _prefix = new byte[AesGcmSivStream.PrefixSize];
+        private readonly long _chunkCount;
+        private readonly int _lastSealedLength;
+        private readonly byte[]? _root;  // with a tag manifest, like _treeStart
+        private readonly long _treeStart;  // where the tree's nodes start
+        private readonly Dictionary<long, Task<byte[]>> _chunks = new();  // guarded by itself
+        private int _prefetchChunks;
+        private AesGcmSivChunkCache? _cache;
+        private long _cacheStream;  // this reader's stream ID in _cache
+        private bool _reading;  // a read has started
+        private bool _disposed;
+
+        /// <summary>
+        /// Initializes a reader over an encrypted file. The handle stays owned by the caller and must stay
+        /// open until the reader is disposed.
+        /// </summary>
+        /// <param name="file">A handle to the file, open for reading.</param>
+        /// <param name="aesGcmSiv">The key the object was encrypted with. Must stay undisposed until the reader is disposed.</param>
+        /// <param name="associatedData">The additional authenticated data the object was encrypted with, if any.</param>
+        /// <exception cref="ArgumentNullException"><paramref name="file"/> or <paramref name="aesGcmSiv"/> is null.</exception>
+        /// <exception cref="CryptographicException">The file does not hold a valid header, or its length is not that of a whole stream.</exception>
+        public AesGcmSivRandomAccessReader(SafeFileHandle file, AesGcmSiv aesGcmSiv, byte[]? associatedData = null)
+            : this(file, null, false, aesGcmSiv, associatedData)
+        {
+        }
+
+        /// <summary>
+        /// Initializes a reader over a seekable stream holding an encrypted object.
+        /// </summary>
+        /// <param name="stream">The stream. Must support reading and seeking.</param>
+        /// <param name="aesGcmSiv">The key the object was encrypted with. Must stay undisposed until the reader is disposed.</param>
+        /// <param name="associatedData">The additional authenticated data the object was encrypted with, if any.</param>
+        /// <param name="leaveOpen">Whether to leave <paramref name="stream"/> open when the reader is disposed.</param>
+        /// <exception cref="ArgumentNullException"><paramref name="stream"/> or <paramref name="aesGcmSiv"/> is null.</exception>
+        /// <exception cref="ArgumentException"><paramref name="stream"/> cannot be read or cannot seek.</exception>
+        /// <exception cref="CryptographicException">The stream does not hold a valid header, or its length is not that of a whole stream.</exception>
+        public AesGcmSivRandomAccessReader(Stream stream, AesGcmSiv aesGcmSiv, byte[]? associatedData = null, bool leaveOpen = false)
+            : this(null, stream, leaveOpen, aesGcmSiv, associatedData)
+        {
+        }
+
+        private AesGcmSivRandomAccessReader(
+            SafeFileHandle? file, Stream? stream, bool leaveOpen, AesGcmSiv aesGcmSiv, byte[]? associatedData)
+        {
+            if (file == null && stream == null)
+                throw new ArgumentNullException(nameof(stream));
+            ArgumentNullException.ThrowIfNull(aesGcmSiv);
+            if (stream != null && (!stream.CanRead || !stream.CanSeek))
+                throw new ArgumentException("The stream must support reading and seeking.", nameof(stream));
+
+            _file = file;
+            _stream = stream;
+            _leaveOpen = leaveOpen;
+            _aesGcmSiv = aesGcmSiv;
+            _associatedData = associatedData;
+
+            Span<byte> header = stackalloc byte[AesGcmSivStream.HeaderSize];
+            ChunkSize = AesGcmSivStream.ParseHeader(header, ReadSource(0, header), _prefix, out bool tagManifest);
+
+            long sealedLength = SourceLength() - AesGcmSivStream.HeaderSize;
+            long manifestChunks = 0;
+            if (tagManifest)
+            {
+                // The manifest ends the stream, and the tree ahead of it has
+                // a size fixed by the chunk count it holds
+                Span<byte> sealedManifest = stackalloc byte[AesGcmSivTagTree.SealedManifestSize];
+                long position = SourceLength() - sealedManifest.Length;
+                _root = new byte[AesGcmSivTagTree.HashSize];
+                if (position < AesGcmSivStream.HeaderSize ||
+                    ReadSource(position, sealedManifest) < sealedManifest.Length ||
+                    !AesGcmSivTagTree.TryOpenManifest(aesGcmSiv, _prefix, associatedData, sealedManifest, out manifestChunks, _root) ||
+                    manifestChunks - 1 > uint.MaxValue)
+                    throw new CryptographicException("The stream's tag manifest failed to authenticate.");
+                _treeStart = position - AesGcmSivTagTree.NodeCount(manifestChunks) * AesGcmSivTagTree.HashSize;
+                sealedLength = _treeStart - AesGcmSivStream.HeaderSize;
+            }
+
+            // Every chunk but the last is full; the last holds at least a tag
+            long full = ChunkSize + TagSize;
+            _chunkCount = (sealedLength + full - 1) / full;
+            long lastSealedLength = sealedLength - (_chunkCount - 1) * full;
+            if (_chunkCount <= 0 || lastSealedLength < TagSize || _chunkCount - 1 > uint.MaxValue ||
+                (tagManifest && _chunkCount != manifestChunks))
+                throw new CryptographicException("The stream has been truncated.");
+            _lastSealedLength = (int)lastSealedLength;
+            Length = sealedLength - _chunkCount * TagSize;
+        }
+
+        /// <summary>Gets the length of the plaintext, in bytes.</summary>
+        public long Length { get; }
+
+        /// <summary>Gets the plaintext bytes per chunk, from the header.</summary>
+        public int ChunkSize { get; }
+
+        /// <summary>
+        /// Gets the root of the tag tree of a stream with a tag manifest, which identifies this version of
+        /// the object, or an empty value for a stream without one.
+        /// </summary>
+        public ReadOnlyMemory<byte> ManifestRoot => _root;
+
+        /// <summary>
+        /// Gets or sets how many chunks past the end of each read to start decrypting in the background.
+        /// The default, 0, decrypts only what is read.
+        /// </summary>
+        /// <exception cref="ArgumentOutOfRangeException">The value is negative.</exception>
+        public int PrefetchChunks
+        {
+            get => _prefetchChunks;
+            set
+            {
+                ArgumentOutOfRangeException.ThrowIfNegative(value);
+                _prefetchChunks = value;
+            }
+        }
+
+        /// <summary>
+        /// Gets or sets the cache that verified chunks are kept in and hot reads are served from, or null,
+        /// the default, for none. Set it before the first read.
+        /// </summary>
+        /// <exception cref="ArgumentException">The cache's chunk size is smaller than <see cref="ChunkSize"/>.</exception>
+        /// <exception cref="InvalidOperationException">A read has already been made.</exception>
+        public AesGcmSivChunkCache? ChunkCache
+        {
+            get => _cache;
+            set
+            {
+                if (_reading)
+                    throw new InvalidOperationException("The chunk cache cannot change once reading has started.");
+                if (value != null && value.ChunkSize < ChunkSize)
+                    throw new ArgumentException($"The cache holds chunks of at most {value.ChunkSize} bytes; this stream has {ChunkSize}.", nameof(value));
+                _cache = value;
+                _cacheStream = value?.NewStream() ?? 0;
+            }
+        }
+
+        /// <summary>
+        /// Reads plaintext starting at <paramref name="offset"/>.
+        /// </summary>
+        /// <param name="offset">The plaintext offset to read from.</param>
+        /// <param name="destination">Receives the plaintext.</param>
+        /// <returns>
+        /// The number of bytes read: the length of <paramref name="destination"/>, or less at the end of the
+        /// plaintext, where it is 0.
+        /// </returns>
+        /// <exception cref="ArgumentOutOfRangeException"><paramref name="offset"/> is negative.</exception>
+        /// <exception cref="ObjectDisposedException">The reader has been disposed.</exception>
+        /// <exception cref="CryptographicException">A chunk in the range failed to authenticate.</exception>
+        public int Read(long offset, Span<byte> destination)
+        {
+            int length = StartRead(offset, destination.Length, out long first, out long last);
+            for (long index = first, copied = 0; copied < length; index++)
+            {
+                int cached = CopyCached(index, offset + copied, destination.Slice((int)copied));
+                if (cached >= 0)
+                {
+                    copied += cached;
+                    continue;
+                }
+                Task<byte[]> chunk = GetChunk(index, inline: true);
+                copied += CopyOut(chunk.GetAwaiter().GetResult(), index, offset + copied, destination.Slice((int)copied));
+            }
+            FinishRead(first, last);
+            return length;
+        }
+
+        /// <summary>
+        /// Reads plaintext starting at <paramref name="offset"/>, decrypting the chunks of the range in
+        /// parallel on the thread pool.
+        /// </summary>
+        /// <param name="offset">The plaintext offset to read from.</param>
+        /// <param name="destination">Receives the plaintext.</param>
+        /// <param name="cancellationToken">The token to monitor for cancellation requests.</param>
+        /// <returns>The number of bytes read, as for <see cref="Read"/>.</returns>
+        /// <exception cref="ArgumentOutOfRangeException"><paramref name="offset"/> is negative.</exception>
+        /// <exception cref="ObjectDisposedException">The reader has been disposed.</exception>
+        /// <exception cref="CryptographicException">A chunk in the range failed to authenticate.</exception>
+        public async ValueTask<int> ReadAsync(long offset, Memory<byte> destination, CancellationToken cancellationToken = default)
+        {
+            int length = StartRead(offset, destination.Length, out long first, out long last);
+            var chunks = new Task<byte[]>?[length == 0 ? 0 : last - first + 1];
+            for (int i = 0; i < chunks.Length; i++)
+            {
+                // Cached chunks are copied out below instead
+                if (_cache == null || !_cache.Contains(_cacheStream, first + i, countMiss: true))
+                    chunks[i] = GetChunk(first + i, inline: false);
+            }
+            FinishRead(first, last);
+
+            long copied = 0;
+            for (int i = 0; i < chunks.Length; i++)
+            {
+                int cached = chunks[i] == null ? CopyCached(first + i, offset + copied, destination.Span.Slice((int)copied)) : -1;
+                if (cached >= 0)
+                {
+                    copied += cached;
+                    continue;
+                }
+                // A cached chunk may have been evicted since
+                byte[] chunk = await (chunks[i] ?? GetChunk(first + i, inline: false)).WaitAsync(cancellationToken).ConfigureAwait(false);
+                copied += CopyOut(chunk, first + i, offset + copied, destination.Span.Slice((int)copied));
+            }
+            return length;
+        }
+
+        /// <summary>
+        /// Drops the decrypted chunks, in the chunk cache too, and, for a reader over a stream, disposes
+        /// the stream unless it was to be left open.
+        /// </summary>
+        public void Dispose()
+        {
+            lock (_chunks)
+            {
+                if (_disposed)
+                    return;
+                _disposed = true;
+                _chunks.Clear();
+            }
+            _cache?.RemoveStream(_cacheStream);
+            if (_stream != null && !_leaveOpen)
+            {
+                lock (_stream)
+                {
+                    _stream.Dispose();
+                }
+            }
+        }
+
+        // Returns how many bytes a read of count bytes at offset gives and
+        // the chunks it covers
+        private int StartRead(long offset, int count, out long first, out long last)
+        {
+            ArgumentOutOfRangeException.ThrowIfNegative(offset);
+            ObjectDisposedException.ThrowIf(_disposed, this);
+            _reading = true;
+            int length = (int)Math.Clamp(Length - offset, 0, count);
+            first = Math.Min(offset / ChunkSize, _chunkCount - 1);
+            last = length == 0 ? first : (offset + length - 1) / ChunkSize;
+            return length;
+        }
+
+        // Drops the chunks before the read and those past the prefetch
+        // window, and starts decrypting the ones in it
+        private void FinishRead(long first, long last)
+        {
+            long end = Math.Min(_chunkCount - 1, last + _prefetchChunks);
+            lock (_chunks)
+            {
+                if (_disposed)
+                    return;
+                List<long>? stale = null;
+                foreach (long index in _chunks.Keys)
+                {
+                    if (index < first || index > end)
+                        (stale ??= new List<long>()).Add(index);
+                }
+                if (stale != null)
+                {
+                    foreach (long index in stale)
+                        _chunks.Remove(index);
+                }
+            }
+            for (long index = last + 1; index <= end; index++)
+            {
+                if (_cache == null || !_cache.Contains(_cacheStream, index))
+                    GetChunk(index, inline: false);
+            }
+        }
+
+        // The chunk's plaintext, decrypted on the calling thread if inline,
+        // otherwise on the thread pool, unless it already is or is being
+        private Task<byte[]> GetChunk(long index, bool inline)
+        {
+            Task<byte[]>? chunk;
+            lock (_chunks)
+            {
+                if (_chunks.TryGetValue(index, out chunk))
+                    return chunk;
+                if (!inline)
+                {
+                    chunk = Task.Run(() => DecryptChunk(index));
+                    if (!_disposed)
+                        _chunks[index] = chunk;
+                    return chunk;
+                }
+            }
+
+            // Another thread may decrypt the same chunk meanwhile; either copy will do
+            chunk = Task.FromResult(DecryptChunk(index));
+            lock (_chunks)
+            {
+                if (!_disposed)
+                    _chunks[index] = chunk;
+            }
+            return chunk;
+        }
+
+        // Reads and verifies one chunk, returning a buffer that starts with
+        // its plaintext
+        private byte[] DecryptChunk(long index)
+        {
+            bool last = index == _chunkCount - 1;
+            int sealedLength = last ? _lastSealedLength : ChunkSize + TagSize;
+            var buffer = new byte[sealedLength];
+            long position = AesGcmSivStream.HeaderSize + index * (ChunkSize + TagSize);
+            if (ReadSource(position, buffer) < sealedLength)
+                throw new CryptographicException("The stream has been truncated.");
+
+            Span<byte> nonce = stackalloc byte[NonceSize];
+            AesGcmSivStream.ChunkNonce(_prefix, (ulong)index, last, nonce);
+            int length = sealedLength - TagSize;
+            Span<byte> chunk = buffer.AsSpan(0, length);
+            if (!_aesGcmSiv.TryDecrypt(nonce, chunk, buffer.AsSpan(length, TagSize), chunk, _associatedData))
+                throw new CryptographicException("A stream chunk failed to authenticate.");
+            if (_root != null && !AesGcmSivTagTree.VerifyPath(_chunkCount, index, buffer.AsSpan(length, TagSize), _root, ReadNode))
+                throw new CryptographicException("A stream chunk is not in the tag manifest.");
+            if (!_disposed)
+                _cache?.Add(_cacheStream, index, chunk);
+            return buffer;
+        }
+
+        // Copies the part of chunk index at and after plaintext offset into
+        // destination from the cache, returning how much was copied, or -1 if
+        // the cache does not hold it
+        private int CopyCached(long index, long offset, Span<byte> destination)
+        {
+            if (_cache == null)
+                return -1;
+            return _cache.TryCopy(_cacheStream, index, (int)(offset - index * ChunkSize), destination);
+        }
+
+        // Copies the part of chunk index at and after plaintext offset into
+        // destination, returning how much was copied
+        private int CopyOut(byte[] chunk, long index, long offset, Span<byte> destination)
+        {
+            long chunkStart = index * ChunkSize;
+            int chunkLength = (index == _chunkCount - 1 ? _lastSealedLength : ChunkSize + TagSize) - TagSize;
+            int start = (int)(offset - chunkStart);
+            int length = Math.Min(chunkLength - start, destination.Length);
+            chunk.AsSpan(start, length).CopyTo(destination);
+            return length;
+        }
+
+        private void ReadNode(long node, Span<byte> hash)
+        {
+            if (ReadSource(_treeStart + node * AesGcmSivTagTree.HashSize, hash) < hash.Length)
+                throw new CryptographicException("The stream has been truncated.");
+        }
+
+        private int ReadSource(long position, Span<byte> buffer)
+        {
+            int filled = 0;
+            if (_file != null)
+            {
+                while (filled < buffer.Length)
+                {
+                    int read = RandomAccess.Read(_file, buffer.Slice(filled), position + filled);
+                    if (read == 0)
+                        break;
+                    filled += read;
+                }
+                return filled;
+            }
+
+            lock (_stream!)
+            {
+                _stream.Position = position;
+                while (filled < buffer.Length)
+                {
+                    int read = _stream.Read(buffer.Slice(filled));
+                    if (read == 0)
+                        break;
+                    filled += read;
+                }
+            }
+            return filled;
+        }
+
+        private long SourceLength()
+        {
+            if (_file != null)
+                return RandomAccess.GetLength(_file);
+            lock (_stream!)
+            {
+                return _stream.Length;
+            }
+        }
+    }
+}
@@ -0,0 +1,393 @@
+using System.Buffers.Binary;
+using Microsoft.Win32.SafeHandles;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// An encrypted, append-only log of records, such as audit events, that many threads append to at
+    /// once.
+    /// </summary>
+    /// <remarks>
+    /// Appends are committed in groups. The first thread to append while no commit is running commits
+    /// every record that is waiting. Records appended while that commit runs queue up and go in the
+    /// next one. A group is encrypted by one
+    /// <see cref="AesGcmSiv.EncryptColumn(ReadOnlySpan{byte}, ReadOnlySpan{int}, Span{byte}, Span{byte}, byte[], ulong)"/>
+    /// call, which runs short records through the multi-buffer kernel. It is then written as one block
+    /// with a single gathered write and, unless turned off, one flush to disk. An append returns once
+    /// its group is durable, so under load the cost of a write and a flush is shared by the whole group.
+    ///
+    /// The file holds a <see cref="HeaderSize"/>-byte header with a random base nonce, then one block
+    /// per group: the record count, the ciphertext length and each record's length, then the
+    /// ciphertexts, then their tags. Record <c>n</c> of the log is encrypted under the base nonce with
+    /// its last 8 bytes XORed with <c>n</c>, so records that are dropped, reordered or moved to another
+    /// block fail to authenticate when read. Truncating the log to a block boundary cannot be detected.
+    /// A block cut short at the end of the file, as a crash during a write leaves it, is not part of the
+    /// log: readers stop before it, and it is removed when the log is opened for appending again.
+    /// Read the log with <see cref="AesGcmSivRecordLogReader"/>.
+    /// </remarks>
+    public sealed class AesGcmSivRecordLog : IDisposable
+    {
+        /// <summary>The size of the file header, in bytes.</summary>
+        public const int HeaderSize = 20;
+
+        /// <summary>The largest record, 16 MiB.</summary>
+        public const int MaxRecordSize = 1 << 24;
+
+        internal const int BlockHeaderSize = 8;  // record count and ciphertext length
+        private const int TagSize = 16;
+        private const int NonceSize = 12;
+        private const byte FormatVersion = 1;
+        // A group stops taking records at this many bytes, holding appenders
+        // back until the commit running takes it
+        private const int MaxGroupBytes = 4 << 20;
+
+        private readonly FileStream _file;
+        private readonly AesGcmSiv _aesGcmSiv;
+        private readonly bool _flushToDisk;
+        private readonly byte[] _baseNonce = new byte[NonceSize];
+        private readonly object _gate = new();
+        private Group _open;  // guarded by _gate, like the three below
+        private bool _committing;
+        private Exception? _failure;
+        private bool _disposed;
+        private long _length;  // only the committing thread touches it
+
+        /// <summary>
+        /// Opens the log at <paramref name="path"/> for appending, creating it if it does not exist.
+        /// </summary>
+        /// <param name="path">The log file.</param>
+        /// <param name="aesGcmSiv">The key to encrypt with. Must stay undisposed until the log is disposed.</param>
+        /// <param name="flushToDisk">
+        /// Whether each commit waits for its block to reach the disk. Turn off only where losing the last
+        /// few groups in a crash is acceptable.
+        /// </param>
+        /// <exception cref="ArgumentNullException"><paramref name="path"/> or <paramref name="aesGcmSiv"/> is null.</exception>
+        /// <exception cref="CryptographicException">The file exists but does not hold a valid log.</exception>
+        /// <exception cref="IOException">The file could not be opened or read.</exception>
+        public AesGcmSivRecordLog(string path, AesGcmSiv aesGcmSiv, bool flushToDisk = true)
+        {
+            ArgumentNullException.ThrowIfNull(path);
+            ArgumentNullException.ThrowIfNull(aesGcmSiv);
+
+            _aesGcmSiv = aesGcmSiv;
+            _flushToDisk = flushToDisk;
+            _file = new FileStream(path, FileMode.OpenOrCreate, FileAccess.ReadWrite, FileShare.Read, bufferSize: 0);
+            try
+            {
+                long records = 0;
+                if (_file.Length == 0)
+                {
+                    var header = new byte[HeaderSize];
+                    WriteHeader(header, _baseNonce);
+                    RandomAccess.Write(_file.SafeFileHandle, header, 0);
+                    _file.Flush(flushToDisk);
+                    _length = HeaderSize;
+                }
+                else
+                {
+                    ReadHeader(_file.SafeFileHandle, _baseNonce);
+                    _length = ScanBlocks(_file.SafeFileHandle, _file.Length, out records);
+                    if (_length < _file.Length)
+                    {
+                        // A torn last block; later blocks must follow on from the
+                        // last whole one
+                        _file.SetLength(_length);
+                        _file.Flush(flushToDisk);
+                    }
+                }
+                _open = new Group(records);
+            }
+            catch
+            {
+                _file.Dispose();
+                throw;
+            }
+        }
+
+        /// <summary>Gets the number of records appended so far, including any not yet committed.</summary>
+        public long RecordCount
+        {
+            get
+            {
+                lock (_gate)
+                {
+                    return _open.FirstRecord + _open.Count;
+                }
+            }
+        }
+
+        /// <summary>
+        /// Appends a record and waits until the group holding it has been written.
+        /// </summary>
+        /// <param name="record">The record, up to <see cref="MaxRecordSize"/> bytes.</param>
+        /// <returns>The record's number in the log, counting from 0.</returns>
+        /// <exception cref="ObjectDisposedException">The log has been disposed.</exception>
+        /// <exception cref="ArgumentException"><paramref name="record"/> is larger than <see cref="MaxRecordSize"/>.</exception>
+        /// <exception cref="IOException">
+        /// The group could not be written. The log takes no more records after a failed commit.
+        /// </exception>
+        /// <exception cref="CryptographicException">The group could not be encrypted.</exception>
+        public long Append(ReadOnlySpan<byte> record)
+        {
+            long number = Enqueue(record, out Group group, out bool lead);
+            if (lead)
+                CommitPending(group);
+            group.Committed.Task.GetAwaiter().GetResult();
+            return number;
+        }
+
+        /// <summary>
+        /// Appends a record and completes once the group holding it has been written. If no commit is
+        /// running, one is started on the thread pool.
+        /// </summary>
+        /// <param name="record">The record, up to <see cref="MaxRecordSize"/> bytes. Copied before this method returns.</param>
+        /// <param name="cancellationToken">
+        /// The token to monitor for cancellation requests. Cancelling stops the wait, not the append: the
+        /// record is still written with its group.
+        /// </param>
+        /// <returns>The record's number in the log, counting from 0.</returns>
+        /// <exception cref="ObjectDisposedException">The log has been disposed.</exception>
+        /// <exception cref="ArgumentException"><paramref name="record"/> is larger than <see cref="MaxRecordSize"/>.</exception>
+        public Task<long> AppendAsync(ReadOnlyMemory<byte> record, CancellationToken cancellationToken = default)
+        {
+            long number = Enqueue(record.Span, out Group group, out bool lead);
+            if (lead)
+                _ = Task.Run(() => CommitPending(null));
+            return WaitAsync(group, number, cancellationToken);
+        }
+
+        /// <summary>
+        /// Waits for any commit in progress, then closes the file. Records appended before this call are
+        /// written first.
+        /// </summary>
+        public void Dispose()
+        {
+            lock (_gate)
+            {
+                if (_disposed)
+                    return;
+                _disposed = true;
+                while (_committing)
+                    Monitor.Wait(_gate);
+                Monitor.PulseAll(_gate);
+            }
+            _file.Dispose();
+        }
+
+        private static async Task<long> WaitAsync(Group group, long number, CancellationToken cancellationToken)
+        {
+            await group.Committed.Task.WaitAsync(cancellationToken).ConfigureAwait(false);
+            return number;
+        }
+
+        // Copies record into the open group, returning its number; lead is set
+        // if the caller must run the commit
+        private long Enqueue(ReadOnlySpan<byte> record, out Group group, out bool lead)
+        {
+            if (record.Length > MaxRecordSize)
+                throw new ArgumentException($"A record can be at most {MaxRecordSize} bytes.", nameof(record));
+
+            lock (_gate)
+            {
+                while (true)
+                {
+                    ObjectDisposedException.ThrowIf(_disposed, this);
+                    if (_failure != null)
+                        throw new IOException("An earlier commit to the log failed.", _failure);
+                    // A group that is not empty always has a commit coming for it
+                    if (_open.Count == 0 || _open.Length + record.Length <= MaxGroupBytes)
+                        break;
+                    Monitor.Wait(_gate);
+                }
+
+                group = _open;
+                long number = group.FirstRecord + group.Count;
+                group.Add(record);
+                lead = !_committing;
+                _committing = true;
+                return number;
+            }
+        }
+
+        // Commits groups until none is waiting. A thread that commits on the
+        // way to its own record stops once own is written and leaves the rest
+        // to the thread pool, so a steady stream of appends cannot hold it.
+        private void CommitPending(Group? own)
+        {
+            while (true)
+            {
+                Group group;
+                lock (_gate)
+                {
+                    if (_open.Count == 0)
+                    {
+                        _committing = false;
+                        Monitor.PulseAll(_gate);
+                        return;
+                    }
+                    if (own != null && own.Committed.Task.IsCompleted)
+                    {
+                        _ = Task.Run(() => CommitPending(null));
+                        return;
+                    }
+                    group = _open;
+                    _open = new Group(group.FirstRecord + group.Count);
+                    Monitor.PulseAll(_gate);
+                }
+
+                try
+                {
+                    Commit(group);
+                }
+                catch (Exception e)
+                {
+                    // Later records would be numbered past a gap, so nothing more
+                    // is accepted, and whatever queued behind this group fails too
+                    Group next;
+                    lock (_gate)
+                    {
+                        _failure = e;
+                        next = _open;
+                        _open = new Group(next.FirstRecord);
+                    }
+                    group.Committed.TrySetException(e);
+                    if (next.Count != 0)
+                        next.Committed.TrySetException(e);
+                    continue;
+                }
+                group.Committed.TrySetResult();
+            }
+        }
+
+        // Encrypts a group in place and writes it as one block
+        private void Commit(Group group)
+        {
+            int count = group.Count;
+            var header = new byte[BlockHeaderSize + count * sizeof(int)];
+            BinaryPrimitives.WriteInt32LittleEndian(header, count);
+            BinaryPrimitives.WriteInt32LittleEndian(header.AsSpan(4), group.Length);
+            for (int i = 0; i < count; i++)
+            {
+                BinaryPrimitives.WriteInt32LittleEndian(
+                    header.AsSpan(BlockHeaderSize + i * sizeof(int)), group.Offsets[i + 1] - group.Offsets[i]);
+            }
+
+            var values = group.Values.AsMemory(0, group.Length);
+            var tags = new byte[count * TagSize];
+            _aesGcmSiv.EncryptColumn(
+                values.Span, group.Offsets.AsSpan(0, count + 1), values.Span, tags, _baseNonce, (ulong)group.FirstRecord);
+
+            RandomAccess.Write(_file.SafeFileHandle, new ReadOnlyMemory<byte>[] { header, values, tags }, _length);
+            _file.Flush(_flushToDisk);
+            _length += header.Length + values.Length + tags.Length;
+        }
+
+        private static void WriteHeader(Span<byte> header, Span<byte> baseNonce)
+        {
+            RandomNumberGenerator.Fill(baseNonce);
+            "AGSL"u8.CopyTo(header);
+            header[4] = FormatVersion;
+            baseNonce.CopyTo(header.Slice(8));
+        }
+
+        // Reads and checks the header of a log, copying out its base nonce
+        internal static void ReadHeader(SafeFileHandle file, Span<byte> baseNonce)
+        {
+            Span<byte> header = stackalloc byte[HeaderSize];
+            if (ReadExactly(file, header, 0) < HeaderSize)
+                throw new CryptographicException("The file is too short to hold a log header.");
+            if (!header.Slice(0, 4).SequenceEqual("AGSL"u8) || header[4] != FormatVersion)
+                throw new CryptographicException("The log header is not valid.");
+            header.Slice(8, NonceSize).CopyTo(baseNonce);
+        }
+
+        // Reads the count and ciphertext length of the block at offset,
+        // returning the block's total length, or -1 if the file ends before
+        // it does
+        internal static long ReadBlockHeader(SafeFileHandle file, long offset, long fileLength, out int count, out int length)
+        {
+            Span<byte> header = stackalloc byte[BlockHeaderSize];
+            count = 0;
+            length = 0;
+            if (fileLength - offset < BlockHeaderSize || ReadExactly(file, header, offset) < BlockHeaderSize)
+                return -1;
+            count = BinaryPrimitives.ReadInt32LittleEndian(header);
+            length = BinaryPrimitives.ReadInt32LittleEndian(header.Slice(4));
+            // A crash can leave the file extended over zeros the write never
+            // reached
+            if (count == 0 && length == 0)
+                return -1;
+            if (count <= 0 || length < 0)
+                throw new CryptographicException("A log block header is not valid.");
+            long total = BlockHeaderSize + (long)count * (sizeof(int) + TagSize) + length;
+            return fileLength - offset < total ? -1 : total;
+        }
+
+        // Walks the blocks after the header, returning where the last whole
+        // one ends
+        private static long ScanBlocks(SafeFileHandle file, long fileLength, out long records)
+        {
+            long offset = HeaderSize;
+            records = 0;
+            while (true)
+            {
+                long total = ReadBlockHeader(file, offset, fileLength, out int count, out _);
+                if (total < 0)
+                    return offset;
+                offset += total;
+                records += count;
+            }
+        }
+
+        // Reads until buffer is full or the file ends, returning the bytes read
+        internal static int ReadExactly(SafeFileHandle file, Span<byte> buffer, long offset)
+        {
+            int total = 0;
+            while (total < buffer.Length)
+            {
+                int read = RandomAccess.Read(file, buffer.Slice(total), offset + total);
+                if (read == 0)
+                    break;
+                total += read;
+            }
+            return total;
+        }
+
+        // Records waiting for one commit, laid out as a column: record i is
+        // Values[Offsets[i]..Offsets[i + 1]]
+        private sealed class Group
+        {
+            public Group(long firstRecord)
+            {
+                FirstRecord = firstRecord;
+            }
+
+            public long FirstRecord { get; }
+            public int Count { get; private set; }
+            public int Length => Offsets[Count];
+            public byte[] Values { get; private set; } = Array.Empty<byte>();
+            public int[] Offsets { get; private set; } = new int[1];
+            public TaskCompletionSource Committed { get; } = new(TaskCreationOptions.RunContinuationsAsynchronously);
+
+            public void Add(ReadOnlySpan<byte> record)
+            {
+                if (Count + 1 == Offsets.Length)
+                {
+                    var offsets = Offsets;
+                    Array.Resize(ref offsets, Offsets.Length * 2);
+                    Offsets = offsets;
+                }
+                int length = Length;
+                if (Values.Length - length < record.Length)
+                {
+                    var values = Values;
+                    Array.Resize(ref values, Math.Max(Math.Max(values.Length * 2, 4096), length + record.Length));
+                    Values = values;
+                }
+                record.CopyTo(Values.AsSpan(length));
+                Offsets[Count + 1] = length + record.Length;
+                Count++;
+            }
+        }
+    }
+}
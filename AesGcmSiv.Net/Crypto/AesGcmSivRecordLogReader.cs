@@ -0,0 +1,133 @@
+using System.Buffers.Binary;
+using Microsoft.Win32.SafeHandles;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Replays the records of an <see cref="AesGcmSivRecordLog"/> in order.
+    /// </summary>
+    /// <remarks>
+    /// Each block, one group commit of the writer, is read with one call and decrypted with one
+    /// <see cref="AesGcmSiv.DecryptColumn(ReadOnlySpan{byte}, ReadOnlySpan{int}, ReadOnlySpan{byte}, Span{byte}, byte[], ulong, Span{bool})"/>
+    /// call, and every record in it is verified before any is returned. The log may be open for
+    /// appending while it is read; reading stops at the last block that was whole when it was reached.
+    /// </remarks>
+    public sealed class AesGcmSivRecordLogReader : IDisposable
+    {
+        private const int NonceSize = 12;
+
+        private readonly SafeFileHandle _file;
+        private readonly AesGcmSiv _aesGcmSiv;
+        private readonly byte[] _baseNonce = new byte[NonceSize];
+        private long _offset = AesGcmSivRecordLog.HeaderSize;  // of the next block
+        private byte[] _block = Array.Empty<byte>();  // the current block's plaintext
+        private int[] _offsets = new int[1];  // of its records within _block
+        private int _count;
+        private int _index;
+        private long _firstRecord;
+
+        /// <summary>
+        /// Opens the log at <paramref name="path"/> for reading.
+        /// </summary>
+        /// <param name="path">The log file.</param>
+        /// <param name="aesGcmSiv">The key the log was written with. Must stay undisposed until the reader is disposed.</param>
+        /// <exception cref="ArgumentNullException"><paramref name="path"/> or <paramref name="aesGcmSiv"/> is null.</exception>
+        /// <exception cref="CryptographicException">The file does not hold a valid log header.</exception>
+        /// <exception cref="IOException">The file could not be opened or read.</exception>
+        public AesGcmSivRecordLogReader(string path, AesGcmSiv aesGcmSiv)
+        {
+            ArgumentNullException.ThrowIfNull(path);
+            ArgumentNullException.ThrowIfNull(aesGcmSiv);
+
+            _aesGcmSiv = aesGcmSiv;
+            _file = File.OpenHandle(path, FileMode.Open, FileAccess.Read, FileShare.ReadWrite, FileOptions.SequentialScan);
+            try
+            {
+                AesGcmSivRecordLog.ReadHeader(_file, _baseNonce);
+            }
+            catch
+            {
+                _file.Dispose();
+                throw;
+            }
+        }
+
+        /// <summary>
+        /// Reads the next record.
+        /// </summary>
+        /// <param name="recordNumber">Receives the record's number in the log, counting from 0.</param>
+        /// <param name="record">
+        /// Receives the plaintext. It is only valid until the next call, which may reuse its memory.
+        /// </param>
+        /// <returns>Whether a record was read; false at the end of the log.</returns>
+        /// <exception cref="CryptographicException">
+        /// A record failed to authenticate, or a block is not valid. The message names the record.
+        /// </exception>
+        /// <exception cref="IOException">The file could not be read.</exception>
+        public bool TryRead(out long recordNumber, out ReadOnlyMemory<byte> record)
+        {
+            if (_index == _count && !ReadBlock())
+            {
+                recordNumber = 0;
+                record = default;
+                return false;
+            }
+            recordNumber = _firstRecord + _index;
+            record = _block.AsMemory(_offsets[_index], _offsets[_index + 1] - _offsets[_index]);
+            _index++;
+            return true;
+        }
+
+        /// <summary>Closes the file.</summary>
+        public void Dispose()
+        {
+            _file.Dispose();
+        }
+
+        // Reads and opens the next block, returning false at the end of the log
+        private bool ReadBlock()
+        {
+            long fileLength = RandomAccess.GetLength(_file);
+            long total = AesGcmSivRecordLog.ReadBlockHeader(_file, _offset, fileLength, out int count, out int length);
+            if (total < 0)
+                return false;
+
+            long firstRecord = _firstRecord + _count;
+            var sealedBlock = new byte[total - AesGcmSivRecordLog.BlockHeaderSize];
+            if (AesGcmSivRecordLog.ReadExactly(_file, sealedBlock, _offset + AesGcmSivRecordLog.BlockHeaderSize) < sealedBlock.Length)
+                return false;
+
+            if (_offsets.Length < count + 1)
+                _offsets = new int[count + 1];
+            long sum = 0;
+            for (int i = 0; i < count && sum <= length; i++)
+            {
+                int recordLength = BinaryPrimitives.ReadInt32LittleEndian(sealedBlock.AsSpan(i * sizeof(int)));
+                sum = recordLength < 0 ? long.MaxValue : sum + recordLength;
+                _offsets[i + 1] = (int)Math.Min(sum, int.MaxValue);
+            }
+            // The record lengths must add up to the ciphertext length
+            if (sum != length)
+                throw new CryptographicException($"The log block holding record {firstRecord} is not valid.");
+
+            int lengthsSize = count * sizeof(int);
+            if (_block.Length < length)
+                _block = new byte[length];
+            var succeeded = new bool[count];
+            int failures = _aesGcmSiv.DecryptColumn(
+                sealedBlock.AsSpan(lengthsSize, length), _offsets.AsSpan(0, count + 1),
+                sealedBlock.AsSpan(lengthsSize + length), _block, _baseNonce, (ulong)firstRecord, succeeded);
+            if (failures != 0)
+            {
+                int failed = Array.IndexOf(succeeded, false);
+                throw new CryptographicException($"Log record {firstRecord + failed} failed to authenticate.");
+            }
+
+            _offset += total;
+            _firstRecord = firstRecord;
+            _count = count;
+            _index = 0;
+            return true;
+        }
+    }
+}
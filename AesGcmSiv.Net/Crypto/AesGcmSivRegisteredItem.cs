@@ -0,0 +1,87 @@
+using System.Runtime.InteropServices;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Describes one message in a batch over the buffers of an <see cref="AesGcmSivBufferPool"/>, by
+    /// buffer index and byte offset rather than by array.
+    /// </summary>
+    /// <remarks>
+    /// The nonce, the associated data and the input are read from <see cref="InputBuffer"/>, and the
+    /// output is written to <see cref="OutputBuffer"/>, which may be the same buffer. The tag is written
+    /// to <see cref="OutputBuffer"/> when encrypting and read from <see cref="InputBuffer"/> when
+    /// decrypting, so a sealed message stays in one buffer. The layout matches the native
+    /// <c>aesgcmsiv_registered_item</c>, so a span of items is passed to the native library as it is.
+    /// </remarks>
+    [StructLayout(LayoutKind.Sequential)]
+    public readonly struct AesGcmSivRegisteredItem
+    {
+        private readonly int _inputBuffer;
+        private readonly int _outputBuffer;
+        private readonly long _nonceOffset;
+        private readonly long _inputOffset;
+        private readonly long _length;
+        private readonly long _associatedDataOffset;
+        private readonly long _associatedDataLength;
+        private readonly long _outputOffset;
+        private readonly long _tagOffset;
+
+        /// <summary>
+        /// Initializes a new registered batch item.
+        /// </summary>
+        /// <param name="inputBuffer">The index of the buffer holding the nonce, associated data and input.</param>
+        /// <param name="nonceOffset">The offset of the 12-byte nonce in the input buffer.</param>
+        /// <param name="inputOffset">The offset of the data to encrypt or decrypt in the input buffer.</param>
+        /// <param name="length">The length of the data to encrypt or decrypt.</param>
+        /// <param name="outputBuffer">The index of the buffer receiving the output.</param>
+        /// <param name="outputOffset">The offset of the output in the output buffer.</param>
+        /// <param name="tagOffset">
+        /// The offset of the 16-byte tag: in the output buffer when encrypting, in the input buffer when
+        /// decrypting.
+        /// </param>
+        /// <param name="associatedDataOffset">The offset of the associated data in the input buffer.</param>
+        /// <param name="associatedDataLength">The length of the associated data, or 0 for none.</param>
+        public AesGcmSivRegisteredItem(
+            int inputBuffer, long nonceOffset, long inputOffset, long length,
+            int outputBuffer, long outputOffset, long tagOffset,
+            long associatedDataOffset = 0, long associatedDataLength = 0)
+        {
+            _inputBuffer = inputBuffer;
+            _outputBuffer = outputBuffer;
+            _nonceOffset = nonceOffset;
+            _inputOffset = inputOffset;
+            _length = length;
+            _associatedDataOffset = associatedDataOffset;
+            _associatedDataLength = associatedDataLength;
+            _outputOffset = outputOffset;
+            _tagOffset = tagOffset;
+        }
+
+        /// <summary>Gets the index of the buffer holding the nonce, associated data and input.</summary>
+        public int InputBuffer => _inputBuffer;
+
+        /// <summary>Gets the index of the buffer receiving the output.</summary>
+        public int OutputBuffer => _outputBuffer;
+
+        /// <summary>Gets the offset of the nonce in the input buffer.</summary>
+        public long NonceOffset => _nonceOffset;
+
+        /// <summary>Gets the offset of the data to encrypt or decrypt in the input buffer.</summary>
+        public long InputOffset => _inputOffset;
+
+        /// <summary>Gets the length of the data to encrypt or decrypt.</summary>
+        public long Length => _length;
+
+        /// <summary>Gets the offset of the associated data in the input buffer.</summary>
+        public long AssociatedDataOffset => _associatedDataOffset;
+
+        /// <summary>Gets the length of the associated data.</summary>
+        public long AssociatedDataLength => _associatedDataLength;
+
+        /// <summary>Gets the offset of the output in the output buffer.</summary>
+        public long OutputOffset => _outputOffset;
+
+        /// <summary>Gets the offset of the tag.</summary>
+        public long TagOffset => _tagOffset;
+    }
+}
@@ -0,0 +1,1326 @@
+using System.Buffers.Binary;
+using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Encrypts or decrypts a stream of any length in fixed-size chunks, holding only one chunk in
+    /// memory at a time.
+    /// </summary>
+    /// <remarks>
+    /// AES-GCM-SIV has to see a whole message before it can produce any output, so a large upload is
+    /// split into chunks sealed one by one, in the format of the native <c>aesgcmsiv_stream_*</c>
+    /// functions: a <see cref="HeaderSize"/>-byte header, then each chunk as ciphertext || tag under a
+    /// nonce made of a random per-stream prefix, the chunk number and a flag set only on the last
+    /// chunk. Reordered, dropped or truncated chunks, and data appended after the end, fail to
+    /// authenticate.
+    ///
+    /// In <see cref="CryptoStreamMode.Write"/> mode plaintext written to this stream is encrypted into
+    /// the underlying stream; call <see cref="FlushFinalChunk"/> or dispose the stream to write the
+    /// last chunk. In <see cref="CryptoStreamMode.Read"/> mode reads return the plaintext of the
+    /// underlying stream, and no chunk is returned until it has been verified.
+    ///
+    /// With <see cref="ParallelChunks"/> above 1, written plaintext is gathered into a window of that
+    /// many chunks, which are sealed together by one batch call on the native worker pool and then
+    /// written in order, so a single large upload can use several cores while memory stays bounded by
+    /// the window. Windows come from a native pool shared by every stream in the process and bounded
+    /// by <see cref="MemoryBudget"/>. When decrypting, the same setting reads ahead: the next window of
+    /// chunks is read and decrypted by one batch call in the background while the current one is
+    /// being read.
+    ///
+    /// With <see cref="Compression"/> set, each chunk is compressed and sealed by one native call,
+    /// through scratch memory the native stream owns, and written as a length-prefixed record. Reading
+    /// detects a compressed stream from its header.
+    ///
+    /// With <see cref="TagManifest"/> set, a hash tree over the chunk tags and a sealed manifest of its
+    /// root and the chunk count follow the last chunk, so that <see cref="AesGcmSivRandomAccessReader"/>
+    /// can tie every chunk it reads to one version of the object.
+    ///
+    /// <see cref="OpenAppend"/> reopens a finished stream to write more chunks after its end, sealing
+    /// only the old last chunk again.
+    /// </remarks>
+    public sealed class AesGcmSivStream : Stream
+    {
+        /// <summary>The size of the stream header, in bytes.</summary>
+        public const int HeaderSize = 12;
+
+        /// <summary>The chunk size used when none is given, 64 KiB.</summary>
+        public const int DefaultChunkSize = 64 * 1024;
+
+        /// <summary>The largest chunk size, 16 MiB.</summary>
+        public const int MaxChunkSize = 1 << 24;
+
+        private const int NonceSize = 12;
+        private const int TagSize = 16;
+        internal const int PrefixSize = 7;
+        private const byte FormatVersion = 1;
+        private const byte CompressedFormatVersion = 2;
+        private const byte ManifestFormatVersion = 4;
+        private const int FrameSize = 4;  // length and last flag ahead of each compressed record
+        private const int MaxParallelChunks = 256;
+        private const int AESGCMSIV_SUCCESS = 0;
+        private const int AESGCMSIV_ERROR_INVALID_INPUT = -3;
+        private const int AESGCMSIV_ERROR_DECRYPT_FAILED = -5;
+
+        private readonly Stream _stream;
+        private readonly AesGcmSiv _aesGcmSiv;
+        private readonly bool _encrypt;
+        private readonly byte[]? _associatedData;
+        private readonly bool _leaveOpen;
+        private readonly byte[] _prefix = new byte[PrefixSize];
+        private int _chunkSize;
+        private byte[]? _buffer;  // one sealed chunk, plus one byte of look-ahead when reading
+        private byte[]? _header;  // written ahead of the first chunk, then dropped
+        private int _parallelChunks = 1;
+        private AesGcmSivCompression _compression;
+        private int _compressionLevel;
+        private bool _tagManifest;
+        private AesGcmSivTagTree? _tagTree;  // the tags sealed so far, with a tag manifest
+        private byte[]? _appendTail;  // the old last chunk's plaintext, until appending starts
+        private SafeAesGcmSivStreamHandle? _native;  // compressed streams only
+        private byte[]? _record;  // one compressed record, framed; _buffer then holds only plaintext
+        private SafeAesGcmSivWindowHandle? _windowHandle;  // the window, from the native window pool
+        private byte[]? _windowArray;  // the window, pinned, when the native library cannot be loaded
+        private unsafe byte* _window;  // chunks gathered for one batch, each in a slot with room for its tag
+        private Memory<byte> _windowMemory;  // the same, for asynchronous writes
+        private int _windowChunks;  // slots in the window, at most _parallelChunks
+        private NativeBatchItem[]? _items;  // the window's chunks as batch items
+        private byte[]? _nonces;  // one per slot
+        private int _windowFull;  // full chunks in the window ahead of the one filling
+        private ReadAheadWindow? _readWindow;  // read-ahead: the window being read; _buffer is its data
+        private Task<ReadAheadWindow>? _ahead;  // read-ahead: the next window, being read and decrypted
+        private int _readChunk;  // read-ahead: the chunk of _readWindow being read
+        private int _readAheadCarry = -1;  // read-ahead: the byte read past the last window, if any
+        private int _count;  // plaintext bytes buffered for writing, or left to read
+        private int _offset;  // next plaintext byte to read
+        private int _carried;  // look-ahead bytes already at the start of the next chunk
+        private ulong _nextChunk;
+        private bool _started;  // header written or read
+        private bool _finished;  // last chunk written or read
+        private bool _failed;  // a chunk failed to verify
+        private bool _disposed;
+
+        /// <summary>
+        /// Initializes a stream that encrypts into, or decrypts from, <paramref name="stream"/>.
+        /// </summary>
+        /// <param name="stream">The underlying stream: written to when encrypting, read from when decrypting.</param>
+        /// <param name="aesGcmSiv">The key to use. Must stay undisposed until this stream is disposed.</param>
+        /// <param name="mode">
+        /// <see cref="CryptoStreamMode.Write"/> to encrypt what is written, <see cref="CryptoStreamMode.Read"/>
+        /// to decrypt what is read.
+        /// </param>
+        /// <param name="chunkSize">
+        /// Plaintext bytes per chunk when encrypting, from 1 to <see cref="MaxChunkSize"/>. When decrypting,
+        /// the chunk size is read from the header instead.
+        /// </param>
+        /// <param name="associatedData">Optional additional authenticated data, bound to every chunk.</param>
+        /// <param name="leaveOpen">Whether to leave <paramref name="stream"/> open when this stream is disposed.</param>
+        /// <exception cref="ArgumentNullException"><paramref name="stream"/> or <paramref name="aesGcmSiv"/> is null.</exception>
+        /// <exception cref="ArgumentException"><paramref name="stream"/> cannot be read or written as <paramref name="mode"/> needs.</exception>
+        /// <exception cref="ArgumentOutOfRangeException"><paramref name="chunkSize"/> or <paramref name="mode"/> is out of range.</exception>
+        public AesGcmSivStream(
+            Stream stream,
+            AesGcmSiv aesGcmSiv,
+            CryptoStreamMode mode,
+            int chunkSize = DefaultChunkSize,
+            byte[]? associatedData = null,
+            bool leaveOpen = false)
+        {
+            ArgumentNullException.ThrowIfNull(stream);
+            ArgumentNullException.ThrowIfNull(aesGcmSiv);
+            ArgumentOutOfRangeException.ThrowIfNegativeOrZero(chunkSize);
+            ArgumentOutOfRangeException.ThrowIfGreaterThan(chunkSize, MaxChunkSize);
+            if (mode != CryptoStreamMode.Read && mode != CryptoStreamMode.Write)
+                throw new ArgumentOutOfRangeException(nameof(mode));
+            if (mode == CryptoStreamMode.Write ? !stream.CanWrite : !stream.CanRead)
+                throw new ArgumentException("The stream does not support the requested mode.", nameof(stream));
+
+            _stream = stream;
+            _aesGcmSiv = aesGcmSiv;
+            _encrypt = mode == CryptoStreamMode.Write;
+            _associatedData = associatedData;
+            _leaveOpen = leaveOpen;
+            _chunkSize = chunkSize;
+        }
+
+        /// <summary>
+        /// Opens a finished stream to append to: the old last chunk is verified, and the stream returned
+        /// writes from its start, so that it is sealed again with the data written after it.
+        /// </summary>
+        /// <remarks>
+        /// Only the old last chunk and the new data are encrypted and written, whatever the length of the
+        /// stream; the header and the other chunks stay as they are. When the old last chunk is still the
+        /// last after the append, it is sealed again under the same nonce. AES-GCM-SIV is built to resist
+        /// nonce reuse, so this reveals no more than whether the two versions of the chunk are equal. A
+        /// crash during an append can leave a stream whose end fails to authenticate.
+        /// </remarks>
+        /// <param name="stream">The stream holding the encrypted data. Must support reading, writing and seeking.</param>
+        /// <param name="aesGcmSiv">The key the stream was encrypted with. Must stay undisposed until the returned stream is disposed.</param>
+        /// <param name="associatedData">The additional authenticated data the stream was encrypted with, if any.</param>
+        /// <param name="leaveOpen">Whether to leave <paramref name="stream"/> open when the returned stream is disposed.</param>
+        /// <returns>A stream in <see cref="CryptoStreamMode.Write"/> mode that carries on the encrypted stream.</returns>
+        /// <exception cref="ArgumentNullException"><paramref name="stream"/> or <paramref name="aesGcmSiv"/> is null.</exception>
+        /// <exception cref="ArgumentException"><paramref name="stream"/> cannot be read, written or seeked.</exception>
+        /// <exception cref="CryptographicException">
+        /// The stream does not hold a valid header, is compressed or has a tag manifest, or its last chunk
+        /// failed to authenticate.
+        /// </exception>
+        public static AesGcmSivStream OpenAppend(
+            Stream stream, AesGcmSiv aesGcmSiv, byte[]? associatedData = null, bool leaveOpen = false)
+        {
+            ArgumentNullException.ThrowIfNull(stream);
+            ArgumentNullException.ThrowIfNull(aesGcmSiv);
+            if (!stream.CanRead || !stream.CanWrite || !stream.CanSeek)
+                throw new ArgumentException("The stream must support reading, writing and seeking.", nameof(stream));
+
+            var prefix = new byte[PrefixSize];
+            Span<byte> header = stackalloc byte[HeaderSize];
+            stream.Position = 0;
+            int headerLength = stream.ReadAtLeast(header, HeaderSize, throwOnEndOfStream: false);
+            if (headerLength == HeaderSize && header[0] == CompressedFormatVersion)
+                throw new CryptographicException("A compressed stream cannot be appended to.");
+            int chunkSize = ParseHeader(header, headerLength, prefix, out bool tagManifest);
+            if (tagManifest)
+                throw new CryptographicException("A stream with a tag manifest cannot be appended to.");
+
+            // Every chunk but the last is full; the last holds at least a tag
+            long sealedLength = stream.Length - HeaderSize;
+            long full = chunkSize + TagSize;
+            long chunkCount = (sealedLength + full - 1) / full;
+            long lastSealedLength = sealedLength - (chunkCount - 1) * full;
+            if (chunkCount == 0 || lastSealedLength < TagSize || chunkCount - 1 > uint.MaxValue)
+                throw new CryptographicException("The stream has been truncated.");
+
+            long lastStart = HeaderSize + (chunkCount - 1) * full;
+            var last = new byte[lastSealedLength];
+            stream.Position = lastStart;
+            stream.ReadExactly(last);
+            int length = last.Length - TagSize;
+            Span<byte> nonce = stackalloc byte[NonceSize];
+            ChunkNonce(prefix, (ulong)(chunkCount - 1), true, nonce);
+            Span<byte> chunk = last.AsSpan(0, length);
+            if (!aesGcmSiv.TryDecrypt(nonce, chunk, last.AsSpan(length), chunk, associatedData))
+                throw new CryptographicException("The last stream chunk failed to authenticate.");
+            stream.Position = lastStart;
+
+            var appender = new AesGcmSivStream(stream, aesGcmSiv, CryptoStreamMode.Write, chunkSize, associatedData, leaveOpen);
+            prefix.AsSpan().CopyTo(appender._prefix);
+            appender._nextChunk = (ulong)(chunkCount - 1);
+            appender._appendTail = chunk.ToArray();
+            CryptographicOperations.ZeroMemory(last);
+            return appender;
+        }
+
+        /// <summary>
+        /// Gets or sets how many chunks are sealed at once, in parallel on the native worker pool, when
+        /// encrypting. The default, 1, seals each chunk as soon as it is known not to be the last.
+        /// </summary>
+        /// <remarks>
+        /// Chunks are still written strictly in order, and the output is the same whatever the value.
+        /// The stream holds up to this many chunks of plaintext, taken as one window when it starts
+        /// writing; while <see cref="MemoryBudget"/> is short it gets fewer, down to one, and the first
+        /// write waits until one fits. On an instance running only managed code the chunks of a window
+        /// are sealed one after another. Ignored when <see cref="Compression"/> is set.
+        ///
+        /// When decrypting, a value above 1 reads ahead. As soon as the header has been read, a
+        /// background task reads the next this many chunks with asynchronous reads and opens them with
+        /// one batch call on the native worker pool, and each window taken by the reader starts the
+        /// next one. Storage latency and decryption then overlap with the caller's processing. The
+        /// reader holds two windows, in managed memory outside <see cref="MemoryBudget"/>, and returns
+        /// no chunk of a window until every chunk in it has been verified.
+        /// </remarks>
+        /// <exception cref="ArgumentOutOfRangeException">The value is less than 1 or greater than 256.</exception>
+        /// <exception cref="InvalidOperationException">Data has already been written or read.</exception>
+        public int ParallelChunks
+        {
+            get => _parallelChunks;
+            set
+            {
+                ArgumentOutOfRangeException.ThrowIfNegativeOrZero(value);
+                ArgumentOutOfRangeException.ThrowIfGreaterThan(value, MaxParallelChunks);
+                if (_started)
+                    throw new InvalidOperationException("The chunk window cannot change once data has been written or read.");
+                _parallelChunks = value;
+            }
+        }
+
+        /// <summary>
+        /// Gets or sets the most memory, in bytes, that the chunk windows of all streams in the process
+        /// may hold at once. The default, 0, sets no limit.
+        /// </summary>
+        /// <remarks>
+        /// A stream with <see cref="ParallelChunks"/> above 1 takes its window from a native pool when
+        /// it starts writing, and gives it back, wiped, when it is disposed. When the budget is short
+        /// the stream is granted fewer chunks, and when not even one fits it waits for other streams to
+        /// give theirs back, so memory stays flat however many uploads burst at once. Released windows
+        /// are kept for reuse within the budget. Lowering the budget does not shrink windows already
+        /// taken.
+        /// </remarks>
+        /// <exception cref="ArgumentOutOfRangeException">The value is negative.</exception>
+        public static unsafe long MemoryBudget
+        {
+            get
+            {
+                AesGcmSivNative.EnsureLoaded();
+                NativeStreamBudgetStats stats;
+                AesGcmSivNative.StreamBudgetGetStats(&stats);
+                return (long)stats.MaxBytes;
+            }
+            set
+            {
+                ArgumentOutOfRangeException.ThrowIfNegative(value);
+                AesGcmSivNative.EnsureLoaded();
+                AesGcmSivNative.StreamBudgetSet((ulong)value);
+            }
+        }
+
+        /// <summary>
+        /// Gets or sets how each chunk is compressed before it is sealed when encrypting. The default,
+        /// <see cref="AesGcmSivCompression.None"/>, writes the plain chunked format.
+        /// </summary>
+        /// <remarks>
+        /// A compressed chunk is written as a 4-byte frame holding its length, then its ciphertext and
+        /// tag, so the stream no longer has fixed chunk offsets: <see cref="AesGcmSivRandomAccessReader"/>
+        /// and <see cref="AesGcmSiv.DecryptFile"/> reject it, and only this class reads it back. A chunk
+        /// that would not get shorter is stored as it is, at a cost of one byte. Chunks are compressed
+        /// one at a time, so <see cref="ParallelChunks"/> has no effect. Ignored when decrypting.
+        /// </remarks>
+        /// <exception cref="ArgumentOutOfRangeException">The value is not a defined compressor.</exception>
+        /// <exception cref="InvalidOperationException">Data has already been written.</exception>
+        /// <exception cref="NotSupportedException">
+        /// The key runs only managed code, or the native library was built without the compressor.
+        /// </exception>
+        public AesGcmSivCompression Compression
+        {
+            get => _compression;
+            set
+            {
+                if (value < AesGcmSivCompression.None || value > AesGcmSivCompression.Lz4)
+                    throw new ArgumentOutOfRangeException(nameof(value));
+                if (_started)
+                    throw new InvalidOperationException("Compression cannot change once data has been written.");
+                if (value != AesGcmSivCompression.None)
+                {
+                    _aesGcmSiv.StreamContext();
+                    if (!AesGcmSiv.IsCompressionSupported(value))
+                        throw new NotSupportedException($"The native library was built without {value} compression.");
+                }
+                _compression = value;
+            }
+        }
+
+        /// <summary>
+        /// Gets or sets the compression level: the Zstandard level, or for LZ4 the acceleration factor.
+        /// The default, 0, uses the compressor's own default.
+        /// </summary>
+        /// <exception cref="InvalidOperationException">Data has already been written.</exception>
+        public int CompressionLevel
+        {
+            get => _compressionLevel;
+            set
+            {
+                if (_started)
+                    throw new InvalidOperationException("Compression cannot change once data has been written.");
+                _compressionLevel = value;
+            }
+        }
+
+        /// <summary>
+        /// Gets or sets whether a tag manifest follows the last chunk when encrypting: a hash tree over the
+        /// chunk tags, and the tree's root and the chunk count sealed under the key. The default is false.
+        /// </summary>
+        /// <remarks>
+        /// <see cref="AesGcmSivRandomAccessReader"/> opens the manifest first, which tells it how many
+        /// chunks the object has without reading the last one, and checks each chunk it reads against the
+        /// root through one node per level of the tree. Its <see cref="AesGcmSivRandomAccessReader.ManifestRoot"/>
+        /// identifies this version of the object. The tree adds 64 bytes per chunk, and its leaves are
+        /// held in memory until the last chunk is written. A stream with a manifest is read only by
+        /// <see cref="AesGcmSivRandomAccessReader"/>, and cannot be compressed. Ignored when decrypting.
+        /// </remarks>
+        /// <exception cref="InvalidOperationException">Data has already been written.</exception>
+        public bool TagManifest
+        {
+            get => _tagManifest;
+            set
+            {
+                if (_started)
+                    throw new InvalidOperationException("The tag manifest cannot change once data has been written.");
+                _tagManifest = value;
+            }
+        }
+
+        /// <inheritdoc/>
+        public override bool CanRead => !_disposed && !_encrypt;
+
+        /// <inheritdoc/>
+        public override bool CanWrite => !_disposed && _encrypt;
+
+        /// <inheritdoc/>
+        public override bool CanSeek => false;
+
+        /// <inheritdoc/>
+        public override long Length => throw new NotSupportedException();
+
+        /// <inheritdoc/>
+        public override long Position
+        {
+            get => throw new NotSupportedException();
+            set => throw new NotSupportedException();
+        }
+
+        /// <inheritdoc/>
+        public override long Seek(long offset, SeekOrigin origin) => throw new NotSupportedException();
+
+        /// <inheritdoc/>
+        public override void SetLength(long value) => throw new NotSupportedException();
+
+        /// <inheritdoc/>
+        public override void Write(byte[] buffer, int offset, int count)
+        {
+            ValidateBufferArguments(buffer, offset, count);
+            Write(buffer.AsSpan(offset, count));
+        }
+
+        /// <inheritdoc/>
+        /// <exception cref="CryptographicException">Encryption failed, or the stream has too many chunks.</exception>
+        public override void Write(ReadOnlySpan<byte> buffer)
+        {
+            ThrowIfNotWritable();
+            while (!buffer.IsEmpty)
+            {
+                int length = FillChunk(buffer);
+                buffer = buffer.Slice(length);
+                if (!buffer.IsEmpty)
+                {
+                    // More data follows, so the full chunk is not the last one
+                    if (!HasWindow)
+                        WriteSealed(SealChunk(last: false));
+                    else if (NextWindowChunk())
+                        WriteWindow(SealWindow(last: false));
+                }
+            }
+        }
+
+        /// <inheritdoc/>
+        public override async ValueTask WriteAsync(ReadOnlyMemory<byte> buffer, CancellationToken cancellationToken = default)
+        {
+            ThrowIfNotWritable();
+            while (!buffer.IsEmpty)
+            {
+                int length = FillChunk(buffer.Span);
+                buffer = buffer.Slice(length);
+                if (!buffer.IsEmpty)
+                {
+                    if (!HasWindow)
+                        await WriteSealedAsync(SealChunk(last: false), cancellationToken).ConfigureAwait(false);
+                    else if (NextWindowChunk())
+                        await WriteWindowAsync(SealWindow(last: false), cancellationToken).ConfigureAwait(false);
+                }
+            }
+        }
+
+        /// <inheritdoc/>
+        public override Task WriteAsync(byte[] buffer, int offset, int count, CancellationToken cancellationToken)
+        {
+            ValidateBufferArguments(buffer, offset, count);
+            return WriteAsync(buffer.AsMemory(offset, count), cancellationToken).AsTask();
+        }
+
+        /// <summary>
+        /// Encrypts and writes the last chunk. Nothing can be written afterwards.
+        /// </summary>
+        /// <remarks>
+        /// Called by <see cref="Stream.Dispose()"/> if it has not been called already. Until then the final
+        /// chunk, which may be full, is held back, since only the last chunk may be shorter than the
+        /// chunk size and it is marked as the last.
+        /// </remarks>
+        /// <exception cref="NotSupportedException">The stream decrypts.</exception>
+        /// <exception cref="ObjectDisposedException">The stream has been disposed.</exception>
+        public void FlushFinalChunk()
+        {
+            ThrowIfNotWritable();
+            // An empty stream still gets a header and an empty last chunk,
+            // so it can't be confused with a truncated one
+            FillChunk(default);
+            if (!HasWindow)
+                WriteSealed(SealChunk(last: true));
+            else
+                WriteWindow(SealWindow(last: true));
+            if (_tagTree != null)
+                _stream.Write(_tagTree.BuildFooter(_aesGcmSiv, _prefix, _associatedData));
+            _stream.Flush();
+        }
+
+        /// <summary>
+        /// Asynchronously encrypts and writes the last chunk, as <see cref="FlushFinalChunk"/> does.
+        /// </summary>
+        /// <param name="cancellationToken">The token to monitor for cancellation requests.</param>
+        /// <returns>A task that completes when the last chunk has been written.</returns>
+        public async ValueTask FlushFinalChunkAsync(CancellationToken cancellationToken = default)
+        {
+            ThrowIfNotWritable();
+            FillChunk(default);
+            if (!HasWindow)
+                await WriteSealedAsync(SealChunk(last: true), cancellationToken).ConfigureAwait(false);
+            else
+                await WriteWindowAsync(SealWindow(last: true), cancellationToken).ConfigureAwait(false);
+            if (_tagTree != null)
+                await _stream.WriteAsync(_tagTree.BuildFooter(_aesGcmSiv, _prefix, _associatedData), cancellationToken).ConfigureAwait(false);
+            await _stream.FlushAsync(cancellationToken).ConfigureAwait(false);
+        }
+
+        /// <summary>
+        /// Flushes the underlying stream. A partly filled chunk is not written until
+        /// <see cref="FlushFinalChunk"/>.
+        /// </summary>
+        public override void Flush()
+        {
+            if (_encrypt && !_disposed)
+                _stream.Flush();
+        }
+
+        /// <inheritdoc/>
+        public override Task FlushAsync(CancellationToken cancellationToken) =>
+            _encrypt && !_disposed ? _stream.FlushAsync(cancellationToken) : Task.CompletedTask;
+
+        /// <inheritdoc/>
+        public override int Read(byte[] buffer, int offset, int count)
+        {
+            ValidateBufferArguments(buffer, offset, count);
+            return Read(buffer.AsSpan(offset, count));
+        }
+
+        /// <inheritdoc/>
+        /// <exception cref="CryptographicException">
+        /// The data is not a valid stream for this key and associated data, or has been truncated or altered.
+        /// </exception>
+        public override int Read(Span<byte> buffer)
+        {
+            ThrowIfNotReadable();
+            if (buffer.IsEmpty)
+                return 0;
+            if (!_started)
+            {
+                Span<byte> header = stackalloc byte[HeaderSize];
+                ReadHeader(header, FillFromStream(header));
+            }
+            while (_count == 0 && !_finished)
+            {
+                if (_native != null)
+                {
+                    OpenRecord(ReadRecord());
+                    continue;
+                }
+                if (_readWindow != null || _ahead != null)
+                {
+                    if (!NextReadAheadChunk())
+                        TakeWindow(WaitForWindow());
+                    continue;
+                }
+                int filled = _carried;
+                int wanted = _chunkSize + TagSize + 1;
+                while (filled < wanted)
+                {
+                    int read = _stream.Read(_buffer!, filled, wanted - filled);
+                    if (read == 0)
+                        break;
+                    filled += read;
+                }
+                OpenChunk(filled);
+            }
+            return CopyOut(buffer);
+        }
+
+        /// <inheritdoc/>
+        public override async ValueTask<int> ReadAsync(Memory<byte> buffer, CancellationToken cancellationToken = default)
+        {
+            ThrowIfNotReadable();
+            if (buffer.IsEmpty)
+                return 0;
+            if (!_started)
+            {
+                var header = new byte[HeaderSize];
+                int headerLength = 0;
+                while (headerLength < HeaderSize)
+                {
+                    int read = await _stream.ReadAsync(header.AsMemory(headerLength), cancellationToken).ConfigureAwait(false);
+                    if (read == 0)
+                        break;
+                    headerLength += read;
+                }
+                ReadHeader(header, headerLength);
+            }
+            while (_count == 0 && !_finished)
+            {
+                if (_native != null)
+                {
+                    OpenRecord(await ReadRecordAsync(cancellationToken).ConfigureAwait(false));
+                    continue;
+                }
+                if (_readWindow != null || _ahead != null)
+                {
+                    if (!NextReadAheadChunk())
+                        TakeWindow(await WaitForWindowAsync(cancellationToken).ConfigureAwait(false));
+                    continue;
+                }
+                int filled = _carried;
+                int wanted = _chunkSize + TagSize + 1;
+                while (filled < wanted)
+                {
+                    int read = await _stream.ReadAsync(_buffer.AsMemory(filled, wanted - filled), cancellationToken).ConfigureAwait(false);
+                    if (read == 0)
+                        break;
+                    filled += read;
+                }
+                OpenChunk(filled);
+            }
+            return CopyOut(buffer.Span);
+        }
+
+        /// <inheritdoc/>
+        public override Task<int> ReadAsync(byte[] buffer, int offset, int count, CancellationToken cancellationToken)
+        {
+            ValidateBufferArguments(buffer, offset, count);
+            return ReadAsync(buffer.AsMemory(offset, count), cancellationToken).AsTask();
+        }
+
+        /// <inheritdoc/>
+        protected override void Dispose(bool disposing)
+        {
+            try
+            {
+                if (disposing && !_disposed)
+                {
+                    if (_encrypt && !_finished)
+                        FlushFinalChunk();
+                    if (_ahead != null)
+                    {
+                        // The window being filled still reads from the stream
+                        try
+                        {
+                            _ahead.Wait();
+                        }
+                        catch (AggregateException)
+                        {
+                        }
+                    }
+                    if (!_leaveOpen)
+                        _stream.Dispose();
+                }
+            }
+            finally
+            {
+                if (!_disposed)
+                {
+                    if (_buffer != null)
+                        CryptographicOperations.ZeroMemory(_buffer);
+                    if (_record != null)
+                        CryptographicOperations.ZeroMemory(_record);
+                    if (_appendTail != null)
+                        CryptographicOperations.ZeroMemory(_appendTail);
+                    _native?.Dispose();
+                    _windowHandle?.Dispose();
+                    if (_windowArray != null)
+                        CryptographicOperations.ZeroMemory(_windowArray);
+                    if (_ahead != null && _ahead.IsCompletedSuccessfully)
+                        CryptographicOperations.ZeroMemory(_ahead.Result.Data);
+                    _disposed = true;
+                }
+                base.Dispose(disposing);
+            }
+        }
+
+        /// <inheritdoc/>
+        public override async ValueTask DisposeAsync()
+        {
+            try
+            {
+                if (!_disposed)
+                {
+                    if (_encrypt && !_finished)
+                        await FlushFinalChunkAsync().ConfigureAwait(false);
+                    if (_ahead != null)
+                        await ((Task)_ahead).ConfigureAwait(ConfigureAwaitOptions.SuppressThrowing);
+                    if (!_leaveOpen)
+                        await _stream.DisposeAsync().ConfigureAwait(false);
+                }
+            }
+            finally
+            {
+                Dispose(false);
+                GC.SuppressFinalize(this);
+            }
+        }
+
+        // Starts the stream if needed and copies as much of data as fits
+        // into the pending chunk, returning how much was taken
+        private int FillChunk(ReadOnlySpan<byte> data)
+        {
+            if (!_started)
+            {
+                if (_appendTail != null && (_compression != AesGcmSivCompression.None || _tagManifest))
+                    throw new InvalidOperationException("A stream being appended to keeps its format.");
+                if (_compression != AesGcmSivCompression.None)
+                {
+                    if (_tagManifest)
+                        throw new InvalidOperationException("A compressed stream cannot have a tag manifest.");
+                    StartCompressed();
+                }
+                else
+                {
+                    if (_parallelChunks > 1)
+                        StartWindow();
+                    else
+                    {
+                        _buffer = new byte[_chunkSize + TagSize];
+                    }
+                    if (_appendTail != null)
+                    {
+                        // Carry on from the old last chunk, which is sealed again in place
+                        _appendTail.CopyTo(HasWindow ? WindowSlot(0) : _buffer.AsSpan());
+                        _count = _appendTail.Length;
+                        CryptographicOperations.ZeroMemory(_appendTail);
+                        _appendTail = null;
+                    }
+                    else
+                    {
+                        _header = new byte[HeaderSize];
+                        WriteHeader(_header, _chunkSize, _prefix);
+                        if (_tagManifest)
+                        {
+                            _header[0] = ManifestFormatVersion;
+                            _tagTree = new AesGcmSivTagTree();
+                        }
+                    }
+                }
+                _started = true;
+            }
+            int length = Math.Min(data.Length, _chunkSize - _count);
+            data.Slice(0, length).CopyTo(HasWindow ? WindowSlot(_windowFull).Slice(_count) : _buffer.AsSpan(_count));
+            _count += length;
+            return length;
+        }
+
+        private void WriteSealed(int sealedLength)
+        {
+            if (_header != null)
+            {
+                _stream.Write(_header);
+                _header = null;
+            }
+            _stream.Write(_record ?? _buffer!, 0, sealedLength);
+        }
+
+        private async ValueTask WriteSealedAsync(int sealedLength, CancellationToken cancellationToken)
+        {
+            if (_header != null)
+            {
+                await _stream.WriteAsync(_header, cancellationToken).ConfigureAwait(false);
+                _header = null;
+            }
+            await _stream.WriteAsync((_record ?? _buffer).AsMemory(0, sealedLength), cancellationToken).ConfigureAwait(false);
+        }
+
+        // Seals the pending chunk in place, or into _record if compressing,
+        // returning its sealed length
+        private int SealChunk(bool last)
+        {
+            if (_native != null)
+                return SealRecord(last);
+
+            Span<byte> nonce = stackalloc byte[NonceSize];
+            ChunkNonce(last, nonce);
+            Span<byte> chunk = _buffer.AsSpan(0, _count);
+            _aesGcmSiv.Encrypt(nonce, chunk, chunk, _buffer.AsSpan(_count, TagSize), _associatedData);
+            _tagTree?.Add(_buffer.AsSpan(_count, TagSize));
+
+            int sealedLength = _count + TagSize;
+            _count = 0;
+            _nextChunk++;
+            _finished = last;
+            return sealedLength;
+        }
+
+        // Starts a native compressed stream, which writes the header
+        private void StartCompressed()
+        {
+            _header = new byte[HeaderSize];
+            int result = SafeAesGcmSivStreamHandle.CreateCompressed(
+                _aesGcmSiv.StreamContext(), _chunkSize, _compression, _compressionLevel, _header, out var native);
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                native.Dispose();
+                throw new CryptographicException($"Starting a compressed stream failed with error code: {result}");
+            }
+            _native = native;
+            _buffer = new byte[_chunkSize];
+            _record = new byte[FrameSize + 1 + _chunkSize + TagSize];
+        }
+
+        // Compresses and seals the pending chunk into _record with one native
+        // call, returning the record's length
+        private unsafe int SealRecord(bool last)
+        {
+            nuint length;
+            int result;
+            bool added = false;
+            _native!.DangerousAddRef(ref added);
+            try
+            {
+                fixed (byte* chunk = _buffer)
+                fixed (byte* aad = _associatedData)
+                fixed (byte* record = _record)
+                {
+                    result = AesGcmSivNative.StreamSealCompressed(
+                        _native.DangerousGetHandle(), chunk, (nuint)_count, aad, (nuint)(_associatedData?.Length ?? 0),
+                        last ? 1 : 0, record, &length);
+                }
+            }
+            finally
+            {
+                _native.DangerousRelease();
+            }
+            if (result != AESGCMSIV_SUCCESS)
+                throw new CryptographicException($"Compressing a stream chunk failed with error code: {result}");
+
+            _count = 0;
+            _nextChunk++;
+            _finished = last;
+            return (int)length;
+        }
+
+        // Takes the window from the native pool, with as many slots as the
+        // memory budget allows, or pins one when only managed code can run
+        private unsafe void StartWindow()
+        {
+            int slotSize = _chunkSize + TagSize;
+            int wanted = Math.Min(_parallelChunks, int.MaxValue / slotSize);
+            SafeAesGcmSivWindowHandle handle;
+            int chunks;
+            int result;
+            try
+            {
+                result = SafeAesGcmSivWindowHandle.Acquire(slotSize, wanted, out handle, out chunks);
+            }
+            catch (Exception e) when (e is DllNotFoundException or EntryPointNotFoundException or BadImageFormatException)
+            {
+                // Without the library there is no pool, and no budget to keep
+                _windowArray = GC.AllocateArray<byte>(slotSize * wanted, pinned: true);
+                _window = (byte*)Unsafe.AsPointer(ref MemoryMarshal.GetArrayDataReference(_windowArray));
+                _windowMemory = _windowArray;
+                StartWindowItems(wanted);
+                return;
+            }
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                handle.Dispose();
+                if (result == AESGCMSIV_ERROR_INVALID_INPUT)
+                    throw new InvalidOperationException($"A chunk of {_chunkSize} bytes does not fit the stream memory budget.");
+                throw new CryptographicException($"Taking a chunk window failed with error code: {result}");
+            }
+            _windowHandle = handle;
+            _window = (byte*)handle.DangerousGetHandle();
+            _windowMemory = new AesGcmSivBufferPool.NativeBufferManager(_window, slotSize * chunks).Memory;
+            StartWindowItems(chunks);
+        }
+
+        private void StartWindowItems(int chunks)
+        {
+            _windowChunks = chunks;
+            _items = new NativeBatchItem[chunks];
+            _nonces = new byte[chunks * NonceSize];
+        }
+
+        // Whether writing gathers chunks into a window
+        private unsafe bool HasWindow => _window != null;
+
+        // Slot i of the window, a chunk followed by room for its tag
+        private unsafe Span<byte> WindowSlot(int i) =>
+            new Span<byte>(_window + (nint)i * (_chunkSize + TagSize), _chunkSize + TagSize);
+
+        // Moves on from the full chunk being filled to the next one in the
+        // window, returning whether the window is now full and must be sealed
+        private bool NextWindowChunk()
+        {
+            _count = 0;
+            return ++_windowFull == _windowChunks;
+        }
+
+        // Seals every chunk in the window with one batch call, the chunk being
+        // filled too if it is the last, each with its tag right behind it.
+        // Returns the sealed length, the chunks lying back to back as they are
+        // written since only the last can be short.
+        private unsafe int SealWindow(bool last)
+        {
+            int count = last ? _windowFull + 1 : _windowChunks;
+            int slotSize = _chunkSize + TagSize;
+            int result;
+            fixed (byte* nonces = _nonces)
+            fixed (byte* aad = _associatedData)
+            fixed (NativeBatchItem* items = _items)
+            {
+                for (int i = 0; i < count; i++)
+                {
+                    bool lastChunk = last && i == count - 1;
+                    int length = lastChunk ? _count : _chunkSize;
+                    byte* chunk = _window + (nint)i * slotSize;
+                    byte* nonce = nonces + i * NonceSize;
+                    ChunkNonce(_prefix, _nextChunk + (ulong)i, lastChunk, new Span<byte>(nonce, NonceSize));
+                    items[i] = new NativeBatchItem
+                    {
+                        Nonce = (IntPtr)nonce,
+                        Input = (IntPtr)chunk,
+                        InputLength = (nuint)length,
+                        AssociatedData = (IntPtr)aad,
+                        AssociatedDataLength = (nuint)(_associatedData?.Length ?? 0),
+                        Output = (IntPtr)chunk,
+                        Tag = (IntPtr)(chunk + length),
+                    };
+                }
+                result = _aesGcmSiv.RunDescriptors(items, count, null);
+            }
+            if (result != AESGCMSIV_SUCCESS)
+                throw new CryptographicException($"Batch encryption failed with error code: {result}");
+            if (_tagTree != null)
+            {
+                // StartWindow set the items up along with the window
+                for (int i = 0; i < count; i++)
+                    _tagTree.Add(new ReadOnlySpan<byte>((void*)_items![i].Tag, TagSize));
+            }
+
+            int sealedLength = (count - 1) * slotSize + (last ? _count : _chunkSize) + TagSize;
+            _count = 0;
+            _windowFull = 0;
+            _nextChunk += (ulong)count;
+            _finished = last;
+            return sealedLength;
+        }
+
+        private unsafe void WriteWindow(int sealedLength)
+        {
+            if (_header != null)
+            {
+                _stream.Write(_header);
+                _header = null;
+            }
+            _stream.Write(new ReadOnlySpan<byte>(_window, sealedLength));
+        }
+
+        private async ValueTask WriteWindowAsync(int sealedLength, CancellationToken cancellationToken)
+        {
+            if (_header != null)
+            {
+                await _stream.WriteAsync(_header, cancellationToken).ConfigureAwait(false);
+                _header = null;
+            }
+            await _stream.WriteAsync(_windowMemory.Slice(0, sealedLength), cancellationToken).ConfigureAwait(false);
+        }
+
+        // Fills in a header for a new stream of chunkSize chunks, choosing its
+        // nonce prefix
+        internal static void WriteHeader(Span<byte> header, int chunkSize, Span<byte> prefix)
+        {
+            RandomNumberGenerator.Fill(prefix);
+            header[0] = FormatVersion;
+            BinaryPrimitives.WriteInt32LittleEndian(header.Slice(1), chunkSize);
+            prefix.CopyTo(header.Slice(5));
+        }
+
+        // Checks a header of which length bytes were read and sets the
+        // stream up for it
+        private void ReadHeader(ReadOnlySpan<byte> header, int length)
+        {
+            if (length == HeaderSize && header[0] == CompressedFormatVersion)
+            {
+                OpenCompressed(header);
+                return;
+            }
+            _chunkSize = ParseHeader(header, length, _prefix);
+            if (_parallelChunks > 1)
+            {
+                var window = new ReadAheadWindow(Math.Min(_parallelChunks, (int.MaxValue - 1) / (_chunkSize + TagSize)), _chunkSize);
+                _ahead = Task.Run(() => FillWindowAsync(window));
+            }
+            else
+            {
+                _buffer = new byte[_chunkSize + TagSize + 1];
+            }
+            _started = true;
+        }
+
+        // Read-ahead: reads the sealed chunks of the next window, and the byte
+        // after them, then opens them in place with one batch call
+        private async Task<ReadAheadWindow> FillWindowAsync(ReadAheadWindow window)
+        {
+            try
+            {
+                int full = _chunkSize + TagSize;
+                int capacity = window.Items.Length * full;
+                int filled = 0;
+                if (_readAheadCarry >= 0)
+                    window.Data[filled++] = (byte)_readAheadCarry;
+                filled += await FillFromStreamAsync(window.Data.AsMemory(filled, capacity + 1 - filled), CancellationToken.None)
+                    .ConfigureAwait(false);
+
+                // Only a window that the stream ends in holds the last chunk
+                window.Final = filled <= capacity;
+                int sealedLength = window.Final ? filled : capacity;
+                _readAheadCarry = window.Final ? -1 : window.Data[capacity];
+                window.Chunks = Math.Max(1, (sealedLength + full - 1) / full);
+                window.LastLength = sealedLength - (window.Chunks - 1) * full - TagSize;
+                if (window.LastLength < 0)
+                    throw new CryptographicException("The stream has been truncated.");
+                OpenWindow(window);
+                return window;
+            }
+            catch
+            {
+                CryptographicOperations.ZeroMemory(window.Data);
+                throw;
+            }
+        }
+
+        private unsafe void OpenWindow(ReadAheadWindow window)
+        {
+            int full = _chunkSize + TagSize;
+            int result;
+            fixed (byte* data = window.Data)
+            fixed (byte* nonces = window.Nonces)
+            fixed (byte* aad = _associatedData)
+            fixed (NativeBatchItem* items = window.Items)
+            {
+                for (int i = 0; i < window.Chunks; i++)
+                {
+                    bool lastInWindow = i == window.Chunks - 1;
+                    int length = lastInWindow ? window.LastLength : _chunkSize;
+                    byte* chunk = data + (nint)i * full;
+                    byte* nonce = nonces + i * NonceSize;
+                    ChunkNonce(_prefix, _nextChunk + (ulong)i, window.Final && lastInWindow, new Span<byte>(nonce, NonceSize));
+                    items[i] = new NativeBatchItem
+                    {
+                        Nonce = (IntPtr)nonce,
+                        Input = (IntPtr)chunk,
+                        InputLength = (nuint)length,
+                        AssociatedData = (IntPtr)aad,
+                        AssociatedDataLength = (nuint)(_associatedData?.Length ?? 0),
+                        Output = (IntPtr)chunk,
+                        Tag = (IntPtr)(chunk + length),
+                    };
+                }
+                result = _aesGcmSiv.RunDescriptors(items, window.Chunks, window.Statuses);
+            }
+            if (result == AESGCMSIV_ERROR_DECRYPT_FAILED)
+                throw new CryptographicException("A stream chunk failed to authenticate.");
+            if (result != AESGCMSIV_SUCCESS)
+                throw new CryptographicException($"Batch decryption failed with error code: {result}");
+            _nextChunk += (ulong)window.Chunks;
+        }
+
+        // Read-ahead: moves to the next chunk of the window being read,
+        // returning false if it has none left
+        private bool NextReadAheadChunk()
+        {
+            if (_readWindow == null || _readChunk == _readWindow.Chunks - 1)
+                return false;
+            _readChunk++;
+            SetReadChunk();
+            return true;
+        }
+
+        // Read-ahead: starts reading a window that has been filled, and
+        // starts filling the one after it in the window just read
+        private void TakeWindow(ReadAheadWindow window)
+        {
+            ReadAheadWindow? spare = _readWindow;
+            if (spare != null)
+                CryptographicOperations.ZeroMemory(spare.Data);
+            _readWindow = window;
+            _buffer = window.Data;
+            _ahead = null;
+            if (!window.Final)
+            {
+                spare ??= new ReadAheadWindow(window.Items.Length, _chunkSize);
+                _ahead = Task.Run(() => FillWindowAsync(spare));
+            }
+            _readChunk = 0;
+            SetReadChunk();
+        }
+
+        private void SetReadChunk()
+        {
+            bool lastInWindow = _readChunk == _readWindow!.Chunks - 1;
+            _offset = _readChunk * (_chunkSize + TagSize);
+            _count = lastInWindow ? _readWindow.LastLength : _chunkSize;
+            _finished = lastInWindow && _readWindow.Final;
+        }
+
+        private ReadAheadWindow WaitForWindow()
+        {
+            try
+            {
+                return _ahead!.GetAwaiter().GetResult();
+            }
+            catch (CryptographicException)
+            {
+                _failed = true;
+                throw;
+            }
+        }
+
+        private async ValueTask<ReadAheadWindow> WaitForWindowAsync(CancellationToken cancellationToken)
+        {
+            try
+            {
+                return await _ahead!.WaitAsync(cancellationToken).ConfigureAwait(false);
+            }
+            catch (CryptographicException)
+            {
+                _failed = true;
+                throw;
+            }
+        }
+
+        // Checks a header of which length bytes were read, returning its
+        // chunk size and copying out its nonce prefix
+        internal static int ParseHeader(ReadOnlySpan<byte> header, int length, Span<byte> prefix)
+        {
+            int chunkSize = ParseHeader(header, length, prefix, out bool tagManifest);
+            if (tagManifest)
+                throw new CryptographicException("The stream has a tag manifest; read it with AesGcmSivRandomAccessReader.");
+            return chunkSize;
+        }
+
+        // As above, but also accepting a stream with a tag manifest, and
+        // telling whether it is one
+        internal static int ParseHeader(ReadOnlySpan<byte> header, int length, Span<byte> prefix, out bool tagManifest)
+        {
+            if (length < HeaderSize)
+                throw new CryptographicException("The stream is too short to hold a header.");
+            int chunkSize = BinaryPrimitives.ReadInt32LittleEndian(header.Slice(1));
+            tagManifest = header[0] == ManifestFormatVersion;
+            if ((header[0] != FormatVersion && !tagManifest) || chunkSize <= 0 || chunkSize > MaxChunkSize)
+                throw new CryptographicException("The stream header is not valid.");
+
+            header.Slice(5, PrefixSize).CopyTo(prefix);
+            return chunkSize;
+        }
+
+        // Starts a native stream to open a compressed stream's records
+        private void OpenCompressed(ReadOnlySpan<byte> header)
+        {
+            int result = SafeAesGcmSivStreamHandle.Open(_aesGcmSiv.StreamContext(), header, out var native);
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                native.Dispose();
+                throw new CryptographicException("The stream header is not valid.");
+            }
+            _native = native;
+            _chunkSize = BinaryPrimitives.ReadInt32LittleEndian(header.Slice(1));
+            _buffer = new byte[_chunkSize];
+            _record = new byte[FrameSize + 1 + _chunkSize + TagSize];
+            _started = true;
+        }
+
+        // Reads the next record of a compressed stream into _record,
+        // returning its length
+        private int ReadRecord()
+        {
+            int length = RecordLength(FillFromStream(_record.AsSpan(0, FrameSize)));
+            if (FillFromStream(_record.AsSpan(FrameSize, length)) < length)
+                throw new CryptographicException("The stream has been truncated.");
+            // Nothing may follow the last record
+            if (IsLastRecord() && FillFromStream(stackalloc byte[1]) != 0)
+                ThrowAppended();
+            return FrameSize + length;
+        }
+
+        private async ValueTask<int> ReadRecordAsync(CancellationToken cancellationToken)
+        {
+            int length = RecordLength(await FillFromStreamAsync(_record.AsMemory(0, FrameSize), cancellationToken).ConfigureAwait(false));
+            if (await FillFromStreamAsync(_record.AsMemory(FrameSize, length), cancellationToken).ConfigureAwait(false) < length)
+                throw new CryptographicException("The stream has been truncated.");
+            if (IsLastRecord() && await FillFromStreamAsync(new byte[1], cancellationToken).ConfigureAwait(false) != 0)
+                ThrowAppended();
+            return FrameSize + length;
+        }
+
+        private bool IsLastRecord() => (_record![FrameSize - 1] & 0x80) != 0;
+
+        private void ThrowAppended()
+        {
+            _failed = true;
+            throw new CryptographicException("The stream has data after its last chunk.");
+        }
+
+        // Checks the frame of a record, of which filled bytes were read,
+        // returning the length of the sealed chunk that follows it
+        private int RecordLength(int filled)
+        {
+            if (filled < FrameSize)
+                throw new CryptographicException("The stream has been truncated.");
+            uint length = BinaryPrimitives.ReadUInt32LittleEndian(_record) & int.MaxValue;
+            if (length > (uint)(_record!.Length - FrameSize))
+            {
+                _failed = true;
+                throw new CryptographicException("A stream chunk failed to authenticate.");
+            }
+            return (int)length;
+        }
+
+        // Verifies, opens and decompresses the record of recordLength bytes in
+        // _record into _buffer with one native call
+        private unsafe void OpenRecord(int recordLength)
+        {
+            nuint length;
+            int last;
+            int result;
+            bool added = false;
+            _native!.DangerousAddRef(ref added);
+            try
+            {
+                fixed (byte* record = _record)
+                fixed (byte* aad = _associatedData)
+                fixed (byte* chunk = _buffer)
+                {
+                    result = AesGcmSivNative.StreamOpenCompressed(
+                        _native.DangerousGetHandle(), record, (nuint)recordLength, aad, (nuint)(_associatedData?.Length ?? 0),
+                        chunk, &length, &last);
+                }
+            }
+            finally
+            {
+                _native.DangerousRelease();
+            }
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                _failed = true;
+                throw new CryptographicException(result == AESGCMSIV_ERROR_DECRYPT_FAILED
+                    ? "A stream chunk failed to authenticate."
+                    : $"Decompressing a stream chunk failed with error code: {result}");
+            }
+
+            _offset = 0;
+            _count = (int)length;
+            _nextChunk++;
+            _finished = last != 0;
+        }
+
+        // Opens the chunk at the start of the buffer, of which filled bytes
+        // have been read. A full chunk plus a look-ahead byte means another
+        // follows; anything less is the last one.
+        private void OpenChunk(int filled)
+        {
+            int full = _chunkSize + TagSize;
+            bool last = filled <= full;
+            int sealedLength = last ? filled : full;
+            if (sealedLength < TagSize)
+                throw new CryptographicException("The stream has been truncated.");
+
+            Span<byte> nonce = stackalloc byte[NonceSize];
+            ChunkNonce(last, nonce);
+            int length = sealedLength - TagSize;
+            Span<byte> chunk = _buffer.AsSpan(0, length);
+            if (!_aesGcmSiv.TryDecrypt(nonce, chunk, _buffer.AsSpan(length, TagSize), chunk, _associatedData))
+            {
+                _failed = true;
+                throw new CryptographicException("A stream chunk failed to authenticate.");
+            }
+
+            _offset = 0;
+            _count = length;
+            _nextChunk++;
+            _finished = last;
+            // The look-ahead byte moves to the front once this chunk has been read
+            _carried = last ? 0 : 1;
+        }
+
+        private int CopyOut(Span<byte> destination)
+        {
+            int length = Math.Min(destination.Length, _count);
+            _buffer.AsSpan(_offset, length).CopyTo(destination);
+            _offset += length;
+            _count -= length;
+            if (_count == 0 && _carried != 0)
+                _buffer![0] = _buffer[_chunkSize + TagSize];
+            return length;
+        }
+
+        private int FillFromStream(Span<byte> buffer)
+        {
+            int filled = 0;
+            while (filled < buffer.Length)
+            {
+                int read = _stream.Read(buffer.Slice(filled));
+                if (read == 0)
+                    break;
+                filled += read;
+            }
+            return filled;
+        }
+
+        private async ValueTask<int> FillFromStreamAsync(Memory<byte> buffer, CancellationToken cancellationToken)
+        {
+            int filled = 0;
+            while (filled < buffer.Length)
+            {
+                int read = await _stream.ReadAsync(buffer.Slice(filled), cancellationToken).ConfigureAwait(false);
+                if (read == 0)
+                    break;
+                filled += read;
+            }
+            return filled;
+        }
+
+        private void ChunkNonce(bool last, Span<byte> nonce) => ChunkNonce(_prefix, _nextChunk, last, nonce);
+
+        // prefix || chunk number, big-endian || last flag
+        internal static void ChunkNonce(ReadOnlySpan<byte> prefix, ulong index, bool last, Span<byte> nonce)
+        {
+            if (index > uint.MaxValue || (!last && index == uint.MaxValue))
+                throw new CryptographicException("The stream has too many chunks.");
+            prefix.CopyTo(nonce);
+            BinaryPrimitives.WriteUInt32BigEndian(nonce.Slice(PrefixSize), (uint)index);
+            nonce[11] = last ? (byte)1 : (byte)0;
+        }
+
+        private void ThrowIfNotWritable()
+        {
+            ObjectDisposedException.ThrowIf(_disposed, this);
+            if (!_encrypt)
+                throw new NotSupportedException("The stream decrypts and cannot be written.");
+            if (_finished)
+                throw new InvalidOperationException("The last chunk has already been written.");
+        }
+
+        private void ThrowIfNotReadable()
+        {
+            ObjectDisposedException.ThrowIf(_disposed, this);
+            if (_encrypt)
+                throw new NotSupportedException("The stream encrypts and cannot be read.");
+            if (_failed)
+                throw new CryptographicException("A stream chunk failed to authenticate.");
+        }
+
+        // Read-ahead: a window of sealed chunks as they lie in the stream, with
+        // room for the byte after them, opened in place by one batch call
+        private sealed class ReadAheadWindow
+        {
+            public ReadAheadWindow(int chunks, int chunkSize)
+            {
+                Data = GC.AllocateArray<byte>(chunks * (chunkSize + TagSize) + 1, pinned: true);
+                Items = new NativeBatchItem[chunks];
+                Nonces = new byte[chunks * NonceSize];
+                Statuses = new int[chunks];
+            }
+
+            public byte[] Data { get; }
+            public NativeBatchItem[] Items { get; }
+            public byte[] Nonces { get; }
+            public int[] Statuses { get; }
+            public int Chunks { get; set; }  // chunks filled
+            public int LastLength { get; set; }  // plaintext bytes in the last chunk filled
+            public bool Final { get; set; }  // holds the stream's last chunk
+        }
+    }
+}
@@ -0,0 +1,164 @@
+using System.Buffers.Binary;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// The hash tree over a stream's chunk tags that a stream with a tag manifest carries in its footer.
+    /// </summary>
+    /// <remarks>
+    /// Leaf <c>i</c> is SHA-256 of 0x00 || the tag of chunk <c>i</c>, and each node above is SHA-256 of
+    /// 0x01 || left || right; a node with no right sibling moves up a level as it is. The footer holds
+    /// every level from the leaves up to the root, 32 bytes per node, then the sealed manifest: the
+    /// chunk count (8 bytes, little-endian) and the root, encrypted under the stream's nonce prefix
+    /// followed by 0xFFFFFFFF and 0x02, which no chunk nonce ends with.
+    /// </remarks>
+    internal sealed class AesGcmSivTagTree
+    {
+        internal const int HashSize = 32;
+        internal const int SealedManifestSize = 8 + HashSize + TagSize;
+
+        private const int TagSize = 16;
+        private const int NonceSize = 12;
+
+        private byte[] _leaves = new byte[HashSize * 64];
+        private long _count;
+
+        // Reads node number node of the footer's levels into hash
+        internal delegate void NodeReader(long node, Span<byte> hash);
+
+        /// <summary>Adds the tag of the next chunk.</summary>
+        internal void Add(ReadOnlySpan<byte> tag)
+        {
+            if ((_count + 1) * HashSize > _leaves.Length)
+            {
+                if (_leaves.Length > Array.MaxLength / 2)
+                    throw new CryptographicException("The stream has too many chunks for a tag manifest.");
+                Array.Resize(ref _leaves, _leaves.Length * 2);
+            }
+            Leaf(tag, _leaves.AsSpan((int)(_count * HashSize), HashSize));
+            _count++;
+        }
+
+        /// <summary>
+        /// Builds the footer for the chunks added: every level of the tree, then the manifest sealed
+        /// under <paramref name="prefix"/>.
+        /// </summary>
+        internal byte[] BuildFooter(AesGcmSiv aesGcmSiv, ReadOnlySpan<byte> prefix, byte[]? associatedData)
+        {
+            long nodes = NodeCount(_count);
+            if (nodes * HashSize + SealedManifestSize > Array.MaxLength)
+                throw new CryptographicException("The stream has too many chunks for a tag manifest.");
+            var footer = new byte[nodes * HashSize + SealedManifestSize];
+            _leaves.AsSpan(0, (int)(_count * HashSize)).CopyTo(footer);
+
+            long start = 0;
+            for (long size = _count; size > 1; size = (size + 1) / 2)
+            {
+                long next = start + size;
+                for (long i = 0; i < size; i += 2)
+                {
+                    Span<byte> parent = footer.AsSpan((int)((next + i / 2) * HashSize), HashSize);
+                    Span<byte> left = footer.AsSpan((int)((start + i) * HashSize), HashSize);
+                    if (i + 1 < size)
+                        Node(left, footer.AsSpan((int)((start + i + 1) * HashSize), HashSize), parent);
+                    else
+                        left.CopyTo(parent);
+                }
+                start = next;
+            }
+
+            Span<byte> manifest = stackalloc byte[8 + HashSize];
+            BinaryPrimitives.WriteInt64LittleEndian(manifest, _count);
+            footer.AsSpan((int)(start * HashSize), HashSize).CopyTo(manifest.Slice(8));
+            Span<byte> nonce = stackalloc byte[NonceSize];
+            ManifestNonce(prefix, nonce);
+            Span<byte> sealedManifest = footer.AsSpan((int)(nodes * HashSize));
+            aesGcmSiv.Encrypt(
+                nonce, manifest, sealedManifest.Slice(0, manifest.Length), sealedManifest.Slice(manifest.Length),
+                associatedData);
+            return footer;
+        }
+
+        /// <summary>
+        /// Opens a sealed manifest, returning whether it authenticated, and if so the chunk count and root.
+        /// </summary>
+        internal static bool TryOpenManifest(
+            AesGcmSiv aesGcmSiv, ReadOnlySpan<byte> prefix, byte[]? associatedData, ReadOnlySpan<byte> sealedManifest,
+            out long chunkCount, Span<byte> root)
+        {
+            chunkCount = 0;
+            Span<byte> manifest = stackalloc byte[8 + HashSize];
+            Span<byte> nonce = stackalloc byte[NonceSize];
+            ManifestNonce(prefix, nonce);
+            if (!aesGcmSiv.TryDecrypt(
+                    nonce, sealedManifest.Slice(0, manifest.Length), sealedManifest.Slice(manifest.Length, TagSize),
+                    manifest, associatedData))
+                return false;
+            chunkCount = BinaryPrimitives.ReadInt64LittleEndian(manifest);
+            manifest.Slice(8).CopyTo(root);
+            return chunkCount > 0;
+        }
+
+        /// <summary>The number of nodes, leaves and root included, in the tree over <paramref name="leaves"/> tags.</summary>
+        internal static long NodeCount(long leaves)
+        {
+            long nodes = leaves;
+            for (long size = leaves; size > 1; size = (size + 1) / 2)
+                nodes += (size + 1) / 2;
+            return nodes;
+        }
+
+        /// <summary>
+        /// Checks that the tag of chunk <paramref name="index"/> leads to <paramref name="root"/>, reading
+        /// one node per level, its sibling's, through <paramref name="readNode"/>.
+        /// </summary>
+        internal static bool VerifyPath(
+            long leaves, long index, ReadOnlySpan<byte> tag, ReadOnlySpan<byte> root, NodeReader readNode)
+        {
+            Span<byte> hash = stackalloc byte[HashSize];
+            Span<byte> sibling = stackalloc byte[HashSize];
+            Leaf(tag, hash);
+
+            long start = 0;
+            for (long size = leaves; size > 1; size = (size + 1) / 2)
+            {
+                long other = index ^ 1;
+                if (other < size)
+                {
+                    readNode(start + other, sibling);
+                    if ((index & 1) == 0)
+                        Node(hash, sibling, hash);
+                    else
+                        Node(sibling, hash, hash);
+                }
+                start += size;
+                index /= 2;
+            }
+            return CryptographicOperations.FixedTimeEquals(hash, root);
+        }
+
+        private static void Leaf(ReadOnlySpan<byte> tag, Span<byte> hash)
+        {
+            Span<byte> input = stackalloc byte[1 + TagSize];
+            input[0] = 0;
+            tag.CopyTo(input.Slice(1));
+            SHA256.HashData(input, hash);
+        }
+
+        private static void Node(ReadOnlySpan<byte> left, ReadOnlySpan<byte> right, Span<byte> hash)
+        {
+            Span<byte> input = stackalloc byte[1 + 2 * HashSize];
+            input[0] = 1;
+            left.CopyTo(input.Slice(1));
+            right.CopyTo(input.Slice(1 + HashSize));
+            SHA256.HashData(input, hash);
+        }
+
+        private static void ManifestNonce(ReadOnlySpan<byte> prefix, Span<byte> nonce)
+        {
+            prefix.CopyTo(nonce);
+            BinaryPrimitives.WriteUInt32BigEndian(nonce.Slice(prefix.Length), uint.MaxValue);
+            nonce[NonceSize - 1] = 2;
+        }
+    }
+}
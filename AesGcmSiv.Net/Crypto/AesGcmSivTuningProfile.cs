@@ -0,0 +1,355 @@
+using System.Diagnostics;
+using System.Text.Json;
+using System.Text.Json.Serialization;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Dispatch thresholds measured on one host: the message size below which
+    /// <see cref="AesGcmSivImplementation.Auto"/> stays in managed code, the share of a large message
+    /// worth a thread, the threads worth using, and how batches are grouped. <see cref="Calibrate"/>
+    /// measures them, <see cref="Save"/> and <see cref="Load"/> keep them in a small JSON file so
+    /// that later processes skip the measurement, and <see cref="Apply"/> puts them into effect.
+    /// </summary>
+    /// <remarks>
+    /// A typical start-up call is <c>AesGcmSivTuningProfile.LoadOrCalibrate(path).Apply()</c>. A
+    /// profile only ever changes which code path runs, never the output. A value of 0 leaves the
+    /// built-in default in place.
+    /// </remarks>
+    public sealed class AesGcmSivTuningProfile
+    {
+        private const int FormatVersion = 1;
+
+        // Same as AESGCMSIV_LANE_MAX_BLOCKS in the native kernels
+        private const int MaxLaneBlocks = 17;
+
+        private const int AESGCMSIV_SUCCESS = 0;
+
+        /// <summary>Version of the file layout, so that a newer layout is recalibrated rather than misread.</summary>
+        public int Version { get; init; } = FormatVersion;
+
+        /// <summary>The <see cref="AesGcmSiv.BackendName"/> the profile was measured with.</summary>
+        public string Backend { get; init; } = string.Empty;
+
+        /// <summary>The <see cref="AesGcmSiv.CpuFeatures"/> the profile was measured with.</summary>
+        public AesGcmSivCpuFeatures CpuFeatures { get; init; }
+
+        /// <summary>The <see cref="Environment.ProcessorCount"/> the profile was measured with.</summary>
+        public int ProcessorCount { get; init; }
+
+        /// <summary>
+        /// Default <see cref="AesGcmSiv.ManagedMessageThreshold"/> for instances created with
+        /// <see cref="AesGcmSivImplementation.Auto"/>; -1 if the managed implementation could not be
+        /// measured.
+        /// </summary>
+        public int ManagedMessageThreshold { get; init; } = -1;
+
+        /// <summary>
+        /// Smallest share of one message, in bytes, worth a thread of its own when
+        /// <see cref="AesGcmSiv.MaxDegreeOfParallelism"/> allows a split.
+        /// </summary>
+        public long ParallelMinBytes { get; init; }
+
+        /// <summary>
+        /// Threads, the caller's included, beyond which splitting a large message stopped paying off.
+        /// Sizes the worker pool shared by every instance.
+        /// </summary>
+        public int PoolThreads { get; init; }
+
+        /// <summary>Messages per pool task when a batch is spread over the worker pool.</summary>
+        public int BatchChunkItems { get; init; }
+
+        /// <summary>
+        /// Longest message, in 16-byte blocks of associated data and plaintext plus one, that a batch
+        /// runs through the multi-buffer kernels; 1 turns them off.
+        /// </summary>
+        public int LaneMaxBlocks { get; init; }
+
+        /// <summary>
+        /// Measures every threshold on this host. Takes well under a second and uses the shared worker
+        /// pool, so run it before the process takes load.
+        /// </summary>
+        /// <returns>The measured profile. It is not applied.</returns>
+        /// <exception cref="CryptographicException">The native library failed a call.</exception>
+        /// <exception cref="DllNotFoundException">The native library could not be loaded.</exception>
+        public static AesGcmSivTuningProfile Calibrate()
+        {
+            AesGcmSivNative.EnsureLoaded();
+            string backend = AesGcmSiv.BackendName;
+            int processors = Environment.ProcessorCount;
+            byte[] key = RandomNumberGenerator.GetBytes(32);
+
+            NativeTuning saved = GetNativeTuning();
+            try
+            {
+                using var cipher = new AesGcmSiv(key, AesGcmSivImplementation.Auto);
+                int managed = AesGcmSiv.IsManagedImplementationSupported ? cipher.MeasureManagedMessageThreshold() : -1;
+                bool kernel = !AesGcmSiv.IsLibraryBackend(backend);
+
+                // Splitting and the lanes only exist in the hand-written kernels, and
+                // splitting needs a second processor to help
+                long parallelMin = 0;
+                int poolThreads = 0;
+                int chunkItems = 0;
+                if (kernel && processors > 1)
+                {
+                    parallelMin = MeasureParallelMinBytes(cipher, processors);
+                    poolThreads = MeasurePoolThreads(cipher, processors);
+                    chunkItems = MeasureBatchChunkItems(cipher);
+                }
+                int laneBlocks = kernel ? MeasureLaneMaxBlocks(cipher) : 0;
+
+                return new AesGcmSivTuningProfile
+                {
+                    Backend = backend,
+                    CpuFeatures = AesGcmSiv.CpuFeatures,
+                    ProcessorCount = processors,
+                    ManagedMessageThreshold = managed,
+                    ParallelMinBytes = parallelMin,
+                    PoolThreads = poolThreads,
+                    BatchChunkItems = chunkItems,
+                    LaneMaxBlocks = laneBlocks,
+                };
+            }
+            finally
+            {
+                SetNativeTuning(saved);
+            }
+        }
+
+        /// <summary>
+        /// Reads a profile written by <see cref="Save"/>.
+        /// </summary>
+        /// <param name="path">The profile file.</param>
+        /// <returns>
+        /// The profile, or null if the file is missing, unreadable, of another version, or was
+        /// measured on a different backend, feature set or processor count.
+        /// </returns>
+        public static AesGcmSivTuningProfile? Load(string path)
+        {
+            ArgumentNullException.ThrowIfNull(path);
+            AesGcmSivTuningProfile? profile;
+            try
+            {
+                profile = JsonSerializer.Deserialize(File.ReadAllText(path), TuningProfileJsonContext.Default.AesGcmSivTuningProfile);
+            }
+            catch (Exception e) when (e is IOException or UnauthorizedAccessException or JsonException)
+            {
+                return null;
+            }
+            if (profile == null || profile.Version != FormatVersion)
+                return null;
+            if (profile.Backend != AesGcmSiv.BackendName || profile.CpuFeatures != AesGcmSiv.CpuFeatures ||
+                profile.ProcessorCount != Environment.ProcessorCount)
+                return null;
+            return profile;
+        }
+
+        /// <summary>
+        /// Writes the profile to <paramref name="path"/>, replacing any file there.
+        /// </summary>
+        /// <param name="path">The profile file.</param>
+        /// <exception cref="IOException">The file could not be written.</exception>
+        public void Save(string path)
+        {
+            ArgumentNullException.ThrowIfNull(path);
+
+            // Written aside and moved into place, so a concurrent Load never
+            // sees half a file
+            string temporary = path + "." + Environment.ProcessId + ".tmp";
+            File.WriteAllText(temporary, JsonSerializer.Serialize(this, TuningProfileJsonContext.Default.AesGcmSivTuningProfile));
+            File.Move(temporary, path, overwrite: true);
+        }
+
+        /// <summary>
+        /// Loads the profile at <paramref name="path"/>, or calibrates and saves one if there is none
+        /// valid for this host.
+        /// </summary>
+        /// <param name="path">The profile file.</param>
+        /// <returns>The profile. It is not applied.</returns>
+        /// <exception cref="CryptographicException">The native library failed a call.</exception>
+        /// <exception cref="IOException">A new profile could not be written.</exception>
+        public static AesGcmSivTuningProfile LoadOrCalibrate(string path)
+        {
+            AesGcmSivTuningProfile? profile = Load(path);
+            if (profile != null)
+                return profile;
+            profile = Calibrate();
+            profile.Save(path);
+            return profile;
+        }
+
+        /// <summary>
+        /// Puts the profile into effect for the whole process.
+        /// </summary>
+        /// <remarks>
+        /// The native thresholds apply to calls that start afterwards. The managed threshold becomes the
+        /// default of <see cref="AesGcmSivImplementation.Auto"/> instances that have not yet made a call.
+        /// The pool size only applies if no instance has used parallelism yet, since the pool is created
+        /// once per process.
+        /// </remarks>
+        /// <exception cref="ArgumentException">A threshold is out of range.</exception>
+        /// <exception cref="CryptographicException">The native library rejected the thresholds.</exception>
+        public void Apply()
+        {
+            if (LaneMaxBlocks < 0 || LaneMaxBlocks > MaxLaneBlocks)
+                throw new ArgumentException($"LaneMaxBlocks must be between 0 and {MaxLaneBlocks}.");
+            if (ParallelMinBytes < 0 || BatchChunkItems < 0 || PoolThreads < 0)
+                throw new ArgumentException("Thresholds must not be negative.");
+
+            AesGcmSivNative.EnsureLoaded();
+            SetNativeTuning(new NativeTuning
+            {
+                ParallelMinBytes = (nuint)ParallelMinBytes,
+                BatchChunkItems = (nuint)BatchChunkItems,
+                LaneMaxBlocks = (nuint)LaneMaxBlocks,
+            });
+            if (ManagedMessageThreshold >= 0)
+                AesGcmSiv.SetDefaultManagedMessageThreshold(ManagedMessageThreshold);
+            if (PoolThreads > 1)
+                AesGcmSiv.SetSharedPoolWorkers(PoolThreads - 1);
+        }
+
+        // Doubles the message from 256 KiB and stops at the first size a
+        // split over every processor beats one thread. The threshold is that
+        // size's per-thread share, or the default if no size up to 16 MiB gained.
+        private static long MeasureParallelMinBytes(AesGcmSiv cipher, int processors)
+        {
+            const int largest = 16 << 20;
+            var buffer = new byte[largest];
+            for (int size = 256 << 10; size <= largest; size *= 2)
+            {
+                long serial = Time(cipher, buffer, size, threads: 1, parallelMinBytes: 0);
+                long split = Time(cipher, buffer, size, threads: processors, parallelMinBytes: size / processors);
+                if (split < serial)
+                    return size / processors;
+            }
+            return 0;
+        }
+
+        // Splits an 8 MiB message over 2, 4, ... threads and returns the
+        // fewest within a tenth of the fastest; 0 if that is every processor.
+        private static int MeasurePoolThreads(AesGcmSiv cipher, int processors)
+        {
+            const int size = 8 << 20;
+            var buffer = new byte[size];
+            var counts = new List<int>();
+            for (int threads = 2; threads < processors; threads *= 2)
+                counts.Add(threads);
+            counts.Add(processors);
+
+            var times = new long[counts.Count];
+            for (int i = 0; i < counts.Count; i++)
+                times[i] = Time(cipher, buffer, size, counts[i], parallelMinBytes: 64 << 10);
+            long best = times.Min();
+            for (int i = 0; i < counts.Count; i++)
+            {
+                if (times[i] <= best + best / 10)
+                    return counts[i] == processors ? 0 : counts[i];
+            }
+            return 0;
+        }
+
+        // Times a batch of 2048 short messages over the pool at a few task sizes
+        private static int MeasureBatchChunkItems(AesGcmSiv cipher)
+        {
+            AesGcmSivBatchItem[] items = BatchItems(2048, 64);
+            cipher.MaxDegreeOfParallelism = -1;
+            int fastest = 0;
+            long best = long.MaxValue;
+            foreach (int chunk in new[] { 16, 32, 64, 128, 256 })
+            {
+                SetNativeTuning(new NativeTuning { BatchChunkItems = (nuint)chunk });
+                long elapsed = Fastest(() => cipher.EncryptBatch(items));
+                if (elapsed < best)
+                {
+                    best = elapsed;
+                    fastest = chunk;
+                }
+            }
+            cipher.MaxDegreeOfParallelism = 1;
+            SetNativeTuning(default);
+            return fastest;
+        }
+
+        // Compares the multi-buffer kernels with one message at a time on a
+        // serial batch, growing the message up to the largest a lane takes,
+        // and returns the last size in blocks at which the lanes kept up
+        private static int MeasureLaneMaxBlocks(AesGcmSiv cipher)
+        {
+            cipher.MaxDegreeOfParallelism = 1;
+            int fits = 1;
+            foreach (int blocks in new[] { 2, 5, 9, MaxLaneBlocks })
+            {
+                AesGcmSivBatchItem[] items = BatchItems(256, (blocks - 1) * 16);
+                SetNativeTuning(new NativeTuning { LaneMaxBlocks = MaxLaneBlocks });
+                long lanes = Fastest(() => cipher.EncryptBatch(items));
+                SetNativeTuning(new NativeTuning { LaneMaxBlocks = 1 });
+                long single = Fastest(() => cipher.EncryptBatch(items));
+                if (lanes > single)
+                    break;
+                fits = blocks;
+            }
+            SetNativeTuning(default);
+            return fits;
+        }
+
+        private static long Time(AesGcmSiv cipher, byte[] buffer, int size, int threads, long parallelMinBytes)
+        {
+            SetNativeTuning(new NativeTuning { ParallelMinBytes = (nuint)parallelMinBytes });
+            cipher.MaxDegreeOfParallelism = threads;
+            byte[] nonce = new byte[12];
+            byte[] tag = new byte[16];
+            long elapsed = Fastest(() => cipher.Encrypt(nonce, buffer.AsSpan(0, size), buffer.AsSpan(0, size), tag));
+            cipher.MaxDegreeOfParallelism = 1;
+            SetNativeTuning(default);
+            return elapsed;
+        }
+
+        // Fastest of three runs, which also discards the first run's warm-up
+        private static long Fastest(Action run)
+        {
+            long best = long.MaxValue;
+            for (int sample = 0; sample < 3; sample++)
+            {
+                long started = Stopwatch.GetTimestamp();
+                run();
+                best = Math.Min(best, Stopwatch.GetTimestamp() - started);
+            }
+            return best;
+        }
+
+        private static AesGcmSivBatchItem[] BatchItems(int count, int size)
+        {
+            var nonce = new byte[12];
+            var items = new AesGcmSivBatchItem[count];
+            for (int i = 0; i < count; i++)
+                items[i] = new AesGcmSivBatchItem(nonce, new byte[size], new byte[size], new byte[16]);
+            return items;
+        }
+
+        private static unsafe NativeTuning GetNativeTuning()
+        {
+            NativeTuning tuning;
+            int result = AesGcmSivNative.GetTuning(&tuning);
+            if (result != AESGCMSIV_SUCCESS)
+                throw new CryptographicException($"Reading the tuning failed with error code: {result}");
+            return tuning;
+        }
+
+        private static unsafe void SetNativeTuning(NativeTuning tuning)
+        {
+            int result = AesGcmSivNative.SetTuning(&tuning);
+            if (result != AESGCMSIV_SUCCESS)
+                throw new CryptographicException($"Setting the tuning failed with error code: {result}");
+        }
+    }
+
+    // Serialization code generated at compile time, so profiles load and save
+    // under trimming and Native AOT
+    [JsonSerializable(typeof(AesGcmSivTuningProfile))]
+    [JsonSourceGenerationOptions(WriteIndented = true)]
+    internal sealed partial class TuningProfileJsonContext : JsonSerializerContext
+    {
+    }
+}
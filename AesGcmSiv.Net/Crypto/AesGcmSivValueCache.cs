@@ -0,0 +1,364 @@
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// A cache of values kept encrypted in native memory, for sensitive data such as personal records
+    /// that a process caches but should not hold in the clear.
+    /// </summary>
+    /// <remarks>
+    /// Values are sealed into slots of native slabs grouped by size, and found by ID through one
+    /// open-addressed index. An entry therefore costs its sealed bytes rounded up to its size class,
+    /// 32 bytes of nonce, length and tag, and its index slot, and adds no object for the garbage
+    /// collector to track or copy, however many millions of entries there are. Gets decrypt straight
+    /// into the caller's buffer, and a batch of them takes one native call.
+    ///
+    /// Each value is sealed under a fresh nonce with its ID as associated data, so a value read back
+    /// under another ID fails to authenticate. Once full, the cache evicts an entry that has not been
+    /// read recently. Gets may run on any number of threads at once; sets and removes wait for them.
+    /// Slab memory is kept for reuse until the cache is disposed.
+    /// </remarks>
+    public sealed unsafe class AesGcmSivValueCache : IDisposable
+    {
+        /// <summary>The longest value the cache holds, 1 MiB.</summary>
+        public const int MaxValueLength = 1 << 20;
+
+        private const int MaxCapacity = 1 << 30;
+        private const uint AESGCMSIV_ALLOC_LOCKED = 1u << 1;
+
+        private const int AESGCMSIV_SUCCESS = 0;
+        private const int AESGCMSIV_ERROR_INVALID_KEY = -1;
+        private const int AESGCMSIV_ERROR_INVALID_INPUT = -3;
+        private const int AESGCMSIV_ERROR_DECRYPT_FAILED = -5;
+        private const int AESGCMSIV_ERROR_NOT_FOUND = -9;
+
+        // Values per native call when a batch is spread over stack buffers
+        private const int StackValues = 64;
+
+        private readonly SafeAesGcmSivValueCacheHandle _cache;
+        private bool _disposed;
+
+        /// <summary>
+        /// Initializes an empty cache.
+        /// </summary>
+        /// <param name="capacity">Most entries held at once, up to 2^30.</param>
+        /// <param name="key">
+        /// The encryption key, 16 or 32 bytes, or empty for a random 32-byte key that never leaves
+        /// native memory.
+        /// </param>
+        /// <param name="lockMemory">
+        /// Whether to keep the slabs out of swap. Creation fails if the process may not lock that
+        /// much memory.
+        /// </param>
+        /// <exception cref="ArgumentOutOfRangeException"><paramref name="capacity"/> is out of range.</exception>
+        /// <exception cref="ArgumentException"><paramref name="key"/> is not empty, 16 or 32 bytes.</exception>
+        /// <exception cref="CryptographicException">The native cache could not be created.</exception>
+        public AesGcmSivValueCache(int capacity, ReadOnlySpan<byte> key = default, bool lockMemory = false)
+        {
+            ArgumentOutOfRangeException.ThrowIfNegativeOrZero(capacity);
+            ArgumentOutOfRangeException.ThrowIfGreaterThan(capacity, MaxCapacity);
+            if (!key.IsEmpty && key.Length != 16 && key.Length != 32)
+                throw new ArgumentException("Key must be exactly 16 bytes (128 bits) or 32 bytes (256 bits).", nameof(key));
+
+            int result = SafeAesGcmSivValueCacheHandle.Create(
+                key, capacity, lockMemory ? AESGCMSIV_ALLOC_LOCKED : 0, out _cache);
+            if (result != AESGCMSIV_SUCCESS)
+            {
+                _cache.Dispose();
+                throw new CryptographicException($"Value cache setup failed with error code: {result}");
+            }
+            Capacity = capacity;
+        }
+
+        /// <summary>Gets the most entries the cache holds at once.</summary>
+        public int Capacity { get; }
+
+        /// <summary>Gets the number of entries.</summary>
+        /// <exception cref="ObjectDisposedException">The cache has been disposed.</exception>
+        public long Count => (long)GetStats().Entries;
+
+        /// <summary>Gets the bytes of native memory allocated for slabs.</summary>
+        /// <exception cref="ObjectDisposedException">The cache has been disposed.</exception>
+        public long SlabBytes => (long)GetStats().SlabBytes;
+
+        /// <summary>Gets the number of entries evicted to make room since the cache was created.</summary>
+        /// <exception cref="ObjectDisposedException">The cache has been disposed.</exception>
+        public long Evictions => (long)GetStats().Evictions;
+
+        /// <summary>
+        /// Seals <paramref name="value"/> into the cache under <paramref name="id"/>, replacing any
+        /// value it held.
+        /// </summary>
+        /// <param name="id">The ID of the value.</param>
+        /// <param name="value">The value, at most <see cref="MaxValueLength"/> bytes.</param>
+        /// <exception cref="ObjectDisposedException">The cache has been disposed.</exception>
+        /// <exception cref="ArgumentException"><paramref name="value"/> is too long.</exception>
+        /// <exception cref="CryptographicException">The value could not be stored.</exception>
+        public void Set(ulong id, ReadOnlySpan<byte> value)
+        {
+            ThrowIfDisposed();
+            if (value.Length > MaxValueLength)
+                throw new ArgumentException($"Value must be at most {MaxValueLength} bytes.", nameof(value));
+
+            int status;
+            fixed (byte* valuePtr = value)
+            {
+                var item = new NativeCacheValue { Id = id, Data = (IntPtr)valuePtr, Length = (nuint)value.Length };
+                NativeCacheValue* i = &item;
+                int* s = &status;
+                Call(cache => AesGcmSivNative.ValueCachePut(cache, 1, i, s));
+            }
+            if (status != AESGCMSIV_SUCCESS)
+                throw new CryptographicException($"Storing the value failed with error code: {status}");
+        }
+
+        /// <summary>
+        /// Decrypts the value under <paramref name="id"/> into <paramref name="destination"/>.
+        /// </summary>
+        /// <param name="id">The ID of the value.</param>
+        /// <param name="destination">Receives the value.</param>
+        /// <param name="bytesWritten">The length of the value, or 0 if there is none.</param>
+        /// <returns>Whether the cache holds a value under <paramref name="id"/>.</returns>
+        /// <exception cref="ObjectDisposedException">The cache has been disposed.</exception>
+        /// <exception cref="ArgumentException"><paramref name="destination"/> is too small for the value.</exception>
+        /// <exception cref="CryptographicException">The sealed value was altered in memory.</exception>
+        public bool TryGet(ulong id, Span<byte> destination, out int bytesWritten)
+        {
+            ThrowIfDisposed();
+            NativeCacheValue item;
+            int status;
+            fixed (byte* destinationPtr = destination)
+            {
+                item = new NativeCacheValue { Id = id, Data = (IntPtr)destinationPtr, Length = (nuint)destination.Length };
+                NativeCacheValue* i = &item;
+                int* s = &status;
+                Call(cache => AesGcmSivNative.ValueCacheGet(cache, 1, i, s));
+            }
+
+            bytesWritten = 0;
+            if (status == AESGCMSIV_ERROR_NOT_FOUND)
+                return false;
+            if (status == AESGCMSIV_ERROR_INVALID_INPUT)
+                throw new ArgumentException($"Destination buffer is too small for the {item.Length}-byte value.", nameof(destination));
+            ThrowIfFailed(status);
+            bytesWritten = (int)item.Length;
+            return true;
+        }
+
+        /// <summary>
+        /// Decrypts the value under <paramref name="id"/> into a new array.
+        /// </summary>
+        /// <param name="id">The ID of the value.</param>
+        /// <returns>The value, or null if the cache holds none under <paramref name="id"/>.</returns>
+        /// <exception cref="ObjectDisposedException">The cache has been disposed.</exception>
+        /// <exception cref="CryptographicException">The sealed value was altered in memory.</exception>
+        public byte[]? Get(ulong id)
+        {
+            ThrowIfDisposed();
+            // A first call with no room reports the length; the value can be
+            // replaced in between, so go round again if it outgrew the array
+            byte[] value = Array.Empty<byte>();
+            for (;;)
+            {
+                NativeCacheValue item;
+                int status;
+                fixed (byte* valuePtr = value)
+                {
+                    item = new NativeCacheValue { Id = id, Data = (IntPtr)valuePtr, Length = (nuint)value.Length };
+                    NativeCacheValue* i = &item;
+                    int* s = &status;
+                    Call(cache => AesGcmSivNative.ValueCacheGet(cache, 1, i, s));
+                }
+
+                if (status == AESGCMSIV_ERROR_NOT_FOUND)
+                    return null;
+                if (status == AESGCMSIV_ERROR_INVALID_INPUT)
+                {
+                    value = new byte[(int)item.Length];
+                    continue;
+                }
+                ThrowIfFailed(status);
+                return (int)item.Length == value.Length ? value : value.AsSpan(0, (int)item.Length).ToArray();
+            }
+        }
+
+        /// <summary>
+        /// Removes the value under <paramref name="id"/>.
+        /// </summary>
+        /// <param name="id">The ID of the value.</param>
+        /// <returns>Whether the cache held a value under <paramref name="id"/>.</returns>
+        /// <exception cref="ObjectDisposedException">The cache has been disposed.</exception>
+        public bool Remove(ulong id)
+        {
+            ThrowIfDisposed();
+            return Call(cache => AesGcmSivNative.ValueCacheRemove(cache, id)) == AESGCMSIV_SUCCESS;
+        }
+
+        /// <summary>
+        /// Seals a batch of values with one native call per 64, value <c>i</c> under <c>ids[i]</c>.
+        /// Values are stored in order, so of two under the same ID the later one stays.
+        /// </summary>
+        /// <param name="ids">The ID of each value.</param>
+        /// <param name="values">The values, back to back.</param>
+        /// <param name="lengths">The length of each value. Must be as long as <paramref name="ids"/>.</param>
+        /// <exception cref="ObjectDisposedException">The cache has been disposed.</exception>
+        /// <exception cref="ArgumentException">
+        /// <paramref name="lengths"/> does not match <paramref name="ids"/>, a length is negative or too
+        /// long, or the lengths add up to more than <paramref name="values"/>.
+        /// </exception>
+        /// <exception cref="CryptographicException">A value could not be stored; the others were.</exception>
+        public void SetBatch(ReadOnlySpan<ulong> ids, ReadOnlySpan<byte> values, ReadOnlySpan<int> lengths)
+        {
+            ThrowIfDisposed();
+            if (lengths.Length != ids.Length)
+                throw new ArgumentException("There must be one length per ID.", nameof(lengths));
+            long total = 0;
+            foreach (int length in lengths)
+            {
+                if (length < 0 || length > MaxValueLength)
+                    throw new ArgumentException($"Each length must be from 0 to {MaxValueLength}.", nameof(lengths));
+                total += length;
+            }
+            if (total > values.Length)
+                throw new ArgumentException("The lengths add up to more than the values.", nameof(values));
+
+            NativeCacheValue* items = stackalloc NativeCacheValue[StackValues];
+            int* statuses = stackalloc int[StackValues];
+            int firstError = AESGCMSIV_SUCCESS;
+            fixed (byte* valuesPtr = values)
+            {
+                int offset = 0;
+                for (int first = 0; first < ids.Length; first += StackValues)
+                {
+                    int count = Math.Min(StackValues, ids.Length - first);
+                    for (int i = 0; i < count; i++)
+                    {
+                        int length = lengths[first + i];
+                        items[i] = new NativeCacheValue { Id = ids[first + i], Data = (IntPtr)(valuesPtr + offset), Length = (nuint)length };
+                        offset += length;
+                    }
+                    int result = Call(cache => AesGcmSivNative.ValueCachePut(cache, (nuint)count, items, statuses));
+                    if (firstError == AESGCMSIV_SUCCESS)
+                        firstError = result;
+                }
+            }
+            if (firstError != AESGCMSIV_SUCCESS)
+                throw new CryptographicException($"Storing a value failed with error code: {firstError}");
+        }
+
+        /// <summary>
+        /// Decrypts a batch of values with one native call per 64, value <c>i</c> into the
+        /// <paramref name="stride"/> bytes of <paramref name="destination"/> from <c>i * stride</c>.
+        /// </summary>
+        /// <param name="ids">The ID of each value.</param>
+        /// <param name="destination">Receives the values, at least <c>ids.Length * stride</c> bytes.</param>
+        /// <param name="stride">Room for each value.</param>
+        /// <param name="lengths">
+        /// Receives the length of each value: -1 if there is none under its ID, or a length above
+        /// <paramref name="stride"/>, with nothing written, if the value did not fit. Must be as long as
+        /// <paramref name="ids"/>.
+        /// </param>
+        /// <returns>The number of values written.</returns>
+        /// <exception cref="ObjectDisposedException">The cache has been disposed.</exception>
+        /// <exception cref="ArgumentException"><paramref name="destination"/> or <paramref name="lengths"/> is too small.</exception>
+        /// <exception cref="ArgumentOutOfRangeException"><paramref name="stride"/> is negative.</exception>
+        /// <exception cref="CryptographicException">A sealed value was altered in memory.</exception>
+        public int GetBatch(ReadOnlySpan<ulong> ids, Span<byte> destination, int stride, Span<int> lengths)
+        {
+            ThrowIfDisposed();
+            ArgumentOutOfRangeException.ThrowIfNegative(stride);
+            if (lengths.Length < ids.Length)
+                throw new ArgumentException("There must be one length per ID.", nameof(lengths));
+            if ((long)ids.Length * stride > destination.Length)
+                throw new ArgumentException("Destination buffer is too small.", nameof(destination));
+
+            NativeCacheValue* items = stackalloc NativeCacheValue[StackValues];
+            int* statuses = stackalloc int[StackValues];
+            int found = 0;
+            fixed (byte* destinationPtr = destination)
+            {
+                for (int first = 0; first < ids.Length; first += StackValues)
+                {
+                    int count = Math.Min(StackValues, ids.Length - first);
+                    for (int i = 0; i < count; i++)
+                    {
+                        items[i] = new NativeCacheValue
+                        {
+                            Id = ids[first + i],
+                            Data = (IntPtr)(destinationPtr + (long)(first + i) * stride),
+                            Length = (nuint)stride,
+                        };
+                    }
+                    Call(cache => AesGcmSivNative.ValueCacheGet(cache, (nuint)count, items, statuses));
+                    for (int i = 0; i < count; i++)
+                    {
+                        switch (statuses[i])
+                        {
+                            case AESGCMSIV_SUCCESS:
+                                lengths[first + i] = (int)items[i].Length;
+                                found++;
+                                break;
+                            case AESGCMSIV_ERROR_NOT_FOUND:
+                                lengths[first + i] = -1;
+                                break;
+                            case AESGCMSIV_ERROR_INVALID_INPUT:
+                                lengths[first + i] = (int)items[i].Length;
+                                break;
+                            default:
+                                ThrowIfFailed(statuses[i]);
+                                break;
+                        }
+                    }
+                }
+            }
+            return found;
+        }
+
+        /// <summary>
+        /// Clears the key and frees the native cache and its slabs.
+        /// </summary>
+        public void Dispose()
+        {
+            if (!_disposed)
+            {
+                _cache.Dispose();
+                _disposed = true;
+            }
+        }
+
+        private NativeValueCacheStats GetStats()
+        {
+            ThrowIfDisposed();
+            NativeValueCacheStats stats;
+            NativeValueCacheStats* s = &stats;
+            Call(cache => AesGcmSivNative.ValueCacheGetStats(cache, s));
+            return stats;
+        }
+
+        private static void ThrowIfFailed(int status)
+        {
+            if (status == AESGCMSIV_ERROR_DECRYPT_FAILED)
+                throw new CryptographicException("A cached value failed to authenticate; its memory was altered.");
+            if (status != AESGCMSIV_SUCCESS)
+                throw new CryptographicException($"Reading the value failed with error code: {status}");
+        }
+
+        private int Call(Func<IntPtr, int> call)
+        {
+            bool added = false;
+            _cache.DangerousAddRef(ref added);
+            try
+            {
+                return call(_cache.DangerousGetHandle());
+            }
+            finally
+            {
+                _cache.DangerousRelease();
+            }
+        }
+
+        private void ThrowIfDisposed()
+        {
+            if (_disposed)
+                throw new ObjectDisposedException(nameof(AesGcmSivValueCache));
+        }
+    }
+}
@@ -0,0 +1,36 @@
+using Microsoft.Win32.SafeHandles;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Owns a native <c>aesgcmsiv_buffers</c> registry. Releasing the handle frees the registry; the
+    /// registered memory belongs to the <see cref="AesGcmSivBufferPool"/> and is left alone.
+    /// </summary>
+    internal sealed class SafeAesGcmSivBuffersHandle : SafeHandleZeroOrMinusOneIsInvalid
+    {
+        private SafeAesGcmSivBuffersHandle()
+            : base(ownsHandle: true)
+        {
+        }
+
+        /// <summary>
+        /// Creates a registry of <paramref name="count"/> unregistered buffers. The handle is returned
+        /// even on failure, and is then invalid; the caller disposes it.
+        /// </summary>
+        internal static unsafe int Create(int count, out SafeAesGcmSivBuffersHandle handle)
+        {
+            AesGcmSivNative.EnsureLoaded();
+            handle = new SafeAesGcmSivBuffersHandle();
+            IntPtr buffers = IntPtr.Zero;
+            int result = AesGcmSivNative.BuffersNew((nuint)count, &buffers);
+            handle.SetHandle(buffers);
+            return result;
+        }
+
+        protected override unsafe bool ReleaseHandle()
+        {
+            AesGcmSivNative.BuffersFree(handle);
+            return true;
+        }
+    }
+}
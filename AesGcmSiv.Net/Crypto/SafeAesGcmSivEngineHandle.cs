@@ -0,0 +1,36 @@
+using Microsoft.Win32.SafeHandles;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Owns a native <c>aesgcmsiv_engine</c>. Releasing the handle waits for the engine's workers and
+    /// frees it, so it must only happen once nothing is reaping the engine any more.
+    /// </summary>
+    internal sealed class SafeAesGcmSivEngineHandle : SafeHandleZeroOrMinusOneIsInvalid
+    {
+        private SafeAesGcmSivEngineHandle()
+            : base(ownsHandle: true)
+        {
+        }
+
+        /// <summary>
+        /// Creates an engine. The handle is returned even on failure, and is then invalid; the caller
+        /// disposes it.
+        /// </summary>
+        internal static unsafe int Create(int workerCount, int queueDepth, out SafeAesGcmSivEngineHandle handle)
+        {
+            AesGcmSivNative.EnsureLoaded();
+            handle = new SafeAesGcmSivEngineHandle();
+            IntPtr engine = IntPtr.Zero;
+            int result = AesGcmSivNative.EngineNew((uint)workerCount, (nuint)queueDepth, &engine);
+            handle.SetHandle(engine);
+            return result;
+        }
+
+        protected override unsafe bool ReleaseHandle()
+        {
+            AesGcmSivNative.EngineFree(handle);
+            return true;
+        }
+    }
+}
@@ -0,0 +1,133 @@
+using System.Text;
+using Microsoft.Win32.SafeHandles;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Owns a native <c>aesgcmsiv_ctx</c>. Releasing the handle frees the context, which clears
+    /// its key schedule.
+    /// </summary>
+    internal sealed class SafeAesGcmSivHandle : SafeHandleZeroOrMinusOneIsInvalid
+    {
+        private SafeAesGcmSivHandle()
+            : base(ownsHandle: true)
+        {
+        }
+
+        /// <summary>
+        /// Creates a context for <paramref name="key"/>. The handle is returned even on failure, and is
+        /// then invalid; the caller disposes it.
+        /// </summary>
+        internal static unsafe int Create(ReadOnlySpan<byte> key, out SafeAesGcmSivHandle handle)
+        {
+            AesGcmSivNative.EnsureLoaded();
+            handle = new SafeAesGcmSivHandle();
+            IntPtr ctx = IntPtr.Zero;
+            int result;
+            fixed (byte* keyPtr = key)
+            {
+                result = AesGcmSivNative.CtxNew(keyPtr, (nuint)key.Length, &ctx);
+            }
+            handle.SetHandle(ctx);
+            return result;
+        }
+
+        /// <summary>
+        /// Creates a context whose cipher is fetched from <paramref name="provider"/> with
+        /// <paramref name="properties"/>; null for both is the same as the overload without them.
+        /// </summary>
+        internal static unsafe int Create(ReadOnlySpan<byte> key, string? provider, string? properties, out SafeAesGcmSivHandle handle)
+        {
+            if (provider == null && properties == null)
+                return Create(key, out handle);
+
+            AesGcmSivNative.EnsureLoaded();
+            handle = new SafeAesGcmSivHandle();
+            IntPtr ctx = IntPtr.Zero;
+            int result;
+            fixed (byte* keyPtr = key)
+            fixed (byte* providerPtr = ToNativeString(provider))
+            fixed (byte* propertiesPtr = ToNativeString(properties))
+            {
+                result = AesGcmSivNative.CtxNewEx(keyPtr, (nuint)key.Length, providerPtr, propertiesPtr, &ctx);
+            }
+            handle.SetHandle(ctx);
+            return result;
+        }
+
+        /// <summary>
+        /// Creates a context for <paramref name="key"/> from the native key cache <paramref name="cache"/>,
+        /// which expands the key only if it is not already cached. The handle is returned even on
+        /// failure, and is then invalid; the caller disposes it.
+        /// </summary>
+        internal static unsafe int CreateFromCache(IntPtr cache, ReadOnlySpan<byte> key, out SafeAesGcmSivHandle handle)
+        {
+            handle = new SafeAesGcmSivHandle();
+            IntPtr ctx = IntPtr.Zero;
+            int result;
+            fixed (byte* keyPtr = key)
+            {
+                result = AesGcmSivNative.KeyCacheGet(cache, keyPtr, (nuint)key.Length, &ctx);
+            }
+            handle.SetHandle(ctx);
+            return result;
+        }
+
+        /// <summary>
+        /// Creates a context for the same key as <paramref name="template"/>, copying its expanded key
+        /// and settings. The handle is returned even on failure, and is then invalid; the caller
+        /// disposes it.
+        /// </summary>
+        internal static unsafe int Clone(SafeAesGcmSivHandle template, out SafeAesGcmSivHandle handle)
+        {
+            handle = new SafeAesGcmSivHandle();
+            IntPtr ctx = IntPtr.Zero;
+            int result;
+            using (var lease = new Lease(template))
+            {
+                result = AesGcmSivNative.CtxClone(lease.Pointer, &ctx);
+            }
+            handle.SetHandle(ctx);
+            return result;
+        }
+
+        // NUL-terminated UTF-8, or null to pass NULL
+        private static byte[]? ToNativeString(string? value)
+        {
+            if (value == null)
+                return null;
+            var bytes = new byte[Encoding.UTF8.GetByteCount(value) + 1];
+            Encoding.UTF8.GetBytes(value, 0, value.Length, bytes, 0);
+            return bytes;
+        }
+
+        protected override unsafe bool ReleaseHandle()
+        {
+            AesGcmSivNative.CtxFree(handle);
+            return true;
+        }
+
+        /// <summary>
+        /// Keeps the handle from being released for the duration of a native call. Function pointer
+        /// calls bypass the marshaller, which would otherwise take this reference.
+        /// </summary>
+        internal readonly ref struct Lease
+        {
+            private readonly SafeAesGcmSivHandle _handle;
+
+            /// <summary>The raw context, valid until the lease is disposed.</summary>
+            public readonly IntPtr Pointer;
+
+            /// <exception cref="ObjectDisposedException">The handle has been released.</exception>
+            public Lease(SafeAesGcmSivHandle handle)
+            {
+                bool added = false;
+                handle.DangerousAddRef(ref added);
+                _handle = handle;
+                Pointer = handle.DangerousGetHandle();
+            }
+
+            public void Dispose() => _handle.DangerousRelease();
+        }
+    }
+}
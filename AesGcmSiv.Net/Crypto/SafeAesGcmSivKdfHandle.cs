@@ -0,0 +1,43 @@
+using Microsoft.Win32.SafeHandles;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Owns a native <c>aesgcmsiv_kdf</c>. Releasing the handle clears the extracted key and frees the
+    /// derivation.
+    /// </summary>
+    internal sealed class SafeAesGcmSivKdfHandle : SafeHandleZeroOrMinusOneIsInvalid
+    {
+        private SafeAesGcmSivKdfHandle()
+            : base(ownsHandle: true)
+        {
+        }
+
+        /// <summary>
+        /// Creates a derivation from <paramref name="masterKey"/> and <paramref name="salt"/>. The handle
+        /// is returned even on failure, and is then invalid; the caller disposes it.
+        /// </summary>
+        internal static unsafe int Create(
+            ReadOnlySpan<byte> masterKey, ReadOnlySpan<byte> salt, int keySize, out SafeAesGcmSivKdfHandle handle)
+        {
+            AesGcmSivNative.EnsureLoaded();
+            handle = new SafeAesGcmSivKdfHandle();
+            IntPtr kdf = IntPtr.Zero;
+            int result;
+            fixed (byte* keyPtr = masterKey)
+            fixed (byte* saltPtr = salt)
+            {
+                result = AesGcmSivNative.KdfNew(
+                    keyPtr, (nuint)masterKey.Length, saltPtr, (nuint)salt.Length, (nuint)keySize, &kdf);
+            }
+            handle.SetHandle(kdf);
+            return result;
+        }
+
+        protected override unsafe bool ReleaseHandle()
+        {
+            AesGcmSivNative.KdfFree(handle);
+            return true;
+        }
+    }
+}
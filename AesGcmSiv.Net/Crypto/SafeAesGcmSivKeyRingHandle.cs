@@ -0,0 +1,36 @@
+using Microsoft.Win32.SafeHandles;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Owns a native <c>aesgcmsiv_keyring</c>. Releasing the handle clears every key, removed ones
+    /// included, and frees the keyring.
+    /// </summary>
+    internal sealed class SafeAesGcmSivKeyRingHandle : SafeHandleZeroOrMinusOneIsInvalid
+    {
+        private SafeAesGcmSivKeyRingHandle()
+            : base(ownsHandle: true)
+        {
+        }
+
+        /// <summary>
+        /// Creates an empty keyring for up to <paramref name="capacity"/> keys. The handle is returned
+        /// even on failure, and is then invalid; the caller disposes it.
+        /// </summary>
+        internal static unsafe int Create(int capacity, out SafeAesGcmSivKeyRingHandle handle)
+        {
+            AesGcmSivNative.EnsureLoaded();
+            handle = new SafeAesGcmSivKeyRingHandle();
+            IntPtr keyring = IntPtr.Zero;
+            int result = AesGcmSivNative.KeyRingNew((nuint)capacity, &keyring);
+            handle.SetHandle(keyring);
+            return result;
+        }
+
+        protected override unsafe bool ReleaseHandle()
+        {
+            AesGcmSivNative.KeyRingFree(handle);
+            return true;
+        }
+    }
+}
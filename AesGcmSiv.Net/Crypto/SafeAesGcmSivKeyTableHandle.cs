@@ -0,0 +1,36 @@
+using Microsoft.Win32.SafeHandles;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Owns a native <c>aesgcmsiv_key_table</c>. Releasing the handle clears every slot and frees the
+    /// table.
+    /// </summary>
+    internal sealed class SafeAesGcmSivKeyTableHandle : SafeHandleZeroOrMinusOneIsInvalid
+    {
+        private SafeAesGcmSivKeyTableHandle()
+            : base(ownsHandle: true)
+        {
+        }
+
+        /// <summary>
+        /// Creates a table of <paramref name="slotCount"/> empty slots. The handle is returned even on
+        /// failure, and is then invalid; the caller disposes it.
+        /// </summary>
+        internal static unsafe int Create(int slotCount, out SafeAesGcmSivKeyTableHandle handle)
+        {
+            AesGcmSivNative.EnsureLoaded();
+            handle = new SafeAesGcmSivKeyTableHandle();
+            IntPtr table = IntPtr.Zero;
+            int result = AesGcmSivNative.KeyTableNew((nuint)slotCount, &table);
+            handle.SetHandle(table);
+            return result;
+        }
+
+        protected override unsafe bool ReleaseHandle()
+        {
+            AesGcmSivNative.KeyTableFree(handle);
+            return true;
+        }
+    }
+}
@@ -0,0 +1,83 @@
+using Microsoft.Win32.SafeHandles;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Owns a native <c>aesgcmsiv_stream</c>. The stream borrows its key context, so the handle holds a
+    /// reference on the context's handle until it is released.
+    /// </summary>
+    internal sealed class SafeAesGcmSivStreamHandle : SafeHandleZeroOrMinusOneIsInvalid
+    {
+        private SafeAesGcmSivHandle? _context;
+
+        private SafeAesGcmSivStreamHandle()
+            : base(ownsHandle: true)
+        {
+        }
+
+        /// <summary>
+        /// Starts sealing a compressed stream under <paramref name="context"/>, writing its header to
+        /// <paramref name="header"/>. The handle is returned even on failure, and is then invalid; the
+        /// caller disposes it.
+        /// </summary>
+        internal static unsafe int CreateCompressed(
+            SafeAesGcmSivHandle context, int chunkSize, AesGcmSivCompression method, int level, Span<byte> header,
+            out SafeAesGcmSivStreamHandle handle)
+        {
+            handle = new SafeAesGcmSivStreamHandle();
+            IntPtr stream = IntPtr.Zero;
+            int result;
+            handle.Borrow(context);
+            fixed (byte* headerPtr = header)
+            {
+                result = AesGcmSivNative.StreamSealNewCompressed(
+                    context.DangerousGetHandle(), (uint)chunkSize, (uint)method, level, headerPtr, &stream);
+            }
+            handle.SetHandle(stream);
+            return result;
+        }
+
+        /// <summary>
+        /// Starts opening the stream whose header is <paramref name="header"/> under
+        /// <paramref name="context"/>. The handle is returned even on failure, and is then invalid; the
+        /// caller disposes it.
+        /// </summary>
+        internal static unsafe int Open(
+            SafeAesGcmSivHandle context, ReadOnlySpan<byte> header, out SafeAesGcmSivStreamHandle handle)
+        {
+            handle = new SafeAesGcmSivStreamHandle();
+            IntPtr stream = IntPtr.Zero;
+            int result;
+            handle.Borrow(context);
+            fixed (byte* headerPtr = header)
+            {
+                result = AesGcmSivNative.StreamOpenNew(context.DangerousGetHandle(), headerPtr, &stream);
+            }
+            handle.SetHandle(stream);
+            return result;
+        }
+
+        private void Borrow(SafeAesGcmSivHandle context)
+        {
+            bool added = false;
+            context.DangerousAddRef(ref added);
+            _context = context;
+        }
+
+        // A handle that never became valid is not released, so it drops
+        // its context reference here instead
+        protected override void Dispose(bool disposing)
+        {
+            base.Dispose(disposing);
+            if (IsInvalid)
+                Interlocked.Exchange(ref _context, null)?.DangerousRelease();
+        }
+
+        protected override unsafe bool ReleaseHandle()
+        {
+            AesGcmSivNative.StreamFree(handle);
+            Interlocked.Exchange(ref _context, null)?.DangerousRelease();
+            return true;
+        }
+    }
+}
@@ -0,0 +1,43 @@
+using Microsoft.Win32.SafeHandles;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Owns a native <c>aesgcmsiv_value_cache</c>. Releasing the handle clears the key and frees the
+    /// cache and its slabs.
+    /// </summary>
+    internal sealed class SafeAesGcmSivValueCacheHandle : SafeHandleZeroOrMinusOneIsInvalid
+    {
+        private SafeAesGcmSivValueCacheHandle()
+            : base(ownsHandle: true)
+        {
+        }
+
+        /// <summary>
+        /// Creates a cache of up to <paramref name="capacity"/> entries under <paramref name="key"/>, or
+        /// under a random key if it is empty. The handle is returned even on failure, and is then
+        /// invalid; the caller disposes it.
+        /// </summary>
+        internal static unsafe int Create(
+            ReadOnlySpan<byte> key, int capacity, uint allocFlags, out SafeAesGcmSivValueCacheHandle handle)
+        {
+            AesGcmSivNative.EnsureLoaded();
+            handle = new SafeAesGcmSivValueCacheHandle();
+            IntPtr cache = IntPtr.Zero;
+            int result;
+            fixed (byte* keyPtr = key)
+            {
+                result = AesGcmSivNative.ValueCacheNew(
+                    key.IsEmpty ? null : keyPtr, (nuint)key.Length, (nuint)capacity, allocFlags, &cache);
+            }
+            handle.SetHandle(cache);
+            return result;
+        }
+
+        protected override unsafe bool ReleaseHandle()
+        {
+            AesGcmSivNative.ValueCacheFree(handle);
+            return true;
+        }
+    }
+}
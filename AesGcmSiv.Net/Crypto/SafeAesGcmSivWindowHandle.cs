@@ -0,0 +1,42 @@
+using Microsoft.Win32.SafeHandles;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Owns a chunk window from the native stream window pool. Releasing the handle wipes the window
+    /// and gives its memory back to the process-wide budget, so a stream that is never disposed still
+    /// frees its share once it is collected.
+    /// </summary>
+    internal sealed class SafeAesGcmSivWindowHandle : SafeHandleZeroOrMinusOneIsInvalid
+    {
+        private SafeAesGcmSivWindowHandle()
+            : base(ownsHandle: true)
+        {
+        }
+
+        /// <summary>
+        /// Takes a window of up to <paramref name="wanted"/> chunks of <paramref name="chunkBytes"/>
+        /// bytes, waiting until at least one fits the budget, and returns how many were granted. The
+        /// handle is returned even on failure, and is then invalid; the caller disposes it.
+        /// </summary>
+        internal static unsafe int Acquire(
+            int chunkBytes, int wanted, out SafeAesGcmSivWindowHandle handle, out int chunks)
+        {
+            AesGcmSivNative.EnsureLoaded();
+            handle = new SafeAesGcmSivWindowHandle();
+            byte* window = null;
+            uint granted = 0;
+            int result = AesGcmSivNative.StreamWindowAcquire(
+                (nuint)chunkBytes, (uint)wanted, 1, 1, &window, &granted);
+            handle.SetHandle((IntPtr)window);
+            chunks = (int)granted;
+            return result;
+        }
+
+        protected override unsafe bool ReleaseHandle()
+        {
+            AesGcmSivNative.StreamWindowRelease((byte*)handle);
+            return true;
+        }
+    }
+}
@@ -0,0 +1,42 @@
+using Microsoft.Win32.SafeHandles;
+
+namespace System.Security.Cryptography
+{
+    /// <summary>
+    /// Owns a native <c>aesgcmsiv_wrap_ctx</c>. Releasing the handle clears the derived keys and frees
+    /// the context.
+    /// </summary>
+    internal sealed class SafeAesGcmSivWrapHandle : SafeHandleZeroOrMinusOneIsInvalid
+    {
+        private SafeAesGcmSivWrapHandle()
+            : base(ownsHandle: true)
+        {
+        }
+
+        /// <summary>
+        /// Creates a key-wrapping context for <paramref name="key"/> and <paramref name="nonce"/>. The
+        /// handle is returned even on failure, and is then invalid; the caller disposes it.
+        /// </summary>
+        internal static unsafe int Create(
+            ReadOnlySpan<byte> key, ReadOnlySpan<byte> nonce, out SafeAesGcmSivWrapHandle handle)
+        {
+            AesGcmSivNative.EnsureLoaded();
+            handle = new SafeAesGcmSivWrapHandle();
+            IntPtr ctx = IntPtr.Zero;
+            int result;
+            fixed (byte* keyPtr = key)
+            fixed (byte* noncePtr = nonce)
+            {
+                result = AesGcmSivNative.WrapCtxNew(keyPtr, (nuint)key.Length, noncePtr, (nuint)nonce.Length, &ctx);
+            }
+            handle.SetHandle(ctx);
+            return result;
+        }
+
+        protected override unsafe bool ReleaseHandle()
+        {
+            AesGcmSivNative.WrapCtxFree(handle);
+            return true;
+        }
+    }
+}
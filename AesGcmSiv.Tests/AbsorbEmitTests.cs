@@ -0,0 +1,173 @@
+using System.Security.Cryptography;
+using Xunit;
+using static AesGcmSiv.Tests.NativeMethods;
+
+namespace AesGcmSiv.Tests
+{
+    /// <summary>
+    /// Tests for two-pass sealing on a message handle, through the native API.
+    /// </summary>
+    public unsafe class AbsorbEmitTests
+    {
+        private readonly byte[] _key;
+        private readonly byte[] _nonce;
+
+        public AbsorbEmitTests()
+        {
+            _key = Enumerable.Range(0, 32).Select(i => (byte)(i * 5 + 1)).ToArray();
+            _nonce = Enumerable.Range(0, 12).Select(i => (byte)(0xC0 | i)).ToArray();
+        }
+
+        private static IntPtr Begin(Context ctx, byte[] nonce)
+        {
+            IntPtr msg;
+            fixed (byte* n = nonce)
+                Assert.Equal(Success, aesgcmsiv_ctx_begin(ctx.Handle, n, (nuint)nonce.Length, &msg));
+            return msg;
+        }
+
+        private static int AadUpdate(IntPtr msg, ReadOnlySpan<byte> aad)
+        {
+            fixed (byte* a = aad)
+                return aesgcmsiv_ctx_aad_update(msg, a, (nuint)aad.Length);
+        }
+
+        private static int Absorb(IntPtr msg, ReadOnlySpan<byte> plaintext)
+        {
+            fixed (byte* p = plaintext)
+                return aesgcmsiv_ctx_absorb_plaintext(msg, p, (nuint)plaintext.Length);
+        }
+
+        private static int FinalizeTag(IntPtr msg, byte[] tag)
+        {
+            fixed (byte* t = tag)
+                return aesgcmsiv_ctx_finalize_tag(msg, t);
+        }
+
+        private static int Emit(IntPtr msg, ReadOnlySpan<byte> plaintext, Span<byte> ciphertext)
+        {
+            fixed (byte* p = plaintext)
+            fixed (byte* c = ciphertext)
+                return aesgcmsiv_ctx_emit_ciphertext(msg, p, (nuint)plaintext.Length, c);
+        }
+
+        // Seals in two passes, absorbing the first pass in pieces of absorbPiece bytes and
+        // emitting in pieces of emitPiece bytes from second, which is normally the plaintext
+        private static byte[] TwoPassSeal(
+            Context ctx, byte[] nonce, byte[] aad, byte[] plaintext, byte[] second, int absorbPiece, int emitPiece, byte[] tag)
+        {
+            IntPtr msg = Begin(ctx, nonce);
+            try
+            {
+                for (int offset = 0; offset < aad.Length; offset += 7)
+                    Assert.Equal(Success, AadUpdate(msg, aad.AsSpan(offset, Math.Min(7, aad.Length - offset))));
+                for (int offset = 0; offset < plaintext.Length; offset += absorbPiece)
+                    Assert.Equal(Success, Absorb(msg, plaintext.AsSpan(offset, Math.Min(absorbPiece, plaintext.Length - offset))));
+                Assert.Equal(Success, FinalizeTag(msg, tag));
+                var ciphertext = (byte[])second.Clone();
+                for (int offset = 0; offset < ciphertext.Length; offset += emitPiece)
+                {
+                    var piece = ciphertext.AsSpan(offset, Math.Min(emitPiece, ciphertext.Length - offset));
+                    Assert.Equal(Success, Emit(msg, piece, piece));
+                }
+                return ciphertext;
+            }
+            finally
+            {
+                aesgcmsiv_ctx_msg_free(msg);
+            }
+        }
+
+        [Theory]
+        [InlineData(0, 0, 1, 1)]
+        [InlineData(0, 33, 1, 1)]
+        [InlineData(15, 0, 4, 3)]
+        [InlineData(100, 20, 17, 64)]
+        [InlineData(4096, 5, 1000, 333)]
+        [InlineData(70_001, 300, 8192, 70_001)]
+        public void TwoPassSeal_ShouldMatchEncryptAndDecrypt(int length, int aadLength, int absorbPiece, int emitPiece)
+        {
+            // Arrange
+            using var ctx = new Context(_key);
+            var plaintext = Enumerable.Range(0, length).Select(i => (byte)(i * 3 ^ i >> 7)).ToArray();
+            var aad = Enumerable.Range(0, aadLength).Select(i => (byte)(200 - i)).ToArray();
+            var tag = new byte[16];
+
+            // Act: emitted in place
+            var ciphertext = TwoPassSeal(ctx, _nonce, aad, plaintext, plaintext, absorbPiece, emitPiece, tag);
+
+            // Assert
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_key);
+            var expected = new byte[length];
+            var expectedTag = new byte[16];
+            aesGcmSiv.Encrypt(_nonce, plaintext, expected, expectedTag, aad);
+            Assert.Equal(expected, ciphertext);
+            Assert.Equal(expectedTag, tag);
+            var decrypted = new byte[length];
+            aesGcmSiv.Decrypt(_nonce, ciphertext, tag, decrypted, aad);
+            Assert.Equal(plaintext, decrypted);
+        }
+
+        [Fact]
+        public void TwoPassSeal_WithDifferentSecondPassOrTamperedOutput_ShouldNotDecrypt()
+        {
+            // Arrange
+            using var ctx = new Context(_key);
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_key);
+            var plaintext = Enumerable.Range(0, 500).Select(i => (byte)i).ToArray();
+            var changed = (byte[])plaintext.Clone();
+            changed[250] ^= 0x10;
+            var tag = new byte[16];
+            var ciphertext = TwoPassSeal(ctx, _nonce, Array.Empty<byte>(), plaintext, plaintext, 64, 64, tag);
+            var mismatchedTag = new byte[16];
+            var mismatched = TwoPassSeal(ctx, _nonce, Array.Empty<byte>(), plaintext, changed, 64, 64, mismatchedTag);
+            ciphertext[499] ^= 0x01;
+            var output = new byte[plaintext.Length];
+
+            // Act & Assert
+            Assert.ThrowsAny<CryptographicException>(() => aesGcmSiv.Decrypt(_nonce, mismatched, mismatchedTag, output));
+            Assert.ThrowsAny<CryptographicException>(() => aesGcmSiv.Decrypt(_nonce, ciphertext, tag, output));
+        }
+
+        [Fact]
+        public void Message_CalledOutOfOrder_ShouldFail()
+        {
+            // Arrange
+            using var ctx = new Context(_key);
+            var data = new byte[32];
+            var tag = new byte[16];
+            IntPtr msg = Begin(ctx, _nonce);
+            try
+            {
+                // Act & Assert
+                Assert.Equal(InvalidInput, Emit(msg, data, data));
+                Assert.Equal(Success, Absorb(msg, data));
+                Assert.Equal(InvalidInput, AadUpdate(msg, data));
+                Assert.Equal(InvalidInput, aesgcmsiv_ctx_absorb_plaintext(msg, null, 1));
+                Assert.Equal(InvalidInput, aesgcmsiv_ctx_finalize_tag(msg, null));
+                Assert.Equal(Success, FinalizeTag(msg, tag));
+                Assert.Equal(InvalidInput, Absorb(msg, data));
+                Assert.Equal(InvalidInput, FinalizeTag(msg, tag));
+                Assert.Equal(InvalidInput, Emit(msg, new byte[33], new byte[33]));
+                Assert.Equal(Success, Emit(msg, data, data));
+                Assert.Equal(InvalidInput, Emit(msg, data.AsSpan(0, 1), data.AsSpan(0, 1)));
+            }
+            finally
+            {
+                aesgcmsiv_ctx_msg_free(msg);
+            }
+        }
+
+        [Fact]
+        public void Begin_WithInvalidNonce_ShouldFail()
+        {
+            using var ctx = new Context(_key);
+            IntPtr msg;
+            var nonce = new byte[16];
+
+            fixed (byte* n = nonce)
+                Assert.Equal(InvalidNonce, aesgcmsiv_ctx_begin(ctx.Handle, n, 16, &msg));
+            Assert.Equal(InvalidNonce, aesgcmsiv_ctx_begin(ctx.Handle, null, 12, &msg));
+        }
+    }
+}
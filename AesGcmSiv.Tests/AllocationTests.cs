@@ -0,0 +1,117 @@
+using System.Security.Cryptography;
+using Xunit;
+
+namespace AesGcmSiv.Tests
+{
+    /// <summary>
+    /// Guards the span-based calls against allocating once warmed up.
+    /// </summary>
+    [Collection(SteadyStateCollection.Name)]
+    public class AllocationTests
+    {
+        private const int Iterations = 10_000;
+
+        // Past one-time work: loading the library, calibrating Auto and
+        // tiering up the JIT
+        private const int WarmupIterations = 200;
+
+        [Theory]
+        [InlineData(AesGcmSivImplementation.Native, 64)]
+        [InlineData(AesGcmSivImplementation.Native, 4096)]
+        [InlineData(AesGcmSivImplementation.Managed, 64)]
+        [InlineData(AesGcmSivImplementation.Managed, 4096)]
+        [InlineData(AesGcmSivImplementation.Auto, 64)]
+        [InlineData(AesGcmSivImplementation.Auto, 4096)]
+        public void SpanCalls_InSteadyState_ShouldNotAllocate(AesGcmSivImplementation implementation, int length)
+        {
+            // Arrange
+            var key = new byte[32];
+            for (int i = 0; i < key.Length; i++) key[i] = (byte)i;
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(key, implementation);
+            var nonce = new byte[12];
+            var plaintext = new byte[length];
+            var ciphertext = new byte[length];
+            var decrypted = new byte[length];
+            var tag = new byte[16];
+            var badTag = new byte[16];
+            var associatedData = new byte[] { 1, 2, 3, 4, 5, 6, 7, 8 };
+            for (int i = 0; i < plaintext.Length; i++) plaintext[i] = (byte)(i * 7);
+
+            void Run(int count)
+            {
+                for (int i = 0; i < count; i++)
+                {
+                    nonce[0] = (byte)i;
+                    aesGcmSiv.Encrypt(nonce, plaintext.AsSpan(), ciphertext.AsSpan(), tag.AsSpan(), associatedData.AsSpan());
+                    aesGcmSiv.Decrypt(nonce, ciphertext.AsSpan(), tag.AsSpan(), decrypted.AsSpan(), associatedData.AsSpan());
+                    aesGcmSiv.TryDecrypt(nonce, ciphertext.AsSpan(), tag.AsSpan(), decrypted.AsSpan(), associatedData.AsSpan());
+                    // A forged tag fails without an exception, and must not allocate either
+                    aesGcmSiv.TryDecrypt(nonce, ciphertext.AsSpan(), badTag.AsSpan(), decrypted.AsSpan(), associatedData.AsSpan());
+                }
+            }
+
+            Run(WarmupIterations);
+
+            // Act
+            long before = GC.GetAllocatedBytesForCurrentThread();
+            Run(Iterations);
+            long allocated = GC.GetAllocatedBytesForCurrentThread() - before;
+
+            // Assert
+            Assert.Equal(0, allocated);
+            Assert.True(aesGcmSiv.TryDecrypt(nonce, ciphertext, tag, decrypted, associatedData));
+            Assert.Equal(plaintext, decrypted);
+        }
+
+        [Theory]
+        [InlineData(AesGcmSivImplementation.Native)]
+        [InlineData(AesGcmSivImplementation.Managed)]
+        public void ReusableBatch_InSteadyState_ShouldNotAllocate(AesGcmSivImplementation implementation)
+        {
+            // Arrange
+            var key = new byte[32];
+            for (int i = 0; i < key.Length; i++) key[i] = (byte)i;
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(key, implementation);
+            using var batch = new AesGcmSivBatch(aesGcmSiv);
+            const int Items = 32;
+            var nonces = new byte[Items * 12];
+            var plaintext = new byte[Items * 256];
+            var ciphertext = new byte[plaintext.Length];
+            var tags = new byte[Items * 16];
+            var succeeded = new bool[Items];
+
+            void Run(int count)
+            {
+                for (int n = 0; n < count; n++)
+                {
+                    for (int i = 0; i < Items; i++)
+                    {
+                        batch.Add(nonces.AsMemory(i * 12, 12), plaintext.AsMemory(i * 256, 256),
+                            ciphertext.AsMemory(i * 256, 256), tags.AsMemory(i * 16, 16));
+                    }
+                    batch.Encrypt();
+                    batch.Clear();
+                    for (int i = 0; i < Items; i++)
+                    {
+                        batch.Add(nonces.AsMemory(i * 12, 12), ciphertext.AsMemory(i * 256, 256),
+                            ciphertext.AsMemory(i * 256, 256), tags.AsMemory(i * 16, 16));
+                    }
+                    batch.Decrypt(succeeded);
+                    batch.Clear();
+                }
+            }
+
+            Run(WarmupIterations);
+
+            // Act
+            long before = GC.GetAllocatedBytesForCurrentThread();
+            Run(Iterations / 10);
+            long allocated = GC.GetAllocatedBytesForCurrentThread() - before;
+
+            // Assert
+            Assert.Equal(0, allocated);
+            Assert.DoesNotContain(false, succeeded);
+            Assert.Equal(plaintext, ciphertext);
+        }
+    }
+}
@@ -0,0 +1,14 @@
+using Xunit;
+
+namespace AesGcmSiv.Tests
+{
+    /// <summary>
+    /// Runs the tests that switch the process's native backend on their own, so that no other test
+    /// runs on a backend it did not expect.
+    /// </summary>
+    [CollectionDefinition(Name, DisableParallelization = true)]
+    public sealed class BackendSelectionCollection
+    {
+        public const string Name = "Backend selection";
+    }
+}
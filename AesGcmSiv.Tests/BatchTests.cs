@@ -0,0 +1,243 @@
+using System.Security.Cryptography;
+using Xunit;
+
+namespace AesGcmSiv.Tests
+{
+    /// <summary>
+    /// Tests for the batch encryption and decryption APIs.
+    /// </summary>
+    public class BatchTests
+    {
+        private readonly byte[] _testKey;
+
+        public BatchTests()
+        {
+            _testKey = new byte[32];
+            for (int i = 0; i < _testKey.Length; i++) _testKey[i] = (byte)i;
+        }
+
+        private static AesGcmSivBatchItem[] CreateItems(int count)
+        {
+            var items = new AesGcmSivBatchItem[count];
+            for (int i = 0; i < count; i++)
+            {
+                var nonce = new byte[12];
+                nonce[0] = (byte)i;
+                var plaintext = new byte[i * 7];
+                for (int j = 0; j < plaintext.Length; j++) plaintext[j] = (byte)(i + j);
+                byte[]? associatedData = i % 2 == 0 ? null : new byte[] { (byte)i, 1, 2, 3 };
+                items[i] = new AesGcmSivBatchItem(nonce, plaintext, new byte[plaintext.Length], new byte[16], associatedData);
+            }
+            return items;
+        }
+
+        [Fact]
+        public void EncryptBatch_ShouldMatchIndividualEncrypt()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var items = CreateItems(20);
+
+            // Act
+            aesGcmSiv.EncryptBatch(items);
+
+            // Assert
+            foreach (var item in items)
+            {
+                var ciphertext = new byte[item.Input.Length];
+                var tag = new byte[16];
+                aesGcmSiv.Encrypt(item.Nonce, item.Input, ciphertext, tag, item.AssociatedData);
+                Assert.Equal(ciphertext, item.Output);
+                Assert.Equal(tag, item.Tag);
+            }
+        }
+
+        [Fact]
+        public void EncryptBatch_WithNoItems_ShouldNotThrow()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+
+            // Act & Assert
+            aesGcmSiv.EncryptBatch(Array.Empty<AesGcmSivBatchItem>());
+        }
+
+        [Fact]
+        public void EncryptBatch_WithInvalidNonce_ShouldThrowArgumentException()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var items = CreateItems(3);
+            items[1] = new AesGcmSivBatchItem(new byte[11], items[1].Input, items[1].Output, items[1].Tag);
+
+            // Act & Assert
+            Assert.Throws<ArgumentException>(() => aesGcmSiv.EncryptBatch(items));
+        }
+
+        [Fact]
+        public void EncryptBatch_AfterDispose_ShouldThrowObjectDisposedException()
+        {
+            // Arrange
+            var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            aesGcmSiv.Dispose();
+
+            // Act & Assert
+            Assert.Throws<ObjectDisposedException>(() => aesGcmSiv.EncryptBatch(CreateItems(1)));
+        }
+
+        [Fact]
+        public void DecryptBatch_ShouldRoundTrip()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var items = CreateItems(20);
+            aesGcmSiv.EncryptBatch(items);
+            var decryptItems = items
+                .Select(i => new AesGcmSivBatchItem(i.Nonce, i.Output, new byte[i.Output.Length], i.Tag, i.AssociatedData))
+                .ToArray();
+            var succeeded = new bool[decryptItems.Length];
+
+            // Act
+            int failures = aesGcmSiv.DecryptBatch(decryptItems, succeeded);
+
+            // Assert
+            Assert.Equal(0, failures);
+            Assert.True(succeeded.All(s => s));
+            for (int i = 0; i < items.Length; i++)
+            {
+                Assert.Equal(items[i].Input, decryptItems[i].Output);
+            }
+        }
+
+        [Fact]
+        public void DecryptBatch_WithCorruptItems_ShouldReportThemAndDecryptTheRest()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var items = CreateItems(10);
+            aesGcmSiv.EncryptBatch(items);
+            items[3].Tag[0] ^= 1;
+            items[7].Output[0] ^= 1;
+            var decryptItems = items
+                .Select(i => new AesGcmSivBatchItem(i.Nonce, i.Output, new byte[i.Output.Length], i.Tag, i.AssociatedData))
+                .ToArray();
+            var succeeded = new bool[decryptItems.Length];
+
+            // Act
+            int failures = aesGcmSiv.DecryptBatch(decryptItems, succeeded);
+
+            // Assert
+            Assert.Equal(2, failures);
+            for (int i = 0; i < items.Length; i++)
+            {
+                bool corrupt = i == 3 || i == 7;
+                Assert.Equal(!corrupt, succeeded[i]);
+                if (corrupt)
+                    Assert.True(decryptItems[i].Output.All(b => b == 0)); // No unauthenticated plaintext
+                else
+                    Assert.Equal(items[i].Input, decryptItems[i].Output);
+            }
+        }
+
+        [Fact]
+        public void DecryptBatch_WithSmallResultBuffer_ShouldThrowArgumentException()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var items = CreateItems(3);
+            aesGcmSiv.EncryptBatch(items);
+
+            // Act & Assert
+            Assert.Throws<ArgumentException>(() => aesGcmSiv.DecryptBatch(items, new bool[2]));
+        }
+
+        private static async IAsyncEnumerable<AesGcmSivBatchItem> ToAsync(IEnumerable<AesGcmSivBatchItem> items)
+        {
+            foreach (var item in items)
+            {
+                await Task.Yield();
+                yield return item;
+            }
+        }
+
+        [Theory]
+        [InlineData(1)]
+        [InlineData(8)]
+        [InlineData(64)]
+        public async Task EncryptStream_ShouldYieldItemsInOrderAndMatchIndividualEncrypt(int batchSize)
+        {
+            // Arrange - 37 items leave a partial final batch for every size but 1
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var items = CreateItems(37);
+
+            // Act
+            var results = new List<AesGcmSivBatchItem>();
+            await foreach (var item in aesGcmSiv.EncryptStream(ToAsync(items), batchSize))
+                results.Add(item);
+
+            // Assert
+            Assert.Equal(items.Length, results.Count);
+            for (int i = 0; i < items.Length; i++)
+            {
+                Assert.Same(items[i].Output, results[i].Output);
+                var ciphertext = new byte[items[i].Input.Length];
+                var tag = new byte[16];
+                aesGcmSiv.Encrypt(items[i].Nonce, items[i].Input, ciphertext, tag, items[i].AssociatedData);
+                Assert.Equal(ciphertext, results[i].Output);
+                Assert.Equal(tag, results[i].Tag);
+            }
+        }
+
+        [Fact]
+        public void EncryptStream_WithInvalidBatchSize_ShouldThrowArgumentOutOfRangeException()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+
+            // Act & Assert
+            Assert.Throws<ArgumentOutOfRangeException>(() => aesGcmSiv.EncryptStream(ToAsync(CreateItems(1)), 0));
+        }
+
+        [Theory]
+        [InlineData(AesGcmSivImplementation.Native)]
+        [InlineData(AesGcmSivImplementation.Managed)]
+        public void ReusableBatch_ShouldMatchEncryptBatchAndRoundTripAcrossClears(AesGcmSivImplementation implementation)
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey, implementation);
+            using var batch = new AesGcmSivBatch(aesGcmSiv, capacity: 4);
+            var items = CreateItems(20);
+            var expected = CreateItems(20);
+            aesGcmSiv.EncryptBatch(expected);
+            var decrypted = new byte[items.Length][];
+            var succeeded = new bool[items.Length];
+
+            // Act
+            foreach (var item in items)
+                batch.Add(item.Nonce, item.Input, item.Output, item.Tag, item.AssociatedData);
+            batch.Encrypt();
+            batch.Clear();
+            items[3].Output[0] ^= 1;
+            for (int i = 0; i < items.Length; i++)
+            {
+                decrypted[i] = new byte[items[i].Input.Length];
+                batch.Add(items[i].Nonce, items[i].Output, decrypted[i], items[i].Tag, items[i].AssociatedData);
+            }
+            int failures = batch.Decrypt(succeeded);
+
+            // Assert
+            items[3].Output[0] ^= 1;
+            for (int i = 0; i < items.Length; i++)
+            {
+                Assert.Equal(expected[i].Output, items[i].Output);
+                Assert.Equal(expected[i].Tag, items[i].Tag);
+                Assert.Equal(i != 3, succeeded[i]);
+                Assert.Equal(i == 3 ? new byte[items[i].Input.Length] : items[i].Input, decrypted[i]);
+            }
+            Assert.Equal(1, failures);
+            Assert.Equal(20, batch.Count);
+            Assert.Throws<ArgumentException>(() => batch.Add(new byte[11], items[1].Input, items[1].Output, items[1].Tag));
+            Assert.Throws<ArgumentException>(() => batch.Decrypt(new bool[19]));
+        }
+    }
+}
@@ -0,0 +1,102 @@
+using System.Net.Http.Headers;
+using System.Security.Cryptography;
+using Microsoft.AspNetCore.Builder;
+using Microsoft.AspNetCore.Hosting;
+using Microsoft.AspNetCore.Http;
+using Microsoft.AspNetCore.TestHost;
+using Xunit;
+
+namespace AesGcmSiv.Tests
+{
+    /// <summary>
+    /// Tests for the request and response body encryption middleware.
+    /// </summary>
+    public class BodyEncryptionTests
+    {
+        private static readonly byte[] _key = Enumerable.Range(0, 32).Select(i => (byte)(i * 7)).ToArray();
+
+        private static TestServer CreateServer(System.Security.Cryptography.AesGcmSiv key, RequestDelegate app) =>
+            new(new WebHostBuilder().Configure(builder =>
+            {
+                builder.UseAesGcmSivBodyEncryption(key, options => options.ChunkSize = 64);
+                builder.Run(app);
+            }));
+
+        private static async Task<byte[]> SealAsync(System.Security.Cryptography.AesGcmSiv key, byte[] plaintext)
+        {
+            var sealedData = new MemoryStream();
+            await using (var encryptor = new AesGcmSivStream(sealedData, key, CryptoStreamMode.Write, 64, leaveOpen: true))
+                await encryptor.WriteAsync(plaintext);
+            return sealedData.ToArray();
+        }
+
+        [Fact]
+        public async Task Middleware_ShouldEncryptTheResponseOnlyWhenAccepted()
+        {
+            // Arrange
+            using var key = new System.Security.Cryptography.AesGcmSiv(_key);
+            var plaintext = Enumerable.Range(0, 300).Select(i => (byte)(i * 13)).ToArray();
+            using var server = CreateServer(key, context =>
+            {
+                context.Response.ContentLength = plaintext.Length;
+                return context.Response.Body.WriteAsync(plaintext).AsTask();
+            });
+            using var client = server.CreateClient();
+            var accepting = new HttpRequestMessage(HttpMethod.Get, "/");
+            accepting.Headers.AcceptEncoding.Add(new StringWithQualityHeaderValue("aesgcmsiv"));
+
+            // Act
+            using var encrypted = await client.SendAsync(accepting);
+            using var plain = await client.GetAsync("/");
+            var decrypted = new MemoryStream();
+            using (var decryptor = new AesGcmSivStream(await encrypted.Content.ReadAsStreamAsync(), key, CryptoStreamMode.Read))
+                await decryptor.CopyToAsync(decrypted);
+
+            // Assert
+            Assert.Equal(new[] { "aesgcmsiv" }, encrypted.Content.Headers.ContentEncoding);
+            Assert.Null(encrypted.Content.Headers.ContentLength);
+            Assert.Equal(plaintext, decrypted.ToArray());
+            Assert.Empty(plain.Content.Headers.ContentEncoding);
+            Assert.Equal(plaintext, await plain.Content.ReadAsByteArrayAsync());
+        }
+
+        [Fact]
+        public async Task Middleware_ShouldDecryptTheRequestAndRejectATamperedOne()
+        {
+            // Arrange
+            using var key = new System.Security.Cryptography.AesGcmSiv(_key);
+            var plaintext = Enumerable.Range(0, 200).Select(i => (byte)(i * 5)).ToArray();
+            byte[] sealedBody = await SealAsync(key, plaintext);
+            using var server = CreateServer(key, async context =>
+            {
+                try
+                {
+                    var body = new MemoryStream();
+                    await context.Request.Body.CopyToAsync(body);
+                    await context.Response.Body.WriteAsync(body.ToArray());
+                }
+                catch (BadHttpRequestException e)
+                {
+                    context.Response.StatusCode = e.StatusCode;
+                }
+            });
+            using var client = server.CreateClient();
+
+            HttpRequestMessage Post(byte[] body)
+            {
+                var request = new HttpRequestMessage(HttpMethod.Post, "/") { Content = new ByteArrayContent(body) };
+                request.Content.Headers.ContentEncoding.Add("aesgcmsiv");
+                return request;
+            }
+
+            // Act
+            using var echoed = await client.SendAsync(Post(sealedBody));
+            sealedBody[AesGcmSivStream.HeaderSize + 70] ^= 1;
+            using var rejected = await client.SendAsync(Post(sealedBody));
+
+            // Assert
+            Assert.Equal(plaintext, await echoed.Content.ReadAsByteArrayAsync());
+            Assert.Equal(400, (int)rejected.StatusCode);
+        }
+    }
+}
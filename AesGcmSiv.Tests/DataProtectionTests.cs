@@ -0,0 +1,108 @@
+using System.Security.Cryptography;
+using Microsoft.AspNetCore.DataProtection;
+using Microsoft.AspNetCore.DataProtection.AuthenticatedEncryption;
+using Microsoft.Extensions.DependencyInjection;
+using Xunit;
+
+namespace AesGcmSiv.Tests
+{
+    /// <summary>
+    /// Tests for the ASP.NET Core Data Protection encryptor.
+    /// </summary>
+    public class DataProtectionTests
+    {
+        private static AesGcmSivAuthenticatedEncryptor CreateEncryptor(int keyLength = 32)
+        {
+            var key = new byte[keyLength];
+            for (int i = 0; i < key.Length; i++) key[i] = (byte)(i * 3);
+            return new AesGcmSivAuthenticatedEncryptor(new Secret(key));
+        }
+
+        [Fact]
+        public void Encryptor_ShouldRoundTrip()
+        {
+            // Arrange
+            using var encryptor = CreateEncryptor();
+            var plaintext = new byte[100];
+            for (int i = 0; i < plaintext.Length; i++) plaintext[i] = (byte)i;
+            var associatedData = new byte[] { 1, 2, 3, 4 };
+
+            // Act
+            var payload = encryptor.Encrypt(new ArraySegment<byte>(plaintext), new ArraySegment<byte>(associatedData));
+            var decrypted = encryptor.Decrypt(new ArraySegment<byte>(payload), new ArraySegment<byte>(associatedData));
+
+            // Assert
+            Assert.Equal(plaintext.Length + System.Security.Cryptography.AesGcmSiv.SealOverhead, payload.Length);
+            Assert.Equal(plaintext, decrypted);
+        }
+
+        [Fact]
+        public void Encryptor_WithWrongAssociatedDataOrTamperedPayload_ShouldThrow()
+        {
+            // Arrange
+            using var encryptor = CreateEncryptor(16);
+            var associatedData = new byte[] { 1, 2, 3, 4 };
+            var payload = encryptor.Encrypt(new ArraySegment<byte>(new byte[10]), new ArraySegment<byte>(associatedData));
+
+            // Act & Assert
+            Assert.ThrowsAny<CryptographicException>(() =>
+                encryptor.Decrypt(new ArraySegment<byte>(payload), new ArraySegment<byte>(new byte[] { 1, 2, 3 })));
+            payload[15] ^= 1;
+            Assert.ThrowsAny<CryptographicException>(() =>
+                encryptor.Decrypt(new ArraySegment<byte>(payload), new ArraySegment<byte>(associatedData)));
+            Assert.ThrowsAny<CryptographicException>(() =>
+                encryptor.Decrypt(new ArraySegment<byte>(payload, 0, 27), new ArraySegment<byte>(associatedData)));
+        }
+
+        [Fact]
+        public void Descriptor_ShouldRoundTripThroughXml()
+        {
+            // Arrange
+            var descriptor = (AesGcmSivAuthenticatedEncryptorDescriptor)
+                new AesGcmSivAuthenticatedEncryptorConfiguration { KeySize = 128 }.CreateNewDescriptor();
+
+            // Act
+            var info = descriptor.ExportToXml();
+            var imported = (AesGcmSivAuthenticatedEncryptorDescriptor)
+                new AesGcmSivAuthenticatedEncryptorDescriptorDeserializer().ImportFromXml(info.SerializedDescriptorElement);
+
+            // Assert
+            Assert.Equal(typeof(AesGcmSivAuthenticatedEncryptorDescriptorDeserializer), info.DeserializerType);
+            Assert.Equal(16, imported.MasterKey.Length);
+            using var encryptor = new AesGcmSivAuthenticatedEncryptor(descriptor.MasterKey);
+            using var importedEncryptor = new AesGcmSivAuthenticatedEncryptor(imported.MasterKey);
+            var payload = encryptor.Encrypt(new ArraySegment<byte>(new byte[] { 5, 6, 7 }), default);
+            Assert.Equal(new byte[] { 5, 6, 7 }, importedEncryptor.Decrypt(new ArraySegment<byte>(payload), default));
+        }
+
+        [Fact]
+        public void UseAesGcmSiv_ShouldProtectThroughDataProtection()
+        {
+            // Arrange
+            var keyDirectory = Directory.CreateTempSubdirectory();
+            try
+            {
+                var services = new ServiceCollection();
+                services.AddDataProtection()
+                    .PersistKeysToFileSystem(keyDirectory)
+                    .UseAesGcmSiv();
+                using var provider = services.BuildServiceProvider();
+                var protector = provider.GetRequiredService<IDataProtectionProvider>().CreateProtector("tests");
+
+                // Act
+                string token = protector.Protect("cookie value");
+
+                // Assert
+                Assert.Equal("cookie value", protector.Unprotect(token));
+                Assert.Contains(keyDirectory.GetFiles("*.xml"),
+                    file => File.ReadAllText(file.FullName).Contains(nameof(AesGcmSivAuthenticatedEncryptorDescriptorDeserializer)));
+                Assert.ThrowsAny<CryptographicException>(() =>
+                    provider.GetRequiredService<IDataProtectionProvider>().CreateProtector("other").Unprotect(token));
+            }
+            finally
+            {
+                keyDirectory.Delete(recursive: true);
+            }
+        }
+    }
+}
@@ -0,0 +1,187 @@
+using System.Runtime.InteropServices;
+using Xunit;
+using static AesGcmSiv.Tests.NativeMethods;
+
+namespace AesGcmSiv.Tests
+{
+    /// <summary>
+    /// Tests for sealing and opening datagrams in place through the native API.
+    /// </summary>
+    public unsafe class DatagramTests
+    {
+        private const int HeaderLength = 4;
+        private const int NonceLength = 12;
+        private const int TagLength = 16;
+        private const int Count = 24;
+
+        private readonly byte[] _key;
+
+        public DatagramTests()
+        {
+            _key = new byte[16];
+            for (int i = 0; i < _key.Length; i++) _key[i] = (byte)(0xA0 + i);
+        }
+
+        private static byte[] Payload(int i)
+        {
+            var payload = new byte[i * 37 % 300];
+            for (int j = 0; j < payload.Length; j++) payload[j] = (byte)(i * 3 + j);
+            return payload;
+        }
+
+        // Datagram i as the sender lays it out: header, spare nonce bytes, payload, room for the tag
+        private static byte[] Unsealed(int i)
+        {
+            var payload = Payload(i);
+            var buffer = new byte[HeaderLength + NonceLength + payload.Length + TagLength];
+            BitConverter.TryWriteBytes(buffer, i);
+            payload.CopyTo(buffer, HeaderLength + NonceLength);
+            return buffer;
+        }
+
+        // Runs call over the buffers, each holding lengths[i] bytes in use, and returns the lengths after
+        private static int Run(byte[][] buffers, int[] lengths, Func<nuint, IntPtr, int> call)
+        {
+            var datagrams = new Datagram[buffers.Length];
+            var handles = buffers.Select(b => GCHandle.Alloc(b, GCHandleType.Pinned)).ToArray();
+            try
+            {
+                for (int i = 0; i < buffers.Length; i++)
+                {
+                    datagrams[i].Data = (byte*)handles[i].AddrOfPinnedObject();
+                    datagrams[i].Length = (nuint)lengths[i];
+                }
+                int result;
+                fixed (Datagram* d = datagrams)
+                    result = call((nuint)buffers.Length, (IntPtr)d);
+                for (int i = 0; i < buffers.Length; i++)
+                    lengths[i] = (int)datagrams[i].Length;
+                return result;
+            }
+            finally
+            {
+                foreach (var handle in handles)
+                    handle.Free();
+            }
+        }
+
+        private static int Seal(Context ctx, byte[][] buffers, int[] lengths) =>
+            Run(buffers, lengths, (count, d) => aesgcmsiv_seal_datagrams(ctx.Handle, count, (Datagram*)d, HeaderLength));
+
+        private static int Open(Context ctx, byte[][] buffers, int[] lengths, int[] status) =>
+            Run(buffers, lengths, (count, d) =>
+            {
+                fixed (int* s = status)
+                    return aesgcmsiv_open_datagrams(ctx.Handle, count, (Datagram*)d, HeaderLength, s);
+            });
+
+        [Fact]
+        public void SealAndOpen_ShouldRoundTripInPlace()
+        {
+            // Arrange
+            using var ctx = new Context(_key);
+            var buffers = Enumerable.Range(0, Count).Select(Unsealed).ToArray();
+            var lengths = buffers.Select(b => b.Length - TagLength).ToArray();
+
+            // Act
+            int sealedResult = Seal(ctx, buffers, lengths);
+            var sealedLengths = (int[])lengths.Clone();
+            var status = new int[Count];
+            int openResult = Open(ctx, buffers, lengths, status);
+
+            // Assert
+            Assert.Equal(Success, sealedResult);
+            Assert.Equal(Success, openResult);
+            for (int i = 0; i < Count; i++)
+            {
+                var payload = Payload(i);
+                Assert.Equal(HeaderLength + NonceLength + payload.Length + TagLength, sealedLengths[i]);
+                Assert.Equal(HeaderLength + NonceLength + payload.Length, lengths[i]);
+                Assert.Equal(Success, status[i]);
+                Assert.Equal(i, BitConverter.ToInt32(buffers[i], 0));
+                Assert.Equal(payload, buffers[i].AsSpan(HeaderLength + NonceLength, payload.Length).ToArray());
+            }
+        }
+
+        [Fact]
+        public void Seal_ShouldUseAFreshNonceEachTime()
+        {
+            // Arrange
+            using var ctx = new Context(_key);
+            var buffers = new[] { Unsealed(5), Unsealed(5) };
+            var lengths = buffers.Select(b => b.Length - TagLength).ToArray();
+
+            // Act
+            Assert.Equal(Success, Seal(ctx, buffers, lengths));
+
+            // Assert
+            Assert.NotEqual(buffers[0].AsSpan(HeaderLength, NonceLength).ToArray(), buffers[1].AsSpan(HeaderLength, NonceLength).ToArray());
+            Assert.NotEqual(buffers[0], buffers[1]);
+        }
+
+        [Theory]
+        [InlineData(0)]
+        [InlineData(HeaderLength + 3)]
+        [InlineData(HeaderLength + NonceLength + 1)]
+        [InlineData(-1)]
+        public void Open_WithTamperedByte_ShouldFailOnlyThatDatagram(int offset)
+        {
+            // Arrange: offset -1 is the last tag byte; the header is authenticated too
+            using var ctx = new Context(_key);
+            var buffers = Enumerable.Range(1, 3).Select(Unsealed).ToArray();
+            var lengths = buffers.Select(b => b.Length - TagLength).ToArray();
+            Assert.Equal(Success, Seal(ctx, buffers, lengths));
+            var sealedLength = lengths[1];
+            buffers[1][offset < 0 ? sealedLength + offset : offset] ^= 0x20;
+
+            // Act
+            var status = new int[3];
+            int result = Open(ctx, buffers, lengths, status);
+
+            // Assert
+            Assert.Equal(DecryptFailed, result);
+            Assert.Equal(new[] { Success, DecryptFailed, Success }, status);
+            Assert.Equal(sealedLength, lengths[1]);
+            Assert.True(buffers[1].AsSpan(HeaderLength + NonceLength, Payload(2).Length).ToArray().All(b => b == 0));
+            Assert.Equal(Payload(3), buffers[2].AsSpan(HeaderLength + NonceLength, Payload(3).Length).ToArray());
+        }
+
+        [Fact]
+        public void Seal_WithDatagramShorterThanHeaderAndNonce_ShouldSealNone()
+        {
+            // Arrange
+            using var ctx = new Context(_key);
+            var buffers = new[] { Unsealed(4), new byte[HeaderLength + NonceLength + TagLength] };
+            var lengths = new[] { buffers[0].Length - TagLength, HeaderLength + NonceLength - 1 };
+            var original = (byte[])buffers[0].Clone();
+
+            // Act
+            int result = Seal(ctx, buffers, lengths);
+
+            // Assert
+            Assert.Equal(InvalidInput, result);
+            Assert.Equal(original, buffers[0]);
+            Assert.Equal(original.Length - TagLength, lengths[0]);
+        }
+
+        [Fact]
+        public void Open_WithDatagramTooShortForATag_ShouldFailThatDatagram()
+        {
+            // Arrange
+            using var ctx = new Context(_key);
+            var buffers = new[] { Unsealed(2), new byte[HeaderLength + NonceLength + TagLength] };
+            var lengths = new[] { buffers[0].Length - TagLength, 0 };
+            Assert.Equal(Success, Seal(ctx, buffers.Take(1).ToArray(), lengths));
+            lengths[1] = HeaderLength + NonceLength + TagLength - 1;
+
+            // Act
+            var status = new int[2];
+            int result = Open(ctx, buffers, lengths, status);
+
+            // Assert
+            Assert.Equal(DecryptFailed, result);
+            Assert.Equal(new[] { Success, DecryptFailed }, status);
+            Assert.Equal(HeaderLength + NonceLength + TagLength - 1, lengths[1]);
+        }
+    }
+}
@@ -0,0 +1,216 @@
+using System.Security.Cryptography;
+using Microsoft.EntityFrameworkCore;
+using Xunit;
+
+namespace AesGcmSiv.Tests
+{
+    /// <summary>
+    /// Tests for the EF Core column encryption package.
+    /// </summary>
+    public class EntityFrameworkTests
+    {
+        private static readonly byte[] s_key1 = Enumerable.Range(0, 32).Select(i => (byte)i).ToArray();
+        private static readonly byte[] s_key2 = Enumerable.Range(0, 16).Select(i => (byte)(i + 100)).ToArray();
+
+        private static byte[] ResolveKey(int keyId) => keyId switch
+        {
+            1 => s_key1,
+            2 => s_key2,
+            _ => throw new CryptographicException("Unknown key."),
+        };
+
+        public class Customer
+        {
+            public int Id { get; set; }
+            public string Name { get; set; } = "";
+            public string? Email { get; set; }
+            public byte[]? Notes { get; set; }
+            public AesGcmSivLazyDecrypted? TaxId { get; set; }
+        }
+
+        private sealed class CustomerContext : DbContext
+        {
+            private readonly AesGcmSivColumnEncryptor _encryptor;
+            private readonly string _database;
+
+            public CustomerContext(AesGcmSivColumnEncryptor encryptor, string database)
+            {
+                _encryptor = encryptor;
+                _database = database;
+            }
+
+            public DbSet<Customer> Customers => Set<Customer>();
+
+            protected override void OnConfiguring(DbContextOptionsBuilder optionsBuilder) =>
+                optionsBuilder.UseInMemoryDatabase(_database).UseAesGcmSivBatching();
+
+            protected override void OnModelCreating(ModelBuilder modelBuilder)
+            {
+                modelBuilder.Entity<Customer>().Property(c => c.Email!).HasAesGcmSivEncryption(_encryptor);
+                modelBuilder.Entity<Customer>().Property(c => c.Notes!).HasAesGcmSivEncryption(_encryptor);
+                modelBuilder.Entity<Customer>().Property(c => c.TaxId!).HasAesGcmSivEncryption(_encryptor);
+            }
+        }
+
+        [Fact]
+        public void EncryptPending_ShouldHandCiphertextsToConverters()
+        {
+            // Arrange
+            using var encryptor = new AesGcmSivColumnEncryptor(1, ResolveKey);
+            var values = new object[] { "alice@example.com", new byte[] { 1, 2, 3 }, "", new byte[0] };
+
+            // Act
+            encryptor.EncryptPending(values);
+            var stored = new[]
+            {
+                encryptor.TakeOrEncrypt((string)values[0]),
+                encryptor.TakeOrEncrypt((byte[])values[1]),
+                encryptor.TakeOrEncrypt((string)values[2]),
+                encryptor.TakeOrEncrypt((byte[])values[3]),
+            };
+
+            // Assert
+            Assert.Equal("alice@example.com", encryptor.DecryptString(stored[0]));
+            Assert.Equal(new byte[] { 1, 2, 3 }, encryptor.Decrypt(stored[1]));
+            Assert.Equal("", encryptor.DecryptString(stored[2]));
+            Assert.Empty(encryptor.Decrypt(stored[3]));
+            Assert.Equal(3 + AesGcmSivColumnEncryptor.Overhead, stored[1].Length);
+            Assert.NotEqual(stored[0].AsSpan(4, 12).ToArray(), stored[1].AsSpan(4, 12).ToArray());
+            // Taken once; the next call encrypts afresh
+            Assert.NotEqual(stored[1], encryptor.TakeOrEncrypt((byte[])values[1]));
+        }
+
+        [Fact]
+        public void Decrypt_AfterKeyRotation_ShouldUseStoredKeyId()
+        {
+            // Arrange
+            using var encryptor = new AesGcmSivColumnEncryptor(1, ResolveKey);
+            byte[] old = encryptor.Encrypt("before");
+
+            // Act
+            encryptor.CurrentKeyId = 2;
+            byte[] rotated = encryptor.Encrypt("after");
+
+            // Assert
+            Assert.Equal("before", encryptor.DecryptString(old));
+            Assert.Equal("after", encryptor.DecryptString(rotated));
+            Assert.Equal(2, rotated[3]);
+            rotated[^1] ^= 1;
+            Assert.ThrowsAny<CryptographicException>(() => encryptor.DecryptString(rotated));
+        }
+
+        [Fact]
+        public void SaveChanges_ShouldRoundTripEncryptedProperties()
+        {
+            // Arrange
+            using var encryptor = new AesGcmSivColumnEncryptor(1, ResolveKey);
+            string database = Guid.NewGuid().ToString();
+            using (var context = new CustomerContext(encryptor, database))
+            {
+                for (int i = 0; i < 100; i++)
+                {
+                    context.Customers.Add(new Customer
+                    {
+                        Name = $"customer {i}",
+                        Email = i % 10 == 0 ? null : $"customer{i}@example.com",
+                        Notes = new byte[i],
+                    });
+                }
+
+                // Act
+                context.SaveChanges();
+            }
+
+            // Assert
+            using (var context = new CustomerContext(encryptor, database))
+            {
+                var customers = context.Customers.OrderBy(c => c.Id).ToList();
+                Assert.Equal(100, customers.Count);
+                for (int i = 0; i < customers.Count; i++)
+                {
+                    Assert.Equal(i % 10 == 0 ? null : $"customer{i}@example.com", customers[i].Email);
+                    Assert.Equal(new byte[i], customers[i].Notes);
+                }
+
+                customers[1].Email = "changed@example.com";
+                context.SaveChanges();
+            }
+            using (var context = new CustomerContext(encryptor, database))
+            {
+                Assert.Equal("changed@example.com", context.Customers.OrderBy(c => c.Id).Skip(1).First().Email);
+            }
+        }
+
+        [Fact]
+        public void DecryptLazily_ShouldDecryptOnFirstReadAndBatchValuesReadTogether()
+        {
+            // Arrange
+            using var encryptor = new AesGcmSivColumnEncryptor(1, ResolveKey);
+            byte[] first = encryptor.Encrypt("alice@example.com");
+            byte[] second = encryptor.Encrypt(new byte[] { 1, 2, 3 });
+            encryptor.CurrentKeyId = 2;
+            byte[] third = encryptor.Encrypt(new byte[0]);
+            byte[] unread = encryptor.Encrypt("never read");
+            byte[] tampered = encryptor.Encrypt("tampered");
+            tampered[^1] ^= 1;
+
+            // Act
+            var a = encryptor.DecryptLazily(first);
+            using var b = encryptor.DecryptLazily(second);
+            using var c = encryptor.DecryptLazily(third);
+            using var d = encryptor.DecryptLazily(unread);
+            using var bad = encryptor.DecryptLazily(tampered);
+            bool decryptedOnLoad = a.IsDecrypted;
+            AesGcmSivLazyDecrypted.DecryptAll(a, b, c, null);
+
+            // Assert
+            Assert.False(decryptedOnLoad);
+            Assert.True(a.IsDecrypted && b.IsDecrypted && c.IsDecrypted);
+            Assert.False(d.IsDecrypted);
+            Assert.Equal(17, a.Length);
+            Assert.Equal("alice@example.com", a.GetString());
+            Assert.Equal(new byte[] { 1, 2, 3 }, b.ToArray());
+            Assert.True(c.Span.IsEmpty);
+            Assert.Same(second, encryptor.TakeOrEncrypt(b));
+            Assert.Equal("changed", encryptor.DecryptString(encryptor.TakeOrEncrypt(AesGcmSivLazyDecrypted.FromString("changed"))));
+            Assert.ThrowsAny<CryptographicException>(() => bad.GetString());
+            Assert.ThrowsAny<CryptographicException>(() => AesGcmSivLazyDecrypted.DecryptAll(d, bad));
+            Assert.Equal("never read", d.GetString());
+            a.Dispose();
+            Assert.Throws<ObjectDisposedException>(() => a.GetString());
+        }
+
+        [Fact]
+        public void SaveChanges_ShouldKeepUnreadLazyPropertiesAsLoaded()
+        {
+            // Arrange
+            using var encryptor = new AesGcmSivColumnEncryptor(1, ResolveKey);
+            string database = Guid.NewGuid().ToString();
+            using (var context = new CustomerContext(encryptor, database))
+            {
+                context.Customers.Add(new Customer { Name = "a", TaxId = AesGcmSivLazyDecrypted.FromString("123-45-6789") });
+                context.Customers.Add(new Customer { Name = "b", TaxId = AesGcmSivLazyDecrypted.FromString("987-65-4321") });
+                context.SaveChanges();
+            }
+
+            // Act
+            using (var context = new CustomerContext(encryptor, database))
+            {
+                var customers = context.Customers.OrderBy(c => c.Id).ToList();
+                Assert.All(customers, c => Assert.False(c.TaxId!.IsDecrypted));
+                customers[0].Name = "renamed";
+                customers[1].TaxId = AesGcmSivLazyDecrypted.FromString("000-00-0000");
+                context.SaveChanges();
+            }
+
+            // Assert
+            using (var context = new CustomerContext(encryptor, database))
+            {
+                var customers = context.Customers.OrderBy(c => c.Id).ToList();
+                AesGcmSivLazyDecrypted.DecryptAll(customers.Select(c => c.TaxId).ToArray());
+                Assert.Equal("123-45-6789", customers[0].TaxId!.GetString());
+                Assert.Equal("000-00-0000", customers[1].TaxId!.GetString());
+            }
+        }
+    }
+}
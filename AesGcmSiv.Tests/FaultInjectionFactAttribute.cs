@@ -0,0 +1,24 @@
+using Xunit;
+
+namespace AesGcmSiv.Tests
+{
+    /// <summary>
+    /// A fact that makes native allocations fail, skipped unless the library was built with
+    /// <c>-DAESGCMSIV_FAULT_INJECTION=ON</c>.
+    /// </summary>
+    public sealed class FaultInjectionFactAttribute : FactAttribute
+    {
+        public FaultInjectionFactAttribute()
+        {
+            try
+            {
+                if (NativeMethods.aesgcmsiv_debug_fail_alloc(uint.MaxValue) != NativeMethods.Success)
+                    Skip = "The native library has no fault points.";
+            }
+            catch (EntryPointNotFoundException)
+            {
+                Skip = "The native library has no fault points.";
+            }
+        }
+    }
+}
@@ -0,0 +1,73 @@
+using System.Security.Cryptography;
+using Confluent.Kafka;
+using Xunit;
+
+namespace AesGcmSiv.Tests
+{
+    /// <summary>
+    /// Tests for the Kafka record value serializer.
+    /// </summary>
+    public class KafkaTests
+    {
+        private static readonly byte[] _key = Enumerable.Range(0, 32).Select(i => (byte)(i * 9)).ToArray();
+
+        [Fact]
+        public void EncryptBatch_ShouldDecryptPerRecordAndInABatch()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_key);
+            var serializer = new AesGcmSivKafkaSerializer(aesGcmSiv);
+            var plaintexts = Enumerable.Range(0, 50).Select(i => Enumerable.Range(0, i * 7).Select(b => (byte)(b ^ i)).ToArray()).ToArray();
+            var messages = plaintexts.Select((p, i) => new Message<string, byte[]> { Key = $"k{i}", Value = i == 3 ? null! : p }).ToList();
+
+            // Act
+            serializer.EncryptBatch("orders", messages);
+            var results = messages.Select(m => new ConsumeResult<string, byte[]> { Topic = "orders", Message = new Message<string, byte[]> { Key = m.Key, Value = m.Value } }).ToList();
+            var single = serializer.Deserialize(messages[10].Value, false, new SerializationContext(MessageComponentType.Value, "orders"));
+            var succeeded = new bool[results.Count];
+            int failures = serializer.DecryptBatch(results, succeeded);
+
+            // Assert
+            Assert.Equal(0, failures);
+            Assert.Null(messages[3].Value);
+            Assert.Equal(plaintexts[10], single);
+            Assert.NotEqual(messages[0].Value.AsSpan(0, 12).ToArray(), messages[1].Value.AsSpan(0, 12).ToArray());
+            for (int i = 0; i < results.Count; i++)
+            {
+                Assert.True(succeeded[i]);
+                Assert.Equal(i == 3 ? null : plaintexts[i], results[i].Message.Value);
+            }
+        }
+
+        [Fact]
+        public void DecryptBatch_WithTamperedValueOrOtherTopic_ShouldReportFailures()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_key);
+            var serializer = new AesGcmSivKafkaSerializer(aesGcmSiv);
+            var context = new SerializationContext(MessageComponentType.Value, "payments");
+            byte[] first = serializer.Serialize(new byte[] { 1, 2, 3 }, context)!;
+            byte[] second = serializer.Serialize(new byte[] { 4, 5, 6 }, context)!;
+            second[13] ^= 1;
+            var results = new List<ConsumeResult<Ignore, byte[]>>
+            {
+                new() { Topic = "payments", Message = new Message<Ignore, byte[]> { Value = first } },
+                new() { Topic = "payments", Message = new Message<Ignore, byte[]> { Value = second } },
+                new() { Topic = "refunds", Message = new Message<Ignore, byte[]> { Value = (byte[])first.Clone() } },
+                new() { Topic = "payments", Message = new Message<Ignore, byte[]> { Value = new byte[5] } },
+            };
+            var succeeded = new bool[results.Count];
+
+            // Act
+            int failures = serializer.DecryptBatch(results, succeeded);
+
+            // Assert
+            Assert.Equal(3, failures);
+            Assert.Equal(new[] { true, false, false, false }, succeeded);
+            Assert.Equal(new byte[] { 1, 2, 3 }, results[0].Message.Value);
+            Assert.All(results.Skip(1), r => Assert.Null(r.Message.Value));
+            Assert.Throws<CryptographicException>(() =>
+                serializer.Deserialize(first, false, new SerializationContext(MessageComponentType.Value, "refunds")));
+        }
+    }
+}
@@ -0,0 +1,110 @@
+using System.Security.Cryptography;
+using Xunit;
+
+namespace AesGcmSiv.Tests
+{
+    /// <summary>
+    /// Checks every native backend this library and CPU can run against the RFC 8452 test vectors,
+    /// including the ones never chosen by default.
+    /// </summary>
+    [Collection(BackendSelectionCollection.Name)]
+    public class KnownAnswerTests
+    {
+        // Every name a backend may have; the ones this build or CPU lacks are skipped
+        private static readonly string[] Backends =
+        {
+            "vaes-avx512", "aesni", "armv8-crypto", "bitsliced-ct64", "openssl",
+        };
+
+        [Theory]
+        // RFC 8452 appendix C.1, AEAD_AES_128_GCM_SIV
+        [InlineData("01000000000000000000000000000000", "030000000000000000000000", "", "",
+            "dc20e2d83f25705bb49e439eca56de25")]
+        [InlineData("01000000000000000000000000000000", "030000000000000000000000", "", "0100000000000000",
+            "b5d839330ac7b786578782fff6013b815b287c22493a364c")]
+        [InlineData("01000000000000000000000000000000", "030000000000000000000000", "", "010000000000000000000000",
+            "7323ea61d05932260047d942a4978db357391a0bc4fdec8b0d106639")]
+        [InlineData("01000000000000000000000000000000", "030000000000000000000000", "", "01000000000000000000000000000000",
+            "743f7c8077ab25f8624e2e948579cf77303aaf90f6fe21199c6068577437a0c4")]
+        [InlineData("01000000000000000000000000000000", "030000000000000000000000", "",
+            "0100000000000000000000000000000002000000000000000000000000000000",
+            "84e07e62ba83a6585417245d7ec413a9fe427d6315c09b57ce45f2e3936a94451a8e45dcd4578c667cd86847bf6155ff")]
+        [InlineData("01000000000000000000000000000000", "030000000000000000000000", "01", "0200000000000000",
+            "1e6daba35669f4273b0a1a2560969cdf790d99759abd1508")]
+        [InlineData("01000000000000000000000000000000", "030000000000000000000000", "01", "020000000000000000000000",
+            "296c7889fd99f41917f4462008299c5102745aaa3a0c469fad9e075a")]
+        [InlineData("01000000000000000000000000000000", "030000000000000000000000", "01", "02000000000000000000000000000000",
+            "e2b0c5da79a901c1745f700525cb335b8f8936ec039e4e4bb97ebd8c4457441f")]
+        // RFC 8452 appendix C.2, AEAD_AES_256_GCM_SIV
+        [InlineData("0100000000000000000000000000000000000000000000000000000000000000", "030000000000000000000000", "", "",
+            "07f5f4169bbf55a8400cd47ea6fd400f")]
+        [InlineData("0100000000000000000000000000000000000000000000000000000000000000", "030000000000000000000000", "",
+            "0100000000000000",
+            "c2ef328e5c71c83b843122130f7364b761e0b97427e3df28")]
+        [InlineData("0100000000000000000000000000000000000000000000000000000000000000", "030000000000000000000000", "",
+            "010000000000000000000000",
+            "9aab2aeb3faa0a34aea8e2b18ca50da9ae6559e48fd10f6e5c9ca17e")]
+        [InlineData("0100000000000000000000000000000000000000000000000000000000000000", "030000000000000000000000", "",
+            "01000000000000000000000000000000",
+            "85a01b63025ba19b7fd3ddfc033b3e76c9eac6fa700942702e90862383c6c366")]
+        [InlineData("0100000000000000000000000000000000000000000000000000000000000000", "030000000000000000000000", "01",
+            "0200000000000000",
+            "1de22967237a813291213f267e3b452f02d01ae33e4ec854")]
+        public void EveryBackend_ShouldMatchRfc8452Vectors(string keyHex, string nonceHex, string aadHex, string plaintextHex, string resultHex)
+        {
+            // Arrange
+            var key = Convert.FromHexString(keyHex);
+            var nonce = Convert.FromHexString(nonceHex);
+            var aad = Convert.FromHexString(aadHex);
+            var plaintext = Convert.FromHexString(plaintextHex);
+            var result = Convert.FromHexString(resultHex);
+            var original = System.Security.Cryptography.AesGcmSiv.BackendName;
+            int checkedBackends = 0;
+
+            try
+            {
+                foreach (var backend in Backends)
+                {
+                    try
+                    {
+                        System.Security.Cryptography.AesGcmSiv.SelectBackend(backend);
+                    }
+                    catch (ArgumentException)
+                    {
+                        continue;
+                    }
+
+                    // Act - instances keep the backend they were created under
+                    System.Security.Cryptography.AesGcmSiv aesGcmSiv;
+                    try
+                    {
+                        aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(key, AesGcmSivImplementation.Native);
+                    }
+                    catch (CryptographicException) when (backend == "openssl")
+                    {
+                        // OpenSSL only has AES-GCM-SIV from 3.2 on
+                        continue;
+                    }
+                    using var disposeAesGcmSiv = aesGcmSiv;
+                    checkedBackends++;
+                    var ciphertext = new byte[plaintext.Length];
+                    var tag = new byte[16];
+                    var decrypted = new byte[plaintext.Length];
+                    aesGcmSiv.Encrypt(nonce, plaintext, ciphertext, tag, aad);
+
+                    // Assert
+                    Assert.Equal(result, ciphertext.Concat(tag).ToArray());
+                    aesGcmSiv.Decrypt(nonce, ciphertext, tag, decrypted, aad);
+                    Assert.Equal(plaintext, decrypted);
+                    tag[0] ^= 1;
+                    Assert.ThrowsAny<CryptographicException>(() => aesGcmSiv.Decrypt(nonce, ciphertext, tag, decrypted, aad));
+                }
+            }
+            finally
+            {
+                System.Security.Cryptography.AesGcmSiv.SelectBackend(original);
+            }
+            Assert.True(checkedBackends > 0);
+        }
+    }
+}
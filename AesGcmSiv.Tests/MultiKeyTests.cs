@@ -0,0 +1,137 @@
+using System.Runtime.InteropServices;
+using System.Security.Cryptography;
+using Xunit;
+using static AesGcmSiv.Tests.NativeMethods;
+
+namespace AesGcmSiv.Tests
+{
+    /// <summary>
+    /// Tests for encrypting one plaintext under many keys through the native API.
+    /// </summary>
+    public unsafe class MultiKeyTests
+    {
+        private const int NonceLength = 12;
+        private const int TagLength = 16;
+
+        private static byte[] Keys(int count, int keyLength)
+        {
+            var keys = new byte[count * keyLength];
+            for (int i = 0; i < keys.Length; i++) keys[i] = (byte)(i * 31 + 7);
+            return keys;
+        }
+
+        private static byte[] Nonces(int count)
+        {
+            var nonces = new byte[count * NonceLength];
+            for (int i = 0; i < nonces.Length; i++) nonces[i] = (byte)(i * 13);
+            return nonces;
+        }
+
+        // Encrypts plaintext for every recipient into ciphertexts, which plaintext may lie inside
+        private static int EncryptMultiKey(
+            byte[] keys, int keyLength, byte[]? nonces, byte[] plaintext, int plaintextOffset, int plaintextLength,
+            byte[]? aad, byte[][] ciphertexts, byte[] tags)
+        {
+            var handles = ciphertexts.Select(c => GCHandle.Alloc(c, GCHandleType.Pinned)).ToArray();
+            try
+            {
+                var outputs = handles.Select(h => (IntPtr)h.AddrOfPinnedObject()).ToArray();
+                fixed (byte* k = keys)
+                fixed (byte* n = nonces)
+                fixed (byte* p = plaintext)
+                fixed (byte* a = aad)
+                fixed (IntPtr* o = outputs)
+                fixed (byte* t = tags)
+                {
+                    return aesgcmsiv_encrypt_multikey((nuint)ciphertexts.Length, k, (nuint)keyLength, n,
+                        p + plaintextOffset, (nuint)plaintextLength, a, (nuint)(aad?.Length ?? 0), (byte**)o, t);
+                }
+            }
+            finally
+            {
+                foreach (var handle in handles)
+                    handle.Free();
+            }
+        }
+
+        [Theory]
+        [InlineData(16, 1, 0)]
+        [InlineData(16, 9, 100)]
+        [InlineData(32, 17, 5000)]
+        [InlineData(32, 40, 70_000)]
+        public void EncryptMultiKey_ShouldMatchEncryptPerRecipient(int keyLength, int count, int plaintextLength)
+        {
+            // Arrange
+            var keys = Keys(count, keyLength);
+            var nonces = Nonces(count);
+            var plaintext = new byte[plaintextLength];
+            for (int i = 0; i < plaintext.Length; i++) plaintext[i] = (byte)(i ^ (i >> 8));
+            var aad = new byte[] { 9, 8, 7 };
+            var ciphertexts = Enumerable.Range(0, count).Select(_ => new byte[plaintextLength]).ToArray();
+            var tags = new byte[count * TagLength];
+
+            // Act
+            int result = EncryptMultiKey(keys, keyLength, nonces, plaintext, 0, plaintextLength, aad, ciphertexts, tags);
+
+            // Assert
+            Assert.Equal(Success, result);
+            for (int i = 0; i < count; i++)
+            {
+                using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(keys.AsSpan(i * keyLength, keyLength).ToArray());
+                var expected = new byte[plaintextLength];
+                var expectedTag = new byte[TagLength];
+                aesGcmSiv.Encrypt(nonces.AsSpan(i * NonceLength, NonceLength), plaintext, expected, expectedTag, aad);
+                Assert.Equal(expected, ciphertexts[i]);
+                Assert.Equal(expectedTag, tags.AsSpan(i * TagLength, TagLength).ToArray());
+
+                var decrypted = new byte[plaintextLength];
+                aesGcmSiv.Decrypt(nonces.AsSpan(i * NonceLength, NonceLength), ciphertexts[i], tags.AsSpan(i * TagLength, TagLength), decrypted, aad);
+                Assert.Equal(plaintext, decrypted);
+            }
+        }
+
+        [Fact]
+        public void RecipientMessage_WhenTamperedOrOpenedByAnotherRecipient_ShouldNotDecrypt()
+        {
+            // Arrange
+            const int Count = 3;
+            var keys = Keys(Count, 32);
+            var nonces = Nonces(Count);
+            var plaintext = new byte[200];
+            var ciphertexts = Enumerable.Range(0, Count).Select(_ => new byte[plaintext.Length]).ToArray();
+            var tags = new byte[Count * TagLength];
+            Assert.Equal(Success, EncryptMultiKey(keys, 32, nonces, plaintext, 0, plaintext.Length, null, ciphertexts, tags));
+            using var first = new System.Security.Cryptography.AesGcmSiv(keys.AsSpan(0, 32).ToArray());
+            using var second = new System.Security.Cryptography.AesGcmSiv(keys.AsSpan(32, 32).ToArray());
+            var tampered = (byte[])ciphertexts[0].Clone();
+            tampered[150] ^= 0x04;
+            var output = new byte[plaintext.Length];
+
+            // Act & Assert
+            Assert.ThrowsAny<CryptographicException>(() =>
+                first.Decrypt(nonces.AsSpan(0, NonceLength), tampered, tags.AsSpan(0, TagLength), output));
+            Assert.ThrowsAny<CryptographicException>(() =>
+                second.Decrypt(nonces.AsSpan(0, NonceLength), ciphertexts[0], tags.AsSpan(0, TagLength), output));
+        }
+
+        [Fact]
+        public void EncryptMultiKey_WithInvalidArguments_ShouldWriteNothing()
+        {
+            // Arrange: the last output overlaps the plaintext
+            const int Count = 4;
+            var plaintext = new byte[64];
+            var shared = new byte[256];
+            var ciphertexts = Enumerable.Range(0, Count).Select(_ => new byte[plaintext.Length]).ToArray();
+            var tags = new byte[Count * TagLength];
+
+            // Act & Assert
+            Assert.Equal(InvalidKey, EncryptMultiKey(Keys(Count, 24), 24, Nonces(Count), plaintext, 0, plaintext.Length, null, ciphertexts, tags));
+            Assert.Equal(InvalidNonce, EncryptMultiKey(Keys(Count, 16), 16, null, plaintext, 0, plaintext.Length, null, ciphertexts, tags));
+            ciphertexts[Count - 1] = shared;
+            Assert.Equal(InvalidInput, EncryptMultiKey(Keys(Count, 16), 16, Nonces(Count), shared, 8, plaintext.Length, null, ciphertexts, tags));
+            Assert.True(ciphertexts.Take(Count - 1).All(c => c.All(b => b == 0)));
+            Assert.True(shared.All(b => b == 0));
+            Assert.True(tags.All(b => b == 0));
+        }
+    }
+}
@@ -0,0 +1,227 @@
+using System.Runtime.InteropServices;
+using Xunit;
+
+namespace AesGcmSiv.Tests
+{
+    /// <summary>
+    /// Native entry points the managed library does not wrap, for testing them directly against
+    /// the library the other tests load.
+    /// </summary>
+    internal static unsafe class NativeMethods
+    {
+        private const string Library = "aesgcmsiv";
+
+        public const int Success = 0;
+        public const int InvalidKey = -1;
+        public const int InvalidNonce = -2;
+        public const int InvalidInput = -3;
+        public const int DecryptFailed = -5;
+        public const int IOError = -8;
+        public const int NotFound = -9;
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_ctx_new(byte* key, nuint keyLength, IntPtr* ctx);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern void aesgcmsiv_ctx_free(IntPtr ctx);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_debug_fail_alloc(uint after);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_ctx_verify_ciphertext(
+            IntPtr ctx, byte* nonce, nuint nonceLength, byte* ciphertext, nuint ciphertextLength,
+            byte* aad, nuint aadLength, byte* tag);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_ctx_begin(IntPtr ctx, byte* nonce, nuint nonceLength, IntPtr* msg);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_ctx_aad_update(IntPtr msg, byte* aad, nuint aadLength);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_ctx_absorb_plaintext(IntPtr msg, byte* plaintext, nuint plaintextLength);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_ctx_finalize_tag(IntPtr msg, byte* tag);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_ctx_emit_ciphertext(IntPtr msg, byte* plaintext, nuint plaintextLength, byte* ciphertext);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern void aesgcmsiv_ctx_msg_free(IntPtr msg);
+
+        [StructLayout(LayoutKind.Sequential)]
+        public struct BatchItem
+        {
+            public byte* Nonce;
+            public byte* Input;
+            public nuint InputLength;
+            public byte* Aad;
+            public nuint AadLength;
+            public byte* Output;
+            public byte* Tag;
+        }
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_verify_batch(IntPtr ctx, nuint count, BatchItem* items, int* status);
+
+        [StructLayout(LayoutKind.Sequential)]
+        public struct Request
+        {
+            public IntPtr Ctx;
+            public uint Op;
+            public BatchItem Item;
+            public ulong UserData;
+        }
+
+        [StructLayout(LayoutKind.Sequential)]
+        public struct Completion
+        {
+            public ulong UserData;
+            public int Status;
+        }
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_engine_new(uint workers, nuint queueDepth, IntPtr* engine);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_engine_submit(IntPtr engine, Request* request);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_engine_reap(IntPtr engine, Completion* completions, nuint max, int wait, nuint* count);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_engine_get_notify_handle(IntPtr engine, nint* handle);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern void aesgcmsiv_engine_free(IntPtr engine);
+
+        [StructLayout(LayoutKind.Sequential)]
+        public struct Datagram
+        {
+            public byte* Data;
+            public nuint Length;
+        }
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_seal_datagrams(IntPtr ctx, nuint count, Datagram* datagrams, nuint headerLength);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_open_datagrams(
+            IntPtr ctx, nuint count, Datagram* datagrams, nuint headerLength, int* status);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_encrypt_multikey(
+            nuint count, byte* keys, nuint keyLength, byte* nonces, byte* plaintext, nuint plaintextLength,
+            byte* aad, nuint aadLength, byte** ciphertexts, byte* tags);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_key_table_new_shared(nuint slots, IntPtr* table);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_key_table_seal(IntPtr table);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_key_table_set(IntPtr table, nuint slot, byte* key, nuint keyLength);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_key_table_clear(IntPtr table, nuint slot);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_key_table_encrypt_batch(IntPtr table, nuint count, BatchItem* items, uint* slots);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_key_table_decrypt_batch(
+            IntPtr table, nuint count, BatchItem* items, uint* slots, int* status);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern void aesgcmsiv_key_table_free(IntPtr table);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_polyval_init(byte* key, nuint keyLength, IntPtr* state);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_polyval_update(IntPtr state, byte* data, nuint length);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_polyval_final(IntPtr state, byte* hash);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern void aesgcmsiv_polyval_free(IntPtr state);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_stream_open_new(IntPtr ctx, byte* header, IntPtr* stream);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern void aesgcmsiv_stream_free(IntPtr stream);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_stream_seal_file(
+            IntPtr ctx, [MarshalAs(UnmanagedType.LPUTF8Str)] string inputPath,
+            [MarshalAs(UnmanagedType.LPUTF8Str)] string outputPath, uint chunkSize, byte* aad, nuint aadLength);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_stream_verify_chunks(
+            IntPtr stream, ulong first, nuint count, byte* sealedChunks, nuint sealedLength, byte* aad, nuint aadLength,
+            int last, int* status);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_stream_scrub_file(
+            IntPtr ctx, [MarshalAs(UnmanagedType.LPUTF8Str)] string inputPath, byte* aad, nuint aadLength,
+            ulong maxBytesPerSecond, delegate* unmanaged[Cdecl]<IntPtr, ulong, ulong, int, void> callback, IntPtr user,
+            ulong* corrupt);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_pack_write_file(
+            IntPtr ctx, [MarshalAs(UnmanagedType.LPUTF8Str)] string outputPath, nuint idSize, nuint count,
+            byte* ids, byte** blobs, nuint* blobLengths);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_pack_open([MarshalAs(UnmanagedType.LPUTF8Str)] string inputPath, IntPtr* pack);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern ulong aesgcmsiv_pack_count(IntPtr pack);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern nuint aesgcmsiv_pack_id_size(IntPtr pack);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_pack_find(IntPtr pack, byte* id, nuint* length);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_pack_read_batch(
+            IntPtr ctx, IntPtr pack, nuint count, byte* ids, byte** outputs, nuint* outputLengths,
+            nuint* lengths, int* status);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern int aesgcmsiv_pack_scrub(
+            IntPtr ctx, IntPtr pack, ulong maxBytesPerSecond, delegate* unmanaged[Cdecl]<IntPtr, ulong, ulong, int, void> callback,
+            IntPtr user, ulong* corrupt);
+
+        [DllImport(Library, ExactSpelling = true)]
+        public static extern void aesgcmsiv_pack_free(IntPtr pack);
+
+        /// <summary>
+        /// A native key context under <paramref name="key"/>, freed on dispose.
+        /// </summary>
+        public sealed class Context : IDisposable
+        {
+            public Context(byte[] key)
+            {
+                IntPtr ctx;
+                fixed (byte* k = key)
+                    Assert.Equal(Success, aesgcmsiv_ctx_new(k, (nuint)key.Length, &ctx));
+                Handle = ctx;
+            }
+
+            public IntPtr Handle { get; private set; }
+
+            public void Dispose()
+            {
+                aesgcmsiv_ctx_free(Handle);
+                Handle = IntPtr.Zero;
+            }
+        }
+    }
+}
@@ -0,0 +1,184 @@
+using System.Runtime.InteropServices;
+using Xunit;
+using static AesGcmSiv.Tests.NativeMethods;
+
+namespace AesGcmSiv.Tests
+{
+    /// <summary>
+    /// Tests for an engine's pollable completion handle, through the native API.
+    /// </summary>
+    public unsafe class NotifyHandleTests : IDisposable
+    {
+        private const int Count = 40;
+        private const int Length = 300;
+        private const int ReapMax = 8;
+
+        [StructLayout(LayoutKind.Sequential)]
+        private struct PollFd
+        {
+            public int Fd;
+            public short Events;
+            public short Revents;
+        }
+
+        [DllImport("libc", EntryPoint = "poll")]
+        private static extern int Poll(PollFd* fds, nuint count, int timeoutMilliseconds);
+
+        [DllImport("kernel32", EntryPoint = "WaitForSingleObject")]
+        private static extern uint WaitForSingleObject(nint handle, uint timeoutMilliseconds);
+
+        private readonly Context _ctx;
+        private readonly IntPtr _engine;
+
+        // Per message: nonce, input, output and tag, in memory that stays put while requests run
+        private readonly byte* _nonces;
+        private readonly byte* _inputs;
+        private readonly byte* _outputs;
+        private readonly byte* _tags;
+
+        public NotifyHandleTests()
+        {
+            _ctx = new Context(Enumerable.Range(0, 32).Select(i => (byte)(i + 100)).ToArray());
+            IntPtr engine;
+            Assert.Equal(Success, aesgcmsiv_engine_new(2, 64, &engine));
+            _engine = engine;
+            _nonces = (byte*)NativeMemory.AllocZeroed(Count * 12);
+            _inputs = (byte*)NativeMemory.AllocZeroed(Count * Length);
+            _outputs = (byte*)NativeMemory.AllocZeroed(Count * Length);
+            _tags = (byte*)NativeMemory.AllocZeroed(Count * 16);
+            for (int i = 0; i < Count; i++)
+            {
+                _nonces[i * 12] = (byte)i;
+                for (int j = 0; j < Length; j++) _inputs[i * Length + j] = (byte)(i + j);
+            }
+        }
+
+        public void Dispose()
+        {
+            aesgcmsiv_engine_free(_engine);
+            _ctx.Dispose();
+            NativeMemory.Free(_nonces);
+            NativeMemory.Free(_inputs);
+            NativeMemory.Free(_outputs);
+            NativeMemory.Free(_tags);
+        }
+
+        // Whether the handle is readable or signaled within timeoutMilliseconds
+        private static bool IsRaised(nint handle, int timeoutMilliseconds)
+        {
+            if (OperatingSystem.IsWindows())
+                return WaitForSingleObject(handle, (uint)timeoutMilliseconds) == 0;
+            var fd = new PollFd { Fd = (int)handle, Events = 1 };
+            return Poll(&fd, 1, timeoutMilliseconds) == 1 && (fd.Revents & 1) != 0;
+        }
+
+        private nint NotifyHandle()
+        {
+            nint handle;
+            Assert.Equal(Success, aesgcmsiv_engine_get_notify_handle(_engine, &handle));
+            return handle;
+        }
+
+        private int Submit(int i, uint op, byte* input, byte* output, bool withNonce = true)
+        {
+            var request = new Request
+            {
+                Ctx = _ctx.Handle,
+                Op = op,
+                UserData = (ulong)i,
+                Item = new BatchItem
+                {
+                    Nonce = withNonce ? _nonces + i * 12 : null,
+                    Input = input + i * Length,
+                    InputLength = Length,
+                    Output = output + i * Length,
+                    Tag = _tags + i * 16,
+                },
+            };
+            return aesgcmsiv_engine_submit(_engine, &request);
+        }
+
+        // Waits on the handle and reaps without waiting, as an event loop would, until
+        // count completions are in
+        private Dictionary<ulong, int> ReapFromLoop(nint handle, int count)
+        {
+            var results = new Dictionary<ulong, int>();
+            var completions = new Completion[ReapMax];
+            while (results.Count < count)
+            {
+                Assert.True(IsRaised(handle, 10_000));
+                nuint reaped;
+                do
+                {
+                    fixed (Completion* c = completions)
+                        Assert.Equal(Success, aesgcmsiv_engine_reap(_engine, c, ReapMax, 0, &reaped));
+                    for (int i = 0; i < (int)reaped; i++)
+                        results.Add(completions[i].UserData, completions[i].Status);
+                } while (reaped == ReapMax);
+            }
+            return results;
+        }
+
+        [Fact]
+        public void Handle_ShouldBeRaisedWhileCompletionsWait()
+        {
+            // Arrange
+            nint handle = NotifyHandle();
+            Assert.False(IsRaised(handle, 0));
+
+            // Act: seal, then open into the inputs, every completion reaped from the handle
+            for (int i = 0; i < Count; i++)
+                Assert.Equal(Success, Submit(i, 0, _inputs, _outputs));
+            var sealedResults = ReapFromLoop(handle, Count);
+            bool raisedAfterSealing = IsRaised(handle, 0);
+            new Span<byte>(_inputs, Count * Length).Clear();
+            for (int i = 0; i < Count; i++)
+                Assert.Equal(Success, Submit(i, 1, _outputs, _inputs));
+            var openedResults = ReapFromLoop(handle, Count);
+
+            // Assert
+            Assert.Equal(handle, NotifyHandle());
+            Assert.Equal(Count, sealedResults.Count);
+            Assert.True(sealedResults.Values.All(status => status == Success));
+            Assert.False(raisedAfterSealing);
+            Assert.True(openedResults.Values.All(status => status == Success));
+            Assert.False(IsRaised(handle, 0));
+            for (int i = 0; i < Count; i++)
+                for (int j = 0; j < Length; j++)
+                    Assert.Equal((byte)(i + j), _inputs[i * Length + j]);
+        }
+
+        [Fact]
+        public void Handle_ShouldCarryFailedDecryptions()
+        {
+            // Arrange
+            nint handle = NotifyHandle();
+            Assert.Equal(Success, Submit(0, 0, _inputs, _outputs));
+            Assert.Equal(Success, Submit(1, 0, _inputs, _outputs));
+            ReapFromLoop(handle, 2);
+            _outputs[Length + 9] ^= 0x02;
+
+            // Act
+            Assert.Equal(Success, Submit(0, 1, _outputs, _inputs));
+            Assert.Equal(Success, Submit(1, 1, _outputs, _inputs));
+            var results = ReapFromLoop(handle, 2);
+
+            // Assert
+            Assert.Equal(Success, results[0]);
+            Assert.Equal(DecryptFailed, results[1]);
+            Assert.True(new Span<byte>(_inputs + Length, Length).ToArray().All(b => b == 0));
+            Assert.False(IsRaised(handle, 0));
+        }
+
+        [Fact]
+        public void NotifyHandle_WithInvalidArguments_ShouldFail()
+        {
+            nint handle = NotifyHandle();
+
+            Assert.Equal(InvalidInput, aesgcmsiv_engine_get_notify_handle(IntPtr.Zero, &handle));
+            Assert.Equal(InvalidInput, aesgcmsiv_engine_get_notify_handle(_engine, null));
+            Assert.Equal(InvalidNonce, Submit(0, 0, _inputs, _outputs, withNonce: false));
+            Assert.False(IsRaised(handle, 50));
+        }
+    }
+}
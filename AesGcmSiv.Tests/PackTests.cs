@@ -0,0 +1,257 @@
+using Xunit;
+using static AesGcmSiv.Tests.NativeMethods;
+
+namespace AesGcmSiv.Tests
+{
+    /// <summary>
+    /// Tests for pack files, written and read through the native API.
+    /// </summary>
+    public unsafe class PackTests : IDisposable
+    {
+        private const int IdSize = 8;
+        private const int BlobCount = 50;
+
+        private readonly byte[] _key;
+        private readonly string _path;
+
+        public PackTests()
+        {
+            _key = new byte[32];
+            for (int i = 0; i < _key.Length; i++) _key[i] = (byte)(i + 3);
+            _path = Path.Combine(Path.GetTempPath(), $"aesgcmsiv-pack-{Guid.NewGuid():N}.pack");
+        }
+
+        public void Dispose()
+        {
+            File.Delete(_path);
+        }
+
+        private static byte[] Id(int i)
+        {
+            var id = new byte[IdSize];
+            BitConverter.TryWriteBytes(id, (long)i * 7919);
+            return id;
+        }
+
+        private static byte[] Blob(int i)
+        {
+            var blob = new byte[i * 13];
+            for (int j = 0; j < blob.Length; j++) blob[j] = (byte)(i + j * 5);
+            return blob;
+        }
+
+        internal static int WritePack(Context ctx, string path, int idSize, byte[][] ids, byte[][] blobs)
+        {
+            var flatIds = ids.SelectMany(id => id).ToArray();
+            var data = blobs.SelectMany(blob => blob).ToArray();
+            var pointers = new byte*[blobs.Length];
+            var lengths = new nuint[blobs.Length];
+            fixed (byte* i = flatIds)
+            fixed (byte* d = data)
+            fixed (byte** p = pointers)
+            fixed (nuint* l = lengths)
+            {
+                for (int k = 0, offset = 0; k < blobs.Length; offset += blobs[k].Length, k++)
+                {
+                    p[k] = d + offset;
+                    l[k] = (nuint)blobs[k].Length;
+                }
+                return aesgcmsiv_pack_write_file(ctx.Handle, path, (nuint)idSize, (nuint)blobs.Length, i, p, l);
+            }
+        }
+
+        // Reads ids with one buffer per id of the given size, returning the call's result
+        private static int ReadBatch(
+            Context ctx, IntPtr pack, byte[][] ids, int[] bufferSizes, byte[][] outputs, nuint[] lengths, int[] status)
+        {
+            var flatIds = ids.SelectMany(id => id).ToArray();
+            var buffer = new byte[bufferSizes.Sum()];
+            var pointers = new byte*[ids.Length];
+            var sizes = bufferSizes.Select(size => (nuint)size).ToArray();
+            int result;
+            fixed (byte* i = flatIds)
+            fixed (byte* b = buffer)
+            fixed (byte** p = pointers)
+            fixed (nuint* s = sizes)
+            fixed (nuint* l = lengths)
+            fixed (int* st = status)
+            {
+                for (int k = 0, offset = 0; k < ids.Length; offset += bufferSizes[k], k++)
+                    p[k] = b + offset;
+                result = aesgcmsiv_pack_read_batch(ctx.Handle, pack, (nuint)ids.Length, i, p, s, l, st);
+            }
+            for (int k = 0, offset = 0; k < ids.Length; offset += bufferSizes[k], k++)
+                outputs[k] = buffer.AsSpan(offset, bufferSizes[k]).ToArray();
+            return result;
+        }
+
+        private static IntPtr Open(string path)
+        {
+            IntPtr pack;
+            Assert.Equal(Success, aesgcmsiv_pack_open(path, &pack));
+            return pack;
+        }
+
+        [Fact]
+        public void WriteAndRead_ShouldRoundTripEveryBlob()
+        {
+            // Arrange: given out of id order, with an empty blob
+            using var ctx = new Context(_key);
+            var order = Enumerable.Range(0, BlobCount).Reverse().ToArray();
+            Assert.Equal(Success, WritePack(ctx, _path, IdSize,
+                order.Select(Id).ToArray(), order.Select(Blob).ToArray()));
+            IntPtr pack = Open(_path);
+            try
+            {
+                // Act
+                var ids = Enumerable.Range(0, BlobCount).Select(Id).ToArray();
+                var outputs = new byte[BlobCount][];
+                var lengths = new nuint[BlobCount];
+                var status = new int[BlobCount];
+                int result = ReadBatch(ctx, pack, ids, ids.Select((_, i) => Blob(i).Length).ToArray(), outputs, lengths, status);
+
+                // Assert
+                Assert.Equal(Success, result);
+                Assert.Equal((ulong)BlobCount, aesgcmsiv_pack_count(pack));
+                Assert.Equal((nuint)IdSize, aesgcmsiv_pack_id_size(pack));
+                for (int i = 0; i < BlobCount; i++)
+                {
+                    nuint length;
+                    fixed (byte* id = ids[i])
+                        Assert.Equal(Success, aesgcmsiv_pack_find(pack, id, &length));
+                    Assert.Equal((nuint)Blob(i).Length, length);
+                    Assert.Equal(Success, status[i]);
+                    Assert.Equal(length, lengths[i]);
+                    Assert.Equal(Blob(i), outputs[i]);
+                }
+                Assert.True(File.ReadAllBytes(_path).AsSpan().IndexOf(Blob(BlobCount - 1).AsSpan(0, 64)) < 0);
+            }
+            finally
+            {
+                aesgcmsiv_pack_free(pack);
+            }
+        }
+
+        [Fact]
+        public void TamperedBlob_ShouldFailOnlyThatBlob()
+        {
+            // Arrange: flip a bit in the last blob's tag
+            using var ctx = new Context(_key);
+            Assert.Equal(Success, WritePack(ctx, _path, IdSize,
+                Enumerable.Range(0, BlobCount).Select(Id).ToArray(), Enumerable.Range(0, BlobCount).Select(Blob).ToArray()));
+            var file = File.ReadAllBytes(_path);
+            file[^1] ^= 0x01;
+            File.WriteAllBytes(_path, file);
+            IntPtr pack = Open(_path);
+            try
+            {
+                // Act
+                var ids = Enumerable.Range(0, BlobCount).Select(Id).ToArray();
+                var outputs = new byte[BlobCount][];
+                var status = new int[BlobCount];
+                int result = ReadBatch(ctx, pack, ids, ids.Select((_, i) => Blob(i).Length).ToArray(), outputs, new nuint[BlobCount], status);
+
+                // Assert
+                Assert.Equal(DecryptFailed, result);
+                Assert.Equal(1, status.Count(s => s == DecryptFailed));
+                for (int i = 0; i < BlobCount; i++)
+                {
+                    if (status[i] == DecryptFailed)
+                        Assert.True(outputs[i].All(b => b == 0));
+                    else
+                        Assert.Equal(Blob(i), outputs[i]);
+                }
+            }
+            finally
+            {
+                aesgcmsiv_pack_free(pack);
+            }
+        }
+
+        [Fact]
+        public void ReadUnderAnotherKey_ShouldFailEveryBlob()
+        {
+            // Arrange
+            using (var ctx = new Context(_key))
+                Assert.Equal(Success, WritePack(ctx, _path, IdSize, new[] { Id(1), Id(2) }, new[] { Blob(1), Blob(2) }));
+            var otherKey = (byte[])_key.Clone();
+            otherKey[0] ^= 0xFF;
+            using var other = new Context(otherKey);
+            IntPtr pack = Open(_path);
+            try
+            {
+                // Act
+                var status = new int[2];
+                int result = ReadBatch(other, pack, new[] { Id(1), Id(2) }, new[] { Blob(1).Length, Blob(2).Length },
+                    new byte[2][], new nuint[2], status);
+
+                // Assert
+                Assert.Equal(DecryptFailed, result);
+                Assert.Equal(new[] { DecryptFailed, DecryptFailed }, status);
+            }
+            finally
+            {
+                aesgcmsiv_pack_free(pack);
+            }
+        }
+
+        [Fact]
+        public void Write_WithInvalidArguments_ShouldFailWithoutLeavingAFile()
+        {
+            using var ctx = new Context(_key);
+
+            Assert.Equal(InvalidInput, WritePack(ctx, _path, IdSize, new[] { Id(1), Id(1) }, new[] { Blob(1), Blob(2) }));
+            Assert.False(File.Exists(_path));
+            Assert.Equal(InvalidInput, WritePack(ctx, _path, 0, new[] { Array.Empty<byte>() }, new[] { Blob(1) }));
+            Assert.Equal(InvalidInput, WritePack(ctx, _path, 65, new[] { new byte[65] }, new[] { Blob(1) }));
+            Assert.False(File.Exists(_path));
+        }
+
+        [Fact]
+        public void Read_WithUnknownIdOrShortBuffer_ShouldReportEachId()
+        {
+            // Arrange
+            using var ctx = new Context(_key);
+            Assert.Equal(Success, WritePack(ctx, _path, IdSize, new[] { Id(1), Id(2) }, new[] { Blob(1), Blob(2) }));
+            IntPtr pack = Open(_path);
+            try
+            {
+                // Act
+                var lengths = new nuint[3];
+                var status = new int[3];
+                var outputs = new byte[3][];
+                int result = ReadBatch(ctx, pack, new[] { Id(1), Id(3), Id(2) }, new[] { Blob(1).Length, 64, Blob(2).Length - 1 },
+                    outputs, lengths, status);
+                nuint length;
+                int found;
+                fixed (byte* id = Id(3))
+                    found = aesgcmsiv_pack_find(pack, id, &length);
+
+                // Assert
+                Assert.Equal(NotFound, result);
+                Assert.Equal(new[] { Success, NotFound, InvalidInput }, status);
+                Assert.Equal(Blob(1), outputs[0]);
+                Assert.Equal((nuint)Blob(2).Length, lengths[2]);
+                Assert.Equal(NotFound, found);
+            }
+            finally
+            {
+                aesgcmsiv_pack_free(pack);
+            }
+        }
+
+        [Fact]
+        public void Open_WithoutPackHeader_ShouldFail()
+        {
+            // Arrange
+            File.WriteAllBytes(_path, new byte[256]);
+
+            // Act
+            IntPtr pack;
+            int result = aesgcmsiv_pack_open(_path, &pack);
+
+            // Assert
+            Assert.Equal(InvalidInput, result);
+        }
+    }
+}
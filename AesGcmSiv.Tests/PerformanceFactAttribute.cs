@@ -0,0 +1,19 @@
+using Xunit;
+
+namespace AesGcmSiv.Tests
+{
+    /// <summary>
+    /// A fact that times the library, skipped when the <c>AESGCMSIV_SKIP_PERF_TESTS</c> environment
+    /// variable is set, for machines too noisy to hold even a generous budget.
+    /// </summary>
+    public sealed class PerformanceFactAttribute : FactAttribute
+    {
+        public const string SkipVariable = "AESGCMSIV_SKIP_PERF_TESTS";
+
+        public PerformanceFactAttribute()
+        {
+            if (!string.IsNullOrEmpty(Environment.GetEnvironmentVariable(SkipVariable)))
+                Skip = $"{SkipVariable} is set.";
+        }
+    }
+}
@@ -0,0 +1,123 @@
+using System.Diagnostics;
+using System.Security.Cryptography;
+using Xunit;
+
+namespace AesGcmSiv.Tests
+{
+    /// <summary>
+    /// Smoke tests that catch gross slowdowns, such as every call getting ten times slower, before
+    /// they reach the benchmarks. Budgets are several times what a healthy host needs, and each
+    /// takes the fastest of a few rounds, so they hold on a loaded machine; filter out
+    /// <c>Category=Performance</c> or set <c>AESGCMSIV_SKIP_PERF_TESTS</c> where they do not.
+    /// </summary>
+    [Trait("Category", "Performance")]
+    [Collection(SteadyStateCollection.Name)]
+    public class PerformanceTests
+    {
+        private const int Rounds = 5;
+        private const int WarmupIterations = 200;
+
+        // Per 1 KB encrypt. The hand-written kernels and OpenSSL on AES-NI take
+        // around a microsecond; the constant-time bitsliced fallback some tens
+        private static readonly TimeSpan HardwareBudget = TimeSpan.FromMicroseconds(20);
+        private static readonly TimeSpan SoftwareBudget = TimeSpan.FromMicroseconds(400);
+
+        private static readonly string[] HardwareBackends = { "vaes-avx512", "aesni", "armv8-crypto" };
+
+        private readonly byte[] _key;
+        private readonly byte[] _nonce = new byte[12];
+
+        public PerformanceTests()
+        {
+            _key = new byte[32];
+            for (int i = 0; i < _key.Length; i++) _key[i] = (byte)i;
+        }
+
+        [PerformanceFact]
+        public void WarmEncrypt1KB_ShouldStayWithinBudgetWithoutAllocating()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_key);
+            var plaintext = new byte[1024];
+            var ciphertext = new byte[plaintext.Length];
+            var tag = new byte[16];
+            const int Iterations = 2000;
+            TimeSpan budget = Array.IndexOf(HardwareBackends, System.Security.Cryptography.AesGcmSiv.BackendName) >= 0
+                ? HardwareBudget
+                : SoftwareBudget;
+
+            void Run(int count)
+            {
+                for (int i = 0; i < count; i++)
+                {
+                    _nonce[0] = (byte)i;
+                    aesGcmSiv.Encrypt(_nonce, plaintext.AsSpan(), ciphertext.AsSpan(), tag.AsSpan());
+                }
+            }
+
+            Run(WarmupIterations);
+            Action round = () => Run(Iterations);
+
+            // Act
+            long before = GC.GetAllocatedBytesForCurrentThread();
+            TimeSpan perCall = FastestRound(round) / Iterations;
+            long allocated = GC.GetAllocatedBytesForCurrentThread() - before;
+
+            // Assert
+            Assert.True(perCall <= budget,
+                $"1 KB encrypt took {perCall.TotalMicroseconds:F2} us on {System.Security.Cryptography.AesGcmSiv.BackendName}; budget {budget.TotalMicroseconds} us");
+            Assert.Equal(0, allocated);
+        }
+
+        [PerformanceFact]
+        public void ReusedInstance_ShouldBeFasterThanAnInstancePerCall()
+        {
+            // Arrange
+            using var reused = new System.Security.Cryptography.AesGcmSiv(_key);
+            var plaintext = new byte[64];
+            var ciphertext = new byte[plaintext.Length];
+            var tag = new byte[16];
+            const int Iterations = 1000;
+
+            void RunReused(int count)
+            {
+                for (int i = 0; i < count; i++)
+                    reused.Encrypt(_nonce, plaintext.AsSpan(), ciphertext.AsSpan(), tag.AsSpan());
+            }
+
+            void RunPerCall(int count)
+            {
+                for (int i = 0; i < count; i++)
+                {
+                    using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_key);
+                    aesGcmSiv.Encrypt(_nonce, plaintext.AsSpan(), ciphertext.AsSpan(), tag.AsSpan());
+                }
+            }
+
+            RunReused(WarmupIterations);
+            RunPerCall(WarmupIterations);
+
+            // Act
+            TimeSpan reusedTime = FastestRound(() => RunReused(Iterations));
+            TimeSpan perCallTime = FastestRound(() => RunPerCall(Iterations));
+
+            // Assert - expanding the key and allocating a context cost more than a short message
+            Assert.True(reusedTime < perCallTime,
+                $"Reused instance took {reusedTime.TotalMilliseconds:F2} ms, an instance per call {perCallTime.TotalMilliseconds:F2} ms");
+        }
+
+        private static TimeSpan FastestRound(Action round)
+        {
+            TimeSpan fastest = TimeSpan.MaxValue;
+            for (int i = 0; i < Rounds; i++)
+            {
+                long start = Stopwatch.GetTimestamp();
+                round();
+                TimeSpan elapsed = Stopwatch.GetElapsedTime(start);
+                if (elapsed < fastest)
+                    fastest = elapsed;
+            }
+            return fastest;
+        }
+    }
+}
@@ -0,0 +1,173 @@
+using System.Buffers.Binary;
+using Xunit;
+using static AesGcmSiv.Tests.NativeMethods;
+
+namespace AesGcmSiv.Tests
+{
+    /// <summary>
+    /// Tests for the standalone POLYVAL hash, through the native API.
+    /// </summary>
+    public unsafe class PolyvalTests
+    {
+        private static IntPtr Init(byte[] key)
+        {
+            IntPtr state;
+            fixed (byte* k = key)
+                Assert.Equal(Success, aesgcmsiv_polyval_init(k, (nuint)key.Length, &state));
+            return state;
+        }
+
+        private static void Update(IntPtr state, ReadOnlySpan<byte> data)
+        {
+            fixed (byte* d = data)
+                Assert.Equal(Success, aesgcmsiv_polyval_update(state, d, (nuint)data.Length));
+        }
+
+        private static byte[] Final(IntPtr state)
+        {
+            var hash = new byte[16];
+            fixed (byte* h = hash)
+                Assert.Equal(Success, aesgcmsiv_polyval_final(state, h));
+            return hash;
+        }
+
+        private static byte[] Hash(byte[] key, byte[] data)
+        {
+            IntPtr state = Init(key);
+            try
+            {
+                Update(state, data);
+                return Final(state);
+            }
+            finally
+            {
+                aesgcmsiv_polyval_free(state);
+            }
+        }
+
+        // RFC 8452 section 3, a bit at a time: each block is added in and the
+        // sum multiplied by H and x^-128, as sum(b_i * H * x^(i - 128))
+        private static byte[] ReferenceHash(byte[] key, byte[] data)
+        {
+            UInt128 h = BinaryPrimitives.ReadUInt128LittleEndian(key);
+            UInt128 reduction = (UInt128)0xE1 << 120;
+            UInt128 s = 0;
+            var padded = new byte[(data.Length + 15) / 16 * 16];
+            data.CopyTo(padded, 0);
+            for (int offset = 0; offset < padded.Length; offset += 16)
+            {
+                UInt128 b = s ^ BinaryPrimitives.ReadUInt128LittleEndian(padded.AsSpan(offset));
+                UInt128 r = 0;
+                for (int i = 0; i < 128; i++)
+                {
+                    if (((b >> i) & 1) != 0)
+                        r ^= h;
+                    r = (r & 1) != 0 ? (r >> 1) ^ reduction : r >> 1;
+                }
+                s = r;
+            }
+            var hash = new byte[16];
+            BinaryPrimitives.WriteUInt128LittleEndian(hash, s);
+            return hash;
+        }
+
+        [Fact]
+        public void Hash_ShouldMatchRfc8452Vector()
+        {
+            // RFC 8452 appendix A
+            var key = Convert.FromHexString("25629347589242761d31f826ba4b757b");
+            var data = Convert.FromHexString("4f4f95668c83dfb6401762bb2d01a262d1a24ddd2721d006bbe45f20d3c9f362");
+
+            var hash = Hash(key, data);
+
+            Assert.Equal(Convert.FromHexString("f7a3b47b846119fae5b7866cf5e5b77e"), hash);
+            Assert.Equal(hash, ReferenceHash(key, data));
+        }
+
+        [Theory]
+        [InlineData(0)]
+        [InlineData(1)]
+        [InlineData(16)]
+        [InlineData(100)]
+        [InlineData(255)]
+        [InlineData(4096)]
+        [InlineData(10_007)]
+        public void Hash_InPieces_ShouldMatchReference(int length)
+        {
+            // Arrange
+            var key = Enumerable.Range(0, 16).Select(i => (byte)(i * 29 + length)).ToArray();
+            var data = Enumerable.Range(0, length).Select(i => (byte)(i * 7 ^ i >> 5)).ToArray();
+            IntPtr state = Init(key);
+            try
+            {
+                // Act: pieces of uneven lengths, then the same input again on the restarted state
+                for (int offset = 0, piece = 1; offset < length; offset += piece, piece = piece * 3 % 61 + 1)
+                    Update(state, data.AsSpan(offset, Math.Min(piece, length - offset)));
+                var hash = Final(state);
+                Update(state, data);
+                var again = Final(state);
+
+                // Assert
+                Assert.Equal(ReferenceHash(key, data), hash);
+                Assert.Equal(hash, again);
+            }
+            finally
+            {
+                aesgcmsiv_polyval_free(state);
+            }
+        }
+
+        [Fact]
+        public void Hash_OfChangedInputOrUnderAnotherKey_ShouldDiffer()
+        {
+            // Arrange
+            var key = Enumerable.Range(1, 16).Select(i => (byte)i).ToArray();
+            var data = Enumerable.Range(0, 300).Select(i => (byte)i).ToArray();
+            var hash = Hash(key, data);
+            var otherKey = (byte[])key.Clone();
+            otherKey[15] ^= 0x80;
+
+            // Act & Assert
+            for (int i = 0; i < data.Length; i += 37)
+            {
+                var changed = (byte[])data.Clone();
+                changed[i] ^= 0x01;
+                Assert.NotEqual(hash, Hash(key, changed));
+            }
+            Assert.NotEqual(hash, Hash(otherKey, data));
+        }
+
+        [Fact]
+        public void Polyval_WithInvalidArguments_ShouldFail()
+        {
+            // Arrange
+            IntPtr state;
+            var key = new byte[17];
+            var hash = new byte[16];
+
+            // Act & Assert
+            fixed (byte* k = key)
+            {
+                Assert.Equal(InvalidKey, aesgcmsiv_polyval_init(k, 15, &state));
+                Assert.Equal(InvalidKey, aesgcmsiv_polyval_init(k, 17, &state));
+            }
+            Assert.Equal(InvalidKey, aesgcmsiv_polyval_init(null, 16, &state));
+            state = Init(new byte[16]);
+            try
+            {
+                fixed (byte* h = hash)
+                {
+                    Assert.Equal(InvalidInput, aesgcmsiv_polyval_update(state, null, 1));
+                    Assert.Equal(InvalidInput, aesgcmsiv_polyval_update(IntPtr.Zero, h, 1));
+                    Assert.Equal(InvalidInput, aesgcmsiv_polyval_final(IntPtr.Zero, h));
+                }
+                Assert.Equal(InvalidInput, aesgcmsiv_polyval_final(state, null));
+                Assert.Equal(Success, aesgcmsiv_polyval_update(state, null, 0));
+            }
+            finally
+            {
+                aesgcmsiv_polyval_free(state);
+            }
+        }
+    }
+}
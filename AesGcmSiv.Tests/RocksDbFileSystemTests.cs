@@ -0,0 +1,199 @@
+using System.Runtime.InteropServices;
+using Xunit;
+using static AesGcmSiv.Tests.NativeMethods;
+
+namespace AesGcmSiv.Tests
+{
+    /// <summary>
+    /// A fact that needs the aesgcmsiv_rocksdb module (built with <c>-DAESGCMSIV_ROCKSDB=ON</c>) beside
+    /// the tests, skipped when it cannot be loaded.
+    /// </summary>
+    public sealed class RocksDbFactAttribute : FactAttribute
+    {
+        public RocksDbFactAttribute()
+        {
+            // The module needs the library loaded ahead of it
+            var assembly = typeof(RocksDbFactAttribute).Assembly;
+            if (!NativeLibrary.TryLoad("aesgcmsiv", assembly, null, out _)
+                || !NativeLibrary.TryLoad("aesgcmsiv_rocksdb", assembly, null, out _))
+                Skip = "aesgcmsiv_rocksdb cannot be loaded.";
+        }
+    }
+
+    /// <summary>
+    /// Tests for the RocksDB file system, through the module's C entry points.
+    /// </summary>
+    public unsafe class RocksDbFileSystemTests : IDisposable
+    {
+        private const string Module = "aesgcmsiv_rocksdb";
+        private const int HeaderSize = 12;
+        private const uint ChunkSize = 4096;
+        private const int SealedChunkSize = (int)ChunkSize + 16;
+
+        [DllImport(Module, ExactSpelling = true)]
+        private static extern int aesgcmsiv_rocksdb_write_file(
+            [MarshalAs(UnmanagedType.LPUTF8Str)] string? path, byte* key, nuint keyLength, uint chunkSize,
+            byte* data, nuint dataLength);
+
+        [DllImport(Module, ExactSpelling = true)]
+        private static extern int aesgcmsiv_rocksdb_read_file(
+            [MarshalAs(UnmanagedType.LPUTF8Str)] string? path, byte* key, nuint keyLength, uint chunkSize,
+            ulong offset, byte* output, nuint length, nuint* read);
+
+        private readonly byte[] _key;
+        private readonly string _path;
+
+        public RocksDbFileSystemTests()
+        {
+            _key = Enumerable.Range(0, 32).Select(i => (byte)(0x80 ^ i * 3)).ToArray();
+            _path = Path.Combine(Path.GetTempPath(), $"aesgcmsiv-rocksdb-{Guid.NewGuid():N}.sst");
+        }
+
+        public void Dispose()
+        {
+            File.Delete(_path);
+        }
+
+        private static byte[] Data(int length) => Enumerable.Range(0, length).Select(i => (byte)(i * 7 ^ i >> 9)).ToArray();
+
+        private int Write(byte[] data, byte[]? key = null, uint chunkSize = ChunkSize, string? path = null)
+        {
+            key ??= _key;
+            fixed (byte* k = key)
+            fixed (byte* d = data)
+                return aesgcmsiv_rocksdb_write_file(path ?? _path, k, (nuint)key.Length, chunkSize, d, (nuint)data.Length);
+        }
+
+        private int Read(ulong offset, byte[] output, out int read, byte[]? key = null, uint chunkSize = ChunkSize)
+        {
+            key ??= _key;
+            nuint count;
+            fixed (byte* k = key)
+            fixed (byte* o = output)
+            {
+                int result = aesgcmsiv_rocksdb_read_file(_path, k, (nuint)key.Length, chunkSize, offset, o, (nuint)output.Length, &count);
+                read = (int)count;
+                return result;
+            }
+        }
+
+        private void Corrupt(long offset)
+        {
+            using var file = File.Open(_path, FileMode.Open);
+            file.Position = offset;
+            int value = file.ReadByte();
+            file.Position = offset;
+            file.WriteByte((byte)(value ^ 0x20));
+        }
+
+        [RocksDbFact]
+        public void File_ShouldRoundTripEncrypted()
+        {
+            foreach (int length in new[] { 0, 1, 4095, 4096, 4097, 100_000 })
+            {
+                // Arrange
+                var data = Data(length);
+
+                // Act
+                Assert.Equal(Success, Write(data));
+                var whole = new byte[length + 10];
+                int result = Read(0, whole, out int read);
+
+                // Assert: reads of the whole file and of ranges across chunk boundaries
+                Assert.Equal(Success, result);
+                Assert.Equal(length, read);
+                Assert.Equal(data, whole.AsSpan(0, read).ToArray());
+                for (int offset = 0; offset < length; offset += 3001)
+                {
+                    var range = new byte[5000];
+                    Assert.Equal(Success, Read((ulong)offset, range, out read));
+                    Assert.Equal(Math.Min(range.Length, length - offset), read);
+                    Assert.Equal(data.AsSpan(offset, read).ToArray(), range.AsSpan(0, read).ToArray());
+                }
+                Assert.Equal(Success, Read((ulong)length + 5, new byte[10], out read));
+                Assert.Equal(0, read);
+                if (length >= 64)
+                {
+                    var file = File.ReadAllBytes(_path);
+                    Assert.True(file.AsSpan().IndexOf(data.AsSpan(length / 2, 32)) < 0);
+                }
+            }
+        }
+
+        [RocksDbFact]
+        public void File_ShouldBeAStreamTheStreamFunctionsOpen()
+        {
+            // Arrange
+            Assert.Equal(Success, Write(Data(50_000)));
+            using var ctx = new Context(_key);
+            ulong corrupt;
+
+            // Act
+            int result = aesgcmsiv_stream_scrub_file(ctx.Handle, _path, null, 0, 0, null, IntPtr.Zero, &corrupt);
+
+            // Assert
+            Assert.Equal(Success, result);
+            Assert.Equal(0UL, corrupt);
+        }
+
+        [RocksDbFact]
+        public void File_WithTamperedChunk_ShouldFailReadsThatCoverIt()
+        {
+            // Arrange
+            var data = Data(20_000);
+            Assert.Equal(Success, Write(data));
+            Corrupt(HeaderSize + 2 * SealedChunkSize + 50);
+            var output = new byte[1000];
+
+            // Act & Assert: chunks 0 and 3 still read, chunk 2 does not
+            Assert.Equal(Success, Read(100, output, out _));
+            Assert.Equal(Success, Read(3 * ChunkSize, output, out _));
+            Assert.Equal(DecryptFailed, Read(2 * ChunkSize + 10, output, out _));
+            Assert.Equal(DecryptFailed, Read(0, new byte[data.Length], out _));
+        }
+
+        [RocksDbFact]
+        public void File_UnderAnotherKeyOrChunkSizeOrTruncated_ShouldFail()
+        {
+            // Arrange
+            var data = Data(10_000);
+            Assert.Equal(Success, Write(data));
+            var otherKey = (byte[])_key.Clone();
+            otherKey[5] ^= 0x01;
+            var output = new byte[data.Length];
+
+            // Act & Assert
+            Assert.Equal(DecryptFailed, Read(0, output, out _, key: otherKey));
+            Assert.Equal(DecryptFailed, Read(0, output, out _, chunkSize: ChunkSize * 2));
+            using (var file = File.Open(_path, FileMode.Open))
+                file.SetLength(file.Length - 1);
+            Assert.Equal(DecryptFailed, Read(0, output, out _));
+        }
+
+        [RocksDbFact]
+        public void WriteAndRead_WithInvalidArguments_ShouldFail()
+        {
+            var data = Data(100);
+            var output = new byte[100];
+            nuint read;
+
+            Assert.Equal(InvalidKey, Write(data, key: new byte[20]));
+            Assert.Equal(InvalidInput, Write(data, chunkSize: 0));
+            Assert.Equal(InvalidInput, Write(data, chunkSize: (1u << 24) + 1));
+            fixed (byte* k = _key)
+            {
+                Assert.Equal(InvalidKey, aesgcmsiv_rocksdb_write_file(_path, null, 32, ChunkSize, null, 0));
+                Assert.Equal(InvalidInput, aesgcmsiv_rocksdb_write_file(null, k, 32, ChunkSize, null, 0));
+                Assert.Equal(InvalidInput, aesgcmsiv_rocksdb_write_file(_path, k, 32, ChunkSize, null, 1));
+                Assert.Equal(NotFound, aesgcmsiv_rocksdb_read_file(_path, k, 32, ChunkSize, 0, null, 0, &read));
+                Assert.Equal(Success, Write(data));
+                Assert.Equal(InvalidInput, aesgcmsiv_rocksdb_read_file(_path, k, 32, ChunkSize, 0, null, 1, &read));
+                fixed (byte* o = output)
+                    Assert.Equal(InvalidInput, aesgcmsiv_rocksdb_read_file(_path, k, 32, ChunkSize, 0, o, 100, null));
+            }
+            Assert.Equal(InvalidKey, Read(0, output, out _, key: new byte[15]));
+            Assert.Equal(Success, Read(0, output, out int count));
+            Assert.Equal(data, output.AsSpan(0, count).ToArray());
+        }
+    }
+}
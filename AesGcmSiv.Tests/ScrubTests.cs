@@ -0,0 +1,246 @@
+using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
+using Xunit;
+using static AesGcmSiv.Tests.NativeMethods;
+
+namespace AesGcmSiv.Tests
+{
+    /// <summary>
+    /// Tests for scrubbing stream and pack files, and verifying stream chunks, through the native API.
+    /// </summary>
+    public unsafe class ScrubTests : IDisposable
+    {
+        private const int HeaderSize = 12;
+        private const int ChunkSize = 1000;
+        private const int SealedChunkSize = ChunkSize + 16;
+        private const int PlaintextLength = 9 * ChunkSize + 123;
+
+        private readonly byte[] _key;
+        private readonly byte[] _aad = { 7, 7, 7 };
+        private readonly string _plainPath;
+        private readonly string _sealedPath;
+
+        public ScrubTests()
+        {
+            _key = Enumerable.Range(0, 16).Select(i => (byte)(0x30 + i)).ToArray();
+            string stem = Path.Combine(Path.GetTempPath(), $"aesgcmsiv-scrub-{Guid.NewGuid():N}");
+            _plainPath = stem + ".plain";
+            _sealedPath = stem + ".sealed";
+            File.WriteAllBytes(_plainPath, Enumerable.Range(0, PlaintextLength).Select(i => (byte)(i * 13)).ToArray());
+        }
+
+        public void Dispose()
+        {
+            File.Delete(_plainPath);
+            File.Delete(_sealedPath);
+        }
+
+        [UnmanagedCallersOnly(CallConvs = new[] { typeof(CallConvCdecl) })]
+        private static void OnCorrupt(IntPtr user, ulong offset, ulong length, int status)
+        {
+            var reports = (List<(ulong, ulong, int)>)GCHandle.FromIntPtr(user).Target!;
+            lock (reports)
+                reports.Add((offset, length, status));
+        }
+
+        private delegate int ScrubCall(IntPtr user, ulong* corrupt);
+
+        // Runs scrub with a callback collecting the reports, sorted by offset
+        private static int Scrub(
+            ScrubCall scrub, out ulong corrupt, out List<(ulong Offset, ulong Length, int Status)> reports)
+        {
+            var collected = new List<(ulong, ulong, int)>();
+            var handle = GCHandle.Alloc(collected);
+            try
+            {
+                ulong count;
+                int result = scrub(GCHandle.ToIntPtr(handle), &count);
+                corrupt = count;
+                reports = collected.OrderBy(r => r.Item1).ToList();
+                return result;
+            }
+            finally
+            {
+                handle.Free();
+            }
+        }
+
+        private int ScrubStream(Context ctx, byte[]? aad, out ulong corrupt, out List<(ulong Offset, ulong Length, int Status)> reports)
+        {
+            string path = _sealedPath;
+            return Scrub((user, count) =>
+            {
+                fixed (byte* a = aad)
+                    return aesgcmsiv_stream_scrub_file(ctx.Handle, path, a, (nuint)(aad?.Length ?? 0), 0, &OnCorrupt, user, count);
+            }, out corrupt, out reports);
+        }
+
+        private static IntPtr OpenPack(string path)
+        {
+            IntPtr pack;
+            Assert.Equal(Success, aesgcmsiv_pack_open(path, &pack));
+            return pack;
+        }
+
+        private void SealFile(Context ctx)
+        {
+            fixed (byte* a = _aad)
+                Assert.Equal(Success, aesgcmsiv_stream_seal_file(ctx.Handle, _plainPath, _sealedPath, ChunkSize, a, (nuint)_aad.Length));
+        }
+
+        private void Corrupt(long offset)
+        {
+            using var file = File.Open(_sealedPath, FileMode.Open);
+            file.Position = offset;
+            int value = file.ReadByte();
+            file.Position = offset;
+            file.WriteByte((byte)(value ^ 0x01));
+        }
+
+        [Fact]
+        public void ScrubStreamFile_WhenIntact_ShouldReportNothing()
+        {
+            // Arrange
+            using var ctx = new Context(_key);
+            SealFile(ctx);
+
+            // Act
+            int result = ScrubStream(ctx, _aad, out ulong corrupt, out var reports);
+
+            // Assert
+            Assert.Equal(Success, result);
+            Assert.Equal(0UL, corrupt);
+            Assert.Empty(reports);
+        }
+
+        [Fact]
+        public void ScrubStreamFile_WithCorruptChunks_ShouldReportEachAndGoOn()
+        {
+            // Arrange: chunks 2 and 9, the short last one
+            using var ctx = new Context(_key);
+            SealFile(ctx);
+            Corrupt(HeaderSize + 2 * SealedChunkSize + 17);
+            Corrupt(HeaderSize + 9 * SealedChunkSize + 5);
+
+            // Act
+            int result = ScrubStream(ctx, _aad, out ulong corrupt, out var reports);
+
+            // Assert
+            Assert.Equal(DecryptFailed, result);
+            Assert.Equal(2UL, corrupt);
+            Assert.Equal(2, reports.Count);
+            Assert.Equal(((ulong)(HeaderSize + 2 * SealedChunkSize), (ulong)SealedChunkSize, DecryptFailed), reports[0]);
+            Assert.Equal(((ulong)(HeaderSize + 9 * SealedChunkSize), (ulong)(123 + 16), DecryptFailed), reports[1]);
+        }
+
+        [Fact]
+        public void ScrubStreamFile_UnderWrongAadOrTruncated_ShouldFail()
+        {
+            // Arrange
+            using var ctx = new Context(_key);
+            SealFile(ctx);
+
+            // Act & Assert
+            Assert.Equal(DecryptFailed, ScrubStream(ctx, null, out ulong corrupt, out _));
+            Assert.Equal(10UL, corrupt);
+            using (var file = File.Open(_sealedPath, FileMode.Open))
+                file.SetLength(HeaderSize + 9 * SealedChunkSize);
+            Assert.Equal(DecryptFailed, ScrubStream(ctx, _aad, out _, out _));
+        }
+
+        [Fact]
+        public void ScrubStreamFile_WithBadHeaderOrMissingFile_ShouldFail()
+        {
+            using var ctx = new Context(_key);
+            File.WriteAllBytes(_sealedPath, new byte[100]);
+
+            Assert.Equal(InvalidInput, ScrubStream(ctx, _aad, out _, out _));
+            File.Delete(_sealedPath);
+            Assert.Equal(IOError, ScrubStream(ctx, _aad, out _, out _));
+        }
+
+        [Fact]
+        public void VerifyChunks_ShouldReportEachChunk()
+        {
+            // Arrange
+            using var ctx = new Context(_key);
+            SealFile(ctx);
+            var sealedFile = File.ReadAllBytes(_sealedPath);
+            IntPtr opened;
+            fixed (byte* h = sealedFile)
+                Assert.Equal(Success, aesgcmsiv_stream_open_new(ctx.Handle, h, &opened));
+            IntPtr stream = opened;
+            try
+            {
+                int VerifyChunks(ulong first, int count, int last, int[] status)
+                {
+                    var chunks = sealedFile.AsSpan(HeaderSize + (int)first * SealedChunkSize);
+                    chunks = chunks.Slice(0, Math.Min(count * SealedChunkSize, chunks.Length));
+                    fixed (byte* c = chunks)
+                    fixed (byte* a = _aad)
+                    fixed (int* s = status)
+                        return aesgcmsiv_stream_verify_chunks(stream, first, (nuint)count, c, (nuint)chunks.Length, a, (nuint)_aad.Length, last, s);
+                }
+
+                // Act & Assert: the whole stream, then a middle run with chunk 4 tampered
+                var status = new int[10];
+                Assert.Equal(Success, VerifyChunks(0, 10, 1, status));
+                Assert.True(status.All(s => s == Success));
+                sealedFile[HeaderSize + 4 * SealedChunkSize + 100] ^= 0x08;
+                status = new int[4];
+                Assert.Equal(DecryptFailed, VerifyChunks(3, 4, 0, status));
+                Assert.Equal(new[] { Success, DecryptFailed, Success, Success }, status);
+
+                // A full chunk verified as the last fails, and a buffer too short for its chunks is rejected
+                status = new int[1];
+                Assert.Equal(DecryptFailed, VerifyChunks(5, 1, 1, status));
+                fixed (byte* c = sealedFile)
+                fixed (int* s = status)
+                    Assert.Equal(InvalidInput, aesgcmsiv_stream_verify_chunks(stream, 0, 2, c + HeaderSize, SealedChunkSize, null, 0, 0, s));
+            }
+            finally
+            {
+                aesgcmsiv_stream_free(stream);
+            }
+        }
+
+        [Fact]
+        public void ScrubPack_ShouldReportEachCorruptBlob()
+        {
+            // Arrange
+            using var ctx = new Context(_key);
+            var ids = Enumerable.Range(0, 20).Select(i => new[] { (byte)i, (byte)(i * 3) }).ToArray();
+            var blobs = Enumerable.Range(0, 20).Select(i => new byte[i * 50 + 1]).ToArray();
+            Assert.Equal(Success, PackTests.WritePack(ctx, _sealedPath, 2, ids, blobs));
+            IntPtr pack = OpenPack(_sealedPath);
+            try
+            {
+                int ScrubPack(Context key, out ulong corrupt, out List<(ulong Offset, ulong Length, int Status)> reports) =>
+                    Scrub((user, count) => aesgcmsiv_pack_scrub(key.Handle, pack, 0, &OnCorrupt, user, count), out corrupt, out reports);
+
+                // Act & Assert
+                Assert.Equal(Success, ScrubPack(ctx, out ulong corrupt, out var reports));
+                Assert.Equal(0UL, corrupt);
+                aesgcmsiv_pack_free(pack);
+                pack = IntPtr.Zero;
+                Corrupt(new FileInfo(_sealedPath).Length - 1);
+                pack = OpenPack(_sealedPath);
+                Assert.Equal(DecryptFailed, ScrubPack(ctx, out corrupt, out reports));
+                Assert.Equal(1UL, corrupt);
+                var report = Assert.Single(reports);
+                Assert.Equal((ulong)new FileInfo(_sealedPath).Length, report.Offset + report.Length);
+                Assert.Equal(DecryptFailed, report.Status);
+
+                var otherKey = (byte[])_key.Clone();
+                otherKey[0] ^= 1;
+                using var other = new Context(otherKey);
+                Assert.Equal(DecryptFailed, ScrubPack(other, out corrupt, out _));
+                Assert.Equal(20UL, corrupt);
+            }
+            finally
+            {
+                aesgcmsiv_pack_free(pack);
+            }
+        }
+    }
+}
@@ -0,0 +1,173 @@
+using Xunit;
+using static AesGcmSiv.Tests.NativeMethods;
+
+namespace AesGcmSiv.Tests
+{
+    /// <summary>
+    /// Tests for key tables in shared memory, through the native API.
+    /// </summary>
+    public unsafe class SharedKeyTableTests : IDisposable
+    {
+        private const int Slots = 4;
+        private const int NonceLength = 12;
+        private const int TagLength = 16;
+
+        private readonly IntPtr _table;
+
+        public SharedKeyTableTests()
+        {
+            IntPtr table;
+            Assert.Equal(Success, aesgcmsiv_key_table_new_shared(Slots, &table));
+            _table = table;
+        }
+
+        public void Dispose()
+        {
+            aesgcmsiv_key_table_free(_table);
+        }
+
+        private static byte[] Key(int slot) =>
+            Enumerable.Range(0, slot % 2 == 0 ? 32 : 16).Select(i => (byte)(slot * 17 + i)).ToArray();
+
+        private static int SetKey(IntPtr table, int slot, byte[] key)
+        {
+            fixed (byte* k = key)
+                return aesgcmsiv_key_table_set(table, (nuint)slot, k, (nuint)key.Length);
+        }
+
+        // Runs an encrypt or decrypt batch of inputs, with nonce i filled with i, returning
+        // the call's result; decrypting reads the tags and writes status
+        private static int RunBatch(
+            IntPtr table, bool encrypt, byte[][] inputs, uint[] slots, byte[][] outputs, byte[] tags, int[] status)
+        {
+            var nonces = new byte[inputs.Length * NonceLength];
+            for (int i = 0; i < inputs.Length; i++) nonces.AsSpan(i * NonceLength, NonceLength).Fill((byte)i);
+            var input = inputs.SelectMany(m => m).ToArray();
+            var output = new byte[input.Length];
+            var items = new BatchItem[inputs.Length];
+            int result;
+            fixed (byte* n = nonces)
+            fixed (byte* i = input)
+            fixed (byte* o = output)
+            fixed (byte* t = tags)
+            fixed (BatchItem* it = items)
+            fixed (uint* s = slots)
+            fixed (int* st = status)
+            {
+                for (int k = 0, offset = 0; k < inputs.Length; offset += inputs[k].Length, k++)
+                {
+                    it[k].Nonce = n + k * NonceLength;
+                    it[k].Input = i + offset;
+                    it[k].InputLength = (nuint)inputs[k].Length;
+                    it[k].Output = o + offset;
+                    it[k].Tag = t + k * TagLength;
+                }
+                result = encrypt
+                    ? aesgcmsiv_key_table_encrypt_batch(table, (nuint)inputs.Length, it, s)
+                    : aesgcmsiv_key_table_decrypt_batch(table, (nuint)inputs.Length, it, s, st);
+            }
+            for (int k = 0, offset = 0; k < inputs.Length; offset += inputs[k].Length, k++)
+                outputs[k] = output.AsSpan(offset, inputs[k].Length).ToArray();
+            return result;
+        }
+
+        private static byte[][] Messages(int count) =>
+            Enumerable.Range(0, count).Select(i => Enumerable.Range(0, i * 11).Select(j => (byte)(i + j)).ToArray()).ToArray();
+
+        [Fact]
+        public void SealedTable_ShouldRoundTripUnderEachSlotsKey()
+        {
+            // Arrange
+            for (int slot = 0; slot < Slots; slot++)
+                Assert.Equal(Success, SetKey(_table, slot, Key(slot)));
+            Assert.Equal(Success, aesgcmsiv_key_table_seal(_table));
+            var messages = Messages(40);
+            var slots = Enumerable.Range(0, messages.Length).Select(i => (uint)(i * 3 % Slots)).ToArray();
+            var ciphertexts = new byte[messages.Length][];
+            var tags = new byte[messages.Length * TagLength];
+
+            // Act
+            int sealedResult = RunBatch(_table, true, messages, slots, ciphertexts, tags, new int[messages.Length]);
+            var decrypted = new byte[messages.Length][];
+            var status = new int[messages.Length];
+            int openResult = RunBatch(_table, false, ciphertexts, slots, decrypted, tags, status);
+
+            // Assert
+            Assert.Equal(Success, sealedResult);
+            Assert.Equal(Success, openResult);
+            for (int i = 0; i < messages.Length; i++)
+            {
+                using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(Key((int)slots[i]));
+                var expected = new byte[messages[i].Length];
+                var expectedTag = new byte[TagLength];
+                var nonce = new byte[NonceLength];
+                nonce.AsSpan().Fill((byte)i);
+                aesGcmSiv.Encrypt(nonce, messages[i], expected, expectedTag);
+                Assert.Equal(expected, ciphertexts[i]);
+                Assert.Equal(expectedTag, tags.AsSpan(i * TagLength, TagLength).ToArray());
+                Assert.Equal(Success, status[i]);
+                Assert.Equal(messages[i], decrypted[i]);
+            }
+        }
+
+        [Fact]
+        public void Decrypt_WithTamperedMessageOrWrongSlot_ShouldFailOnlyThatItem()
+        {
+            // Arrange
+            for (int slot = 0; slot < Slots; slot++)
+                Assert.Equal(Success, SetKey(_table, slot, Key(slot)));
+            var messages = Messages(4);
+            var slots = new uint[] { 0, 1, 2, 3 };
+            var ciphertexts = new byte[4][];
+            var tags = new byte[4 * TagLength];
+            Assert.Equal(Success, RunBatch(_table, true, messages, slots, ciphertexts, tags, new int[4]));
+            ciphertexts[2][5] ^= 0x80;
+            tags[3 * TagLength] ^= 0x01;
+            slots[1] = 0;
+
+            // Act
+            var decrypted = new byte[4][];
+            var status = new int[4];
+            int result = RunBatch(_table, false, ciphertexts, slots, decrypted, tags, status);
+
+            // Assert
+            Assert.Equal(DecryptFailed, result);
+            Assert.Equal(new[] { Success, DecryptFailed, DecryptFailed, DecryptFailed }, status);
+            Assert.Equal(messages[0], decrypted[0]);
+            Assert.True(decrypted.Skip(1).All(d => d.All(b => b == 0)));
+        }
+
+        [Fact]
+        public void SealedTable_ShouldRefuseChanges()
+        {
+            // Arrange
+            Assert.Equal(Success, SetKey(_table, 0, Key(0)));
+            Assert.Equal(Success, aesgcmsiv_key_table_seal(_table));
+
+            // Act & Assert
+            Assert.Equal(Success, aesgcmsiv_key_table_seal(_table));
+            Assert.Equal(InvalidInput, SetKey(_table, 1, Key(1)));
+            Assert.Equal(InvalidInput, aesgcmsiv_key_table_clear(_table, 0));
+            var ciphertexts = new byte[1][];
+            var tags = new byte[TagLength];
+            Assert.Equal(Success, RunBatch(_table, true, Messages(2).Skip(1).ToArray(), new uint[] { 0 }, ciphertexts, tags, new int[1]));
+        }
+
+        [Fact]
+        public void Table_WithInvalidArguments_ShouldFail()
+        {
+            // Arrange
+            IntPtr table;
+            Assert.Equal(Success, SetKey(_table, 0, Key(0)));
+            Assert.Equal(Success, aesgcmsiv_key_table_clear(_table, 0));
+
+            // Act & Assert
+            Assert.Equal(InvalidInput, aesgcmsiv_key_table_new_shared(0, &table));
+            Assert.Equal(InvalidInput, SetKey(_table, Slots, Key(0)));
+            Assert.Equal(InvalidKey, SetKey(_table, 1, new byte[24]));
+            Assert.Equal(InvalidInput, aesgcmsiv_key_table_clear(_table, Slots));
+            Assert.Equal(InvalidKey, RunBatch(_table, true, Messages(1), new uint[] { 0 }, new byte[1][], new byte[TagLength], new int[1]));
+            Assert.Equal(InvalidKey, RunBatch(_table, true, Messages(1), new uint[] { Slots }, new byte[1][], new byte[TagLength], new int[1]));
+        }
+    }
+}
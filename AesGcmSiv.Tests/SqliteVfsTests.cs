@@ -0,0 +1,308 @@
+using System.Runtime.InteropServices;
+using System.Text;
+using Xunit;
+using static AesGcmSiv.Tests.NativeMethods;
+
+namespace AesGcmSiv.Tests
+{
+    /// <summary>
+    /// A fact that needs SQLite and the aesgcmsiv_sqlite module (built with <c>-DAESGCMSIV_SQLITE=ON</c>)
+    /// beside the tests, skipped when either cannot be loaded.
+    /// </summary>
+    public sealed class SqliteFactAttribute : FactAttribute
+    {
+        public SqliteFactAttribute()
+        {
+            // The module needs the library loaded ahead of it
+            var assembly = typeof(SqliteFactAttribute).Assembly;
+            foreach (var library in new[] { "sqlite3", "aesgcmsiv", "aesgcmsiv_sqlite" })
+            {
+                if (!NativeLibrary.TryLoad(library, assembly, null, out _))
+                {
+                    Skip = $"{library} cannot be loaded.";
+                    return;
+                }
+            }
+        }
+    }
+
+    /// <summary>
+    /// Tests for the SQLite VFS shim, through SQLite's and the shim's native APIs.
+    /// </summary>
+    public unsafe class SqliteVfsTests : IDisposable
+    {
+        private const string Sqlite = "sqlite3";
+        private const string Shim = "aesgcmsiv_sqlite";
+        private const int PageSize = 4096;
+        private const int Rows = 300;
+
+        private const int SQLITE_OK = 0;
+        private const int SQLITE_ROW = 100;
+        private const int SQLITE_DONE = 101;
+        private const int SQLITE_NOTADB = 26;
+        private const int SQLITE_IOERR_WRITE = 10 | (3 << 8);
+        private const int SQLITE_IOERR_DATA = 10 | (32 << 8);
+        private const int SQLITE_OPEN_READWRITE = 0x02;
+        private const int SQLITE_OPEN_CREATE = 0x04;
+        private const int SQLITE_FCNTL_RESERVE_BYTES = 38;
+        private const int Reserve = 16;
+
+        [DllImport(Sqlite, ExactSpelling = true)]
+        private static extern int sqlite3_open_v2(
+            [MarshalAs(UnmanagedType.LPUTF8Str)] string filename, IntPtr* db, int flags,
+            [MarshalAs(UnmanagedType.LPUTF8Str)] string? vfs);
+
+        [DllImport(Sqlite, ExactSpelling = true)]
+        private static extern int sqlite3_close(IntPtr db);
+
+        [DllImport(Sqlite, ExactSpelling = true)]
+        private static extern int sqlite3_extended_result_codes(IntPtr db, int onoff);
+
+        [DllImport(Sqlite, ExactSpelling = true)]
+        private static extern int sqlite3_exec(
+            IntPtr db, [MarshalAs(UnmanagedType.LPUTF8Str)] string sql, IntPtr callback, IntPtr arg, IntPtr errmsg);
+
+        [DllImport(Sqlite, ExactSpelling = true)]
+        private static extern int sqlite3_file_control(
+            IntPtr db, [MarshalAs(UnmanagedType.LPUTF8Str)] string name, int op, void* arg);
+
+        [DllImport(Sqlite, ExactSpelling = true)]
+        private static extern int sqlite3_prepare_v2(
+            IntPtr db, [MarshalAs(UnmanagedType.LPUTF8Str)] string sql, int bytes, IntPtr* stmt, IntPtr tail);
+
+        [DllImport(Sqlite, ExactSpelling = true)]
+        private static extern int sqlite3_step(IntPtr stmt);
+
+        [DllImport(Sqlite, ExactSpelling = true)]
+        private static extern IntPtr sqlite3_column_text(IntPtr stmt, int column);
+
+        [DllImport(Sqlite, ExactSpelling = true)]
+        private static extern int sqlite3_finalize(IntPtr stmt);
+
+        [DllImport(Shim, ExactSpelling = true)]
+        private static extern int aesgcmsiv_sqlite_register(
+            [MarshalAs(UnmanagedType.LPUTF8Str)] string? name, [MarshalAs(UnmanagedType.LPUTF8Str)] string? baseVfs,
+            byte* key, nuint keyLength, nuint pageSize, int makeDefault);
+
+        [DllImport(Shim, ExactSpelling = true)]
+        private static extern int aesgcmsiv_sqlite_unregister([MarshalAs(UnmanagedType.LPUTF8Str)] string? name);
+
+        private readonly byte[] _key;
+        private readonly string _vfs;
+        private readonly string _path;
+
+        public SqliteVfsTests()
+        {
+            _key = Enumerable.Range(0, 32).Select(i => (byte)(i * 9 + 2)).ToArray();
+            string id = Guid.NewGuid().ToString("N");
+            _vfs = $"aesgcmsiv-{id}";
+            _path = Path.Combine(Path.GetTempPath(), $"aesgcmsiv-sqlite-{id}.db");
+        }
+
+        public void Dispose()
+        {
+            aesgcmsiv_sqlite_unregister(_vfs);
+            foreach (var suffix in new[] { "", "-journal", "-wal", "-shm" })
+                File.Delete(_path + suffix);
+        }
+
+        private static int Register(string? name, byte[] key, int pageSize = PageSize, string? baseVfs = null)
+        {
+            fixed (byte* k = key)
+                return aesgcmsiv_sqlite_register(name, baseVfs, k, (nuint)key.Length, (nuint)pageSize, 0);
+        }
+
+        private IntPtr Open(string? vfs, bool reserve = true)
+        {
+            IntPtr db;
+            int result = sqlite3_open_v2(_path, &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, vfs);
+            if (result != SQLITE_OK)
+            {
+                sqlite3_close(db);
+                Assert.Equal(SQLITE_OK, result);
+            }
+            sqlite3_extended_result_codes(db, 1);
+            if (reserve)
+            {
+                int bytes = Reserve;
+                Assert.Equal(SQLITE_OK, sqlite3_file_control(db, "main", SQLITE_FCNTL_RESERVE_BYTES, &bytes));
+            }
+            return db;
+        }
+
+        private static int Exec(IntPtr db, string sql) => sqlite3_exec(db, sql, IntPtr.Zero, IntPtr.Zero, IntPtr.Zero);
+
+        // Runs a query, returning its status and the first column of each row
+        private static int Query(IntPtr db, string sql, out List<string?> values)
+        {
+            values = new List<string?>();
+            IntPtr stmt;
+            int result = sqlite3_prepare_v2(db, sql, -1, &stmt, IntPtr.Zero);
+            if (result != SQLITE_OK)
+                return result;
+            while ((result = sqlite3_step(stmt)) == SQLITE_ROW)
+                values.Add(Marshal.PtrToStringUTF8(sqlite3_column_text(stmt, 0)));
+            sqlite3_finalize(stmt);
+            return result == SQLITE_DONE ? SQLITE_OK : result;
+        }
+
+        private static string Value(int i) => $"plaintext-marker-{i:D5}";
+
+        private void CreateDatabase(string journalMode)
+        {
+            IntPtr db = Open(_vfs);
+            try
+            {
+                Assert.Equal(SQLITE_OK, Exec(db, $"PRAGMA page_size = {PageSize}; PRAGMA temp_store = MEMORY; PRAGMA journal_mode = {journalMode};"));
+                Assert.Equal(SQLITE_OK, Exec(db, "CREATE TABLE t (id INTEGER PRIMARY KEY, v TEXT);"));
+                var insert = new StringBuilder("BEGIN;");
+                for (int i = 0; i < Rows; i++)
+                    insert.Append($"INSERT INTO t (v) VALUES ('{Value(i)}');");
+                insert.Append("COMMIT;");
+                Assert.Equal(SQLITE_OK, Exec(db, insert.ToString()));
+                Assert.Equal(SQLITE_OK, Exec(db, "UPDATE t SET v = v || '-updated' WHERE id % 7 = 0;"));
+            }
+            finally
+            {
+                Assert.Equal(SQLITE_OK, sqlite3_close(db));
+            }
+        }
+
+        private int ReadAll(string? vfs, out List<string?> values)
+        {
+            IntPtr db = Open(vfs, reserve: false);
+            try
+            {
+                return Query(db, "SELECT v FROM t ORDER BY id;", out values);
+            }
+            finally
+            {
+                sqlite3_close(db);
+            }
+        }
+
+        private void AssertRoundTrip(string journalMode)
+        {
+            // Arrange
+            Assert.Equal(Success, Register(_vfs, _key));
+
+            // Act
+            CreateDatabase(journalMode);
+            int result = ReadAll(_vfs, out var values);
+
+            // Assert
+            Assert.Equal(SQLITE_OK, result);
+            Assert.Equal(Rows, values.Count);
+            for (int i = 0; i < Rows; i++)
+                Assert.Equal((i + 1) % 7 == 0 ? Value(i) + "-updated" : Value(i), values[i]);
+            var file = File.ReadAllBytes(_path);
+            Assert.Equal(0, file.Length % PageSize);
+            Assert.True(file.AsSpan().IndexOf("plaintext-marker"u8) < 0);
+            Assert.True(file.AsSpan().IndexOf("SQLite format 3"u8) < 0);
+            Assert.Equal(SQLITE_NOTADB, ReadAll(null, out _));
+        }
+
+        [SqliteFact]
+        public void Database_WithRollbackJournal_ShouldRoundTripEncrypted()
+        {
+            AssertRoundTrip("DELETE");
+        }
+
+        [SqliteFact]
+        public void Database_WithWriteAheadLog_ShouldRoundTripEncrypted()
+        {
+            AssertRoundTrip("WAL");
+        }
+
+        [SqliteFact]
+        public void Database_WithTamperedPage_ShouldFailItsRead()
+        {
+            // Arrange
+            Assert.Equal(Success, Register(_vfs, _key));
+            CreateDatabase("DELETE");
+            using (var file = File.Open(_path, FileMode.Open))
+            {
+                file.Position = PageSize + 200;
+                int value = file.ReadByte();
+                file.Position = PageSize + 200;
+                file.WriteByte((byte)(value ^ 0x04));
+            }
+
+            // Act
+            int result = ReadAll(_vfs, out _);
+
+            // Assert
+            Assert.Equal(SQLITE_IOERR_DATA, result);
+        }
+
+        [SqliteFact]
+        public void Database_UnderAnotherKey_ShouldFailItsRead()
+        {
+            // Arrange
+            Assert.Equal(Success, Register(_vfs, _key));
+            CreateDatabase("DELETE");
+            var otherKey = (byte[])_key.Clone();
+            otherKey[31] ^= 0x01;
+            string other = _vfs + "-other";
+            Assert.Equal(Success, Register(other, otherKey));
+            try
+            {
+                // Act
+                int result = ReadAll(other, out _);
+
+                // Assert
+                Assert.Equal(SQLITE_IOERR_DATA, result);
+            }
+            finally
+            {
+                Assert.Equal(Success, aesgcmsiv_sqlite_unregister(other));
+            }
+        }
+
+        [SqliteFact]
+        public void Database_WithoutReserveOrWithAnotherPageSize_ShouldFailTheFirstWrite()
+        {
+            // Arrange
+            Assert.Equal(Success, Register(_vfs, _key));
+
+            // Act & Assert
+            IntPtr db = Open(_vfs, reserve: false);
+            try
+            {
+                Assert.Equal(SQLITE_IOERR_WRITE, Exec(db, $"PRAGMA page_size = {PageSize}; CREATE TABLE t (v TEXT);"));
+            }
+            finally
+            {
+                sqlite3_close(db);
+            }
+            File.Delete(_path);
+            db = Open(_vfs);
+            try
+            {
+                Assert.Equal(SQLITE_IOERR_WRITE, Exec(db, "PRAGMA page_size = 1024; CREATE TABLE t (v TEXT);"));
+            }
+            finally
+            {
+                sqlite3_close(db);
+            }
+        }
+
+        [SqliteFact]
+        public void Register_WithInvalidArguments_ShouldFail()
+        {
+            Assert.Equal(InvalidInput, Register(null, _key));
+            Assert.Equal(InvalidInput, Register(_vfs, _key, pageSize: 256));
+            Assert.Equal(InvalidInput, Register(_vfs, _key, pageSize: 3000));
+            Assert.Equal(InvalidInput, Register(_vfs, _key, pageSize: 131072));
+            Assert.Equal(NotFound, Register(_vfs, _key, baseVfs: "no-such-vfs"));
+            Assert.Equal(InvalidKey, Register(_vfs, new byte[20]));
+
+            Assert.Equal(Success, Register(_vfs, _key));
+            Assert.Equal(InvalidInput, Register(_vfs, _key));
+            Assert.Equal(Success, aesgcmsiv_sqlite_unregister(_vfs));
+            Assert.Equal(NotFound, aesgcmsiv_sqlite_unregister(_vfs));
+            Assert.Equal(NotFound, aesgcmsiv_sqlite_unregister(null));
+            Assert.Equal(NotFound, aesgcmsiv_sqlite_unregister(OperatingSystem.IsWindows() ? "win32" : "unix"));
+        }
+    }
+}
@@ -0,0 +1,14 @@
+using Xunit;
+
+namespace AesGcmSiv.Tests
+{
+    /// <summary>
+    /// Runs the tests that measure warmed-up calls on their own, after every other test, so that no
+    /// other test's calls or meter listeners land in what they count.
+    /// </summary>
+    [CollectionDefinition(Name, DisableParallelization = true)]
+    public sealed class SteadyStateCollection
+    {
+        public const string Name = "Steady state";
+    }
+}
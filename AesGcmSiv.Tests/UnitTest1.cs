@@ -1,3 +1,5 @@
+using System.Buffers.Binary;
+using System.Runtime.InteropServices;
 using System.Security.Cryptography;
 using Xunit;
 
@@ -43,7 +45,18 @@ namespace AesGcmSiv.Tests
             Assert.Throws<ArgumentNullException>(() => new System.Security.Cryptography.AesGcmSiv(null!));
         }
 
+        [Fact]
+        public void Constructor_With128BitKey_ShouldNotThrow()
+        {
+            // Act & Assert
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(new byte[16]);
+            Assert.NotNull(aesGcmSiv);
+        }
+
         [Theory]
+        [InlineData(15)] // Too short for AES-128
+        [InlineData(17)] // Between AES-128 and AES-256
+        [InlineData(24)] // AES-192 is not defined for GCM-SIV
         [InlineData(31)] // Too short
         [InlineData(33)] // Too long
         public void Constructor_WithInvalidKeySize_ShouldThrowArgumentException(int keySize)
@@ -55,6 +68,62 @@ namespace AesGcmSiv.Tests
             Assert.Throws<ArgumentException>(() => new System.Security.Cryptography.AesGcmSiv(invalidKey));
         }
 
+        // Wraps unmanaged key memory; SafeFileHandle would do on Windows, but on Unix it holds a
+        // file descriptor and rejects anything past int.MaxValue as invalid
+        private sealed class UnmanagedKeyHandle : SafeHandle
+        {
+            public UnmanagedKeyHandle(IntPtr key) : base(IntPtr.Zero, ownsHandle: false) => SetHandle(key);
+
+            public override bool IsInvalid => handle == IntPtr.Zero;
+
+            protected override bool ReleaseHandle() => true;
+        }
+
+        [Fact]
+        public void Constructor_FromSpanAndSafeHandle_ShouldMatchArrayKey()
+        {
+            // Arrange
+            using var expectedInstance = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var expected = new byte[_testPlaintext.Length];
+            var expectedTag = new byte[16];
+            expectedInstance.Encrypt(_testNonce, _testPlaintext, expected, expectedTag);
+            IntPtr unmanagedKey = System.Runtime.InteropServices.Marshal.AllocHGlobal(_testKey.Length);
+            System.Runtime.InteropServices.Marshal.Copy(_testKey, 0, unmanagedKey, _testKey.Length);
+            Span<byte> stackKey = stackalloc byte[_testKey.Length];
+            _testKey.CopyTo(stackKey);
+
+            try
+            {
+                // Act
+                using var keyHandle = new UnmanagedKeyHandle(unmanagedKey);
+                var instances = new[]
+                {
+                    new System.Security.Cryptography.AesGcmSiv((ReadOnlySpan<byte>)stackKey),
+                    new System.Security.Cryptography.AesGcmSiv((ReadOnlySpan<byte>)stackKey, AesGcmSivImplementation.Auto),
+                    new System.Security.Cryptography.AesGcmSiv(keyHandle, _testKey.Length),
+                };
+
+                // Assert
+                foreach (var instance in instances)
+                {
+                    using (instance)
+                    {
+                        var ciphertext = new byte[_testPlaintext.Length];
+                        var tag = new byte[16];
+                        instance.Encrypt(_testNonce, _testPlaintext, ciphertext, tag);
+                        Assert.Equal(expected, ciphertext);
+                        Assert.Equal(expectedTag, tag);
+                    }
+                }
+                Assert.Throws<ArgumentException>(() => new System.Security.Cryptography.AesGcmSiv((ReadOnlySpan<byte>)new byte[24]));
+                Assert.Throws<ArgumentException>(() => new System.Security.Cryptography.AesGcmSiv(keyHandle, 24));
+            }
+            finally
+            {
+                System.Runtime.InteropServices.Marshal.FreeHGlobal(unmanagedKey);
+            }
+        }
+
         [Fact]
         public void Encrypt_WithValidParameters_ShouldSucceed()
         {
@@ -71,6 +140,669 @@ namespace AesGcmSiv.Tests
             Assert.False(tag.All(b => b == 0)); // Tag should not be all zeros
         }
 
+        [Fact]
+        public void Encrypt_With128BitKey_ShouldMatchRfc8452Vector()
+        {
+            // Arrange - RFC 8452 appendix C.1, 8-byte plaintext, no AAD
+            var key = Convert.FromHexString("01000000000000000000000000000000");
+            var nonce = Convert.FromHexString("030000000000000000000000");
+            var plaintext = Convert.FromHexString("0100000000000000");
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(key);
+            var ciphertext = new byte[plaintext.Length];
+            var tag = new byte[16];
+
+            // Act
+            aesGcmSiv.Encrypt(nonce, plaintext, ciphertext, tag);
+
+            // Assert
+            Assert.Equal(Convert.FromHexString("b5d839330ac7b786"), ciphertext);
+            Assert.Equal(Convert.FromHexString("578782fff6013b815b287c22493a364c"), tag);
+        }
+
+        [Fact]
+        public void EncryptDecrypt_With128BitKey_ShouldRoundTrip()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey.AsSpan(0, 16).ToArray());
+            var ciphertext = new byte[_testPlaintext.Length];
+            var tag = new byte[16];
+            var decrypted = new byte[_testPlaintext.Length];
+
+            // Act
+            aesGcmSiv.Encrypt(_testNonce, _testPlaintext, ciphertext, tag, _testAssociatedData);
+            aesGcmSiv.Decrypt(_testNonce, ciphertext, tag, decrypted, _testAssociatedData);
+
+            // Assert
+            Assert.Equal(_testPlaintext, decrypted);
+        }
+
+        [Theory]
+        [InlineData(-1)]
+        [InlineData(4)]
+        public void Encrypt_WithParallelism_ShouldMatchSerialOutput(int maxDegreeOfParallelism)
+        {
+            // Arrange
+            var plaintext = new byte[5 * 1024 * 1024 + 3];
+            for (int i = 0; i < plaintext.Length; i++) plaintext[i] = (byte)(i * 31);
+            using var serial = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            using var parallel = new System.Security.Cryptography.AesGcmSiv(_testKey)
+            {
+                MaxDegreeOfParallelism = maxDegreeOfParallelism
+            };
+            var expectedCiphertext = new byte[plaintext.Length];
+            var expectedTag = new byte[16];
+            var ciphertext = new byte[plaintext.Length];
+            var tag = new byte[16];
+
+            // Act
+            serial.Encrypt(_testNonce, plaintext, expectedCiphertext, expectedTag, _testAssociatedData);
+            parallel.Encrypt(_testNonce, plaintext, ciphertext, tag, _testAssociatedData);
+
+            // Assert
+            Assert.Equal(expectedTag, tag);
+            Assert.Equal(expectedCiphertext, ciphertext);
+        }
+
+        [Theory]
+        [InlineData(-1)]
+        [InlineData(3)]
+        public void Decrypt_WithParallelism_ShouldRoundTripAndRejectTampering(int maxDegreeOfParallelism)
+        {
+            // Arrange
+            var plaintext = new byte[4 * 1024 * 1024 + 9];
+            for (int i = 0; i < plaintext.Length; i++) plaintext[i] = (byte)(i * 17);
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey)
+            {
+                MaxDegreeOfParallelism = maxDegreeOfParallelism
+            };
+            var ciphertext = new byte[plaintext.Length];
+            var tag = new byte[16];
+            var decrypted = new byte[plaintext.Length];
+            aesGcmSiv.Encrypt(_testNonce, plaintext, ciphertext, tag, _testAssociatedData);
+
+            // Act
+            aesGcmSiv.Decrypt(_testNonce, ciphertext, tag, decrypted, _testAssociatedData);
+            ciphertext[ciphertext.Length / 2] ^= 1;
+
+            // Assert
+            Assert.Equal(plaintext, decrypted);
+            Assert.Throws<CryptographicException>(() =>
+                aesGcmSiv.Decrypt(_testNonce, ciphertext, tag, decrypted, _testAssociatedData));
+        }
+
+        [Fact]
+        public void EncryptBatch_WithParallelism_ShouldMatchSingleCallsAndRoundTrip()
+        {
+            // Arrange
+            using var serial = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            using var parallel = new System.Security.Cryptography.AesGcmSiv(_testKey)
+            {
+                MaxDegreeOfParallelism = -1
+            };
+            var items = new AesGcmSivBatchItem[301];
+            for (int i = 0; i < items.Length; i++)
+            {
+                var plaintext = new byte[i % 97];
+                for (int j = 0; j < plaintext.Length; j++) plaintext[j] = (byte)(i + j);
+                var nonce = (byte[])_testNonce.Clone();
+                nonce[0] = (byte)i;
+                items[i] = new AesGcmSivBatchItem(nonce, plaintext, new byte[plaintext.Length], new byte[16], _testAssociatedData);
+            }
+
+            // Act
+            parallel.EncryptBatch(items);
+            var decrypted = new AesGcmSivBatchItem[items.Length];
+            for (int i = 0; i < items.Length; i++)
+            {
+                decrypted[i] = new AesGcmSivBatchItem(items[i].Nonce, items[i].Output, new byte[items[i].Input.Length], items[i].Tag, _testAssociatedData);
+            }
+            var succeeded = new bool[items.Length];
+            int failures = parallel.DecryptBatch(decrypted, succeeded);
+
+            // Assert
+            Assert.Equal(0, failures);
+            for (int i = 0; i < items.Length; i++)
+            {
+                var expectedCiphertext = new byte[items[i].Input.Length];
+                var expectedTag = new byte[16];
+                serial.Encrypt(items[i].Nonce, items[i].Input, expectedCiphertext, expectedTag, _testAssociatedData);
+                Assert.Equal(expectedCiphertext, items[i].Output);
+                Assert.Equal(expectedTag, items[i].Tag);
+                Assert.Equal(items[i].Input, decrypted[i].Output);
+            }
+        }
+
+        [Theory]
+        [InlineData(AesGcmSivImplementation.Native)]
+        [InlineData(AesGcmSivImplementation.Managed)]
+        public void EncryptBatch_WithCounterNonces_ShouldMatchExplicitNonces(AesGcmSivImplementation implementation)
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey, implementation);
+            var baseNonce = new byte[] { 0x0f, 0x1e, 0x2d, 0x3c, 0, 0, 0, 0, 0, 0, 0, 0x80 };
+            const ulong firstCounter = 0xfffffffffffffff0;  // wraps within the batch
+            var items = new AesGcmSivBatchItem[150];
+            for (int i = 0; i < items.Length; i++)
+            {
+                var page = new byte[64 + i % 3 * 16];
+                for (int j = 0; j < page.Length; j++) page[j] = (byte)(i * j);
+                items[i] = new AesGcmSivBatchItem(null, page, new byte[page.Length], new byte[16]);
+            }
+
+            // Act
+            aesGcmSiv.EncryptBatch(items, baseNonce, firstCounter);
+            var decrypted = new AesGcmSivBatchItem[items.Length];
+            for (int i = 0; i < items.Length; i++)
+            {
+                decrypted[i] = new AesGcmSivBatchItem(null, items[i].Output, new byte[items[i].Input.Length], (byte[])items[i].Tag.Clone());
+            }
+            decrypted[7].Tag[0] ^= 1;
+            var succeeded = new bool[items.Length];
+            int failures = aesGcmSiv.DecryptBatch(decrypted, baseNonce, firstCounter, succeeded);
+
+            // Assert
+            Assert.Equal(1, failures);
+            for (int i = 0; i < items.Length; i++)
+            {
+                var nonce = (byte[])baseNonce.Clone();
+                BinaryPrimitives.WriteUInt64LittleEndian(nonce.AsSpan(4),
+                    BinaryPrimitives.ReadUInt64LittleEndian(nonce.AsSpan(4)) ^ unchecked(firstCounter + (ulong)i));
+                var expectedCiphertext = new byte[items[i].Input.Length];
+                var expectedTag = new byte[16];
+                aesGcmSiv.Encrypt(nonce, items[i].Input, expectedCiphertext, expectedTag);
+                Assert.Equal(expectedCiphertext, items[i].Output);
+                Assert.Equal(expectedTag, items[i].Tag);
+                Assert.Equal(i != 7, succeeded[i]);
+                if (i != 7)
+                    Assert.Equal(items[i].Input, decrypted[i].Output);
+            }
+        }
+
+        [Theory]
+        [InlineData(AesGcmSivImplementation.Native)]
+        [InlineData(AesGcmSivImplementation.Managed)]
+        public void EncryptBatchWithAssociatedData_ShouldMatchItemsCarryingTheSameAssociatedData(AesGcmSivImplementation implementation)
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey, implementation);
+            var sharedAad = new byte[300];
+            for (int i = 0; i < sharedAad.Length; i++) sharedAad[i] = (byte)i;
+            var shared = new AesGcmSivBatchItem[100];
+            var own = new AesGcmSivBatchItem[shared.Length];
+            for (int i = 0; i < shared.Length; i++)
+            {
+                var nonce = new byte[12];
+                BinaryPrimitives.WriteInt32LittleEndian(nonce, i);
+                var message = new byte[i % 20];
+                for (int j = 0; j < message.Length; j++) message[j] = (byte)(i + j);
+                shared[i] = new AesGcmSivBatchItem(nonce, message, new byte[message.Length], new byte[16]);
+                own[i] = new AesGcmSivBatchItem(nonce, message, new byte[message.Length], new byte[16], sharedAad);
+            }
+
+            // Act
+            aesGcmSiv.EncryptBatchWithAssociatedData(shared, sharedAad);
+            aesGcmSiv.EncryptBatch(own);
+            var decrypted = new AesGcmSivBatchItem[shared.Length];
+            for (int i = 0; i < shared.Length; i++)
+            {
+                decrypted[i] = new AesGcmSivBatchItem(shared[i].Nonce, shared[i].Output, new byte[shared[i].Input.Length], shared[i].Tag);
+            }
+            var succeeded = new bool[shared.Length];
+            int failures = aesGcmSiv.DecryptBatchWithAssociatedData(decrypted, sharedAad, succeeded);
+            var wrongAad = (byte[])sharedAad.Clone();
+            wrongAad[^1] ^= 1;
+            int wrongFailures = aesGcmSiv.DecryptBatchWithAssociatedData(decrypted, wrongAad, new bool[shared.Length]);
+
+            // Assert
+            Assert.Equal(0, failures);
+            Assert.Equal(shared.Length, wrongFailures);
+            for (int i = 0; i < shared.Length; i++)
+            {
+                Assert.Equal(own[i].Output, shared[i].Output);
+                Assert.Equal(own[i].Tag, shared[i].Tag);
+                Assert.True(succeeded[i]);
+            }
+        }
+
+        [Theory]
+        [InlineData(AesGcmSivImplementation.Native)]
+        [InlineData(AesGcmSivImplementation.Managed)]
+        public void ReencryptBatch_ShouldMatchEncryptingUnderTheNewKeyAndKeepForgedItems(AesGcmSivImplementation implementation)
+        {
+            // Arrange
+            var newKeyBytes = new byte[32];
+            for (int i = 0; i < newKeyBytes.Length; i++) newKeyBytes[i] = (byte)(0xa0 + i);
+            using var oldKey = new System.Security.Cryptography.AesGcmSiv(_testKey, implementation);
+            using var newKey = new System.Security.Cryptography.AesGcmSiv(newKeyBytes, implementation);
+            var items = new AesGcmSivBatchItem[50];
+            var expected = new AesGcmSivBatchItem[items.Length];
+            var newNonces = new byte[items.Length * 12];
+            for (int i = 0; i < items.Length; i++)
+            {
+                var nonce = new byte[12];
+                BinaryPrimitives.WriteInt32LittleEndian(nonce, i);
+                BinaryPrimitives.WriteInt32LittleEndian(newNonces.AsSpan(i * 12), i + 1000);
+                var message = new byte[i * 7];
+                for (int j = 0; j < message.Length; j++) message[j] = (byte)(i + j);
+                var aad = new byte[] { (byte)i };
+                var ciphertext = new byte[message.Length];
+                var tag = new byte[16];
+                oldKey.Encrypt(nonce, message, ciphertext, tag, aad);
+                items[i] = new AesGcmSivBatchItem(nonce, ciphertext, new byte[message.Length], tag, aad);
+                expected[i] = new AesGcmSivBatchItem(newNonces.AsSpan(i * 12, 12).ToArray(), message, new byte[message.Length], new byte[16], aad);
+            }
+            newKey.EncryptBatch(expected);
+            var forged = (byte[])items[3].Tag.Clone();
+            forged[0] ^= 1;
+            items[3] = new AesGcmSivBatchItem(items[3].Nonce, items[3].Input, items[3].Output, forged, items[3].AssociatedData);
+
+            var single = (byte[])items[10].Input.Clone();
+            var singleTag = (byte[])items[10].Tag.Clone();
+
+            // Act
+            var succeeded = new bool[items.Length];
+            int failures = oldKey.ReencryptBatch(newKey, items, newNonces, succeeded);
+            var untouched = new byte[16];
+            bool singleOk = oldKey.TryReencrypt(newKey, items[10].Nonce, newNonces.AsSpan(120, 12), single, singleTag, single, singleTag, items[10].AssociatedData);
+            bool forgedOk = oldKey.TryReencrypt(newKey, items[3].Nonce, items[3].Nonce, items[3].Input, forged, new byte[items[3].Input.Length], untouched, items[3].AssociatedData);
+
+            // Assert
+            Assert.Equal(1, failures);
+            Assert.True(singleOk);
+            Assert.False(forgedOk);
+            Assert.Equal(new byte[16], untouched);
+            Assert.Equal(expected[10].Output, single);
+            Assert.Equal(expected[10].Tag, singleTag);
+            for (int i = 0; i < items.Length; i++)
+            {
+                Assert.Equal(i != 3, succeeded[i]);
+                if (i == 3)
+                {
+                    Assert.Equal(new byte[items[3].Output.Length], items[3].Output);
+                    Assert.Equal(forged, items[3].Tag);
+                    continue;
+                }
+                Assert.Equal(expected[i].Output, items[i].Output);
+                Assert.Equal(expected[i].Tag, items[i].Tag);
+            }
+        }
+
+        [Theory]
+        [InlineData(AesGcmSivImplementation.Native)]
+        [InlineData(AesGcmSivImplementation.Managed)]
+        public void SealBase64Url_ShouldEncodeTheSealedMessageAndRejectAlteredTokens(AesGcmSivImplementation implementation)
+        {
+            // Arrange
+            const string alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey, implementation);
+            // 155 bytes sealed, so the token ends in a partial group
+            var message = new byte[127];
+            for (int i = 0; i < message.Length; i++) message[i] = (byte)(i * 3);
+            var aad = new byte[] { 1, 2, 3 };
+            var sealedData = new byte[message.Length + System.Security.Cryptography.AesGcmSiv.SealOverhead];
+            aesGcmSiv.Seal(_testNonce, message, sealedData, aad);
+
+            // Act
+            var token = new byte[System.Security.Cryptography.AesGcmSiv.GetBase64UrlTokenLength(message.Length)];
+            int written = aesGcmSiv.SealBase64Url(_testNonce, message, token, aad);
+            var randomToken = new byte[token.Length];
+            aesGcmSiv.SealBase64UrlWithRandomNonce(message, randomToken, aad);
+            var opened = new byte[message.Length];
+            bool openedOk = aesGcmSiv.TryOpenBase64Url(token, opened, out int openedLength, aad);
+            var openedRandom = new byte[message.Length];
+            bool randomOk = aesGcmSiv.TryOpenBase64Url(randomToken, openedRandom, out _, aad);
+
+            var tampered = (byte[])token.Clone();
+            tampered[40] = (byte)(tampered[40] == 'A' ? 'B' : 'A');
+            var tamperedOutput = new byte[message.Length];
+            bool tamperedOk = aesGcmSiv.TryOpenBase64Url(tampered, tamperedOutput, out int tamperedLength, aad);
+            var padded = new byte[token.Length + 1];
+            token.CopyTo(padded, 0);
+            padded[^1] = (byte)'=';
+            // Sized by length alone the padded token holds one more byte, so room for it is needed
+            // for the padding itself to be what rejects it
+            bool paddedOk = aesGcmSiv.TryOpenBase64Url(padded, new byte[message.Length + 1], out _, aad);
+            var strayBits = (byte[])token.Clone();
+            strayBits[^1] = (byte)alphabet[alphabet.IndexOf((char)token[^1]) | 1];
+            bool strayBitsOk = aesGcmSiv.TryOpenBase64Url(strayBits, new byte[message.Length], out _, aad);
+
+            // Assert
+            Assert.Equal(token.Length, written);
+            Assert.Equal(System.Buffers.Text.Base64Url.EncodeToString(sealedData), System.Text.Encoding.ASCII.GetString(token));
+            Assert.True(openedOk);
+            Assert.Equal(message.Length, openedLength);
+            Assert.Equal(message, opened);
+            Assert.True(randomOk);
+            Assert.Equal(message, openedRandom);
+            Assert.NotEqual(token, randomToken);
+            Assert.False(tamperedOk);
+            Assert.Equal(0, tamperedLength);
+            Assert.Equal(new byte[message.Length], tamperedOutput);
+            Assert.False(paddedOk);
+            Assert.False(strayBitsOk);
+        }
+
+        [Theory]
+        [InlineData(AesGcmSivImplementation.Native)]
+        [InlineData(AesGcmSivImplementation.Managed)]
+        public void EncryptPages_ShouldMatchCounterBatchWithHeaderAsAssociatedData(AesGcmSivImplementation implementation)
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey, implementation);
+            var baseNonce = new byte[] { 0x0f, 0x1e, 0x2d, 0x3c, 0, 0, 0, 0, 0, 0, 0, 0 };
+            const int pageSize = 4096, headerSize = 24, pageCount = 40;
+            const ulong firstPage = 1000;
+            var pages = new byte[pageSize * pageCount];
+            for (int i = 0; i < pages.Length; i++) pages[i] = (byte)(i * 31);
+            var original = (byte[])pages.Clone();
+            var tags = new byte[16 * pageCount];
+
+            // Act
+            aesGcmSiv.EncryptPages(pages, pageSize, headerSize, baseNonce, firstPage, tags);
+            var encrypted = (byte[])pages.Clone();
+            pages[5 * pageSize] ^= 1;  // a header is authenticated too
+            var succeeded = new bool[pageCount];
+            int failures = aesGcmSiv.DecryptPages(pages, pageSize, headerSize, baseNonce, firstPage, tags, succeeded);
+
+            // Assert
+            Assert.Equal(1, failures);
+            for (int i = 0; i < pageCount; i++)
+            {
+                var header = original.AsSpan(i * pageSize, headerSize).ToArray();
+                var body = original.AsSpan(i * pageSize + headerSize, pageSize - headerSize).ToArray();
+                var nonce = (byte[])baseNonce.Clone();
+                BinaryPrimitives.WriteUInt64LittleEndian(nonce.AsSpan(4), firstPage + (ulong)i);
+                var expectedCiphertext = new byte[body.Length];
+                var expectedTag = new byte[16];
+                aesGcmSiv.Encrypt(nonce, body, expectedCiphertext, expectedTag, header);
+                Assert.Equal(header, encrypted.AsSpan(i * pageSize, headerSize).ToArray());
+                Assert.Equal(expectedCiphertext, encrypted.AsSpan(i * pageSize + headerSize, body.Length).ToArray());
+                Assert.Equal(expectedTag, tags.AsSpan(i * 16, 16).ToArray());
+                Assert.Equal(i != 5, succeeded[i]);
+                if (i != 5)
+                    Assert.Equal(body, pages.AsSpan(i * pageSize + headerSize, body.Length).ToArray());
+            }
+            Assert.Throws<ArgumentException>(() =>
+                aesGcmSiv.EncryptPages(new byte[pageSize + 1], pageSize, headerSize, baseNonce, 0, tags));
+        }
+
+        [Theory]
+        [InlineData(AesGcmSivImplementation.Native)]
+        [InlineData(AesGcmSivImplementation.Managed)]
+        public void EncryptColumn_ShouldMatchCounterBatchAtTheSameOffsets(AesGcmSivImplementation implementation)
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey, implementation);
+            var baseNonce = new byte[] { 0x0f, 0x1e, 0x2d, 0x3c, 0, 0, 0, 0, 0, 0, 0, 0 };
+            const ulong firstRow = 500;
+            const int rows = 300;
+            var offsets = new int[rows + 1];
+            offsets[0] = 3;  // a sliced column need not start at 0
+            for (int i = 0; i < rows; i++) offsets[i + 1] = offsets[i] + i * 7 % 50;
+            var values = new byte[offsets[rows]];
+            for (int i = 0; i < values.Length; i++) values[i] = (byte)(i * 13);
+            var ciphertext = new byte[values.Length];
+            var tags = new byte[16 * rows];
+
+            // Act
+            aesGcmSiv.EncryptColumn(values, offsets, ciphertext, tags, baseNonce, firstRow);
+            var decrypted = (byte[])ciphertext.Clone();
+            tags[16 * 42] ^= 1;
+            var succeeded = new bool[rows];
+            int failures = aesGcmSiv.DecryptColumn(
+                decrypted, Array.ConvertAll(offsets, o => (long)o), tags, decrypted, baseNonce, firstRow, succeeded);
+
+            // Assert
+            Assert.Equal(1, failures);
+            for (int i = 0; i < rows; i++)
+            {
+                var value = values.AsSpan(offsets[i], offsets[i + 1] - offsets[i]).ToArray();
+                var nonce = (byte[])baseNonce.Clone();
+                BinaryPrimitives.WriteUInt64LittleEndian(nonce.AsSpan(4), firstRow + (ulong)i);
+                var expectedCiphertext = new byte[value.Length];
+                var expectedTag = new byte[16];
+                aesGcmSiv.Encrypt(nonce, value, expectedCiphertext, expectedTag);
+                Assert.Equal(expectedCiphertext, ciphertext.AsSpan(offsets[i], value.Length).ToArray());
+                if (i != 42)
+                    Assert.Equal(expectedTag, tags.AsSpan(i * 16, 16).ToArray());
+                Assert.Equal(i != 42, succeeded[i]);
+                if (i != 42)
+                    Assert.Equal(value, decrypted.AsSpan(offsets[i], value.Length).ToArray());
+            }
+            offsets[10] = offsets[9] - 1;
+            Assert.Throws<ArgumentException>(() =>
+                aesGcmSiv.EncryptColumn(values, offsets, ciphertext, tags, baseNonce, firstRow));
+        }
+
+        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+        private delegate void ArrowReleaseCallback(IntPtr self);
+
+        [Fact]
+        public void EncryptArrowColumn_ShouldMatchEncryptColumnWithTagsInAStructChild()
+        {
+            // Arrange: a utf8 column sliced to its last three values, as
+            // ArrowSchema (72 bytes) and ArrowArray (80 bytes) structures
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var baseNonce = new byte[] { 7, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+            byte[] values = System.Text.Encoding.UTF8.GetBytes("skipalphabetagamma");
+            int[] offsets = { 0, 4, 9, 13, 18 };
+            int[] slice = { 4, 9, 13, 18 };
+            var expected = new byte[values.Length];
+            var expectedTags = new byte[3 * 16];
+            aesGcmSiv.EncryptColumn(values, slice, expected, expectedTags, baseNonce, 40);
+
+            ArrowReleaseCallback notReleased = _ => { };
+            var pinnedValues = GCHandle.Alloc(values, GCHandleType.Pinned);
+            var pinnedOffsets = GCHandle.Alloc(offsets, GCHandleType.Pinned);
+            IntPtr format = Marshal.StringToHGlobalAnsi("u");
+            IntPtr buffers = Marshal.AllocHGlobal(3 * IntPtr.Size);
+            IntPtr schema = Marshal.AllocHGlobal(72);
+            IntPtr array = Marshal.AllocHGlobal(80);
+            IntPtr schemaOut = Marshal.AllocHGlobal(72);
+            IntPtr arrayOut = Marshal.AllocHGlobal(80);
+            try
+            {
+                Marshal.Copy(new byte[72], 0, schema, 72);
+                Marshal.Copy(new byte[80], 0, array, 80);
+                IntPtr release = Marshal.GetFunctionPointerForDelegate(notReleased);
+                Marshal.WriteIntPtr(schema, 0, format);
+                Marshal.WriteIntPtr(schema, 56, release);
+                Marshal.WriteIntPtr(buffers, 0, IntPtr.Zero);
+                Marshal.WriteIntPtr(buffers, IntPtr.Size, pinnedOffsets.AddrOfPinnedObject());
+                Marshal.WriteIntPtr(buffers, 2 * IntPtr.Size, pinnedValues.AddrOfPinnedObject());
+                Marshal.WriteInt64(array, 0, 3);   // length
+                Marshal.WriteInt64(array, 16, 1);  // offset
+                Marshal.WriteInt64(array, 24, 3);  // n_buffers
+                Marshal.WriteIntPtr(array, 40, buffers);
+                Marshal.WriteIntPtr(array, 64, release);
+
+                // Act
+                aesGcmSiv.EncryptArrowColumn(schema, array, baseNonce, 40, AesGcmSivArrowTagLayout.Struct, schemaOut, arrayOut);
+
+                // Assert: ciphertexts rebased to offset 0, tags in the second child
+                Assert.Equal("+s", Marshal.PtrToStringAnsi(Marshal.ReadIntPtr(schemaOut, 0)));
+                Assert.Equal(3, Marshal.ReadInt64(arrayOut, 0));
+                IntPtr children = Marshal.ReadIntPtr(arrayOut, 48);
+                IntPtr ciphertextBuffers = Marshal.ReadIntPtr(Marshal.ReadIntPtr(children, 0), 40);
+                IntPtr tagBuffers = Marshal.ReadIntPtr(Marshal.ReadIntPtr(children, IntPtr.Size), 40);
+                var outOffsets = new int[4];
+                var outValues = new byte[14];
+                var outTags = new byte[3 * 16];
+                Marshal.Copy(Marshal.ReadIntPtr(ciphertextBuffers, IntPtr.Size), outOffsets, 0, 4);
+                Marshal.Copy(Marshal.ReadIntPtr(ciphertextBuffers, 2 * IntPtr.Size), outValues, 0, 14);
+                Marshal.Copy(Marshal.ReadIntPtr(tagBuffers, IntPtr.Size), outTags, 0, 48);
+                Assert.Equal(new[] { 0, 5, 9, 14 }, outOffsets);
+                Assert.Equal(expected.AsSpan(4, 14).ToArray(), outValues);
+                Assert.Equal(expectedTags, outTags);
+
+                Marshal.GetDelegateForFunctionPointer<ArrowReleaseCallback>(
+                    Marshal.ReadIntPtr(arrayOut, 64))(arrayOut);
+                Marshal.GetDelegateForFunctionPointer<ArrowReleaseCallback>(
+                    Marshal.ReadIntPtr(schemaOut, 56))(schemaOut);
+                Assert.Equal(IntPtr.Zero, Marshal.ReadIntPtr(arrayOut, 64));
+                Assert.Equal(IntPtr.Zero, Marshal.ReadIntPtr(schemaOut, 56));
+            }
+            finally
+            {
+                Marshal.FreeHGlobal(arrayOut);
+                Marshal.FreeHGlobal(schemaOut);
+                Marshal.FreeHGlobal(array);
+                Marshal.FreeHGlobal(schema);
+                Marshal.FreeHGlobal(buffers);
+                Marshal.FreeHGlobal(format);
+                pinnedOffsets.Free();
+                pinnedValues.Free();
+                GC.KeepAlive(notReleased);
+            }
+        }
+
+        [Theory]
+        [InlineData(AesGcmSivImplementation.Native)]
+        [InlineData(AesGcmSivImplementation.Managed)]
+        public void EncryptRegistered_ShouldSealMessagesInPlaceInPoolBuffers(AesGcmSivImplementation implementation)
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey, implementation);
+            using var pool = new AesGcmSivBufferPool(8, 1000, useNativeMemory: implementation == AesGcmSivImplementation.Native);
+            var items = new AesGcmSivRegisteredItem[pool.BufferCount];
+            var plaintexts = new byte[items.Length][];
+            for (int i = 0; i < items.Length; i++)
+            {
+                // nonce || associated data || message || tag, all in buffer i
+                Assert.True(pool.TryRent(out int index));
+                Span<byte> buffer = pool.GetSpan(index);
+                plaintexts[i] = new byte[i * 97];
+                for (int j = 0; j < plaintexts[i].Length; j++) plaintexts[i][j] = (byte)(i + j * 7);
+                _testNonce.CopyTo(buffer);
+                buffer[0] = (byte)i;
+                buffer.Slice(12, 8).Fill((byte)i);
+                plaintexts[i].CopyTo(buffer.Slice(20));
+                items[i] = new AesGcmSivRegisteredItem(
+                    index, nonceOffset: 0, inputOffset: 20, length: plaintexts[i].Length,
+                    outputBuffer: index, outputOffset: 20, tagOffset: 20 + plaintexts[i].Length,
+                    associatedDataOffset: 12, associatedDataLength: 8);
+            }
+
+            // Act
+            aesGcmSiv.EncryptRegistered(pool, items);
+            var sealedBuffers = new byte[items.Length][];
+            for (int i = 0; i < items.Length; i++) sealedBuffers[i] = pool.GetSpan(items[i].InputBuffer).ToArray();
+            pool.GetSpan(items[3].InputBuffer)[12] ^= 1;  // the associated data is authenticated too
+            var succeeded = new bool[items.Length];
+            int failures = aesGcmSiv.DecryptRegistered(pool, items, succeeded);
+
+            // Assert
+            Assert.Equal(1, failures);
+            Assert.False(pool.TryRent(out _));
+            for (int i = 0; i < items.Length; i++)
+            {
+                byte[] sealedBuffer = sealedBuffers[i];
+                int length = plaintexts[i].Length;
+                var expectedCiphertext = new byte[length];
+                var expectedTag = new byte[16];
+                aesGcmSiv.Encrypt(sealedBuffer.AsSpan(0, 12), plaintexts[i], expectedCiphertext, expectedTag, sealedBuffer.AsSpan(12, 8));
+                Assert.Equal(expectedCiphertext, sealedBuffer.AsSpan(20, length).ToArray());
+                Assert.Equal(expectedTag, sealedBuffer.AsSpan(20 + length, 16).ToArray());
+                Assert.Equal(i != 3, succeeded[i]);
+                Assert.Equal(i != 3 ? plaintexts[i] : new byte[length], pool.GetSpan(items[i].InputBuffer).Slice(20, length).ToArray());
+                pool.Return(items[i].InputBuffer);
+            }
+            Assert.Throws<InvalidOperationException>(() => pool.Return(0));
+            var pastTheEnd = new AesGcmSivRegisteredItem(0, 0, 900, 101, 0, 900, 0);
+            Assert.Throws<ArgumentException>(() => aesGcmSiv.EncryptRegistered(pool, new[] { pastTheEnd }));
+        }
+
+        [Theory]
+        [InlineData(0)]
+        [InlineData(-2)]
+        public void MaxDegreeOfParallelism_WithInvalidValue_ShouldThrowArgumentOutOfRangeException(int value)
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+
+            // Act & Assert
+            Assert.Throws<ArgumentOutOfRangeException>(() => aesGcmSiv.MaxDegreeOfParallelism = value);
+        }
+
+        [Fact]
+        public void Encrypt_InPlace_ShouldMatchSeparateBuffers()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var expectedCiphertext = new byte[_testPlaintext.Length];
+            var expectedTag = new byte[16];
+            aesGcmSiv.Encrypt(_testNonce, _testPlaintext, expectedCiphertext, expectedTag, _testAssociatedData);
+            var buffer = (byte[])_testPlaintext.Clone();
+            var tag = new byte[16];
+
+            // Act
+            aesGcmSiv.Encrypt(_testNonce, buffer.AsSpan(), tag, _testAssociatedData);
+
+            // Assert
+            Assert.Equal(expectedCiphertext, buffer);
+            Assert.Equal(expectedTag, tag);
+        }
+
+        [Theory]
+        [InlineData(0, 0x2D06800538D394C2UL)]
+        [InlineData(5000, 0xB418500FC42320EEUL)]
+        public void EncryptHashed_ShouldMatchEncryptAndReturnXxh3OfPlaintext(int length, ulong expectedHash)
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var plaintext = new byte[length];
+            for (int i = 0; i < plaintext.Length; i++)
+                plaintext[i] = (byte)(i % 251);
+            var expectedCiphertext = new byte[length];
+            var expectedTag = new byte[16];
+            aesGcmSiv.Encrypt(_testNonce, plaintext, expectedCiphertext, expectedTag, _testAssociatedData);
+            var ciphertext = new byte[length];
+            var tag = new byte[16];
+
+            // Act
+            ulong hash = aesGcmSiv.EncryptHashed(_testNonce, plaintext, ciphertext, tag, _testAssociatedData);
+
+            // Assert
+            Assert.Equal(expectedHash, hash);
+            Assert.Equal(expectedCiphertext, ciphertext);
+            Assert.Equal(expectedTag, tag);
+        }
+
+        [Fact]
+        public void EncryptDecrypt_InPlaceOnSlice_ShouldRoundTripWithoutTouchingNeighbours()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var region = new byte[_testPlaintext.Length + 8];
+            _testPlaintext.CopyTo(region, 4);
+            var tag = new byte[16];
+
+            // Act
+            aesGcmSiv.Encrypt(_testNonce, region.AsSpan(4, _testPlaintext.Length), tag, _testAssociatedData);
+            aesGcmSiv.Decrypt(_testNonce, region.AsSpan(4, _testPlaintext.Length), tag, _testAssociatedData);
+
+            // Assert
+            Assert.Equal(_testPlaintext, region.AsSpan(4, _testPlaintext.Length).ToArray());
+            Assert.Equal(new byte[4], region.AsSpan(0, 4).ToArray());
+            Assert.Equal(new byte[4], region.AsSpan(4 + _testPlaintext.Length).ToArray());
+        }
+
+        [Fact]
+        public void Decrypt_InPlaceWithTamperedCiphertext_ShouldThrowAndClearBuffer()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var buffer = (byte[])_testPlaintext.Clone();
+            var tag = new byte[16];
+            aesGcmSiv.Encrypt(_testNonce, buffer.AsSpan(), tag, _testAssociatedData);
+            buffer[0] ^= 1;
+
+            // Act & Assert
+            Assert.Throws<CryptographicException>(() =>
+                aesGcmSiv.Decrypt(_testNonce, buffer.AsSpan(), tag, _testAssociatedData));
+            Assert.True(buffer.All(b => b == 0));
+        }
+
         [Fact]
         public void Encrypt_WithNullNonce_ShouldThrowArgumentNullException()
         {
@@ -259,6 +991,117 @@ namespace AesGcmSiv.Tests
                 aesGcmSiv.Decrypt(_testNonce, new byte[64], new byte[16], new byte[64]));
         }
 
+        [Fact]
+        public void MaxDegreeOfParallelism_AfterDispose_ShouldThrowObjectDisposedException()
+        {
+            // Arrange
+            var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            aesGcmSiv.Dispose();
+
+            // Act & Assert
+            Assert.Throws<ObjectDisposedException>(() => aesGcmSiv.MaxDegreeOfParallelism = 2);
+        }
+
+        [Fact]
+        public void UseThreadPool_OnceSharedPoolExists_ShouldRejectChange()
+        {
+            // Arrange - enabling parallelism creates the shared pool if nothing has yet
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey)
+            {
+                MaxDegreeOfParallelism = 2
+            };
+            bool current = System.Security.Cryptography.AesGcmSiv.UseThreadPool;
+
+            // Act & Assert
+            System.Security.Cryptography.AesGcmSiv.UseThreadPool = current;
+            Assert.Throws<InvalidOperationException>(() => System.Security.Cryptography.AesGcmSiv.UseThreadPool = !current);
+        }
+
+        [Fact]
+        public void Encrypt_ReusingOneInstance_ShouldMatchFreshInstances()
+        {
+            // Arrange
+            using var shared = new System.Security.Cryptography.AesGcmSiv(_testKey);
+
+            foreach (int length in new[] { 0, 1, 16, 255, 1000, 64 })
+            {
+                var plaintext = new byte[length];
+                for (int i = 0; i < plaintext.Length; i++) plaintext[i] = (byte)(i * 7);
+                var ciphertext = new byte[length];
+                var tag = new byte[16];
+                var expected = new byte[length];
+                var expectedTag = new byte[16];
+
+                // Act
+                shared.Encrypt(_testNonce, plaintext, ciphertext, tag, _testAssociatedData);
+                using (var fresh = new System.Security.Cryptography.AesGcmSiv(_testKey))
+                {
+                    fresh.Encrypt(_testNonce, plaintext, expected, expectedTag, _testAssociatedData);
+                }
+
+                // Assert
+                Assert.Equal(expected, ciphertext);
+                Assert.Equal(expectedTag, tag);
+            }
+        }
+
+        [Fact]
+        public void EncryptDecrypt_SharedInstanceAcross64Threads_ShouldMatchSerialResults()
+        {
+            // Arrange - expected outputs computed on one thread, one message per length
+            const int threadCount = 64;
+            const int iterations = 200;
+            using var shared = new System.Security.Cryptography.AesGcmSiv(_testKey) { SmallMessageFastPath = true };
+            var plaintexts = new byte[97][];
+            var expectedCiphertexts = new byte[plaintexts.Length][];
+            var expectedTags = new byte[plaintexts.Length][];
+            for (int m = 0; m < plaintexts.Length; m++)
+            {
+                plaintexts[m] = new byte[m * 5];
+                for (int i = 0; i < plaintexts[m].Length; i++) plaintexts[m][i] = (byte)(i + m);
+                expectedCiphertexts[m] = new byte[plaintexts[m].Length];
+                expectedTags[m] = new byte[16];
+                shared.Encrypt(_testNonce, plaintexts[m], expectedCiphertexts[m], expectedTags[m], _testAssociatedData);
+            }
+            int failures = 0;
+            using var start = new Barrier(threadCount);
+
+            // Act
+            var threads = new Thread[threadCount];
+            for (int t = 0; t < threadCount; t++)
+            {
+                int seed = t;
+                threads[t] = new Thread(() =>
+                {
+                    var ciphertext = new byte[plaintexts[^1].Length];
+                    var decrypted = new byte[ciphertext.Length];
+                    var tag = new byte[16];
+                    start.SignalAndWait();
+                    for (int i = 0; i < iterations; i++)
+                    {
+                        int m = (seed * 31 + i * 7) % plaintexts.Length;
+                        int length = plaintexts[m].Length;
+                        shared.Encrypt(_testNonce, plaintexts[m], ciphertext.AsSpan(0, length), tag, _testAssociatedData);
+                        if (!ciphertext.AsSpan(0, length).SequenceEqual(expectedCiphertexts[m]) ||
+                            !tag.AsSpan().SequenceEqual(expectedTags[m]))
+                        {
+                            Interlocked.Increment(ref failures);
+                        }
+                        shared.Decrypt(_testNonce, expectedCiphertexts[m], expectedTags[m], decrypted.AsSpan(0, length), _testAssociatedData);
+                        if (!decrypted.AsSpan(0, length).SequenceEqual(plaintexts[m]))
+                        {
+                            Interlocked.Increment(ref failures);
+                        }
+                    }
+                });
+                threads[t].Start();
+            }
+            foreach (var thread in threads) thread.Join();
+
+            // Assert
+            Assert.Equal(0, failures);
+        }
+
         [Fact]
         public void Encrypt_Deterministic_WithSameInputs_ShouldProduceSameOutput()
         {
@@ -278,5 +1121,2429 @@ namespace AesGcmSiv.Tests
             Assert.Equal(ciphertext1, ciphertext2);
             Assert.Equal(tag1, tag2);
         }
+
+        [Fact]
+        public void Encrypt_WithSegments_ShouldMatchContiguousEncrypt()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var plaintext = new byte[1000];
+            for (int i = 0; i < plaintext.Length; i++) plaintext[i] = (byte)(i * 7);
+            var expected = new byte[plaintext.Length];
+            var expectedTag = new byte[16];
+            aesGcmSiv.Encrypt(_testNonce, plaintext, expected, expectedTag, _testAssociatedData);
+
+            var input = new List<ArraySegment<byte>>
+            {
+                new ArraySegment<byte>(plaintext, 0, 5),
+                new ArraySegment<byte>(plaintext, 5, 0),
+                new ArraySegment<byte>(plaintext, 5, 300),
+                new ArraySegment<byte>(plaintext, 305, 695),
+            };
+            var ciphertext = new byte[plaintext.Length + 10];
+            var output = new List<ArraySegment<byte>>
+            {
+                new ArraySegment<byte>(ciphertext, 500, 510),
+                new ArraySegment<byte>(ciphertext, 0, 490),
+            };
+            var aad = new List<ArraySegment<byte>>
+            {
+                new ArraySegment<byte>(_testAssociatedData, 0, 3),
+                new ArraySegment<byte>(_testAssociatedData, 3, _testAssociatedData.Length - 3),
+            };
+            var tag = new byte[16];
+
+            // Act
+            aesGcmSiv.Encrypt(_testNonce, input, output, tag, aad);
+
+            // Assert - output segments are filled in order
+            Assert.Equal(expectedTag, tag);
+            Assert.Equal(expected.AsSpan(0, 510).ToArray(), ciphertext.AsSpan(500, 510).ToArray());
+            Assert.Equal(expected.AsSpan(510).ToArray(), ciphertext.AsSpan(0, 490).ToArray());
+        }
+
+        [Fact]
+        public void Decrypt_WithSegments_ShouldScatterPlaintextAndRejectTampering()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var ciphertext = new byte[_testPlaintext.Length];
+            var tag = new byte[16];
+            aesGcmSiv.Encrypt(_testNonce, _testPlaintext, ciphertext, tag, _testAssociatedData);
+
+            var first = new byte[7];
+            var second = new byte[_testPlaintext.Length];
+            var input = new List<ArraySegment<byte>> { new ArraySegment<byte>(ciphertext) };
+            var output = new List<ArraySegment<byte>> { new ArraySegment<byte>(first), new ArraySegment<byte>(second) };
+            var aad = new List<ArraySegment<byte>> { new ArraySegment<byte>(_testAssociatedData) };
+
+            // Act
+            aesGcmSiv.Decrypt(_testNonce, input, tag, output, aad);
+
+            // Assert
+            var recovered = first.Concat(second.Take(_testPlaintext.Length - first.Length)).ToArray();
+            Assert.Equal(_testPlaintext, recovered);
+
+            ciphertext[0] ^= 1;
+            Assert.Throws<CryptographicException>(() => aesGcmSiv.Decrypt(_testNonce, input, tag, output, aad));
+            Assert.True(first.All(b => b == 0));
+        }
+
+        [Fact]
+        public void Encrypt_WithSegmentsAndSmallOutput_ShouldThrowArgumentException()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var input = new List<ArraySegment<byte>> { new ArraySegment<byte>(new byte[32]) };
+            var output = new List<ArraySegment<byte>> { new ArraySegment<byte>(new byte[16]), new ArraySegment<byte>(new byte[15]) };
+
+            // Act & Assert
+            Assert.Throws<ArgumentException>(() => aesGcmSiv.Encrypt(_testNonce, input, output, new byte[16]));
+        }
+
+        [Fact]
+        public void Seal_ShouldProduceNonceCiphertextAndTag()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var ciphertext = new byte[_testPlaintext.Length];
+            var tag = new byte[16];
+            aesGcmSiv.Encrypt(_testNonce, _testPlaintext, ciphertext, tag, _testAssociatedData);
+            var sealedData = new byte[_testPlaintext.Length + System.Security.Cryptography.AesGcmSiv.SealOverhead];
+
+            // Act
+            int written = aesGcmSiv.Seal(_testNonce, _testPlaintext, sealedData, _testAssociatedData);
+
+            // Assert
+            Assert.Equal(sealedData.Length, written);
+            Assert.Equal(_testNonce.Concat(ciphertext).Concat(tag).ToArray(), sealedData);
+        }
+
+        [Fact]
+        public void Open_ShouldRoundTripAndRejectTampering()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var sealedData = new byte[_testPlaintext.Length + System.Security.Cryptography.AesGcmSiv.SealOverhead];
+            aesGcmSiv.Seal(_testNonce, _testPlaintext, sealedData, _testAssociatedData);
+            var plaintext = new byte[_testPlaintext.Length];
+
+            // Act
+            int written = aesGcmSiv.Open(sealedData, plaintext, _testAssociatedData);
+
+            // Assert
+            Assert.Equal(_testPlaintext.Length, written);
+            Assert.Equal(_testPlaintext, plaintext);
+
+            sealedData[5] ^= 1;  // part of the nonce
+            Assert.Throws<CryptographicException>(() => aesGcmSiv.Open(sealedData, plaintext, _testAssociatedData));
+            Assert.True(plaintext.All(b => b == 0));
+        }
+
+        [Fact]
+        public void BufferWriterOverloads_ShouldWriteExactlyIntoTheWriter()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var ciphertext = new byte[_testPlaintext.Length];
+            var tag = new byte[16];
+            aesGcmSiv.Encrypt(_testNonce, _testPlaintext, ciphertext, tag, _testAssociatedData);
+            var writer = new System.Buffers.ArrayBufferWriter<byte>();
+
+            // Act
+            int encrypted = aesGcmSiv.Encrypt(_testNonce, _testPlaintext, writer, _testAssociatedData);
+            int sealedLength = aesGcmSiv.Seal(_testNonce, _testPlaintext, writer, _testAssociatedData);
+
+            // Assert
+            Assert.Equal(_testPlaintext.Length + 16, encrypted);
+            Assert.Equal(_testPlaintext.Length + System.Security.Cryptography.AesGcmSiv.SealOverhead, sealedLength);
+            Assert.Equal(ciphertext.Concat(tag).Concat(_testNonce).Concat(ciphertext).Concat(tag).ToArray(), writer.WrittenSpan.ToArray());
+
+            var plaintext = new System.Buffers.ArrayBufferWriter<byte>();
+            Assert.Equal(_testPlaintext.Length, aesGcmSiv.Open(writer.WrittenSpan.Slice(encrypted), plaintext, _testAssociatedData));
+            Assert.Equal(_testPlaintext, plaintext.WrittenSpan.ToArray());
+
+            // A forged message leaves the writer where it was
+            byte[] forged = writer.WrittenSpan.Slice(encrypted).ToArray();
+            forged[^1] ^= 1;
+            Assert.Throws<CryptographicException>(() => aesGcmSiv.Open(forged, plaintext, _testAssociatedData));
+            Assert.Equal(_testPlaintext.Length, plaintext.WrittenCount);
+        }
+
+        [Fact]
+        public void PooledOverloads_ShouldReturnExactlySizedMemoryAndRejectTampering()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var expected = new byte[_testPlaintext.Length + System.Security.Cryptography.AesGcmSiv.SealOverhead];
+            aesGcmSiv.Seal(_testNonce, _testPlaintext, expected, _testAssociatedData);
+
+            // Act
+            using var sealedMessage = aesGcmSiv.SealPooled(_testNonce, _testPlaintext, _testAssociatedData);
+            using var plaintext = aesGcmSiv.OpenPooled(sealedMessage.Memory.Span, _testAssociatedData);
+
+            // Assert
+            Assert.Equal(expected, sealedMessage.Memory.ToArray());
+            Assert.Equal(_testPlaintext, plaintext.Memory.ToArray());
+
+            byte[] forged = sealedMessage.Memory.ToArray();
+            forged[^1] ^= 1;
+            Assert.Throws<CryptographicException>(() => aesGcmSiv.OpenPooled(forged, _testAssociatedData));
+            Assert.Throws<ArgumentException>(() => aesGcmSiv.OpenPooled(new byte[System.Security.Cryptography.AesGcmSiv.SealOverhead - 1]));
+
+            // A disposed owner no longer hands out its memory
+            var disposed = aesGcmSiv.SealPooled(_testNonce, _testPlaintext);
+            disposed.Dispose();
+            Assert.Throws<ObjectDisposedException>(() => disposed.Memory);
+        }
+
+        [Fact]
+        public void SealWithRandomNonce_ShouldOpenAndUseFreshNonces()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var first = new byte[_testPlaintext.Length + System.Security.Cryptography.AesGcmSiv.SealOverhead];
+            var second = new byte[first.Length];
+            var plaintext = new byte[_testPlaintext.Length];
+
+            // Act
+            int written = aesGcmSiv.SealWithRandomNonce(_testPlaintext, first, _testAssociatedData);
+            aesGcmSiv.SealWithRandomNonce(_testPlaintext, second, _testAssociatedData);
+
+            // Assert
+            Assert.Equal(first.Length, written);
+            Assert.Equal(_testPlaintext.Length, aesGcmSiv.Open(first, plaintext, _testAssociatedData));
+            Assert.Equal(_testPlaintext, plaintext);
+            Assert.NotEqual(first.Take(12).ToArray(), second.Take(12).ToArray());
+
+            // Sealing in place, with the plaintext already at offset 12
+            var inPlace = new byte[first.Length];
+            _testPlaintext.CopyTo(inPlace, 12);
+            aesGcmSiv.SealWithRandomNonce(inPlace.AsSpan(12, _testPlaintext.Length), inPlace, _testAssociatedData);
+            Assert.Equal(_testPlaintext.Length, aesGcmSiv.Open(inPlace, plaintext, _testAssociatedData));
+            Assert.Equal(_testPlaintext, plaintext);
+        }
+
+        [Theory]
+        [InlineData(0)]
+        [InlineData(1)]
+        [InlineData(63)]
+        [InlineData(64)]
+        [InlineData(65)]
+        [InlineData(64 * 5)]
+        public async Task Stream_ShouldRoundTripAndRejectTruncation(int length)
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var plaintext = new byte[length];
+            for (int i = 0; i < plaintext.Length; i++) plaintext[i] = (byte)(i * 13);
+            var sealedData = new MemoryStream();
+
+            // Act: encrypt in uneven writes, decrypt synchronously in small reads
+            await using (var encryptor = new AesGcmSivStream(sealedData, aesGcmSiv, CryptoStreamMode.Write, 64, _testAssociatedData, leaveOpen: true))
+            {
+                for (int offset = 0; offset < length; offset += 37)
+                    await encryptor.WriteAsync(plaintext.AsMemory(offset, Math.Min(37, length - offset)));
+            }
+            byte[] encrypted = sealedData.ToArray();
+            var decrypted = new MemoryStream();
+            using (var decryptor = new AesGcmSivStream(new MemoryStream(encrypted), aesGcmSiv, CryptoStreamMode.Read, associatedData: _testAssociatedData))
+            {
+                var buffer = new byte[10];
+                int read;
+                while ((read = decryptor.Read(buffer, 0, buffer.Length)) > 0)
+                    decrypted.Write(buffer, 0, read);
+            }
+
+            // Assert
+            int chunks = Math.Max(1, (length + 63) / 64);  // an empty stream still has its last chunk
+            Assert.Equal(AesGcmSivStream.HeaderSize + length + chunks * 16, encrypted.Length);
+            Assert.Equal(plaintext, decrypted.ToArray());
+
+            // Dropping the last chunk, or a single byte, must not go unnoticed
+            int cut = length > 64 ? AesGcmSivStream.HeaderSize + 64 + 16 : encrypted.Length - 1;
+            using var truncated = new AesGcmSivStream(new MemoryStream(encrypted, 0, cut), aesGcmSiv, CryptoStreamMode.Read, associatedData: _testAssociatedData);
+            await Assert.ThrowsAsync<CryptographicException>(() => truncated.CopyToAsync(Stream.Null));
+        }
+
+        [Theory]
+        [InlineData(0)]
+        [InlineData(64 * 3)]
+        [InlineData(64 * 4 + 1)]
+        [InlineData(64 * 11 + 30)]
+        public async Task Stream_WithParallelChunks_ShouldRoundTrip(int length)
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var plaintext = new byte[length];
+            for (int i = 0; i < plaintext.Length; i++) plaintext[i] = (byte)(i * 11);
+            var sealedData = new MemoryStream();
+
+            // Act: a window of 4 chunks, filled by uneven writes
+            await using (var encryptor = new AesGcmSivStream(sealedData, aesGcmSiv, CryptoStreamMode.Write, 64, _testAssociatedData, leaveOpen: true) { ParallelChunks = 4 })
+            {
+                for (int offset = 0; offset < length; offset += 100)
+                    encryptor.Write(plaintext, offset, Math.Min(100, length - offset));
+                // Only a write starts the stream, and the empty case makes none
+                if (length > 0)
+                    Assert.Throws<InvalidOperationException>(() => encryptor.ParallelChunks = 2);
+            }
+            var decrypted = new MemoryStream();
+            using (var decryptor = new AesGcmSivStream(new MemoryStream(sealedData.ToArray()), aesGcmSiv, CryptoStreamMode.Read, associatedData: _testAssociatedData))
+                await decryptor.CopyToAsync(decrypted);
+
+            // Assert
+            int chunks = Math.Max(1, (length + 63) / 64);
+            Assert.Equal(AesGcmSivStream.HeaderSize + length + chunks * 16, sealedData.Length);
+            Assert.Equal(plaintext, decrypted.ToArray());
+        }
+
+        [Theory]
+        [InlineData(0)]
+        [InlineData(64 * 4)]
+        [InlineData(64 * 8)]
+        [InlineData(64 * 11 + 30)]
+        public async Task Stream_ReadAhead_ShouldRoundTripAndRejectTampering(int length)
+        {
+            // Arrange: windows of 4 chunks of 64 bytes, ending exactly on a window boundary for some lengths
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var plaintext = new byte[length];
+            new Random(139).NextBytes(plaintext);
+            var sealedData = new MemoryStream();
+            await using (var encryptor = new AesGcmSivStream(sealedData, aesGcmSiv, CryptoStreamMode.Write, 64, _testAssociatedData, leaveOpen: true))
+                await encryptor.WriteAsync(plaintext);
+            byte[] encrypted = sealedData.ToArray();
+
+            // Act: read in odd sizes, synchronously and asynchronously
+            var synchronous = new MemoryStream();
+            using (var decryptor = new AesGcmSivStream(new MemoryStream(encrypted), aesGcmSiv, CryptoStreamMode.Read, associatedData: _testAssociatedData) { ParallelChunks = 4 })
+            {
+                var buffer = new byte[37];
+                int read;
+                while ((read = decryptor.Read(buffer)) > 0)
+                    synchronous.Write(buffer, 0, read);
+                Assert.Throws<InvalidOperationException>(() => decryptor.ParallelChunks = 2);
+            }
+            var asynchronous = new MemoryStream();
+            await using (var decryptor = new AesGcmSivStream(new MemoryStream(encrypted), aesGcmSiv, CryptoStreamMode.Read, associatedData: _testAssociatedData) { ParallelChunks = 4 })
+                await decryptor.CopyToAsync(asynchronous);
+
+            // Assert
+            Assert.Equal(plaintext, synchronous.ToArray());
+            Assert.Equal(plaintext, asynchronous.ToArray());
+
+            // A flipped bit in the last chunk, or a dropped last byte, fails the read
+            byte[] tampered = (byte[])encrypted.Clone();
+            tampered[^1] ^= 1;
+            foreach (var input in new[] { new MemoryStream(tampered), new MemoryStream(encrypted, 0, encrypted.Length - 1) })
+            {
+                using var decryptor = new AesGcmSivStream(input, aesGcmSiv, CryptoStreamMode.Read, associatedData: _testAssociatedData) { ParallelChunks = 4 };
+                await Assert.ThrowsAsync<CryptographicException>(() => decryptor.CopyToAsync(Stream.Null));
+                Assert.Throws<CryptographicException>(() => decryptor.ReadByte());
+            }
+        }
+
+        [Fact]
+        public async Task Stream_UnderMemoryBudget_ShouldShrinkWindowsAndRoundTrip()
+        {
+            // Arrange: room for three 64-byte chunks and their tags, shared by eight uploads
+            // that each want a window of eight
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var plaintext = new byte[64 * 20 + 5];
+            for (int i = 0; i < plaintext.Length; i++) plaintext[i] = (byte)(i * 7);
+            AesGcmSivStream.MemoryBudget = 3 * (64 + 16);
+            try
+            {
+                // Act
+                byte[][] sealedData = await Task.WhenAll(Enumerable.Range(0, 8).Select(_ => Task.Run(() =>
+                {
+                    var output = new MemoryStream();
+                    using (var encryptor = new AesGcmSivStream(output, aesGcmSiv, CryptoStreamMode.Write, 64, _testAssociatedData, leaveOpen: true) { ParallelChunks = 8 })
+                    {
+                        for (int offset = 0; offset < plaintext.Length; offset += 100)
+                            encryptor.Write(plaintext, offset, Math.Min(100, plaintext.Length - offset));
+                    }
+                    return output.ToArray();
+                })));
+
+                // Assert
+                Assert.Equal(3 * (64 + 16), AesGcmSivStream.MemoryBudget);
+                foreach (byte[] encrypted in sealedData)
+                {
+                    Assert.Equal(AesGcmSivStream.HeaderSize + plaintext.Length + 21 * 16, encrypted.Length);
+                    var decrypted = new MemoryStream();
+                    using (var decryptor = new AesGcmSivStream(new MemoryStream(encrypted), aesGcmSiv, CryptoStreamMode.Read, associatedData: _testAssociatedData))
+                        await decryptor.CopyToAsync(decrypted);
+                    Assert.Equal(plaintext, decrypted.ToArray());
+                }
+                Assert.Throws<ArgumentOutOfRangeException>(() => AesGcmSivStream.MemoryBudget = -1);
+            }
+            finally
+            {
+                AesGcmSivStream.MemoryBudget = 0;
+            }
+        }
+
+        [Theory]
+        [InlineData(AesGcmSivCompression.Zstd)]
+        [InlineData(AesGcmSivCompression.Lz4)]
+        public async Task Stream_WithCompression_ShouldShrinkTextAndRoundTrip(AesGcmSivCompression compression)
+        {
+            if (!System.Security.Cryptography.AesGcmSiv.IsCompressionSupported(compression))
+                return;
+
+            // Arrange: repetitive JSON, then bytes that do not compress
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var text = new System.Text.StringBuilder();
+            for (int i = 0; text.Length < 50000; i++)
+                text.Append("{\"id\":").Append(i).Append(",\"name\":\"item\",\"tags\":[\"a\",\"b\"]},");
+            byte[] json = System.Text.Encoding.UTF8.GetBytes(text.ToString());
+            var noise = new byte[5000];
+            new Random(7).NextBytes(noise);
+            byte[] plaintext = json.Concat(noise).ToArray();
+            var sealedData = new MemoryStream();
+
+            // Act
+            await using (var encryptor = new AesGcmSivStream(sealedData, aesGcmSiv, CryptoStreamMode.Write, 4096, _testAssociatedData, leaveOpen: true) { Compression = compression })
+            {
+                for (int offset = 0; offset < plaintext.Length; offset += 1000)
+                    encryptor.Write(plaintext, offset, Math.Min(1000, plaintext.Length - offset));
+                Assert.Throws<InvalidOperationException>(() => encryptor.Compression = AesGcmSivCompression.None);
+            }
+            byte[] encrypted = sealedData.ToArray();
+            var decrypted = new MemoryStream();
+            using (var decryptor = new AesGcmSivStream(new MemoryStream(encrypted), aesGcmSiv, CryptoStreamMode.Read, associatedData: _testAssociatedData))
+                await decryptor.CopyToAsync(decrypted);
+
+            // Assert
+            Assert.True(encrypted.Length < json.Length / 2 + noise.Length);
+            Assert.Equal(plaintext, decrypted.ToArray());
+
+            // Truncation, tampering and appended data all fail
+            foreach (byte[] damaged in new[]
+            {
+                encrypted[..^1],
+                encrypted.Select((b, i) => i == encrypted.Length / 2 ? (byte)(b ^ 1) : b).ToArray(),
+                encrypted.Append((byte)0).ToArray(),
+            })
+            {
+                using var reader = new AesGcmSivStream(new MemoryStream(damaged), aesGcmSiv, CryptoStreamMode.Read, associatedData: _testAssociatedData);
+                Assert.Throws<CryptographicException>(() => reader.CopyTo(Stream.Null));
+            }
+        }
+
+        [Fact]
+        public async Task Pipe_ShouldRoundTripMultiSegmentChunksAndMatchStreamFormat()
+        {
+            // Arrange: 100-byte writes into 4 KiB pipe segments, so some 64-byte chunks span two
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var plaintext = new byte[10000];
+            for (int i = 0; i < plaintext.Length; i++) plaintext[i] = (byte)(i * 3);
+            var input = new System.IO.Pipelines.Pipe();
+            var sealedPipe = new System.IO.Pipelines.Pipe();
+
+            // Act
+            Task encrypt = AesGcmSivPipe.EncryptAsync(input.Reader, sealedPipe.Writer, aesGcmSiv, 64, _testAssociatedData);
+            for (int offset = 0; offset < plaintext.Length; offset += 100)
+                await input.Writer.WriteAsync(plaintext.AsMemory(offset, Math.Min(100, plaintext.Length - offset)));
+            await input.Writer.CompleteAsync();
+            await encrypt;
+            await sealedPipe.Writer.CompleteAsync();
+            var sealedData = new MemoryStream();
+            await sealedPipe.Reader.CopyToAsync(sealedData);
+            byte[] encrypted = sealedData.ToArray();
+
+            var fromStream = new MemoryStream();
+            using (var decryptor = new AesGcmSivStream(new MemoryStream(encrypted), aesGcmSiv, CryptoStreamMode.Read, associatedData: _testAssociatedData))
+                await decryptor.CopyToAsync(fromStream);
+
+            var sealedInput = System.IO.Pipelines.PipeReader.Create(new MemoryStream(encrypted), new System.IO.Pipelines.StreamPipeReaderOptions(bufferSize: 50));
+            var output = new System.IO.Pipelines.Pipe();
+            await AesGcmSivPipe.DecryptAsync(sealedInput, output.Writer, aesGcmSiv, _testAssociatedData);
+            await output.Writer.CompleteAsync();
+            var fromPipe = new MemoryStream();
+            await output.Reader.CopyToAsync(fromPipe);
+
+            // Assert
+            Assert.Equal(plaintext, fromStream.ToArray());
+            Assert.Equal(plaintext, fromPipe.ToArray());
+
+            // A truncated stream fails
+            var truncated = System.IO.Pipelines.PipeReader.Create(new MemoryStream(encrypted, 0, encrypted.Length - 1));
+            await Assert.ThrowsAsync<CryptographicException>(() =>
+                AesGcmSivPipe.DecryptAsync(truncated, new System.IO.Pipelines.Pipe().Writer, aesGcmSiv, _testAssociatedData));
+        }
+
+        [Theory]
+        [InlineData(0)]
+        [InlineData(64 * 3)]
+        [InlineData(64 * 3 + 5)]
+        public async Task EncryptFile_ShouldRoundTripInStreamFormatAndRejectTampering(int length)
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var plaintext = new byte[length];
+            for (int i = 0; i < plaintext.Length; i++) plaintext[i] = (byte)(i * 5);
+            string source = Path.GetTempFileName();
+            string sealedPath = Path.GetTempFileName();
+            string destination = Path.GetTempFileName();
+            try
+            {
+                File.WriteAllBytes(source, plaintext);
+
+                // Act
+                aesGcmSiv.EncryptFile(source, sealedPath, 64, _testAssociatedData);
+                aesGcmSiv.DecryptFile(sealedPath, destination, _testAssociatedData);
+
+                // Assert
+                Assert.Equal(plaintext, File.ReadAllBytes(destination));
+                var fromStream = new MemoryStream();
+                using (var decryptor = new AesGcmSivStream(File.OpenRead(sealedPath), aesGcmSiv, CryptoStreamMode.Read, associatedData: _testAssociatedData))
+                    await decryptor.CopyToAsync(fromStream);
+                Assert.Equal(plaintext, fromStream.ToArray());
+
+                // A flipped bit anywhere leaves no plaintext behind
+                byte[] encrypted = File.ReadAllBytes(sealedPath);
+                encrypted[^1] ^= 1;
+                File.WriteAllBytes(sealedPath, encrypted);
+                Assert.Throws<CryptographicException>(() => aesGcmSiv.DecryptFile(sealedPath, destination, _testAssociatedData));
+                Assert.False(File.Exists(destination));
+            }
+            finally
+            {
+                File.Delete(source);
+                File.Delete(sealedPath);
+                File.Delete(destination);
+            }
+        }
+
+        [Theory]
+        [InlineData(0, 1)]
+        [InlineData(64 * 40, 8)]
+        [InlineData(64 * 40 + 7, 3)]
+        public async Task FileEncryptAsync_ShouldWriteTheStreamFormatWithChunksInFlight(int length, int chunksInFlight)
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var plaintext = new byte[length];
+            for (int i = 0; i < plaintext.Length; i++) plaintext[i] = (byte)(i * 7);
+            string source = Path.GetTempFileName();
+            string sealedPath = Path.GetTempFileName();
+            string destination = Path.GetTempFileName();
+            try
+            {
+                File.WriteAllBytes(source, plaintext);
+                // Output left over from a longer file must not survive
+                File.WriteAllBytes(sealedPath, new byte[length + 4096]);
+
+                // Act
+                using (var input = File.OpenHandle(source, options: FileOptions.Asynchronous))
+                using (var output = File.OpenHandle(sealedPath, FileMode.Open, FileAccess.Write, options: FileOptions.Asynchronous))
+                    await AesGcmSivFile.EncryptAsync(input, output, aesGcmSiv, 64, _testAssociatedData, chunksInFlight);
+
+                // Assert
+                int chunks = Math.Max(1, (length + 63) / 64);
+                Assert.Equal(AesGcmSivStream.HeaderSize + length + chunks * 16, new FileInfo(sealedPath).Length);
+                aesGcmSiv.DecryptFile(sealedPath, destination, _testAssociatedData);
+                Assert.Equal(plaintext, File.ReadAllBytes(destination));
+                Assert.Throws<CryptographicException>(() => aesGcmSiv.DecryptFile(sealedPath, destination));
+            }
+            finally
+            {
+                File.Delete(source);
+                File.Delete(sealedPath);
+                File.Delete(destination);
+            }
+        }
+
+        [Theory]
+        [InlineData(0)]
+        [InlineData(256 * 5)]
+        [InlineData(256 * 5 + 70)]
+        public async Task MultipartUpload_ShouldAlignPartsToChunksAndMatchStreamFormat(int length)
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var plaintext = new byte[length];
+            for (int i = 0; i < plaintext.Length; i++) plaintext[i] = (byte)(i * 11);
+            var parts = new System.Collections.Concurrent.ConcurrentDictionary<int, byte[]>();
+
+            // Act: 4 chunks of 64 bytes per part
+            int count = await AesGcmSivMultipartUpload.EncryptAsync(
+                new MemoryStream(plaintext), aesGcmSiv,
+                async (number, part, cancellationToken) =>
+                {
+                    await Task.Yield();
+                    parts[number] = part.ToArray();
+                },
+                partSize: 256, chunkSize: 64, _testAssociatedData, partsInFlight: 2);
+
+            // Assert
+            Assert.Equal(Math.Max(1, (length + 255) / 256), count);
+            Assert.Equal(Enumerable.Range(1, count), parts.Keys.OrderBy(k => k));
+            for (int number = 1; number < count; number++)
+                Assert.Equal((number == 1 ? AesGcmSivStream.HeaderSize : 0) + 4 * (64 + 16), parts[number].Length);
+            byte[] encrypted = Enumerable.Range(1, count).SelectMany(n => parts[n]).ToArray();
+            var decrypted = new MemoryStream();
+            using (var decryptor = new AesGcmSivStream(new MemoryStream(encrypted), aesGcmSiv, CryptoStreamMode.Read, associatedData: _testAssociatedData))
+                await decryptor.CopyToAsync(decrypted);
+            Assert.Equal(plaintext, decrypted.ToArray());
+
+            // A failed upload surfaces once the parts in flight finish
+            var failure = await Assert.ThrowsAsync<IOException>(() => AesGcmSivMultipartUpload.EncryptAsync(
+                new MemoryStream(plaintext), aesGcmSiv,
+                (number, part, cancellationToken) => throw new IOException("upload failed"),
+                partSize: 256, chunkSize: 64));
+            Assert.Equal("upload failed", failure.Message);
+        }
+
+        [Fact]
+        public void JsonEncryptFields_ShouldReplaceOnlySelectedValuesAndRoundTrip()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            byte[] json = System.Text.Encoding.UTF8.GetBytes(
+                "{\"id\": 7, \"card\": {\"number\": \"4111 1111\", \"exp\": [12, 30]}, \"items\": [{\"price\": 9.5}, {\"price\": null}]}");
+            string[] paths = { "card.number", "card.exp", "items.*.price" };
+
+            // Act
+            byte[] encrypted = AesGcmSivJson.EncryptFields(aesGcmSiv, json, paths, _testAssociatedData);
+            byte[] decrypted = AesGcmSivJson.DecryptFields(aesGcmSiv, encrypted, paths, _testAssociatedData);
+
+            // Assert
+            Assert.Equal(json, decrypted);
+            using (var document = System.Text.Json.JsonDocument.Parse(encrypted))
+            {
+                var root = document.RootElement;
+                Assert.Equal(7, root.GetProperty("id").GetInt32());
+                Assert.Equal(System.Text.Json.JsonValueKind.String, root.GetProperty("card").GetProperty("number").ValueKind);
+                Assert.Equal(System.Text.Json.JsonValueKind.String, root.GetProperty("card").GetProperty("exp").ValueKind);
+                foreach (var item in root.GetProperty("items").EnumerateArray())
+                    Assert.Equal(System.Text.Json.JsonValueKind.String, item.GetProperty("price").ValueKind);
+            }
+            Assert.DoesNotContain("4111", System.Text.Encoding.UTF8.GetString(encrypted));
+            Assert.Throws<AuthenticationTagMismatchException>(
+                () => AesGcmSivJson.DecryptFields(aesGcmSiv, encrypted, paths, new byte[] { 1 }));
+            Assert.Throws<ArgumentException>(
+                () => AesGcmSivJson.EncryptFields(aesGcmSiv, "{\"a\": }"u8, paths));
+        }
+
+        [Theory]
+        [InlineData(0)]
+        [InlineData(1000)]
+        public void EncryptMessageFile_ShouldMatchOneMessageAndOnlyReplaceOutputOnceVerified(int length)
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var plaintext = new byte[length];
+            for (int i = 0; i < plaintext.Length; i++) plaintext[i] = (byte)(i * 3);
+            string source = Path.GetTempFileName();
+            string sealedPath = Path.GetTempFileName();
+            string destination = Path.GetTempFileName();
+            try
+            {
+                File.WriteAllBytes(source, plaintext);
+
+                // Act
+                aesGcmSiv.EncryptMessageFile(_testNonce, source, sealedPath, _testAssociatedData);
+                aesGcmSiv.DecryptMessageFile(_testNonce, sealedPath, destination, _testAssociatedData);
+
+                // Assert: the file is exactly ciphertext || tag of one message
+                Assert.Equal(plaintext, File.ReadAllBytes(destination));
+                var ciphertext = new byte[length];
+                var tag = new byte[16];
+                aesGcmSiv.Encrypt(_testNonce, plaintext, ciphertext, tag, _testAssociatedData);
+                Assert.Equal(ciphertext.Concat(tag).ToArray(), File.ReadAllBytes(sealedPath));
+
+                // A flipped bit leaves the existing output as it was and no provisional file behind
+                byte[] encrypted = File.ReadAllBytes(sealedPath);
+                encrypted[0] ^= 1;
+                File.WriteAllBytes(sealedPath, encrypted);
+                File.WriteAllBytes(destination, new byte[] { 42 });
+                Assert.Throws<CryptographicException>(() => aesGcmSiv.DecryptMessageFile(_testNonce, sealedPath, destination, _testAssociatedData));
+                Assert.Equal(new byte[] { 42 }, File.ReadAllBytes(destination));
+                Assert.Empty(Directory.GetFiles(Path.GetDirectoryName(destination)!, Path.GetFileName(destination) + ".partial-*"));
+            }
+            finally
+            {
+                File.Delete(source);
+                File.Delete(sealedPath);
+                File.Delete(destination);
+            }
+        }
+
+        [Fact]
+        public async Task RandomAccessReader_ShouldReadAnyRangeAndRejectTampering()
+        {
+            // Arrange: 5 full chunks of 64 bytes and a partial one
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var plaintext = new byte[64 * 5 + 20];
+            for (int i = 0; i < plaintext.Length; i++) plaintext[i] = (byte)(i * 7);
+            var sealedData = new MemoryStream();
+            await using (var encryptor = new AesGcmSivStream(sealedData, aesGcmSiv, CryptoStreamMode.Write, 64, _testAssociatedData, leaveOpen: true))
+                await encryptor.WriteAsync(plaintext);
+            byte[] encrypted = sealedData.ToArray();
+
+            // Act & Assert: ranges within a chunk, across chunks and past the end
+            using (var reader = new AesGcmSivRandomAccessReader(new MemoryStream(encrypted), aesGcmSiv, _testAssociatedData) { PrefetchChunks = 2 })
+            {
+                Assert.Equal(plaintext.Length, reader.Length);
+                Assert.Equal(64, reader.ChunkSize);
+                foreach (var (offset, count) in new[] { (0, 10), (70, 30), (60, 200), (300, 100), (340, 5) })
+                {
+                    var buffer = new byte[count];
+                    int expected = Math.Max(0, Math.Min(count, plaintext.Length - offset));
+                    Assert.Equal(expected, reader.Read(offset, buffer));
+                    Assert.Equal(plaintext.AsSpan(Math.Min(offset, plaintext.Length), expected).ToArray(), buffer.AsSpan(0, expected).ToArray());
+                    Array.Clear(buffer);
+                    Assert.Equal(expected, await reader.ReadAsync(offset, buffer));
+                    Assert.Equal(plaintext.AsSpan(Math.Min(offset, plaintext.Length), expected).ToArray(), buffer.AsSpan(0, expected).ToArray());
+                }
+            }
+
+            // A flipped bit fails only the chunk that holds it
+            encrypted[AesGcmSivStream.HeaderSize + 2 * (64 + 16)] ^= 1;
+            using var tampered = new AesGcmSivRandomAccessReader(new MemoryStream(encrypted), aesGcmSiv, _testAssociatedData);
+            Assert.Equal(10, tampered.Read(0, new byte[10]));
+            Assert.Throws<CryptographicException>(() => tampered.Read(64 * 2 + 5, new byte[10]));
+        }
+
+        [Fact]
+        public async Task RandomAccessReader_WithChunkCache_ShouldServeHotChunksWithoutDecrypting()
+        {
+            // Arrange: 4 chunks of 64 bytes and a cache of 2
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var plaintext = new byte[64 * 4];
+            new Random(138).NextBytes(plaintext);
+            var sealedData = new MemoryStream();
+            await using (var encryptor = new AesGcmSivStream(sealedData, aesGcmSiv, CryptoStreamMode.Write, 64, _testAssociatedData, leaveOpen: true))
+                await encryptor.WriteAsync(plaintext);
+            byte[] encrypted = sealedData.ToArray();
+            using var cache = new AesGcmSivChunkCache(2, chunkSize: 64);
+            var source = new MemoryStream(encrypted);
+            var reader = new AesGcmSivRandomAccessReader(source, aesGcmSiv, _testAssociatedData) { ChunkCache = cache };
+
+            // Act: read chunk 0, then spoil it in the source; the cached copy is still served
+            var buffer = new byte[20];
+            Assert.Equal(20, reader.Read(10, buffer));
+            encrypted[AesGcmSivStream.HeaderSize] ^= 1;
+            Assert.Equal(20, reader.Read(10, buffer));
+            Assert.Equal(20, await reader.ReadAsync(10, buffer));
+
+            // Assert
+            Assert.Equal(plaintext.AsSpan(10, 20).ToArray(), buffer);
+            Assert.Equal(2, cache.Hits);
+            Assert.Equal(1, cache.Misses);
+            Assert.Equal(1, cache.Count);
+
+            // Chunks 1 to 3 push chunk 0 out, after which it fails to authenticate again
+            Assert.Equal(64 * 3, reader.Read(64, new byte[64 * 3]));
+            Assert.Equal(2, cache.Count);
+            Assert.True(cache.Evictions >= 1);
+            Assert.Throws<CryptographicException>(() => reader.Read(0, new byte[10]));
+            Assert.Throws<InvalidOperationException>(() => reader.ChunkCache = null);
+
+            // Disposing the reader drops its chunks; a cache for smaller chunks is refused
+            reader.Dispose();
+            Assert.Equal(0, cache.Count);
+            using var small = new AesGcmSivChunkCache(2, chunkSize: 32);
+            using var other = new AesGcmSivRandomAccessReader(new MemoryStream(sealedData.ToArray()), aesGcmSiv, _testAssociatedData);
+            Assert.Throws<ArgumentException>(() => other.ChunkCache = small);
+        }
+
+        [Theory]
+        [InlineData(1)]
+        [InlineData(3)]
+        public async Task OpenAppend_ShouldRewriteOnlyTheLastChunk(int parallelChunks)
+        {
+            // Arrange: 2 full chunks of 64 bytes and a partial one
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var first = new byte[64 * 2 + 10];
+            var second = new byte[200];
+            new Random(137).NextBytes(first);
+            new Random(138).NextBytes(second);
+            var sealedData = new MemoryStream();
+            await using (var encryptor = new AesGcmSivStream(sealedData, aesGcmSiv, CryptoStreamMode.Write, 64, _testAssociatedData, leaveOpen: true))
+                await encryptor.WriteAsync(first);
+            byte[] before = sealedData.ToArray();
+
+            // Act: an empty append seals the last chunk again as it was
+            AesGcmSivStream.OpenAppend(sealedData, aesGcmSiv, _testAssociatedData, leaveOpen: true).Dispose();
+            Assert.Equal(before, sealedData.ToArray());
+            await using (var appender = AesGcmSivStream.OpenAppend(sealedData, aesGcmSiv, _testAssociatedData, leaveOpen: true))
+            {
+                appender.ParallelChunks = parallelChunks;
+                await appender.WriteAsync(second);
+            }
+
+            // Assert: the header and the full chunks are untouched, and the whole reads back
+            byte[] after = sealedData.ToArray();
+            int kept = AesGcmSivStream.HeaderSize + 2 * (64 + 16);
+            Assert.Equal(before.AsSpan(0, kept).ToArray(), after.AsSpan(0, kept).ToArray());
+            var decrypted = new MemoryStream();
+            using (var decryptor = new AesGcmSivStream(new MemoryStream(after), aesGcmSiv, CryptoStreamMode.Read, associatedData: _testAssociatedData))
+                decryptor.CopyTo(decrypted);
+            Assert.Equal(first.Concat(second).ToArray(), decrypted.ToArray());
+
+            // A tampered last chunk is refused
+            after[^1] ^= 1;
+            Assert.Throws<CryptographicException>(() =>
+                AesGcmSivStream.OpenAppend(new MemoryStream(after), aesGcmSiv, _testAssociatedData));
+        }
+
+        [Theory]
+        [InlineData(1)]
+        [InlineData(4)]
+        public async Task RandomAccessReader_WithTagManifest_ShouldCheckChunksAgainstTheRoot(int parallelChunks)
+        {
+            // Arrange: 5 full chunks of 64 bytes and a partial one, then a tree of 6 + 3 + 2 + 1 nodes
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var plaintext = new byte[64 * 5 + 20];
+            for (int i = 0; i < plaintext.Length; i++) plaintext[i] = (byte)(i * 11);
+            var sealedData = new MemoryStream();
+            await using (var encryptor = new AesGcmSivStream(sealedData, aesGcmSiv, CryptoStreamMode.Write, 64, _testAssociatedData, leaveOpen: true)
+                { TagManifest = true, ParallelChunks = parallelChunks })
+                await encryptor.WriteAsync(plaintext);
+            byte[] encrypted = sealedData.ToArray();
+            Assert.Equal(AesGcmSivStream.HeaderSize + plaintext.Length + 6 * 16 + 12 * 32 + 56, encrypted.Length);
+
+            // Act & Assert
+            using (var reader = new AesGcmSivRandomAccessReader(new MemoryStream(encrypted), aesGcmSiv, _testAssociatedData))
+            {
+                Assert.Equal(plaintext.Length, reader.Length);
+                Assert.Equal(32, reader.ManifestRoot.Length);
+                var buffer = new byte[plaintext.Length];
+                Assert.Equal(plaintext.Length, reader.Read(0, buffer));
+                Assert.Equal(plaintext, buffer);
+            }
+            Assert.Throws<CryptographicException>(() =>
+                new AesGcmSivStream(new MemoryStream(encrypted), aesGcmSiv, CryptoStreamMode.Read, associatedData: _testAssociatedData).ReadByte());
+
+            // An altered leaf fails only the chunk whose path runs through it
+            encrypted[encrypted.Length - 56 - 12 * 32 + 3 * 32] ^= 1;
+            using (var tampered = new AesGcmSivRandomAccessReader(new MemoryStream(encrypted), aesGcmSiv, _testAssociatedData))
+            {
+                Assert.Equal(10, tampered.Read(0, new byte[10]));
+                Assert.Throws<CryptographicException>(() => tampered.Read(64 * 2, new byte[10]));
+            }
+
+            // Dropping a chunk's worth of bytes no longer matches the sealed chunk count
+            byte[] truncated = encrypted.Take(AesGcmSivStream.HeaderSize + 64 + 16)
+                .Concat(encrypted.Skip(AesGcmSivStream.HeaderSize + 2 * (64 + 16))).ToArray();
+            Assert.Throws<CryptographicException>(() =>
+                new AesGcmSivRandomAccessReader(new MemoryStream(truncated), aesGcmSiv, _testAssociatedData));
+        }
+
+        [Fact]
+        public void ChunkedFile_ShouldRewriteOnlyOverlappingChunks()
+        {
+            // Arrange: 100 chunks of 64 bytes and a partial one
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            string path = Path.GetTempFileName();
+            var plaintext = new byte[64 * 100 + 20];
+            new Random(135).NextBytes(plaintext);
+            long recordSize = 4 + 64 + 16;
+            try
+            {
+                using (var file = new AesGcmSivChunkedFile(path, aesGcmSiv, _testAssociatedData, chunkSize: 64, flushToDisk: false))
+                {
+                    Assert.Equal(0, file.Length);
+                    Assert.Equal(101, file.Write(0, plaintext));
+                }
+                byte[] before = File.ReadAllBytes(path);
+
+                // Act: a small edit across a chunk boundary, then an append
+                int rewritten;
+                using (var file = new AesGcmSivChunkedFile(path, aesGcmSiv, _testAssociatedData, flushToDisk: false))
+                {
+                    Assert.Equal(64, file.ChunkSize);
+                    Assert.Equal(plaintext.Length, file.Length);
+                    rewritten = file.Write(64 * 40 + 60, new byte[] { 1, 2, 3, 4, 5, 6, 7, 8 });
+                    Assert.Equal(2, file.Write(plaintext.Length, new byte[50]));
+                    Assert.Equal(3, file.Generation);
+                }
+                new byte[] { 1, 2, 3, 4, 5, 6, 7, 8 }.CopyTo(plaintext, 64 * 40 + 60);
+                plaintext = plaintext.Concat(new byte[50]).ToArray();
+
+                // Assert: only chunks 40 and 41 changed among the first 100
+                Assert.Equal(2, rewritten);
+                byte[] after = File.ReadAllBytes(path);
+                for (int chunk = 0; chunk < 100; chunk++)
+                {
+                    long start = AesGcmSivChunkedFile.HeaderSize + chunk * recordSize;
+                    bool same = before.AsSpan((int)start, (int)recordSize).SequenceEqual(after.AsSpan((int)start, (int)recordSize));
+                    Assert.Equal(chunk != 40 && chunk != 41, same);
+                }
+                using (var file = new AesGcmSivChunkedFile(path, aesGcmSiv, _testAssociatedData))
+                {
+                    var read = new byte[plaintext.Length + 10];
+                    Assert.Equal(plaintext.Length, file.Read(0, read));
+                    Assert.Equal(plaintext, read.AsSpan(0, plaintext.Length).ToArray());
+                }
+
+                // A chunk's earlier record relabelled with its current version fails
+                before.AsSpan(AesGcmSivChunkedFile.HeaderSize + (int)(40 * recordSize), (int)recordSize)
+                    .CopyTo(after.AsSpan(AesGcmSivChunkedFile.HeaderSize + (int)(40 * recordSize)));
+                after[AesGcmSivChunkedFile.HeaderSize + (int)(40 * recordSize)]++;
+                File.WriteAllBytes(path, after);
+                using (var file = new AesGcmSivChunkedFile(path, aesGcmSiv, _testAssociatedData))
+                {
+                    Assert.Equal(10, file.Read(0, new byte[10]));
+                    Assert.Throws<CryptographicException>(() => file.Read(64 * 40, new byte[10]));
+                }
+            }
+            finally
+            {
+                File.Delete(path);
+            }
+        }
+
+        [Fact]
+        public void Open_WithTooShortInput_ShouldThrowArgumentException()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+
+            // Act & Assert
+            Assert.Throws<ArgumentException>(() =>
+                aesGcmSiv.Open(new byte[System.Security.Cryptography.AesGcmSiv.SealOverhead - 1], new byte[16]));
+        }
+
+        [Fact]
+        public void EncryptDecrypt_WithSpansIntoSharedBuffer_ShouldMatchArrayOverloads()
+        {
+            // Arrange - every input and output is a slice of one pooled-style buffer
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var expected = new byte[_testPlaintext.Length];
+            var expectedTag = new byte[16];
+            aesGcmSiv.Encrypt(_testNonce, _testPlaintext, expected, expectedTag, _testAssociatedData);
+
+            var pool = new byte[1024];
+            Span<byte> nonce = pool.AsSpan(3, 12);
+            Span<byte> plaintext = pool.AsSpan(20, _testPlaintext.Length);
+            Span<byte> ciphertext = pool.AsSpan(200, _testPlaintext.Length);
+            Span<byte> tag = pool.AsSpan(400, 16);
+            Span<byte> decrypted = pool.AsSpan(500, _testPlaintext.Length);
+            _testNonce.CopyTo(nonce);
+            _testPlaintext.CopyTo(plaintext);
+
+            // Act
+            aesGcmSiv.Encrypt(nonce, plaintext, ciphertext, tag, _testAssociatedData);
+            aesGcmSiv.Decrypt(nonce, ciphertext, tag, decrypted, _testAssociatedData);
+
+            // Assert
+            Assert.Equal(expected, ciphertext.ToArray());
+            Assert.Equal(expectedTag, tag.ToArray());
+            Assert.Equal(_testPlaintext, decrypted.ToArray());
+        }
+
+        [Fact]
+        public void EncryptDecrypt_WithDefaultSpans_ShouldRoundTripEmptyMessage()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var tag = new byte[16];
+
+            // Act
+            aesGcmSiv.Encrypt(_testNonce, ReadOnlySpan<byte>.Empty, Span<byte>.Empty, tag);
+
+            // Assert
+            aesGcmSiv.Decrypt(_testNonce, ReadOnlySpan<byte>.Empty, tag, Span<byte>.Empty);
+            tag[0] ^= 1;
+            Assert.Throws<CryptographicException>(() =>
+                aesGcmSiv.Decrypt(_testNonce, ReadOnlySpan<byte>.Empty, tag, Span<byte>.Empty));
+        }
+
+        [Fact]
+        public void Encrypt_WithPartiallyOverlappingSpans_ShouldThrowArgumentException()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var buffer = new byte[128];
+
+            // Act & Assert
+            Assert.Throws<ArgumentException>(() =>
+                aesGcmSiv.Encrypt(_testNonce, buffer.AsSpan(0, 64), buffer.AsSpan(1, 64), new byte[16]));
+        }
+
+        [Fact]
+        public void TryEncrypt_ShouldMatchEncryptAndReportBytesWritten()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var expected = new byte[_testPlaintext.Length];
+            var expectedTag = new byte[16];
+            aesGcmSiv.Encrypt(_testNonce, _testPlaintext, expected, expectedTag, _testAssociatedData);
+            var ciphertext = new byte[_testPlaintext.Length + 8];
+            var tag = new byte[16];
+
+            // Act
+            bool success = aesGcmSiv.TryEncrypt(_testNonce, _testPlaintext, ciphertext, tag, out int bytesWritten, _testAssociatedData);
+
+            // Assert
+            Assert.True(success);
+            Assert.Equal(_testPlaintext.Length, bytesWritten);
+            Assert.Equal(expected, ciphertext.AsSpan(0, bytesWritten).ToArray());
+            Assert.Equal(expectedTag, tag);
+        }
+
+        [Fact]
+        public void TryEncrypt_WithSmallDestination_ShouldReturnFalse()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var ciphertext = new byte[_testPlaintext.Length - 1];
+
+            // Act
+            bool success = aesGcmSiv.TryEncrypt(_testNonce, _testPlaintext, ciphertext, new byte[16], out int bytesWritten);
+
+            // Assert
+            Assert.False(success);
+            Assert.Equal(0, bytesWritten);
+            Assert.True(ciphertext.All(b => b == 0));
+        }
+
+        [Fact]
+        public void TryDecrypt_ShouldRoundTripAndReturnFalseOnTampering()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var ciphertext = new byte[_testPlaintext.Length];
+            var tag = new byte[16];
+            aesGcmSiv.Encrypt(_testNonce, _testPlaintext, ciphertext, tag, _testAssociatedData);
+            var decrypted = new byte[ciphertext.Length];
+
+            // Act & Assert
+            Assert.True(aesGcmSiv.TryDecrypt(_testNonce, ciphertext, tag, decrypted, _testAssociatedData));
+            Assert.Equal(_testPlaintext, decrypted);
+
+            tag[15] ^= 0x80;
+            Assert.False(aesGcmSiv.TryDecrypt(_testNonce, ciphertext, tag, decrypted, _testAssociatedData));
+            Assert.True(decrypted.All(b => b == 0));
+        }
+
+        [Fact]
+        public void TryDecryptWithAny_ShouldReturnTheIndexOfTheKeyThatVerifies()
+        {
+            // Arrange - a rotation window of three keys, the value under the middle one
+            var keys = new byte[3][];
+            var candidates = new System.Security.Cryptography.AesGcmSiv[keys.Length];
+            for (int k = 0; k < keys.Length; k++)
+            {
+                keys[k] = (byte[])_testKey.Clone();
+                keys[k][0] ^= (byte)(k + 1);
+                candidates[k] = new System.Security.Cryptography.AesGcmSiv(keys[k]);
+            }
+            try
+            {
+                var ciphertext = new byte[_testPlaintext.Length];
+                var tag = new byte[16];
+                candidates[1].Encrypt(_testNonce, _testPlaintext, ciphertext, tag, _testAssociatedData);
+                var decrypted = new byte[ciphertext.Length];
+
+                // Act
+                int index = System.Security.Cryptography.AesGcmSiv.TryDecryptWithAny(
+                    candidates, _testNonce, ciphertext, tag, decrypted, _testAssociatedData);
+                var buffer = (byte[])ciphertext.Clone();
+                int inPlace = System.Security.Cryptography.AesGcmSiv.TryDecryptWithAny(
+                    candidates, _testNonce, buffer, tag, buffer, _testAssociatedData);
+                int none = System.Security.Cryptography.AesGcmSiv.TryDecryptWithAny(
+                    new[] { candidates[0], candidates[2] }, _testNonce, ciphertext, tag, decrypted, _testAssociatedData);
+
+                // Assert
+                Assert.Equal(1, index);
+                Assert.Equal(1, inPlace);
+                Assert.Equal(_testPlaintext, buffer);
+                Assert.Equal(-1, none);
+                Assert.True(decrypted.All(b => b == 0));
+                Assert.Throws<ArgumentException>(() => System.Security.Cryptography.AesGcmSiv.TryDecryptWithAny(
+                    ReadOnlySpan<System.Security.Cryptography.AesGcmSiv>.Empty, _testNonce, ciphertext, tag, decrypted));
+            }
+            finally
+            {
+                foreach (var candidate in candidates)
+                    candidate.Dispose();
+            }
+        }
+
+        [Fact]
+        public void TryDecrypt_WithInvalidTagSize_ShouldThrowArgumentException()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+
+            // Act & Assert
+            Assert.Throws<ArgumentException>(() =>
+                aesGcmSiv.TryDecrypt(_testNonce, new byte[16], new byte[15], new byte[16]));
+        }
+
+        [Theory]
+        [InlineData(0)]
+        [InlineData(100)]
+        [InlineData(256)]
+        [InlineData(257)]
+        public void SmallMessageFastPath_ShouldMatchDefaultPath(int length)
+        {
+            // Arrange
+            using var regular = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            using var fast = new System.Security.Cryptography.AesGcmSiv(_testKey) { SmallMessageFastPath = true };
+            var plaintext = new byte[length];
+            for (int i = 0; i < plaintext.Length; i++) plaintext[i] = (byte)(i + 1);
+            var expected = new byte[length];
+            var expectedTag = new byte[16];
+            regular.Encrypt(_testNonce, plaintext, expected, expectedTag, _testAssociatedData);
+            var ciphertext = new byte[length];
+            var tag = new byte[16];
+            var decrypted = new byte[length];
+
+            // Act
+            fast.Encrypt(_testNonce, plaintext, ciphertext, tag, _testAssociatedData);
+            fast.Decrypt(_testNonce, ciphertext, tag, decrypted, _testAssociatedData);
+
+            // Assert
+            Assert.Equal(expected, ciphertext);
+            Assert.Equal(expectedTag, tag);
+            Assert.Equal(plaintext, decrypted);
+            tag[0] ^= 1;
+            Assert.Throws<CryptographicException>(() =>
+                fast.Decrypt(_testNonce, ciphertext, tag, decrypted, _testAssociatedData));
+        }
+
+        [Fact]
+        public void BackendName_ShouldNotBeEmpty()
+        {
+            // Act
+            var name = System.Security.Cryptography.AesGcmSiv.BackendName;
+
+            // Assert
+            Assert.False(string.IsNullOrEmpty(name));
+        }
+
+        [Fact]
+        public async Task HealthProbe_ShouldMeasureTheBackendInUse()
+        {
+            // Act
+            var result = AesGcmSivHealthProbe.Measure(bytes: 4096, runs: 3);
+            using var probe = new AesGcmSivHealthProbe(TimeSpan.FromSeconds(1), expectedCyclesPerByte: 1e6);
+            for (int i = 0; i < 100 && probe.LastResult == null; i++)
+                await Task.Delay(50);
+
+            // Assert
+            Assert.Equal(System.Security.Cryptography.AesGcmSiv.BackendName, result.Backend);
+            Assert.Equal(4096, result.Bytes);
+            Assert.True(result.Cycles > 0);
+            Assert.NotNull(probe.LastResult);
+            Assert.Equal(16384, probe.LastResult.Value.Bytes);
+            Assert.False(probe.IsDegraded);
+            Assert.Throws<ArgumentOutOfRangeException>(() => AesGcmSivHealthProbe.Measure(runs: 65));
+            Assert.Throws<ArgumentOutOfRangeException>(() => new AesGcmSivHealthProbe(TimeSpan.FromMilliseconds(10)));
+        }
+
+        [Theory]
+        [InlineData(AesGcmSivPreloadOptions.None)]
+        [InlineData(AesGcmSivPreloadOptions.SkipOpenSslConfig)]
+        public void Preload_ShouldSucceedAndLeaveLibraryUsable(AesGcmSivPreloadOptions options)
+        {
+            // Act
+            System.Security.Cryptography.AesGcmSiv.Preload(options);
+            System.Security.Cryptography.AesGcmSiv.Preload(options);
+
+            // Assert
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var ciphertext = new byte[_testPlaintext.Length];
+            var tag = new byte[16];
+            var decrypted = new byte[_testPlaintext.Length];
+            aesGcmSiv.Encrypt(_testNonce, _testPlaintext, ciphertext, tag);
+            aesGcmSiv.Decrypt(_testNonce, ciphertext, tag, decrypted);
+            Assert.Equal(_testPlaintext, decrypted);
+        }
+
+        [Fact]
+        public void LoadNativeLibrary_AfterLibraryIsBound_ShouldThrowInvalidOperationException()
+        {
+            // Arrange - constructing an instance binds the library for the process
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+
+            // Act & Assert
+            Assert.Throws<InvalidOperationException>(() =>
+                System.Security.Cryptography.AesGcmSiv.LoadNativeLibrary("aesgcmsiv"));
+        }
+
+        [Fact]
+        public void Constructor_WithoutProviderOrProperties_ShouldMatchDefault()
+        {
+            // Arrange
+            using var defaultInstance = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey, null, null);
+            var expected = new byte[_testPlaintext.Length];
+            var expectedTag = new byte[16];
+            var ciphertext = new byte[_testPlaintext.Length];
+            var tag = new byte[16];
+
+            // Act
+            defaultInstance.Encrypt(_testNonce, _testPlaintext, expected, expectedTag);
+            aesGcmSiv.Encrypt(_testNonce, _testPlaintext, ciphertext, tag);
+
+            // Assert
+            Assert.Equal(expected, ciphertext);
+            Assert.Equal(expectedTag, tag);
+        }
+
+        [Theory]
+        [InlineData("no-such-provider", null)]
+        [InlineData(null, "provider=no-such-provider")]
+        public void Constructor_WithUnavailableProvider_ShouldThrowCryptographicException(string? providerName, string? propertyQuery)
+        {
+            // Act & Assert
+            Assert.Throws<CryptographicException>(() =>
+                new System.Security.Cryptography.AesGcmSiv(_testKey, providerName, propertyQuery));
+        }
+
+        [Fact]
+        public async Task EncryptAsync_DecryptAsync_ShouldMatchSynchronousResults()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var expected = new byte[_testPlaintext.Length];
+            var expectedTag = new byte[16];
+            aesGcmSiv.Encrypt(_testNonce, _testPlaintext, expected, expectedTag, _testAssociatedData);
+            var ciphertext = new byte[_testPlaintext.Length];
+            var tag = new byte[16];
+            var decrypted = new byte[_testPlaintext.Length];
+
+            // Act
+            await aesGcmSiv.EncryptAsync(_testNonce, _testPlaintext, ciphertext, tag, _testAssociatedData);
+            await aesGcmSiv.DecryptAsync(_testNonce, ciphertext, tag, decrypted, _testAssociatedData);
+
+            // Assert
+            Assert.Equal(expected, ciphertext);
+            Assert.Equal(expectedTag, tag);
+            Assert.Equal(_testPlaintext, decrypted);
+        }
+
+        [Fact]
+        public async Task DecryptAsync_WithTamperedTag_ShouldThrowCryptographicException()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var ciphertext = new byte[_testPlaintext.Length];
+            var tag = new byte[16];
+            await aesGcmSiv.EncryptAsync(_testNonce, _testPlaintext, ciphertext, tag);
+            tag[0] ^= 1;
+
+            // Act & Assert
+            await Assert.ThrowsAsync<CryptographicException>(async () =>
+                await aesGcmSiv.DecryptAsync(_testNonce, ciphertext, tag, new byte[ciphertext.Length]));
+        }
+
+        [Fact]
+        public async Task EncryptAsync_LargeMessageWithParallelism_ShouldRunOnPoolAndMatchSerialOutput()
+        {
+            // Arrange - past the 1 MiB threshold, so both calls are queued on the shared pool
+            var plaintext = new byte[3 * 1024 * 1024 + 5];
+            for (int i = 0; i < plaintext.Length; i++) plaintext[i] = (byte)(i * 13);
+            using var serial = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            using var parallel = new System.Security.Cryptography.AesGcmSiv(_testKey)
+            {
+                MaxDegreeOfParallelism = -1
+            };
+            var expected = new byte[plaintext.Length];
+            var expectedTag = new byte[16];
+            serial.Encrypt(_testNonce, plaintext, expected, expectedTag, _testAssociatedData);
+            var ciphertext = new byte[plaintext.Length];
+            var tag = new byte[16];
+            var decrypted = new byte[plaintext.Length];
+
+            // Act
+            await parallel.EncryptAsync(_testNonce, plaintext, ciphertext, tag, _testAssociatedData);
+            await parallel.DecryptAsync(_testNonce, ciphertext, tag, decrypted, _testAssociatedData);
+
+            // Assert
+            Assert.Equal(expectedTag, tag);
+            Assert.Equal(expected, ciphertext);
+            Assert.Equal(plaintext, decrypted);
+            ciphertext[ciphertext.Length / 3] ^= 1;
+            await Assert.ThrowsAsync<CryptographicException>(async () =>
+                await parallel.DecryptAsync(_testNonce, ciphertext, tag, decrypted, _testAssociatedData));
+        }
+
+        [Fact]
+        public async Task EncryptAsync_WithCanceledToken_ShouldNotWriteOutput()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var ciphertext = new byte[_testPlaintext.Length];
+            var tag = new byte[16];
+
+            // Act & Assert
+            await Assert.ThrowsAsync<TaskCanceledException>(async () =>
+                await aesGcmSiv.EncryptAsync(_testNonce, _testPlaintext, ciphertext, tag,
+                    cancellationToken: new CancellationToken(canceled: true)));
+            Assert.True(ciphertext.All(b => b == 0));
+        }
+
+        [Fact]
+        public async Task Engine_ManyThreads_ShouldMatchSerialResults()
+        {
+            // Arrange - two keys, messages from 0 to 300 bytes so both the multi-buffer and the
+            // single-message paths run
+            using var engine = new AesGcmSivEngine(workerCount: 4, queueDepth: 64);
+            using var first = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            using var second = new System.Security.Cryptography.AesGcmSiv(new byte[16]);
+            const int ThreadCount = 16;
+            const int MessagesPerThread = 50;
+            var random = new Random(42);
+            var plaintexts = new byte[ThreadCount * MessagesPerThread][];
+            for (int i = 0; i < plaintexts.Length; i++)
+            {
+                plaintexts[i] = new byte[i % 301];
+                random.NextBytes(plaintexts[i]);
+            }
+            var ciphertexts = new byte[plaintexts.Length][];
+            var tags = new byte[plaintexts.Length][];
+            var decrypted = new byte[plaintexts.Length][];
+
+            // Act
+            await Task.WhenAll(Enumerable.Range(0, ThreadCount).Select(t => Task.Run(async () =>
+            {
+                for (int n = 0; n < MessagesPerThread; n++)
+                {
+                    int i = t * MessagesPerThread + n;
+                    var key = i % 2 == 0 ? first : second;
+                    ciphertexts[i] = new byte[plaintexts[i].Length];
+                    tags[i] = new byte[16];
+                    decrypted[i] = new byte[plaintexts[i].Length];
+                    await engine.EncryptAsync(key, _testNonce, plaintexts[i], ciphertexts[i], tags[i], _testAssociatedData);
+                    await engine.DecryptAsync(key, _testNonce, ciphertexts[i], tags[i], decrypted[i], _testAssociatedData);
+                }
+            })));
+
+            // Assert
+            for (int i = 0; i < plaintexts.Length; i++)
+            {
+                var key = i % 2 == 0 ? first : second;
+                var expected = new byte[plaintexts[i].Length];
+                var expectedTag = new byte[16];
+                key.Encrypt(_testNonce, plaintexts[i], expected, expectedTag, _testAssociatedData);
+                Assert.Equal(expected, ciphertexts[i]);
+                Assert.Equal(expectedTag, tags[i]);
+                Assert.Equal(plaintexts[i], decrypted[i]);
+            }
+        }
+
+        [Fact]
+        public async Task Engine_DecryptWithTamperedTag_ShouldThrowCryptographicException()
+        {
+            // Arrange
+            using var engine = new AesGcmSivEngine(workerCount: 1);
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var ciphertext = new byte[_testPlaintext.Length];
+            var tag = new byte[16];
+            await engine.EncryptAsync(aesGcmSiv, _testNonce, _testPlaintext, ciphertext, tag);
+            tag[0] ^= 1;
+
+            // Act & Assert
+            await Assert.ThrowsAsync<CryptographicException>(async () =>
+                await engine.DecryptAsync(aesGcmSiv, _testNonce, ciphertext, tag, new byte[ciphertext.Length]));
+        }
+
+        [Fact]
+        public async Task Engine_BulkAndLatencyLanes_ShouldRoundTripAndCountPerLane()
+        {
+            // Arrange
+            using var engine = new AesGcmSivEngine(workerCount: 1);
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var bulk = new byte[3 * 1024 * 1024 + 5];
+            new Random(42).NextBytes(bulk);
+            var bulkCiphertext = new byte[bulk.Length];
+            var bulkTag = new byte[16];
+            var bulkDecrypted = new byte[bulk.Length];
+            var ciphertext = new byte[_testPlaintext.Length];
+            var tag = new byte[16];
+
+            // Act
+            ValueTask bulkTask = engine.EncryptAsync(aesGcmSiv, _testNonce, bulk, bulkCiphertext, bulkTag);
+            await engine.EncryptAsync(aesGcmSiv, _testNonce, _testPlaintext, ciphertext, tag);
+            await bulkTask;
+            await engine.DecryptAsync(aesGcmSiv, _testNonce, bulkCiphertext, bulkTag, bulkDecrypted,
+                lane: AesGcmSivEngineLane.Latency);
+            AesGcmSivEngineLaneStatistics latency = engine.GetStatistics(AesGcmSivEngineLane.Latency);
+            AesGcmSivEngineLaneStatistics bulkLane = engine.GetStatistics(AesGcmSivEngineLane.Bulk);
+
+            // Assert
+            Assert.Equal(bulk, bulkDecrypted);
+            var expectedTag = new byte[16];
+            aesGcmSiv.Encrypt(_testNonce, bulk, new byte[bulk.Length], expectedTag);
+            Assert.Equal(expectedTag, bulkTag);
+            Assert.Equal(2, latency.Submitted);
+            Assert.Equal(2, latency.Started);
+            Assert.Equal(1, bulkLane.Submitted);
+            Assert.Equal(0, bulkLane.QueueDepth);
+            Assert.True(latency.MaxWait >= latency.MeanWait);
+            Assert.Throws<ArgumentOutOfRangeException>(() => engine.GetStatistics((AesGcmSivEngineLane)2));
+        }
+
+        [Fact]
+        public async Task Engine_WithLingerAndSmallQueue_ShouldCompleteEveryCall()
+        {
+            // Arrange
+            using var engine = new AesGcmSivEngine(workerCount: 2, queueDepth: 4);
+            engine.ConfigureLinger(TimeSpan.FromMicroseconds(20));
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var expected = new byte[_testPlaintext.Length];
+            var expectedTag = new byte[16];
+            aesGcmSiv.Encrypt(_testNonce, _testPlaintext, expected, expectedTag);
+            const int CallCount = 200;
+            var ciphertexts = new byte[CallCount][];
+            var tags = new byte[CallCount][];
+
+            // Act
+            await Task.WhenAll(Enumerable.Range(0, CallCount).Select(i => Task.Run(async () =>
+            {
+                ciphertexts[i] = new byte[_testPlaintext.Length];
+                tags[i] = new byte[16];
+                await engine.EncryptAsync(aesGcmSiv, _testNonce, _testPlaintext, ciphertexts[i], tags[i]);
+            })));
+
+            // Assert
+            for (int i = 0; i < CallCount; i++)
+            {
+                Assert.Equal(expected, ciphertexts[i]);
+                Assert.Equal(expectedTag, tags[i]);
+            }
+            Assert.Throws<ArgumentOutOfRangeException>(() => engine.ConfigureLinger(TimeSpan.FromMilliseconds(2)));
+            Assert.Throws<ArgumentOutOfRangeException>(() => engine.ConfigureLinger(TimeSpan.Zero, 65));
+        }
+
+        [Fact]
+        public async Task Coalescer_ConcurrentSealAndOpen_ShouldRoundTripEachCall()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            using var coalescer = new AesGcmSivCoalescer(aesGcmSiv, TimeSpan.FromMicroseconds(20), maxBatchSize: 8);
+            const int CallCount = 200;
+            var plaintexts = Enumerable.Range(0, CallCount).Select(i => Enumerable.Repeat((byte)i, i % 50).ToArray()).ToArray();
+            var opened = new byte[CallCount][];
+
+            // Act
+            await Task.WhenAll(Enumerable.Range(0, CallCount).Select(i => Task.Run(async () =>
+            {
+                byte[] sealedData = await coalescer.SealAsync(plaintexts[i], _testAssociatedData);
+                opened[i] = await coalescer.OpenAsync(sealedData, _testAssociatedData);
+            })));
+            byte[] tampered = await coalescer.SealAsync(_testPlaintext);
+            tampered[^1] ^= 1;
+
+            // Assert
+            for (int i = 0; i < CallCount; i++)
+                Assert.Equal(plaintexts[i], opened[i]);
+            var direct = new byte[_testPlaintext.Length];
+            aesGcmSiv.Open(await coalescer.SealAsync(_testPlaintext), direct);
+            Assert.Equal(_testPlaintext, direct);
+            await Assert.ThrowsAsync<CryptographicException>(async () => await coalescer.OpenAsync(tampered));
+            await Assert.ThrowsAsync<ArgumentException>(async () => await coalescer.OpenAsync(new byte[27]));
+            Assert.Throws<ArgumentOutOfRangeException>(() => new AesGcmSivCoalescer(aesGcmSiv, TimeSpan.FromMilliseconds(2)));
+        }
+
+        [Fact]
+        public void Engine_AfterDispose_ShouldThrowObjectDisposedException()
+        {
+            // Arrange
+            var engine = new AesGcmSivEngine(workerCount: 1);
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            engine.Dispose();
+            engine.Dispose();
+
+            // Act & Assert
+            Assert.Throws<ObjectDisposedException>(() =>
+            {
+                _ = engine.EncryptAsync(aesGcmSiv, _testNonce, _testPlaintext, new byte[_testPlaintext.Length], new byte[16]);
+            });
+        }
+
+        [Fact]
+        public void Metrics_WithListener_ShouldRecordCallsBytesAndFailures()
+        {
+            // Arrange
+            var totals = new Dictionary<string, long>();
+            var durations = new List<string>();
+            using var listener = new System.Diagnostics.Metrics.MeterListener();
+            listener.InstrumentPublished = (instrument, l) =>
+            {
+                if (instrument.Meter.Name == System.Security.Cryptography.AesGcmSiv.MeterName)
+                    l.EnableMeasurementEvents(instrument);
+            };
+            listener.SetMeasurementEventCallback<long>((instrument, value, tags, state) =>
+            {
+                lock (totals)
+                    totals[instrument.Name] = totals.GetValueOrDefault(instrument.Name) + value;
+            });
+            // Without a completion callback, .NET 8's Dispose leaves the instruments enabled and
+            // later calls still land in this listener
+            listener.MeasurementsCompleted = (instrument, state) => { };
+            listener.SetMeasurementEventCallback<double>((instrument, value, tags, state) =>
+            {
+                lock (durations)
+                {
+                    foreach (var tag in tags)
+                    {
+                        if (tag.Key == "aesgcmsiv.size")
+                            durations.Add((string)tag.Value!);
+                    }
+                }
+            });
+            listener.Start();
+
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var plaintext = new byte[100];
+            var ciphertext = new byte[100];
+            var tag = new byte[16];
+            var decrypted = new byte[100];
+
+            // Act
+            aesGcmSiv.Encrypt(_testNonce, plaintext, ciphertext, tag);
+            aesGcmSiv.Decrypt(_testNonce, ciphertext, tag, decrypted);
+            tag[0] ^= 1;
+            bool verified = aesGcmSiv.TryDecrypt(_testNonce, ciphertext, tag, decrypted);
+            listener.Dispose();
+
+            // Assert
+            Assert.False(verified);
+            Assert.True(totals.GetValueOrDefault("aesgcmsiv.encryptions") >= 1);
+            Assert.True(totals.GetValueOrDefault("aesgcmsiv.decryptions") >= 2);
+            Assert.True(totals.GetValueOrDefault("aesgcmsiv.bytes") >= 200);
+            Assert.True(totals.GetValueOrDefault("aesgcmsiv.authentication_failures") >= 1);
+            Assert.Contains("<=256B", durations);
+        }
+
+        [Theory]
+        [InlineData(16)]
+        [InlineData(32)]
+        public void ManagedImplementation_ShouldMatchNativeOutput(int keySize)
+        {
+            if (!System.Security.Cryptography.AesGcmSiv.IsManagedImplementationSupported)
+                return;
+
+            // Arrange - sizes either side of block and CTR-stride boundaries, and of the Auto limit
+            var key = _testKey.AsSpan(0, keySize).ToArray();
+            using var native = new System.Security.Cryptography.AesGcmSiv(key);
+            using var managed = new System.Security.Cryptography.AesGcmSiv(key, AesGcmSivImplementation.Managed);
+            using var auto = new System.Security.Cryptography.AesGcmSiv(key, AesGcmSivImplementation.Auto);
+
+            foreach (int size in new[] { 0, 1, 15, 16, 17, 63, 64, 65, 255, 256, 257, 1000 })
+            {
+                var plaintext = new byte[size];
+                for (int i = 0; i < size; i++) plaintext[i] = (byte)(i * 7 + size);
+                var aad = _testAssociatedData.AsSpan(0, size % 17).ToArray();
+                var expected = new byte[size];
+                var expectedTag = new byte[16];
+                var ciphertext = new byte[size];
+                var tag = new byte[16];
+                var decrypted = new byte[size];
+
+                // Act
+                native.Encrypt(_testNonce, plaintext, expected, expectedTag, aad);
+                managed.Encrypt(_testNonce, plaintext, ciphertext, tag, aad);
+                managed.Decrypt(_testNonce, ciphertext, tag, decrypted, aad);
+
+                // Assert
+                Assert.Equal(expected, ciphertext);
+                Assert.Equal(expectedTag, tag);
+                Assert.Equal(plaintext, decrypted);
+
+                auto.Encrypt(_testNonce, plaintext, ciphertext, tag, aad);
+                Assert.Equal(expected, ciphertext);
+                Assert.Equal(expectedTag, tag);
+            }
+        }
+
+        [Fact]
+        public void ManagedMessageThreshold_ShouldSplitCallsWithoutChangingOutput()
+        {
+            if (!System.Security.Cryptography.AesGcmSiv.IsManagedImplementationSupported)
+                return;
+
+            // Arrange
+            using var native = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            using var auto = new System.Security.Cryptography.AesGcmSiv(_testKey, AesGcmSivImplementation.Auto);
+            var plaintext = new byte[4096];
+            var expected = new byte[plaintext.Length];
+            var expectedTag = new byte[16];
+            native.Encrypt(_testNonce, plaintext, expected, expectedTag, _testAssociatedData);
+            var ciphertext = new byte[plaintext.Length];
+            var tag = new byte[16];
+
+            // Assert - the measured default lies in the calibrated range
+            Assert.InRange(auto.ManagedMessageThreshold, 0, 64 * 1024);
+            Assert.Throws<ArgumentOutOfRangeException>(() => auto.ManagedMessageThreshold = -1);
+
+            foreach (int threshold in new[] { 0, plaintext.Length + _testAssociatedData.Length, int.MaxValue })
+            {
+                // Act
+                auto.ManagedMessageThreshold = threshold;
+                auto.Encrypt(_testNonce, plaintext, ciphertext, tag, _testAssociatedData);
+
+                // Assert
+                Assert.Equal(expected, ciphertext);
+                Assert.Equal(expectedTag, tag);
+            }
+        }
+
+        [Fact]
+        public void FromCache_ShouldMatchConstructorAndSurviveEviction()
+        {
+            // Arrange
+            using var direct = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var expected = new byte[_testPlaintext.Length];
+            var expectedTag = new byte[16];
+            direct.Encrypt(_testNonce, _testPlaintext, expected, expectedTag, _testAssociatedData);
+            var ciphertext = new byte[_testPlaintext.Length];
+            var tag = new byte[16];
+            var decrypted = new byte[_testPlaintext.Length];
+            int capacity = System.Security.Cryptography.AesGcmSiv.KeyCacheCapacity;
+
+            try
+            {
+                // Act - a miss, a hit, and a key that has been evicted while its instance lives
+                using var first = System.Security.Cryptography.AesGcmSiv.FromCache(_testKey);
+                using var second = System.Security.Cryptography.AesGcmSiv.FromCache(_testKey);
+                System.Security.Cryptography.AesGcmSiv.KeyCacheCapacity = 1;
+                using var other = System.Security.Cryptography.AesGcmSiv.FromCache(new byte[16]);
+                System.Security.Cryptography.AesGcmSiv.ClearKeyCache();
+
+                // Assert
+                first.Encrypt(_testNonce, _testPlaintext, ciphertext, tag, _testAssociatedData);
+                Assert.Equal(expected, ciphertext);
+                Assert.Equal(expectedTag, tag);
+                second.Decrypt(_testNonce, expected, expectedTag, decrypted, _testAssociatedData);
+                Assert.Equal(_testPlaintext, decrypted);
+                Assert.Throws<ArgumentException>(() => System.Security.Cryptography.AesGcmSiv.FromCache(new byte[20]));
+                Assert.Throws<ArgumentOutOfRangeException>(() => System.Security.Cryptography.AesGcmSiv.KeyCacheCapacity = -1);
+            }
+            finally
+            {
+                System.Security.Cryptography.AesGcmSiv.KeyCacheCapacity = capacity;
+            }
+        }
+
+        [Theory]
+        [InlineData(AesGcmSivImplementation.Native)]
+        [InlineData(AesGcmSivImplementation.Auto)]
+        public void Clone_ShouldMatchTemplateSettingsAndOutliveIt(AesGcmSivImplementation implementation)
+        {
+            // Arrange
+            var template = new System.Security.Cryptography.AesGcmSiv(_testKey, implementation)
+            {
+                MaxDegreeOfParallelism = 2,
+                NonceCacheSize = 16,
+                SmallMessageFastPath = true,
+            };
+            var expected = new byte[_testPlaintext.Length];
+            var expectedTag = new byte[16];
+            template.Encrypt(_testNonce, _testPlaintext, expected, expectedTag, _testAssociatedData);
+            var ciphertext = new byte[_testPlaintext.Length];
+            var tag = new byte[16];
+
+            // Act
+            using var clone = template.Clone();
+            template.Dispose();
+            clone.Encrypt(_testNonce, _testPlaintext, ciphertext, tag, _testAssociatedData);
+
+            // Assert
+            Assert.Equal(expected, ciphertext);
+            Assert.Equal(expectedTag, tag);
+            Assert.Equal(2, clone.MaxDegreeOfParallelism);
+            Assert.True(clone.SmallMessageFastPath);
+            Assert.Equal(0, clone.NonceCacheSize);
+            Assert.Throws<ObjectDisposedException>(() => template.Clone());
+        }
+
+        [Fact]
+        public void TuningProfile_CalibrateSaveLoadApply_ShouldNotChangeOutput()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var expected = new byte[_testPlaintext.Length];
+            var expectedTag = new byte[16];
+            aesGcmSiv.Encrypt(_testNonce, _testPlaintext, expected, expectedTag, _testAssociatedData);
+            var path = Path.Combine(Path.GetTempPath(), $"aesgcmsiv-tuning-{Guid.NewGuid():N}.json");
+
+            try
+            {
+                // Act
+                var profile = AesGcmSivTuningProfile.Calibrate();
+                profile.Save(path);
+                var loaded = AesGcmSivTuningProfile.Load(path);
+
+                // Assert
+                Assert.NotNull(loaded);
+                Assert.Equal(profile.Backend, loaded!.Backend);
+                Assert.Equal(profile.LaneMaxBlocks, loaded.LaneMaxBlocks);
+                Assert.InRange(loaded.LaneMaxBlocks, 0, 17);
+                Assert.Null(AesGcmSivTuningProfile.Load(path + ".missing"));
+
+                loaded.Apply();
+                var ciphertext = new byte[_testPlaintext.Length];
+                var tag = new byte[16];
+                aesGcmSiv.Encrypt(_testNonce, _testPlaintext, ciphertext, tag, _testAssociatedData);
+                Assert.Equal(expected, ciphertext);
+                Assert.Equal(expectedTag, tag);
+                Assert.Throws<ArgumentException>(() => new AesGcmSivTuningProfile { LaneMaxBlocks = 18 }.Apply());
+            }
+            finally
+            {
+                // Back to the built-in thresholds for the other tests
+                new AesGcmSivTuningProfile().Apply();
+                File.Delete(path);
+            }
+        }
+
+        [Fact]
+        public void KeyRing_SealWithKeyId_ShouldOpenUnderTheNamedKey()
+        {
+            // Arrange - IDs that differ only in their high bits, and one key of each size
+            using var keyring = new AesGcmSivKeyRing(4);
+            var keys = new[] { new byte[16], new byte[32], new byte[32] };
+            var ids = new uint[] { 0x01000000, 0x02000000, 0xFFFFFFFF };
+            for (int k = 0; k < keys.Length; k++)
+            {
+                for (int j = 0; j < keys[k].Length; j++) keys[k][j] = (byte)(k * 17 + j);
+                keyring.Add(ids[k], keys[k]);
+            }
+            var plaintext = System.Text.Encoding.UTF8.GetBytes("routed by its header");
+
+            // Act
+            var sealedData = new byte[plaintext.Length + AesGcmSivKeyRing.SealOverhead];
+            int written = keyring.Seal(ids[1], _testNonce, plaintext, sealedData, _testAssociatedData);
+            var opened = new byte[plaintext.Length];
+            int read = keyring.Open(sealedData, opened, out uint keyId, _testAssociatedData);
+
+            // Assert
+            Assert.Equal(sealedData.Length, written);
+            Assert.Equal(plaintext.Length, read);
+            Assert.Equal(ids[1], keyId);
+            Assert.Equal(ids[1], AesGcmSivKeyRing.ReadKeyId(sealedData));
+            Assert.Equal(new byte[] { 0x02, 0, 0, 0 }, sealedData.AsSpan(0, 4).ToArray());
+            Assert.Equal(plaintext, opened);
+            using (var single = new System.Security.Cryptography.AesGcmSiv(keys[1]))
+            {
+                var expected = new byte[plaintext.Length + System.Security.Cryptography.AesGcmSiv.SealOverhead];
+                single.Seal(_testNonce, plaintext, expected, _testAssociatedData);
+                Assert.Equal(expected, sealedData.AsSpan(AesGcmSivKeyRing.KeyIdSize).ToArray());
+            }
+
+            var tampered = (byte[])sealedData.Clone();
+            tampered[^1] ^= 1;
+            Assert.Throws<CryptographicException>(() => keyring.Open(tampered, opened, out _, _testAssociatedData));
+            Assert.Throws<InvalidOperationException>(() => keyring.Add(ids[0], keys[0]));
+            Assert.Throws<KeyNotFoundException>(() => keyring.Seal(7, _testNonce, plaintext, sealedData));
+            Assert.True(keyring.Remove(ids[1]));
+            Assert.False(keyring.Remove(ids[1]));
+            Assert.Throws<CryptographicException>(() => keyring.Open(sealedData, opened, out _, _testAssociatedData));
+        }
+
+        [Fact]
+        public void KeyRing_GetUsage_ShouldCountEachKeysMessages()
+        {
+            // Arrange - one key added before tracking is enabled and one after
+            using var keyring = new AesGcmSivKeyRing(4);
+            keyring.Add(1, new byte[32]);
+            keyring.SetUsageTracking(true);
+            keyring.Add(2, _testKey);
+            var plaintext = new byte[100];
+            var sealedData = new byte[plaintext.Length + AesGcmSivKeyRing.SealOverhead];
+            var opened = new byte[plaintext.Length];
+            var before = DateTimeOffset.UtcNow.AddSeconds(-1);
+
+            // Act
+            for (int i = 0; i < 3; i++)
+                keyring.Seal(1, _testNonce, plaintext, sealedData);
+            keyring.Open(sealedData, opened, out _);
+            sealedData[^1] ^= 1;
+            Assert.Throws<CryptographicException>(() => keyring.Open(sealedData, opened, out _));
+            var usage = keyring.GetUsage().OrderBy(u => u.KeyId).ToArray();
+
+            // Assert
+            Assert.Equal(new uint[] { 1, 2 }, usage.Select(u => u.KeyId).ToArray());
+            Assert.Equal(5, usage[0].Operations);
+            Assert.Equal(4 * plaintext.Length, usage[0].Bytes);
+            Assert.Equal(1, usage[0].Failures);
+            Assert.True(usage[0].LastUsed >= before);
+            Assert.Equal(0, usage[1].Operations);
+            Assert.Null(usage[1].LastUsed);
+
+            keyring.SetUsageTracking(false);
+            keyring.Seal(1, _testNonce, plaintext, sealedData);
+            Assert.True(keyring.Remove(2));
+            var after = Assert.Single(keyring.GetUsage());
+            Assert.Equal(5, after.Operations);
+        }
+
+        [Fact]
+        public void KeyRing_RotatingKeysUnderConcurrentSealsAndOpens_ShouldOnlyUseHeldKeys()
+        {
+            // Arrange - a window of four keys, each its ID repeated, moved on one key at a time
+            const int Window = 4;
+            const uint Rotations = 2000;
+            using var keyring = new AesGcmSivKeyRing(Window + 1);
+            static byte[] KeyFor(uint id) => Enumerable.Repeat((byte)id, 32).ToArray();
+            for (uint id = 0; id < Window; id++)
+                keyring.Add(id, KeyFor(id));
+            long newest = Window - 1;
+            long opened = 0;
+            using var done = new CancellationTokenSource();
+
+            // Act - readers seal and open under any key that may still be held while one writer
+            // adds the next key and removes the oldest
+            var readers = Enumerable.Range(0, 4).Select(r => Task.Run(() =>
+            {
+                var random = new Random(r);
+                var plaintext = new byte[64 + r * 100];
+                var sealedData = new byte[plaintext.Length + AesGcmSivKeyRing.SealOverhead];
+                var output = new byte[plaintext.Length];
+                while (!done.IsCancellationRequested)
+                {
+                    uint id = (uint)(Interlocked.Read(ref newest) - random.Next(Window + 1));
+                    random.NextBytes(plaintext);
+                    try
+                    {
+                        keyring.Seal(id, _testNonce, plaintext, sealedData);
+                    }
+                    catch (KeyNotFoundException)
+                    {
+                        // Removed before it could seal
+                        continue;
+                    }
+                    try
+                    {
+                        keyring.Open(sealedData, output, out uint keyId);
+                        Assert.Equal(id, keyId);
+                        Assert.Equal(plaintext, output);
+                        Interlocked.Increment(ref opened);
+                    }
+                    catch (CryptographicException)
+                    {
+                        // Only because the key was removed after sealing
+                        Assert.Throws<KeyNotFoundException>(() => keyring.Seal(id, _testNonce, plaintext, sealedData));
+                    }
+                }
+            })).ToArray();
+            var writer = Task.Run(() =>
+            {
+                for (uint id = Window; id < Window + Rotations; id++)
+                {
+                    keyring.Add(id, KeyFor(id));
+                    Interlocked.Exchange(ref newest, id);
+                    Assert.True(keyring.Remove(id - Window));
+                }
+                done.Cancel();
+            });
+            Task.WaitAll(readers.Append(writer).ToArray());
+
+            // Assert - every key held at the end still works, and every removed one is gone
+            Assert.True(Interlocked.Read(ref opened) > 0);
+            var sealedCheck = new byte[16 + AesGcmSivKeyRing.SealOverhead];
+            var openedCheck = new byte[16];
+            for (uint id = Rotations; id < Rotations + Window; id++)
+            {
+                keyring.Seal(id, _testNonce, new byte[16], sealedCheck);
+                keyring.Open(sealedCheck, openedCheck, out _);
+            }
+            Assert.Throws<KeyNotFoundException>(() => keyring.Seal(Rotations - 1, _testNonce, new byte[16], sealedCheck));
+            Assert.Equal(Window, keyring.GetUsage().Length);
+        }
+
+        [FaultInjectionFact]
+        public void KeyRing_SetUsageTracking_WithFailedAllocation_ShouldLeaveTrackingOff()
+        {
+            // Arrange - three keys, so the second of their counter blocks can fail
+            using var keyring = new AesGcmSivKeyRing(4);
+            for (uint id = 1; id <= 3; id++)
+                keyring.Add(id, _testKey);
+            var plaintext = new byte[100];
+            var sealedData = new byte[plaintext.Length + AesGcmSivKeyRing.SealOverhead];
+
+            // Act
+            Assert.Equal(NativeMethods.Success, NativeMethods.aesgcmsiv_debug_fail_alloc(1));
+            try
+            {
+                Assert.Throws<CryptographicException>(() => keyring.SetUsageTracking(true));
+            }
+            finally
+            {
+                NativeMethods.aesgcmsiv_debug_fail_alloc(uint.MaxValue);
+            }
+            for (uint id = 1; id <= 3; id++)
+                keyring.Seal(id, _testNonce, plaintext, sealedData);
+
+            // Assert - no key counted, and a retry turns tracking on for all of them
+            foreach (var usage in keyring.GetUsage())
+                Assert.Equal(0, usage.Operations);
+            keyring.SetUsageTracking(true);
+            for (uint id = 1; id <= 3; id++)
+                keyring.Seal(id, _testNonce, plaintext, sealedData);
+            foreach (var usage in keyring.GetUsage())
+                Assert.Equal(1, usage.Operations);
+        }
+
+        [Fact]
+        public void KeyTable_MixedKeyBatch_ShouldMatchPerKeyInstances()
+        {
+            // Arrange - 128- and 256-bit keys interleaved, with one slot left empty
+            var keys = new byte[5][];
+            using var table = new AesGcmSivKeyTable(keys.Length + 1);
+            for (int k = 0; k < keys.Length; k++)
+            {
+                keys[k] = new byte[k % 2 == 0 ? 16 : 32];
+                for (int j = 0; j < keys[k].Length; j++) keys[k][j] = (byte)(k * 31 + j);
+                table.SetKey(k, keys[k]);
+            }
+            var items = new AesGcmSivBatchItem[40];
+            var slots = new int[items.Length];
+            for (int i = 0; i < items.Length; i++)
+            {
+                var plaintext = new byte[i * 7 % 61];
+                for (int j = 0; j < plaintext.Length; j++) plaintext[j] = (byte)(i ^ j);
+                var nonce = (byte[])_testNonce.Clone();
+                nonce[0] = (byte)i;
+                items[i] = new AesGcmSivBatchItem(nonce, plaintext, new byte[plaintext.Length], new byte[16], _testAssociatedData);
+                slots[i] = i * 3 % keys.Length;
+            }
+
+            // Act
+            table.EncryptBatch(items, slots);
+            var decrypted = new AesGcmSivBatchItem[items.Length];
+            for (int i = 0; i < items.Length; i++)
+            {
+                decrypted[i] = new AesGcmSivBatchItem(items[i].Nonce, items[i].Output, new byte[items[i].Input.Length], items[i].Tag, _testAssociatedData);
+            }
+            var tampered = (byte[])items[3].Tag.Clone();
+            tampered[0] ^= 1;
+            decrypted[3] = new AesGcmSivBatchItem(items[3].Nonce, items[3].Output, new byte[items[3].Input.Length], tampered, _testAssociatedData);
+            var succeeded = new bool[items.Length];
+            int failures = table.DecryptBatch(decrypted, slots, succeeded);
+
+            // Assert
+            Assert.Equal(1, failures);
+            Assert.False(succeeded[3]);
+            for (int i = 0; i < items.Length; i++)
+            {
+                using var single = new System.Security.Cryptography.AesGcmSiv(keys[slots[i]]);
+                var expectedCiphertext = new byte[items[i].Input.Length];
+                var expectedTag = new byte[16];
+                single.Encrypt(items[i].Nonce, items[i].Input, expectedCiphertext, expectedTag, _testAssociatedData);
+                Assert.Equal(expectedCiphertext, items[i].Output);
+                Assert.Equal(expectedTag, items[i].Tag);
+                if (i != 3)
+                {
+                    Assert.True(succeeded[i]);
+                    Assert.Equal(items[i].Input, decrypted[i].Output);
+                }
+            }
+            Assert.Throws<CryptographicException>(() => table.EncryptBatch(items.AsSpan(0, 1), new[] { keys.Length }));
+            Assert.Throws<ArgumentOutOfRangeException>(() => table.EncryptBatch(items.AsSpan(0, 1), new[] { keys.Length + 1 }));
+            table.ClearKey(0);
+            Assert.Throws<CryptographicException>(() => table.EncryptBatch(items.AsSpan(0, 1), new[] { 0 }));
+        }
+
+        [Theory]
+        [InlineData(16, false)]
+        [InlineData(32, true)]
+        public void KeyDerivation_Batch_ShouldMatchHkdfKeysPerRecord(int keySize, bool cacheKeys)
+        {
+            // Arrange - IDs short enough to be cached and hashed eight at a time, plus one that is neither
+            var masterKey = new byte[40];
+            for (int j = 0; j < masterKey.Length; j++) masterKey[j] = (byte)(j * 5);
+            var salt = new byte[] { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+            using var derivation = new AesGcmSivKeyDerivation(masterKey, salt, keySize, cacheKeys);
+            var items = new AesGcmSivBatchItem[100];
+            var recordIds = new byte[items.Length][];
+            for (int i = 0; i < items.Length; i++)
+            {
+                recordIds[i] = i == 7 ? new byte[100] : System.Text.Encoding.UTF8.GetBytes($"customer-{i % 40}");
+                var plaintext = new byte[i * 7 % 61];
+                for (int j = 0; j < plaintext.Length; j++) plaintext[j] = (byte)(i ^ j);
+                var nonce = (byte[])_testNonce.Clone();
+                nonce[0] = (byte)i;
+                items[i] = new AesGcmSivBatchItem(nonce, plaintext, new byte[plaintext.Length], new byte[16], _testAssociatedData);
+            }
+
+            // Act - twice, so the second pass finds the keys in the cache when there is one
+            derivation.EncryptBatch(items, recordIds);
+            var firstOutputs = items.Select(item => (byte[])item.Output.Clone()).ToArray();
+            derivation.EncryptBatch(items, recordIds);
+            var decrypted = new AesGcmSivBatchItem[items.Length];
+            for (int i = 0; i < items.Length; i++)
+            {
+                decrypted[i] = new AesGcmSivBatchItem(items[i].Nonce, items[i].Output, new byte[items[i].Input.Length], items[i].Tag, _testAssociatedData);
+            }
+            var tampered = (byte[])items[3].Tag.Clone();
+            tampered[0] ^= 1;
+            decrypted[3] = new AesGcmSivBatchItem(items[3].Nonce, items[3].Output, new byte[items[3].Input.Length], tampered, _testAssociatedData);
+            var succeeded = new bool[items.Length];
+            int failures = derivation.DecryptBatch(decrypted, recordIds, succeeded);
+
+            // Assert
+            Assert.Equal(1, failures);
+            Assert.False(succeeded[3]);
+            var derived = new byte[keySize];
+            for (int i = 0; i < items.Length; i++)
+            {
+                var expectedKey = HKDF.DeriveKey(HashAlgorithmName.SHA256, masterKey, keySize, salt, recordIds[i]);
+                derivation.DeriveKey(recordIds[i], derived);
+                Assert.Equal(expectedKey, derived);
+
+                using var single = new System.Security.Cryptography.AesGcmSiv(expectedKey);
+                var expectedCiphertext = new byte[items[i].Input.Length];
+                var expectedTag = new byte[16];
+                single.Encrypt(items[i].Nonce, items[i].Input, expectedCiphertext, expectedTag, _testAssociatedData);
+                Assert.Equal(expectedCiphertext, items[i].Output);
+                Assert.Equal(expectedCiphertext, firstOutputs[i]);
+                Assert.Equal(expectedTag, items[i].Tag);
+                if (i != 3)
+                {
+                    Assert.True(succeeded[i]);
+                    Assert.Equal(items[i].Input, decrypted[i].Output);
+                }
+            }
+            Assert.Throws<ArgumentNullException>(() => derivation.EncryptBatch(items.AsSpan(0, 1), new byte[1][]));
+        }
+
+        [Fact]
+        public void EnvelopeEncryptor_ShouldReuseDataKeysAndCacheUnwrappedOnes()
+        {
+            // Arrange - a stand-in KMS that hands out random handles and counts its calls
+            var kms = new Dictionary<string, byte[]>();
+            int wraps = 0, unwraps = 0;
+            byte[] Wrap(byte[] key)
+            {
+                wraps++;
+                byte[] handle = RandomNumberGenerator.GetBytes(24);
+                kms[Convert.ToHexString(handle)] = key;
+                return handle;
+            }
+            byte[] Unwrap(byte[] handle)
+            {
+                unwraps++;
+                return (byte[])kms[Convert.ToHexString(handle)].Clone();
+            }
+            using var sender = new AesGcmSivEnvelopeEncryptor(Wrap, Unwrap) { MessagesPerKey = 3 };
+            using var receiver = new AesGcmSivEnvelopeEncryptor(Wrap, Unwrap);
+            var messages = Enumerable.Range(0, 10).Select(i => new byte[i * 13]).ToArray();
+
+            // Act
+            var envelopes = messages.Select(m => sender.Encrypt(m, _testAssociatedData)).ToArray();
+            var decrypted = envelopes.Select(e => receiver.Decrypt(e, _testAssociatedData)).ToArray();
+            var again = envelopes.Select(e => receiver.Decrypt(e, _testAssociatedData)).ToArray();
+            var ownDecrypted = sender.Decrypt(envelopes[9], _testAssociatedData);
+
+            // Assert - a data key per three messages, each unwrapped once by the receiver and never by the sender
+            Assert.Equal(4, wraps);
+            Assert.Equal(4, unwraps);
+            Assert.Equal(4, receiver.CachedKeyCount);
+            Assert.Equal(messages, decrypted);
+            Assert.Equal(messages, again);
+            Assert.Equal(messages[9], ownDecrypted);
+            Assert.Equal(AesGcmSivEnvelopeEncryptor.GetEnvelopeLength(13, 24), envelopes[1].Length);
+            envelopes[1][^1] ^= 1;
+            Assert.ThrowsAny<CryptographicException>(() => receiver.Decrypt(envelopes[1], _testAssociatedData));
+            Assert.ThrowsAny<CryptographicException>(() => receiver.Decrypt(envelopes[2].AsSpan(0, 10)));
+
+            receiver.CacheCapacity = 0;
+            receiver.Decrypt(envelopes[0], _testAssociatedData);
+            sender.RotateKey();
+            sender.Encrypt(messages[0]);
+            Assert.Equal(5, unwraps);
+            Assert.Equal(5, wraps);
+            Assert.Equal(0, receiver.CachedKeyCount);
+        }
+
+        [Fact]
+        public void KeyWrap_ShouldMatchEncryptWithFixedNonceAndRejectTampering()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            using var keyWrap = new AesGcmSivKeyWrap(_testKey, _testNonce);
+            var dataKey = new byte[32];
+            for (int i = 0; i < dataKey.Length; i++) dataKey[i] = (byte)(i * 11);
+            var expected = new byte[dataKey.Length];
+            var expectedTag = new byte[16];
+            aesGcmSiv.Encrypt(_testNonce, dataKey, expected, expectedTag, _testAssociatedData);
+            var wrapped = new byte[dataKey.Length];
+            var tag = new byte[16];
+            var unwrapped = new byte[dataKey.Length];
+
+            // Act
+            keyWrap.Wrap(dataKey, wrapped, tag, _testAssociatedData);
+            keyWrap.Unwrap(wrapped, tag, unwrapped, _testAssociatedData);
+            tag[0] ^= 1;
+            bool forged = keyWrap.TryUnwrap(wrapped, tag, new byte[dataKey.Length], _testAssociatedData);
+
+            // Assert
+            tag[0] ^= 1;
+            Assert.Equal(expected, wrapped);
+            Assert.Equal(expectedTag, tag);
+            Assert.Equal(dataKey, unwrapped);
+            Assert.False(forged);
+            Assert.Throws<ArgumentException>(() => new AesGcmSivKeyWrap(_testKey, new byte[8]));
+        }
+
+        [Fact]
+        public void StreamingThreshold_LargeMessage_ShouldNotChangeOutput()
+        {
+            // Arrange
+            using var plain = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            using var streaming = new System.Security.Cryptography.AesGcmSiv(_testKey) { StreamingThreshold = 4096 };
+            var plaintext = new byte[(1 << 20) + 7];
+            new Random(75).NextBytes(plaintext);
+            var expected = new byte[plaintext.Length];
+            var expectedTag = new byte[16];
+            var ciphertext = new byte[plaintext.Length];
+            var tag = new byte[16];
+            var decrypted = new byte[plaintext.Length];
+
+            // Act
+            plain.Encrypt(_testNonce, plaintext, expected, expectedTag, _testAssociatedData);
+            streaming.Encrypt(_testNonce, plaintext, ciphertext, tag, _testAssociatedData);
+            streaming.Decrypt(_testNonce, ciphertext, tag, decrypted, _testAssociatedData);
+
+            // Assert
+            Assert.Equal(expected, ciphertext);
+            Assert.Equal(expectedTag, tag);
+            Assert.Equal(plaintext, decrypted);
+            Assert.Equal(4096, streaming.StreamingThreshold);
+            Assert.Throws<ArgumentOutOfRangeException>(() => streaming.StreamingThreshold = -1);
+        }
+
+        [Theory]
+        [InlineData(64, 1024)]
+        [InlineData(long.MaxValue, 1 << 16)]
+        public void WideVectorThreshold_ShouldNotChangeOutput(long threshold, int length)
+        {
+            // Arrange
+            using var wide = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            using var narrow = new System.Security.Cryptography.AesGcmSiv(_testKey) { WideVectorThreshold = threshold };
+            var plaintext = new byte[length + 5];
+            new Random(109).NextBytes(plaintext);
+            var expected = new byte[plaintext.Length];
+            var expectedTag = new byte[16];
+            var ciphertext = new byte[plaintext.Length];
+            var tag = new byte[16];
+            var decrypted = new byte[plaintext.Length];
+
+            // Act
+            wide.Encrypt(_testNonce, plaintext, expected, expectedTag, _testAssociatedData);
+            narrow.Encrypt(_testNonce, plaintext, ciphertext, tag, _testAssociatedData);
+            narrow.Decrypt(_testNonce, ciphertext, tag, decrypted, _testAssociatedData);
+
+            // Assert
+            Assert.Equal(expected, ciphertext);
+            Assert.Equal(expectedTag, tag);
+            Assert.Equal(plaintext, decrypted);
+            Assert.Equal(threshold, narrow.WideVectorThreshold);
+            Assert.Throws<ArgumentOutOfRangeException>(() => narrow.WideVectorThreshold = -1);
+        }
+
+        [Fact]
+        public void NonceCache_RepeatedNonces_ShouldNotChangeOutput()
+        {
+            // Arrange
+            using var plain = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            using var cached = new System.Security.Cryptography.AesGcmSiv(_testKey) { NonceCacheSize = 4 };
+            var expected = new byte[_testPlaintext.Length];
+            var expectedTag = new byte[16];
+            var ciphertext = new byte[_testPlaintext.Length];
+            var tag = new byte[16];
+            var decrypted = new byte[_testPlaintext.Length];
+
+            // Act & Assert - more nonces than entries, each seen repeatedly
+            for (int i = 0; i < 24; i++)
+            {
+                var nonce = (byte[])_testNonce.Clone();
+                nonce[0] = (byte)(i % 6);
+                plain.Encrypt(nonce, _testPlaintext, expected, expectedTag, _testAssociatedData);
+                cached.Encrypt(nonce, _testPlaintext, ciphertext, tag, _testAssociatedData);
+                Assert.Equal(expected, ciphertext);
+                Assert.Equal(expectedTag, tag);
+                cached.Decrypt(nonce, ciphertext, tag, decrypted, _testAssociatedData);
+                Assert.Equal(_testPlaintext, decrypted);
+            }
+            cached.NonceCacheSize = 0;
+            Assert.Equal(0, cached.NonceCacheSize);
+            Assert.Throws<ArgumentOutOfRangeException>(() => cached.NonceCacheSize = 4097);
+        }
+
+        [Fact]
+        public void ManagedImplementation_WithTamperedTag_ShouldZeroOutput()
+        {
+            if (!System.Security.Cryptography.AesGcmSiv.IsManagedImplementationSupported)
+                return;
+
+            // Arrange
+            using var managed = new System.Security.Cryptography.AesGcmSiv(_testKey, AesGcmSivImplementation.Managed);
+            var ciphertext = new byte[_testPlaintext.Length];
+            var tag = new byte[16];
+            var decrypted = new byte[_testPlaintext.Length];
+            managed.Encrypt(_testNonce, _testPlaintext, ciphertext, tag, _testAssociatedData);
+            tag[15] ^= 0x80;
+
+            // Act
+            bool verified = managed.TryDecrypt(_testNonce, ciphertext, tag, decrypted, _testAssociatedData);
+
+            // Assert
+            Assert.False(verified);
+            Assert.Equal(new byte[decrypted.Length], decrypted);
+        }
+
+        [Fact]
+        public void ManagedImplementation_BatchAndSegments_ShouldMatchNative()
+        {
+            if (!System.Security.Cryptography.AesGcmSiv.IsManagedImplementationSupported)
+                return;
+
+            // Arrange
+            using var native = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            using var managed = new System.Security.Cryptography.AesGcmSiv(_testKey, AesGcmSivImplementation.Managed);
+            var expected = new byte[_testPlaintext.Length];
+            var expectedTag = new byte[16];
+            native.Encrypt(_testNonce, _testPlaintext, expected, expectedTag, _testAssociatedData);
+
+            var output = new byte[_testPlaintext.Length];
+            var tag = new byte[16];
+            var segments = new[]
+            {
+                new ArraySegment<byte>(_testPlaintext, 0, 10),
+                new ArraySegment<byte>(_testPlaintext, 10, _testPlaintext.Length - 10),
+            };
+            var outputSegments = new[]
+            {
+                new ArraySegment<byte>(output, 0, 33),
+                new ArraySegment<byte>(output, 33, output.Length - 33),
+            };
+            var batchOutput = new byte[_testPlaintext.Length];
+            var batchTag = new byte[16];
+
+            // Act
+            managed.Encrypt(_testNonce, segments, outputSegments, tag, new[] { new ArraySegment<byte>(_testAssociatedData) });
+            managed.EncryptBatch(new[]
+            {
+                new AesGcmSivBatchItem(_testNonce, _testPlaintext, batchOutput, batchTag, _testAssociatedData),
+            });
+
+            // Assert
+            Assert.Equal(expected, output);
+            Assert.Equal(expectedTag, tag);
+            Assert.Equal(expected, batchOutput);
+            Assert.Equal(expectedTag, batchTag);
+            using var engine = new AesGcmSivEngine();
+            Assert.Throws<NotSupportedException>(() =>
+                engine.EncryptAsync(managed, _testNonce, _testPlaintext, output, tag));
+        }
+
+        [Fact]
+        public async Task RecordLog_ShouldReplayConcurrentAppendsAndRejectTampering()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            string path = Path.GetTempFileName();
+            static byte[] Record(int i) => Enumerable.Range(0, i % 97).Select(b => (byte)(b + i)).ToArray();
+            try
+            {
+                // Act - many threads share commits, then a second session carries on numbering
+                var numbers = new long[200];
+                using (var log = new AesGcmSivRecordLog(path, aesGcmSiv))
+                {
+                    Parallel.For(0, 150, i => numbers[i] = log.Append(Record(i)));
+                }
+                using (var log = new AesGcmSivRecordLog(path, aesGcmSiv, flushToDisk: false))
+                {
+                    Assert.Equal(150, log.RecordCount);
+                    await Task.WhenAll(Enumerable.Range(150, 50).Select(async i => numbers[i] = await log.AppendAsync(Record(i))));
+                }
+
+                // Assert - every record comes back under the number its append returned
+                var replayed = new Dictionary<long, byte[]>();
+                using (var reader = new AesGcmSivRecordLogReader(path, aesGcmSiv))
+                {
+                    while (reader.TryRead(out long number, out ReadOnlyMemory<byte> record))
+                        replayed.Add(number, record.ToArray());
+                }
+                Assert.Equal(200, replayed.Count);
+                for (int i = 0; i < 200; i++)
+                    Assert.Equal(Record(i), replayed[numbers[i]]);
+
+                // A torn last block is dropped when the log is reopened
+                long whole = new FileInfo(path).Length;
+                using (var file = File.OpenWrite(path))
+                {
+                    file.Seek(0, SeekOrigin.End);
+                    file.Write(new byte[] { 1, 0, 0, 0, 9, 0, 0, 0, 3 });
+                }
+                using (var log = new AesGcmSivRecordLog(path, aesGcmSiv))
+                {
+                    Assert.Equal(whole, new FileInfo(path).Length);
+                    Assert.Equal(200, log.Append(Record(200)));
+                }
+
+                // A flipped tag bit fails the replay
+                byte[] bytes = File.ReadAllBytes(path);
+                bytes[^1] ^= 1;
+                File.WriteAllBytes(path, bytes);
+                using (var reader = new AesGcmSivRecordLogReader(path, aesGcmSiv))
+                {
+                    Assert.Throws<CryptographicException>(() =>
+                    {
+                        while (reader.TryRead(out _, out _))
+                        {
+                        }
+                    });
+                }
+            }
+            finally
+            {
+                File.Delete(path);
+            }
+        }
+
+        [Fact]
+        public void ChunkStore_ShouldDeduplicateShiftedDataAndRestoreIt()
+        {
+            // Arrange
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_testKey);
+            var chunkIdKey = Enumerable.Range(0, 32).Select(i => (byte)(i + 50)).ToArray();
+            string path = Path.GetTempFileName();
+            var original = new byte[3 << 20];
+            new Random(111).NextBytes(original);
+            // The same data with 100 bytes inserted near the start
+            var shifted = original.Take(5000).Concat(new byte[100]).Concat(original.Skip(5000)).ToArray();
+            try
+            {
+                // Act
+                byte[] originalRecipe, shiftedRecipe;
+                long originalStored, shiftedStored, duplicate;
+                using (var store = new AesGcmSivChunkStore(path, aesGcmSiv, chunkIdKey, averageChunkSize: 16 << 10))
+                {
+                    originalRecipe = store.Store(new MemoryStream(original));
+                    originalStored = store.StoredBytes;
+                }
+                using (var store = new AesGcmSivChunkStore(path, aesGcmSiv, chunkIdKey, averageChunkSize: 16 << 10))
+                {
+                    shiftedRecipe = store.Store(new MemoryStream(shifted));
+                    shiftedStored = store.StoredBytes;
+                    duplicate = store.DuplicateBytes;
+                }
+
+                // Assert - only the chunks around the insertion are new
+                Assert.Equal(original.Length, originalStored);
+                Assert.True(shiftedStored < 256 << 10, $"{shiftedStored} bytes stored again");
+                Assert.Equal(shifted.Length, shiftedStored + duplicate);
+                using (var store = new AesGcmSivChunkStore(path, aesGcmSiv, chunkIdKey))
+                {
+                    var restored = new MemoryStream();
+                    store.Restore(originalRecipe, restored);
+                    Assert.Equal(original, restored.ToArray());
+                    restored.SetLength(0);
+                    store.Restore(shiftedRecipe, restored);
+                    Assert.Equal(shifted, restored.ToArray());
+                    Assert.Throws<CryptographicException>(() => store.Restore(new byte[32], Stream.Null));
+                }
+
+                // A flipped ciphertext bit fails the restore
+                byte[] bytes = File.ReadAllBytes(path);
+                bytes[AesGcmSivChunkStore.HeaderSize + 40] ^= 1;
+                File.WriteAllBytes(path, bytes);
+                using (var store = new AesGcmSivChunkStore(path, aesGcmSiv, chunkIdKey))
+                {
+                    Assert.Throws<CryptographicException>(() => store.Restore(originalRecipe, Stream.Null));
+                }
+            }
+            finally
+            {
+                File.Delete(path);
+            }
+        }
+
+        [Fact]
+        public void ValueCache_SetGetRemoveAndBatch_ShouldRoundTrip()
+        {
+            // Arrange
+            using var cache = new AesGcmSivValueCache(capacity: 100, _testKey);
+            var ids = Enumerable.Range(0, 10).Select(i => (ulong)i * 7919).ToArray();
+            var lengths = Enumerable.Range(0, 10).Select(i => i * 50).ToArray();
+            var values = new byte[lengths.Sum()];
+            new Random(128).NextBytes(values);
+
+            // Act
+            cache.Set(1, _testPlaintext);
+            cache.Set(2, ReadOnlySpan<byte>.Empty);
+            cache.SetBatch(ids, values, lengths);
+            var destination = new byte[(ids.Length + 1) * 500];
+            var gotLengths = new int[ids.Length + 1];
+            int found = cache.GetBatch([.. ids, 12345], destination, 500, gotLengths);
+
+            // Assert
+            Assert.Equal(_testPlaintext, cache.Get(1));
+            Assert.Equal(Array.Empty<byte>(), cache.Get(2));
+            Assert.Null(cache.Get(3));
+            Assert.Equal(12, cache.Count);
+            Assert.Equal(ids.Length, found);
+            Assert.Equal(-1, gotLengths[ids.Length]);
+            int offset = 0;
+            for (int i = 0; i < ids.Length; i++)
+            {
+                Assert.Equal(lengths[i], gotLengths[i]);
+                Assert.Equal(values.AsSpan(offset, lengths[i]).ToArray(), destination.AsSpan(i * 500, lengths[i]).ToArray());
+                offset += lengths[i];
+            }
+            Assert.Throws<ArgumentException>(() => cache.TryGet(ids[9], new byte[10], out _));
+            Assert.True(cache.Remove(1));
+            Assert.False(cache.Remove(1));
+            Assert.False(cache.TryGet(1, new byte[100], out int written));
+            Assert.Equal(0, written);
+        }
+
+        [Fact]
+        public void SelectBackend_ShouldRejectUnknownNameAndKeepCurrent()
+        {
+            // Arrange
+            var name = System.Security.Cryptography.AesGcmSiv.BackendName;
+
+            // Act & Assert
+            Assert.Throws<ArgumentException>(() => System.Security.Cryptography.AesGcmSiv.SelectBackend("no-such-backend"));
+            Assert.Equal(name, System.Security.Cryptography.AesGcmSiv.BackendName);
+
+            // Selecting the backend already in use, then the default, changes nothing
+            System.Security.Cryptography.AesGcmSiv.SelectBackend(name);
+            System.Security.Cryptography.AesGcmSiv.SelectBackend(null);
+            Assert.Equal(name, System.Security.Cryptography.AesGcmSiv.BackendName);
+        }
+
+        [Fact]
+        public void CpuFeatures_ShouldCoverSelectedKernel()
+        {
+            // Act
+            var name = System.Security.Cryptography.AesGcmSiv.BackendName;
+            var features = System.Security.Cryptography.AesGcmSiv.CpuFeatures;
+
+            // Assert - a hand-written kernel is only selected when its instructions are present
+            if (name == "aesni" || name == "vaes-avx512")
+            {
+                Assert.True(features.HasFlag(AesGcmSivCpuFeatures.AesNi | AesGcmSivCpuFeatures.Pclmulqdq));
+            }
+            if (name == "vaes-avx512")
+            {
+                Assert.True(features.HasFlag(AesGcmSivCpuFeatures.Vaes | AesGcmSivCpuFeatures.Vpclmulqdq));
+            }
+            if (name == "armv8-crypto")
+            {
+                Assert.True(features.HasFlag(AesGcmSivCpuFeatures.ArmAes | AesGcmSivCpuFeatures.ArmPmull));
+            }
+            if (name == "bitsliced-ct64")
+            {
+                // The software kernel is the last resort, never chosen over a hardware one
+                Assert.False(features.HasFlag(AesGcmSivCpuFeatures.AesNi | AesGcmSivCpuFeatures.Pclmulqdq));
+                Assert.False(features.HasFlag(AesGcmSivCpuFeatures.ArmAes | AesGcmSivCpuFeatures.ArmPmull));
+            }
+        }
     }
 }
@@ -0,0 +1,150 @@
+using Xunit;
+using static AesGcmSiv.Tests.NativeMethods;
+
+namespace AesGcmSiv.Tests
+{
+    /// <summary>
+    /// Tests for verifying messages without producing their plaintext, through the native API.
+    /// </summary>
+    public unsafe class VerifyCiphertextTests
+    {
+        private const int TagLength = 16;
+
+        private readonly byte[] _key;
+
+        public VerifyCiphertextTests()
+        {
+            _key = Enumerable.Range(0, 32).Select(i => (byte)(i * 11)).ToArray();
+        }
+
+        private static byte[] Nonce(int i) => Enumerable.Range(0, 12).Select(j => (byte)(i + j)).ToArray();
+
+        private (byte[] Ciphertext, byte[] Tag) Seal(int i, int length, byte[]? aad)
+        {
+            using var aesGcmSiv = new System.Security.Cryptography.AesGcmSiv(_key);
+            var plaintext = Enumerable.Range(0, length).Select(j => (byte)(i * 7 + j)).ToArray();
+            var ciphertext = new byte[length];
+            var tag = new byte[TagLength];
+            aesGcmSiv.Encrypt(Nonce(i), plaintext, ciphertext, tag, aad);
+            return (ciphertext, tag);
+        }
+
+        private static int Verify(Context ctx, byte[]? nonce, byte[] ciphertext, byte[]? aad, byte[]? tag)
+        {
+            fixed (byte* n = nonce)
+            fixed (byte* c = ciphertext)
+            fixed (byte* a = aad)
+            fixed (byte* t = tag)
+            {
+                return aesgcmsiv_ctx_verify_ciphertext(ctx.Handle, n, (nuint)(nonce?.Length ?? 0),
+                    c, (nuint)ciphertext.Length, a, (nuint)(aad?.Length ?? 0), t);
+            }
+        }
+
+        // Verifies message i of each (ciphertext, tag) as a batch with no outputs
+        private static int VerifyBatch(Context ctx, (byte[] Ciphertext, byte[] Tag)[] messages, int[] status)
+        {
+            var nonces = messages.SelectMany((_, i) => Nonce(i)).ToArray();
+            var input = messages.SelectMany(m => m.Ciphertext).ToArray();
+            var tags = messages.SelectMany(m => m.Tag).ToArray();
+            var items = new BatchItem[messages.Length];
+            fixed (byte* n = nonces)
+            fixed (byte* c = input)
+            fixed (byte* t = tags)
+            fixed (BatchItem* it = items)
+            fixed (int* s = status)
+            {
+                for (int k = 0, offset = 0; k < messages.Length; offset += messages[k].Ciphertext.Length, k++)
+                {
+                    it[k].Nonce = n + k * 12;
+                    it[k].Input = c + offset;
+                    it[k].InputLength = (nuint)messages[k].Ciphertext.Length;
+                    it[k].Tag = t + k * TagLength;
+                }
+                return aesgcmsiv_verify_batch(ctx.Handle, (nuint)messages.Length, it, s);
+            }
+        }
+
+        [Theory]
+        [InlineData(0)]
+        [InlineData(1)]
+        [InlineData(64)]
+        [InlineData(1000)]
+        [InlineData(100_000)]
+        public void VerifyCiphertext_OfSealedMessage_ShouldSucceed(int length)
+        {
+            // Arrange
+            using var ctx = new Context(_key);
+            var aad = new byte[] { 1, 2, 3 };
+            var (ciphertext, tag) = Seal(3, length, aad);
+
+            // Act
+            int result = Verify(ctx, Nonce(3), ciphertext, aad, tag);
+
+            // Assert
+            Assert.Equal(Success, result);
+        }
+
+        [Theory]
+        [InlineData(0)]
+        [InlineData(499)]
+        [InlineData(-1)]
+        [InlineData(-2)]
+        public void VerifyCiphertext_OfTamperedMessage_ShouldFail(int offset)
+        {
+            // Arrange: -1 flips the tag, -2 the AAD
+            using var ctx = new Context(_key);
+            var aad = new byte[] { 4, 5, 6 };
+            var (ciphertext, tag) = Seal(1, 500, aad);
+            if (offset == -1)
+                tag[15] ^= 0x80;
+            else if (offset == -2)
+                aad[0] ^= 0x01;
+            else
+                ciphertext[offset] ^= 0x40;
+
+            // Act
+            int result = Verify(ctx, Nonce(1), ciphertext, aad, tag);
+
+            // Assert
+            Assert.Equal(DecryptFailed, result);
+        }
+
+        [Fact]
+        public void VerifyBatch_ShouldReportEachMessage()
+        {
+            // Arrange
+            using var ctx = new Context(_key);
+            var messages = Enumerable.Range(0, 30).Select(i => Seal(i, i * 19, null)).ToArray();
+            messages[7].Ciphertext[3] ^= 0x01;
+            messages[22].Tag[0] ^= 0x01;
+            var status = new int[messages.Length];
+
+            // Act
+            int result = VerifyBatch(ctx, messages, status);
+
+            // Assert
+            Assert.Equal(DecryptFailed, result);
+            for (int i = 0; i < messages.Length; i++)
+                Assert.Equal(i == 7 || i == 22 ? DecryptFailed : Success, status[i]);
+        }
+
+        [Fact]
+        public void VerifyCiphertext_WithInvalidArguments_ShouldFail()
+        {
+            using var ctx = new Context(_key);
+            var (ciphertext, tag) = Seal(0, 32, null);
+
+            Assert.Equal(InvalidNonce, Verify(ctx, null, ciphertext, null, tag));
+            Assert.Equal(InvalidNonce, Verify(ctx, new byte[16], ciphertext, null, tag));
+            Assert.Equal(InvalidInput, Verify(ctx, Nonce(0), ciphertext, null, null));
+            fixed (byte* n = Nonce(0))
+            fixed (byte* t = tag)
+            {
+                Assert.Equal(InvalidInput, aesgcmsiv_ctx_verify_ciphertext(ctx.Handle, n, 12, null, 32, null, 0, t));
+                Assert.Equal(InvalidInput, aesgcmsiv_ctx_verify_ciphertext(IntPtr.Zero, n, 12, null, 0, null, 0, t));
+                Assert.Equal(InvalidInput, aesgcmsiv_verify_batch(ctx.Handle, 1, null, null));
+            }
+        }
+    }
+}
@@ -4,7 +4,9 @@ param(
     [string]$Configuration = "Release",
     [string]$Platform = "x64",
     [switch]$Clean,
-    [switch]$SkipNative
+    [switch]$SkipNative,
+    [switch]$StaticOpenSSL,
+    [switch]$Pgo
 )
 
 # Error handling
@@ -19,10 +21,12 @@ $OutputDir = Join-Path $ProjectRoot "bin"
 
 # Create output directories
 $NativeOutputDir = Join-Path $OutputDir "native"
-$WinX64Dir = Join-Path $NativeOutputDir "win-x64"
+# Runtime identifier for the target platform (x64 -> win-x64, ARM64 -> win-arm64)
+$RuntimeId = "win-$($Platform.ToLowerInvariant())"
+$RuntimeDir = Join-Path $NativeOutputDir $RuntimeId
 
-if (!(Test-Path $WinX64Dir)) {
-    New-Item -ItemType Directory -Path $WinX64Dir -Force | Out-Null
+if (!(Test-Path $RuntimeDir)) {
+    New-Item -ItemType Directory -Path $RuntimeDir -Force | Out-Null
 }
 
 Write-Host "Building AES-GCM-SIV Native Library" -ForegroundColor Green
@@ -79,9 +83,12 @@ function Get-OpenSSLPath {
 
 # Build native library
 function Build-NativeLibrary {
-    param([string]$OpenSSLPath)
+    param(
+        [string]$OpenSSLPath,
+        [string]$PgoPhase = ""
+    )
     
-    Write-Host "Building native library..." -ForegroundColor Cyan
+    Write-Host "Building native library... $PgoPhase" -ForegroundColor Cyan
     
     $cmakeBuildDir = Join-Path $BuildDir "cmake-build"
     if (!(Test-Path $cmakeBuildDir)) {
@@ -96,7 +103,9 @@ function Build-NativeLibrary {
             "-A", $Platform,
             "-DCMAKE_BUILD_TYPE=$Configuration",
             "-DOPENSSL_ROOT_DIR=$OpenSSLPath",
-            "-DOPENSSL_USE_STATIC_LIBS=ON",
+            "-DAESGCMSIV_STATIC_OPENSSL=$(if ($StaticOpenSSL) { 'ON' } else { 'OFF' })",
+            "-DAESGCMSIV_PGO=$PgoPhase",
+            "-DAESGCMSIV_PGO_DIR=$(Join-Path $BuildDir 'pgo')",
             $NativeDir
         )
         
@@ -118,12 +127,18 @@ function Build-NativeLibrary {
         # Copy output
         $dllSource = Join-Path $cmakeBuildDir "$Configuration\aesgcmsiv.dll"
         if (Test-Path $dllSource) {
-            Copy-Item $dllSource $WinX64Dir -Force
+            Copy-Item $dllSource $RuntimeDir -Force
             Write-Host "✓ Native library built successfully" -ForegroundColor Green
         } else {
             Write-Error "Native library not found at expected location: $dllSource"
             exit 1
         }
+
+        # The static archive, for Native AOT publishing
+        $staticSource = Join-Path $cmakeBuildDir "$Configuration\aesgcmsiv_static.lib"
+        if (Test-Path $staticSource) {
+            Copy-Item $staticSource $RuntimeDir -Force
+        }
     }
     finally {
         Pop-Location
@@ -174,6 +189,26 @@ function Test-Project {
     }
 }
 
+# Runs the test suite against the instrumented library to record a profile
+function Invoke-PgoTraining {
+    Write-Host "Training PGO profile..." -ForegroundColor Cyan
+    
+    Push-Location $ProjectRoot
+    $env:AESGCMSIV_NATIVE_LIBRARY = Join-Path $RuntimeDir "aesgcmsiv.dll"
+    try {
+        & dotnet test AesGcmSiv.Tests --configuration $Configuration --no-build
+        
+        if ($LASTEXITCODE -ne 0) {
+            Write-Error "PGO training run failed"
+            exit 1
+        }
+    }
+    finally {
+        Remove-Item Env:AESGCMSIV_NATIVE_LIBRARY
+        Pop-Location
+    }
+}
+
 # Main execution
 try {
     # Check prerequisites
@@ -188,12 +223,22 @@ try {
         if (Test-Path (Join-Path $BuildDir "cmake-build")) {
             Remove-Item (Join-Path $BuildDir "cmake-build") -Recurse -Force
         }
+        if (Test-Path (Join-Path $BuildDir "pgo")) {
+            Remove-Item (Join-Path $BuildDir "pgo") -Recurse -Force
+        }
     }
     
     # Build native library
     if (!$SkipNative) {
         $opensslPath = Get-OpenSSLPath
-        Build-NativeLibrary -OpenSSLPath $opensslPath
+        if ($Pgo) {
+            Build-NativeLibrary -OpenSSLPath $opensslPath -PgoPhase "GENERATE"
+            Build-DotNetProjects
+            Invoke-PgoTraining
+            Build-NativeLibrary -OpenSSLPath $opensslPath -PgoPhase "USE"
+        } else {
+            Build-NativeLibrary -OpenSSLPath $opensslPath
+        }
     } else {
         Write-Host "Skipping native build as requested" -ForegroundColor Yellow
     }
@@ -205,7 +250,7 @@ try {
     Test-Project
     
     Write-Host "Build completed successfully!" -ForegroundColor Green
-    Write-Host "Native library location: $WinX64Dir" -ForegroundColor Cyan
+    Write-Host "Native library location: $RuntimeDir" -ForegroundColor Cyan
 }
 catch {
     Write-Error "Build failed: $($_.Exception.Message)"
@@ -11,24 +11,46 @@ set NATIVE_DIR=%~dp0..\Native
 set OUTPUT_DIR=%~dp0..\bin\native\win-x64
 set OPENSSL_DIR=%~dp0..\OpenSSL-Win64
 
+REM "static" links libcrypto_static.lib into the DLL instead of importing
+REM libcrypto-3-x64.dll
+set OPENSSL_LIBS="%OPENSSL_DIR%\lib\VC\x64\MD\libcrypto.lib"
+if /i "%~1"=="static" (
+    set OPENSSL_LIBS="%OPENSSL_DIR%\lib\VC\x64\MD\libcrypto_static.lib" ws2_32.lib crypt32.lib advapi32.lib user32.lib
+)
+
 REM Create output directory
 if not exist "%OUTPUT_DIR%" mkdir "%OUTPUT_DIR%"
 
 REM Navigate to native directory
 cd /d "%NATIVE_DIR%"
 
-REM Build the DLL
+REM Build the DLL, optimized with whole-program optimization
 echo Building with MSVC...
-cl /LD /Fe:aesgcmsiv.dll /I"%OPENSSL_DIR%\include" "%OPENSSL_DIR%\lib\VC\x64\MD\libcrypto.lib" aesgcmsiv.cpp
+set SOURCES=aesgcmsiv.cpp aesgcmsiv_aesni.cpp aesgcmsiv_alloc.cpp aesgcmsiv_armv8.cpp aesgcmsiv_arrow.cpp aesgcmsiv_base64.cpp aesgcmsiv_bitsliced.cpp aesgcmsiv_blocks.cpp aesgcmsiv_compress.cpp aesgcmsiv_cpu.cpp aesgcmsiv_crypto_openssl.cpp aesgcmsiv_datagram.cpp aesgcmsiv_exports.cpp aesgcmsiv_file.cpp aesgcmsiv_json.cpp aesgcmsiv_kernels.cpp aesgcmsiv_mock_kernel.cpp aesgcmsiv_notify.cpp aesgcmsiv_numa.cpp aesgcmsiv_pool.cpp aesgcmsiv_secure.cpp aesgcmsiv_stats.cpp aesgcmsiv_stream_budget.cpp aesgcmsiv_trace.cpp aesgcmsiv_vaes.cpp aesgcmsiv_value_cache.cpp aesgcmsiv_xxh3.cpp
+cl /LD /O2 /GL /EHsc /DNDEBUG /Fe:aesgcmsiv.dll /I"%OPENSSL_DIR%\include" %OPENSSL_LIBS% %SOURCES% advapi32.lib /link /LTCG
 
 if %ERRORLEVEL% neq 0 (
     echo Build failed
     exit /b 1
 )
 
+REM The same library compiled for x86-64-v3 and v4, for the managed loader to
+REM pick on CPUs that have them. MSVC has no switch for v2 alone.
+for %%L in (v3:AVX2 v4:AVX512) do (
+    for /f "tokens=1,2 delims=:" %%A in ("%%L") do (
+        echo Building x86-64-%%A with /arch:%%B...
+        cl /LD /O2 /GL /EHsc /DNDEBUG /arch:%%B /Fe:aesgcmsiv.x86-64-%%A.dll /I"%OPENSSL_DIR%\include" %OPENSSL_LIBS% %SOURCES% advapi32.lib /link /LTCG
+        if errorlevel 1 (
+            echo Build failed
+            exit /b 1
+        )
+    )
+)
+
 REM Copy the DLL to output directory
 if exist aesgcmsiv.dll (
     copy aesgcmsiv.dll "%OUTPUT_DIR%\" >nul
+    copy aesgcmsiv.x86-64-v*.dll "%OUTPUT_DIR%\" >nul
     echo Build completed successfully!
     echo DLL location: %OUTPUT_DIR%
     
@@ -0,0 +1,79 @@
+#!/usr/bin/env bash
+# Builds the native library for Linux or macOS into bin/native/<rid>/.
+#
+# usage: build_native.sh [rid] [extra CMake arguments...]
+#   rid defaults to the host: linux-x64, linux-arm64, osx-x64 or osx-arm64
+#
+# For x64 it also builds the library once per x86-64 microarchitecture level
+# in AESGCMSIV_X86_LEVELS (default "v2 v3 v4"; empty for none), as
+# libaesgcmsiv.x86-64-<level>.so or .dylib beside the baseline, for the
+# managed loader to choose from.
+set -euo pipefail
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+PROJECT_ROOT="$(dirname "$SCRIPT_DIR")"
+NATIVE_DIR="$PROJECT_ROOT/Native"
+
+host_rid() {
+    local os arch
+    case "$(uname -s)" in
+        Linux) os=linux ;;
+        Darwin) os=osx ;;
+        *) echo "Unsupported OS: $(uname -s)" >&2; exit 1 ;;
+    esac
+    case "$(uname -m)" in
+        x86_64|amd64) arch=x64 ;;
+        aarch64|arm64) arch=arm64 ;;
+        *) echo "Unsupported architecture: $(uname -m)" >&2; exit 1 ;;
+    esac
+    echo "$os-$arch"
+}
+
+RID="${1:-$(host_rid)}"
+[ $# -gt 0 ] && shift
+
+BUILD_DIR="$SCRIPT_DIR/cmake-build-$RID"
+OUTPUT_DIR="$PROJECT_ROOT/bin/native/$RID"
+
+CMAKE_ARGS=(-DCMAKE_BUILD_TYPE=Release)
+case "$RID" in
+    osx-arm64) CMAKE_ARGS+=(-DCMAKE_OSX_ARCHITECTURES=arm64) ;;
+    osx-x64) CMAKE_ARGS+=(-DCMAKE_OSX_ARCHITECTURES=x86_64) ;;
+esac
+case "$RID" in
+    osx-*)
+        # Homebrew keeps OpenSSL out of the default search path
+        if [ -z "${OPENSSL_ROOT_DIR:-}" ] && command -v brew >/dev/null; then
+            CMAKE_ARGS+=("-DOPENSSL_ROOT_DIR=$(brew --prefix openssl@3)")
+        fi
+        LIB_NAME=libaesgcmsiv.dylib
+        ;;
+    *)
+        LIB_NAME=libaesgcmsiv.so
+        ;;
+esac
+
+echo "Building AES-GCM-SIV native library for $RID..."
+cmake -S "$NATIVE_DIR" -B "$BUILD_DIR" "${CMAKE_ARGS[@]}" "$@"
+cmake --build "$BUILD_DIR" --parallel
+
+mkdir -p "$OUTPUT_DIR"
+cp "$BUILD_DIR/lib/$LIB_NAME" "$OUTPUT_DIR/"
+# The static archive, for Native AOT publishing; absent with -DAESGCMSIV_BUILD_STATIC=OFF
+if [ -f "$BUILD_DIR/lib/libaesgcmsiv.a" ]; then
+    cp "$BUILD_DIR/lib/libaesgcmsiv.a" "$OUTPUT_DIR/"
+fi
+echo "Library location: $OUTPUT_DIR/$LIB_NAME"
+
+case "$RID" in
+    *-x64) LEVELS="${AESGCMSIV_X86_LEVELS-v2 v3 v4}" ;;
+    *) LEVELS="" ;;
+esac
+for level in $LEVELS; do
+    echo "Building AES-GCM-SIV native library for $RID, x86-64-$level..."
+    LEVEL_DIR="$BUILD_DIR-x86-64-$level"
+    cmake -S "$NATIVE_DIR" -B "$LEVEL_DIR" "${CMAKE_ARGS[@]}" \
+        -DAESGCMSIV_X86_LEVEL="$level" -DAESGCMSIV_BUILD_STATIC=OFF -DAESGCMSIV_BUILD_CLI=OFF "$@"
+    cmake --build "$LEVEL_DIR" --parallel
+    cp "$LEVEL_DIR/lib/$LIB_NAME" "$OUTPUT_DIR/${LIB_NAME%.*}.x86-64-$level.${LIB_NAME##*.}"
+done
@@ -42,7 +42,7 @@ echo Checking if OpenSSL headers exist...
 dir "%OPENSSL_DIR%\include" 2>nul
 echo Checking if OpenSSL lib exists...
 dir "%OPENSSL_DIR%\lib\VC\x64\MD\libcrypto.lib" 2>nul
-cl /LD /Fe:aesgcmsiv.dll /I"%OPENSSL_DIR%\include" "%OPENSSL_DIR%\lib\VC\x64\MD\libcrypto.lib" aesgcmsiv.cpp
+cl /LD /Fe:aesgcmsiv.dll /I"%OPENSSL_DIR%\include" "%OPENSSL_DIR%\lib\VC\x64\MD\libcrypto.lib" aesgcmsiv.cpp aesgcmsiv_aesni.cpp aesgcmsiv_armv8.cpp aesgcmsiv_cpu.cpp aesgcmsiv_kernels.cpp aesgcmsiv_vaes.cpp
 
 if %ERRORLEVEL% neq 0 (
     echo Build failed
@@ -1,187 +1,6487 @@
 #include "aesgcmsiv.h"
-#include <openssl/evp.h>
-#include <openssl/err.h>
+#include "aesgcmsiv_arrow.h"
+#include "aesgcmsiv_base64.h"
+#include "aesgcmsiv_blocks.h"
+#include "aesgcmsiv_compress.h"
+#include "aesgcmsiv_crypto.h"
+#include "aesgcmsiv_kernels.h"
+#include "aesgcmsiv_notify.h"
+#include "aesgcmsiv_pool.h"
+#include "aesgcmsiv_secure.h"
+#include "aesgcmsiv_sha256.h"
+#include "aesgcmsiv_stats.h"
+#include "aesgcmsiv_xxh3.h"
+// For OPENSSL_cleanse, which every supported crypto library has
+#include <openssl/crypto.h>
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <condition_variable>
 #include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+#if !defined(_WIN32)
+#include <pthread.h>
+#endif
 
-// Helper function to validate parameters
-static int validate_encrypt_params(
-    const uint8_t* key, size_t key_len,
+// One nonce's RFC 8452 derived keys. busy is held while the entry is read
+// or written.
+struct nonce_cache_entry {
+    std::atomic_flag busy = ATOMIC_FLAG_INIT;
+    bool valid;
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    alignas(16) uint8_t auth_key[16];
+    aes_key_schedule enc_ks;
+};
+
+// Direct-mapped: a nonce has one entry, and a different nonce that maps
+// there replaces it
+struct nonce_cache {
+    size_t mask;  // entries - 1; a power of two
+    nonce_cache_entry* entries;
+};
+
+// Everything but threads and pool is written once by aesgcmsiv_ctx_new and only read
+// afterwards, so calls on different threads can share a context. Per-call
+// state lives on the caller's stack or in its thread's scratch state.
+struct aesgcmsiv_ctx {
+    const aesgcmsiv_kernel* kernel;  // NULL when using the crypto library
+    aes_key_schedule key_schedule;  // key-generating key for the kernel path
+    nonce_cache* nonces;  // see aesgcmsiv_ctx_set_nonce_cache; NULL when off
+    crypto_key* library_key;  // the crypto library's key; NULL with a kernel
+    std::atomic<unsigned int> threads;  // see aesgcmsiv_ctx_set_threads
+    std::atomic<aesgcmsiv_pool*> pool;  // see aesgcmsiv_ctx_set_pool
+    std::atomic<size_t> stream_min;  // see aesgcmsiv_ctx_set_streaming; 0 when off
+    std::atomic<size_t> wide_min;  // see aesgcmsiv_ctx_set_wide_min; 0 when off
+    std::atomic<aesgcmsiv_usage_counters*> usage;  // see aesgcmsiv_ctx_set_usage_tracking; NULL when off
+    // usage's counters, kept while it is off so that a call that read them
+    // just before still has them, and freed with the context
+    std::atomic<aesgcmsiv_usage_counters*> usage_block;
+};
+
+// One implementation the library can run: a kernel, or the crypto library
+struct backend_dispatch {
+    const aesgcmsiv_kernel* kernel;  // NULL for the crypto library
+    // kernel with its CTR loops swapped for the streaming ones, so every
+    // path built on it writes past the cache; all NULL if it has none
+    aesgcmsiv_kernel streaming;
+    // A kernel on 128-bit vectors sharing kernel's key schedules, for
+    // aesgcmsiv_ctx_set_wide_min; NULL if kernel is no wider
+    const aesgcmsiv_kernel* narrow;
+};
+
+// The hand-written kernels, the crypto library and the mock kernel share
+// the validation, batching and context code above them, so any of them can
+// serve the process. Every one this build and CPU can run is found once, by
+// the static initializer below, when the library is loaded.
+struct backend_registry {
+    uint32_t cpu_features;
+    size_t count;
+    backend_dispatch backends[6];  // the default first
+};
+
+static void add_backend(backend_registry* registry, const aesgcmsiv_kernel* kernel)
+{
+    backend_dispatch& backend = registry->backends[registry->count++];
+    backend.kernel = kernel;
+    backend.streaming = aesgcmsiv_kernel{};
+    if (kernel && kernel->ctr32_stream) {
+        backend.streaming = *kernel;
+        backend.streaming.ctr32 = kernel->ctr32_stream;
+        backend.streaming.ctr32_polyval = kernel->ctr32_polyval_stream;
+    }
+}
+
+// Widest first, so the default is the widest hand-written kernel the CPU
+// supports. Without AES instructions that is the bitsliced one, which is
+// constant time where OpenSSL's generic code may use lookup tables; the
+// crypto library remains for the instances bound to a provider. The mock
+// kernel comes after the library, so it is only ever used by name.
+//
+// The ARMv8 kernel is also only used by name, until the arm64 CI legs have
+// run it against the RFC 8452 vectors (KnownAnswerTests) for a while. A CPU
+// with its instructions defaults to the crypto library meanwhile, which
+// uses them too, rather than to the bitsliced kernel.
+static backend_registry probe_backends()
+{
+    backend_registry registry = {};
+    registry.cpu_features = aesgcmsiv_detect_cpu_features();
+    const aesgcmsiv_kernel* (*const probes[])(uint32_t) = {
+        vaes_kernel_probe,
+        aesni_kernel_probe,
+    };
+    for (auto probe : probes) {
+        if (const aesgcmsiv_kernel* kernel = probe(registry.cpu_features)) {
+            add_backend(&registry, kernel);
+        }
+    }
+    const aesgcmsiv_kernel* armv8 = armv8_kernel_probe(registry.cpu_features);
+    const aesgcmsiv_kernel* bitsliced = bitsliced_kernel_probe(registry.cpu_features);
+    if (bitsliced && !armv8) {
+        add_backend(&registry, bitsliced);
+    }
+    add_backend(&registry, nullptr);
+    if (armv8) {
+        add_backend(&registry, armv8);
+        if (bitsliced) {
+            add_backend(&registry, bitsliced);
+        }
+    }
+    if (const aesgcmsiv_kernel* kernel = mock_kernel_probe(registry.cpu_features)) {
+        add_backend(&registry, kernel);
+    }
+    // Kernels with the same expand_key lay out schedules alike, so one can
+    // take over a context keyed by the other
+    for (size_t i = 0; i < registry.count; i++) {
+        backend_dispatch& wide = registry.backends[i];
+        for (size_t j = i + 1; wide.kernel && wide.kernel->vector_bits > 128 && j < registry.count; j++) {
+            const aesgcmsiv_kernel* kernel = registry.backends[j].kernel;
+            if (kernel && kernel->vector_bits == 128 && kernel->expand_key == wide.kernel->expand_key) {
+                wide.narrow = kernel;
+                break;
+            }
+        }
+    }
+    return registry;
+}
+
+static const backend_registry g_registry = probe_backends();
+
+// The implementation new calls and contexts use; see
+// aesgcmsiv_select_backend. Contexts keep the kernel they were created with.
+static std::atomic<const backend_dispatch*> g_backend{&g_registry.backends[0]};
+
+static const aesgcmsiv_kernel* active_kernel()
+{
+    return g_backend.load(std::memory_order_relaxed)->kernel;
+}
+
+// kernel writing its output with non-temporal stores, or NULL
+static const aesgcmsiv_kernel* streaming_kernel(const aesgcmsiv_kernel* kernel)
+{
+    for (size_t i = 0; kernel && i < g_registry.count; i++) {
+        const backend_dispatch& backend = g_registry.backends[i];
+        if (backend.kernel == kernel) {
+            return backend.streaming.ctr32 ? &backend.streaming : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+// The 128-bit kernel that can stand in for kernel, or NULL
+static const aesgcmsiv_kernel* narrow_kernel(const aesgcmsiv_kernel* kernel)
+{
+    for (size_t i = 0; kernel && i < g_registry.count; i++) {
+        if (g_registry.backends[i].kernel == kernel) {
+            return g_registry.backends[i].narrow;
+        }
+    }
+    return nullptr;
+}
+
+// As reported by aesgcmsiv_get_backend, for a kernel or NULL for the crypto
+// library
+static const char* backend_name(const aesgcmsiv_kernel* kernel)
+{
+    return kernel ? kernel->name : crypto_backend_name;
+}
+
+// The widest vectors kernel uses on a message of len bytes, for the width
+// counters; 0 for the crypto library, which is counted under neither
+static unsigned int vector_bits(const aesgcmsiv_kernel* kernel, uint64_t len)
+{
+    if (!kernel) {
+        return 0;
+    }
+    return len < kernel->vector_min_bytes ? std::min(kernel->vector_bits, 128u) : kernel->vector_bits;
+}
+
+// Mean message length of a batch, which its width is chosen and counted by
+static uint64_t batch_mean_len(const aesgcmsiv_batch_item* items, size_t count)
+{
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < count; i++) {
+        bytes += items[i].input_len;
+    }
+    return count ? bytes / count : 0;
+}
+
+// Helper function to validate the key
+static int validate_key(const uint8_t* key, size_t key_len)
+{
+    if (!key || (key_len != AESGCMSIV_KEY_SIZE_128 && key_len != AESGCMSIV_KEY_SIZE_256)) {
+        return AESGCMSIV_ERROR_INVALID_KEY;
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+// RFC 8452 section 6 caps both the plaintext and the AAD at 2^36 bytes.
+// Taking uint64_t keeps the comparison meaningful where size_t is 32 bits.
+static inline bool exceeds_max_input(uint64_t len)
+{
+    return len > AESGCMSIV_MAX_INPUT_SIZE;
+}
+
+// Helper function to validate per-message parameters. Inline, so each entry
+// point checks in place rather than through a call.
+static inline int validate_encrypt_params(
     const uint8_t* nonce, size_t nonce_len,
     const uint8_t* plaintext, size_t plaintext_len,
-    const uint8_t* aad, size_t aad_len,
+    size_t aad_len,
     uint8_t* ciphertext_out, uint8_t* tag_out)
 {
-    if (!key || key_len != AESGCMSIV_KEY_SIZE) {
-        return AESGCMSIV_ERROR_INVALID_KEY;
-    }
     if (!nonce || nonce_len != AESGCMSIV_NONCE_SIZE) {
         return AESGCMSIV_ERROR_INVALID_NONCE;
     }
-    if (!plaintext || !ciphertext_out || !tag_out) {
+    // An empty message may come with NULL buffers, for authentication only
+    if (!tag_out || (plaintext_len && (!plaintext || !ciphertext_out))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (exceeds_max_input(plaintext_len) || exceeds_max_input(aad_len)) {
         return AESGCMSIV_ERROR_INVALID_INPUT;
     }
     // Allow empty AAD (aad can be non-null but have zero length)
     return AESGCMSIV_SUCCESS;
 }
 
-static int validate_decrypt_params(
-    const uint8_t* key, size_t key_len,
+static inline int validate_decrypt_params(
     const uint8_t* nonce, size_t nonce_len,
     const uint8_t* ciphertext, size_t ciphertext_len,
-    const uint8_t* aad, size_t aad_len,
+    size_t aad_len,
     const uint8_t* tag, uint8_t* plaintext_out)
 {
-    if (!key || key_len != AESGCMSIV_KEY_SIZE) {
-        return AESGCMSIV_ERROR_INVALID_KEY;
-    }
     if (!nonce || nonce_len != AESGCMSIV_NONCE_SIZE) {
         return AESGCMSIV_ERROR_INVALID_NONCE;
     }
-    if (!ciphertext || !tag || !plaintext_out) {
+    if (!tag || (ciphertext_len && (!ciphertext || !plaintext_out))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (exceeds_max_input(ciphertext_len) || exceeds_max_input(aad_len)) {
         return AESGCMSIV_ERROR_INVALID_INPUT;
     }
     // Allow empty AAD (aad can be non-null but have zero length)
     return AESGCMSIV_SUCCESS;
 }
 
-extern "C" {
-
-int aesgcmsiv_encrypt(
-    const uint8_t* key, size_t key_len,
+// validate_decrypt_params for a call that writes no plaintext
+static inline int validate_verify_params(
     const uint8_t* nonce, size_t nonce_len,
-    const uint8_t* plaintext, size_t plaintext_len,
-    const uint8_t* aad, size_t aad_len,
-    uint8_t* ciphertext_out,
-    uint8_t* tag_out)
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    size_t aad_len,
+    const uint8_t* tag)
 {
-    // Validate parameters
-    int validation_result = validate_encrypt_params(
-        key, key_len, nonce, nonce_len, plaintext, plaintext_len,
-        aad, aad_len, ciphertext_out, tag_out);
-    if (validation_result != AESGCMSIV_SUCCESS) {
-        return validation_result;
+    if (!nonce || nonce_len != AESGCMSIV_NONCE_SIZE) {
+        return AESGCMSIV_ERROR_INVALID_NONCE;
+    }
+    if (!tag || (ciphertext_len && !ciphertext)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
     }
+    if (exceeds_max_input(ciphertext_len) || exceeds_max_input(aad_len)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    return AESGCMSIV_SUCCESS;
+}
 
-    // Initialize OpenSSL
-    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-    if (!ctx) {
-        return AESGCMSIV_ERROR_INTERNAL;
+// Checks a segment array and returns its total length in total_out.
+template <typename Segment>
+static int validate_segments(const Segment* segs, size_t count, uint64_t* total_out)
+{
+    if (!segs && count > 0) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
     }
+    uint64_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!segs[i].data && segs[i].len > 0) {
+            return AESGCMSIV_ERROR_INVALID_INPUT;
+        }
+        // Checked per segment so the sum cannot wrap
+        if (exceeds_max_input(segs[i].len) || exceeds_max_input(total + segs[i].len)) {
+            return AESGCMSIV_ERROR_INVALID_INPUT;
+        }
+        total += segs[i].len;
+    }
+    *total_out = total;
+    return AESGCMSIV_SUCCESS;
+}
 
-    // Initialize encryption
-    EVP_CIPHER* cipher = EVP_CIPHER_fetch(nullptr, "AES-256-GCM-SIV", nullptr);
-    if (!cipher) {
-        EVP_CIPHER_CTX_free(ctx);
-        return AESGCMSIV_ERROR_INTERNAL;
+static int validate_vector_params(
+    const uint8_t* nonce, size_t nonce_len,
+    const aesgcmsiv_iovec* input, size_t input_count,
+    const aesgcmsiv_iovec* aad, size_t aad_count,
+    const aesgcmsiv_iovec_out* output, size_t output_count,
+    const uint8_t* tag, size_t* input_len_out, size_t* aad_len_out)
+{
+    if (!nonce || nonce_len != AESGCMSIV_NONCE_SIZE) {
+        return AESGCMSIV_ERROR_INVALID_NONCE;
     }
-    
-    if (EVP_EncryptInit_ex2(ctx, cipher, key, nonce, nullptr) != 1) {
-        EVP_CIPHER_free(cipher);
-        EVP_CIPHER_CTX_free(ctx);
-        return AESGCMSIV_ERROR_INTERNAL;
+    if (!tag) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
     }
-    
-    EVP_CIPHER_free(cipher);
+    uint64_t input_len, aad_len, output_len;
+    int result = validate_segments(input, input_count, &input_len);
+    if (result == AESGCMSIV_SUCCESS) {
+        result = validate_segments(aad, aad_count, &aad_len);
+    }
+    if (result == AESGCMSIV_SUCCESS) {
+        result = validate_segments(output, output_count, &output_len);
+    }
+    if (result != AESGCMSIV_SUCCESS) {
+        return result;
+    }
+    if (output_len < input_len) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *input_len_out = static_cast<size_t>(input_len);
+    *aad_len_out = static_cast<size_t>(aad_len);
+    return AESGCMSIV_SUCCESS;
+}
 
-    // Set AAD if provided
-    if (aad && aad_len > 0) {
-        int out_len;
-        if (EVP_EncryptUpdate(ctx, nullptr, &out_len, aad, static_cast<int>(aad_len)) != 1) {
-            EVP_CIPHER_CTX_free(ctx);
-            return AESGCMSIV_ERROR_INTERNAL;
+// Contiguous copy of a segment array for the OpenSSL path, which takes each
+// input in one update. Never NULL on success, even when empty.
+static uint8_t* gather_segments(const aesgcmsiv_iovec* segs, size_t count, size_t len)
+{
+    uint8_t* buffer = static_cast<uint8_t*>(aesgcmsiv_block_alloc(len ? len : 1));
+    if (buffer) {
+        size_t offset = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (segs[i].len) {
+                memcpy(buffer + offset, segs[i].data, segs[i].len);
+                offset += segs[i].len;
+            }
         }
     }
+    return buffer;
+}
 
-    // Encrypt plaintext
-    int out_len;
-    if (EVP_EncryptUpdate(ctx, ciphertext_out, &out_len, plaintext, static_cast<int>(plaintext_len)) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        return AESGCMSIV_ERROR_INTERNAL;
+static void scatter_segments(const uint8_t* buffer, size_t len, const aesgcmsiv_iovec_out* segs, size_t count)
+{
+    for (size_t i = 0; i < count && len > 0; i++) {
+        size_t n = segs[i].len < len ? segs[i].len : len;
+        memcpy(segs[i].data, buffer, n);
+        buffer += n;
+        len -= n;
     }
+}
 
-    // Finalize encryption and get tag
-    if (EVP_EncryptFinal_ex(ctx, nullptr, &out_len) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        return AESGCMSIV_ERROR_INTERNAL;
+static void free_gathered(uint8_t* buffer, size_t len)
+{
+    if (buffer) {
+        OPENSSL_cleanse(buffer, len);
+        aesgcmsiv_block_free(buffer, len ? len : 1);
+    }
+}
+
+// OpenSSL path of the vector functions: gathers the inputs, runs seal(pt,
+// pt_len, aad, aad_len) to encrypt the copy in place, and scatters the result.
+template <typename Seal>
+static int sealv_gathered(
+    const aesgcmsiv_iovec* plaintext, size_t plaintext_count, size_t plaintext_len,
+    const aesgcmsiv_iovec* aad, size_t aad_count, size_t aad_len,
+    const aesgcmsiv_iovec_out* ciphertext_out, size_t ciphertext_count,
+    Seal seal)
+{
+    uint8_t* pt = gather_segments(plaintext, plaintext_count, plaintext_len);
+    uint8_t* ad = gather_segments(aad, aad_count, aad_len);
+    int result = AESGCMSIV_ERROR_INTERNAL;
+    if (pt && ad) {
+        result = seal(pt, plaintext_len, ad, aad_len);
+        if (result == AESGCMSIV_SUCCESS) {
+            scatter_segments(pt, plaintext_len, ciphertext_out, ciphertext_count);
+        }
     }
+    free_gathered(pt, plaintext_len);
+    free_gathered(ad, aad_len);
+    return result;
+}
 
-    // Get the authentication tag
-    if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, AESGCMSIV_TAG_SIZE, tag_out) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        return AESGCMSIV_ERROR_INTERNAL;
+// Counterpart of sealv_gathered. Plaintext only reaches the caller's
+// segments once it has verified; on failure they are zeroed instead.
+template <typename Open>
+static int openv_gathered(
+    const aesgcmsiv_iovec* ciphertext, size_t ciphertext_count, size_t ciphertext_len,
+    const aesgcmsiv_iovec* aad, size_t aad_count, size_t aad_len,
+    const aesgcmsiv_iovec_out* plaintext_out, size_t plaintext_count,
+    Open open)
+{
+    uint8_t* ct = gather_segments(ciphertext, ciphertext_count, ciphertext_len);
+    uint8_t* ad = gather_segments(aad, aad_count, aad_len);
+    int result = AESGCMSIV_ERROR_INTERNAL;
+    if (ct && ad) {
+        result = open(ct, ciphertext_len, ad, aad_len);
+        if (result == AESGCMSIV_SUCCESS) {
+            scatter_segments(ct, ciphertext_len, plaintext_out, plaintext_count);
+        }
     }
+    if (result != AESGCMSIV_SUCCESS) {
+        for (size_t i = 0, left = ciphertext_len; i < plaintext_count && left > 0; i++) {
+            size_t n = plaintext_out[i].len < left ? plaintext_out[i].len : left;
+            OPENSSL_cleanse(plaintext_out[i].data, n);
+            left -= n;
+        }
+    }
+    free_gathered(ct, ciphertext_len);
+    free_gathered(ad, aad_len);
+    return result;
+}
+
+// Characters the nonce takes at the front of a token. 12 bytes encode to
+// whole groups, so the rest of the token encodes ciphertext || tag alone.
+#define TOKEN_NONCE_CHARS AESGCMSIV_B64URL_LEN(AESGCMSIV_NONCE_SIZE)
 
-    EVP_CIPHER_CTX_free(ctx);
+// Seals into the tail of token_out and encodes the sealed bytes forward
+// over themselves, starting far enough in that every group is read before
+// the characters in front of it reach it. The encoder runs on bytes the
+// encryption has just written, and no scratch buffer is needed. seal
+// writes ciphertext and tag to the two pointers it is given.
+template <typename Seal>
+static int seal_b64url(
+    const uint8_t* nonce, size_t plaintext_len, char* token_out, size_t* token_len_out, Seal seal)
+{
+    if (!token_out || !token_len_out ||
+        plaintext_len > (SIZE_MAX - AESGCMSIV_SEAL_OVERHEAD) / 4 * 3) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    const size_t sealed_len = plaintext_len + AESGCMSIV_TAG_SIZE;
+    const size_t encoded_len = AESGCMSIV_B64URL_LEN(sealed_len);
+    uint8_t* sealed = reinterpret_cast<uint8_t*>(token_out) + TOKEN_NONCE_CHARS + (encoded_len - sealed_len);
+    int result = seal(sealed, sealed + plaintext_len);
+    if (result != AESGCMSIV_SUCCESS) {
+        return result;
+    }
+    aesgcmsiv_b64url_encode(g_registry.cpu_features, nonce, AESGCMSIV_NONCE_SIZE, token_out);
+    aesgcmsiv_b64url_encode(g_registry.cpu_features, sealed, sealed_len, token_out + TOKEN_NONCE_CHARS);
+    *token_len_out = TOKEN_NONCE_CHARS + encoded_len;
     return AESGCMSIV_SUCCESS;
 }
 
-int aesgcmsiv_decrypt(
+// Returns the plaintext length of a token, or false if no token has this
+// length
+static bool token_plaintext_len(const char* token, size_t token_len, size_t* len_out)
+{
+    size_t sealed_len;
+    if (!token || token_len < TOKEN_NONCE_CHARS ||
+        !aesgcmsiv_b64url_decoded_len(token_len - TOKEN_NONCE_CHARS, &sealed_len) ||
+        sealed_len < AESGCMSIV_TAG_SIZE) {
+        return false;
+    }
+    *len_out = sealed_len - AESGCMSIV_TAG_SIZE;
+    return true;
+}
+
+// Decodes the ciphertext's whole groups straight into plaintext_out, and
+// the nonce and the group or two holding the tag onto the stack, then has
+// open decrypt in place. plaintext_len must come from token_plaintext_len.
+// open takes the nonce, the tag and the buffer to decrypt in place.
+template <typename Open>
+static int open_b64url(
+    const char* token, size_t token_len, size_t plaintext_len, uint8_t* plaintext_out, Open open)
+{
+    if (plaintext_len > 0 && !plaintext_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    alignas(16) uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    uint8_t tail[2 + AESGCMSIV_TAG_SIZE];  // the ciphertext's last partial group, then the tag
+    const size_t head_len = plaintext_len / 3 * 3;
+    const size_t tail_len = plaintext_len - head_len;
+    const char* encoded = token + TOKEN_NONCE_CHARS;
+    const size_t head_chars = head_len / 3 * 4;
+    const uint32_t features = g_registry.cpu_features;
+    if (!aesgcmsiv_b64url_decode(features, token, TOKEN_NONCE_CHARS, nonce) ||
+        !aesgcmsiv_b64url_decode(features, encoded, head_chars, plaintext_out) ||
+        !aesgcmsiv_b64url_decode(features, encoded + head_chars,
+            token_len - TOKEN_NONCE_CHARS - head_chars, tail)) {
+        if (plaintext_len > 0) {
+            memset(plaintext_out, 0, plaintext_len);
+        }
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (tail_len > 0) {
+        memcpy(plaintext_out + head_len, tail, tail_len);
+    }
+    return open(nonce, tail + tail_len, plaintext_out);
+}
+
+// Requests one engine worker takes per pass over the submission ring
+#define ENGINE_DRAIN_MAX 64
+
+// Most worker threads an engine starts
+#define ENGINE_MAX_WORKERS 64
+
+// Mean requests an engine worker must find waiting before it lingers for a
+// fuller batch
+#define ENGINE_LINGER_BACKLOG 2
+
+// Bounded multi-producer, multi-consumer ring (Vyukov). Each cell carries a
+// sequence number saying whether it is free for the producer at that
+// position or holds a value for the consumer, so a push or pop is one CAS
+// on the shared position plus a store to the cell, with no lock.
+template <typename T>
+class BoundedRing {
+public:
+    BoundedRing() : mask_(0), enqueue_pos_(0), dequeue_pos_(0) {}
+
+    BoundedRing(const BoundedRing&) = delete;
+    BoundedRing& operator=(const BoundedRing&) = delete;
+
+    // capacity must be a power of two
+    bool init(size_t capacity)
+    {
+        cells_.reset(new (std::nothrow) Cell[capacity]);
+        if (!cells_) {
+            return false;
+        }
+        for (size_t i = 0; i < capacity; i++) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        mask_ = capacity - 1;
+        return true;
+    }
+
+    bool push(const T& value)
+    {
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // full
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool pop(T* value)
+    {
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    *value = cell.value;
+                    cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // empty
+            } else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Sequentially consistent, for the check made before parking a thread
+    bool empty() const
+    {
+        size_t pos = dequeue_pos_.load(std::memory_order_seq_cst);
+        return cells_[pos & mask_].sequence.load(std::memory_order_seq_cst) != pos + 1;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> enqueue_pos_;
+    alignas(64) std::atomic<size_t> dequeue_pos_;
+};
+
+extern "C" {
+
+// The bodies of aesgcmsiv_encrypt and aesgcmsiv_decrypt, for the entry points
+// built on them; stats is the outer call's, so each message is counted once.
+// The _on forms run on kernel, the active one as the caller read it, or NULL
+// for the crypto library.
+static int encrypt_impl_on(
+    StatsScope& stats,
+    const aesgcmsiv_kernel* kernel,
     const uint8_t* key, size_t key_len,
     const uint8_t* nonce, size_t nonce_len,
-    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* plaintext, size_t plaintext_len,
     const uint8_t* aad, size_t aad_len,
-    const uint8_t* tag,
-    uint8_t* plaintext_out)
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out)
 {
     // Validate parameters
-    int validation_result = validate_decrypt_params(
-        key, key_len, nonce, nonce_len, ciphertext, ciphertext_len,
-        aad, aad_len, tag, plaintext_out);
+    int validation_result = validate_key(key, key_len);
+    if (validation_result == AESGCMSIV_SUCCESS) {
+        validation_result = validate_encrypt_params(
+            nonce, nonce_len, plaintext, plaintext_len, aad_len, ciphertext_out, tag_out);
+    }
     if (validation_result != AESGCMSIV_SUCCESS) {
         return validation_result;
     }
 
-    // Initialize OpenSSL
-    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-    if (!ctx) {
-        return AESGCMSIV_ERROR_INTERNAL;
+    if (kernel) {
+        aes_key_schedule ks;
+        kernel->expand_key(key, key_len, &ks);
+        stats.setup_done(kernel->name, vector_bits(kernel, plaintext_len));
+        int result = kernel_seal(
+            kernel, &ks, nonce, plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out);
+        aesgcmsiv_secure_zero(&ks, sizeof(ks));
+        return result;
     }
 
-    // Initialize decryption
-    EVP_CIPHER* cipher = EVP_CIPHER_fetch(nullptr, "AES-256-GCM-SIV", nullptr);
-    if (!cipher) {
-        EVP_CIPHER_CTX_free(ctx);
-        return AESGCMSIV_ERROR_INTERNAL;
+    return crypto_seal(stats, key, key_len, nonce,
+        plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out);
+}
+
+static int decrypt_impl_on(
+    StatsScope& stats,
+    const aesgcmsiv_kernel* kernel,
+    const uint8_t* key, size_t key_len,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out)
+{
+    // Validate parameters
+    int validation_result = validate_key(key, key_len);
+    if (validation_result == AESGCMSIV_SUCCESS) {
+        validation_result = validate_decrypt_params(
+            nonce, nonce_len, ciphertext, ciphertext_len, aad_len, tag, plaintext_out);
     }
-    
-    if (EVP_DecryptInit_ex2(ctx, cipher, key, nonce, nullptr) != 1) {
-        EVP_CIPHER_free(cipher);
-        EVP_CIPHER_CTX_free(ctx);
-        return AESGCMSIV_ERROR_INTERNAL;
+    if (validation_result != AESGCMSIV_SUCCESS) {
+        return validation_result;
     }
-    
-    EVP_CIPHER_free(cipher);
 
-    // Set AAD if provided
-    if (aad && aad_len > 0) {
-        int out_len;
-        if (EVP_DecryptUpdate(ctx, nullptr, &out_len, aad, static_cast<int>(aad_len)) != 1) {
-            EVP_CIPHER_CTX_free(ctx);
-            return AESGCMSIV_ERROR_INTERNAL;
-        }
+    if (kernel) {
+        aes_key_schedule ks;
+        kernel->expand_key(key, key_len, &ks);
+        stats.setup_done(kernel->name, vector_bits(kernel, ciphertext_len));
+        int result = kernel_open(
+            kernel, &ks, nonce, ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out);
+        aesgcmsiv_secure_zero(&ks, sizeof(ks));
+        return result;
     }
 
-    // Set the expected authentication tag
-    if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, AESGCMSIV_TAG_SIZE, const_cast<uint8_t*>(tag)) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        return AESGCMSIV_ERROR_INVALID_TAG;
-    }
+    return crypto_open(stats, key, key_len, nonce,
+        ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out);
+}
+
+static int encrypt_impl(
+    StatsScope& stats,
+    const uint8_t* key, size_t key_len,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out)
+{
+    return encrypt_impl_on(stats, active_kernel(), key, key_len, nonce, nonce_len,
+        plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out);
+}
+
+static int decrypt_impl(
+    StatsScope& stats,
+    const uint8_t* key, size_t key_len,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out)
+{
+    return decrypt_impl_on(stats, active_kernel(), key, key_len, nonce, nonce_len,
+        ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out);
+}
+
+int aesgcmsiv_encrypt(
+    const uint8_t* key, size_t key_len,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out)
+{
+    StatsScope stats(AESGCMSIV_OP_ENCRYPT, plaintext_len, aad_len);
+    return stats.finish(encrypt_impl(stats, key, key_len, nonce, nonce_len,
+        plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out), plaintext_len);
+}
+
+int aesgcmsiv_decrypt(
+    const uint8_t* key, size_t key_len,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out)
+{
+    StatsScope stats(AESGCMSIV_OP_DECRYPT, ciphertext_len, aad_len);
+    return stats.finish(decrypt_impl(stats, key, key_len, nonce, nonce_len,
+        ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out), ciphertext_len);
+}
 
-    // Decrypt ciphertext
-    int out_len;
-    if (EVP_DecryptUpdate(ctx, plaintext_out, &out_len, ciphertext, static_cast<int>(ciphertext_len)) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        return AESGCMSIV_ERROR_DECRYPT_FAILED;
+int aesgcmsiv_encrypt_small(
+    const uint8_t* key, size_t key_len,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out)
+{
+    StatsScope stats(AESGCMSIV_OP_ENCRYPT, plaintext_len, aad_len, StatsScope::Bounded{});
+    const aesgcmsiv_kernel* kernel = active_kernel();
+    if (!kernel) {
+        return stats.finish(AESGCMSIV_ERROR_INTERNAL, 0);
     }
+    if (plaintext_len > AESGCMSIV_SMALL_MAX_SIZE || aad_len > AESGCMSIV_SMALL_MAX_SIZE) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    return stats.finish(encrypt_impl_on(stats, kernel, key, key_len, nonce, nonce_len,
+        plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out), plaintext_len);
+}
 
-    // Finalize decryption and verify tag
-    if (EVP_DecryptFinal_ex(ctx, nullptr, &out_len) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        return AESGCMSIV_ERROR_DECRYPT_FAILED;
+int aesgcmsiv_decrypt_small(
+    const uint8_t* key, size_t key_len,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out)
+{
+    StatsScope stats(AESGCMSIV_OP_DECRYPT, ciphertext_len, aad_len, StatsScope::Bounded{});
+    const aesgcmsiv_kernel* kernel = active_kernel();
+    if (!kernel) {
+        return stats.finish(AESGCMSIV_ERROR_INTERNAL, 0);
+    }
+    if (ciphertext_len > AESGCMSIV_SMALL_MAX_SIZE || aad_len > AESGCMSIV_SMALL_MAX_SIZE) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
     }
+    return stats.finish(decrypt_impl_on(stats, kernel, key, key_len, nonce, nonce_len,
+        ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out), ciphertext_len);
+}
 
-    EVP_CIPHER_CTX_free(ctx);
-    return AESGCMSIV_SUCCESS;
+int aesgcmsiv_seal(
+    const uint8_t* key, size_t key_len,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* sealed_out)
+{
+    StatsScope stats(AESGCMSIV_OP_ENCRYPT, plaintext_len, aad_len);
+    if (!sealed_out) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    uint8_t* ciphertext = sealed_out + AESGCMSIV_NONCE_SIZE;
+    int result = encrypt_impl(stats, key, key_len, nonce, nonce_len,
+        plaintext, plaintext_len, aad, aad_len, ciphertext, ciphertext + plaintext_len);
+    if (result == AESGCMSIV_SUCCESS) {
+        // Written last so a nonce supplied from sealed_out itself still works
+        memmove(sealed_out, nonce, AESGCMSIV_NONCE_SIZE);
+    }
+    return stats.finish(result, plaintext_len);
+}
+
+int aesgcmsiv_open(
+    const uint8_t* key, size_t key_len,
+    const uint8_t* sealed, size_t sealed_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* plaintext_out)
+{
+    StatsScope stats(AESGCMSIV_OP_DECRYPT,
+        sealed_len >= AESGCMSIV_SEAL_OVERHEAD ? sealed_len - AESGCMSIV_SEAL_OVERHEAD : 0, aad_len);
+    if (!sealed || sealed_len < AESGCMSIV_SEAL_OVERHEAD) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    size_t ciphertext_len = sealed_len - AESGCMSIV_SEAL_OVERHEAD;
+    const uint8_t* ciphertext = sealed + AESGCMSIV_NONCE_SIZE;
+    return stats.finish(decrypt_impl(stats, key, key_len, sealed, AESGCMSIV_NONCE_SIZE,
+        ciphertext, ciphertext_len, aad, aad_len, ciphertext + ciphertext_len, plaintext_out),
+        ciphertext_len);
+}
+
+int aesgcmsiv_seal_b64url(
+    const uint8_t* key, size_t key_len,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    char* token_out,
+    size_t* token_len_out)
+{
+    StatsScope stats(AESGCMSIV_OP_ENCRYPT, plaintext_len, aad_len);
+    if (!nonce || nonce_len != AESGCMSIV_NONCE_SIZE) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_NONCE, 0);
+    }
+    return stats.finish(seal_b64url(nonce, plaintext_len, token_out, token_len_out,
+        [&](uint8_t* ciphertext_out, uint8_t* tag_out) {
+            return encrypt_impl(stats, key, key_len, nonce, nonce_len,
+                plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out);
+        }), plaintext_len);
+}
+
+int aesgcmsiv_open_b64url(
+    const uint8_t* key, size_t key_len,
+    const char* token, size_t token_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* plaintext_out,
+    size_t* plaintext_len_out)
+{
+    size_t plaintext_len;
+    if (!token_plaintext_len(token, token_len, &plaintext_len) || !plaintext_len_out) {
+        StatsScope stats(AESGCMSIV_OP_DECRYPT, 0, aad_len);
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    StatsScope stats(AESGCMSIV_OP_DECRYPT, plaintext_len, aad_len);
+    int result = open_b64url(token, token_len, plaintext_len, plaintext_out,
+        [&](const uint8_t* nonce, const uint8_t* tag, uint8_t* buffer) {
+            return decrypt_impl(stats, key, key_len, nonce, AESGCMSIV_NONCE_SIZE,
+                buffer, plaintext_len, aad, aad_len, tag, buffer);
+        });
+    if (result == AESGCMSIV_SUCCESS) {
+        *plaintext_len_out = plaintext_len;
+    }
+    return stats.finish(result, plaintext_len);
+}
+
+int aesgcmsiv_encryptv(
+    const uint8_t* key, size_t key_len,
+    const uint8_t* nonce, size_t nonce_len,
+    const aesgcmsiv_iovec* plaintext, size_t plaintext_count,
+    const aesgcmsiv_iovec* aad, size_t aad_count,
+    const aesgcmsiv_iovec_out* ciphertext_out, size_t ciphertext_count,
+    uint8_t* tag_out)
+{
+    StatsScope stats(AESGCMSIV_OP_ENCRYPT, 0, 0);
+    size_t plaintext_len, aad_len;
+    int validation_result = validate_key(key, key_len);
+    if (validation_result == AESGCMSIV_SUCCESS) {
+        validation_result = validate_vector_params(
+            nonce, nonce_len, plaintext, plaintext_count, aad, aad_count,
+            ciphertext_out, ciphertext_count, tag_out, &plaintext_len, &aad_len);
+    }
+    if (validation_result != AESGCMSIV_SUCCESS) {
+        return stats.finish(validation_result, 0);
+    }
+
+    if (const aesgcmsiv_kernel* kernel = active_kernel()) {
+        aes_key_schedule ks;
+        kernel->expand_key(key, key_len, &ks);
+        stats.setup_done(kernel->name, vector_bits(kernel, plaintext_len));
+        int result = kernel_sealv(
+            kernel, &ks, nonce, plaintext, plaintext_count, aad, aad_count,
+            ciphertext_out, ciphertext_count, tag_out);
+        aesgcmsiv_secure_zero(&ks, sizeof(ks));
+        return stats.finish(result, plaintext_len);
+    }
+
+    return stats.finish(sealv_gathered(plaintext, plaintext_count, plaintext_len, aad, aad_count, aad_len,
+        ciphertext_out, ciphertext_count,
+        [&](uint8_t* pt, size_t pt_len, const uint8_t* ad, size_t ad_len) {
+            return encrypt_impl(stats, key, key_len, nonce, nonce_len, pt, pt_len, ad, ad_len, pt, tag_out);
+        }), plaintext_len);
+}
+
+int aesgcmsiv_decryptv(
+    const uint8_t* key, size_t key_len,
+    const uint8_t* nonce, size_t nonce_len,
+    const aesgcmsiv_iovec* ciphertext, size_t ciphertext_count,
+    const aesgcmsiv_iovec* aad, size_t aad_count,
+    const uint8_t* tag,
+    const aesgcmsiv_iovec_out* plaintext_out, size_t plaintext_count)
+{
+    StatsScope stats(AESGCMSIV_OP_DECRYPT, 0, 0);
+    size_t ciphertext_len, aad_len;
+    int validation_result = validate_key(key, key_len);
+    if (validation_result == AESGCMSIV_SUCCESS) {
+        validation_result = validate_vector_params(
+            nonce, nonce_len, ciphertext, ciphertext_count, aad, aad_count,
+            plaintext_out, plaintext_count, tag, &ciphertext_len, &aad_len);
+    }
+    if (validation_result != AESGCMSIV_SUCCESS) {
+        return stats.finish(validation_result, 0);
+    }
+
+    if (const aesgcmsiv_kernel* kernel = active_kernel()) {
+        aes_key_schedule ks;
+        kernel->expand_key(key, key_len, &ks);
+        stats.setup_done(kernel->name, vector_bits(kernel, ciphertext_len));
+        int result = kernel_openv(
+            kernel, &ks, nonce, ciphertext, ciphertext_count, aad, aad_count,
+            tag, plaintext_out, plaintext_count);
+        aesgcmsiv_secure_zero(&ks, sizeof(ks));
+        return stats.finish(result, ciphertext_len);
+    }
+
+    return stats.finish(openv_gathered(ciphertext, ciphertext_count, ciphertext_len, aad, aad_count, aad_len,
+        plaintext_out, plaintext_count,
+        [&](uint8_t* ct, size_t ct_len, const uint8_t* ad, size_t ad_len) {
+            return decrypt_impl(stats, key, key_len, nonce, nonce_len, ct, ct_len, ad, ad_len, tag, ct);
+        }), ciphertext_len);
+}
+
+int aesgcmsiv_ctx_new(
+    const uint8_t* key, size_t key_len,
+    aesgcmsiv_ctx** ctx_out)
+{
+    return aesgcmsiv_ctx_new_ex(key, key_len, nullptr, nullptr, ctx_out);
+}
+
+static int ctx_new_impl(
+    const uint8_t* key, size_t key_len,
+    const char* provider, const char* properties,
+    aesgcmsiv_ctx** ctx_out)
+{
+    if (!ctx_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *ctx_out = nullptr;
+
+    int validation_result = validate_key(key, key_len);
+    if (validation_result != AESGCMSIV_SUCCESS) {
+        return validation_result;
+    }
+
+    aesgcmsiv_ctx* ctx = aesgcmsiv_secure_new<aesgcmsiv_ctx>();
+    if (!ctx) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    ctx->threads = 1;
+
+    // Naming a provider or properties pins the context to OpenSSL, since the
+    // in-library kernels would bypass whatever the caller selected
+    const bool select = provider || properties;
+    if (!select) {
+        if (const aesgcmsiv_kernel* kernel = active_kernel()) {
+            ctx->kernel = kernel;
+            kernel->expand_key(key, key_len, &ctx->key_schedule);
+            *ctx_out = ctx;
+            return AESGCMSIV_SUCCESS;
+        }
+    }
+
+    int result = crypto_key_new(key, key_len, provider, properties, &ctx->library_key);
+    if (result != AESGCMSIV_SUCCESS) {
+        aesgcmsiv_ctx_free(ctx);
+        return result;
+    }
+
+    *ctx_out = ctx;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_ctx_new_ex(
+    const uint8_t* key, size_t key_len,
+    const char* provider, const char* properties,
+    aesgcmsiv_ctx** ctx_out)
+{
+    int result = ctx_new_impl(key, key_len, provider, properties, ctx_out);
+    AESGCMSIV_TRACE2(ctx__new, key_len, result);
+    return result;
+}
+
+static void nonce_cache_free(nonce_cache* cache)
+{
+    if (!cache) {
+        return;
+    }
+    OPENSSL_cleanse(cache->entries, (cache->mask + 1) * sizeof(nonce_cache_entry));
+    delete[] cache->entries;
+    delete cache;
+}
+
+static size_t nonce_cache_index(const nonce_cache* cache, const uint8_t* nonce)
+{
+    uint64_t lo;
+    uint32_t hi;
+    memcpy(&lo, nonce, sizeof(lo));
+    memcpy(&hi, nonce + sizeof(lo), sizeof(hi));
+    uint64_t h = (lo ^ (static_cast<uint64_t>(hi) * 0x9e3779b97f4a7c15ULL)) * 0xbf58476d1ce4e5b9ULL;
+    return static_cast<size_t>(h ^ (h >> 31)) & cache->mask;
+}
+
+// The kernel for a message of len bytes: the context's own, or its 128-bit
+// stand-in below the context's wide_min
+static const aesgcmsiv_kernel* ctx_kernel(const aesgcmsiv_ctx* ctx, uint64_t len)
+{
+    const size_t min = ctx->wide_min.load(std::memory_order_relaxed);
+    if (!min || len >= min || len < ctx->kernel->vector_min_bytes) {
+        return ctx->kernel;
+    }
+    const aesgcmsiv_kernel* narrow = narrow_kernel(ctx->kernel);
+    return narrow ? narrow : ctx->kernel;
+}
+
+// The per-nonce keys, copied from the cache or derived and stored there. An
+// entry another thread holds is not waited for; this call just derives.
+static void ctx_derive_keys(
+    const aesgcmsiv_ctx* ctx, const uint8_t* nonce,
+    uint8_t* auth_key, aes_key_schedule* enc_ks)
+{
+    nonce_cache_entry& entry = ctx->nonces->entries[nonce_cache_index(ctx->nonces, nonce)];
+    if (entry.busy.test_and_set(std::memory_order_acquire)) {
+        ctx->kernel->derive_keys(&ctx->key_schedule, nonce, auth_key, enc_ks);
+        return;
+    }
+    // Nonces are not secret, so a plain comparison is fine
+    if (entry.valid && memcmp(entry.nonce, nonce, AESGCMSIV_NONCE_SIZE) == 0) {
+        memcpy(auth_key, entry.auth_key, sizeof(entry.auth_key));
+        *enc_ks = entry.enc_ks;
+    } else {
+        ctx->kernel->derive_keys(&ctx->key_schedule, nonce, auth_key, enc_ks);
+        memcpy(entry.nonce, nonce, AESGCMSIV_NONCE_SIZE);
+        memcpy(entry.auth_key, auth_key, sizeof(entry.auth_key));
+        entry.enc_ks = *enc_ks;
+        entry.valid = true;
+    }
+    entry.busy.clear(std::memory_order_release);
+}
+
+// kernel_seal and kernel_open on the calling thread, through the context's
+// nonce cache when it has one
+static int ctx_kernel_seal(
+    const aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out)
+{
+    const aesgcmsiv_kernel* kernel = ctx_kernel(ctx, plaintext_len);
+    if (!ctx->nonces) {
+        return kernel_seal(kernel, &ctx->key_schedule, nonce,
+            plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out);
+    }
+    alignas(16) uint8_t auth_key[16];
+    aes_key_schedule enc_ks;
+    ctx_derive_keys(ctx, nonce, auth_key, &enc_ks);
+    int result = kernel_seal_derived(kernel, auth_key, &enc_ks, nonce,
+        plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out);
+    OPENSSL_cleanse(&enc_ks, sizeof(enc_ks));
+    OPENSSL_cleanse(auth_key, sizeof(auth_key));
+    return result;
+}
+
+static int ctx_kernel_open(
+    const aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out)
+{
+    const aesgcmsiv_kernel* kernel = ctx_kernel(ctx, ciphertext_len);
+    if (!ctx->nonces) {
+        return kernel_open(kernel, &ctx->key_schedule, nonce,
+            ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out);
+    }
+    alignas(16) uint8_t auth_key[16];
+    aes_key_schedule enc_ks;
+    ctx_derive_keys(ctx, nonce, auth_key, &enc_ks);
+    int result = kernel_open_derived(kernel, auth_key, &enc_ks, nonce,
+        ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out);
+    OPENSSL_cleanse(&enc_ks, sizeof(enc_ks));
+    OPENSSL_cleanse(auth_key, sizeof(auth_key));
+    return result;
+}
+
+// Below one parallel share a call never leaves the calling thread, and only
+// there is derivation a noticeable part of the cost
+static bool ctx_uses_nonce_cache(const aesgcmsiv_ctx* ctx, size_t len)
+{
+    return ctx->nonces && len < kernel_parallel_min_bytes.load(std::memory_order_relaxed);
+}
+
+// ctx_kernel, swapped for its streaming form once len reaches the context's
+// threshold
+static const aesgcmsiv_kernel* ctx_output_kernel(const aesgcmsiv_ctx* ctx, size_t len)
+{
+    const aesgcmsiv_kernel* kernel = ctx_kernel(ctx, len);
+    const size_t min = ctx->stream_min.load(std::memory_order_relaxed);
+    const aesgcmsiv_kernel* streaming = min && len >= min ? streaming_kernel(kernel) : nullptr;
+    return streaming ? streaming : kernel;
+}
+
+// A context call whose parameters are known to be valid: the shared tail of
+// the checked and _unchecked entry points
+static int ctx_seal_validated(
+    StatsScope& stats,
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out)
+{
+    stats.set_key_context(ctx);
+    if (ctx->kernel) {
+        const aesgcmsiv_kernel* kernel = ctx_kernel(ctx, plaintext_len);
+        stats.setup_done(kernel->name, vector_bits(kernel, plaintext_len));
+        if (ctx_uses_nonce_cache(ctx, plaintext_len)) {
+            return ctx_kernel_seal(ctx, nonce, plaintext, plaintext_len,
+                aad, aad_len, ciphertext_out, tag_out);
+        }
+        return kernel_seal_parallel(ctx_output_kernel(ctx, plaintext_len), &ctx->key_schedule,
+            ctx->threads.load(std::memory_order_relaxed),
+            ctx->pool.load(std::memory_order_acquire), nonce,
+            plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out);
+    }
+
+    return crypto_key_seal(stats, ctx->library_key, nonce,
+        plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out);
+}
+
+static int ctx_open_validated(
+    StatsScope& stats,
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out)
+{
+    stats.set_key_context(ctx);
+    if (ctx->kernel) {
+        const aesgcmsiv_kernel* kernel = ctx_kernel(ctx, ciphertext_len);
+        stats.setup_done(kernel->name, vector_bits(kernel, ciphertext_len));
+        if (ctx_uses_nonce_cache(ctx, ciphertext_len)) {
+            return ctx_kernel_open(ctx, nonce, ciphertext, ciphertext_len,
+                aad, aad_len, tag, plaintext_out);
+        }
+        return kernel_open_parallel(ctx_output_kernel(ctx, ciphertext_len), &ctx->key_schedule,
+            ctx->threads.load(std::memory_order_relaxed),
+            ctx->pool.load(std::memory_order_acquire), nonce,
+            ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out);
+    }
+
+    return crypto_key_open(stats, ctx->library_key, nonce,
+        ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out);
+}
+
+// The bodies of aesgcmsiv_ctx_encrypt and aesgcmsiv_ctx_decrypt, for the
+// vector, batch and engine paths that run them per message
+static int ctx_encrypt_impl(
+    StatsScope& stats,
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out)
+{
+    if (!ctx) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    int validation_result = validate_encrypt_params(
+        nonce, nonce_len, plaintext, plaintext_len, aad_len, ciphertext_out, tag_out);
+    if (validation_result != AESGCMSIV_SUCCESS) {
+        return validation_result;
+    }
+    return ctx_seal_validated(stats, ctx, nonce,
+        plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out);
+}
+
+static int ctx_decrypt_impl(
+    StatsScope& stats,
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out)
+{
+    if (!ctx) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    int validation_result = validate_decrypt_params(
+        nonce, nonce_len, ciphertext, ciphertext_len, aad_len, tag, plaintext_out);
+    if (validation_result != AESGCMSIV_SUCCESS) {
+        return validation_result;
+    }
+    return ctx_open_validated(stats, ctx, nonce,
+        ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out);
+}
+
+int aesgcmsiv_ctx_encrypt(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out)
+{
+    StatsScope stats(AESGCMSIV_OP_ENCRYPT, plaintext_len, aad_len);
+    return stats.finish(ctx_encrypt_impl(stats, ctx, nonce, nonce_len,
+        plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out), plaintext_len);
+}
+
+int aesgcmsiv_ctx_decrypt(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out)
+{
+    StatsScope stats(AESGCMSIV_OP_DECRYPT, ciphertext_len, aad_len);
+    return stats.finish(ctx_decrypt_impl(stats, ctx, nonce, nonce_len,
+        ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out), ciphertext_len);
+}
+
+int aesgcmsiv_ctx_encrypt_hashed(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out,
+    uint64_t* hash_out)
+{
+    StatsScope stats(AESGCMSIV_OP_ENCRYPT, plaintext_len, aad_len);
+    if (!ctx || !hash_out) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    int validation_result = validate_encrypt_params(
+        nonce, nonce_len, plaintext, plaintext_len, aad_len, ciphertext_out, tag_out);
+    if (validation_result != AESGCMSIV_SUCCESS) {
+        return stats.finish(validation_result, 0);
+    }
+    stats.set_key_context(ctx);
+    if (!ctx->kernel) {
+        // Hashed first, as ciphertext_out may be plaintext
+        const uint64_t hash = aesgcmsiv_xxh3_64(g_registry.cpu_features, plaintext, plaintext_len);
+        int result = crypto_key_seal(stats, ctx->library_key, nonce,
+            plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out);
+        if (result == AESGCMSIV_SUCCESS) {
+            *hash_out = hash;
+        }
+        return stats.finish(result, plaintext_len);
+    }
+    const aesgcmsiv_kernel* kernel = ctx_output_kernel(ctx, plaintext_len);
+    stats.setup_done(kernel->name, vector_bits(kernel, plaintext_len));
+    return stats.finish(kernel_seal_hashed(kernel, &ctx->key_schedule, nonce,
+        plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out,
+        g_registry.cpu_features, hash_out), plaintext_len);
+}
+
+int aesgcmsiv_ctx_authenticate(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* tag_out)
+{
+    StatsScope stats(AESGCMSIV_OP_ENCRYPT, 0, aad_len);
+    return stats.finish(ctx_encrypt_impl(stats, ctx, nonce, nonce_len,
+        nullptr, 0, aad, aad_len, nullptr, tag_out), 0);
+}
+
+int aesgcmsiv_ctx_verify(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag)
+{
+    StatsScope stats(AESGCMSIV_OP_DECRYPT, 0, aad_len);
+    return stats.finish(ctx_decrypt_impl(stats, ctx, nonce, nonce_len,
+        nullptr, 0, aad, aad_len, tag, nullptr), 0);
+}
+
+// ctx_kernel_open for a call that keeps no plaintext; safe on pool workers
+static int ctx_kernel_verify(
+    const aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag)
+{
+    const aesgcmsiv_kernel* kernel = ctx_kernel(ctx, ciphertext_len);
+    if (!ctx->nonces) {
+        return kernel_verify(kernel, &ctx->key_schedule, nonce,
+            ciphertext, ciphertext_len, aad, aad_len, tag);
+    }
+    alignas(16) uint8_t auth_key[16];
+    aes_key_schedule enc_ks;
+    ctx_derive_keys(ctx, nonce, auth_key, &enc_ks);
+    int result = kernel_verify_derived(kernel, auth_key, &enc_ks, nonce,
+        ciphertext, ciphertext_len, aad, aad_len, tag);
+    OPENSSL_cleanse(&enc_ks, sizeof(enc_ks));
+    OPENSSL_cleanse(auth_key, sizeof(auth_key));
+    return result;
+}
+
+// With a kernel the plaintext only ever lands in kernel_verify's L1
+// scratch. The crypto library opens into a buffer, so there it is opened
+// into a temporary one and cleared.
+static int ctx_verify_validated(
+    StatsScope& stats,
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag)
+{
+    stats.set_key_context(ctx);
+    if (ctx->kernel) {
+        const aesgcmsiv_kernel* kernel = ctx_kernel(ctx, ciphertext_len);
+        stats.setup_done(kernel->name, vector_bits(kernel, ciphertext_len));
+        return ctx_kernel_verify(ctx, nonce, ciphertext, ciphertext_len, aad, aad_len, tag);
+    }
+
+    uint8_t* scratch = nullptr;
+    if (ciphertext_len) {
+        scratch = static_cast<uint8_t*>(aesgcmsiv_block_alloc(ciphertext_len));
+        if (!scratch) {
+            return AESGCMSIV_ERROR_INTERNAL;
+        }
+    }
+    int result = crypto_key_open(stats, ctx->library_key, nonce,
+        ciphertext, ciphertext_len, aad, aad_len, tag, scratch);
+    if (scratch) {
+        OPENSSL_cleanse(scratch, ciphertext_len);
+        aesgcmsiv_block_free(scratch, ciphertext_len);
+    }
+    return result;
+}
+
+int aesgcmsiv_ctx_verify_ciphertext(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag)
+{
+    StatsScope stats(AESGCMSIV_OP_DECRYPT, ciphertext_len, aad_len);
+    if (!ctx) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    int validation_result = validate_verify_params(nonce, nonce_len, ciphertext, ciphertext_len, aad_len, tag);
+    if (validation_result != AESGCMSIV_SUCCESS) {
+        return stats.finish(validation_result, 0);
+    }
+    return stats.finish(ctx_verify_validated(stats, ctx, nonce,
+        ciphertext, ciphertext_len, aad, aad_len, tag), ciphertext_len);
+}
+
+int aesgcmsiv_open_trial(
+    aesgcmsiv_ctx* const* ctxs, size_t count,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out,
+    size_t* index_out)
+{
+    StatsScope stats(AESGCMSIV_OP_DECRYPT, ciphertext_len, aad_len);
+    if (index_out) {
+        *index_out = count;
+    }
+    if (count == 0 || !ctxs) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (!ctxs[i]) {
+            return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+        }
+    }
+    int result = validate_decrypt_params(
+        nonce, nonce_len, ciphertext, ciphertext_len, aad_len, tag, plaintext_out);
+    if (result != AESGCMSIV_SUCCESS) {
+        return stats.finish(result, 0);
+    }
+
+    // The last candidate has nothing left to preserve the ciphertext for
+    bool in_place = ciphertext_len && plaintext_out == ciphertext;
+    for (size_t i = 0; i < count; i++) {
+        if (in_place && i + 1 < count) {
+            result = ctx_verify_validated(stats, ctxs[i], nonce,
+                ciphertext, ciphertext_len, aad, aad_len, tag);
+            if (result == AESGCMSIV_SUCCESS) {
+                result = ctx_open_validated(stats, ctxs[i], nonce,
+                    ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out);
+            }
+        } else {
+            result = ctx_open_validated(stats, ctxs[i], nonce,
+                ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out);
+        }
+        if (result != AESGCMSIV_ERROR_DECRYPT_FAILED) {
+            if (result == AESGCMSIV_SUCCESS && index_out) {
+                *index_out = i;
+            }
+            break;
+        }
+    }
+    return stats.finish(result, ciphertext_len);
+}
+
+// What a message takes next. AAD comes first; then either one seal or open
+// call, or plaintext absorbed in pieces, the tag and the ciphertext emitted
+// in pieces.
+enum msg_phase {
+    MSG_AAD,
+    MSG_ABSORB,
+    MSG_EMIT,
+    MSG_FINISHED,
+};
+
+// With a kernel the AAD and absorbed plaintext go straight into pv, a whole
+// block at a time; the crypto library's AAD is gathered in aad instead
+struct aesgcmsiv_ctx_msg {
+    polyval_state pv;
+    aes_key_schedule enc_ks;
+    ctr32_stream ctr;  // MSG_EMIT only
+    aesgcmsiv_ctx* ctx;
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    uint8_t partial[16];  // input short of a block
+    size_t partial_len;
+    uint64_t aad_len;
+    uint64_t msg_len;  // plaintext absorbed
+    uint64_t emitted;  // ciphertext emitted
+    uint8_t* aad;  // crypto library only; from aesgcmsiv_block_alloc
+    size_t aad_capacity;
+    msg_phase phase;
+};
+
+int aesgcmsiv_ctx_begin(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    aesgcmsiv_ctx_msg** msg_out)
+{
+    if (!msg_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *msg_out = nullptr;
+    if (!ctx) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (!nonce || nonce_len != AESGCMSIV_NONCE_SIZE) {
+        return AESGCMSIV_ERROR_INVALID_NONCE;
+    }
+    aesgcmsiv_ctx_msg* msg = aesgcmsiv_secure_new<aesgcmsiv_ctx_msg>();
+    if (!msg) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    msg->ctx = ctx;
+    memcpy(msg->nonce, nonce, AESGCMSIV_NONCE_SIZE);
+    if (ctx->kernel) {
+        alignas(16) uint8_t auth_key[16];
+        if (ctx->nonces) {
+            ctx_derive_keys(ctx, nonce, auth_key, &msg->enc_ks);
+        } else {
+            ctx->kernel->derive_keys(&ctx->key_schedule, nonce, auth_key, &msg->enc_ks);
+        }
+        // Every power the widest stride uses, since the length is not known
+        ctx->kernel->polyval_init(&msg->pv, auth_key, SIZE_MAX);
+        OPENSSL_cleanse(auth_key, sizeof(auth_key));
+    }
+    *msg_out = msg;
+    return AESGCMSIV_SUCCESS;
+}
+
+// Appends to the gathered AAD of a crypto library message, doubling the
+// buffer as it fills
+static int gather_aad(aesgcmsiv_ctx_msg* msg, const uint8_t* aad, size_t aad_len)
+{
+    const size_t used = static_cast<size_t>(msg->aad_len);
+    if (aad_len > msg->aad_capacity - used) {
+        size_t capacity = msg->aad_capacity ? msg->aad_capacity : 256;
+        while (capacity - used < aad_len) {
+            if (capacity > SIZE_MAX / 2) {
+                return AESGCMSIV_ERROR_INVALID_INPUT;
+            }
+            capacity *= 2;
+        }
+        uint8_t* grown = static_cast<uint8_t*>(aesgcmsiv_block_alloc(capacity));
+        if (!grown) {
+            return AESGCMSIV_ERROR_INTERNAL;
+        }
+        if (msg->aad) {
+            memcpy(grown, msg->aad, used);
+            OPENSSL_cleanse(msg->aad, used);
+            aesgcmsiv_block_free(msg->aad, msg->aad_capacity);
+        }
+        msg->aad = grown;
+        msg->aad_capacity = capacity;
+    }
+    memcpy(msg->aad + used, aad, aad_len);
+    return AESGCMSIV_SUCCESS;
+}
+
+// Absorbs a piece of AAD or plaintext into the message's POLYVAL, carrying
+// what falls short of a block over to the next piece
+static void absorb_piece(aesgcmsiv_ctx_msg* msg, const uint8_t* data, size_t len)
+{
+    const aesgcmsiv_kernel* kernel = msg->ctx->kernel;
+    if (msg->partial_len) {
+        size_t take = std::min(16 - msg->partial_len, len);
+        memcpy(msg->partial + msg->partial_len, data, take);
+        msg->partial_len += take;
+        data += take;
+        len -= take;
+        if (msg->partial_len < 16) {
+            return;
+        }
+        kernel->polyval_blocks(&msg->pv, msg->partial, 1);
+        msg->partial_len = 0;
+    }
+    if (len >= 16) {
+        kernel->polyval_blocks(&msg->pv, data, len / 16);
+    }
+    memcpy(msg->partial, data + (len & ~static_cast<size_t>(15)), len % 16);
+    msg->partial_len = len % 16;
+}
+
+// Absorbs the input left short of a block, zero-padded, closing the AAD or
+// the message
+static void absorb_partial(aesgcmsiv_ctx_msg* msg)
+{
+    if (msg->partial_len) {
+        memset(msg->partial + msg->partial_len, 0, 16 - msg->partial_len);
+        msg->ctx->kernel->polyval_blocks(&msg->pv, msg->partial, 1);
+        OPENSSL_cleanse(msg->partial, sizeof(msg->partial));
+        msg->partial_len = 0;
+    }
+}
+
+int aesgcmsiv_ctx_aad_update(
+    aesgcmsiv_ctx_msg* msg,
+    const uint8_t* aad, size_t aad_len)
+{
+    if (!msg || msg->phase != MSG_AAD || (!aad && aad_len)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (aad_len == 0) {
+        return AESGCMSIV_SUCCESS;
+    }
+    if (exceeds_max_input(msg->aad_len + aad_len)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (!msg->ctx->kernel) {
+        int result = gather_aad(msg, aad, aad_len);
+        if (result == AESGCMSIV_SUCCESS) {
+            msg->aad_len += aad_len;
+        }
+        return result;
+    }
+    msg->aad_len += aad_len;
+    absorb_piece(msg, aad, aad_len);
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_ctx_seal(
+    aesgcmsiv_ctx_msg* msg,
+    const uint8_t* plaintext, size_t plaintext_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out)
+{
+    StatsScope stats(AESGCMSIV_OP_ENCRYPT, plaintext_len, msg ? msg->aad_len : 0);
+    if (!msg || msg->phase != MSG_AAD) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    int validation_result = validate_encrypt_params(msg->nonce, AESGCMSIV_NONCE_SIZE,
+        plaintext, plaintext_len, 0, ciphertext_out, tag_out);
+    if (validation_result != AESGCMSIV_SUCCESS) {
+        return stats.finish(validation_result, 0);
+    }
+    msg->phase = MSG_FINISHED;
+    const aesgcmsiv_ctx* ctx = msg->ctx;
+    if (!ctx->kernel) {
+        return stats.finish(crypto_key_seal(stats, ctx->library_key, msg->nonce,
+            plaintext, plaintext_len, msg->aad, static_cast<size_t>(msg->aad_len), ciphertext_out, tag_out), plaintext_len);
+    }
+    stats.setup_done(ctx->kernel->name, vector_bits(ctx->kernel, plaintext_len));
+    absorb_partial(msg);
+    return stats.finish(kernel_seal_absorbed(ctx->kernel, &msg->pv, msg->aad_len, &msg->enc_ks,
+        msg->nonce, plaintext, plaintext_len, ciphertext_out, tag_out), plaintext_len);
+}
+
+int aesgcmsiv_ctx_open(
+    aesgcmsiv_ctx_msg* msg,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out)
+{
+    StatsScope stats(AESGCMSIV_OP_DECRYPT, ciphertext_len, msg ? msg->aad_len : 0);
+    if (!msg || msg->phase != MSG_AAD) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    int validation_result = validate_decrypt_params(msg->nonce, AESGCMSIV_NONCE_SIZE,
+        ciphertext, ciphertext_len, 0, tag, plaintext_out);
+    if (validation_result != AESGCMSIV_SUCCESS) {
+        return stats.finish(validation_result, 0);
+    }
+    msg->phase = MSG_FINISHED;
+    const aesgcmsiv_ctx* ctx = msg->ctx;
+    if (!ctx->kernel) {
+        return stats.finish(crypto_key_open(stats, ctx->library_key, msg->nonce,
+            ciphertext, ciphertext_len, msg->aad, static_cast<size_t>(msg->aad_len), tag, plaintext_out), ciphertext_len);
+    }
+    stats.setup_done(ctx->kernel->name, vector_bits(ctx->kernel, ciphertext_len));
+    absorb_partial(msg);
+    return stats.finish(kernel_open_absorbed(ctx->kernel, &msg->pv, msg->aad_len, &msg->enc_ks,
+        msg->nonce, ciphertext, ciphertext_len, tag, plaintext_out), ciphertext_len);
+}
+
+int aesgcmsiv_ctx_absorb_plaintext(
+    aesgcmsiv_ctx_msg* msg,
+    const uint8_t* plaintext, size_t plaintext_len)
+{
+    if (!msg || (msg->phase != MSG_AAD && msg->phase != MSG_ABSORB) || (!plaintext && plaintext_len)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (!msg->ctx->kernel) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    if (exceeds_max_input(msg->msg_len + plaintext_len)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (msg->phase == MSG_AAD) {
+        absorb_partial(msg);
+        msg->phase = MSG_ABSORB;
+    }
+    if (plaintext_len) {
+        msg->msg_len += plaintext_len;
+        absorb_piece(msg, plaintext, plaintext_len);
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_ctx_finalize_tag(aesgcmsiv_ctx_msg* msg, uint8_t* tag_out)
+{
+    if (!msg || (msg->phase != MSG_AAD && msg->phase != MSG_ABSORB) || !tag_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    const aesgcmsiv_kernel* kernel = msg->ctx->kernel;
+    if (!kernel) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    // Closes the AAD if no plaintext came, otherwise the plaintext
+    absorb_partial(msg);
+    alignas(16) uint8_t tag[16];
+    kernel_absorbed_tag(kernel, &msg->pv, msg->aad_len, msg->msg_len, &msg->enc_ks, msg->nonce, tag);
+    ctr32_stream_init(&msg->ctr, tag);
+    memcpy(tag_out, tag, AESGCMSIV_TAG_SIZE);
+    msg->phase = msg->msg_len ? MSG_EMIT : MSG_FINISHED;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_ctx_emit_ciphertext(
+    aesgcmsiv_ctx_msg* msg,
+    const uint8_t* plaintext, size_t plaintext_len,
+    uint8_t* ciphertext_out)
+{
+    if (!msg || msg->phase != MSG_EMIT || (plaintext_len && (!plaintext || !ciphertext_out))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (plaintext_len > msg->msg_len - msg->emitted) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (plaintext_len) {
+        kernel_ctr32_stream(msg->ctx->kernel, &msg->enc_ks, &msg->ctr, plaintext, ciphertext_out, plaintext_len);
+        msg->emitted += plaintext_len;
+    }
+    if (msg->emitted == msg->msg_len) {
+        OPENSSL_cleanse(&msg->ctr, sizeof(msg->ctr));
+        OPENSSL_cleanse(&msg->enc_ks, sizeof(msg->enc_ks));
+        msg->phase = MSG_FINISHED;
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+void aesgcmsiv_ctx_msg_free(aesgcmsiv_ctx_msg* msg)
+{
+    if (!msg) {
+        return;
+    }
+    if (msg->aad) {
+        OPENSSL_cleanse(msg->aad, static_cast<size_t>(msg->aad_len));
+        aesgcmsiv_block_free(msg->aad, msg->aad_capacity);
+    }
+    aesgcmsiv_secure_delete(msg);
+}
+
+// Nonces per refill of a thread's buffer: one DRBG call, with its locking
+// and reseed checks, covers this many messages
+#define NONCE_BUFFER_NONCES 64
+
+// Bumped in the child after fork, which inherits every thread buffer as it
+// was; a buffer filled in an older generation is discarded
+static std::atomic<uint32_t> g_nonce_generation(0);
+
+struct ThreadNonceBuffer {
+    uint8_t bytes[NONCE_BUFFER_NONCES * AESGCMSIV_NONCE_SIZE];
+    size_t next = NONCE_BUFFER_NONCES;  // index of the next unused nonce
+    uint32_t generation = 0;
+
+    ~ThreadNonceBuffer()
+    {
+        OPENSSL_cleanse(bytes, sizeof(bytes));
+    }
+};
+
+static thread_local ThreadNonceBuffer thread_nonces;
+
+#if !defined(_WIN32)
+static const int g_nonce_fork_handler = pthread_atfork(nullptr, nullptr, [] {
+    g_nonce_generation.fetch_add(1, std::memory_order_relaxed);
+});
+#endif
+
+int aesgcmsiv_random_nonce(uint8_t* nonce_out)
+{
+    if (!nonce_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    ThreadNonceBuffer& buffer = thread_nonces;
+    const uint32_t generation = g_nonce_generation.load(std::memory_order_relaxed);
+    if (buffer.next == NONCE_BUFFER_NONCES || buffer.generation != generation) {
+        int result = crypto_random(buffer.bytes, sizeof(buffer.bytes));
+        if (result != AESGCMSIV_SUCCESS) {
+            buffer.next = NONCE_BUFFER_NONCES;
+            return result;
+        }
+        buffer.next = 0;
+        buffer.generation = generation;
+    }
+    uint8_t* nonce = buffer.bytes + buffer.next * AESGCMSIV_NONCE_SIZE;
+    memcpy(nonce_out, nonce, AESGCMSIV_NONCE_SIZE);
+    // Spent nonces are public, but none is ever there to hand out twice
+    OPENSSL_cleanse(nonce, AESGCMSIV_NONCE_SIZE);
+    buffer.next++;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_ctx_encrypt_autononce(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* sealed_out)
+{
+    StatsScope stats(AESGCMSIV_OP_ENCRYPT, plaintext_len, aad_len);
+    if (!sealed_out) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    alignas(16) uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    int result = aesgcmsiv_random_nonce(nonce);
+    if (result != AESGCMSIV_SUCCESS) {
+        return stats.finish(result, 0);
+    }
+    uint8_t* ciphertext = sealed_out + AESGCMSIV_NONCE_SIZE;
+    result = ctx_encrypt_impl(stats, ctx, nonce, AESGCMSIV_NONCE_SIZE,
+        plaintext, plaintext_len, aad, aad_len, ciphertext, ciphertext + plaintext_len);
+    if (result == AESGCMSIV_SUCCESS) {
+        memcpy(sealed_out, nonce, AESGCMSIV_NONCE_SIZE);
+    }
+    return stats.finish(result, plaintext_len);
+}
+
+int aesgcmsiv_ctx_seal_b64url(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    char* token_out,
+    size_t* token_len_out)
+{
+    StatsScope stats(AESGCMSIV_OP_ENCRYPT, plaintext_len, aad_len);
+    alignas(16) uint8_t fresh[AESGCMSIV_NONCE_SIZE];
+    if (!nonce) {
+        if (nonce_len != 0) {
+            return stats.finish(AESGCMSIV_ERROR_INVALID_NONCE, 0);
+        }
+        int result = aesgcmsiv_random_nonce(fresh);
+        if (result != AESGCMSIV_SUCCESS) {
+            return stats.finish(result, 0);
+        }
+        nonce = fresh;
+        nonce_len = AESGCMSIV_NONCE_SIZE;
+    } else if (nonce_len != AESGCMSIV_NONCE_SIZE) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_NONCE, 0);
+    }
+    return stats.finish(seal_b64url(nonce, plaintext_len, token_out, token_len_out,
+        [&](uint8_t* ciphertext_out, uint8_t* tag_out) {
+            return ctx_encrypt_impl(stats, ctx, nonce, nonce_len,
+                plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out);
+        }), plaintext_len);
+}
+
+int aesgcmsiv_ctx_open_b64url(
+    aesgcmsiv_ctx* ctx,
+    const char* token, size_t token_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* plaintext_out,
+    size_t* plaintext_len_out)
+{
+    size_t plaintext_len;
+    if (!token_plaintext_len(token, token_len, &plaintext_len) || !plaintext_len_out) {
+        StatsScope stats(AESGCMSIV_OP_DECRYPT, 0, aad_len);
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    StatsScope stats(AESGCMSIV_OP_DECRYPT, plaintext_len, aad_len);
+    int result = open_b64url(token, token_len, plaintext_len, plaintext_out,
+        [&](const uint8_t* nonce, const uint8_t* tag, uint8_t* buffer) {
+            return ctx_decrypt_impl(stats, ctx, nonce, AESGCMSIV_NONCE_SIZE,
+                buffer, plaintext_len, aad, aad_len, tag, buffer);
+        });
+    if (result == AESGCMSIV_SUCCESS) {
+        *plaintext_len_out = plaintext_len;
+    }
+    return stats.finish(result, plaintext_len);
+}
+
+int aesgcmsiv_ctx_encrypt_small(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out)
+{
+    StatsScope stats(AESGCMSIV_OP_ENCRYPT, plaintext_len, aad_len, StatsScope::Bounded{});
+    if (!ctx) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    if (!ctx->kernel) {
+        return stats.finish(AESGCMSIV_ERROR_INTERNAL, 0);
+    }
+    if (plaintext_len > AESGCMSIV_SMALL_MAX_SIZE || aad_len > AESGCMSIV_SMALL_MAX_SIZE) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    int validation_result = validate_encrypt_params(
+        nonce, nonce_len, plaintext, plaintext_len, aad_len, ciphertext_out, tag_out);
+    if (validation_result != AESGCMSIV_SUCCESS) {
+        return stats.finish(validation_result, 0);
+    }
+    const aesgcmsiv_kernel* kernel = ctx_kernel(ctx, plaintext_len);
+    stats.setup_done(kernel->name, vector_bits(kernel, plaintext_len));
+    return stats.finish(ctx_kernel_seal(ctx, nonce,
+        plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out), plaintext_len);
+}
+
+int aesgcmsiv_ctx_decrypt_small(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out)
+{
+    StatsScope stats(AESGCMSIV_OP_DECRYPT, ciphertext_len, aad_len, StatsScope::Bounded{});
+    if (!ctx) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    if (!ctx->kernel) {
+        return stats.finish(AESGCMSIV_ERROR_INTERNAL, 0);
+    }
+    if (ciphertext_len > AESGCMSIV_SMALL_MAX_SIZE || aad_len > AESGCMSIV_SMALL_MAX_SIZE) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    int validation_result = validate_decrypt_params(
+        nonce, nonce_len, ciphertext, ciphertext_len, aad_len, tag, plaintext_out);
+    if (validation_result != AESGCMSIV_SUCCESS) {
+        return stats.finish(validation_result, 0);
+    }
+    const aesgcmsiv_kernel* kernel = ctx_kernel(ctx, ciphertext_len);
+    stats.setup_done(kernel->name, vector_bits(kernel, ciphertext_len));
+    return stats.finish(ctx_kernel_open(ctx, nonce,
+        ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out), ciphertext_len);
+}
+
+int aesgcmsiv_ctx_encrypt_unchecked(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out)
+{
+    StatsScope stats(AESGCMSIV_OP_ENCRYPT, plaintext_len, aad_len);
+    return stats.finish(ctx_seal_validated(stats, ctx, nonce,
+        plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out), plaintext_len);
+}
+
+int aesgcmsiv_ctx_decrypt_unchecked(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out)
+{
+    StatsScope stats(AESGCMSIV_OP_DECRYPT, ciphertext_len, aad_len);
+    return stats.finish(ctx_open_validated(stats, ctx, nonce,
+        ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out), ciphertext_len);
+}
+
+// The context's kernel is still checked: it is state, not a parameter, and a
+// context bound to a provider has none
+int aesgcmsiv_ctx_encrypt_small_unchecked(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out)
+{
+    StatsScope stats(AESGCMSIV_OP_ENCRYPT, plaintext_len, aad_len, StatsScope::Bounded{});
+    if (!ctx->kernel) {
+        return stats.finish(AESGCMSIV_ERROR_INTERNAL, 0);
+    }
+    const aesgcmsiv_kernel* kernel = ctx_kernel(ctx, plaintext_len);
+    stats.setup_done(kernel->name, vector_bits(kernel, plaintext_len));
+    return stats.finish(ctx_kernel_seal(ctx, nonce,
+        plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out), plaintext_len);
+}
+
+int aesgcmsiv_ctx_decrypt_small_unchecked(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out)
+{
+    StatsScope stats(AESGCMSIV_OP_DECRYPT, ciphertext_len, aad_len, StatsScope::Bounded{});
+    if (!ctx->kernel) {
+        return stats.finish(AESGCMSIV_ERROR_INTERNAL, 0);
+    }
+    const aesgcmsiv_kernel* kernel = ctx_kernel(ctx, ciphertext_len);
+    stats.setup_done(kernel->name, vector_bits(kernel, ciphertext_len));
+    return stats.finish(ctx_kernel_open(ctx, nonce,
+        ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out), ciphertext_len);
+}
+
+int aesgcmsiv_ctx_encryptv(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const aesgcmsiv_iovec* plaintext, size_t plaintext_count,
+    const aesgcmsiv_iovec* aad, size_t aad_count,
+    const aesgcmsiv_iovec_out* ciphertext_out, size_t ciphertext_count,
+    uint8_t* tag_out)
+{
+    StatsScope stats(AESGCMSIV_OP_ENCRYPT, 0, 0);
+    if (!ctx) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    size_t plaintext_len, aad_len;
+    int validation_result = validate_vector_params(
+        nonce, nonce_len, plaintext, plaintext_count, aad, aad_count,
+        ciphertext_out, ciphertext_count, tag_out, &plaintext_len, &aad_len);
+    if (validation_result != AESGCMSIV_SUCCESS) {
+        return stats.finish(validation_result, 0);
+    }
+
+    if (ctx->kernel) {
+        const aesgcmsiv_kernel* kernel = ctx_kernel(ctx, plaintext_len);
+        stats.setup_done(kernel->name, vector_bits(kernel, plaintext_len));
+        return stats.finish(kernel_sealv(kernel, &ctx->key_schedule, nonce, plaintext, plaintext_count,
+            aad, aad_count, ciphertext_out, ciphertext_count, tag_out), plaintext_len);
+    }
+
+    return stats.finish(sealv_gathered(plaintext, plaintext_count, plaintext_len, aad, aad_count, aad_len,
+        ciphertext_out, ciphertext_count,
+        [&](uint8_t* pt, size_t pt_len, const uint8_t* ad, size_t ad_len) {
+            return ctx_encrypt_impl(stats, ctx, nonce, nonce_len, pt, pt_len, ad, ad_len, pt, tag_out);
+        }), plaintext_len);
+}
+
+int aesgcmsiv_ctx_decryptv(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const aesgcmsiv_iovec* ciphertext, size_t ciphertext_count,
+    const aesgcmsiv_iovec* aad, size_t aad_count,
+    const uint8_t* tag,
+    const aesgcmsiv_iovec_out* plaintext_out, size_t plaintext_count)
+{
+    StatsScope stats(AESGCMSIV_OP_DECRYPT, 0, 0);
+    if (!ctx) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    size_t ciphertext_len, aad_len;
+    int validation_result = validate_vector_params(
+        nonce, nonce_len, ciphertext, ciphertext_count, aad, aad_count,
+        plaintext_out, plaintext_count, tag, &ciphertext_len, &aad_len);
+    if (validation_result != AESGCMSIV_SUCCESS) {
+        return stats.finish(validation_result, 0);
+    }
+
+    if (ctx->kernel) {
+        const aesgcmsiv_kernel* kernel = ctx_kernel(ctx, ciphertext_len);
+        stats.setup_done(kernel->name, vector_bits(kernel, ciphertext_len));
+        return stats.finish(kernel_openv(kernel, &ctx->key_schedule, nonce, ciphertext, ciphertext_count,
+            aad, aad_count, tag, plaintext_out, plaintext_count), ciphertext_len);
+    }
+
+    return stats.finish(openv_gathered(ciphertext, ciphertext_count, ciphertext_len, aad, aad_count, aad_len,
+        plaintext_out, plaintext_count,
+        [&](uint8_t* ct, size_t ct_len, const uint8_t* ad, size_t ad_len) {
+            return ctx_decrypt_impl(stats, ctx, nonce, nonce_len, ct, ct_len, ad, ad_len, tag, ct);
+        }), ciphertext_len);
+}
+
+int aesgcmsiv_ctx_set_threads(aesgcmsiv_ctx* ctx, unsigned int threads)
+{
+    if (!ctx) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    ctx->threads.store(threads, std::memory_order_relaxed);
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_ctx_set_streaming(aesgcmsiv_ctx* ctx, size_t min_bytes)
+{
+    if (!ctx) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    ctx->stream_min.store(min_bytes, std::memory_order_relaxed);
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_ctx_set_wide_min(aesgcmsiv_ctx* ctx, size_t min_bytes)
+{
+    if (!ctx) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    ctx->wide_min.store(min_bytes, std::memory_order_relaxed);
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_ctx_set_nonce_cache(aesgcmsiv_ctx* ctx, size_t entries)
+{
+    if (!ctx || entries > AESGCMSIV_NONCE_CACHE_MAX) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    // OpenSSL derives inside the provider, so there is nothing to keep
+    nonce_cache* cache = nullptr;
+    if (entries > 0 && ctx->kernel) {
+        size_t size = 1;
+        while (size < entries) {
+            size <<= 1;
+        }
+        cache = new (std::nothrow) nonce_cache();
+        if (!cache) {
+            return AESGCMSIV_ERROR_INTERNAL;
+        }
+        cache->entries = new (std::nothrow) nonce_cache_entry[size]();
+        if (!cache->entries) {
+            delete cache;
+            return AESGCMSIV_ERROR_INTERNAL;
+        }
+        cache->mask = size - 1;
+    }
+
+    nonce_cache_free(ctx->nonces);
+    ctx->nonces = cache;
+    return AESGCMSIV_SUCCESS;
+}
+
+#ifdef AESGCMSIV_FAULT_INJECTION
+// Allocations with a fault point left before one fails; negative when none will
+static std::atomic<int64_t> fault_alloc_countdown(-1);
+
+int aesgcmsiv_debug_fail_alloc(uint32_t after)
+{
+    fault_alloc_countdown.store(after == UINT32_MAX ? -1 : int64_t(after), std::memory_order_relaxed);
+    return AESGCMSIV_SUCCESS;
+}
+
+// Whether the allocation at this fault point is to fail
+static bool fault_alloc_fails()
+{
+    int64_t left = fault_alloc_countdown.load(std::memory_order_relaxed);
+    while (left >= 0) {
+        if (fault_alloc_countdown.compare_exchange_weak(left, left - 1, std::memory_order_relaxed)) {
+            return left == 0;
+        }
+    }
+    return false;
+}
+#else
+int aesgcmsiv_debug_fail_alloc(uint32_t)
+{
+    return AESGCMSIV_ERROR_NOT_FOUND;
+}
+
+static bool fault_alloc_fails()
+{
+    return false;
+}
+#endif
+
+// The counter block of ctx, allocated the first time; NULL if it cannot be
+static aesgcmsiv_usage_counters* ctx_usage_block(aesgcmsiv_ctx* ctx)
+{
+    aesgcmsiv_usage_counters* counters = ctx->usage_block.load(std::memory_order_acquire);
+    if (!counters) {
+        counters = fault_alloc_fails() ? nullptr : new (std::nothrow) aesgcmsiv_usage_counters();
+        if (!counters) {
+            return nullptr;
+        }
+        aesgcmsiv_usage_counters* first = nullptr;
+        if (!ctx->usage_block.compare_exchange_strong(first, counters, std::memory_order_acq_rel)) {
+            delete counters;
+            counters = first;
+        }
+    }
+    return counters;
+}
+
+// Points ctx's calls at counters, its block, or at none; cannot fail
+static void ctx_switch_usage(aesgcmsiv_ctx* ctx, aesgcmsiv_usage_counters* counters)
+{
+    aesgcmsiv_usage_counters* previous = ctx->usage.exchange(counters, std::memory_order_acq_rel);
+    if (counters && !previous) {
+        aesgcmsiv_usage_contexts.fetch_add(1, std::memory_order_relaxed);
+    } else if (!counters && previous) {
+        aesgcmsiv_usage_contexts.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+int aesgcmsiv_ctx_set_usage_tracking(aesgcmsiv_ctx* ctx, int enabled)
+{
+    if (!ctx) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    aesgcmsiv_usage_counters* counters = nullptr;
+    if (enabled) {
+        counters = ctx_usage_block(ctx);
+        if (!counters) {
+            return AESGCMSIV_ERROR_INTERNAL;
+        }
+    }
+    ctx_switch_usage(ctx, counters);
+    return AESGCMSIV_SUCCESS;
+}
+
+aesgcmsiv_usage_counters* aesgcmsiv_ctx_usage_counters(const aesgcmsiv_ctx* ctx)
+{
+    return ctx->usage.load(std::memory_order_acquire);
+}
+
+int aesgcmsiv_ctx_get_usage(const aesgcmsiv_ctx* ctx, aesgcmsiv_key_usage* usage_out)
+{
+    if (!ctx || !usage_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    usage_out->key_id = 0;
+    aesgcmsiv_usage_read(ctx->usage_block.load(std::memory_order_acquire), usage_out);
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_ctx_set_pool(aesgcmsiv_ctx* ctx, aesgcmsiv_pool* pool)
+{
+    if (!ctx) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    ctx->pool.store(pool, std::memory_order_release);
+    return AESGCMSIV_SUCCESS;
+}
+
+// Default items per pool task when a batch is split. A multiple of the lane
+// count, and enough short messages that a task outweighs the cost of handing
+// it on.
+#define POOL_BATCH_CHUNK (16 * AESGCMSIV_LANES)
+#define POOL_BATCH_MAX_CHUNKS (4 * (AESGCMSIV_POOL_MAX_WORKERS + 1))
+
+static std::atomic<size_t> g_batch_chunk_items(POOL_BATCH_CHUNK);
+
+static unsigned int batch_chunks(aesgcmsiv_pool* pool, size_t count)
+{
+    if (!pool) {
+        return 1;
+    }
+    const size_t per_task = g_batch_chunk_items.load(std::memory_order_relaxed);
+    size_t chunks = (count + per_task - 1) / per_task;
+    size_t most = 4 * static_cast<size_t>(aesgcmsiv_pool_workers(pool) + 1);
+    return static_cast<unsigned int>(std::min(std::max<size_t>(chunks, 1), most));
+}
+
+int aesgcmsiv_set_tuning(const aesgcmsiv_tuning* tuning)
+{
+    const aesgcmsiv_tuning defaults = {};
+    const aesgcmsiv_tuning& t = tuning ? *tuning : defaults;
+    if (t.lane_max_blocks > AESGCMSIV_LANE_MAX_BLOCKS) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    // Whole lane groups, so that splitting a batch never breaks one up
+    size_t chunk = t.batch_chunk_items ? t.batch_chunk_items : POOL_BATCH_CHUNK;
+    chunk = (chunk + AESGCMSIV_LANES - 1) & ~static_cast<size_t>(AESGCMSIV_LANES - 1);
+
+    kernel_parallel_min_bytes.store(
+        t.parallel_min_bytes ? t.parallel_min_bytes : AESGCMSIV_PARALLEL_MIN_BYTES, std::memory_order_relaxed);
+    g_batch_chunk_items.store(chunk, std::memory_order_relaxed);
+    kernel_lane_max_blocks.store(
+        t.lane_max_blocks ? t.lane_max_blocks : AESGCMSIV_LANE_MAX_BLOCKS, std::memory_order_relaxed);
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_get_tuning(aesgcmsiv_tuning* tuning_out)
+{
+    if (!tuning_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    tuning_out->parallel_min_bytes = kernel_parallel_min_bytes.load(std::memory_order_relaxed);
+    tuning_out->batch_chunk_items = g_batch_chunk_items.load(std::memory_order_relaxed);
+    tuning_out->lane_max_blocks = kernel_lane_max_blocks.load(std::memory_order_relaxed);
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_get_caps(aesgcmsiv_caps* caps_out)
+{
+    if (!caps_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    const aesgcmsiv_kernel* kernel = active_kernel();
+    *caps_out = aesgcmsiv_caps{};
+    caps_out->flags = AESGCMSIV_CAPS_KEY_128 | AESGCMSIV_CAPS_KEY_256 | AESGCMSIV_CAPS_IN_PLACE;
+    caps_out->max_input_len = kernel ? AESGCMSIV_MAX_INPUT_SIZE : crypto_max_input_len;
+    caps_out->batch_width = 1;
+    // A cache line, which also covers the widest (AVX-512) loads
+#if defined(__APPLE__) && defined(__aarch64__)
+    caps_out->alignment = 128;
+#else
+    caps_out->alignment = 64;
+#endif
+    caps_out->parallel_max_threads = 1;
+    if (!kernel) {
+        return AESGCMSIV_SUCCESS;
+    }
+
+    caps_out->flags |= AESGCMSIV_CAPS_SMALL | AESGCMSIV_CAPS_PARALLEL;
+    if (kernel->derive_keys_lanes) {
+        caps_out->batch_width = AESGCMSIV_LANES;
+        // Less the length block
+        caps_out->lane_max_bytes = (kernel_lane_max_blocks.load(std::memory_order_relaxed) - 1) * 16;
+    }
+    caps_out->parallel_min_bytes = kernel_parallel_min_bytes.load(std::memory_order_relaxed);
+    caps_out->parallel_max_threads = AESGCMSIV_PARALLEL_MAX_THREADS;
+    return AESGCMSIV_SUCCESS;
+}
+
+struct aesgcmsiv_polyval {
+    polyval_state pv;
+    const aesgcmsiv_kernel* kernel;
+    uint8_t partial[16];
+    size_t partial_len;
+};
+
+int aesgcmsiv_polyval_init(
+    const uint8_t* key, size_t key_len,
+    aesgcmsiv_polyval** state_out)
+{
+    if (!state_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *state_out = nullptr;
+    if (!key || key_len != 16) {
+        return AESGCMSIV_ERROR_INVALID_KEY;
+    }
+    // The default backend is the fastest hand-written kernel, if there is
+    // one; the library and the mock kernel have no real POLYVAL
+    const aesgcmsiv_kernel* kernel = g_registry.backends[0].kernel;
+    if (!kernel) {
+        return AESGCMSIV_ERROR_NOT_FOUND;
+    }
+    aesgcmsiv_polyval* state = aesgcmsiv_secure_new<aesgcmsiv_polyval>();
+    if (!state) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    state->kernel = kernel;
+    // Every power the widest stride uses, since the length is not known
+    kernel->polyval_init(&state->pv, key, SIZE_MAX);
+    *state_out = state;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_polyval_update(aesgcmsiv_polyval* state, const uint8_t* data, size_t len)
+{
+    if (!state || (!data && len)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (state->partial_len) {
+        size_t take = 16 - state->partial_len < len ? 16 - state->partial_len : len;
+        memcpy(state->partial + state->partial_len, data, take);
+        state->partial_len += take;
+        data += take;
+        len -= take;
+        if (state->partial_len < 16) {
+            return AESGCMSIV_SUCCESS;
+        }
+        state->kernel->polyval_blocks(&state->pv, state->partial, 1);
+        state->partial_len = 0;
+    }
+    if (len >= 16) {
+        state->kernel->polyval_blocks(&state->pv, data, len / 16);
+    }
+    memcpy(state->partial, data + (len & ~static_cast<size_t>(15)), len % 16);
+    state->partial_len = len % 16;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_polyval_final(aesgcmsiv_polyval* state, uint8_t* hash_out)
+{
+    if (!state || !hash_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (state->partial_len) {
+        memset(state->partial + state->partial_len, 0, 16 - state->partial_len);
+        state->kernel->polyval_blocks(&state->pv, state->partial, 1);
+    }
+    memcpy(hash_out, state->pv.s, 16);
+    aesgcmsiv_secure_zero(state->pv.s, sizeof(state->pv.s));
+    aesgcmsiv_secure_zero(state->partial, sizeof(state->partial));
+    state->partial_len = 0;
+    return AESGCMSIV_SUCCESS;
+}
+
+void aesgcmsiv_polyval_free(aesgcmsiv_polyval* state)
+{
+    aesgcmsiv_secure_delete(state);
+}
+
+// Runs run(begin, end) over items [0, count), split across pool when the
+// batch is large enough and on the calling thread otherwise. home(i) is the
+// input of item i, for placing each chunk by node. Templates need C++
+// linkage.
+extern "C++" {
+template <typename Home, typename Run>
+static void run_split(aesgcmsiv_pool* pool, uint32_t op, size_t count, Home home, Run run)
+{
+    unsigned int chunks = batch_chunks(pool, count);
+    AESGCMSIV_TRACE3(batch__dispatch, op, count, chunks < 2 ? 1 : chunks);
+    if (chunks < 2) {
+        run(0, count);
+        return;
+    }
+    // Chunks end on lane boundaries, so splitting loses no interleaving
+    size_t per_chunk = (count / chunks + AESGCMSIV_LANES - 1) & ~static_cast<size_t>(AESGCMSIV_LANES - 1);
+    const void* homes[POOL_BATCH_MAX_CHUNKS];
+    for (unsigned int i = 0; i < chunks; i++) {
+        size_t begin = i * per_chunk;
+        homes[i] = begin < count ? home(begin) : nullptr;
+    }
+    aesgcmsiv_pool_for(pool, chunks, [&](unsigned int i) {
+        size_t begin = std::min(count, i * per_chunk);
+        size_t end = i + 1 < chunks ? std::min(count, begin + per_chunk) : count;
+        run(begin, end);
+    }, homes);
+}
+
+// run_split over an array of items
+template <typename Run>
+static void run_batch(
+    aesgcmsiv_pool* pool, uint32_t op, const aesgcmsiv_batch_item* items, size_t count, Run run)
+{
+    run_split(pool, op, count,
+        [items](size_t i) { return static_cast<const void*>(items[i].input); }, run);
+}
+} // extern "C++"
+
+// The nonces of a batch built from a base nonce and a counter rather than
+// read from its items. A NULL base leaves each item to carry its own.
+struct batch_nonces {
+    const uint8_t* base;
+    uint64_t first;
+};
+
+// Nonces and item copies are built this many at a time on the stack
+#define COUNTER_NONCE_CHUNK 64
+
+// Writes the nonces of items [begin, begin + count): the base nonce with
+// its last 8 bytes XORed with the item's counter, little-endian. One 8-byte
+// XOR per nonce, in a loop with no dependency between iterations, which the
+// compiler unrolls and vectorizes.
+static void derive_nonces(
+    const batch_nonces& nonces, size_t begin, size_t count, uint8_t (*out)[AESGCMSIV_NONCE_SIZE])
+{
+    uint64_t tail = 0;
+    for (int i = 0; i < 8; i++) {
+        tail |= static_cast<uint64_t>(nonces.base[4 + i]) << (8 * i);
+    }
+    const uint64_t counter = nonces.first + begin;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t value = tail ^ (counter + i);
+        memcpy(out[i], nonces.base, 4);
+        for (int b = 0; b < 8; b++) {
+            out[i][4 + b] = static_cast<uint8_t>(value >> (8 * b));
+        }
+    }
+}
+
+// The AAD every item of a batch shares, in place of the items' own
+struct batch_aad {
+    const uint8_t* data;
+    size_t len;
+};
+
+// Calls run(chunk, n, first) on copies of items [begin, end), at most
+// COUNTER_NONCE_CHUNK at a time, with each copy's nonce derived when nonces
+// is non-NULL and its AAD replaced when aad is; chunk[0] is item first.
+// Templates need C++ linkage.
+extern "C++" {
+template <typename Run>
+static void with_overrides(
+    const batch_nonces* nonces, const batch_aad* aad, const aesgcmsiv_batch_item* items,
+    size_t begin, size_t end, Run run)
+{
+    uint8_t nonce_bytes[COUNTER_NONCE_CHUNK][AESGCMSIV_NONCE_SIZE];
+    aesgcmsiv_batch_item chunk[COUNTER_NONCE_CHUNK];
+    for (size_t first = begin; first < end; first += COUNTER_NONCE_CHUNK) {
+        size_t n = std::min<size_t>(COUNTER_NONCE_CHUNK, end - first);
+        if (nonces) {
+            derive_nonces(*nonces, first, n, nonce_bytes);
+        }
+        for (size_t i = 0; i < n; i++) {
+            chunk[i] = items[first + i];
+            if (nonces) {
+                chunk[i].nonce = nonce_bytes[i];
+            }
+            if (aad) {
+                chunk[i].aad = aad->data;
+                chunk[i].aad_len = aad->len;
+            }
+        }
+        run(chunk, n, first);
+    }
+}
+} // extern "C++"
+
+// aesgcmsiv_encrypt_batch, with the nonces derived when nonces is non-NULL
+// and every item under the same AAD when aad is
+static int encrypt_batch_impl(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const batch_nonces* nonces,
+    const batch_aad* aad)
+{
+    StatsScope stats(AESGCMSIV_OP_ENCRYPT, StatsScope::Batch{count});
+    if (!ctx || (count > 0 && !items) || (nonces && !nonces->base) || (aad && !aad->data && aad->len > 0)) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    stats.set_key_context(ctx);
+    if (aad) {
+        stats.set_aad_size(aad->len);
+    } else {
+        stats.record_aad(items, count);
+    }
+
+    // Validate first so the kernel is free to regroup the items it is given;
+    // everything before the first invalid item is still encrypted
+    size_t valid = 0;
+    uint64_t valid_bytes = 0;
+    int validation_result = AESGCMSIV_SUCCESS;
+    for (; valid < count; valid++) {
+        const aesgcmsiv_batch_item& item = items[valid];
+        validation_result = validate_encrypt_params(
+            nonces ? nonces->base : item.nonce, AESGCMSIV_NONCE_SIZE, item.input, item.input_len,
+            aad ? aad->len : item.aad_len, item.output, item.tag);
+        if (validation_result != AESGCMSIV_SUCCESS) {
+            break;
+        }
+        valid_bytes += item.input_len;
+    }
+    const uint64_t mean_len = valid ? valid_bytes / valid : 0;
+    const aesgcmsiv_kernel* kernel = ctx->kernel ? ctx_kernel(ctx, mean_len) : nullptr;
+    stats.setup_done(backend_name(kernel), vector_bits(kernel, mean_len));
+    // The invalid item, if any, counts as a call too
+    const size_t calls = valid + (validation_result != AESGCMSIV_SUCCESS);
+
+    if (ctx->kernel) {
+        run_batch(ctx->pool.load(std::memory_order_acquire), AESGCMSIV_OP_ENCRYPT, items, valid,
+            [&](size_t begin, size_t end) {
+                if (!nonces && !aad) {
+                    kernel_seal_batch(kernel, &ctx->key_schedule, items + begin, end - begin);
+                    return;
+                }
+                with_overrides(nonces, aad, items, begin, end,
+                    [&](const aesgcmsiv_batch_item* chunk, size_t n, size_t) {
+                        kernel_seal_batch(kernel, &ctx->key_schedule, chunk, n);
+                    });
+            });
+        return stats.finish_batch(validation_result, calls, valid_bytes);
+    }
+
+    uint64_t bytes = 0;
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    for (size_t i = 0; i < valid; i++) {
+        const aesgcmsiv_batch_item& item = items[i];
+        if (nonces) {
+            derive_nonces(*nonces, i, 1, &nonce);
+        }
+        int result = ctx_encrypt_impl(stats, ctx,
+            nonces ? nonce : item.nonce, AESGCMSIV_NONCE_SIZE,
+            item.input, item.input_len,
+            aad ? aad->data : item.aad, aad ? aad->len : item.aad_len,
+            item.output, item.tag);
+        if (result != AESGCMSIV_SUCCESS) {
+            return stats.finish_batch(result, i + 1, bytes);
+        }
+        bytes += item.input_len;
+    }
+    return stats.finish_batch(validation_result, calls, valid_bytes);
+}
+
+// aesgcmsiv_decrypt_batch, with the nonces derived when nonces is non-NULL
+// and every item under the same AAD when aad is
+static int decrypt_batch_impl(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const batch_nonces* nonces,
+    const batch_aad* aad,
+    int* status_out)
+{
+    StatsScope stats(AESGCMSIV_OP_DECRYPT, StatsScope::Batch{count});
+    if (!ctx || (count > 0 && (!items || !status_out)) || (nonces && !nonces->base) ||
+        (aad && !aad->data && aad->len > 0)) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    stats.set_key_context(ctx);
+    if (aad) {
+        stats.set_aad_size(aad->len);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const aesgcmsiv_batch_item& item = items[i];
+        status_out[i] = validate_decrypt_params(
+            nonces ? nonces->base : item.nonce, AESGCMSIV_NONCE_SIZE, item.input, item.input_len,
+            aad ? aad->len : item.aad_len, item.tag, item.output);
+    }
+    const uint64_t mean_len = batch_mean_len(items, count);
+    const aesgcmsiv_kernel* kernel = ctx->kernel ? ctx_kernel(ctx, mean_len) : nullptr;
+    stats.setup_done(backend_name(kernel), vector_bits(kernel, mean_len));
+
+    if (ctx->kernel) {
+        run_batch(ctx->pool.load(std::memory_order_acquire), AESGCMSIV_OP_DECRYPT, items, count,
+            [&](size_t begin, size_t end) {
+                if (!nonces && !aad) {
+                    kernel_open_batch(kernel, &ctx->key_schedule,
+                        items + begin, end - begin, status_out + begin);
+                    return;
+                }
+                with_overrides(nonces, aad, items, begin, end,
+                    [&](const aesgcmsiv_batch_item* chunk, size_t n, size_t first) {
+                        kernel_open_batch(kernel, &ctx->key_schedule, chunk, n, status_out + first);
+                    });
+            });
+    } else {
+        uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+        for (size_t i = 0; i < count; i++) {
+            if (status_out[i] != AESGCMSIV_SUCCESS) {
+                continue;
+            }
+            const aesgcmsiv_batch_item& item = items[i];
+            if (nonces) {
+                derive_nonces(*nonces, i, 1, &nonce);
+            }
+            status_out[i] = ctx_decrypt_impl(stats, ctx,
+                nonces ? nonce : item.nonce, AESGCMSIV_NONCE_SIZE,
+                item.input, item.input_len,
+                aad ? aad->data : item.aad, aad ? aad->len : item.aad_len,
+                item.tag, item.output);
+        }
+    }
+    stats.finish_items(items, count, status_out);
+
+    for (size_t i = 0; i < count; i++) {
+        if (status_out[i] != AESGCMSIV_SUCCESS) {
+            return status_out[i];
+        }
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_encrypt_batch(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    const aesgcmsiv_batch_item* items)
+{
+    return encrypt_batch_impl(ctx, count, items, nullptr, nullptr);
+}
+
+int aesgcmsiv_decrypt_batch(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    int* status_out)
+{
+    return decrypt_batch_impl(ctx, count, items, nullptr, nullptr, status_out);
+}
+
+int aesgcmsiv_verify_batch(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    int* status_out)
+{
+    StatsScope stats(AESGCMSIV_OP_DECRYPT, StatsScope::Batch{count});
+    if (!ctx || (count > 0 && (!items || !status_out))) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const aesgcmsiv_batch_item& item = items[i];
+        status_out[i] = validate_verify_params(
+            item.nonce, AESGCMSIV_NONCE_SIZE, item.input, item.input_len, item.aad_len, item.tag);
+    }
+    // Each message picks its own width in ctx_kernel_verify
+    const uint64_t mean_len = batch_mean_len(items, count);
+    const aesgcmsiv_kernel* kernel = ctx->kernel ? ctx_kernel(ctx, mean_len) : nullptr;
+    stats.setup_done(backend_name(kernel), vector_bits(kernel, mean_len));
+
+    if (ctx->kernel) {
+        run_batch(ctx->pool.load(std::memory_order_acquire), AESGCMSIV_OP_DECRYPT, items, count,
+            [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    if (status_out[i] == AESGCMSIV_SUCCESS) {
+                        const aesgcmsiv_batch_item& item = items[i];
+                        status_out[i] = ctx_kernel_verify(ctx, item.nonce,
+                            item.input, item.input_len, item.aad, item.aad_len, item.tag);
+                    }
+                }
+            });
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            if (status_out[i] != AESGCMSIV_SUCCESS) {
+                continue;
+            }
+            const aesgcmsiv_batch_item& item = items[i];
+            status_out[i] = ctx_verify_validated(stats, ctx, item.nonce,
+                item.input, item.input_len, item.aad, item.aad_len, item.tag);
+        }
+    }
+    stats.finish_items(items, count, status_out);
+
+    for (size_t i = 0; i < count; i++) {
+        if (status_out[i] != AESGCMSIV_SUCCESS) {
+            return status_out[i];
+        }
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_encrypt_batch_counter(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const uint8_t* base_nonce,
+    uint64_t first_counter)
+{
+    const batch_nonces nonces = {base_nonce, first_counter};
+    return encrypt_batch_impl(ctx, count, items, &nonces, nullptr);
+}
+
+int aesgcmsiv_decrypt_batch_counter(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const uint8_t* base_nonce,
+    uint64_t first_counter,
+    int* status_out)
+{
+    const batch_nonces nonces = {base_nonce, first_counter};
+    return decrypt_batch_impl(ctx, count, items, &nonces, nullptr, status_out);
+}
+
+int aesgcmsiv_encrypt_batch_shared_aad(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const uint8_t* aad,
+    size_t aad_len)
+{
+    const batch_aad shared = {aad, aad_len};
+    return encrypt_batch_impl(ctx, count, items, nullptr, &shared);
+}
+
+int aesgcmsiv_decrypt_batch_shared_aad(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const uint8_t* aad,
+    size_t aad_len,
+    int* status_out)
+{
+    const batch_aad shared = {aad, aad_len};
+    return decrypt_batch_impl(ctx, count, items, nullptr, &shared, status_out);
+}
+
+// The pages of aesgcmsiv_encrypt_pages and aesgcmsiv_decrypt_pages
+struct page_array {
+    uint8_t* base;
+    size_t page_size;
+    size_t aad_len;  // header bytes at the start of each page
+    uint8_t* tags;  // AESGCMSIV_TAG_SIZE bytes per page
+};
+
+static bool pages_valid(
+    const aesgcmsiv_ctx* ctx, const uint8_t* base_nonce, const page_array& pages, size_t count)
+{
+    if (!ctx || !base_nonce || pages.aad_len > pages.page_size || exceeds_max_input(pages.page_size)) {
+        return false;
+    }
+    if (count == 0) {
+        return true;
+    }
+    return pages.base && pages.tags && pages.page_size > 0 && count <= SIZE_MAX / pages.page_size;
+}
+
+// Page i as a batch item: its header is the AAD and its body is encrypted
+// in place
+static aesgcmsiv_batch_item page_item(const page_array& pages, size_t i, const uint8_t* nonce)
+{
+    uint8_t* page = pages.base + i * pages.page_size;
+    aesgcmsiv_batch_item item;
+    item.nonce = nonce;
+    item.input = page + pages.aad_len;
+    item.input_len = pages.page_size - pages.aad_len;
+    item.aad = page;
+    item.aad_len = pages.aad_len;
+    item.output = page + pages.aad_len;
+    item.tag = pages.tags + i * AESGCMSIV_TAG_SIZE;
+    return item;
+}
+
+// Calls run(chunk, n, first) on items [begin, end) built by item(i, nonce),
+// at most COUNTER_NONCE_CHUNK at a time; chunk[0] is item first. For
+// layouts that describe their messages without an item array. nonce is
+// NULL when nonces has no base. Templates need C++ linkage.
+extern "C++" {
+template <typename Item, typename Run>
+static void with_built_items(
+    const batch_nonces& nonces, size_t begin, size_t end, const Item& item, Run run)
+{
+    uint8_t nonce_bytes[COUNTER_NONCE_CHUNK][AESGCMSIV_NONCE_SIZE];
+    aesgcmsiv_batch_item chunk[COUNTER_NONCE_CHUNK];
+    for (size_t first = begin; first < end; first += COUNTER_NONCE_CHUNK) {
+        size_t n = std::min<size_t>(COUNTER_NONCE_CHUNK, end - first);
+        if (nonces.base) {
+            derive_nonces(nonces, first, n, nonce_bytes);
+        }
+        for (size_t i = 0; i < n; i++) {
+            chunk[i] = item(first + i, nonces.base ? nonce_bytes[i] : nullptr);
+        }
+        run(chunk, n, first);
+    }
+}
+
+// Encrypts count built items whose inputs total bytes, on the context's
+// pool if it has one. The arguments are already validated.
+template <typename Item>
+static int encrypt_built(
+    StatsScope& stats, aesgcmsiv_ctx* ctx, const batch_nonces& nonces, size_t count, const Item& item,
+    uint64_t bytes)
+{
+    stats.set_key_context(ctx);
+    const uint64_t mean_len = count ? bytes / count : 0;
+    const aesgcmsiv_kernel* kernel = ctx->kernel ? ctx_kernel(ctx, mean_len) : nullptr;
+    stats.setup_done(backend_name(kernel), vector_bits(kernel, mean_len));
+    if (ctx->kernel) {
+        run_split(ctx->pool.load(std::memory_order_acquire), AESGCMSIV_OP_ENCRYPT, count,
+            [&](size_t i) { return static_cast<const void*>(item(i, nullptr).input); },
+            [&](size_t begin, size_t end) {
+                with_built_items(nonces, begin, end, item,
+                    [&](const aesgcmsiv_batch_item* chunk, size_t n, size_t) {
+                        kernel_seal_batch(kernel, &ctx->key_schedule, chunk, n);
+                    });
+            });
+        return stats.finish_batch(AESGCMSIV_SUCCESS, count, bytes);
+    }
+
+    uint64_t done = 0;
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    for (size_t i = 0; i < count; i++) {
+        if (nonces.base) {
+            derive_nonces(nonces, i, 1, &nonce);
+        }
+        const aesgcmsiv_batch_item built = item(i, nonces.base ? nonce : nullptr);
+        int result = ctx_encrypt_impl(stats, ctx, built.nonce, AESGCMSIV_NONCE_SIZE,
+            built.input, built.input_len, built.aad, built.aad_len, built.output, built.tag);
+        if (result != AESGCMSIV_SUCCESS) {
+            return stats.finish_batch(result, i + 1, done);
+        }
+        done += built.input_len;
+    }
+    return stats.finish_batch(AESGCMSIV_SUCCESS, count, bytes);
+}
+
+// encrypt_built for decryption, with one result per item in status_out
+template <typename Item>
+static int decrypt_built(
+    StatsScope& stats, aesgcmsiv_ctx* ctx, const batch_nonces& nonces, size_t count, const Item& item,
+    int* status_out)
+{
+    stats.set_key_context(ctx);
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < count; i++) {
+        status_out[i] = AESGCMSIV_SUCCESS;
+        bytes += item(i, nullptr).input_len;
+    }
+    const uint64_t mean_len = count ? bytes / count : 0;
+    const aesgcmsiv_kernel* kernel = ctx->kernel ? ctx_kernel(ctx, mean_len) : nullptr;
+    stats.setup_done(backend_name(kernel), vector_bits(kernel, mean_len));
+
+    if (ctx->kernel) {
+        run_split(ctx->pool.load(std::memory_order_acquire), AESGCMSIV_OP_DECRYPT, count,
+            [&](size_t i) { return static_cast<const void*>(item(i, nullptr).input); },
+            [&](size_t begin, size_t end) {
+                with_built_items(nonces, begin, end, item,
+                    [&](const aesgcmsiv_batch_item* chunk, size_t n, size_t first) {
+                        kernel_open_batch(kernel, &ctx->key_schedule, chunk, n, status_out + first);
+                    });
+            });
+    } else {
+        uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+        for (size_t i = 0; i < count; i++) {
+            if (nonces.base) {
+                derive_nonces(nonces, i, 1, &nonce);
+            }
+            const aesgcmsiv_batch_item built = item(i, nonces.base ? nonce : nullptr);
+            status_out[i] = ctx_decrypt_impl(stats, ctx, built.nonce, AESGCMSIV_NONCE_SIZE,
+                built.input, built.input_len, built.aad, built.aad_len, built.tag, built.output);
+        }
+    }
+    stats.finish_each(count, status_out, [&](size_t i) { return item(i, nullptr).input_len; });
+
+    for (size_t i = 0; i < count; i++) {
+        if (status_out[i] != AESGCMSIV_SUCCESS) {
+            return status_out[i];
+        }
+    }
+    return AESGCMSIV_SUCCESS;
+}
+} // extern "C++"
+
+int aesgcmsiv_encrypt_pages(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* base_nonce,
+    uint8_t* base,
+    size_t page_size,
+    size_t count,
+    uint64_t first_page_no,
+    size_t aad_len,
+    uint8_t* tags_out)
+{
+    StatsScope stats(AESGCMSIV_OP_ENCRYPT, StatsScope::Batch{count});
+    const page_array pages = {base, page_size, aad_len, tags_out};
+    if (!pages_valid(ctx, base_nonce, pages, count)) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    const batch_nonces nonces = {base_nonce, first_page_no};
+    return encrypt_built(stats, ctx, nonces, count,
+        [&pages](size_t i, const uint8_t* nonce) { return page_item(pages, i, nonce); },
+        static_cast<uint64_t>(count) * (page_size - aad_len));
+}
+
+int aesgcmsiv_decrypt_pages(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* base_nonce,
+    uint8_t* base,
+    size_t page_size,
+    size_t count,
+    uint64_t first_page_no,
+    size_t aad_len,
+    const uint8_t* tags,
+    int* status_out)
+{
+    StatsScope stats(AESGCMSIV_OP_DECRYPT, StatsScope::Batch{count});
+    // Tags are only read; the item that carries them is shared with encryption
+    const page_array pages = {base, page_size, aad_len, const_cast<uint8_t*>(tags)};
+    if (!pages_valid(ctx, base_nonce, pages, count) || (count > 0 && !status_out)) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    const batch_nonces nonces = {base_nonce, first_page_no};
+    return decrypt_built(stats, ctx, nonces, count,
+        [&pages](size_t i, const uint8_t* nonce) { return page_item(pages, i, nonce); }, status_out);
+}
+
+// The values of aesgcmsiv_encrypt_column and aesgcmsiv_decrypt_column
+struct column_array {
+    const uint8_t* values;
+    const void* offsets;  // count + 1 entries
+    size_t offset_size;  // 4 or 8
+    uint8_t* values_out;
+    uint8_t* tags;  // AESGCMSIV_TAG_SIZE bytes per value
+    int64_t out_base;  // offset written at the start of values_out
+    bool tags_appended;  // each tag follows its ciphertext; tags unused
+};
+
+static int64_t column_offset(const column_array& column, size_t i)
+{
+    return column.offset_size == 4
+        ? static_cast<const int32_t*>(column.offsets)[i]
+        : static_cast<const int64_t*>(column.offsets)[i];
+}
+
+// Offsets must start at or above 0 and never decrease. Stores the total
+// length of the values in bytes_out.
+static bool column_valid(
+    const aesgcmsiv_ctx* ctx, const uint8_t* base_nonce, const column_array& column, size_t count,
+    uint64_t* bytes_out)
+{
+    if (!ctx || !base_nonce || !column.offsets || (column.offset_size != 4 && column.offset_size != 8)) {
+        return false;
+    }
+    if (count > 0 && (!column.values || !column.values_out || (!column.tags && !column.tags_appended))) {
+        return false;
+    }
+    int64_t previous = column_offset(column, 0);
+    if (previous < 0) {
+        return false;
+    }
+    for (size_t i = 1; i <= count; i++) {
+        int64_t offset = column_offset(column, i);
+        if (offset < previous || exceeds_max_input(static_cast<uint64_t>(offset - previous))) {
+            return false;
+        }
+        previous = offset;
+    }
+    *bytes_out = static_cast<uint64_t>(previous - column_offset(column, 0));
+    return true;
+}
+
+// Value i as a batch item, written at the same offset of the output less
+// out_base, moved on past the tags of the values before it when they are
+// appended
+static aesgcmsiv_batch_item column_item(const column_array& column, size_t i, const uint8_t* nonce)
+{
+    const int64_t begin = column_offset(column, i);
+    aesgcmsiv_batch_item item;
+    item.nonce = nonce;
+    item.input = column.values + begin;
+    item.input_len = static_cast<size_t>(column_offset(column, i + 1) - begin);
+    item.aad = nullptr;
+    item.aad_len = 0;
+    item.output = column.values_out + (begin - column.out_base);
+    if (column.tags_appended) {
+        item.output += i * AESGCMSIV_TAG_SIZE;
+        item.tag = item.output + item.input_len;
+    } else {
+        item.tag = column.tags + i * AESGCMSIV_TAG_SIZE;
+    }
+    return item;
+}
+
+int aesgcmsiv_encrypt_column(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* base_nonce,
+    uint64_t first_row,
+    size_t count,
+    const uint8_t* values,
+    const void* offsets,
+    size_t offset_size,
+    uint8_t* values_out,
+    uint8_t* tags_out)
+{
+    StatsScope stats(AESGCMSIV_OP_ENCRYPT, StatsScope::Batch{count});
+    const column_array column = {values, offsets, offset_size, values_out, tags_out, 0, false};
+    uint64_t bytes;
+    if (!column_valid(ctx, base_nonce, column, count, &bytes)) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    const batch_nonces nonces = {base_nonce, first_row};
+    return encrypt_built(stats, ctx, nonces, count,
+        [&column](size_t i, const uint8_t* nonce) { return column_item(column, i, nonce); }, bytes);
+}
+
+int aesgcmsiv_column_encrypt_packed(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* base_nonce,
+    uint64_t first_row,
+    size_t count,
+    const uint8_t* values,
+    const void* offsets,
+    size_t offset_size,
+    bool tags_appended,
+    uint8_t* values_out,
+    uint8_t* tags_out)
+{
+    StatsScope stats(AESGCMSIV_OP_ENCRYPT, StatsScope::Batch{count});
+    column_array column = {values, offsets, offset_size, values_out, tags_out, 0, tags_appended};
+    uint64_t bytes;
+    if (!column_valid(ctx, base_nonce, column, count, &bytes)) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    column.out_base = column_offset(column, 0);
+    const batch_nonces nonces = {base_nonce, first_row};
+    return encrypt_built(stats, ctx, nonces, count,
+        [&column](size_t i, const uint8_t* nonce) { return column_item(column, i, nonce); }, bytes);
+}
+
+int aesgcmsiv_decrypt_column(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* base_nonce,
+    uint64_t first_row,
+    size_t count,
+    const uint8_t* values,
+    const void* offsets,
+    size_t offset_size,
+    const uint8_t* tags,
+    uint8_t* values_out,
+    int* status_out)
+{
+    StatsScope stats(AESGCMSIV_OP_DECRYPT, StatsScope::Batch{count});
+    const column_array column = {values, offsets, offset_size, values_out, const_cast<uint8_t*>(tags), 0, false};
+    uint64_t bytes;
+    if (!column_valid(ctx, base_nonce, column, count, &bytes) || (count > 0 && !status_out)) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    const batch_nonces nonces = {base_nonce, first_row};
+    return decrypt_built(stats, ctx, nonces, count,
+        [&column](size_t i, const uint8_t* nonce) { return column_item(column, i, nonce); }, status_out);
+}
+
+// Plaintext bytes a re-encryption keeps on the stack; larger plaintexts,
+// and batch chunks that need more, use the heap
+#define REENCRYPT_STACK_BYTES 4096
+
+// Scratch memory for the plaintext between a record's decryption and its
+// re-encryption. Reused across the records of one call or batch chunk,
+// cleansed after each, and freed when it goes out of scope.
+class ReencryptScratch {
+public:
+    ReencryptScratch() = default;
+    ReencryptScratch(const ReencryptScratch&) = delete;
+    ReencryptScratch& operator=(const ReencryptScratch&) = delete;
+
+    ~ReencryptScratch()
+    {
+        release();
+    }
+
+    // len bytes, or NULL if they cannot be allocated
+    uint8_t* get(size_t len)
+    {
+        if (len <= sizeof(stack_)) {
+            return stack_;
+        }
+        if (len > heap_len_) {
+            release();
+            heap_ = static_cast<uint8_t*>(aesgcmsiv_block_alloc(len));
+            heap_len_ = heap_ ? len : 0;
+        }
+        return heap_;
+    }
+
+private:
+    void release()
+    {
+        if (heap_) {
+            OPENSSL_cleanse(heap_, heap_len_);
+            aesgcmsiv_block_free(heap_, heap_len_);
+            heap_ = nullptr;
+            heap_len_ = 0;
+        }
+    }
+
+    uint8_t stack_[REENCRYPT_STACK_BYTES];
+    uint8_t* heap_ = nullptr;
+    size_t heap_len_ = 0;
+};
+
+// Decrypts one record into scratch and encrypts it from there. The output
+// and tag_out are written only once the record has verified.
+static int reencrypt_one(
+    StatsScope& stats, aesgcmsiv_ctx* old_ctx, aesgcmsiv_ctx* new_ctx,
+    const uint8_t* nonce, const uint8_t* new_nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag, uint8_t* ciphertext_out, uint8_t* tag_out,
+    ReencryptScratch& scratch)
+{
+    uint8_t* plaintext = scratch.get(ciphertext_len);
+    if (!plaintext) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    int result = ctx_decrypt_impl(stats, old_ctx, nonce, AESGCMSIV_NONCE_SIZE,
+        ciphertext, ciphertext_len, aad, aad_len, tag, plaintext);
+    if (result == AESGCMSIV_SUCCESS) {
+        // tag_out may be tag, which is no longer needed once this is written
+        uint8_t new_tag[AESGCMSIV_TAG_SIZE];
+        result = ctx_encrypt_impl(stats, new_ctx, new_nonce, AESGCMSIV_NONCE_SIZE,
+            plaintext, ciphertext_len, aad, aad_len, ciphertext_out, new_tag);
+        if (result == AESGCMSIV_SUCCESS) {
+            memcpy(tag_out, new_tag, AESGCMSIV_TAG_SIZE);
+        }
+    }
+    OPENSSL_cleanse(plaintext, ciphertext_len);
+    return result;
+}
+
+int aesgcmsiv_reencrypt(
+    aesgcmsiv_ctx* old_ctx,
+    aesgcmsiv_ctx* new_ctx,
+    const uint8_t* nonce,
+    const uint8_t* new_nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out)
+{
+    StatsScope stats(AESGCMSIV_OP_DECRYPT, ciphertext_len, aad_len);
+    if (!old_ctx || !new_ctx || !tag_out) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    ReencryptScratch scratch;
+    int result = reencrypt_one(stats, old_ctx, new_ctx, nonce, new_nonce ? new_nonce : nonce,
+        ciphertext, ciphertext_len, aad, aad_len, tag, ciphertext_out, tag_out, scratch);
+    return stats.finish(result, ciphertext_len);
+}
+
+// Re-encrypts items [begin, end) on the kernel, as many at a time as fit in
+// the scratch: the whole group is opened into scratch through the
+// multi-buffer lanes, and the items that verified are sealed from there.
+static void reencrypt_kernel_chunk(
+    aesgcmsiv_ctx* old_ctx, aesgcmsiv_ctx* new_ctx,
+    const aesgcmsiv_batch_item* items, const uint8_t* new_nonces, size_t begin, size_t end,
+    int* status_out)
+{
+    ReencryptScratch scratch;
+    aesgcmsiv_batch_item open[COUNTER_NONCE_CHUNK];
+    aesgcmsiv_batch_item seal[COUNTER_NONCE_CHUNK];
+    uint8_t tags[COUNTER_NONCE_CHUNK][AESGCMSIV_TAG_SIZE];
+    for (size_t first = begin; first < end;) {
+        // At least one item, however long
+        size_t n = 0;
+        size_t bytes = 0;
+        while (first + n < end && n < COUNTER_NONCE_CHUNK &&
+               (n == 0 || bytes + items[first + n].input_len <= REENCRYPT_STACK_BYTES)) {
+            bytes += items[first + n].input_len;
+            n++;
+        }
+        uint8_t* arena = scratch.get(bytes);
+        if (!arena) {
+            for (size_t i = 0; i < n; i++) {
+                if (status_out[first + i] == AESGCMSIV_SUCCESS) {
+                    status_out[first + i] = AESGCMSIV_ERROR_INTERNAL;
+                }
+            }
+            first += n;
+            continue;
+        }
+
+        size_t offset = 0;
+        for (size_t i = 0; i < n; i++) {
+            open[i] = items[first + i];
+            open[i].output = arena + offset;
+            offset += open[i].input_len;
+        }
+        kernel_open_batch(old_ctx->kernel, &old_ctx->key_schedule, open, n, status_out + first);
+
+        size_t verified = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (status_out[first + i] != AESGCMSIV_SUCCESS) {
+                continue;
+            }
+            aesgcmsiv_batch_item& item = seal[verified++];
+            item = items[first + i];
+            item.nonce = new_nonces ? new_nonces + (first + i) * AESGCMSIV_NONCE_SIZE : item.nonce;
+            item.input = open[i].output;
+            item.tag = tags[i];
+        }
+        kernel_seal_batch(new_ctx->kernel, &new_ctx->key_schedule, seal, verified);
+        for (size_t i = 0; i < n; i++) {
+            if (status_out[first + i] == AESGCMSIV_SUCCESS) {
+                memcpy(items[first + i].tag, tags[i], AESGCMSIV_TAG_SIZE);
+            }
+        }
+        OPENSSL_cleanse(arena, bytes);
+        first += n;
+    }
+}
+
+int aesgcmsiv_reencrypt_batch(
+    aesgcmsiv_ctx* old_ctx,
+    aesgcmsiv_ctx* new_ctx,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const uint8_t* new_nonces,
+    int* status_out)
+{
+    StatsScope stats(AESGCMSIV_OP_DECRYPT, StatsScope::Batch{count});
+    if (!old_ctx || !new_ctx || (count > 0 && (!items || !status_out))) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    stats.set_key_context(old_ctx);
+
+    for (size_t i = 0; i < count; i++) {
+        const aesgcmsiv_batch_item& item = items[i];
+        status_out[i] = validate_decrypt_params(
+            item.nonce, AESGCMSIV_NONCE_SIZE, item.input, item.input_len, item.aad_len,
+            item.tag, item.output);
+    }
+    stats.setup_done(backend_name(old_ctx->kernel), vector_bits(old_ctx->kernel, batch_mean_len(items, count)));
+
+    // Both keys must run on the same kernel for the lanes to take them
+    if (old_ctx->kernel && old_ctx->kernel == new_ctx->kernel) {
+        run_batch(old_ctx->pool.load(std::memory_order_acquire), AESGCMSIV_OP_DECRYPT, items, count,
+            [&](size_t begin, size_t end) {
+                reencrypt_kernel_chunk(old_ctx, new_ctx, items, new_nonces, begin, end, status_out);
+            });
+    } else {
+        ReencryptScratch scratch;
+        for (size_t i = 0; i < count; i++) {
+            if (status_out[i] != AESGCMSIV_SUCCESS) {
+                continue;
+            }
+            const aesgcmsiv_batch_item& item = items[i];
+            status_out[i] = reencrypt_one(stats, old_ctx, new_ctx,
+                item.nonce, new_nonces ? new_nonces + i * AESGCMSIV_NONCE_SIZE : item.nonce,
+                item.input, item.input_len, item.aad, item.aad_len,
+                item.tag, item.output, item.tag, scratch);
+        }
+    }
+    stats.finish_items(items, count, status_out);
+
+    for (size_t i = 0; i < count; i++) {
+        if (status_out[i] != AESGCMSIV_SUCCESS) {
+            return status_out[i];
+        }
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+// Keys expanded per call of kernel_seal_multikey, so the schedules stay on
+// the stack however many recipients there are
+#define MULTIKEY_KEYS 32
+
+int aesgcmsiv_encrypt_multikey(
+    size_t count,
+    const uint8_t* keys, size_t key_len,
+    const uint8_t* nonces,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* const* ciphertexts_out,
+    uint8_t* tags_out)
+{
+    StatsScope stats(AESGCMSIV_OP_ENCRYPT, StatsScope::Batch{count});
+    if (count == 0) {
+        return stats.finish_batch(AESGCMSIV_SUCCESS, 0, 0);
+    }
+    int validation_result = validate_key(keys, key_len);
+    if (validation_result == AESGCMSIV_SUCCESS && (!ciphertexts_out || !tags_out)) {
+        validation_result = AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    for (size_t i = 0; validation_result == AESGCMSIV_SUCCESS && i < count; i++) {
+        validation_result = validate_encrypt_params(
+            nonces ? nonces + i * AESGCMSIV_NONCE_SIZE : nullptr, AESGCMSIV_NONCE_SIZE,
+            plaintext, plaintext_len, aad_len, ciphertexts_out[i], tags_out);
+        // Every output but an in-place one would be overwritten by the
+        // next recipient's, so none may share the plaintext
+        if (validation_result == AESGCMSIV_SUCCESS && plaintext_len > 0 &&
+            ciphertexts_out[i] < plaintext + plaintext_len && plaintext < ciphertexts_out[i] + plaintext_len) {
+            validation_result = AESGCMSIV_ERROR_INVALID_INPUT;
+        }
+    }
+    if (validation_result != AESGCMSIV_SUCCESS) {
+        return stats.finish_batch(validation_result, count, 0);
+    }
+
+    const aesgcmsiv_kernel* kernel = active_kernel();
+    stats.setup_done(backend_name(kernel), vector_bits(kernel, plaintext_len));
+    if (!kernel) {
+        for (size_t i = 0; i < count; i++) {
+            int result = encrypt_impl(stats, keys + i * key_len, key_len,
+                nonces + i * AESGCMSIV_NONCE_SIZE, AESGCMSIV_NONCE_SIZE,
+                plaintext, plaintext_len, aad, aad_len,
+                ciphertexts_out[i], tags_out + i * AESGCMSIV_TAG_SIZE);
+            if (result != AESGCMSIV_SUCCESS) {
+                return stats.finish_batch(result, i + 1, i * static_cast<uint64_t>(plaintext_len));
+            }
+        }
+        return stats.finish_batch(AESGCMSIV_SUCCESS, count, count * static_cast<uint64_t>(plaintext_len));
+    }
+
+    aes_key_schedule schedules[MULTIKEY_KEYS];
+    for (size_t first = 0; first < count; first += MULTIKEY_KEYS) {
+        size_t n = count - first < MULTIKEY_KEYS ? count - first : MULTIKEY_KEYS;
+        for (size_t i = 0; i < n; i++) {
+            kernel->expand_key(keys + (first + i) * key_len, key_len, &schedules[i]);
+        }
+        kernel_seal_multikey(kernel, schedules, nonces + first * AESGCMSIV_NONCE_SIZE, n,
+            plaintext, plaintext_len, aad, aad_len,
+            ciphertexts_out + first, tags_out + first * AESGCMSIV_TAG_SIZE);
+    }
+    aesgcmsiv_secure_zero(schedules, (count < MULTIKEY_KEYS ? count : MULTIKEY_KEYS) * sizeof(schedules[0]));
+    return stats.finish_batch(AESGCMSIV_SUCCESS, count, count * static_cast<uint64_t>(plaintext_len));
+}
+
+// With a kernel every slot's schedule sits in one array, each starting on a
+// cache line, and an empty slot has rounds 0; a shared table's array is in
+// memory that processes forked later map too. Without a kernel, a set slot
+// holds an OpenSSL-backed context.
+struct aesgcmsiv_key_table {
+    const aesgcmsiv_kernel* kernel;
+    size_t slots;
+    aes_key_schedule* schedules;
+    aesgcmsiv_ctx** contexts;
+    std::atomic<aesgcmsiv_pool*> pool;  // see aesgcmsiv_key_table_set_pool
+    aesgcmsiv_shared_mem shared;  // holds the schedules of a shared table
+    bool sealed;  // see aesgcmsiv_key_table_seal
+};
+
+#define KEY_TABLE_ALIGNMENT 64
+
+static_assert(sizeof(aes_key_schedule) % KEY_TABLE_ALIGNMENT == 0,
+    "key table slots must each start on a cache line");
+
+static bool key_slot_set(const aesgcmsiv_key_table* table, uint32_t slot)
+{
+    if (slot >= table->slots) {
+        return false;
+    }
+    return table->kernel ? table->schedules[slot].rounds != 0 : table->contexts[slot] != nullptr;
+}
+
+static int key_table_new_impl(size_t slots, bool shared, aesgcmsiv_key_table** table_out)
+{
+    if (!table_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *table_out = nullptr;
+    if (slots == 0 || slots > UINT32_MAX || slots > SIZE_MAX / sizeof(aes_key_schedule)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    aesgcmsiv_key_table* table = new (std::nothrow) aesgcmsiv_key_table();
+    if (!table) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    table->kernel = active_kernel();
+    table->slots = slots;
+    table->shared.fd = -1;
+    if (table->kernel && shared) {
+        // Mapped zeroed and page-aligned
+        if (aesgcmsiv_shared_map(slots * sizeof(aes_key_schedule), &table->shared)) {
+            table->schedules = static_cast<aes_key_schedule*>(table->shared.data);
+        }
+    } else if (table->kernel) {
+        const size_t bytes = slots * sizeof(aes_key_schedule);
+        table->schedules = static_cast<aes_key_schedule*>(
+            ::operator new(bytes, std::align_val_t(KEY_TABLE_ALIGNMENT), std::nothrow));
+        if (table->schedules) {
+            memset(table->schedules, 0, bytes);
+        }
+    } else {
+        table->contexts = new (std::nothrow) aesgcmsiv_ctx*[slots]();
+    }
+    if (!table->schedules && !table->contexts) {
+        delete table;
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    *table_out = table;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_key_table_new(size_t slots, aesgcmsiv_key_table** table_out)
+{
+    return key_table_new_impl(slots, false, table_out);
+}
+
+int aesgcmsiv_key_table_new_shared(size_t slots, aesgcmsiv_key_table** table_out)
+{
+#if defined(_WIN32)
+    // No fork to share with
+    return key_table_new_impl(slots, false, table_out);
+#else
+    return key_table_new_impl(slots, true, table_out);
+#endif
+}
+
+int aesgcmsiv_key_table_seal(aesgcmsiv_key_table* table)
+{
+    if (!table) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (table->sealed) {
+        return AESGCMSIV_SUCCESS;
+    }
+    table->sealed = true;
+    if (!table->shared.data) {
+        return AESGCMSIV_SUCCESS;
+    }
+    const bool sealed = aesgcmsiv_shared_seal(&table->shared);
+    table->schedules = static_cast<aes_key_schedule*>(table->shared.data);
+    if (!table->schedules) {
+        // Lost along with the mapping; every slot now reads as empty
+        table->slots = 0;
+    }
+    return sealed ? AESGCMSIV_SUCCESS : AESGCMSIV_ERROR_INTERNAL;
+}
+
+int aesgcmsiv_key_table_set(
+    aesgcmsiv_key_table* table, size_t slot,
+    const uint8_t* key, size_t key_len)
+{
+    if (!table || slot >= table->slots || table->sealed) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    int validation_result = validate_key(key, key_len);
+    if (validation_result != AESGCMSIV_SUCCESS) {
+        return validation_result;
+    }
+
+    if (table->kernel) {
+        // An AES-128 schedule leaves the last round keys of an AES-256 one
+        OPENSSL_cleanse(&table->schedules[slot], sizeof(aes_key_schedule));
+        table->kernel->expand_key(key, key_len, &table->schedules[slot]);
+        return AESGCMSIV_SUCCESS;
+    }
+    aesgcmsiv_ctx* ctx;
+    int result = aesgcmsiv_ctx_new(key, key_len, &ctx);
+    if (result != AESGCMSIV_SUCCESS) {
+        return result;
+    }
+    aesgcmsiv_ctx_free(table->contexts[slot]);
+    table->contexts[slot] = ctx;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_key_table_clear(aesgcmsiv_key_table* table, size_t slot)
+{
+    if (!table || slot >= table->slots || table->sealed) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (table->kernel) {
+        OPENSSL_cleanse(&table->schedules[slot], sizeof(aes_key_schedule));
+    } else {
+        aesgcmsiv_ctx_free(table->contexts[slot]);
+        table->contexts[slot] = nullptr;
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_key_table_set_pool(aesgcmsiv_key_table* table, aesgcmsiv_pool* pool)
+{
+    if (!table) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    table->pool.store(pool, std::memory_order_release);
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_key_table_encrypt_batch(
+    aesgcmsiv_key_table* table,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const uint32_t* slots)
+{
+    StatsScope stats(AESGCMSIV_OP_ENCRYPT, StatsScope::Batch{count});
+    if (!table || (count > 0 && (!items || !slots))) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+
+    // As in aesgcmsiv_encrypt_batch, with an unusable slot counting as an
+    // invalid item
+    size_t valid = 0;
+    uint64_t valid_bytes = 0;
+    int validation_result = AESGCMSIV_SUCCESS;
+    for (; valid < count; valid++) {
+        const aesgcmsiv_batch_item& item = items[valid];
+        validation_result = key_slot_set(table, slots[valid])
+            ? validate_encrypt_params(
+                item.nonce, AESGCMSIV_NONCE_SIZE, item.input, item.input_len, item.aad_len,
+                item.output, item.tag)
+            : AESGCMSIV_ERROR_INVALID_KEY;
+        if (validation_result != AESGCMSIV_SUCCESS) {
+            break;
+        }
+        valid_bytes += item.input_len;
+    }
+    stats.setup_done(backend_name(table->kernel), vector_bits(table->kernel, batch_mean_len(items, count)));
+    const size_t calls = valid + (validation_result != AESGCMSIV_SUCCESS);
+
+    if (table->kernel) {
+        run_batch(table->pool.load(std::memory_order_acquire), AESGCMSIV_OP_ENCRYPT, items, valid,
+            [&](size_t begin, size_t end) {
+                kernel_seal_batch_keyed(table->kernel, table->schedules, slots + begin,
+                    items + begin, end - begin);
+            });
+        return stats.finish_batch(validation_result, calls, valid_bytes);
+    }
+
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < valid; i++) {
+        const aesgcmsiv_batch_item& item = items[i];
+        int result = ctx_encrypt_impl(stats, table->contexts[slots[i]],
+            item.nonce, AESGCMSIV_NONCE_SIZE,
+            item.input, item.input_len,
+            item.aad, item.aad_len,
+            item.output, item.tag);
+        if (result != AESGCMSIV_SUCCESS) {
+            return stats.finish_batch(result, i + 1, bytes);
+        }
+        bytes += item.input_len;
+    }
+    return stats.finish_batch(validation_result, calls, valid_bytes);
+}
+
+int aesgcmsiv_key_table_decrypt_batch(
+    aesgcmsiv_key_table* table,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const uint32_t* slots,
+    int* status_out)
+{
+    StatsScope stats(AESGCMSIV_OP_DECRYPT, StatsScope::Batch{count});
+    if (!table || (count > 0 && (!items || !slots || !status_out))) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const aesgcmsiv_batch_item& item = items[i];
+        status_out[i] = key_slot_set(table, slots[i])
+            ? validate_decrypt_params(
+                item.nonce, AESGCMSIV_NONCE_SIZE, item.input, item.input_len, item.aad_len,
+                item.tag, item.output)
+            : AESGCMSIV_ERROR_INVALID_KEY;
+    }
+    stats.setup_done(backend_name(table->kernel), vector_bits(table->kernel, batch_mean_len(items, count)));
+
+    if (table->kernel) {
+        run_batch(table->pool.load(std::memory_order_acquire), AESGCMSIV_OP_DECRYPT, items, count,
+            [&](size_t begin, size_t end) {
+                kernel_open_batch_keyed(table->kernel, table->schedules, slots + begin,
+                    items + begin, end - begin, status_out + begin);
+            });
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            if (status_out[i] != AESGCMSIV_SUCCESS) {
+                continue;
+            }
+            const aesgcmsiv_batch_item& item = items[i];
+            status_out[i] = ctx_decrypt_impl(stats, table->contexts[slots[i]],
+                item.nonce, AESGCMSIV_NONCE_SIZE,
+                item.input, item.input_len,
+                item.aad, item.aad_len,
+                item.tag, item.output);
+        }
+    }
+    stats.finish_items(items, count, status_out);
+
+    for (size_t i = 0; i < count; i++) {
+        if (status_out[i] != AESGCMSIV_SUCCESS) {
+            return status_out[i];
+        }
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+void aesgcmsiv_key_table_free(aesgcmsiv_key_table* table)
+{
+    if (!table) {
+        return;
+    }
+    if (table->shared.data) {
+        aesgcmsiv_shared_unmap(&table->shared);
+    } else if (table->schedules) {
+        OPENSSL_cleanse(table->schedules, table->slots * sizeof(aes_key_schedule));
+        ::operator delete(table->schedules, std::align_val_t(KEY_TABLE_ALIGNMENT));
+    }
+    if (table->contexts) {
+        for (size_t i = 0; i < table->slots; i++) {
+            aesgcmsiv_ctx_free(table->contexts[i]);
+        }
+        delete[] table->contexts;
+    }
+    delete table;
+}
+
+struct registered_buffer {
+    uint8_t* data;  // NULL while unregistered
+    size_t len;
+};
+
+struct aesgcmsiv_buffers {
+    size_t count;
+    registered_buffer* entries;
+};
+
+int aesgcmsiv_buffers_new(size_t count, aesgcmsiv_buffers** buffers_out)
+{
+    if (!buffers_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *buffers_out = nullptr;
+    if (count == 0 || count > UINT32_MAX) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    aesgcmsiv_buffers* buffers = new (std::nothrow) aesgcmsiv_buffers();
+    if (!buffers) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    buffers->count = count;
+    buffers->entries = new (std::nothrow) registered_buffer[count]();
+    if (!buffers->entries) {
+        delete buffers;
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    *buffers_out = buffers;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_buffers_register(
+    aesgcmsiv_buffers* buffers, size_t index,
+    uint8_t* data, size_t len)
+{
+    if (!buffers || index >= buffers->count || !data) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    buffers->entries[index] = {data, len};
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_buffers_unregister(aesgcmsiv_buffers* buffers, size_t index)
+{
+    if (!buffers || index >= buffers->count) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    buffers->entries[index] = {nullptr, 0};
+    return AESGCMSIV_SUCCESS;
+}
+
+// The len bytes at offset in registered buffer index, or NULL if they are
+// not all within it
+static uint8_t* registered_range(
+    const aesgcmsiv_buffers* buffers, uint32_t index, uint64_t offset, uint64_t len)
+{
+    if (index >= buffers->count) {
+        return nullptr;
+    }
+    const registered_buffer& buffer = buffers->entries[index];
+    if (!buffer.data || offset > buffer.len || len > buffer.len - offset) {
+        return nullptr;
+    }
+    return buffer.data + offset;
+}
+
+// Item i of a registered batch with its ranges resolved to pointers. The
+// tag is read from the input buffer when decrypting and written to the
+// output buffer when encrypting. Any range outside its buffer comes back
+// NULL.
+static aesgcmsiv_batch_item registered_item(
+    const aesgcmsiv_buffers* buffers, const aesgcmsiv_registered_item& item, bool decrypt)
+{
+    aesgcmsiv_batch_item built;
+    built.nonce = registered_range(buffers, item.input_buffer, item.nonce_offset, AESGCMSIV_NONCE_SIZE);
+    built.input = registered_range(buffers, item.input_buffer, item.input_offset, item.input_len);
+    built.input_len = static_cast<size_t>(item.input_len);
+    built.aad = item.aad_len > 0
+        ? registered_range(buffers, item.input_buffer, item.aad_offset, item.aad_len)
+        : nullptr;
+    built.aad_len = static_cast<size_t>(item.aad_len);
+    built.output = registered_range(buffers, item.output_buffer, item.output_offset, item.input_len);
+    built.tag = registered_range(buffers, decrypt ? item.input_buffer : item.output_buffer,
+        item.tag_offset, AESGCMSIV_TAG_SIZE);
+    return built;
+}
+
+// Whether every range of every item lies within its registered buffer.
+// Stores the total input length in bytes_out.
+static bool registered_valid(
+    const aesgcmsiv_ctx* ctx, const aesgcmsiv_buffers* buffers, size_t count,
+    const aesgcmsiv_registered_item* items, bool decrypt, uint64_t* bytes_out)
+{
+    if (!ctx || !buffers || (count > 0 && !items)) {
+        return false;
+    }
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (exceeds_max_input(items[i].input_len) || exceeds_max_input(items[i].aad_len)) {
+            return false;
+        }
+        const aesgcmsiv_batch_item built = registered_item(buffers, items[i], decrypt);
+        if (!built.nonce || !built.input || !built.output || !built.tag || (built.aad_len > 0 && !built.aad)) {
+            return false;
+        }
+        bytes += items[i].input_len;
+    }
+    *bytes_out = bytes;
+    return true;
+}
+
+int aesgcmsiv_encrypt_registered(
+    aesgcmsiv_ctx* ctx,
+    const aesgcmsiv_buffers* buffers,
+    size_t count,
+    const aesgcmsiv_registered_item* items)
+{
+    StatsScope stats(AESGCMSIV_OP_ENCRYPT, StatsScope::Batch{count});
+    uint64_t bytes;
+    if (!registered_valid(ctx, buffers, count, items, false, &bytes)) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    const batch_nonces nonces = {nullptr, 0};
+    return encrypt_built(stats, ctx, nonces, count,
+        [buffers, items](size_t i, const uint8_t*) { return registered_item(buffers, items[i], false); },
+        bytes);
+}
+
+int aesgcmsiv_decrypt_registered(
+    aesgcmsiv_ctx* ctx,
+    const aesgcmsiv_buffers* buffers,
+    size_t count,
+    const aesgcmsiv_registered_item* items,
+    int* status_out)
+{
+    StatsScope stats(AESGCMSIV_OP_DECRYPT, StatsScope::Batch{count});
+    uint64_t bytes;
+    if (!registered_valid(ctx, buffers, count, items, true, &bytes) || (count > 0 && !status_out)) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    const batch_nonces nonces = {nullptr, 0};
+    return decrypt_built(stats, ctx, nonces, count,
+        [buffers, items](size_t i, const uint8_t*) { return registered_item(buffers, items[i], true); },
+        status_out);
+}
+
+void aesgcmsiv_buffers_free(aesgcmsiv_buffers* buffers)
+{
+    if (!buffers) {
+        return;
+    }
+    delete[] buffers->entries;
+    delete buffers;
+}
+
+// With a kernel the nonce never changes, so its derived keys are kept in
+// place of the key-generating key. OpenSSL derives per call and gets an
+// ordinary context.
+struct aesgcmsiv_wrap_ctx {
+    const aesgcmsiv_kernel* kernel;  // NULL when using OpenSSL
+    alignas(16) uint8_t auth_key[16];
+    aes_key_schedule enc_ks;
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    aesgcmsiv_ctx* base;  // OpenSSL path only
+};
+
+int aesgcmsiv_wrap_ctx_new(
+    const uint8_t* key, size_t key_len,
+    const uint8_t* nonce, size_t nonce_len,
+    aesgcmsiv_wrap_ctx** ctx_out)
+{
+    if (!ctx_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *ctx_out = nullptr;
+
+    int validation_result = validate_key(key, key_len);
+    if (validation_result != AESGCMSIV_SUCCESS) {
+        return validation_result;
+    }
+    if (!nonce || nonce_len != AESGCMSIV_NONCE_SIZE) {
+        return AESGCMSIV_ERROR_INVALID_NONCE;
+    }
+
+    aesgcmsiv_wrap_ctx* ctx = aesgcmsiv_secure_new<aesgcmsiv_wrap_ctx>();
+    if (!ctx) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    memcpy(ctx->nonce, nonce, AESGCMSIV_NONCE_SIZE);
+
+    if (const aesgcmsiv_kernel* kernel = active_kernel()) {
+        ctx->kernel = kernel;
+        aes_key_schedule ks;
+        kernel->expand_key(key, key_len, &ks);
+        kernel->derive_keys(&ks, ctx->nonce, ctx->auth_key, &ctx->enc_ks);
+        OPENSSL_cleanse(&ks, sizeof(ks));
+    } else {
+        int result = aesgcmsiv_ctx_new(key, key_len, &ctx->base);
+        if (result != AESGCMSIV_SUCCESS) {
+            aesgcmsiv_wrap_ctx_free(ctx);
+            return result;
+        }
+    }
+
+    *ctx_out = ctx;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_wrap(
+    aesgcmsiv_wrap_ctx* ctx,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out)
+{
+    StatsScope stats(AESGCMSIV_OP_ENCRYPT, plaintext_len, aad_len);
+    if (!ctx) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, plaintext_len);
+    }
+    if (!ctx->kernel) {
+        return stats.finish(ctx_encrypt_impl(stats, ctx->base, ctx->nonce, AESGCMSIV_NONCE_SIZE,
+            plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out), plaintext_len);
+    }
+
+    int validation_result = validate_encrypt_params(
+        ctx->nonce, AESGCMSIV_NONCE_SIZE, plaintext, plaintext_len, aad_len, ciphertext_out, tag_out);
+    if (validation_result != AESGCMSIV_SUCCESS) {
+        return stats.finish(validation_result, plaintext_len);
+    }
+    stats.setup_done(ctx->kernel->name, vector_bits(ctx->kernel, plaintext_len));
+    return stats.finish(kernel_seal_derived(ctx->kernel, ctx->auth_key, &ctx->enc_ks, ctx->nonce,
+        plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out), plaintext_len);
+}
+
+int aesgcmsiv_unwrap(
+    aesgcmsiv_wrap_ctx* ctx,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out)
+{
+    StatsScope stats(AESGCMSIV_OP_DECRYPT, ciphertext_len, aad_len);
+    if (!ctx) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, ciphertext_len);
+    }
+    if (!ctx->kernel) {
+        return stats.finish(ctx_decrypt_impl(stats, ctx->base, ctx->nonce, AESGCMSIV_NONCE_SIZE,
+            ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out), ciphertext_len);
+    }
+
+    int validation_result = validate_decrypt_params(
+        ctx->nonce, AESGCMSIV_NONCE_SIZE, ciphertext, ciphertext_len, aad_len, tag, plaintext_out);
+    if (validation_result != AESGCMSIV_SUCCESS) {
+        return stats.finish(validation_result, ciphertext_len);
+    }
+    stats.setup_done(ctx->kernel->name, vector_bits(ctx->kernel, ciphertext_len));
+    return stats.finish(kernel_open_derived(ctx->kernel, ctx->auth_key, &ctx->enc_ks, ctx->nonce,
+        ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out), ciphertext_len);
+}
+
+void aesgcmsiv_wrap_ctx_free(aesgcmsiv_wrap_ctx* ctx)
+{
+    if (!ctx) {
+        return;
+    }
+    aesgcmsiv_ctx_free(ctx->base);
+    aesgcmsiv_secure_delete(ctx);
+}
+
+#define STREAM_VERSION 1
+#define STREAM_VERSION_COMPRESSED 2
+#define STREAM_PREFIX_SIZE 7
+#define STREAM_FRAME_LAST 0x80000000u
+
+struct aesgcmsiv_stream {
+    aesgcmsiv_ctx* ctx;  // borrowed
+    uint32_t chunk_size;
+    bool decrypt;
+    bool done;  // the last chunk was processed, or one failed to open
+    uint64_t next_chunk;  // up to 2^32, which is the end
+    uint8_t prefix[STREAM_PREFIX_SIZE];
+    aesgcmsiv_codec* codec;  // compressed streams only
+    uint8_t* scratch;  // method byte and chunk_size bytes, from aesgcmsiv_alloc; compressed streams only
+};
+
+// Takes ownership of codec, which makes the stream a compressed one
+static int stream_new(
+    aesgcmsiv_ctx* ctx, uint32_t chunk_size, const uint8_t* prefix, bool decrypt,
+    aesgcmsiv_codec* codec, aesgcmsiv_stream** stream_out)
+{
+    aesgcmsiv_stream* stream = new (std::nothrow) aesgcmsiv_stream();
+    if (!stream) {
+        aesgcmsiv_codec_free(codec);
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    stream->ctx = ctx;
+    stream->chunk_size = chunk_size;
+    stream->decrypt = decrypt;
+    memcpy(stream->prefix, prefix, STREAM_PREFIX_SIZE);
+    stream->codec = codec;
+    if (codec) {
+        // Mapped rather than taken from the heap, so it starts on a page;
+        // chunks of 2 MB and more also get huge pages where there are any
+        const size_t scratch_size = size_t(chunk_size) + 1;
+        stream->scratch = static_cast<uint8_t*>(aesgcmsiv_alloc(
+            scratch_size, scratch_size >= (size_t(2) << 20) ? AESGCMSIV_ALLOC_HUGE_PAGES : 0));
+        if (!stream->scratch) {
+            aesgcmsiv_stream_free(stream);
+            return AESGCMSIV_ERROR_INTERNAL;
+        }
+    }
+    *stream_out = stream;
+    return AESGCMSIV_SUCCESS;
+}
+
+// Writes a header and starts a stream sealing under a fresh random prefix
+static int stream_seal_new(
+    aesgcmsiv_ctx* ctx, uint32_t chunk_size, uint8_t version, aesgcmsiv_codec* codec,
+    uint8_t* header_out, aesgcmsiv_stream** stream_out)
+{
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    int result = aesgcmsiv_random_nonce(nonce);
+    if (result != AESGCMSIV_SUCCESS) {
+        aesgcmsiv_codec_free(codec);
+        return result;
+    }
+    header_out[0] = version;
+    for (int i = 0; i < 4; i++) {
+        header_out[1 + i] = static_cast<uint8_t>(chunk_size >> (8 * i));
+    }
+    memcpy(header_out + 5, nonce, STREAM_PREFIX_SIZE);
+    return stream_new(ctx, chunk_size, nonce, false, codec, stream_out);
+}
+
+int aesgcmsiv_stream_seal_new(
+    aesgcmsiv_ctx* ctx,
+    uint32_t chunk_size,
+    uint8_t* header_out,
+    aesgcmsiv_stream** stream_out)
+{
+    if (!stream_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *stream_out = nullptr;
+    if (!ctx || !header_out || chunk_size == 0 || chunk_size > AESGCMSIV_STREAM_MAX_CHUNK_SIZE) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    return stream_seal_new(ctx, chunk_size, STREAM_VERSION, nullptr, header_out, stream_out);
+}
+
+int aesgcmsiv_compression_supported(uint32_t method)
+{
+    return aesgcmsiv_codec_supported(method) ? 1 : 0;
+}
+
+int aesgcmsiv_stream_seal_new_compressed(
+    aesgcmsiv_ctx* ctx,
+    uint32_t chunk_size,
+    uint32_t method,
+    int level,
+    uint8_t* header_out,
+    aesgcmsiv_stream** stream_out)
+{
+    if (!stream_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *stream_out = nullptr;
+    if (!ctx || !header_out || chunk_size == 0 || chunk_size > AESGCMSIV_STREAM_MAX_CHUNK_SIZE ||
+        !aesgcmsiv_codec_supported(method)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    aesgcmsiv_codec* codec = aesgcmsiv_codec_new(method, level, false);
+    if (!codec) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    return stream_seal_new(ctx, chunk_size, STREAM_VERSION_COMPRESSED, codec, header_out, stream_out);
+}
+
+int aesgcmsiv_stream_open_new(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* header,
+    aesgcmsiv_stream** stream_out)
+{
+    if (!stream_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *stream_out = nullptr;
+    if (!ctx || !header || (header[0] != STREAM_VERSION && header[0] != STREAM_VERSION_COMPRESSED)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    uint32_t chunk_size = 0;
+    for (int i = 0; i < 4; i++) {
+        chunk_size |= static_cast<uint32_t>(header[1 + i]) << (8 * i);
+    }
+    if (chunk_size == 0 || chunk_size > AESGCMSIV_STREAM_MAX_CHUNK_SIZE) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    aesgcmsiv_codec* codec = nullptr;
+    if (header[0] == STREAM_VERSION_COMPRESSED) {
+        // Each record names its own method, so one codec opens them all
+        codec = aesgcmsiv_codec_new(AESGCMSIV_COMPRESS_NONE, 0, true);
+        if (!codec) {
+            return AESGCMSIV_ERROR_INTERNAL;
+        }
+    }
+    return stream_new(ctx, chunk_size, header + 5, true, codec, stream_out);
+}
+
+uint32_t aesgcmsiv_stream_chunk_size(const aesgcmsiv_stream* stream)
+{
+    return stream ? stream->chunk_size : 0;
+}
+
+// Checks that a chunk of plaintext length len may be the last one, or if
+// not, a full one
+static bool stream_chunk_len_valid(const aesgcmsiv_stream* stream, size_t len, int last)
+{
+    return last ? len <= stream->chunk_size : len == stream->chunk_size;
+}
+
+// Checks that chunk index may exist and builds its nonce
+static int stream_index_nonce(
+    const aesgcmsiv_stream* stream, uint64_t index, int last, uint8_t nonce[AESGCMSIV_NONCE_SIZE])
+{
+    // The last chunk may take the final number, but nothing may follow it
+    if (index > UINT32_MAX || (!last && index == UINT32_MAX)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    memcpy(nonce, stream->prefix, STREAM_PREFIX_SIZE);
+    const uint32_t number = static_cast<uint32_t>(index);
+    for (int i = 0; i < 4; i++) {
+        nonce[STREAM_PREFIX_SIZE + i] = static_cast<uint8_t>(number >> (24 - 8 * i));
+    }
+    nonce[11] = last ? 1 : 0;
+    return AESGCMSIV_SUCCESS;
+}
+
+// Checks that chunk index, of plaintext length len, may exist and builds its
+// nonce
+static int stream_chunk_nonce(
+    const aesgcmsiv_stream* stream, uint64_t index, size_t len, int last,
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE])
+{
+    if (!stream_chunk_len_valid(stream, len, last)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    return stream_index_nonce(stream, index, last, nonce);
+}
+
+// stream_chunk_nonce for the chunk that comes next in order
+static int stream_next_nonce(
+    const aesgcmsiv_stream* stream, bool decrypt, size_t len, int last,
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE])
+{
+    if (!stream || stream->decrypt != decrypt || stream->done || stream->codec) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    return stream_chunk_nonce(stream, stream->next_chunk, len, last, nonce);
+}
+
+// The nonce of the next record of a compressed stream, whose length the
+// caller checks
+static int stream_next_record_nonce(
+    const aesgcmsiv_stream* stream, bool decrypt, int last, uint8_t nonce[AESGCMSIV_NONCE_SIZE])
+{
+    if (!stream || stream->decrypt != decrypt || stream->done || !stream->codec) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    return stream_index_nonce(stream, stream->next_chunk, last, nonce);
+}
+
+int aesgcmsiv_stream_seal(
+    aesgcmsiv_stream* stream,
+    const uint8_t* chunk, size_t chunk_len,
+    const uint8_t* aad, size_t aad_len,
+    int last,
+    uint8_t* sealed_out)
+{
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    int result = stream_next_nonce(stream, false, chunk_len, last, nonce);
+    if (result != AESGCMSIV_SUCCESS) {
+        return result;
+    }
+    if (!sealed_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    result = aesgcmsiv_ctx_encrypt(stream->ctx, nonce, AESGCMSIV_NONCE_SIZE,
+        chunk, chunk_len, aad, aad_len, sealed_out, sealed_out + chunk_len);
+    if (result == AESGCMSIV_SUCCESS) {
+        stream->next_chunk++;
+        stream->done = last != 0;
+    }
+    return result;
+}
+
+int aesgcmsiv_stream_open(
+    aesgcmsiv_stream* stream,
+    const uint8_t* sealed, size_t sealed_len,
+    const uint8_t* aad, size_t aad_len,
+    int last,
+    uint8_t* chunk_out)
+{
+    if (sealed_len < AESGCMSIV_TAG_SIZE || !sealed) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    const size_t chunk_len = sealed_len - AESGCMSIV_TAG_SIZE;
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    int result = stream_next_nonce(stream, true, chunk_len, last, nonce);
+    if (result != AESGCMSIV_SUCCESS) {
+        return result;
+    }
+    result = aesgcmsiv_ctx_decrypt(stream->ctx, nonce, AESGCMSIV_NONCE_SIZE,
+        sealed, chunk_len, aad, aad_len, sealed + chunk_len, chunk_out);
+    if (result == AESGCMSIV_SUCCESS) {
+        stream->next_chunk++;
+        stream->done = last != 0;
+    } else if (result == AESGCMSIV_ERROR_DECRYPT_FAILED) {
+        stream->done = true;
+    }
+    return result;
+}
+
+int aesgcmsiv_stream_seal_chunk(
+    const aesgcmsiv_stream* stream,
+    uint64_t index,
+    const uint8_t* chunk, size_t chunk_len,
+    const uint8_t* aad, size_t aad_len,
+    int last,
+    uint8_t* sealed_out)
+{
+    if (!stream || stream->decrypt || stream->codec || !sealed_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    int result = stream_chunk_nonce(stream, index, chunk_len, last, nonce);
+    if (result != AESGCMSIV_SUCCESS) {
+        return result;
+    }
+    return aesgcmsiv_ctx_encrypt(stream->ctx, nonce, AESGCMSIV_NONCE_SIZE,
+        chunk, chunk_len, aad, aad_len, sealed_out, sealed_out + chunk_len);
+}
+
+int aesgcmsiv_stream_open_chunk(
+    const aesgcmsiv_stream* stream,
+    uint64_t index,
+    const uint8_t* sealed, size_t sealed_len,
+    const uint8_t* aad, size_t aad_len,
+    int last,
+    uint8_t* chunk_out)
+{
+    if (!stream || !stream->decrypt || stream->codec || sealed_len < AESGCMSIV_TAG_SIZE || !sealed) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    const size_t chunk_len = sealed_len - AESGCMSIV_TAG_SIZE;
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    int result = stream_chunk_nonce(stream, index, chunk_len, last, nonce);
+    if (result != AESGCMSIV_SUCCESS) {
+        return result;
+    }
+    return aesgcmsiv_ctx_decrypt(stream->ctx, nonce, AESGCMSIV_NONCE_SIZE,
+        sealed, chunk_len, aad, aad_len, sealed + chunk_len, chunk_out);
+}
+
+int aesgcmsiv_stream_verify_chunks(
+    const aesgcmsiv_stream* stream,
+    uint64_t first, size_t count,
+    const uint8_t* sealed, size_t sealed_len,
+    const uint8_t* aad, size_t aad_len,
+    int last,
+    int* status_out)
+{
+    if (!stream || !stream->decrypt || stream->codec || count == 0 || !sealed || !status_out ||
+        (!aad && aad_len)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    // Every chunk but a last one is full, and a last one holds at least a tag
+    const size_t full = stream->chunk_size + static_cast<size_t>(AESGCMSIV_TAG_SIZE);
+    if (count > SIZE_MAX / full || first > UINT32_MAX - (count - 1) ||
+        (last ? sealed_len > count * full || sealed_len < (count - 1) * full + AESGCMSIV_TAG_SIZE
+              : sealed_len != count * full)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    int first_failure = AESGCMSIV_SUCCESS;
+    for (size_t begin = 0; begin < count; begin += COUNTER_NONCE_CHUNK) {
+        const size_t n = std::min<size_t>(COUNTER_NONCE_CHUNK, count - begin);
+        aesgcmsiv_batch_item items[COUNTER_NONCE_CHUNK];
+        uint8_t nonces[COUNTER_NONCE_CHUNK][AESGCMSIV_NONCE_SIZE];
+        for (size_t j = 0; j < n; j++) {
+            const size_t i = begin + j;
+            const bool final_chunk = last && i == count - 1;
+            const size_t chunk_len = (final_chunk ? sealed_len - i * full : full) - AESGCMSIV_TAG_SIZE;
+            int result = stream_chunk_nonce(stream, first + i, chunk_len, final_chunk, nonces[j]);
+            if (result != AESGCMSIV_SUCCESS) {
+                return result;
+            }
+            items[j] = {nonces[j], sealed + i * full, chunk_len, aad, aad_len, nullptr,
+                const_cast<uint8_t*>(sealed + i * full + chunk_len)};
+        }
+        int result = aesgcmsiv_verify_batch(stream->ctx, n, items, status_out + begin);
+        if (first_failure == AESGCMSIV_SUCCESS) {
+            first_failure = result;
+        }
+    }
+    return first_failure;
+}
+
+int aesgcmsiv_stream_seal_compressed(
+    aesgcmsiv_stream* stream,
+    const uint8_t* chunk, size_t chunk_len,
+    const uint8_t* aad, size_t aad_len,
+    int last,
+    uint8_t* record_out,
+    size_t* record_len_out)
+{
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    int result = stream_next_record_nonce(stream, false, last, nonce);
+    if (result != AESGCMSIV_SUCCESS) {
+        return result;
+    }
+    if (!stream_chunk_len_valid(stream, chunk_len, last) || (!chunk && chunk_len > 0) ||
+        !record_out || !record_len_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    // The method byte, then the compressed chunk if that came out shorter
+    // than the chunk itself, or else the chunk as it is
+    uint8_t* body = stream->scratch;
+    size_t payload_len = chunk_len > 1
+        ? aesgcmsiv_codec_compress(stream->codec, chunk, chunk_len, body + 1, chunk_len - 1)
+        : 0;
+    if (payload_len > 0) {
+        body[0] = static_cast<uint8_t>(aesgcmsiv_codec_method(stream->codec));
+    } else {
+        body[0] = AESGCMSIV_COMPRESS_NONE;
+        if (chunk_len > 0) {
+            memcpy(body + 1, chunk, chunk_len);
+        }
+        payload_len = chunk_len;
+    }
+    const size_t body_len = 1 + payload_len;
+    uint8_t* sealed = record_out + AESGCMSIV_STREAM_FRAME_SIZE;
+    result = aesgcmsiv_ctx_encrypt(stream->ctx, nonce, AESGCMSIV_NONCE_SIZE,
+        body, body_len, aad, aad_len, sealed, sealed + body_len);
+    OPENSSL_cleanse(body, body_len);
+    if (result != AESGCMSIV_SUCCESS) {
+        return result;
+    }
+
+    const uint32_t frame = static_cast<uint32_t>(body_len + AESGCMSIV_TAG_SIZE) | (last ? STREAM_FRAME_LAST : 0);
+    for (int i = 0; i < 4; i++) {
+        record_out[i] = static_cast<uint8_t>(frame >> (8 * i));
+    }
+    *record_len_out = AESGCMSIV_STREAM_FRAME_SIZE + body_len + AESGCMSIV_TAG_SIZE;
+    stream->next_chunk++;
+    stream->done = last != 0;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_stream_open_compressed(
+    aesgcmsiv_stream* stream,
+    const uint8_t* record, size_t record_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* chunk_out,
+    size_t* chunk_len_out,
+    int* last_out)
+{
+    if (!record || record_len < AESGCMSIV_STREAM_FRAME_SIZE || !chunk_out || !chunk_len_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    uint32_t frame = 0;
+    for (int i = 0; i < 4; i++) {
+        frame |= static_cast<uint32_t>(record[i]) << (8 * i);
+    }
+    const int last = (frame & STREAM_FRAME_LAST) ? 1 : 0;
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    int result = stream_next_record_nonce(stream, true, last, nonce);
+    if (result != AESGCMSIV_SUCCESS) {
+        return result;
+    }
+    // At least the method byte, and never more than it and a stored chunk
+    const size_t sealed_len = frame & ~STREAM_FRAME_LAST;
+    if (sealed_len != record_len - AESGCMSIV_STREAM_FRAME_SIZE || sealed_len < AESGCMSIV_TAG_SIZE + 1 ||
+        sealed_len - AESGCMSIV_TAG_SIZE > size_t(stream->chunk_size) + 1) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    const uint8_t* sealed = record + AESGCMSIV_STREAM_FRAME_SIZE;
+    const size_t body_len = sealed_len - AESGCMSIV_TAG_SIZE;
+    uint8_t* body = stream->scratch;
+    result = aesgcmsiv_ctx_decrypt(stream->ctx, nonce, AESGCMSIV_NONCE_SIZE,
+        sealed, body_len, aad, aad_len, sealed + body_len, body);
+    size_t chunk_len = 0;
+    if (result == AESGCMSIV_SUCCESS) {
+        if (body[0] == AESGCMSIV_COMPRESS_NONE) {
+            chunk_len = body_len - 1;
+            if (chunk_len <= stream->chunk_size && chunk_len > 0) {
+                memcpy(chunk_out, body + 1, chunk_len);
+            }
+        } else if (!aesgcmsiv_codec_decompress(stream->codec, body[0], body + 1, body_len - 1,
+                       chunk_out, stream->chunk_size, &chunk_len)) {
+            result = AESGCMSIV_ERROR_INVALID_INPUT;
+        }
+        // A verified record can only be malformed if its writer was faulty,
+        // but a short chunk before the end would still shift what follows
+        if (result == AESGCMSIV_SUCCESS && !stream_chunk_len_valid(stream, chunk_len, last)) {
+            result = AESGCMSIV_ERROR_INVALID_INPUT;
+        }
+    }
+    OPENSSL_cleanse(body, body_len);
+    if (result != AESGCMSIV_SUCCESS) {
+        if (result == AESGCMSIV_ERROR_DECRYPT_FAILED || result == AESGCMSIV_ERROR_INVALID_INPUT) {
+            OPENSSL_cleanse(chunk_out, stream->chunk_size);
+            stream->done = true;
+        }
+        return result;
+    }
+
+    *chunk_len_out = chunk_len;
+    if (last_out) {
+        *last_out = last;
+    }
+    stream->next_chunk++;
+    stream->done = last != 0;
+    return AESGCMSIV_SUCCESS;
+}
+
+void aesgcmsiv_stream_free(aesgcmsiv_stream* stream)
+{
+    if (!stream) {
+        return;
+    }
+    if (stream->scratch) {
+        OPENSSL_cleanse(stream->scratch, size_t(stream->chunk_size) + 1);
+        aesgcmsiv_free(stream->scratch);
+    }
+    aesgcmsiv_codec_free(stream->codec);
+    OPENSSL_cleanse(stream, sizeof(*stream));
+    delete stream;
+}
+
+// A queued request and when it was submitted, for the lane's wait times
+struct engine_entry {
+    aesgcmsiv_request request;
+    uint64_t submitted_ns;
+};
+
+struct engine_lane {
+    BoundedRing<engine_entry> ring;
+    std::atomic<size_t> queued;  // submitted, not yet taken by a worker
+    std::atomic<uint64_t> submitted;
+    std::atomic<uint64_t> started;
+    std::atomic<uint64_t> max_depth;
+    std::atomic<uint64_t> wait_ns;
+    std::atomic<uint64_t> max_wait_ns;
+};
+
+// The rings never block. A thread that finds nothing to do parks on a
+// condition variable after advertising itself in a counter; the other side
+// only takes the mutex to wake it when that counter says someone is parked,
+// so the common path stays lock-free.
+struct aesgcmsiv_engine {
+    engine_lane lanes[AESGCMSIV_ENGINE_LANES];
+    BoundedRing<aesgcmsiv_completion> completions;
+    size_t depth;
+    std::atomic<size_t> outstanding;  // submitted, not yet reaped; bounded by depth
+    std::atomic<size_t> queued;  // submitted to any lane, not yet taken by a worker
+    std::atomic<bool> stopping;
+    std::atomic<unsigned int> parked_workers;
+    std::atomic<bool> reaper_parked;
+    std::atomic<uint64_t> preemptions;
+    std::atomic<uint64_t> linger_ns;  // 0 to dispatch at once
+    std::atomic<size_t> batch_target;
+    std::atomic<bool> blocking;  // submit waits for room instead of failing
+    std::atomic<unsigned int> blocked_submitters;
+    std::mutex park_mutex;
+    std::condition_variable work_ready;
+    std::condition_variable completion_ready;
+    std::condition_variable room_ready;
+    std::thread workers[ENGINE_MAX_WORKERS];
+    unsigned int worker_count;
+    // Event-loop handle from aesgcmsiv_engine_get_notify_handle. raised is
+    // set while it is signaled, so workers signal it once per empty ring.
+    std::atomic<bool> notify_on;
+    std::atomic<bool> notify_raised;
+    aesgcmsiv_notify notify;
+};
+
+// What a worker drains from a lane in one pass
+struct engine_drain {
+    engine_entry entries[ENGINE_DRAIN_MAX];
+    aesgcmsiv_batch_item items[ENGINE_DRAIN_MAX];
+    int status[ENGINE_DRAIN_MAX];
+};
+
+static void store_max(std::atomic<uint64_t>& counter, uint64_t value)
+{
+    uint64_t seen = counter.load(std::memory_order_relaxed);
+    while (seen < value && !counter.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+    }
+}
+
+static void wake_workers(aesgcmsiv_engine* engine, bool all)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (engine->parked_workers.load(std::memory_order_seq_cst) != 0) {
+        std::lock_guard<std::mutex> lock(engine->park_mutex);
+        if (all) {
+            engine->work_ready.notify_all();
+        } else {
+            engine->work_ready.notify_one();
+        }
+    }
+}
+
+static void wake_submitters(aesgcmsiv_engine* engine)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (engine->blocked_submitters.load(std::memory_order_seq_cst) != 0) {
+        std::lock_guard<std::mutex> lock(engine->park_mutex);
+        engine->room_ready.notify_all();
+    }
+}
+
+static void raise_notify(aesgcmsiv_engine* engine)
+{
+    if (!engine->notify_raised.exchange(true, std::memory_order_seq_cst)) {
+        aesgcmsiv_notify_raise(&engine->notify);
+    }
+}
+
+// Called by the reaper once it has found the completion ring empty. The
+// handle is cleared before raised is, and the ring looked at again after:
+// a worker that pushed in between either sees raised unset and signals
+// again, or its completion is seen here.
+static void clear_notify(aesgcmsiv_engine* engine)
+{
+    aesgcmsiv_notify_clear(&engine->notify);
+    engine->notify_raised.store(false, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!engine->completions.empty()) {
+        raise_notify(engine);
+    }
+}
+
+static void wake_reaper(aesgcmsiv_engine* engine)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (engine->notify_on.load(std::memory_order_seq_cst)) {
+        raise_notify(engine);
+    }
+    if (engine->reaper_parked.load(std::memory_order_seq_cst)) {
+        std::lock_guard<std::mutex> lock(engine->park_mutex);
+        engine->completion_ready.notify_one();
+    }
+}
+
+// Runs one context's share of a drained batch. The items were validated at
+// submission.
+static void run_engine_items(
+    aesgcmsiv_ctx* ctx, bool decrypt,
+    const aesgcmsiv_batch_item* items, size_t count, int* status_out)
+{
+    StatsScope stats(decrypt ? AESGCMSIV_OP_DECRYPT : AESGCMSIV_OP_ENCRYPT, StatsScope::Batch{count});
+    stats.set_key_context(ctx);
+    const uint64_t mean_len = batch_mean_len(items, count);
+    const aesgcmsiv_kernel* kernel = ctx->kernel ? ctx_kernel(ctx, mean_len) : nullptr;
+    stats.setup_done(backend_name(kernel), vector_bits(kernel, mean_len));
+    for (size_t i = 0; i < count; i++) {
+        status_out[i] = AESGCMSIV_SUCCESS;
+    }
+    if (ctx->kernel) {
+        AESGCMSIV_TRACE3(batch__dispatch, decrypt ? AESGCMSIV_OP_DECRYPT : AESGCMSIV_OP_ENCRYPT, count, 1);
+        if (decrypt) {
+            kernel_open_batch(kernel, &ctx->key_schedule, items, count, status_out);
+        } else {
+            kernel_seal_batch(kernel, &ctx->key_schedule, items, count);
+        }
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            const aesgcmsiv_batch_item& item = items[i];
+            status_out[i] = decrypt
+                ? ctx_decrypt_impl(stats, ctx, item.nonce, AESGCMSIV_NONCE_SIZE,
+                    item.input, item.input_len, item.aad, item.aad_len, item.tag, item.output)
+                : ctx_encrypt_impl(stats, ctx, item.nonce, AESGCMSIV_NONCE_SIZE,
+                    item.input, item.input_len, item.aad, item.aad_len, item.output, item.tag);
+        }
+    }
+    stats.finish_items(items, count, status_out);
+}
+
+// Takes requests off lane into drain from entry first on, up to
+// ENGINE_DRAIN_MAX in all and stopping early once they hold budget bytes,
+// and records how long they waited. Returns the number taken.
+static size_t drain_lane(aesgcmsiv_engine* engine, engine_lane& lane, engine_drain* drain, size_t first, size_t budget)
+{
+    size_t count = first;
+    size_t bytes = 0;
+    while (count < ENGINE_DRAIN_MAX && bytes < budget && lane.ring.pop(&drain->entries[count])) {
+        bytes += drain->entries[count].request.item.input_len;
+        count++;
+    }
+    count -= first;
+    if (count == 0) {
+        return 0;
+    }
+    lane.queued.fetch_sub(count, std::memory_order_relaxed);
+    engine->queued.fetch_sub(count, std::memory_order_seq_cst);
+
+    const uint64_t now = aesgcmsiv_stats_now();
+    uint64_t total = 0;
+    uint64_t longest = 0;
+    for (size_t i = first; i < first + count; i++) {
+        const uint64_t submitted = drain->entries[i].submitted_ns;
+        const uint64_t wait = now > submitted ? now - submitted : 0;
+        total += wait;
+        longest = std::max(longest, wait);
+    }
+    lane.started.fetch_add(count, std::memory_order_relaxed);
+    lane.wait_ns.fetch_add(total, std::memory_order_relaxed);
+    store_max(lane.max_wait_ns, longest);
+    return count;
+}
+
+static void serve_latency(aesgcmsiv_engine* engine, engine_drain* drain);
+
+// A bulk message its worker works through a slice at a time. Only a kernel
+// keeps the message state that allows it; the crypto library takes the
+// whole message in one call.
+static bool engine_sliced(const engine_entry& entry)
+{
+    return entry.request.ctx->kernel && entry.request.item.input_len > AESGCMSIV_ENGINE_SLICE;
+}
+
+// Seals a bulk message through the incremental message calls, serving the
+// latency lane from latency between slices. The tag needs every plaintext
+// byte before any ciphertext, so the plaintext is walked twice. Time spent
+// on the latency lane counts towards this message in the statistics.
+static int engine_seal_sliced(aesgcmsiv_engine* engine, const aesgcmsiv_request& request, engine_drain* latency)
+{
+    const aesgcmsiv_batch_item& item = request.item;
+    StatsScope stats(AESGCMSIV_OP_ENCRYPT, item.input_len, item.aad_len);
+    stats.set_key_context(request.ctx);
+    aesgcmsiv_ctx_msg* msg = nullptr;
+    int result = aesgcmsiv_ctx_begin(request.ctx, item.nonce, AESGCMSIV_NONCE_SIZE, &msg);
+    if (result != AESGCMSIV_SUCCESS) {
+        return stats.finish(result, 0);
+    }
+    stats.setup_done(request.ctx->kernel->name, vector_bits(request.ctx->kernel, item.input_len));
+    result = aesgcmsiv_ctx_aad_update(msg, item.aad, item.aad_len);
+    for (size_t offset = 0; result == AESGCMSIV_SUCCESS && offset < item.input_len; offset += AESGCMSIV_ENGINE_SLICE) {
+        const size_t len = std::min<size_t>(AESGCMSIV_ENGINE_SLICE, item.input_len - offset);
+        result = aesgcmsiv_ctx_absorb_plaintext(msg, item.input + offset, len);
+        serve_latency(engine, latency);
+    }
+    if (result == AESGCMSIV_SUCCESS) {
+        result = aesgcmsiv_ctx_finalize_tag(msg, item.tag);
+    }
+    for (size_t offset = 0; result == AESGCMSIV_SUCCESS && offset < item.input_len; offset += AESGCMSIV_ENGINE_SLICE) {
+        if (offset) {
+            serve_latency(engine, latency);
+        }
+        const size_t len = std::min<size_t>(AESGCMSIV_ENGINE_SLICE, item.input_len - offset);
+        result = aesgcmsiv_ctx_emit_ciphertext(msg, item.input + offset, len, item.output + offset);
+    }
+    aesgcmsiv_ctx_msg_free(msg);
+    return stats.finish(result, item.input_len);
+}
+
+// Opens a bulk message a slice at a time, decrypting each slice and folding
+// its plaintext into POLYVAL while it is still in cache. The output holds
+// unverified plaintext until the tag is checked, and is zeroed if it fails.
+static int engine_open_sliced(aesgcmsiv_engine* engine, const aesgcmsiv_request& request, engine_drain* latency)
+{
+    const aesgcmsiv_batch_item& item = request.item;
+    const aesgcmsiv_kernel* kernel = request.ctx->kernel;
+    StatsScope stats(AESGCMSIV_OP_DECRYPT, item.input_len, item.aad_len);
+    stats.set_key_context(request.ctx);
+    aesgcmsiv_ctx_msg* msg = nullptr;
+    int result = aesgcmsiv_ctx_begin(request.ctx, item.nonce, AESGCMSIV_NONCE_SIZE, &msg);
+    if (result != AESGCMSIV_SUCCESS) {
+        return stats.finish(result, 0);
+    }
+    stats.setup_done(kernel->name, vector_bits(kernel, item.input_len));
+    result = aesgcmsiv_ctx_aad_update(msg, item.aad, item.aad_len);
+    if (result != AESGCMSIV_SUCCESS) {
+        aesgcmsiv_ctx_msg_free(msg);
+        return stats.finish(result, 0);
+    }
+    absorb_partial(msg);
+    ctr32_stream_init(&msg->ctr, item.tag);
+    for (size_t offset = 0; offset < item.input_len; offset += AESGCMSIV_ENGINE_SLICE) {
+        if (offset) {
+            serve_latency(engine, latency);
+        }
+        const size_t len = std::min<size_t>(AESGCMSIV_ENGINE_SLICE, item.input_len - offset);
+        kernel_ctr32_stream(kernel, &msg->enc_ks, &msg->ctr, item.input + offset, item.output + offset, len);
+        absorb_piece(msg, item.output + offset, len);
+    }
+    absorb_partial(msg);
+    alignas(16) uint8_t expected[16];
+    kernel_absorbed_tag(kernel, &msg->pv, msg->aad_len, item.input_len, &msg->enc_ks, msg->nonce, expected);
+    if (!aesgcmsiv_tags_equal(expected, item.tag)) {
+        aesgcmsiv_secure_zero(item.output, item.input_len);
+        result = AESGCMSIV_ERROR_DECRYPT_FAILED;
+    }
+    msg->phase = MSG_FINISHED;
+    aesgcmsiv_ctx_msg_free(msg);
+    return stats.finish(result, item.input_len);
+}
+
+// Runs a drained pass and posts its completions. A bulk pass is given the
+// scratch to serve the latency lane with between its groups and slices; a
+// latency pass gets NULL.
+static void run_drained(aesgcmsiv_engine* engine, engine_drain* drain, size_t count, engine_drain* latency)
+{
+    engine_entry* entries = drain->entries;
+    const auto sliced = [latency](const engine_entry& entry) { return latency && engine_sliced(entry); };
+
+    // Requests from many threads arrive interleaved; grouping them by
+    // context and direction is what turns them into kernel batches
+    std::stable_sort(entries, entries + count,
+        [&sliced](const engine_entry& a, const engine_entry& b) {
+            if (a.request.ctx != b.request.ctx) {
+                return std::less<aesgcmsiv_ctx*>()(a.request.ctx, b.request.ctx);
+            }
+            if (a.request.op != b.request.op) {
+                return a.request.op < b.request.op;
+            }
+            return sliced(a) < sliced(b);
+        });
+    for (size_t start = 0; start < count;) {
+        const aesgcmsiv_request& first = entries[start].request;
+        const bool decrypt = first.op == AESGCMSIV_OP_DECRYPT;
+        const bool slice = sliced(entries[start]);
+        size_t end = start + 1;
+        while (end < count && entries[end].request.ctx == first.ctx &&
+               entries[end].request.op == first.op && sliced(entries[end]) == slice) {
+            end++;
+        }
+        if (slice) {
+            for (size_t i = start; i < end; i++) {
+                if (i > start) {
+                    serve_latency(engine, latency);
+                }
+                drain->status[i] = decrypt
+                    ? engine_open_sliced(engine, entries[i].request, latency)
+                    : engine_seal_sliced(engine, entries[i].request, latency);
+            }
+        } else {
+            for (size_t i = start; i < end; i++) {
+                drain->items[i] = entries[i].request.item;
+            }
+            run_engine_items(first.ctx, decrypt, drain->items + start, end - start, drain->status + start);
+        }
+
+        // Cannot fail: outstanding requests never exceed the ring's capacity
+        for (size_t i = start; i < end; i++) {
+            engine->completions.push(aesgcmsiv_completion{ entries[i].request.user_data, drain->status[i] });
+        }
+        wake_reaper(engine);
+        start = end;
+        if (latency && start < count) {
+            serve_latency(engine, latency);
+        }
+    }
+}
+
+// Runs whatever has arrived on the latency lane, from a worker between
+// slices of bulk work
+static void serve_latency(aesgcmsiv_engine* engine, engine_drain* drain)
+{
+    engine_lane& lane = engine->lanes[AESGCMSIV_LANE_LATENCY];
+    if (lane.queued.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+    size_t count = drain_lane(engine, lane, drain, 0, SIZE_MAX);
+    if (count == 0) {
+        return;
+    }
+    engine->preemptions.fetch_add(1, std::memory_order_relaxed);
+    do {
+        run_drained(engine, drain, count, nullptr);
+    } while ((count = drain_lane(engine, lane, drain, 0, SIZE_MAX)) != 0);
+}
+
+// Holds a latency batch of count requests open until it has target
+// requests or linger_ns has passed, and returns its new size
+static size_t linger_for_batch(
+    aesgcmsiv_engine* engine, engine_lane& lane, engine_drain* drain,
+    size_t count, size_t target, uint64_t linger_ns)
+{
+    const uint64_t deadline = aesgcmsiv_stats_now() + linger_ns;
+    while (count < target && !engine->stopping.load(std::memory_order_relaxed)) {
+        const size_t more = drain_lane(engine, lane, drain, count, SIZE_MAX);
+        if (more > 0) {
+            count += more;
+        } else if (aesgcmsiv_stats_now() >= deadline) {
+            break;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    return count;
+}
+
+static void engine_worker(aesgcmsiv_engine* engine)
+{
+    engine_lane& latency_lane = engine->lanes[AESGCMSIV_LANE_LATENCY];
+    engine_lane& bulk_lane = engine->lanes[AESGCMSIV_LANE_BULK];
+    engine_drain latency;
+    engine_drain bulk;
+    // Mean size of the batches this worker found waiting, in sixteenths
+    // and averaged over about the last eight; lingering is left out, so a
+    // batch that only filled because the worker waited does not count
+    unsigned int backlog = 16;
+
+    for (;;) {
+        size_t count = drain_lane(engine, latency_lane, &latency, 0, SIZE_MAX);
+        if (count > 0) {
+            backlog = backlog - backlog / 8 + static_cast<unsigned int>(count) * 2;
+            // A worker that keeps finding one request is keeping up, and
+            // would only add latency by waiting; one that finds several is
+            // behind, and a fuller batch costs its requests little more
+            const uint64_t linger_ns = engine->linger_ns.load(std::memory_order_relaxed);
+            const size_t target = engine->batch_target.load(std::memory_order_relaxed);
+            if (linger_ns && count < target && backlog >= ENGINE_LINGER_BACKLOG * 16) {
+                count = linger_for_batch(engine, latency_lane, &latency, count, target, linger_ns);
+            }
+            run_drained(engine, &latency, count, nullptr);
+            continue;
+        }
+        count = drain_lane(engine, bulk_lane, &bulk, 0, AESGCMSIV_ENGINE_SLICE);
+        if (count > 0) {
+            run_drained(engine, &bulk, count, &latency);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(engine->park_mutex);
+        engine->parked_workers.fetch_add(1, std::memory_order_seq_cst);
+        if (latency_lane.ring.empty() && bulk_lane.ring.empty()) {
+            if (engine->stopping.load(std::memory_order_seq_cst) &&
+                engine->queued.load(std::memory_order_seq_cst) == 0) {
+                engine->parked_workers.fetch_sub(1, std::memory_order_relaxed);
+                return;
+            }
+            engine->work_ready.wait(lock);
+        }
+        engine->parked_workers.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+int aesgcmsiv_engine_new(
+    unsigned int workers, size_t queue_depth,
+    aesgcmsiv_engine** engine_out)
+{
+    if (!engine_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *engine_out = nullptr;
+    if (queue_depth == 0 || queue_depth > (SIZE_MAX >> 1) + 1) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    if (workers == 0) {
+        workers = aesgcmsiv_cpu_budget();
+    }
+    workers = std::min(workers, static_cast<unsigned int>(ENGINE_MAX_WORKERS));
+
+    size_t depth = 1;
+    while (depth < queue_depth) {
+        depth <<= 1;
+    }
+
+    aesgcmsiv_engine* engine = new (std::nothrow) aesgcmsiv_engine();
+    if (!engine) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    engine->depth = depth;
+    engine->batch_target.store(AESGCMSIV_LANES, std::memory_order_relaxed);
+    if (!engine->lanes[AESGCMSIV_LANE_LATENCY].ring.init(depth) ||
+        !engine->lanes[AESGCMSIV_LANE_BULK].ring.init(depth) || !engine->completions.init(depth)) {
+        delete engine;
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+
+    // Nothing is thrown out of the library; an engine with fewer workers
+    // than asked for still works
+    for (unsigned int i = 0; i < workers; i++) {
+        try {
+            engine->workers[i] = std::thread(engine_worker, engine);
+        } catch (...) {
+            break;
+        }
+        engine->worker_count++;
+    }
+    if (engine->worker_count == 0) {
+        delete engine;
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+
+    *engine_out = engine;
+    return AESGCMSIV_SUCCESS;
+}
+
+static int engine_submit(
+    aesgcmsiv_engine* engine,
+    const aesgcmsiv_request* request,
+    uint32_t lane_index)
+{
+    if (!engine || !request || !request->ctx || lane_index >= AESGCMSIV_ENGINE_LANES) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    const aesgcmsiv_batch_item& item = request->item;
+    int validation_result;
+    if (request->op == AESGCMSIV_OP_ENCRYPT) {
+        validation_result = validate_encrypt_params(
+            item.nonce, AESGCMSIV_NONCE_SIZE, item.input, item.input_len, item.aad_len,
+            item.output, item.tag);
+    } else if (request->op == AESGCMSIV_OP_DECRYPT) {
+        validation_result = validate_decrypt_params(
+            item.nonce, AESGCMSIV_NONCE_SIZE, item.input, item.input_len, item.aad_len,
+            item.tag, item.output);
+    } else {
+        validation_result = AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (validation_result != AESGCMSIV_SUCCESS) {
+        return validation_result;
+    }
+
+    // A blocking submitter parks like a worker does, and reap wakes it
+    // once it has made room
+    while (engine->outstanding.fetch_add(1, std::memory_order_seq_cst) >= engine->depth) {
+        engine->outstanding.fetch_sub(1, std::memory_order_seq_cst);
+        if (!engine->blocking.load(std::memory_order_relaxed)) {
+            return AESGCMSIV_ERROR_BUSY;
+        }
+        std::unique_lock<std::mutex> lock(engine->park_mutex);
+        engine->blocked_submitters.fetch_add(1, std::memory_order_seq_cst);
+        if (engine->stopping.load(std::memory_order_seq_cst)) {
+            engine->blocked_submitters.fetch_sub(1, std::memory_order_relaxed);
+            return AESGCMSIV_ERROR_INVALID_INPUT;
+        }
+        if (engine->outstanding.load(std::memory_order_seq_cst) >= engine->depth) {
+            engine->room_ready.wait(lock);
+        }
+        engine->blocked_submitters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // Counted before checking stopping, so a worker or reaper that has
+    // seen stopping and nothing queued cannot miss this request; one that
+    // loses the race is withdrawn and the waiters rechecked
+    engine->queued.fetch_add(1, std::memory_order_seq_cst);
+    if (engine->stopping.load(std::memory_order_seq_cst)) {
+        engine->queued.fetch_sub(1, std::memory_order_seq_cst);
+        engine->outstanding.fetch_sub(1, std::memory_order_seq_cst);
+        wake_workers(engine, true);
+        wake_reaper(engine);
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    // Counted before the push, so a worker never takes more off the lane
+    // than its count shows
+    engine_lane& lane = engine->lanes[lane_index];
+    store_max(lane.max_depth, lane.queued.fetch_add(1, std::memory_order_relaxed) + 1);
+    lane.submitted.fetch_add(1, std::memory_order_relaxed);
+
+    // Cannot fail: outstanding requests never exceed the ring's capacity
+    lane.ring.push(engine_entry{ *request, aesgcmsiv_stats_now() });
+    wake_workers(engine, false);
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_engine_submit(
+    aesgcmsiv_engine* engine,
+    const aesgcmsiv_request* request)
+{
+    const uint32_t lane = request && request->item.input_len > AESGCMSIV_ENGINE_LATENCY_MAX
+        ? AESGCMSIV_LANE_BULK : AESGCMSIV_LANE_LATENCY;
+    return engine_submit(engine, request, lane);
+}
+
+int aesgcmsiv_engine_submit_lane(
+    aesgcmsiv_engine* engine,
+    const aesgcmsiv_request* request,
+    uint32_t lane)
+{
+    return engine_submit(engine, request, lane);
+}
+
+int aesgcmsiv_engine_set_linger(
+    aesgcmsiv_engine* engine,
+    uint64_t linger_ns, size_t batch_target)
+{
+    if (!engine || linger_ns > AESGCMSIV_ENGINE_MAX_LINGER_NS || batch_target > ENGINE_DRAIN_MAX) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    engine->batch_target.store(batch_target ? batch_target : AESGCMSIV_LANES, std::memory_order_relaxed);
+    engine->linger_ns.store(linger_ns, std::memory_order_relaxed);
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_engine_set_blocking(aesgcmsiv_engine* engine, int block)
+{
+    if (!engine) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    engine->blocking.store(block != 0, std::memory_order_relaxed);
+    if (!block) {
+        // Submitters already waiting recheck and fail with BUSY
+        std::lock_guard<std::mutex> lock(engine->park_mutex);
+        engine->room_ready.notify_all();
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_engine_get_stats(
+    aesgcmsiv_engine* engine,
+    aesgcmsiv_engine_stats* stats_out)
+{
+    if (!engine || !stats_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    for (size_t i = 0; i < AESGCMSIV_ENGINE_LANES; i++) {
+        const engine_lane& lane = engine->lanes[i];
+        aesgcmsiv_engine_lane_stats& out = stats_out->lanes[i];
+        out.submitted = lane.submitted.load(std::memory_order_relaxed);
+        out.started = lane.started.load(std::memory_order_relaxed);
+        out.depth = lane.queued.load(std::memory_order_relaxed);
+        out.max_depth = lane.max_depth.load(std::memory_order_relaxed);
+        out.wait_ns = lane.wait_ns.load(std::memory_order_relaxed);
+        out.max_wait_ns = lane.max_wait_ns.load(std::memory_order_relaxed);
+    }
+    stats_out->preemptions = engine->preemptions.load(std::memory_order_relaxed);
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_engine_reap(
+    aesgcmsiv_engine* engine,
+    aesgcmsiv_completion* completions, size_t max,
+    int wait,
+    size_t* count_out)
+{
+    if (!count_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *count_out = 0;
+    if (!engine || (max > 0 && !completions)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    for (;;) {
+        size_t count = 0;
+        while (count < max && engine->completions.pop(&completions[count])) {
+            count++;
+        }
+        if (count < max && engine->notify_on.load(std::memory_order_seq_cst) &&
+            engine->notify_raised.load(std::memory_order_seq_cst)) {
+            clear_notify(engine);
+        }
+        if (count > 0) {
+            engine->outstanding.fetch_sub(count, std::memory_order_seq_cst);
+            wake_submitters(engine);
+            *count_out = count;
+            return AESGCMSIV_SUCCESS;
+        }
+        if (!wait || max == 0) {
+            return AESGCMSIV_SUCCESS;
+        }
+
+        std::unique_lock<std::mutex> lock(engine->park_mutex);
+        engine->reaper_parked.store(true, std::memory_order_seq_cst);
+        if (engine->completions.empty()) {
+            if (engine->stopping.load(std::memory_order_seq_cst) &&
+                engine->outstanding.load(std::memory_order_seq_cst) == 0) {
+                engine->reaper_parked.store(false, std::memory_order_relaxed);
+                return AESGCMSIV_SUCCESS;
+            }
+            engine->completion_ready.wait(lock);
+        }
+        engine->reaper_parked.store(false, std::memory_order_relaxed);
+    }
+}
+
+int aesgcmsiv_engine_get_notify_handle(
+    aesgcmsiv_engine* engine,
+    intptr_t* handle_out)
+{
+    if (!engine || !handle_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::lock_guard<std::mutex> lock(engine->park_mutex);
+    if (!engine->notify_on.load(std::memory_order_relaxed)) {
+        if (!aesgcmsiv_notify_open(&engine->notify)) {
+            return AESGCMSIV_ERROR_INTERNAL;
+        }
+        engine->notify_on.store(true, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // Completions posted before the handle existed signaled nothing
+        if (!engine->completions.empty()) {
+            raise_notify(engine);
+        }
+    }
+    *handle_out = engine->notify.handle;
+    return AESGCMSIV_SUCCESS;
+}
+
+void aesgcmsiv_engine_shutdown(aesgcmsiv_engine* engine)
+{
+    if (!engine) {
+        return;
+    }
+    engine->stopping.store(true, std::memory_order_seq_cst);
+    std::lock_guard<std::mutex> lock(engine->park_mutex);
+    engine->work_ready.notify_all();
+    engine->completion_ready.notify_all();
+    engine->room_ready.notify_all();
+}
+
+void aesgcmsiv_engine_free(aesgcmsiv_engine* engine)
+{
+    if (!engine) {
+        return;
+    }
+    aesgcmsiv_engine_shutdown(engine);
+    for (unsigned int i = 0; i < engine->worker_count; i++) {
+        engine->workers[i].join();
+    }
+    if (engine->notify_on.load(std::memory_order_relaxed)) {
+        aesgcmsiv_notify_close(&engine->notify);
+    }
+    delete engine;
+}
+
+// A submitted call, with the job running it once it has paused
+struct aesgcmsiv_job {
+    crypto_job* job;
+    aesgcmsiv_ctx* ctx;
+    bool decrypt;
+    const uint8_t* nonce;
+    size_t nonce_len;
+    const uint8_t* input;
+    size_t input_len;
+    const uint8_t* aad;
+    size_t aad_len;
+    const uint8_t* tag;  // read when decrypting
+    uint8_t* output;
+    uint8_t* tag_out;  // written when encrypting
+    aesgcmsiv_done_fn done;  // for a call posted to a pool
+    void* user_data;
+};
+
+static int run_job_call(const aesgcmsiv_job* job)
+{
+    if (job->decrypt) {
+        return aesgcmsiv_ctx_decrypt(job->ctx, job->nonce, job->nonce_len,
+            job->input, job->input_len, job->aad, job->aad_len, job->tag, job->output);
+    }
+    return aesgcmsiv_ctx_encrypt(job->ctx, job->nonce, job->nonce_len,
+        job->input, job->input_len, job->aad, job->aad_len, job->output, job->tag_out);
+}
+
+// Entry point of the job; its argument is a copy of the job pointer
+static int job_entry(void* arg)
+{
+    return run_job_call(*static_cast<aesgcmsiv_job* const*>(arg));
+}
+
+static void free_job(aesgcmsiv_job* job)
+{
+    crypto_job_free(job->job);
+    aesgcmsiv_block_delete(job);
+}
+
+// Starts or resumes the job. Frees it unless it paused.
+static int drive_job(aesgcmsiv_job* job)
+{
+    const bool started = crypto_job_started(job->job);
+    int result = AESGCMSIV_ERROR_INTERNAL;
+    switch (crypto_job_run(job->job, job_entry, &job, sizeof(job), &result)) {
+    case CRYPTO_JOB_PAUSED:
+        return AESGCMSIV_PENDING;
+    case CRYPTO_JOB_FINISHED:
+        break;
+    case CRYPTO_JOB_NO_JOBS:
+        // The thread's job pool is exhausted; a call that never started can
+        // still run, just without the chance to pause
+        result = started ? AESGCMSIV_ERROR_INTERNAL : run_job_call(job);
+        break;
+    case CRYPTO_JOB_FAILED:
+        result = AESGCMSIV_ERROR_INTERNAL;
+        break;
+    }
+    free_job(job);
+    return result;
+}
+
+static int submit_job(const aesgcmsiv_job& call, aesgcmsiv_job** job_out)
+{
+    if (!job_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *job_out = nullptr;
+
+    // Only an OpenSSL cipher can pause; the kernels always run straight
+    // through, so spare them the fibre switch
+    if (!call.ctx || call.ctx->kernel || !crypto_job_capable()) {
+        return run_job_call(&call);
+    }
+
+    aesgcmsiv_job* job = aesgcmsiv_block_new<aesgcmsiv_job>(call);
+    if (!job) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    job->job = crypto_job_new();
+    if (!job->job) {
+        free_job(job);
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+
+    int result = drive_job(job);
+    if (result == AESGCMSIV_PENDING) {
+        *job_out = job;
+    }
+    return result;
+}
+
+int aesgcmsiv_ctx_encrypt_submit(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out,
+    aesgcmsiv_job** job_out)
+{
+    aesgcmsiv_job call = {};
+    call.ctx = ctx;
+    call.nonce = nonce;
+    call.nonce_len = nonce_len;
+    call.input = plaintext;
+    call.input_len = plaintext_len;
+    call.aad = aad;
+    call.aad_len = aad_len;
+    call.output = ciphertext_out;
+    call.tag_out = tag_out;
+    return submit_job(call, job_out);
+}
+
+int aesgcmsiv_ctx_decrypt_submit(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out,
+    aesgcmsiv_job** job_out)
+{
+    aesgcmsiv_job call = {};
+    call.ctx = ctx;
+    call.decrypt = true;
+    call.nonce = nonce;
+    call.nonce_len = nonce_len;
+    call.input = ciphertext;
+    call.input_len = ciphertext_len;
+    call.aad = aad;
+    call.aad_len = aad_len;
+    call.tag = tag;
+    call.output = plaintext_out;
+    return submit_job(call, job_out);
+}
+
+int aesgcmsiv_job_poll(aesgcmsiv_job* job)
+{
+    if (!job || !job->job || !crypto_job_started(job->job)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    return drive_job(job);
+}
+
+// Pool task running a posted call; frees it before reporting, so the
+// callback may release everything the call used
+static void run_posted_call(void* arg)
+{
+    aesgcmsiv_job* job = static_cast<aesgcmsiv_job*>(arg);
+    int result = run_job_call(job);
+    aesgcmsiv_done_fn done = job->done;
+    void* user_data = job->user_data;
+    aesgcmsiv_block_delete(job);
+    done(user_data, result);
+}
+
+static int post_call(const aesgcmsiv_job& call)
+{
+    if (!call.ctx || !call.done) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    int validation_result = call.decrypt
+        ? validate_decrypt_params(call.nonce, call.nonce_len, call.input, call.input_len,
+            call.aad_len, call.tag, call.output)
+        : validate_encrypt_params(call.nonce, call.nonce_len, call.input, call.input_len,
+            call.aad_len, call.output, call.tag_out);
+    if (validation_result != AESGCMSIV_SUCCESS) {
+        return validation_result;
+    }
+
+    aesgcmsiv_pool* pool = call.ctx->pool.load(std::memory_order_acquire);
+    if (!pool) {
+        return run_job_call(&call);
+    }
+    aesgcmsiv_job* job = aesgcmsiv_block_new<aesgcmsiv_job>(call);
+    if (!job) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    if (!aesgcmsiv_pool_post(pool, run_posted_call, job)) {
+        aesgcmsiv_block_delete(job);
+        return run_job_call(&call);
+    }
+    return AESGCMSIV_PENDING;
+}
+
+int aesgcmsiv_ctx_encrypt_async(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out,
+    aesgcmsiv_done_fn done, void* user_data)
+{
+    aesgcmsiv_job call = {};
+    call.ctx = ctx;
+    call.nonce = nonce;
+    call.nonce_len = nonce_len;
+    call.input = plaintext;
+    call.input_len = plaintext_len;
+    call.aad = aad;
+    call.aad_len = aad_len;
+    call.output = ciphertext_out;
+    call.tag_out = tag_out;
+    call.done = done;
+    call.user_data = user_data;
+    return post_call(call);
+}
+
+int aesgcmsiv_ctx_decrypt_async(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out,
+    aesgcmsiv_done_fn done, void* user_data)
+{
+    aesgcmsiv_job call = {};
+    call.ctx = ctx;
+    call.decrypt = true;
+    call.nonce = nonce;
+    call.nonce_len = nonce_len;
+    call.input = ciphertext;
+    call.input_len = ciphertext_len;
+    call.aad = aad;
+    call.aad_len = aad_len;
+    call.tag = tag;
+    call.output = plaintext_out;
+    call.done = done;
+    call.user_data = user_data;
+    return post_call(call);
+}
+
+void aesgcmsiv_ctx_free(aesgcmsiv_ctx* ctx)
+{
+    if (!ctx) {
+        return;
+    }
+    // crypto_key_free cleanses the library's key state; the kernel key
+    // schedule is cleared along with the rest of the slot below
+    crypto_key_free(ctx->library_key);
+    nonce_cache_free(ctx->nonces);
+    if (ctx->usage.load(std::memory_order_relaxed)) {
+        aesgcmsiv_usage_contexts.fetch_sub(1, std::memory_order_relaxed);
+    }
+    delete ctx->usage_block.load(std::memory_order_relaxed);
+    aesgcmsiv_secure_delete(ctx);
+}
+
+// A new context holding a copy of src's expanded key, or of its keyed
+// library state, with the thread count and pool unset and usage untracked
+static int ctx_clone(const aesgcmsiv_ctx* src, aesgcmsiv_ctx** ctx_out)
+{
+    aesgcmsiv_ctx* ctx = aesgcmsiv_secure_new<aesgcmsiv_ctx>();
+    if (!ctx) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    ctx->threads = 1;
+
+    if (src->kernel) {
+        ctx->kernel = src->kernel;
+        ctx->key_schedule = src->key_schedule;
+    } else {
+        int result = crypto_key_clone(src->library_key, &ctx->library_key);
+        if (result != AESGCMSIV_SUCCESS) {
+            aesgcmsiv_ctx_free(ctx);
+            return result;
+        }
+    }
+    *ctx_out = ctx;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_ctx_clone(const aesgcmsiv_ctx* template_ctx, aesgcmsiv_ctx** ctx_out)
+{
+    if (!template_ctx || !ctx_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *ctx_out = nullptr;
+
+    aesgcmsiv_ctx* ctx;
+    int result = ctx_clone(template_ctx, &ctx);
+    if (result != AESGCMSIV_SUCCESS) {
+        return result;
+    }
+    ctx->threads.store(template_ctx->threads.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    ctx->pool.store(template_ctx->pool.load(std::memory_order_acquire), std::memory_order_relaxed);
+    ctx->stream_min.store(template_ctx->stream_min.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    ctx->wide_min.store(template_ctx->wide_min.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    *ctx_out = ctx;
+    return AESGCMSIV_SUCCESS;
+}
+
+// Fewest hash buckets a key cache has; the table grows to one per entry
+#define KEY_CACHE_MIN_BUCKETS 16
+
+// Longest name an entry is found by: a key, or a derivation's domain and
+// record ID (see aesgcmsiv_kdf_set_cache)
+#define KEY_CACHE_MAX_NAME 64
+
+// A cached key. The name bytes are kept for the constant-time comparison
+// that confirms a hash match. A derived entry is named by a derivation and
+// record ID rather than by its key, and is only found by derivations.
+struct key_cache_entry {
+    key_cache_entry* bucket_next;
+    key_cache_entry* lru_prev;  // toward the most recently used
+    key_cache_entry* lru_next;
+    uint64_t hash;
+    size_t key_len;
+    uint8_t key[KEY_CACHE_MAX_NAME];
+    bool derived;
+    aesgcmsiv_ctx* ctx;
+};
+
+// Chained hash table over an intrusive LRU list; every field is guarded by
+// lock. Key expansion on a miss runs outside it.
+struct aesgcmsiv_key_cache {
+    std::mutex lock;
+    uint64_t secret[2];  // SipHash key, drawn when the cache is created
+    size_t capacity;
+    size_t count;
+    std::unique_ptr<key_cache_entry*[]> buckets;
+    size_t bucket_mask;
+    key_cache_entry* lru_head;  // most recently used
+    key_cache_entry* lru_tail;
+};
+
+static uint64_t rotl64(uint64_t x, int bits)
+{
+    return (x << bits) | (x >> (64 - bits));
+}
+
+static void sip_round(uint64_t v[4])
+{
+    v[0] += v[1]; v[1] = rotl64(v[1], 13); v[1] ^= v[0]; v[0] = rotl64(v[0], 32);
+    v[2] += v[3]; v[3] = rotl64(v[3], 16); v[3] ^= v[2];
+    v[0] += v[3]; v[3] = rotl64(v[3], 21); v[3] ^= v[0];
+    v[2] += v[1]; v[1] = rotl64(v[1], 17); v[1] ^= v[2]; v[2] = rotl64(v[2], 32);
+}
+
+// SipHash-2-4 under the cache's secret. The final block holds the bytes
+// past the last whole word, which keys of 16 or 32 bytes do not have, and
+// the length.
+static uint64_t key_cache_hash(const aesgcmsiv_key_cache* cache, const uint8_t* key, size_t key_len)
+{
+    uint64_t v[4] = {
+        cache->secret[0] ^ 0x736f6d6570736575ULL,
+        cache->secret[1] ^ 0x646f72616e646f6dULL,
+        cache->secret[0] ^ 0x6c7967656e657261ULL,
+        cache->secret[1] ^ 0x7465646279746573ULL,
+    };
+    const size_t whole = key_len & ~static_cast<size_t>(7);
+    for (size_t i = 0; i < whole; i += 8) {
+        uint64_t m = 0;
+        for (int b = 7; b >= 0; b--) {
+            m = (m << 8) | key[i + b];
+        }
+        v[3] ^= m;
+        sip_round(v);
+        sip_round(v);
+        v[0] ^= m;
+    }
+    uint64_t last = static_cast<uint64_t>(key_len) << 56;
+    for (size_t i = whole; i < key_len; i++) {
+        last |= static_cast<uint64_t>(key[i]) << (8 * (i - whole));
+    }
+    v[3] ^= last;
+    sip_round(v);
+    sip_round(v);
+    v[0] ^= last;
+    v[2] ^= 0xff;
+    for (int i = 0; i < 4; i++) {
+        sip_round(v);
+    }
+    return v[0] ^ v[1] ^ v[2] ^ v[3];
+}
+
+static key_cache_entry* key_cache_find(
+    aesgcmsiv_key_cache* cache, uint64_t hash, const uint8_t* key, size_t key_len, bool derived)
+{
+    for (key_cache_entry* entry = cache->buckets[hash & cache->bucket_mask]; entry; entry = entry->bucket_next) {
+        if (entry->hash == hash && entry->key_len == key_len && entry->derived == derived &&
+            CRYPTO_memcmp(entry->key, key, key_len) == 0) {
+            return entry;
+        }
+    }
+    return nullptr;
+}
+
+static void key_cache_unlink(aesgcmsiv_key_cache* cache, key_cache_entry* entry)
+{
+    (entry->lru_prev ? entry->lru_prev->lru_next : cache->lru_head) = entry->lru_next;
+    (entry->lru_next ? entry->lru_next->lru_prev : cache->lru_tail) = entry->lru_prev;
+}
+
+static void key_cache_push_front(aesgcmsiv_key_cache* cache, key_cache_entry* entry)
+{
+    entry->lru_prev = nullptr;
+    entry->lru_next = cache->lru_head;
+    (cache->lru_head ? cache->lru_head->lru_prev : cache->lru_tail) = entry;
+    cache->lru_head = entry;
+}
+
+static void key_cache_touch(aesgcmsiv_key_cache* cache, key_cache_entry* entry)
+{
+    if (cache->lru_head != entry) {
+        key_cache_unlink(cache, entry);
+        key_cache_push_front(cache, entry);
+    }
+}
+
+// Removes the least recently used entries until at most capacity are left,
+// clearing each
+static void key_cache_trim(aesgcmsiv_key_cache* cache, size_t capacity)
+{
+    while (cache->count > capacity) {
+        key_cache_entry* entry = cache->lru_tail;
+        key_cache_entry** link = &cache->buckets[entry->hash & cache->bucket_mask];
+        while (*link != entry) {
+            link = &(*link)->bucket_next;
+        }
+        *link = entry->bucket_next;
+        key_cache_unlink(cache, entry);
+        cache->count--;
+
+        aesgcmsiv_ctx_free(entry->ctx);
+        aesgcmsiv_secure_delete(entry);
+    }
+}
+
+// Adds a filled-in entry as the most recently used, evicting beyond capacity
+static void key_cache_insert(aesgcmsiv_key_cache* cache, key_cache_entry* entry)
+{
+    key_cache_entry*& head = cache->buckets[entry->hash & cache->bucket_mask];
+    entry->bucket_next = head;
+    head = entry;
+    key_cache_push_front(cache, entry);
+    cache->count++;
+    key_cache_trim(cache, cache->capacity);
+}
+
+// Grows the table to a bucket per entry of capacity. If the allocation
+// fails the old table stays, with longer chains.
+static bool key_cache_grow(aesgcmsiv_key_cache* cache, size_t capacity)
+{
+    size_t buckets = KEY_CACHE_MIN_BUCKETS;
+    while (buckets < capacity && buckets <= (SIZE_MAX >> 1)) {
+        buckets <<= 1;
+    }
+    if (cache->buckets && buckets <= cache->bucket_mask + 1) {
+        return true;
+    }
+
+    std::unique_ptr<key_cache_entry*[]> table(new (std::nothrow) key_cache_entry*[buckets]());
+    if (!table) {
+        return cache->buckets != nullptr;
+    }
+    for (key_cache_entry* entry = cache->lru_head; entry; entry = entry->lru_next) {
+        key_cache_entry*& head = table[entry->hash & (buckets - 1)];
+        entry->bucket_next = head;
+        head = entry;
+    }
+    cache->buckets = std::move(table);
+    cache->bucket_mask = buckets - 1;
+    return true;
+}
+
+int aesgcmsiv_key_cache_new(size_t capacity, aesgcmsiv_key_cache** cache_out)
+{
+    if (!cache_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *cache_out = nullptr;
+
+    aesgcmsiv_key_cache* cache = new (std::nothrow) aesgcmsiv_key_cache();
+    if (!cache) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    cache->capacity = capacity;
+    int result = crypto_random(reinterpret_cast<uint8_t*>(cache->secret), sizeof(cache->secret));
+    if (result == AESGCMSIV_SUCCESS && !key_cache_grow(cache, capacity)) {
+        result = AESGCMSIV_ERROR_INTERNAL;
+    }
+    if (result != AESGCMSIV_SUCCESS) {
+        delete cache;
+        return result;
+    }
+    *cache_out = cache;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_key_cache_get(
+    aesgcmsiv_key_cache* cache,
+    const uint8_t* key, size_t key_len,
+    aesgcmsiv_ctx** ctx_out)
+{
+    if (!cache || !ctx_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *ctx_out = nullptr;
+    int validation_result = validate_key(key, key_len);
+    if (validation_result != AESGCMSIV_SUCCESS) {
+        return validation_result;
+    }
+
+    uint64_t hash = key_cache_hash(cache, key, key_len);
+    {
+        std::lock_guard<std::mutex> guard(cache->lock);
+        if (key_cache_entry* entry = key_cache_find(cache, hash, key, key_len, false)) {
+            key_cache_touch(cache, entry);
+            return ctx_clone(entry->ctx, ctx_out);
+        }
+    }
+
+    // Expanded without the lock, so a miss doesn't hold up hits on other keys
+    aesgcmsiv_ctx* ctx;
+    int result = aesgcmsiv_ctx_new(key, key_len, &ctx);
+    if (result != AESGCMSIV_SUCCESS) {
+        return result;
+    }
+
+    std::lock_guard<std::mutex> guard(cache->lock);
+    if (key_cache_entry* entry = key_cache_find(cache, hash, key, key_len, false)) {
+        // Another thread added the key meanwhile
+        key_cache_touch(cache, entry);
+        *ctx_out = ctx;
+        return AESGCMSIV_SUCCESS;
+    }
+    key_cache_entry* entry = cache->capacity ? aesgcmsiv_secure_new<key_cache_entry>() : nullptr;
+    if (!entry) {
+        // Not cached, but the caller still gets its context
+        *ctx_out = ctx;
+        return AESGCMSIV_SUCCESS;
+    }
+    result = ctx_clone(ctx, ctx_out);
+    if (result != AESGCMSIV_SUCCESS) {
+        aesgcmsiv_secure_delete(entry);
+        aesgcmsiv_ctx_free(ctx);
+        return result;
+    }
+
+    entry->hash = hash;
+    entry->key_len = key_len;
+    memcpy(entry->key, key, key_len);
+    entry->ctx = ctx;
+    key_cache_insert(cache, entry);
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_key_cache_set_capacity(aesgcmsiv_key_cache* cache, size_t capacity)
+{
+    if (!cache) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::lock_guard<std::mutex> guard(cache->lock);
+    cache->capacity = capacity;
+    key_cache_trim(cache, capacity);
+    key_cache_grow(cache, capacity);
+    return AESGCMSIV_SUCCESS;
+}
+
+void aesgcmsiv_key_cache_clear(aesgcmsiv_key_cache* cache)
+{
+    if (!cache) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(cache->lock);
+    key_cache_trim(cache, 0);
+}
+
+void aesgcmsiv_key_cache_free(aesgcmsiv_key_cache* cache)
+{
+    if (!cache) {
+        return;
+    }
+    key_cache_trim(cache, 0);
+    OPENSSL_cleanse(cache->secret, sizeof(cache->secret));
+    delete cache;
+}
+
+#define KEYRING_MAX_CAPACITY (size_t(1) << 24)
+
+// Low half of a keyring slot's tag; the high half is the key ID
+#define KEYRING_EMPTY 0u
+#define KEYRING_USED 1u
+#define KEYRING_REMOVED 2u
+
+// Readers check the tag, read the context and check the tag again, so a
+// slot reused for another key while they read it is never mistaken for
+// theirs. A removed key's context is retired rather than freed, and freed
+// only once no reader can still hold it (see keyring_drain).
+struct alignas(16) keyring_slot {
+    std::atomic<uint64_t> tag;
+    std::atomic<aesgcmsiv_ctx*> ctx;
+};
+
+#define KEYRING_READER_STRIPES 8
+
+// Seals and opens in flight that entered in one parity of the epoch, spread
+// over stripes so threads on different cores do not share a line
+struct alignas(64) keyring_reader_stripe {
+    std::atomic<size_t> count;
+};
+
+// A removed key's context, and the epoch it was removed in
+struct keyring_retired {
+    aesgcmsiv_ctx* ctx;
+    uint64_t epoch;
+};
+
+// Linear probing over a power-of-two table; lookups are lock-free, and
+// lock serializes adding and removing
+struct aesgcmsiv_keyring {
+    std::unique_ptr<keyring_slot[]> slots;
+    size_t mask;
+    uint64_t secret;  // keys the slot hash, drawn when the keyring is created
+    size_t capacity;
+    std::mutex lock;
+    size_t count;  // keys held, guarded by lock
+    std::vector<aesgcmsiv_ctx*> contexts;  // every context not yet freed, guarded by lock
+    std::vector<keyring_retired> retired;  // removed and not yet freed, guarded by lock
+    bool track_usage;  // see aesgcmsiv_keyring_set_usage_tracking, guarded by lock
+    // Advanced under lock; readers count themselves in readers[epoch & 1]
+    std::atomic<uint64_t> epoch;
+    keyring_reader_stripe readers[2][KEYRING_READER_STRIPES];
+};
+
+// Threads take reader stripes in turn as they first seal or open
+static std::atomic<unsigned int> keyring_next_stripe(0);
+static thread_local unsigned int keyring_stripe = KEYRING_READER_STRIPES;
+
+// Counts a seal or open in flight for as long as it may hold a context it
+// found. It counts itself in the parity of the epoch it saw, and starts
+// again if the epoch moved on before the count was in, so keyring_drain
+// never misses a reader that could have found a context retired before the
+// epoch advanced.
+class KeyringReader {
+public:
+    explicit KeyringReader(aesgcmsiv_keyring* keyring)
+    {
+        if (keyring_stripe == KEYRING_READER_STRIPES) {
+            keyring_stripe = keyring_next_stripe.fetch_add(1, std::memory_order_relaxed) % KEYRING_READER_STRIPES;
+        }
+        for (;;) {
+            const uint64_t epoch = keyring->epoch.load(std::memory_order_seq_cst);
+            count_ = &keyring->readers[epoch & 1][keyring_stripe].count;
+            count_->fetch_add(1, std::memory_order_seq_cst);
+            if (keyring->epoch.load(std::memory_order_seq_cst) == epoch) {
+                break;
+            }
+            count_->fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    ~KeyringReader() { count_->fetch_sub(1, std::memory_order_release); }
+
+    KeyringReader(const KeyringReader&) = delete;
+    KeyringReader& operator=(const KeyringReader&) = delete;
+
+private:
+    std::atomic<size_t>* count_;
+};
+
+static bool keyring_readers_done(const aesgcmsiv_keyring* keyring, uint64_t parity)
+{
+    for (const keyring_reader_stripe& stripe : keyring->readers[parity]) {
+        if (stripe.count.load(std::memory_order_acquire) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Frees the retired contexts no reader can still hold, with keyring->lock
+// held. Readers that entered before the epoch last advanced count in the
+// other parity; once they are done, every context retired before that
+// advance is unreachable, and the epoch advances again so the contexts
+// retired since can follow. Two rounds, so a key removed while no seal or
+// open is running is freed at once; otherwise a later add or remove frees
+// it. Never waits for readers.
+static void keyring_drain(aesgcmsiv_keyring* keyring)
+{
+    for (int round = 0; round < 2 && !keyring->retired.empty(); round++) {
+        // Orders the slot updates before the reader counts are read
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const uint64_t epoch = keyring->epoch.load(std::memory_order_relaxed);
+        if (!keyring_readers_done(keyring, (epoch - 1) & 1)) {
+            return;
+        }
+        size_t kept = 0;
+        for (size_t i = 0; i < keyring->retired.size(); i++) {
+            const keyring_retired retired = keyring->retired[i];
+            if (retired.epoch >= epoch) {
+                keyring->retired[kept++] = retired;
+                continue;
+            }
+            keyring->contexts.erase(std::find(keyring->contexts.begin(), keyring->contexts.end(), retired.ctx));
+            aesgcmsiv_ctx_free(retired.ctx);
+        }
+        keyring->retired.resize(kept);
+        if (!keyring->retired.empty()) {
+            keyring->epoch.store(epoch + 1, std::memory_order_seq_cst);
+        }
+    }
+}
+
+static uint64_t keyring_tag(uint32_t key_id, uint32_t state)
+{
+    return (static_cast<uint64_t>(key_id) << 32) | state;
+}
+
+static size_t keyring_home(const aesgcmsiv_keyring* keyring, uint32_t key_id)
+{
+    uint64_t x = (key_id ^ keyring->secret) * 0x9e3779b97f4a7c15ULL;
+    return static_cast<size_t>(x ^ (x >> 29)) & keyring->mask;
+}
+
+static aesgcmsiv_ctx* keyring_find(const aesgcmsiv_keyring* keyring, uint32_t key_id)
+{
+    const uint64_t used = keyring_tag(key_id, KEYRING_USED);
+    size_t i = keyring_home(keyring, key_id);
+    for (size_t probes = 0; probes <= keyring->mask; probes++, i = (i + 1) & keyring->mask) {
+        const keyring_slot& slot = keyring->slots[i];
+        uint64_t tag = slot.tag.load(std::memory_order_acquire);
+        if (static_cast<uint32_t>(tag) == KEYRING_EMPTY) {
+            return nullptr;
+        }
+        if (tag == used) {
+            aesgcmsiv_ctx* ctx = slot.ctx.load(std::memory_order_acquire);
+            return slot.tag.load(std::memory_order_acquire) == used ? ctx : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+static uint32_t keyring_read_id(const uint8_t* in)
+{
+    return (static_cast<uint32_t>(in[0]) << 24) | (static_cast<uint32_t>(in[1]) << 16) |
+        (static_cast<uint32_t>(in[2]) << 8) | in[3];
+}
+
+int aesgcmsiv_keyring_new(size_t capacity, aesgcmsiv_keyring** keyring_out)
+{
+    if (!keyring_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *keyring_out = nullptr;
+    if (capacity == 0 || capacity > KEYRING_MAX_CAPACITY) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    std::unique_ptr<aesgcmsiv_keyring> keyring(new (std::nothrow) aesgcmsiv_keyring());
+    if (!keyring) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    // At most half full, so probe sequences stay short
+    size_t slots = 4;
+    while (slots < capacity * 2) {
+        slots <<= 1;
+    }
+    keyring->slots.reset(new (std::nothrow) keyring_slot[slots]);
+    if (!keyring->slots) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    for (size_t i = 0; i < slots; i++) {
+        keyring->slots[i].tag.store(keyring_tag(0, KEYRING_EMPTY), std::memory_order_relaxed);
+        keyring->slots[i].ctx.store(nullptr, std::memory_order_relaxed);
+    }
+    keyring->mask = slots - 1;
+    keyring->capacity = capacity;
+    keyring->count = 0;
+    keyring->track_usage = false;
+    keyring->epoch.store(1, std::memory_order_relaxed);
+    for (auto& parity : keyring->readers) {
+        for (keyring_reader_stripe& stripe : parity) {
+            stripe.count.store(0, std::memory_order_relaxed);
+        }
+    }
+    int result = crypto_random(reinterpret_cast<uint8_t*>(&keyring->secret), sizeof(keyring->secret));
+    if (result != AESGCMSIV_SUCCESS) {
+        return result;
+    }
+    *keyring_out = keyring.release();
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_keyring_add(
+    aesgcmsiv_keyring* keyring, uint32_t key_id,
+    const uint8_t* key, size_t key_len)
+{
+    if (!keyring) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::lock_guard<std::mutex> guard(keyring->lock);
+    keyring_drain(keyring);
+    if (keyring->count == keyring->capacity || keyring_find(keyring, key_id)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    // The first empty or removed slot on the ID's probe sequence; with the
+    // table at most half full there is always one
+    size_t i = keyring_home(keyring, key_id);
+    while (static_cast<uint32_t>(keyring->slots[i].tag.load(std::memory_order_relaxed)) == KEYRING_USED) {
+        i = (i + 1) & keyring->mask;
+    }
+
+    aesgcmsiv_ctx* ctx;
+    int result = aesgcmsiv_ctx_new(key, key_len, &ctx);
+    if (result != AESGCMSIV_SUCCESS) {
+        return result;
+    }
+    if (keyring->track_usage) {
+        result = aesgcmsiv_ctx_set_usage_tracking(ctx, 1);
+        if (result != AESGCMSIV_SUCCESS) {
+            aesgcmsiv_ctx_free(ctx);
+            return result;
+        }
+    }
+    try {
+        keyring->contexts.push_back(ctx);
+    } catch (const std::bad_alloc&) {
+        aesgcmsiv_ctx_free(ctx);
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    keyring_slot& slot = keyring->slots[i];
+    slot.ctx.store(ctx, std::memory_order_release);
+    slot.tag.store(keyring_tag(key_id, KEYRING_USED), std::memory_order_release);
+    keyring->count++;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_keyring_remove(aesgcmsiv_keyring* keyring, uint32_t key_id)
+{
+    if (!keyring) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::lock_guard<std::mutex> guard(keyring->lock);
+    const uint64_t used = keyring_tag(key_id, KEYRING_USED);
+    size_t i = keyring_home(keyring, key_id);
+    for (size_t probes = 0;; probes++, i = (i + 1) & keyring->mask) {
+        uint64_t tag = keyring->slots[i].tag.load(std::memory_order_relaxed);
+        if (probes > keyring->mask || static_cast<uint32_t>(tag) == KEYRING_EMPTY) {
+            return AESGCMSIV_ERROR_NOT_FOUND;
+        }
+        if (tag == used) {
+            break;
+        }
+    }
+    // Reserved first, so that retiring the context cannot fail once the key
+    // is gone
+    try {
+        keyring->retired.reserve(keyring->retired.size() + 1);
+    } catch (const std::bad_alloc&) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    keyring->slots[i].tag.store(keyring_tag(key_id, KEYRING_REMOVED), std::memory_order_release);
+    keyring->retired.push_back({ keyring->slots[i].ctx.load(std::memory_order_relaxed),
+        keyring->epoch.load(std::memory_order_relaxed) });
+    keyring->count--;
+
+    // A removed slot just before an empty one ends no other key's probe
+    // sequence, so it and the removed slots before it can be emptied, which
+    // keeps lookups of unknown IDs short
+    if (static_cast<uint32_t>(keyring->slots[(i + 1) & keyring->mask].tag.load(std::memory_order_relaxed)) ==
+        KEYRING_EMPTY) {
+        while (static_cast<uint32_t>(keyring->slots[i].tag.load(std::memory_order_relaxed)) == KEYRING_REMOVED) {
+            keyring->slots[i].tag.store(keyring_tag(0, KEYRING_EMPTY), std::memory_order_release);
+            i = (i - 1) & keyring->mask;
+        }
+    }
+    keyring_drain(keyring);
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_seal_with_keyid(
+    aesgcmsiv_keyring* keyring, uint32_t key_id,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* sealed_out)
+{
+    StatsScope stats(AESGCMSIV_OP_ENCRYPT, plaintext_len, aad_len);
+    if (!keyring || !sealed_out) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    KeyringReader reader(keyring);
+    aesgcmsiv_ctx* ctx = keyring_find(keyring, key_id);
+    if (!ctx) {
+        return stats.finish(AESGCMSIV_ERROR_NOT_FOUND, 0);
+    }
+    uint8_t* ciphertext = sealed_out + AESGCMSIV_KEYID_SIZE + AESGCMSIV_NONCE_SIZE;
+    int result = ctx_encrypt_impl(stats, ctx, nonce, nonce_len,
+        plaintext, plaintext_len, aad, aad_len, ciphertext, ciphertext + plaintext_len);
+    if (result == AESGCMSIV_SUCCESS) {
+        // Written last so a nonce supplied from sealed_out itself still works
+        memmove(sealed_out + AESGCMSIV_KEYID_SIZE, nonce, AESGCMSIV_NONCE_SIZE);
+        sealed_out[0] = static_cast<uint8_t>(key_id >> 24);
+        sealed_out[1] = static_cast<uint8_t>(key_id >> 16);
+        sealed_out[2] = static_cast<uint8_t>(key_id >> 8);
+        sealed_out[3] = static_cast<uint8_t>(key_id);
+    }
+    return stats.finish(result, plaintext_len);
+}
+
+int aesgcmsiv_open_with_keyid(
+    aesgcmsiv_keyring* keyring,
+    const uint8_t* sealed, size_t sealed_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* plaintext_out,
+    uint32_t* key_id_out)
+{
+    StatsScope stats(AESGCMSIV_OP_DECRYPT,
+        sealed_len >= AESGCMSIV_KEYID_SEAL_OVERHEAD ? sealed_len - AESGCMSIV_KEYID_SEAL_OVERHEAD : 0, aad_len);
+    if (sealed && sealed_len >= AESGCMSIV_KEYID_SIZE && key_id_out) {
+        *key_id_out = keyring_read_id(sealed);
+    }
+    if (!keyring || !sealed || sealed_len < AESGCMSIV_KEYID_SEAL_OVERHEAD) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+    KeyringReader reader(keyring);
+    aesgcmsiv_ctx* ctx = keyring_find(keyring, keyring_read_id(sealed));
+    if (!ctx) {
+        return stats.finish(AESGCMSIV_ERROR_NOT_FOUND, 0);
+    }
+    const uint8_t* nonce = sealed + AESGCMSIV_KEYID_SIZE;
+    const uint8_t* ciphertext = nonce + AESGCMSIV_NONCE_SIZE;
+    size_t ciphertext_len = sealed_len - AESGCMSIV_KEYID_SEAL_OVERHEAD;
+    return stats.finish(ctx_decrypt_impl(stats, ctx, nonce, AESGCMSIV_NONCE_SIZE,
+        ciphertext, ciphertext_len, aad, aad_len, ciphertext + ciphertext_len, plaintext_out),
+        ciphertext_len);
+}
+
+int aesgcmsiv_keyring_set_usage_tracking(aesgcmsiv_keyring* keyring, int enabled)
+{
+    if (!keyring) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::lock_guard<std::mutex> guard(keyring->lock);
+    // Every block is allocated before any context is switched, so a
+    // failure leaves the keyring as it was. Removed keys are switched too,
+    // so none is left counting after tracking is turned off.
+    if (enabled) {
+        for (aesgcmsiv_ctx* ctx : keyring->contexts) {
+            if (!ctx_usage_block(ctx)) {
+                return AESGCMSIV_ERROR_INTERNAL;
+            }
+        }
+    }
+    for (aesgcmsiv_ctx* ctx : keyring->contexts) {
+        ctx_switch_usage(ctx, enabled ? ctx->usage_block.load(std::memory_order_relaxed) : nullptr);
+    }
+    keyring->track_usage = enabled != 0;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_keyring_stats(
+    aesgcmsiv_keyring* keyring,
+    aesgcmsiv_key_usage* usage_out, size_t max,
+    size_t* count_out)
+{
+    if (!keyring || !count_out || (max && !usage_out)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::lock_guard<std::mutex> guard(keyring->lock);
+    size_t count = 0;
+    for (size_t i = 0; i <= keyring->mask && count < max; i++) {
+        const keyring_slot& slot = keyring->slots[i];
+        const uint64_t tag = slot.tag.load(std::memory_order_relaxed);
+        if (static_cast<uint32_t>(tag) != KEYRING_USED) {
+            continue;
+        }
+        aesgcmsiv_key_usage& usage = usage_out[count++];
+        aesgcmsiv_ctx_get_usage(slot.ctx.load(std::memory_order_relaxed), &usage);
+        usage.key_id = static_cast<uint32_t>(tag >> 32);
+    }
+    *count_out = keyring->count;
+    return AESGCMSIV_SUCCESS;
+}
+
+void aesgcmsiv_keyring_free(aesgcmsiv_keyring* keyring)
+{
+    if (!keyring) {
+        return;
+    }
+    for (aesgcmsiv_ctx* ctx : keyring->contexts) {
+        aesgcmsiv_ctx_free(ctx);
+    }
+    OPENSSL_cleanse(&keyring->secret, sizeof(keyring->secret));
+    delete keyring;
+}
+
+// Size of the random value naming a derivation's entries in a key cache
+#define KDF_DOMAIN_SIZE 16
+
+static_assert(KDF_DOMAIN_SIZE + AESGCMSIV_KDF_CACHED_ID_MAX <= KEY_CACHE_MAX_NAME,
+    "a derived entry's name must fit a key cache entry");
+
+// Items derived and run together, so their subkeys and schedules fit on the
+// stack and the hashing has enough IDs to fill its lanes
+#define KDF_CHUNK 64
+
+// prk holds the HMAC pads of the extracted key, so expanding a record ID
+// never rehashes them
+struct aesgcmsiv_kdf {
+    const aesgcmsiv_kernel* kernel;  // NULL when using the crypto library
+    hmac_sha256_key prk;
+    size_t key_len;
+    uint8_t domain[KDF_DOMAIN_SIZE];
+    std::atomic<aesgcmsiv_key_cache*> cache;  // see aesgcmsiv_kdf_set_cache
+};
+
+static int validate_kdf_ids(size_t count, const aesgcmsiv_iovec* ids)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (ids[i].len > 0 && !ids[i].data) {
+            return AESGCMSIV_ERROR_INVALID_INPUT;
+        }
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_kdf_new(
+    const uint8_t* master_key, size_t master_len,
+    const uint8_t* salt, size_t salt_len,
+    size_t key_len,
+    aesgcmsiv_kdf** kdf_out)
+{
+    if (!kdf_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *kdf_out = nullptr;
+    if (!master_key || master_len == 0 ||
+        (key_len != AESGCMSIV_KEY_SIZE_128 && key_len != AESGCMSIV_KEY_SIZE_256)) {
+        return AESGCMSIV_ERROR_INVALID_KEY;
+    }
+    if (salt_len > 0 && !salt) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    aesgcmsiv_kdf* kdf = aesgcmsiv_secure_new<aesgcmsiv_kdf>();
+    if (!kdf) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    kdf->kernel = active_kernel();
+    kdf->key_len = key_len;
+    int result = crypto_random(kdf->domain, sizeof(kdf->domain));
+    if (result != AESGCMSIV_SUCCESS) {
+        aesgcmsiv_secure_delete(kdf);
+        return result;
+    }
+    aesgcmsiv_hkdf_extract(g_registry.cpu_features, salt, salt_len, master_key, master_len, &kdf->prk);
+    *kdf_out = kdf;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_kdf_set_cache(aesgcmsiv_kdf* kdf, aesgcmsiv_key_cache* cache)
+{
+    if (!kdf) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    kdf->cache.store(cache, std::memory_order_release);
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_kdf_derive_batch(
+    aesgcmsiv_kdf* kdf,
+    size_t count,
+    const aesgcmsiv_iovec* ids,
+    uint8_t* keys_out)
+{
+    if (!kdf || (count > 0 && (!ids || !keys_out))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    int validation_result = validate_kdf_ids(count, ids);
+    if (validation_result != AESGCMSIV_SUCCESS) {
+        return validation_result;
+    }
+    aesgcmsiv_hkdf_expand_batch(g_registry.cpu_features, &kdf->prk, count, ids, kdf->key_len, keys_out);
+    return AESGCMSIV_SUCCESS;
+}
+
+// Adds the schedules of freshly derived records to the cache, under one
+// hold of its lock. The contexts are built before taking it.
+static void kdf_cache_insert(
+    aesgcmsiv_kdf* kdf, aesgcmsiv_key_cache* cache,
+    const uint8_t (*names)[KEY_CACHE_MAX_NAME], const size_t* name_lens, const uint64_t* hashes,
+    const size_t* missing, size_t misses, const aes_key_schedule* schedules)
+{
+    key_cache_entry* entries[KDF_CHUNK];
+    size_t added = 0;
+    for (size_t m = 0; m < misses; m++) {
+        const size_t i = missing[m];
+        if (name_lens[i] == 0) {
+            continue;
+        }
+        key_cache_entry* entry = aesgcmsiv_secure_new<key_cache_entry>();
+        aesgcmsiv_ctx* ctx = entry ? aesgcmsiv_secure_new<aesgcmsiv_ctx>() : nullptr;
+        if (!ctx) {
+            aesgcmsiv_secure_delete(entry);
+            break;
+        }
+        ctx->threads = 1;
+        ctx->kernel = kdf->kernel;
+        ctx->key_schedule = schedules[i];
+        entry->hash = hashes[i];
+        entry->key_len = name_lens[i];
+        memcpy(entry->key, names[i], name_lens[i]);
+        entry->derived = true;
+        entry->ctx = ctx;
+        entries[added++] = entry;
+    }
+
+    std::lock_guard<std::mutex> guard(cache->lock);
+    for (size_t a = 0; a < added; a++) {
+        key_cache_entry* entry = entries[a];
+        if (cache->capacity == 0 ||
+            key_cache_find(cache, entry->hash, entry->key, entry->key_len, true)) {
+            // Caching nothing, or another thread added the record meanwhile
+            aesgcmsiv_ctx_free(entry->ctx);
+            aesgcmsiv_secure_delete(entry);
+            continue;
+        }
+        key_cache_insert(cache, entry);
+    }
+}
+
+// Fills schedules[i] with the expanded subkey for record ids[i], for each
+// of count items whose status is AESGCMSIV_SUCCESS (every item if status is
+// NULL). Records in the cache are copied from it; the rest are derived as
+// one batch and then added to it.
+static void kdf_schedules(
+    aesgcmsiv_kdf* kdf, size_t count, const aesgcmsiv_iovec* ids, const int* status,
+    aes_key_schedule* schedules)
+{
+    aesgcmsiv_key_cache* cache = kdf->cache.load(std::memory_order_acquire);
+    uint8_t names[KDF_CHUNK][KEY_CACHE_MAX_NAME];
+    size_t name_lens[KDF_CHUNK] = {};  // 0 for an item not cached
+    uint64_t hashes[KDF_CHUNK];
+    bool found[KDF_CHUNK] = {};
+    if (cache) {
+        for (size_t i = 0; i < count; i++) {
+            if ((status && status[i] != AESGCMSIV_SUCCESS) || ids[i].len > AESGCMSIV_KDF_CACHED_ID_MAX) {
+                continue;
+            }
+            memcpy(names[i], kdf->domain, KDF_DOMAIN_SIZE);
+            if (ids[i].len > 0) {
+                memcpy(names[i] + KDF_DOMAIN_SIZE, ids[i].data, ids[i].len);
+            }
+            name_lens[i] = KDF_DOMAIN_SIZE + ids[i].len;
+            hashes[i] = key_cache_hash(cache, names[i], name_lens[i]);
+        }
+        std::lock_guard<std::mutex> guard(cache->lock);
+        for (size_t i = 0; i < count; i++) {
+            if (name_lens[i] == 0) {
+                continue;
+            }
+            if (key_cache_entry* entry = key_cache_find(cache, hashes[i], names[i], name_lens[i], true)) {
+                key_cache_touch(cache, entry);
+                schedules[i] = entry->ctx->key_schedule;
+                found[i] = true;
+            }
+        }
+    }
+
+    aesgcmsiv_iovec infos[KDF_CHUNK];
+    size_t missing[KDF_CHUNK];
+    size_t misses = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!found[i] && (!status || status[i] == AESGCMSIV_SUCCESS)) {
+            missing[misses] = i;
+            infos[misses++] = ids[i];
+        }
+    }
+    if (misses > 0) {
+        uint8_t keys[KDF_CHUNK * AESGCMSIV_KEY_SIZE];
+        aesgcmsiv_hkdf_expand_batch(g_registry.cpu_features, &kdf->prk, misses, infos, kdf->key_len, keys);
+        for (size_t m = 0; m < misses; m++) {
+            kdf->kernel->expand_key(keys + m * kdf->key_len, kdf->key_len, &schedules[missing[m]]);
+        }
+        OPENSSL_cleanse(keys, sizeof(keys));
+        if (cache) {
+            kdf_cache_insert(kdf, cache, names, name_lens, hashes, missing, misses, schedules);
+        }
+    }
+    OPENSSL_cleanse(names, sizeof(names));
+}
+
+int aesgcmsiv_kdf_encrypt_batch(
+    aesgcmsiv_kdf* kdf,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const aesgcmsiv_iovec* ids)
+{
+    StatsScope stats(AESGCMSIV_OP_ENCRYPT, StatsScope::Batch{count});
+    if (!kdf || (count > 0 && (!items || !ids))) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+
+    // As in aesgcmsiv_encrypt_batch, with a bad record ID counting as an
+    // invalid item
+    size_t valid = 0;
+    uint64_t valid_bytes = 0;
+    int validation_result = AESGCMSIV_SUCCESS;
+    for (; valid < count; valid++) {
+        const aesgcmsiv_batch_item& item = items[valid];
+        validation_result = validate_kdf_ids(1, &ids[valid]);
+        if (validation_result == AESGCMSIV_SUCCESS) {
+            validation_result = validate_encrypt_params(
+                item.nonce, AESGCMSIV_NONCE_SIZE, item.input, item.input_len, item.aad_len,
+                item.output, item.tag);
+        }
+        if (validation_result != AESGCMSIV_SUCCESS) {
+            break;
+        }
+        valid_bytes += item.input_len;
+    }
+    stats.setup_done(backend_name(kdf->kernel), vector_bits(kdf->kernel, batch_mean_len(items, count)));
+    const size_t calls = valid + (validation_result != AESGCMSIV_SUCCESS);
+
+    if (kdf->kernel) {
+        alignas(KEY_TABLE_ALIGNMENT) aes_key_schedule schedules[KDF_CHUNK];
+        uint32_t slots[KDF_CHUNK];
+        for (uint32_t i = 0; i < KDF_CHUNK; i++) {
+            slots[i] = i;
+        }
+        for (size_t begin = 0; begin < valid; begin += KDF_CHUNK) {
+            const size_t n = std::min<size_t>(KDF_CHUNK, valid - begin);
+            kdf_schedules(kdf, n, ids + begin, nullptr, schedules);
+            kernel_seal_batch_keyed(kdf->kernel, schedules, slots, items + begin, n);
+        }
+        OPENSSL_cleanse(schedules, sizeof(schedules));
+        return stats.finish_batch(validation_result, calls, valid_bytes);
+    }
+
+    uint8_t keys[KDF_CHUNK * AESGCMSIV_KEY_SIZE];
+    uint64_t bytes = 0;
+    for (size_t begin = 0; begin < valid; begin += KDF_CHUNK) {
+        const size_t n = std::min<size_t>(KDF_CHUNK, valid - begin);
+        aesgcmsiv_hkdf_expand_batch(g_registry.cpu_features, &kdf->prk, n, ids + begin, kdf->key_len, keys);
+        for (size_t i = 0; i < n; i++) {
+            const aesgcmsiv_batch_item& item = items[begin + i];
+            int result = encrypt_impl(stats, keys + i * kdf->key_len, kdf->key_len,
+                item.nonce, AESGCMSIV_NONCE_SIZE,
+                item.input, item.input_len,
+                item.aad, item.aad_len,
+                item.output, item.tag);
+            if (result != AESGCMSIV_SUCCESS) {
+                OPENSSL_cleanse(keys, sizeof(keys));
+                return stats.finish_batch(result, begin + i + 1, bytes);
+            }
+            bytes += item.input_len;
+        }
+    }
+    OPENSSL_cleanse(keys, sizeof(keys));
+    return stats.finish_batch(validation_result, calls, valid_bytes);
+}
+
+int aesgcmsiv_kdf_decrypt_batch(
+    aesgcmsiv_kdf* kdf,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const aesgcmsiv_iovec* ids,
+    int* status_out)
+{
+    StatsScope stats(AESGCMSIV_OP_DECRYPT, StatsScope::Batch{count});
+    if (!kdf || (count > 0 && (!items || !ids || !status_out))) {
+        return stats.finish(AESGCMSIV_ERROR_INVALID_INPUT, 0);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const aesgcmsiv_batch_item& item = items[i];
+        status_out[i] = validate_kdf_ids(1, &ids[i]);
+        if (status_out[i] == AESGCMSIV_SUCCESS) {
+            status_out[i] = validate_decrypt_params(
+                item.nonce, AESGCMSIV_NONCE_SIZE, item.input, item.input_len, item.aad_len,
+                item.tag, item.output);
+        }
+    }
+    stats.setup_done(backend_name(kdf->kernel), vector_bits(kdf->kernel, batch_mean_len(items, count)));
+
+    if (kdf->kernel) {
+        alignas(KEY_TABLE_ALIGNMENT) aes_key_schedule schedules[KDF_CHUNK];
+        uint32_t slots[KDF_CHUNK];
+        for (uint32_t i = 0; i < KDF_CHUNK; i++) {
+            slots[i] = i;
+        }
+        for (size_t begin = 0; begin < count; begin += KDF_CHUNK) {
+            const size_t n = std::min<size_t>(KDF_CHUNK, count - begin);
+            kdf_schedules(kdf, n, ids + begin, status_out + begin, schedules);
+            kernel_open_batch_keyed(kdf->kernel, schedules, slots, items + begin, n, status_out + begin);
+        }
+        OPENSSL_cleanse(schedules, sizeof(schedules));
+    } else {
+        uint8_t key[AESGCMSIV_KEY_SIZE];
+        for (size_t i = 0; i < count; i++) {
+            if (status_out[i] != AESGCMSIV_SUCCESS) {
+                continue;
+            }
+            const aesgcmsiv_batch_item& item = items[i];
+            aesgcmsiv_hkdf_expand_batch(g_registry.cpu_features, &kdf->prk, 1, &ids[i], kdf->key_len, key);
+            status_out[i] = decrypt_impl(stats, key, kdf->key_len,
+                item.nonce, AESGCMSIV_NONCE_SIZE,
+                item.input, item.input_len,
+                item.aad, item.aad_len,
+                item.tag, item.output);
+        }
+        OPENSSL_cleanse(key, sizeof(key));
+    }
+    stats.finish_items(items, count, status_out);
+
+    for (size_t i = 0; i < count; i++) {
+        if (status_out[i] != AESGCMSIV_SUCCESS) {
+            return status_out[i];
+        }
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+void aesgcmsiv_kdf_free(aesgcmsiv_kdf* kdf)
+{
+    if (!kdf) {
+        return;
+    }
+    aesgcmsiv_secure_delete(kdf);
+}
+
+int aesgcmsiv_init(uint32_t flags)
+{
+    if (flags & ~AESGCMSIV_INIT_NO_LOAD_CONFIG) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (active_kernel()) {
+        return AESGCMSIV_SUCCESS;
+    }
+
+    return crypto_init((flags & AESGCMSIV_INIT_NO_LOAD_CONFIG) != 0);
+}
+
+unsigned long aesgcmsiv_get_openssl_error(void)
+{
+    return crypto_last_error();
+}
+
+int aesgcmsiv_get_backend(const char** name_out, uint32_t* features_out)
+{
+    if (!name_out || !features_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *name_out = backend_name(active_kernel());
+    *features_out = g_registry.cpu_features;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_select_backend(const char* name)
+{
+    if (!name) {
+        g_backend.store(&g_registry.backends[0], std::memory_order_relaxed);
+        return AESGCMSIV_SUCCESS;
+    }
+    for (size_t i = 0; i < g_registry.count; i++) {
+        if (strcmp(backend_name(g_registry.backends[i].kernel), name) == 0) {
+            g_backend.store(&g_registry.backends[i], std::memory_order_relaxed);
+            return AESGCMSIV_SUCCESS;
+        }
+    }
+    return AESGCMSIV_ERROR_NOT_FOUND;
+}
+
+// Most reference cycles per 1000 bytes a healthy host takes to encrypt
+// AESGCMSIV_PROBE_DEFAULT_BYTES under AES-256, about twice the typical
+// figure. Only the x86 time stamp counter counts cycles at a fixed rate, so
+// other targets have no references.
+struct probe_reference {
+    const char* backend;
+    uint64_t millicycles_per_byte;
+};
+
+static const probe_reference probe_references[] = {
+#if defined(__x86_64__) || defined(_M_X64)
+    {"vaes-avx512", 2000},
+    {"aesni", 4000},
+    {"bitsliced-ct64", 80000},
+#endif
+    {nullptr, 0},
+};
+
+int aesgcmsiv_probe(size_t bytes, unsigned int runs, aesgcmsiv_probe_result* result_out)
+{
+    if (!result_out || bytes > AESGCMSIV_PROBE_MAX_BYTES || runs > AESGCMSIV_PROBE_MAX_RUNS) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    bytes = bytes ? bytes : AESGCMSIV_PROBE_DEFAULT_BYTES;
+    runs = runs ? runs : AESGCMSIV_PROBE_DEFAULT_RUNS;
+
+    // Arbitrary but fixed, so every probe does the same work
+    static const uint8_t key[32] = {
+        0x41, 0x45, 0x53, 0x2d, 0x47, 0x43, 0x4d, 0x2d, 0x53, 0x49, 0x56, 0x20, 0x70, 0x72, 0x6f, 0x62,
+        0x65, 0x20, 0x6b, 0x65, 0x79, 0x2c, 0x20, 0x6e, 0x6f, 0x74, 0x20, 0x73, 0x65, 0x63, 0x72, 0x65,
+    };
+    static const uint8_t nonce[AESGCMSIV_NONCE_SIZE] = {};
+    std::unique_ptr<uint8_t[]> buffer(new (std::nothrow) uint8_t[2 * bytes]);
+    if (!buffer) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    memset(buffer.get(), 0x5a, bytes);
+    aesgcmsiv_ctx* ctx = nullptr;
+    int status = aesgcmsiv_ctx_new(key, sizeof(key), &ctx);
+    if (status != AESGCMSIV_SUCCESS) {
+        return status;
+    }
+
+    uint8_t tag[AESGCMSIV_TAG_SIZE];
+    uint64_t best_cycles = UINT64_MAX;
+    uint64_t best_ns = UINT64_MAX;
+    // Run 0 warms the caches and is not timed
+    for (unsigned int run = 0; run <= runs && status == AESGCMSIV_SUCCESS; run++) {
+        uint64_t start_ns = aesgcmsiv_stats_now();
+        uint64_t start_cycles = aesgcmsiv_cycles();
+        status = aesgcmsiv_ctx_encrypt(ctx, nonce, sizeof(nonce), buffer.get(), bytes,
+            nullptr, 0, buffer.get() + bytes, tag);
+        uint64_t cycles = aesgcmsiv_cycles() - start_cycles;
+        uint64_t ns = aesgcmsiv_stats_now() - start_ns;
+        if (run) {
+            best_cycles = std::min(best_cycles, cycles);
+            best_ns = std::min(best_ns, ns);
+        }
+    }
+    const char* backend = backend_name(ctx->kernel);
+    aesgcmsiv_ctx_free(ctx);
+    if (status != AESGCMSIV_SUCCESS) {
+        return status;
+    }
+
+    result_out->backend = backend;
+    result_out->bytes = bytes;
+    result_out->cycles = best_cycles;
+    result_out->ns = best_ns;
+    result_out->expected_cycles = 0;
+    for (const probe_reference* reference = probe_references; reference->backend; reference++) {
+        if (strcmp(reference->backend, backend) == 0) {
+            result_out->expected_cycles = bytes * reference->millicycles_per_byte / 1000;
+        }
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+void aesgcmsiv_nop(void)
+{
 }
 
 } // extern "C"
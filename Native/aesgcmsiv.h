@@ -4,7 +4,9 @@
 #include <stdint.h>
 #include <stddef.h>
 
-#ifdef _WIN32
+// AESGCMSIV_STATIC is defined when building or linking the static archive
+// (aesgcmsiv_static in CMake), whose functions are not DLL exports
+#if defined(_WIN32) && !defined(AESGCMSIV_STATIC)
 #define AESGCMSIV_API __declspec(dllexport)
 #else
 #define AESGCMSIV_API
@@ -22,24 +24,121 @@ extern "C" {
 #define AESGCMSIV_ERROR_INVALID_TAG -4
 #define AESGCMSIV_ERROR_DECRYPT_FAILED -5
 #define AESGCMSIV_ERROR_INTERNAL -6
+#define AESGCMSIV_ERROR_BUSY -7  // an engine's queue is full; retry later
+#define AESGCMSIV_ERROR_IO -8  // a file could not be opened, sized or mapped
+#define AESGCMSIV_ERROR_NOT_FOUND -9  // a pack or keyring holds no entry with the id
+
+// Not an error: an asynchronous job was paused and must be polled again
+#define AESGCMSIV_PENDING 1
 
 // Constants
-#define AESGCMSIV_KEY_SIZE 32  // 256-bit key
+#define AESGCMSIV_KEY_SIZE_128 16  // AES-128-GCM-SIV key
+#define AESGCMSIV_KEY_SIZE_256 32  // AES-256-GCM-SIV key
+#define AESGCMSIV_KEY_SIZE AESGCMSIV_KEY_SIZE_256  // largest supported key
 #define AESGCMSIV_NONCE_SIZE 12  // 96-bit nonce
 #define AESGCMSIV_TAG_SIZE 16   // 128-bit authentication tag
+#define AESGCMSIV_MAX_INPUT_SIZE (1ULL << 36)  // RFC 8452 limit on plaintext and AAD
+#define AESGCMSIV_SMALL_MAX_SIZE 256  // plaintext and AAD limit of the _small entry points
+#define AESGCMSIV_SEAL_OVERHEAD (AESGCMSIV_NONCE_SIZE + AESGCMSIV_TAG_SIZE)  // nonce || ciphertext || tag
+#define AESGCMSIV_NONCE_CACHE_MAX 4096  // largest aesgcmsiv_ctx_set_nonce_cache size
+
+// CPU feature bits reported by aesgcmsiv_get_backend
+#define AESGCMSIV_CPU_AESNI       (1u << 0)
+#define AESGCMSIV_CPU_PCLMULQDQ   (1u << 1)
+#define AESGCMSIV_CPU_SSE41       (1u << 2)
+#define AESGCMSIV_CPU_AVX2        (1u << 3)  // with OS support for YMM state
+#define AESGCMSIV_CPU_AVX512      (1u << 4)  // F, BW and VL, with OS support for ZMM state
+#define AESGCMSIV_CPU_VAES        (1u << 5)
+#define AESGCMSIV_CPU_VPCLMULQDQ  (1u << 6)
+#define AESGCMSIV_CPU_SHA         (1u << 7)  // SHA-NI (SHA-1 and SHA-256)
+#define AESGCMSIV_CPU_ARMV8_AES   (1u << 8)
+#define AESGCMSIV_CPU_ARMV8_PMULL (1u << 9)
+
+// Flags for aesgcmsiv_init
+#define AESGCMSIV_INIT_NO_LOAD_CONFIG (1u << 0)  // don't read the OpenSSL config file
+
+// Flags for aesgcmsiv_pool_create_ex
+#define AESGCMSIV_POOL_PIN_NODES (1u << 0)  // spread workers over the NUMA nodes and pin each to its node
+#define AESGCMSIV_POOL_NODE_LOCAL (1u << 1)  // also run work on the node holding its input; implies PIN_NODES
+
+// Flags for aesgcmsiv_alloc
+#define AESGCMSIV_ALLOC_HUGE_PAGES (1u << 0)  // back with 2 MB pages where the OS allows
+#define AESGCMSIV_ALLOC_LOCKED (1u << 1)  // lock in RAM (mlock, VirtualLock); fail if that is refused
+#define AESGCMSIV_ALLOC_NODE(node) ((((uint32_t)(node)) + 1u) << 8)  // place on NUMA node, numbered from 0
+
+/**
+ * Opaque key context. Holds a keyed encryption and decryption state so
+ * repeated calls with the same key skip the per-call context allocation and
+ * key schedule.
+ *
+ * A context may be shared by any number of threads: the key state is
+ * immutable after aesgcmsiv_ctx_new and every call keeps its working state
+ * to itself. aesgcmsiv_ctx_set_threads may also be called concurrently with
+ * other calls. Only aesgcmsiv_ctx_free must not overlap any other use.
+ */
+typedef struct aesgcmsiv_ctx aesgcmsiv_ctx;
+
+/**
+ * Opaque handle to a pool of worker threads that contexts can borrow for
+ * parallel calls instead of starting threads per call. Each worker keeps its
+ * own deque of tasks and an idle worker steals from the busy ones.
+ */
+typedef struct aesgcmsiv_pool aesgcmsiv_pool;
+
+/**
+ * Opaque handle to an encrypt or decrypt job started by
+ * aesgcmsiv_ctx_encrypt_submit or aesgcmsiv_ctx_decrypt_submit that has not
+ * finished yet.
+ */
+typedef struct aesgcmsiv_job aesgcmsiv_job;
+
+/**
+ * One message in a batch call. The nonce is AESGCMSIV_NONCE_SIZE bytes and
+ * the tag AESGCMSIV_TAG_SIZE bytes.
+ */
+typedef struct aesgcmsiv_batch_item {
+    const uint8_t* nonce;
+    const uint8_t* input;  // plaintext when encrypting, ciphertext when decrypting
+    size_t input_len;
+    const uint8_t* aad;  // can be NULL
+    size_t aad_len;
+    uint8_t* output;  // at least input_len bytes; may equal input
+    uint8_t* tag;  // written when encrypting, read when decrypting
+} aesgcmsiv_batch_item;
+
+/**
+ * One segment of a scattered input or output buffer. data may be NULL when
+ * len is 0.
+ */
+typedef struct aesgcmsiv_iovec {
+    const uint8_t* data;
+    size_t len;
+} aesgcmsiv_iovec;
+
+typedef struct aesgcmsiv_iovec_out {
+    uint8_t* data;
+    size_t len;
+} aesgcmsiv_iovec_out;
 
 /**
  * Encrypts plaintext using AES-GCM-SIV.
+ *
+ * Plaintext and AAD may each be up to AESGCMSIV_MAX_INPUT_SIZE bytes. When
+ * the library falls back to OpenSSL (see aesgcmsiv_get_backend) each is
+ * limited to INT_MAX bytes instead; longer inputs are rejected, never
+ * truncated.
  * 
- * @param key Pointer to 32-byte key
- * @param key_len Length of key (must be 32)
+ * @param key Pointer to 16-byte (AES-128) or 32-byte (AES-256) key
+ * @param key_len Length of key (must be 16 or 32)
  * @param nonce Pointer to 12-byte nonce
  * @param nonce_len Length of nonce (must be 12)
  * @param plaintext Pointer to plaintext data
  * @param plaintext_len Length of plaintext
  * @param aad Pointer to additional authenticated data (can be NULL)
  * @param aad_len Length of additional authenticated data
- * @param ciphertext_out Output buffer for ciphertext (must be at least plaintext_len bytes)
+ * @param ciphertext_out Output buffer for ciphertext (must be at least plaintext_len bytes).
+ *        May be the plaintext buffer itself to encrypt in place; any other
+ *        overlap with the plaintext is not supported.
  * @param tag_out Output buffer for authentication tag (must be at least 16 bytes)
  * 
  * @return AESGCMSIV_SUCCESS on success, negative error code on failure
@@ -54,9 +153,11 @@ AESGCMSIV_API int aesgcmsiv_encrypt(
 
 /**
  * Decrypts ciphertext using AES-GCM-SIV.
+ *
+ * Length limits follow aesgcmsiv_encrypt.
  * 
- * @param key Pointer to 32-byte key
- * @param key_len Length of key (must be 32)
+ * @param key Pointer to 16-byte (AES-128) or 32-byte (AES-256) key
+ * @param key_len Length of key (must be 16 or 32)
  * @param nonce Pointer to 12-byte nonce
  * @param nonce_len Length of nonce (must be 12)
  * @param ciphertext Pointer to ciphertext data
@@ -64,7 +165,9 @@ AESGCMSIV_API int aesgcmsiv_encrypt(
  * @param aad Pointer to additional authenticated data (can be NULL)
  * @param aad_len Length of additional authenticated data
  * @param tag Pointer to 16-byte authentication tag
- * @param plaintext_out Output buffer for plaintext (must be at least ciphertext_len bytes)
+ * @param plaintext_out Output buffer for plaintext (must be at least ciphertext_len bytes).
+ *        May be the ciphertext buffer itself to decrypt in place; any other
+ *        overlap with the ciphertext is not supported.
  * 
  * @return AESGCMSIV_SUCCESS on success, negative error code on failure
  */
@@ -76,6 +179,3823 @@ AESGCMSIV_API int aesgcmsiv_decrypt(
     const uint8_t* tag,
     uint8_t* plaintext_out);
 
+/**
+ * aesgcmsiv_encrypt for short messages, with a bounded running time.
+ *
+ * Plaintext and AAD are each limited to AESGCMSIV_SMALL_MAX_SIZE bytes. The
+ * call never blocks, allocates or takes a lock, so managed callers may skip
+ * the GC transition. It needs a hand-written kernel and returns
+ * AESGCMSIV_ERROR_INTERNAL when the library falls back to OpenSSL.
+ *
+ * For the same reason the _small calls only fire their tracepoints: the
+ * counters, the phase profile, slow-operation reports and call recording
+ * leave them out.
+ *
+ * Parameters and output buffers follow aesgcmsiv_encrypt.
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_encrypt_small(
+    const uint8_t* key, size_t key_len,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out);
+
+/**
+ * aesgcmsiv_decrypt for short messages; limits and guarantees follow
+ * aesgcmsiv_encrypt_small.
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_decrypt_small(
+    const uint8_t* key, size_t key_len,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out);
+
+/**
+ * Encrypts plaintext into the combined wire format nonce || ciphertext || tag.
+ *
+ * Length limits follow aesgcmsiv_encrypt.
+ *
+ * @param key Pointer to 16-byte (AES-128) or 32-byte (AES-256) key
+ * @param key_len Length of key (must be 16 or 32)
+ * @param nonce Pointer to 12-byte nonce
+ * @param nonce_len Length of nonce (must be 12)
+ * @param plaintext Pointer to plaintext data
+ * @param plaintext_len Length of plaintext
+ * @param aad Pointer to additional authenticated data (can be NULL)
+ * @param aad_len Length of additional authenticated data
+ * @param sealed_out Output buffer (must be at least plaintext_len +
+ *        AESGCMSIV_SEAL_OVERHEAD bytes). The plaintext may already sit at
+ *        sealed_out + AESGCMSIV_NONCE_SIZE to seal in place; any other
+ *        overlap with the plaintext is not supported.
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_seal(
+    const uint8_t* key, size_t key_len,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* sealed_out);
+
+/**
+ * Verifies and decrypts a buffer laid out as nonce || ciphertext || tag.
+ *
+ * @param key Pointer to 16-byte (AES-128) or 32-byte (AES-256) key
+ * @param key_len Length of key (must be 16 or 32)
+ * @param sealed Pointer to the sealed message
+ * @param sealed_len Length of the sealed message (at least AESGCMSIV_SEAL_OVERHEAD)
+ * @param aad Pointer to additional authenticated data (can be NULL)
+ * @param aad_len Length of additional authenticated data
+ * @param plaintext_out Output buffer for plaintext (must be at least
+ *        sealed_len - AESGCMSIV_SEAL_OVERHEAD bytes). May be
+ *        sealed + AESGCMSIV_NONCE_SIZE to open in place; any other overlap
+ *        with the sealed message is not supported. Zeroed if the tag does
+ *        not verify.
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_open(
+    const uint8_t* key, size_t key_len,
+    const uint8_t* sealed, size_t sealed_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* plaintext_out);
+
+// Characters in the unpadded base64url (RFC 4648, section 5) encoding of n bytes
+#define AESGCMSIV_B64URL_LEN(n) ((n) / 3 * 4 + ((n) % 3 == 0 ? 0 : (n) % 3 + 1))
+// Characters in a token sealing plaintext_len bytes: base64url(nonce || ciphertext || tag)
+#define AESGCMSIV_TOKEN_LEN(plaintext_len) AESGCMSIV_B64URL_LEN((plaintext_len) + AESGCMSIV_SEAL_OVERHEAD)
+
+/**
+ * aesgcmsiv_seal, writing the sealed message as a URL-safe token:
+ * nonce || ciphertext || tag in unpadded base64url. The message is sealed
+ * into token_out and encoded there while it is still in cache, with no
+ * intermediate buffer.
+ *
+ * @param key Pointer to 16-byte (AES-128) or 32-byte (AES-256) key
+ * @param key_len Length of key (must be 16 or 32)
+ * @param nonce Pointer to 12-byte nonce
+ * @param nonce_len Length of nonce (must be 12)
+ * @param plaintext Pointer to plaintext data
+ * @param plaintext_len Length of plaintext
+ * @param aad Pointer to additional authenticated data (can be NULL)
+ * @param aad_len Length of additional authenticated data
+ * @param token_out Output buffer of at least AESGCMSIV_TOKEN_LEN(plaintext_len)
+ *        characters, not NUL-terminated. Must not overlap the nonce or
+ *        the plaintext.
+ * @param token_len_out Receives the token length
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_seal_b64url(
+    const uint8_t* key, size_t key_len,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    char* token_out,
+    size_t* token_len_out);
+
+/**
+ * Verifies and decrypts a token written by aesgcmsiv_seal_b64url. The
+ * ciphertext is decoded straight into plaintext_out and decrypted in place.
+ *
+ * Tokens are strict: padding, whitespace, characters outside the base64url
+ * alphabet and nonzero unused bits in the last character are all rejected
+ * with AESGCMSIV_ERROR_INVALID_INPUT, so a message has exactly one token.
+ *
+ * @param key Pointer to 16-byte (AES-128) or 32-byte (AES-256) key
+ * @param key_len Length of key (must be 16 or 32)
+ * @param token Pointer to the token characters
+ * @param token_len Length of the token (at least AESGCMSIV_TOKEN_LEN(0))
+ * @param aad Pointer to additional authenticated data (can be NULL)
+ * @param aad_len Length of additional authenticated data
+ * @param plaintext_out Output buffer for plaintext, of at least
+ *        token_len * 3 / 4 - AESGCMSIV_SEAL_OVERHEAD bytes. Must not
+ *        overlap the token. Zeroed if the token does not decode or verify.
+ * @param plaintext_len_out Receives the plaintext length
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_open_b64url(
+    const uint8_t* key, size_t key_len,
+    const char* token, size_t token_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* plaintext_out,
+    size_t* plaintext_len_out);
+
+/**
+ * Encrypts a plaintext held in several segments, without first copying it
+ * into one buffer.
+ *
+ * Plaintext and AAD are the concatenation of their segments in order; no
+ * segment needs to be a multiple of the block size. The ciphertext is
+ * written across the output segments in order, which together must hold at
+ * least the plaintext length. The output may occupy the same memory as the
+ * plaintext byte for byte; any other overlap is not supported. Length limits
+ * apply to the totals and follow aesgcmsiv_encrypt. When the library falls
+ * back to OpenSSL the segments are gathered into temporary buffers.
+ *
+ * @param key Pointer to 16-byte (AES-128) or 32-byte (AES-256) key
+ * @param key_len Length of key (must be 16 or 32)
+ * @param nonce Pointer to 12-byte nonce
+ * @param nonce_len Length of nonce (must be 12)
+ * @param plaintext Array of plaintext_count segments
+ * @param plaintext_count Number of plaintext segments
+ * @param aad Array of aad_count AAD segments (can be NULL if aad_count is 0)
+ * @param aad_count Number of AAD segments
+ * @param ciphertext_out Array of ciphertext_count output segments
+ * @param ciphertext_count Number of output segments
+ * @param tag_out Output buffer for authentication tag (must be at least 16 bytes)
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_encryptv(
+    const uint8_t* key, size_t key_len,
+    const uint8_t* nonce, size_t nonce_len,
+    const aesgcmsiv_iovec* plaintext, size_t plaintext_count,
+    const aesgcmsiv_iovec* aad, size_t aad_count,
+    const aesgcmsiv_iovec_out* ciphertext_out, size_t ciphertext_count,
+    uint8_t* tag_out);
+
+/**
+ * Decrypts a ciphertext held in several segments.
+ *
+ * Segment rules follow aesgcmsiv_encryptv. If the tag does not verify, the
+ * first ciphertext-length bytes of the output are zeroed.
+ *
+ * @param key Pointer to 16-byte (AES-128) or 32-byte (AES-256) key
+ * @param key_len Length of key (must be 16 or 32)
+ * @param nonce Pointer to 12-byte nonce
+ * @param nonce_len Length of nonce (must be 12)
+ * @param ciphertext Array of ciphertext_count segments
+ * @param ciphertext_count Number of ciphertext segments
+ * @param aad Array of aad_count AAD segments (can be NULL if aad_count is 0)
+ * @param aad_count Number of AAD segments
+ * @param tag Pointer to 16-byte authentication tag
+ * @param plaintext_out Array of plaintext_count output segments
+ * @param plaintext_count Number of output segments
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_decryptv(
+    const uint8_t* key, size_t key_len,
+    const uint8_t* nonce, size_t nonce_len,
+    const aesgcmsiv_iovec* ciphertext, size_t ciphertext_count,
+    const aesgcmsiv_iovec* aad, size_t aad_count,
+    const uint8_t* tag,
+    const aesgcmsiv_iovec_out* plaintext_out, size_t plaintext_count);
+
+/**
+ * Creates a key context for repeated encryption and decryption under one key.
+ *
+ * @param key Pointer to 16-byte (AES-128) or 32-byte (AES-256) key
+ * @param key_len Length of key (must be 16 or 32)
+ * @param ctx_out Receives the new context on success; set to NULL on failure
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_new(
+    const uint8_t* key, size_t key_len,
+    aesgcmsiv_ctx** ctx_out);
+
+/**
+ * aesgcmsiv_ctx_new with an explicit OpenSSL provider and fetch properties,
+ * for hardware offload or a FIPS provider.
+ *
+ * When either is given the context always uses OpenSSL, never the library's
+ * own kernels, so the aesgcmsiv_ctx_*_small entry points return
+ * AESGCMSIV_ERROR_INTERNAL for it. The provider is loaded into the library's
+ * private OpenSSL library context and held until aesgcmsiv_ctx_free; its
+ * configuration, if any, must come from the OpenSSL config file.
+ *
+ * @param key Pointer to 16-byte (AES-128) or 32-byte (AES-256) key
+ * @param key_len Length of key (must be 16 or 32)
+ * @param provider Name of a provider to load, such as "fips" (can be NULL)
+ * @param properties Property query for the cipher fetch, such as "fips=yes"
+ *        (can be NULL)
+ * @param ctx_out Receives the new context on success; set to NULL on failure
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INTERNAL if the
+ *         provider cannot be loaded or offers no matching cipher, other
+ *         negative error codes on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_new_ex(
+    const uint8_t* key, size_t key_len,
+    const char* provider, const char* properties,
+    aesgcmsiv_ctx** ctx_out);
+
+/**
+ * Returns a new context for the same key as template, for code that wants a
+ * private context per thread or per connection. The expanded key schedule
+ * is copied, or on OpenSSL the keyed cipher contexts with
+ * EVP_CIPHER_CTX_copy, so neither the key schedule nor a provider fetch runs
+ * again; the clone is bound to the template's provider, if any. The thread
+ * count, pool, streaming and wide-vector thresholds are copied too; the
+ * nonce cache is not, so the clone starts without one. The clone is
+ * independent of template, which may be freed first.
+ *
+ * @param template_ctx Key context to copy; not changed, so it may be in use
+ *                     on other threads
+ * @param ctx_out Receives the new context on success; set to NULL on failure
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_clone(const aesgcmsiv_ctx* template_ctx, aesgcmsiv_ctx** ctx_out);
+
+/**
+ * Encrypts plaintext using a key context.
+ *
+ * Parameters and output buffers follow aesgcmsiv_encrypt.
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_encrypt(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out);
+
+/**
+ * Decrypts ciphertext using a key context.
+ *
+ * Parameters and output buffers follow aesgcmsiv_decrypt.
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_decrypt(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out);
+
+/**
+ * aesgcmsiv_ctx_encrypt that also returns a content hash of the plaintext,
+ * for deduplication and ETags, without a second pass over it: the
+ * plaintext is hashed a few kilobytes at a time beside the POLYVAL pass
+ * that computes the tag, while each piece is still in cache. The hash is
+ * XXH3-64 (xxHash 0.8) with seed 0, so it equals XXH3_64bits(plaintext,
+ * plaintext_len) from the reference library.
+ *
+ * The hash is sequential, so the call runs on the calling thread whatever
+ * aesgcmsiv_ctx_set_threads allows, and skips the nonce cache. A context on
+ * the crypto library, which has no POLYVAL pass of its own to join, hashes
+ * in a separate pass first.
+ *
+ * Parameters and output buffers follow aesgcmsiv_encrypt.
+ *
+ * @param hash_out Receives the hash of the plaintext
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_encrypt_hashed(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out,
+    uint64_t* hash_out);
+
+/**
+ * Authenticates AAD alone: the tag aesgcmsiv_ctx_encrypt gives for an
+ * empty plaintext. Runs only the key derivation, POLYVAL over the AAD and
+ * the tag's block encryption, with no counter setup, so large headers are
+ * authenticated at the cost of hashing them.
+ *
+ * Every encrypt and decrypt entry point also takes NULL message buffers
+ * when the message length is 0 and takes this path.
+ *
+ * @param tag_out Receives the AESGCMSIV_TAG_SIZE-byte tag
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_authenticate(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* tag_out);
+
+/**
+ * Checks a tag from aesgcmsiv_ctx_authenticate, in constant time.
+ *
+ * @return AESGCMSIV_SUCCESS if the tag matches, AESGCMSIV_ERROR_DECRYPT_FAILED
+ *         if it does not, other negative error codes on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_verify(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag);
+
+/**
+ * Checks that a message authenticates without producing its plaintext, for
+ * integrity scrubbing. The tag covers the plaintext, so the message is
+ * still decrypted, but with a kernel only into a small scratch buffer that
+ * stays in L1 and is overwritten chunk by chunk: no output buffer is needed
+ * and no plaintext is written out. The crypto library opens into a
+ * temporary buffer instead. Parameters follow aesgcmsiv_ctx_decrypt.
+ *
+ * @return AESGCMSIV_SUCCESS if the tag matches, AESGCMSIV_ERROR_DECRYPT_FAILED
+ *         if it does not, other negative error codes on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_verify_ciphertext(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag);
+
+/**
+ * Decrypts a message whose key is one of several candidates, such as a
+ * stored value that predates key IDs and may be under any key of a rotation
+ * window. The candidates are tried in order, newest first as a rule, and
+ * the first whose tag verifies decrypts the message; the rest are not
+ * tried. Parameters are checked once for all of them.
+ *
+ * Out of place, each attempt decrypts straight into plaintext_out, which a
+ * failed attempt leaves zeroed. In place, the ciphertext must survive a
+ * failed attempt, so every candidate but the last is only verified, as by
+ * aesgcmsiv_ctx_verify_ciphertext, and the one that matches then decrypts.
+ *
+ * @param ctxs The candidate key contexts, in the order to try them
+ * @param count Number of candidates
+ * @param index_out Receives the index in ctxs of the key that verified, or
+ *        count if none did (can be NULL)
+ *
+ * Other parameters follow aesgcmsiv_ctx_decrypt.
+ *
+ * @return AESGCMSIV_SUCCESS if a candidate verified,
+ *         AESGCMSIV_ERROR_DECRYPT_FAILED if none did (plaintext_out is then
+ *         zeroed), other negative error codes on failure
+ */
+AESGCMSIV_API int aesgcmsiv_open_trial(
+    aesgcmsiv_ctx* const* ctxs, size_t count,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out,
+    size_t* index_out);
+
+/**
+ * Opaque handle to one message on a key context whose AAD arrives in
+ * pieces, such as a header assembled while it is parsed. With a kernel,
+ * each piece is folded into POLYVAL as it is added, so the AAD is never
+ * concatenated or read twice; the crypto library takes AAD in one call, so
+ * there the pieces are gathered into a buffer instead.
+ *
+ * A message is used by one thread at a time, and its context must outlive
+ * it. Once sealed, opened or fully emitted it takes no more calls other
+ * than aesgcmsiv_ctx_msg_free.
+ */
+typedef struct aesgcmsiv_ctx_msg aesgcmsiv_ctx_msg;
+
+/**
+ * Starts a message under nonce: derives the per-nonce keys and prepares
+ * POLYVAL for AAD.
+ *
+ * @param msg_out Receives the message on success; set to NULL on failure
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_begin(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    aesgcmsiv_ctx_msg** msg_out);
+
+/**
+ * Appends aad_len bytes to the message's AAD. Pieces may be any length; the
+ * AAD is their concatenation. aad may be NULL when aad_len is 0.
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if the
+ *         message is finished or the AAD would exceed
+ *         AESGCMSIV_MAX_INPUT_SIZE, other negative error codes on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_aad_update(
+    aesgcmsiv_ctx_msg* msg,
+    const uint8_t* aad, size_t aad_len);
+
+/**
+ * Encrypts plaintext under the message's nonce and AAD, and finishes it.
+ * Buffers follow aesgcmsiv_ctx_encrypt.
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_seal(
+    aesgcmsiv_ctx_msg* msg,
+    const uint8_t* plaintext, size_t plaintext_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out);
+
+/**
+ * Decrypts and verifies ciphertext under the message's nonce and AAD, and
+ * finishes it. Buffers follow aesgcmsiv_ctx_decrypt; plaintext_out is
+ * zeroed if the tag does not verify.
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_DECRYPT_FAILED if
+ *         the tag does not verify, other negative error codes on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_open(
+    aesgcmsiv_ctx_msg* msg,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out);
+
+/**
+ * Seals a message in two passes over plaintext that is not all in memory at
+ * once, such as a body arriving off the network. The tag depends on every
+ * plaintext byte and the ciphertext on the tag, so the plaintext is first
+ * absorbed piece by piece, then the tag is finished, then the same plaintext
+ * is passed again, in pieces of any size, to emit the ciphertext. The second
+ * pass must present exactly the bytes absorbed, in order; the library keeps
+ * none of them and cannot tell if they differ, and a message sealed from
+ * different bytes will not open.
+ *
+ * Needs a kernel: with the crypto library these return
+ * AESGCMSIV_ERROR_INTERNAL, as aesgcmsiv_ctx_encrypt_small does.
+ *
+ * aesgcmsiv_ctx_absorb_plaintext ends the AAD; plaintext may be NULL when
+ * plaintext_len is 0.
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if the
+ *         message is past absorbing or the plaintext would exceed
+ *         AESGCMSIV_MAX_INPUT_SIZE, other negative error codes on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_absorb_plaintext(
+    aesgcmsiv_ctx_msg* msg,
+    const uint8_t* plaintext, size_t plaintext_len);
+
+/**
+ * Finishes the tag over the AAD and absorbed plaintext, writing 16 bytes to
+ * tag_out. A message with no plaintext is finished here.
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_finalize_tag(aesgcmsiv_ctx_msg* msg, uint8_t* tag_out);
+
+/**
+ * Encrypts the next plaintext_len bytes of the absorbed plaintext into
+ * ciphertext_out, which may equal plaintext. The message is finished once
+ * every absorbed byte has been emitted.
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT before
+ *         aesgcmsiv_ctx_finalize_tag or if more is emitted than was
+ *         absorbed, other negative error codes on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_emit_ciphertext(
+    aesgcmsiv_ctx_msg* msg,
+    const uint8_t* plaintext, size_t plaintext_len,
+    uint8_t* ciphertext_out);
+
+/**
+ * Clears and frees a message, finished or not. NULL is allowed.
+ */
+AESGCMSIV_API void aesgcmsiv_ctx_msg_free(aesgcmsiv_ctx_msg* msg);
+
+/**
+ * aesgcmsiv_encrypt_small using a key context. Always runs on the calling
+ * thread, whatever aesgcmsiv_ctx_set_threads says.
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_encrypt_small(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out);
+
+/**
+ * aesgcmsiv_decrypt_small using a key context.
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_decrypt_small(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out);
+
+/**
+ * aesgcmsiv_ctx_encrypt without parameter checks, for bindings that have
+ * already validated everything, such as the .NET wrapper. Short messages
+ * then pay for one round of checks rather than two.
+ *
+ * The caller guarantees that ctx is a live context, that nonce points to
+ * AESGCMSIV_NONCE_SIZE bytes, that tag_out is not NULL, nor plaintext and
+ * ciphertext_out unless plaintext_len is 0, and that plaintext_len and
+ * aad_len are within AESGCMSIV_MAX_INPUT_SIZE. Anything else is undefined
+ * behaviour.
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_encrypt_unchecked(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out);
+
+/**
+ * aesgcmsiv_ctx_decrypt without parameter checks; the caller's guarantees
+ * follow aesgcmsiv_ctx_encrypt_unchecked, with tag not NULL, nor
+ * ciphertext and plaintext_out unless ciphertext_len is 0.
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_decrypt_unchecked(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out);
+
+/**
+ * aesgcmsiv_ctx_encrypt_small without parameter checks. On top of the
+ * guarantees of aesgcmsiv_ctx_encrypt_unchecked, plaintext_len and aad_len
+ * must not exceed AESGCMSIV_SMALL_MAX_SIZE. A context with no kernel of its
+ * own still returns AESGCMSIV_ERROR_INTERNAL.
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_encrypt_small_unchecked(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out);
+
+/**
+ * aesgcmsiv_ctx_decrypt_small without parameter checks, as
+ * aesgcmsiv_ctx_encrypt_small_unchecked.
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_decrypt_small_unchecked(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out);
+
+/**
+ * Fills nonce_out with AESGCMSIV_NONCE_SIZE random bytes.
+ *
+ * Nonces are drawn from OpenSSL's DRBG in bulk and handed out from a buffer
+ * per thread, so most calls are a copy. A child process never hands out
+ * the nonces its parent had buffered.
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INTERNAL if the
+ *         random generator failed
+ */
+AESGCMSIV_API int aesgcmsiv_random_nonce(uint8_t* nonce_out);
+
+/**
+ * Encrypts under a fresh random nonce (see aesgcmsiv_random_nonce) and
+ * writes nonce || ciphertext || tag, as aesgcmsiv_seal does, so the nonce
+ * needs no call or buffer of its own.
+ *
+ * @param ctx Key context
+ * @param plaintext Pointer to plaintext data
+ * @param plaintext_len Length of plaintext
+ * @param aad Pointer to additional authenticated data (can be NULL)
+ * @param aad_len Length of additional authenticated data
+ * @param sealed_out Output buffer (must be at least plaintext_len +
+ *        AESGCMSIV_SEAL_OVERHEAD bytes). The plaintext may already sit at
+ *        sealed_out + AESGCMSIV_NONCE_SIZE to seal in place; any other
+ *        overlap with the plaintext is not supported.
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_encrypt_autononce(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* sealed_out);
+
+/**
+ * aesgcmsiv_seal_b64url using a key context.
+ *
+ * @param nonce Pointer to 12-byte nonce, or NULL to draw a fresh one as
+ *        aesgcmsiv_ctx_encrypt_autononce does
+ * @param nonce_len Length of nonce (must be 12, or 0 with a NULL nonce)
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_seal_b64url(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    char* token_out,
+    size_t* token_len_out);
+
+/**
+ * aesgcmsiv_open_b64url using a key context.
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_open_b64url(
+    aesgcmsiv_ctx* ctx,
+    const char* token, size_t token_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* plaintext_out,
+    size_t* plaintext_len_out);
+
+/**
+ * aesgcmsiv_encryptv using a key context.
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_encryptv(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const aesgcmsiv_iovec* plaintext, size_t plaintext_count,
+    const aesgcmsiv_iovec* aad, size_t aad_count,
+    const aesgcmsiv_iovec_out* ciphertext_out, size_t ciphertext_count,
+    uint8_t* tag_out);
+
+/**
+ * aesgcmsiv_decryptv using a key context.
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_decryptv(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const aesgcmsiv_iovec* ciphertext, size_t ciphertext_count,
+    const aesgcmsiv_iovec* aad, size_t aad_count,
+    const uint8_t* tag,
+    const aesgcmsiv_iovec_out* plaintext_out, size_t plaintext_count);
+
+/**
+ * Sets how many threads aesgcmsiv_ctx_encrypt and aesgcmsiv_ctx_decrypt may
+ * use for one large message.
+ *
+ * Messages are only split once each thread gets at least 1 MiB; smaller
+ * messages run on the calling thread. The output is identical whatever the
+ * thread count. Contexts start with 1 thread. Has no effect when the
+ * library falls back to OpenSSL. Calls already running keep the count they
+ * started with.
+ *
+ * @param ctx Key context
+ * @param threads Maximum threads per call including the caller's; 0 uses
+ *        one per CPU the process may use (see aesgcmsiv_available_cpus)
+ *        and 1 disables splitting
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_set_threads(aesgcmsiv_ctx* ctx, unsigned int threads);
+
+/**
+ * Makes aesgcmsiv_ctx_encrypt and aesgcmsiv_ctx_decrypt write the output of
+ * messages of at least min_bytes with non-temporal stores, which go to
+ * memory without filling the cache, and prefetch the input just ahead of
+ * use without keeping it. Suits multi-gigabyte outputs, such as backups,
+ * that this process writes once and never reads back; cached, they would
+ * evict everything else from the last-level cache. Output not aligned to
+ * 16 bytes is written normally.
+ *
+ * Contexts start with streaming off. Currently x86 only; has no effect on
+ * other CPUs or when the library falls back to OpenSSL.
+ *
+ * @param ctx Key context
+ * @param min_bytes Smallest message to stream; 0 turns streaming off
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_set_streaming(aesgcmsiv_ctx* ctx, size_t min_bytes);
+
+/**
+ * Keeps messages shorter than min_bytes off 512-bit vectors. On some CPUs,
+ * Skylake-SP among them, sustained 512-bit work lowers the core's clock for
+ * a while afterwards, slowing latency-sensitive code that shares the core.
+ * Below min_bytes the context runs the 128-bit AES-NI kernel instead, with
+ * the same output. The wide_calls and narrow_calls counters of
+ * aesgcmsiv_op_stats show which width messages ran at.
+ *
+ * Contexts start at 0, which always uses the widest kernel; SIZE_MAX never
+ * uses 512-bit vectors. Applies to the one-message, vectored and batch
+ * calls on ctx, where a batch takes the width for its mean message length.
+ * Messages built up with an aesgcmsiv_ctx_msg and aesgcmsiv_reencrypt_batch
+ * keep the widest. Has no effect unless the context was created on the
+ * vaes-avx512 backend.
+ *
+ * @param ctx Key context
+ * @param min_bytes Shortest message to run on 512-bit vectors
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_set_wide_min(aesgcmsiv_ctx* ctx, size_t min_bytes);
+
+/**
+ * Gives a context a cache of the keys RFC 8452 derives from each nonce, sized
+ * for up to `entries` distinct nonces (rounded up to a power of two). Calls
+ * that repeat a recent nonce then skip key derivation, which is most of the
+ * cost of a short message. It suits nonces that repeat by design, such as
+ * one per shard and epoch; with unique nonces it only adds a copy.
+ *
+ * Each cached nonce keeps its derived keys in memory until it is replaced or
+ * the cache is removed, which clears them. Only messages that would run on
+ * the calling thread use the cache. Has no effect when the library falls
+ * back to OpenSSL.
+ *
+ * Contexts start without a cache. Must not be called while the context is
+ * in use by another thread.
+ *
+ * @param ctx Key context
+ * @param entries Cache size, at most AESGCMSIV_NONCE_CACHE_MAX; 0 removes
+ *        the cache
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_set_nonce_cache(aesgcmsiv_ctx* ctx, size_t entries);
+
+/**
+ * What one key context has been used for since its usage tracking was first
+ * enabled, for telling which keys drive the crypto work. Each message counts
+ * once, however it was submitted, as in aesgcmsiv_op_stats.
+ */
+typedef struct aesgcmsiv_key_usage {
+    uint32_t key_id;  // the key's ID in a keyring; 0 from aesgcmsiv_ctx_get_usage
+    uint64_t ops;  // messages sealed, opened or verified, whether or not they succeeded
+    uint64_t bytes;  // plaintext or ciphertext of the messages that succeeded
+    uint64_t failures;  // messages that failed, a tag that did not verify included
+    uint64_t last_used_ms;  // Unix time in milliseconds of the latest message; 0 if none
+} aesgcmsiv_key_usage;
+
+/**
+ * Turns the usage counters of a context on or off. While on, each call on
+ * the context adds to counters kept with it, spread over a few cache lines
+ * so that threads sharing the key rarely touch the same one, and reads the
+ * wall clock once. While no context in the process has them on, a call pays
+ * one relaxed atomic load for them. Disabling keeps the counts, and enabling
+ * again continues them. Calls already running when this is called may or
+ * may not be counted.
+ *
+ * Contexts start with the counters off; aesgcmsiv_ctx_clone does not copy
+ * them.
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_set_usage_tracking(aesgcmsiv_ctx* ctx, int enabled);
+
+/**
+ * Reads the usage counters of a context, which are all 0 if they were never
+ * enabled. Counts from calls still running may be partly included.
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_get_usage(const aesgcmsiv_ctx* ctx, aesgcmsiv_key_usage* usage_out);
+
+/**
+ * Number of CPUs the process can keep busy, which sizes every default
+ * worker count: the processors its affinity mask allows, capped on Linux by
+ * the CPU quota of its cgroup (v1 cpu.cfs_quota_us or v2 cpu.max, and any
+ * tighter one on a parent), and on Windows by a hard CPU rate cap on its
+ * job object. A pod with a 4-CPU limit on a 96-core host gets 4. A cpuset
+ * already shows in the affinity mask. Read once, on first use, and at
+ * least 1.
+ */
+AESGCMSIV_API unsigned int aesgcmsiv_available_cpus(void);
+
+/**
+ * Creates a work-stealing thread pool and starts its workers.
+ *
+ * @param workers Number of worker threads; 0 uses one fewer than
+ *        aesgcmsiv_available_cpus (at least 1), since the calling thread
+ *        takes part in every call run on the pool
+ * @param pool_out Receives the new pool on success; set to NULL on failure
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_pool_create(unsigned int workers, aesgcmsiv_pool** pool_out);
+
+/**
+ * aesgcmsiv_pool_create with a NUMA placement policy.
+ *
+ * With AESGCMSIV_POOL_PIN_NODES the workers are shared among the NUMA nodes
+ * in proportion to their CPUs, and each worker may only run on the CPUs of
+ * its node. With AESGCMSIV_POOL_NODE_LOCAL, each share of a large message
+ * and each chunk of a batch is also queued on a worker of the node holding
+ * its input pages. A busy node's tasks can still be stolen by idle workers
+ * on other nodes. On a machine with one node both flags have no effect.
+ *
+ * @param workers As for aesgcmsiv_pool_create
+ * @param flags Zero or more AESGCMSIV_POOL_* flags
+ * @param pool_out Receives the new pool on success; set to NULL on failure
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_pool_create_ex(unsigned int workers, uint32_t flags, aesgcmsiv_pool** pool_out);
+
+/**
+ * Stops a pool's workers and frees it. No context may still be using it.
+ * For a hosted pool, waits for the host threads already asked for to run
+ * aesgcmsiv_pool_work and return. Passing NULL is a no-op.
+ */
+AESGCMSIV_API void aesgcmsiv_pool_destroy(aesgcmsiv_pool* pool);
+
+/**
+ * Asks the host of a pool from aesgcmsiv_pool_create_hosted to call
+ * aesgcmsiv_pool_work(pool) once on one of its own threads, soon and
+ * without waiting for it, for example by queueing a work item on its
+ * thread pool. Called on the thread that queued the work.
+ */
+typedef void (*aesgcmsiv_schedule_fn)(void* user_data, aesgcmsiv_pool* pool);
+
+/**
+ * Creates a pool that starts no threads and borrows the host's instead, so
+ * that the library's parallel work shares the host's thread pool rather
+ * than competing with it for the cores.
+ *
+ * Contexts use it like any pool. Whenever tasks are queued, the pool asks
+ * for one host thread per task through schedule, with at most workers of
+ * them in aesgcmsiv_pool_work at once. Each drains the queued tasks and
+ * returns once there are none, without waiting for more. A call that queued
+ * tasks still takes part in them, and runs any no host thread has reached
+ * yet, so a busy host only loses parallelism.
+ *
+ * @param workers Most host threads lent at once; 0 uses one fewer than
+ *        aesgcmsiv_available_cpus (at least 1)
+ * @param schedule Called to ask for a host thread
+ * @param user_data Passed to schedule
+ * @param pool_out Receives the new pool on success; set to NULL on failure
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_pool_create_hosted(
+    unsigned int workers, aesgcmsiv_schedule_fn schedule, void* user_data, aesgcmsiv_pool** pool_out);
+
+/**
+ * Runs the tasks queued on a hosted pool on the calling thread, and returns
+ * once none are left. Call it once for each time schedule was called.
+ * aesgcmsiv_pool_destroy waits for every such call to return. Does nothing
+ * for a pool with its own threads.
+ */
+AESGCMSIV_API void aesgcmsiv_pool_work(aesgcmsiv_pool* pool);
+
+/**
+ * Makes a context run its parallel work on a pool: the shares of a large
+ * message split by aesgcmsiv_ctx_set_threads, and the items of
+ * aesgcmsiv_encrypt_batch and aesgcmsiv_decrypt_batch, which are otherwise
+ * processed on the calling thread. A thread count of 0 then means one share
+ * per pool worker plus the caller. Any number of contexts may share a pool,
+ * which must outlive them or be detached first. Has no effect when the
+ * library falls back to OpenSSL.
+ *
+ * @param ctx Key context
+ * @param pool Pool to borrow, or NULL to go back to threads started per call
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_set_pool(aesgcmsiv_ctx* ctx, aesgcmsiv_pool* pool);
+
+/**
+ * Allocates zero-filled memory for large inputs and outputs, mapped
+ * straight from the OS and aligned to at least a page, so the kernels'
+ * 64-byte loads never split a cache line.
+ *
+ * With AESGCMSIV_ALLOC_HUGE_PAGES the size is rounded up to 2 MB and the
+ * memory is backed by huge pages where the OS has them to give: reserved
+ * huge pages first, then transparent huge pages on Linux, or large pages
+ * on Windows when the process holds SeLockMemoryPrivilege. Otherwise it
+ * gets ordinary pages, so the flag never makes the call fail. One TLB
+ * entry then covers 512 times as much of a long buffer.
+ *
+ * AESGCMSIV_ALLOC_NODE(n) prefers NUMA node n, numbered as the pool numbers
+ * nodes, for the pages as they are first touched; it has no effect on a
+ * machine with one node. AESGCMSIV_ALLOC_LOCKED keeps the pages in RAM,
+ * out of swap, and fails if the OS refuses, as it does past RLIMIT_MEMLOCK.
+ *
+ * @param size Bytes to allocate, at least 1
+ * @param flags Zero or more AESGCMSIV_ALLOC_* flags
+ *
+ * @return The memory, to be freed with aesgcmsiv_free, or NULL on failure
+ */
+AESGCMSIV_API void* aesgcmsiv_alloc(size_t size, uint32_t flags);
+
+/**
+ * Frees memory from aesgcmsiv_alloc. Passing NULL is a no-op.
+ */
+AESGCMSIV_API void aesgcmsiv_free(void* ptr);
+
+/**
+ * Encrypts a batch of messages under one key context.
+ *
+ * Items are processed in order. On failure the remaining items are not
+ * processed and the error of the failing item is returned; every earlier
+ * item has been encrypted.
+ *
+ * @param ctx Key context
+ * @param count Number of items
+ * @param items Array of count items
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_encrypt_batch(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    const aesgcmsiv_batch_item* items);
+
+/**
+ * Decrypts a batch of messages under one key context.
+ *
+ * Every item is processed, whatever the outcome of the others, and its
+ * result is written to status_out. The output of an item whose tag does not
+ * verify is zeroed.
+ *
+ * @param ctx Key context
+ * @param count Number of items
+ * @param items Array of count items
+ * @param status_out Array of count results, one per item
+ *
+ * @return AESGCMSIV_SUCCESS if every item succeeded, otherwise the first
+ *         failing item's status; AESGCMSIV_ERROR_INVALID_INPUT without
+ *         processing any item if the arguments themselves are invalid
+ */
+AESGCMSIV_API int aesgcmsiv_decrypt_batch(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    int* status_out);
+
+/**
+ * aesgcmsiv_decrypt_batch as aesgcmsiv_ctx_verify_ciphertext: each item's
+ * result is written to status_out, and its output is ignored and may be
+ * NULL.
+ *
+ * @return As aesgcmsiv_decrypt_batch
+ */
+AESGCMSIV_API int aesgcmsiv_verify_batch(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    int* status_out);
+
+/**
+ * aesgcmsiv_encrypt_batch with nonces derived from a counter, as for page
+ * or record numbers, instead of read from the items.
+ *
+ * Item i is encrypted under base_nonce with its last 8 bytes XORed with
+ * first_counter + i as a little-endian 64-bit integer, so a base nonce of
+ * file_id || 0 gives item i the nonce file_id || (first_counter + i). The
+ * items' nonce pointers are ignored and may be NULL.
+ *
+ * @param ctx Key context
+ * @param count Number of items
+ * @param items Array of count items
+ * @param base_nonce Base nonce (AESGCMSIV_NONCE_SIZE bytes)
+ * @param first_counter Counter of the first item
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_encrypt_batch_counter(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const uint8_t* base_nonce,
+    uint64_t first_counter);
+
+/**
+ * aesgcmsiv_decrypt_batch with nonces derived as by
+ * aesgcmsiv_encrypt_batch_counter. The items' nonce pointers are ignored
+ * and may be NULL.
+ *
+ * @param ctx Key context
+ * @param count Number of items
+ * @param items Array of count items
+ * @param base_nonce Base nonce (AESGCMSIV_NONCE_SIZE bytes)
+ * @param first_counter Counter of the first item
+ * @param status_out Array of count results, one per item
+ *
+ * @return As aesgcmsiv_decrypt_batch
+ */
+AESGCMSIV_API int aesgcmsiv_decrypt_batch_counter(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const uint8_t* base_nonce,
+    uint64_t first_counter,
+    int* status_out);
+
+/**
+ * aesgcmsiv_encrypt_batch with every item under the same AAD, such as a
+ * table id or schema version, instead of its own. The items' aad and
+ * aad_len are ignored, so a batch of tiny messages need not repeat the AAD
+ * in every item, and every item reads the same AAD bytes, which stay in
+ * cache. The AAD is still hashed once per item, under that item's
+ * authentication key.
+ *
+ * @param ctx Key context
+ * @param count Number of items
+ * @param items Array of count items
+ * @param aad Additional authenticated data of every item (can be NULL if
+ *            aad_len is 0)
+ * @param aad_len Length of the AAD
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_encrypt_batch_shared_aad(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const uint8_t* aad,
+    size_t aad_len);
+
+/**
+ * aesgcmsiv_decrypt_batch with every item under the same AAD, as for
+ * aesgcmsiv_encrypt_batch_shared_aad. The items' aad and aad_len are
+ * ignored.
+ *
+ * @param ctx Key context
+ * @param count Number of items
+ * @param items Array of count items
+ * @param aad Additional authenticated data of every item (can be NULL if
+ *            aad_len is 0)
+ * @param aad_len Length of the AAD
+ * @param status_out Array of count results, one per item
+ *
+ * @return As aesgcmsiv_decrypt_batch
+ */
+AESGCMSIV_API int aesgcmsiv_decrypt_batch_shared_aad(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const uint8_t* aad,
+    size_t aad_len,
+    int* status_out);
+
+/**
+ * Encrypts count fixed-size pages of a contiguous buffer in place, as a
+ * storage engine encrypts its 4, 8 or 16 KiB pages before writing them.
+ *
+ * Page i starts at base + i * page_size. Its first aad_len bytes are a
+ * header that is authenticated but left in the clear; the rest is
+ * encrypted in place, and its tag is written to tags_out + i * 16 rather
+ * than into the page. Page i is encrypted under the nonce
+ * aesgcmsiv_encrypt_batch_counter would give item i for base_nonce and
+ * first_page_no, so a base nonce of file_id || 0 gives each page the nonce
+ * file_id || page number. Pages run as one batch, on the context's pool if
+ * it has one.
+ *
+ * @param ctx Key context
+ * @param base_nonce Base nonce (AESGCMSIV_NONCE_SIZE bytes)
+ * @param base First page; may be NULL when count is 0
+ * @param page_size Bytes per page
+ * @param count Number of pages
+ * @param first_page_no Page number of the first page
+ * @param aad_len Header bytes of each page; at most page_size
+ * @param tags_out Buffer for count * AESGCMSIV_TAG_SIZE bytes of tags
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_encrypt_pages(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* base_nonce,
+    uint8_t* base,
+    size_t page_size,
+    size_t count,
+    uint64_t first_page_no,
+    size_t aad_len,
+    uint8_t* tags_out);
+
+/**
+ * Decrypts pages written by aesgcmsiv_encrypt_pages in place, reporting
+ * each page's result as aesgcmsiv_decrypt_batch does. The body of a page
+ * that fails to authenticate is zeroed; its header is left as it was.
+ *
+ * @param ctx Key context
+ * @param base_nonce Base nonce (AESGCMSIV_NONCE_SIZE bytes)
+ * @param base First page; may be NULL when count is 0
+ * @param page_size Bytes per page
+ * @param count Number of pages
+ * @param first_page_no Page number of the first page
+ * @param aad_len Header bytes of each page; at most page_size
+ * @param tags count * AESGCMSIV_TAG_SIZE bytes of tags
+ * @param status_out Array of count results, one per page
+ *
+ * @return As aesgcmsiv_decrypt_batch
+ */
+AESGCMSIV_API int aesgcmsiv_decrypt_pages(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* base_nonce,
+    uint8_t* base,
+    size_t page_size,
+    size_t count,
+    uint64_t first_page_no,
+    size_t aad_len,
+    const uint8_t* tags,
+    int* status_out);
+
+/**
+ * Encrypts a column of variable-length values laid out as Arrow lays out a
+ * binary column: one contiguous values buffer and count + 1 offsets, value
+ * i being values[offsets[i], offsets[i + 1]). No descriptor is built per
+ * value.
+ *
+ * Each ciphertext is written at the same offset of values_out, so the
+ * output column shares the input's offsets, and the tag of value i goes to
+ * tags_out + i * 16. Value i is encrypted under the nonce
+ * aesgcmsiv_encrypt_batch_counter would give item i for base_nonce and
+ * first_row, with no AAD. Values run as one batch, on the context's pool if
+ * it has one.
+ *
+ * @param ctx Key context
+ * @param base_nonce Base nonce (AESGCMSIV_NONCE_SIZE bytes)
+ * @param first_row Row number of the first value
+ * @param count Number of values
+ * @param values Values buffer
+ * @param offsets count + 1 offsets into values, of offset_size bytes each;
+ *                the first at least 0 and none less than the one before
+ * @param offset_size 4 for int32_t offsets, 8 for int64_t offsets
+ * @param values_out Output buffer of at least offsets[count] bytes; may
+ *                   equal values
+ * @param tags_out Buffer for count * AESGCMSIV_TAG_SIZE bytes of tags
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_encrypt_column(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* base_nonce,
+    uint64_t first_row,
+    size_t count,
+    const uint8_t* values,
+    const void* offsets,
+    size_t offset_size,
+    uint8_t* values_out,
+    uint8_t* tags_out);
+
+/**
+ * Decrypts a column written by aesgcmsiv_encrypt_column, reporting each
+ * value's result as aesgcmsiv_decrypt_batch does. The plaintext of a value
+ * that fails to authenticate is zeroed.
+ *
+ * @param ctx Key context
+ * @param base_nonce Base nonce (AESGCMSIV_NONCE_SIZE bytes)
+ * @param first_row Row number of the first value
+ * @param count Number of values
+ * @param values Encrypted values buffer
+ * @param offsets count + 1 offsets into values, as for encryption
+ * @param offset_size 4 for int32_t offsets, 8 for int64_t offsets
+ * @param tags count * AESGCMSIV_TAG_SIZE bytes of tags
+ * @param values_out Output buffer of at least offsets[count] bytes; may
+ *                   equal values
+ * @param status_out Array of count results, one per value
+ *
+ * @return As aesgcmsiv_decrypt_batch
+ */
+AESGCMSIV_API int aesgcmsiv_decrypt_column(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* base_nonce,
+    uint64_t first_row,
+    size_t count,
+    const uint8_t* values,
+    const void* offsets,
+    size_t offset_size,
+    const uint8_t* tags,
+    uint8_t* values_out,
+    int* status_out);
+
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+// The Arrow C Data Interface structures, exactly as the Arrow specification
+// defines them, for aesgcmsiv_arrow_encrypt_column. A project that already
+// includes Arrow's own copy gets the same definitions.
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+    // Array type description
+    const char* format;
+    const char* name;
+    const char* metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema** children;
+    struct ArrowSchema* dictionary;
+
+    // Release callback
+    void (*release)(struct ArrowSchema*);
+    // Opaque producer-specific data
+    void* private_data;
+};
+
+struct ArrowArray {
+    // Array data description
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void** buffers;
+    struct ArrowArray** children;
+    struct ArrowArray* dictionary;
+
+    // Release callback
+    void (*release)(struct ArrowArray*);
+    // Opaque producer-specific data
+    void* private_data;
+};
+
+#endif  // ARROW_C_DATA_INTERFACE
+
+// Tag layouts for aesgcmsiv_arrow_encrypt_column
+#define AESGCMSIV_ARROW_TAGS_STRUCT 0
+#define AESGCMSIV_ARROW_TAGS_APPENDED 1
+
+/**
+ * Encrypts a binary or string column handed over through the Arrow C Data
+ * Interface, returning the ciphertexts as a new Arrow array. The values go
+ * through the column kernel of aesgcmsiv_encrypt_column straight from the
+ * input's buffers into the output's, with no per-value copies, and value i
+ * is encrypted under the nonce aesgcmsiv_encrypt_batch_counter would give
+ * item i for base_nonce and first_row, with no AAD.
+ *
+ * The input's format must be "z" (binary), "u" (utf8), "Z" (large binary)
+ * or "U" (large utf8); its offset and validity bitmap are honored. The
+ * output keeps the input's offset width and name, and starts at offset 0:
+ *
+ *  - AESGCMSIV_ARROW_TAGS_STRUCT: a struct ("+s") of "ciphertext", binary
+ *    with the input's lengths, and "tag", fixed-size binary of 16 bytes
+ *    ("w:16"). The ciphertext child decrypts with aesgcmsiv_decrypt_column
+ *    over its own buffers.
+ *  - AESGCMSIV_ARROW_TAGS_APPENDED: binary whose value i is ciphertext ||
+ *    tag, 16 bytes longer than the input's.
+ *
+ * Null slots are encrypted like any other, and the output carries the
+ * input's validity bitmap on the struct or binary array and on each child.
+ * The output's buffers are one aesgcmsiv_alloc block; its release callbacks
+ * free it, and the schema and array are released independently. The input
+ * is only read: it is not released or moved.
+ *
+ * @param ctx Key context
+ * @param base_nonce Base nonce (AESGCMSIV_NONCE_SIZE bytes)
+ * @param first_row Row number of the array's first value
+ * @param schema Input column type
+ * @param array Input column
+ * @param tag_layout AESGCMSIV_ARROW_TAGS_STRUCT or AESGCMSIV_ARROW_TAGS_APPENDED
+ * @param schema_out Receives the output type, released by the caller
+ * @param array_out Receives the output column, released by the caller
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT for
+ *         an unsupported format or layout, a malformed array, or appended
+ *         tags that would overflow 32-bit offsets, AESGCMSIV_ERROR_INTERNAL
+ *         if out of memory, or another negative error code from the
+ *         kernel; on failure nothing is written to schema_out or array_out
+ */
+AESGCMSIV_API int aesgcmsiv_arrow_encrypt_column(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* base_nonce,
+    uint64_t first_row,
+    const struct ArrowSchema* schema,
+    const struct ArrowArray* array,
+    uint32_t tag_layout,
+    struct ArrowSchema* schema_out,
+    struct ArrowArray* array_out);
+
+/**
+ * One datagram of a batch sealed or opened in place. On the wire a sealed
+ * datagram is
+ *
+ *   header (header_len bytes) || nonce || ciphertext || tag
+ *
+ * where the header, such as a protocol version and flow id, is sent in the
+ * clear and authenticated as associated data.
+ */
+typedef struct aesgcmsiv_datagram {
+    uint8_t* data;
+    size_t len;  // bytes of data in use; updated by the calls below
+} aesgcmsiv_datagram;
+
+// Bytes a sealed datagram adds to its payload: the nonce and the tag
+#define AESGCMSIV_DATAGRAM_OVERHEAD (AESGCMSIV_NONCE_SIZE + AESGCMSIV_TAG_SIZE)
+
+/**
+ * Seals a batch of datagrams in place, ready to send. Each datagram holds
+ * header || AESGCMSIV_NONCE_SIZE spare bytes || payload, in len bytes, with
+ * AESGCMSIV_TAG_SIZE more bytes of room after them. A fresh random nonce is
+ * written into the spare bytes, the payload is encrypted where it is, the
+ * tag is appended and len grows by AESGCMSIV_TAG_SIZE. All datagrams go
+ * through one batch, so short payloads share the multi-buffer kernel.
+ *
+ * @param ctx Key context
+ * @param count Number of datagrams
+ * @param datagrams Array of count datagrams
+ * @param header_len Bytes of header at the start of each datagram
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT
+ *         without sealing any datagram if a datagram is shorter than its
+ *         header and nonce, or another negative error code, in which case
+ *         none should be sent
+ */
+AESGCMSIV_API int aesgcmsiv_seal_datagrams(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    aesgcmsiv_datagram* datagrams,
+    size_t header_len);
+
+/**
+ * Opens a batch of received datagrams in place. Each holds a sealed
+ * datagram in len bytes. Its payload is decrypted where the ciphertext was,
+ * at data + header_len + AESGCMSIV_NONCE_SIZE, and len shrinks by
+ * AESGCMSIV_TAG_SIZE. A datagram too short to hold a header, nonce and tag,
+ * or whose tag does not verify, gets AESGCMSIV_ERROR_DECRYPT_FAILED, keeps
+ * its len and has its payload zeroed.
+ *
+ * @param ctx Key context
+ * @param count Number of datagrams
+ * @param datagrams Array of count datagrams
+ * @param header_len Bytes of header at the start of each datagram
+ * @param status_out Array of count results, one per datagram
+ *
+ * @return AESGCMSIV_SUCCESS if every datagram opened, otherwise the first
+ *         failing datagram's status; AESGCMSIV_ERROR_INVALID_INPUT without
+ *         opening any if the arguments themselves are invalid
+ */
+AESGCMSIV_API int aesgcmsiv_open_datagrams(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    aesgcmsiv_datagram* datagrams,
+    size_t header_len,
+    int* status_out);
+
+#if defined(__linux__)
+struct mmsghdr;
+
+/**
+ * aesgcmsiv_seal_datagrams over the array sendmmsg takes, so a batch costs
+ * one crypto call and one system call. Each message has a single iovec
+ * holding the datagram, with iov_len as its length; iov_len grows by the
+ * tag, so the array can be passed to sendmmsg as it is.
+ *
+ * @return As for aesgcmsiv_seal_datagrams; AESGCMSIV_ERROR_INVALID_INPUT
+ *         also if a message has other than one iovec
+ */
+AESGCMSIV_API int aesgcmsiv_seal_mmsg(
+    aesgcmsiv_ctx* ctx,
+    struct mmsghdr* messages,
+    unsigned int count,
+    size_t header_len);
+
+/**
+ * aesgcmsiv_open_datagrams over an array filled in by recvmmsg. Each
+ * message has a single iovec and msg_len bytes received; msg_len is set to
+ * header_len + AESGCMSIV_NONCE_SIZE + the payload length on success.
+ *
+ * @return As for aesgcmsiv_open_datagrams; AESGCMSIV_ERROR_INVALID_INPUT
+ *         also if a message has other than one iovec
+ */
+AESGCMSIV_API int aesgcmsiv_open_mmsg(
+    aesgcmsiv_ctx* ctx,
+    struct mmsghdr* messages,
+    unsigned int count,
+    size_t header_len,
+    int* status_out);
+#endif
+
+/**
+ * Encrypts selected fields of a JSON document in one pass. The document is
+ * scanned once, with string bodies skipped 16 bytes at a time by SSE2 or
+ * NEON. The values the paths select are gathered as they are found and
+ * sealed together with one aesgcmsiv_encrypt_batch call, and the output is
+ * written from the spans the scan recorded. Each selected value, whatever
+ * its type, is replaced by a JSON string holding a token as
+ * aesgcmsiv_seal_b64url writes it, over the value's exact text under a
+ * fresh random nonce. Everything else is copied through byte for byte.
+ *
+ * A path is member names separated by '.', from the top-level object, such
+ * as "card.number". A segment "*" matches any member of an object or any
+ * element of an array, as in "items.*.price". Names are compared with keys
+ * as they are written between the quotes, with escapes not decoded, and a
+ * key holding '.' cannot be selected. A value inside a selected value is
+ * sealed along with it.
+ *
+ * Every field is sealed with the same aad, so a token moved to another
+ * selected field still opens. Pass something that names the document, such
+ * as its ID, to keep tokens from moving between documents.
+ *
+ * @param ctx Key context
+ * @param json The UTF-8 document, which must be valid JSON; bytes of 0x80
+ *        and up in strings are passed through unchecked
+ * @param json_len Length of the document
+ * @param paths Array of path_count NUL-terminated paths
+ * @param path_count Number of paths; with none, the document is copied
+ * @param aad Pointer to additional authenticated data (can be NULL)
+ * @param aad_len Length of additional authenticated data
+ * @param out Output buffer. Must not overlap the document.
+ * @param out_capacity Size of out in bytes
+ * @param out_len_out Receives the length of the output, also when out is
+ *        too small, or 0 if the document is not valid JSON
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if
+ *         the document is not valid JSON, a path is empty or has an empty
+ *         segment, or out is too small, AESGCMSIV_ERROR_INTERNAL if out of
+ *         memory, or another negative error code from the batch
+ */
+AESGCMSIV_API int aesgcmsiv_json_seal_fields(
+    aesgcmsiv_ctx* ctx,
+    const char* json, size_t json_len,
+    const char* const* paths, size_t path_count,
+    const uint8_t* aad, size_t aad_len,
+    char* out, size_t out_capacity,
+    size_t* out_len_out);
+
+/**
+ * Reverses aesgcmsiv_json_seal_fields: each value the paths select must be
+ * a string holding a token. The tokens are decoded and opened together
+ * with one aesgcmsiv_decrypt_batch call, and each is replaced by the
+ * value text it sealed. The output is never longer than the document.
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_DECRYPT_FAILED if
+ *         a selected value is not a token or does not verify, in which
+ *         case out is zeroed and *out_len_out is 0, otherwise as for
+ *         aesgcmsiv_json_seal_fields
+ */
+AESGCMSIV_API int aesgcmsiv_json_open_fields(
+    aesgcmsiv_ctx* ctx,
+    const char* json, size_t json_len,
+    const char* const* paths, size_t path_count,
+    const uint8_t* aad, size_t aad_len,
+    char* out, size_t out_capacity,
+    size_t* out_len_out);
+
+/**
+ * Re-encrypts one record from old_ctx's key to new_ctx's, as for key
+ * rotation, in one call. The record is decrypted and verified into native
+ * scratch memory and encrypted from there while it is still in cache; the
+ * plaintext never reaches a caller's buffer and the scratch is cleansed
+ * before returning.
+ *
+ * ciphertext_out and tag_out are written only if the record verifies, so
+ * a record re-encrypted in place is left intact when it does not.
+ *
+ * @param old_ctx Context of the key the record is encrypted under
+ * @param new_ctx Context of the key to encrypt it under; may be old_ctx
+ * @param nonce Nonce the record is encrypted under (AESGCMSIV_NONCE_SIZE
+ *              bytes)
+ * @param new_nonce Nonce to encrypt it under (AESGCMSIV_NONCE_SIZE bytes),
+ *                  or NULL to keep nonce
+ * @param ciphertext Ciphertext under the old key
+ * @param ciphertext_len Length of the ciphertext
+ * @param aad Additional authenticated data (can be NULL), kept unchanged
+ * @param aad_len Length of the AAD
+ * @param tag Tag under the old key (AESGCMSIV_TAG_SIZE bytes)
+ * @param ciphertext_out Buffer for ciphertext_len bytes of ciphertext
+ *                       under the new key; may equal ciphertext
+ * @param tag_out Buffer for the new tag (AESGCMSIV_TAG_SIZE bytes); may
+ *                equal tag
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_DECRYPT_FAILED if
+ *         the record does not verify, other negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_reencrypt(
+    aesgcmsiv_ctx* old_ctx,
+    aesgcmsiv_ctx* new_ctx,
+    const uint8_t* nonce,
+    const uint8_t* new_nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out);
+
+/**
+ * aesgcmsiv_reencrypt over a batch, reporting each record's result as
+ * aesgcmsiv_decrypt_batch does. Each item's input is its ciphertext under
+ * the old key and its tag the old tag; once the item verifies, its output
+ * receives the ciphertext under the new key and its tag is overwritten
+ * with the new tag. Items that fail keep their output and tag as they
+ * were. Groups of short records are opened and sealed through the
+ * multi-buffer lanes, and the batch is split across old_ctx's pool if it
+ * has one. Statistics count each record as a decryption.
+ *
+ * @param old_ctx Context of the key the records are encrypted under
+ * @param new_ctx Context of the key to encrypt them under
+ * @param count Number of items
+ * @param items Array of count items
+ * @param new_nonces count * AESGCMSIV_NONCE_SIZE bytes of nonces to
+ *                   encrypt under, or NULL to keep each item's nonce
+ * @param status_out Array of count results, one per item
+ *
+ * @return As aesgcmsiv_decrypt_batch
+ */
+AESGCMSIV_API int aesgcmsiv_reencrypt_batch(
+    aesgcmsiv_ctx* old_ctx,
+    aesgcmsiv_ctx* new_ctx,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const uint8_t* new_nonces,
+    int* status_out);
+
+/**
+ * Encrypts one plaintext for many recipients, recipient i under its own key
+ * and nonce, as fan-out messages are. The result for each recipient is what
+ * aesgcmsiv_encrypt would give it. The recipients are taken a group at a
+ * time and the plaintext a cache-sized chunk at a time, so each chunk is
+ * loaded once and hashed and encrypted for the whole group while it is
+ * still in cache, rather than the whole plaintext being read again for
+ * every recipient.
+ *
+ * Nothing is written unless every argument is valid.
+ *
+ * @param count Number of recipients
+ * @param keys count * key_len bytes of keys, recipient i's at keys + i * key_len
+ * @param key_len Length of each key (16 or 32)
+ * @param nonces count * AESGCMSIV_NONCE_SIZE bytes of nonces
+ * @param plaintext Plaintext shared by every recipient
+ * @param plaintext_len Length of the plaintext
+ * @param aad Additional authenticated data shared by every recipient (can
+ *            be NULL)
+ * @param aad_len Length of the AAD
+ * @param ciphertexts_out Array of count buffers of plaintext_len bytes each;
+ *                        none may overlap the plaintext
+ * @param tags_out count * AESGCMSIV_TAG_SIZE bytes for the tags
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_encrypt_multikey(
+    size_t count,
+    const uint8_t* keys, size_t key_len,
+    const uint8_t* nonces,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* const* ciphertexts_out,
+    uint8_t* tags_out);
+
+/**
+ * Opaque handle to a fixed number of key slots, for batches in which every
+ * message may use a different key. Each slot holds an expanded key in one
+ * dense, cache-line-aligned array, so a batch only looks its keys up and
+ * short messages under different keys still share the multi-buffer lanes.
+ *
+ * Batches may run on several threads at once. A slot must not be set or
+ * cleared while a batch that uses it is running.
+ */
+typedef struct aesgcmsiv_key_table aesgcmsiv_key_table;
+
+/**
+ * Creates a key table with every slot empty.
+ *
+ * @param slots Number of slots, at least 1 and at most UINT32_MAX
+ * @param table_out Receives the new table on success; set to NULL on failure
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_key_table_new(size_t slots, aesgcmsiv_key_table** table_out);
+
+/**
+ * aesgcmsiv_key_table_new with the expanded keys in shared memory, for
+ * prefork servers: a parent sets every slot, seals the table with
+ * aesgcmsiv_key_table_seal and then forks, and each worker uses the table
+ * it inherits, so every process reads the one copy of the round keys
+ * instead of rebuilding its own. The memory is locked into RAM where the
+ * OS allows and left out of core dumps.
+ *
+ * Without a hand-written kernel the slots hold OpenSSL contexts, which
+ * cannot be shared, and on Windows there is no fork to share with; either
+ * way this is aesgcmsiv_key_table_new.
+ *
+ * A slot set or cleared after fork is seen by every process holding the
+ * table, so tables that will be shared should be sealed first.
+ *
+ * @param slots Number of slots, at least 1 and at most UINT32_MAX
+ * @param table_out Receives the new table on success; set to NULL on failure
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_key_table_new_shared(size_t slots, aesgcmsiv_key_table** table_out);
+
+/**
+ * Makes a table read-only: from now on aesgcmsiv_key_table_set and
+ * aesgcmsiv_key_table_clear fail with AESGCMSIV_ERROR_INVALID_INPUT. A
+ * shared table's memory is also made read-only by the OS, in this process
+ * and in every process forked after the call; on Linux it is sealed so that
+ * no process can map it writable again. Sealing a sealed table does
+ * nothing.
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INTERNAL if the OS
+ *         could not seal a shared table's memory, as when a process forked
+ *         before the call still maps it writable; the table is read-only in
+ *         this process either way
+ */
+AESGCMSIV_API int aesgcmsiv_key_table_seal(aesgcmsiv_key_table* table);
+
+/**
+ * Expands key into a slot, replacing and clearing whatever it held.
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if the
+ *         slot is out of range or the table is sealed, other negative error
+ *         codes on failure
+ */
+AESGCMSIV_API int aesgcmsiv_key_table_set(
+    aesgcmsiv_key_table* table, size_t slot,
+    const uint8_t* key, size_t key_len);
+
+/**
+ * Clears a slot and marks it empty.
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if the
+ *         slot is out of range or the table is sealed
+ */
+AESGCMSIV_API int aesgcmsiv_key_table_clear(aesgcmsiv_key_table* table, size_t slot);
+
+/**
+ * Attaches a pool to a table, as aesgcmsiv_ctx_set_pool does to a context,
+ * so large batches are spread over its workers. NULL detaches it.
+ */
+AESGCMSIV_API int aesgcmsiv_key_table_set_pool(aesgcmsiv_key_table* table, aesgcmsiv_pool* pool);
+
+/**
+ * aesgcmsiv_encrypt_batch with item i under the key in slot slots[i]. An
+ * item naming an empty or out-of-range slot fails with
+ * AESGCMSIV_ERROR_INVALID_KEY.
+ *
+ * @param table Key table
+ * @param count Number of items
+ * @param items Array of count items
+ * @param slots Array of count slot numbers, one per item
+ */
+AESGCMSIV_API int aesgcmsiv_key_table_encrypt_batch(
+    aesgcmsiv_key_table* table,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const uint32_t* slots);
+
+/**
+ * aesgcmsiv_decrypt_batch with item i under the key in slot slots[i]. An
+ * item naming an empty or out-of-range slot gets AESGCMSIV_ERROR_INVALID_KEY
+ * in status_out.
+ */
+AESGCMSIV_API int aesgcmsiv_key_table_decrypt_batch(
+    aesgcmsiv_key_table* table,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const uint32_t* slots,
+    int* status_out);
+
+/**
+ * Clears every slot and frees the table. No batch on it may be running.
+ * Passing NULL is a no-op. A shared table is only unmapped from the calling
+ * process, since others may still be using it; its memory is cleared by
+ * the OS once no process maps it.
+ */
+AESGCMSIV_API void aesgcmsiv_key_table_free(aesgcmsiv_key_table* table);
+
+/**
+ * Opaque handle to a fixed number of registered buffers, as io_uring
+ * registers buffers: memory that stays put for the life of the
+ * registration, such as a pinned or natively allocated pool, is named once
+ * and then referred to by index and offset, so a batch over it passes no
+ * pointers and checks every range against the registered lengths.
+ *
+ * Batches may run on several threads at once. A buffer must not be
+ * registered, unregistered or freed while a batch that uses it is running.
+ */
+typedef struct aesgcmsiv_buffers aesgcmsiv_buffers;
+
+/**
+ * One message of a batch over registered buffers. Offsets are from the
+ * start of the named buffer; every range must lie within it.
+ */
+typedef struct aesgcmsiv_registered_item {
+    uint32_t input_buffer;  // holds the nonce, AAD and input, and the tag when decrypting
+    uint32_t output_buffer;  // receives the output, and the tag when encrypting; may equal input_buffer
+    uint64_t nonce_offset;  // AESGCMSIV_NONCE_SIZE bytes in input_buffer
+    uint64_t input_offset;
+    uint64_t input_len;
+    uint64_t aad_offset;  // ignored when aad_len is 0
+    uint64_t aad_len;
+    uint64_t output_offset;  // input_len bytes in output_buffer; may equal input_offset
+    uint64_t tag_offset;  // AESGCMSIV_TAG_SIZE bytes, in output_buffer when encrypting
+                          // and in input_buffer when decrypting
+} aesgcmsiv_registered_item;
+
+/**
+ * Creates a registry of count buffers, all unregistered.
+ *
+ * @param count Number of buffers, at least 1 and at most UINT32_MAX
+ * @param buffers_out Receives the new registry on success; set to NULL on failure
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_buffers_new(size_t count, aesgcmsiv_buffers** buffers_out);
+
+/**
+ * Registers len bytes at data as buffer index, replacing whatever it held.
+ * The memory is not copied and must stay valid and in place until the
+ * buffer is unregistered or the registry freed.
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if the
+ *         index is out of range or data is NULL
+ */
+AESGCMSIV_API int aesgcmsiv_buffers_register(
+    aesgcmsiv_buffers* buffers, size_t index,
+    uint8_t* data, size_t len);
+
+/**
+ * Unregisters buffer index, so items naming it fail.
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if the
+ *         index is out of range
+ */
+AESGCMSIV_API int aesgcmsiv_buffers_unregister(aesgcmsiv_buffers* buffers, size_t index);
+
+/**
+ * aesgcmsiv_encrypt_batch over items in registered buffers. Every item is
+ * checked before any is encrypted: one naming an unregistered or
+ * out-of-range buffer, or a range past the end of its buffer, fails the
+ * whole call with AESGCMSIV_ERROR_INVALID_INPUT.
+ *
+ * @param ctx Key context
+ * @param buffers Registry the items' buffers are in
+ * @param count Number of items
+ * @param items Array of count items
+ */
+AESGCMSIV_API int aesgcmsiv_encrypt_registered(
+    aesgcmsiv_ctx* ctx,
+    const aesgcmsiv_buffers* buffers,
+    size_t count,
+    const aesgcmsiv_registered_item* items);
+
+/**
+ * aesgcmsiv_decrypt_batch over items in registered buffers, checked as
+ * aesgcmsiv_encrypt_registered checks them.
+ */
+AESGCMSIV_API int aesgcmsiv_decrypt_registered(
+    aesgcmsiv_ctx* ctx,
+    const aesgcmsiv_buffers* buffers,
+    size_t count,
+    const aesgcmsiv_registered_item* items,
+    int* status_out);
+
+/**
+ * Frees the registry; the registered memory itself is left alone. No batch
+ * on it may be running. Passing NULL is a no-op.
+ */
+AESGCMSIV_API void aesgcmsiv_buffers_free(aesgcmsiv_buffers* buffers);
+
+/**
+ * Opaque handle to a key-wrapping context: one key with one fixed nonce, as
+ * RFC 8452 allows for deterministic key wrapping. The per-nonce
+ * authentication and encryption keys are derived once, by
+ * aesgcmsiv_wrap_ctx_new, so wrapping a 32-byte key costs one POLYVAL pass
+ * and a few AES blocks.
+ *
+ * Wrapping is deterministic: the same key and AAD always give the same
+ * output, which reveals repeats and nothing else. A context may be shared
+ * by any number of threads; only aesgcmsiv_wrap_ctx_free must not overlap
+ * any other use.
+ */
+typedef struct aesgcmsiv_wrap_ctx aesgcmsiv_wrap_ctx;
+
+/**
+ * Creates a key-wrapping context for key and nonce.
+ *
+ * @param key Pointer to 16-byte (AES-128) or 32-byte (AES-256) key-encryption key
+ * @param key_len Length of key (must be 16 or 32)
+ * @param nonce Pointer to the fixed 12-byte nonce
+ * @param nonce_len Length of nonce (must be 12)
+ * @param ctx_out Receives the new context on success; set to NULL on failure
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_wrap_ctx_new(
+    const uint8_t* key, size_t key_len,
+    const uint8_t* nonce, size_t nonce_len,
+    aesgcmsiv_wrap_ctx** ctx_out);
+
+/**
+ * aesgcmsiv_ctx_encrypt under the context's key and fixed nonce.
+ */
+AESGCMSIV_API int aesgcmsiv_wrap(
+    aesgcmsiv_wrap_ctx* ctx,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out);
+
+/**
+ * aesgcmsiv_ctx_decrypt under the context's key and fixed nonce. On tag
+ * mismatch the plaintext output is zeroed.
+ */
+AESGCMSIV_API int aesgcmsiv_unwrap(
+    aesgcmsiv_wrap_ctx* ctx,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out);
+
+/**
+ * Clears the derived keys and frees the context. Passing NULL is a no-op.
+ */
+AESGCMSIV_API void aesgcmsiv_wrap_ctx_free(aesgcmsiv_wrap_ctx* ctx);
+
+/**
+ * Opaque handle to one direction of a chunked stream, for messages too large
+ * to hold in memory at once (the STREAM construction of Hoang, Reyhanitabar,
+ * Rogaway and Vizar).
+ *
+ * A stream is a header of AESGCMSIV_STREAM_HEADER_SIZE bytes followed by
+ * chunks. Every chunk but the last holds exactly chunk_size bytes of
+ * plaintext; the last holds up to chunk_size, possibly none. Each is sealed
+ * separately as ciphertext || tag under the nonce
+ *
+ *   prefix (7 bytes) || chunk number (4 bytes, big-endian) || last (1 byte)
+ *
+ * where prefix is random per stream and last is 1 only for the final chunk.
+ * Reordering, dropping, truncating or extending the chunks therefore fails
+ * authentication. The header is version (1 byte, 1), chunk_size (4 bytes,
+ * little-endian) and prefix.
+ *
+ * A stream borrows its key context, which must outlive it, and is used by
+ * one thread at a time.
+ */
+typedef struct aesgcmsiv_stream aesgcmsiv_stream;
+
+#define AESGCMSIV_STREAM_HEADER_SIZE 12
+#define AESGCMSIV_STREAM_MAX_CHUNK_SIZE (1u << 24)  // largest chunk_size, 16 MiB
+
+/**
+ * Starts sealing a stream under a fresh random nonce prefix.
+ *
+ * @param ctx Key context
+ * @param chunk_size Plaintext bytes per chunk, 1 to AESGCMSIV_STREAM_MAX_CHUNK_SIZE
+ * @param header_out Receives the stream header (AESGCMSIV_STREAM_HEADER_SIZE bytes)
+ * @param stream_out Receives the new stream on success; set to NULL on failure
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_stream_seal_new(
+    aesgcmsiv_ctx* ctx,
+    uint32_t chunk_size,
+    uint8_t* header_out,
+    aesgcmsiv_stream** stream_out);
+
+/**
+ * Starts opening a stream from its header. A compressed stream's header (see
+ * aesgcmsiv_stream_seal_new_compressed) is accepted too; its records are then
+ * opened with aesgcmsiv_stream_open_compressed.
+ *
+ * @param ctx Key context
+ * @param header Stream header (AESGCMSIV_STREAM_HEADER_SIZE bytes)
+ * @param stream_out Receives the new stream on success; set to NULL on failure
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if the
+ *         header has an unknown version or an out-of-range chunk size
+ */
+AESGCMSIV_API int aesgcmsiv_stream_open_new(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* header,
+    aesgcmsiv_stream** stream_out);
+
+/**
+ * Returns the stream's plaintext chunk size, or 0 if stream is NULL.
+ */
+AESGCMSIV_API uint32_t aesgcmsiv_stream_chunk_size(const aesgcmsiv_stream* stream);
+
+/**
+ * Seals the next chunk.
+ *
+ * @param stream Stream from aesgcmsiv_stream_seal_new
+ * @param chunk Plaintext: exactly chunk_size bytes, or up to chunk_size if last
+ * @param chunk_len Length of chunk
+ * @param aad Additional authenticated data for this chunk (can be NULL)
+ * @param aad_len Length of aad
+ * @param last Non-zero for the final chunk; no chunk may follow it
+ * @param sealed_out Receives ciphertext || tag (chunk_len + AESGCMSIV_TAG_SIZE
+ *                   bytes); may equal chunk
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT for a
+ *         wrong chunk length, a stream that has already ended or run out of
+ *         chunk numbers, or a stream opened for decryption
+ */
+AESGCMSIV_API int aesgcmsiv_stream_seal(
+    aesgcmsiv_stream* stream,
+    const uint8_t* chunk, size_t chunk_len,
+    const uint8_t* aad, size_t aad_len,
+    int last,
+    uint8_t* sealed_out);
+
+/**
+ * Verifies and opens the next chunk. After a chunk fails to verify the
+ * stream refuses every further chunk.
+ *
+ * @param stream Stream from aesgcmsiv_stream_open_new
+ * @param sealed Sealed chunk: exactly chunk_size + AESGCMSIV_TAG_SIZE bytes,
+ *               or from AESGCMSIV_TAG_SIZE up to that if last
+ * @param sealed_len Length of sealed
+ * @param aad Additional authenticated data for this chunk (can be NULL)
+ * @param aad_len Length of aad
+ * @param last Non-zero if this is the final chunk, as known from the framing
+ * @param chunk_out Receives sealed_len - AESGCMSIV_TAG_SIZE bytes of
+ *                  plaintext; zeroed if the chunk fails to verify; may equal
+ *                  sealed
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_DECRYPT_FAILED if
+ *         the chunk does not verify, AESGCMSIV_ERROR_INVALID_INPUT as for
+ *         aesgcmsiv_stream_seal
+ */
+AESGCMSIV_API int aesgcmsiv_stream_open(
+    aesgcmsiv_stream* stream,
+    const uint8_t* sealed, size_t sealed_len,
+    const uint8_t* aad, size_t aad_len,
+    int last,
+    uint8_t* chunk_out);
+
+/**
+ * Seals chunk number index of a stream, out of order, so chunks can be
+ * sealed on several threads at once and written at their own offsets (see
+ * aesgcmsiv_stream_open_chunk for the layout). Does not change the stream's
+ * position. Each index must be sealed at most once, with last set only on
+ * the final chunk, or chunks repeat a nonce.
+ *
+ * @param stream Stream from aesgcmsiv_stream_seal_new
+ * @param index Chunk number, from 0; at most UINT32_MAX
+ * @param chunk Plaintext, as for aesgcmsiv_stream_seal
+ * @param chunk_len Length of chunk
+ * @param aad Additional authenticated data for this chunk (can be NULL)
+ * @param aad_len Length of aad
+ * @param last Non-zero for the final chunk of the stream
+ * @param sealed_out As for aesgcmsiv_stream_seal
+ *
+ * @return As for aesgcmsiv_stream_seal
+ */
+AESGCMSIV_API int aesgcmsiv_stream_seal_chunk(
+    const aesgcmsiv_stream* stream,
+    uint64_t index,
+    const uint8_t* chunk, size_t chunk_len,
+    const uint8_t* aad, size_t aad_len,
+    int last,
+    uint8_t* sealed_out);
+
+/**
+ * Verifies and opens chunk number index of a stream, out of order. For
+ * random access, such as serving a byte range: does not change the stream's
+ * position, and may be called from several threads at once on the same
+ * stream. Chunk index starts index * (chunk_size + AESGCMSIV_TAG_SIZE)
+ * bytes after the header, and is the last chunk if it reaches the end.
+ *
+ * @param stream Stream from aesgcmsiv_stream_open_new
+ * @param index Chunk number, from 0; at most UINT32_MAX
+ * @param sealed Sealed chunk, as for aesgcmsiv_stream_open
+ * @param sealed_len Length of sealed
+ * @param aad Additional authenticated data for this chunk (can be NULL)
+ * @param aad_len Length of aad
+ * @param last Non-zero if this is the final chunk of the stream
+ * @param chunk_out As for aesgcmsiv_stream_open
+ *
+ * @return As for aesgcmsiv_stream_open, but a failed chunk does not end the
+ *         stream
+ */
+AESGCMSIV_API int aesgcmsiv_stream_open_chunk(
+    const aesgcmsiv_stream* stream,
+    uint64_t index,
+    const uint8_t* sealed, size_t sealed_len,
+    const uint8_t* aad, size_t aad_len,
+    int last,
+    uint8_t* chunk_out);
+
+/**
+ * Seals a whole file into another as a stream. Both files are memory-mapped
+ * with sequential-access hints (madvise and posix_fadvise, or
+ * FILE_FLAG_SEQUENTIAL_SCAN on Windows), and each chunk is sealed straight
+ * from the input mapping into the output mapping.
+ *
+ * @param ctx Key context
+ * @param input_path File to seal, UTF-8
+ * @param output_path File to create or replace, UTF-8; removed on failure
+ * @param chunk_size Plaintext bytes per chunk, 1 to AESGCMSIV_STREAM_MAX_CHUNK_SIZE
+ * @param aad Additional authenticated data for every chunk (can be NULL)
+ * @param aad_len Length of aad
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_IO if a file could not
+ *         be opened, sized or mapped, or another negative error code
+ */
+AESGCMSIV_API int aesgcmsiv_stream_seal_file(
+    aesgcmsiv_ctx* ctx,
+    const char* input_path,
+    const char* output_path,
+    uint32_t chunk_size,
+    const uint8_t* aad, size_t aad_len);
+
+/**
+ * Opens a file sealed by aesgcmsiv_stream_seal_file, or holding any whole
+ * stream, into another, mapping both as it does.
+ *
+ * @param ctx Key context
+ * @param input_path Sealed file, UTF-8
+ * @param output_path File to create or replace, UTF-8. Removed if any chunk
+ *                    fails, so no unverified plaintext is left behind.
+ * @param aad Additional authenticated data for every chunk (can be NULL)
+ * @param aad_len Length of aad
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_DECRYPT_FAILED if a
+ *         chunk fails to authenticate or the file is truncated,
+ *         AESGCMSIV_ERROR_INVALID_INPUT for a bad header, AESGCMSIV_ERROR_IO
+ *         if a file could not be opened, sized or mapped
+ */
+AESGCMSIV_API int aesgcmsiv_stream_open_file(
+    aesgcmsiv_ctx* ctx,
+    const char* input_path,
+    const char* output_path,
+    const uint8_t* aad, size_t aad_len);
+
+/**
+ * Verifies count consecutive chunks of a stream opened for decryption,
+ * starting at chunk number first, without producing their plaintext (see
+ * aesgcmsiv_ctx_verify_ciphertext). The chunks lie back to back at sealed,
+ * as in the stream: each full, except that when last is non-zero the final
+ * one is the stream's last chunk and may be short. They are verified as
+ * batches on the context's pool if it has one. The stream's position is
+ * not used or changed.
+ *
+ * @param status_out Array of count results, one per chunk
+ *
+ * @return AESGCMSIV_SUCCESS if every chunk verified, otherwise the first
+ *         failing chunk's status; AESGCMSIV_ERROR_INVALID_INPUT without
+ *         verifying any chunk if sealed_len does not fit count chunks, the
+ *         chunk numbers run out, or the stream is compressed or sealing
+ */
+AESGCMSIV_API int aesgcmsiv_stream_verify_chunks(
+    const aesgcmsiv_stream* stream,
+    uint64_t first, size_t count,
+    const uint8_t* sealed, size_t sealed_len,
+    const uint8_t* aad, size_t aad_len,
+    int last,
+    int* status_out);
+
+/**
+ * Called by a scrub for each chunk or blob that fails: where its sealed
+ * bytes start in the file, how many there are, and the error, usually
+ * AESGCMSIV_ERROR_DECRYPT_FAILED.
+ */
+typedef void (*aesgcmsiv_scrub_callback)(void* user, uint64_t offset, uint64_t length, int status);
+
+/**
+ * Checks that every chunk of a stream file authenticates, without writing
+ * plaintext anywhere, for periodic integrity scrubbing. The file is read
+ * front to back in large windows, the next one paged in while the current
+ * one is verified on the context's pool, and each window is dropped from
+ * the page cache once verified so the scrub does not push out data other
+ * readers need. A failing chunk is reported and the scrub goes on.
+ *
+ * @param ctx Key context
+ * @param input_path Stream file, UTF-8; compressed streams are not supported
+ * @param aad Additional authenticated data for every chunk (can be NULL)
+ * @param aad_len Length of aad
+ * @param max_bytes_per_second Read rate to stay under, 0 for no limit
+ * @param callback Called for each corrupt chunk (can be NULL)
+ * @param user Passed to callback
+ * @param corrupt_out Receives the number of corrupt chunks (can be NULL)
+ *
+ * @return AESGCMSIV_SUCCESS if every chunk verified,
+ *         AESGCMSIV_ERROR_DECRYPT_FAILED if any did not or the file is
+ *         truncated, AESGCMSIV_ERROR_INVALID_INPUT for a bad header,
+ *         AESGCMSIV_ERROR_IO if the file could not be opened or mapped
+ */
+AESGCMSIV_API int aesgcmsiv_stream_scrub_file(
+    aesgcmsiv_ctx* ctx,
+    const char* input_path,
+    const uint8_t* aad, size_t aad_len,
+    uint64_t max_bytes_per_second,
+    aesgcmsiv_scrub_callback callback, void* user,
+    uint64_t* corrupt_out);
+
+// Compression methods for aesgcmsiv_stream_seal_new_compressed
+#define AESGCMSIV_COMPRESS_NONE 0
+#define AESGCMSIV_COMPRESS_ZSTD 1  // built in with the AESGCMSIV_ZSTD CMake option
+#define AESGCMSIV_COMPRESS_LZ4 2  // built in with the AESGCMSIV_LZ4 CMake option
+
+// Bytes of length and flag ahead of each record of a compressed stream
+#define AESGCMSIV_STREAM_FRAME_SIZE 4
+
+// Largest record a compressed stream writes for chunk_len bytes of plaintext
+#define AESGCMSIV_STREAM_COMPRESSED_MAX(chunk_len) \
+    (AESGCMSIV_STREAM_FRAME_SIZE + 1 + (chunk_len) + AESGCMSIV_TAG_SIZE)
+
+/**
+ * Returns 1 if method, an AESGCMSIV_COMPRESS_* value, is built into this
+ * library, and 0 if not. AESGCMSIV_COMPRESS_NONE always is.
+ */
+AESGCMSIV_API int aesgcmsiv_compression_supported(uint32_t method);
+
+/**
+ * Starts sealing a compressed stream, in which each chunk of plaintext is
+ * compressed and then sealed in one call, through scratch memory the stream
+ * owns.
+ *
+ * The header is as for aesgcmsiv_stream_seal_new but with version 2, and
+ * chunk_size still counts plaintext. Since compressed chunks vary in length,
+ * each is written as a record:
+ *
+ *   frame (4 bytes, little-endian) || ciphertext || tag
+ *
+ * where the frame's low 31 bits are the length of ciphertext || tag and its
+ * top bit is set only on the last record. The ciphertext seals one byte
+ * naming the compression method followed by the compressed chunk, or by the
+ * chunk as it is when compressing would not make it shorter, under the same
+ * nonces as an uncompressed stream. Records have no fixed offsets, so a
+ * compressed stream is read in order only.
+ *
+ * @param ctx Key context
+ * @param chunk_size Plaintext bytes per chunk, 1 to AESGCMSIV_STREAM_MAX_CHUNK_SIZE
+ * @param method AESGCMSIV_COMPRESS_ZSTD or AESGCMSIV_COMPRESS_LZ4, or
+ *               AESGCMSIV_COMPRESS_NONE to use the record format uncompressed
+ * @param level zstd compression level, 0 for zstd's default; for LZ4 the
+ *              acceleration factor, 0 or 1 for LZ4's default
+ * @param header_out Receives the stream header (AESGCMSIV_STREAM_HEADER_SIZE bytes)
+ * @param stream_out Receives the new stream on success; set to NULL on failure
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if
+ *         method is not built in (see aesgcmsiv_compression_supported)
+ */
+AESGCMSIV_API int aesgcmsiv_stream_seal_new_compressed(
+    aesgcmsiv_ctx* ctx,
+    uint32_t chunk_size,
+    uint32_t method,
+    int level,
+    uint8_t* header_out,
+    aesgcmsiv_stream** stream_out);
+
+/**
+ * Compresses and seals the next chunk of a compressed stream as one record.
+ *
+ * @param stream Stream from aesgcmsiv_stream_seal_new_compressed
+ * @param chunk Plaintext: exactly chunk_size bytes, or up to chunk_size if last
+ * @param chunk_len Length of chunk
+ * @param aad Additional authenticated data for this chunk (can be NULL)
+ * @param aad_len Length of aad
+ * @param last Non-zero for the final chunk; no chunk may follow it
+ * @param record_out Receives the record; must hold
+ *                   AESGCMSIV_STREAM_COMPRESSED_MAX(chunk_len) bytes and not
+ *                   overlap chunk
+ * @param record_len_out Receives the length of the record
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT as for
+ *         aesgcmsiv_stream_seal, or for a stream that is not compressed
+ */
+AESGCMSIV_API int aesgcmsiv_stream_seal_compressed(
+    aesgcmsiv_stream* stream,
+    const uint8_t* chunk, size_t chunk_len,
+    const uint8_t* aad, size_t aad_len,
+    int last,
+    uint8_t* record_out,
+    size_t* record_len_out);
+
+/**
+ * Verifies, opens and decompresses the next record of a compressed stream,
+ * whose header aesgcmsiv_stream_open_new accepts. The caller reads the
+ * frame first to learn the record's length. After a record fails to verify
+ * the stream refuses every further record.
+ *
+ * @param stream Stream from aesgcmsiv_stream_open_new
+ * @param record The whole record, frame included
+ * @param record_len Length of record; must match its frame
+ * @param aad Additional authenticated data for this chunk (can be NULL)
+ * @param aad_len Length of aad
+ * @param chunk_out Receives the plaintext; must hold chunk_size bytes. Written
+ *                  only once the record has verified.
+ * @param chunk_len_out Receives the length of the plaintext
+ * @param last_out Receives 1 if this was the last record, else 0 (can be NULL)
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_DECRYPT_FAILED if
+ *         the record does not verify, AESGCMSIV_ERROR_INVALID_INPUT for a
+ *         malformed record, a stream that is not compressed or has ended, or
+ *         a record compressed with a method not built in
+ */
+AESGCMSIV_API int aesgcmsiv_stream_open_compressed(
+    aesgcmsiv_stream* stream,
+    const uint8_t* record, size_t record_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* chunk_out,
+    size_t* chunk_len_out,
+    int* last_out);
+
+/**
+ * Frees a stream. Does not free its key context.
+ */
+AESGCMSIV_API void aesgcmsiv_stream_free(aesgcmsiv_stream* stream);
+
+/**
+ * Sets the memory budget for chunk windows. A writer that gathers several
+ * chunks before sealing them as one batch takes the memory for them as one
+ * window from a process-wide pool, with aesgcmsiv_stream_window_acquire, and
+ * the windows every stream holds, and those kept for reuse, stay within the
+ * budget: a writer gets fewer chunks when room is short and waits when there
+ * is none, so memory stays flat however many streams burst at once.
+ *
+ * Lowering the budget below what is held takes effect as windows are
+ * released; raising it wakes writers waiting for room.
+ *
+ * @param max_bytes Budget in bytes, or 0, the default, for no limit
+ *
+ * @return AESGCMSIV_SUCCESS
+ */
+AESGCMSIV_API int aesgcmsiv_stream_budget_set(uint64_t max_bytes);
+
+/**
+ * Takes a window of chunk_bytes-sized chunks from the pool: wanted chunks
+ * if the budget has room for them, otherwise as many as fit, but never
+ * fewer than min_chunks. The window is zero-filled and page-aligned, with
+ * chunk i at window + i * chunk_bytes.
+ *
+ * @param chunk_bytes Bytes per chunk, at least 1
+ * @param wanted Chunks wanted, at least 1
+ * @param min_chunks Fewest chunks to accept, 1 to wanted
+ * @param wait Nonzero to wait until min_chunks fit, 0 to fail at once
+ * @param window_out Receives the window
+ * @param chunks_out Receives the number of chunks granted
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_BUSY if min_chunks
+ *         do not fit and wait is 0, AESGCMSIV_ERROR_INVALID_INPUT for bad
+ *         arguments or if min_chunks exceed the whole budget,
+ *         AESGCMSIV_ERROR_INTERNAL if the memory could not be allocated
+ */
+AESGCMSIV_API int aesgcmsiv_stream_window_acquire(
+    size_t chunk_bytes, uint32_t wanted, uint32_t min_chunks, int wait,
+    uint8_t** window_out, uint32_t* chunks_out);
+
+/**
+ * Wipes a window from aesgcmsiv_stream_window_acquire and returns it to the
+ * pool, waking writers waiting for room. Passing NULL is a no-op.
+ */
+AESGCMSIV_API void aesgcmsiv_stream_window_release(uint8_t* window);
+
+typedef struct aesgcmsiv_stream_budget_stats {
+    uint64_t max_bytes;  // the budget, 0 for none
+    uint64_t bytes_in_use;  // in windows held by writers
+    uint64_t bytes_cached;  // in released windows kept for reuse
+    uint64_t windows;  // windows granted since the library was loaded
+    uint64_t shrunk;  // of those, granted fewer chunks than wanted
+    uint64_t waits;  // times a writer waited for room
+} aesgcmsiv_stream_budget_stats;
+
+/**
+ * Reads the chunk window pool's counters.
+ *
+ * @param stats_out Receives the counters
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if
+ *         stats_out is NULL
+ */
+AESGCMSIV_API int aesgcmsiv_stream_budget_get_stats(aesgcmsiv_stream_budget_stats* stats_out);
+
+/**
+ * Encrypts a whole file as one RFC 8452 message, for consumers that need the
+ * standard format rather than a stream. The output is ciphertext || tag,
+ * AESGCMSIV_TAG_SIZE bytes longer than the input.
+ *
+ * Both files are memory-mapped as for aesgcmsiv_stream_seal_file, so a file
+ * larger than memory is read in two passes, POLYVAL and then CTR, each paged
+ * in ahead and dropped behind. The input is limited to
+ * AESGCMSIV_MAX_INPUT_SIZE bytes, and without a hand-written kernel to
+ * INT_MAX.
+ *
+ * @param ctx Key context
+ * @param nonce Pointer to 12-byte nonce
+ * @param nonce_len Length of nonce (must be 12)
+ * @param input_path File to encrypt, UTF-8
+ * @param output_path File to create or replace, UTF-8; removed on failure
+ * @param aad Additional authenticated data (can be NULL)
+ * @param aad_len Length of aad
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_IO if a file could not
+ *         be opened, sized or mapped, or another negative error code
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_encrypt_file(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const char* input_path,
+    const char* output_path,
+    const uint8_t* aad, size_t aad_len);
+
+/**
+ * Decrypts a file holding one message, ciphertext || tag, as written by
+ * aesgcmsiv_ctx_encrypt_file. The plaintext is written to a provisional file
+ * beside output_path and renamed over it only once the tag verifies, so
+ * output_path never holds unverified plaintext and is left as it was on
+ * failure.
+ *
+ * @param ctx Key context
+ * @param nonce Pointer to 12-byte nonce
+ * @param nonce_len Length of nonce (must be 12)
+ * @param input_path Encrypted file, UTF-8
+ * @param output_path File to create or replace, UTF-8
+ * @param aad Additional authenticated data (can be NULL)
+ * @param aad_len Length of aad
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_DECRYPT_FAILED if the
+ *         tag does not verify or the file is shorter than a tag,
+ *         AESGCMSIV_ERROR_IO if a file could not be opened, sized, mapped or
+ *         renamed, or another negative error code
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_decrypt_file(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const char* input_path,
+    const char* output_path,
+    const uint8_t* aad, size_t aad_len);
+
+/**
+ * Opaque handle to a pack file opened for reading: many small blobs, each
+ * sealed on its own, behind an index that finds one by id with a binary
+ * search, so fetching a blob costs a page fault or two and one decryption.
+ *
+ * A pack is a header of AESGCMSIV_PACK_HEADER_SIZE bytes, the index, then
+ * each blob as ciphertext || tag. The header is "AGSP", version (1 byte,
+ * 1), id_size (1 byte), 2 zero bytes, the entry count (8 bytes,
+ * little-endian), a random base nonce (12 bytes) and 4 zero bytes. The
+ * index holds one entry per blob, sorted by id as bytes: the id (id_size
+ * bytes), then the offset of the sealed blob from the start of the file and
+ * its plaintext length (8 bytes each, little-endian). Entry i of the index
+ * is sealed under the base nonce with its last 8 bytes XORed with i,
+ * little-endian, and with its id as associated data, so an entry whose id,
+ * position or data was changed fails to authenticate.
+ *
+ * A pack is read-only once written and may be read from several threads at
+ * once.
+ */
+typedef struct aesgcmsiv_pack aesgcmsiv_pack;
+
+#define AESGCMSIV_PACK_HEADER_SIZE 32
+#define AESGCMSIV_PACK_MAX_ID_SIZE 64  // largest id_size
+
+/**
+ * Writes a pack of count blobs. Blob i has the id at ids + i * id_size and
+ * the data blobs[i] of blob_lens[i] bytes; the blobs may be given in any
+ * order, and are sealed as batches on the context's pool if it has one.
+ *
+ * @param ctx Key context
+ * @param output_path File to create or replace, UTF-8; removed on failure
+ * @param id_size Bytes per id, 1 to AESGCMSIV_PACK_MAX_ID_SIZE
+ * @param count Number of blobs
+ * @param ids count ids of id_size bytes each, all different
+ * @param blobs Array of count pointers; an entry may be NULL if its length
+ *        is 0
+ * @param blob_lens Array of count lengths
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if an
+ *         argument is invalid or two ids are equal, AESGCMSIV_ERROR_IO if the
+ *         file could not be created or mapped, or another negative error code
+ */
+AESGCMSIV_API int aesgcmsiv_pack_write_file(
+    aesgcmsiv_ctx* ctx,
+    const char* output_path,
+    size_t id_size,
+    size_t count,
+    const uint8_t* ids,
+    const uint8_t* const* blobs,
+    const size_t* blob_lens);
+
+/**
+ * Opens a pack for reading. The file is memory-mapped with a hint that it
+ * is read at random, so only the index pages a search touches and the
+ * blobs read are paged in. Only the header is checked here; each entry is
+ * checked when it is read.
+ *
+ * @param input_path Pack file, UTF-8
+ * @param pack_out Receives the pack; free with aesgcmsiv_pack_free
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if the
+ *         file does not start with a valid pack header or is too short for
+ *         its index, AESGCMSIV_ERROR_IO if it could not be opened or mapped
+ */
+AESGCMSIV_API int aesgcmsiv_pack_open(const char* input_path, aesgcmsiv_pack** pack_out);
+
+/**
+ * Returns the number of blobs in a pack, or 0 if pack is NULL.
+ */
+AESGCMSIV_API uint64_t aesgcmsiv_pack_count(const aesgcmsiv_pack* pack);
+
+/**
+ * Returns the bytes per id of a pack, or 0 if pack is NULL.
+ */
+AESGCMSIV_API size_t aesgcmsiv_pack_id_size(const aesgcmsiv_pack* pack);
+
+/**
+ * Looks up a blob without decrypting it, to size its output buffer.
+ *
+ * @param pack Pack
+ * @param id The id, aesgcmsiv_pack_id_size bytes
+ * @param length_out Receives the blob's length
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_NOT_FOUND if no
+ *         entry has the id, AESGCMSIV_ERROR_DECRYPT_FAILED if the entry
+ *         points outside the file
+ */
+AESGCMSIV_API int aesgcmsiv_pack_find(const aesgcmsiv_pack* pack, const uint8_t* id, size_t* length_out);
+
+/**
+ * Reads a batch of blobs by id, decrypting straight from the mapping into
+ * the caller's buffers. The blobs found are opened as batches on the
+ * context's pool if it has one, through the multi-buffer kernel when short.
+ *
+ * Every id is processed, whatever the outcome of the others, and its
+ * result is written to status_out: AESGCMSIV_ERROR_NOT_FOUND if no entry
+ * has the id, AESGCMSIV_ERROR_INVALID_INPUT if outputs[i] is shorter than
+ * the blob (lengths_out still gets the length), and
+ * AESGCMSIV_ERROR_DECRYPT_FAILED if it does not authenticate, in which case
+ * its output is zeroed.
+ *
+ * @param ctx Key context the pack was written with
+ * @param pack Pack
+ * @param count Number of ids
+ * @param ids count ids of aesgcmsiv_pack_id_size bytes each
+ * @param outputs Array of count buffers
+ * @param output_lens Array of count buffer sizes
+ * @param lengths_out Array of count blob lengths, or NULL
+ * @param status_out Array of count results, one per id
+ *
+ * @return AESGCMSIV_SUCCESS if every blob was read, otherwise the first
+ *         failing id's status; AESGCMSIV_ERROR_INVALID_INPUT without
+ *         processing any id if the arguments themselves are invalid
+ */
+AESGCMSIV_API int aesgcmsiv_pack_read_batch(
+    aesgcmsiv_ctx* ctx,
+    const aesgcmsiv_pack* pack,
+    size_t count,
+    const uint8_t* ids,
+    uint8_t* const* outputs,
+    const size_t* output_lens,
+    size_t* lengths_out,
+    int* status_out);
+
+/**
+ * aesgcmsiv_stream_scrub_file for a pack: checks that every blob
+ * authenticates under its entry, reading the blobs in file order. An entry
+ * that points outside the file is reported at its own offset in the index.
+ *
+ * @return As aesgcmsiv_stream_scrub_file
+ */
+AESGCMSIV_API int aesgcmsiv_pack_scrub(
+    aesgcmsiv_ctx* ctx,
+    const aesgcmsiv_pack* pack,
+    uint64_t max_bytes_per_second,
+    aesgcmsiv_scrub_callback callback, void* user,
+    uint64_t* corrupt_out);
+
+/**
+ * Unmaps and frees a pack. NULL is ignored.
+ */
+AESGCMSIV_API void aesgcmsiv_pack_free(aesgcmsiv_pack* pack);
+
+/**
+ * Process-wide dispatch thresholds. The right values depend on the CPU and
+ * memory system, so they can be measured once and applied at startup; a
+ * field of 0 means the built-in default. None of them changes the output.
+ */
+typedef struct aesgcmsiv_tuning {
+    // Smallest share of one message worth a thread of its own when a
+    // context splits it (see aesgcmsiv_ctx_set_threads). Default 1 MiB.
+    size_t parallel_min_bytes;
+    // Items per pool task when a batch is spread over a pool, rounded up to
+    // a whole number of multi-buffer lane groups. Default 64.
+    size_t batch_chunk_items;
+    // Longest message, in 16-byte blocks of AAD and plaintext each rounded
+    // up plus the length block, that a batch runs through the multi-buffer
+    // kernels instead of one at a time. At most 17, the default; 1 turns the
+    // lanes off for all but empty messages.
+    size_t lane_max_blocks;
+} aesgcmsiv_tuning;
+
+/**
+ * Replaces the dispatch thresholds for the whole process. Calls already
+ * running may use either the old or the new values.
+ *
+ * @param tuning New thresholds, or NULL to restore every default
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if
+ *         lane_max_blocks is over 17
+ */
+AESGCMSIV_API int aesgcmsiv_set_tuning(const aesgcmsiv_tuning* tuning);
+
+/**
+ * Reads the dispatch thresholds in effect, with defaults filled in.
+ *
+ * @param tuning_out Receives the thresholds
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if
+ *         tuning_out is NULL
+ */
+AESGCMSIV_API int aesgcmsiv_get_tuning(aesgcmsiv_tuning* tuning_out);
+
+// Flags in aesgcmsiv_caps
+#define AESGCMSIV_CAPS_KEY_128  (1u << 0)  // 16-byte keys
+#define AESGCMSIV_CAPS_KEY_256  (1u << 1)  // 32-byte keys
+#define AESGCMSIV_CAPS_IN_PLACE (1u << 2)  // output may be the input buffer itself
+#define AESGCMSIV_CAPS_SMALL    (1u << 3)  // the _small entry points run
+#define AESGCMSIV_CAPS_PARALLEL (1u << 4)  // a context can split one message over threads
+
+/**
+ * What the backend in use can do, for sizing work without hard-coding
+ * constants. Sizes follow the current aesgcmsiv_tuning.
+ */
+typedef struct aesgcmsiv_caps {
+    uint32_t flags;  // AESGCMSIV_CAPS_* bits
+    // Longest plaintext, and separately longest AAD, one call accepts:
+    // AESGCMSIV_MAX_INPUT_SIZE, or INT_MAX through OpenSSL
+    uint64_t max_input_len;
+    // Short messages a batch runs side by side; batches of a multiple of it
+    // waste no lanes. 1 if the backend has no multi-buffer path.
+    size_t batch_width;
+    // Longest AAD plus plaintext, each rounded up to 16 bytes, that still
+    // goes through the lanes; 0 with a batch_width of 1
+    size_t lane_max_bytes;
+    // Buffer alignment that lets every kernel load and store whole vectors
+    // without crossing a cache line; any alignment works
+    size_t alignment;
+    // Smallest share of a message worth a thread when a context splits it
+    // (aesgcmsiv_ctx_set_threads); 0 without AESGCMSIV_CAPS_PARALLEL
+    size_t parallel_min_bytes;
+    // Most threads one split call uses
+    unsigned int parallel_max_threads;
+} aesgcmsiv_caps;
+
+/**
+ * Reports what the backend in use (see aesgcmsiv_get_backend) can do. The
+ * answer changes with aesgcmsiv_set_tuning and aesgcmsiv_select_backend.
+ *
+ * @param caps_out Receives the capabilities
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if
+ *         caps_out is NULL
+ */
+AESGCMSIV_API int aesgcmsiv_get_caps(aesgcmsiv_caps* caps_out);
+
+/**
+ * POLYVAL (RFC 8452 section 3) as a keyed universal hash of its own, run on
+ * the fastest hand-written kernel the CPU supports whichever backend
+ * aesgcmsiv_select_backend chose. Keying computes the powers of the hash
+ * key once; after that a state hashes any number of inputs, one after
+ * another, each finished by aesgcmsiv_polyval_final. A state is used by one
+ * thread at a time.
+ *
+ * POLYVAL is only a universal hash: it is not a MAC unless its output is
+ * encrypted, and the key must stay secret for its collision bound to hold.
+ */
+typedef struct aesgcmsiv_polyval aesgcmsiv_polyval;
+
+/**
+ * Creates a POLYVAL state keyed with the 16-byte hash key H.
+ *
+ * @param key Hash key
+ * @param key_len Must be 16
+ * @param state_out Receives the new state on success
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_KEY if key
+ *         is NULL or key_len is not 16, AESGCMSIV_ERROR_NOT_FOUND if this
+ *         build has no kernel for the CPU (the bitsliced kernel left out
+ *         and no AES instructions), AESGCMSIV_ERROR_INTERNAL if out of memory
+ */
+AESGCMSIV_API int aesgcmsiv_polyval_init(
+    const uint8_t* key, size_t key_len,
+    aesgcmsiv_polyval** state_out);
+
+/**
+ * Absorbs data into the input being hashed. Input may arrive in pieces of
+ * any length; only a trailing partial block is held back.
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if
+ *         state is NULL, or data is NULL with a nonzero len
+ */
+AESGCMSIV_API int aesgcmsiv_polyval_update(
+    aesgcmsiv_polyval* state,
+    const uint8_t* data, size_t len);
+
+/**
+ * Writes POLYVAL of everything absorbed since the state was created or last
+ * finished, with a final partial block zero-padded, and starts the state
+ * over under the same key. Because of the padding, inputs that differ only
+ * in trailing zero bytes within their last block hash alike; callers that
+ * need them apart should absorb the length as a last block.
+ *
+ * @param hash_out Receives the 16-byte result
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if
+ *         state or hash_out is NULL
+ */
+AESGCMSIV_API int aesgcmsiv_polyval_final(aesgcmsiv_polyval* state, uint8_t* hash_out);
+
+/**
+ * Clears and frees a POLYVAL state. NULL is ignored.
+ */
+AESGCMSIV_API void aesgcmsiv_polyval_free(aesgcmsiv_polyval* state);
+
+/**
+ * Starts aesgcmsiv_ctx_encrypt as an OpenSSL ASYNC job, so a cipher on an
+ * offload engine can pause while the device works instead of blocking the
+ * thread.
+ *
+ * If the job finishes without pausing, its result is returned and *job_out
+ * is set to NULL. Otherwise AESGCMSIV_PENDING is returned and *job_out
+ * receives the job, which must be passed to aesgcmsiv_job_poll until that
+ * returns something other than AESGCMSIV_PENDING. Until then ctx and every
+ * buffer must stay valid. Jobs only pause on contexts whose cipher comes from
+ * an engine that supports it (see aesgcmsiv_ctx_new_ex); where OpenSSL has no
+ * ASYNC support, the call simply runs to completion.
+ *
+ * Parameters and output buffers follow aesgcmsiv_ctx_encrypt.
+ *
+ * @param job_out Receives the pending job, or NULL
+ *
+ * @return The result of the encryption, or AESGCMSIV_PENDING
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_encrypt_submit(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out,
+    aesgcmsiv_job** job_out);
+
+/**
+ * aesgcmsiv_ctx_encrypt_submit for aesgcmsiv_ctx_decrypt.
+ *
+ * Parameters and output buffers follow aesgcmsiv_ctx_decrypt.
+ *
+ * @param job_out Receives the pending job, or NULL
+ *
+ * @return The result of the decryption, or AESGCMSIV_PENDING
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_decrypt_submit(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out,
+    aesgcmsiv_job** job_out);
+
+/**
+ * Resumes a pending job. Must be called on the thread that submitted it.
+ *
+ * @param job Job from a submit call that returned AESGCMSIV_PENDING
+ *
+ * @return AESGCMSIV_PENDING if the job paused again; otherwise its result,
+ *         after which job has been freed and must not be used
+ */
+AESGCMSIV_API int aesgcmsiv_job_poll(aesgcmsiv_job* job);
+
+/**
+ * Called once when a call queued by aesgcmsiv_ctx_encrypt_async or
+ * aesgcmsiv_ctx_decrypt_async finishes, on a pool worker, with the result
+ * the synchronous call would have returned. It should return promptly,
+ * since the worker runs other work after it.
+ */
+typedef void (*aesgcmsiv_done_fn)(void* user_data, int status);
+
+/**
+ * Runs aesgcmsiv_ctx_encrypt on the context's pool (see
+ * aesgcmsiv_ctx_set_pool) and returns without waiting, for large messages
+ * that would otherwise hold the caller for milliseconds. The worker that
+ * takes the call splits it across the pool as aesgcmsiv_ctx_set_threads
+ * allows, just as a synchronous call would.
+ *
+ * The parameters are checked here, and a call that fails the check returns
+ * its error without calling done. On a context without a pool, or when
+ * every worker's queue is full, the call runs on the calling thread and
+ * its result is returned, again without calling done. Otherwise
+ * AESGCMSIV_PENDING is returned and done(user_data, status) reports the
+ * result later; until then ctx and every buffer must stay valid.
+ *
+ * Parameters and output buffers follow aesgcmsiv_ctx_encrypt.
+ *
+ * @param done Completion callback; must not be NULL
+ * @param user_data Passed to done unchanged
+ *
+ * @return The result of the encryption, or AESGCMSIV_PENDING
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_encrypt_async(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out,
+    aesgcmsiv_done_fn done, void* user_data);
+
+/**
+ * aesgcmsiv_ctx_encrypt_async for aesgcmsiv_ctx_decrypt.
+ *
+ * Parameters and output buffers follow aesgcmsiv_ctx_decrypt.
+ *
+ * @return The result of the decryption, or AESGCMSIV_PENDING
+ */
+AESGCMSIV_API int aesgcmsiv_ctx_decrypt_async(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out,
+    aesgcmsiv_done_fn done, void* user_data);
+
+/**
+ * Opaque handle to a pool of worker threads fed by lock-free submission
+ * rings. Requests from any number of threads are drained in batches, grouped
+ * by context so short messages go through the multi-buffer kernels, and
+ * their results are posted to a completion ring for one consumer to reap.
+ *
+ * Submissions go to one of two lanes. Workers take the latency lane first,
+ * and take the bulk lane only while the latency lane is empty, a slice of
+ * about AESGCMSIV_ENGINE_SLICE bytes at a time. A bulk message longer than
+ * a slice is worked through a slice at a time on a key context with a
+ * kernel, and between slices its worker runs whatever has arrived on the
+ * latency lane, so a short request waits for at most one slice of bulk work
+ * rather than a whole multi-megabyte message. The priority is strict: a
+ * latency lane that never empties holds the bulk lane back.
+ */
+typedef struct aesgcmsiv_engine aesgcmsiv_engine;
+
+// Operations for aesgcmsiv_request
+#define AESGCMSIV_OP_ENCRYPT 0
+#define AESGCMSIV_OP_DECRYPT 1
+
+/**
+ * One call queued on an engine. item follows aesgcmsiv_batch_item; the
+ * context and every buffer must stay valid until the request's completion
+ * has been reaped.
+ */
+typedef struct aesgcmsiv_request {
+    aesgcmsiv_ctx* ctx;
+    uint32_t op;  // AESGCMSIV_OP_*
+    aesgcmsiv_batch_item item;
+    uint64_t user_data;  // returned unchanged in the completion
+} aesgcmsiv_request;
+
+// Lanes for aesgcmsiv_engine_submit_lane
+#define AESGCMSIV_LANE_LATENCY 0
+#define AESGCMSIV_LANE_BULK 1
+#define AESGCMSIV_ENGINE_LANES 2
+
+// Longest message aesgcmsiv_engine_submit puts on the latency lane
+#define AESGCMSIV_ENGINE_LATENCY_MAX 16384
+
+// Bulk bytes a worker runs before it looks at the latency lane again
+#define AESGCMSIV_ENGINE_SLICE 262144
+
+// Longest linger aesgcmsiv_engine_set_linger accepts, in nanoseconds
+#define AESGCMSIV_ENGINE_MAX_LINGER_NS 1000000
+
+typedef struct aesgcmsiv_completion {
+    uint64_t user_data;
+    int status;  // result the equivalent aesgcmsiv_ctx_* call would return
+} aesgcmsiv_completion;
+
+/**
+ * Creates an engine and starts its worker threads.
+ *
+ * @param workers Number of worker threads; 0 uses aesgcmsiv_available_cpus
+ * @param queue_depth Most requests submitted but not yet reaped, rounded up
+ *        to a power of two
+ * @param engine_out Receives the new engine on success; set to NULL on failure
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_engine_new(
+    unsigned int workers, size_t queue_depth,
+    aesgcmsiv_engine** engine_out);
+
+/**
+ * Queues a request. Safe to call from any number of threads at once, and
+ * never blocks.
+ *
+ * The request's parameters are checked here; a request that fails the check
+ * is rejected with the error the aesgcmsiv_ctx_* call would return and posts
+ * no completion.
+ *
+ * When queue_depth requests are already outstanding it fails with
+ * AESGCMSIV_ERROR_BUSY, or on an engine set blocking by
+ * aesgcmsiv_engine_set_blocking waits until a reap makes room.
+ *
+ * @return AESGCMSIV_SUCCESS if queued, AESGCMSIV_ERROR_BUSY if queue_depth
+ *         requests are already outstanding, AESGCMSIV_ERROR_INVALID_INPUT
+ *         after aesgcmsiv_engine_shutdown, other negative error codes for an
+ *         invalid request
+ */
+AESGCMSIV_API int aesgcmsiv_engine_submit(
+    aesgcmsiv_engine* engine,
+    const aesgcmsiv_request* request);
+
+/**
+ * aesgcmsiv_engine_submit onto a chosen lane. aesgcmsiv_engine_submit puts
+ * messages of up to AESGCMSIV_ENGINE_LATENCY_MAX bytes on the latency lane
+ * and longer ones on the bulk lane; a caller that knows better, such as a
+ * re-encryption job whose records happen to be short, names the lane here.
+ * queue_depth covers both lanes together.
+ *
+ * @param lane AESGCMSIV_LANE_LATENCY or AESGCMSIV_LANE_BULK
+ *
+ * @return As aesgcmsiv_engine_submit; AESGCMSIV_ERROR_INVALID_INPUT for an
+ *         unknown lane
+ */
+AESGCMSIV_API int aesgcmsiv_engine_submit_lane(
+    aesgcmsiv_engine* engine,
+    const aesgcmsiv_request* request,
+    uint32_t lane);
+
+/**
+ * Lets an engine's workers hold a batch of latency-lane requests open for
+ * up to linger_ns, until batch_target requests have arrived, so that the
+ * multi-buffer kernels get full lanes. A worker only lingers while it keeps
+ * finding more than one request waiting when it comes back for work, which
+ * means requests are arriving faster than they are run; under light load
+ * each request is dispatched as soon as a worker is free. A lingering
+ * worker yields its processor rather than sleeping. Off (linger_ns 0) by
+ * default; around 20 microseconds suits small messages from many threads.
+ *
+ * @param linger_ns Longest a worker waits for a fuller batch, 0 to
+ *        AESGCMSIV_ENGINE_MAX_LINGER_NS; 0 dispatches at once
+ * @param batch_target Requests a worker waits for, up to 64; 0 for the
+ *        width of the multi-buffer kernels
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if
+ *         engine is NULL or an argument is out of range
+ */
+AESGCMSIV_API int aesgcmsiv_engine_set_linger(
+    aesgcmsiv_engine* engine,
+    uint64_t linger_ns, size_t batch_target);
+
+/**
+ * Chooses what a submit to a full engine does: with block nonzero it waits
+ * until a reap makes room, or until aesgcmsiv_engine_shutdown, after which
+ * it fails with AESGCMSIV_ERROR_INVALID_INPUT; with block 0, the default,
+ * it fails at once with AESGCMSIV_ERROR_BUSY. A blocking submit must not be
+ * made from the only thread that reaps the engine. Switching blocking off
+ * releases submitters already waiting, with AESGCMSIV_ERROR_BUSY.
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if
+ *         engine is NULL
+ */
+AESGCMSIV_API int aesgcmsiv_engine_set_blocking(aesgcmsiv_engine* engine, int block);
+
+typedef struct aesgcmsiv_engine_lane_stats {
+    uint64_t submitted;  // requests queued on the lane
+    uint64_t started;  // requests a worker has taken off the lane
+    uint64_t depth;  // requests waiting for a worker now
+    uint64_t max_depth;  // most requests ever waiting at once
+    uint64_t wait_ns;  // total time started requests waited for a worker
+    uint64_t max_wait_ns;  // longest any request waited
+} aesgcmsiv_engine_lane_stats;
+
+typedef struct aesgcmsiv_engine_stats {
+    aesgcmsiv_engine_lane_stats lanes[AESGCMSIV_ENGINE_LANES];  // by AESGCMSIV_LANE_*
+    uint64_t preemptions;  // times bulk work paused for the latency lane
+} aesgcmsiv_engine_stats;
+
+/**
+ * Reads an engine's per-lane counters, kept since it was created. Each
+ * counter is read on its own while the workers run, so the counters may be
+ * a few requests apart from one another. The mean wait of a lane is
+ * wait_ns / started.
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if
+ *         engine or stats_out is NULL
+ */
+AESGCMSIV_API int aesgcmsiv_engine_get_stats(
+    aesgcmsiv_engine* engine,
+    aesgcmsiv_engine_stats* stats_out);
+
+/**
+ * Takes up to max finished requests off the completion ring, in no
+ * particular order. Only one thread may reap an engine at a time.
+ *
+ * @param engine Engine
+ * @param completions Array of max entries to fill
+ * @param max Size of completions
+ * @param wait Nonzero to block until at least one request finishes, or
+ *        until the engine has been shut down and has nothing outstanding
+ * @param count_out Receives the number of entries filled
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_engine_reap(
+    aesgcmsiv_engine* engine,
+    aesgcmsiv_completion* completions, size_t max,
+    int wait,
+    size_t* count_out);
+
+/**
+ * Gets a handle that an event loop can wait on for an engine's completions,
+ * so that they are reaped from the loop's own thread instead of a thread
+ * parked in a waiting aesgcmsiv_engine_reap, and without polling. On Linux
+ * it is an eventfd and elsewhere on POSIX the read end of a pipe, either
+ * one non-blocking, to add to epoll, kqueue or a libuv poll handle as
+ * readable; on Windows it is a manual-reset event, for
+ * RegisterWaitForSingleObject, WaitForMultipleObjects or a libuv-style
+ * wait.
+ *
+ * The handle is level-triggered: it is readable, or signaled, while
+ * completions are waiting. A worker raises it when it posts completions to
+ * an empty ring, and aesgcmsiv_engine_reap clears it when it takes the
+ * last one, so on each wakeup reap without waiting until a call returns
+ * fewer than max. Do not read from or reset the handle yourself. A wakeup
+ * may find nothing to reap.
+ *
+ * The handle is made by the first call; until then the engine makes no
+ * system calls to signal. It belongs to the engine, is closed by
+ * aesgcmsiv_engine_free, and is not inherited by child processes.
+ *
+ * @param engine Engine
+ * @param handle_out Receives the file descriptor or HANDLE
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if
+ *         engine or handle_out is NULL, AESGCMSIV_ERROR_INTERNAL if the
+ *         OS refuses to make the handle
+ */
+AESGCMSIV_API int aesgcmsiv_engine_get_notify_handle(
+    aesgcmsiv_engine* engine,
+    intptr_t* handle_out);
+
+/**
+ * Stops an engine accepting requests. Requests already queued still run and
+ * post their completions, and a waiting reap returns once none is left.
+ * Calling it again has no effect.
+ */
+AESGCMSIV_API void aesgcmsiv_engine_shutdown(aesgcmsiv_engine* engine);
+
+/**
+ * Shuts an engine down if needed, waits for its workers to finish the
+ * queued requests, and frees it. No other call on the engine may be running
+ * or follow. Completions not yet reaped are discarded. Passing NULL is a
+ * no-op.
+ */
+AESGCMSIV_API void aesgcmsiv_engine_free(aesgcmsiv_engine* engine);
+
+/**
+ * Frees a key context and clears its key material. Passing NULL is a no-op.
+ */
+AESGCMSIV_API void aesgcmsiv_ctx_free(aesgcmsiv_ctx* ctx);
+
+/**
+ * Opaque handle to a bounded cache of expanded keys, for services that make
+ * a new context per request from a small working set of keys. Entries are
+ * found by a hash keyed with a per-cache random secret, so the key material
+ * cannot be used to flood one bucket. The least recently used entry is
+ * evicted when the cache is full, and every entry is cleared when it leaves
+ * the cache. Safe to use from any number of threads at once.
+ */
+typedef struct aesgcmsiv_key_cache aesgcmsiv_key_cache;
+
+/**
+ * Creates a key cache.
+ *
+ * @param capacity Most keys held at once; 0 caches nothing
+ * @param cache_out Receives the new cache on success; set to NULL on failure
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_key_cache_new(size_t capacity, aesgcmsiv_key_cache** cache_out);
+
+/**
+ * Returns a new context for key, as aesgcmsiv_ctx_new would, copying the
+ * expanded key from the cache when it is there and adding it otherwise. The
+ * context belongs to the caller, is independent of the cache, and is freed
+ * with aesgcmsiv_ctx_free; its thread count and pool start unset.
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_key_cache_get(
+    aesgcmsiv_key_cache* cache,
+    const uint8_t* key, size_t key_len,
+    aesgcmsiv_ctx** ctx_out);
+
+/**
+ * Changes the capacity, evicting the least recently used keys beyond it.
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_key_cache_set_capacity(aesgcmsiv_key_cache* cache, size_t capacity);
+
+/**
+ * Evicts and clears every key, for example after keys have been rotated.
+ * Contexts already returned are unaffected.
+ */
+AESGCMSIV_API void aesgcmsiv_key_cache_clear(aesgcmsiv_key_cache* cache);
+
+/**
+ * Clears and frees a cache. Contexts already returned stay valid. Passing
+ * NULL is a no-op.
+ */
+AESGCMSIV_API void aesgcmsiv_key_cache_free(aesgcmsiv_key_cache* cache);
+
+// Longest value an aesgcmsiv_value_cache holds
+#define AESGCMSIV_VALUE_CACHE_MAX_VALUE (1u << 20)
+// Most entries an aesgcmsiv_value_cache holds
+#define AESGCMSIV_VALUE_CACHE_MAX_ENTRIES (1u << 30)
+
+/**
+ * Opaque handle to a cache of values kept encrypted in memory, for
+ * sensitive data such as personal records that a process caches but should
+ * not hold in the clear. Values are sealed into slots of slabs allocated by
+ * size class, and found through one open-addressed index, so an entry costs
+ * its sealed bytes rounded up to the class, 32 bytes of header and tag, and
+ * its index slot, with no per-entry allocation. Each value is sealed under
+ * a fresh nonce with its ID as AAD, so a value read back under another ID
+ * fails to authenticate. Once full, the cache evicts an entry not read since
+ * the clock hand last passed it. Gets may run on any number of threads at
+ * once; puts and removes wait for them.
+ */
+typedef struct aesgcmsiv_value_cache aesgcmsiv_value_cache;
+
+/**
+ * One value in a batch put or get.
+ */
+typedef struct aesgcmsiv_cache_value {
+    uint64_t id;
+    uint8_t* data;  // put: the value, read only; get: receives it
+    size_t len;  // put: the value's length; get: in, the size of data; out, the value's length
+} aesgcmsiv_cache_value;
+
+typedef struct aesgcmsiv_value_cache_stats {
+    uint64_t entries;
+    uint64_t value_bytes;  // summed over the entries
+    uint64_t slab_bytes;  // allocated for slots, held until the cache is freed
+    uint64_t evictions;
+} aesgcmsiv_value_cache_stats;
+
+/**
+ * Creates a value cache.
+ *
+ * @param key Pointer to 16-byte (AES-128) or 32-byte (AES-256) key, or NULL
+ *            for a random 32-byte key that never leaves the cache
+ * @param key_len Length of key (must be 16 or 32; ignored if key is NULL)
+ * @param capacity Most entries held at once, 1 to
+ *                 AESGCMSIV_VALUE_CACHE_MAX_ENTRIES
+ * @param alloc_flags AESGCMSIV_ALLOC_* flags for the slabs; with
+ *                    AESGCMSIV_ALLOC_LOCKED the ciphertext stays out of swap
+ * @param cache_out Receives the new cache on success; set to NULL on failure
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_KEY for a bad
+ *         key, AESGCMSIV_ERROR_INVALID_INPUT for a bad capacity or flags,
+ *         AESGCMSIV_ERROR_INTERNAL if out of memory
+ */
+AESGCMSIV_API int aesgcmsiv_value_cache_new(
+    const uint8_t* key, size_t key_len,
+    size_t capacity,
+    uint32_t alloc_flags,
+    aesgcmsiv_value_cache** cache_out);
+
+/**
+ * Seals count values into the cache with one batch call, each replacing any
+ * value under its ID. Items are put in order, so of two with the same ID
+ * the later one stays.
+ *
+ * @param cache Value cache
+ * @param count Number of values
+ * @param values Array of count values
+ * @param status_out Array of count results: AESGCMSIV_SUCCESS,
+ *                   AESGCMSIV_ERROR_INVALID_INPUT for a value longer than
+ *                   AESGCMSIV_VALUE_CACHE_MAX_VALUE or NULL with a length,
+ *                   or AESGCMSIV_ERROR_INTERNAL if a slab could not be
+ *                   allocated; a value that fails leaves its ID absent
+ *
+ * @return AESGCMSIV_SUCCESS if every value was put, otherwise the first
+ *         failing value's status; AESGCMSIV_ERROR_INVALID_INPUT without
+ *         putting any if the arguments themselves are invalid
+ */
+AESGCMSIV_API int aesgcmsiv_value_cache_put(
+    aesgcmsiv_value_cache* cache,
+    size_t count,
+    const aesgcmsiv_cache_value* values,
+    int* status_out);
+
+/**
+ * Opens count values from the cache with one batch call, straight into
+ * each item's data.
+ *
+ * @param cache Value cache
+ * @param count Number of values
+ * @param values Array of count values; len of each is set to the length of
+ *               the value under its ID, also when data is too small
+ * @param status_out Array of count results: AESGCMSIV_SUCCESS,
+ *                   AESGCMSIV_ERROR_NOT_FOUND if the ID is absent,
+ *                   AESGCMSIV_ERROR_INVALID_INPUT if data is too small, in
+ *                   which case it is left untouched, or
+ *                   AESGCMSIV_ERROR_DECRYPT_FAILED if the sealed value was
+ *                   altered in memory
+ *
+ * @return AESGCMSIV_SUCCESS if every value was found, otherwise the first
+ *         failing value's status; AESGCMSIV_ERROR_INVALID_INPUT without
+ *         opening any if the arguments themselves are invalid
+ */
+AESGCMSIV_API int aesgcmsiv_value_cache_get(
+    aesgcmsiv_value_cache* cache,
+    size_t count,
+    aesgcmsiv_cache_value* values,
+    int* status_out);
+
+/**
+ * Removes the value under id.
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_NOT_FOUND if id is
+ *         absent, AESGCMSIV_ERROR_INVALID_INPUT if cache is NULL
+ */
+AESGCMSIV_API int aesgcmsiv_value_cache_remove(aesgcmsiv_value_cache* cache, uint64_t id);
+
+/**
+ * Reads the cache's counters.
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if an
+ *         argument is NULL
+ */
+AESGCMSIV_API int aesgcmsiv_value_cache_get_stats(
+    aesgcmsiv_value_cache* cache,
+    aesgcmsiv_value_cache_stats* stats_out);
+
+/**
+ * Clears the key and frees a cache and its slabs. Passing NULL is a no-op.
+ */
+AESGCMSIV_API void aesgcmsiv_value_cache_free(aesgcmsiv_value_cache* cache);
+
+// Size of the key ID in front of a message sealed with aesgcmsiv_seal_with_keyid
+#define AESGCMSIV_KEYID_SIZE 4
+// Bytes aesgcmsiv_seal_with_keyid adds to the plaintext: key ID, nonce and tag
+#define AESGCMSIV_KEYID_SEAL_OVERHEAD (AESGCMSIV_KEYID_SIZE + AESGCMSIV_SEAL_OVERHEAD)
+
+/**
+ * Opaque handle to the keys in rotation, each under a 32-bit key ID, for
+ * messages that carry the ID of their key in front: key ID || nonce ||
+ * ciphertext || tag, the ID big-endian. aesgcmsiv_open_with_keyid reads the
+ * ID, finds its context and opens the message in one call, so a caller
+ * keeps no table of its own from IDs to contexts.
+ *
+ * The keyring is a flat open-addressed table of at least twice its
+ * capacity, hashed under a per-keyring secret, so a lookup usually reads
+ * one cache line, whether or not the ID is known. Seals
+ * and opens take no lock and may run on any number of threads at once, and
+ * alongside adding and removing keys, which are serialized by a lock. A
+ * removed key's context is cleared and freed once no seal or open that
+ * could have found it is still running: at once if none is, otherwise by a
+ * later add or remove. A removed key's ID should not be reused for another
+ * key.
+ */
+typedef struct aesgcmsiv_keyring aesgcmsiv_keyring;
+
+/**
+ * Creates an empty keyring.
+ *
+ * @param capacity Most keys held at once, at least 1 and at most 2^24
+ * @param keyring_out Receives the new keyring on success; set to NULL on failure
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_keyring_new(size_t capacity, aesgcmsiv_keyring** keyring_out);
+
+/**
+ * Expands key and adds it under key_id.
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if
+ *         key_id is already in the keyring or it holds capacity keys, other
+ *         negative error codes on failure
+ */
+AESGCMSIV_API int aesgcmsiv_keyring_add(
+    aesgcmsiv_keyring* keyring, uint32_t key_id,
+    const uint8_t* key, size_t key_len);
+
+/**
+ * Removes the key under key_id, so that messages sealed under it no longer
+ * open. Its context is cleared and freed here if no seal or open is
+ * running, or else by the first add or remove after those that could have
+ * found it have returned.
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_NOT_FOUND if the
+ *         keyring holds no key under key_id
+ */
+AESGCMSIV_API int aesgcmsiv_keyring_remove(aesgcmsiv_keyring* keyring, uint32_t key_id);
+
+/**
+ * aesgcmsiv_seal under the key with key_id, with the ID written in front:
+ * key ID || nonce || ciphertext || tag.
+ *
+ * @param sealed_out Output buffer of at least plaintext_len +
+ *        AESGCMSIV_KEYID_SEAL_OVERHEAD bytes. The plaintext may already sit
+ *        at sealed_out + AESGCMSIV_KEYID_SIZE + AESGCMSIV_NONCE_SIZE to seal
+ *        in place; any other overlap with the plaintext is not supported.
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_NOT_FOUND if the
+ *         keyring holds no key under key_id, other negative error codes on
+ *         failure
+ */
+AESGCMSIV_API int aesgcmsiv_seal_with_keyid(
+    aesgcmsiv_keyring* keyring, uint32_t key_id,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* sealed_out);
+
+/**
+ * Verifies and decrypts a message laid out as key ID || nonce ||
+ * ciphertext || tag under the key its ID names.
+ *
+ * @param sealed Pointer to the sealed message
+ * @param sealed_len Length of the sealed message (at least
+ *        AESGCMSIV_KEYID_SEAL_OVERHEAD)
+ * @param plaintext_out Output buffer of at least sealed_len -
+ *        AESGCMSIV_KEYID_SEAL_OVERHEAD bytes. May be sealed +
+ *        AESGCMSIV_KEYID_SIZE + AESGCMSIV_NONCE_SIZE to open in place; any
+ *        other overlap is not supported. Zeroed if the tag does not verify.
+ * @param key_id_out Receives the message's key ID whenever sealed_len is
+ *        long enough to hold one, even if no key has it. May be NULL.
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_NOT_FOUND if the
+ *         keyring holds no key under the message's ID, other negative error
+ *         codes on failure
+ */
+AESGCMSIV_API int aesgcmsiv_open_with_keyid(
+    aesgcmsiv_keyring* keyring,
+    const uint8_t* sealed, size_t sealed_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* plaintext_out,
+    uint32_t* key_id_out);
+
+/**
+ * aesgcmsiv_ctx_set_usage_tracking on the context of every key the keyring
+ * holds, and on those of keys added later.
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_keyring_set_usage_tracking(aesgcmsiv_keyring* keyring, int enabled);
+
+/**
+ * Reads the usage of every key the keyring holds in one call, in no
+ * particular order, taking the lock that adding and removing keys take but
+ * none that seals and opens do. Removed keys are not listed.
+ *
+ * @param usage_out Receives up to max entries; may be NULL if max is 0
+ * @param max Entries usage_out has room for
+ * @param count_out Receives the number of keys held, which may exceed max;
+ *        only the first max of them are written
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_keyring_stats(
+    aesgcmsiv_keyring* keyring,
+    aesgcmsiv_key_usage* usage_out, size_t max,
+    size_t* count_out);
+
+/**
+ * Clears and frees every key, removed ones not yet freed included, and the
+ * keyring. No call on it may be running. Passing NULL is a no-op.
+ */
+AESGCMSIV_API void aesgcmsiv_keyring_free(aesgcmsiv_keyring* keyring);
+
+/**
+ * Opaque handle to a subkey derivation: one master key from which every
+ * record gets its own key, HKDF-SHA256 (RFC 5869) with the record ID as
+ * the info. Deriving a record's key and encrypting under it happen in one
+ * batch call, so a table of records, each under its own key, costs one
+ * call per batch rather than a context per record. The HMAC pads of the
+ * extracted key are computed once, so each short ID costs two SHA-256
+ * blocks, hashed with SHA-NI, or eight IDs at a time with AVX2 where the
+ * CPU has no SHA-NI. Safe to use from any number of threads at once.
+ */
+typedef struct aesgcmsiv_kdf aesgcmsiv_kdf;
+
+/**
+ * Creates a derivation. The subkey for record ID id is
+ * HKDF-SHA256(IKM = master_key, salt, info = id, L = key_len), as .NET's
+ * HKDF.DeriveKey computes it.
+ *
+ * @param master_key Input keying material, at least one byte
+ * @param salt Optional HKDF salt (can be NULL if salt_len is 0; an empty
+ *        salt is 32 zero bytes)
+ * @param key_len Subkey size: AESGCMSIV_KEY_SIZE_128 or AESGCMSIV_KEY_SIZE_256
+ * @param kdf_out Receives the new derivation on success; set to NULL on failure
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_kdf_new(
+    const uint8_t* master_key, size_t master_len,
+    const uint8_t* salt, size_t salt_len,
+    size_t key_len,
+    aesgcmsiv_kdf** kdf_out);
+
+/**
+ * Keeps the expanded subkeys of recently used records in cache, so hot
+ * records skip both derivation and key expansion. Entries are named by the
+ * record ID and a random value drawn for this derivation, and only records
+ * with IDs of at most AESGCMSIV_KDF_CACHED_ID_MAX bytes are cached. The
+ * cache may be shared with aesgcmsiv_key_cache_get and other derivations,
+ * and must outlive its use here. NULL stops caching.
+ */
+AESGCMSIV_API int aesgcmsiv_kdf_set_cache(aesgcmsiv_kdf* kdf, aesgcmsiv_key_cache* cache);
+
+#define AESGCMSIV_KDF_CACHED_ID_MAX 48  // longest record ID a key cache holds
+
+/**
+ * Derives the subkeys for count record IDs, key i to keys_out + i * key_len,
+ * for callers that encrypt elsewhere.
+ *
+ * @param ids Array of count record IDs; an ID may be empty
+ * @param keys_out Receives count * key_len bytes
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_kdf_derive_batch(
+    aesgcmsiv_kdf* kdf,
+    size_t count,
+    const aesgcmsiv_iovec* ids,
+    uint8_t* keys_out);
+
+/**
+ * aesgcmsiv_encrypt_batch with item i under the subkey for record ids[i].
+ *
+ * @param kdf Derivation
+ * @param count Number of items
+ * @param items Array of count items
+ * @param ids Array of count record IDs, one per item
+ */
+AESGCMSIV_API int aesgcmsiv_kdf_encrypt_batch(
+    aesgcmsiv_kdf* kdf,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const aesgcmsiv_iovec* ids);
+
+/**
+ * aesgcmsiv_decrypt_batch with item i under the subkey for record ids[i].
+ */
+AESGCMSIV_API int aesgcmsiv_kdf_decrypt_batch(
+    aesgcmsiv_kdf* kdf,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const aesgcmsiv_iovec* ids,
+    int* status_out);
+
+/**
+ * Clears and frees a derivation. Its entries stay in an attached cache
+ * until evicted, but no other derivation can find them. Passing NULL is a
+ * no-op.
+ */
+AESGCMSIV_API void aesgcmsiv_kdf_free(aesgcmsiv_kdf* kdf);
+
+/**
+ * Does the one-time setup that would otherwise fall on the first call:
+ * OpenSSL initialization, the library's private OSSL_LIB_CTX and its
+ * provider, and cipher lookup, plus the calling thread's cipher context. Optional, and only useful before the
+ * first encrypt or decrypt; later calls do no further work.
+ *
+ * When a hand-written kernel is selected OpenSSL is never used and there is
+ * nothing to prepare.
+ *
+ * @param flags Zero or more AESGCMSIV_INIT_* flags. A flag affecting OpenSSL
+ *        initialization only takes effect if nothing in the process has
+ *        initialized OpenSSL yet.
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_init(uint32_t flags);
+
+/**
+ * Reports the implementation in use: the one selected when the library was
+ * loaded, unless aesgcmsiv_select_backend has chosen another.
+ *
+ * @param name_out Receives a static string naming the backend, e.g.
+ *        "vaes-avx512", "aesni", "armv8-crypto" or "openssl"
+ * @param features_out Receives the AESGCMSIV_CPU_* bits detected on this CPU
+ *
+ * @return AESGCMSIV_SUCCESS on success, negative error code on failure
+ */
+AESGCMSIV_API int aesgcmsiv_get_backend(const char** name_out, uint32_t* features_out);
+
+/**
+ * Switches the process to another implementation, for comparing them in one
+ * binary. Every implementation sits behind the same validation, batching
+ * and context code, so only the cipher work changes.
+ *
+ * The name is one aesgcmsiv_get_backend can report: any kernel built in
+ * whose instructions this CPU has, including "armv8-crypto", which is
+ * never the default, the crypto library ("openssl"), or "mock", a kernel
+ * that does no cryptography,
+ * in builds configured with AESGCMSIV_MOCK_KERNEL. NULL restores the
+ * default. One-shot calls and contexts created afterwards use the new
+ * choice; existing contexts and key tables keep the one they were created
+ * with. Never select "mock" where real data is handled.
+ *
+ * @param name Backend to use, or NULL for the default
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_NOT_FOUND if this
+ *         build or CPU cannot run the named backend
+ */
+AESGCMSIV_API int aesgcmsiv_select_backend(const char* name);
+
+/**
+ * Makes an allocation fail on purpose, for testing the paths that handle
+ * running out of memory. Only allocations with a fault point count; for now
+ * those are the usage counter blocks of key contexts. The next after of them
+ * succeed and the one after fails, once. Only builds configured with
+ * AESGCMSIV_FAULT_INJECTION have this; never turn that on for production.
+ *
+ * @param after Allocations to let through first, or UINT32_MAX to fail none
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_NOT_FOUND if this
+ *         build has no fault points
+ */
+AESGCMSIV_API int aesgcmsiv_debug_fail_alloc(uint32_t after);
+
+// Bytes aesgcmsiv_probe encrypts per run when given 0, and the most it takes
+#define AESGCMSIV_PROBE_DEFAULT_BYTES 16384
+#define AESGCMSIV_PROBE_MAX_BYTES (1u << 20)
+// Timed runs aesgcmsiv_probe makes when given 0, and the most it takes
+#define AESGCMSIV_PROBE_DEFAULT_RUNS 5
+#define AESGCMSIV_PROBE_MAX_RUNS 64
+
+/**
+ * What one aesgcmsiv_probe measured. Cycles are counted as in
+ * aesgcmsiv_profile_bucket.
+ */
+typedef struct aesgcmsiv_probe_result {
+    const char* backend;  // static string, as aesgcmsiv_get_backend reports it
+    uint64_t bytes;  // encrypted by each run
+    uint64_t cycles;  // of the fastest run
+    uint64_t ns;  // of the fastest run
+    // Most cycles a healthy host of this backend takes for bytes, roughly
+    // twice what one measures; 0 where there is no reference, which is any
+    // backend but the hand-written x86 kernels
+    uint64_t expected_cycles;
+} aesgcmsiv_probe_result;
+
+/**
+ * Measures the speed of the backend in use by encrypting a fixed buffer
+ * under a fixed AES-256 key on the calling thread, for a health check that
+ * catches hosts where the cipher instructions run far slower than they
+ * should (microcode, a hypervisor hiding or trapping them). One untimed run
+ * warms the caches, then the fastest of the timed runs is reported, so a
+ * run cut short by preemption does not count against the host. The runs are
+ * counted by aesgcmsiv_get_stats like any other call.
+ *
+ * A host is degraded when cycles is well above expected_cycles. Where there
+ * is no reference, compare cycles or ns with what the same probe measured
+ * on a healthy host of the fleet.
+ *
+ * @param bytes Bytes to encrypt per run, up to AESGCMSIV_PROBE_MAX_BYTES, or
+ *              0 for AESGCMSIV_PROBE_DEFAULT_BYTES
+ * @param runs Timed runs, up to AESGCMSIV_PROBE_MAX_RUNS, or 0 for
+ *             AESGCMSIV_PROBE_DEFAULT_RUNS
+ * @param result_out Receives the measurement
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if
+ *         result_out is NULL or bytes or runs is too large,
+ *         AESGCMSIV_ERROR_INTERNAL if out of memory, another negative error
+ *         code if encryption failed
+ */
+AESGCMSIV_API int aesgcmsiv_probe(size_t bytes, unsigned int runs, aesgcmsiv_probe_result* result_out);
+
+/**
+ * Returns the most recent OpenSSL error code recorded on the calling thread,
+ * or 0 if there has been none. The code is the packed value ERR_get_error
+ * would have returned, and can be passed to ERR_error_string_n.
+ *
+ * The library empties the thread's OpenSSL error queue whenever an OpenSSL
+ * call fails, keeping only this code, so the queue does not grow however
+ * many messages fail to authenticate. A call that succeeds leaves the code
+ * as it was.
+ */
+AESGCMSIV_API unsigned long aesgcmsiv_get_openssl_error(void);
+
+/**
+ * Does nothing. Timing calls to it gives the cost of crossing into the
+ * library on its own, to set against the cost of the cipher calls.
+ */
+AESGCMSIV_API void aesgcmsiv_nop(void);
+
+// Any export, as returned by aesgcmsiv_get_export; cast to its real type
+typedef void (*aesgcmsiv_proc)(void);
+
+/**
+ * Looks up an export of this library by name, for callers that cannot ask
+ * the loader: a .NET Native AOT app that links the static archive into its
+ * executable calls this directly and binds every other export through it.
+ *
+ * @param name Name of the export, such as "aesgcmsiv_encrypt"
+ *
+ * @return The export, or NULL if this build has none of that name
+ */
+AESGCMSIV_API aesgcmsiv_proc aesgcmsiv_get_export(const char* name);
+
+// Error codes counted one by one in aesgcmsiv_op_stats; failures[n - 1]
+// counts messages that failed with -n
+#define AESGCMSIV_STATS_ERROR_CODES 7
+
+/**
+ * Counters for one direction, summed over every thread since statistics
+ * were last reset. Each message counts once, however it was submitted: a
+ * batch of ten is ten calls, and a call split over pool workers is one.
+ * Times are wall-clock nanoseconds on the calling thread.
+ */
+typedef struct aesgcmsiv_op_stats {
+    uint64_t calls;  // messages, whether or not they succeeded
+    uint64_t bytes;  // plaintext or ciphertext of the messages that succeeded; AAD is not counted
+    uint64_t failures[AESGCMSIV_STATS_ERROR_CODES];
+    uint64_t setup_ns;  // parameter checks, key schedule and cipher context setup
+    uint64_t crypto_ns;  // everything after setup
+    // Messages a hand-written kernel ran with 512-bit vectors, and with
+    // narrower ones only (see aesgcmsiv_ctx_set_wide_min). Those the crypto
+    // library ran count in neither. A batch counts all its messages at the
+    // width chosen for their mean length.
+    uint64_t wide_calls;
+    uint64_t narrow_calls;
+} aesgcmsiv_op_stats;
+
+typedef struct aesgcmsiv_stats {
+    aesgcmsiv_op_stats encrypt;
+    aesgcmsiv_op_stats decrypt;
+} aesgcmsiv_stats;
+
+/**
+ * Turns the counters read by aesgcmsiv_get_stats on or off for the whole
+ * process. They are off until enabled; while off, a call pays one relaxed
+ * atomic load for them. While on, each call takes two or three clock reads
+ * and updates counters private to its thread. Calls already running when
+ * this is called may or may not be counted. Disabling keeps the totals.
+ *
+ * Covers the synchronous encrypt and decrypt calls, batches and engine
+ * requests, and jobs started with the _submit calls, which are counted
+ * when they finish.
+ */
+AESGCMSIV_API void aesgcmsiv_stats_enable(int enabled);
+
+/**
+ * Reads the counters. Each is consistent on its own, but calls finishing
+ * on other threads during the read may be counted in some fields and not
+ * others.
+ *
+ * @param stats_out Receives the totals since the last aesgcmsiv_reset_stats
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if
+ *         stats_out is NULL
+ */
+AESGCMSIV_API int aesgcmsiv_get_stats(aesgcmsiv_stats* stats_out);
+
+/**
+ * Starts the counters, and the phase profile read by aesgcmsiv_get_profile,
+ * again from zero. Safe to call at any time, from any thread.
+ */
+AESGCMSIV_API void aesgcmsiv_reset_stats(void);
+
+/**
+ * Counters for the per-thread free lists that hold async job descriptors
+ * and scratch blocks, summed over every thread since the library was
+ * loaded. They are always kept and are not cleared by aesgcmsiv_reset_stats.
+ * A steady workload should show heap_allocs levelling off while allocs
+ * grows; bytes_cached is the memory the free lists hold on to.
+ */
+typedef struct aesgcmsiv_alloc_stats {
+    uint64_t allocs;  // blocks handed out
+    uint64_t cache_hits;  // of those, reused from a thread's free list
+    uint64_t heap_allocs;  // of those, taken from the heap
+    uint64_t heap_frees;  // blocks returned to the heap: too large, list full, or thread exited
+    uint64_t bytes_in_use;  // in blocks handed out and not yet freed
+    uint64_t bytes_cached;  // in free lists, ready for reuse
+    uint64_t threads;  // threads currently holding free lists
+} aesgcmsiv_alloc_stats;
+
+/**
+ * Reads the allocator counters, with the same consistency as
+ * aesgcmsiv_get_stats.
+ *
+ * @param stats_out Receives the counters
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if
+ *         stats_out is NULL
+ */
+AESGCMSIV_API int aesgcmsiv_get_alloc_stats(aesgcmsiv_alloc_stats* stats_out);
+
+/**
+ * One operation that took longer than the slow-operation threshold. A batch
+ * or a group of engine requests is reported as one operation covering all
+ * of its messages.
+ */
+typedef struct aesgcmsiv_slow_op {
+    uint32_t op;  // AESGCMSIV_OP_ENCRYPT or AESGCMSIV_OP_DECRYPT
+    int status;  // what the call returned; for a batch, its first error or AESGCMSIV_SUCCESS
+    uint64_t count;  // messages: 1, or the size of the batch
+    uint64_t bytes;  // plaintext or ciphertext of the messages that succeeded
+    const char* backend;  // as from aesgcmsiv_get_backend; "openssl" if the call went through OpenSSL
+    uint64_t setup_ns;  // parameter checks, key schedule and cipher context setup
+    uint64_t crypto_ns;  // everything after setup
+    uint64_t suppressed;  // slow operations dropped by the rate limit since the last report
+} aesgcmsiv_slow_op;
+
+typedef void (*aesgcmsiv_slow_op_fn)(const aesgcmsiv_slow_op* slow_op);
+
+// Least time between two calls of the slow-operation callback
+#define AESGCMSIV_SLOW_OP_INTERVAL_NS 100000000u  // 100 ms
+
+/**
+ * Calls fn for operations that take at least threshold_ns from entry to
+ * return, at most once per AESGCMSIV_SLOW_OP_INTERVAL_NS across the whole
+ * process; the operations skipped in between are counted in the next
+ * report's suppressed field. fn runs on the thread that made the slow call,
+ * after the call's work is done and before it returns, so it should be
+ * brief. It may call into the library.
+ *
+ * Covers the same calls as aesgcmsiv_stats_enable, and like the counters
+ * costs one relaxed load per call while no callback is set. Pass NULL to
+ * remove the callback; a call that was already finishing may still invoke
+ * the previous one.
+ *
+ * @return AESGCMSIV_SUCCESS
+ */
+AESGCMSIV_API int aesgcmsiv_set_slow_op_callback(uint64_t threshold_ns, aesgcmsiv_slow_op_fn fn);
+
+// Phases of a message in aesgcmsiv_profile_bucket.cycles
+#define AESGCMSIV_PHASE_SETUP 0  // parameter checks, key schedule, cipher fetch and context setup
+#define AESGCMSIV_PHASE_DERIVE 1  // per-nonce key derivation (RFC 8452 section 4)
+#define AESGCMSIV_PHASE_POLYVAL 2  // POLYVAL over the AAD, the message and the length block
+#define AESGCMSIV_PHASE_CTR 3  // AES-CTR over the message
+#define AESGCMSIV_PHASE_TAG 4  // encrypting the POLYVAL result into the tag
+#define AESGCMSIV_PHASE_FUSED 5  // CTR and POLYVAL in one pass: fused decryption, and the short-message paths
+#define AESGCMSIV_PHASE_OTHER 6  // everything else, including all of a call the crypto library runs
+#define AESGCMSIV_PROFILE_PHASES 7
+
+// Message sizes: bucket 0 holds messages of up to 16 bytes, bucket b > 0
+// those of 2^(b+3) + 1 to 2^(b+4) bytes, and the last bucket everything
+// larger than 256 KiB
+#define AESGCMSIV_PROFILE_SIZE_BUCKETS 16
+
+// Cycles per message: bucket c counts messages that took 2^c to 2^(c+1) - 1
+// cycles, bucket 0 also those that took none, and the last bucket everything
+// longer
+#define AESGCMSIV_PROFILE_CYCLE_BUCKETS 32
+
+/**
+ * Where the cycles of the messages of one size bucket went. Cycles are read
+ * from the time stamp counter on x86, which counts reference cycles at a
+ * fixed rate whatever the core clock; from the virtual counter on ARM64; and
+ * are nanoseconds elsewhere.
+ */
+typedef struct aesgcmsiv_profile_bucket {
+    uint64_t messages;  // that succeeded
+    uint64_t bytes;  // plaintext or ciphertext of those messages
+    uint64_t cycles[AESGCMSIV_PROFILE_PHASES];  // summed over the messages, by AESGCMSIV_PHASE_*
+    uint64_t histogram[AESGCMSIV_PROFILE_CYCLE_BUCKETS];  // messages by cycles from entry to return
+} aesgcmsiv_profile_bucket;
+
+typedef struct aesgcmsiv_profile {
+    aesgcmsiv_profile_bucket encrypt[AESGCMSIV_PROFILE_SIZE_BUCKETS];
+    aesgcmsiv_profile_bucket decrypt[AESGCMSIV_PROFILE_SIZE_BUCKETS];
+} aesgcmsiv_profile;
+
+/**
+ * Turns the phase profile read by aesgcmsiv_get_profile on or off for the
+ * whole process, to find where the cycles of each message size go. It is off
+ * until enabled; while off, a call pays one relaxed load for it, and each
+ * phase of a hand-written kernel one more. While on, each phase takes two
+ * counter reads, so short messages run measurably slower; it is meant for
+ * benchmarks and load tests rather than production.
+ *
+ * Setup is timed on every backend. The kernels mark key derivation and the
+ * tag wherever they handle one message at a time, and POLYVAL and CTR on
+ * the single-message paths; batches and the multi-buffer and parallel paths
+ * leave their bulk work in AESGCMSIV_PHASE_OTHER, as does a call the crypto
+ * library runs, after its setup. A batch
+ * counts all its messages in the bucket of their mean length, and a call
+ * split over pool workers only what its own thread did outside the workers.
+ * Covers the same calls as aesgcmsiv_stats_enable; only messages that
+ * succeed are counted.
+ */
+AESGCMSIV_API void aesgcmsiv_profile_enable(int enabled);
+
+/**
+ * Reads the phase profile, with the same consistency as aesgcmsiv_get_stats.
+ *
+ * @param profile_out Receives the totals since the last aesgcmsiv_reset_stats
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if
+ *         profile_out is NULL, AESGCMSIV_ERROR_INTERNAL if out of memory
+ */
+AESGCMSIV_API int aesgcmsiv_get_profile(aesgcmsiv_profile* profile_out);
+
+// Start of a call recording file, followed by its version and entry size
+// as little-endian uint32_t, then the entries
+#define AESGCMSIV_RECORD_MAGIC "AGSVREC1"
+#define AESGCMSIV_RECORD_VERSION 1
+#define AESGCMSIV_RECORD_HEADER_SIZE 16
+
+// Entries a recording buffers when aesgcmsiv_record_start is given 0
+#define AESGCMSIV_RECORD_DEFAULT_CAPACITY 65536
+
+/**
+ * One call in a recording. In the file each entry is these fields in this
+ * order, little-endian and packed, AESGCMSIV_RECORD_ENTRY_SIZE bytes in all.
+ * Entries are written roughly, not strictly, in order of time_ns.
+ */
+typedef struct aesgcmsiv_record_entry {
+    uint64_t time_ns;  // when the call was made, since the recording started
+    uint32_t duration_ns;  // from entry to return, at most UINT32_MAX
+    uint32_t size;  // plaintext or ciphertext; for a batch, the mean over its messages; at most UINT32_MAX
+    uint32_t aad_size;  // likewise for the AAD
+    uint32_t count;  // messages: 1, or the size of the batch
+    uint32_t key_id;  // the context the call used, as a keyed hash; 0 for calls given a raw key
+    uint16_t thread;  // the calling thread, numbered from 0 in order of its first recorded call
+    uint8_t op;  // AESGCMSIV_OP_ENCRYPT or AESGCMSIV_OP_DECRYPT
+    int8_t status;  // what the call returned; for a batch, its first error or AESGCMSIV_SUCCESS
+} aesgcmsiv_record_entry;
+
+#define AESGCMSIV_RECORD_ENTRY_SIZE 32
+
+/**
+ * Starts recording the metadata of every call to a file, for replaying the
+ * production mix of sizes, keys and threads in a benchmark (see
+ * bench_aesgcmsiv --replay). Nothing of a call's key, nonce, data or AAD is
+ * recorded: only what aesgcmsiv_record_entry holds. key_id tells contexts
+ * apart without identifying them outside the recording: it hashes the
+ * context's address with a secret drawn afresh for each recording.
+ *
+ * Each call adds an entry to a buffer of capacity entries, shared by all
+ * threads, that a background thread writes out; when the buffer is full,
+ * entries are dropped and counted rather than making the caller wait. While
+ * recording, each call takes two clock reads and three atomic updates of
+ * lines all threads share, which is felt at high call rates on many cores.
+ * Covers the same calls as aesgcmsiv_stats_enable.
+ *
+ * @param path The file to write, created or truncated
+ * @param capacity Entries to buffer, rounded up to a power of two; 0 for
+ *        AESGCMSIV_RECORD_DEFAULT_CAPACITY
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_INPUT if
+ *         path is NULL or capacity is over 2^24, AESGCMSIV_ERROR_BUSY if a
+ *         recording is already running, AESGCMSIV_ERROR_IO if the file
+ *         cannot be written, AESGCMSIV_ERROR_INTERNAL if out of memory
+ */
+AESGCMSIV_API int aesgcmsiv_record_start(const char* path, size_t capacity);
+
+/**
+ * Stops the recording, writes out what is buffered and closes the file.
+ * Calls already running may or may not be recorded.
+ *
+ * @param dropped_out Receives the number of entries dropped because the
+ *        buffer was full. May be NULL.
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_NOT_FOUND if no
+ *         recording is running, AESGCMSIV_ERROR_IO if writing the file
+ *         failed at any point
+ */
+AESGCMSIV_API int aesgcmsiv_record_stop(uint64_t* dropped_out);
+
 #ifdef __cplusplus
 }
 #endif
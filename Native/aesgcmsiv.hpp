@@ -0,0 +1,702 @@
+#ifndef AESGCMSIV_HPP
+#define AESGCMSIV_HPP
+
+// Header-only C++20 wrapper over the C API in aesgcmsiv.h: move-only owners
+// for contexts, streams and engines, coroutine awaitables for engine
+// requests, std::span arguments, and results in the style of
+// std::expected in place of int codes. Every function is inline, allocates
+// nothing and makes the same C call the caller would; the only work added is
+// checking that output spans are large enough, which the C API leaves to the
+// caller.
+
+#if __cplusplus < 202002L && !(defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)
+#error "aesgcmsiv.hpp needs C++20 for std::span; use aesgcmsiv.h from older code"
+#endif
+
+#include "aesgcmsiv.h"
+#include <cstddef>
+#include <coroutine>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+namespace aesgcmsiv {
+
+inline constexpr std::size_t key_size_128 = AESGCMSIV_KEY_SIZE_128;
+inline constexpr std::size_t key_size_256 = AESGCMSIV_KEY_SIZE_256;
+inline constexpr std::size_t nonce_size = AESGCMSIV_NONCE_SIZE;
+inline constexpr std::size_t tag_size = AESGCMSIV_TAG_SIZE;
+inline constexpr std::size_t stream_header_size = AESGCMSIV_STREAM_HEADER_SIZE;
+
+using bytes = std::span<const uint8_t>;
+using mutable_bytes = std::span<uint8_t>;
+using batch_item = aesgcmsiv_batch_item;
+
+// The library's error codes
+enum class errc : int {
+    invalid_key = AESGCMSIV_ERROR_INVALID_KEY,
+    invalid_nonce = AESGCMSIV_ERROR_INVALID_NONCE,
+    invalid_input = AESGCMSIV_ERROR_INVALID_INPUT,
+    invalid_tag = AESGCMSIV_ERROR_INVALID_TAG,
+    decrypt_failed = AESGCMSIV_ERROR_DECRYPT_FAILED,
+    internal = AESGCMSIV_ERROR_INTERNAL,
+    busy = AESGCMSIV_ERROR_BUSY,
+    io = AESGCMSIV_ERROR_IO,
+    not_found = AESGCMSIV_ERROR_NOT_FOUND,
+};
+
+inline const char* message(errc error) noexcept
+{
+    switch (error) {
+    case errc::invalid_key: return "invalid key";
+    case errc::invalid_nonce: return "invalid nonce";
+    case errc::invalid_input: return "invalid input";
+    case errc::invalid_tag: return "invalid tag";
+    case errc::decrypt_failed: return "authentication failed";
+    case errc::internal: return "internal error";
+    case errc::busy: return "queue full";
+    case errc::io: return "I/O error";
+    case errc::not_found: return "not found";
+    }
+    return "unknown error";
+}
+
+// A value or an errc, with the observers of std::expected. value() and
+// operator* must only be used when has_value(); nothing here throws.
+template <typename T>
+class [[nodiscard]] result {
+public:
+    result(T value) noexcept : value_(std::move(value)), error_(0) {}
+    result(errc error) noexcept : value_(), error_(static_cast<int>(error)) {}
+
+    bool has_value() const noexcept { return error_ == 0; }
+    explicit operator bool() const noexcept { return has_value(); }
+
+    T& value() & noexcept { return value_; }
+    const T& value() const& noexcept { return value_; }
+    T&& value() && noexcept { return std::move(value_); }
+    T& operator*() & noexcept { return value_; }
+    const T& operator*() const& noexcept { return value_; }
+    T&& operator*() && noexcept { return std::move(value_); }
+    T* operator->() noexcept { return &value_; }
+    const T* operator->() const noexcept { return &value_; }
+
+    template <typename U>
+    T value_or(U&& fallback) const& { return has_value() ? value_ : T(std::forward<U>(fallback)); }
+
+    errc error() const noexcept { return static_cast<errc>(error_); }
+
+private:
+    T value_;
+    int error_;
+};
+
+template <>
+class [[nodiscard]] result<void> {
+public:
+    result() noexcept : error_(0) {}
+    result(errc error) noexcept : error_(static_cast<int>(error)) {}
+
+    bool has_value() const noexcept { return error_ == 0; }
+    explicit operator bool() const noexcept { return has_value(); }
+    errc error() const noexcept { return static_cast<errc>(error_); }
+
+private:
+    int error_;
+};
+
+namespace detail {
+
+inline result<void> check(int code) noexcept
+{
+    return code == AESGCMSIV_SUCCESS ? result<void>() : result<void>(static_cast<errc>(code));
+}
+
+template <typename T>
+inline result<T> check(int code, T&& value) noexcept
+{
+    return code == AESGCMSIV_SUCCESS ? result<T>(std::forward<T>(value)) : result<T>(static_cast<errc>(code));
+}
+
+} // namespace detail
+
+// Builds a batch item from spans; output must hold input.size() bytes and
+// tag tag_size
+inline batch_item make_item(bytes nonce, bytes input, bytes aad, mutable_bytes output, uint8_t* tag) noexcept
+{
+    return batch_item{nonce.data(), input.data(), input.size(), aad.data(), aad.size(), output.data(), tag};
+}
+
+class engine;
+class engine_op;
+
+// Owns an aesgcmsiv_ctx. Calls are const because a context may be shared by
+// any number of threads, as in the C API; only moving from it or destroying
+// it must not overlap other use.
+class context {
+public:
+    context() noexcept = default;
+    explicit context(aesgcmsiv_ctx* adopted) noexcept : ctx_(adopted) {}
+    context(context&& other) noexcept : ctx_(other.release()) {}
+    context& operator=(context&& other) noexcept
+    {
+        if (this != &other) {
+            aesgcmsiv_ctx_free(ctx_);
+            ctx_ = other.release();
+        }
+        return *this;
+    }
+    context(const context&) = delete;
+    context& operator=(const context&) = delete;
+    ~context() { aesgcmsiv_ctx_free(ctx_); }
+
+    static result<context> create(bytes key) noexcept
+    {
+        aesgcmsiv_ctx* ctx = nullptr;
+        int code = aesgcmsiv_ctx_new(key.data(), key.size(), &ctx);
+        return detail::check(code, context(ctx));
+    }
+
+    // See aesgcmsiv_ctx_new_ex; either may be NULL
+    static result<context> create(bytes key, const char* provider, const char* properties) noexcept
+    {
+        aesgcmsiv_ctx* ctx = nullptr;
+        int code = aesgcmsiv_ctx_new_ex(key.data(), key.size(), provider, properties, &ctx);
+        return detail::check(code, context(ctx));
+    }
+
+    aesgcmsiv_ctx* get() const noexcept { return ctx_; }
+    explicit operator bool() const noexcept { return ctx_ != nullptr; }
+
+    aesgcmsiv_ctx* release() noexcept
+    {
+        aesgcmsiv_ctx* ctx = ctx_;
+        ctx_ = nullptr;
+        return ctx;
+    }
+
+    // ciphertext holds at least plaintext.size() bytes and tag tag_size
+    result<void> encrypt(bytes nonce, bytes plaintext, bytes aad, mutable_bytes ciphertext, mutable_bytes tag) const noexcept
+    {
+        if (ciphertext.size() < plaintext.size() || tag.size() < tag_size) {
+            return errc::invalid_input;
+        }
+        return detail::check(aesgcmsiv_ctx_encrypt(ctx_, nonce.data(), nonce.size(),
+            plaintext.data(), plaintext.size(), aad.data(), aad.size(), ciphertext.data(), tag.data()));
+    }
+
+    // plaintext holds at least ciphertext.size() bytes; it is zeroed if the
+    // tag does not verify
+    result<void> decrypt(bytes nonce, bytes ciphertext, bytes aad, bytes tag, mutable_bytes plaintext) const noexcept
+    {
+        if (plaintext.size() < ciphertext.size() || tag.size() != tag_size) {
+            return errc::invalid_input;
+        }
+        return detail::check(aesgcmsiv_ctx_decrypt(ctx_, nonce.data(), nonce.size(),
+            ciphertext.data(), ciphertext.size(), aad.data(), aad.size(), tag.data(), plaintext.data()));
+    }
+
+    // Encrypts under a fresh random nonce; see aesgcmsiv_ctx_encrypt_autononce.
+    // out holds nonce_size + plaintext.size() + tag_size bytes.
+    result<void> encrypt_autononce(bytes plaintext, bytes aad, mutable_bytes out) const noexcept
+    {
+        if (out.size() < plaintext.size() + AESGCMSIV_SEAL_OVERHEAD) {
+            return errc::invalid_input;
+        }
+        return detail::check(aesgcmsiv_ctx_encrypt_autononce(ctx_,
+            plaintext.data(), plaintext.size(), aad.data(), aad.size(), out.data()));
+    }
+
+    result<void> encrypt_batch(std::span<const batch_item> items) const noexcept
+    {
+        return detail::check(aesgcmsiv_encrypt_batch(ctx_, items.size(), items.data()));
+    }
+
+    // Every item is processed and its result written to status, which holds
+    // items.size() entries; the result is the first failure
+    result<void> decrypt_batch(std::span<const batch_item> items, std::span<int> status) const noexcept
+    {
+        if (status.size() < items.size()) {
+            return errc::invalid_input;
+        }
+        return detail::check(aesgcmsiv_decrypt_batch(ctx_, items.size(), items.data(), status.data()));
+    }
+
+    result<void> set_threads(unsigned int threads) const noexcept
+    {
+        return detail::check(aesgcmsiv_ctx_set_threads(ctx_, threads));
+    }
+
+    result<void> set_pool(aesgcmsiv_pool* pool) const noexcept
+    {
+        return detail::check(aesgcmsiv_ctx_set_pool(ctx_, pool));
+    }
+
+    result<void> set_streaming(std::size_t min_bytes) const noexcept
+    {
+        return detail::check(aesgcmsiv_ctx_set_streaming(ctx_, min_bytes));
+    }
+
+    // Must not overlap other use of the context
+    result<void> set_nonce_cache(std::size_t entries) const noexcept
+    {
+        return detail::check(aesgcmsiv_ctx_set_nonce_cache(ctx_, entries));
+    }
+
+    // Awaitable encryption and decryption on an engine; see engine::encrypt
+    engine_op encrypt_async(engine& eng, bytes nonce, bytes plaintext, bytes aad,
+        mutable_bytes ciphertext, mutable_bytes tag) const noexcept;
+    engine_op decrypt_async(engine& eng, bytes nonce, bytes ciphertext, bytes aad,
+        bytes tag, mutable_bytes plaintext) const noexcept;
+
+private:
+    aesgcmsiv_ctx* ctx_ = nullptr;
+};
+
+// Key-size and AAD policies for basic_context
+struct aes128 {
+    static constexpr std::size_t key_size = key_size_128;
+};
+struct aes256 {
+    static constexpr std::size_t key_size = key_size_256;
+};
+struct with_aad {};
+struct no_aad {};
+
+// A context whose key size and AAD use are part of its type. Keys, nonces
+// and tags are fixed-extent spans, so a wrong length is a compile error and
+// the per-call checks context makes on them disappear, and a no_aad context
+// has no AAD parameters to pass or forget. Calls still go through the C
+// API, which keeps its own runtime checks; use context when the key size is
+// only known at run time.
+template <typename Key, typename Aad = with_aad>
+class basic_context {
+    static_assert(Key::key_size == key_size_128 || Key::key_size == key_size_256,
+        "Key must be aes128 or aes256");
+
+public:
+    static constexpr std::size_t key_size = Key::key_size;
+    static constexpr bool has_aad = !std::is_same_v<Aad, no_aad>;
+
+    using key_bytes = std::span<const uint8_t, Key::key_size>;
+    using nonce_bytes = std::span<const uint8_t, nonce_size>;
+    using tag_bytes = std::span<const uint8_t, tag_size>;
+    using mutable_tag_bytes = std::span<uint8_t, tag_size>;
+
+    basic_context() noexcept = default;
+
+    static result<basic_context> create(key_bytes key) noexcept
+    {
+        aesgcmsiv_ctx* ctx = nullptr;
+        int code = aesgcmsiv_ctx_new(key.data(), key_size, &ctx);
+        return detail::check(code, basic_context(ctx));
+    }
+
+    static result<basic_context> create(key_bytes key, const char* provider, const char* properties) noexcept
+    {
+        aesgcmsiv_ctx* ctx = nullptr;
+        int code = aesgcmsiv_ctx_new_ex(key.data(), key_size, provider, properties, &ctx);
+        return detail::check(code, basic_context(ctx));
+    }
+
+    // The untyped context, for streams, batches and the set_* calls
+    const context& untyped() const noexcept { return ctx_; }
+    aesgcmsiv_ctx* get() const noexcept { return ctx_.get(); }
+    explicit operator bool() const noexcept { return static_cast<bool>(ctx_); }
+    aesgcmsiv_ctx* release() noexcept { return ctx_.release(); }
+
+    // ciphertext holds at least plaintext.size() bytes
+    result<void> encrypt(nonce_bytes nonce, bytes plaintext, bytes aad,
+        mutable_bytes ciphertext, mutable_tag_bytes tag) const noexcept
+        requires(has_aad)
+    {
+        return seal(nonce, plaintext, aad.data(), aad.size(), ciphertext, tag);
+    }
+
+    result<void> encrypt(nonce_bytes nonce, bytes plaintext,
+        mutable_bytes ciphertext, mutable_tag_bytes tag) const noexcept
+        requires(!has_aad)
+    {
+        return seal(nonce, plaintext, nullptr, 0, ciphertext, tag);
+    }
+
+    // plaintext holds at least ciphertext.size() bytes; it is zeroed if the
+    // tag does not verify
+    result<void> decrypt(nonce_bytes nonce, bytes ciphertext, bytes aad,
+        tag_bytes tag, mutable_bytes plaintext) const noexcept
+        requires(has_aad)
+    {
+        return open(nonce, ciphertext, aad.data(), aad.size(), tag, plaintext);
+    }
+
+    result<void> decrypt(nonce_bytes nonce, bytes ciphertext,
+        tag_bytes tag, mutable_bytes plaintext) const noexcept
+        requires(!has_aad)
+    {
+        return open(nonce, ciphertext, nullptr, 0, tag, plaintext);
+    }
+
+    result<void> encrypt_autononce(bytes plaintext, bytes aad, mutable_bytes out) const noexcept
+        requires(has_aad)
+    {
+        return ctx_.encrypt_autononce(plaintext, aad, out);
+    }
+
+    result<void> encrypt_autononce(bytes plaintext, mutable_bytes out) const noexcept
+        requires(!has_aad)
+    {
+        return ctx_.encrypt_autononce(plaintext, bytes(), out);
+    }
+
+private:
+    explicit basic_context(aesgcmsiv_ctx* adopted) noexcept : ctx_(adopted) {}
+
+    result<void> seal(nonce_bytes nonce, bytes plaintext, const uint8_t* aad, std::size_t aad_len,
+        mutable_bytes ciphertext, mutable_tag_bytes tag) const noexcept
+    {
+        if (ciphertext.size() < plaintext.size()) {
+            return errc::invalid_input;
+        }
+        return detail::check(aesgcmsiv_ctx_encrypt(ctx_.get(), nonce.data(), nonce_size,
+            plaintext.data(), plaintext.size(), aad, aad_len, ciphertext.data(), tag.data()));
+    }
+
+    result<void> open(nonce_bytes nonce, bytes ciphertext, const uint8_t* aad, std::size_t aad_len,
+        tag_bytes tag, mutable_bytes plaintext) const noexcept
+    {
+        if (plaintext.size() < ciphertext.size()) {
+            return errc::invalid_input;
+        }
+        return detail::check(aesgcmsiv_ctx_decrypt(ctx_.get(), nonce.data(), nonce_size,
+            ciphertext.data(), ciphertext.size(), aad, aad_len, tag.data(), plaintext.data()));
+    }
+
+    context ctx_;
+};
+
+using context128 = basic_context<aes128>;
+using context256 = basic_context<aes256>;
+
+// Owns an aesgcmsiv_stream, which borrows a context that must outlive it
+class stream {
+public:
+    stream() noexcept = default;
+    explicit stream(aesgcmsiv_stream* adopted) noexcept : stream_(adopted) {}
+    stream(stream&& other) noexcept : stream_(other.release()) {}
+    stream& operator=(stream&& other) noexcept
+    {
+        if (this != &other) {
+            aesgcmsiv_stream_free(stream_);
+            stream_ = other.release();
+        }
+        return *this;
+    }
+    stream(const stream&) = delete;
+    stream& operator=(const stream&) = delete;
+    ~stream() { aesgcmsiv_stream_free(stream_); }
+
+    // A stream for sealing, whose header is written to header_out
+    static result<stream> begin_seal(
+        const context& ctx, uint32_t chunk_size,
+        std::span<uint8_t, stream_header_size> header_out) noexcept
+    {
+        aesgcmsiv_stream* s = nullptr;
+        int code = aesgcmsiv_stream_seal_new(ctx.get(), chunk_size, header_out.data(), &s);
+        return detail::check(code, stream(s));
+    }
+
+    static result<stream> begin_open(
+        const context& ctx, std::span<const uint8_t, stream_header_size> header) noexcept
+    {
+        aesgcmsiv_stream* s = nullptr;
+        int code = aesgcmsiv_stream_open_new(ctx.get(), header.data(), &s);
+        return detail::check(code, stream(s));
+    }
+
+    aesgcmsiv_stream* get() const noexcept { return stream_; }
+    explicit operator bool() const noexcept { return stream_ != nullptr; }
+    uint32_t chunk_size() const noexcept { return aesgcmsiv_stream_chunk_size(stream_); }
+
+    aesgcmsiv_stream* release() noexcept
+    {
+        aesgcmsiv_stream* s = stream_;
+        stream_ = nullptr;
+        return s;
+    }
+
+    // Seals the next chunk into sealed_out and returns the bytes written,
+    // chunk.size() + tag_size
+    result<std::size_t> seal(bytes chunk, bytes aad, bool last, mutable_bytes sealed_out) noexcept
+    {
+        const std::size_t sealed_len = chunk.size() + tag_size;
+        if (sealed_out.size() < sealed_len) {
+            return errc::invalid_input;
+        }
+        int code = aesgcmsiv_stream_seal(stream_, chunk.data(), chunk.size(),
+            aad.data(), aad.size(), last ? 1 : 0, sealed_out.data());
+        return detail::check(code, std::size_t(sealed_len));
+    }
+
+    // Opens the next sealed chunk into chunk_out and returns the bytes
+    // written, sealed.size() - tag_size
+    result<std::size_t> open(bytes sealed, bytes aad, bool last, mutable_bytes chunk_out) noexcept
+    {
+        if (sealed.size() < tag_size || chunk_out.size() < sealed.size() - tag_size) {
+            return errc::invalid_input;
+        }
+        int code = aesgcmsiv_stream_open(stream_, sealed.data(), sealed.size(),
+            aad.data(), aad.size(), last ? 1 : 0, chunk_out.data());
+        return detail::check(code, std::size_t(sealed.size() - tag_size));
+    }
+
+private:
+    aesgcmsiv_stream* stream_ = nullptr;
+};
+
+// Where a coroutine resumes once its engine request has finished: any
+// object with post(std::coroutine_handle<>), such as a wrapper that queues
+// the handle on an event loop. Only a pointer is kept, so the executor must
+// outlive the awaits that use it. The default resumes the coroutine on the
+// thread that reaps the engine.
+class executor_ref {
+public:
+    executor_ref() noexcept = default;
+
+    template <typename Executor>
+        requires requires(Executor& e, std::coroutine_handle<> h) { e.post(h); }
+    executor_ref(Executor& executor) noexcept
+        : self_(&executor),
+          post_([](void* self, std::coroutine_handle<> h) { static_cast<Executor*>(self)->post(h); })
+    {
+    }
+
+    void post(std::coroutine_handle<> h) const
+    {
+        if (post_) {
+            post_(self_, h);
+        } else {
+            h.resume();
+        }
+    }
+
+private:
+    void* self_ = nullptr;
+    void (*post_)(void*, std::coroutine_handle<>) = nullptr;
+};
+
+// One request on an engine, submitted when awaited. The request lives in
+// the awaiting coroutine's frame, so nothing is allocated per call, and the
+// coroutine resumes through its executor once the engine's reaper has seen
+// the completion. co_await yields the result the aesgcmsiv_ctx_* call would
+// have returned; a request the engine rejects, including with errc::busy
+// when queue_depth requests are outstanding, resumes at once with that
+// error. The context and every buffer must stay valid until then.
+class [[nodiscard]] engine_op {
+public:
+    engine_op(aesgcmsiv_engine* eng, const aesgcmsiv_request& request) noexcept
+        : engine_(eng), request_(request)
+    {
+    }
+
+    // Resumes on executor rather than on the reaping thread
+    engine_op& on(executor_ref executor) noexcept
+    {
+        executor_ = executor;
+        return *this;
+    }
+
+    // Queues on lane, AESGCMSIV_LANE_LATENCY or AESGCMSIV_LANE_BULK, rather
+    // than the one the message's length picks
+    engine_op& in_lane(uint32_t lane) noexcept
+    {
+        lane_ = lane;
+        return *this;
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> h) noexcept
+    {
+        handle_ = h;
+        request_.user_data = reinterpret_cast<uintptr_t>(this);
+        // Once queued, the reaper may resume h before this returns, so
+        // nothing here touches *this after a successful submit
+        int code = lane_ == auto_lane
+            ? aesgcmsiv_engine_submit(engine_, &request_)
+            : aesgcmsiv_engine_submit_lane(engine_, &request_, lane_);
+        if (code != AESGCMSIV_SUCCESS) {
+            status_ = code;
+            return false;
+        }
+        return true;
+    }
+
+    result<void> await_resume() const noexcept { return detail::check(status_); }
+
+private:
+    friend class engine;
+
+    static constexpr uint32_t auto_lane = UINT32_MAX;
+
+    aesgcmsiv_engine* engine_;
+    aesgcmsiv_request request_;
+    uint32_t lane_ = auto_lane;
+    executor_ref executor_;
+    std::coroutine_handle<> handle_;
+    int status_ = AESGCMSIV_SUCCESS;
+};
+
+// Owns an aesgcmsiv_engine and resumes the coroutines awaiting it. Any
+// thread may await its operations, and the engine's workers group what
+// many coroutines submit into multi-buffer batches; one thread at a time
+// drives completions with poll, from an event loop's idle hook, or run, on
+// a thread of its own. Completions must only be reaped through this class
+// once any operation has been awaited.
+class engine {
+public:
+    engine() noexcept = default;
+    explicit engine(aesgcmsiv_engine* adopted) noexcept : engine_(adopted) {}
+    engine(engine&& other) noexcept : engine_(other.release()) {}
+    engine& operator=(engine&& other) noexcept
+    {
+        if (this != &other) {
+            aesgcmsiv_engine_free(engine_);
+            engine_ = other.release();
+        }
+        return *this;
+    }
+    engine(const engine&) = delete;
+    engine& operator=(const engine&) = delete;
+    ~engine() { aesgcmsiv_engine_free(engine_); }
+
+    // See aesgcmsiv_engine_new
+    static result<engine> create(unsigned int workers, std::size_t queue_depth) noexcept
+    {
+        aesgcmsiv_engine* eng = nullptr;
+        int code = aesgcmsiv_engine_new(workers, queue_depth, &eng);
+        return detail::check(code, engine(eng));
+    }
+
+    aesgcmsiv_engine* get() const noexcept { return engine_; }
+    explicit operator bool() const noexcept { return engine_ != nullptr; }
+
+    aesgcmsiv_engine* release() noexcept
+    {
+        aesgcmsiv_engine* eng = engine_;
+        engine_ = nullptr;
+        return eng;
+    }
+
+    // Buffer sizes follow context::encrypt and context::decrypt, and are
+    // checked when the operation is created; a short buffer resumes the
+    // awaiter at once with errc::invalid_input
+    engine_op encrypt(const context& ctx, bytes nonce, bytes plaintext, bytes aad,
+        mutable_bytes ciphertext, mutable_bytes tag) noexcept
+    {
+        const bool fits = ciphertext.size() >= plaintext.size() && tag.size() >= tag_size;
+        return op(ctx, AESGCMSIV_OP_ENCRYPT,
+            make_item(nonce, plaintext, aad, ciphertext, tag.data()), fits);
+    }
+
+    engine_op decrypt(const context& ctx, bytes nonce, bytes ciphertext, bytes aad,
+        bytes tag, mutable_bytes plaintext) noexcept
+    {
+        const bool fits = plaintext.size() >= ciphertext.size() && tag.size() == tag_size;
+        return op(ctx, AESGCMSIV_OP_DECRYPT,
+            make_item(nonce, ciphertext, aad, plaintext, const_cast<uint8_t*>(tag.data())), fits);
+    }
+
+    // Reaps what has finished without blocking and posts each awaiting
+    // coroutine to its executor; returns how many were resumed
+    result<std::size_t> poll() noexcept { return drain(0); }
+
+    // Blocks reaping and resuming until shutdown has been called and
+    // nothing is outstanding
+    result<void> run() noexcept
+    {
+        for (;;) {
+            result<std::size_t> done = drain(1);
+            if (!done) {
+                return done.error();
+            }
+            if (*done == 0) {
+                return {};
+            }
+        }
+    }
+
+    // See aesgcmsiv_engine_set_linger
+    result<void> set_linger(std::uint64_t linger_ns, std::size_t batch_target = 0) noexcept
+    {
+        return detail::check(aesgcmsiv_engine_set_linger(engine_, linger_ns, batch_target));
+    }
+
+    // See aesgcmsiv_engine_set_blocking. On a blocking engine an await
+    // holds its thread in submit while the queue is full, so poll and run
+    // must then be driven from another thread.
+    result<void> set_blocking(bool block) noexcept
+    {
+        return detail::check(aesgcmsiv_engine_set_blocking(engine_, block ? 1 : 0));
+    }
+
+    // See aesgcmsiv_engine_get_stats
+    result<aesgcmsiv_engine_stats> stats() const noexcept
+    {
+        aesgcmsiv_engine_stats out{};
+        int code = aesgcmsiv_engine_get_stats(engine_, &out);
+        return detail::check(code, std::move(out));
+    }
+
+    // See aesgcmsiv_engine_shutdown
+    void shutdown() noexcept { aesgcmsiv_engine_shutdown(engine_); }
+
+private:
+    // Completions reaped per call into the engine
+    static constexpr std::size_t reap_batch = 64;
+
+    engine_op op(const context& ctx, uint32_t operation, const batch_item& item, bool fits) noexcept
+    {
+        // Submit rejects a request without a context, so a short buffer
+        // fails there without a separate path
+        aesgcmsiv_request request{ctx.get(), operation, item, 0};
+        if (!fits) {
+            request.ctx = nullptr;
+        }
+        return engine_op(engine_, request);
+    }
+
+    result<std::size_t> drain(int wait) noexcept
+    {
+        aesgcmsiv_completion completions[reap_batch];
+        std::size_t count = 0;
+        int code = aesgcmsiv_engine_reap(engine_, completions, reap_batch, wait, &count);
+        if (code != AESGCMSIV_SUCCESS) {
+            return static_cast<errc>(code);
+        }
+        for (std::size_t i = 0; i < count; i++) {
+            engine_op* pending = reinterpret_cast<engine_op*>(static_cast<uintptr_t>(completions[i].user_data));
+            pending->status_ = completions[i].status;
+            pending->executor_.post(pending->handle_);
+        }
+        return count;
+    }
+
+    aesgcmsiv_engine* engine_ = nullptr;
+};
+
+inline engine_op context::encrypt_async(engine& eng, bytes nonce, bytes plaintext, bytes aad,
+    mutable_bytes ciphertext, mutable_bytes tag) const noexcept
+{
+    return eng.encrypt(*this, nonce, plaintext, aad, ciphertext, tag);
+}
+
+inline engine_op context::decrypt_async(engine& eng, bytes nonce, bytes ciphertext, bytes aad,
+    bytes tag, mutable_bytes plaintext) const noexcept
+{
+    return eng.decrypt(*this, nonce, ciphertext, aad, tag, plaintext);
+}
+
+} // namespace aesgcmsiv
+
+#endif // AESGCMSIV_HPP
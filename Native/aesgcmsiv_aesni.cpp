@@ -0,0 +1,730 @@
+#include "aesgcmsiv_kernels.h"
+#include "aesgcmsiv.h"
+#include <cstring>
+
+// AES-GCM-SIV primitives on AES-NI and PCLMULQDQ. Every function that uses
+// the instructions carries AESNI_TARGET so the rest of the library can be
+// compiled for a baseline CPU and this file needs no special flags.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+
+#include "aesgcmsiv_x86.h"
+
+#define AESNI_POLYVAL_STRIDE 8
+
+AESNI_TARGET static inline __m128i expand_mix(__m128i prev, __m128i assist)
+{
+    __m128i out = _mm_xor_si128(prev, _mm_slli_si128(prev, 4));
+    out = _mm_xor_si128(out, _mm_slli_si128(prev, 8));
+    out = _mm_xor_si128(out, _mm_slli_si128(prev, 12));
+    return _mm_xor_si128(out, assist);
+}
+
+// Produces round keys i and i+1 of an AES-256 schedule.
+template <int Rcon>
+AESNI_TARGET static inline void expand_256_pair(__m128i* rk, int i, __m128i* k0, __m128i* k1)
+{
+    __m128i assist = _mm_aeskeygenassist_si128(*k1, Rcon);
+    *k0 = expand_mix(*k0, _mm_shuffle_epi32(assist, 0xff));
+    rk[i] = *k0;
+    if (i + 1 <= 14) {
+        assist = _mm_aeskeygenassist_si128(*k0, 0x00);
+        *k1 = expand_mix(*k1, _mm_shuffle_epi32(assist, 0xaa));
+        rk[i + 1] = *k1;
+    }
+}
+
+// Produces the next round key of an AES-128 schedule.
+template <int Rcon>
+AESNI_TARGET static inline __m128i expand_128_step(__m128i k)
+{
+    return expand_mix(k, _mm_shuffle_epi32(_mm_aeskeygenassist_si128(k, Rcon), 0xff));
+}
+
+AESNI_TARGET static void expand_128(const uint8_t* key, aes_key_schedule* ks)
+{
+    __m128i* rk = reinterpret_cast<__m128i*>(ks->round_keys);
+    rk[0] = load_block(key);
+    rk[1] = expand_128_step<0x01>(rk[0]);
+    rk[2] = expand_128_step<0x02>(rk[1]);
+    rk[3] = expand_128_step<0x04>(rk[2]);
+    rk[4] = expand_128_step<0x08>(rk[3]);
+    rk[5] = expand_128_step<0x10>(rk[4]);
+    rk[6] = expand_128_step<0x20>(rk[5]);
+    rk[7] = expand_128_step<0x40>(rk[6]);
+    rk[8] = expand_128_step<0x80>(rk[7]);
+    rk[9] = expand_128_step<0x1b>(rk[8]);
+    rk[10] = expand_128_step<0x36>(rk[9]);
+    ks->rounds = 10;
+}
+
+AESNI_TARGET static void expand_256(const uint8_t* key, aes_key_schedule* ks)
+{
+    __m128i* rk = reinterpret_cast<__m128i*>(ks->round_keys);
+    __m128i k0 = load_block(key);
+    __m128i k1 = load_block(key + 16);
+    rk[0] = k0;
+    rk[1] = k1;
+    expand_256_pair<0x01>(rk, 2, &k0, &k1);
+    expand_256_pair<0x02>(rk, 4, &k0, &k1);
+    expand_256_pair<0x04>(rk, 6, &k0, &k1);
+    expand_256_pair<0x08>(rk, 8, &k0, &k1);
+    expand_256_pair<0x10>(rk, 10, &k0, &k1);
+    expand_256_pair<0x20>(rk, 12, &k0, &k1);
+    expand_256_pair<0x40>(rk, 14, &k0, &k1);
+    ks->rounds = 14;
+}
+
+AESNI_TARGET void aesni_expand_key(const uint8_t* key, size_t key_len, aes_key_schedule* ks)
+{
+    if (key_len == AESGCMSIV_KEY_SIZE_128) {
+        expand_128(key, ks);
+    } else {
+        expand_256(key, ks);
+    }
+}
+
+AESNI_TARGET void aesni_derive_keys(
+    const aes_key_schedule* ks, const uint8_t* nonce,
+    uint8_t* auth_key, aes_key_schedule* enc_ks)
+{
+    const __m128i* rk = reinterpret_cast<const __m128i*>(ks->round_keys);
+
+    // Block i is LE32(i) || nonce
+    alignas(16) uint8_t input[16] = {0};
+    memcpy(input + 4, nonce, AESGCMSIV_NONCE_SIZE);
+    const __m128i base = _mm_load_si128(reinterpret_cast<const __m128i*>(input));
+
+    // AES-128 needs two blocks for the encryption key, AES-256 four
+    __m128i b[6];
+    for (int i = 0; i < 6; i++) {
+        b[i] = _mm_insert_epi32(base, i, 0);
+    }
+    const bool aes128 = ks->rounds == 10;
+    if (aes128) {
+        aes_encrypt_blocks<4>(rk, ks->rounds, b);
+    } else {
+        aes_encrypt_blocks<6>(rk, ks->rounds, b);
+    }
+
+    // Only the first 8 bytes of each output block are used
+    store_block(auth_key, _mm_unpacklo_epi64(b[0], b[1]));
+
+    alignas(16) uint8_t enc_key[32];
+    store_block(enc_key, _mm_unpacklo_epi64(b[2], b[3]));
+    if (aes128) {
+        aesni_expand_key(enc_key, AESGCMSIV_KEY_SIZE_128, enc_ks);
+    } else {
+        store_block(enc_key + 16, _mm_unpacklo_epi64(b[4], b[5]));
+        aesni_expand_key(enc_key, AESGCMSIV_KEY_SIZE_256, enc_ks);
+    }
+
+    aesgcmsiv_secure_zero(enc_key, sizeof(enc_key));
+    aesgcmsiv_secure_zero(b, sizeof(b));
+}
+
+AESNI_TARGET void aesni_encrypt_block(const aes_key_schedule* ks, const uint8_t* in, uint8_t* out)
+{
+    const __m128i* rk = reinterpret_cast<const __m128i*>(ks->round_keys);
+    store_block(out, aes_encrypt_block(rk, ks->rounds, load_block(in)));
+}
+
+// Fills h[0..powers-1] with H^1..H^powers and clears the accumulator.
+AESNI_TARGET void aesni_polyval_powers(polyval_state* pv, const uint8_t* h, int powers)
+{
+    __m128i hv = load_block(h);
+    __m128i p = hv;
+    store_block(pv->h[0], p);
+    for (int i = 1; i < powers; i++) {
+        p = gf_mul(p, hv);
+        store_block(pv->h[i], p);
+    }
+    store_block(pv->s, _mm_setzero_si128());
+}
+
+AESNI_TARGET static void aesni_polyval_init(polyval_state* pv, const uint8_t* h, size_t blocks)
+{
+    aesni_polyval_powers(pv, h, blocks >= AESNI_POLYVAL_STRIDE ? AESNI_POLYVAL_STRIDE : 1);
+}
+
+// Absorbs whole blocks. Eight blocks are multiplied by descending powers of
+// H and reduced once.
+AESNI_TARGET void aesni_polyval_blocks(polyval_state* pv, const uint8_t* data, size_t blocks)
+{
+    __m128i s = load_block(pv->s);
+    if (blocks >= AESNI_POLYVAL_STRIDE) {
+        __m128i h[AESNI_POLYVAL_STRIDE];
+        for (int i = 0; i < AESNI_POLYVAL_STRIDE; i++) {
+            h[i] = load_block(pv->h[i]);
+        }
+        while (blocks >= AESNI_POLYVAL_STRIDE) {
+            __m128i lo = _mm_setzero_si128();
+            __m128i mid = _mm_setzero_si128();
+            __m128i hi = _mm_setzero_si128();
+            clmul_accumulate(_mm_xor_si128(s, load_block(data)), h[AESNI_POLYVAL_STRIDE - 1], &lo, &mid, &hi);
+            for (int j = 1; j < AESNI_POLYVAL_STRIDE; j++) {
+                clmul_accumulate(load_block(data + 16 * j), h[AESNI_POLYVAL_STRIDE - 1 - j], &lo, &mid, &hi);
+            }
+            s = gf_fold(lo, mid, hi);
+            data += 16 * AESNI_POLYVAL_STRIDE;
+            blocks -= AESNI_POLYVAL_STRIDE;
+        }
+    }
+    if (blocks > 0) {
+        const __m128i h1 = load_block(pv->h[0]);
+        while (blocks > 0) {
+            s = gf_mul(_mm_xor_si128(s, load_block(data)), h1);
+            data += 16;
+            blocks--;
+        }
+    }
+    store_block(pv->s, s);
+}
+
+// How far ahead of the current block the streaming loops prefetch input
+#define AESNI_STREAM_PREFETCH 1024
+
+// An output block: a plain store, or with Stream a non-temporal one that
+// skips the cache, which needs p aligned to 16
+template <bool Stream>
+AESNI_TARGET static inline void put_block(uint8_t* p, __m128i v)
+{
+    if (Stream) {
+        _mm_stream_si128(reinterpret_cast<__m128i*>(p), v);
+    } else {
+        store_block(p, v);
+    }
+}
+
+// With Stream, pulls in the two lines of input well ahead of 128 bytes at p
+// without letting them displace the rest of the cache
+template <bool Stream>
+AESNI_TARGET static inline void prefetch_ahead(const uint8_t* p)
+{
+    if (Stream) {
+        _mm_prefetch(reinterpret_cast<const char*>(p + AESNI_STREAM_PREFETCH), _MM_HINT_NTA);
+        _mm_prefetch(reinterpret_cast<const char*>(p + AESNI_STREAM_PREFETCH + 64), _MM_HINT_NTA);
+    }
+}
+
+// Each input block is loaded before its output is stored, so in == out is
+// safe. With Stream, out must be aligned to 16.
+template <bool Stream>
+AESNI_TARGET static void ctr32_impl(
+    const aes_key_schedule* ks, const uint8_t* counter,
+    const uint8_t* in, uint8_t* out, size_t len)
+{
+    const __m128i* rk = reinterpret_cast<const __m128i*>(ks->round_keys);
+    const int rounds = ks->rounds;
+    const __m128i one = _mm_set_epi32(0, 0, 0, 1);
+    __m128i ctr = load_block(counter);
+
+    while (len >= 128) {
+        prefetch_ahead<Stream>(in);
+        __m128i b[8];
+        for (int i = 0; i < 8; i++) {
+            b[i] = ctr;
+            ctr = _mm_add_epi32(ctr, one);
+        }
+        aes_encrypt_blocks<8>(rk, rounds, b);
+        for (int i = 0; i < 8; i++) {
+            put_block<Stream>(out + 16 * i, _mm_xor_si128(load_block(in + 16 * i), b[i]));
+        }
+        in += 128;
+        out += 128;
+        len -= 128;
+    }
+    while (len >= 16) {
+        __m128i b = aes_encrypt_block(rk, rounds, ctr);
+        ctr = _mm_add_epi32(ctr, one);
+        put_block<Stream>(out, _mm_xor_si128(load_block(in), b));
+        in += 16;
+        out += 16;
+        len -= 16;
+    }
+    if (len) {
+        alignas(16) uint8_t keystream[16];
+        store_block(keystream, aes_encrypt_block(rk, rounds, ctr));
+        for (size_t i = 0; i < len; i++) {
+            out[i] = in[i] ^ keystream[i];
+        }
+        aesgcmsiv_secure_zero(keystream, sizeof(keystream));
+    }
+    if (Stream) {
+        // Orders the streamed stores before whatever tells another thread
+        // the output is ready
+        _mm_sfence();
+    }
+}
+
+AESNI_TARGET void aesni_ctr32(
+    const aes_key_schedule* ks, const uint8_t* counter,
+    const uint8_t* in, uint8_t* out, size_t len)
+{
+    ctr32_impl<false>(ks, counter, in, out, len);
+}
+
+// Output that is not aligned to 16 cannot be streamed, and takes plain
+// stores instead
+AESNI_TARGET void aesni_ctr32_stream(
+    const aes_key_schedule* ks, const uint8_t* counter,
+    const uint8_t* in, uint8_t* out, size_t len)
+{
+    if (reinterpret_cast<uintptr_t>(out) & 15) {
+        ctr32_impl<false>(ks, counter, in, out, len);
+    } else {
+        ctr32_impl<true>(ks, counter, in, out, len);
+    }
+}
+
+// ctr32 that hashes each output block while it is still in a register, so
+// decryption reads the ciphertext once and never reads the plaintext back.
+template <bool Stream>
+AESNI_TARGET static void ctr32_polyval_impl(
+    const aes_key_schedule* ks, const uint8_t* counter,
+    const uint8_t* in, uint8_t* out, size_t len, polyval_state* pv)
+{
+    const __m128i* rk = reinterpret_cast<const __m128i*>(ks->round_keys);
+    const int rounds = ks->rounds;
+    const __m128i one = _mm_set_epi32(0, 0, 0, 1);
+    __m128i ctr = load_block(counter);
+    __m128i s = load_block(pv->s);
+
+    if (len >= 16 * AESNI_POLYVAL_STRIDE) {
+        __m128i h[AESNI_POLYVAL_STRIDE];
+        for (int i = 0; i < AESNI_POLYVAL_STRIDE; i++) {
+            h[i] = load_block(pv->h[i]);
+        }
+        while (len >= 16 * AESNI_POLYVAL_STRIDE) {
+            prefetch_ahead<Stream>(in);
+            __m128i b[AESNI_POLYVAL_STRIDE];
+            for (int i = 0; i < AESNI_POLYVAL_STRIDE; i++) {
+                b[i] = ctr;
+                ctr = _mm_add_epi32(ctr, one);
+            }
+            aes_encrypt_blocks<AESNI_POLYVAL_STRIDE>(rk, rounds, b);
+
+            __m128i lo = _mm_setzero_si128();
+            __m128i mid = _mm_setzero_si128();
+            __m128i hi = _mm_setzero_si128();
+            for (int i = 0; i < AESNI_POLYVAL_STRIDE; i++) {
+                __m128i p = _mm_xor_si128(load_block(in + 16 * i), b[i]);
+                put_block<Stream>(out + 16 * i, p);
+                if (i == 0) {
+                    p = _mm_xor_si128(p, s);
+                }
+                clmul_accumulate(p, h[AESNI_POLYVAL_STRIDE - 1 - i], &lo, &mid, &hi);
+            }
+            s = gf_fold(lo, mid, hi);
+            in += 16 * AESNI_POLYVAL_STRIDE;
+            out += 16 * AESNI_POLYVAL_STRIDE;
+            len -= 16 * AESNI_POLYVAL_STRIDE;
+        }
+    }
+
+    const __m128i h1 = load_block(pv->h[0]);
+    while (len >= 16) {
+        __m128i p = _mm_xor_si128(load_block(in), aes_encrypt_block(rk, rounds, ctr));
+        ctr = _mm_add_epi32(ctr, one);
+        put_block<Stream>(out, p);
+        s = gf_mul(_mm_xor_si128(s, p), h1);
+        in += 16;
+        out += 16;
+        len -= 16;
+    }
+    if (len) {
+        alignas(16) uint8_t last[16];
+        store_block(last, aes_encrypt_block(rk, rounds, ctr));
+        for (size_t i = 0; i < len; i++) {
+            last[i] ^= in[i];
+            out[i] = last[i];
+        }
+        memset(last + len, 0, 16 - len);
+        s = gf_mul(_mm_xor_si128(s, load_block(last)), h1);
+        aesgcmsiv_secure_zero(last, sizeof(last));
+    }
+    store_block(pv->s, s);
+    if (Stream) {
+        _mm_sfence();
+    }
+}
+
+AESNI_TARGET void aesni_ctr32_polyval(
+    const aes_key_schedule* ks, const uint8_t* counter,
+    const uint8_t* in, uint8_t* out, size_t len, polyval_state* pv)
+{
+    ctr32_polyval_impl<false>(ks, counter, in, out, len, pv);
+}
+
+AESNI_TARGET void aesni_ctr32_polyval_stream(
+    const aes_key_schedule* ks, const uint8_t* counter,
+    const uint8_t* in, uint8_t* out, size_t len, polyval_state* pv)
+{
+    if (reinterpret_cast<uintptr_t>(out) & 15) {
+        ctr32_polyval_impl<false>(ks, counter, in, out, len, pv);
+    } else {
+        ctr32_polyval_impl<true>(ks, counter, in, out, len, pv);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Multi-buffer primitives. Lanes share the loop structure, so each round or
+// multiply step issues AESGCMSIV_LANES independent instructions.
+// ---------------------------------------------------------------------------
+
+AESNI_TARGET void aesni_derive_keys_lanes(
+    const aes_key_schedule* ks, const uint8_t* const* nonces,
+    uint8_t (*auth_keys)[16], aes_key_schedule* enc_ks)
+{
+    const __m128i* rk = reinterpret_cast<const __m128i*>(ks->round_keys);
+    const bool aes128 = ks->rounds == 10;
+    const int per_lane = aes128 ? 4 : 6;
+
+    __m128i b[AESGCMSIV_LANES * 6];
+    for (int l = 0; l < AESGCMSIV_LANES; l++) {
+        alignas(16) uint8_t input[16] = {0};
+        memcpy(input + 4, nonces[l], AESGCMSIV_NONCE_SIZE);
+        const __m128i base = _mm_load_si128(reinterpret_cast<const __m128i*>(input));
+        for (int i = 0; i < per_lane; i++) {
+            b[l * per_lane + i] = _mm_insert_epi32(base, i, 0);
+        }
+    }
+    // 16 or 24 blocks, in groups of eight to stay within the register file
+    for (int i = 0; i < AESGCMSIV_LANES * per_lane; i += 8) {
+        aes_encrypt_blocks<8>(rk, ks->rounds, b + i);
+    }
+
+    alignas(16) uint8_t enc_key[32];
+    for (int l = 0; l < AESGCMSIV_LANES; l++) {
+        const __m128i* lb = b + l * per_lane;
+        store_block(auth_keys[l], _mm_unpacklo_epi64(lb[0], lb[1]));
+        store_block(enc_key, _mm_unpacklo_epi64(lb[2], lb[3]));
+        if (aes128) {
+            aesni_expand_key(enc_key, AESGCMSIV_KEY_SIZE_128, &enc_ks[l]);
+        } else {
+            store_block(enc_key + 16, _mm_unpacklo_epi64(lb[4], lb[5]));
+            aesni_expand_key(enc_key, AESGCMSIV_KEY_SIZE_256, &enc_ks[l]);
+        }
+    }
+
+    aesgcmsiv_secure_zero(enc_key, sizeof(enc_key));
+    aesgcmsiv_secure_zero(b, sizeof(b));
+}
+
+// All lanes use keys of the same size, so they share the round count.
+AESNI_TARGET static inline void aes_encrypt_lanes(const __m128i* const* rk, int rounds, __m128i* b)
+{
+    for (int l = 0; l < AESGCMSIV_LANES; l++) {
+        b[l] = _mm_xor_si128(b[l], rk[l][0]);
+    }
+    for (int r = 1; r < rounds; r++) {
+        for (int l = 0; l < AESGCMSIV_LANES; l++) {
+            b[l] = _mm_aesenc_si128(b[l], rk[l][r]);
+        }
+    }
+    for (int l = 0; l < AESGCMSIV_LANES; l++) {
+        b[l] = _mm_aesenclast_si128(b[l], rk[l][rounds]);
+    }
+}
+
+AESNI_TARGET void aesni_encrypt_block_lanes(
+    const aes_key_schedule* enc_ks, const uint8_t (*in)[16], uint8_t (*out)[16])
+{
+    const __m128i* rk[AESGCMSIV_LANES];
+    __m128i b[AESGCMSIV_LANES];
+    for (int l = 0; l < AESGCMSIV_LANES; l++) {
+        rk[l] = reinterpret_cast<const __m128i*>(enc_ks[l].round_keys);
+        b[l] = load_block(in[l]);
+    }
+    aes_encrypt_lanes(rk, enc_ks[0].rounds, b);
+    for (int l = 0; l < AESGCMSIV_LANES; l++) {
+        store_block(out[l], b[l]);
+    }
+}
+
+AESNI_TARGET void aesni_polyval_lanes(
+    const uint8_t (*h)[16], const uint8_t* const* data, const size_t* blocks,
+    uint8_t (*s_out)[16])
+{
+    __m128i hv[AESGCMSIV_LANES];
+    __m128i s[AESGCMSIV_LANES];
+    size_t max_blocks = 0;
+    for (int l = 0; l < AESGCMSIV_LANES; l++) {
+        hv[l] = load_block(h[l]);
+        s[l] = _mm_setzero_si128();
+        if (blocks[l] > max_blocks) {
+            max_blocks = blocks[l];
+        }
+    }
+    for (size_t j = 0; j < max_blocks; j++) {
+        for (int l = 0; l < AESGCMSIV_LANES; l++) {
+            if (j < blocks[l]) {
+                s[l] = gf_mul(_mm_xor_si128(s[l], load_block(data[l] + 16 * j)), hv[l]);
+            }
+        }
+    }
+    for (int l = 0; l < AESGCMSIV_LANES; l++) {
+        store_block(s_out[l], s[l]);
+    }
+}
+
+// Runs until the longest lane is done; lanes that finish early keep
+// generating keystream that is discarded, which is cheap for the short
+// messages this path is used for.
+AESNI_TARGET void aesni_ctr32_lanes(
+    const aes_key_schedule* enc_ks, const uint8_t (*counters)[16],
+    const uint8_t* const* in, uint8_t* const* out, const size_t* len)
+{
+    const __m128i one = _mm_set_epi32(0, 0, 0, 1);
+    const __m128i* rk[AESGCMSIV_LANES];
+    __m128i ctr[AESGCMSIV_LANES];
+    size_t max_len = 0;
+    for (int l = 0; l < AESGCMSIV_LANES; l++) {
+        rk[l] = reinterpret_cast<const __m128i*>(enc_ks[l].round_keys);
+        ctr[l] = load_block(counters[l]);
+        if (len[l] > max_len) {
+            max_len = len[l];
+        }
+    }
+
+    alignas(16) uint8_t keystream[16];
+    for (size_t off = 0; off < max_len; off += 16) {
+        __m128i b[AESGCMSIV_LANES];
+        for (int l = 0; l < AESGCMSIV_LANES; l++) {
+            b[l] = ctr[l];
+            ctr[l] = _mm_add_epi32(ctr[l], one);
+        }
+        aes_encrypt_lanes(rk, enc_ks[0].rounds, b);
+        for (int l = 0; l < AESGCMSIV_LANES; l++) {
+            if (off >= len[l]) {
+                continue;
+            }
+            const size_t n = len[l] - off;
+            if (n >= 16) {
+                store_block(out[l] + off, _mm_xor_si128(load_block(in[l] + off), b[l]));
+            } else {
+                store_block(keystream, b[l]);
+                for (size_t i = 0; i < n; i++) {
+                    out[l][off + i] = in[l][off + i] ^ keystream[i];
+                }
+            }
+        }
+    }
+    aesgcmsiv_secure_zero(keystream, sizeof(keystream));
+}
+
+// ---------------------------------------------------------------------------
+// Fixed-size messages. Each instantiation takes exactly Blocks message
+// blocks and Aad (0 or 1) AAD blocks, so the CTR and POLYVAL loops unroll
+// completely and the whole message lives in registers.
+// ---------------------------------------------------------------------------
+
+// POLYVAL from zero of N blocks, each multiplied by its power of H and
+// reduced once. H^(i+1) is H^a * H^b with a and b about half of i, so the
+// powers take a chain of log2(N) multiplies rather than N.
+template <int N>
+AESNI_TARGET static inline __m128i polyval_fixed(__m128i h, const __m128i* x)
+{
+    __m128i p[N];
+    p[0] = h;
+    for (int i = 1; i < N; i++) {
+        p[i] = gf_mul(p[(i - 1) / 2], p[i / 2]);
+    }
+    __m128i lo = _mm_setzero_si128();
+    __m128i mid = _mm_setzero_si128();
+    __m128i hi = _mm_setzero_si128();
+    for (int i = 0; i < N; i++) {
+        clmul_accumulate(x[i], p[N - 1 - i], &lo, &mid, &hi);
+    }
+    aesgcmsiv_secure_zero(p, sizeof(p));
+    return gf_fold(lo, mid, hi);
+}
+
+// Zero-pads the AAD and message into consecutive blocks and appends the
+// length block.
+template <int Blocks, int Aad>
+AESNI_TARGET static inline void load_fixed(
+    const uint8_t* aad, size_t aad_len, const uint8_t* msg, size_t msg_len,
+    uint8_t* buf, __m128i* x)
+{
+    memset(buf, 0, 16 * (Aad + Blocks));
+    if (Aad) {
+        memcpy(buf, aad, aad_len);
+    }
+    memcpy(buf + 16 * Aad, msg, msg_len);
+    for (int i = 0; i < Aad + Blocks; i++) {
+        x[i] = load_block(buf + 16 * i);
+    }
+    x[Aad + Blocks] = _mm_set_epi64x(
+        static_cast<long long>(static_cast<uint64_t>(msg_len) * 8),
+        static_cast<long long>(static_cast<uint64_t>(aad_len) * 8));
+}
+
+// The tag from the POLYVAL result: XOR the nonce, clear the top bit, encrypt.
+AESNI_TARGET static inline __m128i tag_fixed(
+    const __m128i* rk, int rounds, __m128i s, const uint8_t* nonce)
+{
+    alignas(16) uint8_t n[16] = {0};
+    memcpy(n, nonce, AESGCMSIV_NONCE_SIZE);
+    s = _mm_xor_si128(s, _mm_load_si128(reinterpret_cast<const __m128i*>(n)));
+    s = _mm_and_si128(s, _mm_set_epi32(0x7fffffff, -1, -1, -1));
+    return aes_encrypt_block(rk, rounds, s);
+}
+
+// Keystream blocks for Blocks counters starting at the tag with its top bit
+// set.
+template <int Blocks>
+AESNI_TARGET static inline void ctr_fixed(const __m128i* rk, int rounds, __m128i tag, __m128i* b)
+{
+    const __m128i ctr = _mm_or_si128(tag, _mm_set_epi32(static_cast<int>(0x80000000u), 0, 0, 0));
+    for (int i = 0; i < Blocks; i++) {
+        b[i] = _mm_add_epi32(ctr, _mm_set_epi32(0, 0, 0, i));
+    }
+    aes_encrypt_blocks<Blocks>(rk, rounds, b);
+}
+
+template <int Blocks, int Aad>
+AESNI_TARGET static void seal_fixed(
+    const uint8_t* auth_key, const aes_key_schedule* enc_ks, const uint8_t* nonce,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out, uint8_t* tag_out)
+{
+    const __m128i* rk = reinterpret_cast<const __m128i*>(enc_ks->round_keys);
+
+    alignas(16) uint8_t buf[16 * (Aad + Blocks)];
+    __m128i x[Aad + Blocks + 1];
+    load_fixed<Blocks, Aad>(aad, aad_len, plaintext, plaintext_len, buf, x);
+    const __m128i tag = tag_fixed(rk, enc_ks->rounds, polyval_fixed<Aad + Blocks + 1>(load_block(auth_key), x), nonce);
+
+    __m128i b[Blocks];
+    ctr_fixed<Blocks>(rk, enc_ks->rounds, tag, b);
+    for (int i = 0; i < Blocks; i++) {
+        store_block(buf + 16 * i, _mm_xor_si128(x[Aad + i], b[i]));
+    }
+    // The plaintext was copied into buf, so the output may overlap it
+    memcpy(ciphertext_out, buf, plaintext_len);
+    store_block(tag_out, tag);
+
+    aesgcmsiv_secure_zero(buf, sizeof(buf));
+    aesgcmsiv_secure_zero(x, sizeof(x));
+    aesgcmsiv_secure_zero(b, sizeof(b));
+}
+
+template <int Blocks, int Aad>
+AESNI_TARGET static int open_fixed(
+    const uint8_t* auth_key, const aes_key_schedule* enc_ks, const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out)
+{
+    const __m128i* rk = reinterpret_cast<const __m128i*>(enc_ks->round_keys);
+
+    alignas(16) uint8_t buf[16 * (Aad + Blocks)];
+    __m128i x[Aad + Blocks + 1];
+    load_fixed<Blocks, Aad>(aad, aad_len, ciphertext, ciphertext_len, buf, x);
+
+    const __m128i received = load_block(tag);
+    __m128i b[Blocks];
+    ctr_fixed<Blocks>(rk, enc_ks->rounds, received, b);
+    for (int i = 0; i < Blocks; i++) {
+        x[Aad + i] = _mm_xor_si128(x[Aad + i], b[i]);
+    }
+    // Keystream under the padding of the last block must not be hashed
+    const int last = static_cast<int>(ciphertext_len - 16 * (Blocks - 1));
+    const __m128i keep = _mm_cmpgt_epi8(
+        _mm_set1_epi8(static_cast<char>(last)),
+        _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+    x[Aad + Blocks - 1] = _mm_and_si128(x[Aad + Blocks - 1], keep);
+
+    const __m128i expected = tag_fixed(rk, enc_ks->rounds, polyval_fixed<Aad + Blocks + 1>(load_block(auth_key), x), nonce);
+    const bool ok = _mm_movemask_epi8(_mm_cmpeq_epi8(expected, received)) == 0xffff;
+
+    // Nothing is written but the plaintext of a message that authenticated,
+    // or zeros
+    for (int i = 0; i < Blocks; i++) {
+        store_block(buf + 16 * i, ok ? x[Aad + i] : _mm_setzero_si128());
+    }
+    memcpy(plaintext_out, buf, ciphertext_len);
+
+    aesgcmsiv_secure_zero(buf, sizeof(buf));
+    aesgcmsiv_secure_zero(x, sizeof(x));
+    aesgcmsiv_secure_zero(b, sizeof(b));
+    return ok ? AESGCMSIV_SUCCESS : AESGCMSIV_ERROR_DECRYPT_FAILED;
+}
+
+typedef void (*seal_fixed_fn)(
+    const uint8_t*, const aes_key_schedule*, const uint8_t*, const uint8_t*, size_t,
+    const uint8_t*, size_t, uint8_t*, uint8_t*);
+typedef int (*open_fixed_fn)(
+    const uint8_t*, const aes_key_schedule*, const uint8_t*, const uint8_t*, size_t,
+    const uint8_t*, size_t, const uint8_t*, uint8_t*);
+
+// Indexed by [AAD blocks][message blocks - 1]
+static const seal_fixed_fn seal_fixed_table[2][4] = {
+    {seal_fixed<1, 0>, seal_fixed<2, 0>, seal_fixed<3, 0>, seal_fixed<4, 0>},
+    {seal_fixed<1, 1>, seal_fixed<2, 1>, seal_fixed<3, 1>, seal_fixed<4, 1>},
+};
+static const open_fixed_fn open_fixed_table[2][4] = {
+    {open_fixed<1, 0>, open_fixed<2, 0>, open_fixed<3, 0>, open_fixed<4, 0>},
+    {open_fixed<1, 1>, open_fixed<2, 1>, open_fixed<3, 1>, open_fixed<4, 1>},
+};
+
+void aesni_seal_small(
+    const uint8_t* auth_key, const aes_key_schedule* enc_ks, const uint8_t* nonce,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out, uint8_t* tag_out)
+{
+    seal_fixed_table[aad_len != 0][(plaintext_len - 1) / 16](
+        auth_key, enc_ks, nonce, plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out);
+}
+
+int aesni_open_small(
+    const uint8_t* auth_key, const aes_key_schedule* enc_ks, const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out)
+{
+    return open_fixed_table[aad_len != 0][(ciphertext_len - 1) / 16](
+        auth_key, enc_ks, nonce, ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out);
+}
+
+static const aesgcmsiv_kernel aesni_kernel = {
+    "aesni",
+    aesni_expand_key,
+    aesni_derive_keys,
+    aesni_encrypt_block,
+    aesni_polyval_init,
+    aesni_polyval_blocks,
+    aesni_ctr32,
+    aesni_ctr32_polyval,
+    aesni_derive_keys_lanes,
+    aesni_encrypt_block_lanes,
+    aesni_polyval_lanes,
+    aesni_ctr32_lanes,
+    aesni_seal_small,
+    aesni_open_small,
+    aesni_ctr32_stream,
+    aesni_ctr32_polyval_stream,
+    4,
+    128,
+    0,
+};
+
+const aesgcmsiv_kernel* aesni_kernel_probe(uint32_t cpu_features)
+{
+    const uint32_t required = AESGCMSIV_CPU_AESNI | AESGCMSIV_CPU_PCLMULQDQ | AESGCMSIV_CPU_SSE41;
+    return (cpu_features & required) == required ? &aesni_kernel : nullptr;
+}
+
+#else // not x86
+
+const aesgcmsiv_kernel* aesni_kernel_probe(uint32_t)
+{
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,220 @@
+#include "aesgcmsiv.h"
+#include "aesgcmsiv_pool.h"
+
+// Memory for large buffers, mapped straight from the OS so it starts on a
+// page boundary, with huge pages, NUMA placement and locking on request.
+
+#define HUGE_PAGE_SIZE (size_t(2) << 20)
+
+#define ALLOC_NODE_MASK 0xff00u
+#define ALLOC_KNOWN_FLAGS (AESGCMSIV_ALLOC_HUGE_PAGES | AESGCMSIV_ALLOC_LOCKED | ALLOC_NODE_MASK)
+
+// The node AESGCMSIV_ALLOC_NODE names, or -1 for none
+static int alloc_node(uint32_t flags)
+{
+    return static_cast<int>((flags & ALLOC_NODE_MASK) >> 8) - 1;
+}
+
+static size_t round_up(size_t size, size_t unit)
+{
+    return size > SIZE_MAX - (unit - 1) ? 0 : (size + unit - 1) / unit * unit;
+}
+
+#if defined(_WIN32)
+
+#include <windows.h>
+
+static void* reserve(size_t size, DWORD type, int node)
+{
+    const long os_node = node >= 0 ? aesgcmsiv_numa_os_node(static_cast<unsigned int>(node)) : -1;
+    return os_node >= 0
+        ? VirtualAllocExNuma(GetCurrentProcess(), nullptr, size, type, PAGE_READWRITE, static_cast<DWORD>(os_node))
+        : VirtualAlloc(nullptr, size, type, PAGE_READWRITE);
+}
+
+void* aesgcmsiv_alloc(size_t size, uint32_t flags)
+{
+    if (size == 0 || (flags & ~ALLOC_KNOWN_FLAGS) != 0) {
+        return nullptr;
+    }
+    const int node = alloc_node(flags);
+    void* data = nullptr;
+    if (flags & AESGCMSIV_ALLOC_HUGE_PAGES) {
+        // Large pages are always locked, and need SeLockMemoryPrivilege
+        const size_t large = GetLargePageMinimum();
+        const size_t rounded = large ? round_up(size, large) : 0;
+        if (rounded) {
+            data = reserve(rounded, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, node);
+        }
+        if (data) {
+            return data;
+        }
+        size = round_up(size, HUGE_PAGE_SIZE);
+        if (size == 0) {
+            return nullptr;
+        }
+    }
+    data = reserve(size, MEM_RESERVE | MEM_COMMIT, node);
+    if (data && (flags & AESGCMSIV_ALLOC_LOCKED) && !VirtualLock(data, size)) {
+        VirtualFree(data, 0, MEM_RELEASE);
+        return nullptr;
+    }
+    return data;
+}
+
+void aesgcmsiv_free(void* ptr)
+{
+    if (ptr) {
+        VirtualFree(ptr, 0, MEM_RELEASE);
+    }
+}
+
+#else
+
+#include <mutex>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <unordered_map>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+namespace {
+
+// munmap needs the length, which aesgcmsiv_free is not given, so the
+// length of each live mapping is kept here. Allocations are few and large.
+std::mutex g_mappings_lock;
+std::unordered_map<void*, size_t>* g_mappings;
+
+bool remember(void* data, size_t size)
+{
+    std::lock_guard<std::mutex> lock(g_mappings_lock);
+    if (!g_mappings) {
+        g_mappings = new (std::nothrow) std::unordered_map<void*, size_t>();
+        if (!g_mappings) {
+            return false;
+        }
+    }
+    try {
+        g_mappings->emplace(data, size);
+    } catch (...) {
+        return false;
+    }
+    return true;
+}
+
+// The mapping's length, forgotten, or 0 if data is not a live mapping
+size_t forget(void* data)
+{
+    std::lock_guard<std::mutex> lock(g_mappings_lock);
+    if (!g_mappings) {
+        return 0;
+    }
+    auto it = g_mappings->find(data);
+    if (it == g_mappings->end()) {
+        return 0;
+    }
+    size_t size = it->second;
+    g_mappings->erase(it);
+    return size;
+}
+
+void* map_anonymous(size_t size, int extra)
+{
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | extra, -1, 0);
+    return data == MAP_FAILED ? nullptr : data;
+}
+
+// size bytes starting on a 2 MB boundary, for transparent huge pages: maps
+// 2 MB more than asked and unmaps the ends
+void* map_huge_aligned(size_t size)
+{
+    if (size > SIZE_MAX - HUGE_PAGE_SIZE) {
+        return nullptr;
+    }
+    uint8_t* raw = static_cast<uint8_t*>(map_anonymous(size + HUGE_PAGE_SIZE, 0));
+    if (!raw) {
+        return nullptr;
+    }
+    uint8_t* data = reinterpret_cast<uint8_t*>(
+        round_up(reinterpret_cast<uintptr_t>(raw), HUGE_PAGE_SIZE));
+    if (data > raw) {
+        munmap(raw, static_cast<size_t>(data - raw));
+    }
+    const size_t tail = static_cast<size_t>(raw + size + HUGE_PAGE_SIZE - (data + size));
+    if (tail > 0) {
+        munmap(data + size, tail);
+    }
+    return data;
+}
+
+// Prefers node for pages not yet touched; a full node spills to others
+void prefer_node(void* data, size_t size, int node)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+    const long os_node = node >= 0 ? aesgcmsiv_numa_os_node(static_cast<unsigned int>(node)) : -1;
+    if (os_node < 0 || os_node >= 64) {
+        return;
+    }
+    const int MPOL_PREFERRED_MODE = 1;
+    unsigned long mask = 1ul << os_node;
+    syscall(SYS_mbind, data, size, MPOL_PREFERRED_MODE, &mask, 64ul, 0u);
+#else
+    (void)data;
+    (void)size;
+    (void)node;
+#endif
+}
+
+} // namespace
+
+void* aesgcmsiv_alloc(size_t size, uint32_t flags)
+{
+    if (size == 0 || (flags & ~ALLOC_KNOWN_FLAGS) != 0) {
+        return nullptr;
+    }
+    void* data = nullptr;
+    if (flags & AESGCMSIV_ALLOC_HUGE_PAGES) {
+        size = round_up(size, HUGE_PAGE_SIZE);
+        if (size == 0) {
+            return nullptr;
+        }
+#if defined(MAP_HUGETLB)
+        // Reserved huge pages, if the administrator set any aside
+        data = map_anonymous(size, MAP_HUGETLB);
+#endif
+        if (!data && (data = map_huge_aligned(size)) != nullptr) {
+#if defined(MADV_HUGEPAGE)
+            madvise(data, size, MADV_HUGEPAGE);
+#endif
+        }
+    } else {
+        size = round_up(size, static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+        data = size ? map_anonymous(size, 0) : nullptr;
+    }
+    if (!data) {
+        return nullptr;
+    }
+
+    prefer_node(data, size, alloc_node(flags));
+    if (((flags & AESGCMSIV_ALLOC_LOCKED) && mlock(data, size) != 0) || !remember(data, size)) {
+        munmap(data, size);
+        return nullptr;
+    }
+    return data;
+}
+
+void aesgcmsiv_free(void* ptr)
+{
+    if (!ptr) {
+        return;
+    }
+    size_t size = forget(ptr);
+    if (size > 0) {
+        munmap(ptr, size);
+    }
+}
+
+#endif
@@ -0,0 +1,310 @@
+#include "aesgcmsiv_kernels.h"
+#include "aesgcmsiv.h"
+#include <cstring>
+
+// AES-GCM-SIV primitives on the ARMv8 Cryptography Extensions: AESE/AESMC
+// for AES and PMULL for POLYVAL. On GCC and Clang this file is compiled with
+// +crypto (see CMakeLists.txt); the probe checks the CPU before any of it
+// runs.
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+
+#include <arm_neon.h>
+
+#define ARMV8_POLYVAL_STRIDE 8
+
+// ---------------------------------------------------------------------------
+// AES
+// ---------------------------------------------------------------------------
+
+// SubWord via AESE with a zero round key. With all four columns equal,
+// ShiftRows is a no-op, so lane 0 holds the S-box of each byte.
+static inline uint32_t sub_word(uint32_t w)
+{
+    uint8x16_t v = vreinterpretq_u8_u32(vdupq_n_u32(w));
+    v = vaeseq_u8(v, vdupq_n_u8(0));
+    return vgetq_lane_u32(vreinterpretq_u32_u8(v), 0);
+}
+
+static void armv8_expand_key(const uint8_t* key, size_t key_len, aes_key_schedule* ks)
+{
+    static const uint8_t rcon[10] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36};
+    const int nk = static_cast<int>(key_len / 4);
+    const int rounds = nk + 6;
+    const int words = 4 * (rounds + 1);
+    uint32_t w[4 * (AESGCMSIV_MAX_ROUNDS + 1)];
+    memcpy(w, key, key_len);
+    for (int i = nk; i < words; i++) {
+        uint32_t t = w[i - 1];
+        if (i % nk == 0) {
+            // RotWord on little-endian words, then SubWord and Rcon
+            t = sub_word((t >> 8) | (t << 24)) ^ rcon[i / nk - 1];
+        } else if (nk == 8 && i % 8 == 4) {
+            t = sub_word(t);
+        }
+        w[i] = w[i - nk] ^ t;
+    }
+    memcpy(ks->round_keys, w, sizeof(uint32_t) * words);
+    ks->rounds = rounds;
+    aesgcmsiv_secure_zero(w, sizeof(w));
+}
+
+static inline uint8x16_t aes_encrypt_block(const uint8x16_t* rk, int rounds, uint8x16_t b)
+{
+    for (int r = 0; r < rounds - 1; r++) {
+        b = vaesmcq_u8(vaeseq_u8(b, rk[r]));
+    }
+    b = vaeseq_u8(b, rk[rounds - 1]);
+    return veorq_u8(b, rk[rounds]);
+}
+
+template <int N>
+static inline void aes_encrypt_blocks(const uint8x16_t* rk, int rounds, uint8x16_t* b)
+{
+    for (int r = 0; r < rounds - 1; r++) {
+        const uint8x16_t k = rk[r];
+        for (int i = 0; i < N; i++) {
+            b[i] = vaesmcq_u8(vaeseq_u8(b[i], k));
+        }
+    }
+    for (int i = 0; i < N; i++) {
+        b[i] = veorq_u8(vaeseq_u8(b[i], rk[rounds - 1]), rk[rounds]);
+    }
+}
+
+static inline void load_schedule(const aes_key_schedule* ks, uint8x16_t* rk)
+{
+    for (int r = 0; r <= ks->rounds; r++) {
+        rk[r] = vld1q_u8(ks->round_keys[r]);
+    }
+}
+
+static void armv8_derive_keys(
+    const aes_key_schedule* ks, const uint8_t* nonce,
+    uint8_t* auth_key, aes_key_schedule* enc_ks)
+{
+    uint8x16_t rk[AESGCMSIV_MAX_ROUNDS + 1];
+    load_schedule(ks, rk);
+
+    // Block i is LE32(i) || nonce
+    uint8_t input[16] = {0};
+    memcpy(input + 4, nonce, AESGCMSIV_NONCE_SIZE);
+    const uint32x4_t base = vreinterpretq_u32_u8(vld1q_u8(input));
+
+    // AES-128 needs two blocks for the encryption key, AES-256 four
+    uint8x16_t b[6];
+    for (int i = 0; i < 6; i++) {
+        b[i] = vreinterpretq_u8_u32(vsetq_lane_u32(static_cast<uint32_t>(i), base, 0));
+    }
+    const bool aes128 = ks->rounds == 10;
+    if (aes128) {
+        aes_encrypt_blocks<4>(rk, ks->rounds, b);
+    } else {
+        aes_encrypt_blocks<6>(rk, ks->rounds, b);
+    }
+    const int enc_blocks = aes128 ? 2 : 4;
+
+    // Only the first 8 bytes of each output block are used
+    uint8_t enc_key[32];
+    vst1_u8(auth_key, vget_low_u8(b[0]));
+    vst1_u8(auth_key + 8, vget_low_u8(b[1]));
+    for (int i = 0; i < enc_blocks; i++) {
+        vst1_u8(enc_key + 8 * i, vget_low_u8(b[2 + i]));
+    }
+    armv8_expand_key(enc_key, 8 * static_cast<size_t>(enc_blocks), enc_ks);
+
+    aesgcmsiv_secure_zero(enc_key, sizeof(enc_key));
+    aesgcmsiv_secure_zero(b, sizeof(b));
+    aesgcmsiv_secure_zero(rk, sizeof(rk));
+}
+
+static void armv8_encrypt_block(const aes_key_schedule* ks, const uint8_t* in, uint8_t* out)
+{
+    uint8x16_t rk[AESGCMSIV_MAX_ROUNDS + 1];
+    load_schedule(ks, rk);
+    vst1q_u8(out, aes_encrypt_block(rk, ks->rounds, vld1q_u8(in)));
+    aesgcmsiv_secure_zero(rk, sizeof(rk));
+}
+
+// ---------------------------------------------------------------------------
+// POLYVAL
+// ---------------------------------------------------------------------------
+
+static inline uint64x2_t pmull(uint64_t a, uint64_t b)
+{
+    return vreinterpretq_u64_p128(vmull_p64(static_cast<poly64_t>(a), static_cast<poly64_t>(b)));
+}
+
+static inline void clmul_accumulate(
+    uint64x2_t a, uint64x2_t b, uint64x2_t* lo, uint64x2_t* mid, uint64x2_t* hi)
+{
+    const uint64_t a0 = vgetq_lane_u64(a, 0), a1 = vgetq_lane_u64(a, 1);
+    const uint64_t b0 = vgetq_lane_u64(b, 0), b1 = vgetq_lane_u64(b, 1);
+    *lo = veorq_u64(*lo, pmull(a0, b0));
+    *hi = veorq_u64(*hi, pmull(a1, b1));
+    *mid = veorq_u64(*mid, veorq_u64(pmull(a0, b1), pmull(a1, b0)));
+}
+
+// Same reduction as the x86 kernels: multiplies by x^-128 modulo
+// x^128 + x^127 + x^126 + x^121 + 1.
+static inline uint64x2_t gf_fold(uint64x2_t lo, uint64x2_t mid, uint64x2_t hi)
+{
+    const uint64x2_t zero = vdupq_n_u64(0);
+    const uint64_t poly = 0xc200000000000000ULL;
+    lo = veorq_u64(lo, vextq_u64(zero, mid, 1));
+    hi = veorq_u64(hi, vextq_u64(mid, zero, 1));
+
+    uint64x2_t t = pmull(vgetq_lane_u64(lo, 0), poly);
+    lo = veorq_u64(vextq_u64(lo, lo, 1), t);
+    t = pmull(vgetq_lane_u64(lo, 0), poly);
+    lo = veorq_u64(vextq_u64(lo, lo, 1), t);
+    return veorq_u64(hi, lo);
+}
+
+static inline uint64x2_t gf_mul(uint64x2_t a, uint64x2_t b)
+{
+    uint64x2_t lo = vdupq_n_u64(0);
+    uint64x2_t mid = vdupq_n_u64(0);
+    uint64x2_t hi = vdupq_n_u64(0);
+    clmul_accumulate(a, b, &lo, &mid, &hi);
+    return gf_fold(lo, mid, hi);
+}
+
+static inline uint64x2_t load_u64x2(const uint8_t* p)
+{
+    return vreinterpretq_u64_u8(vld1q_u8(p));
+}
+
+static inline void store_u64x2(uint8_t* p, uint64x2_t v)
+{
+    vst1q_u8(p, vreinterpretq_u8_u64(v));
+}
+
+static void armv8_polyval_init(polyval_state* pv, const uint8_t* h, size_t blocks)
+{
+    const int powers = blocks >= ARMV8_POLYVAL_STRIDE ? ARMV8_POLYVAL_STRIDE : 1;
+    const uint64x2_t hv = load_u64x2(h);
+    uint64x2_t p = hv;
+    store_u64x2(pv->h[0], p);
+    for (int i = 1; i < powers; i++) {
+        p = gf_mul(p, hv);
+        store_u64x2(pv->h[i], p);
+    }
+    store_u64x2(pv->s, vdupq_n_u64(0));
+}
+
+static void armv8_polyval_blocks(polyval_state* pv, const uint8_t* data, size_t blocks)
+{
+    uint64x2_t s = load_u64x2(pv->s);
+    if (blocks >= ARMV8_POLYVAL_STRIDE) {
+        uint64x2_t h[ARMV8_POLYVAL_STRIDE];
+        for (int i = 0; i < ARMV8_POLYVAL_STRIDE; i++) {
+            h[i] = load_u64x2(pv->h[i]);
+        }
+        while (blocks >= ARMV8_POLYVAL_STRIDE) {
+            uint64x2_t lo = vdupq_n_u64(0);
+            uint64x2_t mid = vdupq_n_u64(0);
+            uint64x2_t hi = vdupq_n_u64(0);
+            clmul_accumulate(veorq_u64(s, load_u64x2(data)), h[ARMV8_POLYVAL_STRIDE - 1], &lo, &mid, &hi);
+            for (int j = 1; j < ARMV8_POLYVAL_STRIDE; j++) {
+                clmul_accumulate(load_u64x2(data + 16 * j), h[ARMV8_POLYVAL_STRIDE - 1 - j], &lo, &mid, &hi);
+            }
+            s = gf_fold(lo, mid, hi);
+            data += 16 * ARMV8_POLYVAL_STRIDE;
+            blocks -= ARMV8_POLYVAL_STRIDE;
+        }
+    }
+    if (blocks > 0) {
+        const uint64x2_t h1 = load_u64x2(pv->h[0]);
+        while (blocks > 0) {
+            s = gf_mul(veorq_u64(s, load_u64x2(data)), h1);
+            data += 16;
+            blocks--;
+        }
+    }
+    store_u64x2(pv->s, s);
+}
+
+// ---------------------------------------------------------------------------
+// CTR
+// ---------------------------------------------------------------------------
+
+static void armv8_ctr32(
+    const aes_key_schedule* ks, const uint8_t* counter,
+    const uint8_t* in, uint8_t* out, size_t len)
+{
+    uint8x16_t rk[AESGCMSIV_MAX_ROUNDS + 1];
+    load_schedule(ks, rk);
+    const int rounds = ks->rounds;
+    const uint32x4_t one = vsetq_lane_u32(1, vdupq_n_u32(0), 0);
+    uint32x4_t ctr = vreinterpretq_u32_u8(vld1q_u8(counter));
+
+    while (len >= 128) {
+        uint8x16_t b[8];
+        for (int i = 0; i < 8; i++) {
+            b[i] = vreinterpretq_u8_u32(ctr);
+            ctr = vaddq_u32(ctr, one);
+        }
+        aes_encrypt_blocks<8>(rk, rounds, b);
+        for (int i = 0; i < 8; i++) {
+            vst1q_u8(out + 16 * i, veorq_u8(vld1q_u8(in + 16 * i), b[i]));
+        }
+        in += 128;
+        out += 128;
+        len -= 128;
+    }
+    while (len >= 16) {
+        uint8x16_t b = aes_encrypt_block(rk, rounds, vreinterpretq_u8_u32(ctr));
+        ctr = vaddq_u32(ctr, one);
+        vst1q_u8(out, veorq_u8(vld1q_u8(in), b));
+        in += 16;
+        out += 16;
+        len -= 16;
+    }
+    if (len) {
+        uint8_t keystream[16];
+        vst1q_u8(keystream, aes_encrypt_block(rk, rounds, vreinterpretq_u8_u32(ctr)));
+        for (size_t i = 0; i < len; i++) {
+            out[i] = in[i] ^ keystream[i];
+        }
+        aesgcmsiv_secure_zero(keystream, sizeof(keystream));
+    }
+    aesgcmsiv_secure_zero(rk, sizeof(rk));
+}
+
+static const aesgcmsiv_kernel armv8_kernel = {
+    "armv8-crypto",
+    armv8_expand_key,
+    armv8_derive_keys,
+    armv8_encrypt_block,
+    armv8_polyval_init,
+    armv8_polyval_blocks,
+    armv8_ctr32,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    4,
+    128,
+    0,
+};
+
+const aesgcmsiv_kernel* armv8_kernel_probe(uint32_t cpu_features)
+{
+    const uint32_t required = AESGCMSIV_CPU_ARMV8_AES | AESGCMSIV_CPU_ARMV8_PMULL;
+    return (cpu_features & required) == required ? &armv8_kernel : nullptr;
+}
+
+#else // not arm64
+
+const aesgcmsiv_kernel* armv8_kernel_probe(uint32_t)
+{
+    return nullptr;
+}
+
+#endif
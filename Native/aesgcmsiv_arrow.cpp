@@ -0,0 +1,293 @@
+#include "aesgcmsiv_arrow.h"
+#include <climits>
+#include <cstring>
+#include <new>
+#include <string>
+
+// The Arrow C Data Interface entry point behind
+// aesgcmsiv_arrow_encrypt_column. The input column is read where it lies,
+// and every buffer of the output is carved out of one aesgcmsiv_alloc
+// block, which the column kernel encrypts straight into.
+
+namespace {
+
+// Sections of the output block start on a cache line, as Arrow recommends
+constexpr size_t SECTION_ALIGN = 64;
+
+size_t align_section(size_t size)
+{
+    return (size + SECTION_ALIGN - 1) & ~(SECTION_ALIGN - 1);
+}
+
+// What an exported array owns. The children are released with the root, so
+// they have no private data of their own.
+struct exported_array {
+    void* block;
+    const void* buffers[3];
+    const void* child_buffers[2][3];
+    ArrowArray child_arrays[2];
+    ArrowArray* children[2];
+};
+
+struct exported_schema {
+    std::string name;
+    bool has_name;
+    ArrowSchema child_schemas[2];
+    ArrowSchema* children[2];
+};
+
+void release_child_array(ArrowArray* array)
+{
+    array->release = nullptr;
+}
+
+void release_child_schema(ArrowSchema* schema)
+{
+    schema->release = nullptr;
+}
+
+void release_array(ArrowArray* array)
+{
+    auto* owned = static_cast<exported_array*>(array->private_data);
+    for (int64_t i = 0; i < array->n_children; i++) {
+        if (array->children[i]->release) {
+            array->children[i]->release(array->children[i]);
+        }
+    }
+    aesgcmsiv_free(owned->block);
+    delete owned;
+    array->release = nullptr;
+}
+
+void release_schema(ArrowSchema* schema)
+{
+    auto* owned = static_cast<exported_schema*>(schema->private_data);
+    for (int64_t i = 0; i < schema->n_children; i++) {
+        if (schema->children[i]->release) {
+            schema->children[i]->release(schema->children[i]);
+        }
+    }
+    delete owned;
+    schema->release = nullptr;
+}
+
+// Bytes per offset of a binary or string format, or 0 for any other
+size_t offset_width(const char* format)
+{
+    if (!format || !format[0] || format[1]) {
+        return 0;
+    }
+    switch (format[0]) {
+    case 'z':
+    case 'u':
+        return 4;
+    case 'Z':
+    case 'U':
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+int64_t read_offset(const void* offsets, size_t width, size_t i)
+{
+    return width == 4
+        ? static_cast<const int32_t*>(offsets)[i]
+        : static_cast<const int64_t*>(offsets)[i];
+}
+
+void write_offset(void* offsets, size_t width, size_t i, int64_t offset)
+{
+    if (width == 4) {
+        static_cast<int32_t*>(offsets)[i] = static_cast<int32_t>(offset);
+    } else {
+        static_cast<int64_t*>(offsets)[i] = offset;
+    }
+}
+
+// Copies count validity bits, from bit first of src, to the start of dst,
+// which is zeroed
+void copy_validity(const uint8_t* src, uint64_t first, size_t count, uint8_t* dst)
+{
+    if (first % 8 == 0) {
+        memcpy(dst, src + first / 8, (count + 7) / 8);
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        const uint64_t bit = first + i;
+        if ((src[bit / 8] >> (bit % 8)) & 1) {
+            dst[i / 8] |= static_cast<uint8_t>(1u << (i % 8));
+        }
+    }
+}
+
+} // namespace
+
+int aesgcmsiv_arrow_encrypt_column(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* base_nonce,
+    uint64_t first_row,
+    const struct ArrowSchema* schema,
+    const struct ArrowArray* array,
+    uint32_t tag_layout,
+    struct ArrowSchema* schema_out,
+    struct ArrowArray* array_out)
+{
+    if (!ctx || !base_nonce || !schema || !array || !schema_out || !array_out ||
+        !schema->release || !array->release || tag_layout > AESGCMSIV_ARROW_TAGS_APPENDED) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    const size_t width = offset_width(schema->format);
+    if (width == 0 || array->length < 0 || array->offset < 0 || array->n_buffers != 3 || !array->buffers) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    const bool appended = tag_layout == AESGCMSIV_ARROW_TAGS_APPENDED;
+    const size_t count = static_cast<size_t>(array->length);
+    const uint8_t* values = static_cast<const uint8_t*>(array->buffers[2]);
+
+    // An empty array may come without an offsets buffer
+    static const int64_t no_offsets = 0;
+    const void* offsets = &no_offsets;
+    if (array->buffers[1]) {
+        offsets = static_cast<const uint8_t*>(array->buffers[1]) + static_cast<size_t>(array->offset) * width;
+    } else if (count > 0) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    const int64_t first = read_offset(offsets, width, 0);
+    int64_t last = first;
+    if (first < 0) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    for (size_t i = 1; i <= count; i++) {
+        const int64_t offset = read_offset(offsets, width, i);
+        if (offset < last) {
+            return AESGCMSIV_ERROR_INVALID_INPUT;
+        }
+        last = offset;
+    }
+    const uint64_t value_bytes = static_cast<uint64_t>(last - first);
+    if (value_bytes > 0 && !values) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    // Appended tags lengthen the column by 16 bytes a value, which its
+    // offsets must still reach
+    if (count > SIZE_MAX / 4 / AESGCMSIV_TAG_SIZE) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    const uint64_t offset_max = width == 4 ? INT32_MAX : INT64_MAX;
+    const uint64_t tag_bytes = static_cast<uint64_t>(count) * AESGCMSIV_TAG_SIZE;
+    if ((appended && value_bytes + tag_bytes > offset_max) || value_bytes + tag_bytes > SIZE_MAX / 2) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    const bool has_validity = array->null_count != 0 && array->buffers[0];
+    const size_t validity_size = has_validity ? (count + 7) / 8 : 0;
+    const size_t offsets_size = (count + 1) * width;
+    const size_t data_size = static_cast<size_t>(value_bytes + (appended ? tag_bytes : 0));
+    const size_t tags_size = appended ? 0 : static_cast<size_t>(tag_bytes);
+    const size_t validity_at = 0;
+    const size_t offsets_at = validity_at + align_section(validity_size);
+    const size_t data_at = offsets_at + align_section(offsets_size);
+    const size_t tags_at = data_at + align_section(data_size);
+
+    exported_array* owned = new (std::nothrow) exported_array();
+    exported_schema* owned_schema = new (std::nothrow) exported_schema();
+    uint8_t* block = static_cast<uint8_t*>(aesgcmsiv_alloc(tags_at + tags_size + 1, 0));
+    bool named = false;
+    if (owned_schema && schema->name) {
+        try {
+            owned_schema->name = schema->name;
+            named = true;
+        } catch (const std::bad_alloc&) {
+        }
+    }
+    if (!owned || !owned_schema || !block || (schema->name && !named)) {
+        aesgcmsiv_free(block);
+        delete owned_schema;
+        delete owned;
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    owned->block = block;
+    owned_schema->has_name = named;
+
+    uint8_t* validity = has_validity ? block + validity_at : nullptr;
+    void* offsets_out = block + offsets_at;
+    uint8_t* data = block + data_at;
+    uint8_t* tags = appended ? nullptr : block + tags_at;
+    if (has_validity) {
+        copy_validity(static_cast<const uint8_t*>(array->buffers[0]), static_cast<uint64_t>(array->offset),
+            count, validity);
+    }
+    for (size_t i = 0; i <= count; i++) {
+        write_offset(offsets_out, width, i,
+            read_offset(offsets, width, i) - first + (appended ? static_cast<int64_t>(i * AESGCMSIV_TAG_SIZE) : 0));
+    }
+
+    // A column of empty values may have no values buffer; any address does
+    const int result = aesgcmsiv_column_encrypt_packed(
+        ctx, base_nonce, first_row, count, values ? values : data, offsets, width, appended, data, tags);
+    if (result != AESGCMSIV_SUCCESS) {
+        aesgcmsiv_free(block);
+        delete owned_schema;
+        delete owned;
+        return result;
+    }
+
+    const int64_t null_count = has_validity ? array->null_count : 0;
+    const char* binary_format = width == 4 ? "z" : "Z";
+    const int64_t nullable = schema->flags & ARROW_FLAG_NULLABLE;
+
+    *array_out = ArrowArray{};
+    array_out->length = array->length;
+    array_out->null_count = null_count;
+    array_out->release = release_array;
+    array_out->private_data = owned;
+    *schema_out = ArrowSchema{};
+    schema_out->name = named ? owned_schema->name.c_str() : nullptr;
+    schema_out->flags = nullable;
+    schema_out->release = release_schema;
+    schema_out->private_data = owned_schema;
+
+    if (appended) {
+        owned->buffers[0] = validity;
+        owned->buffers[1] = offsets_out;
+        owned->buffers[2] = data;
+        array_out->n_buffers = 3;
+        array_out->buffers = owned->buffers;
+        schema_out->format = binary_format;
+        return AESGCMSIV_SUCCESS;
+    }
+
+    // A struct whose two children share its validity bitmap
+    owned->buffers[0] = validity;
+    owned->child_buffers[0][0] = validity;
+    owned->child_buffers[0][1] = offsets_out;
+    owned->child_buffers[0][2] = data;
+    owned->child_buffers[1][0] = validity;
+    owned->child_buffers[1][1] = tags;
+    for (int i = 0; i < 2; i++) {
+        ArrowArray& child = owned->child_arrays[i];
+        child.length = array->length;
+        child.null_count = null_count;
+        child.n_buffers = i == 0 ? 3 : 2;
+        child.buffers = owned->child_buffers[i];
+        child.release = release_child_array;
+        owned->children[i] = &child;
+
+        ArrowSchema& child_schema = owned_schema->child_schemas[i];
+        child_schema.format = i == 0 ? binary_format : "w:16";
+        child_schema.name = i == 0 ? "ciphertext" : "tag";
+        child_schema.flags = nullable;
+        child_schema.release = release_child_schema;
+        owned_schema->children[i] = &child_schema;
+    }
+    array_out->n_buffers = 1;
+    array_out->buffers = owned->buffers;
+    array_out->n_children = 2;
+    array_out->children = owned->children;
+    schema_out->format = "+s";
+    schema_out->n_children = 2;
+    schema_out->children = owned_schema->children;
+    return AESGCMSIV_SUCCESS;
+}
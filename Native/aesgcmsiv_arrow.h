@@ -0,0 +1,28 @@
+#ifndef AESGCMSIV_ARROW_H
+#define AESGCMSIV_ARROW_H
+
+// Internal interface between the Arrow C Data Interface entry points
+// (aesgcmsiv_arrow.cpp) and the column kernel behind
+// aesgcmsiv_encrypt_column. Nothing in this header is exported from the
+// library.
+
+#include "aesgcmsiv.h"
+
+// aesgcmsiv_encrypt_column into a packed output: value i is written at
+// offsets[i] - offsets[0] of values_out rather than offsets[i]. With
+// tags_appended each ciphertext is followed by its tag, so value i starts
+// i * AESGCMSIV_TAG_SIZE bytes further on and tags_out is not used.
+// Defined among the C entry points, so it has C linkage too.
+extern "C" int aesgcmsiv_column_encrypt_packed(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* base_nonce,
+    uint64_t first_row,
+    size_t count,
+    const uint8_t* values,
+    const void* offsets,
+    size_t offset_size,
+    bool tags_appended,
+    uint8_t* values_out,
+    uint8_t* tags_out);
+
+#endif
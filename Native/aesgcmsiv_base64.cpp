@@ -0,0 +1,196 @@
+#include "aesgcmsiv_base64.h"
+
+// Unpadded base64url for sealed tokens. The SSSE3 path moves 12 bytes to
+// 16 characters per step, after Muła and Lemire, "Faster Base64 Encoding
+// and Decoding using AVX2 Instructions"; SSE4.1 is the feature bit checked,
+// since every CPU with it has SSSE3. Other CPUs, and the last partial
+// block, use the tables below.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define AESGCMSIV_BASE64_SSSE3
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SSSE3_TARGET
+#else
+#define SSSE3_TARGET __attribute__((target("ssse3")))
+#endif
+#endif
+
+static const char encode_table[64 + 1] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+// 6-bit value of each character, or -1 outside the alphabet
+struct decode_table {
+    int8_t values[256];
+
+    constexpr decode_table() : values()
+    {
+        for (int i = 0; i < 256; i++) {
+            values[i] = -1;
+        }
+        for (int i = 0; i < 64; i++) {
+            values[static_cast<uint8_t>(encode_table[i])] = static_cast<int8_t>(i);
+        }
+    }
+};
+
+static constexpr decode_table decode_values;
+
+static inline int decode_char(char c)
+{
+    return decode_values.values[static_cast<uint8_t>(c)];
+}
+
+#ifdef AESGCMSIV_BASE64_SSSE3
+
+// Returns the number of bytes consumed, a multiple of 12. Each step loads
+// 16 bytes, so it stops while at least that much input is left.
+SSSE3_TARGET static size_t encode_ssse3(const uint8_t* src, size_t len, char* dst)
+{
+    // Each 32-bit lane gets one 3-byte group as b1 b0 b2 b1, so the
+    // multiplies can move all four 6-bit fields into their own bytes
+    const __m128i spread = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    // Offset to add to each 6-bit value, indexed by the class computed below
+    const __m128i offsets = _mm_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '-' - 62, '_' - 63, 'A', 0, 0);
+    size_t i = 0;
+    for (; len - i >= 16; i += 12) {
+        __m128i in = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), spread);
+        __m128i high = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+        __m128i low = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+        __m128i values = _mm_or_si128(high, low);
+
+        // 0 for a-z, 1-10 for digits, 11 and 12 for - and _, 13 for A-Z
+        __m128i index = _mm_subs_epu8(values, _mm_set1_epi8(51));
+        __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), values);
+        index = _mm_or_si128(index, _mm_and_si128(upper, _mm_set1_epi8(13)));
+        __m128i out = _mm_add_epi8(values, _mm_shuffle_epi8(offsets, index));
+        // Read before written: the 16 bytes loaded are already in registers
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i / 3 * 4), out);
+    }
+    return i;
+}
+
+// Returns the number of characters consumed, a multiple of 16, or SIZE_MAX
+// on a character outside the alphabet. Each step stores 16 bytes, so it
+// stops while fewer than 24 characters (18 bytes) are left.
+SSSE3_TARGET static size_t decode_ssse3(const char* src, size_t chars, uint8_t* dst)
+{
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    size_t i = 0;
+    for (; chars - i >= 24; i += 16) {
+        __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        // Bytes of 0x80 and up compare as negative, so fall in no range
+        __m128i upper = _mm_and_si128(
+            _mm_cmpgt_epi8(in, _mm_set1_epi8('A' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('Z' + 1), in));
+        __m128i lower = _mm_and_si128(
+            _mm_cmpgt_epi8(in, _mm_set1_epi8('a' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), in));
+        __m128i digit = _mm_and_si128(
+            _mm_cmpgt_epi8(in, _mm_set1_epi8('0' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), in));
+        __m128i dash = _mm_cmpeq_epi8(in, _mm_set1_epi8('-'));
+        __m128i underscore = _mm_cmpeq_epi8(in, _mm_set1_epi8('_'));
+        __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(_mm_or_si128(digit, dash), underscore));
+        if (_mm_movemask_epi8(valid) != 0xffff) {
+            return SIZE_MAX;
+        }
+
+        __m128i shift = _mm_or_si128(
+            _mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-'A')), _mm_and_si128(lower, _mm_set1_epi8(26 - 'a'))),
+            _mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(52 - '0')),
+                _mm_or_si128(_mm_and_si128(dash, _mm_set1_epi8(62 - '-')),
+                    _mm_and_si128(underscore, _mm_set1_epi8(63 - '_')))));
+        __m128i values = _mm_add_epi8(in, shift);
+
+        // Pairs of 6-bit values to 12 bits, then pairs of those to 24 bits
+        // per 32-bit lane, whose three bytes are gathered big-endian
+        __m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+        merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i / 4 * 3), _mm_shuffle_epi8(merged, pack));
+    }
+    return i;
+}
+
+#endif
+
+void aesgcmsiv_b64url_encode(uint32_t cpu_features, const uint8_t* src, size_t len, char* dst)
+{
+    size_t i = 0;
+#ifdef AESGCMSIV_BASE64_SSSE3
+    if (cpu_features & AESGCMSIV_CPU_SSE41) {
+        i = encode_ssse3(src, len, dst);
+    }
+#endif
+    (void)cpu_features;
+    char* out = dst + i / 3 * 4;
+    for (; len - i >= 3; i += 3) {
+        uint32_t group = static_cast<uint32_t>(src[i]) << 16 | static_cast<uint32_t>(src[i + 1]) << 8 | src[i + 2];
+        out[0] = encode_table[group >> 18];
+        out[1] = encode_table[(group >> 12) & 0x3f];
+        out[2] = encode_table[(group >> 6) & 0x3f];
+        out[3] = encode_table[group & 0x3f];
+        out += 4;
+    }
+    if (len - i == 1) {
+        uint32_t group = static_cast<uint32_t>(src[i]) << 16;
+        out[0] = encode_table[group >> 18];
+        out[1] = encode_table[(group >> 12) & 0x3f];
+    } else if (len - i == 2) {
+        uint32_t group = static_cast<uint32_t>(src[i]) << 16 | static_cast<uint32_t>(src[i + 1]) << 8;
+        out[0] = encode_table[group >> 18];
+        out[1] = encode_table[(group >> 12) & 0x3f];
+        out[2] = encode_table[(group >> 6) & 0x3f];
+    }
+}
+
+bool aesgcmsiv_b64url_decoded_len(size_t chars, size_t* len_out)
+{
+    if (chars % 4 == 1) {
+        return false;
+    }
+    *len_out = chars / 4 * 3 + (chars % 4 == 0 ? 0 : chars % 4 - 1);
+    return true;
+}
+
+bool aesgcmsiv_b64url_decode(uint32_t cpu_features, const char* src, size_t chars, uint8_t* dst)
+{
+    size_t i = 0;
+#ifdef AESGCMSIV_BASE64_SSSE3
+    if (cpu_features & AESGCMSIV_CPU_SSE41) {
+        i = decode_ssse3(src, chars, dst);
+        if (i == SIZE_MAX) {
+            return false;
+        }
+    }
+#endif
+    (void)cpu_features;
+    uint8_t* out = dst + i / 4 * 3;
+    for (; chars - i >= 4; i += 4) {
+        int a = decode_char(src[i]), b = decode_char(src[i + 1]);
+        int c = decode_char(src[i + 2]), d = decode_char(src[i + 3]);
+        if ((a | b | c | d) < 0) {
+            return false;
+        }
+        uint32_t group = static_cast<uint32_t>(a) << 18 | static_cast<uint32_t>(b) << 12 |
+            static_cast<uint32_t>(c) << 6 | static_cast<uint32_t>(d);
+        out[0] = static_cast<uint8_t>(group >> 16);
+        out[1] = static_cast<uint8_t>(group >> 8);
+        out[2] = static_cast<uint8_t>(group);
+        out += 3;
+    }
+    if (chars - i == 2) {
+        int a = decode_char(src[i]), b = decode_char(src[i + 1]);
+        if ((a | b) < 0 || (b & 0x0f) != 0) {
+            return false;
+        }
+        out[0] = static_cast<uint8_t>(a << 2 | b >> 4);
+    } else if (chars - i == 3) {
+        int a = decode_char(src[i]), b = decode_char(src[i + 1]), c = decode_char(src[i + 2]);
+        if ((a | b | c) < 0 || (c & 0x03) != 0) {
+            return false;
+        }
+        out[0] = static_cast<uint8_t>(a << 2 | b >> 4);
+        out[1] = static_cast<uint8_t>(b << 4 | c >> 2);
+    }
+    return true;
+}
@@ -0,0 +1,27 @@
+#ifndef AESGCMSIV_BASE64_H
+#define AESGCMSIV_BASE64_H
+
+// Internal unpadded base64url codec (RFC 4648, section 5) behind the token
+// functions (aesgcmsiv_ctx_seal_b64url). Nothing in this header is
+// exported from the library.
+
+#include "aesgcmsiv.h"
+
+// Encodes len bytes of src into AESGCMSIV_B64URL_LEN(len) characters at
+// dst, with no padding. Runs front to back, so dst may overlap src as long
+// as it starts at least len / 3 bytes before it. cpu_features are the
+// AESGCMSIV_CPU_* bits, which pick the vector path.
+void aesgcmsiv_b64url_encode(uint32_t cpu_features, const uint8_t* src, size_t len, char* dst);
+
+// The number of bytes chars characters of unpadded base64url decode to, or
+// false if no encoding has that length
+bool aesgcmsiv_b64url_decoded_len(size_t chars, size_t* len_out);
+
+// Decodes chars characters of src into dst. Returns false on a character
+// outside the base64url alphabet (padding included) or on nonzero unused
+// bits in the last character, so every byte string has exactly one
+// encoding. dst may hold partial output on failure. chars must have passed
+// aesgcmsiv_b64url_decoded_len.
+bool aesgcmsiv_b64url_decode(uint32_t cpu_features, const char* src, size_t chars, uint8_t* dst);
+
+#endif
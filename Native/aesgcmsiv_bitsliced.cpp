@@ -0,0 +1,603 @@
+#include "aesgcmsiv_kernels.h"
+#include "aesgcmsiv.h"
+#include <cstring>
+
+// Portable constant-time AES-GCM-SIV primitives for CPUs with no AES
+// instructions. AES is bitsliced after Käsper-Schwabe and BearSSL's ct64
+// code: eight blocks at a time, as two sets of four held in eight 64-bit
+// words each, with the Boyar-Peralta S-box circuit. POLYVAL multiplies with
+// integer multiplies masked so no carry reaches a used bit. Neither indexes
+// memory by secret data nor branches on it.
+//
+// Schedules stay in the standard byte layout every other kernel uses; each
+// call bitslices the round keys it needs.
+//
+// Configuring with -DAESGCMSIV_BITSLICED=OFF defines AESGCMSIV_NO_BITSLICED,
+// and such CPUs go through OpenSSL instead.
+
+#ifndef AESGCMSIV_NO_BITSLICED
+
+#define BITSLICED_BLOCKS 8
+
+static inline uint32_t load_le32(const uint8_t* p)
+{
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+           static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+static inline void store_le32(uint8_t* p, uint32_t v)
+{
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+    p[2] = static_cast<uint8_t>(v >> 16);
+    p[3] = static_cast<uint8_t>(v >> 24);
+}
+
+static inline uint64_t load_le64(const uint8_t* p)
+{
+    return static_cast<uint64_t>(load_le32(p)) | static_cast<uint64_t>(load_le32(p + 4)) << 32;
+}
+
+static inline void store_le64(uint8_t* p, uint64_t v)
+{
+    store_le32(p, static_cast<uint32_t>(v));
+    store_le32(p + 4, static_cast<uint32_t>(v >> 32));
+}
+
+// ---------------------------------------------------------------------------
+// AES
+// ---------------------------------------------------------------------------
+
+// Boyar and Peralta's 113-gate S-box circuit on eight bit planes; q[0] holds
+// the low bit of every byte.
+static void bitslice_sbox(uint64_t* q)
+{
+    const uint64_t x0 = q[7], x1 = q[6], x2 = q[5], x3 = q[4];
+    const uint64_t x4 = q[3], x5 = q[2], x6 = q[1], x7 = q[0];
+
+    // Top linear transformation
+    const uint64_t y14 = x3 ^ x5;
+    const uint64_t y13 = x0 ^ x6;
+    const uint64_t y9 = x0 ^ x3;
+    const uint64_t y8 = x0 ^ x5;
+    const uint64_t t0 = x1 ^ x2;
+    const uint64_t y1 = t0 ^ x7;
+    const uint64_t y4 = y1 ^ x3;
+    const uint64_t y12 = y13 ^ y14;
+    const uint64_t y2 = y1 ^ x0;
+    const uint64_t y5 = y1 ^ x6;
+    const uint64_t y3 = y5 ^ y8;
+    const uint64_t t1 = x4 ^ y12;
+    const uint64_t y15 = t1 ^ x5;
+    const uint64_t y20 = t1 ^ x1;
+    const uint64_t y6 = y15 ^ x7;
+    const uint64_t y10 = y15 ^ t0;
+    const uint64_t y11 = y20 ^ y9;
+    const uint64_t y7 = x7 ^ y11;
+    const uint64_t y17 = y10 ^ y11;
+    const uint64_t y19 = y10 ^ y8;
+    const uint64_t y16 = t0 ^ y11;
+    const uint64_t y21 = y13 ^ y16;
+    const uint64_t y18 = x0 ^ y16;
+
+    // Non-linear section
+    const uint64_t t2 = y12 & y15;
+    const uint64_t t3 = y3 & y6;
+    const uint64_t t4 = t3 ^ t2;
+    const uint64_t t5 = y4 & x7;
+    const uint64_t t6 = t5 ^ t2;
+    const uint64_t t7 = y13 & y16;
+    const uint64_t t8 = y5 & y1;
+    const uint64_t t9 = t8 ^ t7;
+    const uint64_t t10 = y2 & y7;
+    const uint64_t t11 = t10 ^ t7;
+    const uint64_t t12 = y9 & y11;
+    const uint64_t t13 = y14 & y17;
+    const uint64_t t14 = t13 ^ t12;
+    const uint64_t t15 = y8 & y10;
+    const uint64_t t16 = t15 ^ t12;
+    const uint64_t t17 = t4 ^ t14;
+    const uint64_t t18 = t6 ^ t16;
+    const uint64_t t19 = t9 ^ t14;
+    const uint64_t t20 = t11 ^ t16;
+    const uint64_t t21 = t17 ^ y20;
+    const uint64_t t22 = t18 ^ y19;
+    const uint64_t t23 = t19 ^ y21;
+    const uint64_t t24 = t20 ^ y18;
+
+    const uint64_t t25 = t21 ^ t22;
+    const uint64_t t26 = t21 & t23;
+    const uint64_t t27 = t24 ^ t26;
+    const uint64_t t28 = t25 & t27;
+    const uint64_t t29 = t28 ^ t22;
+    const uint64_t t30 = t23 ^ t24;
+    const uint64_t t31 = t22 ^ t26;
+    const uint64_t t32 = t31 & t30;
+    const uint64_t t33 = t32 ^ t24;
+    const uint64_t t34 = t23 ^ t33;
+    const uint64_t t35 = t27 ^ t33;
+    const uint64_t t36 = t24 & t35;
+    const uint64_t t37 = t36 ^ t34;
+    const uint64_t t38 = t27 ^ t36;
+    const uint64_t t39 = t29 & t38;
+    const uint64_t t40 = t25 ^ t39;
+
+    const uint64_t t41 = t40 ^ t37;
+    const uint64_t t42 = t29 ^ t33;
+    const uint64_t t43 = t29 ^ t40;
+    const uint64_t t44 = t33 ^ t37;
+    const uint64_t t45 = t42 ^ t41;
+    const uint64_t z0 = t44 & y15;
+    const uint64_t z1 = t37 & y6;
+    const uint64_t z2 = t33 & x7;
+    const uint64_t z3 = t43 & y16;
+    const uint64_t z4 = t40 & y1;
+    const uint64_t z5 = t29 & y7;
+    const uint64_t z6 = t42 & y11;
+    const uint64_t z7 = t45 & y17;
+    const uint64_t z8 = t41 & y10;
+    const uint64_t z9 = t44 & y12;
+    const uint64_t z10 = t37 & y3;
+    const uint64_t z11 = t33 & y4;
+    const uint64_t z12 = t43 & y13;
+    const uint64_t z13 = t40 & y5;
+    const uint64_t z14 = t29 & y2;
+    const uint64_t z15 = t42 & y9;
+    const uint64_t z16 = t45 & y14;
+    const uint64_t z17 = t41 & y8;
+
+    // Bottom linear transformation
+    const uint64_t t46 = z15 ^ z16;
+    const uint64_t t47 = z10 ^ z11;
+    const uint64_t t48 = z5 ^ z13;
+    const uint64_t t49 = z9 ^ z10;
+    const uint64_t t50 = z2 ^ z12;
+    const uint64_t t51 = z2 ^ z5;
+    const uint64_t t52 = z7 ^ z8;
+    const uint64_t t53 = z0 ^ z3;
+    const uint64_t t54 = z6 ^ z7;
+    const uint64_t t55 = z16 ^ z17;
+    const uint64_t t56 = z12 ^ t48;
+    const uint64_t t57 = t50 ^ t53;
+    const uint64_t t58 = z4 ^ t46;
+    const uint64_t t59 = z3 ^ t54;
+    const uint64_t t60 = t46 ^ t57;
+    const uint64_t t61 = z14 ^ t57;
+    const uint64_t t62 = t52 ^ t58;
+    const uint64_t t63 = t49 ^ t58;
+    const uint64_t t64 = z4 ^ t59;
+    const uint64_t t65 = t61 ^ t62;
+    const uint64_t t66 = z1 ^ t63;
+    const uint64_t s0 = t59 ^ t63;
+    const uint64_t s6 = t56 ^ ~t62;
+    const uint64_t s7 = t48 ^ ~t60;
+    const uint64_t t67 = t64 ^ t65;
+    const uint64_t s3 = t53 ^ t66;
+    const uint64_t s4 = t51 ^ t66;
+    const uint64_t s5 = t47 ^ t65;
+    const uint64_t s1 = t64 ^ ~s3;
+    const uint64_t s2 = t55 ^ ~t67;
+
+    q[7] = s0;
+    q[6] = s1;
+    q[5] = s2;
+    q[4] = s3;
+    q[3] = s4;
+    q[2] = s5;
+    q[1] = s6;
+    q[0] = s7;
+}
+
+static inline void swap_bits(uint64_t* x, uint64_t* y, uint64_t low, int shift)
+{
+    const uint64_t a = *x, b = *y;
+    *x = (a & low) | ((b & low) << shift);
+    *y = ((a >> shift) & low) | (b & ~low);
+}
+
+// Transposes between four interleaved blocks per word and one bit plane per
+// word; its own inverse.
+static void ortho(uint64_t* q)
+{
+    const uint64_t m1 = 0x5555555555555555ULL;
+    const uint64_t m2 = 0x3333333333333333ULL;
+    const uint64_t m4 = 0x0F0F0F0F0F0F0F0FULL;
+    swap_bits(&q[0], &q[1], m1, 1);
+    swap_bits(&q[2], &q[3], m1, 1);
+    swap_bits(&q[4], &q[5], m1, 1);
+    swap_bits(&q[6], &q[7], m1, 1);
+    swap_bits(&q[0], &q[2], m2, 2);
+    swap_bits(&q[1], &q[3], m2, 2);
+    swap_bits(&q[4], &q[6], m2, 2);
+    swap_bits(&q[5], &q[7], m2, 2);
+    swap_bits(&q[0], &q[4], m4, 4);
+    swap_bits(&q[1], &q[5], m4, 4);
+    swap_bits(&q[2], &q[6], m4, 4);
+    swap_bits(&q[3], &q[7], m4, 4);
+}
+
+// Spreads one block, as four little-endian words, over two 64-bit words
+static inline void interleave_in(uint64_t* q0, uint64_t* q1, const uint32_t* w)
+{
+    uint64_t x[4];
+    for (int i = 0; i < 4; i++) {
+        x[i] = w[i];
+        x[i] = (x[i] | (x[i] << 16)) & 0x0000FFFF0000FFFFULL;
+        x[i] = (x[i] | (x[i] << 8)) & 0x00FF00FF00FF00FFULL;
+    }
+    *q0 = x[0] | (x[2] << 8);
+    *q1 = x[1] | (x[3] << 8);
+}
+
+static inline void interleave_out(uint32_t* w, uint64_t q0, uint64_t q1)
+{
+    uint64_t x[4];
+    x[0] = q0 & 0x00FF00FF00FF00FFULL;
+    x[1] = q1 & 0x00FF00FF00FF00FFULL;
+    x[2] = (q0 >> 8) & 0x00FF00FF00FF00FFULL;
+    x[3] = (q1 >> 8) & 0x00FF00FF00FF00FFULL;
+    for (int i = 0; i < 4; i++) {
+        x[i] = (x[i] | (x[i] >> 8)) & 0x0000FFFF0000FFFFULL;
+        w[i] = static_cast<uint32_t>(x[i]) | static_cast<uint32_t>(x[i] >> 16);
+    }
+}
+
+// Round keys bitsliced to match a block set: eight words per round
+struct bitsliced_schedule {
+    uint64_t sk[8 * (AESGCMSIV_MAX_ROUNDS + 1)];
+    int rounds;
+};
+
+static void bitslice_schedule(const aes_key_schedule* ks, bitsliced_schedule* bs)
+{
+    for (int r = 0; r <= ks->rounds; r++) {
+        uint32_t w[4];
+        for (int i = 0; i < 4; i++) {
+            w[i] = load_le32(ks->round_keys[r] + 4 * i);
+        }
+        // The same key in all four block positions
+        uint64_t q[8];
+        interleave_in(&q[0], &q[4], w);
+        q[1] = q[2] = q[3] = q[0];
+        q[5] = q[6] = q[7] = q[4];
+        ortho(q);
+        memcpy(bs->sk + 8 * r, q, sizeof(q));
+        aesgcmsiv_secure_zero(q, sizeof(q));
+        aesgcmsiv_secure_zero(w, sizeof(w));
+    }
+    bs->rounds = ks->rounds;
+}
+
+static inline void add_round_key(uint64_t* q, const uint64_t* sk)
+{
+    for (int i = 0; i < 8; i++) {
+        q[i] ^= sk[i];
+    }
+}
+
+static inline void shift_rows(uint64_t* q)
+{
+    for (int i = 0; i < 8; i++) {
+        const uint64_t x = q[i];
+        q[i] = (x & 0x000000000000FFFFULL) |
+               ((x & 0x00000000FFF00000ULL) >> 4) | ((x & 0x00000000000F0000ULL) << 12) |
+               ((x & 0x0000FF0000000000ULL) >> 8) | ((x & 0x000000FF00000000ULL) << 8) |
+               ((x & 0xF000000000000000ULL) >> 12) | ((x & 0x0FFF000000000000ULL) << 4);
+    }
+}
+
+static inline uint64_t rotr32(uint64_t x)
+{
+    return (x << 32) | (x >> 32);
+}
+
+static inline void mix_columns(uint64_t* q)
+{
+    uint64_t r[8];
+    for (int i = 0; i < 8; i++) {
+        r[i] = (q[i] >> 16) | (q[i] << 48);
+    }
+    const uint64_t q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+    const uint64_t q4 = q[4], q5 = q[5], q6 = q[6], q7 = q[7];
+    q[0] = q7 ^ r[7] ^ r[0] ^ rotr32(q0 ^ r[0]);
+    q[1] = q0 ^ r[0] ^ q7 ^ r[7] ^ r[1] ^ rotr32(q1 ^ r[1]);
+    q[2] = q1 ^ r[1] ^ r[2] ^ rotr32(q2 ^ r[2]);
+    q[3] = q2 ^ r[2] ^ q7 ^ r[7] ^ r[3] ^ rotr32(q3 ^ r[3]);
+    q[4] = q3 ^ r[3] ^ q7 ^ r[7] ^ r[4] ^ rotr32(q4 ^ r[4]);
+    q[5] = q4 ^ r[4] ^ r[5] ^ rotr32(q5 ^ r[5]);
+    q[6] = q5 ^ r[5] ^ r[6] ^ rotr32(q6 ^ r[6]);
+    q[7] = q6 ^ r[6] ^ r[7] ^ rotr32(q7 ^ r[7]);
+}
+
+// Encrypts eight blocks, given as 32 little-endian words, in place. Both
+// sets of four go through each round together.
+static void aes_encrypt_x8(const bitsliced_schedule* bs, uint32_t* w)
+{
+    uint64_t q[2][8];
+    for (int set = 0; set < 2; set++) {
+        for (int i = 0; i < 4; i++) {
+            interleave_in(&q[set][i], &q[set][i + 4], w + 16 * set + 4 * i);
+        }
+        ortho(q[set]);
+        add_round_key(q[set], bs->sk);
+    }
+    for (int r = 1; r < bs->rounds; r++) {
+        for (int set = 0; set < 2; set++) {
+            bitslice_sbox(q[set]);
+            shift_rows(q[set]);
+            mix_columns(q[set]);
+            add_round_key(q[set], bs->sk + 8 * r);
+        }
+    }
+    for (int set = 0; set < 2; set++) {
+        bitslice_sbox(q[set]);
+        shift_rows(q[set]);
+        add_round_key(q[set], bs->sk + 8 * bs->rounds);
+        ortho(q[set]);
+        for (int i = 0; i < 4; i++) {
+            interleave_out(w + 16 * set + 4 * i, q[set][i], q[set][i + 4]);
+        }
+    }
+    aesgcmsiv_secure_zero(q, sizeof(q));
+}
+
+// SubWord through the bitsliced S-box, so key expansion is constant time too
+static uint32_t sub_word(uint32_t x)
+{
+    uint64_t q[8] = {x};
+    ortho(q);
+    bitslice_sbox(q);
+    ortho(q);
+    const uint32_t result = static_cast<uint32_t>(q[0]);
+    aesgcmsiv_secure_zero(q, sizeof(q));
+    return result;
+}
+
+static void bitsliced_expand_key(const uint8_t* key, size_t key_len, aes_key_schedule* ks)
+{
+    static const uint8_t rcon[10] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36};
+    const int nk = static_cast<int>(key_len / 4);
+    const int rounds = nk + 6;
+    const int words = 4 * (rounds + 1);
+    uint32_t w[4 * (AESGCMSIV_MAX_ROUNDS + 1)];
+    for (int i = 0; i < nk; i++) {
+        w[i] = load_le32(key + 4 * i);
+    }
+    for (int i = nk; i < words; i++) {
+        uint32_t t = w[i - 1];
+        if (i % nk == 0) {
+            // RotWord on little-endian words, then SubWord and Rcon
+            t = sub_word((t >> 8) | (t << 24)) ^ rcon[i / nk - 1];
+        } else if (nk == 8 && i % 8 == 4) {
+            t = sub_word(t);
+        }
+        w[i] = w[i - nk] ^ t;
+    }
+    for (int i = 0; i < words; i++) {
+        store_le32(ks->round_keys[i / 4] + 4 * (i % 4), w[i]);
+    }
+    ks->rounds = rounds;
+    aesgcmsiv_secure_zero(w, sizeof(w));
+}
+
+static void bitsliced_derive_keys(
+    const aes_key_schedule* ks, const uint8_t* nonce,
+    uint8_t* auth_key, aes_key_schedule* enc_ks)
+{
+    bitsliced_schedule bs;
+    bitslice_schedule(ks, &bs);
+
+    // Block i is LE32(i) || nonce; AES-128 needs four, AES-256 six, and
+    // both fit one pass
+    uint32_t w[4 * BITSLICED_BLOCKS];
+    for (int i = 0; i < BITSLICED_BLOCKS; i++) {
+        w[4 * i] = static_cast<uint32_t>(i);
+        for (int j = 1; j < 4; j++) {
+            w[4 * i + j] = load_le32(nonce + 4 * (j - 1));
+        }
+    }
+    aes_encrypt_x8(&bs, w);
+    const int enc_blocks = ks->rounds == 10 ? 2 : 4;
+
+    // Only the first 8 bytes of each output block are used
+    uint8_t enc_key[32];
+    for (int i = 0; i < 2; i++) {
+        store_le32(auth_key + 8 * i, w[4 * i]);
+        store_le32(auth_key + 8 * i + 4, w[4 * i + 1]);
+    }
+    for (int i = 0; i < enc_blocks; i++) {
+        store_le32(enc_key + 8 * i, w[4 * (2 + i)]);
+        store_le32(enc_key + 8 * i + 4, w[4 * (2 + i) + 1]);
+    }
+    bitsliced_expand_key(enc_key, 8 * static_cast<size_t>(enc_blocks), enc_ks);
+
+    aesgcmsiv_secure_zero(enc_key, sizeof(enc_key));
+    aesgcmsiv_secure_zero(w, sizeof(w));
+    aesgcmsiv_secure_zero(&bs, sizeof(bs));
+}
+
+static void bitsliced_encrypt_block(const aes_key_schedule* ks, const uint8_t* in, uint8_t* out)
+{
+    bitsliced_schedule bs;
+    bitslice_schedule(ks, &bs);
+    uint32_t w[4 * BITSLICED_BLOCKS] = {0};
+    for (int i = 0; i < 4; i++) {
+        w[i] = load_le32(in + 4 * i);
+    }
+    aes_encrypt_x8(&bs, w);
+    for (int i = 0; i < 4; i++) {
+        store_le32(out + 4 * i, w[i]);
+    }
+    aesgcmsiv_secure_zero(w, sizeof(w));
+    aesgcmsiv_secure_zero(&bs, sizeof(bs));
+}
+
+// ---------------------------------------------------------------------------
+// POLYVAL
+// ---------------------------------------------------------------------------
+
+// Low 64 bits of the carry-less product. Each operand is split into four
+// words with every fourth bit kept, so the integer products add at most 15
+// terms into any used bit position and no carry crosses into the next one.
+static inline uint64_t bmul64(uint64_t x, uint64_t y)
+{
+    const uint64_t m0 = 0x1111111111111111ULL;
+    const uint64_t m1 = 0x2222222222222222ULL;
+    const uint64_t m2 = 0x4444444444444444ULL;
+    const uint64_t m3 = 0x8888888888888888ULL;
+    const uint64_t x0 = x & m0, x1 = x & m1, x2 = x & m2, x3 = x & m3;
+    const uint64_t y0 = y & m0, y1 = y & m1, y2 = y & m2, y3 = y & m3;
+    const uint64_t z0 = (x0 * y0) ^ (x1 * y3) ^ (x2 * y2) ^ (x3 * y1);
+    const uint64_t z1 = (x0 * y1) ^ (x1 * y0) ^ (x2 * y3) ^ (x3 * y2);
+    const uint64_t z2 = (x0 * y2) ^ (x1 * y1) ^ (x2 * y0) ^ (x3 * y3);
+    const uint64_t z3 = (x0 * y3) ^ (x1 * y2) ^ (x2 * y1) ^ (x3 * y0);
+    return (z0 & m0) | (z1 & m1) | (z2 & m2) | (z3 & m3);
+}
+
+static inline uint64_t rev64(uint64_t x)
+{
+    x = ((x & 0x5555555555555555ULL) << 1) | ((x >> 1) & 0x5555555555555555ULL);
+    x = ((x & 0x3333333333333333ULL) << 2) | ((x >> 2) & 0x3333333333333333ULL);
+    x = ((x & 0x0F0F0F0F0F0F0F0FULL) << 4) | ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL);
+    x = ((x & 0x00FF00FF00FF00FFULL) << 8) | ((x >> 8) & 0x00FF00FF00FF00FFULL);
+    x = ((x & 0x0000FFFF0000FFFFULL) << 16) | ((x >> 16) & 0x0000FFFF0000FFFFULL);
+    return (x << 32) | (x >> 32);
+}
+
+// a * b * x^-128 modulo x^128 + x^127 + x^126 + x^121 + 1, elements as
+// (low, high) little-endian halves
+static inline void gf_mul(uint64_t* a, const uint64_t* b)
+{
+    // Karatsuba; the high half of each 64x64 product is the low half of the
+    // product of the bit-reversed operands, reversed
+    const uint64_t a0 = a[0], a1 = a[1], a2 = a0 ^ a1;
+    const uint64_t b0 = b[0], b1 = b[1], b2 = b0 ^ b1;
+    const uint64_t a0r = rev64(a0), a1r = rev64(a1), a2r = a0r ^ a1r;
+    const uint64_t b0r = rev64(b0), b1r = rev64(b1), b2r = b0r ^ b1r;
+    const uint64_t z0 = bmul64(a0, b0);
+    const uint64_t z1 = bmul64(a1, b1);
+    uint64_t z2 = bmul64(a2, b2);
+    uint64_t z0h = bmul64(a0r, b0r);
+    uint64_t z1h = bmul64(a1r, b1r);
+    uint64_t z2h = bmul64(a2r, b2r);
+    z2 ^= z0 ^ z1;
+    z2h ^= z0h ^ z1h;
+    z0h = rev64(z0h) >> 1;
+    z1h = rev64(z1h) >> 1;
+    z2h = rev64(z2h) >> 1;
+    uint64_t v0 = z0;
+    uint64_t v1 = z0h ^ z2;
+    uint64_t v2 = z1 ^ z2h;
+    uint64_t v3 = z1h;
+
+    // Montgomery reduction, 64 bits at a time: adding v0 times the modulus
+    // clears the low word, and dividing by x^64 leaves v0 * (x^57 + x^62 +
+    // x^63 + x^64) added to the upper words
+    v1 ^= (v0 << 57) ^ (v0 << 62) ^ (v0 << 63);
+    v2 ^= v0 ^ (v0 >> 7) ^ (v0 >> 2) ^ (v0 >> 1);
+    v2 ^= (v1 << 57) ^ (v1 << 62) ^ (v1 << 63);
+    v3 ^= v1 ^ (v1 >> 7) ^ (v1 >> 2) ^ (v1 >> 1);
+    a[0] = v2;
+    a[1] = v3;
+}
+
+static void bitsliced_polyval_init(polyval_state* pv, const uint8_t* h, size_t)
+{
+    memcpy(pv->h[0], h, 16);
+    memset(pv->s, 0, sizeof(pv->s));
+}
+
+static void bitsliced_polyval_blocks(polyval_state* pv, const uint8_t* data, size_t blocks)
+{
+    const uint64_t h[2] = {load_le64(pv->h[0]), load_le64(pv->h[0] + 8)};
+    uint64_t s[2] = {load_le64(pv->s), load_le64(pv->s + 8)};
+    while (blocks > 0) {
+        s[0] ^= load_le64(data);
+        s[1] ^= load_le64(data + 8);
+        gf_mul(s, h);
+        data += 16;
+        blocks--;
+    }
+    store_le64(pv->s, s[0]);
+    store_le64(pv->s + 8, s[1]);
+}
+
+// ---------------------------------------------------------------------------
+// CTR
+// ---------------------------------------------------------------------------
+
+static void bitsliced_ctr32(
+    const aes_key_schedule* ks, const uint8_t* counter,
+    const uint8_t* in, uint8_t* out, size_t len)
+{
+    bitsliced_schedule bs;
+    bitslice_schedule(ks, &bs);
+    uint32_t ctr[4];
+    for (int i = 0; i < 4; i++) {
+        ctr[i] = load_le32(counter + 4 * i);
+    }
+
+    uint32_t w[4 * BITSLICED_BLOCKS];
+    uint8_t keystream[16 * BITSLICED_BLOCKS];
+    while (len > 0) {
+        for (int i = 0; i < BITSLICED_BLOCKS; i++) {
+            w[4 * i] = ctr[0] + static_cast<uint32_t>(i);
+            w[4 * i + 1] = ctr[1];
+            w[4 * i + 2] = ctr[2];
+            w[4 * i + 3] = ctr[3];
+        }
+        aes_encrypt_x8(&bs, w);
+        for (int i = 0; i < 4 * BITSLICED_BLOCKS; i++) {
+            store_le32(keystream + 4 * i, w[i]);
+        }
+        const size_t n = len < sizeof(keystream) ? len : sizeof(keystream);
+        for (size_t i = 0; i < n; i++) {
+            out[i] = in[i] ^ keystream[i];
+        }
+        ctr[0] += BITSLICED_BLOCKS;
+        in += n;
+        out += n;
+        len -= n;
+    }
+    aesgcmsiv_secure_zero(keystream, sizeof(keystream));
+    aesgcmsiv_secure_zero(w, sizeof(w));
+    aesgcmsiv_secure_zero(&bs, sizeof(bs));
+}
+
+static const aesgcmsiv_kernel bitsliced_kernel = {
+    "bitsliced-ct64",
+    bitsliced_expand_key,
+    bitsliced_derive_keys,
+    bitsliced_encrypt_block,
+    bitsliced_polyval_init,
+    bitsliced_polyval_blocks,
+    bitsliced_ctr32,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    // Each item takes long enough to hide a miss on the next one
+    1,
+    // Plain 64-bit registers
+    64,
+    0,
+};
+
+const aesgcmsiv_kernel* bitsliced_kernel_probe(uint32_t)
+{
+    return &bitsliced_kernel;
+}
+
+#else // AESGCMSIV_NO_BITSLICED
+
+const aesgcmsiv_kernel* bitsliced_kernel_probe(uint32_t)
+{
+    return nullptr;
+}
+
+#endif
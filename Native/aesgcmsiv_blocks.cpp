@@ -0,0 +1,237 @@
+// Per-thread free lists behind aesgcmsiv_block_alloc, and the counters
+// behind aesgcmsiv_get_alloc_stats.
+//
+// Each thread keeps one singly linked list per power-of-two size class,
+// threaded through the free blocks themselves, so taking or returning a
+// block is a couple of plain loads and stores with no lock. The lists and
+// counters live in a cache-line-aligned block owned by the thread and
+// registered, as the statistics blocks are, so readers can sum them; a
+// thread's lists go back to the heap and its counters to the registry when
+// it exits.
+
+#include "aesgcmsiv_blocks.h"
+#include <atomic>
+#include <mutex>
+
+namespace {
+
+constexpr unsigned int kMinShift = 6;  // 64-byte blocks
+constexpr unsigned int kClasses = 15;  // up to AESGCMSIV_BLOCK_MAX_CACHED
+static_assert((size_t(1) << (kMinShift + kClasses - 1)) == AESGCMSIV_BLOCK_MAX_CACHED,
+    "size classes must end at AESGCMSIV_BLOCK_MAX_CACHED");
+
+// Bytes each class's list may hold, but never fewer than two blocks
+constexpr size_t kListBytes = size_t(256) << 10;
+
+// Counter fields, in aesgcmsiv_alloc_stats order
+enum { kAllocs, kCacheHits, kHeapAllocs, kHeapFrees, kInUse, kCached, kCounters };
+
+struct alignas(64) ThreadBlocks {
+    void* lists[kClasses];
+    unsigned int lengths[kClasses];
+    // Written only by the owner; kInUse wraps when blocks move between
+    // threads, but the sum over threads is exact
+    std::atomic<uint64_t> counters[kCounters];
+    ThreadBlocks* prev;
+    ThreadBlocks* next;
+};
+
+struct Registry {
+    std::mutex mutex;
+    ThreadBlocks* head = nullptr;
+    uint64_t threads = 0;
+    uint64_t retired[kCounters] = {};  // from threads that have exited
+};
+
+// Never freed, since threads can still exit while static objects are being
+// destroyed
+Registry& registry()
+{
+    static Registry* instance = new Registry();
+    return *instance;
+}
+
+unsigned int size_class(size_t size)
+{
+    unsigned int index = 0;
+    while ((size_t(1) << (kMinShift + index)) < size) {
+        index++;
+    }
+    return index;
+}
+
+size_t class_size(unsigned int index)
+{
+    return size_t(1) << (kMinShift + index);
+}
+
+size_t list_limit(unsigned int index)
+{
+    const size_t limit = kListBytes / class_size(index);
+    return limit < 2 ? 2 : limit;
+}
+
+inline void bump(std::atomic<uint64_t>& counter, uint64_t amount)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+class ThreadSlot {
+public:
+    ThreadSlot() = default;
+    ThreadSlot(const ThreadSlot&) = delete;
+    ThreadSlot& operator=(const ThreadSlot&) = delete;
+
+    ~ThreadSlot()
+    {
+        exited_ = true;
+        if (!blocks_) {
+            return;
+        }
+        for (unsigned int i = 0; i < kClasses; i++) {
+            while (void* block = blocks_->lists[i]) {
+                blocks_->lists[i] = *static_cast<void**>(block);
+                ::operator delete(block);
+                bump(blocks_->counters[kHeapFrees], 1);
+                bump(blocks_->counters[kCached], 0 - class_size(i));
+            }
+        }
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for (size_t i = 0; i < kCounters; i++) {
+            reg.retired[i] += blocks_->counters[i].load(std::memory_order_relaxed);
+        }
+        (blocks_->prev ? blocks_->prev->next : reg.head) = blocks_->next;
+        if (blocks_->next) {
+            blocks_->next->prev = blocks_->prev;
+        }
+        reg.threads--;
+        delete blocks_;
+        blocks_ = nullptr;
+    }
+
+    // NULL if the lists could not be allocated, or the thread is exiting;
+    // blocks then come from the heap uncounted
+    ThreadBlocks* get()
+    {
+        if (!blocks_ && !exited_) {
+            blocks_ = new (std::nothrow) ThreadBlocks();
+            if (blocks_) {
+                Registry& reg = registry();
+                std::lock_guard<std::mutex> lock(reg.mutex);
+                blocks_->prev = nullptr;
+                blocks_->next = reg.head;
+                if (reg.head) {
+                    reg.head->prev = blocks_;
+                }
+                reg.head = blocks_;
+                reg.threads++;
+            }
+        }
+        return blocks_;
+    }
+
+private:
+    ThreadBlocks* blocks_ = nullptr;
+    bool exited_ = false;
+};
+
+thread_local ThreadSlot t_blocks;
+
+} // namespace
+
+void* aesgcmsiv_block_alloc(size_t size)
+{
+    if (size > AESGCMSIV_BLOCK_MAX_CACHED) {
+        ThreadBlocks* blocks = t_blocks.get();
+        void* data = ::operator new(size, std::nothrow);
+        if (blocks && data) {
+            bump(blocks->counters[kAllocs], 1);
+            bump(blocks->counters[kHeapAllocs], 1);
+            bump(blocks->counters[kInUse], size);
+        }
+        return data;
+    }
+
+    const unsigned int index = size_class(size);
+    const size_t bytes = class_size(index);
+    ThreadBlocks* blocks = t_blocks.get();
+    if (!blocks) {
+        return ::operator new(bytes, std::nothrow);
+    }
+    void* data = blocks->lists[index];
+    if (data) {
+        blocks->lists[index] = *static_cast<void**>(data);
+        blocks->lengths[index]--;
+        bump(blocks->counters[kCacheHits], 1);
+        bump(blocks->counters[kCached], 0 - bytes);
+    } else {
+        data = ::operator new(bytes, std::nothrow);
+        if (!data) {
+            return nullptr;
+        }
+        bump(blocks->counters[kHeapAllocs], 1);
+    }
+    bump(blocks->counters[kAllocs], 1);
+    bump(blocks->counters[kInUse], bytes);
+    return data;
+}
+
+void aesgcmsiv_block_free(void* data, size_t size)
+{
+    if (!data) {
+        return;
+    }
+    ThreadBlocks* blocks = t_blocks.get();
+    const bool cached = size <= AESGCMSIV_BLOCK_MAX_CACHED;
+    const unsigned int index = cached ? size_class(size) : 0;
+    const size_t bytes = cached ? class_size(index) : size;
+    if (blocks) {
+        bump(blocks->counters[kInUse], 0 - bytes);
+    }
+    if (!blocks || !cached || blocks->lengths[index] >= list_limit(index)) {
+        ::operator delete(data);
+        if (blocks) {
+            bump(blocks->counters[kHeapFrees], 1);
+        }
+        return;
+    }
+    *static_cast<void**>(data) = blocks->lists[index];
+    blocks->lists[index] = data;
+    blocks->lengths[index]++;
+    bump(blocks->counters[kCached], bytes);
+}
+
+extern "C" {
+
+int aesgcmsiv_get_alloc_stats(aesgcmsiv_alloc_stats* stats_out)
+{
+    if (!stats_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    uint64_t totals[kCounters];
+    uint64_t threads;
+    {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for (size_t i = 0; i < kCounters; i++) {
+            totals[i] = reg.retired[i];
+        }
+        for (ThreadBlocks* blocks = reg.head; blocks; blocks = blocks->next) {
+            for (size_t i = 0; i < kCounters; i++) {
+                totals[i] += blocks->counters[i].load(std::memory_order_relaxed);
+            }
+        }
+        threads = reg.threads;
+    }
+    stats_out->allocs = totals[kAllocs];
+    stats_out->cache_hits = totals[kCacheHits];
+    stats_out->heap_allocs = totals[kHeapAllocs];
+    stats_out->heap_frees = totals[kHeapFrees];
+    stats_out->bytes_in_use = totals[kInUse];
+    stats_out->bytes_cached = totals[kCached];
+    stats_out->threads = threads;
+    return AESGCMSIV_SUCCESS;
+}
+
+} // extern "C"
@@ -0,0 +1,45 @@
+#ifndef AESGCMSIV_BLOCKS_H
+#define AESGCMSIV_BLOCKS_H
+
+// Internal allocator for short-lived blocks on the request path: async job
+// descriptors, re-encryption scratch and gathered vector inputs. Nothing in
+// this header is exported from the library.
+
+#include "aesgcmsiv.h"
+#include <new>
+#include <utility>
+
+// Largest block kept for reuse; bigger ones go straight to the heap
+#define AESGCMSIV_BLOCK_MAX_CACHED (size_t(1) << 20)
+
+// At least size bytes, aligned to 16, or NULL if they cannot be allocated.
+// Sizes are rounded up to a power of two from 64 bytes, and a block of the
+// same class freed earlier on the calling thread is handed back first, so
+// a thread in a steady state never reaches malloc.
+void* aesgcmsiv_block_alloc(size_t size);
+
+// Releases a block from aesgcmsiv_block_alloc(size) into the calling
+// thread's free lists, or to the heap if they are full. Any thread may free
+// a block. The contents are left as they are; clear secrets first. NULL is
+// ignored.
+void aesgcmsiv_block_free(void* data, size_t size);
+
+// T constructed in a block, or NULL if there is no memory
+template <typename T, typename... Args>
+T* aesgcmsiv_block_new(Args&&... args)
+{
+    static_assert(alignof(T) <= 16, "over-aligned for a block");
+    void* data = aesgcmsiv_block_alloc(sizeof(T));
+    return data ? new (data) T(std::forward<Args>(args)...) : nullptr;
+}
+
+template <typename T>
+void aesgcmsiv_block_delete(T* object)
+{
+    if (object) {
+        object->~T();
+        aesgcmsiv_block_free(object, sizeof(T));
+    }
+}
+
+#endif
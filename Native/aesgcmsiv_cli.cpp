@@ -0,0 +1,1369 @@
+// Bulk file encryption in the chunked stream format, for backups and other
+// large trees, with no .NET runtime involved. The output reads back with
+// aesgcmsiv_stream_open_file, AesGcmSiv.DecryptFile or AesGcmSivStream.
+//
+//   aesgcmsiv-cli encrypt|decrypt --key-file FILE [--chunk-size N]
+//                 [--threads N] [--aad TEXT] [--direct] INPUT OUTPUT
+//
+// INPUT is a file, or a directory whose regular files are all processed into
+// the same relative paths under OUTPUT. The key file holds a raw 16- or
+// 32-byte key. --chunk-size only applies to encryption (decryption reads it
+// from each header) and takes a k or m suffix. Every output is written under
+// a provisional name beside it and renamed into place once complete, so a
+// failed run never leaves a partial file, or unverified plaintext, under an
+// output name.
+//
+// Worker threads take runs of consecutive chunks from a shared cursor that
+// moves from file to file, and seal or open each run at the chunks' own
+// offsets. Each worker keeps the next run's read and the previous run's
+// write in flight while it works on the current one: through io_uring on
+// Linux, overlapped I/O on Windows, and plain positional I/O elsewhere or
+// where io_uring is unavailable. --direct bypasses the page cache (O_DIRECT,
+// F_NOCACHE or FILE_FLAG_NO_BUFFERING) on the plaintext side of files of
+// 64 MiB and more whose chunk size is a multiple of 4096; the sealed side's
+// chunk offsets are never aligned, so it always goes through the cache.
+//
+//   aesgcmsiv-cli scrub --key-file FILE [--threads N] [--aad TEXT]
+//                 [--rate N] INPUT
+//
+// scrub checks that every chunk of each stream file, and every blob of each
+// pack file, under INPUT authenticates, writing no plaintext, and prints
+// the offset of each one that does not. Each file is read front to back in
+// large windows and verified on a pool of --threads workers;
+// --rate caps the read rate in bytes per second (k, m or g suffix) so a
+// scrub leaves disk bandwidth for other readers. Exits 1 if anything is
+// corrupt.
+
+#include "aesgcmsiv.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define CLI_HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Plaintext bytes each worker takes at a time, rounded to whole chunks
+constexpr size_t RUN_BYTES = 4u << 20;
+
+// Alignment of buffers, and of offsets and lengths for direct I/O
+constexpr size_t IO_ALIGNMENT = 4096;
+
+// Smallest file whose plaintext side --direct applies to
+constexpr uint64_t DIRECT_MIN_BYTES = 64u << 20;
+
+struct Options {
+    bool decrypt = false;
+    bool scrub = false;
+    uint64_t rate = 0;  // scrub only; bytes per second, 0 for no limit
+    const char* key_file = nullptr;
+    uint32_t chunk_size = 64 * 1024;  // AesGcmSivStream.DefaultChunkSize
+    unsigned int threads = 0;
+    std::string aad;
+    bool direct = false;
+    fs::path input;
+    fs::path output;
+};
+
+// ---------------------------------------------------------------------------
+// Files and positional I/O
+
+#if defined(_WIN32)
+
+using Handle = HANDLE;
+const Handle no_handle = INVALID_HANDLE_VALUE;
+
+// Every handle is opened for overlapped I/O, so reads and writes carry
+// their own offsets and several can be in flight on one handle
+
+bool open_read(const fs::path& path, bool direct, Handle* file)
+{
+    *file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_FLAG_OVERLAPPED | (direct ? FILE_FLAG_NO_BUFFERING : FILE_FLAG_SEQUENTIAL_SCAN), nullptr);
+    return *file != no_handle;
+}
+
+// Fails if path exists. Shared for writing so a second, direct handle can
+// be opened on it.
+bool create_new(const fs::path& path, Handle* file)
+{
+    *file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+        nullptr, CREATE_NEW, FILE_FLAG_OVERLAPPED, nullptr);
+    return *file != no_handle;
+}
+
+bool open_write_direct(const fs::path& path, Handle* file)
+{
+    *file = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+        nullptr, OPEN_EXISTING, FILE_FLAG_OVERLAPPED | FILE_FLAG_NO_BUFFERING, nullptr);
+    return *file != no_handle;
+}
+
+bool file_size(Handle file, uint64_t* size)
+{
+    LARGE_INTEGER length;
+    if (!GetFileSizeEx(file, &length)) {
+        return false;
+    }
+    *size = static_cast<uint64_t>(length.QuadPart);
+    return true;
+}
+
+bool set_size(Handle file, uint64_t size)
+{
+    FILE_END_OF_FILE_INFO info;
+    info.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+    return SetFileInformationByHandle(file, FileEndOfFileInfo, &info, sizeof(info)) != 0;
+}
+
+void close_handle(Handle* file)
+{
+    if (*file != no_handle) {
+        CloseHandle(*file);
+        *file = no_handle;
+    }
+}
+
+// Starts one overlapped transfer; false if it failed outright. End of file
+// on a read counts as a transfer of nothing.
+bool start_overlapped(bool write, Handle file, uint8_t* buffer, size_t length, uint64_t offset,
+    OVERLAPPED* overlapped, bool* at_end)
+{
+    HANDLE event = overlapped->hEvent;
+    memset(overlapped, 0, sizeof(*overlapped));
+    overlapped->Offset = static_cast<DWORD>(offset);
+    overlapped->OffsetHigh = static_cast<DWORD>(offset >> 32);
+    overlapped->hEvent = event;
+    *at_end = false;
+    BOOL started = write
+        ? WriteFile(file, buffer, static_cast<DWORD>(length), nullptr, overlapped)
+        : ReadFile(file, buffer, static_cast<DWORD>(length), nullptr, overlapped);
+    if (started || GetLastError() == ERROR_IO_PENDING) {
+        return true;
+    }
+    *at_end = !write && GetLastError() == ERROR_HANDLE_EOF;
+    return false;
+}
+
+// Bytes moved by a transfer start_overlapped began, or -1
+int64_t finish_overlapped(Handle file, OVERLAPPED* overlapped)
+{
+    DWORD moved = 0;
+    if (GetOverlappedResult(file, overlapped, &moved, TRUE)) {
+        return moved;
+    }
+    return GetLastError() == ERROR_HANDLE_EOF ? 0 : -1;
+}
+
+// Moves length bytes, or for a read up to the end of the file first.
+// Returns the bytes moved or -1.
+int64_t transfer(bool write, Handle file, uint8_t* buffer, size_t length, uint64_t offset)
+{
+    OVERLAPPED overlapped = {};
+    overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (!overlapped.hEvent) {
+        return -1;
+    }
+    size_t done = 0;
+    int64_t result = 0;
+    while (done < length) {
+        bool at_end;
+        int64_t moved = start_overlapped(write, file, buffer + done, length - done, offset + done, &overlapped, &at_end)
+            ? finish_overlapped(file, &overlapped)
+            : (at_end ? 0 : -1);
+        if (moved <= 0) {
+            result = moved;
+            break;
+        }
+        done += static_cast<size_t>(moved);
+    }
+    CloseHandle(overlapped.hEvent);
+    return result < 0 || (write && done < length) ? -1 : static_cast<int64_t>(done);
+}
+
+bool rename_replace(const fs::path& from, const fs::path& to)
+{
+    return MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+#else
+
+using Handle = int;
+const Handle no_handle = -1;
+
+int direct_flag(bool direct)
+{
+#if defined(O_DIRECT)
+    return direct ? O_DIRECT : 0;
+#else
+    (void)direct;
+    return 0;
+#endif
+}
+
+// Where there is no O_DIRECT, F_NOCACHE is the nearest thing
+void set_no_cache(int fd, bool direct)
+{
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+    if (direct) {
+        fcntl(fd, F_NOCACHE, 1);
+    }
+#else
+    (void)fd;
+    (void)direct;
+#endif
+}
+
+bool open_read(const fs::path& path, bool direct, Handle* file)
+{
+    *file = open(path.c_str(), O_RDONLY | O_CLOEXEC | direct_flag(direct));
+    if (*file < 0) {
+        return false;
+    }
+    set_no_cache(*file, direct);
+#if defined(POSIX_FADV_SEQUENTIAL)
+    if (!direct) {
+        posix_fadvise(*file, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#endif
+    return true;
+}
+
+// Fails if path exists
+bool create_new(const fs::path& path, Handle* file)
+{
+    *file = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+    return *file >= 0;
+}
+
+bool open_write_direct(const fs::path& path, Handle* file)
+{
+    *file = open(path.c_str(), O_WRONLY | O_CLOEXEC | direct_flag(true));
+    if (*file < 0) {
+        return false;
+    }
+    set_no_cache(*file, true);
+    return true;
+}
+
+bool file_size(Handle file, uint64_t* size)
+{
+    struct stat st;
+    if (fstat(file, &st) != 0) {
+        return false;
+    }
+    *size = static_cast<uint64_t>(st.st_size);
+    return true;
+}
+
+bool set_size(Handle file, uint64_t size)
+{
+    return size <= static_cast<uint64_t>(INT64_MAX) && ftruncate(file, static_cast<off_t>(size)) == 0;
+}
+
+void close_handle(Handle* file)
+{
+    if (*file >= 0) {
+        close(*file);
+        *file = -1;
+    }
+}
+
+// Moves length bytes, or for a read up to the end of the file first.
+// Returns the bytes moved or -1.
+int64_t transfer(bool write, Handle file, uint8_t* buffer, size_t length, uint64_t offset)
+{
+    size_t done = 0;
+    while (done < length) {
+        ssize_t moved = write
+            ? pwrite(file, buffer + done, length - done, static_cast<off_t>(offset + done))
+            : pread(file, buffer + done, length - done, static_cast<off_t>(offset + done));
+        if (moved < 0 && errno == EINTR) {
+            continue;
+        }
+        if (moved < 0 || (moved == 0 && write)) {
+            return -1;
+        }
+        if (moved == 0) {
+            break;
+        }
+        done += static_cast<size_t>(moved);
+    }
+    return static_cast<int64_t>(done);
+}
+
+bool rename_replace(const fs::path& from, const fs::path& to)
+{
+    return rename(from.c_str(), to.c_str()) == 0;
+}
+
+#endif
+
+#if defined(CLI_HAVE_IO_URING)
+
+// A minimal io_uring over the raw system calls, so the tool needs no
+// liburing. One ring per worker thread, which is its only user.
+class Ring {
+public:
+    Ring() = default;
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+    ~Ring() { close_ring(); }
+
+    // False if the kernel has no io_uring or it is not permitted here
+    bool open_ring(unsigned entries)
+    {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd_ < 0) {
+            return false;
+        }
+        sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) {
+            sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+        }
+        sq_ring_ = map(sq_size_, IORING_OFF_SQ_RING);
+        cq_ring_ = single ? sq_ring_ : map(cq_size_, IORING_OFF_CQ_RING);
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe*>(map(sqes_size_, IORING_OFF_SQES));
+        if (!sq_ring_ || !cq_ring_ || !sqes_) {
+            close_ring();
+            return false;
+        }
+        uint8_t* sq = static_cast<uint8_t*>(sq_ring_);
+        uint8_t* cq = static_cast<uint8_t*>(cq_ring_);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    // Queues and submits one read or write. False if the kernel refused
+    // the submission, which leaves it queued.
+    bool submit(bool write, int fd, uint8_t* buffer, size_t length, uint64_t offset, uint64_t user_data)
+    {
+        const unsigned tail = *sq_tail_;
+        const unsigned index = tail & sq_mask_;
+        io_uring_sqe* sqe = &sqes_[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+        sqe->fd = fd;
+        sqe->addr = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(buffer));
+        sqe->len = static_cast<uint32_t>(length);
+        sqe->off = offset;
+        sqe->user_data = user_data;
+        sq_array_[index] = index;
+        __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+        return enter(1, 0) == 1;
+    }
+
+    // Takes every available completion, blocking for one if none is
+    // available and block is set. Calls on_complete(user_data, res).
+    template <typename F>
+    bool reap(bool block, F on_complete)
+    {
+        unsigned head = *cq_head_;
+        if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+            if (!block || enter(0, 1) < 0) {
+                return false;
+            }
+        }
+        const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            const io_uring_cqe* cqe = &cqes_[head & cq_mask_];
+            on_complete(cqe->user_data, cqe->res);
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    void* map(size_t size, off_t offset)
+    {
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, offset);
+        return p == MAP_FAILED ? nullptr : p;
+    }
+
+    int enter(unsigned to_submit, unsigned min_complete)
+    {
+        while (true) {
+            long entered = syscall(__NR_io_uring_enter, fd_, to_submit, min_complete,
+                min_complete ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+            if (entered >= 0 || (errno != EINTR && errno != EAGAIN && errno != EBUSY)) {
+                return static_cast<int>(entered);
+            }
+        }
+    }
+
+    void close_ring()
+    {
+        if (sqes_) {
+            munmap(sqes_, sqes_size_);
+        }
+        if (cq_ring_ && cq_ring_ != sq_ring_) {
+            munmap(cq_ring_, cq_size_);
+        }
+        if (sq_ring_) {
+            munmap(sq_ring_, sq_size_);
+        }
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+        fd_ = -1;
+        sq_ring_ = cq_ring_ = nullptr;
+        sqes_ = nullptr;
+    }
+
+    int fd_ = -1;
+    void* sq_ring_ = nullptr;
+    void* cq_ring_ = nullptr;
+    size_t sq_size_ = 0;
+    size_t cq_size_ = 0;
+    size_t sqes_size_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned* sq_array_ = nullptr;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+};
+
+#endif
+
+// One worker's transfers, each in a numbered slot that holds at most one at
+// a time. submit starts a transfer and wait finishes it; without an
+// asynchronous engine, submit does the whole transfer itself.
+class IoQueue {
+public:
+    static constexpr int SLOTS = 3;
+
+    IoQueue()
+    {
+#if defined(_WIN32)
+        for (Op& op : ops_) {
+            op.overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        }
+#elif defined(CLI_HAVE_IO_URING)
+        use_ring_ = ring_.open_ring(8);
+#endif
+    }
+
+    IoQueue(const IoQueue&) = delete;
+    IoQueue& operator=(const IoQueue&) = delete;
+
+    ~IoQueue()
+    {
+        for (int slot = 0; slot < SLOTS; slot++) {
+            if (ops_[slot].pending) {
+                wait(slot);
+            }
+        }
+#if defined(_WIN32)
+        for (Op& op : ops_) {
+            if (op.overlapped.hEvent) {
+                CloseHandle(op.overlapped.hEvent);
+            }
+        }
+#endif
+    }
+
+    const char* engine() const
+    {
+#if defined(_WIN32)
+        return "overlapped I/O";
+#elif defined(CLI_HAVE_IO_URING)
+        return use_ring_ ? "io_uring" : "positional I/O";
+#else
+        return "positional I/O";
+#endif
+    }
+
+    void submit(int slot, bool write, Handle file, uint8_t* buffer, size_t length, uint64_t offset)
+    {
+        Op& op = ops_[slot];
+        op.write = write;
+        op.file = file;
+        op.buffer = buffer;
+        op.length = length;
+        op.offset = offset;
+        op.result = 0;
+        op.pending = false;
+        if (length == 0) {
+            return;
+        }
+#if defined(_WIN32)
+        bool at_end;
+        if (op.overlapped.hEvent && start_overlapped(write, file, buffer, length, offset, &op.overlapped, &at_end)) {
+            op.pending = true;
+        } else {
+            op.result = at_end ? 0 : -1;
+        }
+#elif defined(CLI_HAVE_IO_URING)
+        if (!use_ring_) {
+            op.result = transfer(write, file, buffer, length, offset);
+        } else if (ring_.submit(write, file, buffer, length, offset, static_cast<uint64_t>(slot))) {
+            op.pending = true;
+        } else {
+            ring_failed();
+        }
+#else
+        op.result = transfer(write, file, buffer, length, offset);
+#endif
+    }
+
+    // Bytes moved: the whole length, less only where a read reached the end
+    // of the file, or -1
+    int64_t wait(int slot)
+    {
+        Op& op = ops_[slot];
+        if (op.pending) {
+#if defined(_WIN32)
+            op.result = finish_overlapped(op.file, &op.overlapped);
+#elif defined(CLI_HAVE_IO_URING)
+            while (op.pending) {
+                bool reaped = ring_.reap(true, [this](uint64_t user_data, int res) {
+                    Op& done = ops_[user_data];
+                    done.pending = false;
+                    // Kernels before 5.6 have no IORING_OP_READ or _WRITE
+                    if (res == -EINVAL || res == -EOPNOTSUPP) {
+                        use_ring_ = false;
+                        done.result = transfer(done.write, done.file, done.buffer, done.length, done.offset);
+                    } else {
+                        done.result = res;
+                    }
+                });
+                if (!reaped) {
+                    ring_failed();
+                }
+            }
+#endif
+            op.pending = false;
+        }
+        // A short transfer that did not reach the end of the file is
+        // finished synchronously
+        if (op.result > 0 && static_cast<size_t>(op.result) < op.length) {
+            const size_t done = static_cast<size_t>(op.result);
+            int64_t more = transfer(op.write, op.file, op.buffer + done, op.length - done, op.offset + done);
+            op.result = more < 0 ? -1 : op.result + more;
+        }
+        return op.result;
+    }
+
+private:
+#if defined(CLI_HAVE_IO_URING)
+    // Only reached on a broken ring. Whatever it still holds could land in
+    // a buffer after it is reused, so nothing is safe but stopping.
+    [[noreturn]] static void ring_failed()
+    {
+        fprintf(stderr, "aesgcmsiv-cli: io_uring failed: %s\n", strerror(errno));
+        abort();
+    }
+#endif
+
+    struct Op {
+        bool write = false;
+        bool pending = false;
+        Handle file = no_handle;
+        uint8_t* buffer = nullptr;
+        size_t length = 0;
+        uint64_t offset = 0;
+        int64_t result = 0;
+#if defined(_WIN32)
+        OVERLAPPED overlapped = {};
+#endif
+    };
+
+    Op ops_[SLOTS];
+#if defined(CLI_HAVE_IO_URING)
+    Ring ring_;
+    bool use_ring_ = false;
+#endif
+};
+
+// Grows to the largest run it has held, aligned for direct I/O
+class Buffer {
+public:
+    Buffer() = default;
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+    ~Buffer() { release(); }
+
+    uint8_t* data() const { return data_; }
+
+    void reserve(size_t size)
+    {
+        size = std::max(IO_ALIGNMENT, (size + IO_ALIGNMENT - 1) & ~(IO_ALIGNMENT - 1));
+        if (size > capacity_) {
+            release();
+            data_ = static_cast<uint8_t*>(::operator new(size, std::align_val_t(IO_ALIGNMENT)));
+            capacity_ = size;
+        }
+    }
+
+private:
+    void release()
+    {
+        if (data_) {
+            ::operator delete(data_, std::align_val_t(IO_ALIGNMENT));
+            data_ = nullptr;
+            capacity_ = 0;
+        }
+    }
+
+    uint8_t* data_ = nullptr;
+    size_t capacity_ = 0;
+};
+
+// ---------------------------------------------------------------------------
+// Work
+
+struct FilePair {
+    fs::path input;
+    fs::path output;
+};
+
+// A file being processed. Its runs are handed out in order, but complete
+// in any order; whichever finishes last commits or discards the output.
+struct FileTask {
+    FilePair pair;
+    fs::path provisional;
+    Handle in = no_handle;
+    Handle out = no_handle;
+    Handle tail = no_handle;  // buffered handle beside a direct output
+    bool direct_in = false;
+    bool direct_out = false;
+    aesgcmsiv_stream* stream = nullptr;
+    uint32_t chunk_size = 0;
+    uint64_t plain_size = 0;
+    uint64_t chunks = 0;
+    std::atomic<uint64_t> runs_left{ 0 };
+    std::atomic<bool> failed{ false };
+
+    ~FileTask()
+    {
+        aesgcmsiv_stream_free(stream);
+        close_handle(&in);
+        close_handle(&out);
+        close_handle(&tail);
+    }
+
+    // Marks the file failed, reporting only its first failure
+    void fail(const char* message)
+    {
+        if (!failed.exchange(true)) {
+            fprintf(stderr, "aesgcmsiv-cli: %s: %s\n", pair.input.string().c_str(), message);
+        }
+    }
+};
+
+// Consecutive chunks of one file
+struct Run {
+    std::shared_ptr<FileTask> file;
+    uint64_t first = 0;
+    uint64_t count = 0;
+
+    uint64_t plain_offset() const { return first * file->chunk_size; }
+    size_t plain_length() const
+    {
+        return static_cast<size_t>(std::min<uint64_t>(count * file->chunk_size, file->plain_size - plain_offset()));
+    }
+    uint64_t sealed_offset() const
+    {
+        return AESGCMSIV_STREAM_HEADER_SIZE + first * (uint64_t(file->chunk_size) + AESGCMSIV_TAG_SIZE);
+    }
+    size_t sealed_length() const { return plain_length() + static_cast<size_t>(count) * AESGCMSIV_TAG_SIZE; }
+};
+
+// A name beside path for output that is not yet complete
+bool provisional_path(const fs::path& path, fs::path* provisional)
+{
+    uint8_t random[AESGCMSIV_NONCE_SIZE];
+    if (aesgcmsiv_random_nonce(random) != AESGCMSIV_SUCCESS) {
+        return false;
+    }
+    static const char digits[] = "0123456789abcdef";
+    std::string suffix = ".partial-";
+    for (uint8_t b : random) {
+        suffix += digits[b >> 4];
+        suffix += digits[b & 15];
+    }
+    *provisional = path;
+    *provisional += suffix;
+    return true;
+}
+
+// Hands out runs of chunks across the files in order, opening each file
+// as the previous one's runs run out, so only files in progress are open
+class Scheduler {
+public:
+    Scheduler(const Options& options, aesgcmsiv_ctx* ctx, std::vector<FilePair> files)
+        : options_(options), ctx_(ctx), files_(std::move(files)) {}
+
+    bool next(Run* run)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (true) {
+            if (current_ && next_chunk_ < current_->chunks) {
+                const uint64_t per_run = std::max<uint64_t>(1, RUN_BYTES / current_->chunk_size);
+                run->file = current_;
+                run->first = next_chunk_;
+                run->count = std::min(per_run, current_->chunks - next_chunk_);
+                next_chunk_ += run->count;
+                return true;
+            }
+            current_.reset();
+            if (next_file_ == files_.size()) {
+                return false;
+            }
+            current_ = start(files_[next_file_++]);
+            next_chunk_ = 0;
+        }
+    }
+
+    void finish(Run* run, bool ok)
+    {
+        if (!ok) {
+            run->file->failed = true;
+        }
+        if (run->file->runs_left.fetch_sub(1) == 1) {
+            commit(*run->file);
+        }
+        run->file.reset();
+    }
+
+    uint64_t files_done() const { return files_done_; }
+    uint64_t files_failed() const { return files_failed_; }
+    uint64_t bytes() const { return bytes_; }
+
+private:
+    // Opens a file and its provisional output; NULL if it failed
+    std::shared_ptr<FileTask> start(const FilePair& pair)
+    {
+        auto task = std::make_shared<FileTask>();
+        task->pair = pair;
+        const char* error = options_.decrypt ? start_decrypt(*task) : start_encrypt(*task);
+        if (error) {
+            task->fail(error);
+            discard(*task);
+            return nullptr;
+        }
+        const uint64_t per_run = std::max<uint64_t>(1, RUN_BYTES / task->chunk_size);
+        task->runs_left = (task->chunks + per_run - 1) / per_run;
+        return task;
+    }
+
+    const char* create_output(FileTask& task, uint64_t size)
+    {
+        std::error_code ec;
+        fs::create_directories(task.pair.output.parent_path(), ec);
+        if (!provisional_path(task.pair.output, &task.provisional)) {
+            return "could not generate an output name";
+        }
+        if (!create_new(task.provisional, &task.out)) {
+            task.provisional.clear();
+            return "could not create the output";
+        }
+        if (!set_size(task.out, size)) {
+            return "could not size the output";
+        }
+        // Direct writes go through a second handle, keeping the first for
+        // the unaligned tail; a file system that refuses direct I/O just
+        // gets buffered writes
+        Handle direct = no_handle;
+        if (task.direct_out && open_write_direct(task.provisional, &direct)) {
+            task.tail = task.out;
+            task.out = direct;
+        } else {
+            task.direct_out = false;
+        }
+        return nullptr;
+    }
+
+    const char* start_encrypt(FileTask& task)
+    {
+        std::error_code ec;
+        const uint64_t size = fs::file_size(task.pair.input, ec);
+        task.chunk_size = options_.chunk_size;
+        task.direct_in = !ec && options_.direct && size >= DIRECT_MIN_BYTES;
+        if (task.direct_in && !open_read(task.pair.input, true, &task.in)) {
+            task.direct_in = false;
+        }
+        if ((!task.direct_in && !open_read(task.pair.input, false, &task.in)) || !file_size(task.in, &task.plain_size)) {
+            return "could not open the input";
+        }
+        // An empty file still gets an empty last chunk
+        task.chunks = task.plain_size == 0 ? 1 : (task.plain_size + task.chunk_size - 1) / task.chunk_size;
+        if (task.chunks - 1 > UINT32_MAX) {
+            return "too many chunks at this chunk size";
+        }
+
+        const char* error = create_output(task,
+            AESGCMSIV_STREAM_HEADER_SIZE + task.plain_size + task.chunks * AESGCMSIV_TAG_SIZE);
+        if (error) {
+            return error;
+        }
+        uint8_t header[AESGCMSIV_STREAM_HEADER_SIZE];
+        if (aesgcmsiv_stream_seal_new(ctx_, task.chunk_size, header, &task.stream) != AESGCMSIV_SUCCESS) {
+            return "could not start the stream";
+        }
+        if (transfer(true, task.out, header, sizeof(header), 0) != static_cast<int64_t>(sizeof(header))) {
+            return "could not write the output";
+        }
+        return nullptr;
+    }
+
+    const char* start_decrypt(FileTask& task)
+    {
+        uint64_t size = 0;
+        if (!open_read(task.pair.input, false, &task.in) || !file_size(task.in, &size)) {
+            return "could not open the input";
+        }
+        uint8_t header[AESGCMSIV_STREAM_HEADER_SIZE];
+        if (size < sizeof(header) ||
+            transfer(false, task.in, header, sizeof(header), 0) != static_cast<int64_t>(sizeof(header)) ||
+            aesgcmsiv_stream_open_new(ctx_, header, &task.stream) != AESGCMSIV_SUCCESS) {
+            return "not an encrypted stream";
+        }
+        task.chunk_size = aesgcmsiv_stream_chunk_size(task.stream);
+
+        // Every chunk but the last is full; the last holds at least a tag
+        const uint64_t full = uint64_t(task.chunk_size) + AESGCMSIV_TAG_SIZE;
+        const uint64_t sealed_size = size - sizeof(header);
+        task.chunks = (sealed_size + full - 1) / full;
+        if (task.chunks == 0 || sealed_size - (task.chunks - 1) * full < AESGCMSIV_TAG_SIZE ||
+            task.chunks - 1 > UINT32_MAX) {
+            return "the stream has been truncated";
+        }
+        task.plain_size = sealed_size - task.chunks * AESGCMSIV_TAG_SIZE;
+        task.direct_out = options_.direct && task.plain_size >= DIRECT_MIN_BYTES &&
+            task.chunk_size % IO_ALIGNMENT == 0;
+        return create_output(task, task.plain_size);
+    }
+
+    // Renames a complete output into place, or removes a failed one
+    void commit(FileTask& task)
+    {
+        close_handle(&task.out);
+        close_handle(&task.tail);
+        close_handle(&task.in);
+        if (!task.failed && !rename_replace(task.provisional, task.pair.output)) {
+            task.fail("could not rename the output into place");
+        }
+        if (task.failed) {
+            discard(task);
+            return;
+        }
+        files_done_++;
+        bytes_ += task.plain_size;
+    }
+
+    void discard(FileTask& task)
+    {
+        close_handle(&task.out);
+        close_handle(&task.tail);
+        if (!task.provisional.empty()) {
+            std::error_code ec;
+            fs::remove(task.provisional, ec);
+        }
+        files_failed_++;
+    }
+
+    const Options& options_;
+    aesgcmsiv_ctx* ctx_;
+    std::vector<FilePair> files_;
+    std::mutex mutex_;
+    size_t next_file_ = 0;
+    std::shared_ptr<FileTask> current_;
+    uint64_t next_chunk_ = 0;
+    std::atomic<uint64_t> files_done_{ 0 };
+    std::atomic<uint64_t> files_failed_{ 0 };
+    std::atomic<uint64_t> bytes_{ 0 };
+};
+
+// A run and its buffers as it moves through a worker: read, sealed or
+// opened in place between the two buffers, then written
+struct Slot {
+    enum class State { Idle, Reading, Writing };
+    State state = State::Idle;
+    Run run;
+    Buffer plain;
+    Buffer sealed;
+    size_t write_length = 0;  // the part of the write in the queue
+    bool tail_ok = true;
+};
+
+class Worker {
+public:
+    Worker(const Options& options, Scheduler* scheduler) : options_(options), scheduler_(scheduler) {}
+
+    // Three runs at a time: the current one is sealed or opened while the
+    // next is read and the previous is written
+    void run()
+    {
+        start_read(0);
+        start_read(1);
+        int current = 0;
+        while (slots_[current].state == Slot::State::Reading) {
+            Slot& slot = slots_[current];
+            const bool ok = finish_read(current) && crypt(slot);
+            const int previous = (current + IoQueue::SLOTS - 1) % IoQueue::SLOTS;
+            finish_write(previous);
+            start_read(previous);
+            if (ok) {
+                start_write(current);
+            } else {
+                scheduler_->finish(&slot.run, false);
+                slot.state = Slot::State::Idle;
+            }
+            current = (current + 1) % IoQueue::SLOTS;
+        }
+        for (int i = 0; i < IoQueue::SLOTS; i++) {
+            finish_write(i);
+        }
+    }
+
+    const char* engine() const { return io_.engine(); }
+
+private:
+    void start_read(int index)
+    {
+        Slot& slot = slots_[index];
+        if (!scheduler_->next(&slot.run)) {
+            slot.state = Slot::State::Idle;
+            return;
+        }
+        const Run& run = slot.run;
+        const FileTask& file = *run.file;
+        slot.plain.reserve(run.plain_length());
+        slot.sealed.reserve(run.sealed_length());
+        if (options_.decrypt) {
+            io_.submit(index, false, file.in, slot.sealed.data(), run.sealed_length(), run.sealed_offset());
+        } else {
+            // A direct read covers whole blocks and stops at the end of the file
+            size_t length = run.plain_length();
+            if (file.direct_in) {
+                length = (length + IO_ALIGNMENT - 1) & ~(IO_ALIGNMENT - 1);
+                slot.plain.reserve(length);
+            }
+            io_.submit(index, false, file.in, slot.plain.data(), length, run.plain_offset());
+        }
+        slot.state = Slot::State::Reading;
+    }
+
+    bool finish_read(int index)
+    {
+        Slot& slot = slots_[index];
+        const int64_t read = io_.wait(index);
+        const size_t needed = options_.decrypt ? slot.run.sealed_length() : slot.run.plain_length();
+        if (read < static_cast<int64_t>(needed)) {
+            slot.run.file->fail(read < 0 ? "could not read the input" : "the input changed size while being read");
+            return false;
+        }
+        return true;
+    }
+
+    bool crypt(Slot& slot)
+    {
+        const Run& run = slot.run;
+        FileTask& file = *run.file;
+        const size_t chunk = file.chunk_size;
+        const size_t plain_length = run.plain_length();
+        const uint8_t* aad = reinterpret_cast<const uint8_t*>(options_.aad.data());
+        for (uint64_t i = 0; i < run.count; i++) {
+            const uint64_t index = run.first + i;
+            const int last = index == file.chunks - 1;
+            const size_t offset = static_cast<size_t>(i) * chunk;
+            const size_t length = last ? plain_length - offset : chunk;
+            uint8_t* plain = slot.plain.data() + offset;
+            uint8_t* sealed = slot.sealed.data() + offset + static_cast<size_t>(i) * AESGCMSIV_TAG_SIZE;
+            int result = options_.decrypt
+                ? aesgcmsiv_stream_open_chunk(file.stream, index, sealed, length + AESGCMSIV_TAG_SIZE,
+                      aad, options_.aad.size(), last, plain)
+                : aesgcmsiv_stream_seal_chunk(file.stream, index, plain, length,
+                      aad, options_.aad.size(), last, sealed);
+            if (result != AESGCMSIV_SUCCESS) {
+                file.fail(result == AESGCMSIV_ERROR_DECRYPT_FAILED
+                    ? "a chunk failed to authenticate"
+                    : "a chunk could not be processed");
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void start_write(int index)
+    {
+        Slot& slot = slots_[index];
+        const Run& run = slot.run;
+        const FileTask& file = *run.file;
+        slot.tail_ok = true;
+        if (!options_.decrypt) {
+            slot.write_length = run.sealed_length();
+            io_.submit(index, true, file.out, slot.sealed.data(), slot.write_length, run.sealed_offset());
+        } else {
+            // A direct output takes whole blocks; the last run's unaligned
+            // tail goes through the buffered handle
+            const size_t length = run.plain_length();
+            slot.write_length = file.direct_out ? length & ~(IO_ALIGNMENT - 1) : length;
+            if (slot.write_length < length) {
+                const size_t tail = length - slot.write_length;
+                slot.tail_ok = transfer(true, file.tail, slot.plain.data() + slot.write_length, tail,
+                    run.plain_offset() + slot.write_length) == static_cast<int64_t>(tail);
+            }
+            io_.submit(index, true, file.out, slot.plain.data(), slot.write_length, run.plain_offset());
+        }
+        slot.state = Slot::State::Writing;
+    }
+
+    void finish_write(int index)
+    {
+        Slot& slot = slots_[index];
+        if (slot.state != Slot::State::Writing) {
+            return;
+        }
+        const bool ok = io_.wait(index) == static_cast<int64_t>(slot.write_length) && slot.tail_ok;
+        if (!ok) {
+            slot.run.file->fail("could not write the output");
+        }
+        scheduler_->finish(&slot.run, ok);
+        slot.state = Slot::State::Idle;
+    }
+
+    const Options& options_;
+    Scheduler* scheduler_;
+    IoQueue io_;
+    Slot slots_[IoQueue::SLOTS];
+};
+
+// ---------------------------------------------------------------------------
+// Command line
+
+bool parse_size(const char* text, uint32_t* out)
+{
+    char* end;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (end == text) {
+        return false;
+    }
+    if (*end == 'k' || *end == 'K') {
+        value <<= 10;
+        end++;
+    } else if (*end == 'm' || *end == 'M') {
+        value <<= 20;
+        end++;
+    }
+    if (*end || value == 0 || value > AESGCMSIV_STREAM_MAX_CHUNK_SIZE) {
+        return false;
+    }
+    *out = static_cast<uint32_t>(value);
+    return true;
+}
+
+bool parse_rate(const char* text, uint64_t* out)
+{
+    char* end;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (end == text) {
+        return false;
+    }
+    int shift = 0;
+    if (*end == 'k' || *end == 'K') {
+        shift = 10;
+    } else if (*end == 'm' || *end == 'M') {
+        shift = 20;
+    } else if (*end == 'g' || *end == 'G') {
+        shift = 30;
+    }
+    end += shift != 0;
+    if (*end || value == 0 || value > (UINT64_MAX >> shift)) {
+        return false;
+    }
+    *out = static_cast<uint64_t>(value) << shift;
+    return true;
+}
+
+void usage()
+{
+    fprintf(stderr,
+        "usage: aesgcmsiv-cli encrypt|decrypt --key-file FILE [--chunk-size N]\n"
+        "                     [--threads N] [--aad TEXT] [--direct] INPUT OUTPUT\n"
+        "       aesgcmsiv-cli scrub --key-file FILE [--threads N] [--aad TEXT]\n"
+        "                     [--rate N] INPUT\n");
+}
+
+bool parse_options(int argc, char** argv, Options* options)
+{
+    if (argc < 2 || (strcmp(argv[1], "encrypt") != 0 && strcmp(argv[1], "decrypt") != 0 &&
+            strcmp(argv[1], "scrub") != 0)) {
+        usage();
+        return false;
+    }
+    options->decrypt = strcmp(argv[1], "decrypt") == 0;
+    options->scrub = strcmp(argv[1], "scrub") == 0;
+    std::vector<const char*> paths;
+    for (int i = 2; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool ok = value != nullptr;
+        if (strcmp(arg, "--direct") == 0) {
+            options->direct = true;
+            continue;
+        } else if (strncmp(arg, "--", 2) != 0) {
+            paths.push_back(arg);
+            continue;
+        } else if (strcmp(arg, "--key-file") == 0) {
+            options->key_file = value;
+        } else if (strcmp(arg, "--chunk-size") == 0) {
+            ok = ok && parse_size(value, &options->chunk_size);
+        } else if (strcmp(arg, "--threads") == 0) {
+            options->threads = ok ? static_cast<unsigned int>(strtoul(value, nullptr, 10)) : 0;
+            ok = options->threads > 0;
+        } else if (strcmp(arg, "--aad") == 0) {
+            options->aad = ok ? value : "";
+        } else if (strcmp(arg, "--rate") == 0 && options->scrub) {
+            ok = ok && parse_rate(value, &options->rate);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "aesgcmsiv-cli: bad or incomplete option %s\n", arg);
+            return false;
+        }
+        i++;
+    }
+    if (!options->key_file || paths.size() != (options->scrub ? 1u : 2u)) {
+        usage();
+        return false;
+    }
+    if (options->direct && !options->decrypt && options->chunk_size % IO_ALIGNMENT != 0) {
+        fprintf(stderr, "aesgcmsiv-cli: --direct needs a chunk size that is a multiple of %zu\n", IO_ALIGNMENT);
+        return false;
+    }
+    options->input = paths[0];
+    if (!options->scrub) {
+        options->output = paths[1];
+    }
+    if (options->threads == 0) {
+        options->threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return true;
+}
+
+// Loads a raw 16- or 32-byte key; the caller wipes it
+bool read_key(const char* path, uint8_t* key, size_t* key_len)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    *key_len = fread(key, 1, AESGCMSIV_KEY_SIZE + 1, file);
+    fclose(file);
+    return *key_len == AESGCMSIV_KEY_SIZE_128 || *key_len == AESGCMSIV_KEY_SIZE_256;
+}
+
+void wipe(void* data, size_t length)
+{
+    volatile uint8_t* p = static_cast<volatile uint8_t*>(data);
+    while (length--) {
+        *p++ = 0;
+    }
+}
+
+// Every regular file under a directory input, or the one file input
+bool collect_files(const Options& options, std::vector<FilePair>* files)
+{
+    std::error_code ec;
+    if (fs::is_directory(options.input, ec)) {
+        for (fs::recursive_directory_iterator it(options.input, fs::directory_options::skip_permission_denied, ec), end;
+             !ec && it != end; it.increment(ec)) {
+            if (it->is_regular_file(ec) && !it->is_symlink(ec)) {
+                files->push_back({ it->path(), options.output / it->path().lexically_relative(options.input) });
+            }
+        }
+        if (ec) {
+            fprintf(stderr, "aesgcmsiv-cli: %s: %s\n", options.input.string().c_str(), ec.message().c_str());
+            return false;
+        }
+        return true;
+    }
+    fs::path output = options.output;
+    if (fs::is_directory(output, ec)) {
+        output /= options.input.filename();
+    }
+    files->push_back({ options.input, output });
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Scrubbing
+
+void report_corrupt(void* user, uint64_t offset, uint64_t length, int status)
+{
+    const fs::path* path = static_cast<const fs::path*>(user);
+    printf("%s: corrupt at offset %llu, %llu bytes (error %d)\n", path->string().c_str(),
+        static_cast<unsigned long long>(offset), static_cast<unsigned long long>(length), status);
+}
+
+// Pack files start with their magic; anything else is taken for a stream
+bool is_pack(const fs::path& path)
+{
+    char magic[4] = {};
+    FILE* file = fopen(path.string().c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    const bool pack = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, "AGSP", 4) == 0;
+    fclose(file);
+    return pack;
+}
+
+// Verifies each file in turn, with the library spreading each window of
+// chunks or blobs over the context's pool. Returns the exit status.
+int scrub(const Options& options, aesgcmsiv_ctx* ctx, const std::vector<FilePair>& files)
+{
+    aesgcmsiv_pool* pool = nullptr;
+    if (options.threads > 1 && aesgcmsiv_pool_create(options.threads - 1, &pool) == AESGCMSIV_SUCCESS) {
+        aesgcmsiv_ctx_set_pool(ctx, pool);
+    }
+
+    const auto started = std::chrono::steady_clock::now();
+    uint64_t bytes = 0, corrupt = 0, failed = 0;
+    for (const FilePair& file : files) {
+        const std::string path = file.input.string();
+        uint64_t found = 0;
+        int result;
+        if (is_pack(file.input)) {
+            aesgcmsiv_pack* pack = nullptr;
+            result = aesgcmsiv_pack_open(path.c_str(), &pack);
+            if (result == AESGCMSIV_SUCCESS) {
+                result = aesgcmsiv_pack_scrub(ctx, pack, options.rate,
+                    report_corrupt, const_cast<fs::path*>(&file.input), &found);
+            }
+            aesgcmsiv_pack_free(pack);
+        } else {
+            result = aesgcmsiv_stream_scrub_file(ctx, path.c_str(),
+                reinterpret_cast<const uint8_t*>(options.aad.data()), options.aad.size(), options.rate,
+                report_corrupt, const_cast<fs::path*>(&file.input), &found);
+        }
+        corrupt += found;
+        if (result != AESGCMSIV_SUCCESS && result != AESGCMSIV_ERROR_DECRYPT_FAILED) {
+            fprintf(stderr, "aesgcmsiv-cli: %s: %s\n", path.c_str(),
+                result == AESGCMSIV_ERROR_IO ? "could not be read" : "not a stream or pack file");
+            failed++;
+            continue;
+        }
+        std::error_code ec;
+        bytes += fs::file_size(file.input, ec);
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    const double mib = static_cast<double>(bytes) / (1024 * 1024);
+    fprintf(stderr, "aesgcmsiv-cli: scrubbed %llu files, %.1f MiB in %.2f s (%.1f MiB/s), %llu corrupt",
+        static_cast<unsigned long long>(files.size() - failed), mib, seconds, seconds > 0 ? mib / seconds : 0.0,
+        static_cast<unsigned long long>(corrupt));
+    if (failed != 0) {
+        fprintf(stderr, ", %llu unreadable", static_cast<unsigned long long>(failed));
+    }
+    fprintf(stderr, "\n");
+    aesgcmsiv_ctx_set_pool(ctx, nullptr);
+    aesgcmsiv_pool_destroy(pool);
+    return corrupt == 0 && failed == 0 ? 0 : 1;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parse_options(argc, argv, &options)) {
+        return 2;
+    }
+
+    uint8_t key[AESGCMSIV_KEY_SIZE + 1];
+    size_t key_len = 0;
+    aesgcmsiv_ctx* ctx = nullptr;
+    const bool have_key = read_key(options.key_file, key, &key_len);
+    const int status = have_key ? aesgcmsiv_ctx_new(key, key_len, &ctx) : AESGCMSIV_ERROR_INVALID_KEY;
+    wipe(key, sizeof(key));
+    if (status != AESGCMSIV_SUCCESS) {
+        fprintf(stderr, "aesgcmsiv-cli: %s: %s\n", options.key_file,
+            have_key ? "could not load the key" : "not a 16- or 32-byte key file");
+        return 1;
+    }
+
+    std::vector<FilePair> files;
+    if (!collect_files(options, &files)) {
+        aesgcmsiv_ctx_free(ctx);
+        return 1;
+    }
+
+    if (options.scrub) {
+        const int exit_status = scrub(options, ctx, files);
+        aesgcmsiv_ctx_free(ctx);
+        return exit_status;
+    }
+
+    const auto started = std::chrono::steady_clock::now();
+    Scheduler scheduler(options, ctx, std::move(files));
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (unsigned int i = 0; i < options.threads; i++) {
+        workers.push_back(std::make_unique<Worker>(options, &scheduler));
+    }
+    std::vector<std::thread> threads;
+    for (auto& worker : workers) {
+        threads.emplace_back([&worker] { worker->run(); });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    const double mib = static_cast<double>(scheduler.bytes()) / (1024 * 1024);
+    fprintf(stderr, "aesgcmsiv-cli: %llu files, %.1f MiB in %.2f s (%.1f MiB/s), %u thread%s via %s",
+        static_cast<unsigned long long>(scheduler.files_done()), mib, seconds,
+        seconds > 0 ? mib / seconds : 0.0, options.threads, options.threads == 1 ? "" : "s",
+        workers[0]->engine());
+    if (scheduler.files_failed() != 0) {
+        fprintf(stderr, ", %llu failed", static_cast<unsigned long long>(scheduler.files_failed()));
+    }
+    fprintf(stderr, "\n");
+    aesgcmsiv_ctx_free(ctx);
+    return scheduler.files_failed() == 0 ? 0 : 1;
+}
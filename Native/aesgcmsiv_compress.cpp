@@ -0,0 +1,158 @@
+#include "aesgcmsiv_compress.h"
+#include <new>
+
+// Thin wrappers over the optional compression libraries, so the stream code
+// needs no #ifdefs of its own. Chunks are at most
+// AESGCMSIV_STREAM_MAX_CHUNK_SIZE bytes, which fits every length below in
+// an int.
+
+#ifdef AESGCMSIV_WITH_ZSTD
+#include <zstd.h>
+#endif
+#ifdef AESGCMSIV_WITH_LZ4
+#include <lz4.h>
+#endif
+
+struct aesgcmsiv_codec {
+    uint32_t method;
+    int level;
+#ifdef AESGCMSIV_WITH_ZSTD
+    ZSTD_CCtx* zstd_compress = nullptr;
+    ZSTD_DCtx* zstd_decompress = nullptr;
+#endif
+#ifdef AESGCMSIV_WITH_LZ4
+    void* lz4_state = nullptr;  // LZ4_sizeofState() bytes
+#endif
+};
+
+bool aesgcmsiv_codec_supported(uint32_t method)
+{
+    switch (method) {
+    case AESGCMSIV_COMPRESS_NONE:
+        return true;
+#ifdef AESGCMSIV_WITH_ZSTD
+    case AESGCMSIV_COMPRESS_ZSTD:
+        return true;
+#endif
+#ifdef AESGCMSIV_WITH_LZ4
+    case AESGCMSIV_COMPRESS_LZ4:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+aesgcmsiv_codec* aesgcmsiv_codec_new(uint32_t method, int level, bool decompress)
+{
+    aesgcmsiv_codec* codec = new (std::nothrow) aesgcmsiv_codec();
+    if (!codec) {
+        return nullptr;
+    }
+    codec->method = method;
+    codec->level = level;
+    bool ok = true;
+#ifdef AESGCMSIV_WITH_ZSTD
+    if (decompress) {
+        ok = (codec->zstd_decompress = ZSTD_createDCtx()) != nullptr;
+    } else if (method == AESGCMSIV_COMPRESS_ZSTD) {
+        ok = (codec->zstd_compress = ZSTD_createCCtx()) != nullptr;
+    }
+#endif
+#ifdef AESGCMSIV_WITH_LZ4
+    if (!decompress && method == AESGCMSIV_COMPRESS_LZ4) {
+        ok = ok && (codec->lz4_state = ::operator new(LZ4_sizeofState(), std::nothrow)) != nullptr;
+    }
+#endif
+    (void)decompress;
+    if (!ok) {
+        aesgcmsiv_codec_free(codec);
+        return nullptr;
+    }
+    return codec;
+}
+
+void aesgcmsiv_codec_free(aesgcmsiv_codec* codec)
+{
+    if (!codec) {
+        return;
+    }
+#ifdef AESGCMSIV_WITH_ZSTD
+    ZSTD_freeCCtx(codec->zstd_compress);
+    ZSTD_freeDCtx(codec->zstd_decompress);
+#endif
+#ifdef AESGCMSIV_WITH_LZ4
+    ::operator delete(codec->lz4_state);
+#endif
+    delete codec;
+}
+
+uint32_t aesgcmsiv_codec_method(const aesgcmsiv_codec* codec)
+{
+    return codec->method;
+}
+
+size_t aesgcmsiv_codec_compress(
+    aesgcmsiv_codec* codec, const uint8_t* src, size_t src_len, uint8_t* dst, size_t dst_cap)
+{
+    (void)src;
+    (void)src_len;
+    (void)dst;
+    (void)dst_cap;
+    switch (codec->method) {
+#ifdef AESGCMSIV_WITH_ZSTD
+    case AESGCMSIV_COMPRESS_ZSTD: {
+        size_t written = ZSTD_compressCCtx(codec->zstd_compress, dst, dst_cap, src, src_len, codec->level);
+        return ZSTD_isError(written) ? 0 : written;
+    }
+#endif
+#ifdef AESGCMSIV_WITH_LZ4
+    case AESGCMSIV_COMPRESS_LZ4: {
+        // LZ4 has no levels; a level above 1 is its acceleration factor
+        int written = LZ4_compress_fast_extState(codec->lz4_state,
+            reinterpret_cast<const char*>(src), reinterpret_cast<char*>(dst),
+            static_cast<int>(src_len), static_cast<int>(dst_cap), codec->level > 1 ? codec->level : 1);
+        return written > 0 ? static_cast<size_t>(written) : 0;
+    }
+#endif
+    default:
+        return 0;
+    }
+}
+
+bool aesgcmsiv_codec_decompress(
+    aesgcmsiv_codec* codec, uint32_t method, const uint8_t* src, size_t src_len,
+    uint8_t* dst, size_t dst_cap, size_t* dst_len_out)
+{
+    (void)codec;
+    (void)src;
+    (void)src_len;
+    (void)dst;
+    (void)dst_cap;
+    (void)dst_len_out;
+    switch (method) {
+#ifdef AESGCMSIV_WITH_ZSTD
+    case AESGCMSIV_COMPRESS_ZSTD: {
+        size_t written = ZSTD_decompressDCtx(codec->zstd_decompress, dst, dst_cap, src, src_len);
+        if (ZSTD_isError(written)) {
+            return false;
+        }
+        *dst_len_out = written;
+        return true;
+    }
+#endif
+#ifdef AESGCMSIV_WITH_LZ4
+    case AESGCMSIV_COMPRESS_LZ4: {
+        int written = LZ4_decompress_safe(reinterpret_cast<const char*>(src), reinterpret_cast<char*>(dst),
+            static_cast<int>(src_len), static_cast<int>(dst_cap));
+        if (written < 0) {
+            return false;
+        }
+        *dst_len_out = static_cast<size_t>(written);
+        return true;
+    }
+#endif
+    default:
+        return false;
+    }
+}
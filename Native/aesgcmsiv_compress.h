@@ -0,0 +1,41 @@
+#ifndef AESGCMSIV_COMPRESS_H
+#define AESGCMSIV_COMPRESS_H
+
+// Internal interface to the compressors behind compressed streams
+// (aesgcmsiv_stream_seal_new_compressed). Each is built in only when the
+// library is configured with it: AESGCMSIV_WITH_ZSTD, AESGCMSIV_WITH_LZ4.
+// Nothing in this header is exported from the library.
+
+#include "aesgcmsiv.h"
+
+// Compressor and decompressor state kept by one stream, so the codecs'
+// working memory is allocated once rather than per chunk
+struct aesgcmsiv_codec;
+
+// Whether method, an AESGCMSIV_COMPRESS_* value, is built in.
+// AESGCMSIV_COMPRESS_NONE always is.
+bool aesgcmsiv_codec_supported(uint32_t method);
+
+// State for compressing with method at level, or for decompressing any
+// built-in method. NULL if out of memory.
+aesgcmsiv_codec* aesgcmsiv_codec_new(uint32_t method, int level, bool decompress);
+
+void aesgcmsiv_codec_free(aesgcmsiv_codec* codec);
+
+// The method the codec compresses with
+uint32_t aesgcmsiv_codec_method(const aesgcmsiv_codec* codec);
+
+// Compresses src into dst, returning the compressed length, or 0 if it
+// would not fit in dst_cap bytes or the compressor failed. Callers store
+// such data as it is.
+size_t aesgcmsiv_codec_compress(
+    aesgcmsiv_codec* codec, const uint8_t* src, size_t src_len, uint8_t* dst, size_t dst_cap);
+
+// Decompresses src, compressed with method, into dst. Returns false if the
+// method is not built in, the data is malformed, or it decompresses to more
+// than dst_cap bytes.
+bool aesgcmsiv_codec_decompress(
+    aesgcmsiv_codec* codec, uint32_t method, const uint8_t* src, size_t src_len,
+    uint8_t* dst, size_t dst_cap, size_t* dst_len_out);
+
+#endif
@@ -0,0 +1,112 @@
+#include "aesgcmsiv_kernels.h"
+#include "aesgcmsiv.h"
+
+// CPU feature detection. Runs once when the library is loaded; the kernel
+// probes only look at the bits collected here.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+
+#include "aesgcmsiv_x86.h"
+
+uint32_t aesgcmsiv_detect_cpu_features()
+{
+    uint32_t features = 0;
+    unsigned int regs[4];
+    x86_cpuid(0, 0, regs);
+    const unsigned int max_leaf = regs[0];
+    if (max_leaf < 1) {
+        return 0;
+    }
+
+    x86_cpuid(1, 0, regs);
+    const unsigned int ecx1 = regs[2];
+    if (ecx1 & (1u << 25)) {
+        features |= AESGCMSIV_CPU_AESNI;
+    }
+    if (ecx1 & (1u << 1)) {
+        features |= AESGCMSIV_CPU_PCLMULQDQ;
+    }
+    if (ecx1 & (1u << 19)) {
+        features |= AESGCMSIV_CPU_SSE41;
+    }
+
+    // Wider registers are only usable if the OS saves their state
+    const bool osxsave = (ecx1 & (1u << 27)) && (ecx1 & (1u << 28));
+    const unsigned long long xcr0 = osxsave ? x86_xgetbv0() : 0;
+    const bool ymm_state = (xcr0 & 0x06) == 0x06;
+    const bool zmm_state = (xcr0 & 0xe6) == 0xe6;
+    if (max_leaf < 7) {
+        return features;
+    }
+
+    x86_cpuid(7, 0, regs);
+    const unsigned int ebx7 = regs[1];
+    const unsigned int ecx7 = regs[2];
+    // SHA-NI works on XMM registers, so needs no more than SSE state
+    if (ebx7 & (1u << 29)) {
+        features |= AESGCMSIV_CPU_SHA;
+    }
+    if (!ymm_state) {
+        return features;
+    }
+    if (ebx7 & (1u << 5)) {
+        features |= AESGCMSIV_CPU_AVX2;
+    }
+    const unsigned int avx512_required =
+        (1u << 16) |  // AVX512F
+        (1u << 30) |  // AVX512BW
+        (1u << 31);   // AVX512VL
+    if (zmm_state && (ebx7 & avx512_required) == avx512_required) {
+        features |= AESGCMSIV_CPU_AVX512;
+    }
+    if (ecx7 & (1u << 9)) {
+        features |= AESGCMSIV_CPU_VAES;
+    }
+    if (ecx7 & (1u << 10)) {
+        features |= AESGCMSIV_CPU_VPCLMULQDQ;
+    }
+    return features;
+}
+
+#elif defined(__aarch64__) || defined(_M_ARM64)
+
+#if defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+uint32_t aesgcmsiv_detect_cpu_features()
+{
+#if defined(__linux__)
+    const unsigned long caps = getauxval(AT_HWCAP);
+    uint32_t features = 0;
+    if (caps & HWCAP_AES) {
+        features |= AESGCMSIV_CPU_ARMV8_AES;
+    }
+    if (caps & HWCAP_PMULL) {
+        features |= AESGCMSIV_CPU_ARMV8_PMULL;
+    }
+    return features;
+#elif defined(_WIN32)
+    // Windows reports AES and PMULL together
+    return IsProcessorFeaturePresent(PF_ARM_V8_CRYPTO_INSTRUCTIONS_AVAILABLE)
+        ? AESGCMSIV_CPU_ARMV8_AES | AESGCMSIV_CPU_ARMV8_PMULL
+        : 0;
+#elif defined(__APPLE__)
+    // Every Apple silicon core implements AES and PMULL
+    return AESGCMSIV_CPU_ARMV8_AES | AESGCMSIV_CPU_ARMV8_PMULL;
+#else
+    return 0;
+#endif
+}
+
+#else
+
+uint32_t aesgcmsiv_detect_cpu_features()
+{
+    return 0;
+}
+
+#endif
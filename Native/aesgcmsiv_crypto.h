@@ -0,0 +1,110 @@
+#ifndef AESGCMSIV_CRYPTO_H
+#define AESGCMSIV_CRYPTO_H
+
+// Internal interface to the general-purpose crypto library: the AES-GCM-SIV
+// implementation used when no kernel is, the random number generator, and
+// pausable jobs, implemented on OpenSSL 3 in aesgcmsiv_crypto_openssl.cpp.
+// Another library can be added behind it without touching the callers.
+//
+// Functions returning int return an AESGCMSIV_* code. Any failure inside
+// the library has already been recorded for crypto_last_error and the
+// thread's error queue emptied. Nothing in this header is exported from the
+// library.
+
+#include "aesgcmsiv.h"
+#include "aesgcmsiv_stats.h"
+
+// Reported by aesgcmsiv_get_backend when no kernel is in use
+extern const char* const crypto_backend_name;
+
+// Longest plaintext, and longest AAD, that crypto_seal and crypto_open take
+extern const uint64_t crypto_max_input_len;
+
+// Sets the library up ahead of the first call: its configuration file
+// unless skip_config, and the ciphers and this thread's scratch state
+int crypto_init(bool skip_config);
+
+// A key set up for both directions. Calls on one key may run concurrently.
+struct crypto_key;
+
+// provider and properties, either of which may be NULL, select an OpenSSL
+// provider and fetch properties; libraries without providers fail with
+// AESGCMSIV_ERROR_INTERNAL if either is given. key_len is already valid.
+int crypto_key_new(
+    const uint8_t* key, size_t key_len,
+    const char* provider, const char* properties,
+    crypto_key** key_out);
+
+// A copy of src, bound to the same provider and cipher, without running
+// the key schedule or fetching again where the library can copy its state
+int crypto_key_clone(const crypto_key* src, crypto_key** key_out);
+
+// Clears the key state. NULL is allowed.
+void crypto_key_free(crypto_key* key);
+
+// RFC 8452 under key. Parameters are validated by the caller. The output
+// may equal the input; opening never leaves unauthenticated plaintext in
+// plaintext_out. stats is marked set up once the key and nonce are in
+// place.
+int crypto_key_seal(
+    StatsScope& stats, const crypto_key* key, const uint8_t* nonce,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out, uint8_t* tag_out);
+
+int crypto_key_open(
+    StatsScope& stats, const crypto_key* key, const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag, uint8_t* plaintext_out);
+
+// As above for a key used once, set up on this thread's scratch state
+// rather than allocated
+int crypto_seal(
+    StatsScope& stats, const uint8_t* key, size_t key_len, const uint8_t* nonce,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out, uint8_t* tag_out);
+
+int crypto_open(
+    StatsScope& stats, const uint8_t* key, size_t key_len, const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag, uint8_t* plaintext_out);
+
+// Fills out from the library's DRBG
+int crypto_random(uint8_t* out, size_t len);
+
+// Most recent library error code on this thread, 0 if there was none; see
+// aesgcmsiv_get_openssl_error
+unsigned long crypto_last_error();
+
+// A call that can pause when the cipher waits on an engine or provider,
+// after OpenSSL's ASYNC jobs. Libraries without them report
+// crypto_job_capable() false, and such calls run straight through.
+struct crypto_job;
+
+enum crypto_job_status {
+    CRYPTO_JOB_FINISHED,
+    CRYPTO_JOB_PAUSED,
+    CRYPTO_JOB_NO_JOBS,  // this thread has no job to spare
+    CRYPTO_JOB_FAILED,
+};
+
+bool crypto_job_capable();
+
+// NULL if out of memory
+crypto_job* crypto_job_new();
+
+// Whether the job has started and paused at least once
+bool crypto_job_started(const crypto_job* job);
+
+// Starts fn with a copy of the arg_len bytes at arg, or resumes it. Once
+// finished, *result holds what fn returned.
+crypto_job_status crypto_job_run(
+    crypto_job* job, int (*fn)(void*), void* arg, size_t arg_len, int* result);
+
+// NULL is allowed
+void crypto_job_free(crypto_job* job);
+
+#endif
@@ -0,0 +1,517 @@
+#include "aesgcmsiv_crypto.h"
+#include "aesgcmsiv_blocks.h"
+
+// The library backend on OpenSSL 3: AES-GCM-SIV from the default provider,
+// fetched once into a library context private to this library, and ASYNC
+// jobs for engines and providers that pause.
+
+#include <openssl/async.h>
+#include <openssl/crypto.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/provider.h>
+#include <openssl/rand.h>
+#include <climits>
+#include <new>
+
+const char* const crypto_backend_name = "openssl";
+// EVP_CipherUpdate takes an int length
+const uint64_t crypto_max_input_len = INT_MAX;
+
+// Library context private to this library, with only the default provider
+// loaded. Fetching through the process-wide default context would share its
+// provider store, and the locks on it, with every other OpenSSL user in the
+// process, such as a TLS stack. Created on first use and freed at unload.
+class LibraryContext {
+public:
+    LibraryContext() : libctx_(OSSL_LIB_CTX_new()), provider_(nullptr)
+    {
+        if (libctx_) {
+            provider_ = OSSL_PROVIDER_load(libctx_, "default");
+        }
+    }
+    ~LibraryContext()
+    {
+        if (provider_) {
+            OSSL_PROVIDER_unload(provider_);
+        }
+        OSSL_LIB_CTX_free(libctx_);
+    }
+
+    LibraryContext(const LibraryContext&) = delete;
+    LibraryContext& operator=(const LibraryContext&) = delete;
+
+    // NULL if the context or its provider could not be set up; never falls
+    // back to the default context
+    OSSL_LIB_CTX* get() const { return provider_ ? libctx_ : nullptr; }
+
+private:
+    OSSL_LIB_CTX* libctx_;
+    OSSL_PROVIDER* provider_;
+};
+
+static OSSL_LIB_CTX* library_context()
+{
+    static LibraryContext libctx;
+    return libctx.get();
+}
+
+static const char* cipher_name(size_t key_len)
+{
+    return key_len == AESGCMSIV_KEY_SIZE_128 ? "AES-128-GCM-SIV" : "AES-256-GCM-SIV";
+}
+
+// Process-wide cipher, fetched once on first use and released at library
+// unload. Fetching takes the provider store lock and does a name lookup, so
+// doing it per call serializes concurrent callers. The library context is
+// created first, so it outlives the cipher.
+class CachedCipher {
+public:
+    explicit CachedCipher(const char* name) : cipher_(nullptr)
+    {
+        if (OSSL_LIB_CTX* libctx = library_context()) {
+            cipher_ = EVP_CIPHER_fetch(libctx, name, nullptr);
+        }
+    }
+    ~CachedCipher() { EVP_CIPHER_free(cipher_); }
+
+    CachedCipher(const CachedCipher&) = delete;
+    CachedCipher& operator=(const CachedCipher&) = delete;
+
+    EVP_CIPHER* get() const { return cipher_; }
+
+private:
+    EVP_CIPHER* cipher_;
+};
+
+static const EVP_CIPHER* get_cipher(size_t key_len)
+{
+    // Function-local static initialization is thread-safe
+    if (key_len == AESGCMSIV_KEY_SIZE_128) {
+        static CachedCipher cached_128(cipher_name(key_len));
+        return cached_128.get();
+    }
+    static CachedCipher cached_256(cipher_name(key_len));
+    return cached_256.get();
+}
+
+// Most recent OpenSSL error code on this thread
+static thread_local unsigned long thread_openssl_error;
+
+// OpenSSL pushes an entry on the calling thread's error queue for every
+// failure, and nothing here reads them, so a long-lived thread fed forged
+// messages would grow its queue without bound. Every failure out of an
+// OpenSSL call comes through here: the newest entry is kept and the queue
+// emptied. Returns result.
+static int openssl_failed(int result)
+{
+    if (unsigned long code = ERR_peek_last_error()) {
+        thread_openssl_error = code;
+        ERR_clear_error();
+    }
+    return result;
+}
+
+unsigned long crypto_last_error()
+{
+    return thread_openssl_error;
+}
+
+// Per-thread cipher context reused by every call, so none allocates and
+// frees an EVP_CIPHER_CTX per message. The context is reset after every
+// call, which also clears the key state it held.
+class ThreadCipherCtx {
+public:
+    ThreadCipherCtx() : ctx_(nullptr) {}
+    ~ThreadCipherCtx() { EVP_CIPHER_CTX_free(ctx_); }
+
+    ThreadCipherCtx(const ThreadCipherCtx&) = delete;
+    ThreadCipherCtx& operator=(const ThreadCipherCtx&) = delete;
+
+    EVP_CIPHER_CTX* acquire()
+    {
+        if (!ctx_) {
+            ctx_ = EVP_CIPHER_CTX_new();
+        }
+        return ctx_;
+    }
+
+    void release()
+    {
+        if (EVP_CIPHER_CTX_reset(ctx_) != 1) {
+            // Drop a context left in an unknown state rather than reuse it
+            EVP_CIPHER_CTX_free(ctx_);
+            ctx_ = nullptr;
+            openssl_failed(AESGCMSIV_ERROR_INTERNAL);
+        }
+    }
+
+private:
+    EVP_CIPHER_CTX* ctx_;
+};
+
+static thread_local ThreadCipherCtx thread_cipher_ctx;
+
+int crypto_init(bool skip_config)
+{
+    uint64_t opts = skip_config ? OPENSSL_INIT_NO_LOAD_CONFIG : OPENSSL_INIT_LOAD_CONFIG;
+    if (OPENSSL_init_crypto(opts, nullptr) != 1) {
+        return openssl_failed(AESGCMSIV_ERROR_INTERNAL);
+    }
+
+    // Creates the private library context, loads its provider and fills the
+    // cipher cache
+    if (!get_cipher(AESGCMSIV_KEY_SIZE_128) || !get_cipher(AESGCMSIV_KEY_SIZE_256)) {
+        return openssl_failed(AESGCMSIV_ERROR_INTERNAL);
+    }
+    return thread_cipher_ctx.acquire() ? AESGCMSIV_SUCCESS : openssl_failed(AESGCMSIV_ERROR_INTERNAL);
+}
+
+// Runs AAD, plaintext and tag extraction on a context that already has its
+// key and nonce set.
+static int seal_initialized(
+    EVP_CIPHER_CTX* ctx,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out)
+{
+    // GCM-SIV takes each input in a single update, whose length is an int
+    if (plaintext_len > INT_MAX || aad_len > INT_MAX) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    // Set AAD if provided
+    if (aad && aad_len > 0) {
+        int out_len;
+        if (EVP_EncryptUpdate(ctx, nullptr, &out_len, aad, static_cast<int>(aad_len)) != 1) {
+            return openssl_failed(AESGCMSIV_ERROR_INTERNAL);
+        }
+    }
+
+    // Encrypt plaintext. The update still runs for an empty message, since
+    // it is what generates the tag, and NULL output would make it AAD.
+    uint8_t empty[1] = {0};
+    if (plaintext_len == 0) {
+        plaintext = empty;
+        ciphertext_out = empty;
+    }
+    int out_len;
+    if (EVP_EncryptUpdate(ctx, ciphertext_out, &out_len, plaintext, static_cast<int>(plaintext_len)) != 1) {
+        return openssl_failed(AESGCMSIV_ERROR_INTERNAL);
+    }
+
+    // Finalize encryption and get tag
+    if (EVP_EncryptFinal_ex(ctx, nullptr, &out_len) != 1) {
+        return openssl_failed(AESGCMSIV_ERROR_INTERNAL);
+    }
+
+    // Get the authentication tag
+    if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, AESGCMSIV_TAG_SIZE, tag_out) != 1) {
+        return openssl_failed(AESGCMSIV_ERROR_INTERNAL);
+    }
+
+    return AESGCMSIV_SUCCESS;
+}
+
+// Runs AAD, tag setup, ciphertext and verification on a context that already
+// has its key and nonce set.
+static int open_initialized(
+    EVP_CIPHER_CTX* ctx,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out)
+{
+    if (ciphertext_len > INT_MAX || aad_len > INT_MAX) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    // Set AAD if provided
+    if (aad && aad_len > 0) {
+        int out_len;
+        if (EVP_DecryptUpdate(ctx, nullptr, &out_len, aad, static_cast<int>(aad_len)) != 1) {
+            return openssl_failed(AESGCMSIV_ERROR_INTERNAL);
+        }
+    }
+
+    // Set the expected authentication tag
+    if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, AESGCMSIV_TAG_SIZE, const_cast<uint8_t*>(tag)) != 1) {
+        return openssl_failed(AESGCMSIV_ERROR_INVALID_TAG);
+    }
+
+    // Decrypt ciphertext, through a stand-in buffer when it is empty, as
+    // for sealing
+    uint8_t empty[1] = {0};
+    if (ciphertext_len == 0) {
+        ciphertext = empty;
+        plaintext_out = empty;
+    }
+    int out_len;
+    if (EVP_DecryptUpdate(ctx, plaintext_out, &out_len, ciphertext, static_cast<int>(ciphertext_len)) != 1) {
+        OPENSSL_cleanse(plaintext_out, ciphertext_len);
+        return openssl_failed(AESGCMSIV_ERROR_DECRYPT_FAILED);
+    }
+
+    // Finalize decryption and verify tag; never release unauthenticated
+    // plaintext
+    if (EVP_DecryptFinal_ex(ctx, nullptr, &out_len) != 1) {
+        OPENSSL_cleanse(plaintext_out, ciphertext_len);
+        return openssl_failed(AESGCMSIV_ERROR_DECRYPT_FAILED);
+    }
+
+    return AESGCMSIV_SUCCESS;
+}
+
+struct crypto_key {
+    EVP_CIPHER_CTX* enc;  // keyed for encryption; copied, never used directly
+    EVP_CIPHER_CTX* dec;  // keyed for decryption; copied, never used directly
+    EVP_CIPHER* cipher;  // fetched for a provider or properties; NULL for the shared cipher
+    OSSL_PROVIDER* provider;  // loaded for a named provider, else NULL
+};
+
+int crypto_key_new(
+    const uint8_t* key, size_t key_len,
+    const char* provider, const char* properties,
+    crypto_key** key_out)
+{
+    crypto_key* k = new (std::nothrow) crypto_key();
+    if (!k) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+
+    const EVP_CIPHER* cipher;
+    if (!provider && !properties) {
+        cipher = get_cipher(key_len);
+    } else {
+        OSSL_LIB_CTX* libctx = library_context();
+        if (libctx && provider) {
+            // Loading a provider that is already loaded only takes another
+            // reference, which crypto_key_free drops
+            k->provider = OSSL_PROVIDER_load(libctx, provider);
+        }
+        if (libctx && (!provider || k->provider)) {
+            k->cipher = EVP_CIPHER_fetch(libctx, cipher_name(key_len), properties);
+        }
+        cipher = k->cipher;
+    }
+
+    // Run the key schedule once; each call only supplies a new nonce
+    int result = AESGCMSIV_SUCCESS;
+    if (!cipher ||
+        !(k->enc = EVP_CIPHER_CTX_new()) || !(k->dec = EVP_CIPHER_CTX_new()) ||
+        EVP_EncryptInit_ex2(k->enc, cipher, key, nullptr, nullptr) != 1 ||
+        EVP_DecryptInit_ex2(k->dec, cipher, key, nullptr, nullptr) != 1) {
+        result = openssl_failed(AESGCMSIV_ERROR_INTERNAL);
+        crypto_key_free(k);
+        k = nullptr;
+    }
+    *key_out = k;
+    return result;
+}
+
+int crypto_key_clone(const crypto_key* src, crypto_key** key_out)
+{
+    crypto_key* k = new (std::nothrow) crypto_key();
+    if (!k) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    // A key bound to a provider holds its own references to the provider
+    // and the fetched cipher, so the clone outlives src
+    if (src->provider) {
+        k->provider = OSSL_PROVIDER_load(library_context(), OSSL_PROVIDER_get0_name(src->provider));
+    }
+    if (src->cipher && EVP_CIPHER_up_ref(src->cipher) == 1) {
+        k->cipher = src->cipher;
+    }
+    k->enc = EVP_CIPHER_CTX_new();
+    k->dec = EVP_CIPHER_CTX_new();
+    if ((src->provider && !k->provider) || (src->cipher && !k->cipher) ||
+        !k->enc || !k->dec ||
+        EVP_CIPHER_CTX_copy(k->enc, src->enc) != 1 ||
+        EVP_CIPHER_CTX_copy(k->dec, src->dec) != 1) {
+        crypto_key_free(k);
+        *key_out = nullptr;
+        return openssl_failed(AESGCMSIV_ERROR_INTERNAL);
+    }
+    *key_out = k;
+    return AESGCMSIV_SUCCESS;
+}
+
+void crypto_key_free(crypto_key* key)
+{
+    if (!key) {
+        return;
+    }
+    // EVP_CIPHER_CTX_free cleanses the provider key state
+    EVP_CIPHER_CTX_free(key->enc);
+    EVP_CIPHER_CTX_free(key->dec);
+    EVP_CIPHER_free(key->cipher);
+    if (key->provider) {
+        OSSL_PROVIDER_unload(key->provider);
+    }
+    delete key;
+}
+
+int crypto_key_seal(
+    StatsScope& stats, const crypto_key* key, const uint8_t* nonce,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out, uint8_t* tag_out)
+{
+    // Work on a copy of the keyed template in this thread's context, so
+    // concurrent calls on one key never share cipher state
+    EVP_CIPHER_CTX* ctx = thread_cipher_ctx.acquire();
+    if (!ctx) {
+        return openssl_failed(AESGCMSIV_ERROR_INTERNAL);
+    }
+    if (EVP_CIPHER_CTX_copy(ctx, key->enc) != 1 ||
+        EVP_EncryptInit_ex2(ctx, nullptr, nullptr, nonce, nullptr) != 1) {
+        thread_cipher_ctx.release();
+        return openssl_failed(AESGCMSIV_ERROR_INTERNAL);
+    }
+    stats.setup_done(crypto_backend_name);
+
+    int result = seal_initialized(ctx, plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out);
+
+    thread_cipher_ctx.release();
+    return result;
+}
+
+int crypto_key_open(
+    StatsScope& stats, const crypto_key* key, const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag, uint8_t* plaintext_out)
+{
+    // As in crypto_key_seal, the template itself is never touched
+    EVP_CIPHER_CTX* ctx = thread_cipher_ctx.acquire();
+    if (!ctx) {
+        return openssl_failed(AESGCMSIV_ERROR_INTERNAL);
+    }
+    if (EVP_CIPHER_CTX_copy(ctx, key->dec) != 1 ||
+        EVP_DecryptInit_ex2(ctx, nullptr, nullptr, nonce, nullptr) != 1) {
+        thread_cipher_ctx.release();
+        return openssl_failed(AESGCMSIV_ERROR_INTERNAL);
+    }
+    stats.setup_done(crypto_backend_name);
+
+    int result = open_initialized(ctx, ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out);
+
+    thread_cipher_ctx.release();
+    return result;
+}
+
+int crypto_seal(
+    StatsScope& stats, const uint8_t* key, size_t key_len, const uint8_t* nonce,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out, uint8_t* tag_out)
+{
+    const EVP_CIPHER* cipher = get_cipher(key_len);
+    if (!cipher) {
+        return openssl_failed(AESGCMSIV_ERROR_INTERNAL);
+    }
+
+    // Borrow this thread's cached context
+    EVP_CIPHER_CTX* ctx = thread_cipher_ctx.acquire();
+    if (!ctx) {
+        return openssl_failed(AESGCMSIV_ERROR_INTERNAL);
+    }
+    if (EVP_EncryptInit_ex2(ctx, cipher, key, nonce, nullptr) != 1) {
+        thread_cipher_ctx.release();
+        return openssl_failed(AESGCMSIV_ERROR_INTERNAL);
+    }
+    stats.setup_done(crypto_backend_name);
+
+    int result = seal_initialized(ctx, plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out);
+
+    thread_cipher_ctx.release();
+    return result;
+}
+
+int crypto_open(
+    StatsScope& stats, const uint8_t* key, size_t key_len, const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag, uint8_t* plaintext_out)
+{
+    const EVP_CIPHER* cipher = get_cipher(key_len);
+    if (!cipher) {
+        return openssl_failed(AESGCMSIV_ERROR_INTERNAL);
+    }
+
+    // Borrow this thread's cached context
+    EVP_CIPHER_CTX* ctx = thread_cipher_ctx.acquire();
+    if (!ctx) {
+        return openssl_failed(AESGCMSIV_ERROR_INTERNAL);
+    }
+    if (EVP_DecryptInit_ex2(ctx, cipher, key, nonce, nullptr) != 1) {
+        thread_cipher_ctx.release();
+        return openssl_failed(AESGCMSIV_ERROR_INTERNAL);
+    }
+    stats.setup_done(crypto_backend_name);
+
+    int result = open_initialized(ctx, ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out);
+
+    thread_cipher_ctx.release();
+    return result;
+}
+
+int crypto_random(uint8_t* out, size_t len)
+{
+    if (len > INT_MAX || RAND_bytes(out, static_cast<int>(len)) != 1) {
+        return openssl_failed(AESGCMSIV_ERROR_INTERNAL);
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+struct crypto_job {
+    ASYNC_JOB* job;  // NULL until it first pauses
+    ASYNC_WAIT_CTX* wait_ctx;
+};
+
+bool crypto_job_capable()
+{
+    return ASYNC_is_capable() != 0;
+}
+
+crypto_job* crypto_job_new()
+{
+    crypto_job* job = aesgcmsiv_block_new<crypto_job>();
+    if (job && !(job->wait_ctx = ASYNC_WAIT_CTX_new())) {
+        aesgcmsiv_block_delete(job);
+        job = nullptr;
+    }
+    return job;
+}
+
+bool crypto_job_started(const crypto_job* job)
+{
+    return job->job != nullptr;
+}
+
+crypto_job_status crypto_job_run(
+    crypto_job* job, int (*fn)(void*), void* arg, size_t arg_len, int* result)
+{
+    switch (ASYNC_start_job(&job->job, job->wait_ctx, result, fn, arg, arg_len)) {
+    case ASYNC_PAUSE:
+        return CRYPTO_JOB_PAUSED;
+    case ASYNC_FINISH:
+        return CRYPTO_JOB_FINISHED;
+    case ASYNC_NO_JOBS:
+        openssl_failed(AESGCMSIV_ERROR_INTERNAL);
+        return CRYPTO_JOB_NO_JOBS;
+    default:
+        openssl_failed(AESGCMSIV_ERROR_INTERNAL);
+        return CRYPTO_JOB_FAILED;
+    }
+}
+
+void crypto_job_free(crypto_job* job)
+{
+    if (job) {
+        ASYNC_WAIT_CTX_free(job->wait_ctx);
+        aesgcmsiv_block_delete(job);
+    }
+}
@@ -0,0 +1,226 @@
+#include "aesgcmsiv.h"
+#include <algorithm>
+
+// Datagram batches sealed and opened in place, for relays that move
+// thousands of small packets a second. Each batch becomes batch calls of up
+// to kGroup items built on the stack, so short payloads run through the
+// multi-buffer kernel, and on Linux the same batch goes straight to and
+// from sendmmsg and recvmmsg.
+
+#if defined(__linux__)
+#include <sys/socket.h>
+#endif
+
+namespace {
+
+// Datagrams per batch call, so the items fit on the stack
+constexpr size_t kGroup = 256;
+
+inline uint8_t* payload_of(const aesgcmsiv_datagram& datagram, size_t header_len)
+{
+    return datagram.data + header_len + AESGCMSIV_NONCE_SIZE;
+}
+
+}  // namespace
+
+int aesgcmsiv_seal_datagrams(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    aesgcmsiv_datagram* datagrams,
+    size_t header_len)
+{
+    if (!ctx || (count > 0 && !datagrams)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    for (size_t i = 0; i < count; i++) {
+        const aesgcmsiv_datagram& datagram = datagrams[i];
+        if (!datagram.data || datagram.len < header_len || datagram.len - header_len < AESGCMSIV_NONCE_SIZE ||
+            datagram.len - header_len - AESGCMSIV_NONCE_SIZE > AESGCMSIV_MAX_INPUT_SIZE) {
+            return AESGCMSIV_ERROR_INVALID_INPUT;
+        }
+    }
+
+    for (size_t first = 0; first < count; first += kGroup) {
+        const size_t n = std::min(kGroup, count - first);
+        aesgcmsiv_batch_item items[kGroup];
+        for (size_t j = 0; j < n; j++) {
+            aesgcmsiv_datagram& datagram = datagrams[first + j];
+            uint8_t* nonce = datagram.data + header_len;
+            int result = aesgcmsiv_random_nonce(nonce);
+            if (result != AESGCMSIV_SUCCESS) {
+                return result;
+            }
+            uint8_t* payload = payload_of(datagram, header_len);
+            const size_t payload_len = datagram.len - header_len - AESGCMSIV_NONCE_SIZE;
+            items[j].nonce = nonce;
+            items[j].input = payload;
+            items[j].input_len = payload_len;
+            items[j].aad = datagram.data;
+            items[j].aad_len = header_len;
+            items[j].output = payload;
+            items[j].tag = payload + payload_len;
+        }
+        int result = aesgcmsiv_encrypt_batch(ctx, n, items);
+        if (result != AESGCMSIV_SUCCESS) {
+            return result;
+        }
+        for (size_t j = 0; j < n; j++) {
+            datagrams[first + j].len += AESGCMSIV_TAG_SIZE;
+        }
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_open_datagrams(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    aesgcmsiv_datagram* datagrams,
+    size_t header_len,
+    int* status_out)
+{
+    if (!ctx || (count > 0 && (!datagrams || !status_out))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (!datagrams[i].data && datagrams[i].len != 0) {
+            return AESGCMSIV_ERROR_INVALID_INPUT;
+        }
+    }
+
+    int first_error = AESGCMSIV_SUCCESS;
+    for (size_t first = 0; first < count; first += kGroup) {
+        const size_t n = std::min(kGroup, count - first);
+        // Datagrams too short to be sealed ones fail without reaching the
+        // batch; slots maps each item back to its datagram
+        aesgcmsiv_batch_item items[kGroup];
+        size_t slots[kGroup];
+        int statuses[kGroup];
+        size_t sealed = 0;
+        for (size_t j = 0; j < n; j++) {
+            const aesgcmsiv_datagram& datagram = datagrams[first + j];
+            if (datagram.len < header_len || datagram.len - header_len < AESGCMSIV_DATAGRAM_OVERHEAD) {
+                status_out[first + j] = AESGCMSIV_ERROR_DECRYPT_FAILED;
+                continue;
+            }
+            uint8_t* payload = payload_of(datagram, header_len);
+            const size_t payload_len = datagram.len - header_len - AESGCMSIV_DATAGRAM_OVERHEAD;
+            items[sealed].nonce = datagram.data + header_len;
+            items[sealed].input = payload;
+            items[sealed].input_len = payload_len;
+            items[sealed].aad = datagram.data;
+            items[sealed].aad_len = header_len;
+            items[sealed].output = payload;
+            items[sealed].tag = payload + payload_len;
+            slots[sealed++] = first + j;
+        }
+        if (sealed > 0) {
+            std::fill(statuses, statuses + sealed, AESGCMSIV_ERROR_INTERNAL);
+            aesgcmsiv_decrypt_batch(ctx, sealed, items, statuses);
+            for (size_t j = 0; j < sealed; j++) {
+                status_out[slots[j]] = statuses[j];
+                if (statuses[j] == AESGCMSIV_SUCCESS) {
+                    datagrams[slots[j]].len -= AESGCMSIV_TAG_SIZE;
+                }
+            }
+        }
+        for (size_t j = 0; j < n && first_error == AESGCMSIV_SUCCESS; j++) {
+            first_error = status_out[first + j];
+        }
+    }
+    return first_error;
+}
+
+#if defined(__linux__)
+
+namespace {
+
+// Builds datagram views of messages [first, first + n), each of which has
+// one iovec, taking each length from msg_len when received and from iov_len
+// otherwise
+void view_messages(const mmsghdr* messages, size_t first, size_t n, bool received, aesgcmsiv_datagram* views)
+{
+    for (size_t j = 0; j < n; j++) {
+        const iovec& iov = messages[first + j].msg_hdr.msg_iov[0];
+        views[j].data = static_cast<uint8_t*>(iov.iov_base);
+        views[j].len = received ? messages[first + j].msg_len : iov.iov_len;
+    }
+}
+
+bool single_iovec(const mmsghdr& message)
+{
+    return message.msg_hdr.msg_iovlen == 1 && message.msg_hdr.msg_iov;
+}
+
+}  // namespace
+
+int aesgcmsiv_seal_mmsg(
+    aesgcmsiv_ctx* ctx,
+    struct mmsghdr* messages,
+    unsigned int count,
+    size_t header_len)
+{
+    if (!ctx || (count > 0 && !messages)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    // Every message is checked before any is sealed
+    for (unsigned int i = 0; i < count; i++) {
+        if (!single_iovec(messages[i])) {
+            return AESGCMSIV_ERROR_INVALID_INPUT;
+        }
+        const size_t len = messages[i].msg_hdr.msg_iov[0].iov_len;
+        if (len < header_len || len - header_len < AESGCMSIV_NONCE_SIZE) {
+            return AESGCMSIV_ERROR_INVALID_INPUT;
+        }
+    }
+    for (size_t first = 0; first < count; first += kGroup) {
+        const size_t n = std::min<size_t>(kGroup, count - first);
+        aesgcmsiv_datagram views[kGroup];
+        view_messages(messages, first, n, false, views);
+        int result = aesgcmsiv_seal_datagrams(ctx, n, views, header_len);
+        if (result != AESGCMSIV_SUCCESS) {
+            return result;
+        }
+        for (size_t j = 0; j < n; j++) {
+            messages[first + j].msg_hdr.msg_iov[0].iov_len = views[j].len;
+        }
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_open_mmsg(
+    aesgcmsiv_ctx* ctx,
+    struct mmsghdr* messages,
+    unsigned int count,
+    size_t header_len,
+    int* status_out)
+{
+    if (!ctx || (count > 0 && (!messages || !status_out))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    for (unsigned int i = 0; i < count; i++) {
+        if (!single_iovec(messages[i])) {
+            return AESGCMSIV_ERROR_INVALID_INPUT;
+        }
+    }
+    int first_error = AESGCMSIV_SUCCESS;
+    for (size_t first = 0; first < count; first += kGroup) {
+        const size_t n = std::min<size_t>(kGroup, count - first);
+        aesgcmsiv_datagram views[kGroup];
+        view_messages(messages, first, n, true, views);
+        int result = aesgcmsiv_open_datagrams(ctx, n, views, header_len, status_out + first);
+        if (result == AESGCMSIV_ERROR_INVALID_INPUT) {
+            return result;
+        }
+        for (size_t j = 0; j < n; j++) {
+            if (status_out[first + j] == AESGCMSIV_SUCCESS) {
+                messages[first + j].msg_len = static_cast<unsigned int>(views[j].len);
+            }
+        }
+        if (first_error == AESGCMSIV_SUCCESS) {
+            first_error = result;
+        }
+    }
+    return first_error;
+}
+
+#endif
@@ -0,0 +1,245 @@
+#include "aesgcmsiv.h"
+#include <cstring>
+
+// Every export by name, for callers that cannot look symbols up in the
+// library themselves: a .NET Native AOT app that links the static archive
+// into its executable reaches this one function with DirectPInvoke and
+// binds the rest through it. Keep the table in step with aesgcmsiv.h; the
+// .NET binding fails to load if an export it uses is missing.
+
+namespace {
+
+struct export_entry {
+    const char* name;
+    aesgcmsiv_proc proc;
+};
+
+#define EXPORT(name) { #name, reinterpret_cast<aesgcmsiv_proc>(&name) }
+
+// Sorted by name
+const export_entry exports[] = {
+    EXPORT(aesgcmsiv_alloc),
+    EXPORT(aesgcmsiv_arrow_encrypt_column),
+    EXPORT(aesgcmsiv_available_cpus),
+    EXPORT(aesgcmsiv_buffers_free),
+    EXPORT(aesgcmsiv_buffers_new),
+    EXPORT(aesgcmsiv_buffers_register),
+    EXPORT(aesgcmsiv_buffers_unregister),
+    EXPORT(aesgcmsiv_compression_supported),
+    EXPORT(aesgcmsiv_ctx_aad_update),
+    EXPORT(aesgcmsiv_ctx_absorb_plaintext),
+    EXPORT(aesgcmsiv_ctx_authenticate),
+    EXPORT(aesgcmsiv_ctx_begin),
+    EXPORT(aesgcmsiv_ctx_clone),
+    EXPORT(aesgcmsiv_ctx_decrypt),
+    EXPORT(aesgcmsiv_ctx_decrypt_async),
+    EXPORT(aesgcmsiv_ctx_decrypt_file),
+    EXPORT(aesgcmsiv_ctx_decrypt_small),
+    EXPORT(aesgcmsiv_ctx_decrypt_small_unchecked),
+    EXPORT(aesgcmsiv_ctx_decrypt_submit),
+    EXPORT(aesgcmsiv_ctx_decrypt_unchecked),
+    EXPORT(aesgcmsiv_ctx_decryptv),
+    EXPORT(aesgcmsiv_ctx_emit_ciphertext),
+    EXPORT(aesgcmsiv_ctx_encrypt),
+    EXPORT(aesgcmsiv_ctx_encrypt_async),
+    EXPORT(aesgcmsiv_ctx_encrypt_autononce),
+    EXPORT(aesgcmsiv_ctx_encrypt_file),
+    EXPORT(aesgcmsiv_ctx_encrypt_hashed),
+    EXPORT(aesgcmsiv_ctx_encrypt_small),
+    EXPORT(aesgcmsiv_ctx_encrypt_small_unchecked),
+    EXPORT(aesgcmsiv_ctx_encrypt_submit),
+    EXPORT(aesgcmsiv_ctx_encrypt_unchecked),
+    EXPORT(aesgcmsiv_ctx_encryptv),
+    EXPORT(aesgcmsiv_ctx_finalize_tag),
+    EXPORT(aesgcmsiv_ctx_free),
+    EXPORT(aesgcmsiv_ctx_get_usage),
+    EXPORT(aesgcmsiv_ctx_msg_free),
+    EXPORT(aesgcmsiv_ctx_new),
+    EXPORT(aesgcmsiv_ctx_new_ex),
+    EXPORT(aesgcmsiv_ctx_open),
+    EXPORT(aesgcmsiv_ctx_open_b64url),
+    EXPORT(aesgcmsiv_ctx_seal),
+    EXPORT(aesgcmsiv_ctx_seal_b64url),
+    EXPORT(aesgcmsiv_ctx_set_nonce_cache),
+    EXPORT(aesgcmsiv_ctx_set_pool),
+    EXPORT(aesgcmsiv_ctx_set_streaming),
+    EXPORT(aesgcmsiv_ctx_set_threads),
+    EXPORT(aesgcmsiv_ctx_set_usage_tracking),
+    EXPORT(aesgcmsiv_ctx_set_wide_min),
+    EXPORT(aesgcmsiv_ctx_verify),
+    EXPORT(aesgcmsiv_ctx_verify_ciphertext),
+    EXPORT(aesgcmsiv_debug_fail_alloc),
+    EXPORT(aesgcmsiv_decrypt),
+    EXPORT(aesgcmsiv_decrypt_batch),
+    EXPORT(aesgcmsiv_decrypt_batch_counter),
+    EXPORT(aesgcmsiv_decrypt_batch_shared_aad),
+    EXPORT(aesgcmsiv_decrypt_column),
+    EXPORT(aesgcmsiv_decrypt_pages),
+    EXPORT(aesgcmsiv_decrypt_registered),
+    EXPORT(aesgcmsiv_decrypt_small),
+    EXPORT(aesgcmsiv_decryptv),
+    EXPORT(aesgcmsiv_encrypt),
+    EXPORT(aesgcmsiv_encrypt_batch),
+    EXPORT(aesgcmsiv_encrypt_batch_counter),
+    EXPORT(aesgcmsiv_encrypt_batch_shared_aad),
+    EXPORT(aesgcmsiv_encrypt_column),
+    EXPORT(aesgcmsiv_encrypt_multikey),
+    EXPORT(aesgcmsiv_encrypt_pages),
+    EXPORT(aesgcmsiv_encrypt_registered),
+    EXPORT(aesgcmsiv_encrypt_small),
+    EXPORT(aesgcmsiv_encryptv),
+    EXPORT(aesgcmsiv_engine_free),
+    EXPORT(aesgcmsiv_engine_get_notify_handle),
+    EXPORT(aesgcmsiv_engine_get_stats),
+    EXPORT(aesgcmsiv_engine_new),
+    EXPORT(aesgcmsiv_engine_reap),
+    EXPORT(aesgcmsiv_engine_set_blocking),
+    EXPORT(aesgcmsiv_engine_set_linger),
+    EXPORT(aesgcmsiv_engine_shutdown),
+    EXPORT(aesgcmsiv_engine_submit),
+    EXPORT(aesgcmsiv_engine_submit_lane),
+    EXPORT(aesgcmsiv_free),
+    EXPORT(aesgcmsiv_get_alloc_stats),
+    EXPORT(aesgcmsiv_get_backend),
+    EXPORT(aesgcmsiv_get_caps),
+    EXPORT(aesgcmsiv_get_export),
+    EXPORT(aesgcmsiv_get_openssl_error),
+    EXPORT(aesgcmsiv_get_profile),
+    EXPORT(aesgcmsiv_get_stats),
+    EXPORT(aesgcmsiv_get_tuning),
+    EXPORT(aesgcmsiv_init),
+    EXPORT(aesgcmsiv_job_poll),
+    EXPORT(aesgcmsiv_json_open_fields),
+    EXPORT(aesgcmsiv_json_seal_fields),
+    EXPORT(aesgcmsiv_kdf_decrypt_batch),
+    EXPORT(aesgcmsiv_kdf_derive_batch),
+    EXPORT(aesgcmsiv_kdf_encrypt_batch),
+    EXPORT(aesgcmsiv_kdf_free),
+    EXPORT(aesgcmsiv_kdf_new),
+    EXPORT(aesgcmsiv_kdf_set_cache),
+    EXPORT(aesgcmsiv_key_cache_clear),
+    EXPORT(aesgcmsiv_key_cache_free),
+    EXPORT(aesgcmsiv_key_cache_get),
+    EXPORT(aesgcmsiv_key_cache_new),
+    EXPORT(aesgcmsiv_key_cache_set_capacity),
+    EXPORT(aesgcmsiv_key_table_clear),
+    EXPORT(aesgcmsiv_key_table_decrypt_batch),
+    EXPORT(aesgcmsiv_key_table_encrypt_batch),
+    EXPORT(aesgcmsiv_key_table_free),
+    EXPORT(aesgcmsiv_key_table_new),
+    EXPORT(aesgcmsiv_key_table_new_shared),
+    EXPORT(aesgcmsiv_key_table_seal),
+    EXPORT(aesgcmsiv_key_table_set),
+    EXPORT(aesgcmsiv_key_table_set_pool),
+    EXPORT(aesgcmsiv_keyring_add),
+    EXPORT(aesgcmsiv_keyring_free),
+    EXPORT(aesgcmsiv_keyring_new),
+    EXPORT(aesgcmsiv_keyring_remove),
+    EXPORT(aesgcmsiv_keyring_set_usage_tracking),
+    EXPORT(aesgcmsiv_keyring_stats),
+    EXPORT(aesgcmsiv_nop),
+    EXPORT(aesgcmsiv_open),
+    EXPORT(aesgcmsiv_open_b64url),
+    EXPORT(aesgcmsiv_open_datagrams),
+#if defined(__linux__)
+    EXPORT(aesgcmsiv_open_mmsg),
+#endif
+    EXPORT(aesgcmsiv_open_trial),
+    EXPORT(aesgcmsiv_open_with_keyid),
+    EXPORT(aesgcmsiv_pack_count),
+    EXPORT(aesgcmsiv_pack_find),
+    EXPORT(aesgcmsiv_pack_free),
+    EXPORT(aesgcmsiv_pack_id_size),
+    EXPORT(aesgcmsiv_pack_open),
+    EXPORT(aesgcmsiv_pack_read_batch),
+    EXPORT(aesgcmsiv_pack_scrub),
+    EXPORT(aesgcmsiv_pack_write_file),
+    EXPORT(aesgcmsiv_polyval_final),
+    EXPORT(aesgcmsiv_polyval_free),
+    EXPORT(aesgcmsiv_polyval_init),
+    EXPORT(aesgcmsiv_polyval_update),
+    EXPORT(aesgcmsiv_pool_create),
+    EXPORT(aesgcmsiv_pool_create_ex),
+    EXPORT(aesgcmsiv_pool_create_hosted),
+    EXPORT(aesgcmsiv_pool_destroy),
+    EXPORT(aesgcmsiv_pool_work),
+    EXPORT(aesgcmsiv_probe),
+    EXPORT(aesgcmsiv_profile_enable),
+    EXPORT(aesgcmsiv_random_nonce),
+    EXPORT(aesgcmsiv_record_start),
+    EXPORT(aesgcmsiv_record_stop),
+    EXPORT(aesgcmsiv_reencrypt),
+    EXPORT(aesgcmsiv_reencrypt_batch),
+    EXPORT(aesgcmsiv_reset_stats),
+    EXPORT(aesgcmsiv_seal),
+    EXPORT(aesgcmsiv_seal_b64url),
+    EXPORT(aesgcmsiv_seal_datagrams),
+#if defined(__linux__)
+    EXPORT(aesgcmsiv_seal_mmsg),
+#endif
+    EXPORT(aesgcmsiv_seal_with_keyid),
+    EXPORT(aesgcmsiv_select_backend),
+    EXPORT(aesgcmsiv_set_slow_op_callback),
+    EXPORT(aesgcmsiv_set_tuning),
+    EXPORT(aesgcmsiv_stats_enable),
+    EXPORT(aesgcmsiv_stream_budget_get_stats),
+    EXPORT(aesgcmsiv_stream_budget_set),
+    EXPORT(aesgcmsiv_stream_chunk_size),
+    EXPORT(aesgcmsiv_stream_free),
+    EXPORT(aesgcmsiv_stream_open),
+    EXPORT(aesgcmsiv_stream_open_chunk),
+    EXPORT(aesgcmsiv_stream_open_compressed),
+    EXPORT(aesgcmsiv_stream_open_file),
+    EXPORT(aesgcmsiv_stream_open_new),
+    EXPORT(aesgcmsiv_stream_scrub_file),
+    EXPORT(aesgcmsiv_stream_seal),
+    EXPORT(aesgcmsiv_stream_seal_chunk),
+    EXPORT(aesgcmsiv_stream_seal_compressed),
+    EXPORT(aesgcmsiv_stream_seal_file),
+    EXPORT(aesgcmsiv_stream_seal_new),
+    EXPORT(aesgcmsiv_stream_seal_new_compressed),
+    EXPORT(aesgcmsiv_stream_verify_chunks),
+    EXPORT(aesgcmsiv_stream_window_acquire),
+    EXPORT(aesgcmsiv_stream_window_release),
+    EXPORT(aesgcmsiv_unwrap),
+    EXPORT(aesgcmsiv_value_cache_free),
+    EXPORT(aesgcmsiv_value_cache_get),
+    EXPORT(aesgcmsiv_value_cache_get_stats),
+    EXPORT(aesgcmsiv_value_cache_new),
+    EXPORT(aesgcmsiv_value_cache_put),
+    EXPORT(aesgcmsiv_value_cache_remove),
+    EXPORT(aesgcmsiv_verify_batch),
+    EXPORT(aesgcmsiv_wrap),
+    EXPORT(aesgcmsiv_wrap_ctx_free),
+    EXPORT(aesgcmsiv_wrap_ctx_new),
+};
+
+#undef EXPORT
+
+} // namespace
+
+extern "C" {
+
+aesgcmsiv_proc aesgcmsiv_get_export(const char* name)
+{
+    if (!name) {
+        return nullptr;
+    }
+    size_t lo = 0;
+    size_t hi = sizeof(exports) / sizeof(exports[0]);
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int order = strcmp(name, exports[mid].name);
+        if (order == 0) {
+            return exports[mid].proc;
+        }
+        if (order < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return nullptr;
+}
+
+} // extern "C"
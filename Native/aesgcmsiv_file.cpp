@@ -0,0 +1,1047 @@
+#include "aesgcmsiv.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Whole-file encryption, in the chunked stream format or as one message,
+// and pack files of many small blobs. Files are mapped into memory, so data
+// is sealed or opened straight from the input mapping into the output
+// mapping with no copy through a buffer. The kernel is told each mapping is
+// read front to back, except a pack's, which is read at random.
+
+namespace {
+
+enum class Pattern { Sequential, Random };
+
+}  // namespace
+
+#if defined(_WIN32)
+
+#include <windows.h>
+#include <vector>
+
+namespace {
+
+struct MappedFile {
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+    uint8_t* data = nullptr;
+    size_t size = 0;
+    bool created = false;  // opened for writing, so truncated or new
+};
+
+bool widen(const char* path, std::vector<wchar_t>& wide)
+{
+    int length = MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, path, -1, nullptr, 0);
+    if (length <= 0) {
+        return false;
+    }
+    wide.resize(static_cast<size_t>(length));
+    return MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, path, -1, wide.data(), length) == length;
+}
+
+void unmap(MappedFile& file)
+{
+    if (file.data) {
+        UnmapViewOfFile(file.data);
+    }
+    if (file.mapping) {
+        CloseHandle(file.mapping);
+    }
+    if (file.file != INVALID_HANDLE_VALUE) {
+        CloseHandle(file.file);
+    }
+    file = MappedFile();
+}
+
+// Maps the whole of a file, read-only or as size bytes to write. An
+// exclusive write fails if the file exists instead of replacing it. An empty
+// file is opened but not mapped, since a view cannot be empty.
+bool map_file(const char* path, bool write, uint64_t size, MappedFile& file, bool exclusive = false,
+    Pattern pattern = Pattern::Sequential)
+{
+    std::vector<wchar_t> wide;
+    if (!widen(path, wide)) {
+        return false;
+    }
+    file.file = CreateFileW(wide.data(),
+        write ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+        write ? 0 : FILE_SHARE_READ, nullptr,
+        write ? (exclusive ? CREATE_NEW : CREATE_ALWAYS) : OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL |
+            (pattern == Pattern::Random ? FILE_FLAG_RANDOM_ACCESS : FILE_FLAG_SEQUENTIAL_SCAN),
+        nullptr);
+    if (file.file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    file.created = write;
+    if (!write) {
+        LARGE_INTEGER length;
+        if (!GetFileSizeEx(file.file, &length)) {
+            return false;
+        }
+        size = static_cast<uint64_t>(length.QuadPart);
+    }
+    if (size > SIZE_MAX) {
+        return false;
+    }
+    file.size = static_cast<size_t>(size);
+    if (size == 0) {
+        return true;
+    }
+    // A mapping larger than the file extends it, which sizes the output
+    file.mapping = CreateFileMappingW(file.file, nullptr, write ? PAGE_READWRITE : PAGE_READONLY,
+        static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), nullptr);
+    if (!file.mapping) {
+        return false;
+    }
+    file.data = static_cast<uint8_t*>(MapViewOfFile(file.mapping,
+        write ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0));
+    return file.data != nullptr;
+}
+
+// Starts reading length bytes at offset into the page cache
+void page_in(const MappedFile& file, size_t offset, size_t length)
+{
+#if _WIN32_WINNT >= 0x0602
+    WIN32_MEMORY_RANGE_ENTRY range = {file.data + offset, length};
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+    (void)file;
+    (void)offset;
+    (void)length;
+#endif
+}
+
+// Drops length bytes at offset from the working set; Windows keeps them in
+// the standby list, the first pages it reuses
+void page_out(const MappedFile& file, size_t offset, size_t length)
+{
+    VirtualUnlock(file.data + offset, length);
+}
+
+void remove_file(const char* path)
+{
+    std::vector<wchar_t> wide;
+    if (widen(path, wide)) {
+        DeleteFileW(wide.data());
+    }
+}
+
+// Replaces to with from; both must be closed
+bool rename_file(const char* from, const char* to)
+{
+    std::vector<wchar_t> wide_from, wide_to;
+    return widen(from, wide_from) && widen(to, wide_to) &&
+        MoveFileExW(wide_from.data(), wide_to.data(), MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+}  // namespace
+
+#else
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+struct MappedFile {
+    int fd = -1;
+    uint8_t* data = nullptr;
+    size_t size = 0;
+    bool created = false;  // opened for writing, so truncated or new
+};
+
+void unmap(MappedFile& file)
+{
+    if (file.data) {
+        munmap(file.data, file.size);
+    }
+    if (file.fd >= 0) {
+        close(file.fd);
+    }
+    file = MappedFile();
+}
+
+// Maps the whole of a file, read-only or as size bytes to write. An
+// exclusive write fails if the file exists instead of replacing it. An empty
+// file is opened but not mapped, since a mapping cannot be empty.
+bool map_file(const char* path, bool write, uint64_t size, MappedFile& file, bool exclusive = false,
+    Pattern pattern = Pattern::Sequential)
+{
+    file.fd = write
+        ? open(path, O_RDWR | O_CREAT | (exclusive ? O_EXCL : O_TRUNC) | O_CLOEXEC, 0666)
+        : open(path, O_RDONLY | O_CLOEXEC);
+    if (file.fd < 0) {
+        return false;
+    }
+    file.created = write;
+    if (write) {
+        if (size > static_cast<uint64_t>(INT64_MAX) || ftruncate(file.fd, static_cast<off_t>(size)) != 0) {
+            return false;
+        }
+    } else {
+        struct stat st;
+        if (fstat(file.fd, &st) != 0) {
+            return false;
+        }
+        size = static_cast<uint64_t>(st.st_size);
+    }
+    if (size > SIZE_MAX) {
+        return false;
+    }
+    if (size == 0) {
+        return true;
+    }
+#if defined(POSIX_FADV_SEQUENTIAL)
+    if (!write) {
+        posix_fadvise(file.fd, 0, 0,
+            pattern == Pattern::Random ? POSIX_FADV_RANDOM : POSIX_FADV_SEQUENTIAL);
+    }
+#endif
+    void* data = mmap(nullptr, static_cast<size_t>(size),
+        write ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file.fd, 0);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    file.data = static_cast<uint8_t*>(data);
+    file.size = static_cast<size_t>(size);
+    // Only a hint: readahead grows and pages behind the cursor go first, or
+    // for random reads, only the pages touched are read in
+    madvise(data, file.size, pattern == Pattern::Random ? MADV_RANDOM : MADV_SEQUENTIAL);
+#if defined(MADV_HUGEPAGE)
+    // Also a hint: filesystems that cache large folios can then map a large
+    // file with 2 MB pages, so a pass over it takes far fewer TLB misses
+    if (file.size >= (size_t(2) << 20)) {
+        madvise(data, file.size, MADV_HUGEPAGE);
+    }
+#endif
+    return true;
+}
+
+// The page-aligned span holding length bytes at offset of a mapping
+void page_span(const MappedFile& file, size_t offset, size_t length, uint8_t** start, size_t* span)
+{
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t aligned = offset & ~(page - 1);
+    *start = file.data + aligned;
+    *span = length + (offset - aligned);
+}
+
+// Starts reading length bytes at offset into the page cache
+void page_in(const MappedFile& file, size_t offset, size_t length)
+{
+    uint8_t* start;
+    size_t span;
+    page_span(file, offset, length, &start, &span);
+    madvise(start, span, MADV_WILLNEED);
+}
+
+// Unmaps length bytes at offset and drops them from the page cache, which
+// only takes pages no process has mapped
+void page_out(const MappedFile& file, size_t offset, size_t length)
+{
+    uint8_t* start;
+    size_t span;
+    page_span(file, offset, length, &start, &span);
+    madvise(start, span, MADV_DONTNEED);
+#if defined(POSIX_FADV_DONTNEED)
+    posix_fadvise(file.fd, static_cast<off_t>(start - file.data), static_cast<off_t>(span), POSIX_FADV_DONTNEED);
+#endif
+}
+
+void remove_file(const char* path)
+{
+    unlink(path);
+}
+
+// Atomically replaces to with from
+bool rename_file(const char* from, const char* to)
+{
+    return rename(from, to) == 0;
+}
+
+}  // namespace
+
+#endif
+
+int aesgcmsiv_stream_seal_file(
+    aesgcmsiv_ctx* ctx,
+    const char* input_path,
+    const char* output_path,
+    uint32_t chunk_size,
+    const uint8_t* aad, size_t aad_len)
+{
+    if (!ctx || !input_path || !output_path || chunk_size == 0 ||
+        chunk_size > AESGCMSIV_STREAM_MAX_CHUNK_SIZE || (!aad && aad_len != 0)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    MappedFile input;
+    if (!map_file(input_path, false, 0, input)) {
+        unmap(input);
+        return AESGCMSIV_ERROR_IO;
+    }
+    // Every chunk but the last is full, and an empty file still gets an
+    // empty last chunk
+    const uint64_t chunks = input.size == 0 ? 1 : (input.size + chunk_size - 1) / chunk_size;
+    if (chunks - 1 > UINT32_MAX) {
+        unmap(input);
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    const uint64_t output_size = AESGCMSIV_STREAM_HEADER_SIZE + input.size + chunks * AESGCMSIV_TAG_SIZE;
+
+    MappedFile output;
+    int result = AESGCMSIV_SUCCESS;
+    aesgcmsiv_stream* stream = nullptr;
+    if (!map_file(output_path, true, output_size, output)) {
+        result = AESGCMSIV_ERROR_IO;
+    } else {
+        result = aesgcmsiv_stream_seal_new(ctx, chunk_size, output.data, &stream);
+    }
+
+    uint8_t* out = result == AESGCMSIV_SUCCESS ? output.data + AESGCMSIV_STREAM_HEADER_SIZE : nullptr;
+    for (uint64_t i = 0; result == AESGCMSIV_SUCCESS && i < chunks; i++) {
+        const size_t offset = static_cast<size_t>(i * chunk_size);
+        const bool last = i == chunks - 1;
+        const size_t len = last ? input.size - offset : chunk_size;
+        // An empty file has no mapping to point into
+        static const uint8_t empty = 0;
+        result = aesgcmsiv_stream_seal(stream, input.data ? input.data + offset : &empty, len,
+            aad, aad_len, last, out);
+        out += len + AESGCMSIV_TAG_SIZE;
+    }
+
+    aesgcmsiv_stream_free(stream);
+    const bool created = output.created;
+    unmap(output);
+    unmap(input);
+    if (result != AESGCMSIV_SUCCESS && created) {
+        remove_file(output_path);
+    }
+    return result;
+}
+
+int aesgcmsiv_stream_open_file(
+    aesgcmsiv_ctx* ctx,
+    const char* input_path,
+    const char* output_path,
+    const uint8_t* aad, size_t aad_len)
+{
+    if (!ctx || !input_path || !output_path || (!aad && aad_len != 0)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    MappedFile input;
+    if (!map_file(input_path, false, 0, input)) {
+        unmap(input);
+        return AESGCMSIV_ERROR_IO;
+    }
+    aesgcmsiv_stream* stream = nullptr;
+    int result = input.size < AESGCMSIV_STREAM_HEADER_SIZE
+        ? AESGCMSIV_ERROR_INVALID_INPUT
+        : aesgcmsiv_stream_open_new(ctx, input.data, &stream);
+    if (result != AESGCMSIV_SUCCESS) {
+        unmap(input);
+        return result;
+    }
+
+    // Every chunk but the last is full; the last holds at least a tag, so a
+    // length that leaves less is a truncated stream
+    const size_t full = aesgcmsiv_stream_chunk_size(stream) + static_cast<size_t>(AESGCMSIV_TAG_SIZE);
+    const size_t sealed_size = input.size - AESGCMSIV_STREAM_HEADER_SIZE;
+    const uint64_t chunks = (sealed_size + full - 1) / full;
+    const size_t last_sealed = sealed_size - static_cast<size_t>((chunks - 1) * full);
+    MappedFile output;
+    if (chunks == 0 || last_sealed < AESGCMSIV_TAG_SIZE || chunks - 1 > UINT32_MAX) {
+        result = AESGCMSIV_ERROR_DECRYPT_FAILED;
+    } else if (!map_file(output_path, true, sealed_size - chunks * AESGCMSIV_TAG_SIZE, output)) {
+        result = AESGCMSIV_ERROR_IO;
+    }
+
+    const uint8_t* in = input.data + AESGCMSIV_STREAM_HEADER_SIZE;
+    static uint8_t empty = 0;
+    for (uint64_t i = 0; result == AESGCMSIV_SUCCESS && i < chunks; i++) {
+        const bool last = i == chunks - 1;
+        const size_t sealed_len = last ? last_sealed : full;
+        // An empty plaintext has no mapping to point into
+        uint8_t* out = output.data ? output.data + static_cast<size_t>(i * (full - AESGCMSIV_TAG_SIZE)) : &empty;
+        result = aesgcmsiv_stream_open(stream, in, sealed_len, aad, aad_len, last, out);
+        in += sealed_len;
+    }
+
+    aesgcmsiv_stream_free(stream);
+    const bool created = output.created;
+    unmap(output);
+    unmap(input);
+    // Chunks already opened must not be left behind once a later one fails
+    if (result != AESGCMSIV_SUCCESS && created) {
+        remove_file(output_path);
+    }
+    return result;
+}
+
+namespace {
+
+// A name next to path for output that is not yet verified, unique enough
+// that creating it exclusively only fails on a real I/O error
+bool provisional_path(const char* path, std::string& provisional)
+{
+    uint8_t random[AESGCMSIV_NONCE_SIZE];
+    if (aesgcmsiv_random_nonce(random) != AESGCMSIV_SUCCESS) {
+        return false;
+    }
+    static const char digits[] = "0123456789abcdef";
+    provisional = path;
+    provisional += ".partial-";
+    for (uint8_t b : random) {
+        provisional += digits[b >> 4];
+        provisional += digits[b & 15];
+    }
+    return true;
+}
+
+}  // namespace
+
+namespace {
+
+// Sealed bytes a scrub verifies per window, read ahead one window at a time
+constexpr size_t kScrubWindow = 16u << 20;
+
+// The bookkeeping of a scrub: reads ahead of it, drops what it has
+// verified, holds it to its rate and counts what fails
+class Scrubber {
+public:
+    Scrubber(const MappedFile& file, uint64_t rate, aesgcmsiv_scrub_callback callback, void* user)
+        : file_(file), rate_(rate), callback_(callback), user_(user), started_(std::chrono::steady_clock::now())
+    {
+    }
+
+    // Starts reading the window from offset
+    void ahead(uint64_t offset)
+    {
+        if (offset < file_.size) {
+            page_in(file_, static_cast<size_t>(offset), std::min(kScrubWindow, file_.size - static_cast<size_t>(offset)));
+        }
+    }
+
+    // Drops a verified window and sleeps until the rate allows the next
+    void done(uint64_t offset, uint64_t length)
+    {
+        page_out(file_, static_cast<size_t>(offset), static_cast<size_t>(length));
+        read_ += length;
+        if (rate_ != 0) {
+            std::this_thread::sleep_until(started_ +
+                std::chrono::duration<double>(static_cast<double>(read_) / static_cast<double>(rate_)));
+        }
+    }
+
+    void corrupt(uint64_t offset, uint64_t length, int status)
+    {
+        corrupt_++;
+        if (callback_) {
+            callback_(user_, offset, length, status);
+        }
+    }
+
+    int finish(uint64_t* corrupt_out) const
+    {
+        if (corrupt_out) {
+            *corrupt_out = corrupt_;
+        }
+        return corrupt_ == 0 ? AESGCMSIV_SUCCESS : AESGCMSIV_ERROR_DECRYPT_FAILED;
+    }
+
+private:
+    const MappedFile& file_;
+    const uint64_t rate_;
+    const aesgcmsiv_scrub_callback callback_;
+    void* const user_;
+    const std::chrono::steady_clock::time_point started_;
+    uint64_t read_ = 0;
+    uint64_t corrupt_ = 0;
+};
+
+}  // namespace
+
+int aesgcmsiv_stream_scrub_file(
+    aesgcmsiv_ctx* ctx,
+    const char* input_path,
+    const uint8_t* aad, size_t aad_len,
+    uint64_t max_bytes_per_second,
+    aesgcmsiv_scrub_callback callback, void* user,
+    uint64_t* corrupt_out)
+{
+    if (corrupt_out) {
+        *corrupt_out = 0;
+    }
+    if (!ctx || !input_path || (!aad && aad_len != 0)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    MappedFile input;
+    if (!map_file(input_path, false, 0, input)) {
+        unmap(input);
+        return AESGCMSIV_ERROR_IO;
+    }
+    aesgcmsiv_stream* stream = nullptr;
+    int result = input.size < AESGCMSIV_STREAM_HEADER_SIZE
+        ? AESGCMSIV_ERROR_INVALID_INPUT
+        : aesgcmsiv_stream_open_new(ctx, input.data, &stream);
+    // Version 2 is a compressed stream, whose records have no fixed offsets
+    if (result == AESGCMSIV_SUCCESS && input.data[0] != 1) {
+        result = AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (result != AESGCMSIV_SUCCESS) {
+        aesgcmsiv_stream_free(stream);
+        unmap(input);
+        return result;
+    }
+
+    // Laid out as aesgcmsiv_stream_open_file expects
+    const size_t full = aesgcmsiv_stream_chunk_size(stream) + static_cast<size_t>(AESGCMSIV_TAG_SIZE);
+    const size_t sealed_size = input.size - AESGCMSIV_STREAM_HEADER_SIZE;
+    const uint64_t chunks = (sealed_size + full - 1) / full;
+    const size_t last_sealed = sealed_size - static_cast<size_t>((chunks - 1) * full);
+    const size_t per_window = std::max<size_t>(1, kScrubWindow / full);
+    int* statuses = new (std::nothrow) int[per_window];
+
+    Scrubber scrub(input, max_bytes_per_second, callback, user);
+    if (!statuses) {
+        result = AESGCMSIV_ERROR_INTERNAL;
+    } else if (chunks == 0 || last_sealed < AESGCMSIV_TAG_SIZE || chunks - 1 > UINT32_MAX) {
+        // Truncated, or too long to be a stream: nothing can be verified
+        scrub.corrupt(AESGCMSIV_STREAM_HEADER_SIZE, sealed_size, AESGCMSIV_ERROR_DECRYPT_FAILED);
+    } else {
+        scrub.ahead(0);
+        for (uint64_t first = 0; first < chunks; first += per_window) {
+            const size_t n = static_cast<size_t>(std::min<uint64_t>(per_window, chunks - first));
+            const bool last = first + n == chunks;
+            const size_t offset = AESGCMSIV_STREAM_HEADER_SIZE + static_cast<size_t>(first * full);
+            const size_t length = last ? input.size - offset : n * full;
+            scrub.ahead(offset + length);
+            // Reported as failed if the call refuses the window outright
+            std::fill(statuses, statuses + n, AESGCMSIV_ERROR_INTERNAL);
+            aesgcmsiv_stream_verify_chunks(stream, first, n, input.data + offset, length,
+                aad, aad_len, last, statuses);
+            for (size_t j = 0; j < n; j++) {
+                if (statuses[j] != AESGCMSIV_SUCCESS) {
+                    scrub.corrupt(offset + j * full, last && j == n - 1 ? length - j * full : full, statuses[j]);
+                }
+            }
+            scrub.done(offset, length);
+        }
+    }
+    if (result == AESGCMSIV_SUCCESS) {
+        result = scrub.finish(corrupt_out);
+    }
+
+    delete[] statuses;
+    aesgcmsiv_stream_free(stream);
+    unmap(input);
+    return result;
+}
+
+int aesgcmsiv_ctx_encrypt_file(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const char* input_path,
+    const char* output_path,
+    const uint8_t* aad, size_t aad_len)
+{
+    if (!ctx || !input_path || !output_path || (!aad && aad_len != 0)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (!nonce || nonce_len != AESGCMSIV_NONCE_SIZE) {
+        return AESGCMSIV_ERROR_INVALID_NONCE;
+    }
+
+    MappedFile input;
+    if (!map_file(input_path, false, 0, input)) {
+        unmap(input);
+        return AESGCMSIV_ERROR_IO;
+    }
+    if (input.size > AESGCMSIV_MAX_INPUT_SIZE) {
+        unmap(input);
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    // The tag is a POLYVAL over the whole plaintext and the keystream is
+    // keyed by the tag, so the input is read twice: hashed, then encrypted.
+    // Nothing is held but the mappings, which the kernel pages in ahead of
+    // each pass and drops behind it.
+    MappedFile output;
+    int result = AESGCMSIV_SUCCESS;
+    if (!map_file(output_path, true, static_cast<uint64_t>(input.size) + AESGCMSIV_TAG_SIZE, output)) {
+        result = AESGCMSIV_ERROR_IO;
+    } else {
+        // An empty file has no mapping to point into
+        static const uint8_t empty = 0;
+        result = aesgcmsiv_ctx_encrypt(ctx, nonce, nonce_len,
+            input.data ? input.data : &empty, input.size, aad, aad_len,
+            output.data, output.data + input.size);
+    }
+
+    const bool created = output.created;
+    unmap(output);
+    unmap(input);
+    if (result != AESGCMSIV_SUCCESS && created) {
+        remove_file(output_path);
+    }
+    return result;
+}
+
+int aesgcmsiv_ctx_decrypt_file(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const char* input_path,
+    const char* output_path,
+    const uint8_t* aad, size_t aad_len)
+{
+    if (!ctx || !input_path || !output_path || (!aad && aad_len != 0)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (!nonce || nonce_len != AESGCMSIV_NONCE_SIZE) {
+        return AESGCMSIV_ERROR_INVALID_NONCE;
+    }
+
+    MappedFile input;
+    if (!map_file(input_path, false, 0, input)) {
+        unmap(input);
+        return AESGCMSIV_ERROR_IO;
+    }
+    if (input.size < AESGCMSIV_TAG_SIZE) {
+        unmap(input);
+        return AESGCMSIV_ERROR_DECRYPT_FAILED;
+    }
+    const size_t length = input.size - AESGCMSIV_TAG_SIZE;
+
+    // The plaintext goes to a provisional file beside the output, which only
+    // takes the output's name once the tag has verified; until then the
+    // output, if it exists, is untouched
+    std::string provisional;
+    MappedFile output;
+    int result = AESGCMSIV_SUCCESS;
+    if (!provisional_path(output_path, provisional)) {
+        result = AESGCMSIV_ERROR_INTERNAL;
+    } else if (!map_file(provisional.c_str(), true, length, output, true)) {
+        result = AESGCMSIV_ERROR_IO;
+    } else {
+        static uint8_t empty = 0;
+        result = aesgcmsiv_ctx_decrypt(ctx, nonce, nonce_len,
+            length != 0 ? input.data : &empty, length, aad, aad_len,
+            input.data + length, output.data ? output.data : &empty);
+    }
+
+    const bool created = output.created;
+    unmap(output);
+    unmap(input);
+    if (result == AESGCMSIV_SUCCESS && !rename_file(provisional.c_str(), output_path)) {
+        result = AESGCMSIV_ERROR_IO;
+    }
+    if (result != AESGCMSIV_SUCCESS && created) {
+        remove_file(provisional.c_str());
+    }
+    return result;
+}
+
+// Pack files. The index is sorted, so a lookup is a binary search over the
+// mapping that touches a few index pages; blobs are sealed and opened in
+// groups through the batch functions, so short ones share the multi-buffer
+// kernel and a large read spreads over the context's pool.
+
+struct aesgcmsiv_pack {
+    MappedFile file;
+    const uint8_t* index;
+    uint64_t count;
+    size_t id_size;
+    size_t entry_size;  // id, offset and length
+    uint64_t data_start;  // first byte after the index
+    uint8_t base_nonce[AESGCMSIV_NONCE_SIZE];
+};
+
+namespace {
+
+// Blobs sealed or opened per batch call, so the items fit on the stack
+constexpr size_t kPackGroup = 256;
+
+const uint8_t kPackMagic[4] = {'A', 'G', 'S', 'P'};
+constexpr uint8_t kPackVersion = 1;
+
+uint64_t load_le64(const uint8_t* p)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value |= static_cast<uint64_t>(p[i]) << (8 * i);
+    }
+    return value;
+}
+
+void store_le64(uint8_t* p, uint64_t value)
+{
+    for (int i = 0; i < 8; i++) {
+        p[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+// The nonce of index entry i, as aesgcmsiv_encrypt_batch_counter derives it
+void pack_nonce(const uint8_t* base, uint64_t i, uint8_t* nonce)
+{
+    memcpy(nonce, base, AESGCMSIV_NONCE_SIZE);
+    for (int b = 0; b < 8; b++) {
+        nonce[4 + b] ^= static_cast<uint8_t>(i >> (8 * b));
+    }
+}
+
+// Index of the entry holding id, or count if there is none
+uint64_t pack_search(const aesgcmsiv_pack* pack, const uint8_t* id)
+{
+    uint64_t low = 0;
+    uint64_t high = pack->count;
+    while (low < high) {
+        const uint64_t mid = low + (high - low) / 2;
+        const int order = memcmp(pack->index + mid * pack->entry_size, id, pack->id_size);
+        if (order == 0) {
+            return mid;
+        }
+        if (order < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return pack->count;
+}
+
+// Checks entry i lies within the file, returning where its sealed data
+// starts
+int pack_entry(const aesgcmsiv_pack* pack, uint64_t i, uint64_t* offset_out, size_t* length_out)
+{
+    const uint8_t* entry = pack->index + i * pack->entry_size;
+    const uint64_t offset = load_le64(entry + pack->id_size);
+    const uint64_t length = load_le64(entry + pack->id_size + 8);
+    const uint64_t size = pack->file.size;
+    // An entry that points outside the file was not written by the library
+    if (offset < pack->data_start || offset > size || length > AESGCMSIV_MAX_INPUT_SIZE ||
+        size - offset < length + AESGCMSIV_TAG_SIZE || length > SIZE_MAX) {
+        return AESGCMSIV_ERROR_DECRYPT_FAILED;
+    }
+    *offset_out = offset;
+    *length_out = static_cast<size_t>(length);
+    return AESGCMSIV_SUCCESS;
+}
+
+// Finds id and checks its entry, returning its index and where its sealed
+// data starts
+int pack_locate(const aesgcmsiv_pack* pack, const uint8_t* id, uint64_t* index_out, uint64_t* offset_out,
+    size_t* length_out)
+{
+    const uint64_t i = pack_search(pack, id);
+    if (i == pack->count) {
+        return AESGCMSIV_ERROR_NOT_FOUND;
+    }
+    *index_out = i;
+    return pack_entry(pack, i, offset_out, length_out);
+}
+
+}  // namespace
+
+int aesgcmsiv_pack_write_file(
+    aesgcmsiv_ctx* ctx,
+    const char* output_path,
+    size_t id_size,
+    size_t count,
+    const uint8_t* ids,
+    const uint8_t* const* blobs,
+    const size_t* blob_lens)
+{
+    if (!ctx || !output_path || id_size == 0 || id_size > AESGCMSIV_PACK_MAX_ID_SIZE ||
+        (count > 0 && (!ids || !blobs || !blob_lens))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    const size_t entry_size = id_size + 16;
+    if (count > (UINT64_MAX - AESGCMSIV_PACK_HEADER_SIZE) / entry_size) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    const uint64_t data_start = AESGCMSIV_PACK_HEADER_SIZE + static_cast<uint64_t>(count) * entry_size;
+    uint64_t size = data_start;
+    for (size_t i = 0; i < count; i++) {
+        if ((!blobs[i] && blob_lens[i] != 0) || blob_lens[i] > AESGCMSIV_MAX_INPUT_SIZE ||
+            UINT64_MAX - size < blob_lens[i] + AESGCMSIV_TAG_SIZE) {
+            return AESGCMSIV_ERROR_INVALID_INPUT;
+        }
+        size += blob_lens[i] + AESGCMSIV_TAG_SIZE;
+    }
+
+    // The index is written in id order, so the blobs are sealed in that
+    // order too and each lands right after the one before it
+    size_t* order = new (std::nothrow) size_t[count > 0 ? count : 1];
+    if (!order) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    for (size_t i = 0; i < count; i++) {
+        order[i] = i;
+    }
+    std::sort(order, order + count, [ids, id_size](size_t a, size_t b) {
+        return memcmp(ids + a * id_size, ids + b * id_size, id_size) < 0;
+    });
+    for (size_t i = 1; i < count; i++) {
+        if (memcmp(ids + order[i - 1] * id_size, ids + order[i] * id_size, id_size) == 0) {
+            delete[] order;
+            return AESGCMSIV_ERROR_INVALID_INPUT;
+        }
+    }
+
+    uint8_t base_nonce[AESGCMSIV_NONCE_SIZE];
+    MappedFile output;
+    int result = aesgcmsiv_random_nonce(base_nonce);
+    if (result == AESGCMSIV_SUCCESS && !map_file(output_path, true, size, output)) {
+        result = AESGCMSIV_ERROR_IO;
+    }
+
+    if (result == AESGCMSIV_SUCCESS) {
+        uint8_t* header = output.data;
+        memcpy(header, kPackMagic, sizeof(kPackMagic));
+        header[4] = kPackVersion;
+        header[5] = static_cast<uint8_t>(id_size);
+        header[6] = header[7] = 0;
+        store_le64(header + 8, count);
+        memcpy(header + 16, base_nonce, AESGCMSIV_NONCE_SIZE);
+        memset(header + 28, 0, 4);
+    }
+
+    uint64_t offset = data_start;
+    for (size_t first = 0; result == AESGCMSIV_SUCCESS && first < count; first += kPackGroup) {
+        const size_t n = std::min(kPackGroup, count - first);
+        aesgcmsiv_batch_item items[kPackGroup];
+        for (size_t j = 0; j < n; j++) {
+            const size_t blob = order[first + j];
+            uint8_t* entry = output.data + AESGCMSIV_PACK_HEADER_SIZE + (first + j) * entry_size;
+            memcpy(entry, ids + blob * id_size, id_size);
+            store_le64(entry + id_size, offset);
+            store_le64(entry + id_size + 8, blob_lens[blob]);
+
+            static const uint8_t empty = 0;
+            items[j].nonce = nullptr;
+            items[j].input = blobs[blob] ? blobs[blob] : &empty;
+            items[j].input_len = blob_lens[blob];
+            items[j].aad = entry;  // the id
+            items[j].aad_len = id_size;
+            items[j].output = output.data + offset;
+            items[j].tag = output.data + offset + blob_lens[blob];
+            offset += blob_lens[blob] + AESGCMSIV_TAG_SIZE;
+        }
+        result = aesgcmsiv_encrypt_batch_counter(ctx, n, items, base_nonce, first);
+    }
+
+    delete[] order;
+    const bool created = output.created;
+    unmap(output);
+    if (result != AESGCMSIV_SUCCESS && created) {
+        remove_file(output_path);
+    }
+    return result;
+}
+
+int aesgcmsiv_pack_open(const char* input_path, aesgcmsiv_pack** pack_out)
+{
+    if (!pack_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *pack_out = nullptr;
+    if (!input_path) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    aesgcmsiv_pack* pack = new (std::nothrow) aesgcmsiv_pack();
+    if (!pack) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    if (!map_file(input_path, false, 0, pack->file, false, Pattern::Random)) {
+        aesgcmsiv_pack_free(pack);
+        return AESGCMSIV_ERROR_IO;
+    }
+
+    const uint8_t* header = pack->file.data;
+    const size_t size = pack->file.size;
+    if (size < AESGCMSIV_PACK_HEADER_SIZE || memcmp(header, kPackMagic, sizeof(kPackMagic)) != 0 ||
+        header[4] != kPackVersion || header[5] == 0 || header[5] > AESGCMSIV_PACK_MAX_ID_SIZE) {
+        aesgcmsiv_pack_free(pack);
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    pack->id_size = header[5];
+    pack->entry_size = pack->id_size + 16;
+    pack->count = load_le64(header + 8);
+    if (pack->count > (size - AESGCMSIV_PACK_HEADER_SIZE) / pack->entry_size) {
+        aesgcmsiv_pack_free(pack);
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    pack->index = header + AESGCMSIV_PACK_HEADER_SIZE;
+    pack->data_start = AESGCMSIV_PACK_HEADER_SIZE + pack->count * pack->entry_size;
+    memcpy(pack->base_nonce, header + 16, AESGCMSIV_NONCE_SIZE);
+    *pack_out = pack;
+    return AESGCMSIV_SUCCESS;
+}
+
+uint64_t aesgcmsiv_pack_count(const aesgcmsiv_pack* pack)
+{
+    return pack ? pack->count : 0;
+}
+
+size_t aesgcmsiv_pack_id_size(const aesgcmsiv_pack* pack)
+{
+    return pack ? pack->id_size : 0;
+}
+
+int aesgcmsiv_pack_find(const aesgcmsiv_pack* pack, const uint8_t* id, size_t* length_out)
+{
+    if (!pack || !id || !length_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    uint64_t index, offset;
+    return pack_locate(pack, id, &index, &offset, length_out);
+}
+
+int aesgcmsiv_pack_read_batch(
+    aesgcmsiv_ctx* ctx,
+    const aesgcmsiv_pack* pack,
+    size_t count,
+    const uint8_t* ids,
+    uint8_t* const* outputs,
+    const size_t* output_lens,
+    size_t* lengths_out,
+    int* status_out)
+{
+    if (!ctx || !pack || (count > 0 && (!ids || !outputs || !output_lens || !status_out))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    int first_error = AESGCMSIV_SUCCESS;
+    for (size_t first = 0; first < count; first += kPackGroup) {
+        const size_t n = std::min(kPackGroup, count - first);
+        // Only the blobs found and with room go to the batch; slots maps
+        // each item back to its id
+        aesgcmsiv_batch_item items[kPackGroup];
+        uint8_t nonces[kPackGroup][AESGCMSIV_NONCE_SIZE];
+        size_t slots[kPackGroup];
+        int statuses[kPackGroup];
+        size_t found = 0;
+        for (size_t j = 0; j < n; j++) {
+            const size_t k = first + j;
+            const uint8_t* id = ids + k * pack->id_size;
+            uint64_t index, offset;
+            size_t length = 0;
+            int status = pack_locate(pack, id, &index, &offset, &length);
+            if (lengths_out) {
+                lengths_out[k] = length;
+            }
+            if (status == AESGCMSIV_SUCCESS && (output_lens[k] < length || (!outputs[k] && length != 0))) {
+                status = AESGCMSIV_ERROR_INVALID_INPUT;
+            }
+            status_out[k] = status;
+            if (status != AESGCMSIV_SUCCESS) {
+                continue;
+            }
+            static uint8_t empty = 0;
+            const uint8_t* sealed = pack->file.data + offset;
+            pack_nonce(pack->base_nonce, index, nonces[found]);
+            items[found].nonce = nonces[found];
+            items[found].input = sealed;
+            items[found].input_len = length;
+            items[found].aad = pack->index + index * pack->entry_size;
+            items[found].aad_len = pack->id_size;
+            items[found].output = outputs[k] ? outputs[k] : &empty;
+            items[found].tag = const_cast<uint8_t*>(sealed + length);
+            slots[found++] = k;
+        }
+        if (found > 0) {
+            aesgcmsiv_decrypt_batch(ctx, found, items, statuses);
+            for (size_t j = 0; j < found; j++) {
+                status_out[slots[j]] = statuses[j];
+            }
+        }
+        for (size_t j = 0; j < n && first_error == AESGCMSIV_SUCCESS; j++) {
+            first_error = status_out[first + j];
+        }
+    }
+    return first_error;
+}
+
+// The blobs lie in index order, so walking the index reads the file front
+// to back; a group ends at kPackGroup blobs or a window's worth of bytes
+int aesgcmsiv_pack_scrub(
+    aesgcmsiv_ctx* ctx,
+    const aesgcmsiv_pack* pack,
+    uint64_t max_bytes_per_second,
+    aesgcmsiv_scrub_callback callback, void* user,
+    uint64_t* corrupt_out)
+{
+    if (corrupt_out) {
+        *corrupt_out = 0;
+    }
+    if (!ctx || !pack) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    Scrubber scrub(pack->file, max_bytes_per_second, callback, user);
+    scrub.ahead(pack->data_start);
+    uint64_t i = 0;
+    while (i < pack->count) {
+        aesgcmsiv_batch_item items[kPackGroup];
+        uint8_t nonces[kPackGroup][AESGCMSIV_NONCE_SIZE];
+        uint64_t offsets[kPackGroup];
+        int statuses[kPackGroup];
+        size_t n = 0;
+        uint64_t low = UINT64_MAX, high = 0;
+        for (; i < pack->count && n < kPackGroup && (n == 0 || high - low < kScrubWindow); i++) {
+            uint64_t offset;
+            size_t length;
+            if (pack_entry(pack, i, &offset, &length) != AESGCMSIV_SUCCESS) {
+                scrub.corrupt(AESGCMSIV_PACK_HEADER_SIZE + i * pack->entry_size, pack->entry_size,
+                    AESGCMSIV_ERROR_DECRYPT_FAILED);
+                continue;
+            }
+            static uint8_t empty = 0;
+            const uint8_t* sealed = pack->file.data + offset;
+            pack_nonce(pack->base_nonce, i, nonces[n]);
+            items[n].nonce = nonces[n];
+            items[n].input = sealed;
+            items[n].input_len = length;
+            items[n].aad = pack->index + i * pack->entry_size;
+            items[n].aad_len = pack->id_size;
+            items[n].output = &empty;
+            items[n].tag = const_cast<uint8_t*>(sealed + length);
+            offsets[n++] = offset;
+            low = std::min(low, offset);
+            high = std::max(high, offset + length + AESGCMSIV_TAG_SIZE);
+        }
+        if (n == 0) {
+            continue;
+        }
+        scrub.ahead(high);
+        aesgcmsiv_verify_batch(ctx, n, items, statuses);
+        for (size_t j = 0; j < n; j++) {
+            if (statuses[j] != AESGCMSIV_SUCCESS) {
+                scrub.corrupt(offsets[j], items[j].input_len + AESGCMSIV_TAG_SIZE, statuses[j]);
+            }
+        }
+        scrub.done(low, high - low);
+    }
+    return scrub.finish(corrupt_out);
+}
+
+void aesgcmsiv_pack_free(aesgcmsiv_pack* pack)
+{
+    if (!pack) {
+        return;
+    }
+    unmap(pack->file);
+    delete pack;
+}
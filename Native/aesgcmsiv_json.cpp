@@ -0,0 +1,602 @@
+#include "aesgcmsiv.h"
+#include "aesgcmsiv_base64.h"
+#include "aesgcmsiv_kernels.h"
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <vector>
+
+// Field-level encryption of JSON documents. One scan validates the
+// document and records the span of every value the paths select; the values
+// are then sealed or opened with one batch call, and the output is put
+// together from the recorded spans. String bodies, which hold most of the
+// bytes of a typical document, are skipped 16 bytes at a time with SSE2 or
+// NEON. Only the public batch API and the base64url codec are used, so the
+// mock library builds this file as it is.
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AESGCMSIV_JSON_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define AESGCMSIV_JSON_NEON
+#include <arm_neon.h>
+#endif
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace {
+
+// Deeper nesting is rejected, which bounds the scanner's recursion
+constexpr size_t kMaxDepth = 512;
+
+// Characters the nonce takes at the front of a token
+constexpr size_t kNonceChars = AESGCMSIV_B64URL_LEN(AESGCMSIV_NONCE_SIZE);
+
+// One step of a path, or of the scanner's position: a member name as
+// written between its quotes, or nullptr for an array element
+struct segment {
+    const char* name;
+    size_t len;
+};
+
+// A selected value's text, as offsets into the document
+struct span {
+    size_t begin;
+    size_t end;
+};
+
+// Splits each path at '.'; false if a path or one of its segments is empty
+bool parse_paths(const char* const* paths, size_t count, std::vector<std::vector<segment>>& out)
+{
+    out.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        const char* path = paths[i];
+        if (!path || !*path) {
+            return false;
+        }
+        for (;;) {
+            const char* dot = strchr(path, '.');
+            const size_t len = dot ? static_cast<size_t>(dot - path) : strlen(path);
+            if (len == 0) {
+                return false;
+            }
+            out[i].push_back({path, len});
+            if (!dot) {
+                break;
+            }
+            path = dot + 1;
+        }
+    }
+    return true;
+}
+
+inline unsigned lowest_bit(unsigned mask)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+// The first quote, backslash or control character at or after i, or len
+size_t string_stop(const char* s, size_t i, size_t len)
+{
+#if defined(AESGCMSIV_JSON_SSE2)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1f);
+    for (; len - i >= 16; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        // Control characters are the bytes an unsigned min with 0x1f leaves as they are
+        const __m128i stop = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+            _mm_cmpeq_epi8(_mm_min_epu8(v, control), v));
+        const int mask = _mm_movemask_epi8(stop);
+        if (mask != 0) {
+            return i + lowest_bit(static_cast<unsigned>(mask));
+        }
+    }
+#elif defined(AESGCMSIV_JSON_NEON)
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+    const uint8x16_t control = vdupq_n_u8(0x20);
+    for (; len - i >= 16; i += 16) {
+        const uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(s + i));
+        const uint8x16_t stop = vorrq_u8(vorrq_u8(vceqq_u8(v, quote), vceqq_u8(v, backslash)), vcltq_u8(v, control));
+        if (vmaxvq_u8(stop) != 0) {
+            break;  // the loop below finds it within this block
+        }
+    }
+#endif
+    for (; i < len; i++) {
+        const unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c == '"' || c == '\\' || c < 0x20) {
+            return i;
+        }
+    }
+    return len;
+}
+
+inline bool is_hex(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+// Validates a document while recording the values the paths select. A
+// selected value is skipped whole, so nothing inside it is selected again.
+class scanner {
+public:
+    scanner(const char* json, size_t len, const std::vector<std::vector<segment>>& paths, std::vector<span>& fields)
+        : json_(json), len_(len), paths_(paths), fields_(fields)
+    {
+    }
+
+    // One value and nothing after it but whitespace
+    bool document()
+    {
+        if (!value(0, !paths_.empty())) {
+            return false;
+        }
+        skip_space();
+        return pos_ == len_;
+    }
+
+private:
+    enum match_result { kNone, kPrefix, kExact };
+
+    static bool segment_matches(const segment& pattern, const segment& step)
+    {
+        if (pattern.len == 1 && pattern.name[0] == '*') {
+            return true;
+        }
+        return step.name && step.len == pattern.len && memcmp(step.name, pattern.name, step.len) == 0;
+    }
+
+    // Whether a path selects the current position, or might select
+    // something below it
+    match_result match() const
+    {
+        match_result best = kNone;
+        for (const std::vector<segment>& path : paths_) {
+            if (path.size() < stack_.size()) {
+                continue;
+            }
+            bool same = true;
+            for (size_t i = 0; same && i < stack_.size(); i++) {
+                same = segment_matches(path[i], stack_[i]);
+            }
+            if (!same) {
+                continue;
+            }
+            if (path.size() == stack_.size()) {
+                return kExact;
+            }
+            best = kPrefix;
+        }
+        return best;
+    }
+
+    void skip_space()
+    {
+        while (pos_ < len_ && (json_[pos_] == ' ' || json_[pos_] == '\n' || json_[pos_] == '\r' || json_[pos_] == '\t')) {
+            pos_++;
+        }
+    }
+
+    bool value(size_t depth, bool tracking)
+    {
+        skip_space();
+        if (pos_ == len_) {
+            return false;
+        }
+        if (tracking) {
+            const match_result match_here = match();
+            if (match_here == kExact) {
+                const size_t begin = pos_;
+                if (!value(depth, false)) {
+                    return false;
+                }
+                fields_.push_back({begin, pos_});
+                return true;
+            }
+            tracking = match_here == kPrefix;
+        }
+        switch (json_[pos_]) {
+        case '{':
+            return depth < kMaxDepth && object(depth + 1, tracking);
+        case '[':
+            return depth < kMaxDepth && array(depth + 1, tracking);
+        case '"':
+            return string();
+        case 't':
+            return literal("true", 4);
+        case 'f':
+            return literal("false", 5);
+        case 'n':
+            return literal("null", 4);
+        default:
+            return number();
+        }
+    }
+
+    bool object(size_t depth, bool tracking)
+    {
+        pos_++;
+        skip_space();
+        if (pos_ < len_ && json_[pos_] == '}') {
+            pos_++;
+            return true;
+        }
+        for (;;) {
+            skip_space();
+            if (pos_ == len_ || json_[pos_] != '"') {
+                return false;
+            }
+            const size_t key = pos_ + 1;
+            if (!string()) {
+                return false;
+            }
+            const segment name = {json_ + key, pos_ - 1 - key};
+            skip_space();
+            if (pos_ == len_ || json_[pos_] != ':') {
+                return false;
+            }
+            pos_++;
+            if (tracking) {
+                stack_.push_back(name);
+            }
+            const bool ok = value(depth, tracking);
+            if (tracking) {
+                stack_.pop_back();
+            }
+            if (!ok) {
+                return false;
+            }
+            skip_space();
+            if (pos_ == len_) {
+                return false;
+            }
+            const char next = json_[pos_++];
+            if (next == '}') {
+                return true;
+            }
+            if (next != ',') {
+                return false;
+            }
+        }
+    }
+
+    bool array(size_t depth, bool tracking)
+    {
+        pos_++;
+        skip_space();
+        if (pos_ < len_ && json_[pos_] == ']') {
+            pos_++;
+            return true;
+        }
+        for (;;) {
+            if (tracking) {
+                stack_.push_back({nullptr, 0});
+            }
+            const bool ok = value(depth, tracking);
+            if (tracking) {
+                stack_.pop_back();
+            }
+            if (!ok) {
+                return false;
+            }
+            skip_space();
+            if (pos_ == len_) {
+                return false;
+            }
+            const char next = json_[pos_++];
+            if (next == ']') {
+                return true;
+            }
+            if (next != ',') {
+                return false;
+            }
+        }
+    }
+
+    bool string()
+    {
+        pos_++;
+        for (;;) {
+            pos_ = string_stop(json_, pos_, len_);
+            if (pos_ == len_) {
+                return false;
+            }
+            const char c = json_[pos_++];
+            if (c == '"') {
+                return true;
+            }
+            if (c != '\\' || pos_ == len_) {
+                return false;  // a control character, or a backslash at the end
+            }
+            const char escape = json_[pos_++];
+            if (escape == 'u') {
+                if (len_ - pos_ < 4 || !is_hex(json_[pos_]) || !is_hex(json_[pos_ + 1]) ||
+                    !is_hex(json_[pos_ + 2]) || !is_hex(json_[pos_ + 3])) {
+                    return false;
+                }
+                pos_ += 4;
+            } else if (escape == '\0' || !strchr("\"\\/bfnrt", escape)) {
+                return false;
+            }
+        }
+    }
+
+    bool literal(const char* word, size_t len)
+    {
+        if (len_ - pos_ < len || memcmp(json_ + pos_, word, len) != 0) {
+            return false;
+        }
+        pos_ += len;
+        return true;
+    }
+
+    // One or more digits
+    bool digits()
+    {
+        const size_t start = pos_;
+        while (pos_ < len_ && json_[pos_] >= '0' && json_[pos_] <= '9') {
+            pos_++;
+        }
+        return pos_ > start;
+    }
+
+    bool number()
+    {
+        if (json_[pos_] == '-') {
+            pos_++;
+        }
+        if (pos_ < len_ && json_[pos_] == '0') {
+            pos_++;
+        } else if (!digits()) {
+            return false;
+        }
+        if (pos_ < len_ && json_[pos_] == '.') {
+            pos_++;
+            if (!digits()) {
+                return false;
+            }
+        }
+        if (pos_ < len_ && (json_[pos_] == 'e' || json_[pos_] == 'E')) {
+            pos_++;
+            if (pos_ < len_ && (json_[pos_] == '+' || json_[pos_] == '-')) {
+                pos_++;
+            }
+            if (!digits()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const char* json_;
+    size_t len_;
+    size_t pos_ = 0;
+    const std::vector<std::vector<segment>>& paths_;
+    std::vector<span>& fields_;
+    std::vector<segment> stack_;
+};
+
+bool overlaps(const char* a, size_t a_len, const char* b, size_t b_len)
+{
+    const uintptr_t a_begin = reinterpret_cast<uintptr_t>(a);
+    const uintptr_t b_begin = reinterpret_cast<uintptr_t>(b);
+    return a_len > 0 && b_len > 0 && a_begin < b_begin + b_len && b_begin < a_begin + a_len;
+}
+
+// Checks the arguments both calls share and scans the document into fields
+int scan(
+    aesgcmsiv_ctx* ctx, const char* json, size_t json_len, const char* const* paths, size_t path_count,
+    const uint8_t* aad, size_t aad_len, size_t* out_len_out, std::vector<span>& fields)
+{
+    if (!out_len_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *out_len_out = 0;
+    std::vector<std::vector<segment>> parsed;
+    if (!ctx || !json || (path_count > 0 && !paths) || (aad_len > 0 && !aad) ||
+        !parse_paths(paths, path_count, parsed) ||
+        !scanner(json, json_len, parsed, fields).document()) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+uint32_t cpu_features()
+{
+    const char* name;
+    uint32_t features = 0;
+    aesgcmsiv_get_backend(&name, &features);
+    return features;
+}
+
+int seal_fields(
+    aesgcmsiv_ctx* ctx, const char* json, size_t json_len, const char* const* paths, size_t path_count,
+    const uint8_t* aad, size_t aad_len, char* out, size_t out_capacity, size_t* out_len_out)
+{
+    std::vector<span> fields;
+    int result = scan(ctx, json, json_len, paths, path_count, aad, aad_len, out_len_out, fields);
+    if (result != AESGCMSIV_SUCCESS) {
+        return result;
+    }
+
+    // Each value becomes a quoted token
+    size_t needed = json_len;
+    for (const span& field : fields) {
+        const size_t len = field.end - field.begin;
+        if (len > AESGCMSIV_MAX_INPUT_SIZE) {
+            return AESGCMSIV_ERROR_INVALID_INPUT;
+        }
+        const size_t grows = AESGCMSIV_TOKEN_LEN(len) + 2 - len;
+        if (grows > SIZE_MAX - needed) {
+            return AESGCMSIV_ERROR_INVALID_INPUT;
+        }
+        needed += grows;
+    }
+    *out_len_out = needed;
+    if (!out || out_capacity < needed || overlaps(json, json_len, out, needed)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    // Lay the output out, with each value sealed into the tail of its
+    // token's characters so the encoder can run forward over it
+    std::vector<uint8_t> nonces(fields.size() * AESGCMSIV_NONCE_SIZE);
+    std::vector<aesgcmsiv_batch_item> items(fields.size());
+    std::vector<char*> tokens(fields.size());
+    char* next = out;
+    size_t copied = 0;
+    for (size_t i = 0; i < fields.size(); i++) {
+        const span& field = fields[i];
+        memcpy(next, json + copied, field.begin - copied);
+        next += field.begin - copied;
+        const size_t len = field.end - field.begin;
+        const size_t sealed_len = len + AESGCMSIV_TAG_SIZE;
+        const size_t encoded_len = AESGCMSIV_B64URL_LEN(sealed_len);
+        *next++ = '"';
+        tokens[i] = next;
+        uint8_t* sealed = reinterpret_cast<uint8_t*>(next + kNonceChars + (encoded_len - sealed_len));
+        uint8_t* nonce = nonces.data() + i * AESGCMSIV_NONCE_SIZE;
+        result = aesgcmsiv_random_nonce(nonce);
+        if (result != AESGCMSIV_SUCCESS) {
+            *out_len_out = 0;
+            return result;
+        }
+        items[i].nonce = nonce;
+        items[i].input = reinterpret_cast<const uint8_t*>(json + field.begin);
+        items[i].input_len = len;
+        items[i].aad = aad;
+        items[i].aad_len = aad_len;
+        items[i].output = sealed;
+        items[i].tag = sealed + len;
+        next += kNonceChars + encoded_len;
+        *next++ = '"';
+        copied = field.end;
+    }
+    memcpy(next, json + copied, json_len - copied);
+
+    result = aesgcmsiv_encrypt_batch(ctx, items.size(), items.data());
+    if (result != AESGCMSIV_SUCCESS) {
+        *out_len_out = 0;
+        return result;
+    }
+    const uint32_t features = cpu_features();
+    for (size_t i = 0; i < fields.size(); i++) {
+        aesgcmsiv_b64url_encode(features, items[i].nonce, AESGCMSIV_NONCE_SIZE, tokens[i]);
+        aesgcmsiv_b64url_encode(features, items[i].output, items[i].input_len + AESGCMSIV_TAG_SIZE, tokens[i] + kNonceChars);
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int open_fields(
+    aesgcmsiv_ctx* ctx, const char* json, size_t json_len, const char* const* paths, size_t path_count,
+    const uint8_t* aad, size_t aad_len, char* out, size_t out_capacity, size_t* out_len_out)
+{
+    std::vector<span> fields;
+    int result = scan(ctx, json, json_len, paths, path_count, aad, aad_len, out_len_out, fields);
+    if (result != AESGCMSIV_SUCCESS) {
+        return result;
+    }
+
+    // Each quoted token becomes the value it sealed
+    std::vector<size_t> sealed_lens(fields.size());
+    size_t needed = json_len;
+    size_t sealed_total = 0;
+    for (size_t i = 0; i < fields.size(); i++) {
+        const span& field = fields[i];
+        const size_t len = field.end - field.begin;
+        if (json[field.begin] != '"' || len - 2 < kNonceChars ||
+            !aesgcmsiv_b64url_decoded_len(len - 2 - kNonceChars, &sealed_lens[i]) ||
+            sealed_lens[i] < AESGCMSIV_TAG_SIZE) {
+            return AESGCMSIV_ERROR_DECRYPT_FAILED;
+        }
+        needed -= len - (sealed_lens[i] - AESGCMSIV_TAG_SIZE);
+        sealed_total += sealed_lens[i];
+    }
+    *out_len_out = needed;
+    if (!out || out_capacity < needed || overlaps(json, json_len, out, needed)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    std::vector<uint8_t> nonces(fields.size() * AESGCMSIV_NONCE_SIZE);
+    std::vector<uint8_t> sealed(sealed_total);
+    std::vector<aesgcmsiv_batch_item> items(fields.size());
+    std::vector<int> statuses(fields.size());
+    const uint32_t features = cpu_features();
+    char* next = out;
+    size_t copied = 0;
+    size_t decoded = 0;
+    for (size_t i = 0; i < fields.size(); i++) {
+        const span& field = fields[i];
+        const char* token = json + field.begin + 1;
+        const size_t plaintext_len = sealed_lens[i] - AESGCMSIV_TAG_SIZE;
+        uint8_t* nonce = nonces.data() + i * AESGCMSIV_NONCE_SIZE;
+        uint8_t* ciphertext = sealed.data() + decoded;
+        if (!aesgcmsiv_b64url_decode(features, token, kNonceChars, nonce) ||
+            !aesgcmsiv_b64url_decode(features, token + kNonceChars, field.end - field.begin - 2 - kNonceChars, ciphertext)) {
+            *out_len_out = 0;
+            return AESGCMSIV_ERROR_DECRYPT_FAILED;
+        }
+        memcpy(next, json + copied, field.begin - copied);
+        next += field.begin - copied;
+        items[i].nonce = nonce;
+        items[i].input = ciphertext;
+        items[i].input_len = plaintext_len;
+        items[i].aad = aad;
+        items[i].aad_len = aad_len;
+        items[i].output = reinterpret_cast<uint8_t*>(next);
+        items[i].tag = ciphertext + plaintext_len;
+        next += plaintext_len;
+        decoded += sealed_lens[i];
+        copied = field.end;
+    }
+    memcpy(next, json + copied, json_len - copied);
+
+    result = aesgcmsiv_decrypt_batch(ctx, items.size(), items.data(), statuses.data());
+    if (result != AESGCMSIV_SUCCESS) {
+        // Fields that did verify must not be left behind
+        aesgcmsiv_secure_zero(out, needed);
+        *out_len_out = 0;
+    }
+    return result;
+}
+
+}  // namespace
+
+int aesgcmsiv_json_seal_fields(
+    aesgcmsiv_ctx* ctx,
+    const char* json, size_t json_len,
+    const char* const* paths, size_t path_count,
+    const uint8_t* aad, size_t aad_len,
+    char* out, size_t out_capacity,
+    size_t* out_len_out)
+{
+    try {
+        return seal_fields(ctx, json, json_len, paths, path_count, aad, aad_len, out, out_capacity, out_len_out);
+    } catch (const std::bad_alloc&) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+}
+
+int aesgcmsiv_json_open_fields(
+    aesgcmsiv_ctx* ctx,
+    const char* json, size_t json_len,
+    const char* const* paths, size_t path_count,
+    const uint8_t* aad, size_t aad_len,
+    char* out, size_t out_capacity,
+    size_t* out_len_out)
+{
+    try {
+        return open_fields(ctx, json, json_len, paths, path_count, aad, aad_len, out, out_capacity, out_len_out);
+    } catch (const std::bad_alloc&) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+}
@@ -0,0 +1,1543 @@
+#include "aesgcmsiv_kernels.h"
+#include "aesgcmsiv.h"
+#include "aesgcmsiv_pool.h"
+#include "aesgcmsiv_stats.h"
+#include "aesgcmsiv_xxh3.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// RFC 8452 assembled from a kernel's primitives. Only the bulk loops
+// (POLYVAL and CTR) are performance critical; the per-message glue here runs
+// a constant number of times per call. Phases are marked for the profile
+// behind aesgcmsiv_get_profile: derivation and the tag wherever one message
+// is handled, POLYVAL and CTR on the single-message paths.
+
+// Absorbs data zero-padded to a multiple of 16 bytes.
+static void polyval_padded(
+    const aesgcmsiv_kernel* kernel, polyval_state* pv,
+    const uint8_t* data, size_t len)
+{
+    if (len == 0) {
+        return;
+    }
+    kernel->polyval_blocks(pv, data, len / 16);
+    size_t rem = len % 16;
+    if (rem) {
+        alignas(16) uint8_t last[16] = {0};
+        memcpy(last, data + (len - rem), rem);
+        kernel->polyval_blocks(pv, last, 1);
+        aesgcmsiv_secure_zero(last, sizeof(last));
+    }
+}
+
+static size_t padded_blocks(size_t len)
+{
+    return (len + 15) / 16;
+}
+
+// Counter block `blocks` blocks after counter; the 32-bit word wraps. out
+// may be counter itself.
+static void advance_counter(const uint8_t* counter, size_t blocks, uint8_t* out)
+{
+    memmove(out, counter, 16);
+    uint32_t ctr = static_cast<uint32_t>(out[0]) |
+        (static_cast<uint32_t>(out[1]) << 8) |
+        (static_cast<uint32_t>(out[2]) << 16) |
+        (static_cast<uint32_t>(out[3]) << 24);
+    ctr += static_cast<uint32_t>(blocks);
+    for (int b = 0; b < 4; b++) {
+        out[b] = static_cast<uint8_t>(ctr >> (8 * b));
+    }
+}
+
+// Length block: bit lengths of AAD and message, little-endian
+static void length_block(uint64_t aad_len, uint64_t msg_len, uint8_t* out)
+{
+    uint64_t aad_bits = static_cast<uint64_t>(aad_len) * 8;
+    uint64_t msg_bits = static_cast<uint64_t>(msg_len) * 8;
+    for (int i = 0; i < 8; i++) {
+        out[i] = static_cast<uint8_t>(aad_bits >> (8 * i));
+        out[8 + i] = static_cast<uint8_t>(msg_bits >> (8 * i));
+    }
+}
+
+// Turns the POLYVAL result into the tag.
+static void finish_tag(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* enc_ks,
+    const uint8_t* polyval, const uint8_t* nonce,
+    uint8_t* tag_out)
+{
+    PhaseScope phase(AESGCMSIV_PHASE_TAG);
+    alignas(16) uint8_t s[16];
+    memcpy(s, polyval, sizeof(s));
+    for (int i = 0; i < AESGCMSIV_NONCE_SIZE; i++) {
+        s[i] ^= nonce[i];
+    }
+    s[15] &= 0x7f;
+    kernel->encrypt_block(enc_ks, s, tag_out);
+    aesgcmsiv_secure_zero(s, sizeof(s));
+}
+
+// True for the sizes seal_small and open_small take. The length test
+// wraps at zero, and both tests combine into one branch.
+static inline bool takes_small(const aesgcmsiv_kernel* kernel, size_t msg_len, size_t aad_len)
+{
+    return ((msg_len - 1 < AESGCMSIV_SMALL_MAX_BYTES) & (aad_len <= AESGCMSIV_SMALL_MAX_AAD)) &&
+        kernel->seal_small;
+}
+
+static void compute_tag(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* enc_ks, const uint8_t* auth_key,
+    const uint8_t* nonce,
+    const uint8_t* msg, size_t msg_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* tag_out)
+{
+    polyval_state pv;
+    {
+        PhaseScope phase(AESGCMSIV_PHASE_POLYVAL);
+        kernel->polyval_init(&pv, auth_key, padded_blocks(aad_len) + padded_blocks(msg_len) + 1);
+        polyval_padded(kernel, &pv, aad, aad_len);
+        polyval_padded(kernel, &pv, msg, msg_len);
+
+        alignas(16) uint8_t lengths[16];
+        length_block(aad_len, msg_len, lengths);
+        kernel->polyval_blocks(&pv, lengths, 1);
+    }
+
+    finish_tag(kernel, enc_ks, pv.s, nonce, tag_out);
+    aesgcmsiv_secure_zero(&pv, sizeof(pv));
+}
+
+int kernel_seal_derived(
+    const aesgcmsiv_kernel* kernel,
+    const uint8_t* auth_key, const aes_key_schedule* enc_ks,
+    const uint8_t* nonce,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out)
+{
+    if (takes_small(kernel, plaintext_len, aad_len)) {
+        PhaseScope phase(AESGCMSIV_PHASE_FUSED);
+        kernel->seal_small(auth_key, enc_ks, nonce, plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out);
+        return AESGCMSIV_SUCCESS;
+    }
+    if (plaintext_len == 0) {
+        // Authentication only: POLYVAL over the AAD and the tag, with no
+        // counter block and no keystream
+        compute_tag(kernel, enc_ks, auth_key, nonce, nullptr, 0, aad, aad_len, tag_out);
+        return AESGCMSIV_SUCCESS;
+    }
+
+    alignas(16) uint8_t tag[16];
+    compute_tag(kernel, enc_ks, auth_key, nonce, plaintext, plaintext_len, aad, aad_len, tag);
+
+    // The tag with its top bit set is the initial counter block
+    alignas(16) uint8_t counter[16];
+    memcpy(counter, tag, sizeof(counter));
+    counter[15] |= 0x80;
+    {
+        PhaseScope phase(AESGCMSIV_PHASE_CTR);
+        kernel->ctr32(enc_ks, counter, plaintext, ciphertext_out, plaintext_len);
+    }
+    memcpy(tag_out, tag, AESGCMSIV_TAG_SIZE);
+    return AESGCMSIV_SUCCESS;
+}
+
+int kernel_seal(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* ks,
+    const uint8_t* nonce,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out)
+{
+    alignas(16) uint8_t auth_key[16];
+    aes_key_schedule enc_ks;
+    {
+        PhaseScope phase(AESGCMSIV_PHASE_DERIVE);
+        kernel->derive_keys(ks, nonce, auth_key, &enc_ks);
+    }
+
+    int result = kernel_seal_derived(kernel, auth_key, &enc_ks, nonce,
+        plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out);
+
+    aesgcmsiv_secure_zero(&enc_ks, sizeof(enc_ks));
+    aesgcmsiv_secure_zero(auth_key, sizeof(auth_key));
+    return result;
+}
+
+// Plaintext taken at a time by kernel_seal_hashed: the hash and POLYVAL
+// both read it, and it is small enough to still be in L1 for the second
+static const size_t hashed_chunk_blocks = 16;
+
+int kernel_seal_hashed(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* ks,
+    const uint8_t* nonce,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out,
+    uint32_t cpu_features,
+    uint64_t* hash_out)
+{
+    // A short plaintext is hashed in a few loads, before ciphertext_out,
+    // which may be the same buffer, is written
+    if (plaintext_len <= XXH3_MIDSIZE_MAX) {
+        *hash_out = aesgcmsiv_xxh3_64(cpu_features, plaintext, plaintext_len);
+        return kernel_seal(kernel, ks, nonce, plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out);
+    }
+
+    alignas(16) uint8_t auth_key[16];
+    aes_key_schedule enc_ks;
+    {
+        PhaseScope phase(AESGCMSIV_PHASE_DERIVE);
+        kernel->derive_keys(ks, nonce, auth_key, &enc_ks);
+    }
+
+    polyval_state pv;
+    {
+        PhaseScope phase(AESGCMSIV_PHASE_POLYVAL);
+        kernel->polyval_init(&pv, auth_key, padded_blocks(aad_len) + padded_blocks(plaintext_len) + 1);
+        polyval_padded(kernel, &pv, aad, aad_len);
+        xxh3_state hash;
+        aesgcmsiv_xxh3_init(&hash, cpu_features);
+        const size_t hash_blocks = aesgcmsiv_xxh3_block_count(plaintext_len);
+        for (size_t block = 0; block < hash_blocks; block += hashed_chunk_blocks) {
+            const size_t blocks = std::min(hashed_chunk_blocks, hash_blocks - block);
+            const uint8_t* chunk = plaintext + block * XXH3_BLOCK_SIZE;
+            aesgcmsiv_xxh3_blocks(&hash, chunk, blocks);
+            kernel->polyval_blocks(&pv, chunk, blocks * (XXH3_BLOCK_SIZE / 16));
+        }
+        const size_t hashed = hash_blocks * XXH3_BLOCK_SIZE;
+        polyval_padded(kernel, &pv, plaintext + hashed, plaintext_len - hashed);
+        *hash_out = aesgcmsiv_xxh3_finish(&hash, plaintext, plaintext_len, hash_blocks);
+    }
+
+    alignas(16) uint8_t tag[16];
+    kernel_absorbed_tag(kernel, &pv, aad_len, plaintext_len, &enc_ks, nonce, tag);
+    alignas(16) uint8_t counter[16];
+    memcpy(counter, tag, sizeof(counter));
+    counter[15] |= 0x80;
+    {
+        PhaseScope phase(AESGCMSIV_PHASE_CTR);
+        kernel->ctr32(&enc_ks, counter, plaintext, ciphertext_out, plaintext_len);
+    }
+    memcpy(tag_out, tag, AESGCMSIV_TAG_SIZE);
+
+    aesgcmsiv_secure_zero(&enc_ks, sizeof(enc_ks));
+    aesgcmsiv_secure_zero(auth_key, sizeof(auth_key));
+    return AESGCMSIV_SUCCESS;
+}
+
+int kernel_open_derived(
+    const aesgcmsiv_kernel* kernel,
+    const uint8_t* auth_key, const aes_key_schedule* enc_ks,
+    const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out)
+{
+    if (takes_small(kernel, ciphertext_len, aad_len)) {
+        PhaseScope phase(AESGCMSIV_PHASE_FUSED);
+        return kernel->open_small(auth_key, enc_ks, nonce, ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out);
+    }
+
+    alignas(16) uint8_t expected[16];
+    if (ciphertext_len == 0) {
+        compute_tag(kernel, enc_ks, auth_key, nonce, nullptr, 0, aad, aad_len, expected);
+        return aesgcmsiv_tags_equal(expected, tag) ? AESGCMSIV_SUCCESS : AESGCMSIV_ERROR_DECRYPT_FAILED;
+    }
+
+    // The received tag is the initial counter block
+    alignas(16) uint8_t counter[16];
+    memcpy(counter, tag, sizeof(counter));
+    counter[15] |= 0x80;
+
+    if (kernel->ctr32_polyval) {
+        // AAD first, then the plaintext as the fused loop produces it
+        polyval_state pv;
+        {
+            PhaseScope phase(AESGCMSIV_PHASE_POLYVAL);
+            kernel->polyval_init(&pv, auth_key, padded_blocks(aad_len) + padded_blocks(ciphertext_len) + 1);
+            polyval_padded(kernel, &pv, aad, aad_len);
+        }
+        {
+            PhaseScope phase(AESGCMSIV_PHASE_FUSED);
+            kernel->ctr32_polyval(enc_ks, counter, ciphertext, plaintext_out, ciphertext_len, &pv);
+        }
+
+        alignas(16) uint8_t lengths[16];
+        length_block(aad_len, ciphertext_len, lengths);
+        {
+            PhaseScope phase(AESGCMSIV_PHASE_POLYVAL);
+            kernel->polyval_blocks(&pv, lengths, 1);
+        }
+        finish_tag(kernel, enc_ks, pv.s, nonce, expected);
+        aesgcmsiv_secure_zero(&pv, sizeof(pv));
+    } else {
+        {
+            PhaseScope phase(AESGCMSIV_PHASE_CTR);
+            kernel->ctr32(enc_ks, counter, ciphertext, plaintext_out, ciphertext_len);
+        }
+        compute_tag(kernel, enc_ks, auth_key, nonce, plaintext_out, ciphertext_len, aad, aad_len, expected);
+    }
+
+    if (!aesgcmsiv_tags_equal(expected, tag)) {
+        // Never release unauthenticated plaintext
+        aesgcmsiv_secure_zero(plaintext_out, ciphertext_len);
+        return AESGCMSIV_ERROR_DECRYPT_FAILED;
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int kernel_seal_absorbed(
+    const aesgcmsiv_kernel* kernel,
+    polyval_state* pv, size_t aad_len,
+    const aes_key_schedule* enc_ks,
+    const uint8_t* nonce,
+    const uint8_t* plaintext, size_t plaintext_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out)
+{
+    polyval_padded(kernel, pv, plaintext, plaintext_len);
+    alignas(16) uint8_t tag[16];
+    kernel_absorbed_tag(kernel, pv, aad_len, plaintext_len, enc_ks, nonce, tag);
+    if (plaintext_len) {
+        alignas(16) uint8_t counter[16];
+        memcpy(counter, tag, sizeof(counter));
+        counter[15] |= 0x80;
+        kernel->ctr32(enc_ks, counter, plaintext, ciphertext_out, plaintext_len);
+    }
+    memcpy(tag_out, tag, AESGCMSIV_TAG_SIZE);
+    return AESGCMSIV_SUCCESS;
+}
+
+void kernel_absorbed_tag(
+    const aesgcmsiv_kernel* kernel,
+    polyval_state* pv, uint64_t aad_len, uint64_t msg_len,
+    const aes_key_schedule* enc_ks,
+    const uint8_t* nonce,
+    uint8_t* tag_out)
+{
+    alignas(16) uint8_t lengths[16];
+    length_block(aad_len, msg_len, lengths);
+    kernel->polyval_blocks(pv, lengths, 1);
+    finish_tag(kernel, enc_ks, pv->s, nonce, tag_out);
+    aesgcmsiv_secure_zero(pv, sizeof(*pv));
+}
+
+int kernel_open_absorbed(
+    const aesgcmsiv_kernel* kernel,
+    polyval_state* pv, size_t aad_len,
+    const aes_key_schedule* enc_ks,
+    const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out)
+{
+    if (ciphertext_len) {
+        alignas(16) uint8_t counter[16];
+        memcpy(counter, tag, sizeof(counter));
+        counter[15] |= 0x80;
+        if (kernel->ctr32_polyval) {
+            kernel->ctr32_polyval(enc_ks, counter, ciphertext, plaintext_out, ciphertext_len, pv);
+        } else {
+            kernel->ctr32(enc_ks, counter, ciphertext, plaintext_out, ciphertext_len);
+            polyval_padded(kernel, pv, plaintext_out, ciphertext_len);
+        }
+    }
+    alignas(16) uint8_t expected[16];
+    kernel_absorbed_tag(kernel, pv, aad_len, ciphertext_len, enc_ks, nonce, expected);
+    if (!aesgcmsiv_tags_equal(expected, tag)) {
+        // Never release unauthenticated plaintext
+        aesgcmsiv_secure_zero(plaintext_out, ciphertext_len);
+        return AESGCMSIV_ERROR_DECRYPT_FAILED;
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int kernel_open(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* ks,
+    const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out)
+{
+    alignas(16) uint8_t auth_key[16];
+    aes_key_schedule enc_ks;
+    {
+        PhaseScope phase(AESGCMSIV_PHASE_DERIVE);
+        kernel->derive_keys(ks, nonce, auth_key, &enc_ks);
+    }
+
+    int result = kernel_open_derived(kernel, auth_key, &enc_ks, nonce,
+        ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out);
+
+    aesgcmsiv_secure_zero(&enc_ks, sizeof(enc_ks));
+    aesgcmsiv_secure_zero(auth_key, sizeof(auth_key));
+    return result;
+}
+
+// Plaintext scratch of kernel_verify_derived: a whole number of blocks, and
+// small enough to stay in L1 while it is rewritten chunk after chunk
+static const size_t verify_scratch_bytes = 2048;
+
+int kernel_verify_derived(
+    const aesgcmsiv_kernel* kernel,
+    const uint8_t* auth_key, const aes_key_schedule* enc_ks,
+    const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag)
+{
+    alignas(64) uint8_t scratch[verify_scratch_bytes];
+    if (ciphertext_len == 0 || takes_small(kernel, ciphertext_len, aad_len)) {
+        int result = kernel_open_derived(kernel, auth_key, enc_ks, nonce,
+            ciphertext, ciphertext_len, aad, aad_len, tag, ciphertext_len ? scratch : nullptr);
+        aesgcmsiv_secure_zero(scratch, ciphertext_len);
+        return result;
+    }
+
+    alignas(16) uint8_t counter[16];
+    memcpy(counter, tag, sizeof(counter));
+    counter[15] |= 0x80;
+
+    polyval_state pv;
+    kernel->polyval_init(&pv, auth_key, padded_blocks(aad_len) + padded_blocks(ciphertext_len) + 1);
+    polyval_padded(kernel, &pv, aad, aad_len);
+    for (size_t offset = 0; offset < ciphertext_len; offset += verify_scratch_bytes) {
+        size_t len = std::min(verify_scratch_bytes, ciphertext_len - offset);
+        if (kernel->ctr32_polyval) {
+            kernel->ctr32_polyval(enc_ks, counter, ciphertext + offset, scratch, len, &pv);
+        } else {
+            kernel->ctr32(enc_ks, counter, ciphertext + offset, scratch, len);
+            polyval_padded(kernel, &pv, scratch, len);
+        }
+        advance_counter(counter, verify_scratch_bytes / 16, counter);
+    }
+    aesgcmsiv_secure_zero(scratch, std::min(verify_scratch_bytes, ciphertext_len));
+
+    alignas(16) uint8_t expected[16];
+    kernel_absorbed_tag(kernel, &pv, aad_len, ciphertext_len, enc_ks, nonce, expected);
+    return aesgcmsiv_tags_equal(expected, tag) ? AESGCMSIV_SUCCESS : AESGCMSIV_ERROR_DECRYPT_FAILED;
+}
+
+int kernel_verify(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* ks,
+    const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag)
+{
+    alignas(16) uint8_t auth_key[16];
+    aes_key_schedule enc_ks;
+    {
+        PhaseScope phase(AESGCMSIV_PHASE_DERIVE);
+        kernel->derive_keys(ks, nonce, auth_key, &enc_ks);
+    }
+
+    int result = kernel_verify_derived(kernel, auth_key, &enc_ks, nonce,
+        ciphertext, ciphertext_len, aad, aad_len, tag);
+
+    aesgcmsiv_secure_zero(&enc_ks, sizeof(enc_ks));
+    aesgcmsiv_secure_zero(auth_key, sizeof(auth_key));
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+// Multi-buffer batches
+// ---------------------------------------------------------------------------
+
+std::atomic<size_t> kernel_lane_max_blocks(AESGCMSIV_LANE_MAX_BLOCKS);
+
+static bool fits_lane(const aesgcmsiv_batch_item& item, size_t max_blocks)
+{
+    return padded_blocks(item.aad_len) + padded_blocks(item.input_len) + 1 <= max_blocks;
+}
+
+// compute_tag for one message per lane. Each lane's AAD, message and length
+// block are laid out in a padded buffer so the POLYVAL chains can run side
+// by side.
+static void compute_tag_lanes(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* enc_ks, const uint8_t (*auth_keys)[16],
+    const aesgcmsiv_batch_item* const* lane,
+    const uint8_t* const* msg,
+    uint8_t (*tags_out)[16])
+{
+    alignas(16) uint8_t stream[AESGCMSIV_LANES][AESGCMSIV_LANE_MAX_BLOCKS * 16];
+    const uint8_t* data[AESGCMSIV_LANES];
+    size_t blocks[AESGCMSIV_LANES];
+    for (int l = 0; l < AESGCMSIV_LANES; l++) {
+        const aesgcmsiv_batch_item& item = *lane[l];
+        const size_t aad_blocks = padded_blocks(item.aad_len);
+        blocks[l] = aad_blocks + padded_blocks(item.input_len) + 1;
+        data[l] = stream[l];
+        memset(stream[l], 0, blocks[l] * 16);
+        if (item.aad_len) {
+            memcpy(stream[l], item.aad, item.aad_len);
+        }
+        if (item.input_len) {
+            memcpy(stream[l] + aad_blocks * 16, msg[l], item.input_len);
+        }
+        length_block(item.aad_len, item.input_len, stream[l] + (blocks[l] - 1) * 16);
+    }
+
+    alignas(16) uint8_t s[AESGCMSIV_LANES][16];
+    kernel->polyval_lanes(auth_keys, data, blocks, s);
+    for (int l = 0; l < AESGCMSIV_LANES; l++) {
+        for (int i = 0; i < AESGCMSIV_NONCE_SIZE; i++) {
+            s[l][i] ^= lane[l]->nonce[i];
+        }
+        s[l][15] &= 0x7f;
+    }
+    kernel->encrypt_block_lanes(enc_ks, s, tags_out);
+
+    aesgcmsiv_secure_zero(stream, sizeof(stream));
+    aesgcmsiv_secure_zero(s, sizeof(s));
+}
+
+// derive_keys for one nonce per lane, lane i under the key-generating key
+// ks[i]. Lanes sharing one key take the kernel's interleaved derivation.
+// Mixed keys run the counter blocks through encrypt_block_lanes one at a
+// time, which wants the schedules side by side, so those are gathered first.
+static void derive_lanes(
+    const aesgcmsiv_kernel* kernel, const aes_key_schedule* const* ks,
+    const aesgcmsiv_batch_item* const* lane,
+    uint8_t (*auth_keys)[16], aes_key_schedule* enc_ks)
+{
+    const uint8_t* nonces[AESGCMSIV_LANES];
+    bool shared = true;
+    for (int l = 0; l < AESGCMSIV_LANES; l++) {
+        nonces[l] = lane[l]->nonce;
+        shared = shared && ks[l] == ks[0];
+    }
+    if (shared) {
+        kernel->derive_keys_lanes(ks[0], nonces, auth_keys, enc_ks);
+        return;
+    }
+
+    aes_key_schedule kgk[AESGCMSIV_LANES];
+    alignas(16) uint8_t in[AESGCMSIV_LANES][16];
+    for (int l = 0; l < AESGCMSIV_LANES; l++) {
+        kgk[l] = *ks[l];
+        memset(in[l], 0, 4);
+        memcpy(in[l] + 4, nonces[l], AESGCMSIV_NONCE_SIZE);
+    }
+
+    // Block i is LE32(i) || nonce; AES-128 needs four, AES-256 six
+    const bool aes128 = kgk[0].rounds == 10;
+    const int per_lane = aes128 ? 4 : 6;
+    alignas(16) uint8_t out[6][AESGCMSIV_LANES][16];
+    for (int i = 0; i < per_lane; i++) {
+        for (int l = 0; l < AESGCMSIV_LANES; l++) {
+            in[l][0] = static_cast<uint8_t>(i);
+        }
+        kernel->encrypt_block_lanes(kgk, in, out[i]);
+    }
+
+    // Only the first 8 bytes of each output block are used
+    alignas(16) uint8_t enc_key[32];
+    for (int l = 0; l < AESGCMSIV_LANES; l++) {
+        memcpy(auth_keys[l], out[0][l], 8);
+        memcpy(auth_keys[l] + 8, out[1][l], 8);
+        for (int i = 2; i < per_lane; i++) {
+            memcpy(enc_key + (i - 2) * 8, out[i][l], 8);
+        }
+        kernel->expand_key(enc_key, aes128 ? AESGCMSIV_KEY_SIZE_128 : AESGCMSIV_KEY_SIZE_256, &enc_ks[l]);
+    }
+
+    aesgcmsiv_secure_zero(kgk, sizeof(kgk));
+    aesgcmsiv_secure_zero(out, sizeof(out));
+    aesgcmsiv_secure_zero(enc_key, sizeof(enc_key));
+}
+
+static void seal_lanes(
+    const aesgcmsiv_kernel* kernel, const aes_key_schedule* const* ks,
+    const aesgcmsiv_batch_item* const* lane)
+{
+    alignas(16) uint8_t auth_keys[AESGCMSIV_LANES][16];
+    aes_key_schedule enc_ks[AESGCMSIV_LANES];
+    derive_lanes(kernel, ks, lane, auth_keys, enc_ks);
+
+    const uint8_t* in[AESGCMSIV_LANES];
+    uint8_t* out[AESGCMSIV_LANES];
+    size_t len[AESGCMSIV_LANES];
+    for (int l = 0; l < AESGCMSIV_LANES; l++) {
+        in[l] = lane[l]->input;
+        out[l] = lane[l]->output;
+        len[l] = lane[l]->input_len;
+    }
+
+    alignas(16) uint8_t tags[AESGCMSIV_LANES][16];
+    compute_tag_lanes(kernel, enc_ks, auth_keys, lane, in, tags);
+
+    alignas(16) uint8_t counters[AESGCMSIV_LANES][16];
+    memcpy(counters, tags, sizeof(counters));
+    for (int l = 0; l < AESGCMSIV_LANES; l++) {
+        counters[l][15] |= 0x80;
+    }
+    kernel->ctr32_lanes(enc_ks, counters, in, out, len);
+    for (int l = 0; l < AESGCMSIV_LANES; l++) {
+        memcpy(lane[l]->tag, tags[l], AESGCMSIV_TAG_SIZE);
+    }
+
+    aesgcmsiv_secure_zero(enc_ks, sizeof(enc_ks));
+    aesgcmsiv_secure_zero(auth_keys, sizeof(auth_keys));
+}
+
+static void open_lanes(
+    const aesgcmsiv_kernel* kernel, const aes_key_schedule* const* ks,
+    const aesgcmsiv_batch_item* const* lane, int* const* status)
+{
+    alignas(16) uint8_t auth_keys[AESGCMSIV_LANES][16];
+    aes_key_schedule enc_ks[AESGCMSIV_LANES];
+    derive_lanes(kernel, ks, lane, auth_keys, enc_ks);
+
+    // The received tags are the initial counter blocks
+    const uint8_t* in[AESGCMSIV_LANES];
+    uint8_t* out[AESGCMSIV_LANES];
+    size_t len[AESGCMSIV_LANES];
+    alignas(16) uint8_t counters[AESGCMSIV_LANES][16];
+    for (int l = 0; l < AESGCMSIV_LANES; l++) {
+        in[l] = lane[l]->input;
+        out[l] = lane[l]->output;
+        len[l] = lane[l]->input_len;
+        memcpy(counters[l], lane[l]->tag, 16);
+        counters[l][15] |= 0x80;
+    }
+    kernel->ctr32_lanes(enc_ks, counters, in, out, len);
+
+    alignas(16) uint8_t expected[AESGCMSIV_LANES][16];
+    const uint8_t* plaintext[AESGCMSIV_LANES];
+    for (int l = 0; l < AESGCMSIV_LANES; l++) {
+        plaintext[l] = out[l];
+    }
+    compute_tag_lanes(kernel, enc_ks, auth_keys, lane, plaintext, expected);
+
+    aesgcmsiv_secure_zero(enc_ks, sizeof(enc_ks));
+    aesgcmsiv_secure_zero(auth_keys, sizeof(auth_keys));
+
+    for (int l = 0; l < AESGCMSIV_LANES; l++) {
+        if (aesgcmsiv_tags_equal(expected[l], lane[l]->tag)) {
+            *status[l] = AESGCMSIV_SUCCESS;
+        } else {
+            aesgcmsiv_secure_zero(out[l], len[l]);
+            *status[l] = AESGCMSIV_ERROR_DECRYPT_FAILED;
+        }
+    }
+}
+
+// The most of an item's input a batch prefetches: the whole of a message
+// short enough for the lanes, and the start of a longer one, after which
+// the hardware prefetcher has picked up the stream
+static const size_t batch_prefetch_bytes = 256;
+
+// Starts bringing the cache line holding p in, for reading. Never faults,
+// whatever p is.
+static inline void prefetch_line(const void* p)
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_prefetch(static_cast<const char*>(p), _MM_HINT_T0);
+#elif defined(_MSC_VER) && defined(_M_ARM64)
+    __prefetch(p);
+#else
+    __builtin_prefetch(p);
+#endif
+}
+
+// Prefetches the buffers item i + kernel->batch_prefetch will read, while
+// item i is processed
+static inline void prefetch_ahead(
+    const aesgcmsiv_kernel* kernel, const aesgcmsiv_batch_item* items, size_t i, size_t count)
+{
+    const size_t ahead = i + kernel->batch_prefetch;
+    if (kernel->batch_prefetch == 0 || ahead >= count) {
+        return;
+    }
+    const aesgcmsiv_batch_item& item = items[ahead];
+    prefetch_line(item.nonce);
+    prefetch_line(item.tag);
+    if (item.aad_len) {
+        prefetch_line(item.aad);
+    }
+    const size_t len = std::min(item.input_len, batch_prefetch_bytes);
+    for (size_t offset = 0; offset < len; offset += 64) {
+        prefetch_line(item.input + offset);
+    }
+}
+
+// Short messages waiting for a full set of lanes. The lanes of one call
+// share a round count, so AES-128 and AES-256 messages wait apart. A call
+// also lasts as long as its longest lane, so messages wait by size as well:
+// class c holds those of up to 2^c blocks, counting AAD and length block,
+// and one 17-block message never holds up three 2-block ones.
+struct lane_group {
+    const aesgcmsiv_batch_item* lane[AESGCMSIV_LANES];
+    const aes_key_schedule* ks[AESGCMSIV_LANES];
+    int* status[AESGCMSIV_LANES];
+    int filled;
+};
+
+static const int lane_classes = 6;
+
+static int lane_class(const aesgcmsiv_batch_item& item)
+{
+    const size_t blocks = padded_blocks(item.aad_len) + padded_blocks(item.input_len) + 1;
+    int c = 0;
+    while (c < lane_classes - 1 && (size_t(1) << c) < blocks) {
+        c++;
+    }
+    return c;
+}
+
+// Once the batch is through, each class holds fewer messages than there are
+// lanes. Those of one round count still fill whole calls together, smallest
+// classes first so neighbours in size share a call; full(group) runs each
+// such call and single(group, l) each message left over after them.
+template <typename Full, typename Single>
+static void flush_lane_groups(lane_group (*groups)[lane_classes], Full full, Single single)
+{
+    for (int r = 0; r < 2; r++) {
+        lane_group merged = {};
+        for (int c = 0; c < lane_classes; c++) {
+            const lane_group& group = groups[r][c];
+            for (int l = 0; l < group.filled; l++) {
+                merged.lane[merged.filled] = group.lane[l];
+                merged.ks[merged.filled] = group.ks[l];
+                merged.status[merged.filled] = group.status[l];
+                if (++merged.filled == AESGCMSIV_LANES) {
+                    full(merged);
+                    merged.filled = 0;
+                }
+            }
+        }
+        for (int l = 0; l < merged.filled; l++) {
+            single(merged, l);
+        }
+    }
+}
+
+// The batch loops behind kernel_seal_batch and kernel_seal_batch_keyed;
+// key_of(i) is item i's key-generating key
+template <typename KeyOf>
+static void seal_batch(
+    const aesgcmsiv_kernel* kernel, KeyOf key_of,
+    const aesgcmsiv_batch_item* items, size_t count)
+{
+    const bool lanes = kernel->derive_keys_lanes != nullptr;
+    const size_t max_blocks = kernel_lane_max_blocks.load(std::memory_order_relaxed);
+    lane_group groups[2][lane_classes] = {};
+    for (size_t i = 0; i < count; i++) {
+        prefetch_ahead(kernel, items, i, count);
+        const aesgcmsiv_batch_item& item = items[i];
+        const aes_key_schedule* ks = key_of(i);
+        if (lanes && fits_lane(item, max_blocks)) {
+            lane_group& group = groups[ks->rounds != 10][lane_class(item)];
+            group.lane[group.filled] = &item;
+            group.ks[group.filled++] = ks;
+            if (group.filled == AESGCMSIV_LANES) {
+                seal_lanes(kernel, group.ks, group.lane);
+                group.filled = 0;
+            }
+            continue;
+        }
+        kernel_seal(kernel, ks, item.nonce, item.input, item.input_len,
+            item.aad, item.aad_len, item.output, item.tag);
+    }
+
+    flush_lane_groups(groups,
+        [kernel](const lane_group& group) { seal_lanes(kernel, group.ks, group.lane); },
+        [kernel](const lane_group& group, int l) {
+            const aesgcmsiv_batch_item& item = *group.lane[l];
+            kernel_seal(kernel, group.ks[l], item.nonce, item.input, item.input_len,
+                item.aad, item.aad_len, item.output, item.tag);
+        });
+}
+
+template <typename KeyOf>
+static void open_batch(
+    const aesgcmsiv_kernel* kernel, KeyOf key_of,
+    const aesgcmsiv_batch_item* items, size_t count,
+    int* status_out)
+{
+    const bool lanes = kernel->derive_keys_lanes != nullptr;
+    const size_t max_blocks = kernel_lane_max_blocks.load(std::memory_order_relaxed);
+    lane_group groups[2][lane_classes] = {};
+    for (size_t i = 0; i < count; i++) {
+        prefetch_ahead(kernel, items, i, count);
+        if (status_out[i] != AESGCMSIV_SUCCESS) {
+            continue;
+        }
+        const aesgcmsiv_batch_item& item = items[i];
+        const aes_key_schedule* ks = key_of(i);
+        if (lanes && fits_lane(item, max_blocks)) {
+            lane_group& group = groups[ks->rounds != 10][lane_class(item)];
+            group.lane[group.filled] = &item;
+            group.ks[group.filled] = ks;
+            group.status[group.filled++] = &status_out[i];
+            if (group.filled == AESGCMSIV_LANES) {
+                open_lanes(kernel, group.ks, group.lane, group.status);
+                group.filled = 0;
+            }
+            continue;
+        }
+        status_out[i] = kernel_open(kernel, ks, item.nonce, item.input, item.input_len,
+            item.aad, item.aad_len, item.tag, item.output);
+    }
+
+    flush_lane_groups(groups,
+        [kernel](const lane_group& group) { open_lanes(kernel, group.ks, group.lane, group.status); },
+        [kernel](const lane_group& group, int l) {
+            const aesgcmsiv_batch_item& item = *group.lane[l];
+            *group.status[l] = kernel_open(kernel, group.ks[l], item.nonce, item.input, item.input_len,
+                item.aad, item.aad_len, item.tag, item.output);
+        });
+}
+
+void kernel_seal_batch(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* ks,
+    const aesgcmsiv_batch_item* items, size_t count)
+{
+    seal_batch(kernel, [ks](size_t) { return ks; }, items, count);
+}
+
+void kernel_open_batch(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* ks,
+    const aesgcmsiv_batch_item* items, size_t count,
+    int* status_out)
+{
+    open_batch(kernel, [ks](size_t) { return ks; }, items, count, status_out);
+}
+
+void kernel_seal_batch_keyed(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* schedules, const uint32_t* slots,
+    const aesgcmsiv_batch_item* items, size_t count)
+{
+    seal_batch(kernel, [=](size_t i) { return &schedules[slots[i]]; }, items, count);
+}
+
+void kernel_open_batch_keyed(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* schedules, const uint32_t* slots,
+    const aesgcmsiv_batch_item* items, size_t count,
+    int* status_out)
+{
+    open_batch(kernel, [=](size_t i) { return &schedules[slots[i]]; }, items, count, status_out);
+}
+
+// ---------------------------------------------------------------------------
+// Large-message parallelism
+// ---------------------------------------------------------------------------
+
+// POLYVAL is linear in its input, so the message can be hashed as separate
+// runs of whole blocks that are stitched back together: absorbing L more
+// blocks multiplies the running value by H^L. CTR is independent per block
+// once the tag is known, so it splits along the same boundaries.
+
+// Runs work(0)..work(count - 1) on the pool if there is one, which may
+// place share i on the NUMA node holding homes[i]. Otherwise work(0) runs on
+// the calling thread and a thread is started per other share; if one cannot
+// be, its share runs here instead, and nothing is thrown out of the library.
+template <typename Work>
+static void run_shares(
+    aesgcmsiv_pool* pool, unsigned int count, const void* const* homes, const Work& work)
+{
+    if (pool) {
+        aesgcmsiv_pool_for(pool, count, work, homes);
+        return;
+    }
+    std::thread workers[AESGCMSIV_PARALLEL_MAX_THREADS];
+    for (unsigned int i = 1; i < count; i++) {
+        try {
+            workers[i] = std::thread(work, i);
+        } catch (...) {
+            work(i);
+        }
+    }
+    work(0);
+    for (unsigned int i = 1; i < count; i++) {
+        if (workers[i].joinable()) {
+            workers[i].join();
+        }
+    }
+}
+
+// Multiplies in the POLYVAL field: out = a * b * x^-128.
+static void polyval_mul(
+    const aesgcmsiv_kernel* kernel, const uint8_t* a, const uint8_t* b, uint8_t* out)
+{
+    polyval_state pv;
+    kernel->polyval_init(&pv, b, 1);
+    kernel->polyval_blocks(&pv, a, 1);
+    memcpy(out, pv.s, 16);
+    aesgcmsiv_secure_zero(&pv, sizeof(pv));
+}
+
+// H^n in the POLYVAL field, n >= 1.
+static void polyval_pow(
+    const aesgcmsiv_kernel* kernel, const uint8_t* h, size_t n, uint8_t* out)
+{
+    alignas(16) uint8_t base[16];
+    alignas(16) uint8_t acc[16];
+    memcpy(base, h, sizeof(base));
+    bool have_acc = false;
+    while (n) {
+        if (n & 1) {
+            if (have_acc) {
+                polyval_mul(kernel, acc, base, acc);
+            } else {
+                memcpy(acc, base, sizeof(acc));
+                have_acc = true;
+            }
+        }
+        n >>= 1;
+        if (n) {
+            polyval_mul(kernel, base, base, base);
+        }
+    }
+    memcpy(out, acc, 16);
+    aesgcmsiv_secure_zero(base, sizeof(base));
+    aesgcmsiv_secure_zero(acc, sizeof(acc));
+}
+
+std::atomic<size_t> kernel_parallel_min_bytes(AESGCMSIV_PARALLEL_MIN_BYTES);
+
+static unsigned int parallel_shares(aesgcmsiv_pool* pool, unsigned int threads, size_t len)
+{
+    if (threads == 0) {
+        threads = pool ? aesgcmsiv_pool_workers(pool) + 1 : aesgcmsiv_cpu_budget();
+    }
+    if (threads > AESGCMSIV_PARALLEL_MAX_THREADS) {
+        threads = AESGCMSIV_PARALLEL_MAX_THREADS;
+    }
+    size_t by_size = len / kernel_parallel_min_bytes.load(std::memory_order_relaxed);
+    return by_size < threads ? static_cast<unsigned int>(by_size) : threads;
+}
+
+// Splits a message into `shares` runs of whole blocks. Every run but the
+// last has share_blocks blocks; the last also takes any partial block.
+struct parallel_split {
+    unsigned int shares;
+    size_t share_blocks;
+
+    size_t offset(unsigned int i) const { return i * share_blocks * 16; }
+    size_t length(unsigned int i, size_t len) const
+    {
+        return i + 1 < shares ? share_blocks * 16 : len - offset(i);
+    }
+};
+
+static parallel_split split_message(unsigned int shares, size_t len)
+{
+    parallel_split split;
+    split.shares = shares;
+    // Rounded to the widest POLYVAL stride so no run ends in a short tail
+    size_t blocks = len / 16;
+    split.share_blocks = (blocks / shares) & ~static_cast<size_t>(AESGCMSIV_POLYVAL_POWERS - 1);
+    return split;
+}
+
+// Start of each share of the input, for placing shares by node
+static void share_homes(const parallel_split& split, const uint8_t* input, const void** homes)
+{
+    for (unsigned int i = 0; i < split.shares; i++) {
+        homes[i] = input + split.offset(i);
+    }
+}
+
+// POLYVAL of share i's whole blocks, starting from zero.
+static void hash_share(
+    const aesgcmsiv_kernel* kernel, const uint8_t* auth_key,
+    const parallel_split& split, unsigned int i,
+    const uint8_t* msg, size_t msg_len,
+    uint8_t* partial_out)
+{
+    size_t blocks = split.length(i, msg_len) / 16;
+    polyval_state pv;
+    kernel->polyval_init(&pv, auth_key, blocks);
+    kernel->polyval_blocks(&pv, msg + split.offset(i), blocks);
+    memcpy(partial_out, pv.s, 16);
+    aesgcmsiv_secure_zero(&pv, sizeof(pv));
+}
+
+void ctr32_stream_init(ctr32_stream* stream, const uint8_t* tag)
+{
+    memcpy(stream->counter, tag, sizeof(stream->counter));
+    stream->counter[15] |= 0x80;
+    stream->keystream_used = sizeof(stream->keystream);
+}
+
+void kernel_ctr32_stream(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* enc_ks,
+    ctr32_stream* stream,
+    const uint8_t* in, uint8_t* out, size_t len)
+{
+    // What the previous piece left of its last block's keystream
+    while (len && stream->keystream_used < sizeof(stream->keystream)) {
+        *out++ = static_cast<uint8_t>(*in++ ^ stream->keystream[stream->keystream_used++]);
+        len--;
+    }
+    size_t blocks = len / 16;
+    if (blocks) {
+        kernel->ctr32(enc_ks, stream->counter, in, out, blocks * 16);
+        advance_counter(stream->counter, blocks, stream->counter);
+        in += blocks * 16;
+        out += blocks * 16;
+        len %= 16;
+    }
+    if (len) {
+        kernel->encrypt_block(enc_ks, stream->counter, stream->keystream);
+        advance_counter(stream->counter, 1, stream->counter);
+        for (size_t i = 0; i < len; i++) {
+            out[i] = static_cast<uint8_t>(in[i] ^ stream->keystream[i]);
+        }
+        stream->keystream_used = len;
+    }
+}
+
+// CTR over share i, with the counter advanced to its first block.
+static void ctr_share(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* enc_ks, const uint8_t* counter,
+    const parallel_split& split, unsigned int i,
+    const uint8_t* in, uint8_t* out, size_t len)
+{
+    alignas(16) uint8_t share_counter[16];
+    advance_counter(counter, i * split.share_blocks, share_counter);
+    size_t offset = split.offset(i);
+    kernel->ctr32(enc_ks, share_counter, in + offset, out + offset, split.length(i, len));
+}
+
+// Decrypts share i and hashes its whole plaintext blocks, fused when the
+// kernel can.
+static void open_share(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* enc_ks, const uint8_t* auth_key, const uint8_t* counter,
+    const parallel_split& split, unsigned int i,
+    const uint8_t* in, uint8_t* out, size_t len,
+    uint8_t* partial_out)
+{
+    if (!kernel->ctr32_polyval) {
+        ctr_share(kernel, enc_ks, counter, split, i, in, out, len);
+        hash_share(kernel, auth_key, split, i, out, len, partial_out);
+        return;
+    }
+
+    size_t offset = split.offset(i);
+    size_t share_len = split.length(i, len);
+    size_t whole = share_len & ~static_cast<size_t>(15);
+    alignas(16) uint8_t share_counter[16];
+    advance_counter(counter, i * split.share_blocks, share_counter);
+
+    polyval_state pv;
+    kernel->polyval_init(&pv, auth_key, whole / 16);
+    kernel->ctr32_polyval(enc_ks, share_counter, in + offset, out + offset, whole, &pv);
+    memcpy(partial_out, pv.s, 16);
+    aesgcmsiv_secure_zero(&pv, sizeof(pv));
+
+    // A partial final block is hashed by join_tag
+    if (share_len > whole) {
+        advance_counter(counter, i * split.share_blocks + whole / 16, share_counter);
+        kernel->ctr32(enc_ks, share_counter, in + offset + whole, out + offset + whole,
+            share_len - whole);
+    }
+}
+
+// Joins the per-share hashes with the AAD, the partial final block and the
+// length block, and computes the tag.
+static void join_tag(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* enc_ks, const uint8_t* auth_key,
+    const parallel_split& split, const uint8_t (*partial)[16],
+    const uint8_t* nonce,
+    const uint8_t* msg, size_t msg_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* tag_out)
+{
+    polyval_state pv;
+    kernel->polyval_init(&pv, auth_key, padded_blocks(aad_len));
+    polyval_padded(kernel, &pv, aad, aad_len);
+
+    alignas(16) uint8_t h_share[16];
+    alignas(16) uint8_t h_last[16];
+    size_t last_blocks = split.length(split.shares - 1, msg_len) / 16;
+    polyval_pow(kernel, auth_key, split.share_blocks, h_share);
+    polyval_pow(kernel, auth_key, last_blocks, h_last);
+
+    alignas(16) uint8_t s[16];
+    memcpy(s, pv.s, sizeof(s));
+    for (unsigned int i = 0; i < split.shares; i++) {
+        polyval_mul(kernel, s, i + 1 < split.shares ? h_share : h_last, s);
+        for (int j = 0; j < 16; j++) {
+            s[j] ^= partial[i][j];
+        }
+    }
+
+    // Partial final block and the length block continue from the joined value
+    kernel->polyval_init(&pv, auth_key, 2);
+    memcpy(pv.s, s, sizeof(s));
+    size_t rem = msg_len % 16;
+    polyval_padded(kernel, &pv, msg + (msg_len - rem), rem);
+
+    alignas(16) uint8_t lengths[16];
+    length_block(aad_len, msg_len, lengths);
+    kernel->polyval_blocks(&pv, lengths, 1);
+
+    finish_tag(kernel, enc_ks, pv.s, nonce, tag_out);
+    aesgcmsiv_secure_zero(&pv, sizeof(pv));
+    aesgcmsiv_secure_zero(h_share, sizeof(h_share));
+    aesgcmsiv_secure_zero(h_last, sizeof(h_last));
+    aesgcmsiv_secure_zero(s, sizeof(s));
+}
+
+int kernel_seal_parallel(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* ks,
+    unsigned int threads,
+    aesgcmsiv_pool* pool,
+    const uint8_t* nonce,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out)
+{
+    unsigned int shares = parallel_shares(pool, threads, plaintext_len);
+    if (shares < 2) {
+        return kernel_seal(kernel, ks, nonce, plaintext, plaintext_len,
+            aad, aad_len, ciphertext_out, tag_out);
+    }
+    parallel_split split = split_message(shares, plaintext_len);
+
+    alignas(16) uint8_t auth_key[16];
+    aes_key_schedule enc_ks;
+    {
+        PhaseScope phase(AESGCMSIV_PHASE_DERIVE);
+        kernel->derive_keys(ks, nonce, auth_key, &enc_ks);
+    }
+
+    // The whole plaintext is hashed before any of it is overwritten, so
+    // in-place encryption still works
+    alignas(16) uint8_t partial[AESGCMSIV_PARALLEL_MAX_THREADS][16];
+    const void* homes[AESGCMSIV_PARALLEL_MAX_THREADS];
+    share_homes(split, plaintext, homes);
+    run_shares(pool, split.shares, homes, [&](unsigned int i) {
+        hash_share(kernel, auth_key, split, i, plaintext, plaintext_len, partial[i]);
+    });
+    alignas(16) uint8_t tag[16];
+    join_tag(kernel, &enc_ks, auth_key, split, partial, nonce,
+        plaintext, plaintext_len, aad, aad_len, tag);
+
+    alignas(16) uint8_t counter[16];
+    memcpy(counter, tag, sizeof(counter));
+    counter[15] |= 0x80;
+    run_shares(pool, split.shares, homes, [&](unsigned int i) {
+        ctr_share(kernel, &enc_ks, counter, split, i, plaintext, ciphertext_out, plaintext_len);
+    });
+    memcpy(tag_out, tag, AESGCMSIV_TAG_SIZE);
+
+    aesgcmsiv_secure_zero(&enc_ks, sizeof(enc_ks));
+    aesgcmsiv_secure_zero(auth_key, sizeof(auth_key));
+    aesgcmsiv_secure_zero(partial, sizeof(partial));
+    return AESGCMSIV_SUCCESS;
+}
+
+int kernel_open_parallel(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* ks,
+    unsigned int threads,
+    aesgcmsiv_pool* pool,
+    const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out)
+{
+    unsigned int shares = parallel_shares(pool, threads, ciphertext_len);
+    if (shares < 2) {
+        return kernel_open(kernel, ks, nonce, ciphertext, ciphertext_len,
+            aad, aad_len, tag, plaintext_out);
+    }
+    parallel_split split = split_message(shares, ciphertext_len);
+
+    alignas(16) uint8_t auth_key[16];
+    aes_key_schedule enc_ks;
+    {
+        PhaseScope phase(AESGCMSIV_PHASE_DERIVE);
+        kernel->derive_keys(ks, nonce, auth_key, &enc_ks);
+    }
+
+    // The received tag fixes the counter up front, so each share is
+    // decrypted and hashed on its own thread
+    alignas(16) uint8_t counter[16];
+    memcpy(counter, tag, sizeof(counter));
+    counter[15] |= 0x80;
+    alignas(16) uint8_t partial[AESGCMSIV_PARALLEL_MAX_THREADS][16];
+    const void* homes[AESGCMSIV_PARALLEL_MAX_THREADS];
+    share_homes(split, ciphertext, homes);
+    run_shares(pool, split.shares, homes, [&](unsigned int i) {
+        open_share(kernel, &enc_ks, auth_key, counter, split, i,
+            ciphertext, plaintext_out, ciphertext_len, partial[i]);
+    });
+
+    alignas(16) uint8_t expected[16];
+    join_tag(kernel, &enc_ks, auth_key, split, partial, nonce,
+        plaintext_out, ciphertext_len, aad, aad_len, expected);
+
+    aesgcmsiv_secure_zero(&enc_ks, sizeof(enc_ks));
+    aesgcmsiv_secure_zero(auth_key, sizeof(auth_key));
+    aesgcmsiv_secure_zero(partial, sizeof(partial));
+
+    if (!aesgcmsiv_tags_equal(expected, tag)) {
+        // Never release unauthenticated plaintext
+        aesgcmsiv_secure_zero(plaintext_out, ciphertext_len);
+        return AESGCMSIV_ERROR_DECRYPT_FAILED;
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+// ---------------------------------------------------------------------------
+// One message under many keys
+// ---------------------------------------------------------------------------
+
+// The tag must be known before CTR can start, so each recipient still takes
+// two passes over the plaintext. Taking the recipients a group at a time,
+// and the plaintext a chunk at a time, makes every pass of the group after
+// the first read a chunk that is already in L2: the plaintext comes from
+// memory twice per group rather than twice per recipient. The chunk is
+// large enough that the per-call setup of the bulk loops, which clear
+// their copies of the round keys, stays small beside the work.
+
+#define MULTIKEY_GROUP 32
+#define MULTIKEY_CHUNK_BYTES 65536
+
+static void seal_multikey_group(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* schedules,
+    const uint8_t* nonces,
+    size_t count,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* const* ciphertexts_out,
+    uint8_t* tags_out)
+{
+    alignas(16) uint8_t auth_keys[MULTIKEY_GROUP][16];
+    aes_key_schedule enc_ks[MULTIKEY_GROUP];
+    polyval_state pv[MULTIKEY_GROUP];
+    alignas(16) uint8_t counters[MULTIKEY_GROUP][16];
+
+    const size_t blocks = padded_blocks(aad_len) + padded_blocks(plaintext_len) + 1;
+    for (size_t r = 0; r < count; r++) {
+        kernel->derive_keys(&schedules[r], nonces + r * AESGCMSIV_NONCE_SIZE, auth_keys[r], &enc_ks[r]);
+        kernel->polyval_init(&pv[r], auth_keys[r], blocks);
+        polyval_padded(kernel, &pv[r], aad, aad_len);
+    }
+
+    for (size_t offset = 0; offset < plaintext_len; offset += MULTIKEY_CHUNK_BYTES) {
+        size_t n = plaintext_len - offset < MULTIKEY_CHUNK_BYTES ? plaintext_len - offset : MULTIKEY_CHUNK_BYTES;
+        for (size_t r = 0; r < count; r++) {
+            polyval_padded(kernel, &pv[r], plaintext + offset, n);
+        }
+    }
+
+    alignas(16) uint8_t lengths[16];
+    length_block(aad_len, plaintext_len, lengths);
+    for (size_t r = 0; r < count; r++) {
+        uint8_t* tag = tags_out + r * AESGCMSIV_TAG_SIZE;
+        kernel->polyval_blocks(&pv[r], lengths, 1);
+        finish_tag(kernel, &enc_ks[r], pv[r].s, nonces + r * AESGCMSIV_NONCE_SIZE, tag);
+        // The tag with its top bit set is the initial counter block
+        memcpy(counters[r], tag, 16);
+        counters[r][15] |= 0x80;
+    }
+
+    for (size_t offset = 0; offset < plaintext_len; offset += MULTIKEY_CHUNK_BYTES) {
+        size_t n = plaintext_len - offset < MULTIKEY_CHUNK_BYTES ? plaintext_len - offset : MULTIKEY_CHUNK_BYTES;
+        for (size_t r = 0; r < count; r++) {
+            kernel->ctr32(&enc_ks[r], counters[r], plaintext + offset, ciphertexts_out[r] + offset, n);
+            advance_counter(counters[r], MULTIKEY_CHUNK_BYTES / 16, counters[r]);
+        }
+    }
+
+    // Only the first count entries were used
+    aesgcmsiv_secure_zero(auth_keys, count * sizeof(auth_keys[0]));
+    aesgcmsiv_secure_zero(enc_ks, count * sizeof(enc_ks[0]));
+    aesgcmsiv_secure_zero(pv, count * sizeof(pv[0]));
+    aesgcmsiv_secure_zero(counters, count * sizeof(counters[0]));
+}
+
+void kernel_seal_multikey(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* schedules,
+    const uint8_t* nonces,
+    size_t count,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* const* ciphertexts_out,
+    uint8_t* tags_out)
+{
+    // Messages this short fit in cache whatever the order, and the
+    // fixed-size path is quicker than the general one
+    if (takes_small(kernel, plaintext_len, aad_len)) {
+        for (size_t r = 0; r < count; r++) {
+            kernel_seal(kernel, &schedules[r], nonces + r * AESGCMSIV_NONCE_SIZE,
+                plaintext, plaintext_len, aad, aad_len,
+                ciphertexts_out[r], tags_out + r * AESGCMSIV_TAG_SIZE);
+        }
+        return;
+    }
+
+    for (size_t first = 0; first < count; first += MULTIKEY_GROUP) {
+        size_t n = count - first < MULTIKEY_GROUP ? count - first : MULTIKEY_GROUP;
+        seal_multikey_group(kernel, schedules + first, nonces + first * AESGCMSIV_NONCE_SIZE, n,
+            plaintext, plaintext_len, aad, aad_len,
+            ciphertexts_out + first, tags_out + first * AESGCMSIV_TAG_SIZE);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Scatter/gather
+// ---------------------------------------------------------------------------
+
+// The segments are walked in place: POLYVAL and CTR see one logical message
+// and only the bytes that straddle a segment boundary are staged.
+
+template <typename Segment>
+static size_t segments_len(const Segment* segs, size_t count)
+{
+    size_t len = 0;
+    for (size_t i = 0; i < count; i++) {
+        len += segs[i].len;
+    }
+    return len;
+}
+
+// Absorbs the first len bytes of a segmented message, zero-padded to a
+// whole block.
+template <typename Segment>
+static void polyval_segments(
+    const aesgcmsiv_kernel* kernel, polyval_state* pv,
+    const Segment* segs, size_t count, size_t len)
+{
+    alignas(16) uint8_t carry[16];
+    size_t carried = 0;
+    for (size_t i = 0; i < count && len > 0; i++) {
+        const uint8_t* p = segs[i].data;
+        size_t n = segs[i].len < len ? segs[i].len : len;
+        if (n == 0) {
+            continue;  // data may be NULL
+        }
+        len -= n;
+        if (carried) {
+            size_t take = 16 - carried < n ? 16 - carried : n;
+            memcpy(carry + carried, p, take);
+            carried += take;
+            p += take;
+            n -= take;
+            if (carried < 16) {
+                continue;
+            }
+            kernel->polyval_blocks(pv, carry, 1);
+            carried = 0;
+        }
+        kernel->polyval_blocks(pv, p, n / 16);
+        carried = n % 16;
+        memcpy(carry, p + (n - carried), carried);
+    }
+    if (carried) {
+        memset(carry + carried, 0, 16 - carried);
+        kernel->polyval_blocks(pv, carry, 1);
+    }
+    aesgcmsiv_secure_zero(carry, sizeof(carry));
+}
+
+// CTR keystream that continues across calls, for runs that do not start or
+// end on a block boundary.
+struct ctr_stream {
+    const aesgcmsiv_kernel* kernel;
+    const aes_key_schedule* ks;
+    alignas(16) uint8_t counter[16];
+    alignas(16) uint8_t keystream[16];
+    size_t used;  // keystream bytes already consumed
+
+    void apply(const uint8_t* in, uint8_t* out, size_t len)
+    {
+        while (len > 0 && used < 16) {
+            *out++ = *in++ ^ keystream[used++];
+            len--;
+        }
+        size_t whole = len & ~static_cast<size_t>(15);
+        if (whole) {
+            kernel->ctr32(ks, counter, in, out, whole);
+            advance_counter(counter, whole / 16, counter);
+            in += whole;
+            out += whole;
+            len -= whole;
+        }
+        if (len) {
+            memset(keystream, 0, sizeof(keystream));
+            kernel->ctr32(ks, counter, keystream, keystream, sizeof(keystream));
+            advance_counter(counter, 1, counter);
+            used = 0;
+            while (len > 0) {
+                *out++ = *in++ ^ keystream[used++];
+                len--;
+            }
+        }
+    }
+};
+
+// CTR from the input segments into the output segments, which may be laid
+// out differently. Stops when the input is exhausted.
+static void ctr_segments(
+    const aesgcmsiv_kernel* kernel, const aes_key_schedule* ks, const uint8_t* counter,
+    const aesgcmsiv_iovec* in, size_t in_count,
+    const aesgcmsiv_iovec_out* out, size_t out_count)
+{
+    ctr_stream stream;
+    stream.kernel = kernel;
+    stream.ks = ks;
+    memcpy(stream.counter, counter, sizeof(stream.counter));
+    stream.used = sizeof(stream.keystream);
+
+    size_t i = 0, o = 0, in_off = 0, out_off = 0;
+    while (i < in_count && o < out_count) {
+        if (in_off == in[i].len) {
+            i++;
+            in_off = 0;
+            continue;
+        }
+        if (out_off == out[o].len) {
+            o++;
+            out_off = 0;
+            continue;
+        }
+        size_t in_rem = in[i].len - in_off;
+        size_t out_rem = out[o].len - out_off;
+        size_t run = in_rem < out_rem ? in_rem : out_rem;
+        stream.apply(in[i].data + in_off, out[o].data + out_off, run);
+        in_off += run;
+        out_off += run;
+    }
+    aesgcmsiv_secure_zero(&stream, sizeof(stream));
+}
+
+static void zero_segments(const aesgcmsiv_iovec_out* segs, size_t count, size_t len)
+{
+    for (size_t i = 0; i < count && len > 0; i++) {
+        size_t n = segs[i].len < len ? segs[i].len : len;
+        aesgcmsiv_secure_zero(segs[i].data, n);
+        len -= n;
+    }
+}
+
+template <typename Segment>
+static void compute_tag_segments(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* enc_ks, const uint8_t* auth_key,
+    const uint8_t* nonce,
+    const Segment* msg, size_t msg_count, size_t msg_len,
+    const aesgcmsiv_iovec* aad, size_t aad_count, size_t aad_len,
+    uint8_t* tag_out)
+{
+    polyval_state pv;
+    kernel->polyval_init(&pv, auth_key, padded_blocks(aad_len) + padded_blocks(msg_len) + 1);
+    polyval_segments(kernel, &pv, aad, aad_count, aad_len);
+    polyval_segments(kernel, &pv, msg, msg_count, msg_len);
+
+    alignas(16) uint8_t lengths[16];
+    length_block(aad_len, msg_len, lengths);
+    kernel->polyval_blocks(&pv, lengths, 1);
+
+    finish_tag(kernel, enc_ks, pv.s, nonce, tag_out);
+    aesgcmsiv_secure_zero(&pv, sizeof(pv));
+}
+
+int kernel_sealv(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* ks,
+    const uint8_t* nonce,
+    const aesgcmsiv_iovec* plaintext, size_t plaintext_count,
+    const aesgcmsiv_iovec* aad, size_t aad_count,
+    const aesgcmsiv_iovec_out* ciphertext_out, size_t ciphertext_count,
+    uint8_t* tag_out)
+{
+    alignas(16) uint8_t auth_key[16];
+    aes_key_schedule enc_ks;
+    {
+        PhaseScope phase(AESGCMSIV_PHASE_DERIVE);
+        kernel->derive_keys(ks, nonce, auth_key, &enc_ks);
+    }
+
+    alignas(16) uint8_t tag[16];
+    compute_tag_segments(kernel, &enc_ks, auth_key, nonce,
+        plaintext, plaintext_count, segments_len(plaintext, plaintext_count),
+        aad, aad_count, segments_len(aad, aad_count), tag);
+
+    alignas(16) uint8_t counter[16];
+    memcpy(counter, tag, sizeof(counter));
+    counter[15] |= 0x80;
+    ctr_segments(kernel, &enc_ks, counter, plaintext, plaintext_count, ciphertext_out, ciphertext_count);
+    memcpy(tag_out, tag, AESGCMSIV_TAG_SIZE);
+
+    aesgcmsiv_secure_zero(&enc_ks, sizeof(enc_ks));
+    aesgcmsiv_secure_zero(auth_key, sizeof(auth_key));
+    return AESGCMSIV_SUCCESS;
+}
+
+int kernel_openv(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* ks,
+    const uint8_t* nonce,
+    const aesgcmsiv_iovec* ciphertext, size_t ciphertext_count,
+    const aesgcmsiv_iovec* aad, size_t aad_count,
+    const uint8_t* tag,
+    const aesgcmsiv_iovec_out* plaintext_out, size_t plaintext_count)
+{
+    alignas(16) uint8_t auth_key[16];
+    aes_key_schedule enc_ks;
+    {
+        PhaseScope phase(AESGCMSIV_PHASE_DERIVE);
+        kernel->derive_keys(ks, nonce, auth_key, &enc_ks);
+    }
+
+    alignas(16) uint8_t counter[16];
+    memcpy(counter, tag, sizeof(counter));
+    counter[15] |= 0x80;
+    ctr_segments(kernel, &enc_ks, counter, ciphertext, ciphertext_count, plaintext_out, plaintext_count);
+
+    size_t len = segments_len(ciphertext, ciphertext_count);
+    alignas(16) uint8_t expected[16];
+    compute_tag_segments(kernel, &enc_ks, auth_key, nonce,
+        plaintext_out, plaintext_count, len,
+        aad, aad_count, segments_len(aad, aad_count), expected);
+
+    aesgcmsiv_secure_zero(&enc_ks, sizeof(enc_ks));
+    aesgcmsiv_secure_zero(auth_key, sizeof(auth_key));
+
+    if (!aesgcmsiv_tags_equal(expected, tag)) {
+        // Never release unauthenticated plaintext
+        zero_segments(plaintext_out, plaintext_count, len);
+        return AESGCMSIV_ERROR_DECRYPT_FAILED;
+    }
+    return AESGCMSIV_SUCCESS;
+}
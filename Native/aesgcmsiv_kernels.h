@@ -0,0 +1,409 @@
+#ifndef AESGCMSIV_KERNELS_H
+#define AESGCMSIV_KERNELS_H
+
+// Internal interface to the hand-written AES-GCM-SIV kernels. Nothing in
+// this header is exported from the library.
+
+#include "aesgcmsiv.h"
+#include <atomic>
+#include <stdint.h>
+#include <stddef.h>
+
+#define AESGCMSIV_MAX_ROUNDS 14
+#define AESGCMSIV_POLYVAL_POWERS 16
+
+// Messages processed together by the multi-buffer primitives
+#define AESGCMSIV_LANES 4
+
+// Largest padded AAD plus padded message, plus the length block, that the
+// multi-buffer path takes (256 bytes of data)
+#define AESGCMSIV_LANE_MAX_BLOCKS 17
+
+// Longest message and AAD, in bytes, that the fixed-size paths take
+#define AESGCMSIV_SMALL_MAX_BYTES 64
+#define AESGCMSIV_SMALL_MAX_AAD 16
+
+// Large-message parallelism: smallest share of a message worth a thread, and
+// the most threads one call will use.
+#define AESGCMSIV_PARALLEL_MIN_BYTES (1u << 20)
+#define AESGCMSIV_PARALLEL_MAX_THREADS 64
+
+// Current values of the aesgcmsiv_tuning thresholds the kernels read, each
+// starting at its default above; read relaxed on every call
+extern std::atomic<size_t> kernel_parallel_min_bytes;
+extern std::atomic<size_t> kernel_lane_max_blocks;
+
+// Expanded AES encryption key. Laid out so SIMD kernels can load round keys
+// directly.
+struct alignas(16) aes_key_schedule {
+    uint8_t round_keys[AESGCMSIV_MAX_ROUNDS + 1][16];
+    int rounds;
+};
+
+// POLYVAL accumulator plus precomputed powers of the hash key. h[i] holds
+// H^(i+1); a kernel only fills as many powers as its widest stride needs.
+struct alignas(64) polyval_state {
+    uint8_t h[AESGCMSIV_POLYVAL_POWERS][16];
+    uint8_t s[16];
+};
+
+// Primitive operations a kernel provides. kernel_seal and kernel_open build
+// RFC 8452 out of these, so a new kernel only has to supply the pieces.
+struct aesgcmsiv_kernel {
+    const char* name;
+
+    // Expands a 16- or 32-byte key-generating or message-encryption key
+    void (*expand_key)(const uint8_t* key, size_t key_len, aes_key_schedule* ks);
+
+    // RFC 8452 section 4: per-nonce authentication key and an encryption key
+    // of the same size as the key-generating key
+    void (*derive_keys)(
+        const aes_key_schedule* ks, const uint8_t* nonce,
+        uint8_t* auth_key, aes_key_schedule* enc_ks);
+
+    void (*encrypt_block)(const aes_key_schedule* ks, const uint8_t* in, uint8_t* out);
+
+    // Prepares pv for hash key h. blocks is the number of blocks that will
+    // be absorbed, so short messages skip computing unused powers.
+    void (*polyval_init)(polyval_state* pv, const uint8_t* h, size_t blocks);
+
+    // Absorbs whole 16-byte blocks
+    void (*polyval_blocks)(polyval_state* pv, const uint8_t* data, size_t blocks);
+
+    // AES-CTR with the RFC 8452 32-bit little-endian counter. in == out is
+    // allowed.
+    void (*ctr32)(
+        const aes_key_schedule* ks, const uint8_t* counter,
+        const uint8_t* in, uint8_t* out, size_t len);
+
+    // Optional fused decrypt: ctr32 that also absorbs its output into pv,
+    // the final partial block zero-padded. pv must have been prepared for
+    // at least that many blocks. NULL if the kernel has none, in which case
+    // decryption makes a second pass over the plaintext.
+    void (*ctr32_polyval)(
+        const aes_key_schedule* ks, const uint8_t* counter,
+        const uint8_t* in, uint8_t* out, size_t len, polyval_state* pv);
+
+    // Optional multi-buffer primitives for batches of short messages. Each
+    // works on AESGCMSIV_LANES independent messages at once so their
+    // serial AES and GF(2^128) chains overlap in the pipeline. All four are
+    // NULL if the kernel has no multi-buffer path.
+
+    // derive_keys for one nonce per lane under the same key-generating key
+    void (*derive_keys_lanes)(
+        const aes_key_schedule* ks, const uint8_t* const* nonces,
+        uint8_t (*auth_keys)[16], aes_key_schedule* enc_ks);
+
+    // One block per lane, lane i under enc_ks[i]
+    void (*encrypt_block_lanes)(
+        const aes_key_schedule* enc_ks, const uint8_t (*in)[16], uint8_t (*out)[16]);
+
+    // POLYVAL from zero of blocks[i] whole blocks at data[i] under hash
+    // key h[i]
+    void (*polyval_lanes)(
+        const uint8_t (*h)[16], const uint8_t* const* data, const size_t* blocks,
+        uint8_t (*s_out)[16]);
+
+    // ctr32 per lane, lane i under enc_ks[i]
+    void (*ctr32_lanes)(
+        const aes_key_schedule* enc_ks, const uint8_t (*counters)[16],
+        const uint8_t* const* in, uint8_t* const* out, const size_t* len);
+
+    // Optional whole-message seal and open, under keys from derive_keys,
+    // for 1 to AESGCMSIV_SMALL_MAX_BYTES of message and at most
+    // AESGCMSIV_SMALL_MAX_AAD of AAD, specialized per block count so
+    // nothing loops. open_small zeroes the output on tag mismatch. Both
+    // NULL if the kernel has none.
+    void (*seal_small)(
+        const uint8_t* auth_key, const aes_key_schedule* enc_ks, const uint8_t* nonce,
+        const uint8_t* plaintext, size_t plaintext_len,
+        const uint8_t* aad, size_t aad_len,
+        uint8_t* ciphertext_out, uint8_t* tag_out);
+    int (*open_small)(
+        const uint8_t* auth_key, const aes_key_schedule* enc_ks, const uint8_t* nonce,
+        const uint8_t* ciphertext, size_t ciphertext_len,
+        const uint8_t* aad, size_t aad_len,
+        const uint8_t* tag,
+        uint8_t* plaintext_out);
+
+    // Optional ctr32 and ctr32_polyval that write the output with
+    // non-temporal stores, which bypass the cache, and prefetch the input
+    // ahead without keeping it, for output that will not be read back soon.
+    // Output not aligned to 16 takes plain stores. Both fence their stores
+    // before returning. Both NULL if the kernel has none.
+    void (*ctr32_stream)(
+        const aes_key_schedule* ks, const uint8_t* counter,
+        const uint8_t* in, uint8_t* out, size_t len);
+    void (*ctr32_polyval_stream)(
+        const aes_key_schedule* ks, const uint8_t* counter,
+        const uint8_t* in, uint8_t* out, size_t len, polyval_state* pv);
+
+    // How many items ahead a batch prefetches the nonce, AAD, input and tag
+    // of, so scattered buffers are in cache by the time their item comes
+    // up: enough items to cover a memory access at the kernel's speed per
+    // item. 0 turns prefetching off.
+    unsigned int batch_prefetch;
+
+    // Widest vectors the bulk loops use, in bits, and the shortest message
+    // they use them for; shorter ones run on 128-bit code throughout. Read
+    // by aesgcmsiv_ctx_set_wide_min and the width counters in
+    // aesgcmsiv_op_stats.
+    unsigned int vector_bits;
+    size_t vector_min_bytes;
+};
+
+// Returns the AESGCMSIV_CPU_* bits for the running CPU and OS.
+uint32_t aesgcmsiv_detect_cpu_features();
+
+// Each probe returns the kernel if this build supports it and cpu_features
+// has every feature it needs, else NULL.
+const aesgcmsiv_kernel* aesni_kernel_probe(uint32_t cpu_features);
+const aesgcmsiv_kernel* vaes_kernel_probe(uint32_t cpu_features);
+const aesgcmsiv_kernel* armv8_kernel_probe(uint32_t cpu_features);
+// Portable constant-time kernel; every CPU qualifies unless the build
+// leaves it out
+const aesgcmsiv_kernel* bitsliced_kernel_probe(uint32_t cpu_features);
+// Kernel that does no cryptography, for measuring the code around it; only
+// in builds with AESGCMSIV_MOCK_KERNEL, and only when selected by name
+const aesgcmsiv_kernel* mock_kernel_probe(uint32_t cpu_features);
+
+// Encrypts under the key-generating key in ks. Parameters are assumed to be
+// validated by the caller. ciphertext_out may equal plaintext.
+int kernel_seal(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* ks,
+    const uint8_t* nonce,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out);
+
+// kernel_seal that also sets hash_out to the XXH3-64 hash of the
+// plaintext (see aesgcmsiv_xxh3.h, which cpu_features are for), taken block
+// by block beside POLYVAL so the plaintext is read from memory once for
+// both.
+int kernel_seal_hashed(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* ks,
+    const uint8_t* nonce,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out,
+    uint32_t cpu_features,
+    uint64_t* hash_out);
+
+// Decrypts and verifies under the key-generating key in ks. On tag mismatch
+// the plaintext output is zeroed. plaintext_out may equal ciphertext.
+int kernel_open(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* ks,
+    const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out);
+
+// kernel_seal and kernel_open under per-nonce keys already derived from
+// nonce by derive_keys, for callers that reuse one nonce.
+int kernel_seal_derived(
+    const aesgcmsiv_kernel* kernel,
+    const uint8_t* auth_key, const aes_key_schedule* enc_ks,
+    const uint8_t* nonce,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out);
+
+int kernel_open_derived(
+    const aesgcmsiv_kernel* kernel,
+    const uint8_t* auth_key, const aes_key_schedule* enc_ks,
+    const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out);
+
+// kernel_open that only reports whether the tag verifies. The plaintext is
+// decrypted into a small scratch buffer, hashed there and overwritten by the
+// next chunk, so none is written out and no output buffer is needed.
+int kernel_verify(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* ks,
+    const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag);
+
+int kernel_verify_derived(
+    const aesgcmsiv_kernel* kernel,
+    const uint8_t* auth_key, const aes_key_schedule* enc_ks,
+    const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag);
+
+// The second half of kernel_seal_derived and kernel_open_derived, for AAD
+// absorbed piece by piece: pv has taken the aad_len bytes of AAD, zero-padded
+// to a whole block, and was prepared for the message too. pv is cleared.
+int kernel_seal_absorbed(
+    const aesgcmsiv_kernel* kernel,
+    polyval_state* pv, size_t aad_len,
+    const aes_key_schedule* enc_ks,
+    const uint8_t* nonce,
+    const uint8_t* plaintext, size_t plaintext_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out);
+
+int kernel_open_absorbed(
+    const aesgcmsiv_kernel* kernel,
+    polyval_state* pv, size_t aad_len,
+    const aes_key_schedule* enc_ks,
+    const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out);
+
+// The tag for a message already absorbed into pv, AAD and message each
+// zero-padded to a whole block. pv is cleared.
+void kernel_absorbed_tag(
+    const aesgcmsiv_kernel* kernel,
+    polyval_state* pv, uint64_t aad_len, uint64_t msg_len,
+    const aes_key_schedule* enc_ks,
+    const uint8_t* nonce,
+    uint8_t* tag_out);
+
+// Where a CTR pass fed in pieces of any length has got to
+struct ctr32_stream {
+    alignas(16) uint8_t counter[16];  // the next whole block
+    alignas(16) uint8_t keystream[16];  // of the block before counter
+    size_t keystream_used;  // 16 when none is left
+};
+
+// Starts stream at the counter block for tag
+void ctr32_stream_init(ctr32_stream* stream, const uint8_t* tag);
+
+// Continues stream over len bytes; in == out is allowed
+void kernel_ctr32_stream(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* enc_ks,
+    ctr32_stream* stream,
+    const uint8_t* in, uint8_t* out, size_t len);
+
+// Encrypts items[0..count) under the key-generating key in ks, interleaving
+// short messages when the kernel has multi-buffer primitives. Items are
+// assumed to be validated by the caller.
+void kernel_seal_batch(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* ks,
+    const aesgcmsiv_batch_item* items, size_t count);
+
+// Decrypts every item whose status_out entry is AESGCMSIV_SUCCESS on entry
+// and overwrites that entry with the item's result. Other items are
+// skipped; the rest must be validated by the caller.
+void kernel_open_batch(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* ks,
+    const aesgcmsiv_batch_item* items, size_t count,
+    int* status_out);
+
+// kernel_seal_batch and kernel_open_batch with item i under the
+// key-generating key in schedules[slots[i]]. Short messages share lanes
+// whatever their keys, as long as the keys are the same size. Items and
+// slots are assumed to be validated by the caller.
+void kernel_seal_batch_keyed(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* schedules, const uint32_t* slots,
+    const aesgcmsiv_batch_item* items, size_t count);
+
+void kernel_open_batch_keyed(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* schedules, const uint32_t* slots,
+    const aesgcmsiv_batch_item* items, size_t count,
+    int* status_out);
+
+// kernel_seal of one plaintext for count recipients, recipient i under the
+// key-generating key in schedules[i] and the nonce at nonces + 12 * i, with
+// ciphertext to ciphertexts_out[i] and tag to tags_out + 16 * i. The
+// plaintext is read a cache-sized chunk at a time by a group of recipients
+// at once. No output may overlap the plaintext. Arguments are assumed to be
+// validated by the caller.
+void kernel_seal_multikey(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* schedules,
+    const uint8_t* nonces,
+    size_t count,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* const* ciphertexts_out,
+    uint8_t* tags_out);
+
+// kernel_seal spread across up to `threads` threads, the calling thread
+// included. Messages below kernel_parallel_min_bytes per thread, and
+// threads <= 1, take the serial path; 0 means one thread per hardware
+// thread, or per pool worker plus the caller. The shares run on pool when
+// it is not NULL, and on threads started for the call otherwise.
+int kernel_seal_parallel(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* ks,
+    unsigned int threads,
+    aesgcmsiv_pool* pool,
+    const uint8_t* nonce,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out);
+
+// kernel_open with the same splitting as kernel_seal_parallel.
+int kernel_open_parallel(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* ks,
+    unsigned int threads,
+    aesgcmsiv_pool* pool,
+    const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out);
+
+// kernel_seal and kernel_open over segmented buffers. Arguments must be
+// validated by the caller; the output holds at least as many bytes as the
+// input.
+int kernel_sealv(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* ks,
+    const uint8_t* nonce,
+    const aesgcmsiv_iovec* plaintext, size_t plaintext_count,
+    const aesgcmsiv_iovec* aad, size_t aad_count,
+    const aesgcmsiv_iovec_out* ciphertext_out, size_t ciphertext_count,
+    uint8_t* tag_out);
+
+int kernel_openv(
+    const aesgcmsiv_kernel* kernel,
+    const aes_key_schedule* ks,
+    const uint8_t* nonce,
+    const aesgcmsiv_iovec* ciphertext, size_t ciphertext_count,
+    const aesgcmsiv_iovec* aad, size_t aad_count,
+    const uint8_t* tag,
+    const aesgcmsiv_iovec_out* plaintext_out, size_t plaintext_count);
+
+// Overwrites memory in a way the compiler cannot elide.
+inline void aesgcmsiv_secure_zero(void* ptr, size_t len)
+{
+    volatile uint8_t* p = static_cast<volatile uint8_t*>(ptr);
+    while (len--) {
+        *p++ = 0;
+    }
+}
+
+// Constant-time comparison of two 16-byte tags. Returns true if equal.
+inline bool aesgcmsiv_tags_equal(const uint8_t* a, const uint8_t* b)
+{
+    uint8_t diff = 0;
+    for (int i = 0; i < 16; i++) {
+        diff |= static_cast<uint8_t>(a[i] ^ b[i]);
+    }
+    return diff == 0;
+}
+
+#endif // AESGCMSIV_KERNELS_H
@@ -0,0 +1,116 @@
+#include "aesgcmsiv_kernels.h"
+#include "aesgcmsiv.h"
+#include <cstring>
+
+// A kernel that does no cryptography, for measuring everything around the
+// cipher: validation, dispatch, batching and interop. Each primitive touches
+// its input and output once and mixes in the key, so ciphertext still
+// differs from plaintext and a wrong key or tampered message still fails to
+// open, but nothing here is secret from anyone.
+//
+// Only built with -DAESGCMSIV_MOCK_KERNEL=ON, and even then never chosen by
+// default; aesgcmsiv_select_backend("mock") switches to it.
+
+#ifdef AESGCMSIV_MOCK_KERNEL
+
+static void mock_xor_block(uint8_t* out, const uint8_t* a, const uint8_t* b)
+{
+    for (int i = 0; i < 16; i++) {
+        out[i] = static_cast<uint8_t>(a[i] ^ b[i]);
+    }
+}
+
+static void mock_expand_key(const uint8_t* key, size_t key_len, aes_key_schedule* ks)
+{
+    memset(ks, 0, sizeof(*ks));
+    memcpy(ks->round_keys[0], key, 16);
+    if (key_len == AESGCMSIV_KEY_SIZE_256) {
+        memcpy(ks->round_keys[1], key + 16, 16);
+    }
+    ks->rounds = key_len == AESGCMSIV_KEY_SIZE_256 ? 14 : 10;
+}
+
+static void mock_derive_keys(
+    const aes_key_schedule* ks, const uint8_t* nonce,
+    uint8_t* auth_key, aes_key_schedule* enc_ks)
+{
+    uint8_t block[16] = {};
+    memcpy(block, nonce, AESGCMSIV_NONCE_SIZE);
+    mock_xor_block(auth_key, ks->round_keys[0], block);
+    *enc_ks = *ks;
+    mock_xor_block(enc_ks->round_keys[0], ks->round_keys[1], block);
+}
+
+static void mock_encrypt_block(const aes_key_schedule* ks, const uint8_t* in, uint8_t* out)
+{
+    mock_xor_block(out, in, ks->round_keys[0]);
+}
+
+static void mock_polyval_init(polyval_state* pv, const uint8_t* h, size_t)
+{
+    memcpy(pv->h[0], h, 16);
+    memset(pv->s, 0, sizeof(pv->s));
+}
+
+static void mock_polyval_blocks(polyval_state* pv, const uint8_t* data, size_t blocks)
+{
+    uint8_t s[16];
+    memcpy(s, pv->s, 16);
+    for (size_t i = 0; i < blocks; i++) {
+        mock_xor_block(s, s, data + 16 * i);
+    }
+    mock_xor_block(pv->s, s, pv->h[0]);
+}
+
+static void mock_ctr32(
+    const aes_key_schedule* ks, const uint8_t* counter,
+    const uint8_t* in, uint8_t* out, size_t len)
+{
+    uint8_t pad[16];
+    mock_xor_block(pad, ks->round_keys[0], counter);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        uint8_t block[16];
+        mock_xor_block(block, in + i, pad);
+        memcpy(out + i, block, 16);
+    }
+    for (; i < len; i++) {
+        out[i] = static_cast<uint8_t>(in[i] ^ pad[i & 15]);
+    }
+}
+
+static const aesgcmsiv_kernel mock_kernel = {
+    "mock",
+    mock_expand_key,
+    mock_derive_keys,
+    mock_encrypt_block,
+    mock_polyval_init,
+    mock_polyval_blocks,
+    mock_ctr32,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    4,
+    128,
+    0,
+};
+
+const aesgcmsiv_kernel* mock_kernel_probe(uint32_t)
+{
+    return &mock_kernel;
+}
+
+#else // AESGCMSIV_MOCK_KERNEL
+
+const aesgcmsiv_kernel* mock_kernel_probe(uint32_t)
+{
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,112 @@
+#include "aesgcmsiv_notify.h"
+
+#if defined(_WIN32)
+
+#include <windows.h>
+
+bool aesgcmsiv_notify_open(aesgcmsiv_notify* notify)
+{
+    // Not inheritable, so a child process does not hold it
+    HANDLE event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (!event) {
+        return false;
+    }
+    notify->handle = reinterpret_cast<intptr_t>(event);
+    notify->write_end = notify->handle;
+    return true;
+}
+
+void aesgcmsiv_notify_raise(aesgcmsiv_notify* notify)
+{
+    SetEvent(reinterpret_cast<HANDLE>(notify->handle));
+}
+
+void aesgcmsiv_notify_clear(aesgcmsiv_notify* notify)
+{
+    ResetEvent(reinterpret_cast<HANDLE>(notify->handle));
+}
+
+void aesgcmsiv_notify_close(aesgcmsiv_notify* notify)
+{
+    CloseHandle(reinterpret_cast<HANDLE>(notify->handle));
+}
+
+#else
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+
+bool aesgcmsiv_notify_open(aesgcmsiv_notify* notify)
+{
+#if defined(__linux__)
+    const int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    notify->handle = fd;
+    notify->write_end = fd;
+    return true;
+#else
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return false;
+    }
+    for (int fd : fds) {
+        if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0 ||
+            fcntl(fd, F_SETFD, FD_CLOEXEC) != 0) {
+            close(fds[0]);
+            close(fds[1]);
+            return false;
+        }
+    }
+    notify->handle = fds[0];
+    notify->write_end = fds[1];
+    return true;
+#endif
+}
+
+// A write that finds the counter or the pipe full leaves it readable, which
+// is all a raise needs, so short writes are not retried
+void aesgcmsiv_notify_raise(aesgcmsiv_notify* notify)
+{
+#if defined(__linux__)
+    const uint64_t one = 1;
+    while (write(static_cast<int>(notify->write_end), &one, sizeof(one)) < 0 && errno == EINTR) {
+    }
+#else
+    const char one = 1;
+    while (write(static_cast<int>(notify->write_end), &one, 1) < 0 && errno == EINTR) {
+    }
+#endif
+}
+
+// Reads until the handle would block: one read resets an eventfd, and a
+// pipe is drained of every byte raised into it
+void aesgcmsiv_notify_clear(aesgcmsiv_notify* notify)
+{
+    uint64_t buffer[8];
+    for (;;) {
+        const ssize_t got = read(static_cast<int>(notify->handle), buffer, sizeof(buffer));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return;
+        }
+    }
+}
+
+void aesgcmsiv_notify_close(aesgcmsiv_notify* notify)
+{
+    close(static_cast<int>(notify->handle));
+    if (notify->write_end != notify->handle) {
+        close(static_cast<int>(notify->write_end));
+    }
+}
+
+#endif
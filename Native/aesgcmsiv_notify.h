@@ -0,0 +1,31 @@
+#ifndef AESGCMSIV_NOTIFY_H
+#define AESGCMSIV_NOTIFY_H
+
+// Internal level-triggered signal behind aesgcmsiv_engine_get_notify_handle,
+// which keeps <windows.h> out of the engine. Nothing in this header is
+// exported from the library.
+
+#include "aesgcmsiv.h"
+
+// handle is what an event loop waits on: an eventfd on Linux, the read end
+// of a non-blocking pipe elsewhere on POSIX, and a manual-reset event on
+// Windows. It is readable, or signaled, from a raise until the next clear.
+struct aesgcmsiv_notify {
+    intptr_t handle;
+    intptr_t write_end;  // the pipe's write end, else the same as handle
+};
+
+// Makes the handle, close-on-exec and unsignaled. False if the OS refuses.
+bool aesgcmsiv_notify_open(aesgcmsiv_notify* notify);
+
+// Signals the handle. Raising one already signaled does no harm, but costs
+// a system call, so callers track whether it is raised.
+void aesgcmsiv_notify_raise(aesgcmsiv_notify* notify);
+
+// Unsignals the handle
+void aesgcmsiv_notify_clear(aesgcmsiv_notify* notify);
+
+// Closes the handle
+void aesgcmsiv_notify_close(aesgcmsiv_notify* notify);
+
+#endif
@@ -0,0 +1,520 @@
+#include "aesgcmsiv_pool.h"
+#include <algorithm>
+#include <thread>
+
+// NUMA topology and CPU budget for the worker pool. Probed once, on first
+// use; a machine with a single node, or one whose layout cannot be read, is
+// reported as one node and every NUMA call here becomes a no-op.
+
+#if defined(__linux__)
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+struct NumaTopology {
+    unsigned int count;  // nodes with at least one CPU this process may use
+    unsigned long os_node[AESGCMSIV_NUMA_MAX_NODES];
+    cpu_set_t cpus[AESGCMSIV_NUMA_MAX_NODES];
+    unsigned int cpu_count[AESGCMSIV_NUMA_MAX_NODES];
+};
+
+// Reads a sysfs list such as "0-3,8,10-11" and calls add(n) for each number
+template <typename Add>
+bool read_list(const char* path, const Add& add)
+{
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+    char line[4096];
+    bool read = fgets(line, sizeof(line), file) != nullptr;
+    fclose(file);
+    if (!read) {
+        return false;
+    }
+
+    const char* p = line;
+    while (*p >= '0' && *p <= '9') {
+        char* end;
+        unsigned long first = strtoul(p, &end, 10);
+        unsigned long last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtoul(p + 1, &end, 10);
+            p = end;
+        }
+        for (unsigned long n = first; n <= last; n++) {
+            add(n);
+        }
+        if (*p != ',') {
+            break;
+        }
+        p++;
+    }
+    return true;
+}
+
+NumaTopology probe_topology()
+{
+    NumaTopology topology = {};
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return topology;
+    }
+
+    // Memory-only nodes have no CPUs and are left out; a page on one of them
+    // counts as being on no node
+    read_list("/sys/devices/system/node/online", [&](unsigned long id) {
+        if (topology.count == AESGCMSIV_NUMA_MAX_NODES) {
+            return;
+        }
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%lu/cpulist", id);
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        read_list(path, [&](unsigned long cpu) {
+            if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+                CPU_SET(cpu, &cpus);
+            }
+        });
+        int count = CPU_COUNT(&cpus);
+        if (count > 0) {
+            topology.os_node[topology.count] = id;
+            topology.cpus[topology.count] = cpus;
+            topology.cpu_count[topology.count] = static_cast<unsigned int>(count);
+            topology.count++;
+        }
+    });
+    return topology;
+}
+
+const NumaTopology& topology()
+{
+    static const NumaTopology probed = probe_topology();
+    return probed;
+}
+
+bool read_line(const char* path, char* line, size_t size)
+{
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+    bool read = fgets(line, static_cast<int>(size), file) != nullptr;
+    fclose(file);
+    return read;
+}
+
+// CPUs worth of time one cgroup's quota allows, or 0 if it sets none. v2
+// keeps "quota period" or "max period" in cpu.max; v1 keeps the two in
+// separate files, with a quota of -1 for none.
+unsigned int cgroup_dir_quota(const char* dir, bool v2)
+{
+    char path[4096 + 32];
+    char line[128];
+    long long quota = -1;
+    long long period = 0;
+    if (v2) {
+        snprintf(path, sizeof(path), "%s/cpu.max", dir);
+        if (!read_line(path, line, sizeof(line)) || sscanf(line, "%lld %lld", &quota, &period) != 2) {
+            return 0;
+        }
+    } else {
+        snprintf(path, sizeof(path), "%s/cpu.cfs_quota_us", dir);
+        if (!read_line(path, line, sizeof(line)) || sscanf(line, "%lld", &quota) != 1) {
+            return 0;
+        }
+        snprintf(path, sizeof(path), "%s/cpu.cfs_period_us", dir);
+        if (!read_line(path, line, sizeof(line)) || sscanf(line, "%lld", &period) != 1) {
+            return 0;
+        }
+    }
+    if (quota <= 0 || period <= 0) {
+        return 0;
+    }
+    long long cpus = (quota + period - 1) / period;
+    return static_cast<unsigned int>(std::min(cpus, 1LL << 20));
+}
+
+// Tightest quota on the cgroup at relative path under root or any of its
+// ancestors up to root, or 0 if none sets one. Inside a container the
+// cgroup namespace usually makes the container's own cgroup the root.
+unsigned int cgroup_tree_quota(const char* root, const char* relative, bool v2)
+{
+    char dir[4096];
+    int length = snprintf(dir, sizeof(dir), "%s%s", root, relative);
+    if (length <= 0 || static_cast<size_t>(length) >= sizeof(dir)) {
+        return 0;
+    }
+    const size_t root_length = strlen(root);
+    unsigned int tightest = 0;
+    for (;;) {
+        size_t end = strlen(dir);
+        while (end > root_length && dir[end - 1] == '/') {
+            dir[--end] = '\0';
+        }
+        unsigned int quota = cgroup_dir_quota(dir, v2);
+        if (quota != 0 && (tightest == 0 || quota < tightest)) {
+            tightest = quota;
+        }
+        char* slash = strrchr(dir, '/');
+        if (end <= root_length || !slash || static_cast<size_t>(slash - dir) < root_length) {
+            return tightest;
+        }
+        *slash = '\0';
+    }
+}
+
+// CPU quota of the process's cgroup, v2 or v1, or 0 if it has none. Only
+// the usual mount points are looked at.
+unsigned int cgroup_quota()
+{
+    FILE* file = fopen("/proc/self/cgroup", "r");
+    if (!file) {
+        return 0;
+    }
+    unsigned int quota = 0;
+    char line[4096];
+    while (quota == 0 && fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\n")] = '\0';
+        // hierarchy-id:controllers:path
+        char* controllers = strchr(line, ':');
+        char* relative = controllers ? strchr(controllers + 1, ':') : nullptr;
+        if (!relative) {
+            continue;
+        }
+        *relative++ = '\0';
+        controllers++;
+        if (strcmp(line, "0") == 0 && *controllers == '\0') {
+            quota = cgroup_tree_quota("/sys/fs/cgroup", relative, true);
+            continue;
+        }
+        bool cpu = false;
+        char* rest = nullptr;
+        for (char* name = strtok_r(controllers, ",", &rest); name; name = strtok_r(nullptr, ",", &rest)) {
+            cpu |= strcmp(name, "cpu") == 0;
+        }
+        if (cpu) {
+            quota = cgroup_tree_quota("/sys/fs/cgroup/cpu,cpuacct", relative, false);
+            if (quota == 0) {
+                quota = cgroup_tree_quota("/sys/fs/cgroup/cpu", relative, false);
+            }
+        }
+    }
+    fclose(file);
+    return quota;
+}
+
+// The affinity mask already reflects a cgroup cpuset
+unsigned int probe_cpu_budget()
+{
+    unsigned int cpus = 0;
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        cpus = static_cast<unsigned int>(CPU_COUNT(&allowed));
+    }
+    if (cpus == 0) {
+        cpus = std::thread::hardware_concurrency();
+    }
+    unsigned int quota = cgroup_quota();
+    if (quota != 0) {
+        cpus = std::min(cpus, quota);
+    }
+    return std::max(cpus, 1u);
+}
+
+int node_index(const NumaTopology& topology, unsigned long os_node)
+{
+    for (unsigned int i = 0; i < topology.count; i++) {
+        if (topology.os_node[i] == os_node) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+} // namespace
+
+unsigned int aesgcmsiv_numa_nodes()
+{
+    return topology().count > 1 ? topology().count : 1;
+}
+
+unsigned int aesgcmsiv_numa_node_cpus(unsigned int node)
+{
+    const NumaTopology& t = topology();
+    return t.count > 1 ? t.cpu_count[node] : std::thread::hardware_concurrency();
+}
+
+bool aesgcmsiv_numa_bind_thread(unsigned int node)
+{
+    const NumaTopology& t = topology();
+    return t.count > 1 && sched_setaffinity(0, sizeof(t.cpus[node]), &t.cpus[node]) == 0;
+}
+
+int aesgcmsiv_numa_current_node()
+{
+    const NumaTopology& t = topology();
+    if (t.count < 2) {
+        return 0;
+    }
+    int cpu = sched_getcpu();
+    for (unsigned int i = 0; cpu >= 0 && i < t.count; i++) {
+        if (CPU_ISSET(cpu, &t.cpus[i])) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+void aesgcmsiv_numa_nodes_of(const void* const* addresses, unsigned int count, int* nodes_out)
+{
+    for (unsigned int i = 0; i < count; i++) {
+        nodes_out[i] = -1;
+    }
+    const NumaTopology& t = topology();
+#ifdef SYS_move_pages
+    if (t.count < 2) {
+        return;
+    }
+
+    // move_pages with no target nodes only reports where each page is. An
+    // address that is unmapped or not yet touched gets a negative status.
+    const uintptr_t page_mask = ~static_cast<uintptr_t>(sysconf(_SC_PAGESIZE) - 1);
+    for (unsigned int base = 0; base < count; base += 64) {
+        unsigned int n = count - base < 64 ? count - base : 64;
+        void* pages[64];
+        int status[64];
+        for (unsigned int i = 0; i < n; i++) {
+            pages[i] = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(addresses[base + i]) & page_mask);
+        }
+        if (syscall(SYS_move_pages, 0, static_cast<unsigned long>(n), pages, nullptr, status, 0) != 0) {
+            return;
+        }
+        for (unsigned int i = 0; i < n; i++) {
+            if (addresses[base + i] && status[i] >= 0) {
+                nodes_out[base + i] = node_index(t, static_cast<unsigned long>(status[i]));
+            }
+        }
+    }
+#else
+    (void)addresses;
+    (void)t;
+#endif
+}
+
+long aesgcmsiv_numa_os_node(unsigned int node)
+{
+    const NumaTopology& t = topology();
+    return t.count > 1 && node < t.count ? static_cast<long>(t.os_node[node]) : -1;
+}
+
+#elif defined(_WIN32)
+
+#include <windows.h>
+#include <psapi.h>
+
+namespace {
+
+struct NumaTopology {
+    unsigned int count;  // nodes with at least one processor
+    USHORT os_node[AESGCMSIV_NUMA_MAX_NODES];
+    GROUP_AFFINITY affinity[AESGCMSIV_NUMA_MAX_NODES];
+    unsigned int cpu_count[AESGCMSIV_NUMA_MAX_NODES];
+};
+
+NumaTopology probe_topology()
+{
+    NumaTopology topology = {};
+    ULONG highest = 0;
+    if (!GetNumaHighestNodeNumber(&highest)) {
+        return topology;
+    }
+    for (ULONG id = 0; id <= highest && topology.count < AESGCMSIV_NUMA_MAX_NODES; id++) {
+        GROUP_AFFINITY affinity = {};
+        if (!GetNumaNodeProcessorMaskEx(static_cast<USHORT>(id), &affinity) || affinity.Mask == 0) {
+            continue;
+        }
+        unsigned int cpus = 0;
+        for (KAFFINITY mask = affinity.Mask; mask; mask &= mask - 1) {
+            cpus++;
+        }
+        topology.os_node[topology.count] = static_cast<USHORT>(id);
+        topology.affinity[topology.count] = affinity;
+        topology.cpu_count[topology.count] = cpus;
+        topology.count++;
+    }
+    return topology;
+}
+
+const NumaTopology& topology()
+{
+    static const NumaTopology probed = probe_topology();
+    return probed;
+}
+
+// Processors in the process's affinity mask, capped by a hard CPU rate
+// limit on its job object, such as a container's CPU count. The rate is in
+// hundredths of a percent of every processor on the machine.
+unsigned int probe_cpu_budget()
+{
+    unsigned int cpus = 0;
+    DWORD_PTR process_mask = 0;
+    DWORD_PTR system_mask = 0;
+    if (GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask)) {
+        for (DWORD_PTR mask = process_mask; mask; mask &= mask - 1) {
+            cpus++;
+        }
+    }
+    if (cpus == 0) {
+        cpus = std::thread::hardware_concurrency();
+    }
+
+    JOBOBJECT_CPU_RATE_CONTROL_INFORMATION rate = {};
+    const DWORD hard_cap = JOB_OBJECT_CPU_RATE_CONTROL_ENABLE | JOB_OBJECT_CPU_RATE_CONTROL_HARD_CAP;
+    if (QueryInformationJobObject(nullptr, JobObjectCpuRateControlInformation, &rate, sizeof(rate), nullptr) &&
+        (rate.ControlFlags & hard_cap) == hard_cap && rate.CpuRate > 0) {
+        unsigned long long total = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+        unsigned long long capped = (rate.CpuRate * total + 9999) / 10000;
+        cpus = static_cast<unsigned int>(std::min<unsigned long long>(cpus, std::max(capped, 1ULL)));
+    }
+    return std::max(cpus, 1u);
+}
+
+int node_index(const NumaTopology& topology, ULONG os_node)
+{
+    for (unsigned int i = 0; i < topology.count; i++) {
+        if (topology.os_node[i] == os_node) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+} // namespace
+
+unsigned int aesgcmsiv_numa_nodes()
+{
+    return topology().count > 1 ? topology().count : 1;
+}
+
+unsigned int aesgcmsiv_numa_node_cpus(unsigned int node)
+{
+    const NumaTopology& t = topology();
+    return t.count > 1 ? t.cpu_count[node] : std::thread::hardware_concurrency();
+}
+
+bool aesgcmsiv_numa_bind_thread(unsigned int node)
+{
+    const NumaTopology& t = topology();
+    return t.count > 1 && SetThreadGroupAffinity(GetCurrentThread(), &t.affinity[node], nullptr);
+}
+
+int aesgcmsiv_numa_current_node()
+{
+    const NumaTopology& t = topology();
+    if (t.count < 2) {
+        return 0;
+    }
+    PROCESSOR_NUMBER processor;
+    GetCurrentProcessorNumberEx(&processor);
+    USHORT os_node;
+    return GetNumaProcessorNodeEx(&processor, &os_node) ? node_index(t, os_node) : -1;
+}
+
+void aesgcmsiv_numa_nodes_of(const void* const* addresses, unsigned int count, int* nodes_out)
+{
+    for (unsigned int i = 0; i < count; i++) {
+        nodes_out[i] = -1;
+    }
+    const NumaTopology& t = topology();
+    if (t.count < 2) {
+        return;
+    }
+
+    // Only pages resident in the working set report a node
+    for (unsigned int base = 0; base < count; base += 64) {
+        unsigned int n = count - base < 64 ? count - base : 64;
+        PSAPI_WORKING_SET_EX_INFORMATION info[64] = {};
+        for (unsigned int i = 0; i < n; i++) {
+            info[i].VirtualAddress = const_cast<void*>(addresses[base + i]);
+        }
+        if (!QueryWorkingSetEx(GetCurrentProcess(), info, static_cast<DWORD>(n * sizeof(info[0])))) {
+            return;
+        }
+        for (unsigned int i = 0; i < n; i++) {
+            if (addresses[base + i] && info[i].VirtualAttributes.Valid) {
+                nodes_out[base + i] = node_index(t, static_cast<ULONG>(info[i].VirtualAttributes.Node));
+            }
+        }
+    }
+}
+
+long aesgcmsiv_numa_os_node(unsigned int node)
+{
+    const NumaTopology& t = topology();
+    return t.count > 1 && node < t.count ? static_cast<long>(t.os_node[node]) : -1;
+}
+
+#else
+
+namespace {
+
+unsigned int probe_cpu_budget()
+{
+    return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+} // namespace
+
+unsigned int aesgcmsiv_numa_nodes()
+{
+    return 1;
+}
+
+unsigned int aesgcmsiv_numa_node_cpus(unsigned int node)
+{
+    (void)node;
+    return std::thread::hardware_concurrency();
+}
+
+bool aesgcmsiv_numa_bind_thread(unsigned int node)
+{
+    (void)node;
+    return false;
+}
+
+int aesgcmsiv_numa_current_node()
+{
+    return 0;
+}
+
+void aesgcmsiv_numa_nodes_of(const void* const* addresses, unsigned int count, int* nodes_out)
+{
+    (void)addresses;
+    for (unsigned int i = 0; i < count; i++) {
+        nodes_out[i] = -1;
+    }
+}
+
+long aesgcmsiv_numa_os_node(unsigned int node)
+{
+    (void)node;
+    return -1;
+}
+
+#endif
+
+unsigned int aesgcmsiv_cpu_budget()
+{
+    static const unsigned int budget = probe_cpu_budget();
+    return budget;
+}
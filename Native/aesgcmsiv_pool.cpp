@@ -0,0 +1,543 @@
+#include "aesgcmsiv_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+
+// Tasks one worker's deque holds; a call that finds it full runs the task
+// on the spot
+#define POOL_DEQUE_CAPACITY 256
+
+// Tasks whose home nodes are looked up at once
+#define POOL_PLACE_SLICE 64
+
+namespace {
+
+// One aesgcmsiv_pool_run call. It lives on the caller's stack, which waits
+// under done_mutex for the last task, so a worker that finishes a task
+// releases the mutex before the job can go away.
+struct PoolJob {
+    void (*fn)(void*, unsigned int);
+    void* arg;
+    unsigned int remaining;  // guarded by done_mutex
+    std::mutex done_mutex;
+    std::condition_variable done;
+};
+
+// A task of a PoolJob, or with job NULL one posted on its own, which runs
+// post(post_arg) and is waited for by nobody
+struct PoolTask {
+    PoolJob* job;
+    unsigned int index;
+    void (*post)(void*);
+    void* post_arg;
+};
+
+// Fixed-size deque. The owner pushes and pops at the back, so it works on
+// the tasks it queued most recently; thieves take from the front, where the
+// oldest and usually largest remaining work sits. A lock per deque is
+// enough: the owner is nearly always its only user.
+class WorkDeque {
+public:
+    WorkDeque() : head_(0), size_(0) {}
+
+    bool push(const PoolTask& task)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (size_ == POOL_DEQUE_CAPACITY) {
+            return false;
+        }
+        tasks_[(head_ + size_) % POOL_DEQUE_CAPACITY] = task;
+        size_++;
+        return true;
+    }
+
+    bool pop(PoolTask* task)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (size_ == 0) {
+            return false;
+        }
+        size_--;
+        *task = tasks_[(head_ + size_) % POOL_DEQUE_CAPACITY];
+        return true;
+    }
+
+    bool steal(PoolTask* task)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (size_ == 0) {
+            return false;
+        }
+        *task = tasks_[head_];
+        head_ = (head_ + 1) % POOL_DEQUE_CAPACITY;
+        size_--;
+        return true;
+    }
+
+private:
+    std::mutex mutex_;
+    PoolTask tasks_[POOL_DEQUE_CAPACITY];
+    size_t head_;
+    size_t size_;
+};
+
+} // namespace
+
+// Workers are grouped by NUMA node. An unpinned pool has a single node
+// holding every worker. Each node parks its idle workers on its own
+// condition variable, so work queued for one node does not wake the others.
+//
+// A hosted pool (aesgcmsiv_pool_create_hosted) starts no threads. Its
+// deques are filled the same way, and instead of waking a worker it asks
+// the host to lend a thread, which drains the deques in aesgcmsiv_pool_work
+// and leaves once they are empty.
+struct aesgcmsiv_pool {
+    unsigned int worker_count;
+    unsigned int node_count;
+    bool node_local;  // tasks are queued on the node holding their data
+    WorkDeque deques[AESGCMSIV_POOL_MAX_WORKERS];
+    std::thread threads[AESGCMSIV_POOL_MAX_WORKERS];
+    unsigned int worker_node[AESGCMSIV_POOL_MAX_WORKERS];
+    unsigned int node_size[AESGCMSIV_POOL_MAX_WORKERS];
+    unsigned char node_workers[AESGCMSIV_POOL_MAX_WORKERS][AESGCMSIV_POOL_MAX_WORKERS];
+    std::atomic<unsigned int> node_next[AESGCMSIV_POOL_MAX_WORKERS];  // next worker given a task for the node
+    std::atomic<size_t> pending;  // queued, not yet taken
+    std::atomic<unsigned int> next_deque;  // where an outside caller starts queuing
+    std::atomic<unsigned int> parked[AESGCMSIV_POOL_MAX_WORKERS];  // per node
+    std::atomic<bool> stopping;
+    std::mutex park_mutex;
+    std::condition_variable work_ready[AESGCMSIV_POOL_MAX_WORKERS];  // per node
+    aesgcmsiv_schedule_fn schedule;  // set for a hosted pool
+    void* schedule_user_data;
+    unsigned int helpers;  // host threads asked for and not yet gone; guarded by park_mutex
+    std::condition_variable helpers_gone;
+};
+
+// The worker the current thread is, if it belongs to a pool
+static thread_local aesgcmsiv_pool* tls_pool;
+static thread_local unsigned int tls_worker;
+
+// Takes a task from the worker's own deque, or steals one, trying the
+// workers of node first. self is worker_count for a thread outside the pool,
+// and node is node_count when the thread's node is unknown.
+static bool take_task(aesgcmsiv_pool* pool, unsigned int self, unsigned int node, PoolTask* task)
+{
+    if (self < pool->worker_count && pool->deques[self].pop(task)) {
+        pool->pending.fetch_sub(1, std::memory_order_seq_cst);
+        return true;
+    }
+    if (pool->node_count > 1 && node < pool->node_count) {
+        for (unsigned int i = 0; i < pool->node_size[node]; i++) {
+            unsigned int victim = pool->node_workers[node][i];
+            if (victim != self && pool->deques[victim].steal(task)) {
+                pool->pending.fetch_sub(1, std::memory_order_seq_cst);
+                return true;
+            }
+        }
+    }
+    for (unsigned int i = 1; i <= pool->worker_count; i++) {
+        unsigned int victim = (self + i) % pool->worker_count;
+        if (victim != self && pool->deques[victim].steal(task)) {
+            pool->pending.fetch_sub(1, std::memory_order_seq_cst);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void run_task(const PoolTask& task)
+{
+    PoolJob* job = task.job;
+    if (!job) {
+        task.post(task.post_arg);
+        return;
+    }
+    job->fn(job->arg, task.index);
+    std::lock_guard<std::mutex> lock(job->done_mutex);
+    if (--job->remaining == 0) {
+        job->done.notify_all();
+    }
+}
+
+static void pool_worker(aesgcmsiv_pool* pool, unsigned int self)
+{
+    tls_pool = pool;
+    tls_worker = self;
+    const unsigned int node = pool->worker_node[self];
+    if (pool->node_count > 1) {
+        // A worker that cannot be pinned still runs, only without locality
+        aesgcmsiv_numa_bind_thread(node);
+    }
+
+    for (;;) {
+        PoolTask task;
+        if (take_task(pool, self, node, &task)) {
+            run_task(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(pool->park_mutex);
+        pool->parked[node].fetch_add(1, std::memory_order_seq_cst);
+        if (pool->pending.load(std::memory_order_seq_cst) == 0) {
+            if (pool->stopping.load(std::memory_order_seq_cst)) {
+                pool->parked[node].fetch_sub(1, std::memory_order_relaxed);
+                return;
+            }
+            pool->work_ready[node].wait(lock);
+        }
+        pool->parked[node].fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+// Node the calling thread runs on, or node_count if unknown
+static unsigned int caller_node(const aesgcmsiv_pool* pool, unsigned int self)
+{
+    if (self < pool->worker_count) {
+        return pool->worker_node[self];
+    }
+    if (pool->node_count < 2) {
+        return 0;
+    }
+    int node = aesgcmsiv_numa_current_node();
+    return node >= 0 && static_cast<unsigned int>(node) < pool->node_count
+        ? static_cast<unsigned int>(node)
+        : pool->node_count;
+}
+
+// Home node of each of count tasks, -1 where there is no preference
+static void place_tasks(
+    const aesgcmsiv_pool* pool, const void* const* homes, unsigned int count, int* nodes)
+{
+    if (!pool->node_local || !homes) {
+        for (unsigned int i = 0; i < count; i++) {
+            nodes[i] = -1;
+        }
+        return;
+    }
+    aesgcmsiv_numa_nodes_of(homes, count, nodes);
+    for (unsigned int i = 0; i < count; i++) {
+        if (nodes[i] >= static_cast<int>(pool->node_count) || (nodes[i] >= 0 && pool->node_size[nodes[i]] == 0)) {
+            nodes[i] = -1;
+        }
+    }
+}
+
+// Asks the host of a hosted pool for up to wanted more threads, never
+// holding more than worker_count at once. A thread about to leave checks
+// pending under the same lock, so queued work always finds one.
+static void request_helpers(aesgcmsiv_pool* pool, unsigned int wanted)
+{
+    unsigned int granted;
+    {
+        std::lock_guard<std::mutex> lock(pool->park_mutex);
+        granted = std::min(wanted, pool->worker_count - pool->helpers);
+        pool->helpers += granted;
+    }
+    for (unsigned int i = 0; i < granted; i++) {
+        pool->schedule(pool->schedule_user_data, pool);
+    }
+}
+
+unsigned int aesgcmsiv_pool_workers(const aesgcmsiv_pool* pool)
+{
+    return pool->worker_count;
+}
+
+void aesgcmsiv_pool_run(
+    aesgcmsiv_pool* pool, unsigned int count,
+    void (*fn)(void* arg, unsigned int index), void* arg,
+    const void* const* homes)
+{
+    if (count == 0) {
+        return;
+    }
+
+    PoolJob job;
+    job.fn = fn;
+    job.arg = arg;
+    job.remaining = count;
+
+    // A task with a home node goes to that node's workers in turn. Of the
+    // rest, a worker queues on its own deque, so nested calls stay local
+    // until someone steals them, and an outside caller deals them round the
+    // workers. The caller keeps the first task that is not homed elsewhere,
+    // which is task 0 unless the pool places tasks by node.
+    unsigned int self = tls_pool == pool ? tls_worker : pool->worker_count;
+    unsigned int node = caller_node(pool, self);
+    unsigned int start = self < pool->worker_count
+        ? self
+        : pool->next_deque.fetch_add(1, std::memory_order_relaxed);
+    unsigned int dealt = 0;
+    unsigned int keep = count;
+    unsigned int queued = 0;
+    unsigned int queued_on[AESGCMSIV_POOL_MAX_WORKERS] = {};
+    for (unsigned int base = 0; base < count; base += POOL_PLACE_SLICE) {
+        unsigned int slice = std::min(count - base, static_cast<unsigned int>(POOL_PLACE_SLICE));
+        int nodes[POOL_PLACE_SLICE];
+        place_tasks(pool, homes ? homes + base : nullptr, slice, nodes);
+        for (unsigned int j = 0; j < slice; j++) {
+            PoolTask task = { &job, base + j, nullptr, nullptr };
+            int home = nodes[j];
+            if (keep == count && (home < 0 || static_cast<unsigned int>(home) == node)) {
+                keep = task.index;
+                continue;
+            }
+            unsigned int target;
+            if (home >= 0) {
+                unsigned int turn = pool->node_next[home].fetch_add(1, std::memory_order_relaxed);
+                target = pool->node_workers[home][turn % pool->node_size[home]];
+            } else if (self < pool->worker_count) {
+                target = self;
+            } else {
+                target = (start + ++dealt) % pool->worker_count;
+            }
+            if (pool->deques[target].push(task)) {
+                pool->pending.fetch_add(1, std::memory_order_seq_cst);
+                queued_on[pool->worker_node[target]]++;
+                queued++;
+            } else {
+                run_task(task);
+            }
+        }
+    }
+
+    if (queued > 0 && pool->schedule) {
+        request_helpers(pool, queued);
+    } else if (queued > 0) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::unique_lock<std::mutex> lock(pool->park_mutex, std::defer_lock);
+        for (unsigned int n = 0; n < pool->node_count; n++) {
+            if (queued_on[n] == 0 || pool->parked[n].load(std::memory_order_seq_cst) == 0) {
+                continue;
+            }
+            if (!lock.owns_lock()) {
+                lock.lock();
+            }
+            if (queued_on[n] == 1) {
+                pool->work_ready[n].notify_one();
+            } else {
+                pool->work_ready[n].notify_all();
+            }
+        }
+    }
+
+    if (keep < count) {
+        run_task(PoolTask{ &job, keep, nullptr, nullptr });
+    }
+
+    // Help with whatever is queued, then wait for tasks still running
+    PoolTask task;
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lock(job.done_mutex);
+            if (job.remaining == 0) {
+                break;
+            }
+        }
+        if (!take_task(pool, self, node, &task)) {
+            break;
+        }
+        run_task(task);
+    }
+    std::unique_lock<std::mutex> lock(job.done_mutex);
+    job.done.wait(lock, [&job] { return job.remaining == 0; });
+}
+
+bool aesgcmsiv_pool_post(aesgcmsiv_pool* pool, void (*fn)(void* arg), void* arg)
+{
+    // Dealt round the workers like an outside caller's tasks; a worker
+    // posting keeps the task on its own deque unless someone steals it
+    const PoolTask task = { nullptr, 0, fn, arg };
+    unsigned int self = tls_pool == pool ? tls_worker : pool->worker_count;
+    unsigned int start = self < pool->worker_count
+        ? self
+        : pool->next_deque.fetch_add(1, std::memory_order_relaxed);
+    for (unsigned int i = 0; i < pool->worker_count; i++) {
+        unsigned int target = (start + i) % pool->worker_count;
+        if (!pool->deques[target].push(task)) {
+            continue;
+        }
+        pool->pending.fetch_add(1, std::memory_order_seq_cst);
+        if (pool->schedule) {
+            request_helpers(pool, 1);
+            return true;
+        }
+        unsigned int node = pool->worker_node[target];
+        if (pool->parked[node].load(std::memory_order_seq_cst) > 0) {
+            std::lock_guard<std::mutex> lock(pool->park_mutex);
+            pool->work_ready[node].notify_one();
+        }
+        return true;
+    }
+    return false;
+}
+
+extern "C" {
+
+unsigned int aesgcmsiv_available_cpus(void)
+{
+    return aesgcmsiv_cpu_budget();
+}
+
+int aesgcmsiv_pool_create(unsigned int workers, aesgcmsiv_pool** pool_out)
+{
+    return aesgcmsiv_pool_create_ex(workers, 0, pool_out);
+}
+
+int aesgcmsiv_pool_create_ex(unsigned int workers, uint32_t flags, aesgcmsiv_pool** pool_out)
+{
+    if (!pool_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *pool_out = nullptr;
+    if (flags & ~(AESGCMSIV_POOL_PIN_NODES | AESGCMSIV_POOL_NODE_LOCAL)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    // The calling thread takes part in every call, so by default one
+    // hardware thread is left for it
+    if (workers == 0) {
+        unsigned int cpus = aesgcmsiv_cpu_budget();
+        workers = cpus > 1 ? cpus - 1 : 1;
+    }
+    workers = std::min(workers, static_cast<unsigned int>(AESGCMSIV_POOL_MAX_WORKERS));
+
+    aesgcmsiv_pool* pool = new (std::nothrow) aesgcmsiv_pool();
+    if (!pool) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+
+    // Pinned workers are dealt to nodes in proportion to their CPUs, in
+    // node order, so worker w sits on the node holding the (w * cpus /
+    // workers)th CPU. Placing tasks by node needs the workers pinned.
+    unsigned int nodes = (flags & (AESGCMSIV_POOL_PIN_NODES | AESGCMSIV_POOL_NODE_LOCAL))
+        ? std::min(aesgcmsiv_numa_nodes(), workers)
+        : 1;
+    unsigned int cpus = 0;
+    for (unsigned int n = 0; n < nodes; n++) {
+        cpus += aesgcmsiv_numa_node_cpus(n);
+    }
+    for (unsigned int w = 0, n = 0, node_end = nodes > 1 ? aesgcmsiv_numa_node_cpus(0) : 1; w < workers; w++) {
+        if (nodes > 1) {
+            size_t position = static_cast<size_t>(w) * cpus / workers;
+            while (position >= node_end && n + 1 < nodes) {
+                node_end += aesgcmsiv_numa_node_cpus(++n);
+            }
+        }
+        pool->worker_node[w] = n;
+        pool->node_workers[n][pool->node_size[n]++] = static_cast<unsigned char>(w);
+    }
+    pool->node_count = nodes;
+    pool->node_local = nodes > 1 && (flags & AESGCMSIV_POOL_NODE_LOCAL);
+
+    // Workers read the pool's layout, so it is set before any starts.
+    // Nothing is thrown out of the library: if a thread cannot be started
+    // the pool is torn down and creation fails.
+    unsigned int started = 0;
+    pool->worker_count = workers;
+    for (; started < workers; started++) {
+        try {
+            pool->threads[started] = std::thread(pool_worker, pool, started);
+        } catch (...) {
+            break;
+        }
+    }
+    if (started < workers) {
+        aesgcmsiv_pool_destroy(pool);
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+
+    *pool_out = pool;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_pool_create_hosted(
+    unsigned int workers, aesgcmsiv_schedule_fn schedule, void* user_data, aesgcmsiv_pool** pool_out)
+{
+    if (!pool_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *pool_out = nullptr;
+    if (!schedule) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    if (workers == 0) {
+        unsigned int cpus = aesgcmsiv_cpu_budget();
+        workers = cpus > 1 ? cpus - 1 : 1;
+    }
+    workers = std::min(workers, static_cast<unsigned int>(AESGCMSIV_POOL_MAX_WORKERS));
+
+    aesgcmsiv_pool* pool = new (std::nothrow) aesgcmsiv_pool();
+    if (!pool) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    for (unsigned int w = 0; w < workers; w++) {
+        pool->node_workers[0][w] = static_cast<unsigned char>(w);
+    }
+    pool->worker_count = workers;
+    pool->node_count = 1;
+    pool->node_size[0] = workers;
+    pool->schedule = schedule;
+    pool->schedule_user_data = user_data;
+
+    *pool_out = pool;
+    return AESGCMSIV_SUCCESS;
+}
+
+void aesgcmsiv_pool_work(aesgcmsiv_pool* pool)
+{
+    if (!pool || !pool->schedule) {
+        return;
+    }
+    for (;;) {
+        PoolTask task;
+        while (take_task(pool, pool->worker_count, 0, &task)) {
+            run_task(task);
+        }
+
+        // The pool may be freed as soon as the last helper has gone, so
+        // leaving is the last thing done under the lock
+        std::lock_guard<std::mutex> lock(pool->park_mutex);
+        if (pool->pending.load(std::memory_order_seq_cst) > 0) {
+            continue;
+        }
+        if (--pool->helpers == 0) {
+            pool->helpers_gone.notify_all();
+        }
+        return;
+    }
+}
+
+void aesgcmsiv_pool_destroy(aesgcmsiv_pool* pool)
+{
+    if (!pool) {
+        return;
+    }
+    if (pool->schedule) {
+        // Host threads already asked for still arrive and drain what is left
+        std::unique_lock<std::mutex> lock(pool->park_mutex);
+        pool->helpers_gone.wait(lock, [pool] { return pool->helpers == 0; });
+        lock.unlock();
+        delete pool;
+        return;
+    }
+    pool->stopping.store(true, std::memory_order_seq_cst);
+    {
+        std::lock_guard<std::mutex> lock(pool->park_mutex);
+        for (unsigned int n = 0; n < AESGCMSIV_POOL_MAX_WORKERS; n++) {
+            pool->work_ready[n].notify_all();
+        }
+    }
+    for (unsigned int i = 0; i < AESGCMSIV_POOL_MAX_WORKERS; i++) {
+        if (pool->threads[i].joinable()) {
+            pool->threads[i].join();
+        }
+    }
+    delete pool;
+}
+
+} // extern "C"
@@ -0,0 +1,77 @@
+#ifndef AESGCMSIV_POOL_H
+#define AESGCMSIV_POOL_H
+
+// Internal interface to the work-stealing pool behind aesgcmsiv_pool_create.
+// Nothing in this header is exported from the library.
+
+#include "aesgcmsiv.h"
+
+// Most worker threads a pool starts
+#define AESGCMSIV_POOL_MAX_WORKERS 64
+
+// Number of pool workers; a call running on the pool also uses its caller
+unsigned int aesgcmsiv_pool_workers(const aesgcmsiv_pool* pool);
+
+// Runs fn(arg, 0)..fn(arg, count - 1) on the pool's workers and the calling
+// thread and returns once all have finished. The tasks are spread over the
+// workers' deques; a worker that runs out steals from the others, and the
+// caller steals too rather than sit idle.
+//
+// homes, if not NULL, holds for each task an address in the memory it mostly
+// reads. A pool created with AESGCMSIV_POOL_NODE_LOCAL queues each task on a
+// worker of the NUMA node holding that page; other pools ignore it.
+void aesgcmsiv_pool_run(
+    aesgcmsiv_pool* pool, unsigned int count,
+    void (*fn)(void* arg, unsigned int index), void* arg,
+    const void* const* homes);
+
+// Queues fn(arg) on one of the pool's workers and returns at once; the task
+// runs some time before the pool is destroyed. Returns false, and queues
+// nothing, if every worker's deque is full.
+bool aesgcmsiv_pool_post(aesgcmsiv_pool* pool, void (*fn)(void* arg), void* arg);
+
+// aesgcmsiv_pool_run for a callable taking the task index
+template <typename Work>
+void aesgcmsiv_pool_for(
+    aesgcmsiv_pool* pool, unsigned int count, const Work& work,
+    const void* const* homes = nullptr)
+{
+    aesgcmsiv_pool_run(pool, count,
+        [](void* arg, unsigned int index) { (*static_cast<const Work*>(arg))(index); },
+        const_cast<Work*>(&work), homes);
+}
+
+// NUMA topology (aesgcmsiv_numa.cpp). Nodes are numbered from 0 in the order
+// the OS lists them, counting only those with a CPU the process may use. On
+// a machine that is not NUMA, or whose layout cannot be read, there is one
+// node and binding a thread does nothing.
+#define AESGCMSIV_NUMA_MAX_NODES 64
+
+unsigned int aesgcmsiv_numa_nodes();
+
+// CPUs on node that the process may use
+unsigned int aesgcmsiv_numa_node_cpus(unsigned int node);
+
+// Restricts the calling thread to the CPUs of node. Returns false if it
+// stays where it was.
+bool aesgcmsiv_numa_bind_thread(unsigned int node);
+
+// Node of the CPU the calling thread is running on, or -1 if unknown
+int aesgcmsiv_numa_current_node();
+
+// Node holding the page at each address, or -1 where that is unknown, which
+// includes NULL and pages not yet touched
+void aesgcmsiv_numa_nodes_of(const void* const* addresses, unsigned int count, int* nodes_out);
+
+// The OS's number for node, or -1 on a machine with one node or for a node
+// out of range
+long aesgcmsiv_numa_os_node(unsigned int node);
+
+// CPUs the process can keep busy, read once: the processors its affinity
+// mask allows, which reflects a cgroup cpuset, capped by a cgroup v1 or v2
+// CPU quota on Linux or a hard CPU rate cap on its job object on Windows.
+// At least 1. Sizes the default worker counts, in place of
+// std::thread::hardware_concurrency.
+unsigned int aesgcmsiv_cpu_budget();
+
+#endif // AESGCMSIV_POOL_H
@@ -0,0 +1,311 @@
+// The call recording behind aesgcmsiv_record_start.
+//
+// Calling threads claim a slot of a bounded ring with a compare-and-swap
+// and fill it in; a background thread takes the filled slots in order and
+// writes them out in blocks. Each slot carries a sequence number, so the
+// writer can tell a slot that is still being filled from one that is ready,
+// and a caller a slot the writer has not yet emptied, in which case the ring
+// is full and the entry is dropped rather than waiting.
+//
+// Callers hold the recording open with a count so that stopping can wait
+// for those already inside before it frees the ring.
+
+#include "aesgcmsiv_stats.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdio.h>
+#include <thread>
+
+namespace {
+
+constexpr size_t kMaxCapacity = size_t(1) << 24;
+constexpr size_t kWriteBlock = 1024;  // entries per write
+constexpr auto kWriterIdle = std::chrono::milliseconds(10);
+
+struct Slot {
+    std::atomic<uint64_t> sequence;
+    aesgcmsiv_record_entry entry;
+};
+
+struct Recorder {
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    alignas(64) std::atomic<uint64_t> head;  // next slot to claim
+    alignas(64) uint64_t tail;  // next slot to write, owned by the writer
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint16_t> next_thread;
+    uint32_t generation;
+    uint64_t origin;  // aesgcmsiv_stats_now time the recording started
+    uint64_t secret;  // keys the key_id hash
+    FILE* file;
+    bool failed;  // a write failed; owned by the writer
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+    std::thread writer;
+};
+
+std::mutex g_record_mutex;  // serializes start and stop
+std::atomic<Recorder*> g_recorder(nullptr);
+std::atomic<uint64_t> g_record_users(0);
+uint32_t g_record_generation = 0;
+
+// The calling thread's number in the recording it last recorded a call in
+struct ThreadNumber {
+    uint32_t generation;
+    uint16_t number;
+};
+
+thread_local ThreadNumber t_thread_number = {};
+
+uint16_t thread_number(Recorder& recorder)
+{
+    ThreadNumber& number = t_thread_number;
+    if (number.generation != recorder.generation) {
+        number.generation = recorder.generation;
+        number.number = recorder.next_thread.fetch_add(1, std::memory_order_relaxed);
+    }
+    return number.number;
+}
+
+// splitmix64's finalizer, so nearby addresses spread over the whole range
+uint32_t key_id(const void* context, uint64_t secret)
+{
+    if (!context) {
+        return 0;
+    }
+    uint64_t x = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(context)) ^ secret;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    uint32_t id = static_cast<uint32_t>(x >> 32);
+    return id ? id : 1;
+}
+
+uint32_t clamp32(uint64_t value)
+{
+    return static_cast<uint32_t>(std::min<uint64_t>(value, UINT32_MAX));
+}
+
+void put16(uint8_t* out, uint16_t value)
+{
+    out[0] = static_cast<uint8_t>(value);
+    out[1] = static_cast<uint8_t>(value >> 8);
+}
+
+void put32(uint8_t* out, uint32_t value)
+{
+    for (int i = 0; i < 4; i++) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+void put64(uint8_t* out, uint64_t value)
+{
+    for (int i = 0; i < 8; i++) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+void encode(const aesgcmsiv_record_entry& entry, uint8_t* out)
+{
+    put64(out, entry.time_ns);
+    put32(out + 8, entry.duration_ns);
+    put32(out + 12, entry.size);
+    put32(out + 16, entry.aad_size);
+    put32(out + 20, entry.count);
+    put32(out + 24, entry.key_id);
+    put16(out + 28, entry.thread);
+    out[30] = entry.op;
+    out[31] = static_cast<uint8_t>(entry.status);
+}
+
+// Writes out every slot that is ready; returns whether there were any
+bool drain(Recorder& recorder)
+{
+    uint8_t block[kWriteBlock * AESGCMSIV_RECORD_ENTRY_SIZE];
+    size_t pending = 0;
+    bool any = false;
+    for (;;) {
+        Slot& slot = recorder.slots[recorder.tail & recorder.mask];
+        if (slot.sequence.load(std::memory_order_acquire) != recorder.tail + 1) {
+            break;
+        }
+        encode(slot.entry, block + pending * AESGCMSIV_RECORD_ENTRY_SIZE);
+        // Free for the caller that claims it a lap later
+        slot.sequence.store(recorder.tail + recorder.mask + 1, std::memory_order_release);
+        recorder.tail++;
+        any = true;
+        if (++pending == kWriteBlock) {
+            recorder.failed |= fwrite(block, AESGCMSIV_RECORD_ENTRY_SIZE, pending, recorder.file) != pending;
+            pending = 0;
+        }
+    }
+    if (pending) {
+        recorder.failed |= fwrite(block, AESGCMSIV_RECORD_ENTRY_SIZE, pending, recorder.file) != pending;
+    }
+    return any;
+}
+
+void write_entries(Recorder* recorder)
+{
+    std::unique_lock<std::mutex> lock(recorder->mutex);
+    for (;;) {
+        bool stopping = recorder->stopping;
+        lock.unlock();
+        bool any = drain(*recorder);
+        lock.lock();
+        if (stopping) {
+            return;
+        }
+        // Callers never wake the writer, which would cost them a system
+        // call; it polls instead
+        if (!any) {
+            recorder->wake.wait_for(lock, kWriterIdle);
+        }
+    }
+}
+
+} // namespace
+
+void aesgcmsiv_record_call(
+    uint32_t op, int status, uint64_t count, uint64_t size, uint64_t aad_size,
+    const void* key_context, uint64_t start, uint64_t end)
+{
+    g_record_users.fetch_add(1, std::memory_order_seq_cst);
+    Recorder* recorder = g_recorder.load(std::memory_order_seq_cst);
+    Slot* slot = nullptr;
+    uint64_t position = 0;
+    if (recorder) {
+        position = recorder->head.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& candidate = recorder->slots[position & recorder->mask];
+            uint64_t sequence = candidate.sequence.load(std::memory_order_acquire);
+            if (sequence == position) {
+                if (recorder->head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot = &candidate;
+                    break;
+                }
+            } else if (sequence < position) {
+                recorder->dropped.fetch_add(1, std::memory_order_relaxed);
+                break;
+            } else {
+                position = recorder->head.load(std::memory_order_relaxed);
+            }
+        }
+        if (slot) {
+            aesgcmsiv_record_entry& entry = slot->entry;
+            entry.time_ns = start > recorder->origin ? start - recorder->origin : 0;
+            entry.duration_ns = clamp32(end - start);
+            entry.size = clamp32(size);
+            entry.aad_size = clamp32(aad_size);
+            entry.count = clamp32(count);
+            entry.key_id = key_id(key_context, recorder->secret);
+            entry.thread = thread_number(*recorder);
+            entry.op = static_cast<uint8_t>(op);
+            entry.status = static_cast<int8_t>(std::max(status, -128));
+            slot->sequence.store(position + 1, std::memory_order_release);
+        }
+    }
+    g_record_users.fetch_sub(1, std::memory_order_release);
+}
+
+extern "C" {
+
+int aesgcmsiv_record_start(const char* path, size_t capacity)
+{
+    if (!path || capacity > kMaxCapacity) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    size_t slots = 1;
+    while (slots < (capacity ? capacity : AESGCMSIV_RECORD_DEFAULT_CAPACITY)) {
+        slots <<= 1;
+    }
+
+    std::lock_guard<std::mutex> lock(g_record_mutex);
+    if (g_recorder.load(std::memory_order_relaxed)) {
+        return AESGCMSIV_ERROR_BUSY;
+    }
+    std::unique_ptr<Recorder> recorder(new (std::nothrow) Recorder());
+    if (!recorder) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    recorder->slots.reset(new (std::nothrow) Slot[slots]);
+    uint8_t secret[AESGCMSIV_NONCE_SIZE];
+    if (!recorder->slots || aesgcmsiv_random_nonce(secret) != AESGCMSIV_SUCCESS) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    for (size_t i = 0; i < slots; i++) {
+        recorder->slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    recorder->mask = slots - 1;
+    recorder->head.store(0, std::memory_order_relaxed);
+    recorder->tail = 0;
+    recorder->dropped.store(0, std::memory_order_relaxed);
+    recorder->next_thread.store(0, std::memory_order_relaxed);
+    // From 1, since a thread that has not recorded a call holds 0
+    recorder->generation = ++g_record_generation;
+    memcpy(&recorder->secret, secret, sizeof(recorder->secret));
+    recorder->failed = false;
+    recorder->stopping = false;
+
+    recorder->file = fopen(path, "wb");
+    if (!recorder->file) {
+        return AESGCMSIV_ERROR_IO;
+    }
+    uint8_t header[AESGCMSIV_RECORD_HEADER_SIZE];
+    memcpy(header, AESGCMSIV_RECORD_MAGIC, 8);
+    put32(header + 8, AESGCMSIV_RECORD_VERSION);
+    put32(header + 12, AESGCMSIV_RECORD_ENTRY_SIZE);
+    if (fwrite(header, sizeof(header), 1, recorder->file) != 1) {
+        fclose(recorder->file);
+        return AESGCMSIV_ERROR_IO;
+    }
+    try {
+        recorder->writer = std::thread(write_entries, recorder.get());
+    } catch (...) {
+        fclose(recorder->file);
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+
+    recorder->origin = aesgcmsiv_stats_now();
+    g_recorder.store(recorder.release(), std::memory_order_seq_cst);
+    aesgcmsiv_timing.fetch_or(AESGCMSIV_TIMING_RECORD, std::memory_order_relaxed);
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_record_stop(uint64_t* dropped_out)
+{
+    std::lock_guard<std::mutex> lock(g_record_mutex);
+    std::unique_ptr<Recorder> recorder(g_recorder.exchange(nullptr, std::memory_order_seq_cst));
+    if (!recorder) {
+        return AESGCMSIV_ERROR_NOT_FOUND;
+    }
+    aesgcmsiv_timing.fetch_and(~AESGCMSIV_TIMING_RECORD, std::memory_order_relaxed);
+    // Callers that saw the recorder have claimed their slots once they leave
+    while (g_record_users.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+    {
+        std::lock_guard<std::mutex> writer_lock(recorder->mutex);
+        recorder->stopping = true;
+    }
+    recorder->wake.notify_one();
+    recorder->writer.join();
+
+    // Every slot claimed was filled before its caller left, so the writer's
+    // last pass empties the ring
+    bool failed = recorder->failed;
+    failed |= fclose(recorder->file) != 0;
+    if (dropped_out) {
+        *dropped_out = recorder->dropped.load(std::memory_order_relaxed);
+    }
+    return failed ? AESGCMSIV_ERROR_IO : AESGCMSIV_SUCCESS;
+}
+
+} // extern "C"
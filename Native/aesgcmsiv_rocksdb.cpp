@@ -0,0 +1,797 @@
+// The RocksDB file system behind aesgcmsiv::new_rocksdb_file_system.
+//
+// Every file is a stream: a 12-byte header, then chunks of C plaintext bytes
+// each stored as ciphertext || tag, C + 16 bytes apart, the last holding 0
+// to C bytes. The chunk nonces are the stream format's,
+//
+//   prefix (7 bytes) || chunk number (4 bytes, big-endian) || last (1 byte)
+//
+// built here rather than by the stream functions so that a run of chunks
+// goes through one batch call, which the context's pool spreads across its
+// workers.
+//
+// A writer holds the plaintext from its first unwritten chunk on. Full
+// chunks are sealed with the last flag clear once a run of them has built
+// up; the partial chunk that remains is sealed with the flag set and written
+// behind them on Sync and Close. That chunk only ever grows, so each version
+// covers the one before it on disk, and the first full chunk written in its
+// place replaces it; files never need truncating.
+//
+// A file of S > 0 bytes holds ceil((S - 12) / (C + 16)) chunks, each 16
+// bytes longer than its plaintext, which gives the plaintext size RocksDB is
+// shown. A read covers whole chunks: those wholly inside the caller's range
+// are opened straight into the caller's buffer, and the one or two it only
+// partly covers in place in the bytes read, then copied out.
+
+#include "aesgcmsiv_rocksdb.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace aesgcmsiv {
+namespace {
+
+using rocksdb::FileOptions;
+using rocksdb::IODebugContext;
+using rocksdb::IOOptions;
+using rocksdb::IOStatus;
+using rocksdb::Slice;
+
+constexpr uint8_t kVersion = 1;
+constexpr size_t kHeader = AESGCMSIV_STREAM_HEADER_SIZE;
+constexpr size_t kPrefix = 7;
+constexpr size_t kNonce = AESGCMSIV_NONCE_SIZE;
+constexpr size_t kTag = AESGCMSIV_TAG_SIZE;
+
+// A partial chunk at the end of the info log is written at least this often
+constexpr auto kLogFlushInterval = std::chrono::seconds(5);
+
+// What every file of one file system shares
+struct Keys {
+    aesgcmsiv_ctx* ctx = nullptr;
+    uint32_t chunk_size = 0;
+    size_t run_chunks = 0;
+
+    ~Keys() { aesgcmsiv_ctx_free(ctx); }
+};
+
+IOStatus failure(int code) {
+    if (code == AESGCMSIV_ERROR_DECRYPT_FAILED)
+        return IOStatus::Corruption("aesgcmsiv: a chunk failed to authenticate");
+    return IOStatus::IOError("aesgcmsiv: a chunk could not be processed");
+}
+
+// Copies a file's prefix out of its header, which must be a stream of this
+// file system's chunk size
+IOStatus parse_header(const Keys& keys, const uint8_t* header, uint8_t* prefix) {
+    uint32_t chunk_size = 0;
+    for (int i = 0; i < 4; i++)
+        chunk_size |= static_cast<uint32_t>(header[1 + i]) << (8 * i);
+    if (header[0] != kVersion)
+        return IOStatus::Corruption("aesgcmsiv: not an encrypted file");
+    if (chunk_size != keys.chunk_size)
+        return IOStatus::Corruption("aesgcmsiv: file was written with another chunk size");
+    memcpy(prefix, header + 5, kPrefix);
+    return IOStatus::OK();
+}
+
+// Plaintext bytes in a file of sealed bytes
+IOStatus plain_size(uint64_t sealed, uint32_t chunk_size, uint64_t* size) {
+    *size = 0;
+    if (sealed == 0)
+        return IOStatus::OK();
+    if (sealed < kHeader + kTag)
+        return IOStatus::Corruption("aesgcmsiv: file is truncated");
+    const uint64_t stride = uint64_t(chunk_size) + kTag;
+    const uint64_t body = sealed - kHeader;
+    const uint64_t chunks = (body + stride - 1) / stride;
+    if (body - (chunks - 1) * stride < kTag)
+        return IOStatus::Corruption("aesgcmsiv: file is truncated");
+    *size = body - chunks * kTag;
+    return IOStatus::OK();
+}
+
+// The chunk layout and nonces of one file
+class Chunks {
+public:
+    Chunks(std::shared_ptr<const Keys> keys, const uint8_t* prefix) : keys_(std::move(keys)) {
+        memcpy(prefix_, prefix, kPrefix);
+    }
+
+    aesgcmsiv_ctx* ctx() const { return keys_->ctx; }
+    uint32_t size() const { return keys_->chunk_size; }
+    size_t run_chunks() const { return keys_->run_chunks; }
+    uint64_t stride() const { return uint64_t(keys_->chunk_size) + kTag; }
+    uint64_t offset(uint64_t index) const { return kHeader + index * stride(); }
+
+    // Checks that chunks first to first + count - 1 may exist, the final one
+    // flagged last or not, and writes their nonces
+    bool nonces(uint64_t first, size_t count, bool last, uint8_t* out) const {
+        const uint64_t end = first + count - 1;
+        if (end > UINT32_MAX || (!last && end == UINT32_MAX))
+            return false;
+        for (size_t i = 0; i < count; i++) {
+            uint8_t* nonce = out + i * kNonce;
+            const uint32_t number = static_cast<uint32_t>(first + i);
+            memcpy(nonce, prefix_, kPrefix);
+            for (int j = 0; j < 4; j++)
+                nonce[kPrefix + j] = static_cast<uint8_t>(number >> (24 - 8 * j));
+            nonce[kNonce - 1] = last && i == count - 1 ? 1 : 0;
+        }
+        return true;
+    }
+
+private:
+    std::shared_ptr<const Keys> keys_;  // shared, since files may outlive their file system
+    uint8_t prefix_[kPrefix];
+};
+
+// Reads plaintext from a file opened through the base file system
+class Reader {
+public:
+    Reader(std::shared_ptr<const Keys> keys, const uint8_t* prefix, std::unique_ptr<rocksdb::FSRandomAccessFile> file,
+           uint64_t sealed_size, uint64_t size)
+        : chunks_(std::move(keys), prefix), file_(std::move(file)), sealed_size_(sealed_size), size_(size) {}
+
+    uint64_t size() const { return size_; }
+
+    // Reads up to n bytes at offset into scratch, stopping at the end of the
+    // file. On failure *read is the number of bytes before the first chunk
+    // that failed, which are in scratch.
+    IOStatus read(uint64_t offset, size_t n, const IOOptions& options, char* scratch, size_t* read,
+                  IODebugContext* dbg) const {
+        *read = 0;
+        if (offset >= size_ || n == 0)
+            return IOStatus::OK();
+        n = static_cast<size_t>(std::min<uint64_t>(n, size_ - offset));
+
+        const uint64_t chunk = chunks_.size();
+        const uint64_t stride = chunks_.stride();
+        const uint64_t first = offset / chunk;
+        const size_t count = static_cast<size_t>((offset + n - 1) / chunk - first + 1);
+        const uint64_t begin = chunks_.offset(first);
+        const uint64_t end = std::min(chunks_.offset(first + count), sealed_size_);
+        std::vector<uint8_t> sealed(static_cast<size_t>(end - begin));
+        Slice got;
+        IOStatus s = file_->Read(begin, sealed.size(), options, &got, reinterpret_cast<char*>(sealed.data()), dbg);
+        if (!s.ok())
+            return s;
+        if (got.size() != sealed.size())
+            return IOStatus::Corruption("aesgcmsiv: file is shorter than when it was opened");
+        if (got.data() != reinterpret_cast<const char*>(sealed.data()))
+            memcpy(sealed.data(), got.data(), got.size());
+
+        std::vector<uint8_t> nonces(count * kNonce);
+        if (!chunks_.nonces(first, count, end == sealed_size_, nonces.data()))
+            return IOStatus::Corruption("aesgcmsiv: file has too many chunks");
+        std::vector<aesgcmsiv_batch_item> items(count);
+        for (size_t i = 0; i < count; i++) {
+            const uint64_t start = (first + i) * chunk;
+            const size_t length = static_cast<size_t>(std::min<uint64_t>(chunk, size_ - start));
+            uint8_t* input = sealed.data() + i * stride;
+            const bool inside = start >= offset && start + length <= offset + n;
+            items[i].nonce = nonces.data() + i * kNonce;
+            items[i].input = input;
+            items[i].input_len = length;
+            items[i].output = inside ? reinterpret_cast<uint8_t*>(scratch) + (start - offset) : input;
+            items[i].tag = input + length;
+        }
+        std::vector<int> statuses(count);
+        aesgcmsiv_decrypt_batch(chunks_.ctx(), count, items.data(), statuses.data());
+
+        for (size_t i = 0; i < count; i++) {
+            if (statuses[i] != AESGCMSIV_SUCCESS)
+                return failure(statuses[i]);
+            const uint64_t start = (first + i) * chunk;
+            const uint64_t from = std::max(start, offset);
+            const uint64_t to = std::min<uint64_t>(start + items[i].input_len, offset + n);
+            if (items[i].output == items[i].input)
+                memcpy(scratch + (from - offset), items[i].output + (from - start), static_cast<size_t>(to - from));
+            *read = static_cast<size_t>(to - offset);
+        }
+        return IOStatus::OK();
+    }
+
+private:
+    Chunks chunks_;
+    std::unique_ptr<rocksdb::FSRandomAccessFile> file_;
+    uint64_t sealed_size_;
+    uint64_t size_;
+};
+
+class RandomAccessFile : public rocksdb::FSRandomAccessFile {
+public:
+    explicit RandomAccessFile(std::unique_ptr<Reader> reader) : reader_(std::move(reader)) {}
+
+    IOStatus Read(uint64_t offset, size_t n, const IOOptions& options, Slice* result, char* scratch,
+                  IODebugContext* dbg) const override {
+        size_t read = 0;
+        IOStatus s = reader_->read(offset, n, options, scratch, &read, dbg);
+        *result = Slice(scratch, s.ok() ? read : 0);
+        return s;
+    }
+
+private:
+    std::unique_ptr<Reader> reader_;
+};
+
+class SequentialFile : public rocksdb::FSSequentialFile {
+public:
+    explicit SequentialFile(std::unique_ptr<Reader> reader) : reader_(std::move(reader)) {}
+
+    // Hands back whatever authenticated ahead of a chunk that did not, so a
+    // log reader sees every record before a torn tail
+    IOStatus Read(size_t n, const IOOptions& options, Slice* result, char* scratch,
+                  IODebugContext* dbg) override {
+        size_t read = 0;
+        IOStatus s = reader_->read(position_, n, options, scratch, &read, dbg);
+        if (!s.ok() && read == 0) {
+            *result = Slice(scratch, 0);
+            return s;
+        }
+        position_ += read;
+        *result = Slice(scratch, read);
+        return IOStatus::OK();
+    }
+
+    IOStatus Skip(uint64_t n) override {
+        position_ = std::min(position_ + n, reader_->size());
+        return IOStatus::OK();
+    }
+
+private:
+    std::unique_ptr<Reader> reader_;
+    uint64_t position_ = 0;
+};
+
+// Writes plaintext to a file opened for positioned writes through the base
+// file system
+class WritableFile : public rocksdb::FSWritableFile {
+public:
+    // flush_tail writes the partial chunk on every Flush too
+    WritableFile(std::shared_ptr<const Keys> keys, const uint8_t* prefix,
+                 std::unique_ptr<rocksdb::FSRandomRWFile> file, bool flush_tail, const FileOptions& options)
+        : FSWritableFile(options), chunks_(std::move(keys), prefix), file_(std::move(file)),
+          flush_tail_(flush_tail) {}
+
+    ~WritableFile() override {
+        if (!closed_)
+            Close(IOOptions(), nullptr).PermitUncheckedError();
+    }
+
+    // Writes the header and an empty last chunk, which make a new file a
+    // valid stream
+    IOStatus start(const uint8_t* header, const IOOptions& options, IODebugContext* dbg) {
+        IOStatus s = file_->Write(0, Slice(reinterpret_cast<const char*>(header), kHeader), options, dbg);
+        return s.ok() ? write(true, options, dbg) : s;
+    }
+
+    // Continues a file whose last chunk, number index, holds tail
+    void resume(uint64_t index, std::vector<uint8_t> tail) {
+        index_ = index;
+        buffer_ = std::move(tail);
+        dirty_ = false;
+    }
+
+    using FSWritableFile::Append;
+
+    IOStatus Append(const Slice& data, const IOOptions& options, IODebugContext* dbg) override {
+        if (data.empty())
+            return IOStatus::OK();
+        buffer_.insert(buffer_.end(), data.data(), data.data() + data.size());
+        dirty_ = true;
+        if (buffer_.size() / chunks_.size() >= chunks_.run_chunks())
+            return write(false, options, dbg);
+        return IOStatus::OK();
+    }
+
+    IOStatus Flush(const IOOptions& options, IODebugContext* dbg) override {
+        IOStatus s = write(flush_tail_, options, dbg);
+        return s.ok() ? file_->Flush(options, dbg) : s;
+    }
+
+    IOStatus Sync(const IOOptions& options, IODebugContext* dbg) override {
+        IOStatus s = write(true, options, dbg);
+        return s.ok() ? file_->Sync(options, dbg) : s;
+    }
+
+    IOStatus Fsync(const IOOptions& options, IODebugContext* dbg) override {
+        IOStatus s = write(true, options, dbg);
+        return s.ok() ? file_->Fsync(options, dbg) : s;
+    }
+
+    IOStatus Close(const IOOptions& options, IODebugContext* dbg) override {
+        if (closed_)
+            return IOStatus::OK();
+        closed_ = true;
+        IOStatus s = write(true, options, dbg);
+        IOStatus c = file_->Close(options, dbg);
+        return s.ok() ? c : s;
+    }
+
+    uint64_t GetFileSize(const IOOptions& /*options*/, IODebugContext* /*dbg*/) override {
+        return index_ * chunks_.size() + buffer_.size();
+    }
+
+    IOStatus Truncate(uint64_t size, const IOOptions& options, IODebugContext* dbg) override {
+        if (size == GetFileSize(options, dbg))
+            return IOStatus::OK();
+        return IOStatus::NotSupported("aesgcmsiv: encrypted files cannot be truncated");
+    }
+
+private:
+    // Seals and writes the full chunks held, and with end the partial chunk
+    // after them as the last
+    IOStatus write(bool end, const IOOptions& options, IODebugContext* dbg) {
+        const size_t chunk = chunks_.size();
+        const size_t full = buffer_.size() / chunk;
+        if (end ? !dirty_ : full == 0)
+            return IOStatus::OK();
+        const size_t count = full + (end ? 1 : 0);
+        const size_t stride = static_cast<size_t>(chunks_.stride());
+        nonces_.resize(count * kNonce);
+        if (!chunks_.nonces(index_, count, end, nonces_.data()))
+            return IOStatus::IOError("aesgcmsiv: file is too large");
+        sealed_.resize(full * stride + (end ? buffer_.size() - full * chunk + kTag : 0));
+        items_.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            uint8_t* output = sealed_.data() + i * stride;
+            const size_t length = i < full ? chunk : buffer_.size() - full * chunk;
+            items_[i].nonce = nonces_.data() + i * kNonce;
+            items_[i].input = buffer_.data() + i * chunk;
+            items_[i].input_len = length;
+            items_[i].aad = nullptr;
+            items_[i].aad_len = 0;
+            items_[i].output = output;
+            items_[i].tag = output + length;
+        }
+        int result = aesgcmsiv_encrypt_batch(chunks_.ctx(), count, items_.data());
+        if (result != AESGCMSIV_SUCCESS)
+            return failure(result);
+        IOStatus s = file_->Write(chunks_.offset(index_),
+            Slice(reinterpret_cast<const char*>(sealed_.data()), sealed_.size()), options, dbg);
+        if (!s.ok())
+            return s;
+
+        // Without end the file now stops at a full chunk, not a last one
+        buffer_.erase(buffer_.begin(), buffer_.begin() + full * chunk);
+        index_ += full;
+        dirty_ = !end;
+        return IOStatus::OK();
+    }
+
+    Chunks chunks_;
+    std::unique_ptr<rocksdb::FSRandomRWFile> file_;
+    const bool flush_tail_;
+    uint64_t index_ = 0;  // number of the chunk buffer_ starts
+    std::vector<uint8_t> buffer_;  // plaintext from chunk index_ on
+    bool dirty_ = true;  // the file does not end with buffer_ as its last chunk
+    bool closed_ = false;
+    std::vector<uint8_t> sealed_;
+    std::vector<uint8_t> nonces_;
+    std::vector<aesgcmsiv_batch_item> items_;
+};
+
+// The info log, written through an encrypted file: RocksDB's own loggers
+// write through the base file system
+class Logger : public rocksdb::Logger {
+public:
+    explicit Logger(std::unique_ptr<rocksdb::FSWritableFile> file) : file_(std::move(file)) {}
+
+    ~Logger() override {
+        if (file_)
+            CloseImpl().PermitUncheckedError();
+    }
+
+    using rocksdb::Logger::Logv;
+
+    void Logv(const char* format, va_list ap) override {
+        const auto now = std::chrono::system_clock::now();
+        const std::time_t seconds = std::chrono::system_clock::to_time_t(now);
+        const long micros = static_cast<long>(
+            std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count() % 1000000);
+        std::tm local{};
+#ifdef _WIN32
+        localtime_s(&local, &seconds);
+#else
+        localtime_r(&seconds, &local);
+#endif
+        char stamp[96];
+        snprintf(stamp, sizeof(stamp), "%04d/%02d/%02d-%02d:%02d:%02d.%06ld ",
+            local.tm_year + 1900, local.tm_mon + 1, local.tm_mday,
+            local.tm_hour, local.tm_min, local.tm_sec, micros);
+
+        std::string line(stamp);
+        va_list copy;
+        va_copy(copy, ap);
+        const int length = vsnprintf(nullptr, 0, format, copy);
+        va_end(copy);
+        if (length > 0) {
+            const size_t head = line.size();
+            line.resize(head + static_cast<size_t>(length) + 1);
+            vsnprintf(&line[head], static_cast<size_t>(length) + 1, format, ap);
+            line.resize(head + static_cast<size_t>(length));
+        }
+        if (line.back() != '\n')
+            line += '\n';
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!file_)
+            return;
+        IOOptions options;
+        file_->Append(Slice(line), options, nullptr).PermitUncheckedError();
+        if (now - last_flush_ >= kLogFlushInterval) {
+            last_flush_ = now;
+            file_->Flush(options, nullptr).PermitUncheckedError();
+        }
+    }
+
+    void Flush() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (file_)
+            file_->Flush(IOOptions(), nullptr).PermitUncheckedError();
+    }
+
+protected:
+    rocksdb::Status CloseImpl() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!file_)
+            return rocksdb::Status::OK();
+        IOStatus s = file_->Close(IOOptions(), nullptr);
+        file_.reset();
+        return s;
+    }
+
+private:
+    std::mutex mutex_;
+    std::unique_ptr<rocksdb::FSWritableFile> file_;
+    std::chrono::system_clock::time_point last_flush_{};
+};
+
+bool is_log(const std::string& fname) {
+    return fname.size() >= 4 && fname.compare(fname.size() - 4, 4, ".log") == 0;
+}
+
+class FileSystem : public rocksdb::FileSystemWrapper {
+public:
+    FileSystem(const std::shared_ptr<rocksdb::FileSystem>& base, std::shared_ptr<const Keys> keys)
+        : FileSystemWrapper(base), keys_(std::move(keys)) {}
+
+    static const char* kClassName() { return "AesGcmSivFileSystem"; }
+    const char* Name() const override { return kClassName(); }
+
+    IOStatus NewSequentialFile(const std::string& fname, const FileOptions& options,
+                               std::unique_ptr<rocksdb::FSSequentialFile>* result,
+                               IODebugContext* dbg) override {
+        std::unique_ptr<Reader> reader;
+        IOStatus s = open_reader(fname, options, &reader, dbg);
+        if (s.ok())
+            *result = std::make_unique<SequentialFile>(std::move(reader));
+        return s;
+    }
+
+    IOStatus NewRandomAccessFile(const std::string& fname, const FileOptions& options,
+                                 std::unique_ptr<rocksdb::FSRandomAccessFile>* result,
+                                 IODebugContext* dbg) override {
+        std::unique_ptr<Reader> reader;
+        IOStatus s = open_reader(fname, options, &reader, dbg);
+        if (s.ok())
+            *result = std::make_unique<RandomAccessFile>(std::move(reader));
+        return s;
+    }
+
+    IOStatus NewWritableFile(const std::string& fname, const FileOptions& options,
+                             std::unique_ptr<rocksdb::FSWritableFile>* result,
+                             IODebugContext* dbg) override {
+        return create(fname, options, is_log(fname), result, dbg);
+    }
+
+    IOStatus ReopenWritableFile(const std::string& fname, const FileOptions& options,
+                                std::unique_ptr<rocksdb::FSWritableFile>* result,
+                                IODebugContext* dbg) override {
+        IOStatus s = target()->FileExists(fname, options.io_options, dbg);
+        if (s.IsNotFound())
+            return NewWritableFile(fname, options, result, dbg);
+        uint64_t sealed_size = 0;
+        if (s.ok())
+            s = target()->GetFileSize(fname, options.io_options, &sealed_size, dbg);
+        if (!s.ok())
+            return s;
+        if (sealed_size == 0)
+            return NewWritableFile(fname, options, result, dbg);
+
+        uint64_t size = 0;
+        s = plain_size(sealed_size, keys_->chunk_size, &size);
+        std::unique_ptr<rocksdb::FSRandomRWFile> file;
+        if (s.ok())
+            s = target()->NewRandomRWFile(fname, base_options(options), &file, dbg);
+        uint8_t header[kHeader];
+        uint8_t prefix[kPrefix];
+        if (s.ok())
+            s = read_exactly(*file, 0, kHeader, options.io_options, header, dbg);
+        if (s.ok())
+            s = parse_header(*keys_, header, prefix);
+        if (!s.ok())
+            return s;
+
+        // Take the last chunk back into the buffer, to be sealed again with
+        // whatever follows it
+        Chunks chunks(keys_, prefix);
+        const uint64_t index = size == 0 ? 0 : (size - 1) / keys_->chunk_size;
+        const uint64_t offset = chunks.offset(index);
+        std::vector<uint8_t> tail(static_cast<size_t>(sealed_size - offset));
+        s = read_exactly(*file, offset, tail.size(), options.io_options, tail.data(), dbg);
+        if (!s.ok())
+            return s;
+        uint8_t nonce[kNonce];
+        if (!chunks.nonces(index, 1, true, nonce))
+            return IOStatus::Corruption("aesgcmsiv: file has too many chunks");
+        const size_t length = tail.size() - kTag;
+        int r = aesgcmsiv_ctx_decrypt(keys_->ctx, nonce, kNonce, tail.data(), length, nullptr, 0,
+            tail.data() + length, tail.data());
+        if (r != AESGCMSIV_SUCCESS)
+            return failure(r);
+        tail.resize(length);
+
+        auto writer = std::make_unique<WritableFile>(keys_, prefix, std::move(file), is_log(fname), options);
+        writer->resume(index, std::move(tail));
+        *result = std::move(writer);
+        return IOStatus::OK();
+    }
+
+    // Recycling a log would need its old records kept readable, so the file
+    // is renamed and started afresh
+    IOStatus ReuseWritableFile(const std::string& fname, const std::string& old_fname,
+                               const FileOptions& options, std::unique_ptr<rocksdb::FSWritableFile>* result,
+                               IODebugContext* dbg) override {
+        IOStatus s = target()->RenameFile(old_fname, fname, options.io_options, dbg);
+        return s.ok() ? NewWritableFile(fname, options, result, dbg) : s;
+    }
+
+    IOStatus NewRandomRWFile(const std::string& /*fname*/, const FileOptions& /*options*/,
+                             std::unique_ptr<rocksdb::FSRandomRWFile>* /*result*/,
+                             IODebugContext* /*dbg*/) override {
+        return IOStatus::NotSupported("aesgcmsiv: encrypted files cannot be opened for random writes");
+    }
+
+    IOStatus NewMemoryMappedFileBuffer(const std::string& /*fname*/,
+                                       std::unique_ptr<rocksdb::MemoryMappedFileBuffer>* /*result*/) override {
+        return IOStatus::NotSupported("aesgcmsiv: encrypted files cannot be memory-mapped");
+    }
+
+    IOStatus NewLogger(const std::string& fname, const IOOptions& io_options,
+                       std::shared_ptr<rocksdb::Logger>* result, IODebugContext* dbg) override {
+        FileOptions options;
+        options.io_options = io_options;
+        std::unique_ptr<rocksdb::FSWritableFile> file;
+        IOStatus s = create(fname, options, true, &file, dbg);
+        if (s.ok())
+            *result = std::make_shared<Logger>(std::move(file));
+        return s;
+    }
+
+    IOStatus GetFileSize(const std::string& fname, const IOOptions& options, uint64_t* size,
+                         IODebugContext* dbg) override {
+        uint64_t sealed_size = 0;
+        IOStatus s = target()->GetFileSize(fname, options, &sealed_size, dbg);
+        return s.ok() ? plain_size(sealed_size, keys_->chunk_size, size) : s;
+    }
+
+    IOStatus GetChildrenFileAttributes(const std::string& dir, const IOOptions& options,
+                                       std::vector<rocksdb::FileAttributes>* result,
+                                       IODebugContext* dbg) override {
+        IOStatus s = target()->GetChildrenFileAttributes(dir, options, result, dbg);
+        if (!s.ok())
+            return s;
+        for (rocksdb::FileAttributes& attributes : *result) {
+            uint64_t size = 0;
+            if (plain_size(attributes.size_bytes, keys_->chunk_size, &size).ok())
+                attributes.size_bytes = size;
+        }
+        return IOStatus::OK();
+    }
+
+private:
+    // Chunks sit at offsets no mapping or direct I/O would align to
+    static FileOptions base_options(const FileOptions& options) {
+        FileOptions base(options);
+        base.use_mmap_reads = false;
+        base.use_mmap_writes = false;
+        base.use_direct_reads = false;
+        base.use_direct_writes = false;
+        return base;
+    }
+
+    static IOStatus read_exactly(const rocksdb::FSRandomRWFile& file, uint64_t offset, size_t n,
+                                 const IOOptions& options, uint8_t* out, IODebugContext* dbg) {
+        Slice got;
+        IOStatus s = file.Read(offset, n, options, &got, reinterpret_cast<char*>(out), dbg);
+        if (!s.ok())
+            return s;
+        if (got.size() != n)
+            return IOStatus::Corruption("aesgcmsiv: file is truncated");
+        if (got.data() != reinterpret_cast<const char*>(out))
+            memcpy(out, got.data(), n);
+        return IOStatus::OK();
+    }
+
+    // Creates or empties fname and starts it as a stream under a fresh prefix
+    IOStatus create(const std::string& fname, const FileOptions& options, bool flush_tail,
+                    std::unique_ptr<rocksdb::FSWritableFile>* result, IODebugContext* dbg) {
+        const FileOptions base = base_options(options);
+        std::unique_ptr<rocksdb::FSWritableFile> created;
+        IOStatus s = target()->NewWritableFile(fname, base, &created, dbg);
+        if (s.ok())
+            s = created->Close(options.io_options, dbg);
+        created.reset();
+        std::unique_ptr<rocksdb::FSRandomRWFile> file;
+        if (s.ok())
+            s = target()->NewRandomRWFile(fname, base, &file, dbg);
+        if (!s.ok())
+            return s;
+
+        uint8_t nonce[kNonce];
+        int r = aesgcmsiv_random_nonce(nonce);
+        if (r != AESGCMSIV_SUCCESS)
+            return failure(r);
+        uint8_t header[kHeader];
+        header[0] = kVersion;
+        for (int i = 0; i < 4; i++)
+            header[1 + i] = static_cast<uint8_t>(keys_->chunk_size >> (8 * i));
+        memcpy(header + 5, nonce, kPrefix);
+
+        auto writer = std::make_unique<WritableFile>(keys_, nonce, std::move(file), flush_tail, options);
+        s = writer->start(header, options.io_options, dbg);
+        if (s.ok())
+            *result = std::move(writer);
+        return s;
+    }
+
+    IOStatus open_reader(const std::string& fname, const FileOptions& options,
+                         std::unique_ptr<Reader>* result, IODebugContext* dbg) {
+        std::unique_ptr<rocksdb::FSRandomAccessFile> file;
+        IOStatus s = target()->NewRandomAccessFile(fname, base_options(options), &file, dbg);
+        uint64_t sealed_size = 0;
+        if (s.ok())
+            s = target()->GetFileSize(fname, options.io_options, &sealed_size, dbg);
+        uint64_t size = 0;
+        if (s.ok())
+            s = plain_size(sealed_size, keys_->chunk_size, &size);
+        if (!s.ok())
+            return s;
+
+        uint8_t prefix[kPrefix] = {};
+        if (sealed_size != 0) {
+            uint8_t header[kHeader];
+            Slice got;
+            s = file->Read(0, kHeader, options.io_options, &got, reinterpret_cast<char*>(header), dbg);
+            if (s.ok() && got.size() != kHeader)
+                s = IOStatus::Corruption("aesgcmsiv: file is truncated");
+            if (s.ok())
+                s = parse_header(*keys_, reinterpret_cast<const uint8_t*>(got.data()), prefix);
+            if (!s.ok())
+                return s;
+        }
+        *result = std::make_unique<Reader>(keys_, prefix, std::move(file), sealed_size, size);
+        return IOStatus::OK();
+    }
+
+    std::shared_ptr<const Keys> keys_;
+};
+
+}  // namespace
+
+rocksdb::IOStatus new_rocksdb_file_system(
+    const std::shared_ptr<rocksdb::FileSystem>& base,
+    const uint8_t* key, size_t key_len,
+    const rocksdb_options& options,
+    std::shared_ptr<rocksdb::FileSystem>* result) {
+    if (!base || !result || options.chunk_size == 0 || options.chunk_size > AESGCMSIV_STREAM_MAX_CHUNK_SIZE)
+        return IOStatus::InvalidArgument("aesgcmsiv: invalid file system options");
+    auto keys = std::make_unique<Keys>();
+    int r = aesgcmsiv_ctx_new(key, key_len, &keys->ctx);
+    if (r == AESGCMSIV_ERROR_INVALID_KEY || r == AESGCMSIV_ERROR_INVALID_INPUT)
+        return IOStatus::InvalidArgument("aesgcmsiv: invalid key");
+    if (r == AESGCMSIV_SUCCESS && options.pool)
+        r = aesgcmsiv_ctx_set_pool(keys->ctx, options.pool);
+    if (r != AESGCMSIV_SUCCESS)
+        return IOStatus::IOError("aesgcmsiv: could not set up the key");
+    keys->chunk_size = options.chunk_size;
+    keys->run_chunks = std::max<size_t>(1, options.write_run / options.chunk_size);
+    *result = std::make_shared<FileSystem>(base, std::move(keys));
+    return IOStatus::OK();
+}
+
+namespace {
+
+int to_error(const IOStatus& s) {
+    if (s.ok())
+        return AESGCMSIV_SUCCESS;
+    if (s.IsCorruption())
+        return AESGCMSIV_ERROR_DECRYPT_FAILED;
+    if (s.IsNotFound())
+        return AESGCMSIV_ERROR_NOT_FOUND;
+    if (s.IsInvalidArgument())
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    return AESGCMSIV_ERROR_IO;
+}
+
+// A file system on RocksDB's default, for the C entry points
+int default_file_system(const uint8_t* key, size_t key_len, uint32_t chunk_size,
+                        std::shared_ptr<rocksdb::FileSystem>* result) {
+    if (!key || (key_len != 16 && key_len != 32))
+        return AESGCMSIV_ERROR_INVALID_KEY;
+    rocksdb_options options;
+    options.chunk_size = chunk_size;
+    return to_error(new_rocksdb_file_system(rocksdb::FileSystem::Default(), key, key_len, options, result));
+}
+
+}  // namespace
+
+}  // namespace aesgcmsiv
+
+extern "C" {
+
+int aesgcmsiv_rocksdb_write_file(
+    const char* path,
+    const uint8_t* key, size_t key_len,
+    uint32_t chunk_size,
+    const uint8_t* data, size_t data_len) {
+    if (!path || (!data && data_len != 0))
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    try {
+        std::shared_ptr<rocksdb::FileSystem> fs;
+        int r = aesgcmsiv::default_file_system(key, key_len, chunk_size, &fs);
+        if (r != AESGCMSIV_SUCCESS)
+            return r;
+        rocksdb::IOOptions io;
+        std::unique_ptr<rocksdb::FSWritableFile> file;
+        rocksdb::IOStatus s = fs->NewWritableFile(path, rocksdb::FileOptions(), &file, nullptr);
+        if (s.ok())
+            s = file->Append(rocksdb::Slice(reinterpret_cast<const char*>(data), data_len), io, nullptr);
+        if (s.ok())
+            s = file->Close(io, nullptr);
+        return aesgcmsiv::to_error(s);
+    } catch (const std::bad_alloc&) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+}
+
+int aesgcmsiv_rocksdb_read_file(
+    const char* path,
+    const uint8_t* key, size_t key_len,
+    uint32_t chunk_size,
+    uint64_t offset, uint8_t* out, size_t len,
+    size_t* read_out) {
+    if (!path || (!out && len != 0) || !read_out)
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    *read_out = 0;
+    try {
+        std::shared_ptr<rocksdb::FileSystem> fs;
+        int r = aesgcmsiv::default_file_system(key, key_len, chunk_size, &fs);
+        if (r != AESGCMSIV_SUCCESS)
+            return r;
+        std::unique_ptr<rocksdb::FSRandomAccessFile> file;
+        rocksdb::IOStatus s = fs->NewRandomAccessFile(path, rocksdb::FileOptions(), &file, nullptr);
+        rocksdb::Slice got;
+        if (s.ok())
+            s = file->Read(offset, len, rocksdb::IOOptions(), &got, reinterpret_cast<char*>(out), nullptr);
+        if (!s.ok())
+            return aesgcmsiv::to_error(s);
+        if (got.size() != 0 && got.data() != reinterpret_cast<const char*>(out))
+            std::memmove(out, got.data(), got.size());
+        *read_out = got.size();
+        return AESGCMSIV_SUCCESS;
+    } catch (const std::bad_alloc&) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+}
+
+}  // extern "C"
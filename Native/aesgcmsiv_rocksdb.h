@@ -0,0 +1,133 @@
+#ifndef AESGCMSIV_ROCKSDB_H
+#define AESGCMSIV_ROCKSDB_H
+
+// A RocksDB file system that keeps every file of a database encrypted at
+// rest, built as the separate aesgcmsiv_rocksdb library
+// (-DAESGCMSIV_ROCKSDB=ON) so that the main library does not depend on
+// RocksDB. Like RocksDB's own headers this one is C++ only.
+//
+// RocksDB's EncryptedEnv is not used: its BlockAccessCipherStream must keep
+// every byte at its offset, which leaves no room for a tag, so it can only
+// carry an unauthenticated cipher. This file system stores each file as a
+// stream instead (see aesgcmsiv_stream_seal_new), which the stream
+// functions and aesgcmsiv-cli can open too, and presents the plaintext to
+// RocksDB, which sees ordinary files of the plaintext's size.
+//
+// Chunk n of a file is sealed under the nonce the stream format gives it,
+// so a nonce comes from a chunk's position in its file and the file's random
+// prefix. Appends are buffered until a run of full chunks has built up,
+// which is then sealed with one batch call and written with one positioned
+// write; a compaction writing a table therefore spreads its chunks across
+// the pool the options name. A read opens the chunks it covers as one
+// batch, and fails with Corruption if any of them does not authenticate.
+
+#include "aesgcmsiv.h"
+#include <rocksdb/file_system.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace aesgcmsiv {
+
+struct rocksdb_options {
+    // Plaintext bytes per chunk, 1 to AESGCMSIV_STREAM_MAX_CHUNK_SIZE. A
+    // read opens at least one whole chunk, and a sync reseals the partial
+    // chunk at the end of the file, so keep it near the table block size.
+    // Files written under another chunk size fail to open.
+    uint32_t chunk_size = 4096;
+    // Plaintext bytes of full chunks buffered before they are sealed and
+    // written, rounded down to whole chunks; at least one chunk
+    size_t write_run = size_t(1) << 20;
+    // Pool the batches run on (see aesgcmsiv_ctx_set_pool), or NULL to
+    // seal and open on the calling thread. Must outlive the file system.
+    aesgcmsiv_pool* pool = nullptr;
+};
+
+/**
+ * Creates a file system that encrypts under key and stores its files
+ * through base. Open a database with it through an Env:
+ *
+ *   std::shared_ptr<rocksdb::FileSystem> fs;
+ *   aesgcmsiv::new_rocksdb_file_system(rocksdb::FileSystem::Default(), key, 32, {}, &fs);
+ *   std::unique_ptr<rocksdb::Env> env = rocksdb::NewCompositeEnv(fs);
+ *   options.env = env.get();
+ *
+ * Every file the database writes is encrypted, the info log included; only
+ * the lock file, which holds nothing, is not. Data reaches the disk a run of
+ * chunks at a time, and the partial chunk at the end on Sync and Close; a
+ * write-ahead log (a file named *.log) also writes its partial chunk on
+ * every Flush, so a write without sync survives a crash of the process as
+ * it does with RocksDB's own files. A file whose end was lost in a crash
+ * before it was synced fails to authenticate from its last full chunk on,
+ * which WAL recovery treats as a torn tail.
+ *
+ * The partial chunk at the end is sealed again under the same nonce each
+ * time it grows. AES-GCM-SIV limits what that reveals to whether two
+ * versions were identical, and nothing of a version is repeated beyond
+ * that, but give each database its own key all the same. File names are not
+ * authenticated, since RocksDB renames files. Memory-mapped and direct I/O
+ * are switched off for the files of base, log recycling is reduced to a
+ * rename, and files cannot be opened for random writes, so ingest external
+ * tables with write_global_seqno off.
+ *
+ * @param base File system that does the file I/O
+ * @param key Pointer to 16-byte (AES-128) or 32-byte (AES-256) key
+ * @param key_len Length of key (must be 16 or 32)
+ * @param options Chunk size, write run and pool
+ * @param result Receives the new file system on success
+ *
+ * @return OK on success, InvalidArgument for a bad key, base, chunk size or
+ *         result, IOError if the key could not be set up
+ */
+rocksdb::IOStatus new_rocksdb_file_system(
+    const std::shared_ptr<rocksdb::FileSystem>& base,
+    const uint8_t* key, size_t key_len,
+    const rocksdb_options& options,
+    std::shared_ptr<rocksdb::FileSystem>* result);
+
+}  // namespace aesgcmsiv
+
+extern "C" {
+
+/**
+ * Writes data to path as one file of a database, through a file system on
+ * RocksDB's default made with the default options but chunk_size, for
+ * callers that cannot hold a rocksdb::FileSystem, such as the .NET tests.
+ * A file already at path is replaced.
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_INVALID_KEY for a
+ *         bad key, AESGCMSIV_ERROR_INVALID_INPUT for a NULL path or data or
+ *         a bad chunk size, AESGCMSIV_ERROR_IO if the file could not be
+ *         written
+ */
+AESGCMSIV_API int aesgcmsiv_rocksdb_write_file(
+    const char* path,
+    const uint8_t* key, size_t key_len,
+    uint32_t chunk_size,
+    const uint8_t* data, size_t data_len);
+
+/**
+ * Reads up to len plaintext bytes from offset of a file written through a
+ * file system made as aesgcmsiv_rocksdb_write_file makes it, as RocksDB
+ * would read them.
+ *
+ * @param read_out Receives the number of bytes read, fewer than len only at
+ *                 the end of the file
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_DECRYPT_FAILED if a
+ *         chunk the read covers does not authenticate or the file is not
+ *         one of these, AESGCMSIV_ERROR_NOT_FOUND if there is no file at
+ *         path, AESGCMSIV_ERROR_INVALID_KEY or AESGCMSIV_ERROR_INVALID_INPUT
+ *         as for aesgcmsiv_rocksdb_write_file, AESGCMSIV_ERROR_IO if the
+ *         file could not be read
+ */
+AESGCMSIV_API int aesgcmsiv_rocksdb_read_file(
+    const char* path,
+    const uint8_t* key, size_t key_len,
+    uint32_t chunk_size,
+    uint64_t offset, uint8_t* out, size_t len,
+    size_t* read_out);
+
+}  // extern "C"
+
+#endif // AESGCMSIV_ROCKSDB_H
@@ -0,0 +1,342 @@
+#include "aesgcmsiv_secure.h"
+#include <openssl/crypto.h>
+#include <mutex>
+
+// Each slab is SLAB_SIZE bytes aligned to SLAB_SIZE, so a slot finds its
+// slab header by masking its address. The header takes the first slot-sized
+// line; the rest is cut into slots of one size class. Slabs are reserved
+// three times over so an aligned one fits with unmapped or inaccessible
+// pages on either side, and locked with one call each, so a process holding
+// tens of thousands of keys makes one mlock per few hundred of them.
+//
+// Locking is best effort: past RLIMIT_MEMLOCK, or without the privilege on
+// Windows, slabs are used unlocked rather than failing key setup.
+
+#define SLAB_SIZE (size_t(128) << 10)
+#define SLOT_ALIGN 64
+#define SIZE_CLASSES (AESGCMSIV_SECURE_MAX_SIZE / SLOT_ALIGN)
+
+namespace {
+
+struct slab {
+    void* reservation;  // what to hand back to the OS
+    size_t reservation_size;
+    slab* prev;  // in its class's list of slabs with a free slot
+    slab* next;
+    void* free_slots;  // released slots, linked through their first word
+    size_t slot_size;
+    unsigned int capacity;
+    unsigned int carved;  // slots handed out at least once; the rest are fresh
+    unsigned int used;
+};
+static_assert(sizeof(slab) <= SLOT_ALIGN, "slab header must fit one line");
+
+// Guards every slab and class list
+std::mutex g_lock;
+slab* g_partial[SIZE_CLASSES];  // slabs with a free slot, per class
+
+size_t page_size();
+slab* map_slab();
+void unmap_slab(slab* s);
+
+void link(slab*& head, slab* s)
+{
+    s->prev = nullptr;
+    s->next = head;
+    if (head) {
+        head->prev = s;
+    }
+    head = s;
+}
+
+void unlink(slab*& head, slab* s)
+{
+    if (s->prev) {
+        s->prev->next = s->next;
+    } else {
+        head = s->next;
+    }
+    if (s->next) {
+        s->next->prev = s->prev;
+    }
+    s->prev = s->next = nullptr;
+}
+
+// The aligned slab inside a reservation of 3 * SLAB_SIZE at raw, with at
+// least a page before it
+uint8_t* slab_in(uint8_t* raw)
+{
+    const uintptr_t start = reinterpret_cast<uintptr_t>(raw) + page_size();
+    return reinterpret_cast<uint8_t*>((start + SLAB_SIZE - 1) & ~(uintptr_t)(SLAB_SIZE - 1));
+}
+
+} // namespace
+
+#if defined(_WIN32)
+
+#include <windows.h>
+
+namespace {
+
+size_t page_size()
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+}
+
+// Only the slab is committed; the reserved pages around it fault on access
+slab* map_slab()
+{
+    const size_t size = 3 * SLAB_SIZE;
+    uint8_t* raw = static_cast<uint8_t*>(VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS));
+    if (!raw) {
+        return nullptr;
+    }
+    uint8_t* data = slab_in(raw);
+    if (!VirtualAlloc(data, SLAB_SIZE, MEM_COMMIT, PAGE_READWRITE)) {
+        VirtualFree(raw, 0, MEM_RELEASE);
+        return nullptr;
+    }
+    VirtualLock(data, SLAB_SIZE);
+    slab* s = reinterpret_cast<slab*>(data);
+    s->reservation = raw;
+    s->reservation_size = size;
+    return s;
+}
+
+void unmap_slab(slab* s)
+{
+    VirtualFree(s->reservation, 0, MEM_RELEASE);
+}
+
+} // namespace
+
+bool aesgcmsiv_shared_map(size_t, aesgcmsiv_shared_mem* mem)
+{
+    *mem = aesgcmsiv_shared_mem{nullptr, 0, -1};
+    return false;
+}
+
+bool aesgcmsiv_shared_seal(aesgcmsiv_shared_mem*)
+{
+    return false;
+}
+
+void aesgcmsiv_shared_unmap(aesgcmsiv_shared_mem*)
+{
+}
+
+#else
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(MFD_ALLOW_SEALING)
+#include <fcntl.h>
+#define AESGCMSIV_SHARED_MEMFD
+#endif
+
+namespace {
+
+size_t page_size()
+{
+    static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+// Reserves inaccessible memory, opens up the slab, and gives back all but
+// one guard page on each side
+slab* map_slab()
+{
+    const size_t page = page_size();
+    void* mapped = mmap(nullptr, 3 * SLAB_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED) {
+        return nullptr;
+    }
+    uint8_t* raw = static_cast<uint8_t*>(mapped);
+    uint8_t* data = slab_in(raw);
+    uint8_t* start = data - page;
+    uint8_t* end = data + SLAB_SIZE + page;
+    if (start > raw) {
+        munmap(raw, static_cast<size_t>(start - raw));
+    }
+    munmap(end, static_cast<size_t>(raw + 3 * SLAB_SIZE - end));
+    if (mprotect(data, SLAB_SIZE, PROT_READ | PROT_WRITE) != 0) {
+        munmap(start, static_cast<size_t>(end - start));
+        return nullptr;
+    }
+#if defined(MADV_DONTDUMP)
+    madvise(data, SLAB_SIZE, MADV_DONTDUMP);
+#endif
+    mlock(data, SLAB_SIZE);
+    slab* s = reinterpret_cast<slab*>(data);
+    s->reservation = start;
+    s->reservation_size = static_cast<size_t>(end - start);
+    return s;
+}
+
+void unmap_slab(slab* s)
+{
+    // munmap drops the lock along with the pages
+    munmap(s->reservation, s->reservation_size);
+}
+
+// Locks a fresh mapping, best effort as for slabs
+void protect_shared(void* data, size_t size)
+{
+#if defined(MADV_DONTDUMP)
+    madvise(data, size, MADV_DONTDUMP);
+#endif
+    mlock(data, size);
+}
+
+} // namespace
+
+bool aesgcmsiv_shared_map(size_t size, aesgcmsiv_shared_mem* mem)
+{
+    *mem = aesgcmsiv_shared_mem{nullptr, 0, -1};
+    const size_t page = page_size();
+    if (size == 0 || size > SIZE_MAX - page) {
+        return false;
+    }
+    size = (size + page - 1) & ~(page - 1);
+
+    int fd = -1;
+    void* data;
+#if defined(AESGCMSIV_SHARED_MEMFD)
+    fd = memfd_create("aesgcmsiv-key-table", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        return false;
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        close(fd);
+        return false;
+    }
+    data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+#else
+    data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+#endif
+    if (data == MAP_FAILED) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    protect_shared(data, size);
+    *mem = aesgcmsiv_shared_mem{data, size, fd};
+    return true;
+}
+
+bool aesgcmsiv_shared_seal(aesgcmsiv_shared_mem* mem)
+{
+#if defined(AESGCMSIV_SHARED_MEMFD)
+    if (mem->fd < 0) {
+        return true;
+    }
+    // A memfd cannot be sealed for writes while any shared mapping of it
+    // could be made writable, read-only ones included on recent kernels.
+    // An inaccessible placeholder holds the address while it is sealed, and
+    // the read-only mapping that replaces it can never be made writable.
+    if (mmap(mem->data, mem->size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED) {
+        mprotect(mem->data, mem->size, PROT_READ);
+        return false;
+    }
+    const bool sealed = fcntl(mem->fd, F_ADD_SEALS,
+        F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == 0;
+    void* data = mmap(mem->data, mem->size, PROT_READ, MAP_SHARED | MAP_FIXED, mem->fd, 0);
+    if (data == MAP_FAILED) {
+        // Only when the OS is out of memory; any address will do
+        munmap(mem->data, mem->size);
+        data = mmap(nullptr, mem->size, PROT_READ, MAP_SHARED, mem->fd, 0);
+    }
+    close(mem->fd);
+    mem->fd = -1;
+    if (data == MAP_FAILED) {
+        *mem = aesgcmsiv_shared_mem{nullptr, 0, -1};
+        return false;
+    }
+    mem->data = data;
+    protect_shared(mem->data, mem->size);
+    return sealed;
+#else
+    return mprotect(mem->data, mem->size, PROT_READ) == 0;
+#endif
+}
+
+void aesgcmsiv_shared_unmap(aesgcmsiv_shared_mem* mem)
+{
+    if (!mem->data) {
+        return;
+    }
+    if (mem->fd >= 0) {
+        close(mem->fd);
+    }
+    munmap(mem->data, mem->size);
+    *mem = aesgcmsiv_shared_mem{nullptr, 0, -1};
+}
+
+#endif
+
+void* aesgcmsiv_secure_alloc(size_t size)
+{
+    if (size == 0 || size > AESGCMSIV_SECURE_MAX_SIZE) {
+        return nullptr;
+    }
+    const size_t size_class = (size - 1) / SLOT_ALIGN;
+    const size_t slot_size = (size_class + 1) * SLOT_ALIGN;
+
+    std::lock_guard<std::mutex> lock(g_lock);
+    slab* s = g_partial[size_class];
+    if (!s) {
+        s = map_slab();
+        if (!s) {
+            return nullptr;
+        }
+        s->free_slots = nullptr;
+        s->slot_size = slot_size;
+        s->capacity = static_cast<unsigned int>((SLAB_SIZE - SLOT_ALIGN) / slot_size);
+        s->carved = 0;
+        s->used = 0;
+        link(g_partial[size_class], s);
+    }
+
+    void* slot;
+    if (s->free_slots) {
+        slot = s->free_slots;
+        s->free_slots = *static_cast<void**>(slot);
+        *static_cast<void**>(slot) = nullptr;
+    } else {
+        slot = reinterpret_cast<uint8_t*>(s) + SLOT_ALIGN + s->carved * slot_size;
+        s->carved++;
+    }
+    if (++s->used == s->capacity) {
+        unlink(g_partial[size_class], s);
+    }
+    return slot;
+}
+
+void aesgcmsiv_secure_free(void* data, size_t size)
+{
+    if (!data) {
+        return;
+    }
+    const size_t size_class = (size - 1) / SLOT_ALIGN;
+    slab* s = reinterpret_cast<slab*>(
+        reinterpret_cast<uintptr_t>(data) & ~(uintptr_t)(SLAB_SIZE - 1));
+    OPENSSL_cleanse(data, s->slot_size);
+
+    std::lock_guard<std::mutex> lock(g_lock);
+    if (s->used-- == s->capacity) {
+        link(g_partial[size_class], s);
+    }
+    if (s->used == 0 && (s->prev || s->next)) {
+        // Empty, and not the class's last slab with room: keeping one
+        // spare avoids remapping on every create and free around zero
+        unlink(g_partial[size_class], s);
+        unmap_slab(s);
+        return;
+    }
+    *static_cast<void**>(data) = s->free_slots;
+    s->free_slots = data;
+}
@@ -0,0 +1,73 @@
+#ifndef AESGCMSIV_SECURE_H
+#define AESGCMSIV_SECURE_H
+
+// Internal slab arena for key material: contexts, wrap contexts and key
+// cache entries. Nothing in this header is exported from the library.
+
+#include "aesgcmsiv.h"
+#include <new>
+#include <utility>
+
+// Largest object the arena holds; sizes are rounded up to 64-byte slots
+#define AESGCMSIV_SECURE_MAX_SIZE 1024
+
+// A zeroed slot of at least size bytes, aligned to 64, or NULL if size is
+// 0 or over AESGCMSIV_SECURE_MAX_SIZE or no memory is left. Slots of one
+// size are packed into 128 KB slabs, each locked into RAM as a whole when
+// mapped and fenced by inaccessible guard pages on both sides.
+void* aesgcmsiv_secure_alloc(size_t size);
+
+// Zeroes and releases a slot from aesgcmsiv_secure_alloc(size). NULL is
+// ignored.
+void aesgcmsiv_secure_free(void* data, size_t size);
+
+// Zeroed memory for key material that processes forked after it is mapped
+// see as well: locked into RAM where the OS allows, and left out of core
+// dumps. size is rounded up to a page. On Linux it is backed by a memfd that
+// sealing closes for writes everywhere; elsewhere on POSIX it is anonymous
+// shared memory.
+struct aesgcmsiv_shared_mem {
+    void* data;
+    size_t size;
+    int fd;  // backing memfd until sealed, else -1
+};
+
+// Maps mem. False if the OS refuses, and always on Windows, which has no
+// fork to share with.
+bool aesgcmsiv_shared_map(size_t size, aesgcmsiv_shared_mem* mem);
+
+// Makes mem read-only in this process and in every process forked from now
+// on. On Linux the memfd is sealed as well, so no process can map it
+// writable again; that fails if a process forked earlier still maps it
+// writable, in which case false is returned and the mapping is read-only
+// here regardless. The address stays the same unless the OS runs out of
+// memory while remapping, when mem->data changes, or is NULL if the memory
+// could not be mapped again at all.
+bool aesgcmsiv_shared_seal(aesgcmsiv_shared_mem* mem);
+
+// Unmaps mem in this process. It is not zeroed, since other processes may
+// still be using it; the pages go back to the OS, which clears them, once
+// no process maps them.
+void aesgcmsiv_shared_unmap(aesgcmsiv_shared_mem* mem);
+
+// Value-initialized T in the arena, or NULL if it is full
+template <typename T, typename... Args>
+T* aesgcmsiv_secure_new(Args&&... args)
+{
+    static_assert(sizeof(T) <= AESGCMSIV_SECURE_MAX_SIZE, "too large for a secure slot");
+    static_assert(alignof(T) <= 64, "over-aligned for a secure slot");
+    void* data = aesgcmsiv_secure_alloc(sizeof(T));
+    return data ? new (data) T(std::forward<Args>(args)...) : nullptr;
+}
+
+// Destroys an object from aesgcmsiv_secure_new and zeroes its slot
+template <typename T>
+void aesgcmsiv_secure_delete(T* object)
+{
+    if (object) {
+        object->~T();
+        aesgcmsiv_secure_free(object, sizeof(T));
+    }
+}
+
+#endif
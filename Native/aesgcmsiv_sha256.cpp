@@ -0,0 +1,473 @@
+#include "aesgcmsiv_sha256.h"
+#include "aesgcmsiv_kernels.h"
+
+#include <cstring>
+
+// SHA-256 (FIPS 180-4) for HKDF subkey derivation. Three compression
+// functions: portable C, SHA-NI for one message at a time, and AVX2 for
+// eight independent single-block messages, one per 32-bit lane. HKDF with
+// a short info only ever hashes single blocks once the HMAC pads are
+// precomputed, so the AVX2 path is what derivation runs on CPUs without
+// SHA-NI.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define AESGCMSIV_SHA256_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SHANI_TARGET
+#define AVX2_TARGET
+#else
+#define SHANI_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+static const uint32_t initial_state[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+alignas(16) static const uint32_t round_constants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static inline uint32_t load_be32(const uint8_t* p)
+{
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+        (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+static inline void store_be32(uint8_t* p, uint32_t v)
+{
+    p[0] = static_cast<uint8_t>(v >> 24);
+    p[1] = static_cast<uint8_t>(v >> 16);
+    p[2] = static_cast<uint8_t>(v >> 8);
+    p[3] = static_cast<uint8_t>(v);
+}
+
+static inline uint32_t rotr32(uint32_t x, int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+static void compress_portable(uint32_t state[8], const uint8_t* blocks, size_t count)
+{
+    for (; count > 0; count--, blocks += SHA256_BLOCK_SIZE) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; i++) {
+            w[i] = load_be32(blocks + 4 * i);
+        }
+        for (int i = 16; i < 64; i++) {
+            uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; i++) {
+            uint32_t t1 = h + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25)) + ((e & f) ^ (~e & g)) +
+                round_constants[i] + w[i];
+            uint32_t t2 = (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+        aesgcmsiv_secure_zero(w, sizeof(w));
+    }
+}
+
+#ifdef AESGCMSIV_SHA256_X86
+
+// After Intel's reference code for the SHA extensions. The rounds
+// instruction wants the state as ABEF and CDGH, so it is shuffled into that
+// order once per call rather than per block.
+SHANI_TARGET static void compress_shani(uint32_t state[8], const uint8_t* blocks, size_t count)
+{
+    const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0xb1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4)), 0x1b);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+
+    for (; count > 0; count--, blocks += SHA256_BLOCK_SIZE) {
+        const __m128i abef = state0;
+        const __m128i cdgh = state1;
+        // The last four groups of message words; group i is in m[i % 4]
+        __m128i m[4];
+        for (int i = 0; i < 4; i++) {
+            m[i] = _mm_shuffle_epi8(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 16 * i)), byte_swap);
+        }
+        for (int i = 0; i < 16; i++) {
+            if (i >= 4) {
+                __m128i t = _mm_sha256msg1_epu32(m[i % 4], m[(i + 1) % 4]);
+                t = _mm_add_epi32(t, _mm_alignr_epi8(m[(i + 3) % 4], m[(i + 2) % 4], 4));
+                m[i % 4] = _mm_sha256msg2_epu32(t, m[(i + 3) % 4]);
+            }
+            __m128i msg = _mm_add_epi32(
+                m[i % 4], _mm_load_si128(reinterpret_cast<const __m128i*>(round_constants + 4 * i)));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0e));
+        }
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1b);
+    state1 = _mm_shuffle_epi32(state1, 0xb1);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_blend_epi16(tmp, state1, 0xf0));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), _mm_alignr_epi8(state1, tmp, 8));
+}
+
+AVX2_TARGET static inline __m256i rotr_x8(__m256i x, int n)
+{
+    return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+
+// One block for each of eight messages. states[j] is message j's chaining
+// value and blocks[j] its block; the words are transposed so that lane j of
+// every vector belongs to message j.
+AVX2_TARGET static void compress_avx2_x8(uint32_t* const states[8], const uint8_t* const blocks[8])
+{
+    alignas(32) uint32_t lanes[16][8];
+    __m256i w[16];
+    for (int i = 0; i < 16; i++) {
+        for (int j = 0; j < 8; j++) {
+            lanes[i][j] = load_be32(blocks[j] + 4 * i);
+        }
+        w[i] = _mm256_load_si256(reinterpret_cast<const __m256i*>(lanes[i]));
+    }
+    __m256i v[8];
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 8; j++) {
+            lanes[i][j] = states[j][i];
+        }
+        v[i] = _mm256_load_si256(reinterpret_cast<const __m256i*>(lanes[i]));
+    }
+
+    __m256i a = v[0], b = v[1], c = v[2], d = v[3], e = v[4], f = v[5], g = v[6], h = v[7];
+    for (int i = 0; i < 64; i++) {
+        // The schedule lives in a ring of 16, computed as the rounds reach it
+        if (i >= 16) {
+            __m256i w15 = w[(i - 15) & 15];
+            __m256i w2 = w[(i - 2) & 15];
+            __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(rotr_x8(w15, 7), rotr_x8(w15, 18)), _mm256_srli_epi32(w15, 3));
+            __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(rotr_x8(w2, 17), rotr_x8(w2, 19)), _mm256_srli_epi32(w2, 10));
+            w[i & 15] = _mm256_add_epi32(_mm256_add_epi32(w[i & 15], s0), _mm256_add_epi32(w[(i - 7) & 15], s1));
+        }
+        __m256i sigma1 = _mm256_xor_si256(_mm256_xor_si256(rotr_x8(e, 6), rotr_x8(e, 11)), rotr_x8(e, 25));
+        __m256i choose = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, sigma1), _mm256_add_epi32(choose,
+            _mm256_add_epi32(w[i & 15], _mm256_set1_epi32(static_cast<int>(round_constants[i])))));
+        __m256i sigma0 = _mm256_xor_si256(_mm256_xor_si256(rotr_x8(a, 2), rotr_x8(a, 13)), rotr_x8(a, 22));
+        __m256i majority = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+        __m256i t2 = _mm256_add_epi32(sigma0, majority);
+        h = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi32(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi32(t1, t2);
+    }
+
+    const __m256i out[8] = { a, b, c, d, e, f, g, h };
+    for (int i = 0; i < 8; i++) {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes[i]), _mm256_add_epi32(v[i], out[i]));
+        for (int j = 0; j < 8; j++) {
+            states[j][i] = lanes[i][j];
+        }
+    }
+    aesgcmsiv_secure_zero(lanes, sizeof(lanes));
+}
+
+#endif
+
+static void compress(uint32_t cpu_features, uint32_t state[8], const uint8_t* blocks, size_t count)
+{
+#ifdef AESGCMSIV_SHA256_X86
+    if ((cpu_features & (AESGCMSIV_CPU_SHA | AESGCMSIV_CPU_SSE41)) == (AESGCMSIV_CPU_SHA | AESGCMSIV_CPU_SSE41)) {
+        compress_shani(state, blocks, count);
+        return;
+    }
+#else
+    (void)cpu_features;
+#endif
+    compress_portable(state, blocks, count);
+}
+
+// Streaming hash from a chaining value, which may already cover whole
+// blocks (an HMAC pad)
+struct sha256_stream {
+    uint32_t state[8];
+    uint8_t buffer[SHA256_BLOCK_SIZE];
+    size_t buffered;
+    uint64_t total;
+};
+
+static void stream_init(sha256_stream* s, const uint32_t state[8], uint64_t prefix_len)
+{
+    memcpy(s->state, state, sizeof(s->state));
+    s->buffered = 0;
+    s->total = prefix_len;
+}
+
+static void stream_update(uint32_t cpu_features, sha256_stream* s, const uint8_t* data, size_t len)
+{
+    s->total += len;
+    if (s->buffered > 0) {
+        size_t take = SHA256_BLOCK_SIZE - s->buffered;
+        if (take > len) {
+            take = len;
+        }
+        memcpy(s->buffer + s->buffered, data, take);
+        s->buffered += take;
+        data += take;
+        len -= take;
+        if (s->buffered < SHA256_BLOCK_SIZE) {
+            return;
+        }
+        compress(cpu_features, s->state, s->buffer, 1);
+        s->buffered = 0;
+    }
+    if (len >= SHA256_BLOCK_SIZE) {
+        compress(cpu_features, s->state, data, len / SHA256_BLOCK_SIZE);
+        data += len / SHA256_BLOCK_SIZE * SHA256_BLOCK_SIZE;
+        len %= SHA256_BLOCK_SIZE;
+    }
+    memcpy(s->buffer, data, len);
+    s->buffered = len;
+}
+
+static void stream_final(uint32_t cpu_features, sha256_stream* s, uint8_t out[SHA256_DIGEST_SIZE])
+{
+    const uint64_t bits = s->total * 8;
+    s->buffer[s->buffered++] = 0x80;
+    if (s->buffered > SHA256_BLOCK_SIZE - 8) {
+        memset(s->buffer + s->buffered, 0, SHA256_BLOCK_SIZE - s->buffered);
+        compress(cpu_features, s->state, s->buffer, 1);
+        s->buffered = 0;
+    }
+    memset(s->buffer + s->buffered, 0, SHA256_BLOCK_SIZE - 8 - s->buffered);
+    store_be32(s->buffer + 56, static_cast<uint32_t>(bits >> 32));
+    store_be32(s->buffer + 60, static_cast<uint32_t>(bits));
+    compress(cpu_features, s->state, s->buffer, 1);
+    for (int i = 0; i < 8; i++) {
+        store_be32(out + 4 * i, s->state[i]);
+    }
+    aesgcmsiv_secure_zero(s, sizeof(*s));
+}
+
+void aesgcmsiv_hmac_sha256_init(uint32_t cpu_features, const uint8_t* key, size_t key_len, hmac_sha256_key* out)
+{
+    uint8_t pad[SHA256_BLOCK_SIZE] = {};
+    if (key_len > SHA256_BLOCK_SIZE) {
+        sha256_stream s;
+        stream_init(&s, initial_state, 0);
+        stream_update(cpu_features, &s, key, key_len);
+        stream_final(cpu_features, &s, pad);
+    } else if (key_len > 0) {
+        memcpy(pad, key, key_len);
+    }
+
+    for (int i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        pad[i] ^= 0x36;
+    }
+    memcpy(out->inner, initial_state, sizeof(out->inner));
+    compress(cpu_features, out->inner, pad, 1);
+    for (int i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        pad[i] ^= 0x36 ^ 0x5c;
+    }
+    memcpy(out->outer, initial_state, sizeof(out->outer));
+    compress(cpu_features, out->outer, pad, 1);
+    aesgcmsiv_secure_zero(pad, sizeof(pad));
+}
+
+// The outer hash of an inner digest is always one block: the digest, then
+// padding for 64 + 32 bytes
+static void outer_block(const uint8_t digest[SHA256_DIGEST_SIZE], uint8_t block[SHA256_BLOCK_SIZE])
+{
+    memcpy(block, digest, SHA256_DIGEST_SIZE);
+    block[SHA256_DIGEST_SIZE] = 0x80;
+    memset(block + SHA256_DIGEST_SIZE + 1, 0, SHA256_BLOCK_SIZE - SHA256_DIGEST_SIZE - 1 - 4);
+    store_be32(block + 60, (SHA256_BLOCK_SIZE + SHA256_DIGEST_SIZE) * 8);
+}
+
+void aesgcmsiv_hmac_sha256(
+    uint32_t cpu_features, const hmac_sha256_key* key,
+    const uint8_t* msg, size_t len, uint8_t out[SHA256_DIGEST_SIZE])
+{
+    sha256_stream s;
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    stream_init(&s, key->inner, SHA256_BLOCK_SIZE);
+    stream_update(cpu_features, &s, msg, len);
+    stream_final(cpu_features, &s, digest);
+
+    uint8_t block[SHA256_BLOCK_SIZE];
+    uint32_t state[8];
+    outer_block(digest, block);
+    memcpy(state, key->outer, sizeof(state));
+    compress(cpu_features, state, block, 1);
+    for (int i = 0; i < 8; i++) {
+        store_be32(out + 4 * i, state[i]);
+    }
+    aesgcmsiv_secure_zero(digest, sizeof(digest));
+    aesgcmsiv_secure_zero(block, sizeof(block));
+    aesgcmsiv_secure_zero(state, sizeof(state));
+}
+
+void aesgcmsiv_hkdf_extract(
+    uint32_t cpu_features, const uint8_t* salt, size_t salt_len,
+    const uint8_t* ikm, size_t ikm_len, hmac_sha256_key* prk_out)
+{
+    static const uint8_t zero_salt[SHA256_DIGEST_SIZE] = {};
+    hmac_sha256_key salt_key;
+    uint8_t prk[SHA256_DIGEST_SIZE];
+    if (salt_len == 0) {
+        salt = zero_salt;
+        salt_len = sizeof(zero_salt);
+    }
+    aesgcmsiv_hmac_sha256_init(cpu_features, salt, salt_len, &salt_key);
+    aesgcmsiv_hmac_sha256(cpu_features, &salt_key, ikm, ikm_len, prk);
+    aesgcmsiv_hmac_sha256_init(cpu_features, prk, sizeof(prk), prk_out);
+    aesgcmsiv_secure_zero(&salt_key, sizeof(salt_key));
+    aesgcmsiv_secure_zero(prk, sizeof(prk));
+}
+
+#ifdef AESGCMSIV_SHA256_X86
+
+// Longest info whose inner message, info || 0x01, fits one padded block
+static const size_t single_block_info = SHA256_BLOCK_SIZE - 1 - 1 - 8;
+
+// T(1) for eight single-block infos at once: the inner blocks, then the
+// outer blocks, each as one pass of compress_avx2_x8
+static void expand_avx2_x8(
+    const hmac_sha256_key* prk, const aesgcmsiv_iovec* const infos[8],
+    size_t out_len, uint8_t* const outs[8])
+{
+    uint8_t blocks[8][SHA256_BLOCK_SIZE];
+    uint32_t states[8][8];
+    uint32_t* state_ptrs[8];
+    const uint8_t* block_ptrs[8];
+    for (int j = 0; j < 8; j++) {
+        const size_t len = infos[j]->len;
+        if (len > 0) {
+            memcpy(blocks[j], infos[j]->data, len);
+        }
+        blocks[j][len] = 0x01;
+        blocks[j][len + 1] = 0x80;
+        memset(blocks[j] + len + 2, 0, SHA256_BLOCK_SIZE - 4 - (len + 2));
+        store_be32(blocks[j] + 60, static_cast<uint32_t>((SHA256_BLOCK_SIZE + len + 1) * 8));
+        memcpy(states[j], prk->inner, sizeof(states[j]));
+        state_ptrs[j] = states[j];
+        block_ptrs[j] = blocks[j];
+    }
+    compress_avx2_x8(state_ptrs, block_ptrs);
+
+    for (int j = 0; j < 8; j++) {
+        uint8_t digest[SHA256_DIGEST_SIZE];
+        for (int i = 0; i < 8; i++) {
+            store_be32(digest + 4 * i, states[j][i]);
+        }
+        outer_block(digest, blocks[j]);
+        memcpy(states[j], prk->outer, sizeof(states[j]));
+    }
+    compress_avx2_x8(state_ptrs, block_ptrs);
+
+    for (int j = 0; j < 8; j++) {
+        uint8_t digest[SHA256_DIGEST_SIZE];
+        for (int i = 0; i < 8; i++) {
+            store_be32(digest + 4 * i, states[j][i]);
+        }
+        memcpy(outs[j], digest, out_len);
+        aesgcmsiv_secure_zero(digest, sizeof(digest));
+    }
+    aesgcmsiv_secure_zero(blocks, sizeof(blocks));
+    aesgcmsiv_secure_zero(states, sizeof(states));
+}
+
+#endif
+
+static void expand_one(
+    uint32_t cpu_features, const hmac_sha256_key* prk,
+    const aesgcmsiv_iovec* info, size_t out_len, uint8_t* out)
+{
+    static const uint8_t counter = 0x01;
+    sha256_stream s;
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    stream_init(&s, prk->inner, SHA256_BLOCK_SIZE);
+    if (info->len > 0) {
+        stream_update(cpu_features, &s, info->data, info->len);
+    }
+    stream_update(cpu_features, &s, &counter, 1);
+    stream_final(cpu_features, &s, digest);
+
+    uint8_t block[SHA256_BLOCK_SIZE];
+    outer_block(digest, block);
+    memcpy(s.state, prk->outer, sizeof(s.state));
+    compress(cpu_features, s.state, block, 1);
+    for (int i = 0; i < 8; i++) {
+        store_be32(digest + 4 * i, s.state[i]);
+    }
+    memcpy(out, digest, out_len);
+    aesgcmsiv_secure_zero(digest, sizeof(digest));
+    aesgcmsiv_secure_zero(block, sizeof(block));
+    aesgcmsiv_secure_zero(&s, sizeof(s));
+}
+
+void aesgcmsiv_hkdf_expand_batch(
+    uint32_t cpu_features, const hmac_sha256_key* prk,
+    size_t count, const aesgcmsiv_iovec* infos,
+    size_t out_len, uint8_t* out)
+{
+    size_t i = 0;
+#ifdef AESGCMSIV_SHA256_X86
+    // SHA-NI on one message beats AVX2 on eight, so this only runs without it
+    if ((cpu_features & AESGCMSIV_CPU_AVX2) && !(cpu_features & AESGCMSIV_CPU_SHA)) {
+        // Short infos queue up in eights; long ones go through one at a time
+        const aesgcmsiv_iovec* queued[8];
+        uint8_t* outs[8];
+        size_t pending = 0;
+        for (; i < count; i++) {
+            if (infos[i].len > single_block_info) {
+                expand_one(cpu_features, prk, &infos[i], out_len, out + i * out_len);
+                continue;
+            }
+            queued[pending] = &infos[i];
+            outs[pending] = out + i * out_len;
+            if (++pending == 8) {
+                expand_avx2_x8(prk, queued, out_len, outs);
+                pending = 0;
+            }
+        }
+        for (size_t j = 0; j < pending; j++) {
+            expand_one(cpu_features, prk, queued[j], out_len, outs[j]);
+        }
+        return;
+    }
+#endif
+    for (; i < count; i++) {
+        expand_one(cpu_features, prk, &infos[i], out_len, out + i * out_len);
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef AESGCMSIV_SHA256_H
+#define AESGCMSIV_SHA256_H
+
+// Internal SHA-256, HMAC-SHA256 and HKDF-SHA256 (RFC 5869) behind the key
+// derivation functions (aesgcmsiv_kdf_new). cpu_features are the
+// AESGCMSIV_CPU_* bits, which pick the SHA-NI or AVX2 path. Nothing in this
+// header is exported from the library.
+
+#include "aesgcmsiv.h"
+
+#define SHA256_DIGEST_SIZE 32
+#define SHA256_BLOCK_SIZE 64
+
+// An HMAC key as the chaining values after its padded key block, so each
+// message costs only its own blocks and one for the outer hash
+struct hmac_sha256_key {
+    uint32_t inner[8];  // after key ^ ipad
+    uint32_t outer[8];  // after key ^ opad
+};
+
+// Sets out up for key, of any length
+void aesgcmsiv_hmac_sha256_init(uint32_t cpu_features, const uint8_t* key, size_t key_len, hmac_sha256_key* out);
+
+void aesgcmsiv_hmac_sha256(
+    uint32_t cpu_features, const hmac_sha256_key* key,
+    const uint8_t* msg, size_t len, uint8_t out[SHA256_DIGEST_SIZE]);
+
+// HKDF-Extract: sets prk_out up as the HMAC key PRK = HMAC(salt, ikm). An
+// empty salt stands for 32 zero bytes, as RFC 5869 has it.
+void aesgcmsiv_hkdf_extract(
+    uint32_t cpu_features, const uint8_t* salt, size_t salt_len,
+    const uint8_t* ikm, size_t ikm_len, hmac_sha256_key* prk_out);
+
+// HKDF-Expand of count outputs of out_len bytes, at most 32, so each is
+// the single block T(1) = HMAC(PRK, info || 0x01). Output i goes to
+// out + i * out_len. Infos short enough for one block are hashed eight at a
+// time on AVX2 when the CPU has no SHA-NI.
+void aesgcmsiv_hkdf_expand_batch(
+    uint32_t cpu_features, const hmac_sha256_key* prk,
+    size_t count, const aesgcmsiv_iovec* infos,
+    size_t out_len, uint8_t* out);
+
+#endif
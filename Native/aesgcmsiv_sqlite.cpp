@@ -0,0 +1,588 @@
+// The SQLite VFS shim behind aesgcmsiv_sqlite_register.
+//
+// Each file opened through the shim wraps a file of the base VFS and
+// transforms the page images in it on the way through. Where the pages sit
+// depends on the kind of file:
+//
+//   - In the main database, page n (from 1) is bytes (n - 1) * P to n * P.
+//   - In the write-ahead log, frame n (from 1) is a 24-byte header and a
+//     page, after a 32-byte file header, so its page starts at
+//     32 + (n - 1) * (24 + P) + 24.
+//   - In rollback and statement journals the page images sit at offsets
+//     that depend on the sector size, but SQLite always reads and writes
+//     them as one call of exactly P bytes, and nothing else in a journal
+//     is that size. Such a call is taken to be a page, numbered by its
+//     offset.
+//
+// The first P - 16 bytes of a page are encrypted in place under the page's
+// number, with a different base nonce per kind of file, and the tag goes in
+// the last 16, the bytes SQLite was told to reserve, which read back as
+// zeros. Everything else (the log's headers, the journals' page numbers and
+// checksums) stays as SQLite wrote it; SQLite's own checksums cover the
+// plaintext, which is what it sees. A read or write over the main database or the log may cover any
+// range: the pages wholly inside it run as one batch, and a page it only
+// partly covers is read, decrypted and, for a write, patched and sealed
+// again whole.
+
+#include "aesgcmsiv_sqlite.h"
+#include <sqlite3.h>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifndef SQLITE_IOERR_DATA
+#define SQLITE_IOERR_DATA (SQLITE_IOERR | (32 << 8))
+#endif
+
+namespace {
+
+constexpr uint64_t kWalHeader = 32;
+constexpr uint64_t kWalFrameHeader = 24;
+
+enum class Kind : uint8_t {
+    Plain,  // passed through unchanged
+    Database,
+    Wal,
+    Journal,
+};
+
+struct ShimVfs {
+    sqlite3_vfs vfs;  // registered with SQLite; first, so the two convert
+    sqlite3_vfs* base;
+    aesgcmsiv_ctx* ctx;
+    size_t page_size;
+    std::string name;
+};
+
+struct ShimState {
+    std::vector<uint8_t> scratch;  // a write's sealed bytes
+    std::vector<uint8_t> page;  // one page read apart from the caller's buffer
+    std::vector<aesgcmsiv_batch_item> items;
+    std::vector<int> statuses;
+};
+
+struct ShimFile {
+    sqlite3_file file;  // pMethods; first, so the two convert
+    ShimVfs* vfs;
+    ShimState* state;
+    Kind kind;
+    sqlite3_file* base;  // the base VFS's file, allocated after this one
+};
+
+// Rounded so the base VFS's file that follows is aligned for anything
+constexpr size_t kShimFileSize = (sizeof(ShimFile) + 15) & ~size_t(15);
+
+ShimFile* shim(sqlite3_file* file) { return reinterpret_cast<ShimFile*>(file); }
+
+// Base nonce of a kind of file: its kind in the first byte, so page n of the
+// database, frame n of the log and the page at offset n of a journal never
+// share a nonce
+void base_nonce(Kind kind, uint8_t nonce[AESGCMSIV_NONCE_SIZE]) {
+    std::memset(nonce, 0, AESGCMSIV_NONCE_SIZE);
+    nonce[0] = static_cast<uint8_t>(kind);
+}
+
+// Where page images sit in a database or log: page k (from 0) spans
+// first + k * stride to first + k * stride + page_size
+struct Layout {
+    uint64_t first;
+    uint64_t stride;
+};
+
+Layout layout_of(const ShimFile* f) {
+    uint64_t p = f->vfs->page_size;
+    if (f->kind == Kind::Wal)
+        return {kWalHeader + kWalFrameHeader, kWalFrameHeader + p};
+    return {0, p};
+}
+
+// The pages that overlap [offset, end): k_first to k_first + count - 1
+void pages_overlapping(const Layout& layout, uint64_t page_size, uint64_t offset, uint64_t end,
+                       uint64_t* k_first, uint64_t* count) {
+    uint64_t k = offset <= layout.first ? 0 : (offset - layout.first) / layout.stride;
+    if (layout.first + k * layout.stride + page_size <= offset)
+        k++;  // offset falls between two pages
+    uint64_t n = 0;
+    while (layout.first + (k + n) * layout.stride < end)
+        n++;
+    *k_first = k;
+    *count = n;
+}
+
+// Seals or opens count consecutive pages at data, the first numbered
+// counter, each stride bytes after the last, in one batch call. Returns an
+// SQLite result code.
+int run_pages(ShimFile* f, uint8_t* data, uint64_t stride, size_t count, uint64_t counter, bool encrypt,
+              int error) {
+    if (count == 0)
+        return SQLITE_OK;
+    ShimState* state = f->state;
+    size_t body = f->vfs->page_size - AESGCMSIV_TAG_SIZE;
+    try {
+        state->items.resize(count);
+        state->statuses.resize(count);
+    } catch (const std::bad_alloc&) {
+        return SQLITE_NOMEM;
+    }
+    for (size_t i = 0; i < count; i++) {
+        uint8_t* page = data + i * stride;
+        state->items[i] = {nullptr, page, body, nullptr, 0, page, page + body};
+    }
+
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    base_nonce(f->kind, nonce);
+    int result = encrypt
+        ? aesgcmsiv_encrypt_batch_counter(f->vfs->ctx, count, state->items.data(), nonce, counter)
+        : aesgcmsiv_decrypt_batch_counter(f->vfs->ctx, count, state->items.data(), nonce, counter,
+                                          state->statuses.data());
+    if (result == AESGCMSIV_ERROR_DECRYPT_FAILED)
+        return SQLITE_IOERR_DATA;
+    if (result != AESGCMSIV_SUCCESS)
+        return error;
+
+    // SQLite sees its reserved bytes as zeros, as it left them; the log's
+    // checksums cover them
+    if (!encrypt) {
+        for (size_t i = 0; i < count; i++)
+            std::memset(data + i * stride + body, 0, AESGCMSIV_TAG_SIZE);
+    }
+    return SQLITE_OK;
+}
+
+// Reads page k whole into the state's page buffer and opens it. Returns
+// SQLITE_IOERR_SHORT_READ, with the buffer zeroed, if the page is not all in
+// the file.
+int read_page(ShimFile* f, const Layout& layout, uint64_t k) {
+    size_t p = f->vfs->page_size;
+    try {
+        f->state->page.resize(p);
+    } catch (const std::bad_alloc&) {
+        return SQLITE_NOMEM;
+    }
+    uint8_t* page = f->state->page.data();
+    int rc = f->base->pMethods->xRead(f->base, page, static_cast<int>(p),
+                                      static_cast<sqlite3_int64>(layout.first + k * layout.stride));
+    if (rc == SQLITE_IOERR_SHORT_READ) {
+        std::memset(page, 0, p);
+        return rc;
+    }
+    if (rc != SQLITE_OK)
+        return rc;
+    return run_pages(f, page, 0, 1, k + 1, false, SQLITE_IOERR_READ);
+}
+
+// A first page whose header gives another page size or too few reserved
+// bytes would not read back
+bool header_fits(const uint8_t* page, size_t page_size) {
+    size_t declared = (size_t(page[16]) << 8) | page[17];
+    if (declared == 1)
+        declared = 65536;
+    return declared == page_size && page[20] >= AESGCMSIV_SQLITE_RESERVE;
+}
+
+int shim_close(sqlite3_file* file) {
+    ShimFile* f = shim(file);
+    int rc = f->base->pMethods ? f->base->pMethods->xClose(f->base) : SQLITE_OK;
+    delete f->state;
+    f->state = nullptr;
+    return rc;
+}
+
+int shim_read(sqlite3_file* file, void* buffer, int amount, sqlite3_int64 offset) {
+    ShimFile* f = shim(file);
+    sqlite3_file* base = f->base;
+    uint8_t* out = static_cast<uint8_t*>(buffer);
+    size_t p = f->vfs->page_size;
+    int rc = base->pMethods->xRead(base, buffer, amount, offset);
+    if (f->kind == Kind::Plain || (rc != SQLITE_OK && rc != SQLITE_IOERR_SHORT_READ))
+        return rc;
+
+    if (f->kind == Kind::Journal) {
+        if (rc != SQLITE_OK || static_cast<size_t>(amount) != p)
+            return rc;
+        return run_pages(f, out, 0, 1, static_cast<uint64_t>(offset), false, SQLITE_IOERR_READ);
+    }
+
+    // Pages past the end of the file read as the zeros the base VFS filled
+    // them with
+    uint64_t start = static_cast<uint64_t>(offset);
+    uint64_t end = start + static_cast<uint64_t>(amount);
+    uint64_t size = end;
+    if (rc == SQLITE_IOERR_SHORT_READ) {
+        sqlite3_int64 file_size = 0;
+        int size_rc = base->pMethods->xFileSize(base, &file_size);
+        if (size_rc != SQLITE_OK)
+            return size_rc;
+        size = static_cast<uint64_t>(file_size);
+    }
+
+    Layout layout = layout_of(f);
+    uint64_t k_first, count;
+    pages_overlapping(layout, p, start, end, &k_first, &count);
+    uint64_t whole_first = 0, whole_count = 0;
+    for (uint64_t k = k_first; k < k_first + count; k++) {
+        uint64_t page_start = layout.first + k * layout.stride;
+        uint64_t page_end = page_start + p;
+        if (page_end > size)
+            break;
+        if (page_start >= start && page_end <= end) {
+            if (whole_count++ == 0)
+                whole_first = k;
+            continue;
+        }
+        // A page the read only partly covers
+        int page_rc = read_page(f, layout, k);
+        if (page_rc != SQLITE_OK)
+            return page_rc == SQLITE_IOERR_SHORT_READ ? rc : page_rc;
+        uint64_t from = page_start > start ? page_start : start;
+        uint64_t to = page_end < end ? page_end : end;
+        std::memcpy(out + (from - start), f->state->page.data() + (from - page_start), to - from);
+    }
+
+    if (whole_count != 0) {
+        int open_rc = run_pages(f, out + (layout.first + whole_first * layout.stride - start), layout.stride,
+                                static_cast<size_t>(whole_count), whole_first + 1, false, SQLITE_IOERR_READ);
+        if (open_rc != SQLITE_OK)
+            return open_rc;
+    }
+    return rc;
+}
+
+int shim_write(sqlite3_file* file, const void* buffer, int amount, sqlite3_int64 offset) {
+    ShimFile* f = shim(file);
+    sqlite3_file* base = f->base;
+    size_t p = f->vfs->page_size;
+    ShimState* state = f->state;
+    if (f->kind == Kind::Plain || (f->kind == Kind::Journal && static_cast<size_t>(amount) != p))
+        return base->pMethods->xWrite(base, buffer, amount, offset);
+
+    if (f->kind == Kind::Journal) {
+        try {
+            state->scratch.assign(static_cast<const uint8_t*>(buffer), static_cast<const uint8_t*>(buffer) + p);
+        } catch (const std::bad_alloc&) {
+            return SQLITE_NOMEM;
+        }
+        int rc = run_pages(f, state->scratch.data(), 0, 1, static_cast<uint64_t>(offset), true, SQLITE_IOERR_WRITE);
+        return rc == SQLITE_OK ? base->pMethods->xWrite(base, state->scratch.data(), amount, offset) : rc;
+    }
+
+    // Widen the write to whole pages, filling in what it leaves out of the
+    // first and last from the file, or with zeros where the file holds no
+    // page that opens
+    Layout layout = layout_of(f);
+    uint64_t start = static_cast<uint64_t>(offset);
+    uint64_t end = start + static_cast<uint64_t>(amount);
+    uint64_t k_first, count;
+    pages_overlapping(layout, p, start, end, &k_first, &count);
+    uint64_t low = start, high = end;
+    if (count != 0) {
+        uint64_t first_start = layout.first + k_first * layout.stride;
+        uint64_t last_end = layout.first + (k_first + count - 1) * layout.stride + p;
+        low = first_start < start ? first_start : start;
+        high = last_end > end ? last_end : end;
+    }
+    try {
+        state->scratch.resize(static_cast<size_t>(high - low));
+    } catch (const std::bad_alloc&) {
+        return SQLITE_NOMEM;
+    }
+    uint8_t* scratch = state->scratch.data();
+    for (uint64_t k = k_first; count != 0 && k < k_first + count; k += count > 1 ? count - 1 : 1) {
+        uint64_t page_start = layout.first + k * layout.stride;
+        if (page_start >= start && page_start + p <= end)
+            continue;
+        int rc = read_page(f, layout, k);
+        if (rc == SQLITE_IOERR_DATA || rc == SQLITE_IOERR_SHORT_READ)
+            std::memset(state->page.data(), 0, p);
+        else if (rc != SQLITE_OK)
+            return rc;
+        std::memcpy(scratch + (page_start - low), state->page.data(), p);
+    }
+    std::memcpy(scratch + (start - low), buffer, static_cast<size_t>(amount));
+
+    if (f->kind == Kind::Database && count != 0 && k_first == 0 && !header_fits(scratch, p))
+        return SQLITE_IOERR_WRITE;
+    int rc = run_pages(f, scratch + (layout.first + k_first * layout.stride - low), layout.stride,
+                       static_cast<size_t>(count), k_first + 1, true, SQLITE_IOERR_WRITE);
+    if (rc != SQLITE_OK)
+        return rc;
+    return base->pMethods->xWrite(base, scratch, static_cast<int>(high - low), static_cast<sqlite3_int64>(low));
+}
+
+int shim_truncate(sqlite3_file* file, sqlite3_int64 size) {
+    sqlite3_file* base = shim(file)->base;
+    return base->pMethods->xTruncate(base, size);
+}
+
+int shim_sync(sqlite3_file* file, int flags) {
+    sqlite3_file* base = shim(file)->base;
+    return base->pMethods->xSync(base, flags);
+}
+
+int shim_file_size(sqlite3_file* file, sqlite3_int64* size) {
+    sqlite3_file* base = shim(file)->base;
+    return base->pMethods->xFileSize(base, size);
+}
+
+int shim_lock(sqlite3_file* file, int lock) {
+    sqlite3_file* base = shim(file)->base;
+    return base->pMethods->xLock(base, lock);
+}
+
+int shim_unlock(sqlite3_file* file, int lock) {
+    sqlite3_file* base = shim(file)->base;
+    return base->pMethods->xUnlock(base, lock);
+}
+
+int shim_check_reserved_lock(sqlite3_file* file, int* reserved) {
+    sqlite3_file* base = shim(file)->base;
+    return base->pMethods->xCheckReservedLock(base, reserved);
+}
+
+int shim_file_control(sqlite3_file* file, int op, void* arg) {
+    ShimFile* f = shim(file);
+    if (op == SQLITE_FCNTL_VFSNAME) {
+        // Name the shim ahead of the base VFS, as SQLite's own shims do
+        int rc = f->base->pMethods->xFileControl(f->base, op, arg);
+        char** name = static_cast<char**>(arg);
+        char* joined = rc == SQLITE_OK
+            ? sqlite3_mprintf("%s/%z", f->vfs->name.c_str(), *name)
+            : sqlite3_mprintf("%s", f->vfs->name.c_str());
+        if (!joined)
+            return SQLITE_NOMEM;
+        *name = joined;
+        return SQLITE_OK;
+    }
+    return f->base->pMethods->xFileControl(f->base, op, arg);
+}
+
+int shim_sector_size(sqlite3_file* file) {
+    sqlite3_file* base = shim(file)->base;
+    return base->pMethods->xSectorSize(base);
+}
+
+int shim_device_characteristics(sqlite3_file* file) {
+    sqlite3_file* base = shim(file)->base;
+    return base->pMethods->xDeviceCharacteristics(base);
+}
+
+// The WAL index holds page numbers and hashes, not page contents, so it is
+// shared through the base VFS as it is
+int shim_shm_map(sqlite3_file* file, int region, int size, int extend, void volatile** out) {
+    sqlite3_file* base = shim(file)->base;
+    return base->pMethods->xShmMap(base, region, size, extend, out);
+}
+
+int shim_shm_lock(sqlite3_file* file, int offset, int n, int flags) {
+    sqlite3_file* base = shim(file)->base;
+    return base->pMethods->xShmLock(base, offset, n, flags);
+}
+
+void shim_shm_barrier(sqlite3_file* file) {
+    sqlite3_file* base = shim(file)->base;
+    base->pMethods->xShmBarrier(base);
+}
+
+int shim_shm_unmap(sqlite3_file* file, int delete_flag) {
+    sqlite3_file* base = shim(file)->base;
+    return base->pMethods->xShmUnmap(base, delete_flag);
+}
+
+// Version 2: the shared-memory methods, but not xFetch, so SQLite never
+// maps the encrypted file into memory
+const sqlite3_io_methods kShimMethods = {
+    2,
+    shim_close,
+    shim_read,
+    shim_write,
+    shim_truncate,
+    shim_sync,
+    shim_file_size,
+    shim_lock,
+    shim_unlock,
+    shim_check_reserved_lock,
+    shim_file_control,
+    shim_sector_size,
+    shim_device_characteristics,
+    shim_shm_map,
+    shim_shm_lock,
+    shim_shm_barrier,
+    shim_shm_unmap,
+    nullptr,
+    nullptr,
+};
+
+Kind kind_of(int flags) {
+    if (flags & SQLITE_OPEN_MAIN_DB)
+        return Kind::Database;
+    if (flags & SQLITE_OPEN_WAL)
+        return Kind::Wal;
+    if (flags & (SQLITE_OPEN_MAIN_JOURNAL | SQLITE_OPEN_SUBJOURNAL | SQLITE_OPEN_TEMP_JOURNAL))
+        return Kind::Journal;
+    return Kind::Plain;
+}
+
+int shim_open(sqlite3_vfs* vfs, const char* name, sqlite3_file* file, int flags, int* out_flags) {
+    ShimVfs* v = reinterpret_cast<ShimVfs*>(vfs);
+    ShimFile* f = shim(file);
+    f->file.pMethods = nullptr;
+    f->vfs = v;
+    f->kind = kind_of(flags);
+    f->base = reinterpret_cast<sqlite3_file*>(reinterpret_cast<uint8_t*>(file) + kShimFileSize);
+    f->state = new (std::nothrow) ShimState();
+    if (!f->state)
+        return SQLITE_NOMEM;
+    int rc = v->base->xOpen(v->base, name, f->base, flags, out_flags);
+    if (f->base->pMethods)
+        f->file.pMethods = &kShimMethods;
+    else
+        shim_close(file);
+    return rc;
+}
+
+int shim_delete(sqlite3_vfs* vfs, const char* name, int sync_dir) {
+    sqlite3_vfs* base = reinterpret_cast<ShimVfs*>(vfs)->base;
+    return base->xDelete(base, name, sync_dir);
+}
+
+int shim_access(sqlite3_vfs* vfs, const char* name, int flags, int* out) {
+    sqlite3_vfs* base = reinterpret_cast<ShimVfs*>(vfs)->base;
+    return base->xAccess(base, name, flags, out);
+}
+
+int shim_full_pathname(sqlite3_vfs* vfs, const char* name, int size, char* out) {
+    sqlite3_vfs* base = reinterpret_cast<ShimVfs*>(vfs)->base;
+    return base->xFullPathname(base, name, size, out);
+}
+
+void* shim_dl_open(sqlite3_vfs* vfs, const char* path) {
+    sqlite3_vfs* base = reinterpret_cast<ShimVfs*>(vfs)->base;
+    return base->xDlOpen(base, path);
+}
+
+void shim_dl_error(sqlite3_vfs* vfs, int size, char* out) {
+    sqlite3_vfs* base = reinterpret_cast<ShimVfs*>(vfs)->base;
+    base->xDlError(base, size, out);
+}
+
+void (*shim_dl_sym(sqlite3_vfs* vfs, void* handle, const char* symbol))(void) {
+    sqlite3_vfs* base = reinterpret_cast<ShimVfs*>(vfs)->base;
+    return base->xDlSym(base, handle, symbol);
+}
+
+void shim_dl_close(sqlite3_vfs* vfs, void* handle) {
+    sqlite3_vfs* base = reinterpret_cast<ShimVfs*>(vfs)->base;
+    base->xDlClose(base, handle);
+}
+
+int shim_randomness(sqlite3_vfs* vfs, int size, char* out) {
+    sqlite3_vfs* base = reinterpret_cast<ShimVfs*>(vfs)->base;
+    return base->xRandomness(base, size, out);
+}
+
+int shim_sleep(sqlite3_vfs* vfs, int microseconds) {
+    sqlite3_vfs* base = reinterpret_cast<ShimVfs*>(vfs)->base;
+    return base->xSleep(base, microseconds);
+}
+
+int shim_current_time(sqlite3_vfs* vfs, double* out) {
+    sqlite3_vfs* base = reinterpret_cast<ShimVfs*>(vfs)->base;
+    return base->xCurrentTime(base, out);
+}
+
+int shim_get_last_error(sqlite3_vfs* vfs, int size, char* out) {
+    sqlite3_vfs* base = reinterpret_cast<ShimVfs*>(vfs)->base;
+    return base->xGetLastError ? base->xGetLastError(base, size, out) : 0;
+}
+
+int shim_current_time_int64(sqlite3_vfs* vfs, sqlite3_int64* out) {
+    sqlite3_vfs* base = reinterpret_cast<ShimVfs*>(vfs)->base;
+    if (base->iVersion >= 2 && base->xCurrentTimeInt64)
+        return base->xCurrentTimeInt64(base, out);
+    double days;
+    int rc = base->xCurrentTime(base, &days);
+    *out = static_cast<sqlite3_int64>(days * 86400000.0);
+    return rc;
+}
+
+}  // namespace
+
+extern "C" {
+
+int aesgcmsiv_sqlite_register(
+    const char* name,
+    const char* base_vfs,
+    const uint8_t* key, size_t key_len,
+    size_t page_size,
+    int make_default) {
+    if (!name || page_size < 512 || page_size > 65536 || (page_size & (page_size - 1)) != 0)
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    if (sqlite3_initialize() != SQLITE_OK)
+        return AESGCMSIV_ERROR_INTERNAL;
+    sqlite3_vfs* base = sqlite3_vfs_find(base_vfs);
+    if (!base)
+        return AESGCMSIV_ERROR_NOT_FOUND;
+    if (sqlite3_vfs_find(name))
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+
+    aesgcmsiv_ctx* ctx = nullptr;
+    int result = aesgcmsiv_ctx_new(key, key_len, &ctx);
+    if (result != AESGCMSIV_SUCCESS)
+        return result;
+    ShimVfs* v = new (std::nothrow) ShimVfs();
+    if (!v) {
+        aesgcmsiv_ctx_free(ctx);
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    try {
+        v->name = name;
+    } catch (const std::bad_alloc&) {
+        aesgcmsiv_ctx_free(ctx);
+        delete v;
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    v->base = base;
+    v->ctx = ctx;
+    v->page_size = page_size;
+
+    sqlite3_vfs& vfs = v->vfs;
+    vfs.iVersion = 2;
+    vfs.szOsFile = static_cast<int>(kShimFileSize) + base->szOsFile;
+    vfs.mxPathname = base->mxPathname;
+    vfs.zName = v->name.c_str();
+    vfs.pAppData = v;
+    vfs.xOpen = shim_open;
+    vfs.xDelete = shim_delete;
+    vfs.xAccess = shim_access;
+    vfs.xFullPathname = shim_full_pathname;
+    vfs.xDlOpen = shim_dl_open;
+    vfs.xDlError = shim_dl_error;
+    vfs.xDlSym = shim_dl_sym;
+    vfs.xDlClose = shim_dl_close;
+    vfs.xRandomness = shim_randomness;
+    vfs.xSleep = shim_sleep;
+    vfs.xCurrentTime = shim_current_time;
+    vfs.xGetLastError = shim_get_last_error;
+    vfs.xCurrentTimeInt64 = shim_current_time_int64;
+
+    if (sqlite3_vfs_register(&vfs, make_default ? 1 : 0) != SQLITE_OK) {
+        aesgcmsiv_ctx_free(ctx);
+        delete v;
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_sqlite_unregister(const char* name) {
+    sqlite3_vfs* vfs = name ? sqlite3_vfs_find(name) : nullptr;
+    if (!vfs || vfs->xOpen != shim_open)
+        return AESGCMSIV_ERROR_NOT_FOUND;
+    ShimVfs* v = static_cast<ShimVfs*>(vfs->pAppData);
+    sqlite3_vfs_unregister(vfs);
+    aesgcmsiv_ctx_free(v->ctx);
+    delete v;
+    return AESGCMSIV_SUCCESS;
+}
+
+}  // extern "C"
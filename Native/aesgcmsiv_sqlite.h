@@ -0,0 +1,84 @@
+#ifndef AESGCMSIV_SQLITE_H
+#define AESGCMSIV_SQLITE_H
+
+// A SQLite VFS shim that keeps database pages encrypted at rest, built as
+// the separate aesgcmsiv_sqlite library (-DAESGCMSIV_SQLITE=ON) so that the
+// main library does not depend on SQLite.
+//
+// Every page of the main database file is encrypted under the page-number
+// nonce aesgcmsiv_encrypt_batch_counter gives it, and its tag is kept in
+// the last AESGCMSIV_SQLITE_RESERVE bytes of the page, which SQLite must be
+// told to leave unused. Page images in the write-ahead log and in rollback
+// and statement journals are encrypted the same way, so no plaintext page
+// reaches the disk. Reads and writes that span several pages take one
+// batch call.
+
+#include "aesgcmsiv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bytes at the end of each page that hold its tag. Set them before the
+// database's first page is written:
+//
+//   int reserve = AESGCMSIV_SQLITE_RESERVE;
+//   sqlite3_file_control(db, "main", SQLITE_FCNTL_RESERVE_BYTES, &reserve);
+#define AESGCMSIV_SQLITE_RESERVE AESGCMSIV_TAG_SIZE
+
+/**
+ * Registers a SQLite VFS named name that encrypts under key and stores its
+ * files through the VFS named base_vfs. Open a database with it through
+ * the vfs argument of sqlite3_open_v2, or a "vfs=" URI parameter.
+ *
+ * The database must use page_size bytes per page (PRAGMA page_size), and
+ * reserve AESGCMSIV_SQLITE_RESERVE bytes per page before it is created;
+ * writing a first page that says otherwise fails with SQLITE_IOERR_WRITE.
+ * A page that fails to authenticate fails its read with SQLITE_IOERR_DATA.
+ *
+ * Pages are encrypted under nonces derived from their page numbers, or for
+ * the log and journals from their positions in the file, so a page written
+ * twice with the same content is stored the same both times. AES-GCM-SIV
+ * keeps a rewritten page with different content from revealing more than
+ * that, but databases sharing a key can be compared page by page; give
+ * each database its own key. The shared-memory WAL index, the super-journal
+ * and temporary databases are not encrypted; keep temporary tables in
+ * memory (PRAGMA temp_store = MEMORY). Memory-mapped I/O is not offered.
+ *
+ * @param name Name of the new VFS; copied
+ * @param base_vfs Name of the VFS that does the file I/O, or NULL for the
+ *                 default
+ * @param key Pointer to 16-byte (AES-128) or 32-byte (AES-256) key
+ * @param key_len Length of key (must be 16 or 32)
+ * @param page_size Page size of the databases, a power of two from 512 to
+ *                  65536
+ * @param make_default Nonzero to make the new VFS SQLite's default
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_NOT_FOUND if there
+ *         is no base_vfs, AESGCMSIV_ERROR_INVALID_INPUT if name is NULL or
+ *         taken or page_size is out of range, another negative error code
+ *         on failure
+ */
+AESGCMSIV_API int aesgcmsiv_sqlite_register(
+    const char* name,
+    const char* base_vfs,
+    const uint8_t* key, size_t key_len,
+    size_t page_size,
+    int make_default);
+
+/**
+ * Unregisters a VFS registered by aesgcmsiv_sqlite_register and frees its
+ * key. No database opened through it may still be open.
+ *
+ * @param name Name of the VFS
+ *
+ * @return AESGCMSIV_SUCCESS on success, AESGCMSIV_ERROR_NOT_FOUND if no VFS
+ *         of that name was registered by aesgcmsiv_sqlite_register
+ */
+AESGCMSIV_API int aesgcmsiv_sqlite_unregister(const char* name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AESGCMSIV_SQLITE_H
@@ -0,0 +1,433 @@
+// Counters behind aesgcmsiv_get_stats and aesgcmsiv_get_profile, and the
+// slow-operation callback.
+//
+// Each thread that makes a call while
+// statistics are enabled gets its own block, aligned to a cache line and
+// written only by that thread, so counting costs a few plain stores and never
+// bounces a line between cores. Readers sum the blocks under the registry
+// lock; a block's totals move to the registry when its thread exits.
+//
+// Resetting never writes to a block, which would race with its owner;
+// instead it remembers the totals at the time and aesgcmsiv_get_stats
+// subtracts them.
+//
+// The phase profile is kept the same way, in a second block a thread
+// allocates the first time it profiles a call, since it is some 10 KB.
+//
+// Usage counters belong to a context rather than a thread, so threads sharing
+// one add to them atomically, each to its own stripe.
+
+#include "aesgcmsiv_stats.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+
+std::atomic<unsigned int> aesgcmsiv_timing(0);
+thread_local aesgcmsiv_phase_clock aesgcmsiv_phases;
+std::atomic<unsigned int> aesgcmsiv_usage_contexts(0);
+
+namespace {
+
+constexpr size_t kFields = sizeof(aesgcmsiv_op_stats) / sizeof(uint64_t);
+static_assert(sizeof(aesgcmsiv_op_stats) == kFields * sizeof(uint64_t),
+    "aesgcmsiv_op_stats must be an array of uint64_t");
+
+// Field offsets within aesgcmsiv_op_stats
+constexpr size_t kCalls = offsetof(aesgcmsiv_op_stats, calls) / sizeof(uint64_t);
+constexpr size_t kBytes = offsetof(aesgcmsiv_op_stats, bytes) / sizeof(uint64_t);
+constexpr size_t kFailures = offsetof(aesgcmsiv_op_stats, failures) / sizeof(uint64_t);
+constexpr size_t kSetup = offsetof(aesgcmsiv_op_stats, setup_ns) / sizeof(uint64_t);
+constexpr size_t kCrypto = offsetof(aesgcmsiv_op_stats, crypto_ns) / sizeof(uint64_t);
+constexpr size_t kWide = offsetof(aesgcmsiv_op_stats, wide_calls) / sizeof(uint64_t);
+constexpr size_t kNarrow = offsetof(aesgcmsiv_op_stats, narrow_calls) / sizeof(uint64_t);
+
+constexpr size_t kProfileFields = sizeof(aesgcmsiv_profile) / sizeof(uint64_t);
+constexpr size_t kBucketFields = sizeof(aesgcmsiv_profile_bucket) / sizeof(uint64_t);
+static_assert(sizeof(aesgcmsiv_profile_bucket) == kBucketFields * sizeof(uint64_t),
+    "aesgcmsiv_profile_bucket must be an array of uint64_t");
+
+// Field offsets within aesgcmsiv_profile_bucket
+constexpr size_t kMessages = offsetof(aesgcmsiv_profile_bucket, messages) / sizeof(uint64_t);
+constexpr size_t kProfileBytes = offsetof(aesgcmsiv_profile_bucket, bytes) / sizeof(uint64_t);
+constexpr size_t kCycles = offsetof(aesgcmsiv_profile_bucket, cycles) / sizeof(uint64_t);
+constexpr size_t kHistogram = offsetof(aesgcmsiv_profile_bucket, histogram) / sizeof(uint64_t);
+
+struct Totals {
+    uint64_t values[2][kFields];
+};
+
+struct ProfileTotals {
+    uint64_t values[kProfileFields];
+};
+
+struct ProfileStats {
+    std::atomic<uint64_t> values[kProfileFields];
+};
+
+struct alignas(64) ThreadStats {
+    std::atomic<uint64_t> values[2][kFields];
+    std::atomic<ProfileStats*> profile;  // NULL until the thread profiles a call
+    ThreadStats* prev;
+    ThreadStats* next;
+};
+
+struct Registry {
+    std::mutex mutex;
+    ThreadStats* head = nullptr;
+    Totals retired = {};  // from threads that have exited
+    Totals baseline = {};  // totals at the last reset
+    ProfileTotals retired_profile = {};
+    ProfileTotals baseline_profile = {};
+};
+
+// Never freed, since threads can still exit while static objects are being
+// destroyed
+Registry& registry()
+{
+    static Registry* instance = new Registry();
+    return *instance;
+}
+
+void add_block(const ThreadStats& block, Totals* totals)
+{
+    for (size_t op = 0; op < 2; op++) {
+        for (size_t i = 0; i < kFields; i++) {
+            totals->values[op][i] += block.values[op][i].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void add_profile(const ThreadStats& block, ProfileTotals* totals)
+{
+    const ProfileStats* profile = block.profile.load(std::memory_order_acquire);
+    if (!profile) {
+        return;
+    }
+    for (size_t i = 0; i < kProfileFields; i++) {
+        totals->values[i] += profile->values[i].load(std::memory_order_relaxed);
+    }
+}
+
+// Registry lock held
+Totals current_totals(Registry& reg)
+{
+    Totals totals = reg.retired;
+    for (ThreadStats* block = reg.head; block; block = block->next) {
+        add_block(*block, &totals);
+    }
+    return totals;
+}
+
+// Registry lock held
+void current_profile(Registry& reg, ProfileTotals* totals)
+{
+    *totals = reg.retired_profile;
+    for (ThreadStats* block = reg.head; block; block = block->next) {
+        add_profile(*block, totals);
+    }
+}
+
+class ThreadSlot {
+public:
+    ThreadSlot() = default;
+    ThreadSlot(const ThreadSlot&) = delete;
+    ThreadSlot& operator=(const ThreadSlot&) = delete;
+
+    ~ThreadSlot()
+    {
+        if (!block_) {
+            return;
+        }
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        add_block(*block_, &reg.retired);
+        add_profile(*block_, &reg.retired_profile);
+        (block_->prev ? block_->prev->next : reg.head) = block_->next;
+        if (block_->next) {
+            block_->next->prev = block_->prev;
+        }
+        delete block_->profile.load(std::memory_order_relaxed);
+        delete block_;
+    }
+
+    // NULL if the block could not be allocated; the call then goes uncounted
+    ThreadStats* get()
+    {
+        if (!block_) {
+            block_ = new (std::nothrow) ThreadStats();
+            if (block_) {
+                Registry& reg = registry();
+                std::lock_guard<std::mutex> lock(reg.mutex);
+                block_->prev = nullptr;
+                block_->next = reg.head;
+                if (reg.head) {
+                    reg.head->prev = block_;
+                }
+                reg.head = block_;
+            }
+        }
+        return block_;
+    }
+
+private:
+    ThreadStats* block_ = nullptr;
+};
+
+thread_local ThreadSlot t_slot;
+
+// The owning thread is the only writer, so no read-modify-write is needed
+inline void bump(std::atomic<uint64_t>& counter, uint64_t amount)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+// Bucket 0 for up to 16 bytes, then one per power of two
+size_t size_bucket(uint64_t size)
+{
+    size_t bucket = 0;
+    for (uint64_t limit = 16; size > limit && bucket < AESGCMSIV_PROFILE_SIZE_BUCKETS - 1; limit <<= 1) {
+        bucket++;
+    }
+    return bucket;
+}
+
+// floor(log2(cycles)), 0 for 0
+size_t cycle_bucket(uint64_t cycles)
+{
+    size_t bucket = 0;
+    while (cycles >>= 1) {
+        bucket++;
+    }
+    return std::min<size_t>(bucket, AESGCMSIV_PROFILE_CYCLE_BUCKETS - 1);
+}
+
+std::atomic<aesgcmsiv_slow_op_fn> g_slow_op_fn(nullptr);
+std::atomic<uint64_t> g_slow_op_threshold(0);
+std::atomic<uint64_t> g_slow_op_next(0);  // earliest aesgcmsiv_stats_now time for the next report
+std::atomic<uint64_t> g_slow_op_suppressed(0);
+
+// Threads take usage stripes in turn as they first add to one
+std::atomic<unsigned int> g_next_usage_stripe(0);
+thread_local unsigned int t_usage_stripe = AESGCMSIV_USAGE_STRIPES;
+
+unsigned int usage_stripe()
+{
+    if (t_usage_stripe == AESGCMSIV_USAGE_STRIPES) {
+        t_usage_stripe = g_next_usage_stripe.fetch_add(1, std::memory_order_relaxed) % AESGCMSIV_USAGE_STRIPES;
+    }
+    return t_usage_stripe;
+}
+
+uint64_t unix_now_ms()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+} // namespace
+
+void aesgcmsiv_stats_record(
+    uint32_t op, uint64_t calls, uint64_t bytes, int result,
+    uint64_t setup_ns, uint64_t crypto_ns, unsigned int vector_bits)
+{
+    ThreadStats* block = t_slot.get();
+    if (!block || op > AESGCMSIV_OP_DECRYPT) {
+        return;
+    }
+    std::atomic<uint64_t>* values = block->values[op];
+    bump(values[kCalls], calls);
+    bump(values[kBytes], bytes);
+    if (result < 0 && -result <= AESGCMSIV_STATS_ERROR_CODES) {
+        bump(values[kFailures + static_cast<size_t>(-result - 1)], 1);
+    }
+    bump(values[kSetup], setup_ns);
+    bump(values[kCrypto], crypto_ns);
+    if (vector_bits) {
+        bump(values[vector_bits >= 512 ? kWide : kNarrow], calls);
+    }
+}
+
+void aesgcmsiv_profile_record(
+    uint32_t op, uint64_t messages, uint64_t bytes, const uint64_t* cycles, uint64_t total)
+{
+    ThreadStats* block = t_slot.get();
+    if (!block || op > AESGCMSIV_OP_DECRYPT || messages == 0) {
+        return;
+    }
+    ProfileStats* profile = block->profile.load(std::memory_order_relaxed);
+    if (!profile) {
+        profile = new (std::nothrow) ProfileStats();
+        if (!profile) {
+            return;
+        }
+        block->profile.store(profile, std::memory_order_release);
+    }
+    std::atomic<uint64_t>* values = profile->values +
+        (op * AESGCMSIV_PROFILE_SIZE_BUCKETS + size_bucket(bytes / messages)) * kBucketFields;
+    bump(values[kMessages], messages);
+    bump(values[kProfileBytes], bytes);
+    for (size_t phase = 0; phase < AESGCMSIV_PROFILE_PHASES; phase++) {
+        bump(values[kCycles + phase], cycles[phase]);
+    }
+    bump(values[kHistogram + cycle_bucket(total / messages)], messages);
+}
+
+void aesgcmsiv_usage_record(aesgcmsiv_usage_counters* counters, uint64_t calls, uint64_t bytes,
+    uint64_t failures)
+{
+    aesgcmsiv_usage_stripe& stripe = counters->stripes[usage_stripe()];
+    stripe.ops.fetch_add(calls, std::memory_order_relaxed);
+    if (bytes) {
+        stripe.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+    if (failures) {
+        stripe.failures.fetch_add(failures, std::memory_order_relaxed);
+    }
+    // Threads on one stripe may store out of order, which at worst leaves
+    // the time a millisecond behind
+    const uint64_t now = unix_now_ms();
+    if (stripe.last_used_ms.load(std::memory_order_relaxed) != now) {
+        stripe.last_used_ms.store(now, std::memory_order_relaxed);
+    }
+}
+
+void aesgcmsiv_usage_read(const aesgcmsiv_usage_counters* counters, aesgcmsiv_key_usage* usage_out)
+{
+    usage_out->ops = 0;
+    usage_out->bytes = 0;
+    usage_out->failures = 0;
+    usage_out->last_used_ms = 0;
+    if (!counters) {
+        return;
+    }
+    for (const aesgcmsiv_usage_stripe& stripe : counters->stripes) {
+        usage_out->ops += stripe.ops.load(std::memory_order_relaxed);
+        usage_out->bytes += stripe.bytes.load(std::memory_order_relaxed);
+        usage_out->failures += stripe.failures.load(std::memory_order_relaxed);
+        usage_out->last_used_ms = std::max(usage_out->last_used_ms,
+            stripe.last_used_ms.load(std::memory_order_relaxed));
+    }
+}
+
+void aesgcmsiv_slow_op_check(
+    uint32_t op, int status, uint64_t count, uint64_t bytes, const char* backend,
+    uint64_t setup_ns, uint64_t crypto_ns, uint64_t end)
+{
+    if (setup_ns + crypto_ns < g_slow_op_threshold.load(std::memory_order_relaxed)) {
+        return;
+    }
+    aesgcmsiv_slow_op_fn fn = g_slow_op_fn.load(std::memory_order_acquire);
+    if (!fn) {
+        return;
+    }
+    // Whoever moves the window on reports; everyone else in it is counted
+    uint64_t next = g_slow_op_next.load(std::memory_order_relaxed);
+    if (end < next || !g_slow_op_next.compare_exchange_strong(
+            next, end + AESGCMSIV_SLOW_OP_INTERVAL_NS, std::memory_order_relaxed)) {
+        g_slow_op_suppressed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    if (!backend) {
+        uint32_t features;
+        aesgcmsiv_get_backend(&backend, &features);
+    }
+    aesgcmsiv_slow_op report;
+    report.op = op;
+    report.status = status;
+    report.count = count;
+    report.bytes = bytes;
+    report.backend = backend;
+    report.setup_ns = setup_ns;
+    report.crypto_ns = crypto_ns;
+    report.suppressed = g_slow_op_suppressed.exchange(0, std::memory_order_relaxed);
+    fn(&report);
+}
+
+extern "C" {
+
+void aesgcmsiv_stats_enable(int enabled)
+{
+    if (enabled) {
+        aesgcmsiv_timing.fetch_or(AESGCMSIV_TIMING_STATS, std::memory_order_relaxed);
+    } else {
+        aesgcmsiv_timing.fetch_and(~AESGCMSIV_TIMING_STATS, std::memory_order_relaxed);
+    }
+}
+
+int aesgcmsiv_get_stats(aesgcmsiv_stats* stats_out)
+{
+    if (!stats_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    Registry& reg = registry();
+    Totals totals;
+    {
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        totals = current_totals(reg);
+        for (size_t op = 0; op < 2; op++) {
+            for (size_t i = 0; i < kFields; i++) {
+                totals.values[op][i] -= reg.baseline.values[op][i];
+            }
+        }
+    }
+    memcpy(&stats_out->encrypt, totals.values[AESGCMSIV_OP_ENCRYPT], sizeof(stats_out->encrypt));
+    memcpy(&stats_out->decrypt, totals.values[AESGCMSIV_OP_DECRYPT], sizeof(stats_out->decrypt));
+    return AESGCMSIV_SUCCESS;
+}
+
+void aesgcmsiv_reset_stats(void)
+{
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.baseline = current_totals(reg);
+    current_profile(reg, &reg.baseline_profile);
+}
+
+void aesgcmsiv_profile_enable(int enabled)
+{
+    if (enabled) {
+        aesgcmsiv_timing.fetch_or(AESGCMSIV_TIMING_PROFILE, std::memory_order_relaxed);
+    } else {
+        aesgcmsiv_timing.fetch_and(~AESGCMSIV_TIMING_PROFILE, std::memory_order_relaxed);
+    }
+}
+
+int aesgcmsiv_get_profile(aesgcmsiv_profile* profile_out)
+{
+    if (!profile_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    Registry& reg = registry();
+    // Too large for the stack of a small thread
+    std::unique_ptr<ProfileTotals> totals(new (std::nothrow) ProfileTotals());
+    if (!totals) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    {
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        current_profile(reg, totals.get());
+        for (size_t i = 0; i < kProfileFields; i++) {
+            totals->values[i] -= reg.baseline_profile.values[i];
+        }
+    }
+    memcpy(profile_out, totals->values, sizeof(*profile_out));
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_set_slow_op_callback(uint64_t threshold_ns, aesgcmsiv_slow_op_fn fn)
+{
+    g_slow_op_threshold.store(threshold_ns, std::memory_order_relaxed);
+    g_slow_op_fn.store(fn, std::memory_order_release);
+    if (fn) {
+        aesgcmsiv_timing.fetch_or(AESGCMSIV_TIMING_SLOW_OPS, std::memory_order_relaxed);
+    } else {
+        aesgcmsiv_timing.fetch_and(~AESGCMSIV_TIMING_SLOW_OPS, std::memory_order_relaxed);
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+} // extern "C"
@@ -0,0 +1,399 @@
+#ifndef AESGCMSIV_STATS_H
+#define AESGCMSIV_STATS_H
+
+// Internal interface to the counters behind aesgcmsiv_get_stats, the phase
+// profile behind aesgcmsiv_get_profile, the slow-operation callback and the
+// call recording behind aesgcmsiv_record_start, and the per-context usage
+// counters behind aesgcmsiv_ctx_get_usage.
+// Nothing in this header is exported from the library.
+
+#include "aesgcmsiv.h"
+#include "aesgcmsiv_trace.h"
+#include <atomic>
+#include <chrono>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#elif defined(_MSC_VER) && defined(_M_ARM64)
+#include <intrin.h>
+#endif
+
+// Bits of aesgcmsiv_timing: what wants calls timed
+#define AESGCMSIV_TIMING_STATS (1u << 0)
+#define AESGCMSIV_TIMING_SLOW_OPS (1u << 1)
+#define AESGCMSIV_TIMING_PROFILE (1u << 2)
+#define AESGCMSIV_TIMING_RECORD (1u << 3)
+
+extern std::atomic<unsigned int> aesgcmsiv_timing;
+
+inline unsigned int aesgcmsiv_timing_flags()
+{
+    return aesgcmsiv_timing.load(std::memory_order_relaxed);
+}
+
+inline uint64_t aesgcmsiv_stats_now()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// The counter the phase profile reads; see aesgcmsiv_profile_bucket
+inline uint64_t aesgcmsiv_cycles()
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86)) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(_MSC_VER) && defined(_M_ARM64)
+    return static_cast<uint64_t>(_ReadStatusReg(ARM64_CNTVCT));
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    return aesgcmsiv_stats_now();
+#endif
+}
+
+// Cycles the calling thread's profiled call has spent in each
+// AESGCMSIV_PHASE_*, filled in by PhaseScope while active is set
+struct aesgcmsiv_phase_clock {
+    bool active;
+    uint64_t cycles[AESGCMSIV_PROFILE_PHASES];
+};
+
+extern thread_local aesgcmsiv_phase_clock aesgcmsiv_phases;
+
+// Times a phase of a kernel call into the profile of the call around it.
+// Costs one relaxed load unless profiling is enabled, and then does nothing
+// unless a public call on this thread is being profiled.
+class PhaseScope {
+public:
+    explicit PhaseScope(unsigned int phase)
+        : phase_(phase), start_(0)
+    {
+        if ((aesgcmsiv_timing_flags() & AESGCMSIV_TIMING_PROFILE) && aesgcmsiv_phases.active) {
+            start_ = aesgcmsiv_cycles();
+        }
+    }
+
+    ~PhaseScope()
+    {
+        if (start_) {
+            aesgcmsiv_phases.cycles[phase_] += aesgcmsiv_cycles() - start_;
+        }
+    }
+
+    PhaseScope(const PhaseScope&) = delete;
+    PhaseScope& operator=(const PhaseScope&) = delete;
+
+private:
+    unsigned int phase_;
+    uint64_t start_;
+};
+
+// Adds messages of bytes in total to the calling thread's profile for op,
+// in the bucket of their mean size. cycles holds the cycles of every phase
+// summed over them, and total their cycles from entry to return.
+void aesgcmsiv_profile_record(
+    uint32_t op, uint64_t messages, uint64_t bytes, const uint64_t* cycles, uint64_t total);
+
+// Adds to the calling thread's counters for op (AESGCMSIV_OP_*). result is
+// counted as one failure if it is an error code. The calls count as wide or
+// narrow by vector_bits, the widest vectors the kernel used on them, and as
+// neither if it is 0.
+void aesgcmsiv_stats_record(
+    uint32_t op, uint64_t calls, uint64_t bytes, int result,
+    uint64_t setup_ns, uint64_t crypto_ns, unsigned int vector_bits);
+
+// Reports the operation to the slow-operation callback if it took at least
+// the threshold and the rate limit allows. end is the aesgcmsiv_stats_now
+// time the call finished; backend may be NULL if the call failed before
+// choosing one.
+void aesgcmsiv_slow_op_check(
+    uint32_t op, int status, uint64_t count, uint64_t bytes, const char* backend,
+    uint64_t setup_ns, uint64_t crypto_ns, uint64_t end);
+
+// Adds a call to the running recording, if there is one. start and end are
+// the aesgcmsiv_stats_now times of its entry and return; key_context is the
+// context it used, or NULL.
+void aesgcmsiv_record_call(
+    uint32_t op, int status, uint64_t count, uint64_t size, uint64_t aad_size,
+    const void* key_context, uint64_t start, uint64_t end);
+
+// Stripes of a context's usage counters; a thread always adds to the same
+// one, so threads sharing a key mostly write to different cache lines
+#define AESGCMSIV_USAGE_STRIPES 8
+
+struct alignas(64) aesgcmsiv_usage_stripe {
+    std::atomic<uint64_t> ops;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> failures;
+    std::atomic<uint64_t> last_used_ms;
+};
+
+// The counters behind aesgcmsiv_ctx_get_usage; the usage is the sum of the
+// stripes, and the latest of their times
+struct aesgcmsiv_usage_counters {
+    aesgcmsiv_usage_stripe stripes[AESGCMSIV_USAGE_STRIPES];
+};
+
+// Contexts with usage tracking on, so calls skip looking for counters while
+// there are none
+extern std::atomic<unsigned int> aesgcmsiv_usage_contexts;
+
+// The counters of ctx, or NULL while its usage tracking is off
+extern "C" aesgcmsiv_usage_counters* aesgcmsiv_ctx_usage_counters(const aesgcmsiv_ctx* ctx);
+
+// Adds calls messages, of which failures failed and the rest came to bytes,
+// to the calling thread's stripe of counters, and stamps it with the time
+void aesgcmsiv_usage_record(aesgcmsiv_usage_counters* counters, uint64_t calls, uint64_t bytes,
+    uint64_t failures);
+
+// Sums the stripes of counters into usage_out, leaving its key_id alone;
+// NULL counters read as all 0
+void aesgcmsiv_usage_read(const aesgcmsiv_usage_counters* counters, aesgcmsiv_key_usage* usage_out);
+
+// Times one public call and records it when it finishes, and fires its
+// entry and return tracepoints. Does nothing past one relaxed load unless
+// statistics are enabled or a slow-operation callback is set, and one more
+// for a call on a context unless some context tracks usage. Everything
+// before setup_done is setup; everything after it is crypto. Only the first
+// setup_done counts, so helpers shared by several entry points can mark it
+// without knowing whether their caller already did. While profiling, the
+// outermost scope on a thread also collects the phases its call ran.
+class StatsScope {
+public:
+    // A batch of count messages, which finishes with finish_batch or
+    // finish_items
+    struct Batch {
+        size_t count;
+    };
+
+    // One message of size bytes, which finishes with finish. size is 0 if not
+    // yet known.
+    StatsScope(uint32_t op, uint64_t size, uint64_t aad_size)
+        : op_(op), timing_(aesgcmsiv_timing_flags()),
+          start_(timing_ ? aesgcmsiv_stats_now() : 0), setup_end_(0), backend_(nullptr),
+          vector_bits_(0), batch_count_(0), size_(size), aad_size_(aad_size), key_context_(nullptr),
+          usage_(nullptr)
+    {
+        aesgcmsiv_trace_entry(op, size, aad_size);
+        begin_profile();
+    }
+
+    // A message on a path that must not block, allocate or lock, such as the
+    // _small calls: only the tracepoints see it, since the counters may
+    // allocate the thread's slot and a slow-operation report runs the
+    // caller's callback
+    struct Bounded {};
+
+    StatsScope(uint32_t op, uint64_t size, uint64_t aad_size, Bounded)
+        : op_(op), timing_(0), start_(0), setup_end_(0), backend_(nullptr), vector_bits_(0),
+          batch_count_(0), size_(size), aad_size_(aad_size), key_context_(nullptr), usage_(nullptr),
+          profiling_(false), cycles_start_(0), cycles_setup_end_(0)
+    {
+        aesgcmsiv_trace_entry(op, size, aad_size);
+    }
+
+    StatsScope(uint32_t op, Batch batch)
+        : op_(op), timing_(aesgcmsiv_timing_flags()),
+          start_(timing_ ? aesgcmsiv_stats_now() : 0), setup_end_(0), backend_(nullptr),
+          vector_bits_(0), batch_count_(batch.count), size_(0), aad_size_(0), key_context_(nullptr),
+          usage_(nullptr)
+    {
+        AESGCMSIV_TRACE2(batch__entry, op, batch.count);
+        begin_profile();
+    }
+
+    ~StatsScope()
+    {
+        if (profiling_) {
+            aesgcmsiv_phases.active = false;
+        }
+    }
+
+    StatsScope(const StatsScope&) = delete;
+    StatsScope& operator=(const StatsScope&) = delete;
+
+    // backend names what runs the rest of the call, as aesgcmsiv_get_backend
+    // would; vector_bits is the widest vectors it uses on the call's messages,
+    // or 0 for the crypto library
+    void setup_done(const char* backend, unsigned int vector_bits = 0)
+    {
+        if (timing_ && !setup_end_) {
+            setup_end_ = aesgcmsiv_stats_now();
+            backend_ = backend;
+            vector_bits_ = vector_bits;
+        }
+        if (profiling_ && !cycles_setup_end_) {
+            cycles_setup_end_ = aesgcmsiv_cycles();
+        }
+    }
+
+    // The context whose key the call uses, for the recording to tell keys
+    // apart and for the context's usage counters; calls given a raw key
+    // leave it unset. Like setup_done, only the first counts.
+    void set_key_context(const aesgcmsiv_ctx* context)
+    {
+        if (!key_context_) {
+            key_context_ = context;
+            if (aesgcmsiv_usage_contexts.load(std::memory_order_relaxed)) {
+                usage_ = aesgcmsiv_ctx_usage_counters(context);
+            }
+        }
+    }
+
+    // The mean AAD size of a batch's messages, for the recording; does
+    // nothing unless recording
+    void record_aad(const aesgcmsiv_batch_item* items, size_t count)
+    {
+        if ((timing_ & AESGCMSIV_TIMING_RECORD) && count) {
+            uint64_t aad_bytes = 0;
+            for (size_t i = 0; i < count; i++) {
+                aad_bytes += items[i].aad_len;
+            }
+            aad_size_ = aad_bytes / count;
+        }
+    }
+
+    // The AAD size of every message of a batch under one AAD
+    void set_aad_size(uint64_t aad_size)
+    {
+        aad_size_ = aad_size;
+    }
+
+    // One message of bytes, counted only if it succeeded. Returns result.
+    int finish(int result, uint64_t bytes)
+    {
+        aesgcmsiv_trace_return(op_, bytes, result);
+        record(result, result, 1, result == AESGCMSIV_SUCCESS ? bytes : 0,
+            result == AESGCMSIV_SUCCESS ? 1 : 0);
+        return result;
+    }
+
+    // calls messages of bytes in total, with result counted once. Returns
+    // result.
+    int finish_batch(int result, uint64_t calls, uint64_t bytes)
+    {
+        AESGCMSIV_TRACE3(batch__return, op_, batch_count_, result);
+        record(result, result, calls, bytes, result == AESGCMSIV_SUCCESS ? calls : 0);
+        return result;
+    }
+
+    // Messages with one result each; bytes are those of the ones that succeeded
+    void finish_items(const aesgcmsiv_batch_item* items, size_t count, const int* status)
+    {
+        if (!aad_size_) {
+            record_aad(items, count);
+        }
+        finish_each(count, status, [items](size_t i) { return items[i].input_len; });
+    }
+
+    // finish_items for messages described without an item array, where
+    // length(i) is the size of message i
+    template <typename Length>
+    void finish_each(size_t count, const int* status, Length length)
+    {
+        AESGCMSIV_TRACE3(batch__return, op_, batch_count_, AESGCMSIV_SUCCESS);
+        if (!timing_ && !usage_) {
+            return;
+        }
+        uint64_t bytes = 0;
+        uint64_t succeeded = 0;
+        int first_error = AESGCMSIV_SUCCESS;
+        for (size_t i = 0; i < count; i++) {
+            if (status[i] == AESGCMSIV_SUCCESS) {
+                bytes += length(i);
+                succeeded++;
+                continue;
+            }
+            if (first_error == AESGCMSIV_SUCCESS) {
+                first_error = status[i];
+            }
+            if (timing_ & AESGCMSIV_TIMING_STATS) {
+                aesgcmsiv_stats_record(op_, 0, 0, status[i], 0, 0, 0);
+            }
+        }
+        record(AESGCMSIV_SUCCESS, first_error, count, bytes, succeeded);
+    }
+
+private:
+    // Takes the thread's phase clock unless an outer scope has it
+    void begin_profile()
+    {
+        profiling_ = (timing_ & AESGCMSIV_TIMING_PROFILE) && !aesgcmsiv_phases.active;
+        cycles_start_ = 0;
+        cycles_setup_end_ = 0;
+        if (profiling_) {
+            aesgcmsiv_phase_clock& clock = aesgcmsiv_phases;
+            clock.active = true;
+            for (uint64_t& cycles : clock.cycles) {
+                cycles = 0;
+            }
+            cycles_start_ = aesgcmsiv_cycles();
+        }
+    }
+
+    // Setup is up to setup_done, and what the kernels did not mark as a
+    // phase after it is other
+    void finish_profile(uint64_t messages, uint64_t bytes)
+    {
+        uint64_t end = aesgcmsiv_cycles();
+        uint64_t setup_end = cycles_setup_end_ ? cycles_setup_end_ : end;
+        aesgcmsiv_phase_clock& clock = aesgcmsiv_phases;
+        uint64_t marked = 0;
+        for (unsigned int phase = AESGCMSIV_PHASE_DERIVE; phase < AESGCMSIV_PHASE_OTHER; phase++) {
+            marked += clock.cycles[phase];
+        }
+        clock.cycles[AESGCMSIV_PHASE_SETUP] = setup_end - cycles_start_;
+        clock.cycles[AESGCMSIV_PHASE_OTHER] = end - setup_end > marked ? end - setup_end - marked : 0;
+        aesgcmsiv_profile_record(op_, messages, bytes, clock.cycles, end - cycles_start_);
+    }
+
+    // result is counted as a failure; status is what a slow-operation report
+    // shows; succeeded is the number of messages the profile counts
+    void record(int result, int status, uint64_t calls, uint64_t bytes, uint64_t succeeded)
+    {
+        if (usage_) {
+            aesgcmsiv_usage_record(usage_, calls, bytes, calls - succeeded);
+        }
+        if (!timing_) {
+            return;
+        }
+        if (profiling_ && succeeded) {
+            finish_profile(succeeded, bytes);
+        }
+        uint64_t end = aesgcmsiv_stats_now();
+        uint64_t setup_end = setup_end_ ? setup_end_ : end;
+        if (timing_ & AESGCMSIV_TIMING_STATS) {
+            aesgcmsiv_stats_record(op_, calls, bytes, result, setup_end - start_, end - setup_end,
+                vector_bits_);
+        }
+        if (timing_ & AESGCMSIV_TIMING_SLOW_OPS) {
+            aesgcmsiv_slow_op_check(op_, status, calls, bytes, backend_,
+                setup_end - start_, end - setup_end, end);
+        }
+        if (timing_ & AESGCMSIV_TIMING_RECORD) {
+            aesgcmsiv_record_call(op_, status, calls, succeeded ? bytes / succeeded : size_,
+                aad_size_, key_context_, start_, end);
+        }
+    }
+
+    uint32_t op_;
+    unsigned int timing_;  // AESGCMSIV_TIMING_* bits when the call started
+    uint64_t start_;
+    uint64_t setup_end_;
+    const char* backend_;
+    unsigned int vector_bits_;
+    size_t batch_count_;
+    uint64_t size_;  // of the one message, as given on entry
+    uint64_t aad_size_;
+    const void* key_context_;
+    aesgcmsiv_usage_counters* usage_;  // of key_context_, if it tracks usage
+    bool profiling_;  // this scope holds the thread's phase clock
+    uint64_t cycles_start_;
+    uint64_t cycles_setup_end_;
+};
+
+#endif // AESGCMSIV_STATS_H
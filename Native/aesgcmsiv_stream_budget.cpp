@@ -0,0 +1,217 @@
+#include "aesgcmsiv.h"
+#include "aesgcmsiv_kernels.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// The pool chunk windows come from. Every window held by a writer, and
+// every released one kept for reuse, is counted against one process-wide
+// budget under one lock; windows are taken a few times per stream, so the
+// lock is never hot. A released window is wiped and kept if its size is
+// likely to be asked for again, and idle windows are freed, oldest first,
+// whenever a writer needs their room.
+
+namespace {
+
+// Released windows kept for reuse, whatever the budget
+constexpr size_t kMaxCached = 16;
+
+// Idle memory kept with no budget set
+constexpr uint64_t kUnboundedCacheBytes = uint64_t(64) << 20;
+
+struct idle_window {
+    uint8_t* memory;
+    size_t bytes;
+};
+
+struct window_pool {
+    std::mutex mutex;
+    std::condition_variable room;  // signalled when bytes_in_use falls or the budget grows
+    uint64_t max_bytes = 0;
+    uint64_t bytes_in_use = 0;
+    uint64_t bytes_cached = 0;
+    uint64_t windows = 0;
+    uint64_t shrunk = 0;
+    uint64_t waits = 0;
+    std::unordered_map<uint8_t*, size_t> held;
+    std::vector<idle_window> idle;  // oldest first
+};
+
+window_pool& pool()
+{
+    // Never destroyed, so a window released during static destruction is safe
+    static window_pool* instance = new window_pool();
+    return *instance;
+}
+
+// Room left for windows held by writers, counting idle windows as free
+uint64_t room(const window_pool& p)
+{
+    if (p.max_bytes == 0) {
+        return UINT64_MAX;
+    }
+    return p.bytes_in_use < p.max_bytes ? p.max_bytes - p.bytes_in_use : 0;
+}
+
+// Takes idle windows off the list, oldest first, until held and idle
+// windows fit the budget again; the caller frees them outside the lock
+void trim_idle(window_pool& p, std::vector<uint8_t*>& to_free)
+{
+    size_t dropped = 0;
+    while (dropped < p.idle.size() && p.max_bytes != 0 && p.bytes_in_use + p.bytes_cached > p.max_bytes) {
+        p.bytes_cached -= p.idle[dropped].bytes;
+        to_free.push_back(p.idle[dropped].memory);
+        dropped++;
+    }
+    p.idle.erase(p.idle.begin(), p.idle.begin() + static_cast<ptrdiff_t>(dropped));
+}
+
+void free_all(const std::vector<uint8_t*>& to_free)
+{
+    for (uint8_t* memory : to_free) {
+        aesgcmsiv_free(memory);
+    }
+}
+
+}  // namespace
+
+int aesgcmsiv_stream_budget_set(uint64_t max_bytes)
+{
+    window_pool& p = pool();
+    std::vector<uint8_t*> to_free;
+    {
+        std::lock_guard<std::mutex> lock(p.mutex);
+        p.max_bytes = max_bytes;
+        trim_idle(p, to_free);
+    }
+    p.room.notify_all();
+    free_all(to_free);
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_stream_window_acquire(
+    size_t chunk_bytes, uint32_t wanted, uint32_t min_chunks, int wait,
+    uint8_t** window_out, uint32_t* chunks_out)
+{
+    if (window_out == nullptr || chunks_out == nullptr || chunk_bytes == 0 ||
+        wanted == 0 || min_chunks == 0 || min_chunks > wanted ||
+        chunk_bytes > SIZE_MAX / wanted) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *window_out = nullptr;
+    *chunks_out = 0;
+
+    window_pool& p = pool();
+    std::vector<uint8_t*> to_free;
+    uint8_t* memory = nullptr;
+    size_t bytes;
+    {
+        std::unique_lock<std::mutex> lock(p.mutex);
+        if (p.max_bytes != 0 && uint64_t(chunk_bytes) * min_chunks > p.max_bytes) {
+            return AESGCMSIV_ERROR_INVALID_INPUT;
+        }
+        bool waited = false;
+        while (room(p) / chunk_bytes < min_chunks) {
+            if (!wait) {
+                return AESGCMSIV_ERROR_BUSY;
+            }
+            if (!waited) {
+                p.waits++;
+                waited = true;
+            }
+            p.room.wait(lock);
+            if (p.max_bytes != 0 && uint64_t(chunk_bytes) * min_chunks > p.max_bytes) {
+                return AESGCMSIV_ERROR_INVALID_INPUT;
+            }
+        }
+
+        uint32_t chunks = static_cast<uint32_t>(std::min<uint64_t>(wanted, room(p) / chunk_bytes));
+        bytes = chunk_bytes * chunks;
+        p.bytes_in_use += bytes;
+        p.windows++;
+        if (chunks < wanted) {
+            p.shrunk++;
+        }
+        *chunks_out = chunks;
+
+        auto reuse = std::find_if(p.idle.begin(), p.idle.end(),
+            [bytes](const idle_window& w) { return w.bytes == bytes; });
+        if (reuse != p.idle.end()) {
+            memory = reuse->memory;
+            p.bytes_cached -= bytes;
+            p.idle.erase(reuse);
+            p.held.emplace(memory, bytes);
+        }
+        trim_idle(p, to_free);
+    }
+    free_all(to_free);
+
+    if (memory == nullptr) {
+        memory = static_cast<uint8_t*>(aesgcmsiv_alloc(bytes, 0));
+        std::lock_guard<std::mutex> lock(p.mutex);
+        if (memory == nullptr) {
+            p.bytes_in_use -= bytes;
+            p.room.notify_all();
+            *chunks_out = 0;
+            return AESGCMSIV_ERROR_INTERNAL;
+        }
+        p.held.emplace(memory, bytes);
+    }
+    *window_out = memory;
+    return AESGCMSIV_SUCCESS;
+}
+
+void aesgcmsiv_stream_window_release(uint8_t* window)
+{
+    if (window == nullptr) {
+        return;
+    }
+    window_pool& p = pool();
+    size_t bytes;
+    {
+        std::lock_guard<std::mutex> lock(p.mutex);
+        auto it = p.held.find(window);
+        if (it == p.held.end()) {
+            return;
+        }
+        bytes = it->second;
+    }
+    // Wiped outside the lock; the window still counts as held until it is back
+    aesgcmsiv_secure_zero(window, bytes);
+
+    bool keep;
+    {
+        std::lock_guard<std::mutex> lock(p.mutex);
+        p.held.erase(window);
+        p.bytes_in_use -= bytes;
+        uint64_t cache_limit = p.max_bytes != 0 ? p.max_bytes : kUnboundedCacheBytes;
+        keep = p.idle.size() < kMaxCached && p.bytes_in_use + p.bytes_cached + bytes <= cache_limit;
+        if (keep) {
+            p.idle.push_back({window, bytes});
+            p.bytes_cached += bytes;
+        }
+    }
+    p.room.notify_all();
+    if (!keep) {
+        aesgcmsiv_free(window);
+    }
+}
+
+int aesgcmsiv_stream_budget_get_stats(aesgcmsiv_stream_budget_stats* stats_out)
+{
+    if (stats_out == nullptr) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    window_pool& p = pool();
+    std::lock_guard<std::mutex> lock(p.mutex);
+    stats_out->max_bytes = p.max_bytes;
+    stats_out->bytes_in_use = p.bytes_in_use;
+    stats_out->bytes_cached = p.bytes_cached;
+    stats_out->windows = p.windows;
+    stats_out->shrunk = p.shrunk;
+    stats_out->waits = p.waits;
+    return AESGCMSIV_SUCCESS;
+}
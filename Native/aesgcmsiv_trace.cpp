@@ -0,0 +1,99 @@
+#include "aesgcmsiv_trace.h"
+
+// The ETW provider behind the tracepoints on Windows. USDT probes need no
+// runtime support, so elsewhere this file is empty.
+
+#if defined(AESGCMSIV_TRACE_ETW)
+
+#include <windows.h>
+#include <evntrace.h>
+#include <TraceLoggingProvider.h>
+
+// {5d1f6a43-9c2e-5b7a-8e41-3f0c2d9a6b17}
+TRACELOGGING_DEFINE_PROVIDER(
+    aesgcmsiv_trace_provider,
+    "AesGcmSiv",
+    (0x5d1f6a43, 0x9c2e, 0x5b7a, 0x8e, 0x41, 0x3f, 0x0c, 0x2d, 0x9a, 0x6b, 0x17));
+
+std::atomic<bool> aesgcmsiv_trace_armed(false);
+
+namespace {
+
+// Tracks whether any session has the provider enabled, so that callers
+// test one flag instead of calling into the provider for each event
+void NTAPI on_enable(
+    LPCGUID, ULONG control_code, UCHAR, ULONGLONG, ULONGLONG, PEVENT_FILTER_DESCRIPTOR, PVOID)
+{
+    if (control_code == EVENT_CONTROL_CODE_ENABLE_PROVIDER) {
+        aesgcmsiv_trace_armed.store(true, std::memory_order_relaxed);
+    } else if (control_code == EVENT_CONTROL_CODE_DISABLE_PROVIDER) {
+        aesgcmsiv_trace_armed.store(
+            TraceLoggingProviderEnabled(aesgcmsiv_trace_provider, 0, 0) != FALSE,
+            std::memory_order_relaxed);
+    }
+}
+
+// Registered for as long as the DLL is loaded
+struct ProviderRegistration {
+    ProviderRegistration()
+    {
+        TraceLoggingRegisterEx(aesgcmsiv_trace_provider, on_enable, nullptr);
+    }
+    ~ProviderRegistration()
+    {
+        aesgcmsiv_trace_armed.store(false, std::memory_order_relaxed);
+        TraceLoggingUnregister(aesgcmsiv_trace_provider);
+    }
+};
+
+ProviderRegistration registration;
+
+} // namespace
+
+void aesgcmsiv_trace_write(aesgcmsiv_trace_event event, uint64_t a, int64_t b, int64_t c)
+{
+    switch (event) {
+    case AESGCMSIV_TRACE_ENCRYPT_ENTRY:
+        TraceLoggingWrite(aesgcmsiv_trace_provider, "EncryptStart",
+            TraceLoggingOpcode(WINEVENT_OPCODE_START),
+            TraceLoggingUInt64(a, "Size"), TraceLoggingInt64(b, "AadSize"));
+        break;
+    case AESGCMSIV_TRACE_ENCRYPT_RETURN:
+        TraceLoggingWrite(aesgcmsiv_trace_provider, "EncryptStop",
+            TraceLoggingOpcode(WINEVENT_OPCODE_STOP),
+            TraceLoggingUInt64(a, "Size"), TraceLoggingInt32(static_cast<int32_t>(b), "Status"));
+        break;
+    case AESGCMSIV_TRACE_DECRYPT_ENTRY:
+        TraceLoggingWrite(aesgcmsiv_trace_provider, "DecryptStart",
+            TraceLoggingOpcode(WINEVENT_OPCODE_START),
+            TraceLoggingUInt64(a, "Size"), TraceLoggingInt64(b, "AadSize"));
+        break;
+    case AESGCMSIV_TRACE_DECRYPT_RETURN:
+        TraceLoggingWrite(aesgcmsiv_trace_provider, "DecryptStop",
+            TraceLoggingOpcode(WINEVENT_OPCODE_STOP),
+            TraceLoggingUInt64(a, "Size"), TraceLoggingInt32(static_cast<int32_t>(b), "Status"));
+        break;
+    case AESGCMSIV_TRACE_BATCH_ENTRY:
+        TraceLoggingWrite(aesgcmsiv_trace_provider, "BatchStart",
+            TraceLoggingOpcode(WINEVENT_OPCODE_START),
+            TraceLoggingUInt32(static_cast<uint32_t>(a), "Operation"), TraceLoggingInt64(b, "Count"));
+        break;
+    case AESGCMSIV_TRACE_BATCH_RETURN:
+        TraceLoggingWrite(aesgcmsiv_trace_provider, "BatchStop",
+            TraceLoggingOpcode(WINEVENT_OPCODE_STOP),
+            TraceLoggingUInt32(static_cast<uint32_t>(a), "Operation"), TraceLoggingInt64(b, "Count"),
+            TraceLoggingInt32(static_cast<int32_t>(c), "Status"));
+        break;
+    case AESGCMSIV_TRACE_BATCH_DISPATCH:
+        TraceLoggingWrite(aesgcmsiv_trace_provider, "BatchDispatch",
+            TraceLoggingUInt32(static_cast<uint32_t>(a), "Operation"), TraceLoggingInt64(b, "Count"),
+            TraceLoggingInt64(c, "Chunks"));
+        break;
+    case AESGCMSIV_TRACE_CTX_NEW:
+        TraceLoggingWrite(aesgcmsiv_trace_provider, "ContextCreated",
+            TraceLoggingUInt64(a, "KeySize"), TraceLoggingInt32(static_cast<int32_t>(b), "Status"));
+        break;
+    }
+}
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef AESGCMSIV_TRACE_H
+#define AESGCMSIV_TRACE_H
+
+// Static tracepoints under the provider name "aesgcmsiv":
+//
+//   encrypt__entry(size, aad_size)      decrypt__entry(size, aad_size)
+//   encrypt__return(size, status)       decrypt__return(size, status)
+//   batch__entry(op, count)             batch__return(op, count, status)
+//   batch__dispatch(op, count, chunks)  ctx__new(key_size, status)
+//
+// op is AESGCMSIV_OP_*. A vectored call reports size 0 on entry, since its
+// total is only known once the segments are checked, and a call rejected
+// before doing any work reports size 0 on return. batch__dispatch fires
+// where a batch, or a group of engine requests, is handed to a kernel, with
+// the number of pool chunks it runs as.
+//
+// On Linux these are USDT probes, compiled in when <sys/sdt.h> is available
+// (systemtap-sdt-dev or systemtap-sdt-devel); each is a single nop until a
+// tracer attaches, for example
+//
+//   bpftrace -e 'usdt:./libaesgcmsiv.so:aesgcmsiv:encrypt__return
+//                { @[arg0] = count(); }'
+//
+// On Windows they are TraceLogging events of the provider "AesGcmSiv"
+// ({5d1f6a43-9c2e-5b7a-8e41-3f0c2d9a6b17}), named EncryptStart, EncryptStop
+// and so on with start and stop opcodes, so that PerfView or WPA pairs them
+// into durations. Each costs one relaxed load until a session enables the
+// provider. Build with AESGCMSIV_NO_TRACEPOINTS to leave them out.
+
+#include "aesgcmsiv.h"
+
+#if !defined(AESGCMSIV_NO_TRACEPOINTS) && defined(__linux__) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define AESGCMSIV_TRACE_USDT 1
+#endif
+#elif !defined(AESGCMSIV_NO_TRACEPOINTS) && defined(_WIN32)
+#include <atomic>
+#define AESGCMSIV_TRACE_ETW 1
+#endif
+
+#if defined(AESGCMSIV_TRACE_USDT)
+
+#define AESGCMSIV_TRACE2(name, a, b) DTRACE_PROBE2(aesgcmsiv, name, a, b)
+#define AESGCMSIV_TRACE3(name, a, b, c) DTRACE_PROBE3(aesgcmsiv, name, a, b, c)
+
+#elif defined(AESGCMSIV_TRACE_ETW)
+
+// Set while an ETW session has the provider enabled
+extern std::atomic<bool> aesgcmsiv_trace_armed;
+
+// In aesgcmsiv_trace.cpp, which keeps <windows.h> out of the callers
+enum aesgcmsiv_trace_event {
+    AESGCMSIV_TRACE_ENCRYPT_ENTRY,
+    AESGCMSIV_TRACE_ENCRYPT_RETURN,
+    AESGCMSIV_TRACE_DECRYPT_ENTRY,
+    AESGCMSIV_TRACE_DECRYPT_RETURN,
+    AESGCMSIV_TRACE_BATCH_ENTRY,
+    AESGCMSIV_TRACE_BATCH_RETURN,
+    AESGCMSIV_TRACE_BATCH_DISPATCH,
+    AESGCMSIV_TRACE_CTX_NEW,
+};
+void aesgcmsiv_trace_write(aesgcmsiv_trace_event event, uint64_t a, int64_t b, int64_t c);
+
+#define AESGCMSIV_TRACE_EVENT_encrypt__entry AESGCMSIV_TRACE_ENCRYPT_ENTRY
+#define AESGCMSIV_TRACE_EVENT_encrypt__return AESGCMSIV_TRACE_ENCRYPT_RETURN
+#define AESGCMSIV_TRACE_EVENT_decrypt__entry AESGCMSIV_TRACE_DECRYPT_ENTRY
+#define AESGCMSIV_TRACE_EVENT_decrypt__return AESGCMSIV_TRACE_DECRYPT_RETURN
+#define AESGCMSIV_TRACE_EVENT_batch__entry AESGCMSIV_TRACE_BATCH_ENTRY
+#define AESGCMSIV_TRACE_EVENT_batch__return AESGCMSIV_TRACE_BATCH_RETURN
+#define AESGCMSIV_TRACE_EVENT_batch__dispatch AESGCMSIV_TRACE_BATCH_DISPATCH
+#define AESGCMSIV_TRACE_EVENT_ctx__new AESGCMSIV_TRACE_CTX_NEW
+
+#define AESGCMSIV_TRACE3(name, a, b, c) \
+    do { \
+        if (aesgcmsiv_trace_armed.load(std::memory_order_relaxed)) { \
+            aesgcmsiv_trace_write(AESGCMSIV_TRACE_EVENT_##name, \
+                static_cast<uint64_t>(a), static_cast<int64_t>(b), static_cast<int64_t>(c)); \
+        } \
+    } while (0)
+#define AESGCMSIV_TRACE2(name, a, b) AESGCMSIV_TRACE3(name, a, b, 0)
+
+#else
+
+#define AESGCMSIV_TRACE2(name, a, b) \
+    do { \
+        (void)(a); \
+        (void)(b); \
+    } while (0)
+#define AESGCMSIV_TRACE3(name, a, b, c) \
+    do { \
+        (void)(a); \
+        (void)(b); \
+        (void)(c); \
+    } while (0)
+
+#endif
+
+// Probe names are fixed at compile time, so the direction picks between them
+inline void aesgcmsiv_trace_entry(uint32_t op, uint64_t size, uint64_t aad_size)
+{
+    if (op == AESGCMSIV_OP_DECRYPT) {
+        AESGCMSIV_TRACE2(decrypt__entry, size, aad_size);
+    } else {
+        AESGCMSIV_TRACE2(encrypt__entry, size, aad_size);
+    }
+}
+
+inline void aesgcmsiv_trace_return(uint32_t op, uint64_t size, int status)
+{
+    if (op == AESGCMSIV_OP_DECRYPT) {
+        AESGCMSIV_TRACE2(decrypt__return, size, status);
+    } else {
+        AESGCMSIV_TRACE2(encrypt__return, size, status);
+    }
+}
+
+#endif // AESGCMSIV_TRACE_H
@@ -0,0 +1,247 @@
+#include "aesgcmsiv_kernels.h"
+#include "aesgcmsiv.h"
+#include <cstring>
+
+// 512-bit VAES / VPCLMULQDQ variants of the bulk loops. Each instruction
+// processes four AES blocks, so CTR runs 16 blocks and POLYVAL folds 16
+// blocks per iteration. Key setup, derivation and short tails reuse the
+// AES-NI primitives.
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#include "aesgcmsiv_x86.h"
+
+#define VAES_POLYVAL_STRIDE 16
+
+VAES_TARGET static inline __m128i xor_lanes(__m512i v)
+{
+    __m256i t = _mm256_xor_si256(_mm512_castsi512_si256(v), _mm512_extracti64x4_epi64(v, 1));
+    return _mm_xor_si128(_mm256_castsi256_si128(t), _mm256_extracti128_si256(t, 1));
+}
+
+VAES_TARGET static inline void clmul_accumulate_x4(
+    __m512i a, __m512i b, __m512i* lo, __m512i* mid, __m512i* hi)
+{
+    *lo = _mm512_xor_si512(*lo, _mm512_clmulepi64_epi128(a, b, 0x00));
+    *hi = _mm512_xor_si512(*hi, _mm512_clmulepi64_epi128(a, b, 0x11));
+    *mid = _mm512_ternarylogic_epi64(*mid,
+        _mm512_clmulepi64_epi128(a, b, 0x01),
+        _mm512_clmulepi64_epi128(a, b, 0x10), 0x96);
+}
+
+static void vaes_polyval_init(polyval_state* pv, const uint8_t* h, size_t blocks)
+{
+    int powers = 1;
+    if (blocks >= VAES_POLYVAL_STRIDE) {
+        powers = VAES_POLYVAL_STRIDE;
+    } else if (blocks >= 8) {
+        powers = 8;  // the AES-NI loop handles 8..15 blocks
+    }
+    aesni_polyval_powers(pv, h, powers);
+}
+
+VAES_TARGET static void vaes_polyval_blocks(polyval_state* pv, const uint8_t* data, size_t blocks)
+{
+    if (blocks >= VAES_POLYVAL_STRIDE) {
+        // Block j of a 16-block group is multiplied by H^(16-j); lane k of
+        // p[i] holds the power for block 4i+k.
+        __m512i p[4];
+        for (int i = 0; i < 4; i++) {
+            __m512i v = _mm512_loadu_si512(pv->h[12 - 4 * i]);
+            p[i] = _mm512_shuffle_i64x2(v, v, 0x1b);
+        }
+
+        __m128i s = load_block(pv->s);
+        while (blocks >= VAES_POLYVAL_STRIDE) {
+            __m512i lo = _mm512_setzero_si512();
+            __m512i mid = _mm512_setzero_si512();
+            __m512i hi = _mm512_setzero_si512();
+            __m512i x = _mm512_xor_si512(_mm512_loadu_si512(data), _mm512_zextsi128_si512(s));
+            clmul_accumulate_x4(x, p[0], &lo, &mid, &hi);
+            for (int i = 1; i < 4; i++) {
+                clmul_accumulate_x4(_mm512_loadu_si512(data + 64 * i), p[i], &lo, &mid, &hi);
+            }
+            s = gf_fold(xor_lanes(lo), xor_lanes(mid), xor_lanes(hi));
+            data += 16 * VAES_POLYVAL_STRIDE;
+            blocks -= VAES_POLYVAL_STRIDE;
+        }
+        store_block(pv->s, s);
+    }
+    aesni_polyval_blocks(pv, data, blocks);
+}
+
+VAES_TARGET static inline __m512i aes_encrypt_x4(const __m512i* rk, int rounds, __m512i b)
+{
+    b = _mm512_xor_si512(b, rk[0]);
+    for (int r = 1; r < rounds; r++) {
+        b = _mm512_aesenc_epi128(b, rk[r]);
+    }
+    return _mm512_aesenclast_epi128(b, rk[rounds]);
+}
+
+VAES_TARGET static void vaes_ctr32(
+    const aes_key_schedule* ks, const uint8_t* counter,
+    const uint8_t* in, uint8_t* out, size_t len)
+{
+    if (len < 64) {
+        aesni_ctr32(ks, counter, in, out, len);
+        return;
+    }
+
+    const int rounds = ks->rounds;
+    __m512i rk[AESGCMSIV_MAX_ROUNDS + 1];
+    for (int r = 0; r <= rounds; r++) {
+        rk[r] = _mm512_broadcast_i32x4(load_block(ks->round_keys[r]));
+    }
+
+    // Lane k starts at counter + k; the counter word wraps modulo 2^32
+    __m512i ctr = _mm512_add_epi32(_mm512_broadcast_i32x4(load_block(counter)),
+        _mm512_set_epi32(0, 0, 0, 3, 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 0));
+    const __m512i four = _mm512_set_epi32(0, 0, 0, 4, 0, 0, 0, 4, 0, 0, 0, 4, 0, 0, 0, 4);
+
+    while (len >= 256) {
+        __m512i b[4];
+        for (int i = 0; i < 4; i++) {
+            b[i] = _mm512_xor_si512(ctr, rk[0]);
+            ctr = _mm512_add_epi32(ctr, four);
+        }
+        for (int r = 1; r < rounds; r++) {
+            for (int i = 0; i < 4; i++) {
+                b[i] = _mm512_aesenc_epi128(b[i], rk[r]);
+            }
+        }
+        for (int i = 0; i < 4; i++) {
+            b[i] = _mm512_aesenclast_epi128(b[i], rk[rounds]);
+            _mm512_storeu_si512(out + 64 * i, _mm512_xor_si512(_mm512_loadu_si512(in + 64 * i), b[i]));
+        }
+        in += 256;
+        out += 256;
+        len -= 256;
+    }
+    while (len >= 64) {
+        __m512i b = aes_encrypt_x4(rk, rounds, ctr);
+        ctr = _mm512_add_epi32(ctr, four);
+        _mm512_storeu_si512(out, _mm512_xor_si512(_mm512_loadu_si512(in), b));
+        in += 64;
+        out += 64;
+        len -= 64;
+    }
+    aesgcmsiv_secure_zero(rk, sizeof(rk));
+
+    if (len) {
+        // Lane 0 holds the next counter block
+        alignas(16) uint8_t next[16];
+        store_block(next, _mm512_castsi512_si128(ctr));
+        aesni_ctr32(ks, next, in, out, len);
+    }
+}
+
+// Fused decrypt with 16 blocks per iteration: four 512-bit CTR vectors are
+// XORed into plaintext and folded into POLYVAL straight from the registers.
+VAES_TARGET static void vaes_ctr32_polyval(
+    const aes_key_schedule* ks, const uint8_t* counter,
+    const uint8_t* in, uint8_t* out, size_t len, polyval_state* pv)
+{
+    if (len < 16 * VAES_POLYVAL_STRIDE) {
+        aesni_ctr32_polyval(ks, counter, in, out, len, pv);
+        return;
+    }
+
+    const int rounds = ks->rounds;
+    __m512i rk[AESGCMSIV_MAX_ROUNDS + 1];
+    for (int r = 0; r <= rounds; r++) {
+        rk[r] = _mm512_broadcast_i32x4(load_block(ks->round_keys[r]));
+    }
+    __m512i p[4];
+    for (int i = 0; i < 4; i++) {
+        __m512i v = _mm512_loadu_si512(pv->h[12 - 4 * i]);
+        p[i] = _mm512_shuffle_i64x2(v, v, 0x1b);
+    }
+
+    __m512i ctr = _mm512_add_epi32(_mm512_broadcast_i32x4(load_block(counter)),
+        _mm512_set_epi32(0, 0, 0, 3, 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 0));
+    const __m512i four = _mm512_set_epi32(0, 0, 0, 4, 0, 0, 0, 4, 0, 0, 0, 4, 0, 0, 0, 4);
+    __m128i s = load_block(pv->s);
+
+    while (len >= 16 * VAES_POLYVAL_STRIDE) {
+        __m512i b[4];
+        for (int i = 0; i < 4; i++) {
+            b[i] = _mm512_xor_si512(ctr, rk[0]);
+            ctr = _mm512_add_epi32(ctr, four);
+        }
+        for (int r = 1; r < rounds; r++) {
+            for (int i = 0; i < 4; i++) {
+                b[i] = _mm512_aesenc_epi128(b[i], rk[r]);
+            }
+        }
+
+        __m512i lo = _mm512_setzero_si512();
+        __m512i mid = _mm512_setzero_si512();
+        __m512i hi = _mm512_setzero_si512();
+        for (int i = 0; i < 4; i++) {
+            b[i] = _mm512_aesenclast_epi128(b[i], rk[rounds]);
+            __m512i x = _mm512_xor_si512(_mm512_loadu_si512(in + 64 * i), b[i]);
+            _mm512_storeu_si512(out + 64 * i, x);
+            if (i == 0) {
+                x = _mm512_xor_si512(x, _mm512_zextsi128_si512(s));
+            }
+            clmul_accumulate_x4(x, p[i], &lo, &mid, &hi);
+        }
+        s = gf_fold(xor_lanes(lo), xor_lanes(mid), xor_lanes(hi));
+        in += 16 * VAES_POLYVAL_STRIDE;
+        out += 16 * VAES_POLYVAL_STRIDE;
+        len -= 16 * VAES_POLYVAL_STRIDE;
+    }
+    aesgcmsiv_secure_zero(rk, sizeof(rk));
+    store_block(pv->s, s);
+
+    if (len) {
+        alignas(16) uint8_t next[16];
+        store_block(next, _mm512_castsi512_si128(ctr));
+        aesni_ctr32_polyval(ks, next, in, out, len, pv);
+    }
+}
+
+static const aesgcmsiv_kernel vaes_kernel = {
+    "vaes-avx512",
+    aesni_expand_key,
+    aesni_derive_keys,
+    aesni_encrypt_block,
+    vaes_polyval_init,
+    vaes_polyval_blocks,
+    vaes_ctr32,
+    vaes_ctr32_polyval,
+    aesni_derive_keys_lanes,
+    aesni_encrypt_block_lanes,
+    aesni_polyval_lanes,
+    aesni_ctr32_lanes,
+    aesni_seal_small,
+    aesni_open_small,
+    // Streaming output is bound by memory bandwidth, not by the AES units,
+    // so the 128-bit loops keep up
+    aesni_ctr32_stream,
+    aesni_ctr32_polyval_stream,
+    // Twice as fast per item as aesni, so twice as far ahead
+    8,
+    // vaes_ctr32 takes four blocks to a register from 64 bytes up
+    512,
+    64,
+};
+
+const aesgcmsiv_kernel* vaes_kernel_probe(uint32_t cpu_features)
+{
+    const uint32_t required =
+        AESGCMSIV_CPU_AESNI | AESGCMSIV_CPU_PCLMULQDQ | AESGCMSIV_CPU_SSE41 |
+        AESGCMSIV_CPU_AVX2 | AESGCMSIV_CPU_AVX512 |
+        AESGCMSIV_CPU_VAES | AESGCMSIV_CPU_VPCLMULQDQ;
+    return (cpu_features & required) == required ? &vaes_kernel : nullptr;
+}
+
+#else // not x64
+
+const aesgcmsiv_kernel* vaes_kernel_probe(uint32_t)
+{
+    return nullptr;
+}
+
+#endif
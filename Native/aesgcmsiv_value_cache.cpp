@@ -0,0 +1,533 @@
+#include "aesgcmsiv.h"
+#include "aesgcmsiv_crypto.h"
+// For OPENSSL_cleanse, which every supported crypto library has
+#include <openssl/crypto.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <shared_mutex>
+#include <vector>
+
+// A cache of values kept sealed in memory. A value is sealed into a slot of
+// its size class, laid out as nonce || length || ciphertext || tag, and its
+// ID maps to the slot through an open-addressed index with linear probing.
+// Slabs of slots are allocated as classes fill and kept until the cache is
+// freed; a freed slot goes back on its class's free list. Every batch call
+// runs under one lock, shared by gets and exclusive to puts and removes.
+
+namespace {
+
+constexpr size_t kHeader = AESGCMSIV_NONCE_SIZE + 4;
+constexpr size_t kOverhead = kHeader + AESGCMSIV_TAG_SIZE;
+
+// Size classes run from 64 bytes in four steps per doubling, so a slot
+// wastes at most a fifth of itself; the last fits the longest value
+constexpr unsigned int kClasses = 60;
+
+constexpr size_t class_size(unsigned int size_class)
+{
+    return (size_t(64) << (size_class / 4)) + (size_class % 4) * (size_t(16) << (size_class / 4));
+}
+
+static_assert(class_size(kClasses - 1) >= AESGCMSIV_VALUE_CACHE_MAX_VALUE + kOverhead,
+    "the largest class must hold the longest value");
+
+unsigned int class_for(size_t slot_bytes)
+{
+    unsigned int size_class = 0;
+    while (class_size(size_class) < slot_bytes) {
+        size_class++;
+    }
+    return size_class;
+}
+
+// Bytes per slab, and with huge pages the page they are rounded up to
+constexpr size_t kSlabBytes = size_t(256) << 10;
+constexpr size_t kHugeSlabBytes = size_t(2) << 20;
+
+// Values per batch call, so the items fit on the stack
+constexpr size_t kGroup = 128;
+
+struct index_entry {
+    uint64_t id;
+    uint32_t slot;  // within its class
+    uint8_t size_class;
+    uint8_t used;
+    std::atomic<uint8_t> referenced;  // read since the clock hand last passed
+};
+
+struct size_class_slabs {
+    std::vector<uint8_t*> slabs;
+    std::vector<uint32_t> free_slots;
+};
+
+inline void store_le64(uint8_t* out, uint64_t value)
+{
+    for (int i = 0; i < 8; i++) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+inline void store_le32(uint8_t* out, uint32_t value)
+{
+    for (int i = 0; i < 4; i++) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+inline uint32_t load_le32(const uint8_t* in)
+{
+    return uint32_t(in[0]) | uint32_t(in[1]) << 8 | uint32_t(in[2]) << 16 | uint32_t(in[3]) << 24;
+}
+
+}  // namespace
+
+struct aesgcmsiv_value_cache {
+    std::shared_mutex lock;
+    aesgcmsiv_ctx* ctx = nullptr;
+    uint64_t secret = 0;  // keys the index hash, drawn when the cache is created
+    uint8_t nonce_prefix[4] = {};
+    uint64_t next_nonce = 0;
+    uint32_t alloc_flags = 0;
+    size_t slab_bytes = kSlabBytes;
+    size_t capacity = 0;
+    std::unique_ptr<index_entry[]> index;
+    size_t mask = 0;
+    size_t hand = 0;  // clock hand over the index
+    uint64_t entries = 0;
+    uint64_t value_bytes = 0;
+    uint64_t slab_total = 0;
+    uint64_t evictions = 0;
+    size_class_slabs classes[kClasses];
+};
+
+namespace {
+
+// The splitmix64 finalizer over the ID under the cache's secret, so IDs
+// chosen by an attacker cannot be made to share a run of the index
+size_t home_of(const aesgcmsiv_value_cache* cache, uint64_t id)
+{
+    uint64_t h = id ^ cache->secret;
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return static_cast<size_t>(h ^ (h >> 31)) & cache->mask;
+}
+
+index_entry* find(aesgcmsiv_value_cache* cache, uint64_t id)
+{
+    for (size_t i = home_of(cache, id);; i = (i + 1) & cache->mask) {
+        index_entry& entry = cache->index[i];
+        if (!entry.used) {
+            return nullptr;
+        }
+        if (entry.id == id) {
+            return &entry;
+        }
+    }
+}
+
+void copy_entry(index_entry& to, const index_entry& from)
+{
+    to.id = from.id;
+    to.slot = from.slot;
+    to.size_class = from.size_class;
+    to.used = from.used;
+    to.referenced.store(from.referenced.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+uint8_t* slot_of(aesgcmsiv_value_cache* cache, unsigned int size_class, uint32_t slot)
+{
+    const size_t size = class_size(size_class);
+    const size_t per_slab = std::max<size_t>(1, cache->slab_bytes / size);
+    return cache->classes[size_class].slabs[slot / per_slab] + (slot % per_slab) * size;
+}
+
+// A free slot of size_class, allocating a slab if there is none, or false
+// if out of memory
+bool take_slot(aesgcmsiv_value_cache* cache, unsigned int size_class, uint32_t* slot_out)
+{
+    size_class_slabs& slabs = cache->classes[size_class];
+    if (slabs.free_slots.empty()) {
+        const size_t size = class_size(size_class);
+        const size_t per_slab = std::max<size_t>(1, cache->slab_bytes / size);
+        const size_t bytes = std::max(cache->slab_bytes, size);
+        try {
+            slabs.slabs.reserve(slabs.slabs.size() + 1);
+            slabs.free_slots.reserve(per_slab);
+        } catch (const std::bad_alloc&) {
+            return false;
+        }
+        uint8_t* slab = static_cast<uint8_t*>(aesgcmsiv_alloc(bytes, cache->alloc_flags));
+        if (!slab) {
+            return false;
+        }
+        const uint32_t first = static_cast<uint32_t>(slabs.slabs.size() * per_slab);
+        slabs.slabs.push_back(slab);
+        cache->slab_total += bytes;
+        for (size_t i = per_slab; i-- > 0;) {
+            slabs.free_slots.push_back(first + static_cast<uint32_t>(i));
+        }
+    }
+    *slot_out = slabs.free_slots.back();
+    slabs.free_slots.pop_back();
+    return true;
+}
+
+// Slots freed during a put, returned to their classes once the batch that
+// may still write them has run
+struct freed_slot {
+    uint8_t size_class;
+    uint32_t slot;
+};
+
+// Empties the index slot at i, shifting later entries of its run back so
+// that lookups need no tombstones
+void erase_at(aesgcmsiv_value_cache* cache, size_t i)
+{
+    size_t j = i;
+    for (;;) {
+        cache->index[i].used = 0;
+        for (;;) {
+            j = (j + 1) & cache->mask;
+            if (!cache->index[j].used) {
+                return;
+            }
+            // The entry at j stays if its home lies cyclically in (i, j]
+            const size_t home = home_of(cache, cache->index[j].id);
+            if (i <= j ? (i < home && home <= j) : (i < home || home <= j)) {
+                continue;
+            }
+            break;
+        }
+        copy_entry(cache->index[i], cache->index[j]);
+        i = j;
+    }
+}
+
+void forget(aesgcmsiv_value_cache* cache, index_entry* entry, std::vector<freed_slot>& freed)
+{
+    const uint8_t* slot = slot_of(cache, entry->size_class, entry->slot);
+    cache->value_bytes -= load_le32(slot + AESGCMSIV_NONCE_SIZE);
+    cache->entries--;
+    freed.push_back({entry->size_class, entry->slot});
+    erase_at(cache, static_cast<size_t>(entry - cache->index.get()));
+}
+
+// Evicts the first entry the clock hand finds unread since it last passed
+void evict_one(aesgcmsiv_value_cache* cache, std::vector<freed_slot>& freed)
+{
+    for (;; cache->hand = (cache->hand + 1) & cache->mask) {
+        index_entry& entry = cache->index[cache->hand];
+        if (!entry.used) {
+            continue;
+        }
+        if (entry.referenced.load(std::memory_order_relaxed)) {
+            entry.referenced.store(0, std::memory_order_relaxed);
+            continue;
+        }
+        // The hand stays put: erasing may shift the next entry into place
+        forget(cache, &entry, freed);
+        cache->evictions++;
+        return;
+    }
+}
+
+index_entry* insert(aesgcmsiv_value_cache* cache, uint64_t id)
+{
+    size_t i = home_of(cache, id);
+    while (cache->index[i].used) {
+        i = (i + 1) & cache->mask;
+    }
+    index_entry& entry = cache->index[i];
+    entry.id = id;
+    entry.used = 1;
+    entry.referenced.store(1, std::memory_order_relaxed);
+    cache->entries++;
+    return &entry;
+}
+
+void release(aesgcmsiv_value_cache* cache, std::vector<freed_slot>& freed)
+{
+    for (const freed_slot& slot : freed) {
+        cache->classes[slot.size_class].free_slots.push_back(slot.slot);
+    }
+    freed.clear();
+}
+
+}  // namespace
+
+extern "C" {
+
+int aesgcmsiv_value_cache_new(
+    const uint8_t* key, size_t key_len,
+    size_t capacity,
+    uint32_t alloc_flags,
+    aesgcmsiv_value_cache** cache_out)
+{
+    if (!cache_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *cache_out = nullptr;
+    if (capacity == 0 || capacity > AESGCMSIV_VALUE_CACHE_MAX_ENTRIES) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    // Rejects unknown flags, and a lock the OS refuses, up front
+    void* trial = aesgcmsiv_alloc(1, alloc_flags);
+    if (!trial) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    aesgcmsiv_free(trial);
+
+    std::unique_ptr<aesgcmsiv_value_cache> cache(new (std::nothrow) aesgcmsiv_value_cache());
+    if (!cache) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    // At most half full, so runs stay short
+    size_t slots = 2;
+    while (slots < capacity * 2) {
+        slots *= 2;
+    }
+    cache->index.reset(new (std::nothrow) index_entry[slots]());
+    if (!cache->index) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    cache->mask = slots - 1;
+    cache->capacity = capacity;
+    cache->alloc_flags = alloc_flags;
+    cache->slab_bytes = (alloc_flags & AESGCMSIV_ALLOC_HUGE_PAGES) ? kHugeSlabBytes : kSlabBytes;
+
+    uint8_t random[AESGCMSIV_KEY_SIZE_256 + sizeof(cache->secret) + sizeof(cache->nonce_prefix)];
+    int result = crypto_random(random, sizeof(random));
+    if (result == AESGCMSIV_SUCCESS) {
+        memcpy(&cache->secret, random + AESGCMSIV_KEY_SIZE_256, sizeof(cache->secret));
+        memcpy(cache->nonce_prefix, random + AESGCMSIV_KEY_SIZE_256 + sizeof(cache->secret),
+            sizeof(cache->nonce_prefix));
+        result = key ? aesgcmsiv_ctx_new(key, key_len, &cache->ctx)
+                     : aesgcmsiv_ctx_new(random, AESGCMSIV_KEY_SIZE_256, &cache->ctx);
+    }
+    OPENSSL_cleanse(random, sizeof(random));
+    if (result != AESGCMSIV_SUCCESS) {
+        return result;
+    }
+    *cache_out = cache.release();
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_value_cache_put(
+    aesgcmsiv_value_cache* cache,
+    size_t count,
+    const aesgcmsiv_cache_value* values,
+    int* status_out)
+{
+    if (!cache || (count > 0 && (!values || !status_out))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    std::unique_lock<std::shared_mutex> guard(cache->lock);
+    std::vector<freed_slot> freed;
+    try {
+        freed.reserve(2 * std::min(count, kGroup));
+    } catch (const std::bad_alloc&) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    int first_error = AESGCMSIV_SUCCESS;
+    for (size_t first = 0; first < count; first += kGroup) {
+        const size_t n = std::min(kGroup, count - first);
+        aesgcmsiv_batch_item items[kGroup];
+        uint8_t aads[kGroup][8];
+        size_t owners[kGroup];  // the value each item seals
+        size_t sealing = 0;
+        for (size_t j = 0; j < n; j++) {
+            const aesgcmsiv_cache_value& value = values[first + j];
+            int& status = status_out[first + j];
+            index_entry* entry = find(cache, value.id);
+            if (value.len > AESGCMSIV_VALUE_CACHE_MAX_VALUE || (!value.data && value.len > 0)) {
+                status = AESGCMSIV_ERROR_INVALID_INPUT;
+            } else {
+                const unsigned int size_class = class_for(value.len + kOverhead);
+                uint32_t slot_number;
+                status = take_slot(cache, size_class, &slot_number) ? AESGCMSIV_SUCCESS : AESGCMSIV_ERROR_INTERNAL;
+                if (status == AESGCMSIV_SUCCESS) {
+                    if (entry) {
+                        forget(cache, entry, freed);
+                    } else if (cache->entries == cache->capacity) {
+                        evict_one(cache, freed);
+                    }
+                    entry = insert(cache, value.id);
+                    entry->size_class = static_cast<uint8_t>(size_class);
+                    entry->slot = slot_number;
+                    cache->value_bytes += value.len;
+
+                    uint8_t* slot = slot_of(cache, size_class, slot_number);
+                    memcpy(slot, cache->nonce_prefix, sizeof(cache->nonce_prefix));
+                    store_le64(slot + sizeof(cache->nonce_prefix), cache->next_nonce++);
+                    store_le32(slot + AESGCMSIV_NONCE_SIZE, static_cast<uint32_t>(value.len));
+                    store_le64(aads[sealing], value.id);
+                    aesgcmsiv_batch_item& item = items[sealing];
+                    item.nonce = slot;
+                    item.input = value.data;
+                    item.input_len = value.len;
+                    item.aad = aads[sealing];
+                    item.aad_len = sizeof(aads[sealing]);
+                    item.output = slot + kHeader;
+                    item.tag = slot + kHeader + value.len;
+                    owners[sealing++] = first + j;
+                    continue;
+                }
+            }
+            // A failed put leaves its ID absent
+            if (entry) {
+                forget(cache, entry, freed);
+            }
+            if (first_error == AESGCMSIV_SUCCESS) {
+                first_error = status;
+            }
+        }
+
+        const int result = aesgcmsiv_encrypt_batch(cache->ctx, sealing, items);
+        if (result != AESGCMSIV_SUCCESS) {
+            for (size_t k = 0; k < sealing; k++) {
+                const aesgcmsiv_cache_value& value = values[owners[k]];
+                index_entry* entry = find(cache, value.id);
+                if (entry && slot_of(cache, entry->size_class, entry->slot) == items[k].nonce) {
+                    forget(cache, entry, freed);
+                }
+                status_out[owners[k]] = result;
+            }
+            if (first_error == AESGCMSIV_SUCCESS) {
+                first_error = result;
+            }
+        }
+        release(cache, freed);
+    }
+    return first_error;
+}
+
+int aesgcmsiv_value_cache_get(
+    aesgcmsiv_value_cache* cache,
+    size_t count,
+    aesgcmsiv_cache_value* values,
+    int* status_out)
+{
+    if (!cache || (count > 0 && (!values || !status_out))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+
+    std::shared_lock<std::shared_mutex> guard(cache->lock);
+    int first_error = AESGCMSIV_SUCCESS;
+    for (size_t first = 0; first < count; first += kGroup) {
+        const size_t n = std::min(kGroup, count - first);
+        aesgcmsiv_batch_item items[kGroup];
+        uint8_t aads[kGroup][8];
+        size_t owners[kGroup];
+        int statuses[kGroup];
+        size_t opening = 0;
+        for (size_t j = 0; j < n; j++) {
+            aesgcmsiv_cache_value& value = values[first + j];
+            int& status = status_out[first + j];
+            const index_entry* entry = find(cache, value.id);
+            if (!entry) {
+                status = AESGCMSIV_ERROR_NOT_FOUND;
+            } else {
+                if (!entry->referenced.load(std::memory_order_relaxed)) {
+                    const_cast<index_entry*>(entry)->referenced.store(1, std::memory_order_relaxed);
+                }
+                const uint8_t* slot = slot_of(cache, entry->size_class, entry->slot);
+                const size_t len = load_le32(slot + AESGCMSIV_NONCE_SIZE);
+                const size_t room = value.len;
+                if (len > class_size(entry->size_class) - kOverhead) {
+                    // Only a length altered in memory can overrun its slot
+                    status = AESGCMSIV_ERROR_DECRYPT_FAILED;
+                } else if (len > room || (!value.data && len > 0)) {
+                    value.len = len;
+                    status = AESGCMSIV_ERROR_INVALID_INPUT;
+                } else {
+                    value.len = len;
+                    store_le64(aads[opening], value.id);
+                    aesgcmsiv_batch_item& item = items[opening];
+                    item.nonce = slot;
+                    item.input = slot + kHeader;
+                    item.input_len = len;
+                    item.aad = aads[opening];
+                    item.aad_len = sizeof(aads[opening]);
+                    item.output = value.data;
+                    item.tag = const_cast<uint8_t*>(slot + kHeader + len);
+                    owners[opening++] = first + j;
+                    continue;
+                }
+            }
+            if (first_error == AESGCMSIV_SUCCESS) {
+                first_error = status;
+            }
+        }
+
+        if (opening > 0) {
+            // Stands for every item if the batch is refused as a whole
+            std::fill(statuses, statuses + opening, AESGCMSIV_ERROR_INVALID_INPUT);
+            aesgcmsiv_decrypt_batch(cache->ctx, opening, items, statuses);
+            for (size_t k = 0; k < opening; k++) {
+                const int status = statuses[k];
+                status_out[owners[k]] = status;
+                if (status != AESGCMSIV_SUCCESS && first_error == AESGCMSIV_SUCCESS) {
+                    first_error = status;
+                }
+            }
+        }
+    }
+    return first_error;
+}
+
+int aesgcmsiv_value_cache_remove(aesgcmsiv_value_cache* cache, uint64_t id)
+{
+    if (!cache) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::unique_lock<std::shared_mutex> guard(cache->lock);
+    index_entry* entry = find(cache, id);
+    if (!entry) {
+        return AESGCMSIV_ERROR_NOT_FOUND;
+    }
+    std::vector<freed_slot> freed;
+    try {
+        freed.reserve(1);
+    } catch (const std::bad_alloc&) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    forget(cache, entry, freed);
+    release(cache, freed);
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_value_cache_get_stats(
+    aesgcmsiv_value_cache* cache,
+    aesgcmsiv_value_cache_stats* stats_out)
+{
+    if (!cache || !stats_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::shared_lock<std::shared_mutex> guard(cache->lock);
+    stats_out->entries = cache->entries;
+    stats_out->value_bytes = cache->value_bytes;
+    stats_out->slab_bytes = cache->slab_total;
+    stats_out->evictions = cache->evictions;
+    return AESGCMSIV_SUCCESS;
+}
+
+void aesgcmsiv_value_cache_free(aesgcmsiv_value_cache* cache)
+{
+    if (!cache) {
+        return;
+    }
+    for (size_class_slabs& slabs : cache->classes) {
+        for (uint8_t* slab : slabs.slabs) {
+            aesgcmsiv_free(slab);
+        }
+    }
+    aesgcmsiv_ctx_free(cache->ctx);
+    delete cache;
+}
+
+} // extern "C"
@@ -0,0 +1,169 @@
+#ifndef AESGCMSIV_X86_H
+#define AESGCMSIV_X86_H
+
+// Shared x86 intrinsic helpers for the AES-NI and VAES kernels. Only include
+// this from kernel translation units, behind an x86 check.
+
+#include "aesgcmsiv_kernels.h"
+#include <immintrin.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define AESNI_TARGET
+#define VAES_TARGET
+#else
+#include <cpuid.h>
+#define AESNI_TARGET __attribute__((target("aes,pclmul,sse4.1")))
+#define VAES_TARGET __attribute__((target("aes,pclmul,sse4.1,avx2,avx512f,avx512bw,avx512vl,vaes,vpclmulqdq")))
+#endif
+
+// Runs cpuid for leaf/subleaf and returns {eax, ebx, ecx, edx}.
+static inline void x86_cpuid(unsigned int leaf, unsigned int subleaf, unsigned int regs[4])
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (int i = 0; i < 4; i++) {
+        regs[i] = static_cast<unsigned int>(info[i]);
+    }
+#else
+    if (!__get_cpuid_count(leaf, subleaf, &regs[0], &regs[1], &regs[2], &regs[3])) {
+        regs[0] = regs[1] = regs[2] = regs[3] = 0;
+    }
+#endif
+}
+
+// Reads XCR0 to check which register states the OS saves. Only call after
+// cpuid reports OSXSAVE.
+static inline unsigned long long x86_xgetbv0()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+
+AESNI_TARGET static inline __m128i aes_encrypt_block(const __m128i* rk, int rounds, __m128i b)
+{
+    b = _mm_xor_si128(b, rk[0]);
+    for (int r = 1; r < rounds; r++) {
+        b = _mm_aesenc_si128(b, rk[r]);
+    }
+    return _mm_aesenclast_si128(b, rk[rounds]);
+}
+
+// Encrypts N independent blocks with the rounds interleaved so the AES unit
+// pipeline stays full.
+template <int N>
+AESNI_TARGET static inline void aes_encrypt_blocks(const __m128i* rk, int rounds, __m128i* b)
+{
+    for (int i = 0; i < N; i++) {
+        b[i] = _mm_xor_si128(b[i], rk[0]);
+    }
+    for (int r = 1; r < rounds; r++) {
+        const __m128i k = rk[r];
+        for (int i = 0; i < N; i++) {
+            b[i] = _mm_aesenc_si128(b[i], k);
+        }
+    }
+    const __m128i last = rk[rounds];
+    for (int i = 0; i < N; i++) {
+        b[i] = _mm_aesenclast_si128(b[i], last);
+    }
+}
+
+// Reduces the 256-bit product hi:lo to a 128-bit POLYVAL result, i.e. the
+// product times x^-128 modulo x^128 + x^127 + x^126 + x^121 + 1.
+AESNI_TARGET static inline __m128i gf_reduce(__m128i lo, __m128i hi)
+{
+    const __m128i poly = _mm_set_epi64x(static_cast<long long>(0xc200000000000000ULL), 1);
+    __m128i t = _mm_clmulepi64_si128(lo, poly, 0x10);
+    lo = _mm_xor_si128(_mm_shuffle_epi32(lo, 0x4e), t);
+    t = _mm_clmulepi64_si128(lo, poly, 0x10);
+    lo = _mm_xor_si128(_mm_shuffle_epi32(lo, 0x4e), t);
+    return _mm_xor_si128(hi, lo);
+}
+
+AESNI_TARGET static inline void clmul_accumulate(
+    __m128i a, __m128i b, __m128i* lo, __m128i* mid, __m128i* hi)
+{
+    *lo = _mm_xor_si128(*lo, _mm_clmulepi64_si128(a, b, 0x00));
+    *hi = _mm_xor_si128(*hi, _mm_clmulepi64_si128(a, b, 0x11));
+    *mid = _mm_xor_si128(*mid, _mm_clmulepi64_si128(a, b, 0x01));
+    *mid = _mm_xor_si128(*mid, _mm_clmulepi64_si128(a, b, 0x10));
+}
+
+AESNI_TARGET static inline __m128i gf_fold(__m128i lo, __m128i mid, __m128i hi)
+{
+    lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+    return gf_reduce(lo, hi);
+}
+
+AESNI_TARGET static inline __m128i gf_mul(__m128i a, __m128i b)
+{
+    __m128i lo = _mm_setzero_si128();
+    __m128i mid = _mm_setzero_si128();
+    __m128i hi = _mm_setzero_si128();
+    clmul_accumulate(a, b, &lo, &mid, &hi);
+    return gf_fold(lo, mid, hi);
+}
+
+AESNI_TARGET static inline __m128i load_block(const uint8_t* p)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+AESNI_TARGET static inline void store_block(uint8_t* p, __m128i v)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+}
+
+// Shared AES-NI primitives, also used by the wide kernels for the parts of
+// a message that are too short for 512-bit lanes.
+void aesni_expand_key(const uint8_t* key, size_t key_len, aes_key_schedule* ks);
+void aesni_derive_keys(
+    const aes_key_schedule* ks, const uint8_t* nonce,
+    uint8_t* auth_key, aes_key_schedule* enc_ks);
+void aesni_encrypt_block(const aes_key_schedule* ks, const uint8_t* in, uint8_t* out);
+void aesni_polyval_powers(polyval_state* pv, const uint8_t* h, int powers);
+void aesni_polyval_blocks(polyval_state* pv, const uint8_t* data, size_t blocks);
+void aesni_ctr32(
+    const aes_key_schedule* ks, const uint8_t* counter,
+    const uint8_t* in, uint8_t* out, size_t len);
+void aesni_ctr32_polyval(
+    const aes_key_schedule* ks, const uint8_t* counter,
+    const uint8_t* in, uint8_t* out, size_t len, polyval_state* pv);
+void aesni_ctr32_stream(
+    const aes_key_schedule* ks, const uint8_t* counter,
+    const uint8_t* in, uint8_t* out, size_t len);
+void aesni_ctr32_polyval_stream(
+    const aes_key_schedule* ks, const uint8_t* counter,
+    const uint8_t* in, uint8_t* out, size_t len, polyval_state* pv);
+void aesni_derive_keys_lanes(
+    const aes_key_schedule* ks, const uint8_t* const* nonces,
+    uint8_t (*auth_keys)[16], aes_key_schedule* enc_ks);
+void aesni_encrypt_block_lanes(
+    const aes_key_schedule* enc_ks, const uint8_t (*in)[16], uint8_t (*out)[16]);
+void aesni_polyval_lanes(
+    const uint8_t (*h)[16], const uint8_t* const* data, const size_t* blocks,
+    uint8_t (*s_out)[16]);
+void aesni_ctr32_lanes(
+    const aes_key_schedule* enc_ks, const uint8_t (*counters)[16],
+    const uint8_t* const* in, uint8_t* const* out, const size_t* len);
+void aesni_seal_small(
+    const uint8_t* auth_key, const aes_key_schedule* enc_ks, const uint8_t* nonce,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out, uint8_t* tag_out);
+int aesni_open_small(
+    const uint8_t* auth_key, const aes_key_schedule* enc_ks, const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out);
+
+#endif // AESGCMSIV_X86_H
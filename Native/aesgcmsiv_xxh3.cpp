@@ -0,0 +1,375 @@
+#include "aesgcmsiv_xxh3.h"
+#include "aesgcmsiv.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// XXH3-64 after the reference implementation. The long path's block loop
+// is the only one that matters for speed, and has SSE2 and AVX2 forms on
+// x86-64, where scalar code would run at a fraction of POLYVAL's rate; the
+// short paths and the last block are scalar everywhere.
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define AESGCMSIV_XXH3_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+
+constexpr uint64_t PRIME32_1 = 0x9E3779B1u;
+constexpr uint64_t PRIME32_2 = 0x85EBCA77u;
+constexpr uint64_t PRIME32_3 = 0xC2B2AE3Du;
+constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ull;
+constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ull;
+constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5ull;
+constexpr uint64_t PRIME_MX1 = 0x165667919E3779F9ull;
+constexpr uint64_t PRIME_MX2 = 0x9FB21C651E98DF25ull;
+
+constexpr size_t STRIPE_LEN = 64;
+constexpr size_t SECRET_CONSUME_RATE = 8;
+constexpr size_t STRIPES_PER_BLOCK = XXH3_BLOCK_SIZE / STRIPE_LEN;
+
+alignas(64) const uint8_t default_secret[192] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+// Little-endian loads, whatever the host
+uint32_t load32(const uint8_t* p)
+{
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+        (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint64_t load64(const uint8_t* p)
+{
+    return static_cast<uint64_t>(load32(p)) | (static_cast<uint64_t>(load32(p + 4)) << 32);
+}
+
+uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+uint64_t swap64(uint64_t x)
+{
+    x = ((x & 0x00FF00FF00FF00FFull) << 8) | ((x >> 8) & 0x00FF00FF00FF00FFull);
+    x = ((x & 0x0000FFFF0000FFFFull) << 16) | ((x >> 16) & 0x0000FFFF0000FFFFull);
+    return (x << 32) | (x >> 32);
+}
+
+// The 128-bit product of a and b, its halves xored
+uint64_t mul128_fold64(uint64_t a, uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+    // __extension__ keeps -Wpedantic quiet about the GCC and Clang type
+    __extension__ typedef unsigned __int128 uint128;
+    const uint128 product = static_cast<uint128>(a) * b;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    uint64_t high;
+    const uint64_t low = _umul128(a, b, &high);
+    return low ^ high;
+#else
+    const uint64_t lo_lo = (a & 0xFFFFFFFFu) * (b & 0xFFFFFFFFu);
+    const uint64_t hi_lo = (a >> 32) * (b & 0xFFFFFFFFu);
+    const uint64_t lo_hi = (a & 0xFFFFFFFFu) * (b >> 32);
+    const uint64_t hi_hi = (a >> 32) * (b >> 32);
+    const uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFFu) + lo_hi;
+    const uint64_t upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    const uint64_t lower = (cross << 32) | (lo_lo & 0xFFFFFFFFu);
+    return lower ^ upper;
+#endif
+}
+
+uint64_t xxh64_avalanche(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t avalanche(uint64_t h)
+{
+    h ^= h >> 37;
+    h *= PRIME_MX1;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t rrmxmx(uint64_t h, uint64_t len)
+{
+    h ^= rotl64(h, 49) ^ rotl64(h, 24);
+    h *= PRIME_MX2;
+    h ^= (h >> 35) + len;
+    h *= PRIME_MX2;
+    h ^= h >> 28;
+    return h;
+}
+
+uint64_t mix16(const uint8_t* input, const uint8_t* secret)
+{
+    return mul128_fold64(load64(input) ^ load64(secret), load64(input + 8) ^ load64(secret + 8));
+}
+
+uint64_t hash_0to16(const uint8_t* input, size_t len)
+{
+    const uint8_t* secret = default_secret;
+    if (len > 8) {
+        const uint64_t lo = load64(input) ^ (load64(secret + 24) ^ load64(secret + 32));
+        const uint64_t hi = load64(input + len - 8) ^ (load64(secret + 40) ^ load64(secret + 48));
+        return avalanche(len + swap64(lo) + hi + mul128_fold64(lo, hi));
+    }
+    if (len >= 4) {
+        const uint64_t combined = load32(input + len - 4) + (static_cast<uint64_t>(load32(input)) << 32);
+        return rrmxmx(combined ^ (load64(secret + 8) ^ load64(secret + 16)), len);
+    }
+    if (len > 0) {
+        const uint32_t combined = (static_cast<uint32_t>(input[0]) << 16) |
+            (static_cast<uint32_t>(input[len >> 1]) << 24) |
+            static_cast<uint32_t>(input[len - 1]) |
+            (static_cast<uint32_t>(len) << 8);
+        return xxh64_avalanche(combined ^ static_cast<uint64_t>(load32(secret) ^ load32(secret + 4)));
+    }
+    return xxh64_avalanche(load64(secret + 56) ^ load64(secret + 64));
+}
+
+uint64_t hash_17to128(const uint8_t* input, size_t len)
+{
+    const uint8_t* secret = default_secret;
+    uint64_t acc = len * PRIME64_1;
+    if (len > 32) {
+        if (len > 64) {
+            if (len > 96) {
+                acc += mix16(input + 48, secret + 96);
+                acc += mix16(input + len - 64, secret + 112);
+            }
+            acc += mix16(input + 32, secret + 64);
+            acc += mix16(input + len - 48, secret + 80);
+        }
+        acc += mix16(input + 16, secret + 32);
+        acc += mix16(input + len - 32, secret + 48);
+    }
+    acc += mix16(input, secret);
+    acc += mix16(input + len - 16, secret + 16);
+    return avalanche(acc);
+}
+
+uint64_t hash_129to240(const uint8_t* input, size_t len)
+{
+    const uint8_t* secret = default_secret;
+    uint64_t acc = len * PRIME64_1;
+    for (size_t i = 0; i < 8; i++) {
+        acc += mix16(input + 16 * i, secret + 16 * i);
+    }
+    acc = avalanche(acc);
+    for (size_t i = 8; i < len / 16; i++) {
+        acc += mix16(input + 16 * i, secret + 16 * (i - 8) + 3);
+    }
+    acc += mix16(input + len - 16, secret + 136 - 17);
+    return avalanche(acc);
+}
+
+void accumulate_stripe(uint64_t* acc, const uint8_t* input, const uint8_t* secret)
+{
+    for (size_t i = 0; i < 8; i++) {
+        const uint64_t value = load64(input + 8 * i);
+        const uint64_t key = value ^ load64(secret + 8 * i);
+        acc[i ^ 1] += value;
+        acc[i] += (key & 0xFFFFFFFFu) * (key >> 32);
+    }
+}
+
+void accumulate(uint64_t* acc, const uint8_t* input, size_t stripes)
+{
+    for (size_t s = 0; s < stripes; s++) {
+        accumulate_stripe(acc, input + s * STRIPE_LEN, default_secret + s * SECRET_CONSUME_RATE);
+    }
+}
+
+#ifdef AESGCMSIV_XXH3_X86
+
+// The accumulators as four vectors of two lanes; a stripe's product is the
+// low half of each 64-bit lane of data ^ secret times its high half
+void blocks_sse2(uint64_t* acc_out, const uint8_t* data, size_t blocks)
+{
+    __m128i acc[4];
+    for (int i = 0; i < 4; i++) {
+        acc[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc_out) + i);
+    }
+    const __m128i prime = _mm_set1_epi32(static_cast<int>(PRIME32_1));
+    const uint8_t* scramble_secret = default_secret + sizeof(default_secret) - STRIPE_LEN;
+    for (size_t b = 0; b < blocks; b++) {
+        const uint8_t* block = data + b * XXH3_BLOCK_SIZE;
+        for (size_t s = 0; s < STRIPES_PER_BLOCK; s++) {
+            const __m128i* in = reinterpret_cast<const __m128i*>(block + s * STRIPE_LEN);
+            const __m128i* key = reinterpret_cast<const __m128i*>(default_secret + s * SECRET_CONSUME_RATE);
+            for (int i = 0; i < 4; i++) {
+                const __m128i value = _mm_loadu_si128(in + i);
+                const __m128i mixed = _mm_xor_si128(value, _mm_loadu_si128(key + i));
+                const __m128i product = _mm_mul_epu32(mixed, _mm_shuffle_epi32(mixed, _MM_SHUFFLE(0, 3, 0, 1)));
+                acc[i] = _mm_add_epi64(acc[i], _mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2)));
+                acc[i] = _mm_add_epi64(acc[i], product);
+            }
+        }
+        const __m128i* key = reinterpret_cast<const __m128i*>(scramble_secret);
+        for (int i = 0; i < 4; i++) {
+            __m128i a = _mm_xor_si128(acc[i], _mm_srli_epi64(acc[i], 47));
+            a = _mm_xor_si128(a, _mm_loadu_si128(key + i));
+            const __m128i low = _mm_mul_epu32(a, prime);
+            const __m128i high = _mm_mul_epu32(_mm_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+            acc[i] = _mm_add_epi64(low, _mm_slli_epi64(high, 32));
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(acc_out) + i, acc[i]);
+    }
+}
+
+AVX2_TARGET void blocks_avx2(uint64_t* acc_out, const uint8_t* data, size_t blocks)
+{
+    __m256i acc[2];
+    for (int i = 0; i < 2; i++) {
+        acc[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc_out) + i);
+    }
+    const __m256i prime = _mm256_set1_epi32(static_cast<int>(PRIME32_1));
+    const uint8_t* scramble_secret = default_secret + sizeof(default_secret) - STRIPE_LEN;
+    for (size_t b = 0; b < blocks; b++) {
+        const uint8_t* block = data + b * XXH3_BLOCK_SIZE;
+        for (size_t s = 0; s < STRIPES_PER_BLOCK; s++) {
+            const __m256i* in = reinterpret_cast<const __m256i*>(block + s * STRIPE_LEN);
+            const __m256i* key = reinterpret_cast<const __m256i*>(default_secret + s * SECRET_CONSUME_RATE);
+            for (int i = 0; i < 2; i++) {
+                const __m256i value = _mm256_loadu_si256(in + i);
+                const __m256i mixed = _mm256_xor_si256(value, _mm256_loadu_si256(key + i));
+                const __m256i product = _mm256_mul_epu32(mixed, _mm256_shuffle_epi32(mixed, _MM_SHUFFLE(0, 3, 0, 1)));
+                acc[i] = _mm256_add_epi64(acc[i], _mm256_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2)));
+                acc[i] = _mm256_add_epi64(acc[i], product);
+            }
+        }
+        const __m256i* key = reinterpret_cast<const __m256i*>(scramble_secret);
+        for (int i = 0; i < 2; i++) {
+            __m256i a = _mm256_xor_si256(acc[i], _mm256_srli_epi64(acc[i], 47));
+            a = _mm256_xor_si256(a, _mm256_loadu_si256(key + i));
+            const __m256i low = _mm256_mul_epu32(a, prime);
+            const __m256i high = _mm256_mul_epu32(_mm256_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+            acc[i] = _mm256_add_epi64(low, _mm256_slli_epi64(high, 32));
+        }
+    }
+    for (int i = 0; i < 2; i++) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc_out) + i, acc[i]);
+    }
+}
+
+#else
+
+void scramble(uint64_t* acc)
+{
+    const uint8_t* secret = default_secret + sizeof(default_secret) - STRIPE_LEN;
+    for (size_t i = 0; i < 8; i++) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= load64(secret + 8 * i);
+        acc[i] = a * PRIME32_1;
+    }
+}
+
+void blocks_scalar(uint64_t* acc, const uint8_t* data, size_t blocks)
+{
+    for (size_t b = 0; b < blocks; b++) {
+        accumulate(acc, data + b * XXH3_BLOCK_SIZE, STRIPES_PER_BLOCK);
+        scramble(acc);
+    }
+}
+
+#endif
+
+} // namespace
+
+void aesgcmsiv_xxh3_init(xxh3_state* state, uint32_t cpu_features)
+{
+    state->cpu_features = cpu_features;
+    state->acc[0] = PRIME32_3;
+    state->acc[1] = PRIME64_1;
+    state->acc[2] = PRIME64_2;
+    state->acc[3] = PRIME64_3;
+    state->acc[4] = PRIME64_4;
+    state->acc[5] = PRIME32_2;
+    state->acc[6] = PRIME64_5;
+    state->acc[7] = PRIME32_1;
+}
+
+size_t aesgcmsiv_xxh3_block_count(size_t len)
+{
+    return len > XXH3_MIDSIZE_MAX ? (len - 1) / XXH3_BLOCK_SIZE : 0;
+}
+
+void aesgcmsiv_xxh3_blocks(xxh3_state* state, const uint8_t* data, size_t blocks)
+{
+#ifdef AESGCMSIV_XXH3_X86
+    if (state->cpu_features & AESGCMSIV_CPU_AVX2) {
+        blocks_avx2(state->acc, data, blocks);
+    } else {
+        blocks_sse2(state->acc, data, blocks);
+    }
+#else
+    blocks_scalar(state->acc, data, blocks);
+#endif
+}
+
+uint64_t aesgcmsiv_xxh3_finish(xxh3_state* state, const uint8_t* input, size_t len, size_t blocks_done)
+{
+    if (len <= 16) {
+        return hash_0to16(input, len);
+    }
+    if (len <= 128) {
+        return hash_17to128(input, len);
+    }
+    if (len <= XXH3_MIDSIZE_MAX) {
+        return hash_129to240(input, len);
+    }
+
+    const size_t blocks = aesgcmsiv_xxh3_block_count(len);
+    aesgcmsiv_xxh3_blocks(state, input + blocks_done * XXH3_BLOCK_SIZE, blocks - blocks_done);
+
+    // The last block is never scrambled, and its last stripe is the
+    // input's last 64 bytes, overlapping the one before if need be
+    const size_t tail = blocks * XXH3_BLOCK_SIZE;
+    accumulate(state->acc, input + tail, (len - 1 - tail) / STRIPE_LEN);
+    accumulate_stripe(state->acc, input + len - STRIPE_LEN, default_secret + sizeof(default_secret) - STRIPE_LEN - 7);
+
+    uint64_t result = len * PRIME64_1;
+    for (size_t i = 0; i < 4; i++) {
+        const uint8_t* secret = default_secret + 11 + 16 * i;
+        result += mul128_fold64(state->acc[2 * i] ^ load64(secret), state->acc[2 * i + 1] ^ load64(secret + 8));
+    }
+    return avalanche(result);
+}
+
+uint64_t aesgcmsiv_xxh3_64(uint32_t cpu_features, const uint8_t* input, size_t len)
+{
+    xxh3_state state;
+    aesgcmsiv_xxh3_init(&state, cpu_features);
+    return aesgcmsiv_xxh3_finish(&state, input, len, 0);
+}
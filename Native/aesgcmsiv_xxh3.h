@@ -0,0 +1,40 @@
+#ifndef AESGCMSIV_XXH3_H
+#define AESGCMSIV_XXH3_H
+
+// Internal XXH3-64 (xxHash 0.8, seed 0 and the default secret), the content
+// hash behind aesgcmsiv_ctx_encrypt_hashed. A long input is taken a block
+// at a time so the caller can interleave it with another pass over the same
+// bytes. cpu_features are the AESGCMSIV_CPU_* bits, which pick the AVX2
+// path. Nothing in this header is exported from the library.
+
+#include <cstddef>
+#include <cstdint>
+
+// Inputs up to this length take the short paths, which read the input once
+// in a few loads and keep no state
+#define XXH3_MIDSIZE_MAX 240
+// Bytes the long path takes between scrambles
+#define XXH3_BLOCK_SIZE 1024
+
+struct xxh3_state {
+    uint64_t acc[8];
+    uint32_t cpu_features;
+};
+
+void aesgcmsiv_xxh3_init(xxh3_state* state, uint32_t cpu_features);
+
+// Whole blocks of a long input of len bytes that aesgcmsiv_xxh3_blocks may
+// take; the rest, at least one byte, is left to aesgcmsiv_xxh3_finish
+size_t aesgcmsiv_xxh3_block_count(size_t len);
+
+// Takes blocks XXH3_BLOCK_SIZE-byte blocks, continuing from the last
+void aesgcmsiv_xxh3_blocks(xxh3_state* state, const uint8_t* data, size_t blocks);
+
+// The hash of all len bytes of input, of which the first blocks_done blocks
+// went through aesgcmsiv_xxh3_blocks; the rest are read here
+uint64_t aesgcmsiv_xxh3_finish(xxh3_state* state, const uint8_t* input, size_t len, size_t blocks_done);
+
+// The hash of len bytes in one call
+uint64_t aesgcmsiv_xxh3_64(uint32_t cpu_features, const uint8_t* input, size_t len);
+
+#endif
@@ -0,0 +1,1433 @@
+// Microbenchmark for the native library. Calls the C ABI directly, so the
+// numbers leave out P/Invoke and everything managed; compare them with
+// AesGcmSiv.Benchmarks to see where time goes.
+//
+//   bench_aesgcmsiv [--sizes 16,256,...] [--aad 0,32,...] [--threads 1,2,...]
+//                   [--op encrypt|decrypt|both] [--key 16|32] [--seconds S]
+//                   [--backend NAME[,NAME...]] [--json FILE] [--profile]
+//   bench_aesgcmsiv --memory [10k,100k,1m] [--key 16|32] [--backend NAME]
+//   bench_aesgcmsiv --replay FILE [--pace recorded|max] [--key 16|32]
+//                   [--backend NAME[,NAME...]] [--profile]
+//
+// Every combination of the lists is run. Each thread encrypts or decrypts
+// its own buffers under one shared context for the given time, after a
+// short warm-up. cycles/byte is time stamp counter ticks per byte per
+// thread: on CPUs with an invariant TSC that is reference cycles, which
+// differ from core cycles while turbo or power saving is in effect. It is
+// only reported on x86.
+//
+// --backend runs on another implementation than the default, by any name
+// aesgcmsiv_select_backend takes. Given several, it runs the whole matrix
+// on each in turn and ends with a table of each one's throughput relative to
+// the first, e.g. --backend vaes-avx512,aesni,openssl to put the kernels
+// next to the crypto library's own AES-GCM-SIV. Before a backend is timed
+// it must reproduce the RFC 8452 appendix C vectors, and every size and AAD
+// size in the matrix must encrypt to the same bytes as on the first
+// backend; one that does not is reported and skipped.
+//
+// --json also writes the results to FILE in the aesgcmsiv-bench/1 schema
+// shared with AesGcmSiv.Benchmarks, whose compare mode diffs two such files.
+//
+// --profile turns on the library's phase profile (aesgcmsiv_profile_enable)
+// and, after each backend's matrix, prints where the cycles of each message
+// size went: setup, key derivation, POLYVAL, CTR, the tag, fused CTR and
+// POLYVAL, and the rest. The profile reads the counter twice per phase, so
+// the throughput of short messages is lower with it on.
+//
+// --replay runs a recording made with aesgcmsiv_record_start instead of the
+// matrix: every recorded thread gets a thread of its own, which makes its
+// calls in order with the recorded sizes, AAD sizes, batching and keys (a
+// context per recorded key_id, and a raw key where the call was given one).
+// At the recorded pace each call is made when it was made in production,
+// so the concurrency and bursts are those recorded and the latencies are
+// what matters; at maximum pace each thread makes its calls back to back,
+// which measures capacity for the same mix. Decryption runs on messages
+// sealed beforehand, up to 256 MB of them, beyond which and for recorded
+// forgeries it runs on messages that fail to authenticate, at the same
+// cost. The first row shows the latencies as recorded. Calls that failed
+// in production for other reasons than authentication are skipped.
+//
+// --memory measures footprint instead of throughput: for each count it
+// creates that many contexts, fills a key cache of that capacity, opens that
+// many streams, and starts a few pools, reporting how much resident and
+// locked memory each grew by and what creating and releasing one cost. The
+// key cache row also times inserts into the full cache, each of which evicts
+// the least recently used key. Resident memory is read from
+// /proc/self/status on Linux, the working set on Windows and the task info
+// on macOS; locked memory only on Linux, where key material is locked in
+// 128 KB slabs. Pools hold threads, so at most 64 are started whatever the
+// count.
+
+#include "aesgcmsiv.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define BENCH_HAVE_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC 1
+#endif
+
+namespace {
+
+enum class Operation { Encrypt, Decrypt };
+
+struct Options {
+    std::vector<size_t> sizes = { 16, 64, 256, 1024, 4096, 16384, 65536, 1 << 20 };
+    std::vector<size_t> aad_sizes = { 0, 32 };
+    std::vector<unsigned int> threads;
+    std::vector<Operation> operations = { Operation::Encrypt, Operation::Decrypt };
+    size_t key_len = AESGCMSIV_KEY_SIZE_256;
+    double seconds = 0.5;
+    std::vector<std::string> backends;  // empty for the default
+    const char* json_path = nullptr;
+    std::vector<size_t> memory_counts;  // --memory; empty for the throughput run
+    bool profile = false;
+    const char* replay_path = nullptr;  // --replay
+    bool max_pace = false;
+};
+
+struct Result {
+    double ops_per_second;
+    double bytes_per_second;
+    double cycles_per_byte;  // negative when there is no TSC
+};
+
+// One row of the report, kept for the JSON file
+struct Row {
+    const char* backend;
+    Operation operation;
+    size_t size;
+    size_t aad_size;
+    unsigned int threads;
+    Result result;
+};
+
+uint64_t read_tsc()
+{
+#ifdef BENCH_HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Parses "16,256,4k,1m" into byte counts
+bool parse_sizes(const char* text, std::vector<size_t>* out)
+{
+    out->clear();
+    while (*text) {
+        char* end;
+        unsigned long long value = strtoull(text, &end, 10);
+        if (end == text) {
+            return false;
+        }
+        if (*end == 'k' || *end == 'K') {
+            value <<= 10;
+            end++;
+        } else if (*end == 'm' || *end == 'M') {
+            value <<= 20;
+            end++;
+        }
+        out->push_back(static_cast<size_t>(value));
+        if (*end == ',') {
+            end++;
+        } else if (*end) {
+            return false;
+        }
+        text = end;
+    }
+    return !out->empty();
+}
+
+bool parse_threads(const char* text, std::vector<unsigned int>* out)
+{
+    std::vector<size_t> counts;
+    if (!parse_sizes(text, &counts)) {
+        return false;
+    }
+    out->clear();
+    for (size_t count : counts) {
+        if (count == 0) {
+            return false;
+        }
+        out->push_back(static_cast<unsigned int>(count));
+    }
+    return true;
+}
+
+// 1, 2, 4, ... up to the hardware thread count, which is always included
+std::vector<unsigned int> default_threads()
+{
+    unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned int> threads;
+    for (unsigned int n = 1; n < hardware; n *= 2) {
+        threads.push_back(n);
+    }
+    threads.push_back(hardware);
+    return threads;
+}
+
+bool parse_options(int argc, char** argv, Options* options)
+{
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool ok = value != nullptr;
+        if (strcmp(arg, "--profile") == 0) {
+            options->profile = true;
+            continue;
+        } else if (strcmp(arg, "--memory") == 0) {
+            // The counts are optional
+            if (!value || strncmp(value, "--", 2) == 0) {
+                options->memory_counts = { 10000, 100000, 1000000 };
+                continue;
+            }
+            ok = parse_sizes(value, &options->memory_counts) &&
+                std::find(options->memory_counts.begin(), options->memory_counts.end(), size_t(0)) ==
+                    options->memory_counts.end();
+        } else if (strcmp(arg, "--sizes") == 0) {
+            ok = ok && parse_sizes(value, &options->sizes);
+        } else if (strcmp(arg, "--aad") == 0) {
+            ok = ok && parse_sizes(value, &options->aad_sizes);
+        } else if (strcmp(arg, "--threads") == 0) {
+            ok = ok && parse_threads(value, &options->threads);
+        } else if (strcmp(arg, "--op") == 0) {
+            if (ok && strcmp(value, "encrypt") == 0) {
+                options->operations = { Operation::Encrypt };
+            } else if (ok && strcmp(value, "decrypt") == 0) {
+                options->operations = { Operation::Decrypt };
+            } else {
+                ok = ok && strcmp(value, "both") == 0;
+            }
+        } else if (strcmp(arg, "--key") == 0) {
+            options->key_len = ok ? strtoul(value, nullptr, 10) : 0;
+            ok = options->key_len == AESGCMSIV_KEY_SIZE_128 || options->key_len == AESGCMSIV_KEY_SIZE_256;
+        } else if (strcmp(arg, "--seconds") == 0) {
+            options->seconds = ok ? strtod(value, nullptr) : 0;
+            ok = options->seconds > 0;
+        } else if (strcmp(arg, "--backend") == 0) {
+            options->backends.clear();
+            for (const char* name = value; ok && *name;) {
+                const char* end = strchr(name, ',');
+                size_t length = end ? static_cast<size_t>(end - name) : strlen(name);
+                ok = length > 0;
+                options->backends.emplace_back(name, length);
+                name += end ? length + 1 : length;
+            }
+            ok = ok && !options->backends.empty();
+        } else if (strcmp(arg, "--json") == 0) {
+            options->json_path = value;
+        } else if (strcmp(arg, "--replay") == 0) {
+            options->replay_path = value;
+        } else if (strcmp(arg, "--pace") == 0) {
+            options->max_pace = ok && strcmp(value, "max") == 0;
+            ok = ok && (options->max_pace || strcmp(value, "recorded") == 0);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "bench_aesgcmsiv: bad or incomplete option %s\n", arg);
+            return false;
+        }
+        i++;
+    }
+    if (options->threads.empty()) {
+        options->threads = default_threads();
+    }
+    if (!options->memory_counts.empty() && options->json_path) {
+        fprintf(stderr, "bench_aesgcmsiv: --json does not apply to --memory\n");
+        return false;
+    }
+    if (!options->memory_counts.empty() && options->profile) {
+        fprintf(stderr, "bench_aesgcmsiv: --profile does not apply to --memory\n");
+        return false;
+    }
+    if (options->replay_path && (options->json_path || !options->memory_counts.empty())) {
+        fprintf(stderr, "bench_aesgcmsiv: --json and --memory do not apply to --replay\n");
+        return false;
+    }
+    if (!options->memory_counts.empty() && options->backends.size() > 1) {
+        fprintf(stderr, "bench_aesgcmsiv: --memory takes one backend\n");
+        return false;
+    }
+    return true;
+}
+
+// Buffers owned by one benchmark thread. Decryption needs a valid tag, so
+// the ciphertext is made up front.
+struct ThreadState {
+    std::vector<uint8_t> input;
+    std::vector<uint8_t> aad;
+    std::vector<uint8_t> output;
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    uint8_t tag[AESGCMSIV_TAG_SIZE];
+    uint64_t operations;
+    bool failed;
+};
+
+int run_once(aesgcmsiv_ctx* ctx, Operation operation, ThreadState& state)
+{
+    const uint8_t* aad = state.aad.empty() ? nullptr : state.aad.data();
+    if (operation == Operation::Encrypt) {
+        return aesgcmsiv_ctx_encrypt(ctx, state.nonce, sizeof(state.nonce),
+            state.input.data(), state.input.size(), aad, state.aad.size(),
+            state.output.data(), state.tag);
+    }
+    return aesgcmsiv_ctx_decrypt(ctx, state.nonce, sizeof(state.nonce),
+        state.input.data(), state.input.size(), aad, state.aad.size(),
+        state.tag, state.output.data());
+}
+
+bool prepare(aesgcmsiv_ctx* ctx, Operation operation, size_t size, size_t aad_size,
+    unsigned int index, ThreadState* state)
+{
+    // One spare byte keeps data() valid for empty messages
+    state->input.assign(size + 1, static_cast<uint8_t>(index));
+    state->input.resize(size);
+    state->aad.assign(aad_size, 0xa5);
+    state->output.assign(size + 1, 0);
+    state->output.resize(size);
+    memset(state->nonce, static_cast<int>(index), sizeof(state->nonce));
+    state->operations = 0;
+    state->failed = false;
+    if (operation == Operation::Decrypt) {
+        if (run_once(ctx, Operation::Encrypt, *state) != AESGCMSIV_SUCCESS) {
+            return false;
+        }
+        state->input.swap(state->output);
+    }
+    return true;
+}
+
+bool measure(aesgcmsiv_ctx* ctx, Operation operation, size_t size, size_t aad_size,
+    unsigned int thread_count, double seconds, Result* result)
+{
+    std::vector<ThreadState> states(thread_count);
+    for (unsigned int i = 0; i < thread_count; i++) {
+        if (!prepare(ctx, operation, size, aad_size, i, &states[i])) {
+            return false;
+        }
+    }
+
+    // 0: warming up, 1: measuring, 2: stop
+    std::atomic<int> phase(0);
+    std::atomic<unsigned int> ready(0);
+    auto body = [&](ThreadState* state) {
+        ready.fetch_add(1);
+        while (phase.load(std::memory_order_relaxed) == 0) {
+            run_once(ctx, operation, *state);
+        }
+        uint64_t operations = 0;
+        while (phase.load(std::memory_order_relaxed) == 1) {
+            if (run_once(ctx, operation, *state) != AESGCMSIV_SUCCESS) {
+                state->failed = true;
+            }
+            operations++;
+        }
+        state->operations = operations;
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < thread_count; i++) {
+        workers.emplace_back(body, &states[i]);
+    }
+    while (ready.load() < thread_count) {
+        std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(std::min(seconds / 5, 0.1)));
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t tsc_start = read_tsc();
+    phase.store(1);
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    phase.store(2);
+    uint64_t tsc_end = read_tsc();
+    auto end = std::chrono::steady_clock::now();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    uint64_t operations = 0;
+    for (const ThreadState& state : states) {
+        if (state.failed) {
+            return false;
+        }
+        operations += state.operations;
+    }
+    double elapsed = std::chrono::duration<double>(end - start).count();
+    double bytes = static_cast<double>(operations) * static_cast<double>(size);
+    result->ops_per_second = static_cast<double>(operations) / elapsed;
+    result->bytes_per_second = bytes / elapsed;
+#ifdef BENCH_HAVE_TSC
+    result->cycles_per_byte = bytes > 0
+        ? static_cast<double>(tsc_end - tsc_start) * thread_count / bytes
+        : 0;
+#else
+    (void)tsc_end;
+    (void)tsc_start;
+    result->cycles_per_byte = -1;
+#endif
+    return true;
+}
+
+// RFC 8452 appendix C vectors, in hex
+struct KnownAnswer {
+    const char* key;
+    const char* nonce;
+    const char* plaintext;
+    const char* aad;
+    const char* ciphertext;
+    const char* tag;
+};
+
+const KnownAnswer known_answers[] = {
+    { "01000000000000000000000000000000", "030000000000000000000000", "", "",
+        "", "dc20e2d83f25705bb49e439eca56de25" },
+    { "01000000000000000000000000000000", "030000000000000000000000", "0100000000000000", "",
+        "b5d839330ac7b786", "578782fff6013b815b287c22493a364c" },
+    { "01000000000000000000000000000000", "030000000000000000000000", "0200000000000000", "01",
+        "1e6daba35669f427", "3b0a1a2560969cdf790d99759abd1508" },
+    { "ee8e1ed9ff2540ae8f2ba9f50bc2f27c", "752abad3e0afb5f434dc4310", "48656c6c6f20776f726c64", "6578616d706c65",
+        "5d349ead175ef6b1def6fd", "4fbcdeb7e4793f4a1d7e4faa70100af1" },
+    { "0100000000000000000000000000000000000000000000000000000000000000", "030000000000000000000000", "", "",
+        "", "07f5f4169bbf55a8400cd47ea6fd400f" },
+    { "0100000000000000000000000000000000000000000000000000000000000000", "030000000000000000000000",
+        "0100000000000000", "", "c2ef328e5c71c83b", "843122130f7364b761e0b97427e3df28" },
+    { "0100000000000000000000000000000000000000000000000000000000000000", "030000000000000000000000",
+        "0200000000000000", "01", "1de22967237a8132", "91213f267e3b452f02d01ae33e4ec854" },
+};
+
+std::vector<uint8_t> from_hex(const char* hex)
+{
+    std::vector<uint8_t> bytes(strlen(hex) / 2 + 1);
+    for (size_t i = 0; i + 1 < bytes.size(); i++) {
+        char pair[3] = { hex[2 * i], hex[2 * i + 1], 0 };
+        bytes[i] = static_cast<uint8_t>(strtoul(pair, nullptr, 16));
+    }
+    // The spare byte keeps data() valid for empty values
+    bytes.pop_back();
+    return bytes;
+}
+
+// Whether the selected backend reproduces every known answer
+bool check_known_answers()
+{
+    for (const KnownAnswer& test : known_answers) {
+        std::vector<uint8_t> key = from_hex(test.key);
+        std::vector<uint8_t> nonce = from_hex(test.nonce);
+        std::vector<uint8_t> plaintext = from_hex(test.plaintext);
+        std::vector<uint8_t> aad = from_hex(test.aad);
+        std::vector<uint8_t> expected = from_hex(test.ciphertext);
+        std::vector<uint8_t> tag = from_hex(test.tag);
+        expected.insert(expected.end(), tag.begin(), tag.end());
+        std::vector<uint8_t> output(expected.size());
+        aesgcmsiv_ctx* ctx = nullptr;
+        if (aesgcmsiv_ctx_new(key.data(), key.size(), &ctx) != AESGCMSIV_SUCCESS) {
+            return false;
+        }
+        int status = aesgcmsiv_ctx_encrypt(ctx, nonce.data(), nonce.size(), plaintext.data(), plaintext.size(),
+            aad.empty() ? nullptr : aad.data(), aad.size(), output.data(), output.data() + plaintext.size());
+        aesgcmsiv_ctx_free(ctx);
+        if (status != AESGCMSIV_SUCCESS || output != expected) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Ciphertext and tag of a fixed message of each size and AAD size in the
+// matrix, to hold every backend to the first one's output
+std::vector<std::vector<uint8_t>> sample_outputs(aesgcmsiv_ctx* ctx, const Options& options)
+{
+    std::vector<std::vector<uint8_t>> outputs;
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 };
+    for (size_t aad_size : options.aad_sizes) {
+        std::vector<uint8_t> aad(aad_size + 1, 0xa5);
+        for (size_t size : options.sizes) {
+            std::vector<uint8_t> input(size + 1);
+            for (size_t i = 0; i < size; i++) {
+                input[i] = static_cast<uint8_t>(i * 31 + aad_size);
+            }
+            std::vector<uint8_t> output(size + AESGCMSIV_TAG_SIZE);
+            if (aesgcmsiv_ctx_encrypt(ctx, nonce, sizeof(nonce), input.data(), size,
+                    aad_size ? aad.data() : nullptr, aad_size, output.data(), output.data() + size) !=
+                AESGCMSIV_SUCCESS) {
+                output.clear();
+            }
+            outputs.push_back(std::move(output));
+        }
+    }
+    return outputs;
+}
+
+const char* operation_name(Operation operation)
+{
+    return operation == Operation::Encrypt ? "encrypt" : "decrypt";
+}
+
+const char* os_name()
+{
+#if defined(_WIN32)
+    return "windows";
+#elif defined(__APPLE__)
+    return "macos";
+#elif defined(__linux__)
+    return "linux";
+#else
+    return "unknown";
+#endif
+}
+
+const char* arch_name()
+{
+#if defined(_M_X64) || defined(__x86_64__)
+    return "x64";
+#elif defined(_M_IX86) || defined(__i386__)
+    return "x86";
+#elif defined(_M_ARM64) || defined(__aarch64__)
+    return "arm64";
+#else
+    return "unknown";
+#endif
+}
+
+// The CPUID brand string on x86, the "model name" line of /proc/cpuinfo
+// elsewhere on Linux
+std::string cpu_name()
+{
+    std::string name;
+#ifdef BENCH_HAVE_TSC
+    unsigned int brand[12] = {};
+    for (unsigned int leaf = 0; leaf < 3; leaf++) {
+        unsigned int* regs = brand + leaf * 4;
+#ifdef _MSC_VER
+        __cpuid(reinterpret_cast<int*>(regs), static_cast<int>(0x80000002u + leaf));
+#else
+        if (!__get_cpuid(0x80000002u + leaf, &regs[0], &regs[1], &regs[2], &regs[3])) {
+            break;
+        }
+#endif
+    }
+    name.assign(reinterpret_cast<const char*>(brand), strnlen(reinterpret_cast<const char*>(brand), sizeof(brand)));
+#elif defined(__linux__)
+    if (FILE* file = fopen("/proc/cpuinfo", "r")) {
+        char line[256];
+        while (fgets(line, sizeof(line), file)) {
+            const char* colon = strchr(line, ':');
+            if (strncmp(line, "model name", 10) == 0 && colon) {
+                name = colon + 1;
+                break;
+            }
+        }
+        fclose(file);
+    }
+#endif
+    size_t begin = name.find_first_not_of(" \t\n");
+    size_t end = name.find_last_not_of(" \t\n");
+    return begin == std::string::npos ? "unknown" : name.substr(begin, end - begin + 1);
+}
+
+void write_json_string(FILE* file, const std::string& text)
+{
+    fputc('"', file);
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            fprintf(file, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(file, "\\u%04x", c);
+        } else {
+            fputc(c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+// With several backends each result's variant names its backend, so the
+// compare mode still matches results one to one
+bool write_json(const char* path, const Options& options, const std::string& backend, uint32_t features,
+    bool several, const std::vector<Row>& rows)
+{
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        return false;
+    }
+    fprintf(file, "{\n  \"schema\": \"aesgcmsiv-bench/1\",\n  \"suite\": \"native\",\n");
+    fprintf(file, "  \"machine\": {\n    \"os\": \"%s\",\n    \"arch\": \"%s\",\n    \"cpu\": ",
+        os_name(), arch_name());
+    write_json_string(file, cpu_name());
+    fprintf(file, ",\n    \"logical_processors\": %u\n  },\n",
+        std::max(1u, std::thread::hardware_concurrency()));
+    fprintf(file, "  \"backend\": {\n    \"name\": ");
+    write_json_string(file, backend);
+    fprintf(file, ",\n    \"features\": %u\n  },\n", features);
+    fprintf(file, "  \"seconds_per_point\": %g,\n  \"results\": [", options.seconds);
+    for (size_t i = 0; i < rows.size(); i++) {
+        const Row& row = rows[i];
+        fprintf(file, "%s\n    {\"name\": \"%s\", \"variant\": \"aes-%zu%s%s\", \"size\": %zu, \"aad\": %zu, "
+            "\"threads\": %u, \"ops_per_second\": %.1f, \"bytes_per_second\": %.1f, \"cycles_per_byte\": ",
+            i ? "," : "", operation_name(row.operation), options.key_len * 8, several ? " " : "",
+            several ? row.backend : "", row.size, row.aad_size, row.threads, row.result.ops_per_second,
+            row.result.bytes_per_second);
+        if (row.result.cycles_per_byte >= 0 && row.size > 0) {
+            fprintf(file, "%.4f}", row.result.cycles_per_byte);
+        } else {
+            fprintf(file, "null}");
+        }
+    }
+    fprintf(file, "\n  ]\n}\n");
+    return fclose(file) == 0;
+}
+
+// Resident and locked memory of the process in bytes, -1 where the OS does
+// not report it
+struct MemoryUsage {
+    long long resident;
+    long long locked;
+};
+
+MemoryUsage memory_usage()
+{
+    MemoryUsage usage = { -1, -1 };
+#if defined(__linux__)
+    if (FILE* file = fopen("/proc/self/status", "r")) {
+        char line[256];
+        while (fgets(line, sizeof(line), file)) {
+            long long kb;
+            if (sscanf(line, "VmRSS: %lld kB", &kb) == 1) {
+                usage.resident = kb << 10;
+            } else if (sscanf(line, "VmLck: %lld kB", &kb) == 1) {
+                usage.locked = kb << 10;
+            }
+        }
+        fclose(file);
+    }
+#elif defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        usage.resident = static_cast<long long>(counters.WorkingSetSize);
+    }
+#elif defined(__APPLE__)
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) ==
+        KERN_SUCCESS) {
+        usage.resident = static_cast<long long>(info.resident_size);
+    }
+#endif
+    return usage;
+}
+
+// One row of the --memory report
+struct Footprint {
+    const char* object;
+    size_t count;
+    long long resident;  // growth while the objects were live, -1 if unknown
+    long long locked;
+    double create_ns;  // per object
+    double release_ns;
+    double evict_ns;  // per insert into a full key cache; negative elsewhere
+};
+
+// Tracks one measurement: usage before the objects exist and after
+class FootprintProbe {
+public:
+    FootprintProbe(const char* object, size_t count)
+        : before_(memory_usage()), start_(std::chrono::steady_clock::now())
+    {
+        row_.object = object;
+        row_.count = count;
+        row_.evict_ns = -1;
+    }
+
+    // The objects are all live
+    void created()
+    {
+        row_.create_ns = elapsed_ns() / static_cast<double>(row_.count);
+        MemoryUsage after = memory_usage();
+        row_.resident = before_.resident >= 0 ? after.resident - before_.resident : -1;
+        row_.locked = before_.locked >= 0 ? after.locked - before_.locked : -1;
+    }
+
+    void start() { start_ = std::chrono::steady_clock::now(); }
+
+    // Time since start() per object, for n objects
+    double stop(size_t n) { return elapsed_ns() / static_cast<double>(n); }
+
+    Footprint released()
+    {
+        row_.release_ns = stop(row_.count);
+        return row_;
+    }
+
+    Footprint& row() { return row_; }
+
+private:
+    double elapsed_ns() const
+    {
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_).count();
+    }
+
+    MemoryUsage before_;
+    std::chrono::steady_clock::time_point start_;
+    Footprint row_ = {};
+};
+
+// A distinct key per index
+void make_key(size_t index, uint8_t* key)
+{
+    memset(key, 0x5c, AESGCMSIV_KEY_SIZE);
+    memcpy(key, &index, sizeof(index));
+}
+
+bool measure_contexts(size_t count, size_t key_len, std::vector<Footprint>* rows)
+{
+    // Sized up front so the handle array is in the baseline
+    std::vector<aesgcmsiv_ctx*> contexts(count, nullptr);
+    uint8_t key[AESGCMSIV_KEY_SIZE];
+    FootprintProbe probe("context", count);
+    bool ok = true;
+    for (size_t i = 0; i < count && ok; i++) {
+        make_key(i, key);
+        ok = aesgcmsiv_ctx_new(key, key_len, &contexts[i]) == AESGCMSIV_SUCCESS;
+    }
+    probe.created();
+    probe.start();
+    for (aesgcmsiv_ctx* ctx : contexts) {
+        aesgcmsiv_ctx_free(ctx);
+    }
+    rows->push_back(probe.released());
+    return ok;
+}
+
+bool measure_key_cache(size_t count, size_t key_len, std::vector<Footprint>* rows)
+{
+    aesgcmsiv_key_cache* cache = nullptr;
+    uint8_t key[AESGCMSIV_KEY_SIZE];
+    FootprintProbe probe("key cache", count);
+    if (aesgcmsiv_key_cache_new(count, &cache) != AESGCMSIV_SUCCESS) {
+        return false;
+    }
+    // Each miss hands back a context too; it is freed at once so only the
+    // cache's own entries stay resident
+    auto insert = [&](size_t first) {
+        for (size_t i = first; i < first + count; i++) {
+            aesgcmsiv_ctx* ctx = nullptr;
+            make_key(i, key);
+            if (aesgcmsiv_key_cache_get(cache, key, key_len, &ctx) != AESGCMSIV_SUCCESS) {
+                return false;
+            }
+            aesgcmsiv_ctx_free(ctx);
+        }
+        return true;
+    };
+    bool ok = insert(0);
+    probe.created();
+    if (ok) {
+        probe.start();
+        ok = insert(count);
+        probe.row().evict_ns = probe.stop(count);
+    }
+    probe.start();
+    aesgcmsiv_key_cache_clear(cache);
+    rows->push_back(probe.released());
+    aesgcmsiv_key_cache_free(cache);
+    return ok;
+}
+
+bool measure_streams(size_t count, size_t key_len, std::vector<Footprint>* rows)
+{
+    std::vector<aesgcmsiv_stream*> streams(count, nullptr);
+    uint8_t key[AESGCMSIV_KEY_SIZE];
+    make_key(0, key);
+    aesgcmsiv_ctx* ctx = nullptr;
+    if (aesgcmsiv_ctx_new(key, key_len, &ctx) != AESGCMSIV_SUCCESS) {
+        return false;
+    }
+    uint8_t header[AESGCMSIV_STREAM_HEADER_SIZE];
+    FootprintProbe probe("stream", count);
+    bool ok = true;
+    for (size_t i = 0; i < count && ok; i++) {
+        ok = aesgcmsiv_stream_seal_new(ctx, 64 << 10, header, &streams[i]) == AESGCMSIV_SUCCESS;
+    }
+    probe.created();
+    probe.start();
+    for (aesgcmsiv_stream* stream : streams) {
+        aesgcmsiv_stream_free(stream);
+    }
+    rows->push_back(probe.released());
+    aesgcmsiv_ctx_free(ctx);
+    return ok;
+}
+
+bool measure_pools(size_t count, std::vector<Footprint>* rows)
+{
+    count = std::min<size_t>(count, 64);
+    std::vector<aesgcmsiv_pool*> pools(count, nullptr);
+    FootprintProbe probe("pool", count);
+    bool ok = true;
+    for (size_t i = 0; i < count && ok; i++) {
+        ok = aesgcmsiv_pool_create(2, &pools[i]) == AESGCMSIV_SUCCESS;
+    }
+    probe.created();
+    probe.start();
+    for (aesgcmsiv_pool* pool : pools) {
+        aesgcmsiv_pool_destroy(pool);
+    }
+    rows->push_back(probe.released());
+    return ok;
+}
+
+void print_footprint(const Footprint& row)
+{
+    char resident[32] = "-";
+    char per_object[32] = "-";
+    char locked[32] = "-";
+    char evict[32] = "-";
+    if (row.resident >= 0) {
+        snprintf(resident, sizeof(resident), "%.1f", static_cast<double>(row.resident) / (1024 * 1024));
+        snprintf(per_object, sizeof(per_object), "%.0f",
+            static_cast<double>(row.resident) / static_cast<double>(row.count));
+    }
+    if (row.locked >= 0) {
+        snprintf(locked, sizeof(locked), "%lld", row.locked >> 10);
+    }
+    if (row.evict_ns >= 0) {
+        snprintf(evict, sizeof(evict), "%.0f", row.evict_ns);
+    }
+    printf("%-10s %10zu %10s %10s %10s %10.0f %10.0f %10s\n",
+        row.object, row.count, resident, per_object, locked, row.create_ns, row.release_ns, evict);
+    fflush(stdout);
+}
+
+int run_memory(const Options& options)
+{
+    printf("%-10s %10s %10s %10s %10s %10s %10s %10s\n",
+        "object", "count", "rss MB", "bytes/obj", "locked KB", "create ns", "release ns", "evict ns");
+    int exit_code = 0;
+    for (size_t count : options.memory_counts) {
+        std::vector<Footprint> rows;
+        bool ok = measure_contexts(count, options.key_len, &rows) &&
+            measure_key_cache(count, options.key_len, &rows) &&
+            measure_streams(count, options.key_len, &rows) &&
+            measure_pools(count, &rows);
+        for (const Footprint& row : rows) {
+            print_footprint(row);
+        }
+        if (!ok) {
+            fprintf(stderr, "bench_aesgcmsiv: footprint of %zu objects failed\n", count);
+            exit_code = 1;
+        }
+    }
+    return exit_code;
+}
+
+// Runs the whole matrix on ctx, adding a row per point; false if any point
+// failed
+bool run_matrix(aesgcmsiv_ctx* ctx, const Options& options, const char* backend, std::vector<Row>* rows)
+{
+    printf("%-8s %10s %8s %8s %14s %12s %12s\n",
+        "op", "size", "aad", "threads", "ops/s", "MB/s", "cycles/byte");
+    bool ok = true;
+    for (Operation operation : options.operations) {
+        for (size_t aad_size : options.aad_sizes) {
+            for (size_t size : options.sizes) {
+                for (unsigned int threads : options.threads) {
+                    const char* name = operation_name(operation);
+                    Result result = {};
+                    if (!measure(ctx, operation, size, aad_size, threads, options.seconds, &result)) {
+                        fprintf(stderr, "bench_aesgcmsiv: %s of %zu bytes failed\n", name, size);
+                        ok = false;
+                        continue;
+                    }
+                    char cycles[32] = "-";
+                    if (result.cycles_per_byte >= 0 && size > 0) {
+                        snprintf(cycles, sizeof(cycles), "%.2f", result.cycles_per_byte);
+                    }
+                    printf("%-8s %10zu %8zu %8u %14.0f %12.1f %12s\n",
+                        name, size, aad_size, threads, result.ops_per_second,
+                        result.bytes_per_second / (1024 * 1024), cycles);
+                    fflush(stdout);
+                    rows->push_back({ backend, operation, size, aad_size, threads, result });
+                }
+            }
+        }
+    }
+    return ok;
+}
+
+// Where the cycles of each message size went, from the library's profile
+// since the last reset
+void print_profile(const char* backend)
+{
+    aesgcmsiv_profile profile;
+    if (aesgcmsiv_get_profile(&profile) != AESGCMSIV_SUCCESS) {
+        fprintf(stderr, "bench_aesgcmsiv: could not read the profile\n");
+        return;
+    }
+    static const char* const phases[AESGCMSIV_PROFILE_PHASES] = {
+        "setup", "derive", "polyval", "ctr", "tag", "fused", "other" };
+    printf("\n# cycles per message on %s, and their share by phase in percent\n%-8s %16s %12s %12s",
+        backend, "op", "size", "messages", "cycles/msg");
+    for (const char* phase : phases) {
+        printf(" %8s", phase);
+    }
+    printf("\n");
+    for (Operation operation : { Operation::Encrypt, Operation::Decrypt }) {
+        const aesgcmsiv_profile_bucket* buckets =
+            operation == Operation::Encrypt ? profile.encrypt : profile.decrypt;
+        for (size_t b = 0; b < AESGCMSIV_PROFILE_SIZE_BUCKETS; b++) {
+            const aesgcmsiv_profile_bucket& bucket = buckets[b];
+            if (!bucket.messages) {
+                continue;
+            }
+            char size[32];
+            if (b == 0) {
+                snprintf(size, sizeof(size), "0-16");
+            } else if (b == AESGCMSIV_PROFILE_SIZE_BUCKETS - 1) {
+                snprintf(size, sizeof(size), "> %zu", size_t(8) << b);
+            } else {
+                snprintf(size, sizeof(size), "%zu-%zu", (size_t(8) << b) + 1, size_t(16) << b);
+            }
+            uint64_t total = 0;
+            for (uint64_t cycles : bucket.cycles) {
+                total += cycles;
+            }
+            printf("%-8s %16s %12llu %12.0f", operation_name(operation), size,
+                static_cast<unsigned long long>(bucket.messages),
+                static_cast<double>(total) / static_cast<double>(bucket.messages));
+            for (uint64_t cycles : bucket.cycles) {
+                printf(" %8.1f", total ? 100.0 * static_cast<double>(cycles) / static_cast<double>(total) : 0.0);
+            }
+            printf("\n");
+        }
+    }
+}
+
+// Each backend's throughput over the first one's, point by point
+void print_relative(const std::vector<Row>& rows, const std::vector<const char*>& backends)
+{
+    printf("\n# throughput relative to %s\n%-8s %10s %8s %8s", backends[0], "op", "size", "aad", "threads");
+    for (const char* backend : backends) {
+        printf(" %14s", backend);
+    }
+    printf("\n");
+    for (const Row& base : rows) {
+        if (base.backend != backends[0]) {
+            continue;
+        }
+        printf("%-8s %10zu %8zu %8u", operation_name(base.operation), base.size, base.aad_size, base.threads);
+        for (const char* backend : backends) {
+            auto match = std::find_if(rows.begin(), rows.end(), [&](const Row& row) {
+                return row.backend == backend && row.operation == base.operation && row.size == base.size &&
+                    row.aad_size == base.aad_size && row.threads == base.threads;
+            });
+            if (match == rows.end()) {
+                printf(" %14s", "-");
+            } else {
+                printf(" %14.2f", match->result.ops_per_second / base.result.ops_per_second);
+            }
+        }
+        printf("\n");
+    }
+}
+
+// A recording from aesgcmsiv_record_start, ready to replay: the calls of each
+// recorded thread in order of time, and for decryption a valid ciphertext of
+// each size under each key
+struct Recording {
+    std::vector<std::vector<aesgcmsiv_record_entry>> threads;
+    std::vector<uint32_t> key_ids;
+    size_t calls = 0;
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+    uint64_t span_ns = 0;
+    size_t skipped = 0;  // calls that failed for other reasons than authentication
+    size_t max_size = 0;
+    size_t max_aad = 0;
+    size_t max_count = 0;
+};
+
+uint64_t get_le(const uint8_t* in, size_t bytes)
+{
+    uint64_t value = 0;
+    for (size_t i = bytes; i-- > 0;) {
+        value = value << 8 | in[i];
+    }
+    return value;
+}
+
+bool read_recording(const char* path, Recording* recording)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    uint8_t header[AESGCMSIV_RECORD_HEADER_SIZE];
+    bool ok = fread(header, sizeof(header), 1, file) == 1 && memcmp(header, AESGCMSIV_RECORD_MAGIC, 8) == 0 &&
+        get_le(header + 8, 4) == AESGCMSIV_RECORD_VERSION;
+    // Later versions may add fields after the known ones
+    size_t entry_size = ok ? static_cast<size_t>(get_le(header + 12, 4)) : 0;
+    ok = ok && entry_size >= AESGCMSIV_RECORD_ENTRY_SIZE;
+    std::vector<uint8_t> raw(entry_size);
+    while (ok && fread(raw.data(), entry_size, 1, file) == 1) {
+        const uint8_t* in = raw.data();
+        aesgcmsiv_record_entry entry;
+        entry.time_ns = get_le(in, 8);
+        entry.duration_ns = static_cast<uint32_t>(get_le(in + 8, 4));
+        entry.size = static_cast<uint32_t>(get_le(in + 12, 4));
+        entry.aad_size = static_cast<uint32_t>(get_le(in + 16, 4));
+        entry.count = static_cast<uint32_t>(get_le(in + 20, 4));
+        entry.key_id = static_cast<uint32_t>(get_le(in + 24, 4));
+        entry.thread = static_cast<uint16_t>(get_le(in + 28, 2));
+        entry.op = in[30];
+        entry.status = static_cast<int8_t>(in[31]);
+        if ((entry.status != AESGCMSIV_SUCCESS && entry.status != AESGCMSIV_ERROR_DECRYPT_FAILED) ||
+            entry.count == 0 || entry.op > AESGCMSIV_OP_DECRYPT) {
+            recording->skipped++;
+            continue;
+        }
+        if (entry.thread >= recording->threads.size()) {
+            recording->threads.resize(entry.thread + size_t(1));
+        }
+        recording->threads[entry.thread].push_back(entry);
+        if (std::find(recording->key_ids.begin(), recording->key_ids.end(), entry.key_id) ==
+            recording->key_ids.end()) {
+            recording->key_ids.push_back(entry.key_id);
+        }
+        recording->calls++;
+        recording->messages += entry.count;
+        recording->bytes += uint64_t(entry.size) * entry.count;
+        recording->span_ns = std::max<uint64_t>(recording->span_ns, entry.time_ns + entry.duration_ns);
+        recording->max_size = std::max<size_t>(recording->max_size, entry.size);
+        recording->max_aad = std::max<size_t>(recording->max_aad, entry.aad_size);
+        recording->max_count = std::max<size_t>(recording->max_count, entry.count);
+    }
+    ok = ok && !ferror(file);
+    fclose(file);
+    for (std::vector<aesgcmsiv_record_entry>& calls : recording->threads) {
+        std::stable_sort(calls.begin(), calls.end(),
+            [](const aesgcmsiv_record_entry& a, const aesgcmsiv_record_entry& b) { return a.time_ns < b.time_ns; });
+    }
+    return ok && recording->calls > 0;
+}
+
+// What one backend replays a recording on: a context per recorded key, and
+// the sealed messages decryption needs
+struct ReplaySetup {
+    size_t key_len;
+    std::vector<std::pair<uint32_t, aesgcmsiv_ctx*>> contexts;
+    std::vector<uint8_t> plaintext;
+    std::vector<uint8_t> aad;
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    // (key, size, AAD size) to ciphertext and tag. Past a budget decryption
+    // runs on messages that fail to authenticate, which cost the same.
+    std::vector<std::pair<std::tuple<uint32_t, uint32_t, uint32_t>, std::vector<uint8_t>>> sealed;
+
+    ~ReplaySetup()
+    {
+        for (auto& context : contexts) {
+            aesgcmsiv_ctx_free(context.second);
+        }
+    }
+
+    aesgcmsiv_ctx* context(uint32_t key_id) const
+    {
+        for (const auto& context : contexts) {
+            if (context.first == key_id) {
+                return context.second;
+            }
+        }
+        return nullptr;
+    }
+
+    // The ciphertext followed by the tag, or NULL
+    const std::vector<uint8_t>* find_sealed(const aesgcmsiv_record_entry& entry) const
+    {
+        auto key = std::make_tuple(entry.key_id, entry.size, entry.aad_size);
+        auto match = std::lower_bound(sealed.begin(), sealed.end(), key,
+            [](const auto& item, const auto& wanted) { return item.first < wanted; });
+        return match != sealed.end() && match->first == key ? &match->second : nullptr;
+    }
+};
+
+constexpr size_t kReplaySealedBudget = size_t(256) << 20;
+
+bool prepare_replay(const Recording& recording, size_t key_len, ReplaySetup* setup)
+{
+    setup->key_len = key_len;
+    setup->plaintext.assign(recording.max_size + 1, 0x5a);
+    setup->aad.assign(recording.max_aad + 1, 0xa5);
+    memset(setup->nonce, 0x3c, sizeof(setup->nonce));
+    uint8_t key[AESGCMSIV_KEY_SIZE];
+    for (uint32_t key_id : recording.key_ids) {
+        aesgcmsiv_ctx* ctx = nullptr;
+        make_key(key_id, key);
+        if (aesgcmsiv_ctx_new(key, key_len, &ctx) != AESGCMSIV_SUCCESS) {
+            return false;
+        }
+        setup->contexts.emplace_back(key_id, ctx);
+    }
+
+    size_t budget = kReplaySealedBudget;
+    for (const std::vector<aesgcmsiv_record_entry>& calls : recording.threads) {
+        for (const aesgcmsiv_record_entry& entry : calls) {
+            if (entry.op != AESGCMSIV_OP_DECRYPT || entry.status != AESGCMSIV_SUCCESS) {
+                continue;
+            }
+            auto key = std::make_tuple(entry.key_id, entry.size, entry.aad_size);
+            auto match = std::lower_bound(setup->sealed.begin(), setup->sealed.end(), key,
+                [](const auto& item, const auto& wanted) { return item.first < wanted; });
+            if ((match != setup->sealed.end() && match->first == key) ||
+                entry.size + AESGCMSIV_TAG_SIZE > budget) {
+                continue;
+            }
+            std::vector<uint8_t> message(entry.size + AESGCMSIV_TAG_SIZE);
+            if (aesgcmsiv_ctx_encrypt(setup->context(entry.key_id), setup->nonce, sizeof(setup->nonce),
+                    setup->plaintext.data(), entry.size, setup->aad.data(), entry.aad_size,
+                    message.data(), message.data() + entry.size) != AESGCMSIV_SUCCESS) {
+                return false;
+            }
+            budget -= message.size();
+            setup->sealed.emplace(match, key, std::move(message));
+        }
+    }
+    return true;
+}
+
+// Buffers and results of one replay thread
+struct ReplayThread {
+    std::vector<uint8_t> output;
+    std::vector<uint8_t> tags;
+    std::vector<aesgcmsiv_batch_item> items;
+    std::vector<int> status;
+    std::vector<uint64_t> latencies;
+    uint64_t max_late_ns = 0;
+    bool failed = false;
+};
+
+// Makes one recorded call as it was made: the same direction, sizes, key and
+// batching. Calls given a raw key are replayed the same way.
+bool replay_call(const ReplaySetup& setup, const aesgcmsiv_record_entry& entry, ReplayThread& state)
+{
+    const bool decrypt = entry.op == AESGCMSIV_OP_DECRYPT;
+    const std::vector<uint8_t>* sealed =
+        decrypt && entry.status == AESGCMSIV_SUCCESS ? setup.find_sealed(entry) : nullptr;
+    const uint8_t* input = sealed ? sealed->data() : setup.plaintext.data();
+    const uint8_t* aad = setup.aad.data();
+    // Unsealed messages fail with this tag, as recorded forgeries did
+    uint8_t* tag = state.tags.data();
+    if (sealed) {
+        memcpy(tag, sealed->data() + entry.size, AESGCMSIV_TAG_SIZE);
+    } else if (decrypt) {
+        memset(tag, 0, AESGCMSIV_TAG_SIZE);
+    }
+    const int expected = decrypt && !sealed ? AESGCMSIV_ERROR_DECRYPT_FAILED : AESGCMSIV_SUCCESS;
+    aesgcmsiv_ctx* ctx = setup.context(entry.key_id);
+
+    if (entry.count == 1) {
+        int result;
+        if (entry.key_id == 0) {
+            uint8_t key[AESGCMSIV_KEY_SIZE];
+            make_key(0, key);
+            result = decrypt
+                ? aesgcmsiv_decrypt(key, setup.key_len, setup.nonce, sizeof(setup.nonce), input, entry.size,
+                    aad, entry.aad_size, tag, state.output.data())
+                : aesgcmsiv_encrypt(key, setup.key_len, setup.nonce, sizeof(setup.nonce), input, entry.size,
+                    aad, entry.aad_size, state.output.data(), tag);
+        } else {
+            result = decrypt
+                ? aesgcmsiv_ctx_decrypt(ctx, setup.nonce, sizeof(setup.nonce), input, entry.size,
+                    aad, entry.aad_size, tag, state.output.data())
+                : aesgcmsiv_ctx_encrypt(ctx, setup.nonce, sizeof(setup.nonce), input, entry.size,
+                    aad, entry.aad_size, state.output.data(), tag);
+        }
+        return result == expected;
+    }
+
+    for (uint32_t i = 0; i < entry.count; i++) {
+        aesgcmsiv_batch_item& item = state.items[i];
+        item.nonce = setup.nonce;
+        item.input = input;
+        item.input_len = entry.size;
+        item.aad = aad;
+        item.aad_len = entry.aad_size;
+        item.output = state.output.data() + size_t(i) * entry.size;
+        item.tag = decrypt ? tag : state.tags.data() + size_t(i) * AESGCMSIV_TAG_SIZE;
+    }
+    if (!decrypt) {
+        return aesgcmsiv_encrypt_batch(ctx, entry.count, state.items.data()) == AESGCMSIV_SUCCESS;
+    }
+    // Returns the first item's error, which is expected of forgeries
+    aesgcmsiv_decrypt_batch(ctx, entry.count, state.items.data(), state.status.data());
+    return std::all_of(state.status.begin(), state.status.begin() + entry.count,
+        [expected](int status) { return status == expected; });
+}
+
+// The given fraction of the way through sorted latencies
+uint64_t percentile(const std::vector<uint64_t>& sorted, double fraction)
+{
+    return sorted.empty() ? 0 : sorted[std::min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()))];
+}
+
+void print_replay_row(const char* source, const Recording& recording, double seconds,
+    std::vector<uint64_t>& latencies, const char* late)
+{
+    std::sort(latencies.begin(), latencies.end());
+    printf("%-14s %12.0f %10.1f %10.1f %10.1f %10.1f %10.1f %12s\n", source,
+        static_cast<double>(recording.calls) / seconds,
+        static_cast<double>(recording.bytes) / seconds / (1024 * 1024),
+        percentile(latencies, 0.5) / 1e3, percentile(latencies, 0.99) / 1e3,
+        percentile(latencies, 0.999) / 1e3, (latencies.empty() ? 0 : latencies.back()) / 1e3, late);
+    fflush(stdout);
+}
+
+// Replays the recording once on the selected backend, each recorded thread
+// on a thread of its own
+bool replay_once(const Recording& recording, const ReplaySetup& setup, bool max_pace, const char* backend)
+{
+    std::vector<ReplayThread> states(recording.threads.size());
+    for (ReplayThread& state : states) {
+        state.output.assign(recording.max_size * recording.max_count + 1, 0);
+        state.tags.assign(recording.max_count * AESGCMSIV_TAG_SIZE, 0);
+        state.items.resize(recording.max_count);
+        state.status.resize(recording.max_count);
+    }
+
+    std::atomic<unsigned int> ready(0);
+    std::atomic<bool> go(false);
+    std::chrono::steady_clock::time_point origin;
+    auto body = [&](size_t index) {
+        ReplayThread& state = states[index];
+        state.latencies.reserve(recording.threads[index].size());
+        ready.fetch_add(1);
+        while (!go.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+        for (const aesgcmsiv_record_entry& entry : recording.threads[index]) {
+            if (!max_pace) {
+                auto due = origin + std::chrono::nanoseconds(entry.time_ns);
+                // Sleep most of the way, then spin, since sleeps overshoot
+                if (due - std::chrono::steady_clock::now() > std::chrono::microseconds(200)) {
+                    std::this_thread::sleep_until(due - std::chrono::microseconds(100));
+                }
+                while (std::chrono::steady_clock::now() < due) {
+                }
+            }
+            auto start = std::chrono::steady_clock::now();
+            if (!replay_call(setup, entry, state)) {
+                state.failed = true;
+            }
+            auto end = std::chrono::steady_clock::now();
+            state.latencies.push_back(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()));
+            if (!max_pace) {
+                uint64_t late = static_cast<uint64_t>(std::max<int64_t>(0,
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        start - origin - std::chrono::nanoseconds(entry.time_ns)).count()));
+                state.max_late_ns = std::max(state.max_late_ns, late);
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < recording.threads.size(); i++) {
+        workers.emplace_back(body, i);
+    }
+    while (ready.load() < workers.size()) {
+        std::this_thread::yield();
+    }
+    origin = std::chrono::steady_clock::now() + std::chrono::milliseconds(1);
+    go.store(true, std::memory_order_release);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - origin).count();
+
+    std::vector<uint64_t> latencies;
+    uint64_t max_late_ns = 0;
+    bool ok = true;
+    for (const ReplayThread& state : states) {
+        latencies.insert(latencies.end(), state.latencies.begin(), state.latencies.end());
+        max_late_ns = std::max(max_late_ns, state.max_late_ns);
+        ok = ok && !state.failed;
+    }
+    char late[32] = "-";
+    if (!max_pace) {
+        snprintf(late, sizeof(late), "%.1f", max_late_ns / 1e3);
+    }
+    print_replay_row(backend, recording, seconds, latencies, late);
+    return ok;
+}
+
+int run_replay(const Options& options, const std::vector<const char*>& names)
+{
+    Recording recording;
+    if (!read_recording(options.replay_path, &recording)) {
+        fprintf(stderr, "bench_aesgcmsiv: %s is not a readable recording\n", options.replay_path);
+        return 2;
+    }
+    printf("# replay of %s: %zu calls, %llu messages, %.1f MB over %.3f s on %zu threads under %zu keys",
+        options.replay_path, recording.calls, static_cast<unsigned long long>(recording.messages),
+        static_cast<double>(recording.bytes) / (1024 * 1024), recording.span_ns / 1e9,
+        recording.threads.size(), recording.key_ids.size());
+    if (recording.skipped) {
+        printf(", %zu failed calls skipped", recording.skipped);
+    }
+    printf("\n# %s pace, %zu-bit key; latencies in microseconds per call\n",
+        options.max_pace ? "maximum" : "recorded", options.key_len * 8);
+    printf("%-14s %12s %10s %10s %10s %10s %10s %12s\n",
+        "backend", "calls/s", "MB/s", "p50", "p99", "p99.9", "max", "max late");
+
+    std::vector<uint64_t> recorded;
+    for (const std::vector<aesgcmsiv_record_entry>& calls : recording.threads) {
+        for (const aesgcmsiv_record_entry& entry : calls) {
+            recorded.push_back(entry.duration_ns);
+        }
+    }
+    print_replay_row("recorded", recording, std::max(recording.span_ns, uint64_t(1)) / 1e9, recorded, "-");
+
+    int exit_code = 0;
+    for (const char* name : names) {
+        aesgcmsiv_select_backend(name);
+        const char* backend = "unknown";
+        uint32_t features = 0;
+        aesgcmsiv_get_backend(&backend, &features);
+        ReplaySetup setup;
+        if (!check_known_answers() || !prepare_replay(recording, options.key_len, &setup)) {
+            fprintf(stderr, "bench_aesgcmsiv: %s cannot replay the recording; skipped\n", backend);
+            exit_code = 1;
+            continue;
+        }
+        if (options.profile) {
+            aesgcmsiv_profile_enable(1);
+            aesgcmsiv_reset_stats();
+        }
+        if (!replay_once(recording, setup, options.max_pace, backend)) {
+            fprintf(stderr, "bench_aesgcmsiv: replay on %s had unexpected results\n", backend);
+            exit_code = 1;
+        }
+        if (options.profile) {
+            print_profile(backend);
+        }
+    }
+    return exit_code;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parse_options(argc, argv, &options)) {
+        return 2;
+    }
+
+    // NULL runs the default backend
+    std::vector<const char*> names;
+    for (const std::string& name : options.backends) {
+        names.push_back(name.c_str());
+    }
+    if (names.empty()) {
+        names.push_back(nullptr);
+    }
+    for (const char* name : names) {
+        if (name && aesgcmsiv_select_backend(name) != AESGCMSIV_SUCCESS) {
+            fprintf(stderr, "bench_aesgcmsiv: backend %s is not available\n", name);
+            return 2;
+        }
+    }
+
+    if (options.replay_path) {
+        return run_replay(options, names);
+    }
+
+    const char* backend = "unknown";
+    uint32_t features = 0;
+    if (!options.memory_counts.empty()) {
+        aesgcmsiv_select_backend(names[0]);
+        aesgcmsiv_get_backend(&backend, &features);
+        printf("# backend %s, %zu-bit key, memory footprint\n", backend, options.key_len * 8);
+        return run_memory(options);
+    }
+
+    uint8_t key[AESGCMSIV_KEY_SIZE];
+    for (size_t i = 0; i < sizeof(key); i++) {
+        key[i] = static_cast<uint8_t>(i * 7 + 1);
+    }
+    int exit_code = 0;
+    std::vector<Row> rows;
+    std::vector<const char*> measured;
+    std::vector<std::vector<uint8_t>> reference;
+    std::string backend_list;
+    for (const char* name : names) {
+        aesgcmsiv_select_backend(name);
+        aesgcmsiv_get_backend(&backend, &features);
+        if (!measured.empty()) {
+            printf("\n");
+        }
+        printf("# backend %s, %zu-bit key, %.2f s per point\n", backend, options.key_len * 8, options.seconds);
+
+        aesgcmsiv_ctx* ctx = nullptr;
+        int status = aesgcmsiv_ctx_new(key, options.key_len, &ctx);
+        if (status != AESGCMSIV_SUCCESS) {
+            // OpenSSL before 3.2 has no AES-GCM-SIV, for one
+            fprintf(stderr, "bench_aesgcmsiv: aesgcmsiv_ctx_new failed with %d on %s; skipped\n", status, backend);
+            exit_code = 1;
+            continue;
+        }
+        std::vector<std::vector<uint8_t>> outputs = sample_outputs(ctx, options);
+        if (!check_known_answers()) {
+            fprintf(stderr, "bench_aesgcmsiv: %s does not reproduce the RFC 8452 vectors; skipped\n", backend);
+            exit_code = 1;
+        } else if (!measured.empty() && outputs != reference) {
+            fprintf(stderr, "bench_aesgcmsiv: %s encrypts differently from %s; skipped\n", backend, measured[0]);
+            exit_code = 1;
+        } else {
+            if (measured.empty()) {
+                reference = std::move(outputs);
+            }
+            if (options.profile) {
+                aesgcmsiv_profile_enable(1);
+                aesgcmsiv_reset_stats();
+            }
+            if (!run_matrix(ctx, options, backend, &rows)) {
+                exit_code = 1;
+            }
+            if (options.profile) {
+                print_profile(backend);
+            }
+            measured.push_back(backend);
+            backend_list += (backend_list.empty() ? "" : ",") + std::string(backend);
+        }
+        aesgcmsiv_ctx_free(ctx);
+    }
+    if (measured.size() > 1) {
+        print_relative(rows, measured);
+    }
+
+    if (options.json_path &&
+        !write_json(options.json_path, options, backend_list, features, measured.size() > 1, rows)) {
+        fprintf(stderr, "bench_aesgcmsiv: could not write %s\n", options.json_path);
+        exit_code = 1;
+    }
+    return exit_code;
+}
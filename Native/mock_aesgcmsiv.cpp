@@ -1,9 +1,88 @@
 #include "aesgcmsiv.h"
+#include "aesgcmsiv_arrow.h"
+#include "aesgcmsiv_notify.h"
+#include "aesgcmsiv_xxh3.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <condition_variable>
 #include <cstring>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+#if defined(__linux__)
+#include <sys/socket.h>
+#endif
 
 // Mock implementation for testing - NOT for production use
 // This simulates the behavior without actual cryptography
 
+struct aesgcmsiv_ctx {
+    uint8_t key[AESGCMSIV_KEY_SIZE];
+    size_t key_len;
+    mutable std::mutex usage_lock;  // guards track_usage and usage
+    bool track_usage;
+    aesgcmsiv_key_usage usage;
+};
+
+// Counts one message on ctx, if it tracks usage; returns result
+static int count_usage(aesgcmsiv_ctx* ctx, int result, size_t bytes)
+{
+    std::lock_guard<std::mutex> guard(ctx->usage_lock);
+    if (ctx->track_usage) {
+        ctx->usage.ops++;
+        if (result == AESGCMSIV_SUCCESS) {
+            ctx->usage.bytes += bytes;
+        } else {
+            ctx->usage.failures++;
+        }
+        ctx->usage.last_used_ms = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+    }
+    return result;
+}
+
+static bool valid_key(const uint8_t* key, size_t key_len)
+{
+    return key && (key_len == AESGCMSIV_KEY_SIZE_128 || key_len == AESGCMSIV_KEY_SIZE_256);
+}
+
+// The mock gathers segmented buffers and reuses the contiguous functions
+template <typename Segment>
+static uint8_t* gather(const Segment* segs, size_t count, size_t* len_out)
+{
+    if (!segs && count > 0) {
+        return nullptr;
+    }
+    size_t len = 0;
+    for (size_t i = 0; i < count; i++) {
+        len += segs[i].len;
+    }
+    uint8_t* buffer = new (std::nothrow) uint8_t[len ? len : 1];
+    if (buffer) {
+        for (size_t i = 0, offset = 0; i < count; offset += segs[i].len, i++) {
+            if (segs[i].len) {
+                memcpy(buffer + offset, segs[i].data, segs[i].len);
+            }
+        }
+    }
+    *len_out = len;
+    return buffer;
+}
+
+static void scatter(const uint8_t* buffer, size_t len, const aesgcmsiv_iovec_out* segs, size_t count)
+{
+    for (size_t i = 0; i < count && len > 0; i++) {
+        size_t n = segs[i].len < len ? segs[i].len : len;
+        memcpy(segs[i].data, buffer, n);
+        buffer += n;
+        len -= n;
+    }
+}
+
 extern "C" {
 
 int aesgcmsiv_encrypt(
@@ -15,13 +94,16 @@ int aesgcmsiv_encrypt(
     uint8_t* tag_out)
 {
     // Validate parameters
-    if (!key || key_len != AESGCMSIV_KEY_SIZE) {
+    if (!valid_key(key, key_len)) {
         return AESGCMSIV_ERROR_INVALID_KEY;
     }
     if (!nonce || nonce_len != AESGCMSIV_NONCE_SIZE) {
         return AESGCMSIV_ERROR_INVALID_NONCE;
     }
-    if (!plaintext || !ciphertext_out || !tag_out) {
+    if (!tag_out || (plaintext_len && (!plaintext || !ciphertext_out))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (plaintext_len > AESGCMSIV_MAX_INPUT_SIZE || aad_len > AESGCMSIV_MAX_INPUT_SIZE) {
         return AESGCMSIV_ERROR_INVALID_INPUT;
     }
     if (aad && !aad_len) {
@@ -30,7 +112,7 @@ int aesgcmsiv_encrypt(
 
     // Mock encryption: XOR with a simple pattern
     for (size_t i = 0; i < plaintext_len; i++) {
-        ciphertext_out[i] = plaintext[i] ^ (key[i % 32]) ^ (nonce[i % 12]);
+        ciphertext_out[i] = plaintext[i] ^ (key[i % key_len]) ^ (nonce[i % 12]);
     }
 
     // Mock tag: simple hash-like pattern
@@ -50,13 +132,16 @@ int aesgcmsiv_decrypt(
     uint8_t* plaintext_out)
 {
     // Validate parameters
-    if (!key || key_len != AESGCMSIV_KEY_SIZE) {
+    if (!valid_key(key, key_len)) {
         return AESGCMSIV_ERROR_INVALID_KEY;
     }
     if (!nonce || nonce_len != AESGCMSIV_NONCE_SIZE) {
         return AESGCMSIV_ERROR_INVALID_NONCE;
     }
-    if (!ciphertext || !tag || !plaintext_out) {
+    if (!tag || (ciphertext_len && (!ciphertext || !plaintext_out))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (ciphertext_len > AESGCMSIV_MAX_INPUT_SIZE || aad_len > AESGCMSIV_MAX_INPUT_SIZE) {
         return AESGCMSIV_ERROR_INVALID_INPUT;
     }
     if (aad && !aad_len) {
@@ -65,13 +150,16 @@ int aesgcmsiv_decrypt(
 
     // Mock decryption: XOR with the same pattern
     for (size_t i = 0; i < ciphertext_len; i++) {
-        plaintext_out[i] = ciphertext[i] ^ (key[i % 32]) ^ (nonce[i % 12]);
+        plaintext_out[i] = ciphertext[i] ^ (key[i % key_len]) ^ (nonce[i % 12]);
     }
 
     // Mock tag verification: check if tag matches expected pattern
     for (int i = 0; i < AESGCMSIV_TAG_SIZE; i++) {
         uint8_t expected_tag = (key[i] + nonce[i % 12] + ciphertext_len) & 0xFF;
         if (tag[i] != expected_tag) {
+            if (ciphertext_len) {
+                memset(plaintext_out, 0, ciphertext_len);
+            }
             return AESGCMSIV_ERROR_DECRYPT_FAILED;
         }
     }
@@ -79,4 +167,3447 @@ int aesgcmsiv_decrypt(
     return AESGCMSIV_SUCCESS;
 }
 
+int aesgcmsiv_encrypt_small(
+    const uint8_t* key, size_t key_len,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out)
+{
+    if (plaintext_len > AESGCMSIV_SMALL_MAX_SIZE || aad_len > AESGCMSIV_SMALL_MAX_SIZE) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    return aesgcmsiv_encrypt(key, key_len, nonce, nonce_len,
+        plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out);
+}
+
+int aesgcmsiv_decrypt_small(
+    const uint8_t* key, size_t key_len,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out)
+{
+    if (ciphertext_len > AESGCMSIV_SMALL_MAX_SIZE || aad_len > AESGCMSIV_SMALL_MAX_SIZE) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    return aesgcmsiv_decrypt(key, key_len, nonce, nonce_len,
+        ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out);
+}
+
+int aesgcmsiv_seal(
+    const uint8_t* key, size_t key_len,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* sealed_out)
+{
+    if (!sealed_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    uint8_t* ciphertext = sealed_out + AESGCMSIV_NONCE_SIZE;
+    int result = aesgcmsiv_encrypt(key, key_len, nonce, nonce_len,
+        plaintext, plaintext_len, aad, aad_len, ciphertext, ciphertext + plaintext_len);
+    if (result == AESGCMSIV_SUCCESS) {
+        memmove(sealed_out, nonce, AESGCMSIV_NONCE_SIZE);
+    }
+    return result;
+}
+
+int aesgcmsiv_open(
+    const uint8_t* key, size_t key_len,
+    const uint8_t* sealed, size_t sealed_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* plaintext_out)
+{
+    if (!sealed || sealed_len < AESGCMSIV_SEAL_OVERHEAD) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    size_t ciphertext_len = sealed_len - AESGCMSIV_SEAL_OVERHEAD;
+    const uint8_t* ciphertext = sealed + AESGCMSIV_NONCE_SIZE;
+    return aesgcmsiv_decrypt(key, key_len, sealed, AESGCMSIV_NONCE_SIZE,
+        ciphertext, ciphertext_len, aad, aad_len, ciphertext + ciphertext_len, plaintext_out);
+}
+
+// Plain table codec for tokens; the mock has no vector paths
+static const char mock_b64url_chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+static void mock_b64url_encode(const uint8_t* src, size_t len, char* dst)
+{
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t group = static_cast<uint32_t>(src[i]) << 16;
+        if (i + 1 < len) {
+            group |= static_cast<uint32_t>(src[i + 1]) << 8;
+        }
+        if (i + 2 < len) {
+            group |= src[i + 2];
+        }
+        size_t chars = len - i >= 3 ? 4 : len - i + 1;
+        for (size_t j = 0; j < chars; j++) {
+            *dst++ = mock_b64url_chars[(group >> (18 - 6 * j)) & 0x3f];
+        }
+    }
+}
+
+// Strict, as the real decoder is: no padding, and no stray low bits
+static bool mock_b64url_decode(const char* src, size_t chars, std::vector<uint8_t>& out)
+{
+    if (chars % 4 == 1) {
+        return false;
+    }
+    out.clear();
+    uint32_t bits = 0;
+    int pending = 0;
+    for (size_t i = 0; i < chars; i++) {
+        const char* found = src[i] ? strchr(mock_b64url_chars, src[i]) : nullptr;
+        if (!found) {
+            return false;
+        }
+        bits = bits << 6 | static_cast<uint32_t>(found - mock_b64url_chars);
+        pending += 6;
+        if (pending >= 8) {
+            pending -= 8;
+            out.push_back(static_cast<uint8_t>(bits >> pending));
+            bits &= (1u << pending) - 1;
+        }
+    }
+    return bits == 0;
+}
+
+int aesgcmsiv_seal_b64url(
+    const uint8_t* key, size_t key_len,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    char* token_out,
+    size_t* token_len_out)
+{
+    if (!token_out || !token_len_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::vector<uint8_t> sealed(plaintext_len + AESGCMSIV_SEAL_OVERHEAD);
+    int result = aesgcmsiv_seal(key, key_len, nonce, nonce_len,
+        plaintext, plaintext_len, aad, aad_len, sealed.data());
+    if (result == AESGCMSIV_SUCCESS) {
+        mock_b64url_encode(sealed.data(), sealed.size(), token_out);
+        *token_len_out = AESGCMSIV_B64URL_LEN(sealed.size());
+    }
+    return result;
+}
+
+int aesgcmsiv_open_b64url(
+    const uint8_t* key, size_t key_len,
+    const char* token, size_t token_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* plaintext_out,
+    size_t* plaintext_len_out)
+{
+    std::vector<uint8_t> sealed;
+    if (!token || !plaintext_len_out || !mock_b64url_decode(token, token_len, sealed) ||
+        sealed.size() < AESGCMSIV_SEAL_OVERHEAD) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    int result = aesgcmsiv_open(key, key_len, sealed.data(), sealed.size(), aad, aad_len, plaintext_out);
+    if (result == AESGCMSIV_SUCCESS) {
+        *plaintext_len_out = sealed.size() - AESGCMSIV_SEAL_OVERHEAD;
+    }
+    return result;
+}
+
+int aesgcmsiv_encryptv(
+    const uint8_t* key, size_t key_len,
+    const uint8_t* nonce, size_t nonce_len,
+    const aesgcmsiv_iovec* plaintext, size_t plaintext_count,
+    const aesgcmsiv_iovec* aad, size_t aad_count,
+    const aesgcmsiv_iovec_out* ciphertext_out, size_t ciphertext_count,
+    uint8_t* tag_out)
+{
+    size_t plaintext_len, aad_len, capacity;
+    uint8_t* pt = gather(plaintext, plaintext_count, &plaintext_len);
+    uint8_t* ad = gather(aad, aad_count, &aad_len);
+    uint8_t* ct = gather(ciphertext_out, ciphertext_count, &capacity);
+    int result = AESGCMSIV_ERROR_INVALID_INPUT;
+    if (pt && ad && ct && capacity >= plaintext_len) {
+        result = aesgcmsiv_encrypt(key, key_len, nonce, nonce_len,
+            pt, plaintext_len, aad_len ? ad : nullptr, aad_len, ct, tag_out);
+        if (result == AESGCMSIV_SUCCESS) {
+            scatter(ct, plaintext_len, ciphertext_out, ciphertext_count);
+        }
+    }
+    delete[] pt;
+    delete[] ad;
+    delete[] ct;
+    return result;
+}
+
+int aesgcmsiv_decryptv(
+    const uint8_t* key, size_t key_len,
+    const uint8_t* nonce, size_t nonce_len,
+    const aesgcmsiv_iovec* ciphertext, size_t ciphertext_count,
+    const aesgcmsiv_iovec* aad, size_t aad_count,
+    const uint8_t* tag,
+    const aesgcmsiv_iovec_out* plaintext_out, size_t plaintext_count)
+{
+    size_t ciphertext_len, aad_len, capacity;
+    uint8_t* ct = gather(ciphertext, ciphertext_count, &ciphertext_len);
+    uint8_t* ad = gather(aad, aad_count, &aad_len);
+    uint8_t* pt = gather(plaintext_out, plaintext_count, &capacity);
+    int result = AESGCMSIV_ERROR_INVALID_INPUT;
+    if (ct && ad && pt && capacity >= ciphertext_len) {
+        result = aesgcmsiv_decrypt(key, key_len, nonce, nonce_len,
+            ct, ciphertext_len, aad_len ? ad : nullptr, aad_len, tag, pt);
+        if (result == AESGCMSIV_SUCCESS || result == AESGCMSIV_ERROR_DECRYPT_FAILED) {
+            scatter(pt, ciphertext_len, plaintext_out, plaintext_count);
+        }
+    }
+    delete[] ct;
+    delete[] ad;
+    delete[] pt;
+    return result;
+}
+
+int aesgcmsiv_ctx_new(
+    const uint8_t* key, size_t key_len,
+    aesgcmsiv_ctx** ctx_out)
+{
+    if (!ctx_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *ctx_out = nullptr;
+    if (!valid_key(key, key_len)) {
+        return AESGCMSIV_ERROR_INVALID_KEY;
+    }
+
+    aesgcmsiv_ctx* ctx = new (std::nothrow) aesgcmsiv_ctx();
+    if (!ctx) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    memcpy(ctx->key, key, key_len);
+    ctx->key_len = key_len;
+    *ctx_out = ctx;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_ctx_new_ex(
+    const uint8_t* key, size_t key_len,
+    const char* provider, const char* properties,
+    aesgcmsiv_ctx** ctx_out)
+{
+    // The mock has no providers to select from
+    (void)provider;
+    (void)properties;
+    return aesgcmsiv_ctx_new(key, key_len, ctx_out);
+}
+
+int aesgcmsiv_ctx_encrypt(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out)
+{
+    if (!ctx) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    return count_usage(ctx, aesgcmsiv_encrypt(ctx->key, ctx->key_len, nonce, nonce_len,
+        plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out), plaintext_len);
+}
+
+int aesgcmsiv_ctx_encrypt_hashed(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out,
+    uint64_t* hash_out)
+{
+    if (!hash_out || (plaintext_len > 0 && !plaintext)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    // Hashed first, as ciphertext_out may be plaintext
+    uint64_t hash = aesgcmsiv_xxh3_64(0, plaintext, plaintext_len);
+    int result = aesgcmsiv_ctx_encrypt(ctx, nonce, nonce_len,
+        plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out);
+    if (result == AESGCMSIV_SUCCESS) {
+        *hash_out = hash;
+    }
+    return result;
+}
+
+int aesgcmsiv_ctx_decrypt(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out)
+{
+    if (!ctx) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    return count_usage(ctx, aesgcmsiv_decrypt(ctx->key, ctx->key_len, nonce, nonce_len,
+        ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out), ciphertext_len);
+}
+
+int aesgcmsiv_ctx_authenticate(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* tag_out)
+{
+    return aesgcmsiv_ctx_encrypt(ctx, nonce, nonce_len, nullptr, 0, aad, aad_len, nullptr, tag_out);
+}
+
+int aesgcmsiv_ctx_verify(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag)
+{
+    return aesgcmsiv_ctx_decrypt(ctx, nonce, nonce_len, nullptr, 0, aad, aad_len, tag, nullptr);
+}
+
+int aesgcmsiv_ctx_verify_ciphertext(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag)
+{
+    std::vector<uint8_t> scratch(ciphertext_len);
+    return aesgcmsiv_ctx_decrypt(ctx, nonce, nonce_len, ciphertext, ciphertext_len,
+        aad, aad_len, tag, ciphertext_len ? scratch.data() : nullptr);
+}
+
+int aesgcmsiv_open_trial(
+    aesgcmsiv_ctx* const* ctxs, size_t count,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out,
+    size_t* index_out)
+{
+    if (index_out) {
+        *index_out = count;
+    }
+    if (count == 0 || !ctxs) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    int result = AESGCMSIV_ERROR_DECRYPT_FAILED;
+    for (size_t i = 0; i < count && result == AESGCMSIV_ERROR_DECRYPT_FAILED; i++) {
+        result = aesgcmsiv_ctx_verify_ciphertext(ctxs[i], nonce, nonce_len,
+            ciphertext, ciphertext_len, aad, aad_len, tag);
+        if (result == AESGCMSIV_SUCCESS) {
+            result = aesgcmsiv_ctx_decrypt(ctxs[i], nonce, nonce_len,
+                ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out);
+            if (result == AESGCMSIV_SUCCESS && index_out) {
+                *index_out = i;
+            }
+        }
+    }
+    if (result == AESGCMSIV_ERROR_DECRYPT_FAILED && plaintext_out) {
+        memset(plaintext_out, 0, ciphertext_len);
+    }
+    return result;
+}
+
+struct aesgcmsiv_ctx_msg {
+    aesgcmsiv_ctx* ctx;
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    std::vector<uint8_t> aad;
+    std::vector<uint8_t> body;  // absorbed plaintext, then its ciphertext
+    size_t emitted;
+    bool tagged;
+    bool finished;
+};
+
+int aesgcmsiv_ctx_begin(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    aesgcmsiv_ctx_msg** msg_out)
+{
+    if (!msg_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *msg_out = nullptr;
+    if (!ctx) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (!nonce || nonce_len != AESGCMSIV_NONCE_SIZE) {
+        return AESGCMSIV_ERROR_INVALID_NONCE;
+    }
+    aesgcmsiv_ctx_msg* msg = new (std::nothrow) aesgcmsiv_ctx_msg();
+    if (!msg) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    msg->ctx = ctx;
+    memcpy(msg->nonce, nonce, AESGCMSIV_NONCE_SIZE);
+    *msg_out = msg;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_ctx_aad_update(aesgcmsiv_ctx_msg* msg, const uint8_t* aad, size_t aad_len)
+{
+    if (!msg || msg->finished || (!aad && aad_len)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (aad_len) {
+        msg->aad.insert(msg->aad.end(), aad, aad + aad_len);
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_ctx_seal(
+    aesgcmsiv_ctx_msg* msg,
+    const uint8_t* plaintext, size_t plaintext_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out)
+{
+    if (!msg || msg->finished) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    msg->finished = true;
+    return aesgcmsiv_ctx_encrypt(msg->ctx, msg->nonce, AESGCMSIV_NONCE_SIZE, plaintext, plaintext_len,
+        msg->aad.empty() ? nullptr : msg->aad.data(), msg->aad.size(), ciphertext_out, tag_out);
+}
+
+int aesgcmsiv_ctx_open(
+    aesgcmsiv_ctx_msg* msg,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out)
+{
+    if (!msg || msg->finished) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    msg->finished = true;
+    return aesgcmsiv_ctx_decrypt(msg->ctx, msg->nonce, AESGCMSIV_NONCE_SIZE, ciphertext, ciphertext_len,
+        msg->aad.empty() ? nullptr : msg->aad.data(), msg->aad.size(), tag, plaintext_out);
+}
+
+int aesgcmsiv_ctx_absorb_plaintext(aesgcmsiv_ctx_msg* msg, const uint8_t* plaintext, size_t plaintext_len)
+{
+    if (!msg || msg->finished || msg->tagged || (!plaintext && plaintext_len)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (plaintext_len) {
+        msg->body.insert(msg->body.end(), plaintext, plaintext + plaintext_len);
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_ctx_finalize_tag(aesgcmsiv_ctx_msg* msg, uint8_t* tag_out)
+{
+    if (!msg || msg->finished || msg->tagged || !tag_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    msg->tagged = true;
+    msg->finished = msg->body.empty();
+    return aesgcmsiv_ctx_encrypt(msg->ctx, msg->nonce, AESGCMSIV_NONCE_SIZE,
+        msg->body.empty() ? nullptr : msg->body.data(), msg->body.size(),
+        msg->aad.empty() ? nullptr : msg->aad.data(), msg->aad.size(),
+        msg->body.empty() ? nullptr : msg->body.data(), tag_out);
+}
+
+int aesgcmsiv_ctx_emit_ciphertext(
+    aesgcmsiv_ctx_msg* msg,
+    const uint8_t* plaintext, size_t plaintext_len,
+    uint8_t* ciphertext_out)
+{
+    if (!msg || msg->finished || !msg->tagged || (plaintext_len && (!plaintext || !ciphertext_out))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (plaintext_len > msg->body.size() - msg->emitted) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (plaintext_len) {
+        memcpy(ciphertext_out, msg->body.data() + msg->emitted, plaintext_len);
+        msg->emitted += plaintext_len;
+    }
+    msg->finished = msg->emitted == msg->body.size();
+    return AESGCMSIV_SUCCESS;
+}
+
+void aesgcmsiv_ctx_msg_free(aesgcmsiv_ctx_msg* msg)
+{
+    delete msg;
+}
+
+int aesgcmsiv_ctx_encrypt_small(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out)
+{
+    if (!ctx) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    return aesgcmsiv_encrypt_small(ctx->key, ctx->key_len, nonce, nonce_len,
+        plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out);
+}
+
+int aesgcmsiv_ctx_decrypt_small(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out)
+{
+    if (!ctx) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    return aesgcmsiv_decrypt_small(ctx->key, ctx->key_len, nonce, nonce_len,
+        ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out);
+}
+
+int aesgcmsiv_ctx_encrypt_unchecked(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out)
+{
+    return aesgcmsiv_ctx_encrypt(ctx, nonce, AESGCMSIV_NONCE_SIZE,
+        plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out);
+}
+
+int aesgcmsiv_ctx_encrypt_small_unchecked(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out)
+{
+    return aesgcmsiv_ctx_encrypt_small(ctx, nonce, AESGCMSIV_NONCE_SIZE,
+        plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out);
+}
+
+int aesgcmsiv_ctx_decrypt_unchecked(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out)
+{
+    return aesgcmsiv_ctx_decrypt(ctx, nonce, AESGCMSIV_NONCE_SIZE,
+        ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out);
+}
+
+int aesgcmsiv_ctx_decrypt_small_unchecked(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out)
+{
+    return aesgcmsiv_ctx_decrypt_small(ctx, nonce, AESGCMSIV_NONCE_SIZE,
+        ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out);
+}
+
+int aesgcmsiv_ctx_encryptv(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const aesgcmsiv_iovec* plaintext, size_t plaintext_count,
+    const aesgcmsiv_iovec* aad, size_t aad_count,
+    const aesgcmsiv_iovec_out* ciphertext_out, size_t ciphertext_count,
+    uint8_t* tag_out)
+{
+    if (!ctx) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    return aesgcmsiv_encryptv(ctx->key, ctx->key_len, nonce, nonce_len,
+        plaintext, plaintext_count, aad, aad_count, ciphertext_out, ciphertext_count, tag_out);
+}
+
+int aesgcmsiv_ctx_decryptv(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const aesgcmsiv_iovec* ciphertext, size_t ciphertext_count,
+    const aesgcmsiv_iovec* aad, size_t aad_count,
+    const uint8_t* tag,
+    const aesgcmsiv_iovec_out* plaintext_out, size_t plaintext_count)
+{
+    if (!ctx) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    return aesgcmsiv_decryptv(ctx->key, ctx->key_len, nonce, nonce_len,
+        ciphertext, ciphertext_count, aad, aad_count, tag, plaintext_out, plaintext_count);
+}
+
+int aesgcmsiv_ctx_set_threads(aesgcmsiv_ctx* ctx, unsigned int threads)
+{
+    (void)threads;
+    return ctx ? AESGCMSIV_SUCCESS : AESGCMSIV_ERROR_INVALID_INPUT;
+}
+
+int aesgcmsiv_ctx_set_streaming(aesgcmsiv_ctx* ctx, size_t min_bytes)
+{
+    (void)min_bytes;
+    return ctx ? AESGCMSIV_SUCCESS : AESGCMSIV_ERROR_INVALID_INPUT;
+}
+
+int aesgcmsiv_ctx_set_wide_min(aesgcmsiv_ctx* ctx, size_t min_bytes)
+{
+    (void)min_bytes;
+    return ctx ? AESGCMSIV_SUCCESS : AESGCMSIV_ERROR_INVALID_INPUT;
+}
+
+int aesgcmsiv_encrypt_batch(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    const aesgcmsiv_batch_item* items)
+{
+    if (!ctx || (count > 0 && !items)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    for (size_t i = 0; i < count; i++) {
+        const aesgcmsiv_batch_item& item = items[i];
+        int result = aesgcmsiv_ctx_encrypt(ctx,
+            item.nonce, AESGCMSIV_NONCE_SIZE,
+            item.input, item.input_len,
+            item.aad, item.aad_len,
+            item.output, item.tag);
+        if (result != AESGCMSIV_SUCCESS) {
+            return result;
+        }
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_decrypt_batch(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    int* status_out)
+{
+    if (!ctx || (count > 0 && (!items || !status_out))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    int first_failure = AESGCMSIV_SUCCESS;
+    for (size_t i = 0; i < count; i++) {
+        const aesgcmsiv_batch_item& item = items[i];
+        status_out[i] = aesgcmsiv_ctx_decrypt(ctx,
+            item.nonce, AESGCMSIV_NONCE_SIZE,
+            item.input, item.input_len,
+            item.aad, item.aad_len,
+            item.tag, item.output);
+        if (status_out[i] != AESGCMSIV_SUCCESS && first_failure == AESGCMSIV_SUCCESS) {
+            first_failure = status_out[i];
+        }
+    }
+    return first_failure;
+}
+
+int aesgcmsiv_verify_batch(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    int* status_out)
+{
+    if (!ctx || (count > 0 && (!items || !status_out))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    int first_failure = AESGCMSIV_SUCCESS;
+    for (size_t i = 0; i < count; i++) {
+        const aesgcmsiv_batch_item& item = items[i];
+        status_out[i] = aesgcmsiv_ctx_verify_ciphertext(ctx,
+            item.nonce, AESGCMSIV_NONCE_SIZE,
+            item.input, item.input_len,
+            item.aad, item.aad_len,
+            item.tag);
+        if (status_out[i] != AESGCMSIV_SUCCESS && first_failure == AESGCMSIV_SUCCESS) {
+            first_failure = status_out[i];
+        }
+    }
+    return first_failure;
+}
+
+// Item i's nonce, as the real library derives it
+static void counter_nonce(const uint8_t* base, uint64_t counter, uint8_t* nonce)
+{
+    memcpy(nonce, base, AESGCMSIV_NONCE_SIZE);
+    for (int b = 0; b < 8; b++) {
+        nonce[4 + b] ^= static_cast<uint8_t>(counter >> (8 * b));
+    }
+}
+
+int aesgcmsiv_encrypt_batch_counter(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const uint8_t* base_nonce,
+    uint64_t first_counter)
+{
+    if (!ctx || (count > 0 && !items) || !base_nonce) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    for (size_t i = 0; i < count; i++) {
+        aesgcmsiv_batch_item item = items[i];
+        counter_nonce(base_nonce, first_counter + i, nonce);
+        item.nonce = nonce;
+        int result = aesgcmsiv_encrypt_batch(ctx, 1, &item);
+        if (result != AESGCMSIV_SUCCESS) {
+            return result;
+        }
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_decrypt_batch_counter(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const uint8_t* base_nonce,
+    uint64_t first_counter,
+    int* status_out)
+{
+    if (!ctx || (count > 0 && (!items || !status_out)) || !base_nonce) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    int first_failure = AESGCMSIV_SUCCESS;
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    for (size_t i = 0; i < count; i++) {
+        aesgcmsiv_batch_item item = items[i];
+        counter_nonce(base_nonce, first_counter + i, nonce);
+        item.nonce = nonce;
+        aesgcmsiv_decrypt_batch(ctx, 1, &item, &status_out[i]);
+        if (status_out[i] != AESGCMSIV_SUCCESS && first_failure == AESGCMSIV_SUCCESS) {
+            first_failure = status_out[i];
+        }
+    }
+    return first_failure;
+}
+
+int aesgcmsiv_encrypt_batch_shared_aad(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const uint8_t* aad,
+    size_t aad_len)
+{
+    if (!ctx || (count > 0 && !items) || (!aad && aad_len > 0)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    for (size_t i = 0; i < count; i++) {
+        aesgcmsiv_batch_item item = items[i];
+        item.aad = aad;
+        item.aad_len = aad_len;
+        int result = aesgcmsiv_encrypt_batch(ctx, 1, &item);
+        if (result != AESGCMSIV_SUCCESS) {
+            return result;
+        }
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_decrypt_batch_shared_aad(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const uint8_t* aad,
+    size_t aad_len,
+    int* status_out)
+{
+    if (!ctx || (count > 0 && (!items || !status_out)) || (!aad && aad_len > 0)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    int first_failure = AESGCMSIV_SUCCESS;
+    for (size_t i = 0; i < count; i++) {
+        aesgcmsiv_batch_item item = items[i];
+        item.aad = aad;
+        item.aad_len = aad_len;
+        aesgcmsiv_decrypt_batch(ctx, 1, &item, &status_out[i]);
+        if (status_out[i] != AESGCMSIV_SUCCESS && first_failure == AESGCMSIV_SUCCESS) {
+            first_failure = status_out[i];
+        }
+    }
+    return first_failure;
+}
+
+// Page i as a batch item, as the real library builds it
+static aesgcmsiv_batch_item mock_page_item(
+    uint8_t* base, size_t page_size, size_t aad_len, const uint8_t* tags, size_t i, const uint8_t* nonce)
+{
+    uint8_t* page = base + i * page_size;
+    aesgcmsiv_batch_item item;
+    item.nonce = nonce;
+    item.input = page + aad_len;
+    item.input_len = page_size - aad_len;
+    item.aad = page;
+    item.aad_len = aad_len;
+    item.output = page + aad_len;
+    item.tag = const_cast<uint8_t*>(tags) + i * AESGCMSIV_TAG_SIZE;
+    return item;
+}
+
+int aesgcmsiv_encrypt_pages(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* base_nonce,
+    uint8_t* base,
+    size_t page_size,
+    size_t count,
+    uint64_t first_page_no,
+    size_t aad_len,
+    uint8_t* tags_out)
+{
+    if (!ctx || !base_nonce || aad_len > page_size || (count > 0 && (!base || !tags_out))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    for (size_t i = 0; i < count; i++) {
+        counter_nonce(base_nonce, first_page_no + i, nonce);
+        aesgcmsiv_batch_item item = mock_page_item(base, page_size, aad_len, tags_out, i, nonce);
+        int result = aesgcmsiv_encrypt_batch(ctx, 1, &item);
+        if (result != AESGCMSIV_SUCCESS) {
+            return result;
+        }
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_decrypt_pages(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* base_nonce,
+    uint8_t* base,
+    size_t page_size,
+    size_t count,
+    uint64_t first_page_no,
+    size_t aad_len,
+    const uint8_t* tags,
+    int* status_out)
+{
+    if (!ctx || !base_nonce || aad_len > page_size || (count > 0 && (!base || !tags || !status_out))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    int first_failure = AESGCMSIV_SUCCESS;
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    for (size_t i = 0; i < count; i++) {
+        counter_nonce(base_nonce, first_page_no + i, nonce);
+        aesgcmsiv_batch_item item = mock_page_item(base, page_size, aad_len, tags, i, nonce);
+        aesgcmsiv_decrypt_batch(ctx, 1, &item, &status_out[i]);
+        if (status_out[i] != AESGCMSIV_SUCCESS && first_failure == AESGCMSIV_SUCCESS) {
+            first_failure = status_out[i];
+        }
+    }
+    return first_failure;
+}
+
+static int64_t mock_column_offset(const void* offsets, size_t offset_size, size_t i)
+{
+    return offset_size == 4
+        ? static_cast<const int32_t*>(offsets)[i]
+        : static_cast<const int64_t*>(offsets)[i];
+}
+
+static bool mock_column_valid(const void* offsets, size_t offset_size, size_t count)
+{
+    if (!offsets || (offset_size != 4 && offset_size != 8) || mock_column_offset(offsets, offset_size, 0) < 0) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (mock_column_offset(offsets, offset_size, i + 1) < mock_column_offset(offsets, offset_size, i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int aesgcmsiv_encrypt_column(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* base_nonce,
+    uint64_t first_row,
+    size_t count,
+    const uint8_t* values,
+    const void* offsets,
+    size_t offset_size,
+    uint8_t* values_out,
+    uint8_t* tags_out)
+{
+    if (!ctx || !base_nonce || !mock_column_valid(offsets, offset_size, count) ||
+        (count > 0 && (!values || !values_out || !tags_out))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    for (size_t i = 0; i < count; i++) {
+        int64_t begin = mock_column_offset(offsets, offset_size, i);
+        size_t len = static_cast<size_t>(mock_column_offset(offsets, offset_size, i + 1) - begin);
+        counter_nonce(base_nonce, first_row + i, nonce);
+        aesgcmsiv_batch_item item = {
+            nonce, values + begin, len, nullptr, 0, values_out + begin, tags_out + i * AESGCMSIV_TAG_SIZE};
+        int result = aesgcmsiv_encrypt_batch(ctx, 1, &item);
+        if (result != AESGCMSIV_SUCCESS) {
+            return result;
+        }
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_column_encrypt_packed(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* base_nonce,
+    uint64_t first_row,
+    size_t count,
+    const uint8_t* values,
+    const void* offsets,
+    size_t offset_size,
+    bool tags_appended,
+    uint8_t* values_out,
+    uint8_t* tags_out)
+{
+    if (!ctx || !base_nonce || !mock_column_valid(offsets, offset_size, count) ||
+        (count > 0 && (!values || !values_out || (!tags_out && !tags_appended)))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    const int64_t base = mock_column_offset(offsets, offset_size, 0);
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    for (size_t i = 0; i < count; i++) {
+        int64_t begin = mock_column_offset(offsets, offset_size, i);
+        size_t len = static_cast<size_t>(mock_column_offset(offsets, offset_size, i + 1) - begin);
+        uint8_t* output = values_out + (begin - base) + (tags_appended ? i * AESGCMSIV_TAG_SIZE : 0);
+        counter_nonce(base_nonce, first_row + i, nonce);
+        aesgcmsiv_batch_item item = {
+            nonce, values + begin, len, nullptr, 0, output,
+            tags_appended ? output + len : tags_out + i * AESGCMSIV_TAG_SIZE};
+        int result = aesgcmsiv_encrypt_batch(ctx, 1, &item);
+        if (result != AESGCMSIV_SUCCESS) {
+            return result;
+        }
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_decrypt_column(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* base_nonce,
+    uint64_t first_row,
+    size_t count,
+    const uint8_t* values,
+    const void* offsets,
+    size_t offset_size,
+    const uint8_t* tags,
+    uint8_t* values_out,
+    int* status_out)
+{
+    if (!ctx || !base_nonce || !mock_column_valid(offsets, offset_size, count) ||
+        (count > 0 && (!values || !tags || !values_out || !status_out))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    int first_failure = AESGCMSIV_SUCCESS;
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    for (size_t i = 0; i < count; i++) {
+        int64_t begin = mock_column_offset(offsets, offset_size, i);
+        size_t len = static_cast<size_t>(mock_column_offset(offsets, offset_size, i + 1) - begin);
+        counter_nonce(base_nonce, first_row + i, nonce);
+        aesgcmsiv_batch_item item = {
+            nonce, values + begin, len, nullptr, 0, values_out + begin,
+            const_cast<uint8_t*>(tags) + i * AESGCMSIV_TAG_SIZE};
+        aesgcmsiv_decrypt_batch(ctx, 1, &item, &status_out[i]);
+        if (status_out[i] != AESGCMSIV_SUCCESS && first_failure == AESGCMSIV_SUCCESS) {
+            first_failure = status_out[i];
+        }
+    }
+    return first_failure;
+}
+
+// Decrypts into a temporary buffer and encrypts from it, leaving the outputs
+// alone unless the record verifies, as the real library does
+int aesgcmsiv_reencrypt(
+    aesgcmsiv_ctx* old_ctx,
+    aesgcmsiv_ctx* new_ctx,
+    const uint8_t* nonce,
+    const uint8_t* new_nonce,
+    const uint8_t* ciphertext,
+    size_t ciphertext_len,
+    const uint8_t* aad,
+    size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out)
+{
+    if (!old_ctx || !new_ctx || !tag_out || (!ciphertext_out && ciphertext_len > 0)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::vector<uint8_t> plaintext(ciphertext_len + 1);
+    aesgcmsiv_batch_item item;
+    item.nonce = nonce;
+    item.input = ciphertext;
+    item.input_len = ciphertext_len;
+    item.aad = aad;
+    item.aad_len = aad_len;
+    item.output = plaintext.data();
+    item.tag = const_cast<uint8_t*>(tag);
+    int status = AESGCMSIV_SUCCESS;
+    int result = aesgcmsiv_decrypt_batch(old_ctx, 1, &item, &status);
+    if (result != AESGCMSIV_SUCCESS) {
+        return result;
+    }
+    uint8_t new_tag[AESGCMSIV_TAG_SIZE];
+    item.nonce = new_nonce ? new_nonce : nonce;
+    item.input = plaintext.data();
+    item.output = ciphertext_out;
+    item.tag = new_tag;
+    result = aesgcmsiv_encrypt_batch(new_ctx, 1, &item);
+    if (result == AESGCMSIV_SUCCESS) {
+        memcpy(tag_out, new_tag, sizeof(new_tag));
+    }
+    return result;
+}
+
+int aesgcmsiv_reencrypt_batch(
+    aesgcmsiv_ctx* old_ctx,
+    aesgcmsiv_ctx* new_ctx,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const uint8_t* new_nonces,
+    int* status_out)
+{
+    if (!old_ctx || !new_ctx || (count > 0 && (!items || !status_out))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    int first_failure = AESGCMSIV_SUCCESS;
+    for (size_t i = 0; i < count; i++) {
+        const aesgcmsiv_batch_item& item = items[i];
+        status_out[i] = aesgcmsiv_reencrypt(
+            old_ctx, new_ctx, item.nonce, new_nonces ? new_nonces + i * AESGCMSIV_NONCE_SIZE : nullptr,
+            item.input, item.input_len, item.aad, item.aad_len, item.tag, item.output, item.tag);
+        if (status_out[i] != AESGCMSIV_SUCCESS && first_failure == AESGCMSIV_SUCCESS) {
+            first_failure = status_out[i];
+        }
+    }
+    return first_failure;
+}
+
+int aesgcmsiv_encrypt_multikey(
+    size_t count,
+    const uint8_t* keys, size_t key_len,
+    const uint8_t* nonces,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* const* ciphertexts_out,
+    uint8_t* tags_out)
+{
+    if (count > 0 && (!keys || !nonces || !ciphertexts_out || !tags_out)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    for (size_t i = 0; i < count; i++) {
+        int result = aesgcmsiv_encrypt(keys + i * key_len, key_len,
+            nonces + i * AESGCMSIV_NONCE_SIZE, AESGCMSIV_NONCE_SIZE,
+            plaintext, plaintext_len, aad, aad_len,
+            ciphertexts_out[i], tags_out + i * AESGCMSIV_TAG_SIZE);
+        if (result != AESGCMSIV_SUCCESS) {
+            return result;
+        }
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+// One mock context per set slot; the mock never shares a table
+struct aesgcmsiv_key_table {
+    size_t slots;
+    aesgcmsiv_ctx** contexts;
+    bool sealed;
+};
+
+static aesgcmsiv_ctx* key_slot(const aesgcmsiv_key_table* table, uint32_t slot)
+{
+    return slot < table->slots ? table->contexts[slot] : nullptr;
+}
+
+int aesgcmsiv_key_table_new(size_t slots, aesgcmsiv_key_table** table_out)
+{
+    if (!table_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *table_out = nullptr;
+    if (slots == 0 || slots > UINT32_MAX) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    aesgcmsiv_key_table* table = new (std::nothrow) aesgcmsiv_key_table{slots, nullptr, false};
+    if (!table || !(table->contexts = new (std::nothrow) aesgcmsiv_ctx*[slots]())) {
+        delete table;
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    *table_out = table;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_key_table_new_shared(size_t slots, aesgcmsiv_key_table** table_out)
+{
+    return aesgcmsiv_key_table_new(slots, table_out);
+}
+
+int aesgcmsiv_key_table_seal(aesgcmsiv_key_table* table)
+{
+    if (!table) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    table->sealed = true;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_key_table_set(
+    aesgcmsiv_key_table* table, size_t slot,
+    const uint8_t* key, size_t key_len)
+{
+    if (!table || slot >= table->slots || table->sealed) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    aesgcmsiv_ctx* ctx;
+    int result = aesgcmsiv_ctx_new(key, key_len, &ctx);
+    if (result == AESGCMSIV_SUCCESS) {
+        aesgcmsiv_ctx_free(table->contexts[slot]);
+        table->contexts[slot] = ctx;
+    }
+    return result;
+}
+
+int aesgcmsiv_key_table_clear(aesgcmsiv_key_table* table, size_t slot)
+{
+    if (!table || slot >= table->slots || table->sealed) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    aesgcmsiv_ctx_free(table->contexts[slot]);
+    table->contexts[slot] = nullptr;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_key_table_set_pool(aesgcmsiv_key_table* table, aesgcmsiv_pool*)
+{
+    return table ? AESGCMSIV_SUCCESS : AESGCMSIV_ERROR_INVALID_INPUT;
+}
+
+int aesgcmsiv_key_table_encrypt_batch(
+    aesgcmsiv_key_table* table,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const uint32_t* slots)
+{
+    if (!table || (count > 0 && (!items || !slots))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    for (size_t i = 0; i < count; i++) {
+        aesgcmsiv_ctx* ctx = key_slot(table, slots[i]);
+        int result = ctx ? aesgcmsiv_encrypt_batch(ctx, 1, &items[i]) : AESGCMSIV_ERROR_INVALID_KEY;
+        if (result != AESGCMSIV_SUCCESS) {
+            return result;
+        }
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_key_table_decrypt_batch(
+    aesgcmsiv_key_table* table,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const uint32_t* slots,
+    int* status_out)
+{
+    if (!table || (count > 0 && (!items || !slots || !status_out))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    int first_failure = AESGCMSIV_SUCCESS;
+    for (size_t i = 0; i < count; i++) {
+        aesgcmsiv_ctx* ctx = key_slot(table, slots[i]);
+        status_out[i] = ctx ? aesgcmsiv_decrypt_batch(ctx, 1, &items[i], &status_out[i]) : AESGCMSIV_ERROR_INVALID_KEY;
+        if (status_out[i] != AESGCMSIV_SUCCESS && first_failure == AESGCMSIV_SUCCESS) {
+            first_failure = status_out[i];
+        }
+    }
+    return first_failure;
+}
+
+void aesgcmsiv_key_table_free(aesgcmsiv_key_table* table)
+{
+    if (table) {
+        for (size_t i = 0; i < table->slots; i++) {
+            aesgcmsiv_ctx_free(table->contexts[i]);
+        }
+        delete[] table->contexts;
+        delete table;
+    }
+}
+
+struct mock_registered_buffer {
+    uint8_t* data;
+    size_t len;
+};
+
+struct aesgcmsiv_buffers {
+    size_t count;
+    mock_registered_buffer* entries;
+};
+
+int aesgcmsiv_buffers_new(size_t count, aesgcmsiv_buffers** buffers_out)
+{
+    if (!buffers_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *buffers_out = nullptr;
+    if (count == 0 || count > UINT32_MAX) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    aesgcmsiv_buffers* buffers = new (std::nothrow) aesgcmsiv_buffers{count, nullptr};
+    if (!buffers || !(buffers->entries = new (std::nothrow) mock_registered_buffer[count]())) {
+        delete buffers;
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    *buffers_out = buffers;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_buffers_register(
+    aesgcmsiv_buffers* buffers, size_t index,
+    uint8_t* data, size_t len)
+{
+    if (!buffers || index >= buffers->count || !data) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    buffers->entries[index] = {data, len};
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_buffers_unregister(aesgcmsiv_buffers* buffers, size_t index)
+{
+    if (!buffers || index >= buffers->count) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    buffers->entries[index] = {nullptr, 0};
+    return AESGCMSIV_SUCCESS;
+}
+
+static uint8_t* mock_registered_range(
+    const aesgcmsiv_buffers* buffers, uint32_t index, uint64_t offset, uint64_t len)
+{
+    if (index >= buffers->count) {
+        return nullptr;
+    }
+    const mock_registered_buffer& buffer = buffers->entries[index];
+    if (!buffer.data || offset > buffer.len || len > buffer.len - offset) {
+        return nullptr;
+    }
+    return buffer.data + offset;
+}
+
+// Item i as a batch item, as the real library builds it; false if any
+// range lies outside its buffer
+static bool mock_registered_item(
+    const aesgcmsiv_buffers* buffers, const aesgcmsiv_registered_item& item, bool decrypt,
+    aesgcmsiv_batch_item* built)
+{
+    built->nonce = mock_registered_range(buffers, item.input_buffer, item.nonce_offset, AESGCMSIV_NONCE_SIZE);
+    built->input = mock_registered_range(buffers, item.input_buffer, item.input_offset, item.input_len);
+    built->input_len = static_cast<size_t>(item.input_len);
+    built->aad = item.aad_len > 0
+        ? mock_registered_range(buffers, item.input_buffer, item.aad_offset, item.aad_len)
+        : nullptr;
+    built->aad_len = static_cast<size_t>(item.aad_len);
+    built->output = mock_registered_range(buffers, item.output_buffer, item.output_offset, item.input_len);
+    built->tag = mock_registered_range(buffers, decrypt ? item.input_buffer : item.output_buffer,
+        item.tag_offset, AESGCMSIV_TAG_SIZE);
+    return built->nonce && built->input && built->output && built->tag && (item.aad_len == 0 || built->aad);
+}
+
+static bool mock_registered_valid(
+    const aesgcmsiv_ctx* ctx, const aesgcmsiv_buffers* buffers, size_t count,
+    const aesgcmsiv_registered_item* items, bool decrypt)
+{
+    if (!ctx || !buffers || (count > 0 && !items)) {
+        return false;
+    }
+    aesgcmsiv_batch_item built;
+    for (size_t i = 0; i < count; i++) {
+        if (!mock_registered_item(buffers, items[i], decrypt, &built)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int aesgcmsiv_encrypt_registered(
+    aesgcmsiv_ctx* ctx,
+    const aesgcmsiv_buffers* buffers,
+    size_t count,
+    const aesgcmsiv_registered_item* items)
+{
+    if (!mock_registered_valid(ctx, buffers, count, items, false)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    for (size_t i = 0; i < count; i++) {
+        aesgcmsiv_batch_item item;
+        mock_registered_item(buffers, items[i], false, &item);
+        int result = aesgcmsiv_encrypt_batch(ctx, 1, &item);
+        if (result != AESGCMSIV_SUCCESS) {
+            return result;
+        }
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_decrypt_registered(
+    aesgcmsiv_ctx* ctx,
+    const aesgcmsiv_buffers* buffers,
+    size_t count,
+    const aesgcmsiv_registered_item* items,
+    int* status_out)
+{
+    if (!mock_registered_valid(ctx, buffers, count, items, true) || (count > 0 && !status_out)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    int first_failure = AESGCMSIV_SUCCESS;
+    for (size_t i = 0; i < count; i++) {
+        aesgcmsiv_batch_item item;
+        mock_registered_item(buffers, items[i], true, &item);
+        aesgcmsiv_decrypt_batch(ctx, 1, &item, &status_out[i]);
+        if (status_out[i] != AESGCMSIV_SUCCESS && first_failure == AESGCMSIV_SUCCESS) {
+            first_failure = status_out[i];
+        }
+    }
+    return first_failure;
+}
+
+void aesgcmsiv_buffers_free(aesgcmsiv_buffers* buffers)
+{
+    if (buffers) {
+        delete[] buffers->entries;
+        delete buffers;
+    }
+}
+
+struct aesgcmsiv_wrap_ctx {
+    aesgcmsiv_ctx* base;
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+};
+
+int aesgcmsiv_wrap_ctx_new(
+    const uint8_t* key, size_t key_len,
+    const uint8_t* nonce, size_t nonce_len,
+    aesgcmsiv_wrap_ctx** ctx_out)
+{
+    if (!ctx_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *ctx_out = nullptr;
+    if (!valid_key(key, key_len)) {
+        return AESGCMSIV_ERROR_INVALID_KEY;
+    }
+    if (!nonce || nonce_len != AESGCMSIV_NONCE_SIZE) {
+        return AESGCMSIV_ERROR_INVALID_NONCE;
+    }
+
+    aesgcmsiv_wrap_ctx* ctx = new (std::nothrow) aesgcmsiv_wrap_ctx();
+    if (!ctx) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    int result = aesgcmsiv_ctx_new(key, key_len, &ctx->base);
+    if (result != AESGCMSIV_SUCCESS) {
+        delete ctx;
+        return result;
+    }
+    memcpy(ctx->nonce, nonce, AESGCMSIV_NONCE_SIZE);
+    *ctx_out = ctx;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_wrap(
+    aesgcmsiv_wrap_ctx* ctx,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out)
+{
+    if (!ctx) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    return aesgcmsiv_ctx_encrypt(ctx->base, ctx->nonce, AESGCMSIV_NONCE_SIZE,
+        plaintext, plaintext_len, aad, aad_len, ciphertext_out, tag_out);
+}
+
+int aesgcmsiv_unwrap(
+    aesgcmsiv_wrap_ctx* ctx,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out)
+{
+    if (!ctx) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    return aesgcmsiv_ctx_decrypt(ctx->base, ctx->nonce, AESGCMSIV_NONCE_SIZE,
+        ciphertext, ciphertext_len, aad, aad_len, tag, plaintext_out);
+}
+
+void aesgcmsiv_wrap_ctx_free(aesgcmsiv_wrap_ctx* ctx)
+{
+    if (ctx) {
+        aesgcmsiv_ctx_free(ctx->base);
+        delete ctx;
+    }
+}
+
+// Same framing as the real library, over the mock cipher
+struct aesgcmsiv_stream {
+    aesgcmsiv_ctx* ctx;
+    uint32_t chunk_size;
+    bool decrypt;
+    bool done;
+    uint64_t next_chunk;
+    uint8_t prefix[7];
+    bool compressed;  // version 2 header; the mock only stores records uncompressed
+};
+
+static int mock_stream_new(
+    aesgcmsiv_ctx* ctx, const uint8_t* header, bool decrypt, aesgcmsiv_stream** stream_out)
+{
+    uint32_t chunk_size = header[1] | header[2] << 8 | header[3] << 16 | static_cast<uint32_t>(header[4]) << 24;
+    if (!ctx || (header[0] != 1 && header[0] != 2) || chunk_size == 0 || chunk_size > AESGCMSIV_STREAM_MAX_CHUNK_SIZE) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    aesgcmsiv_stream* stream = new (std::nothrow) aesgcmsiv_stream();
+    if (!stream) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    stream->ctx = ctx;
+    stream->chunk_size = chunk_size;
+    stream->decrypt = decrypt;
+    memcpy(stream->prefix, header + 5, 7);
+    stream->compressed = header[0] == 2;
+    *stream_out = stream;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_stream_seal_new(
+    aesgcmsiv_ctx* ctx,
+    uint32_t chunk_size,
+    uint8_t* header_out,
+    aesgcmsiv_stream** stream_out)
+{
+    if (!stream_out || !header_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *stream_out = nullptr;
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    aesgcmsiv_random_nonce(nonce);
+    header_out[0] = 1;
+    for (int i = 0; i < 4; i++) {
+        header_out[1 + i] = static_cast<uint8_t>(chunk_size >> (8 * i));
+    }
+    memcpy(header_out + 5, nonce, 7);
+    return mock_stream_new(ctx, header_out, false, stream_out);
+}
+
+int aesgcmsiv_stream_open_new(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* header,
+    aesgcmsiv_stream** stream_out)
+{
+    if (!stream_out || !header) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *stream_out = nullptr;
+    return mock_stream_new(ctx, header, true, stream_out);
+}
+
+uint32_t aesgcmsiv_stream_chunk_size(const aesgcmsiv_stream* stream)
+{
+    return stream ? stream->chunk_size : 0;
+}
+
+static int mock_chunk_nonce(
+    const aesgcmsiv_stream* stream, uint64_t index, size_t len, int last, uint8_t* nonce)
+{
+    if ((last ? len > stream->chunk_size : len != stream->chunk_size) ||
+        index > UINT32_MAX || (!last && index == UINT32_MAX)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    memcpy(nonce, stream->prefix, 7);
+    for (int i = 0; i < 4; i++) {
+        nonce[7 + i] = static_cast<uint8_t>(index >> (24 - 8 * i));
+    }
+    nonce[11] = last ? 1 : 0;
+    return AESGCMSIV_SUCCESS;
+}
+
+static int mock_stream_nonce(
+    const aesgcmsiv_stream* stream, bool decrypt, size_t len, int last, uint8_t* nonce)
+{
+    if (!stream || stream->decrypt != decrypt || stream->done) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    return mock_chunk_nonce(stream, stream->next_chunk, len, last, nonce);
+}
+
+int aesgcmsiv_stream_seal(
+    aesgcmsiv_stream* stream,
+    const uint8_t* chunk, size_t chunk_len,
+    const uint8_t* aad, size_t aad_len,
+    int last,
+    uint8_t* sealed_out)
+{
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    int result = mock_stream_nonce(stream, false, chunk_len, last, nonce);
+    if (result == AESGCMSIV_SUCCESS) {
+        result = aesgcmsiv_ctx_encrypt(stream->ctx, nonce, AESGCMSIV_NONCE_SIZE,
+            chunk, chunk_len, aad, aad_len, sealed_out, sealed_out + chunk_len);
+    }
+    if (result == AESGCMSIV_SUCCESS) {
+        stream->next_chunk++;
+        stream->done = last != 0;
+    }
+    return result;
+}
+
+int aesgcmsiv_stream_open(
+    aesgcmsiv_stream* stream,
+    const uint8_t* sealed, size_t sealed_len,
+    const uint8_t* aad, size_t aad_len,
+    int last,
+    uint8_t* chunk_out)
+{
+    if (!sealed || sealed_len < AESGCMSIV_TAG_SIZE) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    const size_t chunk_len = sealed_len - AESGCMSIV_TAG_SIZE;
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    int result = mock_stream_nonce(stream, true, chunk_len, last, nonce);
+    if (result != AESGCMSIV_SUCCESS) {
+        return result;
+    }
+    result = aesgcmsiv_ctx_decrypt(stream->ctx, nonce, AESGCMSIV_NONCE_SIZE,
+        sealed, chunk_len, aad, aad_len, sealed + chunk_len, chunk_out);
+    if (result == AESGCMSIV_SUCCESS) {
+        stream->next_chunk++;
+    }
+    stream->done = result == AESGCMSIV_ERROR_DECRYPT_FAILED || (result == AESGCMSIV_SUCCESS && last);
+    return result;
+}
+
+int aesgcmsiv_stream_seal_chunk(
+    const aesgcmsiv_stream* stream,
+    uint64_t index,
+    const uint8_t* chunk, size_t chunk_len,
+    const uint8_t* aad, size_t aad_len,
+    int last,
+    uint8_t* sealed_out)
+{
+    if (!stream || stream->decrypt || !sealed_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    int result = mock_chunk_nonce(stream, index, chunk_len, last, nonce);
+    if (result != AESGCMSIV_SUCCESS) {
+        return result;
+    }
+    return aesgcmsiv_ctx_encrypt(stream->ctx, nonce, AESGCMSIV_NONCE_SIZE,
+        chunk, chunk_len, aad, aad_len, sealed_out, sealed_out + chunk_len);
+}
+
+int aesgcmsiv_stream_open_chunk(
+    const aesgcmsiv_stream* stream,
+    uint64_t index,
+    const uint8_t* sealed, size_t sealed_len,
+    const uint8_t* aad, size_t aad_len,
+    int last,
+    uint8_t* chunk_out)
+{
+    if (!stream || !stream->decrypt || !sealed || sealed_len < AESGCMSIV_TAG_SIZE) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    const size_t chunk_len = sealed_len - AESGCMSIV_TAG_SIZE;
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    int result = mock_chunk_nonce(stream, index, chunk_len, last, nonce);
+    if (result != AESGCMSIV_SUCCESS) {
+        return result;
+    }
+    return aesgcmsiv_ctx_decrypt(stream->ctx, nonce, AESGCMSIV_NONCE_SIZE,
+        sealed, chunk_len, aad, aad_len, sealed + chunk_len, chunk_out);
+}
+
+int aesgcmsiv_stream_verify_chunks(
+    const aesgcmsiv_stream* stream,
+    uint64_t first, size_t count,
+    const uint8_t* sealed, size_t sealed_len,
+    const uint8_t* aad, size_t aad_len,
+    int last,
+    int* status_out)
+{
+    if (!stream || !stream->decrypt || count == 0 || !sealed || !status_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    const size_t full = stream->chunk_size + static_cast<size_t>(AESGCMSIV_TAG_SIZE);
+    if (last ? sealed_len > count * full || sealed_len < (count - 1) * full + AESGCMSIV_TAG_SIZE
+             : sealed_len != count * full) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::vector<uint8_t> scratch(stream->chunk_size + 1);
+    int first_failure = AESGCMSIV_SUCCESS;
+    for (size_t i = 0; i < count; i++) {
+        const bool final_chunk = last && i == count - 1;
+        status_out[i] = aesgcmsiv_stream_open_chunk(stream, first + i, sealed + i * full,
+            final_chunk ? sealed_len - i * full : full, aad, aad_len, final_chunk, scratch.data());
+        if (status_out[i] != AESGCMSIV_SUCCESS && first_failure == AESGCMSIV_SUCCESS) {
+            first_failure = status_out[i];
+        }
+    }
+    return first_failure;
+}
+
+int aesgcmsiv_compression_supported(uint32_t method)
+{
+    return method == AESGCMSIV_COMPRESS_NONE ? 1 : 0;
+}
+
+int aesgcmsiv_stream_seal_new_compressed(
+    aesgcmsiv_ctx* ctx,
+    uint32_t chunk_size,
+    uint32_t method,
+    int,
+    uint8_t* header_out,
+    aesgcmsiv_stream** stream_out)
+{
+    if (method != AESGCMSIV_COMPRESS_NONE) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    int result = aesgcmsiv_stream_seal_new(ctx, chunk_size, header_out, stream_out);
+    if (result == AESGCMSIV_SUCCESS) {
+        header_out[0] = 2;
+        (*stream_out)->compressed = true;
+    }
+    return result;
+}
+
+// Every record is stored: frame || seal(method byte 0 || chunk)
+int aesgcmsiv_stream_seal_compressed(
+    aesgcmsiv_stream* stream,
+    const uint8_t* chunk, size_t chunk_len,
+    const uint8_t* aad, size_t aad_len,
+    int last,
+    uint8_t* record_out,
+    size_t* record_len_out)
+{
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    int result = !stream || !stream->compressed || !record_out || !record_len_out
+        ? AESGCMSIV_ERROR_INVALID_INPUT
+        : mock_stream_nonce(stream, false, chunk_len, last, nonce);
+    if (result != AESGCMSIV_SUCCESS) {
+        return result;
+    }
+    std::vector<uint8_t> body(chunk_len + 1);
+    if (chunk_len > 0) {
+        memcpy(body.data() + 1, chunk, chunk_len);
+    }
+    uint8_t* sealed = record_out + AESGCMSIV_STREAM_FRAME_SIZE;
+    result = aesgcmsiv_ctx_encrypt(stream->ctx, nonce, AESGCMSIV_NONCE_SIZE,
+        body.data(), body.size(), aad, aad_len, sealed, sealed + body.size());
+    if (result != AESGCMSIV_SUCCESS) {
+        return result;
+    }
+    const uint32_t frame = static_cast<uint32_t>(body.size() + AESGCMSIV_TAG_SIZE) | (last ? 0x80000000u : 0);
+    for (int i = 0; i < 4; i++) {
+        record_out[i] = static_cast<uint8_t>(frame >> (8 * i));
+    }
+    *record_len_out = AESGCMSIV_STREAM_FRAME_SIZE + body.size() + AESGCMSIV_TAG_SIZE;
+    stream->next_chunk++;
+    stream->done = last != 0;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_stream_open_compressed(
+    aesgcmsiv_stream* stream,
+    const uint8_t* record, size_t record_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* chunk_out,
+    size_t* chunk_len_out,
+    int* last_out)
+{
+    if (!stream || !stream->compressed || !record || record_len < AESGCMSIV_STREAM_FRAME_SIZE + AESGCMSIV_TAG_SIZE + 1 ||
+        !chunk_out || !chunk_len_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    const uint32_t frame = record[0] | record[1] << 8 | record[2] << 16 | static_cast<uint32_t>(record[3]) << 24;
+    const int last = (frame >> 31) != 0;
+    const size_t body_len = record_len - AESGCMSIV_STREAM_FRAME_SIZE - AESGCMSIV_TAG_SIZE;
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    int result = (frame & 0x7fffffffu) != record_len - AESGCMSIV_STREAM_FRAME_SIZE
+        ? AESGCMSIV_ERROR_INVALID_INPUT
+        : mock_stream_nonce(stream, true, body_len - 1, last, nonce);
+    if (result != AESGCMSIV_SUCCESS) {
+        return result;
+    }
+    std::vector<uint8_t> body(body_len);
+    const uint8_t* sealed = record + AESGCMSIV_STREAM_FRAME_SIZE;
+    result = aesgcmsiv_ctx_decrypt(stream->ctx, nonce, AESGCMSIV_NONCE_SIZE,
+        sealed, body_len, aad, aad_len, sealed + body_len, body.data());
+    if (result == AESGCMSIV_SUCCESS && body[0] != AESGCMSIV_COMPRESS_NONE) {
+        result = AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (result != AESGCMSIV_SUCCESS) {
+        stream->done = true;
+        return result;
+    }
+    memcpy(chunk_out, body.data() + 1, body_len - 1);
+    *chunk_len_out = body_len - 1;
+    if (last_out) {
+        *last_out = last;
+    }
+    stream->next_chunk++;
+    stream->done = last != 0;
+    return AESGCMSIV_SUCCESS;
+}
+
+void aesgcmsiv_stream_free(aesgcmsiv_stream* stream)
+{
+    delete stream;
+}
+
+// Windows are counted against the budget but never waited for: a window
+// that does not fit fails with AESGCMSIV_ERROR_BUSY
+static std::mutex mock_window_mutex;
+static aesgcmsiv_stream_budget_stats mock_window_stats;
+static std::vector<std::pair<uint8_t*, size_t>> mock_windows;
+
+int aesgcmsiv_stream_budget_set(uint64_t max_bytes)
+{
+    std::lock_guard<std::mutex> lock(mock_window_mutex);
+    mock_window_stats.max_bytes = max_bytes;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_stream_window_acquire(
+    size_t chunk_bytes, uint32_t wanted, uint32_t min_chunks, int wait,
+    uint8_t** window_out, uint32_t* chunks_out)
+{
+    (void)wait;
+    if (!window_out || !chunks_out || chunk_bytes == 0 || wanted == 0 || min_chunks == 0 ||
+        min_chunks > wanted || chunk_bytes > SIZE_MAX / wanted) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::lock_guard<std::mutex> lock(mock_window_mutex);
+    uint64_t max = mock_window_stats.max_bytes;
+    uint64_t room = max == 0 ? UINT64_MAX : max > mock_window_stats.bytes_in_use ? max - mock_window_stats.bytes_in_use : 0;
+    uint64_t chunks = std::min<uint64_t>(wanted, room / chunk_bytes);
+    if (chunks < min_chunks) {
+        return max != 0 && uint64_t(chunk_bytes) * min_chunks > max ? AESGCMSIV_ERROR_INVALID_INPUT : AESGCMSIV_ERROR_BUSY;
+    }
+    size_t bytes = chunk_bytes * static_cast<size_t>(chunks);
+    uint8_t* window = static_cast<uint8_t*>(aesgcmsiv_alloc(bytes, 0));
+    if (!window) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    mock_windows.emplace_back(window, bytes);
+    mock_window_stats.bytes_in_use += bytes;
+    mock_window_stats.windows++;
+    mock_window_stats.shrunk += chunks < wanted;
+    *window_out = window;
+    *chunks_out = static_cast<uint32_t>(chunks);
+    return AESGCMSIV_SUCCESS;
+}
+
+void aesgcmsiv_stream_window_release(uint8_t* window)
+{
+    std::lock_guard<std::mutex> lock(mock_window_mutex);
+    for (size_t i = 0; i < mock_windows.size(); i++) {
+        if (mock_windows[i].first == window) {
+            mock_window_stats.bytes_in_use -= mock_windows[i].second;
+            mock_windows.erase(mock_windows.begin() + static_cast<ptrdiff_t>(i));
+            aesgcmsiv_free(window);
+            return;
+        }
+    }
+}
+
+int aesgcmsiv_stream_budget_get_stats(aesgcmsiv_stream_budget_stats* stats_out)
+{
+    if (!stats_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::lock_guard<std::mutex> lock(mock_window_mutex);
+    *stats_out = mock_window_stats;
+    return AESGCMSIV_SUCCESS;
+}
+
+// The mock reads and writes whole files instead of mapping them
+static bool mock_read_file(const char* path, std::vector<uint8_t>& data)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    uint8_t buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + read);
+    }
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+static int mock_write_file(const char* path, const std::vector<uint8_t>& data)
+{
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        return AESGCMSIV_ERROR_IO;
+    }
+    bool ok = data.empty() || fwrite(data.data(), 1, data.size(), file) == data.size();
+    return fclose(file) == 0 && ok ? AESGCMSIV_SUCCESS : AESGCMSIV_ERROR_IO;
+}
+
+int aesgcmsiv_stream_seal_file(
+    aesgcmsiv_ctx* ctx,
+    const char* input_path,
+    const char* output_path,
+    uint32_t chunk_size,
+    const uint8_t* aad, size_t aad_len)
+{
+    if (!ctx || !input_path || !output_path || chunk_size == 0 || chunk_size > AESGCMSIV_STREAM_MAX_CHUNK_SIZE) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::vector<uint8_t> input;
+    if (!mock_read_file(input_path, input)) {
+        return AESGCMSIV_ERROR_IO;
+    }
+    const size_t chunks = input.empty() ? 1 : (input.size() + chunk_size - 1) / chunk_size;
+    std::vector<uint8_t> output(AESGCMSIV_STREAM_HEADER_SIZE + input.size() + chunks * AESGCMSIV_TAG_SIZE);
+    aesgcmsiv_stream* stream = nullptr;
+    int result = aesgcmsiv_stream_seal_new(ctx, chunk_size, output.data(), &stream);
+    uint8_t* out = output.data() + AESGCMSIV_STREAM_HEADER_SIZE;
+    for (size_t i = 0; result == AESGCMSIV_SUCCESS && i < chunks; i++) {
+        const bool last = i == chunks - 1;
+        const size_t len = last ? input.size() - i * chunk_size : chunk_size;
+        result = aesgcmsiv_stream_seal(stream, input.data() + i * chunk_size, len, aad, aad_len, last, out);
+        out += len + AESGCMSIV_TAG_SIZE;
+    }
+    aesgcmsiv_stream_free(stream);
+    return result == AESGCMSIV_SUCCESS ? mock_write_file(output_path, output) : result;
+}
+
+int aesgcmsiv_stream_open_file(
+    aesgcmsiv_ctx* ctx,
+    const char* input_path,
+    const char* output_path,
+    const uint8_t* aad, size_t aad_len)
+{
+    if (!ctx || !input_path || !output_path) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::vector<uint8_t> input;
+    if (!mock_read_file(input_path, input)) {
+        return AESGCMSIV_ERROR_IO;
+    }
+    aesgcmsiv_stream* stream = nullptr;
+    if (input.size() < AESGCMSIV_STREAM_HEADER_SIZE ||
+        aesgcmsiv_stream_open_new(ctx, input.data(), &stream) != AESGCMSIV_SUCCESS) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    const size_t full = stream->chunk_size + static_cast<size_t>(AESGCMSIV_TAG_SIZE);
+    const size_t sealed_size = input.size() - AESGCMSIV_STREAM_HEADER_SIZE;
+    const size_t chunks = (sealed_size + full - 1) / full;
+    int result = chunks == 0 || sealed_size - (chunks - 1) * full < AESGCMSIV_TAG_SIZE
+        ? AESGCMSIV_ERROR_DECRYPT_FAILED
+        : AESGCMSIV_SUCCESS;
+    std::vector<uint8_t> output(result == AESGCMSIV_SUCCESS ? sealed_size - chunks * AESGCMSIV_TAG_SIZE : 0);
+    for (size_t i = 0; result == AESGCMSIV_SUCCESS && i < chunks; i++) {
+        const bool last = i == chunks - 1;
+        const size_t sealed_len = last ? sealed_size - i * full : full;
+        result = aesgcmsiv_stream_open(stream, input.data() + AESGCMSIV_STREAM_HEADER_SIZE + i * full,
+            sealed_len, aad, aad_len, last, output.data() + i * stream->chunk_size);
+    }
+    aesgcmsiv_stream_free(stream);
+    return result == AESGCMSIV_SUCCESS ? mock_write_file(output_path, output) : result;
+}
+
+// Reads the whole file and verifies it in one call, with no pacing
+int aesgcmsiv_stream_scrub_file(
+    aesgcmsiv_ctx* ctx,
+    const char* input_path,
+    const uint8_t* aad, size_t aad_len,
+    uint64_t,
+    aesgcmsiv_scrub_callback callback, void* user,
+    uint64_t* corrupt_out)
+{
+    if (corrupt_out) {
+        *corrupt_out = 0;
+    }
+    if (!ctx || !input_path) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::vector<uint8_t> input;
+    if (!mock_read_file(input_path, input)) {
+        return AESGCMSIV_ERROR_IO;
+    }
+    aesgcmsiv_stream* stream = nullptr;
+    if (input.size() < AESGCMSIV_STREAM_HEADER_SIZE ||
+        aesgcmsiv_stream_open_new(ctx, input.data(), &stream) != AESGCMSIV_SUCCESS) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    const size_t full = stream->chunk_size + static_cast<size_t>(AESGCMSIV_TAG_SIZE);
+    const size_t sealed_size = input.size() - AESGCMSIV_STREAM_HEADER_SIZE;
+    const size_t chunks = (sealed_size + full - 1) / full;
+    uint64_t corrupt = 0;
+    if (chunks == 0 || sealed_size - (chunks - 1) * full < AESGCMSIV_TAG_SIZE) {
+        corrupt = 1;
+        if (callback) {
+            callback(user, AESGCMSIV_STREAM_HEADER_SIZE, sealed_size, AESGCMSIV_ERROR_DECRYPT_FAILED);
+        }
+    } else {
+        std::vector<int> statuses(chunks);
+        aesgcmsiv_stream_verify_chunks(stream, 0, chunks, input.data() + AESGCMSIV_STREAM_HEADER_SIZE,
+            sealed_size, aad, aad_len, 1, statuses.data());
+        for (size_t i = 0; i < chunks; i++) {
+            if (statuses[i] != AESGCMSIV_SUCCESS) {
+                corrupt++;
+                if (callback) {
+                    callback(user, AESGCMSIV_STREAM_HEADER_SIZE + i * full,
+                        i == chunks - 1 ? sealed_size - i * full : full, statuses[i]);
+                }
+            }
+        }
+    }
+    aesgcmsiv_stream_free(stream);
+    if (corrupt_out) {
+        *corrupt_out = corrupt;
+    }
+    return corrupt == 0 ? AESGCMSIV_SUCCESS : AESGCMSIV_ERROR_DECRYPT_FAILED;
+}
+
+int aesgcmsiv_ctx_encrypt_file(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const char* input_path,
+    const char* output_path,
+    const uint8_t* aad, size_t aad_len)
+{
+    if (!ctx || !input_path || !output_path) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::vector<uint8_t> input;
+    if (!mock_read_file(input_path, input)) {
+        return AESGCMSIV_ERROR_IO;
+    }
+    std::vector<uint8_t> output(input.size() + AESGCMSIV_TAG_SIZE);
+    static const uint8_t empty = 0;
+    int result = aesgcmsiv_ctx_encrypt(ctx, nonce, nonce_len, input.empty() ? &empty : input.data(), input.size(),
+        aad, aad_len, output.data(), output.data() + input.size());
+    return result == AESGCMSIV_SUCCESS ? mock_write_file(output_path, output) : result;
+}
+
+// Nothing is written until the tag verifies, so no provisional file is needed
+int aesgcmsiv_ctx_decrypt_file(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const char* input_path,
+    const char* output_path,
+    const uint8_t* aad, size_t aad_len)
+{
+    if (!ctx || !input_path || !output_path) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::vector<uint8_t> input;
+    if (!mock_read_file(input_path, input)) {
+        return AESGCMSIV_ERROR_IO;
+    }
+    if (input.size() < AESGCMSIV_TAG_SIZE) {
+        return AESGCMSIV_ERROR_DECRYPT_FAILED;
+    }
+    const size_t length = input.size() - AESGCMSIV_TAG_SIZE;
+    std::vector<uint8_t> output(length);
+    uint8_t empty = 0;
+    int result = aesgcmsiv_ctx_decrypt(ctx, nonce, nonce_len, input.data(), length,
+        aad, aad_len, input.data() + length, output.empty() ? &empty : output.data());
+    return result == AESGCMSIV_SUCCESS ? mock_write_file(output_path, output) : result;
+}
+
+// The mock seals and opens datagrams one at a time
+int aesgcmsiv_seal_datagrams(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    aesgcmsiv_datagram* datagrams,
+    size_t header_len)
+{
+    if (!ctx || (count > 0 && !datagrams)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (!datagrams[i].data || datagrams[i].len < header_len ||
+            datagrams[i].len - header_len < AESGCMSIV_NONCE_SIZE) {
+            return AESGCMSIV_ERROR_INVALID_INPUT;
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        uint8_t* nonce = datagrams[i].data + header_len;
+        uint8_t* payload = nonce + AESGCMSIV_NONCE_SIZE;
+        const size_t payload_len = datagrams[i].len - header_len - AESGCMSIV_NONCE_SIZE;
+        aesgcmsiv_random_nonce(nonce);
+        int result = aesgcmsiv_ctx_encrypt(ctx, nonce, AESGCMSIV_NONCE_SIZE, payload, payload_len,
+            datagrams[i].data, header_len, payload, payload + payload_len);
+        if (result != AESGCMSIV_SUCCESS) {
+            return result;
+        }
+        datagrams[i].len += AESGCMSIV_TAG_SIZE;
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_open_datagrams(
+    aesgcmsiv_ctx* ctx,
+    size_t count,
+    aesgcmsiv_datagram* datagrams,
+    size_t header_len,
+    int* status_out)
+{
+    if (!ctx || (count > 0 && (!datagrams || !status_out))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    int first_error = AESGCMSIV_SUCCESS;
+    for (size_t i = 0; i < count; i++) {
+        int status = AESGCMSIV_ERROR_DECRYPT_FAILED;
+        if (datagrams[i].len >= header_len && datagrams[i].len - header_len >= AESGCMSIV_DATAGRAM_OVERHEAD) {
+            uint8_t* nonce = datagrams[i].data + header_len;
+            uint8_t* payload = nonce + AESGCMSIV_NONCE_SIZE;
+            const size_t payload_len = datagrams[i].len - header_len - AESGCMSIV_DATAGRAM_OVERHEAD;
+            status = aesgcmsiv_ctx_decrypt(ctx, nonce, AESGCMSIV_NONCE_SIZE, payload, payload_len,
+                datagrams[i].data, header_len, payload + payload_len, payload);
+            if (status == AESGCMSIV_SUCCESS) {
+                datagrams[i].len -= AESGCMSIV_TAG_SIZE;
+            }
+        }
+        status_out[i] = status;
+        if (first_error == AESGCMSIV_SUCCESS) {
+            first_error = status;
+        }
+    }
+    return first_error;
+}
+
+#if defined(__linux__)
+int aesgcmsiv_seal_mmsg(
+    aesgcmsiv_ctx* ctx,
+    struct mmsghdr* messages,
+    unsigned int count,
+    size_t header_len)
+{
+    if (!ctx || (count > 0 && !messages)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::vector<aesgcmsiv_datagram> views(count);
+    for (unsigned int i = 0; i < count; i++) {
+        if (messages[i].msg_hdr.msg_iovlen != 1 || !messages[i].msg_hdr.msg_iov) {
+            return AESGCMSIV_ERROR_INVALID_INPUT;
+        }
+        views[i] = {static_cast<uint8_t*>(messages[i].msg_hdr.msg_iov[0].iov_base), messages[i].msg_hdr.msg_iov[0].iov_len};
+    }
+    int result = aesgcmsiv_seal_datagrams(ctx, count, views.data(), header_len);
+    for (unsigned int i = 0; result == AESGCMSIV_SUCCESS && i < count; i++) {
+        messages[i].msg_hdr.msg_iov[0].iov_len = views[i].len;
+    }
+    return result;
+}
+
+int aesgcmsiv_open_mmsg(
+    aesgcmsiv_ctx* ctx,
+    struct mmsghdr* messages,
+    unsigned int count,
+    size_t header_len,
+    int* status_out)
+{
+    if (!ctx || (count > 0 && (!messages || !status_out))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::vector<aesgcmsiv_datagram> views(count);
+    for (unsigned int i = 0; i < count; i++) {
+        if (messages[i].msg_hdr.msg_iovlen != 1 || !messages[i].msg_hdr.msg_iov) {
+            return AESGCMSIV_ERROR_INVALID_INPUT;
+        }
+        views[i] = {static_cast<uint8_t*>(messages[i].msg_hdr.msg_iov[0].iov_base), messages[i].msg_len};
+    }
+    int result = aesgcmsiv_open_datagrams(ctx, count, views.data(), header_len, status_out);
+    for (unsigned int i = 0; i < count; i++) {
+        if (status_out[i] == AESGCMSIV_SUCCESS) {
+            messages[i].msg_len = static_cast<unsigned int>(views[i].len);
+        }
+    }
+    return result;
+}
+#endif
+
+// The mock writes the pack format, with the mock cipher, and reads the
+// whole file into memory on open
+struct aesgcmsiv_pack {
+    std::vector<uint8_t> data;
+    uint64_t count;
+    size_t id_size;
+};
+
+static uint64_t mock_load_le64(const uint8_t* p)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value |= static_cast<uint64_t>(p[i]) << (8 * i);
+    }
+    return value;
+}
+
+static void mock_pack_nonce(const uint8_t* base, uint64_t i, uint8_t* nonce)
+{
+    memcpy(nonce, base, AESGCMSIV_NONCE_SIZE);
+    for (int b = 0; b < 8; b++) {
+        nonce[4 + b] ^= static_cast<uint8_t>(i >> (8 * b));
+    }
+}
+
+int aesgcmsiv_pack_write_file(
+    aesgcmsiv_ctx* ctx,
+    const char* output_path,
+    size_t id_size,
+    size_t count,
+    const uint8_t* ids,
+    const uint8_t* const* blobs,
+    const size_t* blob_lens)
+{
+    if (!ctx || !output_path || id_size == 0 || id_size > AESGCMSIV_PACK_MAX_ID_SIZE ||
+        (count > 0 && (!ids || !blobs || !blob_lens))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::vector<size_t> order(count);
+    for (size_t i = 0; i < count; i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [ids, id_size](size_t a, size_t b) {
+        return memcmp(ids + a * id_size, ids + b * id_size, id_size) < 0;
+    });
+    for (size_t i = 1; i < count; i++) {
+        if (memcmp(ids + order[i - 1] * id_size, ids + order[i] * id_size, id_size) == 0) {
+            return AESGCMSIV_ERROR_INVALID_INPUT;
+        }
+    }
+
+    const size_t entry_size = id_size + 16;
+    std::vector<uint8_t> output(AESGCMSIV_PACK_HEADER_SIZE + count * entry_size);
+    memcpy(output.data(), "AGSP", 4);
+    output[4] = 1;
+    output[5] = static_cast<uint8_t>(id_size);
+    for (int b = 0; b < 8; b++) {
+        output[8 + b] = static_cast<uint8_t>(static_cast<uint64_t>(count) >> (8 * b));
+    }
+    aesgcmsiv_random_nonce(output.data() + 16);
+    for (size_t i = 0; i < count; i++) {
+        const size_t blob = order[i];
+        const size_t offset = output.size();
+        const size_t length = blob_lens[blob];
+        if (!blobs[blob] && length != 0) {
+            return AESGCMSIV_ERROR_INVALID_INPUT;
+        }
+        const size_t entry = AESGCMSIV_PACK_HEADER_SIZE + i * entry_size;
+        memcpy(output.data() + entry, ids + blob * id_size, id_size);
+        for (int b = 0; b < 8; b++) {
+            output[entry + id_size + b] = static_cast<uint8_t>(static_cast<uint64_t>(offset) >> (8 * b));
+            output[entry + id_size + 8 + b] = static_cast<uint8_t>(static_cast<uint64_t>(length) >> (8 * b));
+        }
+        output.resize(offset + length + AESGCMSIV_TAG_SIZE);
+        uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+        mock_pack_nonce(output.data() + 16, i, nonce);
+        static const uint8_t empty = 0;
+        int result = aesgcmsiv_ctx_encrypt(ctx, nonce, sizeof(nonce), length ? blobs[blob] : &empty, length,
+            output.data() + entry, id_size, output.data() + offset, output.data() + offset + length);
+        if (result != AESGCMSIV_SUCCESS) {
+            return result;
+        }
+    }
+    return mock_write_file(output_path, output);
+}
+
+int aesgcmsiv_pack_open(const char* input_path, aesgcmsiv_pack** pack_out)
+{
+    if (!pack_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *pack_out = nullptr;
+    if (!input_path) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    aesgcmsiv_pack* pack = new aesgcmsiv_pack();
+    if (!mock_read_file(input_path, pack->data)) {
+        delete pack;
+        return AESGCMSIV_ERROR_IO;
+    }
+    const std::vector<uint8_t>& data = pack->data;
+    if (data.size() < AESGCMSIV_PACK_HEADER_SIZE || memcmp(data.data(), "AGSP", 4) != 0 || data[4] != 1 ||
+        data[5] == 0 || data[5] > AESGCMSIV_PACK_MAX_ID_SIZE) {
+        delete pack;
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    pack->id_size = data[5];
+    pack->count = mock_load_le64(data.data() + 8);
+    if (pack->count > (data.size() - AESGCMSIV_PACK_HEADER_SIZE) / (pack->id_size + 16)) {
+        delete pack;
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *pack_out = pack;
+    return AESGCMSIV_SUCCESS;
+}
+
+uint64_t aesgcmsiv_pack_count(const aesgcmsiv_pack* pack)
+{
+    return pack ? pack->count : 0;
+}
+
+size_t aesgcmsiv_pack_id_size(const aesgcmsiv_pack* pack)
+{
+    return pack ? pack->id_size : 0;
+}
+
+// A linear scan; the mock does not rely on the index being sorted
+static int mock_pack_locate(const aesgcmsiv_pack* pack, const uint8_t* id, uint64_t* index_out,
+    uint64_t* offset_out, size_t* length_out)
+{
+    const size_t entry_size = pack->id_size + 16;
+    for (uint64_t i = 0; i < pack->count; i++) {
+        const uint8_t* entry = pack->data.data() + AESGCMSIV_PACK_HEADER_SIZE + i * entry_size;
+        if (memcmp(entry, id, pack->id_size) != 0) {
+            continue;
+        }
+        const uint64_t offset = mock_load_le64(entry + pack->id_size);
+        const uint64_t length = mock_load_le64(entry + pack->id_size + 8);
+        if (offset > pack->data.size() || pack->data.size() - offset < length + AESGCMSIV_TAG_SIZE) {
+            return AESGCMSIV_ERROR_DECRYPT_FAILED;
+        }
+        *index_out = i;
+        *offset_out = offset;
+        *length_out = static_cast<size_t>(length);
+        return AESGCMSIV_SUCCESS;
+    }
+    return AESGCMSIV_ERROR_NOT_FOUND;
+}
+
+int aesgcmsiv_pack_find(const aesgcmsiv_pack* pack, const uint8_t* id, size_t* length_out)
+{
+    if (!pack || !id || !length_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    uint64_t index, offset;
+    return mock_pack_locate(pack, id, &index, &offset, length_out);
+}
+
+int aesgcmsiv_pack_read_batch(
+    aesgcmsiv_ctx* ctx,
+    const aesgcmsiv_pack* pack,
+    size_t count,
+    const uint8_t* ids,
+    uint8_t* const* outputs,
+    const size_t* output_lens,
+    size_t* lengths_out,
+    int* status_out)
+{
+    if (!ctx || !pack || (count > 0 && (!ids || !outputs || !output_lens || !status_out))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    int first_error = AESGCMSIV_SUCCESS;
+    for (size_t k = 0; k < count; k++) {
+        uint64_t index, offset;
+        size_t length = 0;
+        int status = mock_pack_locate(pack, ids + k * pack->id_size, &index, &offset, &length);
+        if (lengths_out) {
+            lengths_out[k] = length;
+        }
+        if (status == AESGCMSIV_SUCCESS && (output_lens[k] < length || (!outputs[k] && length != 0))) {
+            status = AESGCMSIV_ERROR_INVALID_INPUT;
+        }
+        if (status == AESGCMSIV_SUCCESS) {
+            uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+            mock_pack_nonce(pack->data.data() + 16, index, nonce);
+            const uint8_t* entry = pack->data.data() + AESGCMSIV_PACK_HEADER_SIZE + index * (pack->id_size + 16);
+            const uint8_t* sealed = pack->data.data() + offset;
+            uint8_t empty = 0;
+            status = aesgcmsiv_ctx_decrypt(ctx, nonce, sizeof(nonce), sealed, length, entry, pack->id_size,
+                sealed + length, outputs[k] ? outputs[k] : &empty);
+        }
+        status_out[k] = status;
+        if (first_error == AESGCMSIV_SUCCESS) {
+            first_error = status;
+        }
+    }
+    return first_error;
+}
+
+int aesgcmsiv_pack_scrub(
+    aesgcmsiv_ctx* ctx,
+    const aesgcmsiv_pack* pack,
+    uint64_t,
+    aesgcmsiv_scrub_callback callback, void* user,
+    uint64_t* corrupt_out)
+{
+    if (corrupt_out) {
+        *corrupt_out = 0;
+    }
+    if (!ctx || !pack) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    const size_t entry_size = pack->id_size + 16;
+    uint64_t corrupt = 0;
+    for (uint64_t i = 0; i < pack->count; i++) {
+        const uint8_t* entry = pack->data.data() + AESGCMSIV_PACK_HEADER_SIZE + i * entry_size;
+        uint64_t index, offset;
+        size_t length = 0;
+        int status = mock_pack_locate(pack, entry, &index, &offset, &length);
+        if (status == AESGCMSIV_SUCCESS) {
+            uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+            mock_pack_nonce(pack->data.data() + 16, index, nonce);
+            const uint8_t* sealed = pack->data.data() + offset;
+            status = aesgcmsiv_ctx_verify_ciphertext(ctx, nonce, sizeof(nonce), sealed, length,
+                entry, pack->id_size, sealed + length);
+        } else {
+            offset = AESGCMSIV_PACK_HEADER_SIZE + i * entry_size;
+            length = entry_size - AESGCMSIV_TAG_SIZE;
+        }
+        if (status != AESGCMSIV_SUCCESS) {
+            corrupt++;
+            if (callback) {
+                callback(user, offset, length + AESGCMSIV_TAG_SIZE, status);
+            }
+        }
+    }
+    if (corrupt_out) {
+        *corrupt_out = corrupt;
+    }
+    return corrupt == 0 ? AESGCMSIV_SUCCESS : AESGCMSIV_ERROR_DECRYPT_FAILED;
+}
+
+void aesgcmsiv_pack_free(aesgcmsiv_pack* pack)
+{
+    delete pack;
+}
+
+// The mock never pauses, so every submitted call completes on the spot
+int aesgcmsiv_ctx_encrypt_submit(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out,
+    aesgcmsiv_job** job_out)
+{
+    if (!job_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *job_out = nullptr;
+    return aesgcmsiv_ctx_encrypt(ctx, nonce, nonce_len, plaintext, plaintext_len,
+        aad, aad_len, ciphertext_out, tag_out);
+}
+
+int aesgcmsiv_ctx_decrypt_submit(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out,
+    aesgcmsiv_job** job_out)
+{
+    if (!job_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *job_out = nullptr;
+    return aesgcmsiv_ctx_decrypt(ctx, nonce, nonce_len, ciphertext, ciphertext_len,
+        aad, aad_len, tag, plaintext_out);
+}
+
+// The mock has no pool, so every call runs on the caller
+int aesgcmsiv_ctx_encrypt_async(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext_out,
+    uint8_t* tag_out,
+    aesgcmsiv_done_fn done, void* user_data)
+{
+    (void)user_data;
+    if (!done) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    return aesgcmsiv_ctx_encrypt(ctx, nonce, nonce_len, plaintext, plaintext_len,
+        aad, aad_len, ciphertext_out, tag_out);
+}
+
+int aesgcmsiv_ctx_decrypt_async(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* ciphertext, size_t ciphertext_len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t* tag,
+    uint8_t* plaintext_out,
+    aesgcmsiv_done_fn done, void* user_data)
+{
+    (void)user_data;
+    if (!done) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    return aesgcmsiv_ctx_decrypt(ctx, nonce, nonce_len, ciphertext, ciphertext_len,
+        aad, aad_len, tag, plaintext_out);
+}
+
+int aesgcmsiv_job_poll(aesgcmsiv_job* job)
+{
+    (void)job;
+    return AESGCMSIV_ERROR_INVALID_INPUT;
+}
+
+unsigned int aesgcmsiv_available_cpus(void)
+{
+    unsigned int cpus = std::thread::hardware_concurrency();
+    return cpus > 0 ? cpus : 1;
+}
+
+// The mock has no parallel paths, so a pool is only a token to hand back
+struct aesgcmsiv_pool {
+    unsigned int workers;
+};
+
+int aesgcmsiv_pool_create(unsigned int workers, aesgcmsiv_pool** pool_out)
+{
+    if (!pool_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *pool_out = new (std::nothrow) aesgcmsiv_pool{ workers };
+    return *pool_out ? AESGCMSIV_SUCCESS : AESGCMSIV_ERROR_INTERNAL;
+}
+
+int aesgcmsiv_pool_create_ex(unsigned int workers, uint32_t flags, aesgcmsiv_pool** pool_out)
+{
+    (void)flags;
+    return aesgcmsiv_pool_create(workers, pool_out);
+}
+
+int aesgcmsiv_pool_create_hosted(
+    unsigned int workers, aesgcmsiv_schedule_fn schedule, void* user_data, aesgcmsiv_pool** pool_out)
+{
+    (void)user_data;
+    if (!pool_out || !schedule) {
+        if (pool_out) {
+            *pool_out = nullptr;
+        }
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    return aesgcmsiv_pool_create(workers, pool_out);
+}
+
+void aesgcmsiv_pool_work(aesgcmsiv_pool* pool)
+{
+    (void)pool;
+}
+
+void aesgcmsiv_pool_destroy(aesgcmsiv_pool* pool)
+{
+    delete pool;
+}
+
+int aesgcmsiv_ctx_set_pool(aesgcmsiv_ctx* ctx, aesgcmsiv_pool* pool)
+{
+    (void)pool;
+    return ctx ? AESGCMSIV_SUCCESS : AESGCMSIV_ERROR_INVALID_INPUT;
+}
+
+// Heap memory aligned to a cache line; the placement flags are ignored
+void* aesgcmsiv_alloc(size_t size, uint32_t flags)
+{
+    (void)flags;
+    if (size == 0) {
+        return nullptr;
+    }
+    void* data = ::operator new(size, std::align_val_t(64), std::nothrow);
+    if (data) {
+        memset(data, 0, size);
+    }
+    return data;
+}
+
+void aesgcmsiv_free(void* ptr)
+{
+    ::operator delete(ptr, std::align_val_t(64));
+}
+
+// Unique rather than random: a process-wide counter is enough to tell
+// calls apart
+int aesgcmsiv_random_nonce(uint8_t* nonce_out)
+{
+    static std::atomic<uint64_t> counter(0);
+    if (!nonce_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    uint64_t value = counter.fetch_add(1, std::memory_order_relaxed) + 1;
+    memset(nonce_out, 0, AESGCMSIV_NONCE_SIZE);
+    memcpy(nonce_out, &value, sizeof(value));
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_ctx_encrypt_autononce(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* sealed_out)
+{
+    if (!sealed_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    uint8_t nonce[AESGCMSIV_NONCE_SIZE];
+    aesgcmsiv_random_nonce(nonce);
+    uint8_t* ciphertext = sealed_out + AESGCMSIV_NONCE_SIZE;
+    int result = aesgcmsiv_ctx_encrypt(ctx, nonce, AESGCMSIV_NONCE_SIZE,
+        plaintext, plaintext_len, aad, aad_len, ciphertext, ciphertext + plaintext_len);
+    if (result == AESGCMSIV_SUCCESS) {
+        memcpy(sealed_out, nonce, AESGCMSIV_NONCE_SIZE);
+    }
+    return result;
+}
+
+int aesgcmsiv_ctx_seal_b64url(
+    aesgcmsiv_ctx* ctx,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    char* token_out,
+    size_t* token_len_out)
+{
+    if (!ctx) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    uint8_t fresh[AESGCMSIV_NONCE_SIZE];
+    if (!nonce) {
+        if (nonce_len != 0) {
+            return AESGCMSIV_ERROR_INVALID_NONCE;
+        }
+        aesgcmsiv_random_nonce(fresh);
+        nonce = fresh;
+        nonce_len = AESGCMSIV_NONCE_SIZE;
+    }
+    return aesgcmsiv_seal_b64url(ctx->key, ctx->key_len, nonce, nonce_len,
+        plaintext, plaintext_len, aad, aad_len, token_out, token_len_out);
+}
+
+int aesgcmsiv_ctx_open_b64url(
+    aesgcmsiv_ctx* ctx,
+    const char* token, size_t token_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* plaintext_out,
+    size_t* plaintext_len_out)
+{
+    if (!ctx) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    return aesgcmsiv_open_b64url(ctx->key, ctx->key_len, token, token_len,
+        aad, aad_len, plaintext_out, plaintext_len_out);
+}
+
+// The mock derives nothing, so there is nothing to cache
+int aesgcmsiv_ctx_set_nonce_cache(aesgcmsiv_ctx* ctx, size_t entries)
+{
+    return ctx && entries <= AESGCMSIV_NONCE_CACHE_MAX ? AESGCMSIV_SUCCESS : AESGCMSIV_ERROR_INVALID_INPUT;
+}
+
+// Only aesgcmsiv_ctx_encrypt and aesgcmsiv_ctx_decrypt, and the calls built
+// on them, are counted in the mock
+int aesgcmsiv_ctx_set_usage_tracking(aesgcmsiv_ctx* ctx, int enabled)
+{
+    if (!ctx) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::lock_guard<std::mutex> guard(ctx->usage_lock);
+    ctx->track_usage = enabled != 0;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_ctx_get_usage(const aesgcmsiv_ctx* ctx, aesgcmsiv_key_usage* usage_out)
+{
+    if (!ctx || !usage_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::lock_guard<std::mutex> guard(ctx->usage_lock);
+    *usage_out = ctx->usage;
+    return AESGCMSIV_SUCCESS;
+}
+
+// The mock engine runs each request inside submit and only queues its
+// completion
+struct aesgcmsiv_engine {
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<aesgcmsiv_completion> completions;
+    bool stopping = false;
+    uint64_t submitted[AESGCMSIV_ENGINE_LANES] = {};
+    bool notify_on = false;
+    aesgcmsiv_notify notify;
+};
+
+int aesgcmsiv_engine_new(
+    unsigned int workers, size_t queue_depth,
+    aesgcmsiv_engine** engine_out)
+{
+    (void)workers;
+    if (!engine_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *engine_out = nullptr;
+    if (queue_depth == 0) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *engine_out = new (std::nothrow) aesgcmsiv_engine();
+    return *engine_out ? AESGCMSIV_SUCCESS : AESGCMSIV_ERROR_INTERNAL;
+}
+
+int aesgcmsiv_engine_submit(
+    aesgcmsiv_engine* engine,
+    const aesgcmsiv_request* request)
+{
+    const uint32_t lane = request && request->item.input_len > AESGCMSIV_ENGINE_LATENCY_MAX
+        ? AESGCMSIV_LANE_BULK : AESGCMSIV_LANE_LATENCY;
+    return aesgcmsiv_engine_submit_lane(engine, request, lane);
+}
+
+int aesgcmsiv_engine_submit_lane(
+    aesgcmsiv_engine* engine,
+    const aesgcmsiv_request* request,
+    uint32_t lane)
+{
+    if (!engine || !request || lane >= AESGCMSIV_ENGINE_LANES) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    const aesgcmsiv_batch_item& item = request->item;
+    int status = request->op == AESGCMSIV_OP_DECRYPT
+        ? aesgcmsiv_ctx_decrypt(request->ctx, item.nonce, AESGCMSIV_NONCE_SIZE,
+            item.input, item.input_len, item.aad, item.aad_len, item.tag, item.output)
+        : aesgcmsiv_ctx_encrypt(request->ctx, item.nonce, AESGCMSIV_NONCE_SIZE,
+            item.input, item.input_len, item.aad, item.aad_len, item.output, item.tag);
+
+    std::lock_guard<std::mutex> lock(engine->mutex);
+    if (engine->stopping) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    engine->completions.push_back(aesgcmsiv_completion{ request->user_data, status });
+    if (engine->notify_on && engine->completions.size() == 1) {
+        aesgcmsiv_notify_raise(&engine->notify);
+    }
+    engine->submitted[lane]++;
+    engine->ready.notify_one();
+    return AESGCMSIV_SUCCESS;
+}
+
+// The mock runs each request as it is submitted, so there is no batch to
+// fill and its queue is never full
+int aesgcmsiv_engine_set_linger(
+    aesgcmsiv_engine* engine,
+    uint64_t linger_ns, size_t batch_target)
+{
+    return engine && linger_ns <= AESGCMSIV_ENGINE_MAX_LINGER_NS && batch_target <= 64
+        ? AESGCMSIV_SUCCESS : AESGCMSIV_ERROR_INVALID_INPUT;
+}
+
+int aesgcmsiv_engine_set_blocking(aesgcmsiv_engine* engine, int block)
+{
+    (void)block;
+    return engine ? AESGCMSIV_SUCCESS : AESGCMSIV_ERROR_INVALID_INPUT;
+}
+
+// Nothing waits in the mock, so every request started as it was submitted
+int aesgcmsiv_engine_get_stats(
+    aesgcmsiv_engine* engine,
+    aesgcmsiv_engine_stats* stats_out)
+{
+    if (!engine || !stats_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::lock_guard<std::mutex> lock(engine->mutex);
+    *stats_out = aesgcmsiv_engine_stats{};
+    for (size_t i = 0; i < AESGCMSIV_ENGINE_LANES; i++) {
+        stats_out->lanes[i].submitted = engine->submitted[i];
+        stats_out->lanes[i].started = engine->submitted[i];
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_engine_reap(
+    aesgcmsiv_engine* engine,
+    aesgcmsiv_completion* completions, size_t max,
+    int wait,
+    size_t* count_out)
+{
+    if (!engine || !count_out || (max > 0 && !completions)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::unique_lock<std::mutex> lock(engine->mutex);
+    if (wait && max > 0) {
+        engine->ready.wait(lock, [engine] { return !engine->completions.empty() || engine->stopping; });
+    }
+    size_t count = 0;
+    while (count < max && !engine->completions.empty()) {
+        completions[count++] = engine->completions.front();
+        engine->completions.pop_front();
+    }
+    if (engine->notify_on && count > 0 && engine->completions.empty()) {
+        aesgcmsiv_notify_clear(&engine->notify);
+    }
+    *count_out = count;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_engine_get_notify_handle(
+    aesgcmsiv_engine* engine,
+    intptr_t* handle_out)
+{
+    if (!engine || !handle_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::lock_guard<std::mutex> lock(engine->mutex);
+    if (!engine->notify_on) {
+        if (!aesgcmsiv_notify_open(&engine->notify)) {
+            return AESGCMSIV_ERROR_INTERNAL;
+        }
+        engine->notify_on = true;
+        if (!engine->completions.empty()) {
+            aesgcmsiv_notify_raise(&engine->notify);
+        }
+    }
+    *handle_out = engine->notify.handle;
+    return AESGCMSIV_SUCCESS;
+}
+
+void aesgcmsiv_engine_shutdown(aesgcmsiv_engine* engine)
+{
+    if (!engine) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(engine->mutex);
+    engine->stopping = true;
+    engine->ready.notify_all();
+}
+
+void aesgcmsiv_engine_free(aesgcmsiv_engine* engine)
+{
+    if (engine && engine->notify_on) {
+        aesgcmsiv_notify_close(&engine->notify);
+    }
+    delete engine;
+}
+
+void aesgcmsiv_ctx_free(aesgcmsiv_ctx* ctx)
+{
+    if (ctx) {
+        memset(ctx->key, 0, sizeof(ctx->key));
+        delete ctx;
+    }
+}
+
+int aesgcmsiv_ctx_clone(const aesgcmsiv_ctx* template_ctx, aesgcmsiv_ctx** ctx_out)
+{
+    if (!template_ctx || !ctx_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *ctx_out = new (std::nothrow) aesgcmsiv_ctx();
+    if (!*ctx_out) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    memcpy((*ctx_out)->key, template_ctx->key, sizeof(template_ctx->key));
+    (*ctx_out)->key_len = template_ctx->key_len;
+    return AESGCMSIV_SUCCESS;
+}
+
+// The mock's contexts hold the raw key, so there is nothing worth caching
+struct aesgcmsiv_key_cache {
+    size_t capacity;
+};
+
+int aesgcmsiv_key_cache_new(size_t capacity, aesgcmsiv_key_cache** cache_out)
+{
+    if (!cache_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *cache_out = new (std::nothrow) aesgcmsiv_key_cache{capacity};
+    return *cache_out ? AESGCMSIV_SUCCESS : AESGCMSIV_ERROR_INTERNAL;
+}
+
+int aesgcmsiv_key_cache_get(
+    aesgcmsiv_key_cache* cache,
+    const uint8_t* key, size_t key_len,
+    aesgcmsiv_ctx** ctx_out)
+{
+    if (!cache) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    return aesgcmsiv_ctx_new(key, key_len, ctx_out);
+}
+
+int aesgcmsiv_key_cache_set_capacity(aesgcmsiv_key_cache* cache, size_t capacity)
+{
+    if (!cache) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    cache->capacity = capacity;
+    return AESGCMSIV_SUCCESS;
+}
+
+void aesgcmsiv_key_cache_clear(aesgcmsiv_key_cache*)
+{
+}
+
+void aesgcmsiv_key_cache_free(aesgcmsiv_key_cache* cache)
+{
+    delete cache;
+}
+
+// A value cache the mock keeps in the clear, searched linearly under one
+// lock, evicting the oldest entry when full
+struct aesgcmsiv_value_cache {
+    std::mutex lock;
+    size_t capacity;
+    std::deque<std::pair<uint64_t, std::vector<uint8_t>>> values;
+    uint64_t evictions;
+};
+
+static std::deque<std::pair<uint64_t, std::vector<uint8_t>>>::iterator find_value(
+    aesgcmsiv_value_cache* cache, uint64_t id)
+{
+    return std::find_if(cache->values.begin(), cache->values.end(),
+        [id](const std::pair<uint64_t, std::vector<uint8_t>>& value) { return value.first == id; });
+}
+
+int aesgcmsiv_value_cache_new(
+    const uint8_t* key, size_t key_len,
+    size_t capacity,
+    uint32_t,
+    aesgcmsiv_value_cache** cache_out)
+{
+    if (!cache_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *cache_out = nullptr;
+    if (key && key_len != AESGCMSIV_KEY_SIZE_128 && key_len != AESGCMSIV_KEY_SIZE_256) {
+        return AESGCMSIV_ERROR_INVALID_KEY;
+    }
+    if (capacity == 0 || capacity > AESGCMSIV_VALUE_CACHE_MAX_ENTRIES) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    aesgcmsiv_value_cache* cache = new (std::nothrow) aesgcmsiv_value_cache();
+    if (!cache) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    cache->capacity = capacity;
+    cache->evictions = 0;
+    *cache_out = cache;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_value_cache_put(
+    aesgcmsiv_value_cache* cache,
+    size_t count,
+    const aesgcmsiv_cache_value* values,
+    int* status_out)
+{
+    if (!cache || (count > 0 && (!values || !status_out))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::lock_guard<std::mutex> guard(cache->lock);
+    int first_error = AESGCMSIV_SUCCESS;
+    for (size_t i = 0; i < count; i++) {
+        const aesgcmsiv_cache_value& value = values[i];
+        auto found = find_value(cache, value.id);
+        if (found != cache->values.end()) {
+            cache->values.erase(found);
+        }
+        if (value.len > AESGCMSIV_VALUE_CACHE_MAX_VALUE || (!value.data && value.len > 0)) {
+            status_out[i] = AESGCMSIV_ERROR_INVALID_INPUT;
+            first_error = first_error == AESGCMSIV_SUCCESS ? status_out[i] : first_error;
+            continue;
+        }
+        if (cache->values.size() == cache->capacity) {
+            cache->values.pop_front();
+            cache->evictions++;
+        }
+        cache->values.emplace_back(value.id, std::vector<uint8_t>(value.data, value.data + value.len));
+        status_out[i] = AESGCMSIV_SUCCESS;
+    }
+    return first_error;
+}
+
+int aesgcmsiv_value_cache_get(
+    aesgcmsiv_value_cache* cache,
+    size_t count,
+    aesgcmsiv_cache_value* values,
+    int* status_out)
+{
+    if (!cache || (count > 0 && (!values || !status_out))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::lock_guard<std::mutex> guard(cache->lock);
+    int first_error = AESGCMSIV_SUCCESS;
+    for (size_t i = 0; i < count; i++) {
+        aesgcmsiv_cache_value& value = values[i];
+        auto found = find_value(cache, value.id);
+        if (found == cache->values.end()) {
+            status_out[i] = AESGCMSIV_ERROR_NOT_FOUND;
+        } else if (found->second.size() > value.len || (!value.data && !found->second.empty())) {
+            value.len = found->second.size();
+            status_out[i] = AESGCMSIV_ERROR_INVALID_INPUT;
+        } else {
+            value.len = found->second.size();
+            std::copy(found->second.begin(), found->second.end(), value.data);
+            status_out[i] = AESGCMSIV_SUCCESS;
+        }
+        first_error = first_error == AESGCMSIV_SUCCESS ? status_out[i] : first_error;
+    }
+    return first_error;
+}
+
+int aesgcmsiv_value_cache_remove(aesgcmsiv_value_cache* cache, uint64_t id)
+{
+    if (!cache) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::lock_guard<std::mutex> guard(cache->lock);
+    auto found = find_value(cache, id);
+    if (found == cache->values.end()) {
+        return AESGCMSIV_ERROR_NOT_FOUND;
+    }
+    cache->values.erase(found);
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_value_cache_get_stats(
+    aesgcmsiv_value_cache* cache,
+    aesgcmsiv_value_cache_stats* stats_out)
+{
+    if (!cache || !stats_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::lock_guard<std::mutex> guard(cache->lock);
+    stats_out->entries = cache->values.size();
+    stats_out->value_bytes = 0;
+    for (const auto& value : cache->values) {
+        stats_out->value_bytes += value.second.size();
+    }
+    stats_out->slab_bytes = 0;
+    stats_out->evictions = cache->evictions;
+    return AESGCMSIV_SUCCESS;
+}
+
+void aesgcmsiv_value_cache_free(aesgcmsiv_value_cache* cache)
+{
+    delete cache;
+}
+
+// A keyring the mock searches linearly under one lock
+struct aesgcmsiv_keyring {
+    std::mutex lock;
+    size_t capacity;
+    std::vector<std::pair<uint32_t, aesgcmsiv_ctx*>> keys;
+    std::vector<aesgcmsiv_ctx*> removed;
+    bool track_usage = false;
+};
+
+static aesgcmsiv_ctx* keyring_find(aesgcmsiv_keyring* keyring, uint32_t key_id)
+{
+    std::lock_guard<std::mutex> guard(keyring->lock);
+    for (const auto& entry : keyring->keys) {
+        if (entry.first == key_id) {
+            return entry.second;
+        }
+    }
+    return nullptr;
+}
+
+int aesgcmsiv_keyring_new(size_t capacity, aesgcmsiv_keyring** keyring_out)
+{
+    if (!keyring_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *keyring_out = nullptr;
+    if (capacity == 0 || capacity > (size_t(1) << 24)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *keyring_out = new (std::nothrow) aesgcmsiv_keyring();
+    if (!*keyring_out) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    (*keyring_out)->capacity = capacity;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_keyring_add(
+    aesgcmsiv_keyring* keyring, uint32_t key_id,
+    const uint8_t* key, size_t key_len)
+{
+    if (!keyring) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    if (keyring_find(keyring, key_id)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    aesgcmsiv_ctx* ctx;
+    int result = aesgcmsiv_ctx_new(key, key_len, &ctx);
+    if (result != AESGCMSIV_SUCCESS) {
+        return result;
+    }
+    std::lock_guard<std::mutex> guard(keyring->lock);
+    if (keyring->keys.size() == keyring->capacity) {
+        aesgcmsiv_ctx_free(ctx);
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    ctx->track_usage = keyring->track_usage;
+    keyring->keys.emplace_back(key_id, ctx);
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_keyring_remove(aesgcmsiv_keyring* keyring, uint32_t key_id)
+{
+    if (!keyring) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::lock_guard<std::mutex> guard(keyring->lock);
+    for (size_t i = 0; i < keyring->keys.size(); i++) {
+        if (keyring->keys[i].first == key_id) {
+            keyring->removed.push_back(keyring->keys[i].second);
+            keyring->keys.erase(keyring->keys.begin() + i);
+            return AESGCMSIV_SUCCESS;
+        }
+    }
+    return AESGCMSIV_ERROR_NOT_FOUND;
+}
+
+int aesgcmsiv_seal_with_keyid(
+    aesgcmsiv_keyring* keyring, uint32_t key_id,
+    const uint8_t* nonce, size_t nonce_len,
+    const uint8_t* plaintext, size_t plaintext_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* sealed_out)
+{
+    if (!keyring || !sealed_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    aesgcmsiv_ctx* ctx = keyring_find(keyring, key_id);
+    if (!ctx) {
+        return AESGCMSIV_ERROR_NOT_FOUND;
+    }
+    uint8_t* ciphertext = sealed_out + AESGCMSIV_KEYID_SIZE + AESGCMSIV_NONCE_SIZE;
+    int result = aesgcmsiv_ctx_encrypt(ctx, nonce, nonce_len,
+        plaintext, plaintext_len, aad, aad_len, ciphertext, ciphertext + plaintext_len);
+    if (result == AESGCMSIV_SUCCESS) {
+        memmove(sealed_out + AESGCMSIV_KEYID_SIZE, nonce, AESGCMSIV_NONCE_SIZE);
+        for (int i = 0; i < AESGCMSIV_KEYID_SIZE; i++) {
+            sealed_out[i] = static_cast<uint8_t>(key_id >> (24 - 8 * i));
+        }
+    }
+    return result;
+}
+
+int aesgcmsiv_open_with_keyid(
+    aesgcmsiv_keyring* keyring,
+    const uint8_t* sealed, size_t sealed_len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* plaintext_out,
+    uint32_t* key_id_out)
+{
+    if (!sealed || sealed_len < AESGCMSIV_KEYID_SIZE) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    uint32_t key_id = 0;
+    for (int i = 0; i < AESGCMSIV_KEYID_SIZE; i++) {
+        key_id = (key_id << 8) | sealed[i];
+    }
+    if (key_id_out) {
+        *key_id_out = key_id;
+    }
+    if (!keyring || sealed_len < AESGCMSIV_KEYID_SEAL_OVERHEAD) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    aesgcmsiv_ctx* ctx = keyring_find(keyring, key_id);
+    if (!ctx) {
+        return AESGCMSIV_ERROR_NOT_FOUND;
+    }
+    const uint8_t* nonce = sealed + AESGCMSIV_KEYID_SIZE;
+    const uint8_t* ciphertext = nonce + AESGCMSIV_NONCE_SIZE;
+    size_t ciphertext_len = sealed_len - AESGCMSIV_KEYID_SEAL_OVERHEAD;
+    return aesgcmsiv_ctx_decrypt(ctx, nonce, AESGCMSIV_NONCE_SIZE,
+        ciphertext, ciphertext_len, aad, aad_len, ciphertext + ciphertext_len, plaintext_out);
+}
+
+int aesgcmsiv_keyring_set_usage_tracking(aesgcmsiv_keyring* keyring, int enabled)
+{
+    if (!keyring) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::lock_guard<std::mutex> guard(keyring->lock);
+    for (const auto& entry : keyring->keys) {
+        aesgcmsiv_ctx_set_usage_tracking(entry.second, enabled);
+    }
+    for (aesgcmsiv_ctx* ctx : keyring->removed) {
+        aesgcmsiv_ctx_set_usage_tracking(ctx, enabled);
+    }
+    keyring->track_usage = enabled != 0;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_keyring_stats(
+    aesgcmsiv_keyring* keyring,
+    aesgcmsiv_key_usage* usage_out, size_t max,
+    size_t* count_out)
+{
+    if (!keyring || !count_out || (max && !usage_out)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    std::lock_guard<std::mutex> guard(keyring->lock);
+    for (size_t i = 0; i < keyring->keys.size() && i < max; i++) {
+        aesgcmsiv_ctx_get_usage(keyring->keys[i].second, &usage_out[i]);
+        usage_out[i].key_id = keyring->keys[i].first;
+    }
+    *count_out = keyring->keys.size();
+    return AESGCMSIV_SUCCESS;
+}
+
+void aesgcmsiv_keyring_free(aesgcmsiv_keyring* keyring)
+{
+    if (!keyring) {
+        return;
+    }
+    for (const auto& entry : keyring->keys) {
+        aesgcmsiv_ctx_free(entry.second);
+    }
+    for (aesgcmsiv_ctx* ctx : keyring->removed) {
+        aesgcmsiv_ctx_free(ctx);
+    }
+    delete keyring;
+}
+
+// The mock's subkey is the master key folded with the record ID, which
+// keeps records apart without hashing anything
+struct aesgcmsiv_kdf {
+    uint8_t master[AESGCMSIV_KEY_SIZE];
+    size_t key_len;
+};
+
+static void mock_derive(const aesgcmsiv_kdf* kdf, const aesgcmsiv_iovec& id, uint8_t* key_out)
+{
+    memcpy(key_out, kdf->master, kdf->key_len);
+    for (size_t i = 0; i < id.len; i++) {
+        key_out[i % kdf->key_len] ^= static_cast<uint8_t>(id.data[i] + i / kdf->key_len);
+    }
+    key_out[0] ^= static_cast<uint8_t>(id.len);
+}
+
+int aesgcmsiv_kdf_new(
+    const uint8_t* master_key, size_t master_len,
+    const uint8_t* salt, size_t salt_len,
+    size_t key_len,
+    aesgcmsiv_kdf** kdf_out)
+{
+    if (!kdf_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *kdf_out = nullptr;
+    if (!master_key || master_len == 0 || !valid_key(master_key, key_len)) {
+        return AESGCMSIV_ERROR_INVALID_KEY;
+    }
+    if (salt_len > 0 && !salt) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    aesgcmsiv_kdf* kdf = new (std::nothrow) aesgcmsiv_kdf();
+    if (!kdf) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    kdf->key_len = key_len;
+    for (size_t i = 0; i < master_len; i++) {
+        kdf->master[i % key_len] ^= master_key[i];
+    }
+    for (size_t i = 0; i < salt_len; i++) {
+        kdf->master[i % key_len] ^= static_cast<uint8_t>(salt[i] + 1);
+    }
+    *kdf_out = kdf;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_kdf_set_cache(aesgcmsiv_kdf* kdf, aesgcmsiv_key_cache*)
+{
+    return kdf ? AESGCMSIV_SUCCESS : AESGCMSIV_ERROR_INVALID_INPUT;
+}
+
+int aesgcmsiv_kdf_derive_batch(
+    aesgcmsiv_kdf* kdf,
+    size_t count,
+    const aesgcmsiv_iovec* ids,
+    uint8_t* keys_out)
+{
+    if (!kdf || (count > 0 && (!ids || !keys_out))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (ids[i].len > 0 && !ids[i].data) {
+            return AESGCMSIV_ERROR_INVALID_INPUT;
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        mock_derive(kdf, ids[i], keys_out + i * kdf->key_len);
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_kdf_encrypt_batch(
+    aesgcmsiv_kdf* kdf,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const aesgcmsiv_iovec* ids)
+{
+    if (!kdf || (count > 0 && (!items || !ids))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    for (size_t i = 0; i < count; i++) {
+        uint8_t key[AESGCMSIV_KEY_SIZE];
+        int result = aesgcmsiv_kdf_derive_batch(kdf, 1, &ids[i], key);
+        if (result != AESGCMSIV_SUCCESS) {
+            return result;
+        }
+        const aesgcmsiv_batch_item& item = items[i];
+        result = aesgcmsiv_encrypt(key, kdf->key_len, item.nonce, AESGCMSIV_NONCE_SIZE,
+            item.input, item.input_len, item.aad, item.aad_len, item.output, item.tag);
+        if (result != AESGCMSIV_SUCCESS) {
+            return result;
+        }
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_kdf_decrypt_batch(
+    aesgcmsiv_kdf* kdf,
+    size_t count,
+    const aesgcmsiv_batch_item* items,
+    const aesgcmsiv_iovec* ids,
+    int* status_out)
+{
+    if (!kdf || (count > 0 && (!items || !ids || !status_out))) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    int first_failure = AESGCMSIV_SUCCESS;
+    for (size_t i = 0; i < count; i++) {
+        uint8_t key[AESGCMSIV_KEY_SIZE];
+        const aesgcmsiv_batch_item& item = items[i];
+        status_out[i] = aesgcmsiv_kdf_derive_batch(kdf, 1, &ids[i], key);
+        if (status_out[i] == AESGCMSIV_SUCCESS) {
+            status_out[i] = aesgcmsiv_decrypt(key, kdf->key_len, item.nonce, AESGCMSIV_NONCE_SIZE,
+                item.input, item.input_len, item.aad, item.aad_len, item.tag, item.output);
+        }
+        if (status_out[i] != AESGCMSIV_SUCCESS && first_failure == AESGCMSIV_SUCCESS) {
+            first_failure = status_out[i];
+        }
+    }
+    return first_failure;
+}
+
+void aesgcmsiv_kdf_free(aesgcmsiv_kdf* kdf)
+{
+    if (kdf) {
+        memset(kdf->master, 0, sizeof(kdf->master));
+        delete kdf;
+    }
+}
+
+int aesgcmsiv_init(uint32_t flags)
+{
+    return (flags & ~AESGCMSIV_INIT_NO_LOAD_CONFIG) ? AESGCMSIV_ERROR_INVALID_INPUT : AESGCMSIV_SUCCESS;
+}
+
+unsigned long aesgcmsiv_get_openssl_error(void)
+{
+    return 0;
+}
+
+int aesgcmsiv_get_backend(const char** name_out, uint32_t* features_out)
+{
+    if (!name_out || !features_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *name_out = "mock";
+    *features_out = 0;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_select_backend(const char* name)
+{
+    return !name || strcmp(name, "mock") == 0 ? AESGCMSIV_SUCCESS : AESGCMSIV_ERROR_NOT_FOUND;
+}
+
+int aesgcmsiv_debug_fail_alloc(uint32_t)
+{
+    return AESGCMSIV_ERROR_NOT_FOUND;
+}
+
+int aesgcmsiv_probe(size_t bytes, unsigned int runs, aesgcmsiv_probe_result* result_out)
+{
+    if (!result_out || bytes > AESGCMSIV_PROBE_MAX_BYTES || runs > AESGCMSIV_PROBE_MAX_RUNS) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    bytes = bytes ? bytes : AESGCMSIV_PROBE_DEFAULT_BYTES;
+    result_out->backend = "mock";
+    result_out->bytes = bytes;
+    result_out->cycles = bytes;
+    result_out->ns = bytes;
+    result_out->expected_cycles = 0;
+    return AESGCMSIV_SUCCESS;
+}
+
+void aesgcmsiv_nop(void)
+{
+}
+
+void aesgcmsiv_stats_enable(int)
+{
+}
+
+int aesgcmsiv_get_stats(aesgcmsiv_stats* stats_out)
+{
+    if (!stats_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *stats_out = aesgcmsiv_stats{};
+    return AESGCMSIV_SUCCESS;
+}
+
+void aesgcmsiv_reset_stats(void)
+{
+}
+
+// The mock allocates nothing on the request path
+int aesgcmsiv_get_alloc_stats(aesgcmsiv_alloc_stats* stats_out)
+{
+    if (!stats_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *stats_out = aesgcmsiv_alloc_stats{};
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_set_slow_op_callback(uint64_t, aesgcmsiv_slow_op_fn)
+{
+    return AESGCMSIV_SUCCESS;
+}
+
+void aesgcmsiv_profile_enable(int)
+{
+}
+
+int aesgcmsiv_get_profile(aesgcmsiv_profile* profile_out)
+{
+    if (!profile_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *profile_out = aesgcmsiv_profile{};
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_record_start(const char* path, size_t)
+{
+    return path ? AESGCMSIV_SUCCESS : AESGCMSIV_ERROR_INVALID_INPUT;
+}
+
+int aesgcmsiv_record_stop(uint64_t* dropped_out)
+{
+    if (dropped_out) {
+        *dropped_out = 0;
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_set_tuning(const aesgcmsiv_tuning*)
+{
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_get_tuning(aesgcmsiv_tuning* tuning_out)
+{
+    if (!tuning_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *tuning_out = aesgcmsiv_tuning{};
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_get_caps(aesgcmsiv_caps* caps_out)
+{
+    if (!caps_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *caps_out = aesgcmsiv_caps{};
+    caps_out->flags = AESGCMSIV_CAPS_KEY_128 | AESGCMSIV_CAPS_KEY_256 | AESGCMSIV_CAPS_IN_PLACE | AESGCMSIV_CAPS_SMALL;
+    caps_out->max_input_len = AESGCMSIV_MAX_INPUT_SIZE;
+    caps_out->batch_width = 1;
+    caps_out->alignment = 1;
+    caps_out->parallel_max_threads = 1;
+    return AESGCMSIV_SUCCESS;
+}
+
+// The mock hash folds each zero-padded block into the key with XOR
+struct aesgcmsiv_polyval {
+    uint8_t key[16];
+    uint8_t s[16];
+    size_t pos;
+};
+
+int aesgcmsiv_polyval_init(const uint8_t* key, size_t key_len, aesgcmsiv_polyval** state_out)
+{
+    if (!state_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    *state_out = nullptr;
+    if (!key || key_len != 16) {
+        return AESGCMSIV_ERROR_INVALID_KEY;
+    }
+    aesgcmsiv_polyval* state = new (std::nothrow) aesgcmsiv_polyval();
+    if (!state) {
+        return AESGCMSIV_ERROR_INTERNAL;
+    }
+    memcpy(state->key, key, 16);
+    *state_out = state;
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_polyval_update(aesgcmsiv_polyval* state, const uint8_t* data, size_t len)
+{
+    if (!state || (!data && len)) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    for (size_t i = 0; i < len; i++) {
+        state->s[state->pos] ^= data[i];
+        state->pos = (state->pos + 1) % 16;
+    }
+    return AESGCMSIV_SUCCESS;
+}
+
+int aesgcmsiv_polyval_final(aesgcmsiv_polyval* state, uint8_t* hash_out)
+{
+    if (!state || !hash_out) {
+        return AESGCMSIV_ERROR_INVALID_INPUT;
+    }
+    for (int i = 0; i < 16; i++) {
+        hash_out[i] = static_cast<uint8_t>(state->s[i] ^ state->key[i]);
+    }
+    memset(state->s, 0, sizeof(state->s));
+    state->pos = 0;
+    return AESGCMSIV_SUCCESS;
+}
+
+void aesgcmsiv_polyval_free(aesgcmsiv_polyval* state)
+{
+    delete state;
+}
+
 } // extern "C" 
\ No newline at end of file